@@ -47,6 +47,14 @@ static void efiarm_cpu_nap ( void ) {
 	 * just sits there idly burning power.
 	 *
 	 */
+
+	/* Timer interrupts may already have been disabled if
+	 * ExitBootServices() has been called, in which case we might
+	 * never wake up.
+	 */
+	if ( efi_shutdown_in_progress )
+		return;
+
 	__asm__ __volatile__ ( "wfi" );
 }
 
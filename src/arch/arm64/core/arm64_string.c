@@ -188,9 +188,15 @@ void arm64_memmove_forwards ( void *dest, const void *src, size_t len ) {
 	const void *discard_src;
 	unsigned long discard_data;
 
-	/* Assume memmove() is not performance-critical, and perform a
-	 * bytewise copy for simplicity.
+	/* Use "ldp"/"stp" copy if the regions are sufficiently far
+	 * apart that no 16-byte load can observe an earlier store.
 	 */
+	if ( ( src - dest ) >= 16 ) {
+		arm64_memcpy ( dest, src, len );
+		return;
+	}
+
+	/* Otherwise, perform a bytewise copy */
 	__asm__ __volatile__ ( "b 2f\n\t"
 			       "\n1:\n\t"
 			       "ldrb %w2, [%1], #1\n\t"
@@ -213,23 +219,64 @@ void arm64_memmove_forwards ( void *dest, const void *src, size_t len ) {
  * @v len		Length
  */
 void arm64_memmove_backwards ( void *dest, const void *src, size_t len ) {
+	void *discard_dest;
+	void *discard_start;
+	const void *discard_src;
 	size_t discard_offset;
 	unsigned long discard_data;
+	unsigned long discard_low;
+	unsigned long discard_high;
 
-	/* Assume memmove() is not performance-critical, and perform a
-	 * bytewise copy for simplicity.
+	/* If length is too short for an "ldp"/"stp" instruction pair,
+	 * or if the regions are so close together that a 16-byte
+	 * load could observe an earlier store, then just copy
+	 * individual bytes.
 	 */
-	__asm__ __volatile__ ( "cbz %0, 2f\n\t"
+	if ( ( len < 16 ) || ( ( dest - src ) < 16 ) ) {
+		__asm__ __volatile__ ( "cbz %0, 2f\n\t"
+				       "\n1:\n\t"
+				       "sub %0, %0, #1\n\t"
+				       "ldrb %w1, [%3, %0]\n\t"
+				       "strb %w1, [%2, %0]\n\t"
+				       "cbnz %0, 1b\n\t"
+				       "\n2:\n\t"
+				       : "=&r" ( discard_offset ),
+					 "=&r" ( discard_data )
+				       : "r" ( dest ), "r" ( src ), "0" ( len )
+				       : "memory" );
+		return;
+	}
+
+	/* Use "ldp"/"stp" to copy 16 bytes at a time, working down
+	 * from the end: one initial potentially unaligned access,
+	 * multiple destination-aligned accesses, one final
+	 * potentially unaligned access.
+	 */
+	__asm__ __volatile__ ( "ldp %3, %4, [%1, #-16]!\n\t"
+			       "stp %3, %4, [%0, #-16]!\n\t"
+			       "neg %3, %0\n\t"
+			       "and %3, %3, #15\n\t"
+			       "add %0, %0, %3\n\t"
+			       "add %1, %1, %3\n\t"
+			       "add %2, %5, #15\n\t"
+			       "bic %2, %2, #15\n\t"
+			       "b 2f\n\t"
 			       "\n1:\n\t"
-			       "sub %0, %0, #1\n\t"
-			       "ldrb %w1, [%3, %0]\n\t"
-			       "strb %w1, [%2, %0]\n\t"
-			       "cbnz %0, 1b\n\t"
+			       "ldp %3, %4, [%1, #-16]!\n\t"
+			       "stp %3, %4, [%0, #-16]!\n\t"
 			       "\n2:\n\t"
-			       : "=&r" ( discard_offset ),
-				 "=&r" ( discard_data )
-			       : "r" ( dest ), "r" ( src ), "0" ( len )
-			       : "memory" );
+			       "cmp %0, %2\n\t"
+			       "bne 1b\n\t"
+			       "ldp %3, %4, [%6]\n\t"
+			       "stp %3, %4, [%5]\n\t"
+			       : "=&r" ( discard_dest ),
+				 "=&r" ( discard_src ),
+				 "=&r" ( discard_start ),
+				 "=&r" ( discard_low ),
+				 "=&r" ( discard_high )
+			       : "r" ( dest ), "r" ( src ),
+				 "0" ( dest + len ), "1" ( src + len )
+			       : "memory", "cc" );
 }
 
 /**
@@ -0,0 +1,271 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <ipxe/aes.h>
+#include <ipxe/cpuid.h>
+#include <ipxe/sse.h>
+
+/** @file
+ *
+ * AES-NI accelerated AES
+ *
+ * Round keys are loaded using unaligned accesses, since the AES
+ * context has no particular alignment.
+ *
+ * Multiple blocks are processed in groups of four, with the rounds
+ * for each group interleaved so that the latency of each AES
+ * instruction is hidden behind the following independent ones.
+ */
+
+/** Number of blocks processed in parallel */
+#define AESNI_PARALLEL 4
+
+/**
+ * Check if AES-NI is supported
+ *
+ * @ret supported	AES-NI is supported
+ */
+static int aesni_supported ( void ) {
+	struct x86_features features;
+
+	/* Check for AES instructions */
+	x86_features ( &features );
+	return ( !! ( features.intel.ecx & CPUID_FEATURES_INTEL_ECX_AES ) );
+}
+
+/**
+ * Encrypt single block
+ *
+ * @v aes		AES context
+ * @v src		Data to encrypt
+ * @v dst		Buffer for encrypted data
+ */
+static void aesni_encrypt ( struct aes_context *aes, const void *src,
+			    void *dst ) {
+	const union aes_matrix *key = aes->encrypt.key;
+	unsigned int count = ( aes->rounds - 1 );
+
+	__asm__ __volatile__ ( "movdqu (%2), %%xmm0\n\t"
+			       "movdqu (%0), %%xmm1\n\t"
+			       "pxor %%xmm1, %%xmm0\n\t"
+			       "\n1:\n\t"
+			       "add $16, %0\n\t"
+			       "movdqu (%0), %%xmm1\n\t"
+			       "dec %1\n\t"
+			       "jz 2f\n\t"
+			       "aesenc %%xmm1, %%xmm0\n\t"
+			       "jmp 1b\n\t"
+			       "\n2:\n\t"
+			       "aesenclast %%xmm1, %%xmm0\n\t"
+			       "movdqu %%xmm0, (%3)\n\t"
+			       : "+r" ( key ), "+r" ( count )
+			       : "r" ( src ), "r" ( dst )
+			       : SSE_CLOBBERS "memory" );
+}
+
+/**
+ * Decrypt single block
+ *
+ * @v aes		AES context
+ * @v src		Data to decrypt
+ * @v dst		Buffer for decrypted data
+ */
+static void aesni_decrypt ( struct aes_context *aes, const void *src,
+			    void *dst ) {
+	const union aes_matrix *key = aes->decrypt.key;
+	unsigned int count = ( aes->rounds - 1 );
+
+	__asm__ __volatile__ ( "movdqu (%2), %%xmm0\n\t"
+			       "movdqu (%0), %%xmm1\n\t"
+			       "pxor %%xmm1, %%xmm0\n\t"
+			       "\n1:\n\t"
+			       "add $16, %0\n\t"
+			       "movdqu (%0), %%xmm1\n\t"
+			       "dec %1\n\t"
+			       "jz 2f\n\t"
+			       "aesdec %%xmm1, %%xmm0\n\t"
+			       "jmp 1b\n\t"
+			       "\n2:\n\t"
+			       "aesdeclast %%xmm1, %%xmm0\n\t"
+			       "movdqu %%xmm0, (%3)\n\t"
+			       : "+r" ( key ), "+r" ( count )
+			       : "r" ( src ), "r" ( dst )
+			       : SSE_CLOBBERS "memory" );
+}
+
+/**
+ * Encrypt four blocks in parallel
+ *
+ * @v aes		AES context
+ * @v src		Data to encrypt
+ * @v dst		Buffer for encrypted data
+ */
+static void aesni_encrypt_parallel ( struct aes_context *aes,
+				     const void *src, void *dst ) {
+	const union aes_matrix *key = aes->encrypt.key;
+	unsigned int count = ( aes->rounds - 1 );
+
+	__asm__ __volatile__ ( "movdqu (%0), %%xmm4\n\t"
+			       "movdqu 0(%2), %%xmm0\n\t"
+			       "movdqu 16(%2), %%xmm1\n\t"
+			       "movdqu 32(%2), %%xmm2\n\t"
+			       "movdqu 48(%2), %%xmm3\n\t"
+			       "pxor %%xmm4, %%xmm0\n\t"
+			       "pxor %%xmm4, %%xmm1\n\t"
+			       "pxor %%xmm4, %%xmm2\n\t"
+			       "pxor %%xmm4, %%xmm3\n\t"
+			       "\n1:\n\t"
+			       "add $16, %0\n\t"
+			       "movdqu (%0), %%xmm4\n\t"
+			       "dec %1\n\t"
+			       "jz 2f\n\t"
+			       "aesenc %%xmm4, %%xmm0\n\t"
+			       "aesenc %%xmm4, %%xmm1\n\t"
+			       "aesenc %%xmm4, %%xmm2\n\t"
+			       "aesenc %%xmm4, %%xmm3\n\t"
+			       "jmp 1b\n\t"
+			       "\n2:\n\t"
+			       "aesenclast %%xmm4, %%xmm0\n\t"
+			       "aesenclast %%xmm4, %%xmm1\n\t"
+			       "aesenclast %%xmm4, %%xmm2\n\t"
+			       "aesenclast %%xmm4, %%xmm3\n\t"
+			       "movdqu %%xmm0, 0(%3)\n\t"
+			       "movdqu %%xmm1, 16(%3)\n\t"
+			       "movdqu %%xmm2, 32(%3)\n\t"
+			       "movdqu %%xmm3, 48(%3)\n\t"
+			       : "+r" ( key ), "+r" ( count )
+			       : "r" ( src ), "r" ( dst )
+			       : SSE_CLOBBERS "memory" );
+}
+
+/**
+ * Decrypt four blocks in parallel
+ *
+ * @v aes		AES context
+ * @v src		Data to decrypt
+ * @v dst		Buffer for decrypted data
+ */
+static void aesni_decrypt_parallel ( struct aes_context *aes,
+				     const void *src, void *dst ) {
+	const union aes_matrix *key = aes->decrypt.key;
+	unsigned int count = ( aes->rounds - 1 );
+
+	__asm__ __volatile__ ( "movdqu (%0), %%xmm4\n\t"
+			       "movdqu 0(%2), %%xmm0\n\t"
+			       "movdqu 16(%2), %%xmm1\n\t"
+			       "movdqu 32(%2), %%xmm2\n\t"
+			       "movdqu 48(%2), %%xmm3\n\t"
+			       "pxor %%xmm4, %%xmm0\n\t"
+			       "pxor %%xmm4, %%xmm1\n\t"
+			       "pxor %%xmm4, %%xmm2\n\t"
+			       "pxor %%xmm4, %%xmm3\n\t"
+			       "\n1:\n\t"
+			       "add $16, %0\n\t"
+			       "movdqu (%0), %%xmm4\n\t"
+			       "dec %1\n\t"
+			       "jz 2f\n\t"
+			       "aesdec %%xmm4, %%xmm0\n\t"
+			       "aesdec %%xmm4, %%xmm1\n\t"
+			       "aesdec %%xmm4, %%xmm2\n\t"
+			       "aesdec %%xmm4, %%xmm3\n\t"
+			       "jmp 1b\n\t"
+			       "\n2:\n\t"
+			       "aesdeclast %%xmm4, %%xmm0\n\t"
+			       "aesdeclast %%xmm4, %%xmm1\n\t"
+			       "aesdeclast %%xmm4, %%xmm2\n\t"
+			       "aesdeclast %%xmm4, %%xmm3\n\t"
+			       "movdqu %%xmm0, 0(%3)\n\t"
+			       "movdqu %%xmm1, 16(%3)\n\t"
+			       "movdqu %%xmm2, 32(%3)\n\t"
+			       "movdqu %%xmm3, 48(%3)\n\t"
+			       : "+r" ( key ), "+r" ( count )
+			       : "r" ( src ), "r" ( dst )
+			       : SSE_CLOBBERS "memory" );
+}
+
+/**
+ * Encrypt multiple blocks
+ *
+ * @v aes		AES context
+ * @v src		Data to encrypt
+ * @v dst		Buffer for encrypted data
+ * @v len		Length of data
+ */
+static void aesni_bulk_encrypt ( struct aes_context *aes, const void *src,
+				 void *dst, size_t len ) {
+
+	/* Encrypt groups of blocks in parallel */
+	while ( len >= ( AESNI_PARALLEL * AES_BLOCKSIZE ) ) {
+		aesni_encrypt_parallel ( aes, src, dst );
+		src += ( AESNI_PARALLEL * AES_BLOCKSIZE );
+		dst += ( AESNI_PARALLEL * AES_BLOCKSIZE );
+		len -= ( AESNI_PARALLEL * AES_BLOCKSIZE );
+	}
+
+	/* Encrypt any remaining blocks individually */
+	while ( len ) {
+		aesni_encrypt ( aes, src, dst );
+		src += AES_BLOCKSIZE;
+		dst += AES_BLOCKSIZE;
+		len -= AES_BLOCKSIZE;
+	}
+}
+
+/**
+ * Decrypt multiple blocks
+ *
+ * @v aes		AES context
+ * @v src		Data to decrypt
+ * @v dst		Buffer for decrypted data
+ * @v len		Length of data
+ */
+static void aesni_bulk_decrypt ( struct aes_context *aes, const void *src,
+				 void *dst, size_t len ) {
+
+	/* Decrypt groups of blocks in parallel */
+	while ( len >= ( AESNI_PARALLEL * AES_BLOCKSIZE ) ) {
+		aesni_decrypt_parallel ( aes, src, dst );
+		src += ( AESNI_PARALLEL * AES_BLOCKSIZE );
+		dst += ( AESNI_PARALLEL * AES_BLOCKSIZE );
+		len -= ( AESNI_PARALLEL * AES_BLOCKSIZE );
+	}
+
+	/* Decrypt any remaining blocks individually */
+	while ( len ) {
+		aesni_decrypt ( aes, src, dst );
+		src += AES_BLOCKSIZE;
+		dst += AES_BLOCKSIZE;
+		len -= AES_BLOCKSIZE;
+	}
+}
+
+/** AES-NI accelerator */
+struct aes_accelerator aesni_accelerator __aes_accelerator = {
+	.name = "AES-NI",
+	.supported = aesni_supported,
+	.encrypt = aesni_encrypt,
+	.decrypt = aesni_decrypt,
+	.bulk_encrypt = aesni_bulk_encrypt,
+	.bulk_decrypt = aesni_bulk_decrypt,
+};
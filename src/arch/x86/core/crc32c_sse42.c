@@ -0,0 +1,94 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+#include <stdint.h>
+#include <string.h>
+#include <ipxe/crc32c.h>
+#include <ipxe/cpuid.h>
+
+/** @file
+ *
+ * SSE4.2 accelerated CRC32C
+ *
+ * The SSE4.2 "crc32" instruction implements the Castagnoli
+ * polynomial directly, and operates only on general-purpose
+ * registers.  No SSE register state is touched.
+ */
+
+/** Native word type consumed by each instruction in the main loop */
+typedef unsigned long crc32c_sse42_word_t;
+
+/**
+ * Check if SSE4.2 is supported
+ *
+ * @ret supported	SSE4.2 is supported
+ */
+static int crc32c_sse42_supported ( void ) {
+	uint32_t discard_a;
+	uint32_t discard_b;
+	uint32_t ecx;
+	uint32_t discard_d;
+
+	/* Check for SSE4.2 instructions */
+	if ( cpuid_supported ( CPUID_FEATURES ) != 0 )
+		return 0;
+	cpuid ( CPUID_FEATURES, &discard_a, &discard_b, &ecx, &discard_d );
+	return ( !! ( ecx & CPUID_FEATURES_INTEL_ECX_SSE4_2 ) );
+}
+
+/**
+ * Update CRC32C
+ *
+ * @v crc		Current CRC value
+ * @v data		Data
+ * @v len		Length of data
+ * @ret crc		Updated CRC value
+ */
+static uint32_t crc32c_sse42_update ( uint32_t crc, const void *data,
+				      size_t len ) {
+	const uint8_t *bytes = data;
+	crc32c_sse42_word_t word;
+	unsigned long value = crc;
+
+	/* Process a native word at a time */
+	while ( len >= sizeof ( word ) ) {
+		memcpy ( &word, bytes, sizeof ( word ) );
+		__asm__ ( "crc32 %1, %0" : "+r" ( value ) : "r" ( word ) );
+		bytes += sizeof ( word );
+		len -= sizeof ( word );
+	}
+
+	/* Process trailing bytes */
+	while ( len-- ) {
+		__asm__ ( "crc32b %1, %k0"
+			  : "+r" ( value ) : "rm" ( *(bytes++) ) );
+	}
+
+	return value;
+}
+
+/** SSE4.2 accelerated CRC32C */
+struct crc32c_accelerator crc32c_sse42 __crc32c_accelerator = {
+	.name = "sse4.2",
+	.supported = crc32c_sse42_supported,
+	.update = crc32c_sse42_update,
+};
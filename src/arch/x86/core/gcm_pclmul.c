@@ -0,0 +1,140 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <ipxe/gcm.h>
+#include <ipxe/cpuid.h>
+#include <ipxe/sse.h>
+
+/** @file
+ *
+ * PCLMULQDQ accelerated GCM
+ *
+ * Blocks are byte-reversed on loading, so that each polynomial is
+ * held as a 128-bit value with the coefficient of x^127 in the least
+ * significant bit.  The 256-bit carry-less product is then shifted
+ * left by one bit to account for the bit-reflected representation,
+ * and reduced modulo the field polynomial.
+ */
+
+/** Byte shuffle mask to reverse a block */
+static const uint8_t gcm_pclmul_reverse[16] = {
+	0x0f, 0x0e, 0x0d, 0x0c, 0x0b, 0x0a, 0x09, 0x08,
+	0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01, 0x00,
+};
+
+/**
+ * Check if PCLMULQDQ is supported
+ *
+ * @ret supported	PCLMULQDQ is supported
+ */
+static int gcm_pclmul_supported ( void ) {
+	struct x86_features features;
+
+	/* Check for carry-less multiplication instruction */
+	x86_features ( &features );
+	return ( !! ( features.intel.ecx & CPUID_FEATURES_INTEL_ECX_PCLMUL ) );
+}
+
+/**
+ * Multiply by hash key
+ *
+ * @v poly		Polynomial to multiply (in place)
+ * @v key		Hash key
+ */
+static void gcm_pclmul_multiply ( union gcm_block *poly,
+				  const union gcm_block *key ) {
+
+	__asm__ __volatile__ ( /* Load and reverse operands */
+			       "movdqu (%2), %%xmm2\n\t"
+			       "movdqu (%0), %%xmm0\n\t"
+			       "movdqu (%1), %%xmm1\n\t"
+			       "pshufb %%xmm2, %%xmm0\n\t"
+			       "pshufb %%xmm2, %%xmm1\n\t"
+			       /* Calculate 256-bit product in %xmm0:%xmm2 */
+			       "movdqa %%xmm0, %%xmm2\n\t"
+			       "pclmulqdq $0x00, %%xmm1, %%xmm2\n\t"
+			       "movdqa %%xmm0, %%xmm3\n\t"
+			       "pclmulqdq $0x10, %%xmm1, %%xmm3\n\t"
+			       "movdqa %%xmm0, %%xmm4\n\t"
+			       "pclmulqdq $0x01, %%xmm1, %%xmm4\n\t"
+			       "pclmulqdq $0x11, %%xmm1, %%xmm0\n\t"
+			       "pxor %%xmm4, %%xmm3\n\t"
+			       "movdqa %%xmm3, %%xmm4\n\t"
+			       "pslldq $8, %%xmm4\n\t"
+			       "psrldq $8, %%xmm3\n\t"
+			       "pxor %%xmm4, %%xmm2\n\t"
+			       "pxor %%xmm3, %%xmm0\n\t"
+			       /* Shift product left by one bit */
+			       "movdqa %%xmm2, %%xmm3\n\t"
+			       "psrld $31, %%xmm3\n\t"
+			       "movdqa %%xmm0, %%xmm4\n\t"
+			       "psrld $31, %%xmm4\n\t"
+			       "pslld $1, %%xmm2\n\t"
+			       "pslld $1, %%xmm0\n\t"
+			       "movdqa %%xmm3, %%xmm5\n\t"
+			       "psrldq $12, %%xmm5\n\t"
+			       "pslldq $4, %%xmm4\n\t"
+			       "pslldq $4, %%xmm3\n\t"
+			       "por %%xmm3, %%xmm2\n\t"
+			       "por %%xmm4, %%xmm0\n\t"
+			       "por %%xmm5, %%xmm0\n\t"
+			       /* Reduce low half */
+			       "movdqa %%xmm2, %%xmm3\n\t"
+			       "pslld $31, %%xmm3\n\t"
+			       "movdqa %%xmm2, %%xmm4\n\t"
+			       "pslld $30, %%xmm4\n\t"
+			       "movdqa %%xmm2, %%xmm5\n\t"
+			       "pslld $25, %%xmm5\n\t"
+			       "pxor %%xmm4, %%xmm3\n\t"
+			       "pxor %%xmm5, %%xmm3\n\t"
+			       "movdqa %%xmm3, %%xmm4\n\t"
+			       "psrldq $4, %%xmm4\n\t"
+			       "pslldq $12, %%xmm3\n\t"
+			       "pxor %%xmm3, %%xmm2\n\t"
+			       "movdqa %%xmm2, %%xmm1\n\t"
+			       "psrld $1, %%xmm1\n\t"
+			       "movdqa %%xmm2, %%xmm3\n\t"
+			       "psrld $2, %%xmm3\n\t"
+			       "movdqa %%xmm2, %%xmm5\n\t"
+			       "psrld $7, %%xmm5\n\t"
+			       "pxor %%xmm3, %%xmm1\n\t"
+			       "pxor %%xmm5, %%xmm1\n\t"
+			       "pxor %%xmm4, %%xmm1\n\t"
+			       "pxor %%xmm1, %%xmm2\n\t"
+			       "pxor %%xmm2, %%xmm0\n\t"
+			       /* Reverse and store result */
+			       "movdqu (%2), %%xmm1\n\t"
+			       "pshufb %%xmm1, %%xmm0\n\t"
+			       "movdqu %%xmm0, (%0)\n\t"
+			       : : "r" ( poly ), "r" ( key ),
+				   "r" ( gcm_pclmul_reverse )
+			       : SSE_CLOBBERS "memory" );
+}
+
+/** PCLMULQDQ GCM accelerator */
+struct gcm_accelerator gcm_pclmul_accelerator __gcm_accelerator = {
+	.name = "PCLMULQDQ",
+	.supported = gcm_pclmul_supported,
+	.multiply = gcm_pclmul_multiply,
+};
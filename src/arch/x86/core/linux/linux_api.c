@@ -109,6 +109,10 @@ int linux_munmap ( void *addr, __kernel_size_t length ) {
 	return linux_syscall ( __NR_munmap, addr, length );
 }
 
+int linux_madvise ( void *addr, __kernel_size_t length, int advice ) {
+	return linux_syscall ( __NR_madvise, addr, length, advice );
+}
+
 int linux_socket ( int domain, int type_, int protocol ) {
 #ifdef __NR_socket
 	return linux_syscall ( __NR_socket, domain, type_, protocol );
@@ -147,3 +151,46 @@ ssize_t linux_sendto ( int fd, const void *buf, size_t len, int flags,
 	return linux_syscall ( __NR_socketcall, SOCKOP_sendto, sc_args );
 #endif
 }
+
+int linux_setsockopt ( int fd, int level, int optname, const void *optval,
+		       socklen_t optlen ) {
+#ifdef __NR_setsockopt
+	return linux_syscall ( __NR_setsockopt, fd, level, optname,
+			       optval, optlen );
+#else
+#ifndef SOCKOP_setsockopt
+# define SOCKOP_setsockopt 14
+#endif
+	unsigned long sc_args[] = { fd, level, optname,
+				    (unsigned long)optval, optlen };
+	return linux_syscall ( __NR_socketcall, SOCKOP_setsockopt, sc_args );
+#endif
+}
+
+int linux_recvmmsg ( int fd, struct linux_mmsghdr *msgvec, unsigned int vlen,
+		     unsigned int flags, struct timespec *timeout ) {
+#ifdef __NR_recvmmsg
+	return linux_syscall ( __NR_recvmmsg, fd, msgvec, vlen, flags,
+			       timeout );
+#else
+#ifndef SOCKOP_recvmmsg
+# define SOCKOP_recvmmsg 19
+#endif
+	unsigned long sc_args[] = { fd, (unsigned long)msgvec, vlen,
+				    flags, (unsigned long)timeout };
+	return linux_syscall ( __NR_socketcall, SOCKOP_recvmmsg, sc_args );
+#endif
+}
+
+int linux_sendmmsg ( int fd, struct linux_mmsghdr *msgvec, unsigned int vlen,
+		     unsigned int flags ) {
+#ifdef __NR_sendmmsg
+	return linux_syscall ( __NR_sendmmsg, fd, msgvec, vlen, flags );
+#else
+#ifndef SOCKOP_sendmmsg
+# define SOCKOP_sendmmsg 20
+#endif
+	unsigned long sc_args[] = { fd, (unsigned long)msgvec, vlen, flags };
+	return linux_syscall ( __NR_socketcall, SOCKOP_sendmmsg, sc_args );
+#endif
+}
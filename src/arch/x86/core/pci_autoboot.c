@@ -27,6 +27,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stdint.h>
 #include <ipxe/device.h>
 #include <ipxe/init.h>
+#include <ipxe/pci.h>
 #include <realmode.h>
 #include <usr/autoboot.h>
 
@@ -38,8 +39,10 @@ uint16_t __bss16 ( autoboot_busdevfn );
  */
 static void pci_autoboot_init ( void ) {
 
-	if ( autoboot_busdevfn )
+	if ( autoboot_busdevfn ) {
 		set_autoboot_busloc ( BUS_TYPE_PCI, autoboot_busdevfn );
+		pci_prefer ( autoboot_busdevfn );
+	}
 }
 
 /** PCI autoboot device initialisation function */
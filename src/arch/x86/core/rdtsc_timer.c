@@ -38,6 +38,18 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Number of microseconds to use for TSC calibration */
 #define TSC_CALIBRATE_US 1024
 
+/** Minimum plausible reported TSC increment per microsecond */
+#define TSC_MIN_PER_US 100
+
+/** Maximum plausible reported TSC increment per microsecond */
+#define TSC_MAX_PER_US 10000
+
+/** Hypervisor signatures known to provide timing information */
+static const char *rdtsc_hypervisors[] = {
+	"VMwareVMware",
+	"KVMKVMKVM\0\0\0",
+};
+
 /** TSC increment per microsecond */
 static unsigned long tsc_per_us;
 
@@ -112,14 +124,130 @@ static void rdtsc_udelay ( unsigned long usecs ) {
 }
 
 /**
- * Probe RDTSC timer
+ * Get TSC frequency from hypervisor timing information
  *
- * @ret rc		Return status code
+ * @ret tsc_per_us	TSC increment per microsecond, or zero if unknown
  */
-static int rdtsc_probe ( void ) {
+static unsigned long rdtsc_hypervisor_frequency ( void ) {
+	union {
+		uint32_t dword[3];
+		char text[12];
+	} signature;
+	uint32_t features;
+	uint32_t max_function;
+	uint32_t tsc_khz;
+	unsigned int i;
+	uint32_t discard_a;
+	uint32_t discard_b;
+	uint32_t discard_c;
+	uint32_t discard_d;
+
+	/* Check for presence of a hypervisor */
+	cpuid ( CPUID_FEATURES, &discard_a, &discard_b, &features,
+		&discard_d );
+	if ( ! ( features & CPUID_FEATURES_INTEL_ECX_HYPERVISOR ) )
+		return 0;
+
+	/* Check that hypervisor is known to define the timing
+	 * information function, since the meaning of hypervisor
+	 * functions is vendor-specific.
+	 */
+	cpuid ( CPUID_HYPERVISOR_MAX_FN, &max_function, &signature.dword[0],
+		&signature.dword[1], &signature.dword[2] );
+	for ( i = 0 ; i < ( sizeof ( rdtsc_hypervisors ) /
+			    sizeof ( rdtsc_hypervisors[0] ) ) ; i++ ) {
+		if ( memcmp ( signature.text, rdtsc_hypervisors[i],
+			      sizeof ( signature.text ) ) == 0 )
+			break;
+	}
+	if ( i == ( sizeof ( rdtsc_hypervisors ) /
+		    sizeof ( rdtsc_hypervisors[0] ) ) ) {
+		DBGC ( colour, "RDTSC ignoring unknown hypervisor "
+		       "\"%.12s\"\n", signature.text );
+		return 0;
+	}
+
+	/* Check that timing information function is supported */
+	if ( ( ( max_function & CPUID_HYPERVISOR_CHECK_MASK ) !=
+	       ( CPUID_HYPERVISOR_MAX_FN & CPUID_HYPERVISOR_CHECK_MASK ) ) ||
+	     ( max_function < CPUID_HYPERVISOR_TIMING ) )
+		return 0;
+
+	/* Get TSC frequency (in kHz) */
+	cpuid ( CPUID_HYPERVISOR_TIMING, &tsc_khz, &discard_b, &discard_c,
+		&discard_d );
+	DBGC ( colour, "RDTSC hypervisor \"%.12s\" reports %d kHz TSC\n",
+	       signature.text, tsc_khz );
+
+	/* Ignore implausible values */
+	if ( ( tsc_khz < ( TSC_MIN_PER_US * 1000 ) ) ||
+	     ( tsc_khz > ( TSC_MAX_PER_US * 1000 ) ) ) {
+		DBGC ( colour, "RDTSC ignoring implausible hypervisor TSC "
+		       "frequency\n" );
+		return 0;
+	}
+
+	return ( tsc_khz / 1000 );
+}
+
+/**
+ * Get TSC frequency from processor frequency information
+ *
+ * @ret tsc_per_us	TSC increment per microsecond, or zero if unknown
+ */
+static unsigned long rdtsc_cpuid_frequency ( void ) {
+	uint32_t denominator;
+	uint32_t numerator;
+	uint32_t crystal_hz;
+	uint32_t base_mhz;
+	uint32_t discard_b;
+	uint32_t discard_c;
+	uint32_t discard_d;
+
+	/* Use TSC to core crystal clock ratio, if available */
+	if ( cpuid_supported ( CPUID_TSC_RATIO ) != 0 )
+		return 0;
+	cpuid ( CPUID_TSC_RATIO, &denominator, &numerator, &crystal_hz,
+		&discard_d );
+	if ( denominator && numerator && crystal_hz ) {
+		DBGC ( colour, "RDTSC has %d Hz crystal with TSC ratio "
+		       "%d/%d\n", crystal_hz, numerator, denominator );
+		return ( ( ( crystal_hz / 1000 ) * numerator ) /
+			 ( denominator * 1000 ) );
+	}
+
+	/* Otherwise, use processor base frequency, if available */
+	if ( cpuid_supported ( CPUID_FREQUENCY ) != 0 )
+		return 0;
+	cpuid ( CPUID_FREQUENCY, &base_mhz, &discard_b, &discard_c,
+		&discard_d );
+	DBGC ( colour, "RDTSC has %d MHz base frequency\n", base_mhz );
+	return base_mhz;
+}
+
+/**
+ * Calibrate TSC frequency via 8254 PIT
+ *
+ * @ret tsc_per_us	TSC increment per microsecond
+ */
+static unsigned long rdtsc_calibrate ( void ) {
 	unsigned long before;
 	unsigned long after;
 	unsigned long elapsed;
+
+	before = rdtsc_raw();
+	pit8254_udelay ( TSC_CALIBRATE_US );
+	after = rdtsc_raw();
+	elapsed = ( after - before );
+	return ( elapsed / TSC_CALIBRATE_US );
+}
+
+/**
+ * Probe RDTSC timer
+ *
+ * @ret rc		Return status code
+ */
+static int rdtsc_probe ( void ) {
 	uint32_t apm;
 	uint32_t discard_a;
 	uint32_t discard_b;
@@ -139,12 +267,15 @@ static int rdtsc_probe ( void ) {
 		return -ENOTTY;
 	}
 
-	/* Calibrate udelay() timer via 8254 PIT */
-	before = rdtsc_raw();
-	pit8254_udelay ( TSC_CALIBRATE_US );
-	after = rdtsc_raw();
-	elapsed = ( after - before );
-	tsc_per_us = ( elapsed / TSC_CALIBRATE_US );
+	/* Determine udelay() timer frequency, avoiding the need for
+	 * calibration via the 8254 PIT if the frequency is reported
+	 * by the hypervisor or the CPU.
+	 */
+	tsc_per_us = rdtsc_hypervisor_frequency();
+	if ( ! tsc_per_us )
+		tsc_per_us = rdtsc_cpuid_frequency();
+	if ( ! tsc_per_us )
+		tsc_per_us = rdtsc_calibrate();
 	if ( ! tsc_per_us ) {
 		DBGC ( colour, "RDTSC has zero TSC per microsecond\n" );
 		return -EIO;
@@ -0,0 +1,168 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <byteswap.h>
+#include <ipxe/sha1.h>
+#include <ipxe/cpuid.h>
+#include <ipxe/sse.h>
+
+/** @file
+ *
+ * SHA-NI accelerated SHA-1
+ *
+ * The message schedule is expanded into a buffer on the stack, since
+ * there are too few usable SSE registers to hold it.
+ *
+ * The SHA-1 instructions expect each group of four message words to
+ * be held with the first word in the most significant dword.  The
+ * message schedule is stored in this reversed form.
+ */
+
+/** Number of SHA-1 rounds */
+#define SHA1NI_ROUNDS 80
+
+/**
+ * Perform groups of four rounds
+ *
+ * @v func		Round function selector
+ * @v count		Number of groups
+ */
+#define SHA1NI_GROUPS( func, count )					\
+	"mov $" #count ", %1\n\t"					\
+	"\n1:\n\t"							\
+	"movdqu (%0), %%xmm0\n\t"					\
+	"sha1nexte %%xmm0, %%xmm2\n\t"					\
+	"movdqa %%xmm1, %%xmm3\n\t"					\
+	"sha1rnds4 $" #func ", %%xmm2, %%xmm1\n\t"			\
+	"movdqa %%xmm3, %%xmm2\n\t"					\
+	"add $16, %0\n\t"						\
+	"dec %1\n\t"							\
+	"jnz 1b\n\t"
+
+/** Byte shuffle mask to reverse a block of four big-endian dwords */
+static const uint8_t sha1ni_reverse[16] = {
+	0x0f, 0x0e, 0x0d, 0x0c, 0x0b, 0x0a, 0x09, 0x08,
+	0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01, 0x00,
+};
+
+/**
+ * Check if SHA-NI is supported
+ *
+ * @ret supported	SHA-NI is supported
+ */
+static int sha1ni_supported ( void ) {
+	uint32_t discard_a;
+	uint32_t ebx;
+	uint32_t discard_c;
+	uint32_t discard_d;
+
+	/* Check for SHA instructions */
+	if ( cpuid_supported ( CPUID_STRUCTURED_FEATURES ) != 0 )
+		return 0;
+	cpuid ( CPUID_STRUCTURED_FEATURES, &discard_a, &ebx, &discard_c,
+		&discard_d );
+	return ( !! ( ebx & CPUID_STRUCTURED_FEATURES_EBX_SHA ) );
+}
+
+/**
+ * Digest single block
+ *
+ * @v digest		Digest to update (in big-endian form)
+ * @v data		Data block
+ */
+static void sha1ni_digest ( struct sha1_digest *digest,
+			    const union sha1_block *data ) {
+	uint32_t w[SHA1NI_ROUNDS];
+	uint32_t *next = w;
+	uint32_t e = be32_to_cpu ( digest->h[4] );
+	unsigned int count;
+	unsigned int i;
+
+	/* Convert data block to reversed host-endian w[0..15] */
+	for ( i = 0 ; i < 16 ; i += 4 ) {
+		__asm__ __volatile__ ( "movdqu (%0), %%xmm3\n\t"
+				       "movdqu (%1), %%xmm4\n\t"
+				       "pshufb %%xmm3, %%xmm4\n\t"
+				       "movdqu %%xmm4, (%2)\n\t"
+				       : : "r" ( sha1ni_reverse ),
+					   "r" ( &data->dword[i] ),
+					   "r" ( &w[i] )
+				       : SSE_CLOBBERS "memory" );
+	}
+
+	/* Calculate w[16..79] */
+	for ( ; i < SHA1NI_ROUNDS ; i += 4 ) {
+		__asm__ __volatile__ ( "movdqu -64(%0), %%xmm3\n\t"
+				       "movdqu -48(%0), %%xmm4\n\t"
+				       "sha1msg1 %%xmm4, %%xmm3\n\t"
+				       "movdqu -32(%0), %%xmm4\n\t"
+				       "pxor %%xmm4, %%xmm3\n\t"
+				       "movdqu -16(%0), %%xmm4\n\t"
+				       "sha1msg2 %%xmm4, %%xmm3\n\t"
+				       "movdqu %%xmm3, (%0)\n\t"
+				       : : "r" ( &w[i] )
+				       : SSE_CLOBBERS "memory" );
+	}
+
+	/* Perform rounds, four at a time.  The digest is held as
+	 * (a,b,c,d) in %xmm1, with e (or the value of (a,b,c,d)
+	 * from which e is derived) in %xmm2.  The original values are
+	 * saved in %xmm4 and %xmm5.
+	 */
+	__asm__ __volatile__ ( "movdqu (%4), %%xmm3\n\t"
+			       "movdqu (%3), %%xmm1\n\t"
+			       "pshufb %%xmm3, %%xmm1\n\t"
+			       "movd %2, %%xmm2\n\t"
+			       "pslldq $12, %%xmm2\n\t"
+			       "movdqa %%xmm1, %%xmm4\n\t"
+			       "movdqa %%xmm2, %%xmm5\n\t"
+			       "movdqu (%0), %%xmm0\n\t"
+			       "paddd %%xmm0, %%xmm2\n\t"
+			       "movdqa %%xmm1, %%xmm3\n\t"
+			       "sha1rnds4 $0, %%xmm2, %%xmm1\n\t"
+			       "movdqa %%xmm3, %%xmm2\n\t"
+			       "add $16, %0\n\t"
+			       SHA1NI_GROUPS ( 0, 4 )
+			       SHA1NI_GROUPS ( 1, 5 )
+			       SHA1NI_GROUPS ( 2, 5 )
+			       SHA1NI_GROUPS ( 3, 5 )
+			       "sha1nexte %%xmm5, %%xmm2\n\t"
+			       "paddd %%xmm4, %%xmm1\n\t"
+			       "movdqu (%4), %%xmm3\n\t"
+			       "pshufb %%xmm3, %%xmm1\n\t"
+			       "movdqu %%xmm1, (%3)\n\t"
+			       "psrldq $12, %%xmm2\n\t"
+			       "movd %%xmm2, %2\n\t"
+			       : "+r" ( next ), "=&r" ( count ), "+r" ( e )
+			       : "r" ( digest ), "r" ( sha1ni_reverse )
+			       : SSE_CLOBBERS "memory" );
+	digest->h[4] = cpu_to_be32 ( e );
+}
+
+/** SHA-NI SHA-1 accelerator */
+struct sha1_accelerator sha1ni_accelerator __sha1_accelerator = {
+	.name = "SHA-NI",
+	.supported = sha1ni_supported,
+	.digest = sha1ni_digest,
+};
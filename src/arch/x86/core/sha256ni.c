@@ -0,0 +1,152 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <ipxe/sha256.h>
+#include <ipxe/cpuid.h>
+#include <ipxe/sse.h>
+
+/** @file
+ *
+ * SHA-NI accelerated SHA-256
+ *
+ * The 64-word message schedule does not fit within the usable SSE
+ * registers, and so is expanded into a buffer on the stack.
+ */
+
+/** Byte shuffle mask to convert big-endian dwords to host-endian */
+static const uint8_t sha256ni_bswap[16] = {
+	0x03, 0x02, 0x01, 0x00, 0x07, 0x06, 0x05, 0x04,
+	0x0b, 0x0a, 0x09, 0x08, 0x0f, 0x0e, 0x0d, 0x0c,
+};
+
+/**
+ * Check if SHA-NI is supported
+ *
+ * @ret supported	SHA-NI is supported
+ */
+static int sha256ni_supported ( void ) {
+	uint32_t discard_a;
+	uint32_t ebx;
+	uint32_t discard_c;
+	uint32_t discard_d;
+
+	/* Check for SHA instructions */
+	if ( cpuid_supported ( CPUID_STRUCTURED_FEATURES ) != 0 )
+		return 0;
+	cpuid ( CPUID_STRUCTURED_FEATURES, &discard_a, &ebx, &discard_c,
+		&discard_d );
+	return ( !! ( ebx & CPUID_STRUCTURED_FEATURES_EBX_SHA ) );
+}
+
+/**
+ * Digest single block
+ *
+ * @v digest		Digest to update (in big-endian form)
+ * @v data		Data block
+ */
+static void sha256ni_digest ( struct sha256_digest *digest,
+			      const union sha256_block *data ) {
+	uint32_t w[SHA256_ROUNDS];
+	const uint32_t *k = sha256_k;
+	uint32_t *next = w;
+	unsigned int count;
+	unsigned int i;
+
+	/* Convert data block to host-endian w[0..15] */
+	for ( i = 0 ; i < 16 ; i += 4 ) {
+		__asm__ __volatile__ ( "movdqu (%0), %%xmm3\n\t"
+				       "movdqu (%1), %%xmm4\n\t"
+				       "pshufb %%xmm3, %%xmm4\n\t"
+				       "movdqu %%xmm4, (%2)\n\t"
+				       : : "r" ( sha256ni_bswap ),
+					   "r" ( &data->dword[i] ),
+					   "r" ( &w[i] )
+				       : SSE_CLOBBERS "memory" );
+	}
+
+	/* Calculate w[16..63] */
+	for ( ; i < SHA256_ROUNDS ; i += 4 ) {
+		__asm__ __volatile__ ( "movdqu -64(%0), %%xmm3\n\t"
+				       "movdqu -48(%0), %%xmm4\n\t"
+				       "sha256msg1 %%xmm4, %%xmm3\n\t"
+				       "movdqu -28(%0), %%xmm4\n\t"
+				       "paddd %%xmm4, %%xmm3\n\t"
+				       "movdqu -16(%0), %%xmm4\n\t"
+				       "sha256msg2 %%xmm4, %%xmm3\n\t"
+				       "movdqu %%xmm3, (%0)\n\t"
+				       : : "r" ( &w[i] )
+				       : SSE_CLOBBERS "memory" );
+	}
+
+	/* Perform rounds, four at a time.  The digest is held as
+	 * (a,b,e,f) in %xmm1 and (c,d,g,h) in %xmm2, with the
+	 * original values saved in %xmm4 and %xmm5.
+	 */
+	count = ( SHA256_ROUNDS / 4 );
+	__asm__ __volatile__ ( "movdqu (%4), %%xmm3\n\t"
+			       "movdqu (%3), %%xmm1\n\t"
+			       "movdqu 16(%3), %%xmm2\n\t"
+			       "pshufb %%xmm3, %%xmm1\n\t"
+			       "pshufb %%xmm3, %%xmm2\n\t"
+			       "pshufd $0xb1, %%xmm1, %%xmm1\n\t"
+			       "pshufd $0x1b, %%xmm2, %%xmm2\n\t"
+			       "movdqa %%xmm1, %%xmm3\n\t"
+			       "palignr $8, %%xmm2, %%xmm1\n\t"
+			       "pblendw $0xf0, %%xmm3, %%xmm2\n\t"
+			       "movdqa %%xmm1, %%xmm4\n\t"
+			       "movdqa %%xmm2, %%xmm5\n\t"
+			       "\n1:\n\t"
+			       "movdqu (%0), %%xmm0\n\t"
+			       "movdqu (%1), %%xmm3\n\t"
+			       "paddd %%xmm3, %%xmm0\n\t"
+			       "sha256rnds2 %%xmm1, %%xmm2\n\t"
+			       "pshufd $0x0e, %%xmm0, %%xmm0\n\t"
+			       "sha256rnds2 %%xmm2, %%xmm1\n\t"
+			       "add $16, %0\n\t"
+			       "add $16, %1\n\t"
+			       "dec %2\n\t"
+			       "jnz 1b\n\t"
+			       "paddd %%xmm4, %%xmm1\n\t"
+			       "paddd %%xmm5, %%xmm2\n\t"
+			       "pshufd $0x1b, %%xmm1, %%xmm1\n\t"
+			       "pshufd $0xb1, %%xmm2, %%xmm2\n\t"
+			       "movdqa %%xmm1, %%xmm3\n\t"
+			       "pblendw $0xf0, %%xmm2, %%xmm1\n\t"
+			       "palignr $8, %%xmm3, %%xmm2\n\t"
+			       "movdqu (%4), %%xmm3\n\t"
+			       "pshufb %%xmm3, %%xmm1\n\t"
+			       "pshufb %%xmm3, %%xmm2\n\t"
+			       "movdqu %%xmm1, (%3)\n\t"
+			       "movdqu %%xmm2, 16(%3)\n\t"
+			       : "+r" ( k ), "+r" ( next ), "+r" ( count )
+			       : "r" ( digest ), "r" ( sha256ni_bswap )
+			       : SSE_CLOBBERS "memory" );
+}
+
+/** SHA-NI SHA-256 accelerator */
+struct sha256_accelerator sha256ni_accelerator __sha256_accelerator = {
+	.name = "SHA-NI",
+	.supported = sha256ni_supported,
+	.digest = sha256ni_digest,
+};
@@ -0,0 +1,147 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/cpuid.h>
+#include <ipxe/sse.h>
+
+/** @file
+ *
+ * SSE2 accelerated TCP/IP checksum
+ *
+ * Each 16-bit word is zero-extended into a 32-bit lane and summed
+ * using packed addition, deferring the end-around carry until the
+ * lanes are folded together.  The byte order of the words does not
+ * matter, since the one's complement sum is independent of byte
+ * order (and the existing checksum routine sums native-endian words
+ * in exactly the same way).
+ *
+ * Data is loaded using unaligned accesses, since I/O buffers have no
+ * particular alignment.
+ */
+
+/** Number of bytes summed by each iteration of the main loop */
+#define TCPIP_SSE2_STEP 32
+
+/** Maximum number of iterations before lanes must be folded
+ *
+ * Each iteration adds two 16-bit words to each 32-bit lane.
+ */
+#define TCPIP_SSE2_MAX_COUNT 0x7fff
+
+/**
+ * Check if SSE2 is supported
+ *
+ * @ret supported	SSE2 is supported
+ */
+static int tcpip_sse2_supported ( void ) {
+	struct x86_features features;
+
+	/* Check for SSE2 instructions */
+	x86_features ( &features );
+	return ( !! ( features.intel.edx & CPUID_FEATURES_INTEL_EDX_SSE2 ) );
+}
+
+/**
+ * Sum data into 32-bit lanes
+ *
+ * @v data		Data buffer
+ * @v count		Number of iterations (must be non-zero)
+ * @v lanes		Lanes to fill in
+ */
+static void tcpip_sse2_sum ( const void *data, unsigned int count,
+			     uint32_t *lanes ) {
+
+	__asm__ __volatile__ ( "pxor %%xmm0, %%xmm0\n\t"
+			       "pxor %%xmm1, %%xmm1\n\t"
+			       "pxor %%xmm2, %%xmm2\n\t"
+			       "\n1:\n\t"
+			       "movdqu (%0), %%xmm3\n\t"
+			       "movdqu 16(%0), %%xmm5\n\t"
+			       "movdqa %%xmm3, %%xmm4\n\t"
+			       "punpcklwd %%xmm0, %%xmm3\n\t"
+			       "punpckhwd %%xmm0, %%xmm4\n\t"
+			       "paddd %%xmm3, %%xmm1\n\t"
+			       "paddd %%xmm4, %%xmm2\n\t"
+			       "movdqa %%xmm5, %%xmm4\n\t"
+			       "punpcklwd %%xmm0, %%xmm5\n\t"
+			       "punpckhwd %%xmm0, %%xmm4\n\t"
+			       "paddd %%xmm5, %%xmm1\n\t"
+			       "paddd %%xmm4, %%xmm2\n\t"
+			       "add $32, %0\n\t"
+			       "dec %1\n\t"
+			       "jnz 1b\n\t"
+			       "movdqu %%xmm1, (%2)\n\t"
+			       "movdqu %%xmm2, 16(%2)\n\t"
+			       : "+r" ( data ), "+r" ( count )
+			       : "r" ( lanes )
+			       : SSE_CLOBBERS "memory" );
+}
+
+/**
+ * Calculate continued TCP/IP checksum
+ *
+ * @v partial		Checksum of already-summed data
+ * @v data		Data buffer
+ * @v len		Length of data buffer
+ * @ret cksum		Updated checksum
+ */
+static uint16_t tcpip_sse2_chksum ( uint16_t partial, const void *data,
+				    size_t len ) {
+	uint64_t sum = ( ( ~partial ) & 0xffff );
+	uint32_t lanes[8];
+	unsigned int count;
+	unsigned int i;
+
+	/* Sum whole iterations, folding lanes before they can overflow */
+	while ( len >= TCPIP_SSE2_STEP ) {
+		count = ( len / TCPIP_SSE2_STEP );
+		if ( count > TCPIP_SSE2_MAX_COUNT )
+			count = TCPIP_SSE2_MAX_COUNT;
+		tcpip_sse2_sum ( data, count, lanes );
+		for ( i = 0 ; i < ( sizeof ( lanes ) /
+				    sizeof ( lanes[0] ) ) ; i++ ) {
+			sum += lanes[i];
+		}
+		data += ( count * TCPIP_SSE2_STEP );
+		len -= ( count * TCPIP_SSE2_STEP );
+	}
+
+	/* Fold down to a uint16_t */
+	while ( sum >> 16 )
+		sum = ( ( sum & 0xffff ) + ( sum >> 16 ) );
+
+	/* Sum any remaining data.  This starts at an even offset, and
+	 * is too short to be accelerated.
+	 */
+	return tcpip_continue_chksum ( ( ~sum & 0xffff ), data, len );
+}
+
+/** SSE2 accelerated TCP/IP checksum */
+struct tcpip_chksum_accelerator tcpip_sse2 __tcpip_chksum_accelerator = {
+	.name = "sse2",
+	.min_len = 128,
+	.supported = tcpip_sse2_supported,
+	.chksum = tcpip_sse2_chksum,
+};
@@ -30,8 +30,139 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** @file
  *
  * Big integer support
+ *
+ * All multiplication is performed as a sequence of single-row
+ * multiply-and-accumulate operations.  Each row executes the same
+ * instruction sequence regardless of the values involved, so that
+ * the time taken depends only upon the sizes of the operands.
+ *
+ * On x86_64, pairs of 32-bit elements are processed as single 64-bit
+ * limbs, which quarters the number of multiplications required for a
+ * full multiply and halves the number required for each row of a
+ * Montgomery reduction.
  */
 
+#ifdef __x86_64__
+
+/** A 64-bit limb (which may alias a pair of 32-bit elements) */
+typedef uint64_t __attribute__ (( may_alias )) x86_64_limb_t;
+
+/**
+ * Multiply 64-bit limbs by a single limb and accumulate
+ *
+ * @v multiplicand	Limb 0 of big integer to be multiplied
+ * @v multiplier	Limb by which to multiply
+ * @v value		Limb 0 of big integer to be added to
+ * @v count		Number of limbs (must be non-zero)
+ * @ret carry		Carry out of most significant limb
+ */
+static uint64_t x86_64_multiply_accumulate ( const x86_64_limb_t *multiplicand,
+					     uint64_t multiplier,
+					     x86_64_limb_t *value,
+					     unsigned int count ) {
+	uint64_t carry = 0;
+	uint64_t discard_a;
+	uint64_t discard_d;
+	long index;
+
+	/* Perform a single multiply for each limb, adding in the
+	 * existing value limb and the carry from the previous limb.
+	 * The carry cannot overflow, since:
+	 *
+	 *     a < 2^{n}, b < 2^{n}, c < 2^{n}, d < 2^{n}
+	 *       => ab + c + d < 2^{2n}
+	 *
+	 * The index counts upwards from -count to zero, so that the
+	 * loop requires only a single flag-setting instruction.
+	 */
+	__asm__ __volatile__ ( "\n1:\n\t"
+			       "movq (%5,%2,8), %%rax\n\t"
+			       "mulq %4\n\t"
+			       "addq (%6,%2,8), %%rax\n\t"
+			       "adcq $0, %%rdx\n\t"
+			       "addq %3, %%rax\n\t"
+			       "adcq $0, %%rdx\n\t"
+			       "movq %%rax, (%6,%2,8)\n\t"
+			       "movq %%rdx, %3\n\t"
+			       "incq %2\n\t"
+			       "jnz 1b\n\t"
+			       : "=&a" ( discard_a ), "=&d" ( discard_d ),
+				 "=&r" ( index ), "+r" ( carry )
+			       : "r" ( multiplier ),
+				 "r" ( multiplicand + count ),
+				 "r" ( value + count ),
+				 "2" ( -( ( long ) count ) )
+			       : "memory" );
+
+	return carry;
+}
+
+#endif /* __x86_64__ */
+
+/**
+ * Multiply big integer by a single element and accumulate
+ *
+ * @v multiplicand0	Element 0 of big integer to be multiplied
+ * @v multiplier	Element by which to multiply
+ * @v value0		Element 0 of big integer to be added to
+ * @v size		Number of elements
+ * @ret carry		Carry out of most significant element
+ */
+uint32_t bigint_multiply_accumulate_raw ( const uint32_t *multiplicand0,
+					  uint32_t multiplier,
+					  uint32_t *value0,
+					  unsigned int size ) {
+	uint32_t carry = 0;
+	void *discard_S;
+	void *discard_D;
+	long discard_c;
+
+#ifdef __x86_64__
+	/* Process pairs of elements as 64-bit limbs.  Since the
+	 * multiplier is less than 2^{32}, the carry out of each limb
+	 * is also less than 2^{32}, and so may be carried into a
+	 * trailing 32-bit element.
+	 */
+	if ( size >= 2 ) {
+		carry = x86_64_multiply_accumulate ( ( ( const void * )
+						       multiplicand0 ),
+						     multiplier,
+						     ( ( void * ) value0 ),
+						     ( size / 2 ) );
+		if ( ! ( size & 1 ) )
+			return carry;
+		multiplicand0 += ( size & ~1U );
+		value0 += ( size & ~1U );
+		size = 1;
+	}
+#endif
+
+	/* Perform a single multiply for each element, adding in the
+	 * existing value element and the carry from the previous
+	 * element.  The carry cannot overflow, since:
+	 *
+	 *     a < 2^{n}, b < 2^{n}, c < 2^{n}, d < 2^{n}
+	 *       => ab + c + d < 2^{2n}
+	 */
+	__asm__ __volatile__ ( "\n1:\n\t"
+			       "lodsl\n\t"
+			       "mull %4\n\t"
+			       "addl (%1), %%eax\n\t"
+			       "adcl $0, %%edx\n\t"
+			       "addl %3, %%eax\n\t"
+			       "adcl $0, %%edx\n\t"
+			       "stosl\n\t"
+			       "movl %%edx, %3\n\t"
+			       "loop 1b\n\t"
+			       : "=&S" ( discard_S ), "=&D" ( discard_D ),
+				 "=&c" ( discard_c ), "+r" ( carry )
+			       : "rm" ( multiplier ), "0" ( multiplicand0 ),
+				 "1" ( value0 ), "2" ( size )
+			       : "eax", "edx", "memory" );
+
+	return carry;
+}
+
 /**
  * Multiply big integers
  *
@@ -50,46 +181,39 @@ void bigint_multiply_raw ( const uint32_t *multiplicand0,
 	bigint_t ( size * 2 ) __attribute__ (( may_alias )) *result =
 		( ( void * ) result0 );
 	unsigned int i;
-	unsigned int j;
-	uint32_t multiplicand_element;
-	uint32_t multiplier_element;
-	uint32_t *result_elements;
-	uint32_t discard_a;
-	uint32_t discard_d;
-	long index;
 
 	/* Zero result */
 	memset ( result, 0, sizeof ( *result ) );
 
-	/* Multiply integers one element at a time */
-	for ( i = 0 ; i < size ; i++ ) {
-		multiplicand_element = multiplicand->element[i];
-		for ( j = 0 ; j < size ; j++ ) {
-			multiplier_element = multiplier->element[j];
-			result_elements = &result->element[ i + j ];
-			/* Perform a single multiply, and add the
-			 * resulting double-element into the result,
-			 * carrying as necessary.  The carry can
-			 * never overflow beyond the end of the
-			 * result, since:
-			 *
-			 *     a < 2^{n}, b < 2^{n} => ab < 2^{2n}
-			 */
-			__asm__ __volatile__ ( "mull %4\n\t"
-					       "addl %%eax, (%5,%2,4)\n\t"
-					       "adcl %%edx, 4(%5,%2,4)\n\t"
-					       "\n1:\n\t"
-					       "adcl $0, 8(%5,%2,4)\n\t"
-					       "inc %2\n\t"
-						       /* Does not affect CF */
-					       "jc 1b\n\t"
-					       : "=&a" ( discard_a ),
-						 "=&d" ( discard_d ),
-						 "=&r" ( index )
-					       : "0" ( multiplicand_element ),
-						 "g" ( multiplier_element ),
-						 "r" ( result_elements ),
-						 "2" ( 0 ) );
+	/* Multiply by each multiplier element in turn, accumulating
+	 * into the corresponding row of the result.  The carry out of
+	 * each row lands in an element that has not yet been
+	 * touched, and so can be stored directly.
+	 */
+#ifdef __x86_64__
+	if ( ! ( size & 1 ) ) {
+		const x86_64_limb_t *multiplicand64 =
+			( ( const void * ) multiplicand->element );
+		const x86_64_limb_t *multiplier64 =
+			( ( const void * ) multiplier->element );
+		x86_64_limb_t *result64 = ( ( void * ) result->element );
+		unsigned int count = ( size / 2 );
+
+		for ( i = 0 ; i < count ; i++ ) {
+			result64[ i + count ] =
+				x86_64_multiply_accumulate ( multiplicand64,
+							     multiplier64[i],
+							     &result64[i],
+							     count );
 		}
+		return;
+	}
+#endif
+	for ( i = 0 ; i < size ; i++ ) {
+		result->element[ i + size ] =
+			bigint_multiply_accumulate_raw ( multiplicand->element,
+							 multiplier->element[i],
+							 &result->element[i],
+							 size );
 	}
 }
@@ -30,6 +30,160 @@
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <string.h>
+#include <ipxe/init.h>
+#include <ipxe/cpuid.h>
+
+#ifdef __x86_64__
+
+/** Minimum length for which to use "rep movsb" on ERMS-capable CPUs
+ *
+ * CPUs with Enhanced REP MOVSB/STOSB (ERMS) support will internally
+ * use the widest available transfers for "rep movsb", which then
+ * outperforms any explicit sequence for all but the shortest copies.
+ */
+#define X86_ERMS_MIN_LEN 256
+
+/** CPU supports Enhanced REP MOVSB/STOSB */
+static int x86_erms;
+
+/**
+ * Copy memory area
+ *
+ * @v dest		Destination address
+ * @v src		Source address
+ * @v len		Length
+ * @ret dest		Destination address
+ */
+void * __attribute__ (( noinline )) __memcpy ( void *dest, const void *src,
+					       size_t len ) {
+	void *rdi = dest;
+	const void *rsi = src;
+	unsigned long discard_rcx;
+
+	/* Use a single "rep movsb" for large copies, if supported */
+	if ( x86_erms && ( len >= X86_ERMS_MIN_LEN ) ) {
+		__asm__ __volatile__ ( "rep movsb"
+				       : "=&D" ( rdi ), "=&S" ( rsi ),
+					 "=&c" ( discard_rcx )
+				       : "0" ( rdi ), "1" ( rsi ), "2" ( len )
+				       : "memory" );
+		return dest;
+	}
+
+	/* Otherwise, move qwords and then any trailing bytes */
+	__asm__ __volatile__ ( "rep movsq"
+			       : "=&D" ( rdi ), "=&S" ( rsi ),
+				 "=&c" ( discard_rcx )
+			       : "0" ( rdi ), "1" ( rsi ), "2" ( len >> 3 )
+			       : "memory" );
+	__asm__ __volatile__ ( "rep movsb"
+			       : "=&D" ( rdi ), "=&S" ( rsi ),
+				 "=&c" ( discard_rcx )
+			       : "0" ( rdi ), "1" ( rsi ), "2" ( len & 7 )
+			       : "memory" );
+	return dest;
+}
+
+/**
+ * Copy memory area backwards
+ *
+ * @v dest		Destination address
+ * @v src		Source address
+ * @v len		Length
+ * @ret dest		Destination address
+ */
+void * __attribute__ (( noinline )) __memcpy_reverse ( void *dest,
+						       const void *src,
+						       size_t len ) {
+	void *rdi = ( dest + len - 8 );
+	const void *rsi = ( src + len - 8 );
+	unsigned long discard_rcx;
+
+	/* Move qwords downwards from the end of the area, and then
+	 * any leading bytes.  There is no fast-string support for
+	 * descending copies, so this is substantially faster than a
+	 * bytewise copy.
+	 */
+	__asm__ __volatile__ ( "std\n\t"
+			       "rep movsq\n\t"
+			       "addq $7, %%rdi\n\t"
+			       "addq $7, %%rsi\n\t"
+			       "movq %6, %%rcx\n\t"
+			       "rep movsb\n\t"
+			       "cld\n\t"
+			       : "=&D" ( rdi ), "=&S" ( rsi ),
+				 "=&c" ( discard_rcx )
+			       : "0" ( rdi ), "1" ( rsi ), "2" ( len >> 3 ),
+				 "g" ( len & 7 )
+			       : "memory" );
+	return dest;
+}
+
+/**
+ * Fill memory region
+ *
+ * @v dest		Destination address
+ * @v fill		Fill pattern
+ * @v len		Length
+ * @ret dest		Destination address
+ */
+void * __attribute__ (( noinline )) __memset ( void *dest, int fill,
+					       size_t len ) {
+	uint64_t pattern = ( ( fill & 0xff ) * 0x0101010101010101ULL );
+	void *rdi = dest;
+	unsigned long discard_rcx;
+
+	/* Use a single "rep stosb" for large fills, if supported */
+	if ( x86_erms && ( len >= X86_ERMS_MIN_LEN ) ) {
+		__asm__ __volatile__ ( "rep stosb"
+				       : "=&D" ( rdi ), "=&c" ( discard_rcx )
+				       : "0" ( rdi ), "1" ( len ),
+					 "a" ( pattern )
+				       : "memory" );
+		return dest;
+	}
+
+	/* Otherwise, store qwords and then any trailing bytes.  This
+	 * matters mainly for large fills such as zeroing the BSS
+	 * portion of a loaded image segment.
+	 */
+	__asm__ __volatile__ ( "rep stosq"
+			       : "=&D" ( rdi ), "=&c" ( discard_rcx )
+			       : "0" ( rdi ), "1" ( len >> 3 ),
+				 "a" ( pattern )
+			       : "memory" );
+	__asm__ __volatile__ ( "rep stosb"
+			       : "=&D" ( rdi ), "=&c" ( discard_rcx )
+			       : "0" ( rdi ), "1" ( len & 7 ),
+				 "a" ( pattern )
+			       : "memory" );
+	return dest;
+}
+
+/**
+ * Detect optimised string operation support
+ *
+ */
+static void x86_string_init ( void ) {
+	uint32_t discard_a;
+	uint32_t ebx;
+	uint32_t discard_c;
+	uint32_t discard_d;
+
+	/* Check for Enhanced REP MOVSB/STOSB */
+	if ( cpuid_supported ( CPUID_STRUCTURED_FEATURES ) != 0 )
+		return;
+	cpuid ( CPUID_STRUCTURED_FEATURES, &discard_a, &ebx, &discard_c,
+		&discard_d );
+	x86_erms = ( !! ( ebx & CPUID_STRUCTURED_FEATURES_EBX_ERMS ) );
+}
+
+/** Optimised string operation initialisation function */
+struct init_fn x86_string_init_fn __init_fn ( INIT_EARLY ) = {
+	.initialise = x86_string_init,
+};
+
+#else /* __x86_64__ */
 
 /**
  * Copy memory area
@@ -73,24 +227,57 @@ void * __attribute__ (( noinline )) __memcpy ( void *dest, const void *src,
 void * __attribute__ (( noinline )) __memcpy_reverse ( void *dest,
 						       const void *src,
 						       size_t len ) {
-	void *edi = ( dest + len - 1 );
-	const void *esi = ( src + len - 1 );
+	void *edi = ( dest + len - 4 );
+	const void *esi = ( src + len - 4 );
 	int discard_ecx;
 
-	/* Assume memmove() is not performance-critical, and perform a
-	 * bytewise copy for simplicity.
+	/* Move dwords downwards from the end of the area, and then
+	 * any leading bytes.
 	 */
 	__asm__ __volatile__ ( "std\n\t"
+			       "rep movsl\n\t"
+			       "addl $3, %%edi\n\t"
+			       "addl $3, %%esi\n\t"
+			       "movl %6, %%ecx\n\t"
 			       "rep movsb\n\t"
 			       "cld\n\t"
 			       : "=&D" ( edi ), "=&S" ( esi ),
 				 "=&c" ( discard_ecx )
-			       : "0" ( edi ), "1" ( esi ),
-				 "2" ( len )
+			       : "0" ( edi ), "1" ( esi ), "2" ( len >> 2 ),
+				 "g" ( len & 3 )
+			       : "memory" );
+	return dest;
+}
+
+/**
+ * Fill memory region
+ *
+ * @v dest		Destination address
+ * @v fill		Fill pattern
+ * @v len		Length
+ * @ret dest		Destination address
+ */
+void * __attribute__ (( noinline )) __memset ( void *dest, int fill,
+					       size_t len ) {
+	uint32_t pattern = ( ( fill & 0xff ) * 0x01010101UL );
+	void *edi = dest;
+	int discard_ecx;
+
+	/* Store dwords and then any trailing bytes */
+	__asm__ __volatile__ ( "rep stosl"
+			       : "=&D" ( edi ), "=&c" ( discard_ecx )
+			       : "0" ( edi ), "1" ( len >> 2 ),
+				 "a" ( pattern )
+			       : "memory" );
+	__asm__ __volatile__ ( "rep stosb"
+			       : "=&D" ( edi ), "=&c" ( discard_ecx )
+			       : "0" ( edi ), "1" ( len & 3 ),
+				 "a" ( pattern )
 			       : "memory" );
 	return dest;
 }
 
+#endif /* __x86_64__ */
 
 /**
  * Copy (possibly overlapping) memory area
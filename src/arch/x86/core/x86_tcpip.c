@@ -45,6 +45,7 @@ extern char x86_tcpip_loop_end[];
 uint16_t tcpip_continue_chksum ( uint16_t partial, const void *data,
 				 size_t len ) {
 	unsigned long sum = ( ( ~partial ) & 0xffff );
+	struct tcpip_chksum_accelerator *accel;
 	unsigned long initial_word_count;
 	unsigned long loop_count;
 	unsigned long loop_partial_count;
@@ -56,6 +57,11 @@ uint16_t tcpip_continue_chksum ( uint16_t partial, const void *data,
 	unsigned long discard_r1;
 	unsigned long discard_r2;
 
+	/* Use accelerated implementation, if available and worthwhile */
+	accel = tcpip_chksum_accelerator();
+	if ( accel && ( len >= accel->min_len ) )
+		return accel->chksum ( partial, data, len );
+
 	/* Calculate number of initial 16-bit words required to bring
 	 * the main loop into alignment.  (We don't care about the
 	 * speed for data aligned to less than 16 bits, since this
@@ -171,3 +177,7 @@ uint16_t tcpip_continue_chksum ( uint16_t partial, const void *data,
 
 	return ( ~sum & 0xffff );
 }
+
+/* Drag in TCP/IP checksum accelerators */
+REQUIRING_SYMBOL ( tcpip_continue_chksum );
+REQUIRE_OBJECT ( config_tcpip );
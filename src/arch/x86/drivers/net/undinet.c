@@ -72,8 +72,15 @@ struct undi_nic {
 /** Delay between retries of PXENV_UNDI_INITIALIZE */
 #define UNDI_INITIALIZE_RETRY_DELAY_MS 200
 
-/** Maximum number of received packets per poll */
-#define UNDI_RX_QUOTA 4
+/** Maximum number of received packets per poll
+ *
+ * Once the ISR has been triggered, frames are retrieved using
+ * PXENV_UNDI_ISR_IN_GET_NEXT until the PXE stack reports that
+ * processing is complete.  A larger quota allows a burst of received
+ * frames to be drained within a single poll, rather than waiting for
+ * a further interrupt (or poll) for each group of frames.
+ */
+#define UNDI_RX_QUOTA 16
 
 /** Alignment of received frame payload */
 #define UNDI_RX_ALIGN 16
@@ -500,13 +500,49 @@ static void bzimage_load_initrds ( struct image *image,
 	struct image *initrd;
 	struct image *highest = NULL;
 	struct image *other;
+	userptr_t bottom;
 	userptr_t top;
 	userptr_t dest;
 	size_t offset;
 	size_t len;
 
-	/* Reshuffle initrds into desired order */
-	initrd_reshuffle ( userptr_add ( bzimg->pm_kernel, bzimg->pm_sz ) );
+	/* Calculate total loaded length of initrds */
+	len = 0;
+	for_each_image ( initrd ) {
+		len += bzimage_load_initrd ( image, initrd, UNULL );
+		len = bzimage_align ( len );
+	}
+
+	/* Do nothing if there are no initrds */
+	if ( ! len )
+		return;
+
+	/* Copy initrds directly to their final locations, if there
+	 * is a free region large enough to hold them all.  This
+	 * avoids the need to reshuffle, and so copies each initrd
+	 * exactly once.
+	 */
+	bottom = userptr_add ( bzimg->pm_kernel, bzimg->pm_sz );
+	dest = initrd_region ( len, bottom, bzimg->mem_limit );
+	if ( dest ) {
+		DBGC ( image, "bzImage %p loading initrds directly from "
+		       "%#08lx upwards\n", image, user_to_phys ( dest, 0 ) );
+		bzimg->ramdisk_image = user_to_phys ( dest, 0 );
+		offset = 0;
+		for_each_image ( initrd ) {
+			len = bzimage_load_initrd ( image, initrd,
+						    userptr_add ( dest, offset ) );
+			bzimg->ramdisk_size = ( offset + len );
+			offset = bzimage_align ( offset + len );
+		}
+		DBGC ( image, "bzImage %p initrds at [%#08lx,%#08lx)\n",
+		       image, bzimg->ramdisk_image,
+		       ( bzimg->ramdisk_image + bzimg->ramdisk_size ) );
+		return;
+	}
+
+	/* Otherwise, reshuffle initrds into desired order */
+	initrd_reshuffle ( bottom );
 
 	/* Find highest initrd */
 	for_each_image ( initrd ) {
@@ -28,6 +28,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/image.h>
 #include <ipxe/uaccess.h>
 #include <ipxe/init.h>
+#include <ipxe/timer.h>
 #include <ipxe/memblock.h>
 
 /** @file
@@ -80,8 +81,11 @@ static userptr_t initrd_squash_high ( userptr_t top ) {
 		       user_to_phys ( highest->data, highest->len ),
 		       user_to_phys ( current, 0 ),
 		       user_to_phys ( current, highest->len ) );
-		memmove_user ( current, 0, highest->data, 0, highest->len );
-		highest->data = current;
+		if ( highest->data != current ) {
+			memmove_user ( current, 0, highest->data, 0,
+				       highest->len );
+			highest->data = current;
+		}
 	}
 
 	/* Copy any remaining initrds (e.g. embedded images) to the region */
@@ -106,92 +110,141 @@ static userptr_t initrd_squash_high ( userptr_t top ) {
 }
 
 /**
- * Swap position of two adjacent initrds
+ * Exchange contents of two equal-length non-overlapping regions
  *
- * @v low		Lower initrd
- * @v high		Higher initrd
+ * @v first		First region
+ * @v second		Second region
+ * @v len		Length of each region
  * @v free		Free space
  * @v free_len		Length of free space
  */
-static void initrd_swap ( struct image *low, struct image *high,
-			  userptr_t free, size_t free_len ) {
-	size_t len = 0;
+static void initrd_exchange ( userptr_t first, userptr_t second, size_t len,
+			      userptr_t free, size_t free_len ) {
+	size_t offset;
 	size_t frag_len;
-	size_t new_len;
-
-	DBGC ( &images, "INITRD swapping %s [%#08lx,%#08lx)<->[%#08lx,%#08lx) "
-	       "%s\n", low->name, user_to_phys ( low->data, 0 ),
-	       user_to_phys ( low->data, low->len ),
-	       user_to_phys ( high->data, 0 ),
-	       user_to_phys ( high->data, high->len ), high->name );
 
-	/* Round down length of free space */
-	free_len &= ~( INITRD_ALIGN - 1 );
-	assert ( free_len > 0 );
-
-	/* Swap image data */
-	while ( len < high->len ) {
-
-		/* Calculate maximum fragment length */
-		frag_len = ( high->len - len );
+	for ( offset = 0 ; offset < len ; offset += frag_len ) {
+		frag_len = ( len - offset );
 		if ( frag_len > free_len )
 			frag_len = free_len;
-		new_len = ( ( len + frag_len + INITRD_ALIGN - 1 ) &
-			    ~( INITRD_ALIGN - 1 ) );
-
-		/* Swap fragments */
-		memcpy_user ( free, 0, high->data, len, frag_len );
-		memmove_user ( low->data, new_len, low->data, len, low->len );
-		memcpy_user ( low->data, len, free, 0, frag_len );
-		len = new_len;
+		memcpy_user ( free, 0, first, offset, frag_len );
+		memcpy_user ( first, offset, second, offset, frag_len );
+		memcpy_user ( second, offset, free, 0, frag_len );
 	}
-
-	/* Adjust data pointers */
-	high->data = low->data;
-	low->data = userptr_add ( low->data, len );
 }
 
 /**
- * Swap position of any two adjacent initrds not currently in the correct order
+ * Rotate two adjacent regions
  *
+ * @v low		Start of lower region
+ * @v low_len		Length of lower region
+ * @v high_len		Length of higher region
  * @v free		Free space
  * @v free_len		Length of free space
- * @ret swapped		A pair of initrds was swapped
+ *
+ * The higher region immediately follows the lower region, and the
+ * two regions are exchanged.  If either region fits within the free
+ * space, then it is moved out of the way while the other region is
+ * moved in a single pass.  Otherwise, equal-length blocks are
+ * exchanged until one region fits (or the rotation is complete).
+ * Either way, the total amount of data moved is proportional to the
+ * combined length of the regions, rather than to the product of the
+ * region length and the number of fragments.
  */
-static int initrd_swap_any ( userptr_t free, size_t free_len ) {
-	struct image *low;
-	struct image *high;
-	size_t padded_len;
-	userptr_t adjacent;
-
-	/* Find any pair of initrds that can be swapped */
-	for_each_image ( low ) {
-
-		/* Calculate location of adjacent image (if any) */
-		padded_len = ( ( low->len + INITRD_ALIGN - 1 ) &
-			       ~( INITRD_ALIGN - 1 ) );
-		adjacent = userptr_add ( low->data, padded_len );
-
-		/* Search for adjacent image */
-		for_each_image ( high ) {
-
-			/* If we have found the adjacent image, swap and exit */
-			if ( high->data == adjacent ) {
-				initrd_swap ( low, high, free, free_len );
-				return 1;
-			}
+static void initrd_rotate ( userptr_t low, size_t low_len, size_t high_len,
+			    userptr_t free, size_t free_len ) {
+	userptr_t high;
+
+	while ( low_len && high_len ) {
+		high = userptr_add ( low, low_len );
+
+		/* Move lower region via free space, if possible */
+		if ( low_len <= free_len ) {
+			memcpy_user ( free, 0, low, 0, low_len );
+			memmove_user ( low, 0, high, 0, high_len );
+			memcpy_user ( low, high_len, free, 0, low_len );
+			return;
+		}
+
+		/* Move higher region via free space, if possible */
+		if ( high_len <= free_len ) {
+			memcpy_user ( free, 0, high, 0, high_len );
+			memmove_user ( low, high_len, low, 0, low_len );
+			memcpy_user ( low, 0, free, 0, high_len );
+			return;
+		}
 
-			/* Stop search if all remaining potential
-			 * adjacent images are already in the correct
-			 * order.
-			 */
-			if ( high == low )
-				break;
+		/* Exchange equal-length blocks, leaving one block in
+		 * its final position and a smaller rotation remaining.
+		 */
+		if ( low_len <= high_len ) {
+			initrd_exchange ( low, userptr_add ( low, high_len ),
+					  low_len, free, free_len );
+			high_len -= low_len;
+		} else {
+			initrd_exchange ( low, high, high_len,
+					  free, free_len );
+			low = userptr_add ( low, high_len );
+			low_len -= high_len;
 		}
 	}
+}
+
+/**
+ * Sort initrds into desired order
+ *
+ * @v used		Lowest address used by initrds
+ * @v free		Free space
+ * @v free_len		Length of free space
+ *
+ * The initrds must already have been squashed into a contiguous
+ * region starting at @c used.  Each initrd in turn is rotated down
+ * into the lowest position not yet occupied by a sorted initrd.
+ */
+static void initrd_sort ( userptr_t used, userptr_t free, size_t free_len ) {
+	struct image *initrd;
+	struct image *other;
+	userptr_t current = used;
+	size_t skip_len;
+	size_t len;
+
+	/* Round down length of free space */
+	free_len &= ~( INITRD_ALIGN - 1 );
+	assert ( free_len > 0 );
+
+	/* Place each initrd in turn */
+	for_each_image ( initrd ) {
+
+		/* Calculate padded length */
+		len = ( ( initrd->len + INITRD_ALIGN - 1 ) &
+			~( INITRD_ALIGN - 1 ) );
+
+		/* Rotate initrd down past any unsorted initrds */
+		skip_len = userptr_sub ( initrd->data, current );
+		if ( skip_len ) {
+			DBGC ( &images, "INITRD rotating %s [%#08lx,%#08lx)->"
+			       "[%#08lx,%#08lx)\n", initrd->name,
+			       user_to_phys ( initrd->data, 0 ),
+			       user_to_phys ( initrd->data, initrd->len ),
+			       user_to_phys ( current, 0 ),
+			       user_to_phys ( current, initrd->len ) );
+			initrd_rotate ( current, skip_len, len,
+					free, free_len );
+			for_each_image ( other ) {
+				if ( ( userptr_sub ( other->data,
+						     current ) >= 0 ) &&
+				     ( userptr_sub ( other->data,
+						     initrd->data ) < 0 ) ) {
+					other->data = userptr_add ( other->data,
+								    len );
+				}
+			}
+			initrd->data = current;
+		}
 
-	/* Nothing swapped */
-	return 0;
+		/* Move to next position */
+		current = userptr_add ( current, len );
+	}
 }
 
 /**
@@ -227,6 +280,7 @@ static void initrd_dump ( void ) {
  * permitted.
  */
 void initrd_reshuffle ( userptr_t bottom ) {
+	unsigned long start = currticks();
 	userptr_t top;
 	userptr_t used;
 	userptr_t free;
@@ -249,13 +303,78 @@ void initrd_reshuffle ( userptr_t bottom ) {
 	free = bottom;
 	free_len = userptr_sub ( used, free );
 
-	/* Bubble-sort initrds into desired order */
-	while ( initrd_swap_any ( free, free_len ) ) {}
+	/* Sort initrds into desired order */
+	initrd_sort ( used, free, free_len );
 
 	/* Debug */
+	DBGC ( &images, "INITRD reshuffled in %ld ticks\n",
+	       ( currticks() - start ) );
 	initrd_dump();
 }
 
+/**
+ * Find free region for initrds
+ *
+ * @v len		Total length of initrds (including padding)
+ * @v bottom		Lowest address available for initrds
+ * @v limit		Highest usable physical address
+ * @ret dest		Start of region, or UNULL if no region was found
+ *
+ * Find the highest region within the space available for initrds
+ * that does not overlap any existing image.  If such a region
+ * exists, then each initrd may be copied directly to its final
+ * location, without any need for reshuffling.
+ */
+userptr_t initrd_region ( size_t len, userptr_t bottom, physaddr_t limit ) {
+	struct image *initrd;
+	userptr_t top;
+	userptr_t dest;
+	userptr_t lowest;
+	physaddr_t phys;
+
+	/* Calculate limits of available space for initrds */
+	top = initrd_top;
+	if ( userptr_sub ( initrd_bottom, bottom ) > 0 )
+		bottom = initrd_bottom;
+	if ( user_to_phys ( top, -1 ) > limit )
+		top = phys_to_user ( limit + 1 );
+
+	while ( 1 ) {
+
+		/* Calculate aligned start of region */
+		if ( userptr_sub ( top, bottom ) < ( ( off_t ) len ) )
+			return UNULL;
+		phys = user_to_phys ( top, -len );
+		phys &= ~( INITRD_ALIGN - 1 );
+		dest = phys_to_user ( phys );
+		if ( userptr_sub ( dest, bottom ) < 0 )
+			return UNULL;
+
+		/* Find lowest image overlapping this region, if any */
+		lowest = UNULL;
+		for_each_image ( initrd ) {
+			if ( ( userptr_sub ( initrd->data,
+					     userptr_add ( dest, len ) ) < 0 ) &&
+			     ( userptr_sub ( userptr_add ( initrd->data,
+							   initrd->len ),
+					     dest ) > 0 ) &&
+			     ( ( lowest == UNULL ) ||
+			       ( userptr_sub ( initrd->data, lowest ) < 0 ) ) ){
+				lowest = initrd->data;
+			}
+		}
+		if ( lowest == UNULL )
+			break;
+
+		/* Retry below the overlapping image */
+		top = lowest;
+	}
+
+	DBGC ( &images, "INITRD using free region [%#08lx,%#08lx)\n",
+	       user_to_phys ( dest, 0 ), user_to_phys ( dest, len ) );
+	return dest;
+}
+
 /**
  * Check that there is enough space to reshuffle initrds
  *
@@ -26,5 +26,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 extern void initrd_reshuffle ( userptr_t bottom );
 extern int initrd_reshuffle_check ( size_t len, userptr_t bottom );
+extern userptr_t initrd_region ( size_t len, userptr_t bottom,
+				 physaddr_t limit );
 
 #endif /* _INITRD_H */
@@ -39,9 +39,51 @@ struct x86_features {
 /** Get standard features */
 #define CPUID_FEATURES 0x00000001UL
 
+/** Carry-less multiplication instruction is supported */
+#define CPUID_FEATURES_INTEL_ECX_PCLMUL 0x00000002UL
+
+/** SSE4.2 instructions are supported */
+#define CPUID_FEATURES_INTEL_ECX_SSE4_2 0x00100000UL
+
+/** AES instructions are supported */
+#define CPUID_FEATURES_INTEL_ECX_AES 0x02000000UL
+
+/** RDRAND instruction is supported */
+#define CPUID_FEATURES_INTEL_ECX_RDRAND 0x40000000UL
+
 /** Hypervisor is present */
 #define CPUID_FEATURES_INTEL_ECX_HYPERVISOR 0x80000000UL
 
+/** SSE2 instructions are supported */
+#define CPUID_FEATURES_INTEL_EDX_SSE2 0x04000000UL
+
+/** Get structured extended features */
+#define CPUID_STRUCTURED_FEATURES 0x00000007UL
+
+/** Enhanced REP MOVSB/STOSB is supported */
+#define CPUID_STRUCTURED_FEATURES_EBX_ERMS 0x00000200UL
+
+/** RDSEED instruction is supported */
+#define CPUID_STRUCTURED_FEATURES_EBX_RDSEED 0x00040000UL
+
+/** SHA instructions are supported */
+#define CPUID_STRUCTURED_FEATURES_EBX_SHA 0x20000000UL
+
+/** Get TSC to core crystal clock ratio */
+#define CPUID_TSC_RATIO 0x00000015UL
+
+/** Get processor frequency information */
+#define CPUID_FREQUENCY 0x00000016UL
+
+/** Get largest hypervisor function */
+#define CPUID_HYPERVISOR_MAX_FN 0x40000000UL
+
+/** Hypervisor function existence check mask */
+#define CPUID_HYPERVISOR_CHECK_MASK 0xffff0000UL
+
+/** Get hypervisor timing information */
+#define CPUID_HYPERVISOR_TIMING 0x40000010UL
+
 /** Get largest extended function */
 #define CPUID_AMD_MAX_FN 0x80000000UL
 
@@ -71,6 +113,9 @@ struct x86_features {
  * @v ebx		Output via %ebx
  * @v ecx		Output via %ecx
  * @v edx		Output via %edx
+ *
+ * Functions which have subfunctions (such as the structured extended
+ * features function) will return subfunction zero.
  */
 static inline __attribute__ (( always_inline )) void
 cpuid ( uint32_t function, uint32_t *eax, uint32_t *ebx, uint32_t *ecx,
@@ -78,7 +123,7 @@ cpuid ( uint32_t function, uint32_t *eax, uint32_t *ebx, uint32_t *ecx,
 
 	__asm__ ( "cpuid"
 		  : "=a" ( *eax ), "=b" ( *ebx ), "=c" ( *ecx ), "=d" ( *edx )
-		  : "0" ( function ) );
+		  : "0" ( function ), "2" ( 0 ) );
 }
 
 extern int cpuid_supported ( uint32_t function );
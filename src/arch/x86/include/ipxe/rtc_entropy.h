@@ -37,6 +37,9 @@ ENTROPY_INLINE ( rtc, min_entropy_per_sample ) ( void ) {
 	 * We choose the lowest of these (2.67 bits) and apply a 50%
 	 * safety margin to allow for some potential non-independence
 	 * of samples.
+	 *
+	 * The same (highly conservative) value is used when samples
+	 * are instead obtained via RDSEED or RDRAND.
 	 */
 	return 1.3;
 }
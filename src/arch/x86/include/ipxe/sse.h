@@ -0,0 +1,32 @@
+#ifndef _IPXE_SSE_H
+#define _IPXE_SSE_H
+
+/** @file
+ *
+ * x86 SSE register usage
+ *
+ * Accelerated routines written using inline assembly use only %xmm0
+ * to %xmm5.  These are caller-saved in all relevant calling
+ * conventions (including the EFI x64 calling convention, which
+ * preserves %xmm6 and above), and so no SSE state ever needs to be
+ * saved or restored.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** Clobbered SSE registers
+ *
+ * This expands to a list of clobbers with a trailing comma, and so
+ * must be followed by at least one further clobber (e.g. "memory").
+ *
+ * SSE registers cannot be declared as clobbered when building for a
+ * target that does not support SSE (in which case the compiler will
+ * never use them), and so the list is empty in this case.
+ */
+#ifdef __SSE__
+#define SSE_CLOBBERS "xmm0", "xmm1", "xmm2", "xmm3", "xmm4", "xmm5",
+#else
+#define SSE_CLOBBERS
+#endif
+
+#endif /* _IPXE_SSE_H */
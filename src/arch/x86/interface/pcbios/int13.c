@@ -845,7 +845,7 @@ static int int13_device_path_info ( struct san_device *sandev,
 		return rc;
 
 	/* Get underlying hardware device */
-	device = identify_device ( &sandev->block );
+	device = identify_device ( &sandev->active->block );
 	if ( ! device ) {
 		DBGC ( sandev, "INT13 drive %02x cannot identify hardware "
 		       "device\n", sandev->drive );
@@ -869,7 +869,8 @@ static int int13_device_path_info ( struct san_device *sandev,
 	}
 
 	/* Get EDD block device description */
-	if ( ( rc = edd_describe ( &sandev->block, &dpi->interface_type,
+	if ( ( rc = edd_describe ( &sandev->active->block,
+				   &dpi->interface_type,
 				   &dpi->device_path ) ) != 0 ) {
 		DBGC ( sandev, "INT13 drive %02x cannot identify block device: "
 		       "%s\n", sandev->drive, strerror ( rc ) );
@@ -1199,14 +1200,16 @@ static void int13_unhook_vector ( void ) {
 /**
  * Hook INT 13 SAN device
  *
- * @v uri		URI
+ * @v uris		List of URIs
+ * @v count		Number of URIs
  * @v drive		Drive number
  * @ret drive		Drive number, or negative error
  *
  * Registers the drive with the INT 13 emulation subsystem, and hooks
  * the INT 13 interrupt vector (if not already hooked).
  */
-static int int13_hook ( struct uri *uri, unsigned int drive ) {
+static int int13_hook ( struct uri **uris, unsigned int count,
+			unsigned int drive ) {
 	struct san_device *sandev;
 	struct int13_data *int13;
 	unsigned int natural_drive;
@@ -1223,7 +1226,7 @@ static int int13_hook ( struct uri *uri, unsigned int drive ) {
 		drive = natural_drive;
 
 	/* Allocate SAN device */
-	sandev = alloc_sandev ( uri, sizeof ( *int13 ) );
+	sandev = alloc_sandev ( uris, count, sizeof ( *int13 ) );
 	if ( ! sandev ) {
 		rc = -ENOMEM;
 		goto err_alloc;
@@ -1550,7 +1553,7 @@ static int int13_describe ( unsigned int drive ) {
 		  sizeof ( xbftab.acpi.oem_table_id ) );
 
 	/* Fill in remaining parameters */
-	if ( ( rc = acpi_describe ( &sandev->block, &xbftab.acpi,
+	if ( ( rc = acpi_describe ( &sandev->active->block, &xbftab.acpi,
 				    sizeof ( xbftab ) ) ) != 0 ) {
 		DBGC ( sandev, "INT13 drive %02x could not create ACPI "
 		       "description: %s\n", sandev->drive, strerror ( rc ) );
@@ -55,6 +55,9 @@ struct external_memory {
 	int used;
 };
 
+/** Base of heap */
+static userptr_t base = UNULL;
+
 /** Top of heap */
 static userptr_t top = UNULL;
 
@@ -64,6 +67,19 @@ static userptr_t bottom = UNULL;
 /** Remaining space on heap */
 static size_t heap_size;
 
+/** Arena block (if any)
+ *
+ * The heap grows downwards, and so expanding the lowest block on the
+ * heap requires its existing contents to be moved down.  A buffer
+ * that grows repeatedly (such as a large download of unknown length)
+ * would therefore be copied in its entirety many times over.
+ *
+ * The first such block to be expanded is instead moved (once) to the
+ * base of the heap, from where it can subsequently grow upwards in
+ * place towards the bottom of the heap.
+ */
+static userptr_t arena = UNULL;
+
 /**
  * Find largest usable memory region
  *
@@ -119,7 +135,6 @@ size_t largest_memblock ( userptr_t *start ) {
  *
  */
 static void init_eheap ( void ) {
-	userptr_t base;
 
 	heap_size = largest_memblock ( &base );
 	bottom = top = userptr_add ( base, heap_size );
@@ -149,6 +164,98 @@ static void ecollect_free ( void ) {
 	}
 }
 
+/**
+ * Resize arena block
+ *
+ * @v new_size		Requested size
+ * @ret new_ptr		Allocated memory, or UNULL
+ */
+static userptr_t earena_resize ( size_t new_size ) {
+	struct external_memory extmem;
+
+	/* Get block properties */
+	copy_from_user ( &extmem, arena, -sizeof ( extmem ),
+			 sizeof ( extmem ) );
+
+	/* Free block, if applicable */
+	if ( ! new_size ) {
+		DBG ( "EXTMEM freeing arena [%lx,%lx)\n",
+		      user_to_phys ( arena, 0 ),
+		      user_to_phys ( arena, extmem.size ) );
+		heap_size = ( user_to_phys ( bottom, 0 ) -
+			      user_to_phys ( base, 0 ) );
+		arena = UNULL;
+		return UNOWHERE;
+	}
+
+	/* Expand/shrink block in place */
+	if ( new_size > ( heap_size + extmem.size ) ) {
+		DBG ( "EXTMEM out of space\n" );
+		return UNULL;
+	}
+	DBG ( "EXTMEM resizing arena [%lx,%lx) to [%lx,%lx)\n",
+	      user_to_phys ( arena, 0 ), user_to_phys ( arena, extmem.size ),
+	      user_to_phys ( arena, 0 ), user_to_phys ( arena, new_size ) );
+	heap_size = ( heap_size + extmem.size - new_size );
+	extmem.size = new_size;
+
+	/* Write back block properties */
+	copy_to_user ( arena, -sizeof ( extmem ), &extmem,
+		       sizeof ( extmem ) );
+
+	return arena;
+}
+
+/**
+ * Move lowest block to arena
+ *
+ * @v ptr		Lowest block on heap
+ * @v new_size		Requested size
+ * @ret new_ptr		Allocated memory, or UNULL
+ */
+static userptr_t earena_create ( userptr_t ptr, size_t new_size ) {
+	struct external_memory extmem;
+	userptr_t new;
+	size_t align;
+	size_t len;
+
+	/* Calculate aligned arena block position */
+	align = ( -user_to_phys ( base, sizeof ( extmem ) ) &
+		  ( EM_ALIGN - 1 ) );
+	new = userptr_add ( base, ( sizeof ( extmem ) + align ) );
+	len = ( sizeof ( extmem ) + align + new_size );
+	if ( ( len < new_size ) || ( len > heap_size ) )
+		return UNULL;
+
+	/* Get old block properties */
+	copy_from_user ( &extmem, ptr, -sizeof ( extmem ),
+			 sizeof ( extmem ) );
+	DBG ( "EXTMEM moving [%lx,%lx) to arena [%lx,%lx)\n",
+	      user_to_phys ( ptr, 0 ), user_to_phys ( ptr, extmem.size ),
+	      user_to_phys ( new, 0 ), user_to_phys ( new, new_size ) );
+
+	/* Copy contents to arena block.  The arena block lies
+	 * entirely within the free space below the old block, and so
+	 * cannot overlap it.
+	 */
+	memcpy_user ( new, 0, ptr, 0, extmem.size );
+
+	/* Free old block */
+	extmem.used = 0;
+	copy_to_user ( ptr, -sizeof ( extmem ), &extmem,
+		       sizeof ( extmem ) );
+
+	/* Create arena block */
+	extmem.size = new_size;
+	extmem.used = 1;
+	copy_to_user ( new, -sizeof ( extmem ), &extmem,
+		       sizeof ( extmem ) );
+	heap_size -= len;
+	arena = new;
+
+	return new;
+}
+
 /**
  * Reallocate external memory
  *
@@ -165,9 +272,15 @@ static userptr_t memtop_urealloc ( userptr_t ptr, size_t new_size ) {
 	size_t align;
 
 	/* (Re)initialise external memory allocator if necessary */
-	if ( bottom == top )
+	if ( ( bottom == top ) && ( ! arena ) )
 		init_eheap();
 
+	/* Resize arena block in place, if applicable */
+	if ( ptr && ( ptr == arena ) ) {
+		new = earena_resize ( new_size );
+		goto done;
+	}
+
 	/* Get block properties into extmem */
 	if ( ptr && ( ptr != UNOWHERE ) ) {
 		/* Determine old size */
@@ -187,6 +300,17 @@ static userptr_t memtop_urealloc ( userptr_t ptr, size_t new_size ) {
 	}
 	extmem.used = ( new_size > 0 );
 
+	/* Move lowest block to arena instead of expanding it, if
+	 * possible.
+	 */
+	if ( ( ptr == bottom ) && ( ! arena ) && extmem.size &&
+	     ( new_size > extmem.size ) ) {
+		new = earena_create ( ptr, new_size );
+		if ( new )
+			goto done;
+		new = ptr;
+	}
+
 	/* Expand/shrink block if possible */
 	if ( ptr == bottom ) {
 		/* Update block */
@@ -222,14 +346,22 @@ static userptr_t memtop_urealloc ( userptr_t ptr, size_t new_size ) {
 	/* Write back block properties */
 	copy_to_user ( new, -sizeof ( extmem ), &extmem,
 		       sizeof ( extmem ) );
+	if ( ! new_size )
+		new = UNOWHERE;
 
+ done:
 	/* Collect any free blocks and update hidden memory region */
 	ecollect_free();
-	hide_umalloc ( user_to_phys ( bottom, ( ( bottom == top ) ?
-						0 : -sizeof ( extmem ) ) ),
-		       user_to_phys ( top, 0 ) );
+	if ( arena ) {
+		hide_umalloc ( user_to_phys ( base, 0 ),
+			       user_to_phys ( top, 0 ) );
+	} else {
+		hide_umalloc ( user_to_phys ( bottom, ( ( bottom == top ) ?
+							0 : -sizeof ( extmem ) ) ),
+			       user_to_phys ( top, 0 ) );
+	}
 
-	return ( new_size ? new : UNOWHERE );
+	return new;
 }
 
 PROVIDE_UMALLOC ( memtop, urealloc, memtop_urealloc );
@@ -36,11 +36,32 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <biosint.h>
 #include <pic8259.h>
 #include <rtc.h>
+#include <ipxe/cpuid.h>
 #include <ipxe/entropy.h>
 
 /** Maximum time to wait for an RTC interrupt, in milliseconds */
 #define RTC_MAX_WAIT_MS 100
 
+/** Maximum number of attempts to obtain a hardware random number
+ *
+ * Intel recommends retrying RDRAND up to ten times before concluding
+ * that the hardware has failed.
+ */
+#define RTC_HWRNG_MAX_ATTEMPTS 10
+
+/** Hardware random number sources */
+enum rtc_hwrng {
+	/** No hardware random number source (use RTC interrupts) */
+	RTC_HWRNG_NONE = 0,
+	/** RDSEED instruction */
+	RTC_HWRNG_RDSEED,
+	/** RDRAND instruction */
+	RTC_HWRNG_RDRAND,
+};
+
+/** Hardware random number source in use */
+static enum rtc_hwrng rtc_hwrng;
+
 /** RTC interrupt handler */
 extern void rtc_isr ( void );
 
@@ -168,14 +189,88 @@ static int rtc_entropy_check ( void ) {
 	return -ETIMEDOUT;
 }
 
+/**
+ * Identify hardware random number source
+ *
+ * @ret hwrng		Hardware random number source
+ */
+static enum rtc_hwrng rtc_hwrng_detect ( void ) {
+	struct x86_features features;
+	uint32_t discard_a;
+	uint32_t ebx;
+	uint32_t discard_c;
+	uint32_t discard_d;
+
+	/* Prefer RDSEED, which returns conditioned entropy rather
+	 * than the output of a DRBG.
+	 */
+	if ( cpuid_supported ( CPUID_STRUCTURED_FEATURES ) == 0 ) {
+		cpuid ( CPUID_STRUCTURED_FEATURES, &discard_a, &ebx,
+			&discard_c, &discard_d );
+		if ( ebx & CPUID_STRUCTURED_FEATURES_EBX_RDSEED )
+			return RTC_HWRNG_RDSEED;
+	}
+
+	/* Otherwise, use RDRAND if available */
+	x86_features ( &features );
+	if ( features.intel.ecx & CPUID_FEATURES_INTEL_ECX_RDRAND )
+		return RTC_HWRNG_RDRAND;
+
+	return RTC_HWRNG_NONE;
+}
+
+/**
+ * Obtain hardware random number
+ *
+ * @ret value		Random number
+ * @ret rc		Return status code
+ */
+static int rtc_hwrng_sample ( uint32_t *value ) {
+	unsigned int i;
+	uint8_t ok;
+
+	for ( i = 0 ; i < RTC_HWRNG_MAX_ATTEMPTS ; i++ ) {
+		if ( rtc_hwrng == RTC_HWRNG_RDSEED ) {
+			__asm__ __volatile__ ( "rdseed %0\n\t"
+					       "setc %1\n\t"
+					       : "=r" ( *value ), "=qm" ( ok ) );
+		} else {
+			__asm__ __volatile__ ( "rdrand %0\n\t"
+					       "setc %1\n\t"
+					       : "=r" ( *value ), "=qm" ( ok ) );
+		}
+		if ( ok )
+			return 0;
+	}
+
+	DBGC ( &rtc_flag, "RTC hardware random number source failed\n" );
+	return -EIO;
+}
+
 /**
  * Enable entropy gathering
  *
  * @ret rc		Return status code
  */
 static int rtc_entropy_enable ( void ) {
+	uint32_t discard;
 	int rc;
 
+	/* Use a hardware random number source, if available, since
+	 * waiting for RTC interrupts takes several milliseconds per
+	 * sample and noticeably delays startup.
+	 */
+	rtc_hwrng = rtc_hwrng_detect();
+	if ( rtc_hwrng != RTC_HWRNG_NONE ) {
+		if ( ( rc = rtc_hwrng_sample ( &discard ) ) == 0 ) {
+			DBGC ( &rtc_flag, "RTC using %s\n",
+			       ( ( rtc_hwrng == RTC_HWRNG_RDSEED ) ?
+				 "RDSEED" : "RDRAND" ) );
+			return 0;
+		}
+		rtc_hwrng = RTC_HWRNG_NONE;
+	}
+
 	/* Hook ISR and enable RTC interrupts */
 	rtc_hook_isr();
 	enable_irq ( RTC_IRQ );
@@ -200,6 +295,10 @@ static int rtc_entropy_enable ( void ) {
  */
 static void rtc_entropy_disable ( void ) {
 
+	/* Do nothing if using a hardware random number source */
+	if ( rtc_hwrng != RTC_HWRNG_NONE )
+		return;
+
 	/* Disable RTC interrupts and unhook ISR */
 	rtc_disable_int();
 	disable_irq ( RTC_IRQ );
@@ -210,11 +309,25 @@ static void rtc_entropy_disable ( void ) {
  * Measure a single RTC tick
  *
  * @ret delta		Length of RTC tick (in TSC units)
+ *
+ * If a hardware random number source is in use, then the sample is
+ * instead taken from the hardware random number source.
  */
 uint8_t rtc_sample ( void ) {
 	uint32_t before;
 	uint32_t after;
 	uint32_t temp;
+	uint32_t value;
+
+	/* Use hardware random number source, if available.  A
+	 * failure will result in a constant sample, which will be
+	 * detected by the entropy source health tests.
+	 */
+	if ( rtc_hwrng != RTC_HWRNG_NONE ) {
+		if ( rtc_hwrng_sample ( &value ) != 0 )
+			return 0;
+		return value;
+	}
 
 	__asm__ __volatile__ (
 		REAL_CODE ( /* Enable interrupts */
@@ -31,6 +31,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
 #include <byteswap.h>
 #include <ipxe/uaccess.h>
@@ -60,12 +61,25 @@ struct pxe_tftp_connection {
 	size_t max_offset;
 	/** Block size */
 	size_t blksize;
+	/** Data transfer window size */
+	size_t window;
+	/** Read-ahead buffer (if any) */
+	void *prefetch;
 	/** Block index */
 	unsigned int blkidx;
 	/** Overall return status code */
 	int rc;
 };
 
+/** Size of the PXENV_TFTP_READ read-ahead buffer (in blocks)
+ *
+ * Received blocks are acknowledged and prefetched into this buffer
+ * without waiting for the NBP to ask for them.  This allows larger
+ * TFTP window sizes to be used, and allows each PXENV_TFTP_READ to
+ * return immediately if the next block has already arrived.
+ */
+#define PXE_TFTP_PREFETCH_BLOCKS ( 2 * TFTP_MAX_WINDOWSIZE )
+
 /**
  * Close PXE TFTP connection
  *
@@ -85,7 +99,7 @@ static void pxe_tftp_close ( struct pxe_tftp_connection *pxe_tftp, int rc ) {
  */
 static size_t pxe_tftp_xfer_window ( struct pxe_tftp_connection *pxe_tftp ) {
 
-	return pxe_tftp->blksize;
+	return pxe_tftp->window;
 }
 
 /**
@@ -165,24 +179,33 @@ static struct pxe_tftp_connection pxe_tftp = {
  * @v ipaddress		IP address
  * @v port		TFTP server port (in network byte order)
  * @v filename		File name
- * @v blksize		Requested block size
+ * @v window		Requested block size or data transfer window
+ * @v mirror		Use HTTP mirror
  * @ret rc		Return status code
+ *
+ * The requested data transfer window is used as the requested TFTP
+ * block size.  For atomic downloads, this may be the size of the
+ * whole receive buffer, since the TFTP protocol will then cap the
+ * block size at its own maximum.
  */
 static int pxe_tftp_open ( IP4_t ipaddress, UDP_PORT_t port,
-			   UINT8_t *filename, UINT16_t blksize ) {
+			   UINT8_t *filename, size_t window, int mirror ) {
 	union {
 		struct sockaddr sa;
 		struct sockaddr_in sin;
 	} server;
+	struct uri *mirror_uri;
 	struct uri *uri;
 	int rc;
 
 	/* Reset PXE TFTP connection structure */
+	free ( pxe_tftp.prefetch );
 	memset ( &pxe_tftp, 0, sizeof ( pxe_tftp ) );
 	intf_init ( &pxe_tftp.xfer, &pxe_tftp_xfer_desc, NULL );
-	if ( blksize < TFTP_DEFAULT_BLKSIZE )
-		blksize = TFTP_DEFAULT_BLKSIZE;
-	pxe_tftp.blksize = blksize;
+	if ( window < TFTP_DEFAULT_BLKSIZE )
+		window = TFTP_DEFAULT_BLKSIZE;
+	pxe_tftp.blksize = window;
+	pxe_tftp.window = window;
 	pxe_tftp.rc = -EINPROGRESS;
 
 	/* Construct URI */
@@ -197,16 +220,33 @@ static int pxe_tftp_open ( IP4_t ipaddress, UDP_PORT_t port,
 	uri = pxe_uri ( &server.sa, ( ( char * ) filename ) );
 	if ( ! uri ) {
 		DBG ( " could not create URI\n" );
-		return -ENOMEM;
+		rc = -ENOMEM;
+		goto err_uri;
+	}
+
+	/* Use HTTP mirror, if applicable */
+	if ( mirror ) {
+		mirror_uri = pxe_mirror_uri ( uri );
+		if ( ! mirror_uri ) {
+			rc = -ENOTSUP;
+			goto err_mirror;
+		}
+		uri_put ( uri );
+		uri = mirror_uri;
+		DBG ( " via %s", uri->host );
 	}
 
 	/* Open PXE TFTP connection */
 	if ( ( rc = xfer_open_uri ( &pxe_tftp.xfer, uri ) ) != 0 ) {
 		DBG ( " could not open (%s)\n", strerror ( rc ) );
-		return rc;
+		goto err_open;
 	}
 
-	return 0;
+ err_open:
+ err_mirror:
+	uri_put ( uri );
+ err_uri:
+	return rc;
 }
 
 /**
@@ -252,6 +292,7 @@ static int pxe_tftp_open ( IP4_t ipaddress, UDP_PORT_t port,
  * other PXE API call "if an MTFTP connection is active".
  */
 static PXENV_EXIT_t pxenv_tftp_open ( struct s_PXENV_TFTP_OPEN *tftp_open ) {
+	size_t blksize;
 	int rc;
 
 	DBG ( "PXENV_TFTP_OPEN" );
@@ -263,11 +304,27 @@ static PXENV_EXIT_t pxenv_tftp_open ( struct s_PXENV_TFTP_OPEN *tftp_open ) {
 	if ( ( rc = pxe_tftp_open ( tftp_open->ServerIPAddress,
 				    tftp_open->TFTPPort,
 				    tftp_open->FileName,
-				    tftp_open->PacketSize ) ) != 0 ) {
+				    tftp_open->PacketSize, 0 ) ) != 0 ) {
 		tftp_open->Status = PXENV_STATUS ( rc );
 		return PXENV_EXIT_FAILURE;
 	}
 
+	/* Allocate read-ahead buffer.  The negotiated block size can
+	 * never exceed the requested block size.
+	 */
+	blksize = pxe_tftp.blksize;
+	if ( blksize > TFTP_MAX_BLKSIZE )
+		blksize = TFTP_MAX_BLKSIZE;
+	pxe_tftp.size = ( PXE_TFTP_PREFETCH_BLOCKS * blksize );
+	pxe_tftp.prefetch = malloc ( pxe_tftp.size );
+	if ( ! pxe_tftp.prefetch ) {
+		rc = -ENOMEM;
+		pxe_tftp_close ( &pxe_tftp, rc );
+		tftp_open->Status = PXENV_STATUS ( rc );
+		return PXENV_EXIT_FAILURE;
+	}
+	pxe_tftp.buffer = virt_to_user ( pxe_tftp.prefetch );
+
 	/* Wait for OACK to arrive so that we have the block size */
 	while ( ( ( rc = pxe_tftp.rc ) == -EINPROGRESS ) &&
 		( pxe_tftp.max_offset == 0 ) ) {
@@ -306,6 +363,9 @@ static PXENV_EXIT_t pxenv_tftp_close ( struct s_PXENV_TFTP_CLOSE *tftp_close ) {
 	DBG ( "PXENV_TFTP_CLOSE" );
 
 	pxe_tftp_close ( &pxe_tftp, 0 );
+	free ( pxe_tftp.prefetch );
+	pxe_tftp.prefetch = NULL;
+	pxe_tftp.buffer = UNULL;
 	tftp_close->Status = PXENV_STATUS_SUCCESS;
 	return PXENV_EXIT_SUCCESS;
 }
@@ -372,27 +432,46 @@ static PXENV_EXIT_t pxenv_tftp_close ( struct s_PXENV_TFTP_CLOSE *tftp_close ) {
  * @ref pxe_x86_pmode16 "implementation note" for more details.)
  */
 static PXENV_EXIT_t pxenv_tftp_read ( struct s_PXENV_TFTP_READ *tftp_read ) {
+	size_t fill;
+	size_t len;
 	int rc;
 
 	DBG ( "PXENV_TFTP_READ to %04x:%04x",
 	      tftp_read->Buffer.segment, tftp_read->Buffer.offset );
 
-	/* Read single block into buffer */
-	pxe_tftp.buffer = real_to_user ( tftp_read->Buffer.segment,
-					 tftp_read->Buffer.offset );
-	pxe_tftp.size = pxe_tftp.blksize;
-	pxe_tftp.start = pxe_tftp.offset;
+	/* Fail if no connection is open */
+	if ( ! pxe_tftp.prefetch ) {
+		tftp_read->Status = PXENV_STATUS_TFTP_CANNOT_READ_FROM_CONNECTION;
+		return PXENV_EXIT_FAILURE;
+	}
+
+	/* Wait until a complete block (or the end of the file) has
+	 * been prefetched.
+	 */
 	while ( ( ( rc = pxe_tftp.rc ) == -EINPROGRESS ) &&
-		( pxe_tftp.offset == pxe_tftp.start ) )
+		( ( pxe_tftp.offset - pxe_tftp.start ) < pxe_tftp.blksize ) )
 		step();
-	pxe_tftp.buffer = UNULL;
-	tftp_read->BufferSize = ( pxe_tftp.offset - pxe_tftp.start );
-	tftp_read->PacketNumber = ++pxe_tftp.blkidx;
 
 	/* EINPROGRESS is normal if we haven't reached EOF yet */
 	if ( rc == -EINPROGRESS )
 		rc = 0;
 
+	/* Return single block from read-ahead buffer */
+	if ( rc == 0 ) {
+		fill = ( pxe_tftp.offset - pxe_tftp.start );
+		len = fill;
+		if ( len > pxe_tftp.blksize )
+			len = pxe_tftp.blksize;
+		copy_to_user ( real_to_user ( tftp_read->Buffer.segment,
+					      tftp_read->Buffer.offset ),
+			       0, pxe_tftp.prefetch, len );
+		memmove ( pxe_tftp.prefetch, ( pxe_tftp.prefetch + len ),
+			  ( fill - len ) );
+		pxe_tftp.start += len;
+		tftp_read->BufferSize = len;
+		tftp_read->PacketNumber = ++pxe_tftp.blkidx;
+	}
+
 	tftp_read->Status = PXENV_STATUS ( rc );
 	return ( rc ? PXENV_EXIT_FAILURE : PXENV_EXIT_SUCCESS );
 }
@@ -479,29 +558,42 @@ static PXENV_EXIT_t pxenv_tftp_read ( struct s_PXENV_TFTP_READ *tftp_read ) {
  */
 PXENV_EXIT_t pxenv_tftp_read_file ( struct s_PXENV_TFTP_READ_FILE
 				    *tftp_read_file ) {
+	int mirror;
 	int rc;
 
 	DBG ( "PXENV_TFTP_READ_FILE to %08x+%x", tftp_read_file->Buffer,
 	      tftp_read_file->BufferSize );
 
-	/* Open TFTP file */
-	if ( ( rc = pxe_tftp_open ( tftp_read_file->ServerIPAddress, 0,
-				    tftp_read_file->FileName, 0 ) ) != 0 ) {
-		tftp_read_file->Status = PXENV_STATUS ( rc );
-		return PXENV_EXIT_FAILURE;
+	/* Try via HTTP mirror (if configured), then from the server */
+	for ( mirror = 1 ; mirror >= 0 ; mirror-- ) {
+
+		/* Open TFTP file.  The whole buffer is available, so
+		 * request the largest possible block size.
+		 */
+		if ( ( rc = pxe_tftp_open ( tftp_read_file->ServerIPAddress, 0,
+					    tftp_read_file->FileName,
+					    tftp_read_file->BufferSize,
+					    mirror ) ) != 0 ) {
+			continue;
+		}
+
+		/* Read entire file */
+		pxe_tftp.buffer = phys_to_user ( tftp_read_file->Buffer );
+		pxe_tftp.size = tftp_read_file->BufferSize;
+		while ( ( rc = pxe_tftp.rc ) == -EINPROGRESS )
+			step();
+		pxe_tftp.buffer = UNULL;
+		tftp_read_file->BufferSize = pxe_tftp.max_offset;
+
+		/* Close TFTP file */
+		pxe_tftp_close ( &pxe_tftp, rc );
+		if ( rc == 0 )
+			break;
+
+		/* Restore buffer size for retry */
+		tftp_read_file->BufferSize = pxe_tftp.size;
 	}
 
-	/* Read entire file */
-	pxe_tftp.buffer = phys_to_user ( tftp_read_file->Buffer );
-	pxe_tftp.size = tftp_read_file->BufferSize;
-	while ( ( rc = pxe_tftp.rc ) == -EINPROGRESS )
-		step();
-	pxe_tftp.buffer = UNULL;
-	tftp_read_file->BufferSize = pxe_tftp.max_offset;
-
-	/* Close TFTP file */
-	pxe_tftp_close ( &pxe_tftp, rc );
-
 	tftp_read_file->Status = PXENV_STATUS ( rc );
 	return ( rc ? PXENV_EXIT_FAILURE : PXENV_EXIT_SUCCESS );
 }
@@ -556,7 +648,7 @@ static PXENV_EXIT_t pxenv_tftp_get_fsize ( struct s_PXENV_TFTP_GET_FSIZE
 
 	/* Open TFTP file */
 	if ( ( rc = pxe_tftp_open ( tftp_get_fsize->ServerIPAddress, 0,
-				    tftp_get_fsize->FileName, 0 ) ) != 0 ) {
+				    tftp_get_fsize->FileName, 0, 0 ) ) != 0 ) {
 		tftp_get_fsize->Status = PXENV_STATUS ( rc );
 		return PXENV_EXIT_FAILURE;
 	}
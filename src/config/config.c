@@ -123,6 +123,9 @@ REQUIRE_OBJECT ( nfs_open );
 #ifdef DOWNLOAD_PROTO_SLAM
 REQUIRE_OBJECT ( slam );
 #endif
+#ifdef DOWNLOAD_PROTO_MCFEC
+REQUIRE_OBJECT ( mcfec );
+#endif
 
 /*
  * Drag in all requested SAN boot protocols
@@ -182,6 +185,12 @@ REQUIRE_OBJECT ( efi_image );
 #ifdef IMAGE_SDI
 REQUIRE_OBJECT ( sdi );
 #endif
+#ifdef IMAGE_ZLIB
+REQUIRE_OBJECT ( zlib );
+#endif
+#ifdef IMAGE_GZIP
+REQUIRE_OBJECT ( gzip );
+#endif
 
 /*
  * Drag in all requested commands
@@ -209,6 +218,9 @@ REQUIRE_OBJECT ( image_cmd );
 #ifdef IMAGE_TRUST_CMD
 REQUIRE_OBJECT ( image_trust_cmd );
 #endif
+#ifdef IMAGE_ARCHIVE_CMD
+REQUIRE_OBJECT ( image_archive_cmd );
+#endif
 #ifdef DHCP_CMD
 REQUIRE_OBJECT ( dhcp_cmd );
 #endif
@@ -269,6 +281,9 @@ REQUIRE_OBJECT ( console_cmd );
 #ifdef IPSTAT_CMD
 REQUIRE_OBJECT ( ipstat_cmd );
 #endif
+#ifdef TCPSTAT_CMD
+REQUIRE_OBJECT ( tcpstat_cmd );
+#endif
 #ifdef PROFSTAT_CMD
 REQUIRE_OBJECT ( profstat_cmd );
 #endif
@@ -278,6 +293,18 @@ REQUIRE_OBJECT ( ntp_cmd );
 #ifdef CERT_CMD
 REQUIRE_OBJECT ( cert_cmd );
 #endif
+#ifdef TIMELINE_CMD
+REQUIRE_OBJECT ( timeline_cmd );
+#endif
+#ifdef TRACE_CMD
+REQUIRE_OBJECT ( trace_cmd );
+#endif
+#ifdef HTTPBENCH_CMD
+REQUIRE_OBJECT ( httpbench_cmd );
+#endif
+#ifdef MEMSTAT_CMD
+REQUIRE_OBJECT ( memstat_cmd );
+#endif
 
 /*
  * Drag in miscellaneous objects
@@ -296,6 +323,12 @@ REQUIRE_OBJECT ( gdbidt );
 REQUIRE_OBJECT ( gdbudp );
 REQUIRE_OBJECT ( gdbstub_cmd );
 #endif
+#ifdef NET_NAP
+REQUIRE_OBJECT ( netnap );
+#endif
+#ifdef TIMELINE
+REQUIRE_OBJECT ( timeline );
+#endif
 
 /*
  * Drag in objects that are always required, but not dragged in via
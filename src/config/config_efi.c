@@ -49,3 +49,12 @@ REQUIRE_OBJECT ( efi_fbcon );
 #ifdef DOWNLOAD_PROTO_FILE
 REQUIRE_OBJECT ( efi_local );
 #endif
+#ifdef DOWNLOAD_PROTO_CACHE
+REQUIRE_OBJECT ( efi_cache );
+#endif
+#ifdef DISKWRITE_CMD
+REQUIRE_OBJECT ( diskwrite_cmd );
+#endif
+#ifdef HANDOVER
+REQUIRE_OBJECT ( efi_handover );
+#endif
@@ -12,9 +12,18 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** RSA public-key algorithm */
 #define CRYPTO_PUBKEY_RSA
 
+/** ECDHE key exchange algorithm */
+#define CRYPTO_EXCHANGE_ECDHE
+
+/** X25519 elliptic curve */
+#define CRYPTO_CURVE_X25519
+
 /** AES-CBC block cipher */
 #define CRYPTO_CIPHER_AES_CBC
 
+/** AES-GCM authenticated encryption cipher */
+#define CRYPTO_CIPHER_AES_GCM
+
 /** MD5 digest algorithm
  *
  * Note that use of MD5 is implicit when using TLSv1.1 or earlier.
@@ -42,6 +51,15 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** SHA-512 digest algorithm */
 #define CRYPTO_DIGEST_SHA512
 
+/** Calculate image digests while downloading
+ *
+ * If enabled, a SHA-256 digest of each downloaded image is calculated
+ * incrementally as data arrives.  Signature verification of images
+ * signed using SHA-256 then no longer requires a second pass over the
+ * whole image.
+ */
+//#define DOWNLOAD_DIGEST_SHA256
+
 /** Margin of error (in seconds) allowed in signed timestamps
  *
  * We default to allowing a reasonable margin of error: 12 hours to
@@ -22,6 +22,11 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define TIME_EFI
 #define REBOOT_EFI
 
+#define HEAP_GROW		/* Extend heap on demand */
+
+#define	NETDEV_RX_FILL	64	/* Default receive ring fill level */
+#define	NET_NAP			/* Sleep while network is idle */
+
 #define DOWNLOAD_PROTO_FILE	/* Local filesystem access */
 
 #define	IMAGE_EFI		/* EFI image support */
@@ -44,6 +49,11 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define IOAPI_X86
 #define NAP_EFIX86
 #define	CPUID_CMD		/* x86 CPU feature detection command */
+#define	AES_NI			/* AES-NI accelerated AES */
+#define	SHA_NI			/* SHA-NI accelerated SHA-1 and SHA-256 */
+#define	GCM_PCLMUL		/* PCLMULQDQ accelerated GCM */
+#define	TCPIP_SSE2		/* SSE2 accelerated TCP/IP checksum */
+#define	CRC32C_SSE42		/* SSE4.2 accelerated CRC32C */
 #endif
 
 #if defined ( __arm__ ) || defined ( __aarch64__ )
@@ -25,4 +25,14 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 #define IMAGE_SCRIPT
 
+#define	NETDEV_RX_FILL	64	/* Default receive ring fill level */
+
+#if defined ( __i386__ ) || defined ( __x86_64__ )
+#define	AES_NI			/* AES-NI accelerated AES */
+#define	SHA_NI			/* SHA-NI accelerated SHA-1 and SHA-256 */
+#define	GCM_PCLMUL		/* PCLMULQDQ accelerated GCM */
+#define	TCPIP_SSE2		/* SSE2 accelerated TCP/IP checksum */
+#define	CRC32C_SSE42		/* SSE4.2 accelerated CRC32C */
+#endif
+
 #endif /* CONFIG_DEFAULTS_LINUX_H */
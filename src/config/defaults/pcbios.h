@@ -22,6 +22,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define TIME_RTC
 #define REBOOT_PCBIOS
 
+#define	NETDEV_RX_FILL	8	/* Default receive ring fill level */
+#define	NET_NAP			/* Sleep while network is idle */
+
 #ifdef __x86_64__
 #define IOMAP_PAGES
 #else
@@ -47,8 +50,11 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define	USB_HCD_EHCI		/* EHCI USB host controller */
 #define	USB_HCD_UHCI		/* UHCI USB host controller */
 #define	USB_KEYBOARD		/* USB keyboards */
+#define	USB_BLOCK		/* USB block devices */
 
 #define	REBOOT_CMD		/* Reboot command */
 #define	CPUID_CMD		/* x86 CPU feature detection command */
 
+#define	CRC32C_SSE42		/* SSE4.2 accelerated CRC32C */
+
 #endif /* CONFIG_DEFAULTS_PCBIOS_H */
@@ -39,6 +39,17 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define DHCP_DISC_PROXY_TIMEOUT_SEC	2
 //#define DHCP_DISC_PROXY_TIMEOUT_SEC	11	/* as per PXE spec */
 
+/*
+ * An existing lease (e.g. one handed over by a previous boot stage)
+ * may be reused by sending a DHCPREQUEST for the same address
+ * without first performing discovery (the INIT-REBOOT state of RFC
+ * 2131).  This is done only when ProxyDHCP is not expected, since
+ * ProxyDHCP offers are sent only in response to DHCPDISCOVER.  If no
+ * DHCPACK is received within this timeout, iPXE falls back to the
+ * normal discovery process.
+ */
+#define DHCP_REBOOT_TIMEOUT_SEC		2
+
 /*
  * Per the PXE spec, requests are also tried 4 times, but at timeout
  * intervals of 1, 2, 3, 4 seconds.  To adapt this to an exponential
@@ -57,8 +57,10 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #undef	DOWNLOAD_PROTO_HTTPS	/* Secure Hypertext Transfer Protocol */
 #undef	DOWNLOAD_PROTO_FTP	/* File Transfer Protocol */
 #undef	DOWNLOAD_PROTO_SLAM	/* Scalable Local Area Multicast */
+#undef	DOWNLOAD_PROTO_MCFEC	/* Multicast FEC file transfer */
 #undef	DOWNLOAD_PROTO_NFS	/* Network File System Protocol */
 //#undef DOWNLOAD_PROTO_FILE	/* Local filesystem access */
+#undef	DOWNLOAD_PROTO_CACHE	/* Local disk download cache (EFI only) */
 
 /*
  * SAN boot protocols
@@ -71,6 +73,53 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 //#undef	SANBOOT_PROTO_FCP	/* Fibre Channel protocol */
 //#undef	SANBOOT_PROTO_HTTP	/* HTTP SAN protocol */
 
+/*
+ * SAN boot block cache
+ *
+ * SAN_CACHE_SIZE is the default size (in kB) of the block cache used
+ * for each SAN device, and may be overridden using the "san-cache"
+ * setting.  A value of 0 disables the cache.
+ */
+#define SAN_CACHE_SIZE		4096
+
+/*
+ * SAN boot write-back buffer
+ *
+ * SAN_WRITEBACK_SIZE is the default size (in kB) of the buffer used
+ * to coalesce adjacent writes to each SAN device, and may be
+ * overridden using the "san-writeback" setting.  Buffered writes are
+ * flushed when the device is flushed, reset or unregistered, and
+ * before an operating system calls ExitBootServices() (on UEFI 2.8 or
+ * later).  Write-back is refused where no such handover flush exists
+ * (including INT 13 under BIOS).  A value of 0 (the default) disables
+ * write-back.
+ */
+#define SAN_WRITEBACK_SIZE	0
+
+/*
+ * Heap growth
+ *
+ * If HEAP_GROW is defined (as it is by default for EFI builds), then
+ * the internal heap will be extended on demand using umalloc(), by
+ * at least HEAP_GROW_SIZE kB at a time, before resorting to
+ * discarding cached data.  Leave HEAP_GROW undefined to retain a
+ * strictly fixed-size heap (e.g. for option ROM builds).
+ */
+//#define HEAP_GROW		/* Extend heap on demand */
+#define HEAP_GROW_SIZE		512
+
+/*
+ * Heap allocation profiling
+ *
+ * If MALLOC_PROFILE is defined, then each allocation made via
+ * malloc(), zalloc() or realloc() will be attributed to its call
+ * site, and per-call-site allocation counts, sizes, and high-water
+ * marks will be shown by the "memstat" command.  This costs one
+ * pointer per allocation.
+ */
+//#define MALLOC_PROFILE	/* Per-call-site heap allocation profiling */
+#define MALLOC_PROFILE_SITES	128
+
 /*
  * HTTP extensions
  *
@@ -78,7 +127,71 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define HTTP_AUTH_BASIC		/* Basic authentication */
 #define HTTP_AUTH_DIGEST	/* Digest authentication */
 //#define HTTP_ENC_PEERDIST	/* PeerDist content encoding */
+//#define PEERDIST_SERVER	/* Serve PeerDist content to other peers */
+//#define HTTP_ENC_GZIP		/* gzip and deflate content encodings */
+//#define HTTP_PARALLEL		/* Parallel range downloads */
 //#define HTTP_HACK_GCE		/* Google Compute Engine hacks */
+//#define HTTP_VERSION_2	/* HTTP/2 for HTTPS connections */
+
+/*
+ * TCP congestion control algorithms
+ *
+ * NewReno is always available.
+ *
+ */
+//#define TCP_CONGESTION_CUBIC	/* CUBIC congestion control */
+
+/*
+ * TCP receive processing
+ *
+ */
+//#define TCP_GRO		/* Coalesce consecutive received segments */
+
+/*
+ * Network idle behaviour
+ *
+ */
+//#define NET_NAP		/* Sleep while network is idle */
+
+/*
+ * Network boot behaviour
+ *
+ * If AUTOBOOT_PARALLEL is defined, then all candidate network devices
+ * will be opened and configured concurrently, and the first device to
+ * obtain something bootable will be used.  This avoids waiting for
+ * each device to time out in turn on systems with many unconnected
+ * ports.
+ */
+//#define AUTOBOOT_PARALLEL	/* Configure all network devices concurrently */
+
+/*
+ * Device probing behaviour
+ *
+ * If PCI_DEFERRED_PROBE is defined and a preferred PCI device is
+ * known (e.g. the device from which a PCI option ROM was invoked),
+ * then only the preferred device will be probed at startup.  All
+ * other PCI devices will be probed one at a time in the background,
+ * allowing network boot to start without waiting for slow drivers.
+ */
+//#define PCI_DEFERRED_PROBE	/* Probe non-preferred PCI devices later */
+
+/*
+ * State handover
+ *
+ * If HANDOVER is defined, then cached state (such as neighbour cache
+ * entries and DNS responses) will be handed over to a chained iPXE
+ * binary, where the platform provides a suitable mechanism.
+ */
+//#define HANDOVER		/* Hand over cached state to a chained iPXE */
+
+/*
+ * Boot timeline
+ *
+ * If TIMELINE is defined, then timestamped phase transitions (DHCP,
+ * DNS, TCP and TLS handshakes, HTTP requests, etc) will be recorded
+ * and made available via the "timeline" setting.
+ */
+//#define TIMELINE		/* Record boot timeline */
 
 /*
  * 802.11 cryptosystems and handshaking protocols
@@ -115,6 +228,8 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define	IMAGE_PNG		/* PNG image support */
 #define	IMAGE_DER		/* DER image support */
 #define	IMAGE_PEM		/* PEM image support */
+//#define	IMAGE_ZLIB		/* ZLIB image support */
+//#define	IMAGE_GZIP		/* GZIP image support */
 
 /*
  * Command-line commands to include
@@ -137,7 +252,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 //#define NSLOOKUP_CMD		/* DNS resolving command */
 //#define TIME_CMD		/* Time commands */
 //#define DIGEST_CMD		/* Image crypto digest commands */
-//#define LOTEST_CMD		/* Loopback testing commands */
+//#define LOTEST_CMD		/* Loopback testing and benchmarking commands */
 //#define VLAN_CMD		/* VLAN commands */
 //#define PXE_CMD		/* PXE commands */
 //#define REBOOT_CMD		/* Reboot command */
@@ -149,9 +264,16 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 //#define PING_CMD		/* Ping command */
 //#define CONSOLE_CMD		/* Console command */
 //#define IPSTAT_CMD		/* IP statistics commands */
+//#define TCPSTAT_CMD		/* TCP statistics commands */
 //#define PROFSTAT_CMD		/* Profiling commands */
 //#define NTP_CMD		/* NTP commands */
 //#define CERT_CMD		/* Certificate management commands */
+//#define TIMELINE_CMD		/* Boot timeline command */
+//#define TRACE_CMD		/* Tracepoint command */
+//#define HTTPBENCH_CMD		/* Download benchmarking command */
+//#define IMAGE_ARCHIVE_CMD	/* Archive image management commands */
+//#define MEMSTAT_CMD		/* Heap statistics command */
+//#define DISKWRITE_CMD		/* Local disk writing command (EFI only) */
 
 /*
  * ROM-specific options
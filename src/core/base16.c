@@ -24,11 +24,9 @@
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdint.h>
-#include <stdio.h>
 #include <errno.h>
 #include <assert.h>
 #include <ipxe/string.h>
-#include <ipxe/vsprintf.h>
 #include <ipxe/base16.h>
 
 /** @file
@@ -49,17 +47,27 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 size_t hex_encode ( char separator, const void *raw, size_t raw_len,
 		    char *data, size_t len ) {
+	static const char digits[16] = "0123456789abcdef";
 	const uint8_t *bytes = raw;
-	const char delimiter[2] = { separator, '\0' };
 	size_t used = 0;
 	unsigned int i;
 
-	if ( len )
-		data[0] = 0; /* Ensure that a terminating NUL exists */
 	for ( i = 0 ; i < raw_len ; i++ ) {
-		used += ssnprintf ( ( data + used ), ( len - used ),
-				    "%s%02x", ( used ? delimiter : "" ),
-				    bytes[i] );
+		if ( used && separator ) {
+			if ( used < len )
+				data[used] = separator;
+			used++;
+		}
+		if ( used < len )
+			data[used] = digits[ bytes[i] >> 4 ];
+		used++;
+		if ( used < len )
+			data[used] = digits[ bytes[i] & 0x0f ];
+		used++;
+	}
+	if ( len ) {
+		/* Ensure that a terminating NUL exists */
+		data[ ( used < len ) ? used : ( len - 1 ) ] = '\0';
 	}
 	return used;
 }
@@ -39,6 +39,29 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 static const char base64[64] =
 	"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
+/** Invalid character marker within base64 decoding table */
+#define BASE64_INVALID 0xff
+
+/** Base64 decoding table (indexed by 7-bit ASCII character) */
+static const uint8_t base64_decoding[128] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0x3e, 0xff, 0xff, 0xff, 0x3f,
+	0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b,
+	0x3c, 0x3d, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+	0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e,
+	0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+	0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20,
+	0x21, 0x22, 0x23, 0x24, 0x25, 0x26, 0x27, 0x28,
+	0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30,
+	0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff,
+};
+
 /**
  * Base64-encode data
  *
@@ -92,14 +115,11 @@ int base64_decode ( const char *encoded, void *data, size_t len ) {
 	const char *in = encoded;
 	uint8_t *out = data;
 	uint8_t in_char;
-	char *match;
-	int in_bits;
-	unsigned int bit = 0;
+	uint8_t in_bits;
+	uint32_t acc = 0;
+	unsigned int acc_bits = 0;
 	unsigned int pad_count = 0;
-	size_t offset;
-
-	/* Zero the output buffer */
-	memset ( data, 0, len );
+	size_t offset = 0;
 
 	/* Decode string */
 	while ( ( in_char = *(in++) ) ) {
@@ -116,7 +136,12 @@ int base64_decode ( const char *encoded, void *data, size_t len ) {
 				return -EINVAL;
 			}
 			pad_count++;
-			bit -= 2; /* unused_bits = ( 2 * pad_count ) */
+			if ( acc_bits < 2 ) {
+				DBG ( "Base64-encoded string \"%s\" has invalid "
+				      "bit length\n", encoded );
+				return -EINVAL;
+			}
+			acc_bits -= 2; /* unused_bits = ( 2 * pad_count ) */
 			continue;
 		}
 		if ( pad_count ) {
@@ -126,32 +151,32 @@ int base64_decode ( const char *encoded, void *data, size_t len ) {
 		}
 
 		/* Process normal characters */
-		match = strchr ( base64, in_char );
-		if ( ! match ) {
+		in_bits = ( ( in_char < sizeof ( base64_decoding ) ) ?
+			    base64_decoding[in_char] : BASE64_INVALID );
+		if ( in_bits == BASE64_INVALID ) {
 			DBG ( "Base64-encoded string \"%s\" contains invalid "
 			      "character '%c'\n", encoded, in_char );
 			return -EINVAL;
 		}
-		in_bits = ( match - base64 );
-
-		/* Add to raw data */
-		in_bits <<= 2;
-		offset = ( bit / 8 );
-		if ( offset < len )
-			out[offset] |= ( in_bits >> ( bit % 8 ) );
-		offset++;
-		if ( offset < len )
-			out[offset] |= ( in_bits << ( 8 - ( bit % 8 ) ) );
-		bit += 6;
+
+		/* Add to raw data, emitting each completed byte */
+		acc = ( ( acc << 6 ) | in_bits );
+		acc_bits += 6;
+		if ( acc_bits >= 8 ) {
+			acc_bits -= 8;
+			if ( offset < len )
+				out[offset] = ( acc >> acc_bits );
+			offset++;
+		}
 	}
 
 	/* Check that we decoded a whole number of bytes */
-	if ( ( bit % 8 ) != 0 ) {
+	if ( acc_bits != 0 ) {
 		DBG ( "Base64-encoded string \"%s\" has invalid bit length "
-		      "%d\n", encoded, bit );
+		      "%zd\n", encoded, ( ( 8 * offset ) + acc_bits ) );
 		return -EINVAL;
 	}
 
 	/* Return length in bytes */
-	return ( bit / 8 );
+	return offset;
 }
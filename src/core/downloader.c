@@ -24,6 +24,7 @@
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <syslog.h>
 #include <ipxe/iobuf.h>
@@ -34,7 +35,10 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/umalloc.h>
 #include <ipxe/image.h>
 #include <ipxe/xferbuf.h>
+#include <ipxe/crypto.h>
+#include <ipxe/sha256.h>
 #include <ipxe/downloader.h>
+#include <config/crypto.h>
 
 /** @file
  *
@@ -42,6 +46,13 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
+/** Digest algorithm to be calculated while downloading (if any) */
+#ifdef DOWNLOAD_DIGEST_SHA256
+#define DOWNLOAD_DIGEST &sha256_algorithm
+#else
+#define DOWNLOAD_DIGEST NULL
+#endif
+
 /** A downloader */
 struct downloader {
 	/** Reference count for this object */
@@ -56,6 +67,13 @@ struct downloader {
 	struct image *image;
 	/** Data transfer buffer */
 	struct xfer_buffer buffer;
+
+	/** Digest algorithm (if digest is being calculated) */
+	struct digest_algorithm *digest;
+	/** Digest context */
+	void *digest_ctx;
+	/** Length of data included in digest */
+	size_t digest_len;
 };
 
 /**
@@ -68,9 +86,69 @@ static void downloader_free ( struct refcnt *refcnt ) {
 		container_of ( refcnt, struct downloader, refcnt );
 
 	image_put ( downloader->image );
+	free ( downloader->digest_ctx );
 	free ( downloader );
 }
 
+/**
+ * Stop calculating digest
+ *
+ * @v downloader	Downloader
+ */
+static void downloader_digest_stop ( struct downloader *downloader ) {
+
+	free ( downloader->digest_ctx );
+	downloader->digest_ctx = NULL;
+	downloader->digest = NULL;
+}
+
+/**
+ * Add received data to digest
+ *
+ * @v downloader	Downloader
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ *
+ * The digest can be calculated incrementally only while data arrives
+ * strictly in order.  If any data arrives out of order (e.g. via a
+ * multicast protocol, or a retried transfer), then we give up on the
+ * digest and leave it to be calculated from the complete image.
+ */
+static void downloader_digest ( struct downloader *downloader,
+				struct io_buffer *iobuf,
+				struct xfer_metadata *meta ) {
+	size_t len = iob_len ( iobuf );
+	size_t pos;
+
+	/* Do nothing unless we are calculating a digest */
+	if ( ! downloader->digest )
+		return;
+
+	/* Ignore pure seeks (e.g. from xfer_presize()) */
+	if ( ! len )
+		return;
+
+	/* Calculate position of this data */
+	pos = downloader->buffer.pos;
+	if ( meta->flags & XFER_FL_ABS_OFFSET )
+		pos = 0;
+	pos += meta->offset;
+
+	/* Stop calculating digest if data is out of order */
+	if ( pos != downloader->digest_len ) {
+		DBGC ( downloader, "DOWNLOADER %p abandoning digest at %#zx "
+		       "(received %#zx)\n", downloader,
+		       downloader->digest_len, pos );
+		downloader_digest_stop ( downloader );
+		return;
+	}
+
+	/* Add data to digest */
+	digest_update ( downloader->digest, downloader->digest_ctx,
+			iobuf->data, len );
+	downloader->digest_len += len;
+}
+
 /**
  * Terminate download
  *
@@ -91,6 +169,15 @@ static void downloader_finished ( struct downloader *downloader, int rc ) {
 	/* Update image length */
 	downloader->image->len = downloader->buffer.len;
 
+	/* Record digest, if it covers the whole image */
+	if ( ( rc == 0 ) && downloader->digest &&
+	     ( downloader->digest_len == downloader->buffer.len ) ) {
+		digest_final ( downloader->digest, downloader->digest_ctx,
+			       downloader->image->digest_value );
+		downloader->image->digest = downloader->digest;
+	}
+	downloader_digest_stop ( downloader );
+
 	/* Shut down interfaces */
 	intf_shutdown ( &downloader->xfer, rc );
 	intf_shutdown ( &downloader->job, rc );
@@ -141,6 +228,9 @@ static int downloader_deliver ( struct downloader *downloader,
 				struct xfer_metadata *meta ) {
 	int rc;
 
+	/* Add data to digest */
+	downloader_digest ( downloader, iobuf, meta );
+
 	/* Add data to buffer */
 	if ( ( rc = xferbuf_deliver ( &downloader->buffer, iob_disown ( iobuf ),
 				      meta ) ) != 0 )
@@ -162,6 +252,9 @@ static int downloader_deliver ( struct downloader *downloader,
 static struct xfer_buffer *
 downloader_buffer ( struct downloader *downloader ) {
 
+	/* Data written directly to the buffer will bypass the digest */
+	downloader_digest_stop ( downloader );
+
 	/* Provide direct access to underlying data transfer buffer */
 	return &downloader->buffer;
 }
@@ -243,12 +336,14 @@ static struct interface_descriptor downloader_job_desc =
  *
  * @v job		Job control interface
  * @v image		Image to fill with downloaded file
+ * @v digest		Digest algorithm to calculate, or NULL for default
  * @ret rc		Return status code
  *
  * Instantiates a downloader object to download the content of the
  * specified image from its URI.
  */
-int create_downloader ( struct interface *job, struct image *image ) {
+int create_downloader ( struct interface *job, struct image *image,
+			struct digest_algorithm *digest ) {
 	struct downloader *downloader;
 	int rc;
 
@@ -264,6 +359,18 @@ int create_downloader ( struct interface *job, struct image *image ) {
 	downloader->image = image_get ( image );
 	xferbuf_umalloc_init ( &downloader->buffer, &image->data );
 
+	/* Start calculating digest, if applicable */
+	downloader->digest = ( digest ? digest : DOWNLOAD_DIGEST );
+	if ( downloader->digest ) {
+		downloader->digest_ctx = malloc ( downloader->digest->ctxsize );
+		if ( downloader->digest_ctx ) {
+			digest_init ( downloader->digest,
+				      downloader->digest_ctx );
+		} else {
+			downloader->digest = NULL;
+		}
+	}
+
 	/* Instantiate child objects and attach to our interfaces */
 	if ( ( rc = xfer_open_uri ( &downloader->xfer, image->uri ) ) != 0 )
 		goto err;
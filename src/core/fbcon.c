@@ -156,16 +156,27 @@ static void fbcon_store ( struct fbcon *fbcon, struct fbcon_text_cell *cell,
  */
 static void fbcon_draw ( struct fbcon *fbcon, struct fbcon_text_cell *cell,
 			 unsigned int xpos, unsigned int ypos ) {
+	struct fbcon_text_cell displayed;
 	uint8_t glyph[fbcon->font->height];
+	uint8_t pixels[ FBCON_CHAR_WIDTH * sizeof ( uint32_t ) ];
 	size_t offset;
 	size_t pixel_len;
-	size_t skip_len;
 	unsigned int row;
 	unsigned int column;
 	uint8_t bitmask;
+	uint8_t *dst;
 	int transparent;
 	void *src;
 
+	/* Do nothing if this cell is already displayed */
+	offset = ( ( ( ypos * fbcon->character.width ) + xpos ) *
+		   sizeof ( displayed ) );
+	copy_from_user ( &displayed, fbcon->display.start, offset,
+			 sizeof ( displayed ) );
+	if ( memcmp ( &displayed, cell, sizeof ( displayed ) ) == 0 )
+		return;
+	copy_to_user ( fbcon->display.start, offset, cell, sizeof ( *cell ) );
+
 	/* Get font character */
 	fbcon->font->glyph ( cell->character, glyph );
 
@@ -174,29 +185,30 @@ static void fbcon_draw ( struct fbcon *fbcon, struct fbcon_text_cell *cell,
 		   ( ypos * fbcon->character.stride ) +
 		   ( xpos * fbcon->character.len ) );
 	pixel_len = fbcon->pixel->len;
-	skip_len = ( fbcon->pixel->stride - fbcon->character.len );
 
 	/* Check for transparent background colour */
 	transparent = ( cell->background == FBCON_TRANSPARENT );
 
-	/* Draw character rows */
+	/* Draw character rows.  Each row is constructed in a local
+	 * buffer and written to the frame buffer in a single copy.
+	 */
 	for ( row = 0 ; row < fbcon->font->height ; row++ ) {
 
-		/* Draw background picture, if applicable */
+		/* Start with background picture, if applicable */
 		if ( transparent ) {
 			if ( fbcon->picture.start ) {
-				memcpy_user ( fbcon->start, offset,
-					      fbcon->picture.start, offset,
-					      fbcon->character.len );
+				copy_from_user ( pixels, fbcon->picture.start,
+						 offset,
+						 fbcon->character.len );
 			} else {
-				memset_user ( fbcon->start, offset, 0,
-					      fbcon->character.len );
+				memset ( pixels, 0, fbcon->character.len );
 			}
 		}
 
-		/* Draw character row */
-		for ( column = FBCON_CHAR_WIDTH, bitmask = glyph[row] ;
-		      column ; column--, bitmask <<= 1, offset += pixel_len ) {
+		/* Construct character row */
+		for ( column = FBCON_CHAR_WIDTH, bitmask = glyph[row],
+			      dst = pixels ; column ;
+		      column--, bitmask <<= 1, dst += pixel_len ) {
 			if ( bitmask & 0x80 ) {
 				src = &cell->foreground;
 			} else if ( ! transparent ) {
@@ -204,17 +216,22 @@ static void fbcon_draw ( struct fbcon *fbcon, struct fbcon_text_cell *cell,
 			} else {
 				continue;
 			}
-			copy_to_user ( fbcon->start, offset, src, pixel_len );
+			memcpy ( dst, src, pixel_len );
 		}
 
-		/* Move to next row */
-		offset += skip_len;
+		/* Draw character row and move to next row */
+		copy_to_user ( fbcon->start, offset, pixels,
+			       fbcon->character.len );
+		offset += fbcon->pixel->stride;
 	}
 }
 
 /**
  * Redraw all characters
  *
+ * Only characters which differ from those already displayed will be
+ * drawn.
+ *
  * @v fbcon		Frame buffer console
  */
 static void fbcon_redraw ( struct fbcon *fbcon ) {
@@ -254,7 +271,11 @@ static void fbcon_scroll ( struct fbcon *fbcon ) {
 	/* Update cursor position */
 	fbcon->ypos--;
 
-	/* Redraw all characters */
+	/* Redraw any changed characters.  There is no portable way
+	 * to scroll the frame buffer itself, and reading back from
+	 * frame buffer memory is often extremely slow, so we rely on
+	 * skipping the (typically many) cells that are unchanged.
+	 */
 	fbcon_redraw ( fbcon );
 }
 
@@ -585,6 +606,7 @@ int fbcon_init ( struct fbcon *fbcon, userptr_t start,
 		 struct fbcon_colour_map *map,
 		 struct fbcon_font *font,
 		 struct console_configuration *config ) {
+	size_t text_len;
 	int width;
 	int height;
 	unsigned int xgap;
@@ -669,15 +691,27 @@ int fbcon_init ( struct fbcon *fbcon, userptr_t start,
 	fbcon_set_default_background ( fbcon );
 
 	/* Allocate and initialise stored character array */
-	fbcon->text.start = umalloc ( fbcon->character.width *
-				      fbcon->character.height *
-				      sizeof ( struct fbcon_text_cell ) );
+	text_len = ( fbcon->character.width * fbcon->character.height *
+		     sizeof ( struct fbcon_text_cell ) );
+	fbcon->text.start = umalloc ( text_len );
 	if ( ! fbcon->text.start ) {
 		rc = -ENOMEM;
 		goto err_text;
 	}
 	fbcon_clear ( fbcon, 0 );
 
+	/* Allocate and initialise displayed character array.  The
+	 * cleared character array consists of spaces on a transparent
+	 * background, which matches the initial frame buffer content.
+	 */
+	fbcon->display.start = umalloc ( text_len );
+	if ( ! fbcon->display.start ) {
+		rc = -ENOMEM;
+		goto err_display;
+	}
+	memcpy_user ( fbcon->display.start, 0, fbcon->text.start, 0,
+		      text_len );
+
 	/* Set framebuffer to all black (including margins) */
 	memset_user ( fbcon->start, 0, 0, fbcon->len );
 
@@ -699,6 +733,8 @@ int fbcon_init ( struct fbcon *fbcon, userptr_t start,
 
 	ufree ( fbcon->picture.start );
  err_picture:
+	ufree ( fbcon->display.start );
+ err_display:
 	ufree ( fbcon->text.start );
  err_text:
  err_margin:
@@ -713,5 +749,6 @@ int fbcon_init ( struct fbcon *fbcon, userptr_t start,
 void fbcon_fini ( struct fbcon *fbcon ) {
 
 	ufree ( fbcon->text.start );
+	ufree ( fbcon->display.start );
 	ufree ( fbcon->picture.start );
 }
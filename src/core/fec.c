@@ -0,0 +1,313 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+/** @file
+ *
+ * Reed-Solomon forward error correction
+ *
+ * This is a systematic erasure code over GF(2^8).  A source block
+ * consists of k equal-length source symbols, which are used
+ * unmodified as encoding symbols 0 to k-1.  Repair symbol i (for
+ * k <= i < 256) is the linear combination
+ *
+ *    R_i = sum_j ( S_j / ( i + j ) )
+ *
+ * over all source symbols S_j, where addition is exclusive-OR.  The
+ * coefficients form a Cauchy matrix, every square submatrix of which
+ * is invertible.  Any k distinct encoding symbols are therefore
+ * sufficient to recover the whole source block.
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <ipxe/fec.h>
+
+/** GF(2^8) reducing polynomial (x^8 + x^4 + x^3 + x^2 + 1) */
+#define FEC_POLY 0x11d
+
+/** GF(2^8) logarithm table */
+static uint8_t fec_log[256];
+
+/** GF(2^8) exponentiation table (doubled to avoid reductions) */
+static uint8_t fec_exp[ 2 * 255 ];
+
+/**
+ * Construct GF(2^8) logarithm and exponentiation tables
+ *
+ */
+static void fec_init ( void ) {
+	unsigned int value;
+	unsigned int i;
+
+	/* Do nothing if tables have already been constructed */
+	if ( fec_exp[0] )
+		return;
+
+	/* Construct tables using generator 2 */
+	for ( value = 1, i = 0 ; i < 255 ; i++ ) {
+		fec_exp[i] = fec_exp[ i + 255 ] = value;
+		fec_log[value] = i;
+		value <<= 1;
+		if ( value & 0x100 )
+			value ^= FEC_POLY;
+	}
+}
+
+/**
+ * Multiply in GF(2^8)
+ *
+ * @v a			Multiplicand
+ * @v b			Multiplier
+ * @ret product		Product
+ */
+static unsigned int fec_mul ( unsigned int a, unsigned int b ) {
+
+	if ( ! ( a && b ) )
+		return 0;
+	return fec_exp[ fec_log[a] + fec_log[b] ];
+}
+
+/**
+ * Invert in GF(2^8)
+ *
+ * @v a			Non-zero value
+ * @ret inverse		Multiplicative inverse
+ */
+static unsigned int fec_inv ( unsigned int a ) {
+
+	assert ( a != 0 );
+	return fec_exp[ 255 - fec_log[a] ];
+}
+
+/**
+ * Calculate repair symbol coefficient
+ *
+ * @v index		Repair symbol index
+ * @v source		Source symbol index
+ * @ret coeff		Coefficient
+ */
+static unsigned int fec_coeff ( unsigned int index, unsigned int source ) {
+
+	assert ( index > source );
+	assert ( index < FEC_MAX_SYMBOLS );
+	return fec_inv ( index ^ source );
+}
+
+/**
+ * Multiply symbol by constant and add to accumulator
+ *
+ * @v acc		Accumulator symbol
+ * @v data		Symbol
+ * @v coeff		Constant
+ * @v len		Symbol length
+ */
+static void fec_mul_add ( uint8_t *acc, const uint8_t *data,
+			  unsigned int coeff, size_t len ) {
+	const uint8_t *exp;
+	unsigned int byte;
+
+	/* Handle trivial cases */
+	if ( ! coeff )
+		return;
+
+	/* Multiply-accumulate each byte */
+	exp = &fec_exp[ fec_log[coeff] ];
+	while ( len-- ) {
+		byte = *(data++);
+		if ( byte )
+			*acc ^= exp[ fec_log[byte] ];
+		acc++;
+	}
+}
+
+/**
+ * Multiply symbol by constant in place
+ *
+ * @v data		Symbol
+ * @v coeff		Non-zero constant
+ * @v len		Symbol length
+ */
+static void fec_scale ( uint8_t *data, unsigned int coeff, size_t len ) {
+	const uint8_t *exp;
+
+	/* Handle trivial case */
+	if ( coeff == 1 )
+		return;
+
+	/* Multiply each byte */
+	exp = &fec_exp[ fec_log[coeff] ];
+	for ( ; len-- ; data++ ) {
+		if ( *data )
+			*data = exp[ fec_log[*data] ];
+	}
+}
+
+/**
+ * Construct repair symbol
+ *
+ * @v k			Number of source symbols
+ * @v source		Source symbols
+ * @v index		Repair symbol index (k <= index < 256)
+ * @v repair		Repair symbol to fill in
+ * @v len		Symbol length
+ */
+void fec_encode ( unsigned int k, const void **source, unsigned int index,
+		  void *repair, size_t len ) {
+	unsigned int i;
+
+	/* Sanity checks */
+	assert ( index >= k );
+	assert ( index < FEC_MAX_SYMBOLS );
+
+	/* Construct tables, if necessary */
+	fec_init();
+
+	/* Accumulate weighted source symbols */
+	memset ( repair, 0, len );
+	for ( i = 0 ; i < k ; i++ )
+		fec_mul_add ( repair, source[i], fec_coeff ( index, i ), len );
+}
+
+/**
+ * Recover missing source symbols
+ *
+ * @v k			Number of source symbols
+ * @v source		Source symbols
+ * @v missing		Indices of missing source symbols
+ * @v repair		Repair symbols
+ * @v index		Indices of repair symbols
+ * @v count		Number of missing source symbols (and repair symbols)
+ * @v len		Symbol length
+ * @ret rc		Return status code
+ *
+ * Each source symbol buffer listed in @c missing will be filled in.
+ * The repair symbols are used as working space, and are destroyed.
+ */
+int fec_decode ( unsigned int k, void **source, const uint8_t *missing,
+		 void **repair, const uint8_t *index, unsigned int count,
+		 size_t len ) {
+	uint8_t is_missing[k];
+	uint8_t *matrix;
+	uint8_t *row;
+	uint8_t *other;
+	void *tmp;
+	unsigned int coeff;
+	unsigned int pivot;
+	unsigned int i;
+	unsigned int j;
+
+	/* Do nothing unless there are missing symbols */
+	if ( ! count )
+		return 0;
+
+	/* Construct tables, if necessary */
+	fec_init();
+
+	/* Identify missing source symbols */
+	memset ( is_missing, 0, sizeof ( is_missing ) );
+	for ( i = 0 ; i < count ; i++ ) {
+		assert ( missing[i] < k );
+		is_missing[ missing[i] ] = 1;
+	}
+
+	/* Allocate coefficient matrix */
+	matrix = malloc ( count * count );
+	if ( ! matrix )
+		return -ENOMEM;
+
+	/* Remove contribution of each received source symbol from
+	 * each repair symbol, and construct the matrix of
+	 * coefficients relating the remaining repair symbol values
+	 * to the missing source symbols.
+	 */
+	for ( i = 0 ; i < count ; i++ ) {
+		for ( j = 0 ; j < k ; j++ ) {
+			if ( ! is_missing[j] ) {
+				fec_mul_add ( repair[i], source[j],
+					      fec_coeff ( index[i], j ), len );
+			}
+		}
+		row = &matrix[ i * count ];
+		for ( j = 0 ; j < count ; j++ )
+			row[j] = fec_coeff ( index[i], missing[j] );
+	}
+
+	/* Reduce matrix to the identity using Gauss-Jordan
+	 * elimination, applying the same row operations to the
+	 * repair symbols.  The matrix is a Cauchy matrix and so is
+	 * always invertible; a zero pivot is impossible.
+	 */
+	for ( i = 0 ; i < count ; i++ ) {
+
+		/* Find a row with a non-zero pivot */
+		for ( pivot = i ; pivot < count ; pivot++ ) {
+			if ( matrix[ pivot * count + i ] )
+				break;
+		}
+		assert ( pivot < count );
+
+		/* Swap pivot row into place */
+		if ( pivot != i ) {
+			row = &matrix[ i * count ];
+			other = &matrix[ pivot * count ];
+			for ( j = 0 ; j < count ; j++ ) {
+				coeff = row[j];
+				row[j] = other[j];
+				other[j] = coeff;
+			}
+			tmp = repair[i];
+			repair[i] = repair[pivot];
+			repair[pivot] = tmp;
+		}
+
+		/* Normalise pivot row */
+		row = &matrix[ i * count ];
+		coeff = fec_inv ( row[i] );
+		for ( j = 0 ; j < count ; j++ )
+			row[j] = fec_mul ( row[j], coeff );
+		fec_scale ( repair[i], coeff, len );
+
+		/* Eliminate pivot column from all other rows */
+		for ( pivot = 0 ; pivot < count ; pivot++ ) {
+			if ( pivot == i )
+				continue;
+			other = &matrix[ pivot * count ];
+			coeff = other[i];
+			if ( ! coeff )
+				continue;
+			for ( j = 0 ; j < count ; j++ )
+				other[j] ^= fec_mul ( row[j], coeff );
+			fec_mul_add ( repair[pivot], repair[i], coeff, len );
+		}
+	}
+
+	/* Copy out recovered source symbols */
+	for ( i = 0 ; i < count ; i++ )
+		memcpy ( source[ missing[i] ], repair[i], len );
+
+	free ( matrix );
+	return 0;
+}
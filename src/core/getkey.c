@@ -28,7 +28,6 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/process.h>
 #include <ipxe/keys.h>
 #include <ipxe/timer.h>
-#include <ipxe/nap.h>
 
 /** @file
  *
@@ -43,6 +42,11 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  * @v timeout		Timeout period, in ticks (0=indefinite)
  * @ret character	Character read from console
+ *
+ * The CPU is not put to sleep between polls, since doing so would
+ * starve any background transfers (which rely upon the network
+ * device being polled).  Sleeping while the network is idle is
+ * handled by net_nap(), if enabled.
  */
 static int getchar_timeout ( unsigned long timeout ) {
 	unsigned long start = currticks();
@@ -51,7 +55,6 @@ static int getchar_timeout ( unsigned long timeout ) {
 		step();
 		if ( iskey() )
 			return getchar();
-		cpu_nap();
 	}
 
 	return -1;
@@ -0,0 +1,219 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <ipxe/handover.h>
+
+/** @file
+ *
+ * State handover to a chained iPXE
+ *
+ * When one iPXE binary chainloads another (e.g. undionly.kpxe
+ * chainloading ipxe.efi), the second binary would otherwise have to
+ * rediscover everything that the first binary already knew.  A state
+ * handover block allows cached state (such as neighbour cache
+ * entries and DNS responses) to be passed to the chained binary via
+ * whatever mechanism the platform provides.
+ *
+ * The block consists of a header followed by a sequence of records,
+ * each identified by a type and generated by the corresponding
+ * state handover provider.  Records of unknown type are ignored.
+ */
+
+/**
+ * Find state handover provider
+ *
+ * @v type		Record type
+ * @ret provider	State handover provider, or NULL if not found
+ */
+static struct handover_provider * handover_find ( unsigned int type ) {
+	struct handover_provider *provider;
+
+	for_each_table_entry ( provider, HANDOVER_PROVIDERS ) {
+		if ( provider->type == type )
+			return provider;
+	}
+	return NULL;
+}
+
+/**
+ * Construct state handover block
+ *
+ * @v data		Buffer to fill in, or NULL
+ * @v len		Length of buffer
+ * @ret len		Length of state handover block
+ */
+static size_t handover_build ( void *data, size_t len ) {
+	struct handover_header *hdr = data;
+	struct handover_record *record;
+	struct handover_provider *provider;
+	size_t offset = sizeof ( *hdr );
+	size_t remaining;
+	size_t record_len;
+
+	/* Construct records */
+	for_each_table_entry ( provider, HANDOVER_PROVIDERS ) {
+
+		/* Save state, if space permits */
+		if ( ( offset + sizeof ( *record ) ) <= len ) {
+			record = ( data + offset );
+			remaining = ( len - offset - sizeof ( *record ) );
+		} else {
+			record = NULL;
+			remaining = 0;
+		}
+		record_len = provider->save ( ( record ? record->data : NULL ),
+					      remaining );
+		if ( ! record_len )
+			continue;
+
+		/* Fill in record header */
+		if ( record && ( record_len <= remaining ) ) {
+			record->type = provider->type;
+			record->reserved = 0;
+			record->len = record_len;
+			DBG ( "HANDOVER saved %s state (%zd bytes)\n",
+			      provider->name, record_len );
+		}
+		offset += ( ( sizeof ( *record ) + record_len +
+			      HANDOVER_ALIGN - 1 ) & ~( HANDOVER_ALIGN - 1 ) );
+	}
+
+	/* Fill in header */
+	if ( offset <= len ) {
+		hdr->magic = HANDOVER_MAGIC;
+		hdr->version = HANDOVER_VERSION;
+		hdr->len = offset;
+	}
+
+	return offset;
+}
+
+/**
+ * Save state for handover to a chained iPXE
+ *
+ * @ret data		State handover block
+ * @ret len		Length of state handover block
+ * @ret rc		Return status code
+ *
+ * The caller is responsible for eventually calling free() on the
+ * state handover block.
+ */
+int handover_save ( void **data, size_t *len ) {
+	size_t check_len;
+
+	/* Calculate length of state handover block */
+	*len = handover_build ( NULL, 0 );
+
+	/* Allocate state handover block */
+	*data = zalloc ( *len );
+	if ( ! *data )
+		return -ENOMEM;
+
+	/* Construct state handover block */
+	check_len = handover_build ( *data, *len );
+	if ( check_len != *len ) {
+		DBG ( "HANDOVER length changed from %zd to %zd bytes\n",
+		      *len, check_len );
+		free ( *data );
+		*data = NULL;
+		return -EAGAIN;
+	}
+
+	return 0;
+}
+
+/**
+ * Restore state handed over from a previous iPXE
+ *
+ * @v data		State handover block
+ * @v len		Maximum length of state handover block
+ * @ret rc		Return status code
+ */
+int handover_restore ( const void *data, size_t len ) {
+	const struct handover_header *hdr = data;
+	const struct handover_record *record;
+	struct handover_provider *provider;
+	size_t offset = sizeof ( *hdr );
+	size_t remaining;
+	int rc;
+
+	/* Sanity checks */
+	if ( len < sizeof ( *hdr ) ) {
+		DBG ( "HANDOVER underlength header\n" );
+		return -EINVAL;
+	}
+	if ( hdr->magic != HANDOVER_MAGIC ) {
+		DBG ( "HANDOVER invalid signature %#08x\n", hdr->magic );
+		return -EINVAL;
+	}
+	if ( hdr->version != HANDOVER_VERSION ) {
+		DBG ( "HANDOVER unsupported version %d\n", hdr->version );
+		return -ENOTSUP;
+	}
+	if ( ( hdr->len < sizeof ( *hdr ) ) || ( hdr->len > len ) ) {
+		DBG ( "HANDOVER invalid length %d\n", hdr->len );
+		return -EINVAL;
+	}
+	len = hdr->len;
+
+	/* Restore records */
+	while ( offset < len ) {
+
+		/* Parse record header */
+		record = ( data + offset );
+		remaining = ( len - offset );
+		if ( ( remaining < sizeof ( *record ) ) ||
+		     ( record->len > ( remaining - sizeof ( *record ) ) ) ) {
+			DBG ( "HANDOVER invalid record at offset %#zx\n",
+			      offset );
+			return -EINVAL;
+		}
+		offset += ( ( sizeof ( *record ) + record->len +
+			      HANDOVER_ALIGN - 1 ) & ~( HANDOVER_ALIGN - 1 ) );
+
+		/* Identify provider */
+		provider = handover_find ( record->type );
+		if ( ! provider ) {
+			DBG ( "HANDOVER ignoring unknown record type %#04x\n",
+			      record->type );
+			continue;
+		}
+
+		/* Restore state.  Failure is not fatal, since the
+		 * state will simply be rediscovered.
+		 */
+		if ( ( rc = provider->restore ( record->data,
+						record->len ) ) != 0 ) {
+			DBG ( "HANDOVER could not restore %s state: %s\n",
+			      provider->name, strerror ( rc ) );
+			continue;
+		}
+		DBG ( "HANDOVER restored %s state (%d bytes)\n",
+		      provider->name, record->len );
+	}
+
+	return 0;
+}
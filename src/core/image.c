@@ -33,6 +33,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <syslog.h>
 #include <ipxe/list.h>
 #include <ipxe/umalloc.h>
+#include <ipxe/crypto.h>
 #include <ipxe/uri.h>
 #include <ipxe/image.h>
 
@@ -481,3 +482,39 @@ int image_set_trust ( int require_trusted, int permanent ) {
 
 	return 0;
 }
+
+/**
+ * Calculate image digest
+ *
+ * @v image		Image
+ * @v digest		Digest algorithm
+ * @v out		Digest output
+ *
+ * The precomputed digest will be used if it was calculated using the
+ * same algorithm, otherwise the digest is calculated from the image
+ * data.
+ */
+void image_digest ( struct image *image, struct digest_algorithm *digest,
+		    void *out ) {
+	uint8_t ctx[digest->ctxsize];
+	uint8_t buf[128];
+	size_t offset;
+	size_t frag_len;
+
+	/* Use precomputed digest, if available */
+	if ( image->digest == digest ) {
+		memcpy ( out, image->digest_value, digest->digestsize );
+		return;
+	}
+
+	/* Calculate digest */
+	digest_init ( digest, ctx );
+	for ( offset = 0 ; offset < image->len ; offset += frag_len ) {
+		frag_len = ( image->len - offset );
+		if ( frag_len > sizeof ( buf ) )
+			frag_len = sizeof ( buf );
+		copy_from_user ( buf, image->data, offset, frag_len );
+		digest_update ( digest, ctx, buf, frag_len );
+	}
+	digest_final ( digest, ctx, out );
+}
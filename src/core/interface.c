@@ -64,6 +64,9 @@ struct interface_descriptor null_intf_desc =
 /** The null interface */
 struct interface null_intf = INTF_INIT ( null_intf_desc );
 
+/** Object interface operation lookup generation */
+unsigned long intf_generation = 1;
+
 /*****************************************************************************
  *
  * Object interface plumbing
@@ -87,6 +90,7 @@ void intf_plug ( struct interface *intf, struct interface *dest ) {
 	intf_get ( dest );
 	intf_put ( intf->dest );
 	intf->dest = dest;
+	intf_invalidate();
 }
 
 /**
@@ -114,6 +118,7 @@ void intf_unplug ( struct interface *intf ) {
 	       INTF_INTF_DBG ( intf, intf->dest ) );
 	intf_put ( intf->dest );
 	intf->dest = &null_intf;
+	intf_invalidate();
 }
 
 /**
@@ -123,6 +128,7 @@ void intf_unplug ( struct interface *intf ) {
  */
 void intf_nullify ( struct interface *intf ) {
 	intf->desc = &null_intf_desc;
+	intf_invalidate();
 }
 
 /**
@@ -206,8 +212,16 @@ void * intf_get_dest_op_no_passthru_untyped ( struct interface *intf,
  */
 void * intf_get_dest_op_untyped ( struct interface *intf, void *type,
 				  struct interface **dest ) {
+	struct interface_cache *cache = &intf->cache;
 	void *func;
 
+	/* Use cached lookup, if still valid */
+	if ( ( cache->generation == intf_generation ) &&
+	     ( cache->type == type ) ) {
+		*dest = intf_get ( cache->dest );
+		return cache->func;
+	}
+
 	while ( 1 ) {
 
 		/* Search for an implementing method provided by the
@@ -215,13 +229,21 @@ void * intf_get_dest_op_untyped ( struct interface *intf, void *type,
 		 */
 		func = intf_get_dest_op_no_passthru_untyped( intf, type, dest );
 		if ( func )
-			return func;
+			break;
 
 		/* Pass through to the underlying interface, if applicable */
 		if ( ! ( intf = intf_get_passthru ( *dest ) ) )
-			return NULL;
+			break;
 		intf_put ( *dest );
 	}
+
+	/* Cache lookup */
+	cache->generation = intf_generation;
+	cache->type = type;
+	cache->func = func;
+	cache->dest = *dest;
+
+	return func;
 }
 
 /*****************************************************************************
@@ -281,7 +303,9 @@ void intf_shutdown ( struct interface *intf, int rc ) {
 
 	/* Transfer destination to temporary interface */
 	tmp.dest = intf->dest;
+	tmp.cache.generation = 0;
 	intf->dest = &null_intf;
+	intf_invalidate();
 
 	/* Notify destination of close via temporary interface */
 	intf_close ( &tmp, rc );
@@ -27,6 +27,8 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <strings.h>
 #include <errno.h>
 #include <ipxe/malloc.h>
+#include <ipxe/io.h>
+#include <ipxe/list.h>
 #include <ipxe/iobuf.h>
 
 /** @file
@@ -35,6 +37,80 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
+/** A pool of free receive I/O buffers of a fixed length */
+struct io_buffer_pool {
+	/** Requested length (or zero if this pool is unused) */
+	size_t len;
+	/** Actual length of each buffer (or zero if not yet known) */
+	size_t size;
+	/** List of free I/O buffers */
+	struct list_head list;
+	/** Number of free I/O buffers */
+	unsigned int count;
+};
+
+/** Receive I/O buffer pools */
+static struct io_buffer_pool iob_pools[IOB_POOL_COUNT];
+
+/**
+ * Find (or create) receive I/O buffer pool
+ *
+ * @v len		Requested length
+ * @ret pool		I/O buffer pool, or NULL if no pool is available
+ */
+static struct io_buffer_pool * iob_pool ( size_t len ) {
+	struct io_buffer_pool *pool;
+	unsigned int i;
+
+	/* Find existing pool, or use first unused pool */
+	for ( i = 0 ; i < IOB_POOL_COUNT ; i++ ) {
+		pool = &iob_pools[i];
+		if ( pool->len == len )
+			return pool;
+		if ( ! pool->len ) {
+			pool->len = len;
+			INIT_LIST_HEAD ( &pool->list );
+			return pool;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Return I/O buffer to a receive I/O buffer pool, if applicable
+ *
+ * @v iobuf		I/O buffer
+ * @ret recycled	I/O buffer was returned to a pool
+ *
+ * Any I/O buffer that is indistinguishable from one returned by
+ * alloc_iob() for a pooled length (i.e. one with the same actual
+ * length and at least the same physical alignment) may be recycled,
+ * regardless of how it was originally allocated.
+ */
+static int iob_recycle ( struct io_buffer *iobuf ) {
+	struct io_buffer_pool *pool;
+	size_t size = ( iobuf->end - iobuf->head );
+	size_t align;
+	unsigned int i;
+
+	for ( i = 0 ; i < IOB_POOL_COUNT ; i++ ) {
+		pool = &iob_pools[i];
+		if ( ( ! pool->size ) || ( pool->size != size ) )
+			continue;
+		if ( pool->count >= IOB_POOL_MAX )
+			return 0;
+		align = ( 1UL << fls ( pool->len - 1 ) );
+		if ( virt_to_phys ( iobuf->head ) & ( align - 1 ) )
+			return 0;
+		list_add ( &iobuf->list, &pool->list );
+		pool->count++;
+		return 1;
+	}
+
+	return 0;
+}
+
 /**
  * Allocate I/O buffer with specified alignment and offset
  *
@@ -112,6 +188,7 @@ struct io_buffer * alloc_iob_raw ( size_t len, size_t align, size_t offset ) {
 	/* Populate descriptor */
 	iobuf->head = iobuf->data = iobuf->tail = data;
 	iobuf->end = ( data + len );
+	iobuf->flags = 0;
 
 	return iobuf;
 }
@@ -138,21 +215,49 @@ struct io_buffer * alloc_iob ( size_t len ) {
 }
 
 /**
- * Free I/O buffer
+ * Allocate I/O buffer for a receive ring
  *
- * @v iobuf	I/O buffer
+ * @v len	Required length of buffer
+ * @ret iobuf	I/O buffer, or NULL if none available
+ *
+ * The I/O buffer will be aligned as for alloc_iob().  Buffers of the
+ * same length will be recycled when freed, so that refilling a
+ * receive ring in the steady state requires no heap allocation.
  */
-void free_iob ( struct io_buffer *iobuf ) {
-	size_t len;
+struct io_buffer * alloc_rx_iob ( size_t len ) {
+	struct io_buffer_pool *pool;
+	struct io_buffer *iobuf;
 
-	/* Allow free_iob(NULL) to be valid */
-	if ( ! iobuf )
-		return;
+	/* Pad to minimum length */
+	if ( len < IOB_ZLEN )
+		len = IOB_ZLEN;
 
-	/* Sanity checks */
-	assert ( iobuf->head <= iobuf->data );
-	assert ( iobuf->data <= iobuf->tail );
-	assert ( iobuf->tail <= iobuf->end );
+	/* Reuse a pooled I/O buffer, if available */
+	pool = iob_pool ( len );
+	if ( pool && pool->count ) {
+		iobuf = list_first_entry ( &pool->list, struct io_buffer,
+					   list );
+		list_del ( &iobuf->list );
+		pool->count--;
+		iobuf->data = iobuf->tail = iobuf->head;
+		iobuf->flags = 0;
+		return iobuf;
+	}
+
+	/* Otherwise, allocate a new I/O buffer */
+	iobuf = alloc_iob ( len );
+	if ( iobuf && pool )
+		pool->size = ( iobuf->end - iobuf->head );
+	return iobuf;
+}
+
+/**
+ * Free I/O buffer memory
+ *
+ * @v iobuf	I/O buffer
+ */
+static void free_iob_raw ( struct io_buffer *iobuf ) {
+	size_t len;
 
 	/* Free buffer */
 	len = ( iobuf->end - iobuf->head );
@@ -169,6 +274,30 @@ void free_iob ( struct io_buffer *iobuf ) {
 	}
 }
 
+/**
+ * Free I/O buffer
+ *
+ * @v iobuf	I/O buffer
+ */
+void free_iob ( struct io_buffer *iobuf ) {
+
+	/* Allow free_iob(NULL) to be valid */
+	if ( ! iobuf )
+		return;
+
+	/* Sanity checks */
+	assert ( iobuf->head <= iobuf->data );
+	assert ( iobuf->data <= iobuf->tail );
+	assert ( iobuf->tail <= iobuf->end );
+
+	/* Return to a receive buffer pool, if applicable */
+	if ( iob_recycle ( iobuf ) )
+		return;
+
+	/* Free buffer */
+	free_iob_raw ( iobuf );
+}
+
 /**
  * Ensure I/O buffer has sufficient headroom
  *
@@ -259,3 +388,35 @@ struct io_buffer * iob_split ( struct io_buffer *iobuf, size_t len ) {
 	iob_pull ( iobuf, len );
 	return split;
 }
+
+/**
+ * Discard some pooled receive I/O buffers
+ *
+ * @ret discarded	Number of cached items discarded
+ */
+static unsigned int iob_pool_discard ( void ) {
+	struct io_buffer_pool *pool;
+	struct io_buffer *iobuf;
+	unsigned int discarded = 0;
+	unsigned int i;
+
+	/* Free one I/O buffer from each pool */
+	for ( i = 0 ; i < IOB_POOL_COUNT ; i++ ) {
+		pool = &iob_pools[i];
+		if ( ! pool->count )
+			continue;
+		iobuf = list_first_entry ( &pool->list, struct io_buffer,
+					   list );
+		list_del ( &iobuf->list );
+		pool->count--;
+		free_iob_raw ( iobuf );
+		discarded++;
+	}
+
+	return discarded;
+}
+
+/** Receive I/O buffer pool cache discarder */
+struct cache_discarder iob_pool_discarder __cache_discarder ( CACHE_CHEAP ) = {
+	.discard = iob_pool_discard,
+};
@@ -141,3 +141,80 @@ int line_buffer ( struct line_buffer *linebuf, const char *data, size_t len ) {
 
 	return consume;
 }
+
+/**
+ * Buffer up a complete block of lines
+ *
+ * @v linebuf			Line buffer
+ * @v data			New data to add
+ * @v len			Length of new data to add
+ * @ret len			Consumed length, or negative error number
+ *
+ * If the line buffer is empty and the new data contains a complete
+ * block of lines terminated by an empty line (such as a set of HTTP
+ * headers), then the whole block is buffered using a single
+ * allocation.  The line buffer will be left in the same state as if
+ * line_buffer() had been called once for each line in the block.
+ *
+ * If no complete block is present, then nothing is consumed and the
+ * caller should fall back to using line_buffer().
+ */
+int line_buffer_block ( struct line_buffer *linebuf, const char *data,
+			size_t len ) {
+	const char *end = ( data + len );
+	const char *line;
+	const char *eol;
+	size_t line_len;
+	size_t consume;
+	char *new_data;
+	char *out;
+
+	/* Do nothing unless line buffer is empty */
+	if ( linebuf->len )
+		return 0;
+
+	/* Find terminating empty line */
+	line = data;
+	do {
+		eol = memchr ( line, '\n', ( end - line ) );
+		if ( ! eol )
+			return 0;
+		line_len = ( eol - line );
+		line = ( eol + 1 );
+	} while ( ( line_len > 1 ) ||
+		  ( ( line_len == 1 ) && ( eol[-1] != '\r' ) ) );
+	consume = ( line - data );
+
+	/* Reject any embedded NULs within the data to be consumed */
+	if ( memchr ( data, '\0', consume ) )
+		return -EINVAL;
+
+	/* Allocate data buffer */
+	new_data = malloc ( consume + 1 /* NUL */ );
+	if ( ! new_data )
+		return -ENOMEM;
+
+	/* Copy in each line, replacing the line terminator (including
+	 * any trailing CR) with a NUL.
+	 */
+	out = new_data;
+	for ( line = data ; line < ( data + consume ) ; line = ( eol + 1 ) ) {
+		eol = memchr ( line, '\n', ( data + consume - line ) );
+		assert ( eol != NULL );
+		line_len = ( eol - line );
+		if ( line_len && ( line[ line_len - 1 ] == '\r' ) )
+			line_len--;
+		memcpy ( out, line, line_len );
+		out += line_len;
+		*(out++) = '\0';
+	}
+	*out = '\0';
+
+	/* Record buffered data */
+	free ( linebuf->data );
+	linebuf->data = new_data;
+	linebuf->len = ( out - new_data );
+	linebuf->consumed = consume;
+
+	return consume;
+}
@@ -32,7 +32,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/init.h>
 #include <ipxe/refcnt.h>
 #include <ipxe/malloc.h>
+#include <ipxe/umalloc.h>
 #include <valgrind/memcheck.h>
+#include <config/general.h>
 
 /** @file
  *
@@ -57,6 +59,8 @@ struct memory_block {
 		  sizeof ( ( ( struct refcnt * ) NULL )->count ) ];
 	/** List of free blocks */
 	struct list_head list;
+	/** List of free blocks within the same size class */
+	struct list_head bin;
 };
 
 #define MIN_MEMBLOCK_SIZE \
@@ -66,6 +70,10 @@ struct memory_block {
 struct autosized_block {
 	/** Size of this block */
 	size_t size;
+#ifdef MALLOC_PROFILE
+	/** Allocation call site (if known) */
+	struct malloc_site *site;
+#endif
 	/** Remaining data */
 	char data[0];
 };
@@ -90,9 +98,24 @@ struct autosized_block {
 /** List of free memory blocks */
 static LIST_HEAD ( free_blocks );
 
+/** Free blocks by size class */
+static struct list_head free_bins[MEMBLOCK_BINS];
+
+/** Bitmask of non-empty size classes */
+static unsigned long free_bins_mask;
+
 /** Total amount of free memory */
 size_t freemem;
 
+/** Total amount of memory added to the heap */
+size_t heapmem;
+
+/** Maximum amount of memory ever simultaneously allocated */
+size_t maxusedmem;
+
+/** Total number of memory blocks ever allocated */
+unsigned long memblock_allocs;
+
 /**
  * Heap size
  *
@@ -103,6 +126,113 @@ size_t freemem;
 /** The heap itself */
 static char heap[HEAP_SIZE] __attribute__ (( aligned ( __alignof__(void *) )));
 
+/**
+ * Minimum heap growth increment
+ *
+ * If heap growth is disabled, this will be zero.
+ */
+#ifdef HEAP_GROW
+#define HEAP_GROW_LEN ( HEAP_GROW_SIZE * 1024 )
+#else
+#define HEAP_GROW_LEN 0
+#endif
+
+#ifdef MALLOC_PROFILE
+
+/** Allocation call sites */
+static struct malloc_site malloc_sites[MALLOC_PROFILE_SITES];
+
+/**
+ * Find (or create) allocation call site
+ *
+ * @v caller		Caller address
+ * @ret site		Allocation call site, or NULL if table is full
+ */
+static struct malloc_site * malloc_site_find ( void *caller ) {
+	struct malloc_site *site;
+	unsigned int start;
+	unsigned int i;
+
+	/* Search open-addressed table, starting from hashed caller */
+	start = ( ( ( unsigned long ) caller ) % MALLOC_PROFILE_SITES );
+	for ( i = 0 ; i < MALLOC_PROFILE_SITES ; i++ ) {
+		site = &malloc_sites[ ( start + i ) % MALLOC_PROFILE_SITES ];
+		if ( site->caller == caller )
+			return site;
+		if ( ! site->caller ) {
+			site->caller = caller;
+			return site;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Record allocation against call site
+ *
+ * @v block		Allocated block
+ * @v caller		Caller address
+ */
+static void malloc_site_alloc ( struct autosized_block *block,
+				void *caller ) {
+	struct malloc_site *site;
+
+	site = malloc_site_find ( caller );
+	block->site = site;
+	if ( ! site )
+		return;
+	site->count++;
+	site->total += block->size;
+	site->used += block->size;
+	if ( site->used > site->max )
+		site->max = site->used;
+}
+
+/**
+ * Record freeing against call site
+ *
+ * @v block		Block being freed
+ */
+static void malloc_site_free ( struct autosized_block *block ) {
+	struct malloc_site *site = block->site;
+
+	if ( site )
+		site->used -= block->size;
+}
+
+/**
+ * Get allocation call site
+ *
+ * @v index		Index
+ * @ret site		Allocation call site, or NULL if index is out of range
+ *
+ * An unused entry is indicated by a NULL caller address.
+ */
+struct malloc_site * malloc_site ( unsigned int index ) {
+
+	if ( index >= MALLOC_PROFILE_SITES )
+		return NULL;
+	return &malloc_sites[index];
+}
+
+#else
+
+static inline void malloc_site_alloc ( struct autosized_block *block __unused,
+				       void *caller __unused ) {
+	/* Nothing to do */
+}
+
+static inline void
+malloc_site_free ( struct autosized_block *block __unused ) {
+	/* Nothing to do */
+}
+
+struct malloc_site * malloc_site ( unsigned int index __unused ) {
+	return NULL;
+}
+
+#endif
+
 /**
  * Mark all blocks in free list as defined
  *
@@ -192,6 +322,42 @@ static inline void valgrind_make_blocks_noaccess ( void ) {
 	VALGRIND_MAKE_MEM_NOACCESS ( &free_blocks, sizeof ( free_blocks ) );
 }
 
+/**
+ * Get size class for a memory block
+ *
+ * @v size		Block size
+ * @ret bin		Size class
+ */
+static inline unsigned int memblock_bin ( size_t size ) {
+
+	return ( flsl ( size ) - 1 );
+}
+
+/**
+ * Add free block to its size class
+ *
+ * @v block		Free block
+ */
+static inline void memblock_bin_add ( struct memory_block *block ) {
+	unsigned int bin = memblock_bin ( block->size );
+
+	list_add ( &block->bin, &free_bins[bin] );
+	free_bins_mask |= ( 1UL << bin );
+}
+
+/**
+ * Remove free block from its size class
+ *
+ * @v block		Free block
+ */
+static inline void memblock_bin_del ( struct memory_block *block ) {
+	unsigned int bin = memblock_bin ( block->size );
+
+	list_del ( &block->bin );
+	if ( list_empty ( &free_bins[bin] ) )
+		free_bins_mask &= ~( 1UL << bin );
+}
+
 /**
  * Check integrity of the blocks in the free list
  *
@@ -216,6 +382,11 @@ static inline void check_blocks ( void ) {
 		assert ( ( ( void * ) block + block->size ) >
 			 ( ( void * ) block ) );
 
+		/* Check that block's size class is marked as non-empty */
+		list_check ( &block->bin );
+		assert ( free_bins_mask &
+			 ( 1UL << memblock_bin ( block->size ) ) );
+
 		/* Check that blocks remain in ascending order, and
 		 * that adjacent blocks have been merged.
 		 */
@@ -257,6 +428,102 @@ static void discard_all_cache ( void ) {
 	} while ( discarded );
 }
 
+/**
+ * Find a free block large enough for an allocation
+ *
+ * @v size		Actual size of allocation
+ * @v align_mask	Alignment mask
+ * @v offset		Offset from physical alignment
+ * @ret block		Free block, or NULL
+ *
+ * Any block within a size class above that of the requested size is
+ * guaranteed to be large enough for an unaligned allocation, so in
+ * the common case this will return the first block of the smallest
+ * suitable non-empty size class without searching.  Only if no such
+ * block exists (or if the allocation is aligned) do we search
+ * individual blocks, starting with the size class containing the
+ * requested size itself.
+ */
+static struct memory_block * find_memblock ( size_t size, size_t align_mask,
+					     size_t offset ) {
+	struct memory_block *block;
+	unsigned long mask;
+	unsigned int min_bin;
+	unsigned int bin;
+	size_t pre_size;
+
+	/* Search size classes in ascending order, skipping empty classes */
+	min_bin = memblock_bin ( size );
+	if ( size & ( size - 1 ) )
+		min_bin++;
+	for ( bin = min_bin ; bin < MEMBLOCK_BINS ; bin++ ) {
+		mask = ( free_bins_mask & ~( ( 1UL << bin ) - 1 ) );
+		if ( ! mask )
+			break;
+		bin = ( ffsl ( mask ) - 1 );
+		list_for_each_entry ( block, &free_bins[bin], bin ) {
+			pre_size = ( ( offset - virt_to_phys ( block ) )
+				     & align_mask );
+			if ( ( block->size >= pre_size ) &&
+			     ( ( block->size - pre_size ) >= size ) )
+				return block;
+		}
+	}
+
+	/* Fall back to searching the class containing the requested size */
+	if ( min_bin != memblock_bin ( size ) ) {
+		bin = memblock_bin ( size );
+		list_for_each_entry ( block, &free_bins[bin], bin ) {
+			pre_size = ( ( offset - virt_to_phys ( block ) )
+				     & align_mask );
+			if ( ( block->size >= pre_size ) &&
+			     ( ( block->size - pre_size ) >= size ) )
+				return block;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Extend the heap
+ *
+ * @v size		Actual size of allocation
+ * @v align		Physical alignment
+ * @ret grown		Heap was extended
+ *
+ * Additional regions obtained via umalloc() are added to the heap
+ * permanently, as with any other region passed to mpopulate().
+ */
+static int grow_heap ( size_t size, size_t align ) {
+	size_t min_len = HEAP_GROW_LEN;
+	userptr_t region;
+	size_t len;
+
+	/* Do nothing unless heap growth is enabled */
+	if ( ! min_len )
+		return 0;
+
+	/* Allow for alignment and for loss of partial blocks */
+	len = ( size + align + ( 2 * MIN_MEMBLOCK_SIZE ) );
+	if ( len < size )
+		return 0;
+	if ( len < min_len )
+		len = min_len;
+
+	/* Allocate and add region */
+	region = umalloc ( len );
+	if ( ! region ) {
+		DBGC ( &heap, "Could not grow heap by %#zx\n", len );
+		return 0;
+	}
+	DBGC ( &heap, "Growing heap by [%#08lx,%#08lx)\n",
+	       user_to_phys ( region, 0 ), user_to_phys ( region, len ) );
+	mpopulate ( user_to_virt ( region, 0 ), len );
+
+	return 1;
+}
+
 /**
  * Allocate a memory block
  *
@@ -306,13 +573,11 @@ void * alloc_memblock ( size_t size, size_t align, size_t offset ) {
 	DBGC2 ( &heap, "Allocating %#zx (aligned %#zx+%zx)\n",
 		size, align, offset );
 	while ( 1 ) {
-		/* Search through blocks for the first one with enough space */
-		list_for_each_entry ( block, &free_blocks, list ) {
+		/* Find a block with enough space */
+		block = find_memblock ( actual_size, align_mask, offset );
+		if ( block ) {
 			pre_size = ( ( offset - virt_to_phys ( block ) )
 				     & align_mask );
-			if ( ( block->size < pre_size ) ||
-			     ( ( block->size - pre_size ) < actual_size ) )
-				continue;
 			post_size = ( block->size - pre_size - actual_size );
 			/* Split block into pre-block, block, and
 			 * post-block.  After this split, the "pre"
@@ -320,6 +585,7 @@ void * alloc_memblock ( size_t size, size_t align, size_t offset ) {
 			 * free list.
 			 */
 			pre   = block;
+			memblock_bin_del ( pre );
 			block = ( ( ( void * ) pre   ) + pre_size );
 			post  = ( ( ( void * ) block ) + actual_size );
 			DBGC2 ( &heap, "[%p,%p) -> [%p,%p) + [%p,%p)\n", pre,
@@ -335,6 +601,7 @@ void * alloc_memblock ( size_t size, size_t align, size_t offset ) {
 							      sizeof ( *post ));
 				post->size = post_size;
 				list_add ( &post->list, &pre->list );
+				memblock_bin_add ( post );
 			}
 			/* Shrink "pre" block, leaving the main block
 			 * isolated and no longer part of the free
@@ -350,9 +617,14 @@ void * alloc_memblock ( size_t size, size_t align, size_t offset ) {
 				list_del ( &pre->list );
 				VALGRIND_MAKE_MEM_NOACCESS ( pre,
 							     sizeof ( *pre ) );
+			} else {
+				memblock_bin_add ( pre );
 			}
 			/* Update total free memory */
 			freemem -= actual_size;
+			if ( ( heapmem - freemem ) > maxusedmem )
+				maxusedmem = ( heapmem - freemem );
+			memblock_allocs++;
 			/* Return allocated block */
 			DBGC2 ( &heap, "Allocated [%p,%p)\n", block,
 				( ( ( void * ) block ) + size ) );
@@ -361,6 +633,10 @@ void * alloc_memblock ( size_t size, size_t align, size_t offset ) {
 			goto done;
 		}
 
+		/* Try extending the heap */
+		if ( grow_heap ( actual_size, align ) )
+			continue;
+
 		/* Try discarding some cached data to free up memory */
 		if ( ! discard_cache() ) {
 			/* Nothing available to discard */
@@ -446,6 +722,7 @@ void free_memblock ( void *ptr, size_t size ) {
 				( ( ( void * ) freeing ) + freeing->size ),
 				block,
 				( ( ( void * ) freeing ) + freeing->size ) );
+			memblock_bin_del ( block );
 			block->size += actual_size;
 			list_del ( &block->list );
 			VALGRIND_MAKE_MEM_NOACCESS ( freeing,
@@ -469,10 +746,12 @@ void free_memblock ( void *ptr, size_t size ) {
 			( ( ( void * ) freeing ) + freeing->size ), block,
 			( ( ( void * ) block ) + block->size ), freeing,
 			( ( ( void * ) block ) + block->size ) );
+		memblock_bin_del ( block );
 		freeing->size += block->size;
 		list_del ( &block->list );
 		VALGRIND_MAKE_MEM_NOACCESS ( block, sizeof ( *block ) );
 	}
+	memblock_bin_add ( freeing );
 
 	/* Update free memory counter */
 	freemem += actual_size;
@@ -482,26 +761,14 @@ void free_memblock ( void *ptr, size_t size ) {
 }
 
 /**
- * Reallocate memory
+ * Reallocate memory on behalf of a caller
  *
  * @v old_ptr		Memory previously allocated by malloc(), or NULL
  * @v new_size		Requested size
+ * @v caller		Caller address (for allocation profiling)
  * @ret new_ptr		Allocated memory, or NULL
- *
- * Allocates memory with no particular alignment requirement.  @c
- * new_ptr will be aligned to at least a multiple of sizeof(void*).
- * If @c old_ptr is non-NULL, then the contents of the newly allocated
- * memory will be the same as the contents of the previously allocated
- * memory, up to the minimum of the old and new sizes.  The old memory
- * will be freed.
- *
- * If allocation fails the previously allocated block is left
- * untouched and NULL is returned.
- *
- * Calling realloc() with a new size of zero is a valid way to free a
- * memory block.
  */
-void * realloc ( void *old_ptr, size_t new_size ) {
+static void * mrealloc ( void *old_ptr, size_t new_size, void *caller ) {
 	struct autosized_block *old_block;
 	struct autosized_block *new_block;
 	size_t old_total_size;
@@ -521,8 +788,10 @@ void * realloc ( void *old_ptr, size_t new_size ) {
 		if ( ! new_block )
 			return NULL;
 		new_block->size = new_total_size;
-		VALGRIND_MAKE_MEM_NOACCESS ( &new_block->size,
-					     sizeof ( new_block->size ) );
+		malloc_site_alloc ( new_block, caller );
+		VALGRIND_MAKE_MEM_NOACCESS ( new_block,
+					     offsetof ( struct autosized_block,
+							data ) );
 		new_ptr = &new_block->data;
 		VALGRIND_MALLOCLIKE_BLOCK ( new_ptr, new_size, 0, 0 );
 	}
@@ -535,10 +804,12 @@ void * realloc ( void *old_ptr, size_t new_size ) {
 	if ( old_ptr && ( old_ptr != NOWHERE ) ) {
 		old_block = container_of ( old_ptr, struct autosized_block,
 					   data );
-		VALGRIND_MAKE_MEM_DEFINED ( &old_block->size,
-					    sizeof ( old_block->size ) );
+		VALGRIND_MAKE_MEM_DEFINED ( old_block,
+					    offsetof ( struct autosized_block,
+						       data ) );
 		old_total_size = old_block->size;
 		assert ( old_total_size != 0 );
+		malloc_site_free ( old_block );
 		old_size = ( old_total_size -
 			     offsetof ( struct autosized_block, data ) );
 		memcpy ( new_ptr, old_ptr,
@@ -547,6 +818,34 @@ void * realloc ( void *old_ptr, size_t new_size ) {
 		free_memblock ( old_block, old_total_size );
 	}
 
+	return new_ptr;
+}
+
+/**
+ * Reallocate memory
+ *
+ * @v old_ptr		Memory previously allocated by malloc(), or NULL
+ * @v new_size		Requested size
+ * @ret new_ptr		Allocated memory, or NULL
+ *
+ * Allocates memory with no particular alignment requirement.  @c
+ * new_ptr will be aligned to at least a multiple of sizeof(void*).
+ * If @c old_ptr is non-NULL, then the contents of the newly allocated
+ * memory will be the same as the contents of the previously allocated
+ * memory, up to the minimum of the old and new sizes.  The old memory
+ * will be freed.
+ *
+ * If allocation fails the previously allocated block is left
+ * untouched and NULL is returned.
+ *
+ * Calling realloc() with a new size of zero is a valid way to free a
+ * memory block.
+ */
+void * realloc ( void *old_ptr, size_t new_size ) {
+	void *new_ptr;
+
+	new_ptr = mrealloc ( old_ptr, new_size,
+			     __builtin_return_address ( 0 ) );
 	if ( ASSERTED ) {
 		DBGC ( &heap, "Possible memory corruption detected from %p\n",
 		       __builtin_return_address ( 0 ) );
@@ -566,7 +865,7 @@ void * realloc ( void *old_ptr, size_t new_size ) {
 void * malloc ( size_t size ) {
 	void *ptr;
 
-	ptr = realloc ( NULL, size );
+	ptr = mrealloc ( NULL, size, __builtin_return_address ( 0 ) );
 	if ( ASSERTED ) {
 		DBGC ( &heap, "Possible memory corruption detected from %p\n",
 		       __builtin_return_address ( 0 ) );
@@ -586,7 +885,7 @@ void * malloc ( size_t size ) {
  */
 void free ( void *ptr ) {
 
-	realloc ( ptr, 0 );
+	mrealloc ( ptr, 0, NULL );
 	if ( ASSERTED ) {
 		DBGC ( &heap, "Possible memory corruption detected from %p\n",
 		       __builtin_return_address ( 0 ) );
@@ -607,7 +906,7 @@ void free ( void *ptr ) {
 void * zalloc ( size_t size ) {
 	void *data;
 
-	data = malloc ( size );
+	data = mrealloc ( NULL, size, __builtin_return_address ( 0 ) );
 	if ( data )
 		memset ( data, 0, size );
 	if ( ASSERTED ) {
@@ -632,7 +931,33 @@ void mpopulate ( void *start, size_t len ) {
 	/* Prevent free_memblock() from rounding up len beyond the end
 	 * of what we were actually given...
 	 */
-	free_memblock ( start, ( len & ~( MIN_MEMBLOCK_SIZE - 1 ) ) );
+	len &= ~( MIN_MEMBLOCK_SIZE - 1 );
+	heapmem += len;
+	free_memblock ( start, len );
+}
+
+/**
+ * Get free memory block statistics
+ *
+ * @v stats		Statistics to fill in
+ *
+ * The distribution of free blocks across size classes gives a
+ * measure of heap fragmentation.
+ */
+void memblock_stats ( struct memblock_stats *stats ) {
+	struct memory_block *block;
+	unsigned int bin;
+
+	memset ( stats, 0, sizeof ( *stats ) );
+	valgrind_make_blocks_defined();
+	list_for_each_entry ( block, &free_blocks, list ) {
+		bin = memblock_bin ( block->size );
+		stats->count[bin]++;
+		stats->size[bin] += block->size;
+		if ( block->size > stats->largest )
+			stats->largest = block->size;
+	}
+	valgrind_make_blocks_noaccess();
 }
 
 /**
@@ -640,6 +965,10 @@ void mpopulate ( void *start, size_t len ) {
  *
  */
 static void init_heap ( void ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < MEMBLOCK_BINS ; i++ )
+		INIT_LIST_HEAD ( &free_bins[i] );
 	VALGRIND_MAKE_MEM_NOACCESS ( heap, sizeof ( heap ) );
 	VALGRIND_MAKE_MEM_NOACCESS ( &free_blocks, sizeof ( free_blocks ) );
 	mpopulate ( heap, sizeof ( heap ) );
@@ -26,12 +26,15 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <string.h>
 #include <stdio.h>
 #include <errno.h>
+#include <byteswap.h>
 #include <ipxe/process.h>
 #include <ipxe/console.h>
 #include <ipxe/keys.h>
 #include <ipxe/job.h>
 #include <ipxe/monojob.h>
 #include <ipxe/timer.h>
+#include <ipxe/settings.h>
+#include <ipxe/vsprintf.h>
 
 /** @file
  *
@@ -39,8 +42,26 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
+/** Number of progress samples used to calculate the transfer rate
+ *
+ * One sample is taken per second, so the displayed rate is smoothed
+ * over this many seconds.
+ */
+#define MONOJOB_SAMPLES 8
+
+/** A progress sample */
+struct monojob_sample {
+	/** Time of sample (in ticks) */
+	unsigned long ticks;
+	/** Completed progress */
+	unsigned long completed;
+};
+
 static int monojob_rc;
 
+/** Most recent download transfer rate (in bytes per second) */
+static unsigned long monojob_rate;
+
 static void monojob_close ( struct interface *intf, int rc ) {
 	monojob_rc = rc;
 	intf_restart ( intf, rc );
@@ -55,25 +76,140 @@ static struct interface_descriptor monojob_intf_desc =
 
 struct interface monojob = INTF_INIT ( monojob_intf_desc );
 
+/**
+ * Calculate transfer rate
+ *
+ * @v completed		Completed progress
+ * @v elapsed		Elapsed time (in ticks)
+ * @ret rate		Transfer rate (in bytes per second)
+ */
+static unsigned long monojob_calc_rate ( unsigned long completed,
+					 unsigned long elapsed ) {
+
+	if ( ! elapsed )
+		return 0;
+	return ( ( ( completed / elapsed ) * TICKS_PER_SEC ) +
+		 ( ( ( completed % elapsed ) * TICKS_PER_SEC ) / elapsed ) );
+}
+
+/**
+ * Format transfer rate
+ *
+ * @v rate		Transfer rate (in bytes per second)
+ * @v buf		Buffer to fill in
+ * @v len		Length of buffer
+ * @ret len		Length of formatted rate
+ */
+static int monojob_format_rate ( unsigned long rate, char *buf,
+				 ssize_t len ) {
+	static const char units[] = "KMG";
+	unsigned int unit = 0;
+
+	if ( rate < 10000 )
+		return ssnprintf ( buf, len, "%ldB/s", rate );
+	rate /= 1024;
+	while ( ( rate >= 10000 ) && ( unit < ( sizeof ( units ) - 2 ) ) ) {
+		rate /= 1024;
+		unit++;
+	}
+	return ssnprintf ( buf, len, "%ld%cB/s", rate, units[unit] );
+}
+
+/**
+ * Format job progress
+ *
+ * @v progress		Job progress
+ * @v rate		Transfer rate (in bytes per second)
+ * @v buf		Buffer to fill in
+ * @v len		Length of buffer
+ * @ret len		Length of formatted progress
+ *
+ * Progress is formatted as a percentage (if the total is known),
+ * followed by the transfer rate and the estimated time remaining (if
+ * applicable).
+ */
+static int monojob_format ( struct job_progress *progress,
+			    unsigned long rate, char *buf, ssize_t len ) {
+	unsigned long scaled_completed;
+	unsigned long scaled_total;
+	unsigned long remaining;
+	unsigned long eta;
+	int used = 0;
+
+	/* Format percentage, normalising figures to avoid overflow */
+	scaled_completed = ( progress->completed / 128 );
+	scaled_total = ( progress->total / 128 );
+	if ( scaled_total ) {
+		used += ssnprintf ( ( buf + used ), ( len - used ), "%3ld%%",
+				    ( ( 100 * scaled_completed ) /
+				      scaled_total ) );
+	}
+
+	/* Format transfer rate */
+	if ( progress->completed ) {
+		if ( used )
+			used += ssnprintf ( ( buf + used ), ( len - used ),
+					    " " );
+		used += monojob_format_rate ( rate, ( buf + used ),
+					      ( len - used ) );
+	}
+
+	/* Format estimated time remaining */
+	if ( scaled_total && rate &&
+	     ( progress->total > progress->completed ) ) {
+		remaining = ( progress->total - progress->completed );
+		eta = ( ( remaining / rate ) +
+			( ( remaining % rate ) ? 1 : 0 ) );
+		used += ssnprintf ( ( buf + used ), ( len - used ),
+				    " ETA %ld:%02ld", ( eta / 60 ),
+				    ( eta % 60 ) );
+	}
+
+	return used;
+}
+
+/**
+ * Erase displayed progress
+ *
+ * @v len		Length of displayed progress
+ */
+static void monojob_erase ( size_t len ) {
+	size_t i;
+
+	for ( i = 0 ; i < len ; i++ )
+		putchar ( '\b' );
+	for ( i = 0 ; i < len ; i++ )
+		putchar ( ' ' );
+	for ( i = 0 ; i < len ; i++ )
+		putchar ( '\b' );
+}
+
 /**
  * Wait for single foreground job to complete
  *
  * @v string		Job description to display, or NULL to be silent
  * @v timeout		Timeout period, in ticks (0=indefinite)
  * @ret rc		Job final status code
+ *
+ * Progress is checked at most once per clock tick, and the display
+ * is redrawn at most once per second (and only if it has changed).
  */
 int monojob_wait ( const char *string, unsigned long timeout ) {
+	struct monojob_sample samples[MONOJOB_SAMPLES];
+	struct monojob_sample *oldest;
 	struct job_progress progress;
-	unsigned long last_keycheck;
+	unsigned long start;
+	unsigned long last_check;
 	unsigned long last_progress;
 	unsigned long last_display;
 	unsigned long now;
 	unsigned long elapsed;
 	unsigned long completed = 0;
-	unsigned long scaled_completed;
-	unsigned long scaled_total;
-	unsigned int percentage;
-	int shown_percentage = 0;
+	unsigned long rate;
+	unsigned int sample_count;
+	char display[32];
+	char shown[ sizeof ( display ) ];
+	size_t shown_len = 0;
 	int ongoing_rc;
 	int key;
 	int rc;
@@ -81,26 +217,31 @@ int monojob_wait ( const char *string, unsigned long timeout ) {
 	if ( string )
 		printf ( "%s...", string );
 	monojob_rc = -EINPROGRESS;
-	last_keycheck = last_progress = last_display = currticks();
+	shown[0] = '\0';
+	start = last_check = last_progress = last_display = currticks();
+	samples[0].ticks = start;
+	samples[0].completed = 0;
+	sample_count = 1;
 	while ( monojob_rc == -EINPROGRESS ) {
 
 		/* Allow job to progress */
 		step();
 		now = currticks();
 
-		/* Check for keypresses.  This can be time-consuming,
-		 * so check only once per clock tick.
+		/* Checking for keypresses and job progress can be
+		 * time-consuming, so check only once per clock tick.
 		 */
-		elapsed = ( now - last_keycheck );
-		if ( elapsed ) {
-			if ( iskey() ) {
-				key = getchar();
-				if ( key == CTRL_C ) {
-					monojob_rc = -ECANCELED;
-					break;
-				}
+		if ( now == last_check )
+			continue;
+		last_check = now;
+
+		/* Check for keypresses */
+		if ( iskey() ) {
+			key = getchar();
+			if ( key == CTRL_C ) {
+				monojob_rc = -ECANCELED;
+				break;
 			}
-			last_keycheck = now;
 		}
 
 		/* Monitor progress */
@@ -118,31 +259,55 @@ int monojob_wait ( const char *string, unsigned long timeout ) {
 			break;
 		}
 
-		/* Display progress, if applicable */
+		/* Do nothing more until next display interval */
 		elapsed = ( now - last_display );
-		if ( string && ( elapsed >= TICKS_PER_SEC ) ) {
-			if ( shown_percentage )
-				printf ( "\b\b\b\b    \b\b\b\b" );
-			/* Normalise progress figures to avoid overflow */
-			scaled_completed = ( progress.completed / 128 );
-			scaled_total = ( progress.total / 128 );
-			if ( scaled_total ) {
-				percentage = ( ( 100 * scaled_completed ) /
-					       scaled_total );
-				printf ( "%3d%%", percentage );
-				shown_percentage = 1;
-			} else {
-				printf ( "." );
-				shown_percentage = 0;
-			}
-			last_display = now;
+		if ( elapsed < TICKS_PER_SEC )
+			continue;
+		last_display = now;
+
+		/* Record progress sample and calculate transfer rate */
+		samples[ sample_count++ % MONOJOB_SAMPLES ] =
+			( struct monojob_sample ) {
+				.ticks = now,
+				.completed = completed,
+			};
+		oldest = &samples[ ( sample_count < MONOJOB_SAMPLES ) ? 0 :
+				   ( sample_count % MONOJOB_SAMPLES ) ];
+		rate = monojob_calc_rate ( ( completed - oldest->completed ),
+					   ( now - oldest->ticks ) );
+		if ( completed )
+			monojob_rate = rate;
+
+		/* Construct progress display, if applicable */
+		if ( ! string )
+			continue;
+		display[0] = '\0';
+		monojob_format ( &progress, rate, display,
+				 sizeof ( display ) );
+
+		/* Fall back to a simple activity indicator */
+		if ( ! display[0] ) {
+			printf ( "." );
+			continue;
 		}
+
+		/* Redraw progress display only if changed */
+		if ( strcmp ( display, shown ) == 0 )
+			continue;
+		monojob_erase ( shown_len );
+		printf ( "%s", display );
+		memcpy ( shown, display, sizeof ( shown ) );
+		shown_len = strlen ( shown );
 	}
 	rc = monojob_rc;
 	monojob_close ( &monojob, rc );
 
-	if ( shown_percentage )
-		printf ( "\b\b\b\b    \b\b\b\b" );
+	/* Record average transfer rate */
+	if ( completed )
+		monojob_rate = monojob_calc_rate ( completed,
+						   ( currticks() - start ) );
+
+	monojob_erase ( shown_len );
 
 	if ( string ) {
 		if ( rc ) {
@@ -154,3 +319,36 @@ int monojob_wait ( const char *string, unsigned long timeout ) {
 
 	return rc;
 }
+
+/**
+ * Fetch transfer rate setting
+ *
+ * @v data		Buffer to fill with setting data
+ * @v len		Length of buffer
+ * @ret len		Length of setting data, or negative error
+ */
+static int monojob_rate_fetch ( void *data, size_t len ) {
+	uint32_t content;
+
+	/* Return most recent transfer rate */
+	content = htonl ( monojob_rate );
+	if ( len > sizeof ( content ) )
+		len = sizeof ( content );
+	memcpy ( data, &content, len );
+	return sizeof ( content );
+}
+
+/** Transfer rate setting */
+const struct setting download_rate_setting __setting ( SETTING_MISC,
+						       download-rate ) = {
+	.name = "download-rate",
+	.description = "Download rate (bytes per second)",
+	.type = &setting_type_uint32,
+	.scope = &builtin_scope,
+};
+
+/** Transfer rate built-in setting */
+struct builtin_setting download_rate_builtin_setting __builtin_setting = {
+	.setting = &download_rate_setting,
+	.fetch = monojob_rate_fetch,
+};
@@ -26,7 +26,8 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <errno.h>
 #include <ipxe/sanboot.h>
 
-static int null_san_hook ( struct uri *uri __unused,
+static int null_san_hook ( struct uri **uris __unused,
+			   unsigned int count __unused,
 			   unsigned int drive __unused ) {
 	return -EOPNOTSUPP;
 }
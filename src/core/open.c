@@ -30,6 +30,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/uri.h>
 #include <ipxe/socket.h>
 #include <ipxe/open.h>
+#include <ipxe/timeline.h>
 
 /** @file
  *
@@ -53,6 +54,20 @@ struct uri_opener * xfer_uri_opener ( const char *scheme ) {
 	return NULL;
 }
 
+/**
+ * Record timeline event (when boot timeline is not present)
+ *
+ * @v phase		Phase
+ * @v event		Event within phase
+ * @v detail		Detail, or NULL
+ * @v rc		Status code
+ */
+__weak void timeline_record ( const char *phase __unused,
+			      const char *event __unused,
+			      const char *detail __unused, int rc __unused ) {
+	/* Nothing to do */
+}
+
 /**
  * Open URI
  *
@@ -88,7 +103,11 @@ int xfer_open_uri ( struct interface *intf, struct uri *uri ) {
 	/* Call opener */
 	DBGC ( INTF_COL ( intf ), "INTF " INTF_FMT " opening %s URI\n",
 	       INTF_DBG ( intf ), resolved_uri->scheme );
-	if ( ( rc = opener->open ( intf, resolved_uri ) ) != 0 ) {
+	rc = opener->open ( intf, resolved_uri );
+	timeline_record ( resolved_uri->scheme, "open",
+			  ( resolved_uri->host ? resolved_uri->host :
+			    resolved_uri->path ), rc );
+	if ( rc != 0 ) {
 		DBGC ( INTF_COL ( intf ), "INTF " INTF_FMT " could not open: "
 		       "%s\n", INTF_DBG ( intf ), strerror ( rc ) );
 		goto err_open;
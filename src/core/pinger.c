@@ -34,6 +34,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/open.h>
 #include <ipxe/socket.h>
 #include <ipxe/retry.h>
+#include <ipxe/profile.h>
 #include <ipxe/pinger.h>
 
 /** @file
@@ -74,6 +75,10 @@ struct pinger {
 	uint16_t sequence;
 	/** Response for current sequence number is still pending */
 	int pending;
+	/** Transmission timestamp of current sequence number */
+	unsigned long sent;
+	/** Transmit next request as soon as a response is received */
+	int flood;
 	/** Number of remaining expiry events (zero to continue indefinitely) */
 	unsigned int remaining;
 	/** Return status */
@@ -84,10 +89,11 @@ struct pinger {
 	 * @v src		Source socket address, or NULL
 	 * @v sequence		Sequence number
 	 * @v len		Payload length
+	 * @v elapsed		Round-trip time (in profiling timestamp units)
 	 * @v rc		Status code
 	 */
 	void ( * callback ) ( struct sockaddr *src, unsigned int sequence,
-			      size_t len, int rc );
+			      size_t len, unsigned long elapsed, int rc );
 };
 
 /**
@@ -171,7 +177,7 @@ static void pinger_expired ( struct retry_timer *timer, int over __unused ) {
 
 	/* If no response has been received, notify the callback function */
 	if ( pinger->pending && pinger->callback )
-		pinger->callback ( NULL, pinger->sequence, 0, -ETIMEDOUT );
+		pinger->callback ( NULL, pinger->sequence, 0, 0, -ETIMEDOUT );
 
 	/* Check for termination */
 	if ( pinger->remaining && ( --pinger->remaining == 0 ) ) {
@@ -205,6 +211,7 @@ static void pinger_expired ( struct retry_timer *timer, int over __unused ) {
 	meta.offset = pinger->sequence;
 
 	/* Transmit packet */
+	pinger->sent = profile_timestamp();
 	if ( ( rc = xfer_deliver ( &pinger->xfer, iobuf, &meta ) ) != 0 ) {
 		DBGC ( pinger, "PINGER %p could not transmit: %s\n",
 		       pinger, strerror ( rc ) );
@@ -222,6 +229,7 @@ static void pinger_expired ( struct retry_timer *timer, int over __unused ) {
  */
 static int pinger_deliver ( struct pinger *pinger, struct io_buffer *iobuf,
 			    struct xfer_metadata *meta ) {
+	unsigned long elapsed = ( profile_timestamp() - pinger->sent );
 	size_t len = iob_len ( iobuf );
 	uint16_t sequence = meta->offset;
 	int terminate = 0;
@@ -262,6 +270,10 @@ static int pinger_deliver ( struct pinger *pinger, struct io_buffer *iobuf,
 		rc = 0;
 		pinger->rc = 0;
 		terminate = ( pinger->remaining == 1 );
+
+		/* Send next request immediately, if applicable */
+		if ( pinger->flood && ( ! terminate ) )
+			start_timer_nodelay ( &pinger->timer );
 	}
 
 	/* Discard I/O buffer */
@@ -269,7 +281,7 @@ static int pinger_deliver ( struct pinger *pinger, struct io_buffer *iobuf,
 
 	/* Notify callback function, if applicable */
 	if ( pinger->callback )
-		pinger->callback ( meta->src, sequence, len, rc );
+		pinger->callback ( meta->src, sequence, len, elapsed, rc );
 
 	/* Terminate if applicable */
 	if ( terminate )
@@ -306,14 +318,19 @@ static struct interface_descriptor pinger_job_desc =
  * @v timeout		Timeout (in ticks)
  * @v len		Payload length
  * @v count		Number of packets to send (or zero for no limit)
+ * @v flood		Send each packet as soon as a response is received
  * @v callback		Callback function (or NULL)
  * @ret rc		Return status code
+ *
+ * The timeout is the interval between packets.  In flood mode, it is
+ * the interval only for packets that receive no response.
  */
 int create_pinger ( struct interface *job, const char *hostname,
 		    unsigned long timeout, size_t len, unsigned int count,
+		    int flood,
 		    void ( * callback ) ( struct sockaddr *src,
 					  unsigned int sequence, size_t len,
-					  int rc ) ) {
+					  unsigned long elapsed, int rc ) ) {
 	struct pinger *pinger;
 	int rc;
 
@@ -331,6 +348,7 @@ int create_pinger ( struct interface *job, const char *hostname,
 	timer_init ( &pinger->timer, pinger_expired, &pinger->refcnt );
 	pinger->timeout = timeout;
 	pinger->len = len;
+	pinger->flood = flood;
 	pinger->remaining = ( count ? ( count + 1 /* Initial packet */ ) : 0 );
 	pinger->callback = callback;
 	pinger->rc = -ETIMEDOUT;
@@ -38,6 +38,26 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Process run queue */
 static LIST_HEAD ( run_queue );
 
+/** Process at the head of the run queue for the current turn */
+static struct process *run_current;
+
+/** Number of steps taken by the current process in the current turn */
+static unsigned int run_steps;
+
+/** Number of non-permanent processes in the run queue */
+static unsigned int run_transient;
+
+/**
+ * Check whether or not process is a permanent process
+ *
+ * @v process		Process
+ * @ret is_permanent	Process is a permanent process
+ */
+static inline int process_permanent ( struct process *process ) {
+	return ( ( process >= table_start ( PERMANENT_PROCESSES ) ) &&
+		 ( process < table_end ( PERMANENT_PROCESSES ) ) );
+}
+
 /**
  * Get pointer to object containing process
  *
@@ -62,6 +82,8 @@ void process_add ( struct process *process ) {
 		       " starting\n", PROC_DBG ( process ) );
 		ref_get ( process->refcnt );
 		list_add_tail ( &process->list, &run_queue );
+		if ( ! process_permanent ( process ) )
+			run_transient++;
 	} else {
 		DBGC ( PROC_COL ( process ), "PROCESS " PROC_FMT
 		       " already started\n", PROC_DBG ( process ) );
@@ -82,6 +104,8 @@ void process_del ( struct process *process ) {
 		       " stopping\n", PROC_DBG ( process ) );
 		list_del ( &process->list );
 		INIT_LIST_HEAD ( &process->list );
+		if ( ! process_permanent ( process ) )
+			run_transient--;
 		ref_put ( process->refcnt );
 	} else {
 		DBGC ( PROC_COL ( process ), "PROCESS " PROC_FMT
@@ -93,7 +117,8 @@ void process_del ( struct process *process ) {
  * Single-step a single process
  *
  * This executes a single step of the first process in the run queue,
- * and moves the process to the end of the run queue.
+ * and moves the process to the end of the run queue once it has used
+ * up its scheduling weight.
  */
 void step ( void ) {
 	struct process *process;
@@ -105,9 +130,16 @@ void step ( void ) {
 		ref_get ( process->refcnt ); /* Inhibit destruction mid-step */
 		desc = process->desc;
 		object = process_object ( process );
+		if ( process != run_current ) {
+			run_current = process;
+			run_steps = 0;
+		}
 		if ( desc->reschedule ) {
-			list_del ( &process->list );
-			list_add_tail ( &process->list, &run_queue );
+			if ( ++run_steps >= desc->weight ) {
+				list_del ( &process->list );
+				list_add_tail ( &process->list, &run_queue );
+				run_current = NULL;
+			}
 		} else {
 			process_del ( process );
 		}
@@ -120,6 +152,34 @@ void step ( void ) {
 	}
 }
 
+/**
+ * Yield the remainder of the current scheduling turn
+ *
+ * @v process		Process
+ *
+ * A weighted process should call this from its step() method when it
+ * has no further work to do, so that its remaining steps in the
+ * current turn do not delay other processes.
+ */
+void process_yield ( struct process *process ) {
+
+	if ( process == run_current ) {
+		list_del ( &process->list );
+		list_add_tail ( &process->list, &run_queue );
+		run_current = NULL;
+	}
+}
+
+/**
+ * Check whether or not only permanent processes are runnable
+ *
+ * @ret is_idle		Run queue contains only permanent processes
+ */
+int process_idle ( void ) {
+
+	return ( run_transient == 0 );
+}
+
 /**
  * Initialise processes
  *
@@ -107,6 +107,7 @@ static inline unsigned int profile_accvar_shift ( struct profiler *profiler ) {
  * @v sample		Sample value
  */
 void profile_update ( struct profiler *profiler, unsigned long sample ) {
+	unsigned int bucket;
 	unsigned int sample_msb;
 	unsigned int mean_shift;
 	unsigned int delta_shift;
@@ -125,6 +126,12 @@ void profile_update ( struct profiler *profiler, unsigned long sample ) {
 	/* Update sample count */
 	profiler->count++;
 
+	/* Update histogram */
+	bucket = flsl ( sample );
+	if ( bucket >= PROFILE_HIST_BUCKETS )
+		bucket = ( PROFILE_HIST_BUCKETS - 1 );
+	profiler->hist[bucket]++;
+
 	/* Adjust mean sample value scale if necessary.  Skip if
 	 * sample is zero (in which case flsl(sample)-1 would
 	 * underflow): in the case of a zero sample we have no need to
@@ -30,6 +30,8 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/xfer.h>
 #include <ipxe/open.h>
 #include <ipxe/process.h>
+#include <ipxe/retry.h>
+#include <ipxe/timer.h>
 #include <ipxe/socket.h>
 #include <ipxe/resolv.h>
 
@@ -291,6 +293,28 @@ int resolv ( struct interface *resolv, const char *name,
  ***************************************************************************
  */
 
+/** Maximum number of concurrent connection attempts for a named socket */
+#define NAMED_MAX_ATTEMPTS 2
+
+/** Connection attempt delay
+ *
+ * When a name resolves to more than one address (e.g. to both an
+ * IPv6 and an IPv4 address), a connection attempt to the next
+ * address is started if the previous attempt has not succeeded
+ * within this time, as recommended by RFC8305 section 5.
+ */
+#define NAMED_ATTEMPT_DELAY ( TICKS_PER_SEC / 4 )
+
+/** A named socket connection attempt */
+struct named_attempt {
+	/** Named socket */
+	struct named_socket *named;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Peer socket address */
+	struct sockaddr peer;
+};
+
 /** A named socket */
 struct named_socket {
 	/** Reference counter */
@@ -305,6 +329,21 @@ struct named_socket {
 	struct sockaddr local;
 	/** Stored local socket address exists */
 	int have_local;
+
+	/** Connection attempts */
+	struct named_attempt attempt[NAMED_MAX_ATTEMPTS];
+	/** Number of resolved addresses */
+	unsigned int count;
+	/** Number of connection attempts started */
+	unsigned int started;
+	/** Number of connection attempts failed */
+	unsigned int failed;
+	/** Name resolution is complete */
+	int resolved;
+	/** Most recent failure status code */
+	int rc;
+	/** Connection attempt delay timer */
+	struct retry_timer timer;
 };
 
 /**
@@ -314,6 +353,15 @@ struct named_socket {
  * @v rc		Reason for termination
  */
 static void named_close ( struct named_socket *named, int rc ) {
+	unsigned int i;
+
+	/* Stop timer */
+	stop_timer ( &named->timer );
+
+	/* Cancel any outstanding connection attempts */
+	for ( i = 0 ; i < NAMED_MAX_ATTEMPTS ; i++ )
+		intf_shutdown ( &named->attempt[i].xfer, -ECANCELED );
+
 	/* Shut down interfaces */
 	intf_shutdown ( &named->resolv, rc );
 	intf_shutdown ( &named->xfer, rc );
@@ -340,6 +388,128 @@ static struct interface_operation named_xfer_ops[] = {
 static struct interface_descriptor named_xfer_desc =
 	INTF_DESC ( struct named_socket, xfer, named_xfer_ops );
 
+/**
+ * Start next connection attempt, if applicable
+ *
+ * @v named		Named socket
+ */
+static void named_next ( struct named_socket *named ) {
+	struct named_attempt *attempt;
+	struct sockaddr *local;
+	int rc;
+
+	/* Start connection attempts until one is successfully opened,
+	 * or until we run out of resolved addresses.  Do not start a
+	 * new attempt while the delay timer is running, unless all
+	 * previous attempts have already failed.
+	 */
+	while ( named->started < named->count ) {
+
+		/* Wait for delay timer, if applicable */
+		if ( timer_running ( &named->timer ) &&
+		     ( named->failed < named->started ) )
+			return;
+
+		/* Start connection attempt */
+		attempt = &named->attempt[ named->started++ ];
+		local = ( named->have_local ? &named->local : NULL );
+		DBGC ( named, "NAMED %p connecting to %s\n",
+		       named, sock_ntoa ( &attempt->peer ) );
+		if ( ( rc = xfer_open_socket ( &attempt->xfer, named->semantics,
+					       &attempt->peer, local ) ) == 0 ) {
+			start_timer_fixed ( &named->timer,
+					    NAMED_ATTEMPT_DELAY );
+			return;
+		}
+		DBGC ( named, "NAMED %p could not connect to %s: %s\n",
+		       named, sock_ntoa ( &attempt->peer ), strerror ( rc ) );
+		named->failed++;
+		named->rc = rc;
+	}
+
+	/* Fail if all attempts have failed and no further addresses
+	 * will be resolved.
+	 */
+	if ( named->resolved && ( named->failed == named->started ) )
+		named_close ( named, named->rc );
+}
+
+/**
+ * Handle connection attempt delay timer expiry
+ *
+ * @v timer		Connection attempt delay timer
+ * @v fail		Failure indicator
+ */
+static void named_expired ( struct retry_timer *timer, int fail __unused ) {
+	struct named_socket *named =
+		container_of ( timer, struct named_socket, timer );
+
+	/* Start next connection attempt, if applicable */
+	named_next ( named );
+}
+
+/**
+ * Handle change of connection attempt flow control window
+ *
+ * @v attempt		Connection attempt
+ */
+static void named_attempt_window_changed ( struct named_attempt *attempt ) {
+	struct named_socket *named = attempt->named;
+	struct interface *parent = named->xfer.dest;
+	struct interface *conn = attempt->xfer.dest;
+
+	/* Do nothing until the connection is established */
+	if ( ! xfer_window ( &attempt->xfer ) )
+		return;
+
+	DBGC ( named, "NAMED %p connected to %s\n",
+	       named, sock_ntoa ( &attempt->peer ) );
+
+	/* Plug connection directly into parent interface */
+	intf_plug_plug ( parent, conn );
+	intf_unplug ( &attempt->xfer );
+	intf_unplug ( &named->xfer );
+
+	/* Notify parent that the connection is ready for data */
+	xfer_window_changed ( conn );
+
+	/* Terminate named socket opener, cancelling any other attempts */
+	named_close ( named, 0 );
+}
+
+/**
+ * Handle connection attempt failure
+ *
+ * @v attempt		Connection attempt
+ * @v rc		Reason for failure
+ */
+static void named_attempt_close ( struct named_attempt *attempt, int rc ) {
+	struct named_socket *named = attempt->named;
+
+	DBGC ( named, "NAMED %p connection to %s failed: %s\n",
+	       named, sock_ntoa ( &attempt->peer ), strerror ( rc ) );
+
+	/* Shut down interface */
+	intf_shutdown ( &attempt->xfer, rc );
+
+	/* Record failure and start next attempt immediately */
+	named->failed++;
+	named->rc = ( rc ? rc : -ECONNRESET );
+	stop_timer ( &named->timer );
+	named_next ( named );
+}
+
+/** Named socket connection attempt interface operations */
+static struct interface_operation named_attempt_ops[] = {
+	INTF_OP ( xfer_window_changed, struct named_attempt *,
+		  named_attempt_window_changed ),
+	INTF_OP ( intf_close, struct named_attempt *, named_attempt_close ),
+};
+
+/** Named socket connection attempt interface descriptor */
+static struct interface_descriptor named_attempt_desc =
+	INTF_DESC ( struct named_attempt, xfer, named_attempt_ops );
+
 /**
  * Name resolved
  *
@@ -350,6 +520,19 @@ static void named_resolv_done ( struct named_socket *named,
 				struct sockaddr *sa ) {
 	int rc;
 
+	/* Race connection attempts for stream sockets.  (Compare
+	 * against the constant value rather than SOCK_STREAM, to
+	 * avoid dragging in TCP support.)
+	 */
+	if ( named->semantics == TCP_SOCK_STREAM ) {
+		if ( named->count < NAMED_MAX_ATTEMPTS ) {
+			memcpy ( &named->attempt[ named->count++ ].peer, sa,
+				 sizeof ( named->attempt[0].peer ) );
+			named_next ( named );
+		}
+		return;
+	}
+
 	/* Nullify data transfer interface */
 	intf_nullify ( &named->xfer );
 
@@ -371,9 +554,31 @@ static void named_resolv_done ( struct named_socket *named,
 	named_close ( named, rc );
 }
 
+/**
+ * Name resolution complete
+ *
+ * @v named		Named socket
+ * @v rc		Reason for completion
+ */
+static void named_resolv_close ( struct named_socket *named, int rc ) {
+
+	/* Shut down interface */
+	intf_shutdown ( &named->resolv, rc );
+
+	/* Fail if no address was resolved */
+	if ( ! named->count ) {
+		named_close ( named, ( rc ? rc : -ENXIO ) );
+		return;
+	}
+
+	/* Otherwise, wait for outstanding connection attempts */
+	named->resolved = 1;
+	named_next ( named );
+}
+
 /** Named socket opener resolver interface operations */
 static struct interface_operation named_resolv_op[] = {
-	INTF_OP ( intf_close, struct named_socket *, named_close ),
+	INTF_OP ( intf_close, struct named_socket *, named_resolv_close ),
 	INTF_OP ( resolv_done, struct named_socket *, named_resolv_done ),
 };
 
@@ -394,6 +599,7 @@ int xfer_open_named_socket ( struct interface *xfer, int semantics,
 			     struct sockaddr *peer, const char *name,
 			     struct sockaddr *local ) {
 	struct named_socket *named;
+	unsigned int i;
 	int rc;
 
 	/* Allocate and initialise structure */
@@ -403,6 +609,12 @@ int xfer_open_named_socket ( struct interface *xfer, int semantics,
 	ref_init ( &named->refcnt, NULL );
 	intf_init ( &named->xfer, &named_xfer_desc, &named->refcnt );
 	intf_init ( &named->resolv, &named_resolv_desc, &named->refcnt );
+	for ( i = 0 ; i < NAMED_MAX_ATTEMPTS ; i++ ) {
+		named->attempt[i].named = named;
+		intf_init ( &named->attempt[i].xfer, &named_attempt_desc,
+			    &named->refcnt );
+	}
+	timer_init ( &named->timer, named_expired, &named->refcnt );
 	named->semantics = semantics;
 	if ( local ) {
 		memcpy ( &named->local, local, sizeof ( named->local ) );
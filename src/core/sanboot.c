@@ -39,9 +39,13 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/timer.h>
 #include <ipxe/process.h>
 #include <ipxe/iso9660.h>
+#include <ipxe/eltorito.h>
 #include <ipxe/dhcp.h>
 #include <ipxe/settings.h>
+#include <ipxe/umalloc.h>
+#include <ipxe/profile.h>
 #include <ipxe/sanboot.h>
+#include <config/general.h>
 
 /**
  * Default SAN drive number
@@ -74,9 +78,105 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 #define SAN_COMMAND_MAX_RETRIES 10
 
+/**
+ * Minimum length of a concurrent read/write command fragment
+ *
+ * Large requests are split between command slots only as far as this
+ * length, to avoid swamping the device with tiny commands.
+ */
+#define SAN_COMMAND_MIN_LEN ( 64 * 1024 )
+
+/** SAN device command slot states (used by sandev_rw_uncached()) */
+enum san_command_state {
+	/** Slot has no fragment assigned */
+	SAN_COMMAND_FREE = 0,
+	/** Fragment is waiting to be issued */
+	SAN_COMMAND_PENDING,
+	/** Fragment has been issued */
+	SAN_COMMAND_RUNNING,
+};
+
+/**
+ * Minimum length of a block cache line
+ *
+ * The cache line length will be increased to the underlying block
+ * size if necessary.
+ */
+#define SAN_CACHE_LINE_LEN 4096
+
+/**
+ * Minimum length of block cache fetch buffer
+ *
+ * All cache misses are satisfied by a single read into the fetch
+ * buffer.  Reads that do not fit within the fetch buffer bypass the
+ * cache.
+ *
+ * This is large enough to hold a maximum-length (127-sector) INT 13
+ * read along with a full read-ahead, and to be split between several
+ * concurrent commands.
+ */
+#define SAN_CACHE_FETCH_LEN ( 256 * 1024 )
+
+/**
+ * Maximum length of block cache fetch buffer
+ *
+ * The fetch buffer (and hence the maximum read-ahead) is sized at
+ * half of the block cache, so that a full read-ahead does not evict
+ * the whole cache.  Devices with a high per-command overhead (such as
+ * HTTP, where each read is a separate range request) benefit from
+ * reading ahead by several megabytes during long sequential runs.
+ */
+#define SAN_CACHE_FETCH_MAX ( 4 * 1024 * 1024 )
+
+/**
+ * Initial length of block cache read-ahead
+ *
+ * When a cache miss continues a sequential run of reads, the
+ * following data will be read into the cache at the same time.  The
+ * read-ahead length is doubled on each such miss (up to the length
+ * of the fetch buffer), and is reset whenever the sequential run is
+ * broken.
+ */
+#define SAN_CACHE_READAHEAD_LEN ( 64 * 1024 )
+
+/**
+ * Number of ISO9660 blocks to prefetch from the volume descriptor set
+ *
+ * The volume descriptor set (including any El Torito boot record
+ * volume descriptor) starts at the primary volume descriptor and is
+ * almost always only a few blocks long.  Reading it with a single
+ * command avoids a round trip per descriptor on devices with a high
+ * per-command latency (such as HTTP).
+ */
+#define SAN_ISO9660_PREFETCH_BLOCKS 16
+
 /** List of SAN devices */
 LIST_HEAD ( san_devices );
 
+/** Block cache hit profiler */
+static struct profiler sandev_cache_hit_profiler __profiler =
+	{ .name = "sandev.cache_hit" };
+
+/** Block cache miss profiler */
+static struct profiler sandev_cache_miss_profiler __profiler =
+	{ .name = "sandev.cache_miss" };
+
+/** The "san-cache" setting */
+const struct setting san_cache_setting __setting ( SETTING_SANBOOT_EXTRA,
+						   san-cache ) = {
+	.name = "san-cache",
+	.description = "SAN block cache size (in kB)",
+	.type = &setting_type_uint32,
+};
+
+/** The "san-writeback" setting */
+const struct setting san_writeback_setting __setting ( SETTING_SANBOOT_EXTRA,
+						       san-writeback ) = {
+	.name = "san-writeback",
+	.description = "SAN write-back buffer size (in kB)",
+	.type = &setting_type_uint32,
+};
+
 /**
  * Find SAN device by drive number
  *
@@ -101,38 +201,181 @@ struct san_device * sandev_find ( unsigned int drive ) {
 static void sandev_free ( struct refcnt *refcnt ) {
 	struct san_device *sandev =
 		container_of ( refcnt, struct san_device, refcnt );
+	unsigned int i;
 
-	assert ( ! timer_running ( &sandev->timer ) );
-	uri_put ( sandev->uri );
+	for ( i = 0 ; i < SAN_COMMAND_MAX ; i++ )
+		assert ( ! timer_running ( &sandev->commands[i].timer ) );
+	for ( i = 0 ; i < sandev->paths ; i++ )
+		uri_put ( sandev->path[i].uri );
 	free ( sandev );
 }
 
+static void sandev_command_close ( struct san_command *cmd, int rc );
+
 /**
- * Close SAN device command
+ * Count SAN device paths with a given status
  *
  * @v sandev		SAN device
+ * @v path_rc		Path status of interest
+ * @ret count		Number of paths with this status
+ */
+static unsigned int sandev_count_paths ( struct san_device *sandev,
+					 int path_rc ) {
+	unsigned int count = 0;
+	unsigned int i;
+
+	for ( i = 0 ; i < sandev->paths ; i++ ) {
+		if ( sandev->path[i].path_rc == path_rc )
+			count++;
+	}
+	return count;
+}
+
+/**
+ * Close SAN device path
+ *
+ * @v path		SAN path
  * @v rc		Reason for close
+ *
+ * Any commands in progress via this path will be closed, and may be
+ * retried via any other available path.  The device as a whole
+ * requires reopening only once no available paths remain.
  */
-static void sandev_command_close ( struct san_device *sandev, int rc ) {
+static void sandev_path_close ( struct san_path *path, int rc ) {
+	struct san_device *sandev = path->sandev;
+	struct san_command *cmd;
+	unsigned int i;
+
+	/* Record path status */
+	path->path_rc = rc;
+
+	/* Restart block device interface */
+	intf_restart ( &path->block, rc );
+
+	/* Close any outstanding commands using this path */
+	for ( i = 0 ; i < SAN_COMMAND_MAX ; i++ ) {
+		cmd = &sandev->commands[i];
+		if ( cmd->path == path )
+			sandev_command_close ( cmd, rc );
+	}
+
+	/* Choose a new primary path, if applicable */
+	if ( sandev->active != path )
+		return;
+	sandev->active = NULL;
+	for ( i = 0 ; i < sandev->paths ; i++ ) {
+		if ( sandev->path[i].path_rc == 0 ) {
+			sandev->active = &sandev->path[i];
+			return;
+		}
+	}
+
+	/* Record device error */
+	sandev->block_rc = rc;
+}
+
+/**
+ * Check for newly available SAN device paths
+ *
+ * @v sandev		SAN device
+ */
+static void sandev_poll_paths ( struct san_device *sandev ) {
+	struct san_path *path;
+	unsigned int i;
+
+	for ( i = 0 ; i < sandev->paths ; i++ ) {
+		path = &sandev->path[i];
+		if ( ( path->path_rc != -EINPROGRESS ) ||
+		     ( xfer_window ( &path->block ) == 0 ) )
+			continue;
+		DBGC ( sandev, "SAN %#02x.%d is available\n",
+		       sandev->drive, path->index );
+		path->path_rc = 0;
+		if ( sandev->active ) {
+			sandev->concurrent = 1;
+		} else {
+			sandev->active = path;
+			sandev->block_rc = 0;
+		}
+	}
+}
+
+/**
+ * Select SAN device path for a new command
+ *
+ * @v sandev		SAN device
+ * @ret path		SAN path, or NULL if no path can accept a command
+ *
+ * The available path with the fewest commands in progress is chosen,
+ * with ties broken in round-robin order.
+ */
+static struct san_path * sandev_select_path ( struct san_device *sandev ) {
+	struct san_path *path;
+	struct san_path *best = NULL;
+	unsigned int i;
+
+	/* Check for paths that have completed opening */
+	sandev_poll_paths ( sandev );
+
+	/* Find least busy path that is able to accept a command */
+	for ( i = 0 ; i < sandev->paths ; i++ ) {
+		path = &sandev->path[ ( sandev->next + i ) % sandev->paths ];
+		if ( path->path_rc != 0 )
+			continue;
+		if ( path->active && ( xfer_window ( &path->block ) == 0 ) )
+			continue;
+		if ( ( ! best ) || ( path->active < best->active ) )
+			best = path;
+	}
+	if ( best )
+		sandev->next = ( best->index + 1 );
+
+	return best;
+}
+
+/**
+ * Close SAN device command
+ *
+ * @v cmd		SAN device command
+ * @v rc		Reason for close
+ */
+static void sandev_command_close ( struct san_command *cmd, int rc ) {
+	struct san_device *sandev = cmd->sandev;
+	struct san_path *path = cmd->path;
 
 	/* Stop timer */
-	stop_timer ( &sandev->timer );
+	stop_timer ( &cmd->timer );
 
 	/* Restart interface */
-	intf_restart ( &sandev->command, rc );
+	intf_restart ( &cmd->command, rc );
 
 	/* Record command status */
-	sandev->command_rc = rc;
+	cmd->rc = rc;
+
+	/* Release path */
+	if ( ! path )
+		return;
+	cmd->path = NULL;
+	path->active--;
+
+	/* Demote a failing path if any other path remains available */
+	if ( ( rc != 0 ) && ( path->path_rc == 0 ) &&
+	     ( sandev_count_paths ( sandev, 0 ) > 1 ) ) {
+		DBGC ( sandev, "SAN %#02x.%d demoted: %s\n",
+		       sandev->drive, path->index, strerror ( rc ) );
+		sandev_path_close ( path, rc );
+	}
 }
 
 /**
  * Record SAN device capacity
  *
- * @v sandev		SAN device
+ * @v cmd		SAN device command
  * @v capacity		SAN device capacity
  */
-static void sandev_command_capacity ( struct san_device *sandev,
+static void sandev_command_capacity ( struct san_command *cmd,
 				      struct block_device_capacity *capacity ) {
+	struct san_device *sandev = cmd->sandev;
 
 	/* Record raw capacity information */
 	memcpy ( &sandev->capacity, capacity, sizeof ( sandev->capacity ) );
@@ -140,14 +383,14 @@ static void sandev_command_capacity ( struct san_device *sandev,
 
 /** SAN device command interface operations */
 static struct interface_operation sandev_command_op[] = {
-	INTF_OP ( intf_close, struct san_device *, sandev_command_close ),
-	INTF_OP ( block_capacity, struct san_device *,
+	INTF_OP ( intf_close, struct san_command *, sandev_command_close ),
+	INTF_OP ( block_capacity, struct san_command *,
 		  sandev_command_capacity ),
 };
 
 /** SAN device command interface descriptor */
 static struct interface_descriptor sandev_command_desc =
-	INTF_DESC ( struct san_device, command, sandev_command_op );
+	INTF_DESC ( struct san_command, command, sandev_command_op );
 
 /**
  * Handle SAN device command timeout
@@ -156,27 +399,31 @@ static struct interface_descriptor sandev_command_desc =
  */
 static void sandev_command_expired ( struct retry_timer *timer,
 				     int over __unused ) {
-	struct san_device *sandev =
-		container_of ( timer, struct san_device, timer );
+	struct san_command *cmd =
+		container_of ( timer, struct san_command, timer );
 
-	sandev_command_close ( sandev, -ETIMEDOUT );
+	sandev_command_close ( cmd, -ETIMEDOUT );
 }
 
 /**
- * Restart SAN device interface
+ * Restart SAN device interfaces
  *
  * @v sandev		SAN device
  * @v rc		Reason for restart
  */
 static void sandev_restart ( struct san_device *sandev, int rc ) {
+	unsigned int i;
 
-	/* Restart block device interface */
-	intfs_restart ( rc, &sandev->command, &sandev->block, NULL );
+	/* Restart all paths */
+	for ( i = 0 ; i < sandev->paths ; i++ )
+		sandev_path_close ( &sandev->path[i], rc );
 
-	/* Close any outstanding command */
-	sandev_command_close ( sandev, rc );
+	/* Close any outstanding commands */
+	for ( i = 0 ; i < SAN_COMMAND_MAX ; i++ )
+		sandev_command_close ( &sandev->commands[i], rc );
 
 	/* Record device error */
+	sandev->active = NULL;
 	sandev->block_rc = rc;
 }
 
@@ -186,62 +433,75 @@ static void sandev_restart ( struct san_device *sandev, int rc ) {
  * @v sandev		SAN device
  * @ret rc		Return status code
  *
- * This function will block until the device is available.
+ * All paths are opened concurrently.  This function will block until
+ * at least one path is available; any remaining paths will be used
+ * as and when they also become available.
  */
 int sandev_reopen ( struct san_device *sandev ) {
+	struct san_path *path;
+	unsigned int i;
 	int rc;
 
-	/* Close any outstanding command and restart interface */
+	/* Close any outstanding commands and restart interfaces */
 	sandev_restart ( sandev, -ECONNRESET );
 
-	/* Mark device as being not yet open */
+	/* Mark device and all paths as being not yet open */
 	sandev->block_rc = -EINPROGRESS;
-
-	/* Open block device interface */
-	if ( ( rc = xfer_open_uri ( &sandev->block, sandev->uri ) ) != 0 ) {
-		DBGC ( sandev, "SAN %#02x could not (re)open URI: %s\n",
-		       sandev->drive, strerror ( rc ) );
-		return rc;
+	for ( i = 0 ; i < sandev->paths ; i++ )
+		sandev->path[i].path_rc = -EINPROGRESS;
+
+	/* Open block device interface for each path */
+	for ( i = 0 ; i < sandev->paths ; i++ ) {
+		path = &sandev->path[i];
+		if ( ( rc = xfer_open_uri ( &path->block, path->uri ) ) != 0 ) {
+			DBGC ( sandev, "SAN %#02x.%d could not (re)open URI: "
+			       "%s\n", sandev->drive, path->index,
+			       strerror ( rc ) );
+			sandev_path_close ( path, rc );
+		}
 	}
 
-	/* Wait for device to become available */
-	while ( sandev->block_rc == -EINPROGRESS ) {
-		step();
-		if ( xfer_window ( &sandev->block ) != 0 ) {
-			sandev->block_rc = 0;
+	/* Wait for any path to become available */
+	while ( sandev_count_paths ( sandev, -EINPROGRESS ) ) {
+		sandev_poll_paths ( sandev );
+		if ( sandev->active )
 			return 0;
-		}
+		step();
 	}
 
+	/* Record device error */
+	rc = ( sandev->paths ? sandev->path[0].path_rc : -ENODEV );
+	sandev->block_rc = rc;
 	DBGC ( sandev, "SAN %#02x never became available: %s\n",
-	       sandev->drive, strerror ( sandev->block_rc ) );
-	return sandev->block_rc;
+	       sandev->drive, strerror ( rc ) );
+	return rc;
 }
 
 /**
  * Handle closure of underlying block device interface
  *
- * @v sandev		SAN device
+ * @v path		SAN path
  * @ret rc		Reason for close
  */
-static void sandev_block_close ( struct san_device *sandev, int rc ) {
+static void sandev_block_close ( struct san_path *path, int rc ) {
+	struct san_device *sandev = path->sandev;
 
 	/* Any closure is an error from our point of view */
 	if ( rc == 0 )
 		rc = -ENOTCONN;
-	DBGC ( sandev, "SAN %#02x went away: %s\n",
-	       sandev->drive, strerror ( rc ) );
+	DBGC ( sandev, "SAN %#02x.%d went away: %s\n",
+	       sandev->drive, path->index, strerror ( rc ) );
 
-	/* Close any outstanding command and restart interface */
-	sandev_restart ( sandev, rc );
+	/* Close any outstanding commands and restart interface */
+	sandev_path_close ( path, rc );
 }
 
 /**
  * Check SAN device flow control window
  *
- * @v sandev		SAN device
+ * @v path		SAN path
  */
-static size_t sandev_block_window ( struct san_device *sandev __unused ) {
+static size_t sandev_block_window ( struct san_path *path __unused ) {
 
 	/* We are never ready to receive data via this interface.
 	 * This prevents objects that support both block and stream
@@ -252,13 +512,13 @@ static size_t sandev_block_window ( struct san_device *sandev __unused ) {
 
 /** SAN device block interface operations */
 static struct interface_operation sandev_block_op[] = {
-	INTF_OP ( intf_close, struct san_device *, sandev_block_close ),
-	INTF_OP ( xfer_window, struct san_device *, sandev_block_window ),
+	INTF_OP ( intf_close, struct san_path *, sandev_block_close ),
+	INTF_OP ( xfer_window, struct san_path *, sandev_block_window ),
 };
 
 /** SAN device block interface descriptor */
 static struct interface_descriptor sandev_block_desc =
-	INTF_DESC ( struct san_device, block, sandev_block_op );
+	INTF_DESC ( struct san_path, block, sandev_block_op );
 
 /** SAN device read/write command parameters */
 struct san_command_rw_params {
@@ -283,17 +543,18 @@ union san_command_params {
 /**
  * Initiate SAN device read/write command
  *
- * @v sandev		SAN device
+ * @v cmd		SAN device command
  * @v params		Command parameters
  * @ret rc		Return status code
  */
-static int sandev_command_rw ( struct san_device *sandev,
+static int sandev_command_rw ( struct san_command *cmd,
 			       const union san_command_params *params ) {
+	struct san_device *sandev = cmd->sandev;
 	size_t len = ( params->rw.count * sandev->capacity.blksize );
 	int rc;
 
 	/* Initiate read/write command */
-	if ( ( rc = params->rw.block_rw ( &sandev->block, &sandev->command,
+	if ( ( rc = params->rw.block_rw ( &cmd->path->block, &cmd->command,
 					  params->rw.lba, params->rw.count,
 					  params->rw.buffer, len ) ) != 0 ) {
 		DBGC ( sandev, "SAN %#02x could not initiate read/write: "
@@ -307,18 +568,19 @@ static int sandev_command_rw ( struct san_device *sandev,
 /**
  * Initiate SAN device read capacity command
  *
- * @v sandev		SAN device
+ * @v cmd		SAN device command
  * @v params		Command parameters
  * @ret rc		Return status code
  */
 static int
-sandev_command_read_capacity ( struct san_device *sandev,
+sandev_command_read_capacity ( struct san_command *cmd,
 			       const union san_command_params *params __unused){
+	struct san_device *sandev = cmd->sandev;
 	int rc;
 
 	/* Initiate read capacity command */
-	if ( ( rc = block_read_capacity ( &sandev->block,
-					  &sandev->command ) ) != 0 ) {
+	if ( ( rc = block_read_capacity ( &cmd->path->block,
+					  &cmd->command ) ) != 0 ) {
 		DBGC ( sandev, "SAN %#02x could not initiate read capacity: "
 		       "%s\n", sandev->drive, strerror ( rc ) );
 		return rc;
@@ -327,6 +589,46 @@ sandev_command_read_capacity ( struct san_device *sandev,
 	return 0;
 }
 
+/**
+ * Start SAN device command
+ *
+ * @v cmd		SAN device command
+ * @v path		SAN path
+ * @v command		Command
+ * @v params		Command parameters (if required)
+ * @ret rc		Return status code
+ *
+ * The command is complete once its timer is no longer running.
+ */
+static int
+sandev_command_start ( struct san_command *cmd, struct san_path *path,
+		       int ( * command ) ( struct san_command *cmd,
+					   const union san_command_params
+					   *params ),
+		       const union san_command_params *params ) {
+	int rc;
+
+	/* Sanity check */
+	assert ( ! timer_running ( &cmd->timer ) );
+	assert ( cmd->path == NULL );
+
+	/* Start expiry timer */
+	start_timer_fixed ( &cmd->timer, SAN_COMMAND_TIMEOUT );
+
+	/* Initiate command */
+	cmd->rc = -EINPROGRESS;
+	cmd->path = path;
+	if ( ( rc = command ( cmd, params ) ) != 0 ) {
+		stop_timer ( &cmd->timer );
+		cmd->path = NULL;
+		cmd->rc = rc;
+		return rc;
+	}
+	path->active++;
+
+	return 0;
+}
+
 /**
  * Execute a single SAN device command and wait for completion
  *
@@ -337,15 +639,13 @@ sandev_command_read_capacity ( struct san_device *sandev,
  */
 static int
 sandev_command ( struct san_device *sandev,
-		 int ( * command ) ( struct san_device *sandev,
+		 int ( * command ) ( struct san_command *cmd,
 				     const union san_command_params *params ),
 		 const union san_command_params *params ) {
+	struct san_command *cmd = &sandev->commands[0];
 	unsigned int retries;
 	int rc;
 
-	/* Sanity check */
-	assert ( ! timer_running ( &sandev->timer ) );
-
 	/* (Re)try command */
 	for ( retries = 0 ; retries < SAN_COMMAND_MAX_RETRIES ; retries++ ) {
 
@@ -355,26 +655,23 @@ sandev_command ( struct san_device *sandev,
 			continue;
 		}
 
-		/* Start expiry timer */
-		start_timer_fixed ( &sandev->timer, SAN_COMMAND_TIMEOUT );
-
-		/* Initiate command */
-		if ( ( rc = command ( sandev, params ) ) != 0 ) {
-			stop_timer ( &sandev->timer );
+		/* Initiate command via primary path */
+		if ( ( rc = sandev_command_start ( cmd, sandev->active,
+						   command, params ) ) != 0 ) {
 			continue;
 		}
 
 		/* Wait for command to complete */
-		while ( timer_running ( &sandev->timer ) )
+		while ( timer_running ( &cmd->timer ) )
 			step();
 
 		/* Exit on success */
-		if ( ( rc = sandev->command_rc ) == 0 )
+		if ( ( rc = cmd->rc ) == 0 )
 			return 0;
 	}
 
 	/* Sanity check */
-	assert ( ! timer_running ( &sandev->timer ) );
+	assert ( ! timer_running ( &cmd->timer ) );
 
 	return rc;
 }
@@ -394,6 +691,736 @@ int sandev_reset ( struct san_device *sandev ) {
 	if ( ( rc = sandev_reopen ( sandev ) ) != 0 )
 		return rc;
 
+	/* Write out any buffered writes */
+	if ( ( rc = sandev_flush ( sandev ) ) != 0 )
+		return rc;
+
+	return 0;
+}
+
+/**
+ * Read from or write to SAN device, bypassing the block cache
+ *
+ * @v sandev		SAN device
+ * @v lba		Starting underlying logical block address
+ * @v count		Number of underlying logical blocks
+ * @v buffer		Data buffer
+ * @v block_rw		Block read/write method
+ * @ret rc		Return status code
+ *
+ * The request is split into fragments, which are issued concurrently
+ * for as long as the underlying block device continues to advertise
+ * a non-zero flow control window.  Each fragment is retried
+ * independently.
+ */
+static int sandev_rw_uncached ( struct san_device *sandev, uint64_t lba,
+				unsigned int count, userptr_t buffer,
+				int ( * block_rw ) ( struct interface *control,
+						     struct interface *data,
+						     uint64_t lba,
+						     unsigned int count,
+						     userptr_t buffer,
+						     size_t len ) ) {
+	union san_command_params params[SAN_COMMAND_MAX];
+	unsigned int retries[SAN_COMMAND_MAX];
+	unsigned int state[SAN_COMMAND_MAX];
+	struct san_command *cmd;
+	struct san_path *path;
+	unsigned int frag_max;
+	unsigned int frag_min;
+	unsigned int running = 0;
+	unsigned int pending;
+	unsigned int i;
+	size_t frag_len;
+	int rc;
+
+	/* Determine maximum fragment length.  If the device is known
+	 * to accept concurrent commands, then split the request
+	 * between the available command slots.
+	 */
+	frag_max = sandev->capacity.max_count;
+	if ( sandev->concurrent ) {
+		frag_min = ( SAN_COMMAND_MIN_LEN / sandev->capacity.blksize );
+		if ( frag_max > frag_min ) {
+			frag_max = ( ( count + SAN_COMMAND_MAX - 1 ) /
+				     SAN_COMMAND_MAX );
+			if ( frag_max < frag_min )
+				frag_max = frag_min;
+			if ( frag_max > sandev->capacity.max_count )
+				frag_max = sandev->capacity.max_count;
+		}
+	}
+
+	/* Mark all command slots as free */
+	for ( i = 0 ; i < SAN_COMMAND_MAX ; i++ )
+		state[i] = SAN_COMMAND_FREE;
+
+	while ( 1 ) {
+
+		/* Assign fragments to free command slots */
+		pending = 0;
+		for ( i = 0 ; i < SAN_COMMAND_MAX ; i++ ) {
+			if ( count && ( state[i] == SAN_COMMAND_FREE ) ) {
+				params[i].rw.block_rw = block_rw;
+				params[i].rw.buffer = buffer;
+				params[i].rw.lba = lba;
+				params[i].rw.count = frag_max;
+				if ( params[i].rw.count > count )
+					params[i].rw.count = count;
+				retries[i] = 0;
+				state[i] = SAN_COMMAND_PENDING;
+				frag_len = ( sandev->capacity.blksize *
+					     params[i].rw.count );
+				buffer = userptr_add ( buffer, frag_len );
+				lba += params[i].rw.count;
+				count -= params[i].rw.count;
+			}
+			if ( state[i] == SAN_COMMAND_PENDING )
+				pending++;
+		}
+
+		/* Exit on completion */
+		if ( ! ( pending || running ) )
+			return 0;
+
+		/* Reopen block device if applicable, once all
+		 * outstanding commands have completed.
+		 */
+		if ( sandev_needs_reopen ( sandev ) && ! running &&
+		     ( ( rc = sandev_reopen ( sandev ) ) != 0 ) ) {
+			for ( i = 0 ; i < SAN_COMMAND_MAX ; i++ ) {
+				if ( ( state[i] == SAN_COMMAND_PENDING ) &&
+				     ( ++retries[i] >= SAN_COMMAND_MAX_RETRIES))
+					goto err;
+			}
+			continue;
+		}
+
+		/* Issue pending commands, for as long as any path is
+		 * able to accept them.
+		 */
+		for ( i = 0 ; i < SAN_COMMAND_MAX ; i++ ) {
+			if ( state[i] != SAN_COMMAND_PENDING )
+				continue;
+			if ( sandev_needs_reopen ( sandev ) )
+				break;
+			path = sandev_select_path ( sandev );
+			if ( ! path )
+				break;
+			cmd = &sandev->commands[i];
+			if ( ( rc = sandev_command_start ( cmd, path,
+							   sandev_command_rw,
+							   &params[i] ) ) !=0){
+				if ( ++retries[i] >= SAN_COMMAND_MAX_RETRIES )
+					goto err;
+				break;
+			}
+			state[i] = SAN_COMMAND_RUNNING;
+			running++;
+			if ( xfer_window ( &path->block ) != 0 )
+				sandev->concurrent = 1;
+		}
+
+		/* Wait for a command to complete */
+		if ( running )
+			step();
+
+		/* Collect completed commands */
+		for ( i = 0 ; i < SAN_COMMAND_MAX ; i++ ) {
+			cmd = &sandev->commands[i];
+			if ( ( state[i] != SAN_COMMAND_RUNNING ) ||
+			     timer_running ( &cmd->timer ) )
+				continue;
+			running--;
+			if ( ( rc = cmd->rc ) == 0 ) {
+				state[i] = SAN_COMMAND_FREE;
+			} else if ( ++retries[i] >= SAN_COMMAND_MAX_RETRIES ) {
+				goto err;
+			} else {
+				state[i] = SAN_COMMAND_PENDING;
+			}
+		}
+	}
+
+ err:
+	/* Abort any outstanding commands */
+	for ( i = 0 ; i < SAN_COMMAND_MAX ; i++ ) {
+		if ( state[i] == SAN_COMMAND_RUNNING )
+			sandev_command_close ( &sandev->commands[i], rc );
+	}
+	return rc;
+}
+
+/**
+ * Find block cache hash bucket
+ *
+ * @v cache		Block cache
+ * @v lba		Starting underlying logical block address of line
+ * @ret bucket		Hash bucket
+ */
+static struct list_head * sandev_cache_bucket ( struct san_cache *cache,
+						uint64_t lba ) {
+	unsigned int index;
+
+	index = ( ( lba / cache->blocks ) % SAN_CACHE_BUCKETS );
+	return &cache->hash[index];
+}
+
+/**
+ * Find block cache line
+ *
+ * @v cache		Block cache
+ * @v lba		Starting underlying logical block address of line
+ * @ret line		Cache line, or NULL if not present
+ */
+static struct san_cache_line * sandev_cache_find ( struct san_cache *cache,
+						   uint64_t lba ) {
+	struct san_cache_line *line;
+
+	list_for_each_entry ( line, sandev_cache_bucket ( cache, lba ),
+			      hash ) {
+		if ( line->lba == lba )
+			return line;
+	}
+	return NULL;
+}
+
+/**
+ * Calculate block cache line data offset
+ *
+ * @v sandev		SAN device
+ * @v line		Cache line
+ * @ret offset		Offset within cached data
+ */
+static inline off_t sandev_cache_offset ( struct san_device *sandev,
+					  struct san_cache_line *line ) {
+	struct san_cache *cache = &sandev->cache;
+
+	return ( ( line - cache->lines ) *
+		 ( cache->blocks * sandev->capacity.blksize ) );
+}
+
+/**
+ * Mark block cache line as most recently used
+ *
+ * @v cache		Block cache
+ * @v line		Cache line
+ */
+static inline void sandev_cache_touch ( struct san_cache *cache,
+					struct san_cache_line *line ) {
+
+	list_del ( &line->lru );
+	list_add ( &line->lru, &cache->lru );
+}
+
+/**
+ * Invalidate block cache line
+ *
+ * @v cache		Block cache
+ * @v line		Cache line
+ */
+static void sandev_cache_invalidate ( struct san_cache *cache,
+				      struct san_cache_line *line ) {
+
+	/* Remove from hash bucket and mark as least recently used */
+	list_del ( &line->hash );
+	INIT_LIST_HEAD ( &line->hash );
+	list_del ( &line->lru );
+	list_add_tail ( &line->lru, &cache->lru );
+}
+
+/**
+ * Read from block cache
+ *
+ * @v sandev		SAN device
+ * @v lba		Starting underlying logical block address
+ * @v count		Number of underlying logical blocks
+ * @v buffer		Data buffer
+ * @ret copied		Number of underlying logical blocks copied
+ *
+ * The longest cached prefix of the requested range is copied.
+ */
+static unsigned int sandev_cache_copy ( struct san_device *sandev,
+					uint64_t lba, unsigned int count,
+					userptr_t buffer ) {
+	struct san_cache *cache = &sandev->cache;
+	size_t blksize = sandev->capacity.blksize;
+	struct san_cache_line *line;
+	unsigned int copied = 0;
+	unsigned int skip;
+	unsigned int frag;
+	off_t offset = 0;
+
+	while ( count ) {
+
+		/* Find cache line */
+		skip = ( lba % cache->blocks );
+		line = sandev_cache_find ( cache, ( lba - skip ) );
+		if ( ! line )
+			break;
+		sandev_cache_touch ( cache, line );
+
+		/* Copy data */
+		frag = ( cache->blocks - skip );
+		if ( frag > count )
+			frag = count;
+		memcpy_user ( buffer, offset, cache->data,
+			      ( sandev_cache_offset ( sandev, line ) +
+				( skip * blksize ) ), ( frag * blksize ) );
+
+		/* Move to next cache line */
+		offset += ( frag * blksize );
+		lba += frag;
+		count -= frag;
+		copied += frag;
+	}
+
+	return copied;
+}
+
+/**
+ * Add fetched data to block cache
+ *
+ * @v sandev		SAN device
+ * @v lba		Starting underlying logical block address of line
+ * @v offset		Offset within fetch buffer
+ */
+static void sandev_cache_add ( struct san_device *sandev, uint64_t lba,
+			       off_t offset ) {
+	struct san_cache *cache = &sandev->cache;
+	struct san_cache_line *line;
+
+	/* Reuse existing line, or evict least recently used line */
+	line = sandev_cache_find ( cache, lba );
+	if ( ! line ) {
+		line = list_last_entry ( &cache->lru, struct san_cache_line,
+					 lru );
+		assert ( line != NULL );
+		list_del ( &line->hash );
+		line->lba = lba;
+		list_add ( &line->hash, sandev_cache_bucket ( cache, lba ) );
+	}
+	sandev_cache_touch ( cache, line );
+
+	/* Copy data */
+	memcpy_user ( cache->data, sandev_cache_offset ( sandev, line ),
+		      cache->fetch, offset,
+		      ( cache->blocks * sandev->capacity.blksize ) );
+}
+
+/**
+ * Fetch range of blocks into block cache
+ *
+ * @v sandev		SAN device
+ * @v start		Starting underlying logical block address
+ * @v end		Ending underlying logical block address
+ * @ret rc		Return status code
+ *
+ * The range must start on a cache line boundary and must fit within
+ * the fetch buffer.  All complete lines within the range will be
+ * added to the cache.
+ */
+static int sandev_cache_fetch ( struct san_device *sandev, uint64_t start,
+				uint64_t end ) {
+	struct san_cache *cache = &sandev->cache;
+	size_t blksize = sandev->capacity.blksize;
+	uint64_t pos;
+	int rc;
+
+	/* Read into fetch buffer */
+	if ( ( rc = sandev_rw_uncached ( sandev, start, ( end - start ),
+					 cache->fetch, block_read ) ) != 0 )
+		return rc;
+
+	/* Add all complete lines to cache */
+	for ( pos = start ; ( pos + cache->blocks ) <= end ;
+	      pos += cache->blocks ) {
+		sandev_cache_add ( sandev, pos, ( ( pos - start ) * blksize ) );
+	}
+
+	return 0;
+}
+
+/**
+ * Prefetch range of blocks into block cache
+ *
+ * @v sandev		SAN device
+ * @v lba		Starting underlying logical block address
+ * @v count		Number of underlying logical blocks
+ *
+ * The range will be truncated to fit within the fetch buffer.  Any
+ * leading cache lines that are already present will not be fetched
+ * again.  Prefetching is an optimisation, and so failures are
+ * ignored.
+ */
+static void sandev_prefetch ( struct san_device *sandev, uint64_t lba,
+			      unsigned int count ) {
+	struct san_cache *cache = &sandev->cache;
+	uint64_t start;
+	uint64_t end;
+	int rc;
+
+	/* Do nothing unless cache is in use */
+	if ( ! cache->lines )
+		return;
+
+	/* Calculate range to be fetched, aligned to cache lines */
+	start = ( lba - ( lba % cache->blocks ) );
+	end = ( lba + count + cache->blocks - 1 );
+	end -= ( end % cache->blocks );
+	if ( end > ( start + cache->fetch_blocks ) )
+		end = ( start + cache->fetch_blocks );
+	if ( end > sandev->capacity.blocks )
+		end = sandev->capacity.blocks;
+
+	/* Skip any leading lines already present in the cache */
+	while ( ( start < end ) && sandev_cache_find ( cache, start ) )
+		start += cache->blocks;
+	if ( start >= end )
+		return;
+
+	/* Fetch into cache */
+	DBGC ( sandev, "SAN %#02x prefetching [%#08llx,%#08llx)\n",
+	       sandev->drive, ( ( unsigned long long ) start ),
+	       ( ( unsigned long long ) end ) );
+	if ( ( rc = sandev_cache_fetch ( sandev, start, end ) ) != 0 ) {
+		DBGC ( sandev, "SAN %#02x could not prefetch: %s\n",
+		       sandev->drive, strerror ( rc ) );
+	}
+}
+
+/**
+ * Read from SAN device via block cache
+ *
+ * @v sandev		SAN device
+ * @v lba		Starting underlying logical block address
+ * @v count		Number of underlying logical blocks
+ * @v buffer		Data buffer
+ * @ret rc		Return status code
+ */
+static int sandev_cache_read ( struct san_device *sandev, uint64_t lba,
+			       unsigned int count, userptr_t buffer ) {
+	struct san_cache *cache = &sandev->cache;
+	size_t blksize = sandev->capacity.blksize;
+	unsigned int copied;
+	uint64_t start;
+	uint64_t end;
+	uint64_t limit;
+	int sequential;
+	int rc;
+
+	/* Check for a sequential read */
+	sequential = ( lba == cache->next_lba );
+	cache->next_lba = ( lba + count );
+	if ( ! sequential )
+		cache->readahead = ( SAN_CACHE_READAHEAD_LEN / blksize );
+
+	/* Satisfy from cache, if possible */
+	profile_start ( &sandev_cache_hit_profiler );
+	copied = sandev_cache_copy ( sandev, lba, count, buffer );
+	if ( copied == count ) {
+		profile_stop ( &sandev_cache_hit_profiler );
+		return 0;
+	}
+	profile_start ( &sandev_cache_miss_profiler );
+
+	/* Fetch only the portion not already present in the cache */
+	lba += copied;
+	count -= copied;
+	buffer = userptr_add ( buffer, ( copied * blksize ) );
+
+	/* Calculate range to be fetched, aligned to cache lines and
+	 * extended by the read-ahead length for a sequential read.
+	 */
+	start = ( lba - ( lba % cache->blocks ) );
+	end = ( lba + count + cache->blocks - 1 );
+	end -= ( end % cache->blocks );
+	if ( sequential ) {
+		end += cache->readahead;
+		cache->readahead *= 2;
+		if ( cache->readahead > cache->fetch_blocks )
+			cache->readahead = cache->fetch_blocks;
+	}
+	limit = ( start + cache->fetch_blocks );
+	if ( end > limit )
+		end = limit;
+	if ( end > sandev->capacity.blocks )
+		end = sandev->capacity.blocks;
+
+	/* Bypass cache if request does not fit within fetch buffer */
+	if ( ( lba + count ) > end ) {
+		rc = sandev_rw_uncached ( sandev, lba, count, buffer,
+					  block_read );
+		goto done;
+	}
+
+	/* Read into fetch buffer and add to cache */
+	if ( ( rc = sandev_cache_fetch ( sandev, start, end ) ) != 0 )
+		goto done;
+
+	/* Copy out requested data */
+	memcpy_user ( buffer, 0, cache->fetch, ( ( lba - start ) * blksize ),
+		      ( count * blksize ) );
+
+ done:
+	profile_stop ( &sandev_cache_miss_profiler );
+	return rc;
+}
+
+/**
+ * Invalidate block cache for a range of blocks
+ *
+ * @v sandev		SAN device
+ * @v lba		Starting underlying logical block address
+ * @v count		Number of underlying logical blocks
+ */
+static void sandev_cache_discard ( struct san_device *sandev, uint64_t lba,
+				   unsigned int count ) {
+	struct san_cache *cache = &sandev->cache;
+	struct san_cache_line *line;
+	uint64_t end = ( lba + count );
+	uint64_t pos;
+
+	for ( pos = ( lba - ( lba % cache->blocks ) ) ; pos < end ;
+	      pos += cache->blocks ) {
+		if ( ( line = sandev_cache_find ( cache, pos ) ) )
+			sandev_cache_invalidate ( cache, line );
+	}
+}
+
+/**
+ * Initialise SAN device block cache
+ *
+ * @v sandev		SAN device
+ *
+ * The block cache is an optimisation.  Failure to allocate the cache
+ * is not an error.
+ */
+static void sandev_cache_init ( struct san_device *sandev ) {
+	struct san_cache *cache = &sandev->cache;
+	size_t blksize = sandev->capacity.blksize;
+	unsigned long size;
+	size_t fetch_len;
+	size_t line_len;
+	unsigned int i;
+
+	/* Determine cache size */
+	if ( fetch_uint_setting ( NULL, &san_cache_setting, &size ) < 0 )
+		size = SAN_CACHE_SIZE;
+	size *= 1024;
+
+	/* Determine cache line length */
+	line_len = SAN_CACHE_LINE_LEN;
+	if ( ( ! blksize ) || ( blksize > SAN_CACHE_FETCH_LEN ) )
+		return;
+	if ( line_len < blksize )
+		line_len = blksize;
+	line_len -= ( line_len % blksize );
+	cache->blocks = ( line_len / blksize );
+	cache->count = ( size / line_len );
+	fetch_len = ( size / 2 );
+	if ( fetch_len < SAN_CACHE_FETCH_LEN )
+		fetch_len = SAN_CACHE_FETCH_LEN;
+	if ( fetch_len > SAN_CACHE_FETCH_MAX )
+		fetch_len = SAN_CACHE_FETCH_MAX;
+	cache->fetch_blocks = ( fetch_len / line_len ) * cache->blocks;
+	if ( ! cache->count )
+		return;
+
+	/* Allocate cache */
+	cache->lines = zalloc ( cache->count * sizeof ( cache->lines[0] ) );
+	if ( ! cache->lines )
+		goto err_lines;
+	cache->data = umalloc ( cache->count * line_len );
+	if ( ! cache->data )
+		goto err_data;
+	cache->fetch = umalloc ( cache->fetch_blocks * blksize );
+	if ( ! cache->fetch )
+		goto err_fetch;
+
+	/* Initialise cache */
+	for ( i = 0 ; i < SAN_CACHE_BUCKETS ; i++ )
+		INIT_LIST_HEAD ( &cache->hash[i] );
+	INIT_LIST_HEAD ( &cache->lru );
+	for ( i = 0 ; i < cache->count ; i++ ) {
+		INIT_LIST_HEAD ( &cache->lines[i].hash );
+		list_add_tail ( &cache->lines[i].lru, &cache->lru );
+	}
+	cache->next_lba = -1ULL;
+	DBGC ( sandev, "SAN %#02x using %d x %zd-byte block cache with "
+	       "%zd-byte fetch buffer\n", sandev->drive, cache->count,
+	       line_len, ( cache->fetch_blocks * blksize ) );
+
+	return;
+
+	ufree ( cache->fetch );
+ err_fetch:
+	ufree ( cache->data );
+ err_data:
+	free ( cache->lines );
+ err_lines:
+	DBGC ( sandev, "SAN %#02x could not allocate block cache\n",
+	       sandev->drive );
+	memset ( cache, 0, sizeof ( *cache ) );
+}
+
+/**
+ * Free SAN device block cache
+ *
+ * @v sandev		SAN device
+ */
+static void sandev_cache_free ( struct san_device *sandev ) {
+	struct san_cache *cache = &sandev->cache;
+
+	ufree ( cache->dirty );
+	ufree ( cache->fetch );
+	ufree ( cache->data );
+	free ( cache->lines );
+	memset ( cache, 0, sizeof ( *cache ) );
+}
+
+/**
+ * Initialise SAN device write-back buffer
+ *
+ * @v sandev		SAN device
+ *
+ * The write-back buffer is an optimisation.  Failure to allocate the
+ * buffer is not an error.  Write-back is used only if the SAN boot
+ * mechanism guarantees to flush the device before handing over to an
+ * operating system, since buffered writes would otherwise be lost.
+ */
+static void sandev_writeback_init ( struct san_device *sandev ) {
+	struct san_cache *cache = &sandev->cache;
+	size_t blksize = sandev->capacity.blksize;
+	unsigned long size;
+
+	/* Determine buffer size */
+	if ( fetch_uint_setting ( NULL, &san_writeback_setting, &size ) < 0 )
+		size = SAN_WRITEBACK_SIZE;
+	size *= 1024;
+	if ( ! blksize )
+		return;
+	if ( ! ( size / blksize ) )
+		return;
+
+	/* Refuse write-back if nothing will flush at handover */
+	if ( ! sandev->handover_flush ) {
+		DBGC ( sandev, "SAN %#02x cannot use write-back buffer: no "
+		       "flush at operating system handover\n", sandev->drive );
+		return;
+	}
+
+	/* Allocate buffer */
+	cache->dirty = umalloc ( size );
+	if ( ! cache->dirty ) {
+		DBGC ( sandev, "SAN %#02x could not allocate write-back "
+		       "buffer\n", sandev->drive );
+		return;
+	}
+	cache->dirty_max = ( size / blksize );
+	DBGC ( sandev, "SAN %#02x using %zd-byte write-back buffer\n",
+	       sandev->drive, ( cache->dirty_max * blksize ) );
+}
+
+/**
+ * Check if a range of blocks overlaps buffered writes
+ *
+ * @v sandev		SAN device
+ * @v lba		Starting underlying logical block address
+ * @v count		Number of underlying logical blocks
+ * @ret overlaps	Range overlaps buffered writes
+ */
+static int sandev_writeback_overlaps ( struct san_device *sandev,
+				       uint64_t lba, unsigned int count ) {
+	struct san_cache *cache = &sandev->cache;
+
+	return ( cache->dirty_count &&
+		 ( lba < ( cache->dirty_lba + cache->dirty_count ) ) &&
+		 ( ( lba + count ) > cache->dirty_lba ) );
+}
+
+/**
+ * Flush buffered writes to SAN device
+ *
+ * @v sandev		SAN device
+ * @ret rc		Return status code
+ *
+ * Buffered writes are retained on failure, so that a subsequent
+ * flush may retry them.  Note that read-ahead into the block cache
+ * may have fetched stale copies of buffered blocks.
+ */
+int sandev_flush ( struct san_device *sandev ) {
+	struct san_cache *cache = &sandev->cache;
+	int rc;
+
+	/* Do nothing unless there are buffered writes */
+	if ( ! cache->dirty_count )
+		return 0;
+
+	/* Write out buffered writes */
+	DBGC2 ( sandev, "SAN %#02x flushing LBA %#08llx+%#x\n",
+		sandev->drive, cache->dirty_lba, cache->dirty_count );
+	if ( ( rc = sandev_rw_uncached ( sandev, cache->dirty_lba,
+					 cache->dirty_count, cache->dirty,
+					 block_write ) ) != 0 ) {
+		DBGC ( sandev, "SAN %#02x could not flush LBA %#08llx+%#x: "
+		       "%s\n", sandev->drive, cache->dirty_lba,
+		       cache->dirty_count, strerror ( rc ) );
+		return rc;
+	}
+
+	/* Discard any stale copies read ahead into the block cache */
+	if ( cache->lines ) {
+		sandev_cache_discard ( sandev, cache->dirty_lba,
+				       cache->dirty_count );
+	}
+	cache->dirty_count = 0;
+
+	return 0;
+}
+
+/**
+ * Write to SAN device via write-back buffer
+ *
+ * @v sandev		SAN device
+ * @v lba		Starting underlying logical block address
+ * @v count		Number of underlying logical blocks
+ * @v buffer		Data buffer
+ * @ret rc		Return status code
+ *
+ * A write that overlaps or immediately follows the buffered writes
+ * is merged into the buffer, so that a sequence of small sequential
+ * writes reaches the device as a single large write.
+ */
+static int sandev_writeback ( struct san_device *sandev, uint64_t lba,
+			      unsigned int count, userptr_t buffer ) {
+	struct san_cache *cache = &sandev->cache;
+	size_t blksize = sandev->capacity.blksize;
+	uint64_t end = ( lba + count );
+	int rc;
+
+	/* Flush buffered writes unless this write can be merged */
+	if ( cache->dirty_count &&
+	     ( ( lba < cache->dirty_lba ) ||
+	       ( lba > ( cache->dirty_lba + cache->dirty_count ) ) ||
+	       ( ( end - cache->dirty_lba ) > cache->dirty_max ) ) ) {
+		if ( ( rc = sandev_flush ( sandev ) ) != 0 )
+			return rc;
+	}
+
+	/* Write directly if too large to buffer */
+	if ( count > cache->dirty_max )
+		return sandev_rw_uncached ( sandev, lba, count, buffer,
+					    block_write );
+
+	/* Merge into buffer */
+	if ( ! cache->dirty_count )
+		cache->dirty_lba = lba;
+	memcpy_user ( cache->dirty, ( ( lba - cache->dirty_lba ) * blksize ),
+		      buffer, 0, ( count * blksize ) );
+	if ( ( end - cache->dirty_lba ) > cache->dirty_count )
+		cache->dirty_count = ( end - cache->dirty_lba );
+
 	return 0;
 }
 
@@ -413,38 +1440,96 @@ int sandev_rw ( struct san_device *sandev, uint64_t lba,
 				     struct interface *data,
 				     uint64_t lba, unsigned int count,
 				     userptr_t buffer, size_t len ) ) {
-	union san_command_params params;
-	unsigned int remaining;
-	size_t frag_len;
 	int rc;
 
-	/* Initialise command parameters */
-	params.rw.block_rw = block_rw;
-	params.rw.buffer = buffer;
-	params.rw.lba = ( lba << sandev->blksize_shift );
-	params.rw.count = sandev->capacity.max_count;
-	remaining = ( count << sandev->blksize_shift );
-
-	/* Read/write fragments */
-	while ( remaining ) {
+	/* Convert to underlying blocks */
+	lba <<= sandev->blksize_shift;
+	count <<= sandev->blksize_shift;
 
-		/* Determine fragment length */
-		if ( params.rw.count > remaining )
-			params.rw.count = remaining;
+	/* Flush buffered writes before reading any of the same blocks */
+	if ( ( block_rw == block_read ) &&
+	     sandev_writeback_overlaps ( sandev, lba, count ) &&
+	     ( ( rc = sandev_flush ( sandev ) ) != 0 ) )
+		return rc;
 
-		/* Execute command */
-		if ( ( rc = sandev_command ( sandev, sandev_command_rw,
-					     &params ) ) != 0 )
-			return rc;
+	/* Use write-back buffer for writes, if available */
+	if ( ( block_rw == block_write ) && sandev->cache.dirty ) {
+		if ( sandev->cache.lines )
+			sandev_cache_discard ( sandev, lba, count );
+		return sandev_writeback ( sandev, lba, count, buffer );
+	}
 
-		/* Move to next fragment */
-		frag_len = ( sandev->capacity.blksize * params.rw.count );
-		params.rw.buffer = userptr_add ( params.rw.buffer, frag_len );
-		params.rw.lba += params.rw.count;
-		remaining -= params.rw.count;
+	/* Bypass cache if not in use */
+	if ( ! sandev->cache.lines ) {
+		return sandev_rw_uncached ( sandev, lba, count, buffer,
+					    block_rw );
 	}
 
-	return 0;
+	/* Use cache for reads */
+	if ( block_rw == block_read )
+		return sandev_cache_read ( sandev, lba, count, buffer );
+
+	/* Discard any cached copy of written data */
+	sandev_cache_discard ( sandev, lba, count );
+
+	return sandev_rw_uncached ( sandev, lba, count, buffer, block_rw );
+}
+
+/**
+ * Prefetch El Torito boot catalog and boot images, if present
+ *
+ * @v sandev		SAN device
+ * @v scratch		Scratch area for single ISO9660 block
+ *
+ * The BIOS or UEFI boot process will almost immediately read the El
+ * Torito boot catalog and the boot image(s) that it describes.
+ * Prefetching these into the block cache allows each to be fetched
+ * with a single command, rather than via many small reads.
+ */
+static void sandev_prefetch_eltorito ( struct san_device *sandev,
+				       void *scratch ) {
+	static const struct eltorito_descriptor_fixed boot_check = {
+		.type = ISO9660_TYPE_BOOT,
+		.id = ISO9660_ID,
+		.version = 1,
+		.system_id = "EL TORITO SPECIFICATION",
+	};
+	struct eltorito_descriptor *boot = scratch;
+	struct eltorito_boot_entry *entry = scratch;
+	unsigned int shift = sandev->blksize_shift;
+	unsigned int count;
+	unsigned int catalog;
+	unsigned int i;
+	int rc;
+
+	/* Read boot record volume descriptor (usually already cached) */
+	if ( ( rc = sandev_rw ( sandev, ELTORITO_LBA, 1,
+				virt_to_user ( boot ), block_read ) ) != 0 )
+		return;
+	if ( memcmp ( &boot->fixed, &boot_check, sizeof ( boot_check ) ) != 0 )
+		return;
+	catalog = le32_to_cpu ( boot->sector );
+
+	/* Read boot catalog */
+	if ( ( rc = sandev_rw ( sandev, catalog, 1, virt_to_user ( scratch ),
+				block_read ) ) != 0 )
+		return;
+
+	/* Prefetch each bootable entry's image.  The first entry is
+	 * the validation entry; unused entries will be zero.
+	 */
+	for ( i = 1 ; i < ( ISO9660_BLKSIZE / sizeof ( *entry ) ) ; i++ ) {
+		if ( entry[i].indicator != ELTORITO_BOOTABLE )
+			continue;
+		count = ( ( le16_to_cpu ( entry[i].length ) +
+			    ( ISO9660_BLKSIZE / 512 ) - 1 ) /
+			  ( ISO9660_BLKSIZE / 512 ) );
+		if ( ! count )
+			count = 1;
+		sandev_prefetch ( sandev,
+				  ( ( ( uint64_t ) le32_to_cpu ( entry[i].start ) )
+				    << shift ), ( count << shift ) );
+	}
 }
 
 /**
@@ -495,6 +1580,10 @@ static int sandev_parse_iso9660 ( struct san_device *sandev ) {
 		goto err_alloc;
 	}
 
+	/* Prefetch volume descriptor set */
+	sandev_prefetch ( sandev, lba,
+			  ( SAN_ISO9660_PREFETCH_BLOCKS << blksize_shift ) );
+
 	/* Read primary volume descriptor */
 	if ( ( rc = sandev_rw ( sandev, lba, count, virt_to_user ( primary ),
 				block_read ) ) != 0 ) {
@@ -510,6 +1599,7 @@ static int sandev_parse_iso9660 ( struct san_device *sandev ) {
 		       "treating as CD-ROM\n", sandev->drive );
 		sandev->blksize_shift = blksize_shift;
 		sandev->is_cdrom = 1;
+		sandev_prefetch_eltorito ( sandev, primary );
 	}
 
  err_rw:
@@ -522,22 +1612,44 @@ static int sandev_parse_iso9660 ( struct san_device *sandev ) {
 /**
  * Allocate SAN device
  *
+ * @v uris		List of URIs
+ * @v count		Number of URIs
+ * @v priv_size		Size of private data
  * @ret sandev		SAN device, or NULL
  */
-struct san_device * alloc_sandev ( struct uri *uri, size_t priv_size ) {
+struct san_device * alloc_sandev ( struct uri **uris, unsigned int count,
+				   size_t priv_size ) {
 	struct san_device *sandev;
+	struct san_command *cmd;
+	struct san_path *path;
+	size_t size;
+	unsigned int i;
 
 	/* Allocate and initialise structure */
-	sandev = zalloc ( sizeof ( *sandev ) + priv_size );
+	size = ( sizeof ( *sandev ) + ( count * sizeof ( sandev->path[0] ) ) );
+	sandev = zalloc ( size + priv_size );
 	if ( ! sandev )
 		return NULL;
 	ref_init ( &sandev->refcnt, sandev_free );
-	sandev->uri = uri_get ( uri );
-	intf_init ( &sandev->block, &sandev_block_desc, &sandev->refcnt );
 	sandev->block_rc = -EINPROGRESS;
-	intf_init ( &sandev->command, &sandev_command_desc, &sandev->refcnt );
-	timer_init ( &sandev->timer, sandev_command_expired, &sandev->refcnt );
-	sandev->priv = ( ( ( void * ) sandev ) + sizeof ( *sandev ) );
+	sandev->paths = count;
+	for ( i = 0 ; i < count ; i++ ) {
+		path = &sandev->path[i];
+		path->sandev = sandev;
+		path->index = i;
+		path->uri = uri_get ( uris[i] );
+		intf_init ( &path->block, &sandev_block_desc, &sandev->refcnt );
+		path->path_rc = -EINPROGRESS;
+	}
+	for ( i = 0 ; i < SAN_COMMAND_MAX ; i++ ) {
+		cmd = &sandev->commands[i];
+		cmd->sandev = sandev;
+		intf_init ( &cmd->command, &sandev_command_desc,
+			    &sandev->refcnt );
+		timer_init ( &cmd->timer, sandev_command_expired,
+			     &sandev->refcnt );
+	}
+	sandev->priv = ( ( ( void * ) sandev ) + size );
 
 	return sandev;
 }
@@ -562,15 +1674,23 @@ int register_sandev ( struct san_device *sandev ) {
 				     NULL ) ) != 0 )
 		return rc;
 
+	/* Allocate block cache */
+	sandev_cache_init ( sandev );
+	sandev_writeback_init ( sandev );
+
 	/* Configure as a CD-ROM, if applicable */
 	if ( ( rc = sandev_parse_iso9660 ( sandev ) ) != 0 )
-		return rc;
+		goto err_iso9660;
 
 	/* Add to list of SAN devices */
 	list_add_tail ( &sandev->list, &san_devices );
 	DBGC ( sandev, "SAN %#02x registered\n", sandev->drive );
 
 	return 0;
+
+ err_iso9660:
+	sandev_cache_free ( sandev );
+	return rc;
 }
 
 /**
@@ -579,16 +1699,27 @@ int register_sandev ( struct san_device *sandev ) {
  * @v sandev		SAN device
  */
 void unregister_sandev ( struct san_device *sandev ) {
+	struct san_command *cmd;
+	unsigned int i;
 
-	/* Sanity check */
-	assert ( ! timer_running ( &sandev->timer ) );
+	/* Write out any buffered writes (ignoring errors) */
+	sandev_flush ( sandev );
 
 	/* Shut down interfaces */
-	intfs_shutdown ( 0, &sandev->block, &sandev->command, NULL );
+	for ( i = 0 ; i < sandev->paths ; i++ )
+		intf_shutdown ( &sandev->path[i].block, 0 );
+	for ( i = 0 ; i < SAN_COMMAND_MAX ; i++ ) {
+		cmd = &sandev->commands[i];
+		assert ( ! timer_running ( &cmd->timer ) );
+		intf_shutdown ( &cmd->command, 0 );
+	}
 
 	/* Remove from list of SAN devices */
 	list_del ( &sandev->list );
 	DBGC ( sandev, "SAN %#02x unregistered\n", sandev->drive );
+
+	/* Free block cache */
+	sandev_cache_free ( sandev );
 }
 
 /** The "san-drive" setting */
@@ -32,6 +32,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stddef.h>
 #include <string.h>
 #include <ipxe/init.h>
+#include <ipxe/process.h>
 #include <ipxe/uart.h>
 #include <ipxe/console.h>
 #include <ipxe/serial.h>
@@ -68,6 +69,57 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Serial console UART */
 struct uart serial_console;
 
+/** Serial console transmit buffer
+ *
+ * Output is queued here and fed to the UART as the transmitter
+ * becomes ready, so that printing does not stall the caller for the
+ * duration of each character at the serial baud rate.  Debug output
+ * is never left queued, so that it cannot be lost if we subsequently
+ * hang.
+ */
+static uint8_t serial_tx[SERIAL_TX_LEN];
+
+/** Serial console transmit buffer producer counter */
+static unsigned int serial_tx_prod;
+
+/** Serial console transmit buffer consumer counter */
+static unsigned int serial_tx_cons;
+
+/**
+ * Transmit queued characters without waiting
+ *
+ */
+static void serial_transmit ( void ) {
+	unsigned int fill;
+
+	/* Fill the transmit FIFO whenever it becomes empty */
+	while ( ( serial_tx_cons != serial_tx_prod ) &&
+		uart_transmit_ready ( &serial_console ) ) {
+		fill = ( serial_tx_prod - serial_tx_cons );
+		if ( fill > serial_console.fifo )
+			fill = serial_console.fifo;
+		if ( ! fill )
+			fill = 1;
+		while ( fill-- ) {
+			uart_write ( &serial_console, UART_THR,
+				     serial_tx[ serial_tx_cons++ %
+						SERIAL_TX_LEN ] );
+		}
+	}
+}
+
+/**
+ * Transmit all queued characters
+ *
+ */
+static void serial_drain ( void ) {
+
+	while ( serial_tx_cons != serial_tx_prod ) {
+		uart_transmit ( &serial_console,
+				serial_tx[ serial_tx_cons++ % SERIAL_TX_LEN ] );
+	}
+}
+
 /**
  * Print a character to serial console
  *
@@ -79,10 +131,46 @@ static void serial_putchar ( int character ) {
 	if ( ! serial_console.base )
 		return;
 
-	/* Transmit character */
-	uart_transmit ( &serial_console, character );
+	/* Transmit whatever the UART can accept immediately */
+	serial_transmit();
+
+	/* If the buffer is full, wait for the oldest character */
+	if ( ( serial_tx_prod - serial_tx_cons ) >= SERIAL_TX_LEN ) {
+		uart_transmit ( &serial_console,
+				serial_tx[ serial_tx_cons++ % SERIAL_TX_LEN ] );
+	}
+
+	/* Queue character */
+	serial_tx[ serial_tx_prod++ % SERIAL_TX_LEN ] = character;
+
+	/* Transmit debug output immediately, otherwise transmit
+	 * whatever the UART can accept.
+	 */
+	if ( console_usage & CONSOLE_USAGE_DEBUG ) {
+		serial_drain();
+	} else {
+		serial_transmit();
+	}
 }
 
+/**
+ * Transmit queued serial console output
+ *
+ * @v process		Process
+ */
+static void serial_step ( struct process *process __unused ) {
+
+	/* Do nothing if we have no UART */
+	if ( ! serial_console.base )
+		return;
+
+	/* Transmit whatever the UART can accept */
+	serial_transmit();
+}
+
+/** Serial console transmit process */
+PERMANENT_PROCESS ( serial_process, serial_step );
+
 /**
  * Get character from serial console
  *
@@ -125,11 +213,34 @@ static int serial_iskey ( void ) {
 	return uart_data_ready ( &serial_console );
 }
 
+/**
+ * Configure serial console
+ *
+ * @v config		Console configuration, or NULL to reset
+ * @ret rc		Return status code
+ *
+ * The console is reset before control is handed to an external
+ * program (such as a PXE NBP) which may itself use the UART, so all
+ * queued output is transmitted before returning.
+ */
+static int serial_configure ( struct console_configuration *config __unused ) {
+
+	/* Do nothing if we have no UART */
+	if ( ! serial_console.base )
+		return 0;
+
+	/* Transmit any queued output */
+	serial_drain();
+
+	return 0;
+}
+
 /** Serial console */
 struct console_driver serial_console_driver __console_driver = {
 	.putchar = serial_putchar,
 	.getchar = serial_getchar,
 	.iskey = serial_iskey,
+	.configure = serial_configure,
 	.usage = CONSOLE_SERIAL,
 };
 
@@ -169,6 +280,7 @@ static void serial_shutdown ( int flags __unused ) {
 		return;
 
 	/* Flush any pending output */
+	serial_drain();
 	uart_flush ( &serial_console );
 
 	/* Leave console enabled; it's still usable */
@@ -224,6 +224,195 @@ struct settings_operations generic_settings_operations = {
 	.clear = generic_settings_clear,
 };
 
+/******************************************************************************
+ *
+ * Predefined settings index
+ *
+ ******************************************************************************
+ */
+
+/** Number of predefined settings index hash buckets */
+#define SETTING_INDEX_BUCKETS 64
+
+/** A predefined settings index
+ *
+ * Every lookup of a named setting, and every fetch of a setting from
+ * a settings block to which it does not directly apply, needs to
+ * find the matching predefined setting.  This index avoids a linear
+ * scan of the (large) table of predefined settings for each such
+ * lookup.
+ *
+ * Since setting_cmp() will match on either tag or name, predefined
+ * settings are hashed both by tag and by name.  Each hash chain is
+ * kept in table order, so that merging the two chains finds the same
+ * first match as a linear scan of the table.  Chain links hold a
+ * table index plus one, with zero terminating the chain.
+ *
+ * The table of predefined settings is fixed at build time, so the
+ * index never needs to be invalidated.
+ */
+struct setting_index {
+	/** Heads of name hash chains */
+	uint16_t name[SETTING_INDEX_BUCKETS];
+	/** Heads of tag hash chains */
+	uint16_t tag[SETTING_INDEX_BUCKETS];
+	/** Hash chain links for each predefined setting */
+	struct {
+		/** Next setting in name hash chain */
+		uint16_t name;
+		/** Next setting in tag hash chain */
+		uint16_t tag;
+	} next[0];
+};
+
+/** Predefined settings index (if yet constructed) */
+static struct setting_index *setting_index;
+
+/**
+ * Calculate predefined settings index hash bucket for a setting name
+ *
+ * @v name		Setting name
+ * @ret bucket		Hash bucket
+ */
+static unsigned int setting_name_bucket ( const char *name ) {
+	unsigned int hash = 0;
+
+	while ( *name )
+		hash = ( ( hash * 31 ) + *(name++) );
+	return ( hash % SETTING_INDEX_BUCKETS );
+}
+
+/**
+ * Calculate predefined settings index hash bucket for a setting tag
+ *
+ * @v tag		Setting tag
+ * @ret bucket		Hash bucket
+ */
+static unsigned int setting_tag_bucket ( unsigned long tag ) {
+
+	/* Encapsulated tags place the encapsulating option in the
+	 * upper bytes, so fold these in.
+	 */
+	return ( ( tag ^ ( tag >> 8 ) ^ ( tag >> 16 ) ^ ( tag >> 24 ) ) %
+		 SETTING_INDEX_BUCKETS );
+}
+
+/**
+ * Construct predefined settings index
+ *
+ * @ret index		Predefined settings index, or NULL on failure
+ */
+static struct setting_index * build_setting_index ( void ) {
+	unsigned int count = table_num_entries ( SETTINGS );
+	struct setting_index *index;
+	struct setting *setting;
+	unsigned int bucket;
+	unsigned int i;
+
+	/* Use existing index, if already constructed */
+	if ( setting_index )
+		return setting_index;
+
+	/* Sanity check */
+	if ( count >= 0xffff )
+		return NULL;
+
+	/* Allocate index */
+	index = zalloc ( sizeof ( *index ) +
+			 ( count * sizeof ( index->next[0] ) ) );
+	if ( ! index )
+		return NULL;
+
+	/* Add settings to head of each chain in reverse table order,
+	 * so that each chain ends up in table order.
+	 */
+	for_each_table_entry_reverse ( setting, SETTINGS ) {
+		i = table_index ( SETTINGS, setting );
+		if ( setting->name && setting->name[0] ) {
+			bucket = setting_name_bucket ( setting->name );
+			index->next[i].name = index->name[bucket];
+			index->name[bucket] = ( i + 1 );
+		}
+		if ( setting->tag ) {
+			bucket = setting_tag_bucket ( setting->tag );
+			index->next[i].tag = index->tag[bucket];
+			index->tag[bucket] = ( i + 1 );
+		}
+	}
+
+	DBGC ( &setting_index, "SETTINGS indexed %d predefined settings\n",
+	       count );
+	setting_index = index;
+	return index;
+}
+
+/**
+ * Check if predefined setting matches
+ *
+ * @v predefined	Predefined setting
+ * @v setting		Setting to match
+ * @v settings		Settings block to which setting must apply, or NULL
+ * @ret matches		Predefined setting matches
+ */
+static int predefined_setting_matches ( const struct setting *predefined,
+					const struct setting *setting,
+					struct settings *settings ) {
+
+	return ( ( setting_cmp ( setting, predefined ) == 0 ) &&
+		 ( ( ! settings ) || setting_applies ( settings, predefined ) ) );
+}
+
+/**
+ * Find matching predefined setting
+ *
+ * @v setting		Setting to match
+ * @v settings		Settings block to which setting must apply, or NULL
+ * @ret predefined	First matching predefined setting, or NULL
+ */
+static struct setting *
+find_predefined_setting ( const struct setting *setting,
+			  struct settings *settings ) {
+	struct setting *predefined = table_start ( SETTINGS );
+	struct setting_index *index;
+	struct setting *candidate;
+	unsigned int name = 0;
+	unsigned int tag = 0;
+	unsigned int next;
+
+	/* Fall back to a linear scan if the index is unavailable */
+	index = build_setting_index();
+	if ( ! index ) {
+		for_each_table_entry ( candidate, SETTINGS ) {
+			if ( predefined_setting_matches ( candidate, setting,
+							  settings ) )
+				return candidate;
+		}
+		return NULL;
+	}
+
+	/* Identify relevant hash chains */
+	if ( setting->name && setting->name[0] )
+		name = index->name[ setting_name_bucket ( setting->name ) ];
+	if ( setting->tag )
+		tag = index->tag[ setting_tag_bucket ( setting->tag ) ];
+
+	/* Merge chains in table order */
+	while ( name || tag ) {
+		next = ( ( name && ( ( ! tag ) || ( name < tag ) ) ) ?
+			 name : tag );
+		if ( name == next )
+			name = index->next[ next - 1 ].name;
+		if ( tag == next )
+			tag = index->next[ next - 1 ].tag;
+		candidate = &predefined[ next - 1 ];
+		if ( predefined_setting_matches ( candidate, setting,
+						  settings ) )
+			return candidate;
+	}
+
+	return NULL;
+}
+
 /******************************************************************************
  *
  * Registered settings blocks
@@ -585,20 +774,13 @@ int setting_applies ( struct settings *settings,
  */
 static const struct setting *
 applicable_setting ( struct settings *settings, const struct setting *setting ){
-	const struct setting *applicable;
 
 	/* If setting is already applicable, use it */
 	if ( setting_applies ( settings, setting ) )
 		return setting;
 
 	/* Otherwise, look for a matching predefined setting which does apply */
-	for_each_table_entry ( applicable, SETTINGS ) {
-		if ( ( setting_cmp ( setting, applicable ) == 0 ) &&
-		     ( setting_applies ( settings, applicable ) ) )
-			return applicable;
-	}
-
-	return NULL;
+	return find_predefined_setting ( setting, settings );
 }
 
 /**
@@ -1463,13 +1645,11 @@ int storen_setting ( struct settings *settings, const struct setting *setting,
  * @ret setting		Setting, or NULL
  */
 struct setting * find_setting ( const char *name ) {
-	struct setting *setting;
+	struct setting setting = {
+		.name = name,
+	};
 
-	for_each_table_entry ( setting, SETTINGS ) {
-		if ( strcmp ( name, setting->name ) == 0 )
-			return setting;
-	}
-	return NULL;
+	return find_predefined_setting ( &setting, NULL );
 }
 
 /**
@@ -1563,12 +1743,9 @@ int parse_setting_name ( char *name, get_child_settings_t get_child,
 	setting->tag = parse_setting_tag ( setting_name );
 	setting->scope = (*settings)->default_scope;
 	setting->name = setting_name;
-	for_each_table_entry ( predefined, SETTINGS ) {
+	if ( ( predefined = find_predefined_setting ( setting, NULL ) ) ) {
 		/* Matches a predefined setting; use that setting */
-		if ( setting_cmp ( predefined, setting ) == 0 ) {
-			memcpy ( setting, predefined, sizeof ( *setting ) );
-			break;
-		}
+		memcpy ( setting, predefined, sizeof ( *setting ) );
 	}
 
 	/* Identify setting type, if specified */
@@ -46,6 +46,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Current system clock offset */
 signed long time_offset;
 
+/** Number of time synchronisations in progress */
+unsigned int time_sync_pending;
+
 /** Days of week (for debugging) */
 static const char *weekdays[] = {
 	"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"
@@ -0,0 +1,191 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <ipxe/timer.h>
+#include <ipxe/settings.h>
+#include <ipxe/timeline.h>
+
+/** @file
+ *
+ * Boot timeline
+ *
+ * The boot timeline records timestamped phase transitions (DHCP, DNS,
+ * TCP and TLS handshakes, HTTP requests, etc) in a small ring buffer,
+ * allowing the time spent in each phase of a slow boot to be
+ * determined after the event.  Timestamps are taken from currticks(),
+ * which will use the TSC where available.
+ *
+ * The timeline is exposed as the read-only "timeline" setting, so
+ * that it may be sent to a syslog server or uploaded via an HTTP POST
+ * request from a script, and may be printed using the "timeline"
+ * command.
+ */
+
+/** Recorded timeline events */
+static struct timeline_event timeline_events[TIMELINE_MAX_EVENTS];
+
+/** Number of timeline events ever recorded */
+static unsigned int timeline_prod;
+
+/** Time of first recorded event (in ticks) */
+static unsigned long timeline_start;
+
+/**
+ * Record timeline event
+ *
+ * @v phase		Phase (e.g. "dhcp")
+ * @v event		Event within phase (e.g. "done")
+ * @v detail		Detail, or NULL
+ * @v rc		Status code
+ *
+ * The phase and event names must be static strings.  The detail (if
+ * any) will be copied, and may be truncated.
+ */
+void timeline_record ( const char *phase, const char *event,
+		       const char *detail, int rc ) {
+	struct timeline_event *entry;
+
+	/* Identify next entry, overwriting the oldest if necessary */
+	entry = &timeline_events[ timeline_prod % TIMELINE_MAX_EVENTS ];
+	entry->ticks = currticks();
+
+	/* Record start of timeline */
+	if ( ! timeline_prod )
+		timeline_start = entry->ticks;
+	timeline_prod++;
+
+	/* Populate event */
+	entry->phase = phase;
+	entry->event = event;
+	entry->rc = rc;
+	snprintf ( entry->detail, sizeof ( entry->detail ), "%s",
+		   ( detail ? detail : "" ) );
+	DBGC ( &timeline_prod, "TIMELINE %s %s %s: %s\n",
+	       phase, event, entry->detail, strerror ( rc ) );
+}
+
+/**
+ * Get number of available timeline events
+ *
+ * @ret count		Number of available timeline events
+ */
+unsigned int timeline_count ( void ) {
+
+	return ( ( timeline_prod < TIMELINE_MAX_EVENTS ) ?
+		 timeline_prod : TIMELINE_MAX_EVENTS );
+}
+
+/**
+ * Get timeline event
+ *
+ * @v index		Event index (zero being the oldest available event)
+ * @ret entry		Timeline event, or NULL if not available
+ */
+const struct timeline_event * timeline_get ( unsigned int index ) {
+
+	/* Identify event */
+	if ( index >= timeline_count() )
+		return NULL;
+	index += ( timeline_prod - timeline_count() );
+	return &timeline_events[ index % TIMELINE_MAX_EVENTS ];
+}
+
+/**
+ * Format timeline event
+ *
+ * @v index		Event index (zero being the oldest available event)
+ * @v buf		Buffer to fill in
+ * @v len		Length of buffer
+ * @ret len		Length of formatted event, or negative error
+ *
+ * Events are formatted as a single line of space-separated
+ * "key=value" pairs, with the time expressed in milliseconds since
+ * the first recorded event.
+ */
+int timeline_format ( unsigned int index, char *buf, size_t len ) {
+	const struct timeline_event *entry;
+	unsigned long elapsed;
+	unsigned long ms;
+
+	/* Identify event */
+	entry = timeline_get ( index );
+	if ( ! entry )
+		return -ENOENT;
+
+	/* Format event */
+	elapsed = ( entry->ticks - timeline_start );
+	ms = ( ( elapsed * 1000ULL ) / TICKS_PER_SEC );
+	return snprintf ( buf, len, "t=%ld phase=%s event=%s detail=%s "
+			  "rc=%08x", ms,
+			  entry->phase, entry->event,
+			  ( entry->detail[0] ? entry->detail : "-" ),
+			  -entry->rc );
+}
+
+/**
+ * Fetch timeline setting
+ *
+ * @v data		Buffer to fill with setting data
+ * @v len		Length of buffer
+ * @ret len		Length of setting data, or negative error
+ */
+static int timeline_fetch ( void *data, size_t len ) {
+	unsigned int count = timeline_count();
+	unsigned int i;
+	size_t used = 0;
+	int frag_len;
+
+	/* Concatenate all events, separated by newlines */
+	for ( i = 0 ; i < count ; i++ ) {
+		if ( i ) {
+			if ( used < len )
+				( ( char * ) data )[used] = '\n';
+			used++;
+		}
+		frag_len = timeline_format ( i, ( data + used ),
+					     ( ( used < len ) ?
+					       ( len - used ) : 0 ) );
+		if ( frag_len < 0 )
+			return frag_len;
+		used += frag_len;
+	}
+
+	return used;
+}
+
+/** Timeline setting */
+const struct setting timeline_setting __setting ( SETTING_MISC, timeline ) = {
+	.name = "timeline",
+	.description = "Boot timeline",
+	.type = &setting_type_string,
+	.scope = &builtin_scope,
+};
+
+/** Timeline built-in setting */
+struct builtin_setting timeline_builtin_setting __builtin_setting = {
+	.setting = &timeline_setting,
+	.fetch = timeline_fetch,
+};
@@ -27,7 +27,6 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/process.h>
 #include <ipxe/console.h>
 #include <ipxe/keys.h>
-#include <ipxe/nap.h>
 #include <ipxe/init.h>
 #include <ipxe/timer.h>
 
@@ -104,7 +103,6 @@ unsigned int sleep ( unsigned int secs ) {
 			step();
 			if ( iskey() && ( getchar() == CTRL_C ) )
 				return secs;
-			cpu_nap();
 		}
 		start = now;
 	}
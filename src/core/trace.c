@@ -0,0 +1,177 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <bits/profile.h>
+#include <ipxe/settings.h>
+#include <ipxe/trace.h>
+
+/** @file
+ *
+ * Tracepoints
+ *
+ * Tracepoints record a timestamp, a tracepoint name, an object
+ * identifier and a single value in a ring buffer.  Unlike debug
+ * messages, recording a tracepoint does not produce any console
+ * output, and so does not substantially perturb the timing of the
+ * code being traced.
+ *
+ * Tracepoints are compiled in only for objects built with the trace
+ * debug level (e.g. "make DEBUG=tcp:16,intel:16").  The ring buffer
+ * may be printed after the event using the "trace" command, or
+ * retrieved via the read-only "trace" setting (e.g. for uploading
+ * via an HTTP POST request).
+ */
+
+/** Recorded trace records */
+static struct trace_record trace_records[TRACE_MAX_RECORDS];
+
+/** Number of trace records ever recorded */
+static unsigned int trace_prod;
+
+/** Timestamp of first trace record */
+static unsigned long trace_start;
+
+/**
+ * Record tracepoint
+ *
+ * @v name		Tracepoint name (must be a static string)
+ * @v id		Object identifier
+ * @v value		Value
+ */
+void trace_record ( const char *name, const void *id, unsigned long value ) {
+	struct trace_record *record;
+
+	/* Identify next record, overwriting the oldest if necessary */
+	record = &trace_records[ trace_prod % TRACE_MAX_RECORDS ];
+	record->timestamp = profile_timestamp();
+
+	/* Record start of trace */
+	if ( ! trace_prod )
+		trace_start = record->timestamp;
+	trace_prod++;
+
+	/* Populate record */
+	record->name = name;
+	record->id = id;
+	record->value = value;
+}
+
+/**
+ * Get number of available trace records
+ *
+ * @ret count		Number of available trace records
+ */
+unsigned int trace_count ( void ) {
+
+	return ( ( trace_prod < TRACE_MAX_RECORDS ) ?
+		 trace_prod : TRACE_MAX_RECORDS );
+}
+
+/**
+ * Get trace record
+ *
+ * @v index		Record index (zero being the oldest available record)
+ * @ret record		Trace record, or NULL if not available
+ */
+const struct trace_record * trace_get ( unsigned int index ) {
+
+	/* Identify record */
+	if ( index >= trace_count() )
+		return NULL;
+	index += ( trace_prod - trace_count() );
+	return &trace_records[ index % TRACE_MAX_RECORDS ];
+}
+
+/**
+ * Format trace record
+ *
+ * @v index		Record index (zero being the oldest available record)
+ * @v buf		Buffer to fill in
+ * @v len		Length of buffer
+ * @ret len		Length of formatted record, or negative error
+ *
+ * Records are formatted as a single line of space-separated
+ * "key=value" pairs, with the time expressed in timestamp units
+ * (e.g. CPU cycles) since the first recorded tracepoint.
+ */
+int trace_format ( unsigned int index, char *buf, size_t len ) {
+	const struct trace_record *record;
+
+	/* Identify record */
+	record = trace_get ( index );
+	if ( ! record )
+		return -ENOENT;
+
+	/* Format record */
+	return snprintf ( buf, len, "t=%ld name=%s id=%p value=%#lx",
+			  ( record->timestamp - trace_start ), record->name,
+			  record->id, record->value );
+}
+
+/**
+ * Fetch trace setting
+ *
+ * @v data		Buffer to fill with setting data
+ * @v len		Length of buffer
+ * @ret len		Length of setting data, or negative error
+ */
+static int trace_fetch ( void *data, size_t len ) {
+	unsigned int count = trace_count();
+	unsigned int i;
+	size_t used = 0;
+	int frag_len;
+
+	/* Concatenate all records, separated by newlines */
+	for ( i = 0 ; i < count ; i++ ) {
+		if ( i ) {
+			if ( used < len )
+				( ( char * ) data )[used] = '\n';
+			used++;
+		}
+		frag_len = trace_format ( i, ( data + used ),
+					  ( ( used < len ) ?
+					    ( len - used ) : 0 ) );
+		if ( frag_len < 0 )
+			return frag_len;
+		used += frag_len;
+	}
+
+	return used;
+}
+
+/** Trace setting */
+const struct setting trace_setting __setting ( SETTING_MISC, trace ) = {
+	.name = "trace",
+	.description = "Tracepoint records",
+	.type = &setting_type_string,
+	.scope = &builtin_scope,
+};
+
+/** Trace built-in setting */
+struct builtin_setting trace_builtin_setting __builtin_setting = {
+	.setting = &trace_setting,
+	.fetch = trace_fetch,
+};
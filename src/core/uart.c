@@ -36,6 +36,15 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Timeout for transmit holding register to become empty */
 #define UART_THRE_TIMEOUT_MS 100
 
+/** Polling interval for transmit holding register to become empty
+ *
+ * A single character takes less than 100us to transmit at typical
+ * baud rates.  The interval is long enough that the time taken to
+ * read the line status register does not significantly extend the
+ * overall timeout.
+ */
+#define UART_THRE_POLL_US 10
+
 /** Timeout for transmitter to become empty */
 #define UART_TEMT_TIMEOUT_MS 1000
 
@@ -50,11 +59,12 @@ void uart_transmit ( struct uart *uart, uint8_t data ) {
 	uint8_t lsr;
 
 	/* Wait for transmitter holding register to become empty */
-	for ( i = 0 ; i < UART_THRE_TIMEOUT_MS ; i++ ) {
+	for ( i = 0 ; i < ( ( UART_THRE_TIMEOUT_MS * 1000 ) /
+			    UART_THRE_POLL_US ) ; i++ ) {
 		lsr = uart_read ( uart, UART_LSR );
 		if ( lsr & UART_LSR_THRE )
 			break;
-		mdelay ( 1 );
+		udelay ( UART_THRE_POLL_US );
 	}
 
 	/* Transmit data (even if we timed out) */
@@ -142,6 +152,8 @@ int uart_init ( struct uart *uart, unsigned int baud, uint8_t lcr ) {
 
 	/* Enable FIFOs */
 	uart_write ( uart, UART_FCR, UART_FCR_FE );
+	uart->fifo = ( ( ( uart_read ( uart, UART_IIR ) & UART_IIR_FIFO ) ==
+			 UART_IIR_FIFO ) ? UART_FIFO_LEN : 1 );
 
 	/* Assert DTR and RTS */
 	uart_write ( uart, UART_MCR, ( UART_MCR_DTR | UART_MCR_RTS ) );
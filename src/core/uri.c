@@ -32,11 +32,13 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <libgen.h>
 #include <ctype.h>
 #include <ipxe/vsprintf.h>
 #include <ipxe/params.h>
 #include <ipxe/tcpip.h>
+#include <ipxe/settings.h>
 #include <ipxe/uri.h>
 
 /**
@@ -791,3 +793,70 @@ struct uri * pxe_uri ( struct sockaddr *sa_server, const char *filename ) {
 	/* Otherwise, construct a TFTP URI directly */
 	return tftp_uri ( sa_server, filename );
 }
+
+/** PXE download mirror setting */
+const struct setting pxe_mirror_setting __setting ( SETTING_MISC, pxe-mirror ) = {
+	.name = "pxe-mirror",
+	.description = "PXE download mirror",
+	.type = &setting_type_string,
+};
+
+/**
+ * Construct HTTP mirror URI for a TFTP URI
+ *
+ * @v tftp		TFTP URI
+ * @ret uri		Mirror URI, or NULL if not applicable
+ *
+ * If the "pxe-mirror" setting is present, then TFTP downloads
+ * requested via the PXE APIs may be fetched from the same path
+ * relative to the mirror URI instead.  This allows large files
+ * (such as boot.wim) to be fetched via HTTP by legacy bootstraps
+ * that know only how to use TFTP.
+ */
+struct uri * pxe_mirror_uri ( struct uri *tftp ) {
+	struct uri relative;
+	struct uri *base;
+	struct uri *uri = NULL;
+	char *mirror;
+	char *path;
+	char *tmp;
+
+	/* Do nothing unless this is a TFTP URI with a path */
+	if ( ! ( tftp->scheme && ( strcasecmp ( tftp->scheme, "tftp" ) == 0 ) &&
+		 tftp->path ) )
+		goto err_scheme;
+
+	/* Fetch mirror URI, if any */
+	fetch_string_setting_copy ( NULL, &pxe_mirror_setting, &mirror );
+	if ( ! mirror )
+		goto err_fetch;
+	base = parse_uri ( mirror );
+	if ( ! base )
+		goto err_parse;
+
+	/* Construct path relative to mirror URI.  Bootstraps written
+	 * for Windows servers may use backslashes as path separators.
+	 */
+	path = strdup ( tftp->path );
+	if ( ! path )
+		goto err_path;
+	for ( tmp = path ; *tmp ; tmp++ ) {
+		if ( *tmp == '\\' )
+			*tmp = '/';
+	}
+	for ( tmp = path ; *tmp == '/' ; tmp++ ) {}
+	memset ( &relative, 0, sizeof ( relative ) );
+	relative.path = tmp;
+
+	/* Resolve against mirror URI */
+	uri = resolve_uri ( base, &relative );
+
+	free ( path );
+ err_path:
+	uri_put ( base );
+ err_parse:
+	free ( mirror );
+ err_fetch:
+ err_scheme:
+	return uri;
+}
@@ -365,6 +365,35 @@ int xfer_seek ( struct interface *intf, off_t offset ) {
 	return xfer_deliver ( intf, iobuf, &meta );
 }
 
+/**
+ * Notify recipient of expected data length
+ *
+ * @v intf		Data transfer interface
+ * @v len		Expected total length
+ * @ret rc		Return status code
+ *
+ * This should be called before any data is delivered, as soon as the
+ * total length is known (e.g. from an HTTP Content-Length header or a
+ * TFTP "tsize" option).  It allows a recipient such as a data
+ * transfer buffer to allocate all of the required space in a single
+ * step, rather than repeatedly extending (and copying) its buffer as
+ * data arrives.
+ *
+ * The notification takes the form of a seek to the expected length
+ * followed by a seek back to the start, and so requires no special
+ * handling by recipients that have no interest in the length.
+ */
+int xfer_presize ( struct interface *intf, size_t len ) {
+	int rc;
+
+	/* Seek to expected length */
+	if ( ( rc = xfer_seek ( intf, len ) ) != 0 )
+		return rc;
+
+	/* Seek back to start */
+	return xfer_seek ( intf, 0 );
+}
+
 /**
  * Check that data is delivered strictly in order
  *
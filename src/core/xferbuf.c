@@ -59,6 +59,7 @@ void xferbuf_free ( struct xfer_buffer *xferbuf ) {
 
 	xferbuf->op->realloc ( xferbuf, 0 );
 	xferbuf->len = 0;
+	xferbuf->size = 0;
 	xferbuf->pos = 0;
 }
 
@@ -68,19 +69,38 @@ void xferbuf_free ( struct xfer_buffer *xferbuf ) {
  * @v xferbuf		Data transfer buffer
  * @v len		Required minimum size
  * @ret rc		Return status code
+ *
+ * Reallocating a large buffer will generally copy the existing
+ * contents.  If the final length has not been announced in advance
+ * (e.g. via xfer_presize()), then extending the buffer by only the
+ * length of each received packet would copy the whole content for
+ * every packet.  We therefore extend the allocation in proportion to
+ * its current size, falling back to the exact size if the larger
+ * allocation fails.
  */
 static int xferbuf_ensure_size ( struct xfer_buffer *xferbuf, size_t len ) {
+	size_t size;
 	int rc;
 
 	/* If buffer is already large enough, do nothing */
 	if ( len <= xferbuf->len )
 		return 0;
 
-	/* Extend buffer */
-	if ( ( rc = xferbuf->op->realloc ( xferbuf, len ) ) != 0 ) {
-		DBGC ( xferbuf, "XFERBUF %p could not extend buffer to "
-		       "%zd bytes: %s\n", xferbuf, len, strerror ( rc ) );
-		return rc;
+	/* Extend allocation, if necessary */
+	if ( len > xferbuf->size ) {
+		size = ( len + ( xferbuf->len / XFERBUF_GROW_RATIO ) );
+		if ( ( size < len ) ||
+		     ( xferbuf->op->realloc ( xferbuf, size ) != 0 ) ) {
+			size = len;
+			if ( ( rc = xferbuf->op->realloc ( xferbuf,
+							   size ) ) != 0 ) {
+				DBGC ( xferbuf, "XFERBUF %p could not extend "
+				       "buffer to %zd bytes: %s\n", xferbuf,
+				       len, strerror ( rc ) );
+				return rc;
+			}
+		}
+		xferbuf->size = size;
 	}
 	xferbuf->len = len;
 
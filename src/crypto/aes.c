@@ -38,6 +38,8 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/crypto.h>
 #include <ipxe/ecb.h>
 #include <ipxe/cbc.h>
+#include <ipxe/gcm.h>
+#include <ipxe/accelerator.h>
 #include <ipxe/aes.h>
 
 /** AES strides
@@ -404,6 +406,12 @@ static void aes_encrypt ( void *ctx, const void *src, void *dst, size_t len ) {
 	/* Sanity check */
 	assert ( len == sizeof ( *in ) );
 
+	/* Use accelerated implementation, if available */
+	if ( aes->accel ) {
+		aes->accel->encrypt ( aes, src, dst );
+		return;
+	}
+
 	/* Initialise input state */
 	memcpy ( in, src, sizeof ( *in ) );
 
@@ -440,6 +448,12 @@ static void aes_decrypt ( void *ctx, const void *src, void *dst, size_t len ) {
 	/* Sanity check */
 	assert ( len == sizeof ( *in ) );
 
+	/* Use accelerated implementation, if available */
+	if ( aes->accel ) {
+		aes->accel->decrypt ( aes, src, dst );
+		return;
+	}
+
 	/* Initialise input state */
 	memcpy ( in, src, sizeof ( *in ) );
 
@@ -458,6 +472,60 @@ static void aes_decrypt ( void *ctx, const void *src, void *dst, size_t len ) {
 		    &aes->decrypt.key[ rounds - 1 ] );
 }
 
+/**
+ * Encrypt multiple independent blocks
+ *
+ * @v ctx		Context
+ * @v src		Data to encrypt
+ * @v dst		Buffer for encrypted data
+ * @v len		Length of data
+ */
+static void aes_bulk_encrypt ( void *ctx, const void *src, void *dst,
+			       size_t len ) {
+	struct aes_context *aes = ctx;
+
+	/* Use accelerated implementation, if available */
+	if ( aes->accel && aes->accel->bulk_encrypt ) {
+		aes->accel->bulk_encrypt ( aes, src, dst, len );
+		return;
+	}
+
+	/* Otherwise, encrypt one block at a time */
+	while ( len ) {
+		aes_encrypt ( ctx, src, dst, AES_BLOCKSIZE );
+		src += AES_BLOCKSIZE;
+		dst += AES_BLOCKSIZE;
+		len -= AES_BLOCKSIZE;
+	}
+}
+
+/**
+ * Decrypt multiple independent blocks
+ *
+ * @v ctx		Context
+ * @v src		Data to decrypt
+ * @v dst		Buffer for decrypted data
+ * @v len		Length of data
+ */
+static void aes_bulk_decrypt ( void *ctx, const void *src, void *dst,
+			       size_t len ) {
+	struct aes_context *aes = ctx;
+
+	/* Use accelerated implementation, if available */
+	if ( aes->accel && aes->accel->bulk_decrypt ) {
+		aes->accel->bulk_decrypt ( aes, src, dst, len );
+		return;
+	}
+
+	/* Otherwise, decrypt one block at a time */
+	while ( len ) {
+		aes_decrypt ( ctx, src, dst, AES_BLOCKSIZE );
+		src += AES_BLOCKSIZE;
+		dst += AES_BLOCKSIZE;
+		len -= AES_BLOCKSIZE;
+	}
+}
+
 /**
  * Multiply a polynomial by (x) modulo (x^8 + x^4 + x^3 + x^2 + 1) in GF(2^8)
  *
@@ -669,6 +737,15 @@ aes_key_rcon ( uint32_t column, unsigned int rcon ) {
 		 ( column ^ rcon ) : ( column ^ ( rcon << 24 ) ) );
 }
 
+/**
+ * Find accelerated AES implementation
+ *
+ * @ret accel		Accelerated implementation, or NULL
+ */
+static struct aes_accelerator * aes_accelerator ( void ) {
+	return accelerator_select ( AES_ACCELERATORS );
+}
+
 /**
  * Set key
  *
@@ -775,6 +852,9 @@ static int aes_setkey ( void *ctx, const void *key, size_t keylen ) {
 	DBGC2 ( aes, "AES %p inverted %zd-bit key:\n", aes, ( keylen * 8 ) );
 	DBGC2_HDA ( aes, 0, &aes->decrypt, ( rounds * sizeof ( *dec ) ) );
 
+	/* Select accelerated implementation, if available */
+	aes->accel = aes_accelerator();
+
 	return 0;
 }
 
@@ -797,6 +877,8 @@ struct cipher_algorithm aes_algorithm = {
 	.setiv = aes_setiv,
 	.encrypt = aes_encrypt,
 	.decrypt = aes_decrypt,
+	.bulk_encrypt = aes_bulk_encrypt,
+	.bulk_decrypt = aes_bulk_decrypt,
 };
 
 /* AES in Electronic Codebook mode */
@@ -806,3 +888,11 @@ ECB_CIPHER ( aes_ecb, aes_ecb_algorithm,
 /* AES in Cipher Block Chaining mode */
 CBC_CIPHER ( aes_cbc, aes_cbc_algorithm,
 	     aes_algorithm, struct aes_context, AES_BLOCKSIZE );
+
+/* AES in Galois/Counter mode */
+GCM_CIPHER ( aes_gcm, aes_gcm_algorithm,
+	     aes_algorithm, struct aes_context, AES_BLOCKSIZE );
+
+/* Drag in AES accelerators */
+REQUIRING_SYMBOL ( aes_algorithm );
+REQUIRE_OBJECT ( config_aes );
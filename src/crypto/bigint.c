@@ -90,6 +90,176 @@ void bigint_mod_multiply_raw ( const bigint_element_t *multiplicand0,
 	assert ( bigint_is_geq ( modulus, result ) );
 }
 
+/**
+ * Multiply big integer by a single element and accumulate
+ *
+ * @v multiplicand0	Element 0 of big integer to be multiplied
+ * @v multiplier	Element by which to multiply
+ * @v value0		Element 0 of big integer to be added to
+ * @v size		Number of elements
+ * @ret carry		Carry out of most significant element
+ *
+ * This is a portable implementation for architectures that do not
+ * provide their own.  Each double-width product is assembled from
+ * four half-width products, since C provides no type wider than an
+ * element on all architectures.
+ */
+__weak bigint_element_t
+bigint_multiply_accumulate_raw ( const bigint_element_t *multiplicand0,
+				 bigint_element_t multiplier,
+				 bigint_element_t *value0, unsigned int size ) {
+	const unsigned int half = ( 4 * sizeof ( bigint_element_t ) );
+	const bigint_element_t mask = ( ( ( bigint_element_t ) 1 << half ) - 1 );
+	bigint_element_t multiplier_low = ( multiplier & mask );
+	bigint_element_t multiplier_high = ( multiplier >> half );
+	bigint_element_t multiplicand_low;
+	bigint_element_t multiplicand_high;
+	bigint_element_t low_low;
+	bigint_element_t low_high;
+	bigint_element_t high_low;
+	bigint_element_t middle;
+	bigint_element_t low;
+	bigint_element_t high;
+	bigint_element_t carry = 0;
+	unsigned int i;
+
+	/* Perform a single multiply for each element, adding in the
+	 * existing value element and the carry from the previous
+	 * element.  The carry cannot overflow, since:
+	 *
+	 *     a < 2^{n}, b < 2^{n}, c < 2^{n}, d < 2^{n}
+	 *       => ab + c + d < 2^{2n}
+	 */
+	for ( i = 0 ; i < size ; i++ ) {
+		multiplicand_low = ( multiplicand0[i] & mask );
+		multiplicand_high = ( multiplicand0[i] >> half );
+		low_low = ( multiplicand_low * multiplier_low );
+		low_high = ( multiplicand_low * multiplier_high );
+		high_low = ( multiplicand_high * multiplier_low );
+		middle = ( ( low_low >> half ) + ( low_high & mask ) +
+			   ( high_low & mask ) );
+		low = ( ( low_low & mask ) | ( middle << half ) );
+		high = ( ( multiplicand_high * multiplier_high ) +
+			 ( low_high >> half ) + ( high_low >> half ) +
+			 ( middle >> half ) );
+		low += value0[i];
+		high += ( low < value0[i] );
+		low += carry;
+		high += ( low < carry );
+		value0[i] = low;
+		carry = high;
+	}
+
+	return carry;
+}
+
+/**
+ * Calculate Montgomery inverse of modulus
+ *
+ * @v modulus0		Element 0 of big integer modulus (must be odd)
+ * @ret inverse		Negated inverse of element 0 of modulus
+ *
+ * Calculates -N^{-1} mod 2^{w}, where w is the number of bits in an
+ * element, using Newton's method.  Any odd number is its own inverse
+ * modulo 2^{3}, and each iteration doubles the number of correct
+ * bits.
+ */
+static bigint_element_t
+bigint_montgomery_inverse ( const bigint_element_t *modulus0 ) {
+	bigint_element_t modulus = modulus0[0];
+	bigint_element_t inverse = modulus;
+	unsigned int bits;
+
+	/* Sanity check */
+	assert ( modulus & 1 );
+
+	/* Calculate inverse */
+	for ( bits = 3 ; bits < ( 8 * sizeof ( inverse ) ) ; bits *= 2 )
+		inverse *= ( 2 - ( modulus * inverse ) );
+	assert ( ( bigint_element_t ) ( modulus * inverse ) == 1 );
+
+	return ( -inverse );
+}
+
+/**
+ * Perform Montgomery reduction of big integer
+ *
+ * @v modulus0		Element 0 of big integer modulus (must be odd)
+ * @v value0		Element 0 of big integer to be reduced
+ * @v result0		Element 0 of big integer to hold result
+ * @v size		Number of elements in modulus and result
+ * @v inverse		Negated inverse of element 0 of modulus
+ *
+ * Calculates TR^{-1} mod N, where R=2^{wk} for a k-element modulus
+ * N.  The value T (which is overwritten) has 2k elements and must be
+ * less than NR.
+ */
+static void bigint_montgomery_raw ( const bigint_element_t *modulus0,
+				    bigint_element_t *value0,
+				    bigint_element_t *result0,
+				    unsigned int size,
+				    bigint_element_t inverse ) {
+	const bigint_t ( size ) __attribute__ (( may_alias )) *modulus =
+		( ( const void * ) modulus0 );
+	bigint_t ( size * 2 ) __attribute__ (( may_alias )) *value =
+		( ( void * ) value0 );
+	bigint_t ( size ) __attribute__ (( may_alias )) *result =
+		( ( void * ) result0 );
+	bigint_element_t multiplier;
+	bigint_element_t element;
+	bigint_element_t carry;
+	bigint_element_t overflow = 0;
+	unsigned int i;
+
+	/* Add multiples of the modulus to clear each low element in
+	 * turn.  The carry out of each addition is accumulated into
+	 * the next unreduced element, with any overflow from that
+	 * element being deferred to the following iteration.
+	 */
+	for ( i = 0 ; i < size ; i++ ) {
+		multiplier = ( value->element[i] * inverse );
+		carry = bigint_multiply_accumulate_raw ( modulus->element,
+							 multiplier,
+							 &value->element[i],
+							 size );
+		element = ( value->element[ i + size ] + carry );
+		carry = ( element < carry );
+		element += overflow;
+		carry += ( element < overflow );
+		value->element[ i + size ] = element;
+		overflow = carry;
+	}
+	assert ( bigint_is_zero_raw ( value->element, size ) );
+
+	/* Extract high elements, and perform final subtraction if
+	 * required.  The result is guaranteed to be less than 2N.
+	 */
+	memcpy ( result, &value->element[size], sizeof ( *result ) );
+	if ( overflow || bigint_is_geq ( result, modulus ) )
+		bigint_subtract ( modulus, result );
+
+	/* Sanity check */
+	assert ( ! bigint_is_geq ( result, modulus ) );
+}
+
+/**
+ * Perform Montgomery multiplication of big integers
+ *
+ * @v multiplicand	Big integer to be multiplied
+ * @v multiplier	Big integer to be multiplied
+ * @v modulus		Big integer modulus
+ * @v result		Big integer to hold result
+ * @v product		Big integer to hold temporary double-size product
+ * @v inverse		Negated inverse of element 0 of modulus
+ */
+#define bigint_montgomery_multiply( multiplicand, multiplier, modulus,	\
+				    result, product, inverse ) do {	\
+	unsigned int size = bigint_size (modulus);			\
+	bigint_multiply ( (multiplicand), (multiplier), (product) );	\
+	bigint_montgomery_raw ( (modulus)->element, (product)->element,	\
+				(result)->element, size, (inverse) );	\
+	} while ( 0 )
+
 /**
  * Perform modular exponentiation of big integers
  *
@@ -100,6 +270,12 @@ void bigint_mod_multiply_raw ( const bigint_element_t *multiplicand0,
  * @v size		Number of elements in base, modulus, and result
  * @v exponent_size	Number of elements in exponent
  * @v tmp		Temporary working space
+ *
+ * Odd moduli (including all RSA moduli) are handled using Montgomery
+ * multiplication with a sliding-window exponent, which avoids any
+ * long division within the main loop.  Even moduli fall back to
+ * simple square-and-multiply using conventional modular
+ * multiplication.
  */
 void bigint_mod_exp_raw ( const bigint_element_t *base0,
 			  const bigint_element_t *modulus0,
@@ -117,23 +293,115 @@ void bigint_mod_exp_raw ( const bigint_element_t *base0,
 		( ( void * ) result0 );
 	size_t mod_multiply_len = bigint_mod_multiply_tmp_len ( modulus );
 	struct {
-		bigint_t ( size ) base;
-		bigint_t ( exponent_size ) exponent;
+		bigint_t ( size * 2 ) product;
+		bigint_t ( size ) powers[BIGINT_MOD_EXP_POWERS];
 		uint8_t mod_multiply[mod_multiply_len];
 	} *temp = tmp;
 	static const uint8_t start[1] = { 0x01 };
+	bigint_element_t inverse;
+	unsigned int window;
+	int started;
+	int high;
+	int low;
+	int i;
 
-	memcpy ( &temp->base, base, sizeof ( temp->base ) );
-	memcpy ( &temp->exponent, exponent, sizeof ( temp->exponent ) );
+	/* Sanity check */
+	assert ( sizeof ( *temp ) ==
+		 bigint_mod_exp_tmp_len ( modulus, exponent ) );
+
+	/* Start with a result of one */
 	bigint_init ( result, start, sizeof ( start ) );
+	high = ( bigint_max_set_bit ( exponent ) - 1 );
 
-	while ( ! bigint_is_zero ( &temp->exponent ) ) {
-		if ( bigint_bit_is_set ( &temp->exponent, 0 ) ) {
-			bigint_mod_multiply ( result, &temp->base, modulus,
-					      result, temp->mod_multiply );
+	/* Use simple square-and-multiply for even moduli */
+	if ( ! bigint_bit_is_set ( modulus, 0 ) ) {
+		for ( i = high ; i >= 0 ; i-- ) {
+			bigint_mod_multiply ( result, result, modulus, result,
+					      temp->mod_multiply );
+			if ( bigint_bit_is_set ( exponent, i ) ) {
+				bigint_mod_multiply ( result, base, modulus,
+						      result,
+						      temp->mod_multiply );
+			}
 		}
-		bigint_ror ( &temp->exponent );
-		bigint_mod_multiply ( &temp->base, &temp->base, modulus,
-				      &temp->base, temp->mod_multiply );
+		return;
+	}
+
+	/* Calculate R mod N as (R-N) mod N, and use this to convert
+	 * the base into Montgomery form.
+	 */
+	bigint_init ( &temp->powers[0], start, sizeof ( start ) );
+	memset ( result, 0, sizeof ( *result ) );
+	bigint_subtract ( modulus, result );
+	bigint_mod_multiply ( result, &temp->powers[0], modulus, result,
+			      temp->mod_multiply );
+	bigint_mod_multiply ( base, result, modulus, &temp->powers[0],
+			      temp->mod_multiply );
+
+	/* Precompute odd powers of the base, using the result as
+	 * temporary storage for the square of the base.
+	 */
+	inverse = bigint_montgomery_inverse ( modulus->element );
+	bigint_montgomery_multiply ( &temp->powers[0], &temp->powers[0],
+				     modulus, result, &temp->product,
+				     inverse );
+	for ( i = 1 ; i < BIGINT_MOD_EXP_POWERS ; i++ ) {
+		bigint_montgomery_multiply ( &temp->powers[ i - 1 ], result,
+					     modulus, &temp->powers[i],
+					     &temp->product, inverse );
+	}
+
+	/* Process exponent from the most significant bit downwards */
+	bigint_init ( result, start, sizeof ( start ) );
+	started = 0;
+	for ( i = high ; i >= 0 ; i = ( low - 1 ) ) {
+
+		/* Square once for each unset bit between windows */
+		low = i;
+		if ( ! bigint_bit_is_set ( exponent, i ) ) {
+			bigint_montgomery_multiply ( result, result, modulus,
+						     result, &temp->product,
+						     inverse );
+			continue;
+		}
+
+		/* Find longest window ending in a set bit */
+		low = ( i - BIGINT_MOD_EXP_WINDOW + 1 );
+		if ( low < 0 )
+			low = 0;
+		while ( ! bigint_bit_is_set ( exponent, low ) )
+			low++;
+
+		/* Square once for each bit within the window */
+		for ( window = 0 ; i >= low ; i-- ) {
+			window = ( ( window << 1 ) |
+				   ( bigint_bit_is_set ( exponent, i ) ? 1 : 0 ));
+			if ( started ) {
+				bigint_montgomery_multiply ( result, result,
+							     modulus, result,
+							     &temp->product,
+							     inverse );
+			}
+		}
+
+		/* Multiply by the corresponding odd power */
+		if ( started ) {
+			bigint_montgomery_multiply ( result,
+						     &temp->powers[ window / 2 ],
+						     modulus, result,
+						     &temp->product, inverse );
+		} else {
+			memcpy ( result, &temp->powers[ window / 2 ],
+				 sizeof ( *result ) );
+			started = 1;
+		}
+	}
+
+	/* Convert result out of Montgomery form, if applicable */
+	if ( started ) {
+		bigint_grow ( result, &temp->product );
+		bigint_montgomery_raw ( modulus->element,
+					temp->product.element,
+					result->element, size, inverse );
 	}
 }
@@ -34,6 +34,14 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
+/** Maximum length of data decrypted in a single bulk operation
+ *
+ * Unlike encryption, CBC decryption of each block does not depend
+ * upon the result of decrypting the previous block, and so may be
+ * performed on several blocks in parallel.
+ */
+#define CBC_BULK_LEN 128
+
 /**
  * XOR data blocks
  *
@@ -93,9 +101,44 @@ void cbc_decrypt ( void *ctx, const void *src, void *dst, size_t len,
 		   struct cipher_algorithm *raw_cipher, void *cbc_ctx ) {
 	size_t blocksize = raw_cipher->blocksize;
 	uint8_t next_cbc_ctx[blocksize];
+	uint8_t bulk[CBC_BULK_LEN] __attribute__ (( aligned ( 4 ) ));
+	size_t frag_len;
 
 	assert ( ( len % blocksize ) == 0 );
 
+	/* Decrypt several blocks at a time, if possible */
+	if ( is_bulk_cipher ( raw_cipher ) &&
+	     ( blocksize <= sizeof ( bulk ) ) ) {
+		while ( len ) {
+			frag_len = ( sizeof ( bulk ) -
+				     ( sizeof ( bulk ) % blocksize ) );
+			if ( frag_len > len )
+				frag_len = len;
+
+			/* Decrypt blocks */
+			cipher_bulk_decrypt ( raw_cipher, ctx, src, bulk,
+					      frag_len );
+
+			/* XOR each block with the preceding ciphertext
+			 * block.  The ciphertext is still intact at this
+			 * point, even if decrypting in place.
+			 */
+			memcpy ( next_cbc_ctx, ( src + frag_len - blocksize ),
+				 blocksize );
+			cbc_xor ( cbc_ctx, bulk, blocksize );
+			cbc_xor ( src, ( bulk + blocksize ),
+				  ( frag_len - blocksize ) );
+			memcpy ( cbc_ctx, next_cbc_ctx, blocksize );
+
+			/* Copy out decrypted blocks */
+			memcpy ( dst, bulk, frag_len );
+			dst += frag_len;
+			src += frag_len;
+			len -= frag_len;
+		}
+		return;
+	}
+
 	while ( len ) {
 		memcpy ( next_cbc_ctx, src, blocksize );
 		cipher_decrypt ( raw_cipher, ctx, src, dst, blocksize );
@@ -75,6 +75,93 @@ struct x509_chain certstore = {
 	.links = LIST_HEAD_INIT ( certstore.links ),
 };
 
+/** Number of buckets in each certificate store index (must be a power of two)
+ *
+ * A full public CA bundle may contain several hundred certificates.
+ */
+#define CERTSTORE_INDEX_SIZE 64
+
+/** Maximum number of trailing bytes used to hash a raw certificate
+ *
+ * The final bytes of a raw certificate lie within its signature, and
+ * so are effectively unique.
+ */
+#define CERTSTORE_RAW_HASH_LEN 32
+
+/** Certificate store index by raw certificate data */
+static struct list_head certstore_raw_index[CERTSTORE_INDEX_SIZE];
+
+/** Certificate store index by subject */
+static struct list_head certstore_subject_index[CERTSTORE_INDEX_SIZE];
+
+/**
+ * Calculate hash of data
+ *
+ * @v data		Data
+ * @v len		Length of data
+ * @ret hash		Hash value
+ */
+static unsigned int certstore_hash ( const void *data, size_t len ) {
+	const uint8_t *bytes = data;
+	unsigned int hash = len;
+
+	while ( len-- )
+		hash = ( ( hash * 31 ) + *(bytes++) );
+	return hash;
+}
+
+/**
+ * Get certificate store index bucket
+ *
+ * @v index		Index
+ * @v hash		Hash value
+ * @ret bucket		Bucket list
+ */
+static struct list_head * certstore_bucket ( struct list_head *index,
+					     unsigned int hash ) {
+	struct list_head *bucket;
+
+	/* Identify bucket */
+	bucket = &index[ hash & ( CERTSTORE_INDEX_SIZE - 1 ) ];
+
+	/* Initialise bucket on first use */
+	if ( ! bucket->next )
+		INIT_LIST_HEAD ( bucket );
+	return bucket;
+}
+
+/**
+ * Get certificate store raw data index bucket
+ *
+ * @v raw		Raw certificate data
+ * @ret bucket		Bucket list
+ */
+static struct list_head *
+certstore_raw_bucket ( const struct asn1_cursor *raw ) {
+	size_t len = raw->len;
+
+	if ( len > CERTSTORE_RAW_HASH_LEN )
+		len = CERTSTORE_RAW_HASH_LEN;
+	return certstore_bucket ( certstore_raw_index,
+				  ( certstore_hash ( ( raw->data + raw->len -
+						       len ), len ) ^
+				    raw->len ) );
+}
+
+/**
+ * Get certificate store subject index bucket
+ *
+ * @v subject		Raw subject
+ * @ret bucket		Bucket list
+ */
+static struct list_head *
+certstore_subject_bucket ( const struct asn1_cursor *subject ) {
+
+	return certstore_bucket ( certstore_subject_index,
+				  certstore_hash ( subject->data,
+						   subject->len ) );
+}
+
 /**
  * Mark stored certificate as most recently used
  *
@@ -103,13 +190,32 @@ struct x509_certificate * certstore_find ( struct asn1_cursor *raw ) {
 	struct x509_certificate *cert;
 
 	/* Search for certificate within store */
-	list_for_each_entry ( cert, &certstore.links, store.list ) {
+	list_for_each_entry ( cert, certstore_raw_bucket ( raw ), raw_index ) {
 		if ( asn1_compare ( raw, &cert->raw ) == 0 )
 			return certstore_found ( cert );
 	}
 	return NULL;
 }
 
+/**
+ * Find certificate in store by subject
+ *
+ * @v subject		Raw subject
+ * @ret cert		X.509 certificate, or NULL if not found
+ */
+struct x509_certificate *
+certstore_find_subject ( const struct asn1_cursor *subject ) {
+	struct x509_certificate *cert;
+
+	/* Search for certificate within store */
+	list_for_each_entry ( cert, certstore_subject_bucket ( subject ),
+			      subject_index ) {
+		if ( asn1_compare ( subject, &cert->subject.raw ) == 0 )
+			return certstore_found ( cert );
+	}
+	return NULL;
+}
+
 /**
  * Find certificate in store corresponding to a private key
  *
@@ -141,6 +247,9 @@ void certstore_add ( struct x509_certificate *cert ) {
 	cert->store.cert = cert;
 	x509_get ( cert );
 	list_add ( &cert->store.list, &certstore.links );
+	list_add ( &cert->raw_index, certstore_raw_bucket ( &cert->raw ) );
+	list_add ( &cert->subject_index,
+		   certstore_subject_bucket ( &cert->subject.raw ) );
 	DBGC ( &certstore, "CERTSTORE added certificate %s\n",
 	       x509_name ( cert ) );
 }
@@ -160,6 +269,8 @@ void certstore_del ( struct x509_certificate *cert ) {
 	DBGC ( &certstore, "CERTSTORE removed certificate %s\n",
 	       x509_name ( cert ) );
 	list_del ( &cert->store.list );
+	list_del ( &cert->raw_index );
+	list_del ( &cert->subject_index );
 	x509_put ( cert );
 }
 
@@ -574,12 +574,16 @@ static void cms_digest ( struct cms_signature *sig,
  * @v cert		Corresponding certificate
  * @v data		Signed data
  * @v len		Length of signed data
+ * @v digested		Algorithm of precomputed digest, or NULL
+ * @v value		Precomputed digest value
  * @ret rc		Return status code
  */
 static int cms_verify_digest ( struct cms_signature *sig,
 			       struct cms_signer_info *info,
 			       struct x509_certificate *cert,
-			       userptr_t data, size_t len ) {
+			       userptr_t data, size_t len,
+			       struct digest_algorithm *digested,
+			       const void *value ) {
 	struct digest_algorithm *digest = info->digest;
 	struct pubkey_algorithm *pubkey = info->pubkey;
 	struct x509_public_key *public_key = &cert->subject.public_key;
@@ -587,8 +591,14 @@ static int cms_verify_digest ( struct cms_signature *sig,
 	uint8_t ctx[ pubkey->ctxsize ];
 	int rc;
 
-	/* Generate digest */
-	cms_digest ( sig, info, data, len, digest_out );
+	/* Use precomputed digest, if applicable, or generate digest */
+	if ( digested && ( digested == digest ) ) {
+		memcpy ( digest_out, value, sizeof ( digest_out ) );
+		DBGC ( sig, "CMS %p/%p using precomputed digest\n",
+		       sig, info );
+	} else {
+		cms_digest ( sig, info, data, len, digest_out );
+	}
 
 	/* Initialise public-key algorithm */
 	if ( ( rc = pubkey_init ( pubkey, ctx, public_key->raw.data,
@@ -620,6 +630,8 @@ static int cms_verify_digest ( struct cms_signature *sig,
  * @v info		Signer information
  * @v data		Signed data
  * @v len		Length of signed data
+ * @v digested		Algorithm of precomputed digest, or NULL
+ * @v value		Precomputed digest value
  * @v time		Time at which to validate certificates
  * @v store		Certificate store, or NULL to use default
  * @v root		Root certificate list, or NULL to use default
@@ -628,6 +640,8 @@ static int cms_verify_digest ( struct cms_signature *sig,
 static int cms_verify_signer_info ( struct cms_signature *sig,
 				    struct cms_signer_info *info,
 				    userptr_t data, size_t len,
+				    struct digest_algorithm *digested,
+				    const void *value,
 				    time_t time, struct x509_chain *store,
 				    struct x509_root *root ) {
 	struct x509_certificate *cert;
@@ -660,27 +674,35 @@ static int cms_verify_signer_info ( struct cms_signature *sig,
 	}
 
 	/* Verify digest */
-	if ( ( rc = cms_verify_digest ( sig, info, cert, data, len ) ) != 0 )
+	if ( ( rc = cms_verify_digest ( sig, info, cert, data, len,
+					digested, value ) ) != 0 )
 		return rc;
 
 	return 0;
 }
 
 /**
- * Verify CMS signature
+ * Verify CMS signature using optional precomputed digest
  *
  * @v sig		CMS signature
  * @v data		Signed data
  * @v len		Length of signed data
+ * @v digested		Algorithm of precomputed digest, or NULL
+ * @v value		Precomputed digest value
  * @v name		Required common name, or NULL to check all signatures
  * @v time		Time at which to validate certificates
  * @v store		Certificate store, or NULL to use default
  * @v root		Root certificate list, or NULL to use default
  * @ret rc		Return status code
+ *
+ * A precomputed digest (e.g. one calculated while the signed data was
+ * being downloaded) will be used in place of reading the signed data
+ * for any signer using the same digest algorithm.
  */
-int cms_verify ( struct cms_signature *sig, userptr_t data, size_t len,
-		 const char *name, time_t time, struct x509_chain *store,
-		 struct x509_root *root ) {
+int cms_verify_digested ( struct cms_signature *sig, userptr_t data,
+			  size_t len, struct digest_algorithm *digested,
+			  const void *value, const char *name, time_t time,
+			  struct x509_chain *store, struct x509_root *root ) {
 	struct cms_signer_info *info;
 	struct x509_certificate *cert;
 	int count = 0;
@@ -691,7 +713,8 @@ int cms_verify ( struct cms_signature *sig, userptr_t data, size_t len,
 		cert = x509_first ( info->chain );
 		if ( name && ( x509_check_name ( cert, name ) != 0 ) )
 			continue;
-		if ( ( rc = cms_verify_signer_info ( sig, info, data, len, time,
+		if ( ( rc = cms_verify_signer_info ( sig, info, data, len,
+						     digested, value, time,
 						     store, root ) ) != 0 )
 			return rc;
 		count++;
@@ -711,3 +734,23 @@ int cms_verify ( struct cms_signature *sig, userptr_t data, size_t len,
 
 	return 0;
 }
+
+/**
+ * Verify CMS signature
+ *
+ * @v sig		CMS signature
+ * @v data		Signed data
+ * @v len		Length of signed data
+ * @v name		Required common name, or NULL to check all signatures
+ * @v time		Time at which to validate certificates
+ * @v store		Certificate store, or NULL to use default
+ * @v root		Root certificate list, or NULL to use default
+ * @ret rc		Return status code
+ */
+int cms_verify ( struct cms_signature *sig, userptr_t data, size_t len,
+		 const char *name, time_t time, struct x509_chain *store,
+		 struct x509_root *root ) {
+
+	return cms_verify_digested ( sig, data, len, NULL, NULL, name, time,
+				     store, root );
+}
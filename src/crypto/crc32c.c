@@ -0,0 +1,150 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+#include <stdint.h>
+#include <byteswap.h>
+#include <ipxe/accelerator.h>
+#include <ipxe/crc32c.h>
+
+/** @file
+ *
+ * CRC32C (Castagnoli) checksum
+ *
+ * The portable implementation uses the "slicing-by-8" technique,
+ * consuming eight bytes per iteration using eight lookup tables.
+ * The tables are constructed on first use, to avoid adding 8kB of
+ * initialised data to the binary.
+ *
+ * Seeds and results follow the convention used by crc32_le(): the
+ * caller is responsible for any pre- and post-inversion.
+ */
+
+/** Slicing-by-8 lookup tables */
+static uint32_t crc32c_table[8][256];
+
+/**
+ * Construct slicing-by-8 lookup tables
+ *
+ */
+static void crc32c_init ( void ) {
+	uint32_t crc;
+	unsigned int i;
+	unsigned int j;
+
+	/* Construct byte-at-a-time table */
+	for ( i = 0 ; i < 256 ; i++ ) {
+		crc = i;
+		for ( j = 0 ; j < 8 ; j++ )
+			crc = ( ( crc >> 1 ) ^ ( ( crc & 1 ) ? CRC32C_POLY : 0 ) );
+		crc32c_table[0][i] = crc;
+	}
+
+	/* Construct tables for subsequent byte positions */
+	for ( i = 0 ; i < 256 ; i++ ) {
+		crc = crc32c_table[0][i];
+		for ( j = 1 ; j < 8 ; j++ ) {
+			crc = ( ( crc >> 8 ) ^ crc32c_table[0][ crc & 0xff ] );
+			crc32c_table[j][i] = crc;
+		}
+	}
+}
+
+/**
+ * Calculate CRC32C using slicing-by-8
+ *
+ * @v crc		Current CRC value
+ * @v data		Data
+ * @v len		Length of data
+ * @ret crc		Updated CRC value
+ */
+static uint32_t crc32c_generic ( uint32_t crc, const void *data, size_t len ) {
+	const uint8_t *bytes = data;
+	uint32_t lo;
+	uint32_t hi;
+
+	/* Construct tables on first use (entry 1 is never zero) */
+	if ( ! crc32c_table[0][1] )
+		crc32c_init();
+
+	/* Process leading bytes until aligned */
+	while ( len && ( ( ( intptr_t ) bytes ) & ( sizeof ( lo ) - 1 ) ) ) {
+		crc = ( ( crc >> 8 ) ^ crc32c_table[0][ ( crc ^ *(bytes++) ) &
+						      0xff ] );
+		len--;
+	}
+
+	/* Process eight bytes at a time */
+	while ( len >= 8 ) {
+		lo = ( le32_to_cpu ( *( ( const uint32_t * ) bytes ) ) ^ crc );
+		hi = le32_to_cpu ( *( ( const uint32_t * ) ( bytes + 4 ) ) );
+		crc = ( crc32c_table[7][ lo & 0xff ] ^
+			crc32c_table[6][ ( lo >> 8 ) & 0xff ] ^
+			crc32c_table[5][ ( lo >> 16 ) & 0xff ] ^
+			crc32c_table[4][ lo >> 24 ] ^
+			crc32c_table[3][ hi & 0xff ] ^
+			crc32c_table[2][ ( hi >> 8 ) & 0xff ] ^
+			crc32c_table[1][ ( hi >> 16 ) & 0xff ] ^
+			crc32c_table[0][ hi >> 24 ] );
+		bytes += 8;
+		len -= 8;
+	}
+
+	/* Process trailing bytes */
+	while ( len-- ) {
+		crc = ( ( crc >> 8 ) ^ crc32c_table[0][ ( crc ^ *(bytes++) ) &
+						      0xff ] );
+	}
+
+	return crc;
+}
+
+/**
+ * Identify CRC32C accelerator
+ *
+ * @ret accel		Accelerated implementation, or NULL
+ */
+static struct crc32c_accelerator * crc32c_accelerator ( void ) {
+	return accelerator_select ( CRC32C_ACCELERATORS );
+}
+
+/**
+ * Calculate CRC32C
+ *
+ * @v seed		Initial value
+ * @v data		Data
+ * @v len		Length of data
+ * @ret crc		CRC32C value
+ */
+uint32_t crc32c_le ( uint32_t seed, const void *data, size_t len ) {
+	struct crc32c_accelerator *accel;
+
+	/* Use accelerated implementation, if available */
+	accel = crc32c_accelerator();
+	if ( accel )
+		return accel->update ( seed, data, len );
+
+	return crc32c_generic ( seed, data, len );
+}
+
+/* Drag in CRC32C accelerators */
+REQUIRING_SYMBOL ( crc32c_le );
+REQUIRE_OBJECT ( config_crc32c );
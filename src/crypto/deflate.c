@@ -28,6 +28,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <errno.h>
 #include <assert.h>
 #include <ctype.h>
+#include <byteswap.h>
 #include <ipxe/uaccess.h>
 #include <ipxe/deflate.h>
 
@@ -161,42 +162,31 @@ static const char * deflate_alphabet_name ( struct deflate *deflate,
  *
  * @v deflate		Decompressor
  * @v alphabet		Huffman alphabet
+ * @v used		Number of decoding table entries used
  */
 static void deflate_dump_alphabet ( struct deflate *deflate,
-				    struct deflate_alphabet *alphabet ) {
-	struct deflate_huf_symbols *huf_sym;
-	unsigned int bits;
-	unsigned int huf;
+				    struct deflate_alphabet *alphabet,
+				    unsigned int used ) {
+	struct deflate_huf_entry *entry;
 	unsigned int i;
 
 	/* Do nothing unless debugging is enabled */
 	if ( ! DBG_EXTRA )
 		return;
 
-	/* Dump symbol table for each utilised length */
-	for ( bits = 1 ; bits <= ( sizeof ( alphabet->huf ) /
-				   sizeof ( alphabet->huf[0] ) ) ; bits++ ) {
-		huf_sym = &alphabet->huf[ bits - 1 ];
-		if ( huf_sym->freq == 0 )
-			continue;
-		huf = ( huf_sym->start >> huf_sym->shift );
-		DBGC2 ( alphabet, "DEFLATE %p \"%s\" length %d start \"%s\" "
-			"freq %d:", deflate,
-			deflate_alphabet_name ( deflate, alphabet ), bits,
-			deflate_bin ( huf, huf_sym->bits ), huf_sym->freq );
-		for ( i = 0 ; i < huf_sym->freq ; i++ ) {
-			DBGC2 ( alphabet, " %03x",
-				huf_sym->raw[ huf + i ] );
+	/* Dump decoding table */
+	DBGC2 ( alphabet, "DEFLATE %p \"%s\" uses %d/%d entries:", deflate,
+		deflate_alphabet_name ( deflate, alphabet ), used,
+		alphabet->max );
+	for ( i = 0 ; i < used ; i++ ) {
+		entry = &alphabet->table[i];
+		if ( entry->sub_bits ) {
+			DBGC2 ( alphabet, " [%d+%d]", entry->raw,
+				entry->sub_bits );
+		} else {
+			DBGC2 ( alphabet, " %03x/%d", entry->raw,
+				entry->bits );
 		}
-		DBGC2 ( alphabet, "\n" );
-	}
-
-	/* Dump quick lookup table */
-	DBGC2 ( alphabet, "DEFLATE %p \"%s\" quick lookup:", deflate,
-		deflate_alphabet_name ( deflate, alphabet ) );
-	for ( i = 0 ; i < ( sizeof ( alphabet->lookup ) /
-			    sizeof ( alphabet->lookup[0] ) ) ; i++ ) {
-		DBGC2 ( alphabet, " %d", ( alphabet->lookup[i] + 1 ) );
 	}
 	DBGC2 ( alphabet, "\n" );
 }
@@ -213,36 +203,33 @@ static void deflate_dump_alphabet ( struct deflate *deflate,
 static int deflate_alphabet ( struct deflate *deflate,
 			      struct deflate_alphabet *alphabet,
 			      unsigned int count, unsigned int offset ) {
-	struct deflate_huf_symbols *huf_sym;
+	struct deflate_huf_entry *table = alphabet->table;
+	struct deflate_huf_entry *sub = NULL;
+	unsigned int freq[ DEFLATE_HUFFMAN_BITS + 1 ];
+	unsigned int next[ DEFLATE_HUFFMAN_BITS + 1 ];
+	unsigned int start[ DEFLATE_HUFFMAN_BITS + 1 ];
+	unsigned int root = alphabet->root;
+	unsigned int prefix = -1U;
+	unsigned int sub_bits = 0;
+	unsigned int used;
 	unsigned int huf;
-	unsigned int cum_freq;
+	unsigned int rev;
 	unsigned int bits;
 	unsigned int raw;
-	unsigned int adjustment;
-	unsigned int prefix;
-	int complete;
-
-	/* Clear symbol table */
-	memset ( alphabet->huf, 0, sizeof ( alphabet->huf ) );
+	unsigned int index;
+	unsigned int i;
+	int left;
 
 	/* Count number of symbols with each Huffman-coded length */
-	for ( raw = 0 ; raw < count ; raw++ ) {
-		bits = deflate_length ( deflate, ( raw + offset ) );
-		if ( bits )
-			alphabet->huf[ bits - 1 ].freq++;
-	}
+	memset ( freq, 0, sizeof ( freq ) );
+	for ( raw = 0 ; raw < count ; raw++ )
+		freq[ deflate_length ( deflate, ( raw + offset ) ) ]++;
 
-	/* Populate Huffman-coded symbol table */
+	/* Calculate first Huffman-coded symbol of each length */
 	huf = 0;
-	cum_freq = 0;
-	for ( bits = 1 ; bits <= ( sizeof ( alphabet->huf ) /
-				   sizeof ( alphabet->huf[0] ) ) ; bits++ ) {
-		huf_sym = &alphabet->huf[ bits - 1 ];
-		huf_sym->bits = bits;
-		huf_sym->shift = ( 16 - bits );
-		huf_sym->start = ( huf << huf_sym->shift );
-		huf_sym->raw = &alphabet->raw[cum_freq];
-		huf += huf_sym->freq;
+	for ( bits = 1 ; bits <= DEFLATE_HUFFMAN_BITS ; bits++ ) {
+		next[bits] = huf;
+		huf += freq[bits];
 		if ( huf > ( 1U << bits ) ) {
 			DBGC ( alphabet, "DEFLATE %p \"%s\" has too many "
 			       "symbols with lengths <=%d\n", deflate,
@@ -251,48 +238,96 @@ static int deflate_alphabet ( struct deflate *deflate,
 			return -EINVAL;
 		}
 		huf <<= 1;
-		cum_freq += huf_sym->freq;
 	}
-	complete = ( huf == ( 1U << bits ) );
 
-	/* Populate raw symbol table */
+	/* Check that there are no invalid codes */
+	if ( huf != ( 1U << bits ) ) {
+		DBGC ( alphabet, "DEFLATE %p \"%s\" is incomplete\n", deflate,
+		       deflate_alphabet_name ( deflate, alphabet ) );
+		return -EINVAL;
+	}
+
+	/* Sort symbols by Huffman-coded length, then by value.  This
+	 * places symbols in order of Huffman-coded value.
+	 */
+	start[0] = 0;
+	for ( bits = 1 ; bits <= DEFLATE_HUFFMAN_BITS ; bits++ )
+		start[bits] = ( start[ bits - 1 ] + freq[ bits - 1 ] );
 	for ( raw = 0 ; raw < count ; raw++ ) {
 		bits = deflate_length ( deflate, ( raw + offset ) );
-		if ( bits ) {
-			huf_sym = &alphabet->huf[ bits - 1 ];
-			*(huf_sym->raw++) = raw;
-		}
+		deflate->sorted[ start[bits]++ ] = raw;
 	}
 
-	/* Adjust Huffman-coded symbol table raw pointers and populate
-	 * quick lookup table.
+	/* Populate decoding tables.  Symbols are processed in order
+	 * of Huffman-coded value, so that all symbols sharing a root
+	 * table prefix are processed consecutively, and the length of
+	 * each subsidiary table may be determined from the lengths of
+	 * the symbols not yet processed.
 	 */
-	for ( bits = 1 ; bits <= ( sizeof ( alphabet->huf ) /
-				   sizeof ( alphabet->huf[0] ) ) ; bits++ ) {
-		huf_sym = &alphabet->huf[ bits - 1 ];
-
-		/* Adjust raw pointer */
-		huf_sym->raw -= huf_sym->freq; /* Reset to first symbol */
-		adjustment = ( huf_sym->start >> huf_sym->shift );
-		huf_sym->raw -= adjustment; /* Adjust for quick indexing */
-
-		/* Populate quick lookup table */
-		for ( prefix = ( huf_sym->start >> DEFLATE_HUFFMAN_QL_SHIFT ) ;
-		      prefix < ( 1 << DEFLATE_HUFFMAN_QL_BITS ) ; prefix++ ) {
-			alphabet->lookup[prefix] = ( bits - 1 );
+	used = ( 1 << root );
+	for ( i = freq[0] ; i < count ; i++ ) {
+		raw = deflate->sorted[i];
+		bits = deflate_length ( deflate, ( raw + offset ) );
+
+		/* Allocate Huffman-coded symbol and reverse bit order
+		 * to match the accumulator.
+		 */
+		huf = next[bits]++;
+		rev = ( ( ( deflate_reverse[ huf & 0xff ] << 8 ) |
+			  deflate_reverse[ huf >> 8 ] ) >>
+			( 16 - bits ) );
+
+		/* Fill root table entries for short symbols */
+		if ( bits <= root ) {
+			for ( index = rev ; index < ( 1U << root ) ;
+			      index += ( 1 << bits ) ) {
+				table[index].raw = raw;
+				table[index].bits = bits;
+				table[index].sub_bits = 0;
+			}
+			freq[bits]--;
+			continue;
 		}
-	}
 
-	/* Dump alphabet (for debugging) */
-	deflate_dump_alphabet ( deflate, alphabet );
+		/* Allocate subsidiary table, if applicable */
+		if ( ( rev & ( ( 1 << root ) - 1 ) ) != prefix ) {
+			prefix = ( rev & ( ( 1 << root ) - 1 ) );
+			sub_bits = ( bits - root );
+			left = ( 1 << sub_bits );
+			while ( ( sub_bits + root ) < DEFLATE_HUFFMAN_BITS ) {
+				left -= freq[ sub_bits + root ];
+				if ( left <= 0 )
+					break;
+				sub_bits++;
+				left <<= 1;
+			}
+			if ( ( used + ( 1 << sub_bits ) ) > alphabet->max ) {
+				DBGC ( alphabet, "DEFLATE %p \"%s\" table "
+				       "overflow\n", deflate,
+				       deflate_alphabet_name ( deflate,
+							       alphabet ) );
+				return -EINVAL;
+			}
+			table[prefix].raw = used;
+			table[prefix].bits = root;
+			table[prefix].sub_bits = sub_bits;
+			sub = &table[used];
+			used += ( 1 << sub_bits );
+		}
 
-	/* Check that there are no invalid codes */
-	if ( ! complete ) {
-		DBGC ( alphabet, "DEFLATE %p \"%s\" is incomplete\n", deflate,
-		       deflate_alphabet_name ( deflate, alphabet ) );
-		return -EINVAL;
+		/* Fill subsidiary table entries */
+		for ( index = ( rev >> root ) ; index < ( 1U << sub_bits ) ;
+		      index += ( 1 << ( bits - root ) ) ) {
+			sub[index].raw = raw;
+			sub[index].bits = bits;
+			sub[index].sub_bits = 0;
+		}
+		freq[bits]--;
 	}
 
+	/* Dump alphabet (for debugging) */
+	deflate_dump_alphabet ( deflate, alphabet, used );
+
 	return 0;
 }
 
@@ -318,11 +353,8 @@ static int deflate_accumulate ( struct deflate *deflate,
 		/* Acquire byte from input */
 		copy_from_user ( &byte, in->data, in->offset++,
 				 sizeof ( byte ) );
-		deflate->accumulator = ( deflate->accumulator |
-					 ( byte << deflate->bits ) );
-		deflate->rotalumucca = ( deflate->rotalumucca |
-					 ( deflate_reverse[byte] <<
-					   ( 24 - deflate->bits ) ) );
+		deflate->accumulator |= ( ( ( uint64_t ) byte ) <<
+					  deflate->bits );
 		deflate->bits += 8;
 
 		/* Sanity check */
@@ -349,7 +381,6 @@ static int deflate_consume ( struct deflate *deflate, unsigned int count ) {
 	/* Extract data and consume bits */
 	data = ( deflate->accumulator & ( ( 1 << count ) - 1 ) );
 	deflate->accumulator >>= count;
-	deflate->rotalumucca <<= count;
 	deflate->bits -= count;
 
 	return data;
@@ -385,6 +416,31 @@ static int deflate_extract ( struct deflate *deflate, struct deflate_chunk *in,
 	return data;
 }
 
+/**
+ * Look up Huffman-coded symbol
+ *
+ * @v alphabet		Huffman alphabet
+ * @v accumulator	Accumulated bits
+ * @ret entry		Decoding table entry
+ */
+static inline __attribute__ (( always_inline )) struct deflate_huf_entry *
+deflate_lookup ( struct deflate_alphabet *alphabet, uint64_t accumulator ) {
+	struct deflate_huf_entry *entry;
+	unsigned int root = alphabet->root;
+
+	/* Look up root table entry */
+	entry = &alphabet->table[ accumulator & ( ( 1 << root ) - 1 ) ];
+
+	/* Look up subsidiary table entry, if applicable */
+	if ( entry->sub_bits ) {
+		entry = &alphabet->table[ entry->raw +
+					  ( ( accumulator >> root ) &
+					    ( ( 1 << entry->sub_bits ) - 1 ) )];
+	}
+
+	return entry;
+}
+
 /**
  * Attempt to decode a Huffman-coded symbol from input stream
  *
@@ -396,43 +452,32 @@ static int deflate_extract ( struct deflate *deflate, struct deflate_chunk *in,
 static int deflate_decode ( struct deflate *deflate,
 			    struct deflate_chunk *in,
 			    struct deflate_alphabet *alphabet ) {
-	struct deflate_huf_symbols *huf_sym;
-	uint16_t huf;
-	unsigned int lookup_index;
+	struct deflate_huf_entry *entry;
 	int excess;
-	unsigned int raw;
 
 	/* Attempt to accumulate maximum required number of bits.
 	 * There may be fewer bits than this remaining in the stream,
 	 * even if the stream still contains some complete
-	 * Huffman-coded symbols.
+	 * Huffman-coded symbols.  Any bits beyond those accumulated
+	 * are zero, and so cannot cause a complete symbol to be
+	 * decoded incorrectly.
 	 */
 	deflate_accumulate ( deflate, in, DEFLATE_HUFFMAN_BITS );
 
-	/* Normalise the bit-reversed accumulated value to 16 bits */
-	huf = ( deflate->rotalumucca >> 16 );
-
-	/* Find symbol set for this length */
-	lookup_index = ( huf >> DEFLATE_HUFFMAN_QL_SHIFT );
-	huf_sym = &alphabet->huf[ alphabet->lookup[ lookup_index ] ];
-	while ( huf < huf_sym->start )
-		huf_sym--;
+	/* Look up symbol */
+	entry = deflate_lookup ( alphabet, deflate->accumulator );
 
 	/* Calculate number of excess bits, and return if not yet complete */
-	excess = ( deflate->bits - huf_sym->bits );
+	excess = ( deflate->bits - entry->bits );
 	if ( excess < 0 )
 		return excess;
 
 	/* Consume bits */
-	deflate_consume ( deflate, huf_sym->bits );
+	deflate_consume ( deflate, entry->bits );
+	DBGCP ( deflate, "DEFLATE %p decoded %#x = %d\n",
+		deflate, entry->raw, entry->raw );
 
-	/* Look up raw symbol */
-	raw = huf_sym->raw[ huf >> huf_sym->shift ];
-	DBGCP ( deflate, "DEFLATE %p decoded %s = %#x = %d\n", deflate,
-		deflate_bin ( ( huf >> huf_sym->shift ), huf_sym->bits ),
-		raw, raw );
-
-	return raw;
+	return entry->raw;
 }
 
 /**
@@ -458,19 +503,179 @@ static void deflate_copy ( struct deflate_chunk *out,
 	size_t out_offset = out->offset;
 	size_t copy_len;
 
-	/* Copy data one byte at a time, to allow for overlap */
 	if ( out_offset < out->len ) {
 		copy_len = ( out->len - out_offset );
 		if ( copy_len > len )
 			copy_len = len;
-		while ( copy_len-- ) {
-			memcpy_user ( out->data, out_offset++,
-				      start, offset++, 1 );
+		if ( ( start != out->data ) ||
+		     ( ( offset + copy_len ) <= out_offset ) ) {
+			/* Copy non-overlapping data in a single pass */
+			memcpy_user ( out->data, out_offset,
+				      start, offset, copy_len );
+		} else {
+			/* Copy data one byte at a time, to allow for
+			 * overlap.
+			 */
+			while ( copy_len-- ) {
+				memcpy_user ( out->data, out_offset++,
+					      start, offset++, 1 );
+			}
 		}
 	}
 	out->offset += len;
 }
 
+/**
+ * Inflate literal/length and distance symbols via fast path
+ *
+ * @v deflate		Decompressor
+ * @v in		Compressed input data
+ * @v out		Output data buffer
+ * @ret rc		Return status code, or positive at end of block
+ *
+ * While there is sufficient input data to decode a complete
+ * literal/length and distance pair without running out of
+ * accumulated bits, and sufficient space in the output buffer to
+ * hold the longest possible duplicated string, we can avoid all of
+ * the resumption and bounds checks required by the general case.
+ * The accumulator is refilled using a single 64-bit load per
+ * symbol pair.
+ *
+ * Data may be written to the output buffer beyond the updated
+ * offset.  Such data will be overwritten as decompression continues.
+ */
+static int deflate_fast ( struct deflate *deflate,
+			  struct deflate_chunk *in,
+			  struct deflate_chunk *out ) {
+	struct deflate_alphabet litlen = deflate->litlen;
+	struct deflate_alphabet distance = deflate->distance_codelen;
+	const uint8_t *in_data = user_to_virt ( in->data, 0 );
+	const uint8_t *in_pos = ( in_data + in->offset );
+	const uint8_t *in_end;
+	uint8_t *out_data = user_to_virt ( out->data, 0 );
+	uint8_t *out_pos = ( out_data + out->offset );
+	uint8_t *out_end;
+	uint64_t accumulator = deflate->accumulator;
+	unsigned int bits = deflate->bits;
+	struct deflate_huf_entry *entry;
+	const uint8_t *src;
+	uint8_t *end;
+	uint64_t word;
+	unsigned int code;
+	unsigned int extra;
+	unsigned int extra_bits;
+	size_t dup_len;
+	size_t dup_distance;
+	int rc = 0;
+
+	/* Do nothing unless there is sufficient input and output space */
+	if ( ( ( in->len - in->offset ) < sizeof ( word ) ) ||
+	     ( ( out->offset + DEFLATE_FAST_OUT ) > out->len ) )
+		return 0;
+	in_end = ( in_data + in->len - sizeof ( word ) );
+	out_end = ( out_data + out->len - DEFLATE_FAST_OUT );
+
+	while ( ( in_pos <= in_end ) && ( out_pos <= out_end ) ) {
+
+		/* Refill accumulator with as many whole bytes as will
+		 * fit.  This always leaves at least 56 bits, which is
+		 * sufficient for the longest possible literal/length
+		 * and distance pair (including extra bits).
+		 */
+		memcpy ( &word, in_pos, sizeof ( word ) );
+		accumulator |= ( le64_to_cpu ( word ) << bits );
+		extra = ( ( 63 - bits ) / 8 );
+		in_pos += extra;
+		bits += ( 8 * extra );
+		accumulator &= ( ( 1ULL << bits ) - 1 );
+
+		/* Decode literal/length symbol */
+		entry = deflate_lookup ( &litlen, accumulator );
+		accumulator >>= entry->bits;
+		bits -= entry->bits;
+		code = entry->raw;
+
+		/* Handle literal values */
+		if ( code < DEFLATE_LITLEN_END ) {
+			*(out_pos++) = code;
+			continue;
+		}
+
+		/* Handle end of block */
+		if ( code == DEFLATE_LITLEN_END ) {
+			rc = 1;
+			break;
+		}
+
+		/* Calculate duplicate length */
+		extra = ( code - DEFLATE_LITLEN_END - 1 );
+		if ( extra < 28 ) {
+			extra_bits = ( extra / 4 );
+			if ( extra_bits )
+				extra_bits--;
+			dup_len = ( deflate_litlen_base[extra] +
+				    ( accumulator &
+				      ( ( 1 << extra_bits ) - 1 ) ) );
+			accumulator >>= extra_bits;
+			bits -= extra_bits;
+		} else {
+			dup_len = DEFLATE_DUP_MAX_LEN;
+		}
+
+		/* Decode distance symbol and calculate distance */
+		entry = deflate_lookup ( &distance, accumulator );
+		accumulator >>= entry->bits;
+		bits -= entry->bits;
+		code = entry->raw;
+		extra_bits = ( code / 2 );
+		if ( extra_bits )
+			extra_bits--;
+		dup_distance = ( deflate_distance_base[code] +
+				 ( accumulator &
+				   ( ( 1 << extra_bits ) - 1 ) ) );
+		accumulator >>= extra_bits;
+		bits -= extra_bits;
+
+		/* Sanity check */
+		if ( dup_distance > ( size_t ) ( out_pos - out_data ) ) {
+			DBGC ( deflate, "DEFLATE %p bad distance %zd (max "
+			       "%zd)\n", deflate, dup_distance,
+			       ( out_pos - out_data ) );
+			rc = -EINVAL;
+			break;
+		}
+
+		/* Copy data, allowing for overlap.  If the distance
+		 * is at least the size of a word then we can copy a
+		 * word at a time, possibly overrunning the end of the
+		 * duplicated string (but never the output buffer).
+		 */
+		src = ( out_pos - dup_distance );
+		end = ( out_pos + dup_len );
+		if ( dup_distance >= sizeof ( word ) ) {
+			do {
+				memcpy ( out_pos, src, sizeof ( word ) );
+				out_pos += sizeof ( word );
+				src += sizeof ( word );
+			} while ( out_pos < end );
+		} else if ( dup_distance == 1 ) {
+			memset ( out_pos, *src, dup_len );
+		} else {
+			while ( out_pos < end )
+				*(out_pos++) = *(src++);
+		}
+		out_pos = end;
+	}
+
+	/* Record progress */
+	in->offset = ( in_pos - in_data );
+	out->offset = ( out_pos - out_data );
+	deflate->accumulator = accumulator;
+	deflate->bits = bits;
+
+	return rc;
+}
+
 /**
  * Inflate compressed data
  *
@@ -822,10 +1027,18 @@ int deflate_inflate ( struct deflate *deflate,
 
  lzhuf_litlen: {
 		int code;
+		int rc;
 		uint8_t byte;
 		unsigned int extra;
 		unsigned int bits;
 
+		/* Decode as many symbols as possible via the fast path */
+		rc = deflate_fast ( deflate, in, out );
+		if ( rc < 0 )
+			return rc;
+		if ( rc > 0 )
+			goto block_done;
+
 		/* Decode Huffman codes */
 		while ( 1 ) {
 
@@ -865,7 +1078,7 @@ int deflate_inflate ( struct deflate *deflate,
 						deflate_litlen_base[extra];
 				} else {
 					deflate->extra_bits = 0;
-					deflate->dup_len = 258;
+					deflate->dup_len = DEFLATE_DUP_MAX_LEN;
 				}
 				goto lzhuf_litlen_extra;
 			}
@@ -1046,4 +1259,13 @@ void deflate_init ( struct deflate *deflate, enum deflate_format format ) {
 	/* Initialise structure */
 	memset ( deflate, 0, sizeof ( *deflate ) );
 	deflate->format = format;
+	deflate->litlen.table = deflate->litlen_table;
+	deflate->litlen.root = DEFLATE_LITLEN_ROOT_BITS;
+	deflate->litlen.max = ( sizeof ( deflate->litlen_table ) /
+				sizeof ( deflate->litlen_table[0] ) );
+	deflate->distance_codelen.table = deflate->distance_codelen_table;
+	deflate->distance_codelen.root = DEFLATE_DISTANCE_ROOT_BITS;
+	deflate->distance_codelen.max =
+		( sizeof ( deflate->distance_codelen_table ) /
+		  sizeof ( deflate->distance_codelen_table[0] ) );
 }
@@ -48,6 +48,12 @@ void ecb_encrypt ( void *ctx, const void *src, void *dst, size_t len,
 
 	assert ( ( len % blocksize ) == 0 );
 
+	/* Use bulk operation, if available */
+	if ( is_bulk_cipher ( raw_cipher ) ) {
+		cipher_bulk_encrypt ( raw_cipher, ctx, src, dst, len );
+		return;
+	}
+
 	while ( len ) {
 		cipher_encrypt ( raw_cipher, ctx, src, dst, blocksize );
 		dst += blocksize;
@@ -71,6 +77,12 @@ void ecb_decrypt ( void *ctx, const void *src, void *dst, size_t len,
 
 	assert ( ( len % blocksize ) == 0 );
 
+	/* Use bulk operation, if available */
+	if ( is_bulk_cipher ( raw_cipher ) ) {
+		cipher_bulk_decrypt ( raw_cipher, ctx, src, dst, len );
+		return;
+	}
+
 	while ( len ) {
 		cipher_decrypt ( raw_cipher, ctx, src, dst, blocksize );
 		dst += blocksize;
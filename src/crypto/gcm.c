@@ -0,0 +1,417 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <string.h>
+#include <byteswap.h>
+#include <assert.h>
+#include <ipxe/crypto.h>
+#include <ipxe/accelerator.h>
+#include <ipxe/gcm.h>
+
+/** @file
+ *
+ * Galois/Counter Mode (GCM)
+ *
+ * The GCM mode of operation is defined in NIST SP 800-38D.  Blocks
+ * are treated as polynomials over GF(2) using the bit-reflected
+ * ordering specified by GCM, i.e. the most significant bit of the
+ * first byte is the coefficient of x^0.
+ *
+ * Without an accelerator, multiplication by the hash key is performed
+ * four bits at a time using a table of precomputed products (Shoup's
+ * method).
+ */
+
+/** Maximum number of keystream blocks generated in a single bulk operation */
+#define GCM_BULK_BLOCKS 8
+
+/** GCM field polynomial (x^128 + x^7 + x^2 + x + 1), as reflected
+ * into the high qword
+ */
+#define GCM_POLY 0xe100000000000000ULL
+
+/** Reduction constants for multiplication by x^4
+ *
+ * Entry @c n is the reduction of the polynomial represented by the
+ * four bits @c n that are shifted out when multiplying by x^4, placed
+ * within the most significant 16 bits of the high qword.
+ */
+static const uint16_t gcm_reduce[16] = {
+	0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+	0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0,
+};
+
+/**
+ * Identify GCM accelerator
+ *
+ * @ret accel		Accelerated implementation, or NULL
+ */
+static struct gcm_accelerator * gcm_accelerator ( void ) {
+	return accelerator_select ( GCM_ACCELERATORS );
+}
+
+/**
+ * Construct multiplication table
+ *
+ * @v table		Multiplication table to fill in
+ * @v key		Hash key
+ */
+static void gcm_table ( struct gcm_table *table,
+			const union gcm_block *key ) {
+	uint64_t hi = be64_to_cpu ( key->qword[0] );
+	uint64_t lo = be64_to_cpu ( key->qword[1] );
+	uint64_t carry;
+	unsigned int i;
+	unsigned int j;
+
+	/* Construct products with single-bit values.  Since bits are
+	 * reflected, the value 8 represents the polynomial 1, the
+	 * value 4 represents x, and so on.
+	 */
+	table->hi[0] = 0;
+	table->lo[0] = 0;
+	for ( i = 8 ; i ; i >>= 1 ) {
+		table->hi[i] = hi;
+		table->lo[i] = lo;
+		carry = ( lo & 1 );
+		lo = ( ( hi << 63 ) | ( lo >> 1 ) );
+		hi = ( ( hi >> 1 ) ^ ( carry ? GCM_POLY : 0 ) );
+	}
+
+	/* Construct remaining products by linearity */
+	for ( i = 2 ; i < 16 ; i <<= 1 ) {
+		for ( j = 1 ; j < i ; j++ ) {
+			table->hi[ i + j ] = ( table->hi[i] ^ table->hi[j] );
+			table->lo[ i + j ] = ( table->lo[i] ^ table->lo[j] );
+		}
+	}
+}
+
+/**
+ * Multiply accumulated hash by hash key
+ *
+ * @v gcm		GCM context
+ */
+static void gcm_multiply ( struct gcm_context *gcm ) {
+	struct gcm_table *table = &gcm->table;
+	uint64_t hi = 0;
+	uint64_t lo = 0;
+	unsigned int nibble;
+	unsigned int rem;
+	unsigned int i;
+
+	/* Use accelerated implementation, if available */
+	if ( gcm->accel ) {
+		gcm->accel->multiply ( &gcm->hash, &gcm->key );
+		return;
+	}
+
+	/* Process four bits at a time, starting from the highest
+	 * power of x (i.e. the low nibble of the last byte).
+	 */
+	for ( i = ( 2 * GCM_BLOCKSIZE ) ; i-- ; ) {
+
+		/* Extract nibble */
+		nibble = gcm->hash.byte[ i / 2 ];
+		nibble = ( ( i & 1 ) ? ( nibble & 0x0f ) : ( nibble >> 4 ) );
+
+		/* Multiply product so far by x^4 */
+		rem = ( lo & 0x0f );
+		lo = ( ( hi << 60 ) | ( lo >> 4 ) );
+		hi = ( ( hi >> 4 ) ^
+		       ( ( ( uint64_t ) gcm_reduce[rem] ) << 48 ) );
+
+		/* Add product of hash key with nibble */
+		hi ^= table->hi[nibble];
+		lo ^= table->lo[nibble];
+	}
+
+	/* Store result */
+	gcm->hash.qword[0] = cpu_to_be64 ( hi );
+	gcm->hash.qword[1] = cpu_to_be64 ( lo );
+}
+
+/**
+ * Add data to accumulated hash
+ *
+ * @v gcm		GCM context
+ * @v data		Data
+ * @v len		Length of data
+ * @v offset		Offset within current block
+ */
+static void gcm_hash ( struct gcm_context *gcm, const void *data,
+		       size_t len, unsigned int offset ) {
+	const uint8_t *byte = data;
+
+	while ( len-- ) {
+		gcm->hash.byte[offset++] ^= *(byte++);
+		if ( offset == GCM_BLOCKSIZE ) {
+			gcm_multiply ( gcm );
+			offset = 0;
+		}
+	}
+}
+
+/**
+ * Add additional data to accumulated hash
+ *
+ * @v gcm		GCM context
+ * @v data		Additional data
+ * @v len		Length of additional data
+ */
+static void gcm_additional ( struct gcm_context *gcm, const void *data,
+			     size_t len ) {
+
+	gcm_hash ( gcm, data, len, ( gcm->add_len % GCM_BLOCKSIZE ) );
+	gcm->add_len += len;
+}
+
+/**
+ * Encrypt or decrypt data
+ *
+ * @v ctx		Context
+ * @v src		Data to encrypt or decrypt
+ * @v dst		Buffer for encrypted or decrypted data
+ * @v len		Length of data
+ * @v raw_cipher	Underlying cipher algorithm
+ * @v gcm		GCM context
+ * @v encrypt		Data is being encrypted
+ */
+static void gcm_crypt ( void *ctx, const void *src, void *dst, size_t len,
+			struct cipher_algorithm *raw_cipher,
+			struct gcm_context *gcm, int encrypt ) {
+	union gcm_block stream[GCM_BULK_BLOCKS];
+	const uint8_t *keystream = ( ( const uint8_t * ) stream );
+	const uint8_t *in = src;
+	uint8_t *out = dst;
+	unsigned int offset;
+	unsigned int count;
+	uint32_t ctr;
+	size_t frag_len;
+	size_t i;
+
+	/* Complete any partial block of additional data */
+	if ( len && ( gcm->data_len == 0 ) &&
+	     ( gcm->add_len % GCM_BLOCKSIZE ) ) {
+		gcm_multiply ( gcm );
+	}
+
+	while ( len ) {
+
+		/* Generate keystream for several whole blocks at once,
+		 * if possible.
+		 */
+		offset = ( gcm->data_len % GCM_BLOCKSIZE );
+		count = ( len / GCM_BLOCKSIZE );
+		if ( count > GCM_BULK_BLOCKS )
+			count = GCM_BULK_BLOCKS;
+		if ( ( offset == 0 ) && ( count > 1 ) &&
+		     is_bulk_cipher ( raw_cipher ) ) {
+
+			/* Generate keystream */
+			for ( i = 0 ; i < count ; i++ ) {
+				ctr = ntohl ( gcm->ctr.ctr.value );
+				gcm->ctr.ctr.value = htonl ( ctr + 1 );
+				memcpy ( &stream[i], &gcm->ctr,
+					 sizeof ( stream[i] ) );
+			}
+			frag_len = ( count * GCM_BLOCKSIZE );
+			cipher_bulk_encrypt ( raw_cipher, ctx, stream, stream,
+					      frag_len );
+
+			/* Hash ciphertext and apply keystream */
+			if ( ! encrypt )
+				gcm_hash ( gcm, in, frag_len, 0 );
+			for ( i = 0 ; i < frag_len ; i++ )
+				out[i] = ( in[i] ^ keystream[i] );
+			if ( encrypt )
+				gcm_hash ( gcm, out, frag_len, 0 );
+
+			/* Move to next fragment */
+			in += frag_len;
+			out += frag_len;
+			len -= frag_len;
+			gcm->data_len += frag_len;
+			continue;
+		}
+
+		/* Generate keystream for next block, if applicable */
+		if ( offset == 0 ) {
+			gcm->ctr.ctr.value =
+				htonl ( ntohl ( gcm->ctr.ctr.value ) + 1 );
+			cipher_encrypt ( raw_cipher, ctx, &gcm->ctr,
+					 &gcm->stream, GCM_BLOCKSIZE );
+		}
+
+		/* Calculate fragment length */
+		frag_len = ( GCM_BLOCKSIZE - offset );
+		if ( frag_len > len )
+			frag_len = len;
+
+		/* Hash ciphertext and apply keystream */
+		if ( ! encrypt )
+			gcm_hash ( gcm, in, frag_len, offset );
+		for ( i = 0 ; i < frag_len ; i++ )
+			out[i] = ( in[i] ^ gcm->stream.byte[ offset + i ] );
+		if ( encrypt )
+			gcm_hash ( gcm, out, frag_len, offset );
+
+		/* Move to next fragment */
+		in += frag_len;
+		out += frag_len;
+		len -= frag_len;
+		gcm->data_len += frag_len;
+	}
+}
+
+/**
+ * Set key
+ *
+ * @v ctx		Context
+ * @v key		Key
+ * @v keylen		Key length
+ * @v raw_cipher	Underlying cipher algorithm
+ * @v gcm		GCM context
+ * @ret rc		Return status code
+ */
+int gcm_setkey ( void *ctx, const void *key, size_t keylen,
+		 struct cipher_algorithm *raw_cipher,
+		 struct gcm_context *gcm ) {
+	int rc;
+
+	/* Set underlying cipher key */
+	if ( ( rc = cipher_setkey ( raw_cipher, ctx, key, keylen ) ) != 0 )
+		return rc;
+
+	/* Construct hash key */
+	memset ( &gcm->key, 0, sizeof ( gcm->key ) );
+	cipher_encrypt ( raw_cipher, ctx, &gcm->key, &gcm->key,
+			 sizeof ( gcm->key ) );
+
+	/* Use accelerated implementation or multiplication table */
+	gcm->accel = gcm_accelerator();
+	if ( ! gcm->accel )
+		gcm_table ( &gcm->table, &gcm->key );
+
+	return 0;
+}
+
+/**
+ * Set initialisation vector
+ *
+ * @v ctx		Context
+ * @v iv		Initialisation vector (of length GCM_IV_LEN)
+ * @v raw_cipher	Underlying cipher algorithm
+ * @v gcm		GCM context
+ */
+void gcm_setiv ( void *ctx __unused, const void *iv,
+		 struct cipher_algorithm *raw_cipher __unused,
+		 struct gcm_context *gcm ) {
+
+	/* Reset counter and accumulated hash */
+	memcpy ( gcm->ctr.ctr.iv, iv, sizeof ( gcm->ctr.ctr.iv ) );
+	gcm->ctr.ctr.value = htonl ( 1 );
+	memset ( &gcm->hash, 0, sizeof ( gcm->hash ) );
+	gcm->add_len = 0;
+	gcm->data_len = 0;
+}
+
+/**
+ * Encrypt data
+ *
+ * @v ctx		Context
+ * @v src		Data to encrypt
+ * @v dst		Buffer for encrypted data, or NULL for additional data
+ * @v len		Length of data
+ * @v raw_cipher	Underlying cipher algorithm
+ * @v gcm		GCM context
+ */
+void gcm_encrypt ( void *ctx, const void *src, void *dst, size_t len,
+		   struct cipher_algorithm *raw_cipher,
+		   struct gcm_context *gcm ) {
+
+	if ( dst ) {
+		gcm_crypt ( ctx, src, dst, len, raw_cipher, gcm, 1 );
+	} else {
+		gcm_additional ( gcm, src, len );
+	}
+}
+
+/**
+ * Decrypt data
+ *
+ * @v ctx		Context
+ * @v src		Data to decrypt
+ * @v dst		Buffer for decrypted data, or NULL for additional data
+ * @v len		Length of data
+ * @v raw_cipher	Underlying cipher algorithm
+ * @v gcm		GCM context
+ */
+void gcm_decrypt ( void *ctx, const void *src, void *dst, size_t len,
+		   struct cipher_algorithm *raw_cipher,
+		   struct gcm_context *gcm ) {
+
+	if ( dst ) {
+		gcm_crypt ( ctx, src, dst, len, raw_cipher, gcm, 0 );
+	} else {
+		gcm_additional ( gcm, src, len );
+	}
+}
+
+/**
+ * Generate authentication tag
+ *
+ * @v ctx		Context
+ * @v auth		Buffer for authentication tag
+ * @v raw_cipher	Underlying cipher algorithm
+ * @v gcm		GCM context
+ */
+void gcm_auth ( void *ctx, void *auth, struct cipher_algorithm *raw_cipher,
+		struct gcm_context *gcm ) {
+	union gcm_block lengths;
+	union gcm_block *tag = &gcm->stream;
+	uint8_t *out = auth;
+	size_t len;
+	unsigned int i;
+
+	/* Complete any partial block */
+	len = ( gcm->data_len ? gcm->data_len : gcm->add_len );
+	if ( len % GCM_BLOCKSIZE )
+		gcm_multiply ( gcm );
+
+	/* Add lengths block */
+	lengths.len.add = cpu_to_be64 ( ( ( uint64_t ) gcm->add_len ) * 8 );
+	lengths.len.data = cpu_to_be64 ( ( ( uint64_t ) gcm->data_len ) * 8 );
+	gcm_hash ( gcm, &lengths, sizeof ( lengths ), 0 );
+
+	/* Encrypt hash using initial counter block */
+	gcm->ctr.ctr.value = htonl ( 1 );
+	cipher_encrypt ( raw_cipher, ctx, &gcm->ctr, tag, sizeof ( *tag ) );
+	for ( i = 0 ; i < sizeof ( *tag ) ; i++ )
+		out[i] = ( tag->byte[i] ^ gcm->hash.byte[i] );
+}
+
+/* Drag in GCM accelerators */
+REQUIRING_SYMBOL ( gcm_setkey );
+REQUIRE_OBJECT ( config_gcm );
@@ -0,0 +1,117 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+/** @file
+ *
+ * HMAC-based key derivation function (HKDF)
+ *
+ * HKDF is documented in RFC 5869.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <ipxe/crypto.h>
+#include <ipxe/hmac.h>
+#include <ipxe/hkdf.h>
+
+/**
+ * Extract pseudorandom key
+ *
+ * @v digest		Digest algorithm
+ * @v salt		Salt
+ * @v salt_len		Length of salt
+ * @v ikm		Input keying material
+ * @v ikm_len		Length of input keying material
+ * @v prk		Pseudorandom key to fill in
+ *
+ * The pseudorandom key buffer must be large enough to hold a digest
+ * value.  An empty salt is equivalent to a salt consisting of
+ * zero bytes, as specified by RFC 5869.
+ */
+void hkdf_extract ( struct digest_algorithm *digest, const void *salt,
+		    size_t salt_len, const void *ikm, size_t ikm_len,
+		    void *prk ) {
+	uint8_t ctx[digest->ctxsize];
+	uint8_t key[ salt_len ? salt_len : 1 ];
+	size_t key_len = salt_len;
+
+	/* Copy the salt, since HMAC may modify the key */
+	memcpy ( key, salt, salt_len );
+
+	/* PRK = HMAC-Hash ( salt, IKM ) */
+	hmac_init ( digest, ctx, key, &key_len );
+	hmac_update ( digest, ctx, ikm, ikm_len );
+	hmac_final ( digest, ctx, key, &key_len, prk );
+}
+
+/**
+ * Expand pseudorandom key
+ *
+ * @v digest		Digest algorithm
+ * @v prk		Pseudorandom key
+ * @v prk_len		Length of pseudorandom key
+ * @v info		Context and application specific information
+ * @v info_len		Length of information
+ * @v out		Output keying material
+ * @v out_len		Length of output keying material
+ *
+ * The output length must not exceed 255 times the digest size.
+ */
+void hkdf_expand ( struct digest_algorithm *digest, const void *prk,
+		   size_t prk_len, const void *info, size_t info_len,
+		   void *out, size_t out_len ) {
+	uint8_t ctx[digest->ctxsize];
+	uint8_t key[prk_len];
+	uint8_t t[digest->digestsize];
+	size_t key_len;
+	size_t t_len = 0;
+	size_t frag_len;
+	uint8_t counter;
+
+	/* Sanity check */
+	assert ( out_len <= ( 255 * sizeof ( t ) ) );
+
+	/* T(n) = HMAC-Hash ( PRK, T(n-1) | info | n ) */
+	for ( counter = 1 ; out_len ; counter++ ) {
+
+		/* Copy the key, since HMAC may modify it */
+		memcpy ( key, prk, prk_len );
+		key_len = prk_len;
+
+		/* Calculate T(n) */
+		hmac_init ( digest, ctx, key, &key_len );
+		hmac_update ( digest, ctx, t, t_len );
+		hmac_update ( digest, ctx, info, info_len );
+		hmac_update ( digest, ctx, &counter, sizeof ( counter ) );
+		hmac_final ( digest, ctx, key, &key_len, t );
+		t_len = sizeof ( t );
+
+		/* Copy out output keying material */
+		frag_len = out_len;
+		if ( frag_len > t_len )
+			frag_len = t_len;
+		memcpy ( out, t, frag_len );
+		out += frag_len;
+		out_len -= frag_len;
+	}
+}
@@ -0,0 +1,37 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <ipxe/rsa.h>
+#include <ipxe/sha256.h>
+#include <ipxe/tls.h>
+
+/** RSA-PSS with SHA-256 signature hash algorithm */
+struct tls_signature_hash_algorithm
+tls_rsa_pss_sha256 __tls_sig_hash_algorithm = {
+	.code = {
+		.signature = TLS_RSA_PSS_RSAE_SHA256_ALGORITHM,
+		.hash = TLS_INTRINSIC_ALGORITHM,
+	},
+	.pubkey = &rsa_pss_algorithm,
+	.digest = &sha256_algorithm,
+};
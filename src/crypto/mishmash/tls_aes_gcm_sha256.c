@@ -0,0 +1,46 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <byteswap.h>
+#include <ipxe/aes.h>
+#include <ipxe/gcm.h>
+#include <ipxe/sha256.h>
+#include <ipxe/tls.h>
+
+/** TLS_AES_128_GCM_SHA256 cipher suite
+ *
+ * TLSv1.3 cipher suites specify only the record protection and the
+ * key derivation digest, which is always SHA-256 for the cipher
+ * suites that we support.  The key exchange and signature algorithms
+ * are negotiated separately.
+ */
+struct tls_cipher_suite tls_aes_128_gcm_sha256 __tls_cipher_suite ( 01 ) = {
+	.code = htons ( TLS_AES_128_GCM_SHA256 ),
+	.key_len = ( 128 / 8 ),
+	.fixed_iv_len = GCM_IV_LEN,
+	.record_iv_len = 0,
+	.exchange = &tls13_exchange_algorithm,
+	.pubkey = &pubkey_null,
+	.cipher = &aes_gcm_algorithm,
+	.digest = &digest_null,
+};
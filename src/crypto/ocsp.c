@@ -282,7 +282,6 @@ int ocsp_check ( struct x509_certificate *cert,
 	/* Sanity checks */
 	assert ( cert != NULL );
 	assert ( issuer != NULL );
-	assert ( x509_is_valid ( issuer ) );
 
 	/* Allocate and initialise check */
 	*ocsp = zalloc ( sizeof ( **ocsp ) );
@@ -294,6 +293,10 @@ int ocsp_check ( struct x509_certificate *cert,
 	(*ocsp)->cert = x509_get ( cert );
 	(*ocsp)->issuer = x509_get ( issuer );
 
+	/* Decode certificate extensions (to locate OCSP responder) */
+	if ( ( rc = x509_decode_extensions ( cert ) ) != 0 )
+		goto err_decode;
+
 	/* Build request */
 	if ( ( rc = ocsp_request ( *ocsp ) ) != 0 )
 		goto err_request;
@@ -306,6 +309,7 @@ int ocsp_check ( struct x509_certificate *cert,
 
  err_uri_string:
  err_request:
+ err_decode:
 	ocsp_put ( *ocsp );
  err_alloc:
 	*ocsp = NULL;
@@ -880,6 +884,7 @@ int ocsp_validate ( struct ocsp_check *ocsp, time_t time ) {
 
 	/* Sanity checks */
 	assert ( response->data != NULL );
+	assert ( x509_is_valid ( ocsp->issuer ) );
 
 	/* The response may include a signer certificate; if this is
 	 * not present then the response must have been signed
@@ -940,8 +945,12 @@ int ocsp_validate ( struct ocsp_check *ocsp, time_t time ) {
 	DBGC2 ( ocsp, "OCSP %p \"%s\" response is valid (at time %lld)\n",
 		ocsp, x509_name ( ocsp->cert ), time );
 
-	/* Mark certificate as passing OCSP verification */
+	/* Mark certificate as passing OCSP verification until the
+	 * response becomes stale
+	 */
 	ocsp->cert->extensions.auth_info.ocsp.good = 1;
+	ocsp->cert->extensions.auth_info.ocsp.expiry =
+		( response->next_update + TIMESTAMP_ERROR_MARGIN );
 
 	/* Validate certificate against issuer */
 	if ( ( rc = x509_validate ( ocsp->cert, ocsp->issuer, time,
@@ -28,18 +28,77 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stdarg.h>
 #include <string.h>
 #include <errno.h>
+#include <byteswap.h>
 #include <ipxe/asn1.h>
 #include <ipxe/crypto.h>
 #include <ipxe/bigint.h>
 #include <ipxe/random_nz.h>
+#include <ipxe/rbg.h>
 #include <ipxe/rsa.h>
 
 /** @file
  *
  * RSA public-key cryptography
  *
- * RSA is documented in RFC 3447.
+ * RSA is documented in RFC 3447.  The RSA-PSS signature scheme is
+ * documented in RFC 8017.
+ *
+ * Private key operations use the Chinese Remainder Theorem (CRT) when
+ * the private key includes the CRT components.  This replaces one
+ * full-size modular exponentiation with two half-size modular
+ * exponentiations, which is approximately three to four times faster.
+ * Each CRT result is verified using the public exponent before use,
+ * since a faulty CRT result could otherwise reveal the prime factors.
+ */
+
+/** RSA private key Chinese Remainder Theorem components */
+struct rsa_crt_params {
+	/** Public exponent */
+	struct asn1_cursor public_exponent;
+	/** First prime factor (p) */
+	struct asn1_cursor p;
+	/** Second prime factor (q) */
+	struct asn1_cursor q;
+	/** First factor's CRT exponent (dP) */
+	struct asn1_cursor dp;
+	/** Second factor's CRT exponent (dQ) */
+	struct asn1_cursor dq;
+	/** CRT coefficient (qInv) */
+	struct asn1_cursor qinv;
+};
+
+/**
+ * RSA Chinese Remainder Theorem dynamic storage
+ *
+ * @v size		Modulus size
+ * @v crt_size		Size of CRT components
+ * @v public_exponent_size Size of public exponent
+ * @v tmp_len		Length of temporary working space
+ *
+ * Every member is an array of big integer elements (or of bytes at
+ * the end), and so the structure is naturally aligned without
+ * packing.  It is deliberately not packed, so that the addresses of
+ * its members may be passed to the big integer functions.
  */
+#define RSA_CRT_STORAGE( size, crt_size, public_exponent_size, tmp_len ) \
+	struct {							\
+		bigint_t ( crt_size ) p;				\
+		bigint_t ( crt_size ) q;				\
+		bigint_t ( crt_size ) dp;				\
+		bigint_t ( crt_size ) dq;				\
+		bigint_t ( crt_size ) qinv;				\
+		bigint_t ( public_exponent_size ) public_exponent;	\
+		bigint_t ( crt_size ) reduced;				\
+		bigint_t ( crt_size ) m1;				\
+		bigint_t ( crt_size ) m2;				\
+		bigint_t ( 2 * (crt_size) ) one;			\
+		bigint_t ( 2 * (crt_size) ) modulus;			\
+		bigint_t ( 2 * (crt_size) ) value;			\
+		bigint_t ( 2 * (crt_size) ) factor;			\
+		bigint_t ( 2 * (crt_size) ) result;			\
+		bigint_t ( size ) check;				\
+		uint8_t tmp[tmp_len];					\
+	}
 
 /* Disambiguate the various error causes */
 #define EACCES_VERIFY \
@@ -82,6 +141,8 @@ rsa_find_prefix ( struct digest_algorithm *digest ) {
  */
 static void rsa_free ( struct rsa_context *context ) {
 
+	free ( context->crt );
+	context->crt = NULL;
 	free ( context->dynamic );
 	context->dynamic = NULL;
 }
@@ -131,6 +192,54 @@ static int rsa_alloc ( struct rsa_context *context, size_t modulus_len,
 	return 0;
 }
 
+/**
+ * Allocate RSA Chinese Remainder Theorem storage
+ *
+ * @v context		RSA context
+ * @v crt_len		Maximum length of CRT components
+ * @v public_exponent_len Public exponent length
+ * @ret rc		Return status code
+ *
+ * The standard dynamic storage must already have been allocated.
+ */
+static int rsa_alloc_crt ( struct rsa_context *context, size_t crt_len,
+			   size_t public_exponent_len ) {
+	unsigned int size = context->size;
+	unsigned int crt_size = bigint_required_size ( crt_len );
+	unsigned int full_size = ( 2 * crt_size );
+	unsigned int public_exponent_size =
+		bigint_required_size ( public_exponent_len );
+	bigint_t ( crt_size ) *crt_modulus;
+	bigint_t ( crt_size ) *crt_exponent;
+	bigint_t ( full_size ) *full_modulus;
+	size_t exp_tmp_len = bigint_mod_exp_tmp_len ( crt_modulus,
+						      crt_exponent );
+	size_t mul_tmp_len = bigint_mod_multiply_tmp_len ( full_modulus );
+	size_t tmp_len = ( ( exp_tmp_len > mul_tmp_len ) ?
+			   exp_tmp_len : mul_tmp_len );
+	RSA_CRT_STORAGE ( size, crt_size, public_exponent_size,
+			  tmp_len ) *crt;
+	static const uint8_t one = 1;
+
+	/* Products of CRT components must be able to hold the modulus */
+	if ( full_size < size )
+		return -ERANGE;
+
+	/* Allocate storage */
+	crt = malloc ( sizeof ( *crt ) );
+	if ( ! crt )
+		return -ENOMEM;
+
+	/* Assign storage */
+	context->crt = crt;
+	context->crt_size = crt_size;
+	context->public_exponent_size = public_exponent_size;
+	context->crt_tmp_len = tmp_len;
+	bigint_init ( &crt->one, &one, sizeof ( one ) );
+
+	return 0;
+}
+
 /**
  * Parse RSA integer
  *
@@ -222,6 +331,114 @@ static int rsa_parse_mod_exp ( struct asn1_cursor *modulus,
 	return 0;
 }
 
+/**
+ * Parse RSA private key Chinese Remainder Theorem components
+ *
+ * @v crt		CRT components to fill in
+ * @v raw		ASN.1 cursor
+ * @ret rc		Return status code
+ */
+static int rsa_parse_crt ( struct rsa_crt_params *crt,
+			   const struct asn1_cursor *raw ) {
+	struct asn1_cursor cursor;
+	int version;
+	int rc;
+
+	/* Enter RSAPrivateKey */
+	memcpy ( &cursor, raw, sizeof ( cursor ) );
+	asn1_enter ( &cursor, ASN1_SEQUENCE );
+
+	/* Check version (two-prime keys only) */
+	if ( asn1_type ( &cursor ) != ASN1_INTEGER )
+		return -ENOTSUP;
+	if ( ( rc = asn1_integer ( &cursor, &version ) ) != 0 )
+		return rc;
+	if ( version != 0 )
+		return -ENOTSUP;
+	asn1_skip_any ( &cursor );
+
+	/* Skip modulus */
+	asn1_skip ( &cursor, ASN1_INTEGER );
+
+	/* Extract public exponent */
+	if ( ( rc = rsa_parse_integer ( &crt->public_exponent,
+					&cursor ) ) != 0 )
+		return rc;
+	asn1_skip_any ( &cursor );
+
+	/* Skip private exponent */
+	asn1_skip ( &cursor, ASN1_INTEGER );
+
+	/* Extract prime factors, exponents, and coefficient */
+	if ( ( rc = rsa_parse_integer ( &crt->p, &cursor ) ) != 0 )
+		return rc;
+	asn1_skip_any ( &cursor );
+	if ( ( rc = rsa_parse_integer ( &crt->q, &cursor ) ) != 0 )
+		return rc;
+	asn1_skip_any ( &cursor );
+	if ( ( rc = rsa_parse_integer ( &crt->dp, &cursor ) ) != 0 )
+		return rc;
+	asn1_skip_any ( &cursor );
+	if ( ( rc = rsa_parse_integer ( &crt->dq, &cursor ) ) != 0 )
+		return rc;
+	asn1_skip_any ( &cursor );
+	if ( ( rc = rsa_parse_integer ( &crt->qinv, &cursor ) ) != 0 )
+		return rc;
+
+	return 0;
+}
+
+/**
+ * Initialise RSA Chinese Remainder Theorem components
+ *
+ * @v context		RSA context
+ * @v raw		ASN.1 cursor
+ * @ret rc		Return status code
+ */
+static int rsa_init_crt ( struct rsa_context *context,
+			  const struct asn1_cursor *raw ) {
+	struct rsa_crt_params params;
+	size_t crt_len;
+	int rc;
+
+	/* Parse CRT components */
+	if ( ( rc = rsa_parse_crt ( &params, raw ) ) != 0 )
+		return rc;
+
+	/* Allocate storage large enough for all CRT components */
+	crt_len = params.p.len;
+	if ( crt_len < params.q.len )
+		crt_len = params.q.len;
+	if ( crt_len < params.dp.len )
+		crt_len = params.dp.len;
+	if ( crt_len < params.dq.len )
+		crt_len = params.dq.len;
+	if ( crt_len < params.qinv.len )
+		crt_len = params.qinv.len;
+	if ( ( rc = rsa_alloc_crt ( context, crt_len,
+				    params.public_exponent.len ) ) != 0 )
+		return rc;
+
+	/* Construct big integers */
+	{
+		RSA_CRT_STORAGE ( context->size, context->crt_size,
+				  context->public_exponent_size,
+				  context->crt_tmp_len ) *crt = context->crt;
+
+		bigint_init ( &crt->p, params.p.data, params.p.len );
+		bigint_init ( &crt->q, params.q.data, params.q.len );
+		bigint_init ( &crt->dp, params.dp.data, params.dp.len );
+		bigint_init ( &crt->dq, params.dq.data, params.dq.len );
+		bigint_init ( &crt->qinv, params.qinv.data,
+			      params.qinv.len );
+		bigint_init ( &crt->public_exponent,
+			      params.public_exponent.data,
+			      params.public_exponent.len );
+	}
+
+	return 0;
+}
+
 /**
  * Initialise RSA cipher
  *
@@ -266,6 +483,11 @@ static int rsa_init ( void *ctx, const void *key, size_t key_len ) {
 	bigint_init ( ( ( bigint_t ( context->exponent_size ) * )
 			context->exponent0 ), exponent.data, exponent.len );
 
+	/* Use Chinese Remainder Theorem for private keys, if possible */
+	if ( ( rc = rsa_init_crt ( context, &cursor ) ) == 0 ) {
+		DBGC ( context, "RSA %p using CRT\n", context );
+	}
+
 	return 0;
 
 	rsa_free ( context );
@@ -286,6 +508,71 @@ static size_t rsa_max_len ( void *ctx ) {
 	return context->max_len;
 }
 
+/**
+ * Perform RSA private key operation using Chinese Remainder Theorem
+ *
+ * @v context		RSA context
+ * @ret rc		Return status code
+ *
+ * The input must already be present in the input buffer.
+ */
+static int rsa_cipher_crt ( struct rsa_context *context ) {
+	bigint_t ( context->size ) *input = ( ( void * ) context->input0 );
+	bigint_t ( context->size ) *output = ( ( void * ) context->output0 );
+	bigint_t ( context->size ) *modulus = ( ( void * ) context->modulus0 );
+	RSA_CRT_STORAGE ( context->size, context->crt_size,
+			  context->public_exponent_size,
+			  context->crt_tmp_len ) *crt = context->crt;
+
+	/* Calculate m1 = ( c mod p ) ^ dP mod p */
+	bigint_grow ( input, &crt->value );
+	bigint_grow ( &crt->p, &crt->modulus );
+	bigint_mod_multiply ( &crt->value, &crt->one, &crt->modulus,
+			      &crt->result, crt->tmp );
+	bigint_shrink ( &crt->result, &crt->reduced );
+	bigint_mod_exp ( &crt->reduced, &crt->p, &crt->dp, &crt->m1,
+			 crt->tmp );
+
+	/* Calculate m2 = ( c mod q ) ^ dQ mod q */
+	bigint_grow ( &crt->q, &crt->modulus );
+	bigint_mod_multiply ( &crt->value, &crt->one, &crt->modulus,
+			      &crt->result, crt->tmp );
+	bigint_shrink ( &crt->result, &crt->reduced );
+	bigint_mod_exp ( &crt->reduced, &crt->q, &crt->dq, &crt->m2,
+			 crt->tmp );
+
+	/* Calculate h = qInv * ( m1 - m2 ) mod p */
+	bigint_grow ( &crt->p, &crt->modulus );
+	bigint_grow ( &crt->m2, &crt->value );
+	bigint_mod_multiply ( &crt->value, &crt->one, &crt->modulus,
+			      &crt->factor, crt->tmp );
+	bigint_grow ( &crt->m1, &crt->value );
+	if ( ! bigint_is_geq ( &crt->value, &crt->factor ) )
+		bigint_add ( &crt->modulus, &crt->value );
+	bigint_subtract ( &crt->factor, &crt->value );
+	bigint_grow ( &crt->qinv, &crt->factor );
+	bigint_mod_multiply ( &crt->value, &crt->factor, &crt->modulus,
+			      &crt->result, crt->tmp );
+	bigint_shrink ( &crt->result, &crt->reduced );
+
+	/* Calculate m = m2 + h * q */
+	bigint_multiply ( &crt->reduced, &crt->q, &crt->result );
+	bigint_grow ( &crt->m2, &crt->value );
+	bigint_add ( &crt->value, &crt->result );
+	bigint_shrink ( &crt->result, output );
+
+	/* Verify result using public exponent */
+	bigint_mod_exp ( output, modulus, &crt->public_exponent, &crt->check,
+			 context->tmp );
+	if ( memcmp ( &crt->check, input, sizeof ( crt->check ) ) != 0 ) {
+		DBGC ( context, "RSA %p CRT result verification failed\n",
+		       context );
+		return -EIO;
+	}
+
+	return 0;
+}
+
 /**
  * Perform RSA cipher operation
  *
@@ -304,8 +591,12 @@ static void rsa_cipher ( struct rsa_context *context,
 	/* Initialise big integer */
 	bigint_init ( input, in, context->max_len );
 
-	/* Perform modular exponentiation */
-	bigint_mod_exp ( input, modulus, exponent, output, context->tmp );
+	/* Perform modular exponentiation, using Chinese Remainder
+	 * Theorem if possible.
+	 */
+	if ( ( ! context->crt ) || ( rsa_cipher_crt ( context ) != 0 ) )
+		bigint_mod_exp ( input, modulus, exponent, output,
+				 context->tmp );
 
 	/* Copy out result */
 	bigint_done ( output, out, context->max_len );
@@ -571,6 +862,234 @@ static int rsa_verify ( void *ctx, struct digest_algorithm *digest,
 	return 0;
 }
 
+/**
+ * Calculate RSA modulus length in bits
+ *
+ * @v context		RSA context
+ * @ret bits		Modulus length in bits
+ */
+static unsigned int rsa_modulus_bits ( struct rsa_context *context ) {
+	bigint_t ( context->size ) *modulus = ( ( void * ) context->modulus0 );
+
+	return bigint_max_set_bit ( modulus );
+}
+
+/**
+ * Apply RSA-PSS mask
+ *
+ * @v digest		Digest algorithm
+ * @v seed		Mask seed (of length equal to the digest size)
+ * @v data		Data to be masked
+ * @v len		Length of data
+ *
+ * The mask is generated using MGF1 with the same digest algorithm as
+ * is used for the message digest.
+ */
+static void rsa_pss_mask ( struct digest_algorithm *digest, const void *seed,
+			   void *data, size_t len ) {
+	uint8_t ctx[digest->ctxsize];
+	uint8_t mask[digest->digestsize];
+	uint8_t *bytes = data;
+	uint32_t counter;
+	uint32_t counter_be;
+	size_t frag_len;
+	size_t i;
+
+	for ( counter = 0 ; len ; counter++ ) {
+
+		/* Generate next portion of mask */
+		counter_be = htonl ( counter );
+		digest_init ( digest, ctx );
+		digest_update ( digest, ctx, seed, sizeof ( mask ) );
+		digest_update ( digest, ctx, &counter_be,
+				sizeof ( counter_be ) );
+		digest_final ( digest, ctx, mask );
+
+		/* Apply mask */
+		frag_len = len;
+		if ( frag_len > sizeof ( mask ) )
+			frag_len = sizeof ( mask );
+		for ( i = 0 ; i < frag_len ; i++ )
+			bytes[i] ^= mask[i];
+		bytes += frag_len;
+		len -= frag_len;
+	}
+}
+
+/**
+ * Calculate RSA-PSS hash
+ *
+ * @v digest		Digest algorithm
+ * @v value		Digest value
+ * @v salt		Salt
+ * @v salt_len		Length of salt
+ * @v hash		Hash to fill in
+ */
+static void rsa_pss_hash ( struct digest_algorithm *digest, const void *value,
+			   const void *salt, size_t salt_len, void *hash ) {
+	static const uint8_t padding[8] = { 0 };
+	uint8_t ctx[digest->ctxsize];
+
+	digest_init ( digest, ctx );
+	digest_update ( digest, ctx, padding, sizeof ( padding ) );
+	digest_update ( digest, ctx, value, digest->digestsize );
+	digest_update ( digest, ctx, salt, salt_len );
+	digest_final ( digest, ctx, hash );
+}
+
+/**
+ * Sign digest value using RSA-PSS
+ *
+ * @v ctx		RSA context
+ * @v digest		Digest algorithm
+ * @v value		Digest value
+ * @v signature		Signature
+ * @ret signature_len	Signature length, or negative error
+ *
+ * The salt length is equal to the digest size, as required by TLS.
+ */
+static int rsa_pss_sign ( void *ctx, struct digest_algorithm *digest,
+			  const void *value, void *signature ) {
+	struct rsa_context *context = ctx;
+	size_t digest_len = digest->digestsize;
+	size_t salt_len = digest_len;
+	unsigned int em_bits = ( rsa_modulus_bits ( context ) - 1 );
+	size_t em_len = ( ( em_bits + 7 ) / 8 );
+	size_t db_len = ( em_len - digest_len - 1 );
+	uint8_t *encoded;
+	uint8_t *em;
+	uint8_t *db;
+	uint8_t *salt;
+	uint8_t *hash;
+	int rc;
+
+	/* Sanity check */
+	if ( em_len < ( digest_len + salt_len + 2 ) ) {
+		DBGC ( context, "RSA %p modulus too short for %s PSS\n",
+		       context, digest->name );
+		return -ERANGE;
+	}
+	DBGC ( context, "RSA %p PSS signing %s digest:\n",
+	       context, digest->name );
+	DBGC_HDA ( context, 0, value, digest_len );
+
+	/* Construct encoded message (using the big integer output
+	 * buffer as temporary storage)
+	 */
+	encoded = ( ( void * ) context->output0 );
+	memset ( encoded, 0, context->max_len );
+	em = ( encoded + context->max_len - em_len );
+	db = em;
+	hash = ( db + db_len );
+	salt = ( hash - salt_len );
+	if ( ( rc = rbg_generate ( NULL, 0, 0, salt, salt_len ) ) != 0 ) {
+		DBGC ( context, "RSA %p could not generate salt: %s\n",
+		       context, strerror ( rc ) );
+		return rc;
+	}
+	rsa_pss_hash ( digest, value, salt, salt_len, hash );
+	*( salt - 1 ) = 0x01;
+	rsa_pss_mask ( digest, hash, db, db_len );
+	db[0] &= ( 0xff >> ( ( 8 * em_len ) - em_bits ) );
+	em[ em_len - 1 ] = 0xbc;
+	DBGC ( context, "RSA %p PSS encoded %s digest:\n",
+	       context, digest->name );
+	DBGC_HDA ( context, 0, encoded, context->max_len );
+
+	/* Encipher the encoded digest */
+	rsa_cipher ( context, encoded, signature );
+	DBGC ( context, "RSA %p PSS signed %s digest:\n",
+	       context, digest->name );
+	DBGC_HDA ( context, 0, signature, context->max_len );
+
+	return context->max_len;
+}
+
+/**
+ * Verify signed digest value using RSA-PSS
+ *
+ * @v ctx		RSA context
+ * @v digest		Digest algorithm
+ * @v value		Digest value
+ * @v signature		Signature
+ * @v signature_len	Signature length
+ * @ret rc		Return status code
+ *
+ * Any salt length is accepted.
+ */
+static int rsa_pss_verify ( void *ctx, struct digest_algorithm *digest,
+			    const void *value, const void *signature,
+			    size_t signature_len ) {
+	struct rsa_context *context = ctx;
+	size_t digest_len = digest->digestsize;
+	unsigned int em_bits = ( rsa_modulus_bits ( context ) - 1 );
+	size_t em_len = ( ( em_bits + 7 ) / 8 );
+	uint8_t db_top = ( 0xff >> ( ( 8 * em_len ) - em_bits ) );
+	uint8_t expected[digest_len];
+	uint8_t *encoded;
+	uint8_t *em;
+	uint8_t *db;
+	uint8_t *salt;
+	uint8_t *hash;
+
+	/* Sanity check */
+	if ( signature_len != context->max_len ) {
+		DBGC ( context, "RSA %p signature incorrect length (%zd "
+		       "bytes, should be %zd)\n",
+		       context, signature_len, context->max_len );
+		return -ERANGE;
+	}
+	if ( em_len < ( digest_len + 2 ) ) {
+		DBGC ( context, "RSA %p modulus too short for %s PSS\n",
+		       context, digest->name );
+		return -ERANGE;
+	}
+	DBGC ( context, "RSA %p PSS verifying %s digest:\n",
+	       context, digest->name );
+	DBGC_HDA ( context, 0, value, digest_len );
+	DBGC_HDA ( context, 0, signature, signature_len );
+
+	/* Decipher the signature (using the big integer input buffer
+	 * as temporary storage)
+	 */
+	encoded = ( ( void * ) context->input0 );
+	rsa_cipher ( context, signature, encoded );
+	DBGC ( context, "RSA %p deciphered signature:\n", context );
+	DBGC_HDA ( context, 0, encoded, context->max_len );
+
+	/* Parse encoded message */
+	em = ( encoded + context->max_len - em_len );
+	db = em;
+	hash = ( em + em_len - digest_len - 1 );
+	if ( ( em != encoded ) && ( encoded[0] != 0x00 ) )
+		goto invalid;
+	if ( em[ em_len - 1 ] != 0xbc )
+		goto invalid;
+	if ( db[0] & ~db_top )
+		goto invalid;
+
+	/* Unmask data block and locate salt */
+	rsa_pss_mask ( digest, hash, db, ( hash - db ) );
+	db[0] &= db_top;
+	for ( salt = db ; ( ( salt < hash ) && ( *salt == 0x00 ) ) ; salt++ ) {}
+	if ( ( salt == hash ) || ( *(salt++) != 0x01 ) )
+		goto invalid;
+
+	/* Verify the signature */
+	rsa_pss_hash ( digest, value, salt, ( hash - salt ), expected );
+	if ( memcmp ( hash, expected, sizeof ( expected ) ) != 0 )
+		goto invalid;
+
+	DBGC ( context, "RSA %p PSS signature verified successfully\n",
+	       context );
+	return 0;
+
+ invalid:
+	DBGC ( context, "RSA %p PSS signature verification failed\n",
+	       context );
+	return -EACCES_VERIFY;
+}
+
 /**
  * Finalise RSA cipher
  *
@@ -635,3 +1154,22 @@ struct pubkey_algorithm rsa_algorithm = {
 	.final		= rsa_final,
 	.match		= rsa_match,
 };
+
+/** RSA-PSS public-key algorithm
+ *
+ * This uses the same keys as the RSA public-key algorithm, and
+ * differs only in the signature encoding.  Encryption uses the same
+ * PKCS #1 v1.5 encoding as the RSA public-key algorithm.
+ */
+struct pubkey_algorithm rsa_pss_algorithm = {
+	.name		= "rsa-pss",
+	.ctxsize	= sizeof ( struct rsa_context ),
+	.init		= rsa_init,
+	.max_len	= rsa_max_len,
+	.encrypt	= rsa_encrypt,
+	.decrypt	= rsa_decrypt,
+	.sign		= rsa_pss_sign,
+	.verify		= rsa_pss_verify,
+	.final		= rsa_final,
+	.match		= rsa_match,
+};
@@ -36,6 +36,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/rotate.h>
 #include <ipxe/crypto.h>
 #include <ipxe/asn1.h>
+#include <ipxe/accelerator.h>
 #include <ipxe/sha1.h>
 
 /** SHA-1 variables */
@@ -122,6 +123,15 @@ static void sha1_init ( void *ctx ) {
 	context->len = 0;
 }
 
+/**
+ * Identify SHA-1 accelerator
+ *
+ * @ret accel		Accelerated implementation, or NULL
+ */
+static struct sha1_accelerator * sha1_accelerator ( void ) {
+	return accelerator_select ( SHA1_ACCELERATORS );
+}
+
 /**
  * Calculate SHA-1 digest of accumulated data
  *
@@ -132,6 +142,9 @@ static void sha1_digest ( struct sha1_context *context ) {
 		union sha1_digest_data_dwords ddd;
 		struct sha1_variables v;
 	} u;
+	struct sha1_accelerator *accel;
+	struct sha1_digest digest;
+	union sha1_block data;
 	uint32_t *a = &u.v.a;
 	uint32_t *b = &u.v.b;
 	uint32_t *c = &u.v.c;
@@ -153,6 +166,18 @@ static void sha1_digest ( struct sha1_context *context ) {
 	linker_assert ( &u.ddd.dd.digest.h[4] == e, sha1_bad_layout );
 	linker_assert ( &u.ddd.dd.data.dword[0] == w, sha1_bad_layout );
 
+	/* Use accelerated implementation, if available.  The context
+	 * is packed, so copy through aligned local variables.
+	 */
+	accel = sha1_accelerator();
+	if ( accel ) {
+		memcpy ( &digest, &context->ddd.dd.digest, sizeof ( digest ) );
+		memcpy ( &data, &context->ddd.dd.data, sizeof ( data ) );
+		accel->digest ( &digest, &data );
+		memcpy ( &context->ddd.dd.digest, &digest, sizeof ( digest ) );
+		return;
+	}
+
 	DBGC ( context, "SHA1 digesting:\n" );
 	DBGC_HDA ( context, 0, &context->ddd.dd.digest,
 		   sizeof ( context->ddd.dd.digest ) );
@@ -210,14 +235,20 @@ static void sha1_update ( void *ctx, const void *data, size_t len ) {
 	struct sha1_context *context = ctx;
 	const uint8_t *byte = data;
 	size_t offset;
+	size_t frag_len;
 
-	/* Accumulate data a byte at a time, performing the digest
-	 * whenever we fill the data buffer
+	/* Accumulate data as many bytes at a time as possible,
+	 * performing the digest whenever we fill the data buffer
 	 */
-	while ( len-- ) {
+	while ( len ) {
 		offset = ( context->len % sizeof ( context->ddd.dd.data ) );
-		context->ddd.dd.data.byte[offset] = *(byte++);
-		context->len++;
+		frag_len = ( sizeof ( context->ddd.dd.data ) - offset );
+		if ( frag_len > len )
+			frag_len = len;
+		memcpy ( &context->ddd.dd.data.byte[offset], byte, frag_len );
+		byte += frag_len;
+		len -= frag_len;
+		context->len += frag_len;
 		if ( ( context->len % sizeof ( context->ddd.dd.data ) ) == 0 )
 			sha1_digest ( context );
 	}
@@ -274,3 +305,7 @@ struct asn1_algorithm oid_sha1_algorithm __asn1_algorithm = {
 	.digest = &sha1_algorithm,
 	.oid = ASN1_OID_CURSOR ( oid_sha1 ),
 };
+
+/* Drag in SHA-1 accelerators */
+REQUIRING_SYMBOL ( sha1_algorithm );
+REQUIRE_OBJECT ( config_sha1 );
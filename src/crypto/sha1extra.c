@@ -81,10 +81,53 @@ void prf_sha1 ( const void *key, size_t key_len, const char *label,
 }
 
 /**
- * PBKDF2 key derivation function inner block operation
+ * Precompute PBKDF2 HMAC pad states
  *
  * @v passphrase	Passphrase from which to derive key
  * @v pass_len		Length of passphrase
+ * @v ipad		SHA1 context to fill in with inner pad state
+ * @v opad		SHA1 context to fill in with outer pad state
+ *
+ * Every PBKDF2 iteration uses the same HMAC key, so the SHA1 states
+ * after absorbing the inner and outer pads can be calculated once
+ * and then copied, rather than rekeying HMAC on every iteration.
+ */
+static void pbkdf2_sha1_pads ( const void *passphrase, size_t pass_len,
+			       struct sha1_context *ipad,
+			       struct sha1_context *opad )
+{
+	u8 key[sizeof ( union sha1_block )];
+	u8 pad[sizeof ( union sha1_block )];
+	unsigned int i;
+
+	/* Reduce key if necessary, as per RFC 2104 */
+	memset ( key, 0, sizeof ( key ) );
+	if ( pass_len > sizeof ( key ) ) {
+		digest_init ( &sha1_algorithm, ipad );
+		digest_update ( &sha1_algorithm, ipad, passphrase, pass_len );
+		digest_final ( &sha1_algorithm, ipad, key );
+	} else {
+		memcpy ( key, passphrase, pass_len );
+	}
+
+	/* Absorb inner pad */
+	for ( i = 0 ; i < sizeof ( pad ) ; i++ )
+		pad[i] = ( key[i] ^ 0x36 );
+	digest_init ( &sha1_algorithm, ipad );
+	digest_update ( &sha1_algorithm, ipad, pad, sizeof ( pad ) );
+
+	/* Absorb outer pad */
+	for ( i = 0 ; i < sizeof ( pad ) ; i++ )
+		pad[i] = ( key[i] ^ 0x5c );
+	digest_init ( &sha1_algorithm, opad );
+	digest_update ( &sha1_algorithm, opad, pad, sizeof ( pad ) );
+}
+
+/**
+ * PBKDF2 key derivation function inner block operation
+ *
+ * @v ipad		SHA1 context with inner pad state
+ * @v opad		SHA1 context with outer pad state
  * @v salt		Salt to include in key
  * @v salt_len		Length of salt
  * @v iterations	Number of iterations of SHA1 to perform
@@ -93,14 +136,14 @@ void prf_sha1 ( const void *key, size_t key_len, const char *label,
  *
  * The operation of this function is described in RFC 2898.
  */
-static void pbkdf2_sha1_f ( const void *passphrase, size_t pass_len,
+static void pbkdf2_sha1_f ( const struct sha1_context *ipad,
+			    const struct sha1_context *opad,
 			    const void *salt, size_t salt_len,
 			    int iterations, u32 blocknr, u8 *block )
 {
-	u8 pass[pass_len];	/* modifiable passphrase */
 	u8 in[salt_len + 4];	/* input buffer to first round */
 	u8 last[SHA1_DIGEST_SIZE]; /* output of round N, input of N+1 */
-	u8 sha1_ctx[SHA1_CTX_SIZE];
+	struct sha1_context ctx;
 	u8 *next_in = in;	/* changed to `last' after first round */
 	int next_size = sizeof ( in );
 	int i;
@@ -108,15 +151,17 @@ static void pbkdf2_sha1_f ( const void *passphrase, size_t pass_len,
 
 	blocknr = htonl ( blocknr );
 
-	memcpy ( pass, passphrase, pass_len );
 	memcpy ( in, salt, salt_len );
 	memcpy ( in + salt_len, &blocknr, 4 );
 	memset ( block, 0, sizeof ( last ) );
 
 	for ( i = 0; i < iterations; i++ ) {
-		hmac_init ( &sha1_algorithm, sha1_ctx, pass, &pass_len );
-		hmac_update ( &sha1_algorithm, sha1_ctx, next_in, next_size );
-		hmac_final ( &sha1_algorithm, sha1_ctx, pass, &pass_len, last );
+		memcpy ( &ctx, ipad, sizeof ( ctx ) );
+		digest_update ( &sha1_algorithm, &ctx, next_in, next_size );
+		digest_final ( &sha1_algorithm, &ctx, last );
+		memcpy ( &ctx, opad, sizeof ( ctx ) );
+		digest_update ( &sha1_algorithm, &ctx, last, sizeof ( last ) );
+		digest_final ( &sha1_algorithm, &ctx, last );
 
 		for ( j = 0; j < sizeof ( last ); j++ ) {
 			block[j] ^= last[j];
@@ -144,6 +189,8 @@ static void pbkdf2_sha1_f ( const void *passphrase, size_t pass_len,
  * EAPOL authentication.
  *
  * The operation of this function is further described in RFC 2898.
+ * SHA1 itself will use an accelerated implementation (e.g. SHA-NI)
+ * where available.
  */
 void pbkdf2_sha1 ( const void *passphrase, size_t pass_len,
 		   const void *salt, size_t salt_len,
@@ -152,9 +199,13 @@ void pbkdf2_sha1 ( const void *passphrase, size_t pass_len,
 	u32 blocks = ( key_len + SHA1_DIGEST_SIZE - 1 ) / SHA1_DIGEST_SIZE;
 	u32 blk;
 	u8 buf[SHA1_DIGEST_SIZE];
+	struct sha1_context ipad;
+	struct sha1_context opad;
+
+	pbkdf2_sha1_pads ( passphrase, pass_len, &ipad, &opad );
 
 	for ( blk = 1; blk <= blocks; blk++ ) {
-		pbkdf2_sha1_f ( passphrase, pass_len, salt, salt_len,
+		pbkdf2_sha1_f ( &ipad, &opad, salt, salt_len,
 				iterations, blk, buf );
 		if ( key_len <= sizeof ( buf ) ) {
 			memcpy ( key, buf, key_len );
@@ -36,6 +36,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/rotate.h>
 #include <ipxe/crypto.h>
 #include <ipxe/asn1.h>
+#include <ipxe/accelerator.h>
 #include <ipxe/sha256.h>
 
 /** SHA-256 variables */
@@ -55,7 +56,7 @@ struct sha256_variables {
 } __attribute__ (( packed ));
 
 /** SHA-256 constants */
-static const uint32_t k[SHA256_ROUNDS] = {
+const uint32_t sha256_k[SHA256_ROUNDS] = {
 	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
 	0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
 	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
@@ -112,6 +113,15 @@ static void sha256_init ( void *ctx ) {
 			     sizeof ( struct sha256_digest ) );
 }
 
+/**
+ * Identify SHA-256 accelerator
+ *
+ * @ret accel		Accelerated implementation, or NULL
+ */
+static struct sha256_accelerator * sha256_accelerator ( void ) {
+	return accelerator_select ( SHA256_ACCELERATORS );
+}
+
 /**
  * Calculate SHA-256 digest of accumulated data
  *
@@ -122,6 +132,9 @@ static void sha256_digest ( struct sha256_context *context ) {
 		union sha256_digest_data_dwords ddd;
 		struct sha256_variables v;
 	} u;
+	struct sha256_accelerator *accel;
+	struct sha256_digest digest;
+	union sha256_block data;
 	uint32_t *a = &u.v.a;
 	uint32_t *b = &u.v.b;
 	uint32_t *c = &u.v.c;
@@ -151,6 +164,18 @@ static void sha256_digest ( struct sha256_context *context ) {
 	linker_assert ( &u.ddd.dd.digest.h[7] == h, sha256_bad_layout );
 	linker_assert ( &u.ddd.dd.data.dword[0] == w, sha256_bad_layout );
 
+	/* Use accelerated implementation, if available.  The context
+	 * is packed, so copy through aligned local variables.
+	 */
+	accel = sha256_accelerator();
+	if ( accel ) {
+		memcpy ( &digest, &context->ddd.dd.digest, sizeof ( digest ) );
+		memcpy ( &data, &context->ddd.dd.data, sizeof ( data ) );
+		accel->digest ( &digest, &data );
+		memcpy ( &context->ddd.dd.digest, &digest, sizeof ( digest ) );
+		return;
+	}
+
 	DBGC ( context, "SHA256 digesting:\n" );
 	DBGC_HDA ( context, 0, &context->ddd.dd.digest,
 		   sizeof ( context->ddd.dd.digest ) );
@@ -182,7 +207,7 @@ static void sha256_digest ( struct sha256_context *context ) {
 		t2 = ( s0 + maj );
 		s1 = ( ror32 ( *e, 6 ) ^ ror32 ( *e, 11 ) ^ ror32 ( *e, 25 ) );
 		ch = ( ( *e & *f ) ^ ( (~*e) & *g ) );
-		t1 = ( *h + s1 + ch + k[i] + w[i] );
+		t1 = ( *h + s1 + ch + sha256_k[i] + w[i] );
 		*h = *g;
 		*g = *f;
 		*f = *e;
@@ -218,14 +243,20 @@ void sha256_update ( void *ctx, const void *data, size_t len ) {
 	struct sha256_context *context = ctx;
 	const uint8_t *byte = data;
 	size_t offset;
+	size_t frag_len;
 
-	/* Accumulate data a byte at a time, performing the digest
-	 * whenever we fill the data buffer
+	/* Accumulate data as many bytes at a time as possible,
+	 * performing the digest whenever we fill the data buffer
 	 */
-	while ( len-- ) {
+	while ( len ) {
 		offset = ( context->len % sizeof ( context->ddd.dd.data ) );
-		context->ddd.dd.data.byte[offset] = *(byte++);
-		context->len++;
+		frag_len = ( sizeof ( context->ddd.dd.data ) - offset );
+		if ( frag_len > len )
+			frag_len = len;
+		memcpy ( &context->ddd.dd.data.byte[offset], byte, frag_len );
+		byte += frag_len;
+		len -= frag_len;
+		context->len += frag_len;
 		if ( ( context->len % sizeof ( context->ddd.dd.data ) ) == 0 )
 			sha256_digest ( context );
 	}
@@ -281,3 +312,7 @@ struct asn1_algorithm oid_sha256_algorithm __asn1_algorithm = {
 	.digest = &sha256_algorithm,
 	.oid = ASN1_OID_CURSOR ( oid_sha256 ),
 };
+
+/* Drag in SHA-256 accelerators */
+REQUIRING_SYMBOL ( sha256_algorithm );
+REQUIRE_OBJECT ( config_sha256 );
@@ -0,0 +1,385 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+/** @file
+ *
+ * X25519 key exchange
+ *
+ * This is the Diffie-Hellman function defined in RFC 7748 section 5,
+ * using the Montgomery ladder over Curve25519.
+ *
+ * Field elements are held as sixteen signed 64-bit limbs in radix
+ * 2^16, which leaves enough headroom that additions and subtractions
+ * never need to propagate carries, and that a full product can be
+ * accumulated without overflow.  Every operation (including the
+ * conditional swap within the ladder) executes the same sequence of
+ * instructions regardless of the values involved, so that the time
+ * taken does not reveal the private key.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <ipxe/x25519.h>
+
+/** Number of limbs in a field element */
+#define X25519_LIMBS 16
+
+/** A field element modulo 2^255-19 */
+struct x25519_element {
+	/** Limbs (in radix 2^16, least significant first) */
+	int64_t limb[X25519_LIMBS];
+};
+
+/** The constant (A-2)/4 = 121665 */
+static const struct x25519_element x25519_121665 = {
+	.limb = { 0xdb41, 0x0001 },
+};
+
+/** The generator (base point) u-coordinate */
+static const struct x25519_value x25519_generator = {
+	.raw = { 9 },
+};
+
+/**
+ * Propagate carries
+ *
+ * @v elem		Field element
+ *
+ * Each limb is reduced to the range [0,2^16), with the carry out of
+ * the most significant limb folded back in using 2^256 = 38
+ * (modulo 2^255-19).
+ */
+static void x25519_carry ( struct x25519_element *elem ) {
+	int64_t carry;
+	unsigned int i;
+
+	for ( i = 0 ; i < X25519_LIMBS ; i++ ) {
+		carry = ( elem->limb[i] >> 16 );
+		elem->limb[i] -= ( carry * 0x10000 );
+		if ( i < ( X25519_LIMBS - 1 ) ) {
+			elem->limb[ i + 1 ] += carry;
+		} else {
+			elem->limb[0] += ( carry * 38 );
+		}
+	}
+}
+
+/**
+ * Add field elements
+ *
+ * @v result		Result
+ * @v augend		Augend
+ * @v addend		Addend
+ */
+static void x25519_add ( struct x25519_element *result,
+			 const struct x25519_element *augend,
+			 const struct x25519_element *addend ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < X25519_LIMBS ; i++ )
+		result->limb[i] = ( augend->limb[i] + addend->limb[i] );
+}
+
+/**
+ * Subtract field elements
+ *
+ * @v result		Result
+ * @v minuend		Minuend
+ * @v subtrahend	Subtrahend
+ */
+static void x25519_subtract ( struct x25519_element *result,
+			      const struct x25519_element *minuend,
+			      const struct x25519_element *subtrahend ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < X25519_LIMBS ; i++ )
+		result->limb[i] = ( minuend->limb[i] - subtrahend->limb[i] );
+}
+
+/**
+ * Multiply field elements
+ *
+ * @v result		Result (may be either input)
+ * @v multiplicand	Multiplicand
+ * @v multiplier	Multiplier
+ */
+static void x25519_multiply ( struct x25519_element *result,
+			      const struct x25519_element *multiplicand,
+			      const struct x25519_element *multiplier ) {
+	int64_t product[ 2 * X25519_LIMBS - 1 ];
+	unsigned int i;
+	unsigned int j;
+
+	/* Calculate full product */
+	memset ( product, 0, sizeof ( product ) );
+	for ( i = 0 ; i < X25519_LIMBS ; i++ ) {
+		for ( j = 0 ; j < X25519_LIMBS ; j++ ) {
+			product[ i + j ] += ( multiplicand->limb[i] *
+					      multiplier->limb[j] );
+		}
+	}
+
+	/* Reduce using 2^256 = 38 (modulo 2^255-19) */
+	for ( i = 0 ; i < ( X25519_LIMBS - 1 ) ; i++ )
+		product[i] += ( 38 * product[ i + X25519_LIMBS ] );
+	for ( i = 0 ; i < X25519_LIMBS ; i++ )
+		result->limb[i] = product[i];
+
+	/* Propagate carries (twice, since the first pass may leave
+	 * a carry folded into the least significant limb).
+	 */
+	x25519_carry ( result );
+	x25519_carry ( result );
+}
+
+/**
+ * Square field element
+ *
+ * @v result		Result (may be input)
+ * @v elem		Field element
+ */
+static inline void x25519_square ( struct x25519_element *result,
+				   const struct x25519_element *elem ) {
+
+	x25519_multiply ( result, elem, elem );
+}
+
+/**
+ * Invert field element
+ *
+ * @v result		Result (may be input)
+ * @v elem		Field element
+ *
+ * The inverse is calculated as elem^(p-2) using Fermat's little
+ * theorem.  The exponent p-2 = 2^255-21 has every bit set except for
+ * bits 2 and 4.
+ */
+static void x25519_invert ( struct x25519_element *result,
+			    const struct x25519_element *elem ) {
+	struct x25519_element tmp;
+	int bit;
+
+	memcpy ( &tmp, elem, sizeof ( tmp ) );
+	for ( bit = 253 ; bit >= 0 ; bit-- ) {
+		x25519_square ( &tmp, &tmp );
+		if ( ( bit != 2 ) && ( bit != 4 ) )
+			x25519_multiply ( &tmp, &tmp, elem );
+	}
+	memcpy ( result, &tmp, sizeof ( *result ) );
+}
+
+/**
+ * Conditionally swap field elements in constant time
+ *
+ * @v elem1		First field element
+ * @v elem2		Second field element
+ * @v swap		Swap (0 or 1)
+ */
+static void x25519_swap ( struct x25519_element *elem1,
+			  struct x25519_element *elem2, int64_t swap ) {
+	int64_t mask = -swap;
+	int64_t diff;
+	unsigned int i;
+
+	for ( i = 0 ; i < X25519_LIMBS ; i++ ) {
+		diff = ( mask & ( elem1->limb[i] ^ elem2->limb[i] ) );
+		elem1->limb[i] ^= diff;
+		elem2->limb[i] ^= diff;
+	}
+}
+
+/**
+ * Decode field element
+ *
+ * @v elem		Field element to fill in
+ * @v value		Encoded value
+ *
+ * As required by RFC 7748, the most significant bit is ignored.
+ */
+static void x25519_decode ( struct x25519_element *elem,
+			    const struct x25519_value *value ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < X25519_LIMBS ; i++ ) {
+		elem->limb[i] = ( value->raw[ 2 * i ] |
+				  ( value->raw[ 2 * i + 1 ] << 8 ) );
+	}
+	elem->limb[ X25519_LIMBS - 1 ] &= 0x7fff;
+}
+
+/**
+ * Encode field element
+ *
+ * @v elem		Field element
+ * @v value		Encoded value to fill in
+ *
+ * The element is fully reduced modulo 2^255-19 before encoding.
+ */
+static void x25519_encode ( const struct x25519_element *elem,
+			    struct x25519_value *value ) {
+	struct x25519_element reduced;
+	struct x25519_element trial;
+	int64_t borrow;
+	unsigned int i;
+	unsigned int pass;
+
+	/* Propagate carries until all limbs are in [0,2^16) */
+	memcpy ( &reduced, elem, sizeof ( reduced ) );
+	x25519_carry ( &reduced );
+	x25519_carry ( &reduced );
+	x25519_carry ( &reduced );
+
+	/* Subtract the modulus (at most twice), keeping the result
+	 * only if it does not underflow.
+	 */
+	for ( pass = 0 ; pass < 2 ; pass++ ) {
+		trial.limb[0] = ( reduced.limb[0] - 0xffed );
+		for ( i = 1 ; i < ( X25519_LIMBS - 1 ) ; i++ ) {
+			trial.limb[i] = ( reduced.limb[i] - 0xffff -
+					  ( ( trial.limb[ i - 1 ] >> 16 ) & 1 ));
+			trial.limb[ i - 1 ] &= 0xffff;
+		}
+		trial.limb[ X25519_LIMBS - 1 ] =
+			( reduced.limb[ X25519_LIMBS - 1 ] - 0x7fff -
+			  ( ( trial.limb[ X25519_LIMBS - 2 ] >> 16 ) & 1 ) );
+		trial.limb[ X25519_LIMBS - 2 ] &= 0xffff;
+		borrow = ( ( trial.limb[ X25519_LIMBS - 1 ] >> 16 ) & 1 );
+		x25519_swap ( &reduced, &trial, ( 1 - borrow ) );
+	}
+
+	/* Encode as little-endian byte string */
+	for ( i = 0 ; i < X25519_LIMBS ; i++ ) {
+		value->raw[ 2 * i ] = ( reduced.limb[i] & 0xff );
+		value->raw[ 2 * i + 1 ] = ( reduced.limb[i] >> 8 );
+	}
+}
+
+/**
+ * Calculate X25519 key
+ *
+ * @v base		Base point u-coordinate
+ * @v scalar		Scalar multiple
+ * @v result		Result u-coordinate to fill in
+ * @ret rc		Return status code
+ *
+ * The scalar is clamped as described in RFC 7748 section 5.  An
+ * all-zero result (which arises only from a small-order base point)
+ * is rejected, as required by RFC 8422 section 5.11.
+ */
+int x25519_key ( const struct x25519_value *base,
+		 const struct x25519_value *scalar,
+		 struct x25519_value *result ) {
+	struct x25519_value clamped;
+	struct x25519_element x;
+	struct x25519_element a;
+	struct x25519_element b;
+	struct x25519_element c;
+	struct x25519_element d;
+	struct x25519_element e;
+	struct x25519_element f;
+	uint8_t check;
+	int64_t bit;
+	unsigned int i;
+	int pos;
+
+	/* Clamp scalar */
+	memcpy ( &clamped, scalar, sizeof ( clamped ) );
+	clamped.raw[0] &= 0xf8;
+	clamped.raw[ X25519_SIZE - 1 ] &= 0x7f;
+	clamped.raw[ X25519_SIZE - 1 ] |= 0x40;
+
+	/* Initialise ladder with (a:c) = (1:0) and (b:d) = (u:1) */
+	x25519_decode ( &x, base );
+	memcpy ( &b, &x, sizeof ( b ) );
+	memset ( &a, 0, sizeof ( a ) );
+	memset ( &c, 0, sizeof ( c ) );
+	memset ( &d, 0, sizeof ( d ) );
+	a.limb[0] = 1;
+	d.limb[0] = 1;
+
+	/* Perform Montgomery ladder */
+	for ( pos = 254 ; pos >= 0 ; pos-- ) {
+		bit = ( ( clamped.raw[ pos / 8 ] >> ( pos % 8 ) ) & 1 );
+		x25519_swap ( &a, &b, bit );
+		x25519_swap ( &c, &d, bit );
+		x25519_add ( &e, &a, &c );
+		x25519_subtract ( &a, &a, &c );
+		x25519_add ( &c, &b, &d );
+		x25519_subtract ( &b, &b, &d );
+		x25519_square ( &d, &e );
+		x25519_square ( &f, &a );
+		x25519_multiply ( &a, &c, &a );
+		x25519_multiply ( &c, &b, &e );
+		x25519_add ( &e, &a, &c );
+		x25519_subtract ( &a, &a, &c );
+		x25519_square ( &b, &a );
+		x25519_subtract ( &c, &d, &f );
+		x25519_multiply ( &a, &c, &x25519_121665 );
+		x25519_add ( &a, &a, &d );
+		x25519_multiply ( &c, &c, &a );
+		x25519_multiply ( &a, &d, &f );
+		x25519_multiply ( &d, &b, &x );
+		x25519_square ( &b, &e );
+		x25519_swap ( &a, &b, bit );
+		x25519_swap ( &c, &d, bit );
+	}
+
+	/* Convert result to affine u-coordinate a/c */
+	x25519_invert ( &c, &c );
+	x25519_multiply ( &a, &a, &c );
+	x25519_encode ( &a, result );
+
+	/* Reject an all-zero result */
+	check = 0;
+	for ( i = 0 ; i < X25519_SIZE ; i++ )
+		check |= result->raw[i];
+	if ( ! check )
+		return -EPERM;
+
+	return 0;
+}
+
+/**
+ * Multiply scalar by curve point
+ *
+ * @v base		Base point (or NULL to use generator)
+ * @v scalar		Scalar multiple
+ * @v result		Result point to fill in
+ * @ret rc		Return status code
+ */
+static int x25519_curve_multiply ( const void *base, const void *scalar,
+				   void *result ) {
+
+	/* Use base point if applicable */
+	if ( ! base )
+		base = &x25519_generator;
+
+	return x25519_key ( base, scalar, result );
+}
+
+/** X25519 elliptic curve */
+struct elliptic_curve x25519_curve = {
+	.name = "x25519",
+	.keysize = sizeof ( struct x25519_value ),
+	.multiply = x25519_curve_multiply,
+};
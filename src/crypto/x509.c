@@ -971,9 +971,9 @@ static int x509_parse_tbscertificate ( struct x509_certificate *cert,
 		return rc;
 	asn1_skip_any ( &cursor );
 
-	/* Parse extensions, if present */
-	if ( ( rc = x509_parse_extensions ( cert, &cursor ) ) != 0 )
-		return rc;
+	/* Record extensions, if present, for subsequent decoding */
+	memcpy ( &cert->extensions.raw, &cursor,
+		 sizeof ( cert->extensions.raw ) );
 
 	return 0;
 }
@@ -1040,6 +1040,39 @@ int x509_parse ( struct x509_certificate *cert,
 	return 0;
 }
 
+/**
+ * Decode X.509 certificate extensions
+ *
+ * @v cert		X.509 certificate
+ * @ret rc		Return status code
+ *
+ * Extensions are decoded on first use, and the decoded values are
+ * retained for as long as the certificate remains in the store.
+ */
+int x509_decode_extensions ( struct x509_certificate *cert ) {
+	struct x509_extensions *extensions = &cert->extensions;
+	struct asn1_cursor raw;
+	int rc;
+
+	/* Do nothing if extensions have already been decoded */
+	if ( cert->flags & X509_FL_DECODED )
+		return 0;
+
+	/* Decode extensions */
+	if ( ( rc = x509_parse_extensions ( cert, &extensions->raw ) ) != 0 ) {
+		DBGC ( cert, "X509 %p \"%s\" could not decode extensions: "
+		       "%s\n", cert, x509_name ( cert ), strerror ( rc ) );
+		/* Discard any partially decoded extensions */
+		memcpy ( &raw, &extensions->raw, sizeof ( raw ) );
+		memset ( extensions, 0, sizeof ( *extensions ) );
+		memcpy ( &extensions->raw, &raw, sizeof ( extensions->raw ) );
+		return rc;
+	}
+	cert->flags |= X509_FL_DECODED;
+
+	return 0;
+}
+
 /**
  * Create X.509 certificate
  *
@@ -1169,6 +1202,10 @@ int x509_check_issuer ( struct x509_certificate *cert,
 	struct x509_public_key *public_key = &issuer->subject.public_key;
 	int rc;
 
+	/* Decode issuer's extensions */
+	if ( ( rc = x509_decode_extensions ( issuer ) ) != 0 )
+		return rc;
+
 	/* Check issuer.  In theory, this should be a full X.500 DN
 	 * comparison, which would require support for a plethora of
 	 * abominations such as TeletexString (which allows the
@@ -1305,8 +1342,10 @@ int x509_check_time ( struct x509_certificate *cert, time_t time ) {
  *
  * The issuing certificate must have already been validated.
  *
- * Validation results are cached: if a certificate has already been
- * successfully validated then @c issuer, @c time, and @c root will be
+ * Validation results are cached until the earliest of the expiry
+ * times of the certificate, its issuers, and any OCSP response: if a
+ * certificate has already been successfully validated and the cached
+ * result has not yet expired then @c issuer and @c root will be
  * ignored.
  */
 int x509_validate ( struct x509_certificate *cert,
@@ -1319,9 +1358,16 @@ int x509_validate ( struct x509_certificate *cert,
 	if ( ! root )
 		root = &root_certificates;
 
-	/* Return success if certificate has already been validated */
-	if ( x509_is_valid ( cert ) )
-		return 0;
+	/* Return success if certificate has already been validated,
+	 * unless the cached validation has since expired.
+	 */
+	if ( x509_is_valid ( cert ) ) {
+		if ( time <= cert->expiry )
+			return 0;
+		DBGC ( cert, "X509 %p \"%s\" validation expired (at time "
+		       "%lld)\n", cert, x509_name ( cert ), time );
+		x509_invalidate ( cert );
+	}
 
 	/* Fail if certificate is invalid at specified time */
 	if ( ( rc = x509_check_time ( cert, time ) ) != 0 )
@@ -1329,8 +1375,12 @@ int x509_validate ( struct x509_certificate *cert,
 
 	/* Succeed if certificate is a trusted root certificate */
 	if ( x509_check_root ( cert, root ) == 0 ) {
+		if ( ( rc = x509_decode_extensions ( cert ) ) != 0 )
+			return rc;
 		cert->flags |= X509_FL_VALIDATED;
 		cert->path_remaining = ( cert->extensions.basic.path_len + 1 );
+		cert->expiry = ( cert->validity.not_after.time +
+				 TIMESTAMP_ERROR_MARGIN );
 		return 0;
 	}
 
@@ -1353,6 +1403,10 @@ int x509_validate ( struct x509_certificate *cert,
 	if ( ( rc = x509_check_issuer ( cert, issuer ) ) != 0 )
 		return rc;
 
+	/* Fail if extensions cannot be decoded */
+	if ( ( rc = x509_decode_extensions ( cert ) ) != 0 )
+		return rc;
+
 	/* Fail if path length constraint is violated */
 	if ( issuer->path_remaining == 0 ) {
 		DBGC ( cert, "X509 %p \"%s\" ", cert, x509_name ( cert ) );
@@ -1363,7 +1417,7 @@ int x509_validate ( struct x509_certificate *cert,
 
 	/* Fail if OCSP is required */
 	if ( cert->extensions.auth_info.ocsp.uri.len &&
-	     ( ! cert->extensions.auth_info.ocsp.good ) ) {
+	     ( ! x509_ocsp_is_good ( cert, time ) ) ) {
 		DBGC ( cert, "X509 %p \"%s\" requires an OCSP check\n",
 		       cert, x509_name ( cert ) );
 		return -EACCES_OCSP_REQUIRED;
@@ -1375,6 +1429,16 @@ int x509_validate ( struct x509_certificate *cert,
 	if ( cert->path_remaining > max_path_remaining )
 		cert->path_remaining = max_path_remaining;
 
+	/* Calculate validation expiry time */
+	cert->expiry = ( cert->validity.not_after.time +
+			 TIMESTAMP_ERROR_MARGIN );
+	if ( cert->expiry > issuer->expiry )
+		cert->expiry = issuer->expiry;
+	if ( cert->extensions.auth_info.ocsp.uri.len &&
+	     ( cert->expiry > cert->extensions.auth_info.ocsp.expiry ) ) {
+		cert->expiry = cert->extensions.auth_info.ocsp.expiry;
+	}
+
 	/* Mark certificate as valid */
 	cert->flags |= X509_FL_VALIDATED;
 
@@ -1521,6 +1585,10 @@ int x509_check_name ( struct x509_certificate *cert, const char *name ) {
 	struct asn1_cursor alt_name;
 	int rc;
 
+	/* Decode extensions */
+	if ( ( rc = x509_decode_extensions ( cert ) ) != 0 )
+		return rc;
+
 	/* Check commonName */
 	if ( x509_check_dnsname ( cert, common_name, name ) == 0 ) {
 		DBGC2 ( cert, "X509 %p \"%s\" commonName matches \"%s\"\n",
@@ -1659,6 +1727,10 @@ x509_find_subject ( struct x509_chain *certs,
 	struct x509_link *link;
 	struct x509_certificate *cert;
 
+	/* Use index for certificate store */
+	if ( certs == &certstore )
+		return certstore_find_subject ( subject );
+
 	/* Scan through certificate list */
 	list_for_each_entry ( link, &certs->links, list ) {
 
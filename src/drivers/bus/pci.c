@@ -34,6 +34,8 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/tables.h>
 #include <ipxe/device.h>
 #include <ipxe/pci.h>
+#include <ipxe/process.h>
+#include <config/general.h>
 
 /** @file
  *
@@ -43,6 +45,22 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 static void pcibus_remove ( struct root_device *rootdev );
 
+/** Deferred PCI probing is enabled */
+#ifdef PCI_DEFERRED_PROBE
+#define PCI_DEFERRED_PROBE_ENABLED 1
+#else
+#define PCI_DEFERRED_PROBE_ENABLED 0
+#endif
+
+/** Preferred PCI device bus:dev.fn address, or negative if none */
+static int pci_preferred = -1;
+
+/** PCI bus root device for deferred probing */
+static struct root_device *pci_deferred_rootdev;
+
+/** Next bus:dev.fn address to consider for deferred probing */
+static unsigned int pci_deferred_busdevfn;
+
 /**
  * Read PCI BAR
  *
@@ -310,6 +328,103 @@ void pci_remove ( struct pci_device *pci ) {
 	DBGC ( pci, PCI_FMT " removed\n", PCI_ARGS ( pci ) );
 }
 
+/**
+ * Probe a single PCI device
+ *
+ * @v rootdev		PCI bus root device
+ * @v pci		PCI device
+ * @ret rc		Return status code
+ *
+ * On success, the PCI device has been added to the device hierarchy
+ * and is owned by the PCI bus.
+ */
+static int pcibus_probe_device ( struct root_device *rootdev,
+				 struct pci_device *pci ) {
+	int rc;
+
+	/* Look for a driver */
+	if ( ( rc = pci_find_driver ( pci ) ) != 0 ) {
+		DBGC ( pci, PCI_FMT " (%04x:%04x class %06x) has no "
+		       "driver\n", PCI_ARGS ( pci ), pci->vendor,
+		       pci->device, pci->class );
+		return rc;
+	}
+
+	/* Add to device hierarchy */
+	pci->dev.parent = &rootdev->dev;
+	list_add ( &pci->dev.siblings, &rootdev->dev.children );
+
+	/* Look for a driver */
+	if ( ( rc = pci_probe ( pci ) ) != 0 ) {
+		/* Not registered */
+		list_del ( &pci->dev.siblings );
+		return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * Probe next deferred PCI device
+ *
+ * @v process		Process
+ *
+ * Deferred devices are probed one at a time, so that network traffic
+ * on the preferred device may proceed in between probes.
+ */
+static void pcibus_deferred_step ( struct process *process ) {
+	struct pci_device *pci;
+	int busdevfn;
+
+	/* Allocate struct pci_device */
+	pci = malloc ( sizeof ( *pci ) );
+	if ( ! pci ) {
+		/* Try again on next step */
+		return;
+	}
+
+	/* Find next deferred PCI device, if any */
+	busdevfn = pci_find_next ( pci, pci_deferred_busdevfn );
+	if ( busdevfn < 0 ) {
+		DBGC ( pci, "PCI completed deferred probing\n" );
+		process_del ( process );
+		free ( pci );
+		return;
+	}
+	pci_deferred_busdevfn = ( busdevfn + 1 );
+
+	/* Probe device, unless it is the already-probed preferred device */
+	if ( ( busdevfn == pci_preferred ) ||
+	     ( pcibus_probe_device ( pci_deferred_rootdev, pci ) != 0 ) ) {
+		free ( pci );
+	}
+}
+
+/** Deferred PCI probe process descriptor */
+static struct process_descriptor pci_deferred_desc =
+	PROC_DESC_PURE ( pcibus_deferred_step );
+
+/** Deferred PCI probe process */
+static struct process pci_deferred_process = {
+	.list = LIST_HEAD_INIT ( pci_deferred_process.list ),
+	.desc = &pci_deferred_desc,
+	.refcnt = NULL,
+};
+
+/**
+ * Set preferred PCI device
+ *
+ * @v busdevfn		PCI bus:dev.fn address
+ *
+ * If deferred probing is enabled, then only the preferred PCI device
+ * will be probed at startup.  All other PCI devices will be probed
+ * in the background.
+ */
+void pci_prefer ( unsigned int busdevfn ) {
+
+	pci_preferred = busdevfn;
+}
+
 /**
  * Probe PCI root bus
  *
@@ -338,25 +453,25 @@ static int pcibus_probe ( struct root_device *rootdev ) {
 		if ( busdevfn < 0 )
 			break;
 
-		/* Look for a driver */
-		if ( ( rc = pci_find_driver ( pci ) ) != 0 ) {
-			DBGC ( pci, PCI_FMT " (%04x:%04x class %06x) has no "
-			       "driver\n", PCI_ARGS ( pci ), pci->vendor,
-			       pci->device, pci->class );
+		/* Defer probing of all but the preferred device, if
+		 * applicable.
+		 */
+		if ( PCI_DEFERRED_PROBE_ENABLED && ( pci_preferred >= 0 ) &&
+		     ( busdevfn != pci_preferred ) ) {
+			if ( ! process_running ( &pci_deferred_process ) ) {
+				DBGC ( pci, PCI_FMT " deferring probe of "
+				       "remaining devices\n", PCI_ARGS ( pci ) );
+				pci_deferred_rootdev = rootdev;
+				pci_deferred_busdevfn = busdevfn;
+				process_add ( &pci_deferred_process );
+			}
 			continue;
 		}
 
-		/* Add to device hierarchy */
-		pci->dev.parent = &rootdev->dev;
-		list_add ( &pci->dev.siblings, &rootdev->dev.children );
-
-		/* Look for a driver */
-		if ( ( rc = pci_probe ( pci ) ) == 0 ) {
+		/* Probe device */
+		if ( pcibus_probe_device ( rootdev, pci ) == 0 ) {
 			/* pcidev registered, we can drop our ref */
 			pci = NULL;
-		} else {
-			/* Not registered; re-use struct pci_device */
-			list_del ( &pci->dev.siblings );
 		}
 	}
 
@@ -378,6 +493,10 @@ static void pcibus_remove ( struct root_device *rootdev ) {
 	struct pci_device *pci;
 	struct pci_device *tmp;
 
+	/* Stop any deferred probing */
+	if ( PCI_DEFERRED_PROBE_ENABLED )
+		process_del ( &pci_deferred_process );
+
 	list_for_each_entry_safe ( pci, tmp, &rootdev->dev.children,
 				   dev.siblings ) {
 		pci_remove ( pci );
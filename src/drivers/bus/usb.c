@@ -643,12 +643,18 @@ int usb_refill ( struct usb_endpoint *ep ) {
 	struct io_buffer *iobuf;
 	size_t reserve = ep->reserve;
 	size_t len = ( ep->len ? ep->len : ep->mtu );
-	int rc;
+	unsigned int fill = ep->fill;
+	int rc = 0;
 
 	/* Sanity checks */
 	assert ( ep->open );
 	assert ( ep->max > 0 );
 
+	/* Enqueue all buffers as a single batch, if supported by the
+	 * host controller, to avoid ringing a doorbell per buffer.
+	 */
+	ep->batch = ( ep->host->doorbell != NULL );
+
 	/* Refill endpoint */
 	while ( ep->fill < ep->max ) {
 
@@ -656,8 +662,10 @@ int usb_refill ( struct usb_endpoint *ep ) {
 		if ( list_empty ( &ep->recycled ) ) {
 			/* Recycled buffer list is empty; allocate new buffer */
 			iobuf = alloc_iob ( reserve + len );
-			if ( ! iobuf )
-				return -ENOMEM;
+			if ( ! iobuf ) {
+				rc = -ENOMEM;
+				break;
+			}
 			iob_reserve ( iobuf, reserve );
 		} else {
 			/* Get buffer from recycled buffer list */
@@ -674,11 +682,18 @@ int usb_refill ( struct usb_endpoint *ep ) {
 		/* Enqueue buffer */
 		if ( ( rc = usb_stream ( ep, iobuf, 0 ) ) != 0 ) {
 			list_add ( &iobuf->list, &ep->recycled );
-			return rc;
+			break;
 		}
 	}
 
-	return 0;
+	/* Start any batched transfers */
+	if ( ep->batch ) {
+		ep->batch = 0;
+		if ( ep->fill != fill )
+			ep->host->doorbell ( ep );
+	}
+
+	return rc;
 }
 
 /**
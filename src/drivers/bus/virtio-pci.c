@@ -23,10 +23,12 @@
 
 static int vp_alloc_vq(struct vring_virtqueue *vq, u16 num)
 {
-    size_t queue_size = PAGE_MASK + vring_size(num);
+    size_t queue_size = PAGE_MASK + (vq->packed ? vring_packed_size(num) :
+                                                  vring_size(num));
     size_t vdata_size = num * sizeof(void *);
+    size_t id_size = (vq->packed ? (2 * num * sizeof(u16)) : 0);
 
-    vq->queue = zalloc(queue_size + vdata_size);
+    vq->queue = zalloc(queue_size + vdata_size + id_size);
     if (!vq->queue) {
         return -ENOMEM;
     }
@@ -34,6 +36,12 @@ static int vp_alloc_vq(struct vring_virtqueue *vq, u16 num)
     /* vdata immediately follows the ring */
     vq->vdata = (void **)(vq->queue + queue_size);
 
+    /* packed ring buffer ID state follows vdata */
+    if (vq->packed) {
+        vq->next_id = (u16 *)(vq->queue + queue_size + vdata_size);
+        vq->chain_len = &vq->next_id[num];
+    }
+
     return 0;
 }
 
@@ -43,6 +51,8 @@ void vp_free_vq(struct vring_virtqueue *vq)
         free(vq->queue);
         vq->queue = NULL;
         vq->vdata = NULL;
+        vq->next_id = NULL;
+        vq->chain_len = NULL;
     }
 }
 
@@ -352,6 +362,7 @@ int vpm_find_vqs(struct virtio_pci_modern_device *vdev,
 {
     unsigned i;
     struct vring_virtqueue *vq;
+    void *desc, *driver, *device;
     u16 size, off;
     u32 notify_offset_multiplier;
     int err;
@@ -401,18 +412,28 @@ int vpm_find_vqs(struct virtio_pci_modern_device *vdev,
             DBG("VIRTIO-PCI %p: failed to allocate queue memory\n", vdev);
             return err;
         }
-        vring_init(&vq->vring, size, vq->queue);
+        if (vq->packed) {
+            vring_packed_init(vq, size, vq->queue);
+            desc = vq->vpacked.desc;
+            driver = vq->vpacked.driver;
+            device = vq->vpacked.device;
+        } else {
+            vring_init(&vq->vring, size, vq->queue);
+            desc = vq->vring.desc;
+            driver = vq->vring.avail;
+            device = vq->vring.used;
+        }
 
         /* activate the queue */
         vpm_iowrite16(vdev, &vdev->common, size, COMMON_OFFSET(queue_size));
 
-        vpm_iowrite64(vdev, &vdev->common, virt_to_phys(vq->vring.desc),
+        vpm_iowrite64(vdev, &vdev->common, virt_to_phys(desc),
                       COMMON_OFFSET(queue_desc_lo),
                       COMMON_OFFSET(queue_desc_hi));
-        vpm_iowrite64(vdev, &vdev->common, virt_to_phys(vq->vring.avail),
+        vpm_iowrite64(vdev, &vdev->common, virt_to_phys(driver),
                       COMMON_OFFSET(queue_avail_lo),
                       COMMON_OFFSET(queue_avail_hi));
-        vpm_iowrite64(vdev, &vdev->common, virt_to_phys(vq->vring.used),
+        vpm_iowrite64(vdev, &vdev->common, virt_to_phys(device),
                       COMMON_OFFSET(queue_used_lo),
                       COMMON_OFFSET(queue_used_hi));
 
@@ -59,6 +59,35 @@ void vring_detach(struct vring_virtqueue *vq, unsigned int head)
  *
  */
 
+static void *vring_get_buf_packed(struct vring_virtqueue *vq,
+                                  unsigned int *len)
+{
+   struct vring_packed *vr = &vq->vpacked;
+   struct vring_packed_desc *desc;
+   u16 id;
+   void *opaque;
+
+   desc = &vr->desc[vq->last_used_idx];
+   rmb();
+   id = desc->id;
+   if (len != NULL)
+           *len = desc->len;
+
+   opaque = vq->vdata[id];
+
+   /* skip over the whole chain and return the buffer ID */
+
+   vq->last_used_idx += vq->chain_len[id];
+   if (vq->last_used_idx >= vr->num) {
+           vq->last_used_idx -= vr->num;
+           vq->used_wrap ^= 1;
+   }
+   vq->next_id[id] = vq->free_head;
+   vq->free_head = id;
+
+   return opaque;
+}
+
 void *vring_get_buf(struct vring_virtqueue *vq, unsigned int *len)
 {
    struct vring *vr = &vq->vring;
@@ -68,6 +97,9 @@ void *vring_get_buf(struct vring_virtqueue *vq, unsigned int *len)
 
    BUG_ON(!vring_more_used(vq));
 
+   if (vq->packed)
+           return vring_get_buf_packed(vq, len);
+
    elem = &vr->used->ring[vq->last_used_idx % vr->num];
    wmb();
    id = elem->id;
@@ -80,9 +112,63 @@ void *vring_get_buf(struct vring_virtqueue *vq, unsigned int *len)
 
    vq->last_used_idx++;
 
+   /* keep interrupts suppressed, if applicable */
+
+   if (vq->event_idx && (vr->avail->flags & VRING_AVAIL_F_NO_INTERRUPT))
+           *vr->used_event = vq->last_used_idx - 1;
+
    return opaque;
 }
 
+static void vring_add_buf_packed(struct vring_virtqueue *vq,
+                                 struct vring_list list[],
+                                 unsigned int out, unsigned int in,
+                                 void *opaque)
+{
+   struct vring_packed *vr = &vq->vpacked;
+   struct vring_packed_desc *desc;
+   unsigned int total = out + in;
+   unsigned int i;
+   u16 id, head, flags, head_flags = 0;
+
+   id = vq->free_head;
+   head = vq->next_avail_idx;
+   for (i = 0; i < total; i++, list++) {
+
+           flags = (vq->avail_wrap ? VRING_PACKED_DESC_F_AVAIL :
+                                     VRING_PACKED_DESC_F_USED);
+           if (i >= out)
+                   flags |= VRING_DESC_F_WRITE;
+           if (i + 1 < total)
+                   flags |= VRING_DESC_F_NEXT;
+
+           desc = &vr->desc[vq->next_avail_idx];
+           desc->addr = (u64)virt_to_phys(list->addr);
+           desc->len = list->length;
+           desc->id = id;
+
+           /* the head is made available last, once the chain is complete */
+
+           if (i == 0)
+                   head_flags = flags;
+           else
+                   desc->flags = flags;
+
+           if (++vq->next_avail_idx >= vr->num) {
+                   vq->next_avail_idx = 0;
+                   vq->avail_wrap ^= 1;
+           }
+   }
+
+   vq->free_head = vq->next_id[id];
+   vq->chain_len[id] = total;
+   vq->vdata[id] = opaque;
+   vq->num_added += total;
+
+   wmb();
+   vr->desc[head].flags = head_flags;
+}
+
 void vring_add_buf(struct vring_virtqueue *vq,
 		   struct vring_list list[],
 		   unsigned int out, unsigned int in,
@@ -93,6 +179,11 @@ void vring_add_buf(struct vring_virtqueue *vq,
 
    BUG_ON(out + in == 0);
 
+   if (vq->packed) {
+           vring_add_buf_packed(vq, list, out, in, opaque);
+           return;
+   }
+
    prev = 0;
    head = vq->free_head;
    for (i = head; out; i = vr->desc[i].next, out--) {
@@ -122,16 +213,61 @@ void vring_add_buf(struct vring_virtqueue *vq,
    wmb();
 }
 
+/*
+ * vring_need_kick_packed
+ *
+ * does the device want to be notified about the descriptors added
+ * since the last kick ?
+ *
+ */
+
+static int vring_need_kick_packed(struct vring_virtqueue *vq)
+{
+   struct vring_packed *vr = &vq->vpacked;
+   u16 new_idx, old, off_wrap, event_idx;
+   u16 flags;
+
+   new_idx = vq->next_avail_idx;
+   old = new_idx - vq->num_added;
+   vq->num_added = 0;
+
+   mb();
+   flags = vr->device->flags;
+   if (flags != VRING_PACKED_EVENT_FLAG_DESC)
+           return (flags != VRING_PACKED_EVENT_FLAG_DISABLE);
+
+   off_wrap = vr->device->off_wrap;
+   event_idx = off_wrap & ~(1 << VRING_PACKED_EVENT_F_WRAP_CTR);
+   if ((off_wrap >> VRING_PACKED_EVENT_F_WRAP_CTR) != vq->avail_wrap)
+           event_idx -= vr->num;
+   return vring_need_event(event_idx, new_idx, old);
+}
+
 void vring_kick(struct virtio_pci_modern_device *vdev, unsigned int ioaddr,
                 struct vring_virtqueue *vq, int num_added)
 {
    struct vring *vr = &vq->vring;
+   u16 old, new_idx;
+   int notify;
 
-   wmb();
-   vr->avail->idx += num_added;
+   if (vq->packed) {
+           notify = vring_need_kick_packed(vq);
+   } else {
+           wmb();
+           old = vr->avail->idx;
+           new_idx = old + num_added;
+           vr->avail->idx = new_idx;
 
-   mb();
-   if (!(vr->used->flags & VRING_USED_F_NO_NOTIFY)) {
+           mb();
+           if (vq->event_idx) {
+                   notify = vring_need_event(*vr->avail_event,
+                                             new_idx, old);
+           } else {
+                   notify = !(vr->used->flags & VRING_USED_F_NO_NOTIFY);
+           }
+   }
+
+   if (notify) {
            if (vdev) {
                    /* virtio 1.0 */
                    vpm_notify(vdev, vq);
@@ -501,7 +501,6 @@ static int flexboot_nodnic_post_recv ( struct ib_device *ibdev,
 			      struct io_buffer *iobuf ) {
 	struct flexboot_nodnic *flexboot_nodnic = ib_get_drvdata ( ibdev );
 	struct flexboot_nodnic_queue_pair *flexboot_nodnic_qp = ib_qp_get_drvdata ( qp );
-	struct flexboot_nodnic_port *port = &flexboot_nodnic->port[ibdev->port - 1];
 	struct ib_work_queue *wq = &qp->recv;
 	nodnic_qp *nodnic_qp = flexboot_nodnic_qp->nodnic_queue_pair;
 	struct nodnic_recv_ring *recv_ring = &nodnic_qp->receive;
@@ -528,15 +527,47 @@ static int flexboot_nodnic_post_recv ( struct ib_device *ibdev,
 	MLX_FILL_1 ( &wqe->data[0], 3,
 			 local_address_l, virt_to_bus ( iobuf->data ) );
 
+	/* The doorbell is rung once for the whole batch of posted
+	 * entries by flexboot_nodnic_recv_doorbell().
+	 */
 	wq->next_idx++;
 
+post_recv_done:
+	return status;
+}
+
+/**
+ * Ring receive doorbell for any newly posted work queue entries
+ *
+ * @v ibdev		Infiniband device
+ * @v qp		Queue pair
+ *
+ * On devices without receive doorbell records, each doorbell is a
+ * write via the device command interface, and so is expensive.  We
+ * therefore ring the doorbell once per refill rather than once per
+ * posted work queue entry.
+ */
+static void flexboot_nodnic_recv_doorbell ( struct ib_device *ibdev,
+					    struct ib_queue_pair *qp ) {
+	struct flexboot_nodnic *flexboot_nodnic = ib_get_drvdata ( ibdev );
+	struct flexboot_nodnic_queue_pair *flexboot_nodnic_qp = ib_qp_get_drvdata ( qp );
+	struct flexboot_nodnic_port *port = &flexboot_nodnic->port[ibdev->port - 1];
+	struct ib_work_queue *wq = &qp->recv;
+	nodnic_qp *nodnic_qp = flexboot_nodnic_qp->nodnic_queue_pair;
+	struct nodnic_recv_ring *recv_ring = &nodnic_qp->receive;
+	mlx_status status;
+
+	/* Do nothing unless new entries have been posted */
+	if ( flexboot_nodnic_qp->recv_doorbell_idx == wq->next_idx )
+		return;
+
 	status = port->port_priv.recv_doorbell ( &port->port_priv,
 				&recv_ring->nodnic_ring, ( mlx_uint16 ) wq->next_idx );
 	if ( status != 0 ) {
 		DBGC ( flexboot_nodnic, "flexboot_nodnic %p ring receive doorbell failed\n", flexboot_nodnic );
+		return;
 	}
-post_recv_done:
-	return status;
+	flexboot_nodnic_qp->recv_doorbell_idx = wq->next_idx;
 }
 
 /***************************************************************************
@@ -746,8 +777,38 @@ static void flexboot_nodnic_port_disable_dma ( struct flexboot_nodnic_port *port
 /** Number of flexboot_nodnic Ethernet send work queue entries */
 #define FLEXBOOT_NODNIC_ETH_NUM_SEND_WQES 64
 
-/** Number of flexboot_nodnic Ethernet receive work queue entries */
+/** Minimum number of flexboot_nodnic Ethernet receive work queue entries */
 #define FLEXBOOT_NODNIC_ETH_NUM_RECV_WQES 64
+
+/** Maximum number of flexboot_nodnic Ethernet receive work queue entries */
+#define FLEXBOOT_NODNIC_ETH_MAX_RECV_WQES 512
+
+/**
+ * Choose number of flexboot_nodnic Ethernet receive work queue entries
+ *
+ * @v flexboot_nodnic	flexboot_nodnic device
+ * @v cq_size		Completion queue size
+ * @ret num_wqes	Number of receive work queue entries
+ *
+ * Use as deep a receive queue as the device's ring size and
+ * completion queue size permit.
+ */
+static unsigned int
+flexboot_nodnic_eth_num_recv_wqes ( struct flexboot_nodnic *flexboot_nodnic,
+				    mlx_uint64 cq_size ) {
+	mlx_size max_ring_size =
+		( 1UL << flexboot_nodnic->device_priv.device_cap.log_max_ring_size );
+	unsigned int num_wqes = FLEXBOOT_NODNIC_ETH_MAX_RECV_WQES;
+
+	while ( ( num_wqes > FLEXBOOT_NODNIC_ETH_NUM_RECV_WQES ) &&
+		( ( ( num_wqes * sizeof ( struct nodnic_recv_wqe ) ) >
+		    max_ring_size ) ||
+		  ( ( FLEXBOOT_NODNIC_ETH_NUM_SEND_WQES + num_wqes ) >
+		    cq_size ) ) ) {
+		num_wqes >>= 1;
+	}
+	return num_wqes;
+}
 /** flexboot nodnic Ethernet queue pair operations */
 static struct ib_queue_pair_operations flexboot_nodnic_eth_qp_op = {
 	.alloc_iob = alloc_iob,
@@ -842,6 +903,10 @@ static void flexboot_nodnic_eth_poll ( struct net_device *netdev) {
 	struct ib_device *ibdev = port->ibdev;
 
 	ib_poll_eq ( ibdev );
+
+	/* Notify device of any refilled receive entries */
+	if ( port->eth_qp )
+		flexboot_nodnic_recv_doorbell ( ibdev, port->eth_qp );
 }
 
 /**
@@ -877,9 +942,14 @@ static int flexboot_nodnic_eth_open ( struct net_device *netdev ) {
 	}
 	INIT_LIST_HEAD ( &dummy_cq->work_queues );
 
+	status = nodnic_port_get_cq_size(&port->port_priv, &cq_size);
+	MLX_FATAL_CHECK_STATUS(status, get_cq_size_err,
+			"nodnic_port_get_cq_size failed");
+
 	port->eth_qp = ib_create_qp ( ibdev, IB_QPT_ETH,
 					FLEXBOOT_NODNIC_ETH_NUM_SEND_WQES, dummy_cq,
-					FLEXBOOT_NODNIC_ETH_NUM_RECV_WQES, dummy_cq,
+					flexboot_nodnic_eth_num_recv_wqes (
+						flexboot_nodnic, cq_size ), dummy_cq,
 					&flexboot_nodnic_eth_qp_op, netdev->name );
 	if ( !port->eth_qp ) {
 		DBGC ( flexboot_nodnic, "flexboot_nodnic %p port %d could not create queue pair\n",
@@ -890,10 +960,6 @@ static int flexboot_nodnic_eth_open ( struct net_device *netdev ) {
 
 	ib_qp_set_ownerdata ( port->eth_qp, netdev );
 
-	status = nodnic_port_get_cq_size(&port->port_priv, &cq_size);
-	MLX_FATAL_CHECK_STATUS(status, get_cq_size_err,
-			"nodnic_port_get_cq_size failed");
-
 	port->eth_cq = ib_create_cq ( ibdev, cq_size,
 			&flexboot_nodnic_eth_cq_op );
 	if ( !port->eth_cq ) {
@@ -930,6 +996,7 @@ static int flexboot_nodnic_eth_open ( struct net_device *netdev ) {
 
 	/* Fill receive rings */
 	ib_refill_recv ( ibdev, port->eth_qp );
+	flexboot_nodnic_recv_doorbell ( ibdev, port->eth_qp );
 
 	status = nodnic_port_enable_dma(&port->port_priv);
 	MLX_FATAL_CHECK_STATUS(status, dma_err,
@@ -963,9 +1030,9 @@ init_err:
 	nodnic_port_free_eq(&port->port_priv);
 eq_alloc_err:
 err_create_cq:
-get_cq_size_err:
 	ib_destroy_qp(ibdev, port->eth_qp );
 err_create_qp:
+get_cq_size_err:
 	free(dummy_cq);
 err_create_dummy_cq:
 	port->port_priv.port_state &= ~NODNIC_PORT_OPENED;
@@ -72,6 +72,8 @@ struct flexboot_nodnic_port {
 /** A flexboot nodnic queue pair */
 struct flexboot_nodnic_queue_pair {
 	nodnic_qp *nodnic_queue_pair;
+	/** Receive work queue index most recently passed to doorbell */
+	unsigned long recv_doorbell_idx;
 };
 
 /** A flexboot nodnic cq */
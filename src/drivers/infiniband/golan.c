@@ -1889,6 +1889,7 @@ static void golan_poll_cq(struct ib_device *ibdev,
 	struct golan_cqe64	*cqe64;
 	struct golan_completion_queue *golan_cq = ib_cq_get_drvdata(cq);
 	struct golan		*golan	= ib_get_drvdata(ibdev);
+	unsigned long		start_idx = cq->next_idx;
 
 	for (i = 0; i < cq->num_cqes; ++i) {
 		/* Look for completion entry */
@@ -1914,10 +1915,11 @@ static void golan_poll_cq(struct ib_device *ibdev,
 
 		/* Update completion queue's index */
 		cq->next_idx++;
+	}
 
-		/* Update doorbell record */
+	/* Update doorbell record once for all consumed entries */
+	if (cq->next_idx != start_idx)
 		*(golan_cq->doorbell_record) = cpu_to_be32(cq->next_idx & 0xffffff);
-	}
 }
 
 static const char *golan_eqe_type_str(u8 type)
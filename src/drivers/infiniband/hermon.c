@@ -1295,8 +1295,13 @@ static int hermon_modify_qp ( struct ib_device *ibdev,
 		MLX_FILL_1 ( &qpctx, 16,
 			     qpc_eec_data.primary_address_path.sched_queue,
 			     hermon_sched_queue ( ibdev, qp ) );
-		MLX_FILL_1 ( &qpctx, 39,
-			     qpc_eec_data.next_rcv_psn, qp->recv.psn );
+		MLX_FILL_2 ( &qpctx, 39,
+			     qpc_eec_data.next_rcv_psn, qp->recv.psn,
+			     qpc_eec_data.min_rnr_nak, HERMON_MIN_RNR_NAK );
+		if ( qp->type == IB_QPT_RC ) {
+			MLX_FILL_1 ( &qpctx, 0, opt_param_mask,
+				     HERMON_QP_OPT_PARAM_RNR_TIMEOUT );
+		}
 		if ( ( rc = hermon_cmd_init2rtr_qp ( hermon, qp->qpn,
 						     &qpctx ) ) != 0 ) {
 			DBGC ( hermon, "Hermon %p QPN %#lx INIT2RTR_QP failed:"
@@ -1826,6 +1831,7 @@ static void hermon_poll_cq ( struct ib_device *ibdev,
 	struct hermon_completion_queue *hermon_cq = ib_cq_get_drvdata ( cq );
 	union hermonprm_completion_entry *cqe;
 	unsigned int cqe_idx_mask;
+	unsigned long start_idx = cq->next_idx;
 	int rc;
 
 	while ( 1 ) {
@@ -1848,8 +1854,10 @@ static void hermon_poll_cq ( struct ib_device *ibdev,
 
 		/* Update completion queue's index */
 		cq->next_idx++;
+	}
 
-		/* Update doorbell record */
+	/* Update doorbell record once for all consumed entries */
+	if ( cq->next_idx != start_idx ) {
 		MLX_FILL_1 ( hermon_cq->doorbell, 0, update_ci,
 			     ( cq->next_idx & 0x00ffffffUL ) );
 	}
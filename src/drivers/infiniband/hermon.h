@@ -108,6 +108,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 	( 0x800 + HERMON_PAGE_SIZE * ( (_eqn) / 4 ) + 0x08 * ( (_eqn) % 4 ) )
 
 #define HERMON_QP_OPT_PARAM_PM_STATE	0x00000400UL
+#define HERMON_QP_OPT_PARAM_RNR_TIMEOUT	0x00000040UL
 #define HERMON_QP_OPT_PARAM_QKEY	0x00000020UL
 #define HERMON_QP_OPT_PARAM_ALT_PATH	0x00000001UL
 
@@ -134,6 +135,15 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 #define HERMON_RETRY_MAX		0x07
 
+/** Minimum RNR NAK timer (0.64ms)
+ *
+ * The default encoding (zero) corresponds to the maximum RNR NAK
+ * timer value of 655ms, which would stall a reliable connection for
+ * an unreasonable length of time whenever the receive ring is
+ * momentarily empty.
+ */
+#define HERMON_MIN_RNR_NAK		0x0c
+
 #define HERMON_MOD_STAT_CFG_SET		0x01
 #define HERMON_MOD_STAT_CFG_QUERY	0x03
 
@@ -19,6 +19,7 @@
 #include <errno.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <linux_api.h>
 #include <ipxe/list.h>
 #include <ipxe/linux.h>
@@ -29,6 +30,7 @@
 #include <ipxe/ethernet.h>
 #include <ipxe/settings.h>
 #include <ipxe/socket.h>
+#include <ipxe/io.h>
 
 /* This hack prevents pre-2.6.32 headers from redefining struct sockaddr */
 #define __GLIBC__ 2
@@ -44,9 +46,26 @@
 #define LINUX_SOCK_RAW 3
 #define LINUX_SIOCGIFINDEX 0x8933
 #define LINUX_SIOCGIFHWADDR 0x8927
+#define LINUX_SOL_PACKET 263
 
 #define RX_BUF_SIZE 1536
 
+/** Maximum number of packets per recvmmsg() or sendmmsg() call */
+#define AF_PACKET_BATCH 32
+
+/** Receive ring frame size
+ *
+ * This must be large enough to hold the ring frame header, the
+ * socket address, and a full-sized Ethernet frame.
+ */
+#define AF_PACKET_RING_FRAME_SIZE 2048
+
+/** Receive ring block size (must be a multiple of the page size) */
+#define AF_PACKET_RING_BLOCK_SIZE 4096
+
+/** Default number of receive ring frames */
+#define AF_PACKET_RING_FRAMES 256
+
 /** @file
  *
  * The AF_PACKET driver.
@@ -61,8 +80,89 @@ struct af_packet_nic {
 	int fd;
 	/** ifindex */
 	int ifindex;
+	/** Requested number of receive ring frames (or zero to disable) */
+	unsigned int ring_frames;
+	/** Memory-mapped receive ring (if any) */
+	void *ring;
+	/** Length of receive ring */
+	size_t ring_len;
+	/** Number of receive ring frames */
+	unsigned int ring_count;
+	/** Index of next receive ring frame */
+	unsigned int ring_index;
+	/** Receive buffers (when not using the receive ring) */
+	struct io_buffer *rx_iobuf[AF_PACKET_BATCH];
 };
 
+/**
+ * Open memory-mapped receive ring
+ *
+ * @v nic		AF_PACKET NIC
+ * @ret rc		Return status code
+ *
+ * A PACKET_RX_RING allows received packets to be collected without
+ * any system calls.  Failure is not fatal, since recvmmsg() may be
+ * used instead.
+ */
+static int af_packet_ring_open ( struct af_packet_nic *nic )
+{
+	struct tpacket_req req;
+	size_t len;
+	void *ring;
+	int ret;
+
+	/* Calculate ring geometry */
+	len = ( nic->ring_frames * AF_PACKET_RING_FRAME_SIZE );
+	memset(&req, 0, sizeof(req));
+	req.tp_block_size = AF_PACKET_RING_BLOCK_SIZE;
+	req.tp_block_nr = ( ( len + AF_PACKET_RING_BLOCK_SIZE - 1 ) /
+			    AF_PACKET_RING_BLOCK_SIZE );
+	req.tp_frame_size = AF_PACKET_RING_FRAME_SIZE;
+	req.tp_frame_nr = ( ( req.tp_block_nr * AF_PACKET_RING_BLOCK_SIZE ) /
+			    AF_PACKET_RING_FRAME_SIZE );
+	len = ( req.tp_block_nr * AF_PACKET_RING_BLOCK_SIZE );
+
+	/* Create ring */
+	ret = linux_setsockopt(nic->fd, LINUX_SOL_PACKET, PACKET_RX_RING,
+			       &req, sizeof(req));
+	if (ret != 0) {
+		DBGC(nic, "af_packet %p setsockopt(PACKET_RX_RING) = %d "
+		     "(%s)\n", nic, ret, linux_strerror(linux_errno));
+		return ret;
+	}
+
+	/* Map ring */
+	ring = linux_mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED,
+			  nic->fd, 0);
+	if (ring == MAP_FAILED) {
+		DBGC(nic, "af_packet %p mmap(PACKET_RX_RING) failed (%s)\n",
+		     nic, linux_strerror(linux_errno));
+		return -1;
+	}
+
+	nic->ring = ring;
+	nic->ring_len = len;
+	nic->ring_count = req.tp_frame_nr;
+	nic->ring_index = 0;
+	DBGC(nic, "af_packet %p using %d-frame receive ring\n",
+	     nic, nic->ring_count);
+
+	return 0;
+}
+
+/**
+ * Close memory-mapped receive ring
+ *
+ * @v nic		AF_PACKET NIC
+ */
+static void af_packet_ring_close ( struct af_packet_nic *nic )
+{
+	if (nic->ring) {
+		linux_munmap(nic->ring, nic->ring_len);
+		nic->ring = NULL;
+	}
+}
+
 /** Open the linux interface */
 static int af_packet_nic_open ( struct net_device * netdev )
 {
@@ -115,6 +215,10 @@ static int af_packet_nic_open ( struct net_device * netdev )
 		return ret;
 	}
 
+	/* Use a memory-mapped receive ring, if possible */
+	if (nic->ring_frames)
+		af_packet_ring_open(nic);
+
 	return 0;
 }
 
@@ -122,80 +226,189 @@ static int af_packet_nic_open ( struct net_device * netdev )
 static void af_packet_nic_close ( struct net_device *netdev )
 {
 	struct af_packet_nic * nic = netdev->priv;
+	unsigned int i;
+
+	af_packet_ring_close(nic);
 	linux_close(nic->fd);
+
+	for (i = 0; i < AF_PACKET_BATCH; i++) {
+		free_iob(nic->rx_iobuf[i]);
+		nic->rx_iobuf[i] = NULL;
+	}
 }
 
 /**
  * Transmit an ethernet packet.
  *
- * The packet can be written to the socket and marked as complete immediately.
+ * The packet is left on the transmit queue, to be written to the
+ * socket (along with any other queued packets) by a single sendmmsg()
+ * call during the next poll.
  */
-static int af_packet_nic_transmit ( struct net_device *netdev,
+static int af_packet_nic_transmit ( struct net_device *netdev __unused,
 				    struct io_buffer *iobuf )
 {
-	struct af_packet_nic * nic = netdev->priv;
-	struct sockaddr_ll socket_address;
-	const struct ethhdr * eh;
-	int rc;
+	/* Pad packet */
+	iob_pad(iobuf, ETH_ZLEN);
 
-	memset(&socket_address, 0, sizeof(socket_address));
-	socket_address.sll_family = LINUX_AF_PACKET;
-	socket_address.sll_ifindex = nic->ifindex;
-	socket_address.sll_halen = ETH_ALEN;
-
-	eh = iobuf->data;
-	memcpy(socket_address.sll_addr, eh->h_dest, ETH_ALEN);
+	return 0;
+}
 
-	rc = linux_sendto(nic->fd, iobuf->data, iobuf->tail - iobuf->data,
-			  0, (struct sockaddr *)&socket_address,
-			  sizeof(socket_address));
+/** Write queued packets to the socket */
+static void af_packet_nic_flush ( struct net_device *netdev )
+{
+	struct af_packet_nic * nic = netdev->priv;
+	struct linux_mmsghdr msgs[AF_PACKET_BATCH];
+	struct linux_iovec iov[AF_PACKET_BATCH];
+	struct io_buffer * iobuf;
+	unsigned int count;
+	unsigned int i;
+	int sent;
+
+	do {
+		/* Construct batch from transmit queue.  No socket
+		 * address is required, since the socket is bound to
+		 * the interface.
+		 */
+		count = 0;
+		memset(msgs, 0, sizeof(msgs));
+		list_for_each_entry(iobuf, &netdev->tx_queue, list) {
+			if (count == AF_PACKET_BATCH)
+				break;
+			iov[count].iov_base = iobuf->data;
+			iov[count].iov_len = iob_len(iobuf);
+			msgs[count].msg_hdr.msg_iov = &iov[count];
+			msgs[count].msg_hdr.msg_iovlen = 1;
+			count++;
+		}
+		if (! count)
+			return;
+
+		/* Write batch */
+		sent = linux_sendmmsg(nic->fd, msgs, count, 0);
+		DBGC2(nic, "af_packet %p wrote %d of %d packets\n",
+		      nic, sent, count);
+		if (sent < 0) {
+			DBGC(nic, "af_packet %p sendmmsg failed (%s)\n",
+			     nic, linux_strerror(linux_errno));
+			sent = 0;
+		}
+
+		/* Complete written packets */
+		for (i = 0; i < (unsigned int) sent; i++)
+			netdev_tx_complete_next(netdev);
+
+		/* Discard the packet that could not be written, to
+		 * guarantee forward progress.
+		 */
+		if ((unsigned int) sent < count) {
+			netdev_tx_complete_next_err(netdev, -EIO);
+			return;
+		}
+
+	} while (count == AF_PACKET_BATCH);
+}
 
-	DBGC2(nic, "af_packet %p wrote %d bytes\n", nic, rc);
-	netdev_tx_complete(netdev, iobuf);
+/** Poll for new packets using the memory-mapped receive ring */
+static void af_packet_nic_poll_ring ( struct net_device *netdev )
+{
+	struct af_packet_nic * nic = netdev->priv;
+	struct tpacket_hdr * hdr;
+	struct io_buffer * iobuf;
+	unsigned int len;
+
+	while (1) {
+
+		/* Stop at first frame still owned by the kernel */
+		hdr = (nic->ring + (nic->ring_index *
+				    AF_PACKET_RING_FRAME_SIZE));
+		if (! (*((volatile unsigned long *) &hdr->tp_status) &
+		       TP_STATUS_USER))
+			return;
+		rmb();
+
+		/* Copy out packet */
+		len = hdr->tp_snaplen;
+		iobuf = alloc_iob(len);
+		if (! iobuf) {
+			DBGC(nic, "af_packet %p alloc_iob failed\n", nic);
+			return;
+		}
+		memcpy(iob_put(iobuf, len), ((void *) hdr + hdr->tp_mac),
+		       len);
+		DBGC2(nic, "af_packet %p ring read %d bytes\n", nic, len);
+
+		/* Return frame to kernel */
+		wmb();
+		hdr->tp_status = TP_STATUS_KERNEL;
+		nic->ring_index = ((nic->ring_index + 1) % nic->ring_count);
 
-	return 0;
+		netdev_rx(netdev, iobuf);
+	}
 }
 
-/** Poll for new packets */
-static void af_packet_nic_poll ( struct net_device *netdev )
+/** Poll for new packets using recvmmsg() */
+static void af_packet_nic_poll_mmsg ( struct net_device *netdev )
 {
 	struct af_packet_nic * nic = netdev->priv;
-	struct pollfd pfd;
+	struct linux_mmsghdr msgs[AF_PACKET_BATCH];
+	struct linux_iovec iov[AF_PACKET_BATCH];
 	struct io_buffer * iobuf;
+	unsigned int count;
+	unsigned int i;
 	int r;
 
-	pfd.fd = nic->fd;
-	pfd.events = POLLIN;
-	if (linux_poll(&pfd, 1, 0) == -1) {
-		DBGC(nic, "af_packet %p poll failed (%s)\n",
-		     nic, linux_strerror(linux_errno));
-		return;
+	/* Refill receive buffers */
+	memset(msgs, 0, sizeof(msgs));
+	for (count = 0; count < AF_PACKET_BATCH; count++) {
+		iobuf = nic->rx_iobuf[count];
+		if (! iobuf) {
+			iobuf = alloc_iob(RX_BUF_SIZE);
+			if (! iobuf)
+				break;
+			nic->rx_iobuf[count] = iobuf;
+		}
+		iov[count].iov_base = iobuf->data;
+		iov[count].iov_len = RX_BUF_SIZE;
+		msgs[count].msg_hdr.msg_iov = &iov[count];
+		msgs[count].msg_hdr.msg_iovlen = 1;
 	}
-	if ((pfd.revents & POLLIN) == 0)
+	if (! count) {
+		DBGC(nic, "af_packet %p alloc_iob failed\n", nic);
 		return;
+	}
 
-	/* At this point we know there is at least one new packet to be read */
-
-	iobuf = alloc_iob(RX_BUF_SIZE);
-	if (! iobuf)
-		goto allocfail;
-
-	while ((r = linux_read(nic->fd, iobuf->data, RX_BUF_SIZE)) > 0) {
-		DBGC2(nic, "af_packet %p read %d bytes\n", nic, r);
+	/* Read as many packets as are available (without blocking,
+	 * since the socket is in non-blocking mode).
+	 */
+	r = linux_recvmmsg(nic->fd, msgs, count, 0, NULL);
+	if (r <= 0)
+		return;
 
-		iob_put(iobuf, r);
+	/* Hand off received packets */
+	for (i = 0; i < (unsigned int) r; i++) {
+		iobuf = nic->rx_iobuf[i];
+		nic->rx_iobuf[i] = NULL;
+		DBGC2(nic, "af_packet %p read %d bytes\n",
+		      nic, msgs[i].msg_len);
+		iob_put(iobuf, msgs[i].msg_len);
 		netdev_rx(netdev, iobuf);
-
-		iobuf = alloc_iob(RX_BUF_SIZE);
-		if (! iobuf)
-			goto allocfail;
 	}
+}
+
+/** Poll for completed and received packets */
+static void af_packet_nic_poll ( struct net_device *netdev )
+{
+	struct af_packet_nic * nic = netdev->priv;
 
-	free_iob(iobuf);
-	return;
+	/* Write any queued packets */
+	af_packet_nic_flush(netdev);
 
-allocfail:
-	DBGC(nic, "af_packet %p alloc_iob failed\n", nic);
+	/* Read any received packets */
+	if (nic->ring) {
+		af_packet_nic_poll_ring(netdev);
+	} else {
+		af_packet_nic_poll_mmsg(netdev);
+	}
 }
 
 /**
@@ -256,6 +469,7 @@ static int af_packet_nic_probe ( struct linux_device *device,
 				 struct linux_device_request *request )
 {
 	struct linux_setting *if_setting;
+	struct linux_setting *ring_setting;
 	struct net_device *netdev;
 	struct af_packet_nic *nic;
 	int rc;
@@ -288,6 +502,14 @@ static int af_packet_nic_probe ( struct linux_device *device,
 	af_packet_update_properties(netdev);
 	if_setting->applied = 1;
 
+	/* Look for the optional ring setting (zero disables the ring) */
+	nic->ring_frames = AF_PACKET_RING_FRAMES;
+	ring_setting = linux_find_setting("ring", &request->settings);
+	if (ring_setting) {
+		nic->ring_frames = strtoul(ring_setting->value, NULL, 0);
+		ring_setting->applied = 1;
+	}
+
 	/* Apply rest of the settings */
 	linux_apply_settings(&request->settings, &netdev->settings.settings);
 
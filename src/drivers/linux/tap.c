@@ -40,6 +40,15 @@
 
 #define RX_BUF_SIZE 1536
 
+/** Maximum number of packets received per poll
+ *
+ * A TAP device is a character device rather than a socket, and so
+ * cannot use recvmmsg().  Reading directly from the non-blocking
+ * descriptor (without a preceding poll()) costs exactly one system
+ * call per packet plus one to discover that the queue is empty.
+ */
+#define TAP_RX_BATCH 64
+
 /** @file
  *
  * The TAP driver.
@@ -124,37 +133,27 @@ static int tap_transmit(struct net_device *netdev, struct io_buffer *iobuf)
 static void tap_poll(struct net_device *netdev)
 {
 	struct tap_nic * nic = netdev->priv;
-	struct pollfd pfd;
 	struct io_buffer * iobuf;
+	unsigned int count;
 	int r;
 
-	pfd.fd = nic->fd;
-	pfd.events = POLLIN;
-	if (linux_poll(&pfd, 1, 0) == -1) {
-		DBGC(nic, "tap %p poll failed (%s)\n", nic, linux_strerror(linux_errno));
-		return;
-	}
-	if ((pfd.revents & POLLIN) == 0)
-		return;
+	for (count = 0; count < TAP_RX_BATCH; count++) {
 
-	/* At this point we know there is at least one new packet to be read */
-
-	iobuf = alloc_iob(RX_BUF_SIZE);
-	if (! iobuf)
-		goto allocfail;
+		iobuf = alloc_iob(RX_BUF_SIZE);
+		if (! iobuf)
+			goto allocfail;
 
-	while ((r = linux_read(nic->fd, iobuf->data, RX_BUF_SIZE)) > 0) {
+		/* Non-blocking read fails if no packet is waiting */
+		r = linux_read(nic->fd, iobuf->data, RX_BUF_SIZE);
+		if (r <= 0) {
+			free_iob(iobuf);
+			return;
+		}
 		DBGC2(nic, "tap %p read %d bytes\n", nic, r);
 
 		iob_put(iobuf, r);
 		netdev_rx(netdev, iobuf);
-
-		iobuf = alloc_iob(RX_BUF_SIZE);
-		if (! iobuf)
-			goto allocfail;
 	}
-
-	free_iob(iobuf);
 	return;
 
 allocfail:
@@ -647,6 +647,7 @@ static int axge_probe ( struct usb_function *func,
 	}
 	netdev_init ( netdev, &axge_operations );
 	netdev->dev = &func->dev;
+	netdev->tx_headroom = sizeof ( struct axge_tx_header );
 	axge = netdev->priv;
 	memset ( axge, 0, sizeof ( *axge ) );
 	axge->usb = usb;
@@ -156,7 +156,7 @@ struct axge_device {
  *
  * This is a policy decision.
  */
-#define AXGE_IN_MAX_FILL 8
+#define AXGE_IN_MAX_FILL 16
 
 /** Bulk IN buffer size
  *
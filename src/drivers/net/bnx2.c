@@ -2348,15 +2348,16 @@ static void
 bnx2_transmit(struct nic *nic, const char *dst_addr,
 		unsigned int type, unsigned int size, const char *packet)
 {
-	/* Sometimes the nic will be behind by a frame.  Using two transmit
-	 * buffers prevents us from timing out in that case.
+	/* Use several transmit buffers, so that we need to wait for the
+	 * nic only when it is more than a few frames behind.  Completion
+	 * is tracked via the status block rather than register reads.
 	 */
 	static struct eth_frame {
 		uint8_t  dst_addr[ETH_ALEN];
 		uint8_t  src_addr[ETH_ALEN];
 		uint16_t type;
 		uint8_t  data [ETH_FRAME_LEN - ETH_HLEN];
-	} frame[2];
+	} frame[TX_FRAME_CNT];
 	static int frame_idx = 0;
 	
 	/* send the packet to destination */
@@ -2368,12 +2369,17 @@ bnx2_transmit(struct nic *nic, const char *dst_addr,
 
 	prod = bp->tx_prod;
 	ring_prod = TX_RING_IDX(prod);
-	hw_cons = bp->status_blk->status_tx_quick_consumer_index0;
-	if ((hw_cons & MAX_TX_DESC_CNT) == MAX_TX_DESC_CNT) {
-		hw_cons++;
-	}
 
-	while((hw_cons != prod) && (hw_cons != (PREV_TX_BD(prod)))) {
+	/* The distance may include the skipped next-page entry, which
+	 * errs on the side of waiting.
+	 */
+	while (1) {
+		hw_cons = bp->status_blk->status_tx_quick_consumer_index0;
+		if ((hw_cons & MAX_TX_DESC_CNT) == MAX_TX_DESC_CNT) {
+			hw_cons++;
+		}
+		if ((u16)(prod - hw_cons) < TX_FRAME_CNT)
+			break;
 		mdelay(10);	/* give the nic a chance */
 		//poll_interruptions();
 		if (++i > 500) { /* timeout 5s for transmit */
@@ -2403,7 +2409,7 @@ bnx2_transmit(struct nic *nic, const char *dst_addr,
 
 	/* Advance to the next entry */
 	prod = NEXT_TX_BD(prod);
-	frame_idx ^= 1;
+	frame_idx = ((frame_idx + 1) % TX_FRAME_CNT);
 
 	bp->tx_prod_bseq += (size + ETH_HLEN);
 
@@ -4585,7 +4585,12 @@ struct fw_info {
 
 #define RX_OFFSET		(sizeof(struct l2_fhdr) + 2)
 
-#define RX_BUF_CNT		20
+#define RX_BUF_CNT		32
+
+/* Number of transmit frame buffers.  Transmission waits only when all
+ * of these are still owned by the NIC.
+ */
+#define TX_FRAME_CNT		8
 
 /* 8 for CRC and VLAN */
 #define RX_BUF_USE_SIZE		(ETH_MAX_MTU + ETH_HLEN + RX_OFFSET + 8)
@@ -525,6 +525,7 @@ static int dm96xx_probe ( struct usb_function *func,
 	}
 	netdev_init ( netdev, &dm96xx_operations );
 	netdev->dev = &func->dev;
+	netdev->tx_headroom = sizeof ( struct dm96xx_tx_header );
 	dm96xx = netdev->priv;
 	memset ( dm96xx, 0, sizeof ( *dm96xx ) );
 	dm96xx->usb = usb;
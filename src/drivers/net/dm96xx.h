@@ -184,7 +184,7 @@ dm96xx_write_register ( struct dm96xx_device *dm96xx, unsigned int offset,
  *
  * This is a policy decision.
  */
-#define DM96XX_IN_MAX_FILL 8
+#define DM96XX_IN_MAX_FILL 16
 
 /** Bulk IN buffer size */
 #define DM96XX_IN_MTU					\
@@ -75,7 +75,7 @@ struct ecm_device {
  *
  * This is a policy decision.
  */
-#define ECM_IN_MAX_FILL 8
+#define ECM_IN_MAX_FILL 16
 
 /** Bulk IN buffer size
  *
@@ -137,6 +137,13 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 #define PCI_MAX_BAR 6
 
+/** Maximum number of outstanding transmissions
+ *
+ * This must not exceed MAX_XMIT_BUFFERS, so that a single status
+ * request can report all completions.
+ */
+#define NII_NUM_TX 16
+
 /** An NII NIC */
 struct nii_nic {
 	/** EFI device */
@@ -175,14 +182,16 @@ struct nii_nic {
 	/** Media status is supported */
 	int media;
 
-	/** Current transmit buffer */
-	struct io_buffer *txbuf;
+	/** Transmit buffers */
+	struct io_buffer *txbuf[NII_NUM_TX];
+	/** Number of transmit buffers in use */
+	unsigned int tx_fill;
 	/** Current receive buffer */
 	struct io_buffer *rxbuf;
 };
 
 /** Maximum number of received packets per poll */
-#define NII_RX_QUOTA 4
+#define NII_RX_QUOTA 32
 
 /**
  * Open PCI I/O protocol and identify BARs
@@ -796,15 +805,19 @@ static int nii_transmit ( struct net_device *netdev,
 	struct nii_nic *nii = netdev->priv;
 	PXE_CPB_TRANSMIT cpb;
 	unsigned int op;
+	unsigned int i;
 	int stat;
 	int rc;
 
-	/* Defer the packet if there is already a transmission in progress */
-	if ( nii->txbuf ) {
+	/* Defer the packet if there are too many transmissions in progress */
+	if ( nii->tx_fill >= NII_NUM_TX ) {
 		netdev_tx_defer ( netdev, iobuf );
 		return 0;
 	}
 
+	/* Find a free transmit buffer slot */
+	for ( i = 0 ; nii->txbuf[i] ; i++ ) {}
+
 	/* Construct parameter block */
 	memset ( &cpb, 0, sizeof ( cpb ) );
 	cpb.FrameAddr = virt_to_bus ( iobuf->data );
@@ -816,12 +829,22 @@ static int nii_transmit ( struct net_device *netdev,
 		      ( PXE_OPFLAGS_TRANSMIT_WHOLE |
 			PXE_OPFLAGS_TRANSMIT_DONT_BLOCK ) );
 	if ( ( stat = nii_issue_cpb ( nii, op, &cpb, sizeof ( cpb ) ) ) < 0 ) {
+
+		/* Defer the packet if the UNDI transmit queue is
+		 * full; it will be retried on the next completion.
+		 */
+		if ( ( stat == -PXE_STATCODE_QUEUE_FULL ) && nii->tx_fill ) {
+			netdev_tx_defer ( netdev, iobuf );
+			return 0;
+		}
+
 		rc = -EIO_STAT ( stat );
 		DBGC ( nii, "NII %s could not transmit: %s\n",
 		       nii->dev.name, strerror ( rc ) );
 		return rc;
 	}
-	nii->txbuf = iobuf;
+	nii->txbuf[i] = iobuf;
+	nii->tx_fill++;
 
 	return 0;
 }
@@ -831,22 +854,42 @@ static int nii_transmit ( struct net_device *netdev,
  *
  * @v netdev		Network device
  * @v stat		Status flags
+ * @v db		Status data block
  */
-static void nii_poll_tx ( struct net_device *netdev, unsigned int stat ) {
+static void nii_poll_tx ( struct net_device *netdev, unsigned int stat,
+			  PXE_DB_GET_STATUS *db ) {
 	struct nii_nic *nii = netdev->priv;
 	struct io_buffer *iobuf;
+	physaddr_t addr;
+	unsigned int i;
+	unsigned int j;
 
 	/* Do nothing unless we have a completion */
 	if ( stat & PXE_STATFLAGS_GET_STATUS_NO_TXBUFS_WRITTEN )
 		return;
 
-	/* Sanity check */
-	assert ( nii->txbuf != NULL );
+	/* Complete each reported transmission */
+	for ( i = 0 ; ( i < MAX_XMIT_BUFFERS ) && db->TxBuffer[i] ; i++ ) {
 
-	/* Complete transmission */
-	iobuf = nii->txbuf;
-	nii->txbuf = NULL;
-	netdev_tx_complete ( netdev, iobuf );
+		/* Identify completed transmit buffer */
+		addr = db->TxBuffer[i];
+		for ( j = 0 ; j < NII_NUM_TX ; j++ ) {
+			iobuf = nii->txbuf[j];
+			if ( iobuf && ( virt_to_bus ( iobuf->data ) == addr ) )
+				break;
+		}
+		if ( j >= NII_NUM_TX ) {
+			DBGC ( nii, "NII %s reported spurious TX completion\n",
+			       nii->dev.name );
+			netdev_tx_err ( netdev, NULL, -EPIPE );
+			continue;
+		}
+
+		/* Complete transmission */
+		nii->txbuf[j] = NULL;
+		nii->tx_fill--;
+		netdev_tx_complete ( netdev, iobuf );
+	}
 }
 
 /**
@@ -939,7 +982,8 @@ static void nii_poll ( struct net_device *netdev ) {
 	/* Get status */
 	op = NII_OP ( PXE_OPCODE_GET_STATUS,
 		      ( PXE_OPFLAGS_GET_INTERRUPT_STATUS |
-			( nii->txbuf ? PXE_OPFLAGS_GET_TRANSMITTED_BUFFERS : 0)|
+			( nii->tx_fill ?
+			  PXE_OPFLAGS_GET_TRANSMITTED_BUFFERS : 0 ) |
 			( nii->media ? PXE_OPFLAGS_GET_MEDIA_STATUS : 0 ) ) );
 	if ( ( stat = nii_issue_db ( nii, op, &db, sizeof ( db ) ) ) < 0 ) {
 		rc = -EIO_STAT ( stat );
@@ -949,8 +993,8 @@ static void nii_poll ( struct net_device *netdev ) {
 	}
 
 	/* Process any TX completions */
-	if ( nii->txbuf )
-		nii_poll_tx ( netdev, stat );
+	if ( nii->tx_fill )
+		nii_poll_tx ( netdev, stat, &db );
 
 	/* Process any RX completions */
 	nii_poll_rx ( netdev );
@@ -1010,15 +1054,20 @@ static int nii_open ( struct net_device *netdev ) {
  */
 static void nii_close ( struct net_device *netdev ) {
 	struct nii_nic *nii = netdev->priv;
+	unsigned int i;
 
 	/* Shut down NIC */
 	nii_shutdown ( nii );
 
-	/* Discard transmit buffer, if applicable */
-	if ( nii->txbuf ) {
-		netdev_tx_complete_err ( netdev, nii->txbuf, -ECANCELED );
-		nii->txbuf = NULL;
+	/* Discard transmit buffers, if applicable */
+	for ( i = 0 ; i < NII_NUM_TX ; i++ ) {
+		if ( nii->txbuf[i] ) {
+			netdev_tx_complete_err ( netdev, nii->txbuf[i],
+						 -ECANCELED );
+			nii->txbuf[i] = NULL;
+		}
 	}
+	nii->tx_fill = 0;
 
 	/* Discard receive buffer, if applicable */
 	if ( nii->rxbuf ) {
@@ -39,6 +39,13 @@ FILE_LICENCE ( GPL2_OR_LATER );
  *
  */
 
+/** Maximum number of outstanding transmissions
+ *
+ * This applies only if the SNP driver reports that it supports
+ * queueing multiple transmissions.
+ */
+#define SNP_NUM_TX 16
+
 /** An SNP NIC */
 struct snp_nic {
 	/** EFI device */
@@ -55,14 +62,18 @@ struct snp_nic {
 	 */
 	size_t mtu;
 
-	/** Current transmit buffer */
-	struct io_buffer *txbuf;
+	/** Transmit buffers */
+	struct io_buffer *txbuf[SNP_NUM_TX];
+	/** Number of transmit buffers in use */
+	unsigned int tx_fill;
+	/** Maximum number of transmit buffers in use */
+	unsigned int tx_max;
 	/** Current receive buffer */
 	struct io_buffer *rxbuf;
 };
 
 /** Maximum number of received packets per poll */
-#define SNP_RX_QUOTA 4
+#define SNP_RX_QUOTA 32
 
 /**
  * Format SNP MAC address (for debugging)
@@ -154,15 +165,19 @@ static void snpnet_check_link ( struct net_device *netdev ) {
 static int snpnet_transmit ( struct net_device *netdev,
 			     struct io_buffer *iobuf ) {
 	struct snp_nic *snp = netdev_priv ( netdev );
+	unsigned int i;
 	EFI_STATUS efirc;
 	int rc;
 
-	/* Defer the packet if there is already a transmission in progress */
-	if ( snp->txbuf ) {
+	/* Defer the packet if there are too many transmissions in progress */
+	if ( snp->tx_fill >= snp->tx_max ) {
 		netdev_tx_defer ( netdev, iobuf );
 		return 0;
 	}
 
+	/* Find a free transmit buffer slot */
+	for ( i = 0 ; snp->txbuf[i] ; i++ ) {}
+
 	/* Transmit packet */
 	if ( ( efirc = snp->snp->Transmit ( snp->snp, 0, iob_len ( iobuf ),
 					    iobuf->data, NULL, NULL,
@@ -172,7 +187,8 @@ static int snpnet_transmit ( struct net_device *netdev,
 		       netdev->name, strerror ( rc ) );
 		return rc;
 	}
-	snp->txbuf = iobuf;
+	snp->txbuf[i] = iobuf;
+	snp->tx_fill++;
 
 	return 0;
 }
@@ -185,37 +201,52 @@ static int snpnet_transmit ( struct net_device *netdev,
 static void snpnet_poll_tx ( struct net_device *netdev ) {
 	struct snp_nic *snp = netdev->priv;
 	struct io_buffer *iobuf;
+	unsigned int quota;
+	unsigned int i;
 	UINT32 irq;
 	VOID *txbuf;
 	EFI_STATUS efirc;
 	int rc;
 
-	/* Get status */
-	txbuf = NULL;
-	if ( ( efirc = snp->snp->GetStatus ( snp->snp, &irq, &txbuf ) ) != 0 ) {
-		rc = -EEFI ( efirc );
-		DBGC ( snp, "SNP %s could not get status: %s\n",
-		       netdev->name, strerror ( rc ) );
-		netdev_rx_err ( netdev, NULL, rc );
-		return;
-	}
+	/* Retrieve all available completions (and at least the
+	 * interrupt status, even if no transmissions are in progress).
+	 */
+	quota = snp->tx_fill;
+	do {
+		/* Get status */
+		txbuf = NULL;
+		if ( ( efirc = snp->snp->GetStatus ( snp->snp, &irq,
+						     &txbuf ) ) != 0 ) {
+			rc = -EEFI ( efirc );
+			DBGC ( snp, "SNP %s could not get status: %s\n",
+			       netdev->name, strerror ( rc ) );
+			netdev_rx_err ( netdev, NULL, rc );
+			return;
+		}
 
-	/* Do nothing unless we have a completion */
-	if ( ! txbuf )
-		return;
+		/* Stop when there are no more completions */
+		if ( ! txbuf )
+			return;
 
-	/* Sanity check */
-	if ( ! snp->txbuf ) {
-		DBGC ( snp, "SNP %s reported spurious TX completion\n",
-		       netdev->name );
-		netdev_tx_err ( netdev, NULL, -EPIPE );
-		return;
-	}
+		/* Identify completed transmit buffer */
+		for ( i = 0 ; i < SNP_NUM_TX ; i++ ) {
+			if ( snp->txbuf[i] && ( snp->txbuf[i]->data == txbuf ) )
+				break;
+		}
+		if ( i >= SNP_NUM_TX ) {
+			DBGC ( snp, "SNP %s reported spurious TX completion\n",
+			       netdev->name );
+			netdev_tx_err ( netdev, NULL, -EPIPE );
+			return;
+		}
+
+		/* Complete transmission */
+		iobuf = snp->txbuf[i];
+		snp->txbuf[i] = NULL;
+		snp->tx_fill--;
+		netdev_tx_complete ( netdev, iobuf );
 
-	/* Complete transmission */
-	iobuf = snp->txbuf;
-	snp->txbuf = NULL;
-	netdev_tx_complete ( netdev, iobuf );
+	} while ( quota-- );
 }
 
 /**
@@ -364,6 +395,9 @@ static int snpnet_open ( struct net_device *netdev ) {
 		/* Ignore error */
 	}
 
+	/* Allow multiple transmissions to be queued, if supported */
+	snp->tx_max = ( snp->snp->Mode->MultipleTxSupported ? SNP_NUM_TX : 1 );
+
 	/* Dump mode information (for debugging) */
 	snpnet_dump_mode ( netdev );
 
@@ -377,6 +411,7 @@ static int snpnet_open ( struct net_device *netdev ) {
  */
 static void snpnet_close ( struct net_device *netdev ) {
 	struct snp_nic *snp = netdev->priv;
+	unsigned int i;
 	EFI_STATUS efirc;
 	int rc;
 
@@ -388,11 +423,15 @@ static void snpnet_close ( struct net_device *netdev ) {
 		/* Nothing we can do about this */
 	}
 
-	/* Discard transmit buffer, if applicable */
-	if ( snp->txbuf ) {
-		netdev_tx_complete_err ( netdev, snp->txbuf, -ECANCELED );
-		snp->txbuf = NULL;
+	/* Discard transmit buffers, if applicable */
+	for ( i = 0 ; i < SNP_NUM_TX ; i++ ) {
+		if ( snp->txbuf[i] ) {
+			netdev_tx_complete_err ( netdev, snp->txbuf[i],
+						 -ECANCELED );
+			snp->txbuf[i] = NULL;
+		}
 	}
+	snp->tx_fill = 0;
 
 	/* Discard receive buffer, if applicable */
 	if ( snp->rxbuf ) {
@@ -35,6 +35,8 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/malloc.h>
 #include <ipxe/pci.h>
 #include <ipxe/profile.h>
+#include <ipxe/vlan.h>
+#include <ipxe/trace.h>
 #include "intel.h"
 
 /** @file
@@ -563,17 +565,17 @@ void intel_refill_rx ( struct intel_nic *intel ) {
 	unsigned int refilled = 0;
 
 	/* Refill ring */
-	while ( ( intel->rx.prod - intel->rx.cons ) < INTEL_RX_FILL ) {
+	while ( ( intel->rx.prod - intel->rx.cons ) < intel->rx.fill ) {
 
 		/* Allocate I/O buffer */
-		iobuf = alloc_iob ( INTEL_RX_MAX_LEN );
+		iobuf = alloc_rx_iob ( INTEL_RX_MAX_LEN );
 		if ( ! iobuf ) {
 			/* Wait for next refill */
 			break;
 		}
 
 		/* Get next receive descriptor */
-		rx_idx = ( intel->rx.prod++ % INTEL_NUM_RX_DESC );
+		rx_idx = ( intel->rx.prod++ % intel->rx.count );
 		rx = &intel->rx.desc[rx_idx];
 
 		/* Populate receive descriptor */
@@ -593,7 +595,7 @@ void intel_refill_rx ( struct intel_nic *intel ) {
 	/* Push descriptors to card, if applicable */
 	if ( refilled ) {
 		wmb();
-		rx_tail = ( intel->rx.prod % INTEL_NUM_RX_DESC );
+		rx_tail = ( intel->rx.prod % intel->rx.count );
 		profile_start ( &intel_vm_refill_profiler );
 		writel ( rx_tail, intel->regs + intel->rx.reg + INTEL_xDT );
 		profile_stop ( &intel_vm_refill_profiler );
@@ -609,7 +611,7 @@ void intel_refill_rx ( struct intel_nic *intel ) {
 void intel_empty_rx ( struct intel_nic *intel ) {
 	unsigned int i;
 
-	for ( i = 0 ; i < INTEL_NUM_RX_DESC ; i++ ) {
+	for ( i = 0 ; i < intel->rx.count ; i++ ) {
 		if ( intel->rx_iobuf[i] )
 			free_iob ( intel->rx_iobuf[i] );
 		intel->rx_iobuf[i] = NULL;
@@ -627,6 +629,8 @@ static int intel_open ( struct net_device *netdev ) {
 	union intel_receive_address mac;
 	uint32_t tctl;
 	uint32_t rctl;
+	uint32_t rxcsum;
+	uint32_t ctrl;
 	int rc;
 
 	/* Create transmit descriptor ring */
@@ -658,7 +662,23 @@ static int intel_open ( struct net_device *netdev ) {
 		  INTEL_RCTL_BAM | INTEL_RCTL_BSIZE_2048 | INTEL_RCTL_SECRC );
 	writel ( rctl, intel->regs + INTEL_RCTL );
 
+	/* Enable receive checksum offload, if applicable */
+	if ( netdev->state & NETDEV_RX_CSUM ) {
+		rxcsum = readl ( intel->regs + INTEL_RXCSUM );
+		rxcsum |= ( INTEL_RXCSUM_IPOFL | INTEL_RXCSUM_TUOFL );
+		writel ( rxcsum, intel->regs + INTEL_RXCSUM );
+	}
+
+	/* Enable VLAN tag insertion and stripping, if applicable */
+	if ( netdev->state & NETDEV_RX_VLAN ) {
+		ctrl = readl ( intel->regs + INTEL_CTRL );
+		ctrl |= INTEL_CTRL_VME;
+		writel ( ctrl, intel->regs + INTEL_CTRL );
+	}
+
 	/* Fill receive ring */
+	intel->rx.fill = netdev_rx_fill ( netdev, INTEL_RX_FILL,
+					  INTEL_RX_MAX_LEN );
 	intel_refill_rx ( intel );
 
 	/* Update link state */
@@ -720,21 +740,33 @@ int intel_transmit ( struct net_device *netdev, struct io_buffer *iobuf ) {
 	unsigned int tx_idx;
 	unsigned int tx_tail;
 	physaddr_t address;
+	size_t start;
 	size_t len;
 
 	/* Get next transmit descriptor */
-	if ( ( intel->tx.prod - intel->tx.cons ) >= INTEL_TX_FILL ) {
+	if ( ( intel->tx.prod - intel->tx.cons ) >= ( intel->tx.count - 1 ) ) {
 		DBGC ( intel, "INTEL %p out of transmit descriptors\n", intel );
 		return -ENOBUFS;
 	}
-	tx_idx = ( intel->tx.prod++ % INTEL_NUM_TX_DESC );
-	tx_tail = ( intel->tx.prod % INTEL_NUM_TX_DESC );
+	tx_idx = ( intel->tx.prod++ % intel->tx.count );
+	tx_tail = ( intel->tx.prod % intel->tx.count );
 	tx = &intel->tx.desc[tx_idx];
 
 	/* Populate transmit descriptor */
 	address = virt_to_bus ( iobuf->data );
 	len = iob_len ( iobuf );
 	intel->tx.describe ( tx, address, len );
+	if ( iobuf->flags & IOB_FL_CSUM_OFFLOAD ) {
+		start = iob_csum_start ( iobuf );
+		tx->flags = ( start + iobuf->csum_offset );
+		tx->command |= INTEL_DESC_CMD_IC;
+		tx->status |= cpu_to_le32 ( INTEL_DESC_STATUS_CSS ( start ) );
+	}
+	if ( iobuf->flags & IOB_FL_VLAN ) {
+		tx->command |= INTEL_DESC_CMD_VLE;
+		tx->status |= cpu_to_le32 ( INTEL_DESC_STATUS_VLAN
+					    ( iobuf->vlan_tci ) );
+	}
 	wmb();
 
 	/* Notify card that there are packets ready to transmit */
@@ -764,7 +796,7 @@ void intel_poll_tx ( struct net_device *netdev ) {
 	while ( intel->tx.cons != intel->tx.prod ) {
 
 		/* Get next transmit descriptor */
-		tx_idx = ( intel->tx.cons % INTEL_NUM_TX_DESC );
+		tx_idx = ( intel->tx.cons % intel->tx.count );
 		tx = &intel->tx.desc[tx_idx];
 
 		/* Stop if descriptor is still in use */
@@ -772,6 +804,7 @@ void intel_poll_tx ( struct net_device *netdev ) {
 			return;
 
 		DBGC2 ( intel, "INTEL %p TX %d complete\n", intel, tx_idx );
+		TRACE ( "intel_tx_complete", intel, tx_idx );
 
 		/* Complete TX descriptor */
 		netdev_tx_complete_next ( netdev );
@@ -789,13 +822,16 @@ void intel_poll_rx ( struct net_device *netdev ) {
 	struct intel_descriptor *rx;
 	struct io_buffer *iobuf;
 	unsigned int rx_idx;
+	unsigned int received = 0;
+	unsigned int tag;
+	uint32_t status;
 	size_t len;
 
 	/* Check for received packets */
 	while ( intel->rx.cons != intel->rx.prod ) {
 
 		/* Get next receive descriptor */
-		rx_idx = ( intel->rx.cons % INTEL_NUM_RX_DESC );
+		rx_idx = ( intel->rx.cons % intel->rx.count );
 		rx = &intel->rx.desc[rx_idx];
 
 		/* Stop if descriptor is still in use */
@@ -807,6 +843,25 @@ void intel_poll_rx ( struct net_device *netdev ) {
 		intel->rx_iobuf[rx_idx] = NULL;
 		len = le16_to_cpu ( rx->length );
 		iob_put ( iobuf, len );
+		TRACE ( "intel_rx_complete", intel, rx_idx );
+
+		/* Record hardware checksum verification, if applicable.
+		 * Checksum errors reported by the hardware are not
+		 * treated as fatal: the packet is instead left for
+		 * verification in software.  This ensures that UDP
+		 * datagrams with a zero (i.e. absent) checksum are
+		 * still accepted, even if the hardware reports an
+		 * error for them.
+		 */
+		status = le32_to_cpu ( rx->status );
+		if ( ( netdev->state & NETDEV_RX_CSUM ) &&
+		     ( status & ( INTEL_DESC_STATUS_TCPCS |
+				  INTEL_DESC_STATUS_UDPCS ) ) &&
+		     ! ( status & ( INTEL_DESC_STATUS_IXSM |
+				    INTEL_DESC_STATUS_TCPE |
+				    INTEL_DESC_STATUS_IPE ) ) ) {
+			iobuf->flags |= IOB_FL_CSUM_VERIFIED;
+		}
 
 		/* Hand off to network stack */
 		if ( rx->status & cpu_to_le32 ( INTEL_DESC_STATUS_RXE ) ) {
@@ -814,13 +869,24 @@ void intel_poll_rx ( struct net_device *netdev ) {
 			       "status %08x)\n", intel, rx_idx, len,
 			       le32_to_cpu ( rx->status ) );
 			netdev_rx_err ( netdev, iobuf, -EIO );
+		} else if ( ( netdev->state & NETDEV_RX_VLAN ) &&
+			    ( status & INTEL_DESC_STATUS_VP ) ) {
+			tag = VLAN_TAG ( INTEL_DESC_STATUS_VLAN_TCI ( status ) );
+			DBGC2 ( intel, "INTEL %p RX %d complete (length %zd, "
+				"tag %d)\n", intel, rx_idx, len, tag );
+			vlan_netdev_rx ( netdev, tag, iobuf );
 		} else {
 			DBGC2 ( intel, "INTEL %p RX %d complete (length %zd)\n",
 				intel, rx_idx, len );
 			netdev_rx ( netdev, iobuf );
 		}
 		intel->rx.cons++;
+		received++;
 	}
+
+	/* Record overflow if all posted buffers were consumed */
+	if ( received )
+		netdev_rx_overflow ( netdev );
 }
 
 /**
@@ -950,6 +1016,12 @@ static int intel_probe ( struct pci_device *pci ) {
 	if ( ( rc = intel_fetch_mac ( intel, netdev->hw_addr ) ) != 0 )
 		goto err_fetch_mac;
 
+	/* Legacy descriptors support transport-layer checksum offload
+	 * and VLAN tag insertion and stripping.
+	 */
+	netdev->state |= ( NETDEV_TX_CSUM | NETDEV_RX_CSUM |
+			   NETDEV_TX_VLAN | NETDEV_RX_VLAN );
+
 	/* Register network device */
 	if ( ( rc = register_netdev ( netdev ) ) != 0 )
 		goto err_register_netdev;
@@ -40,6 +40,12 @@ struct intel_descriptor {
 /** Report status */
 #define INTEL_DESC_CMD_RS 0x08
 
+/** Insert VLAN tag (legacy transmit descriptor) */
+#define INTEL_DESC_CMD_VLE 0x40
+
+/** Insert checksum (legacy transmit descriptor) */
+#define INTEL_DESC_CMD_IC 0x04
+
 /** Insert frame checksum (CRC) */
 #define INTEL_DESC_CMD_IFCS 0x02
 
@@ -49,9 +55,36 @@ struct intel_descriptor {
 /** Descriptor done */
 #define INTEL_DESC_STATUS_DD 0x00000001UL
 
+/** Ignore checksum indication (legacy receive descriptor) */
+#define INTEL_DESC_STATUS_IXSM 0x00000004UL
+
+/** VLAN tag stripped (legacy receive descriptor) */
+#define INTEL_DESC_STATUS_VP 0x00000008UL
+
+/** UDP checksum calculated (legacy receive descriptor) */
+#define INTEL_DESC_STATUS_UDPCS 0x00000010UL
+
+/** TCP checksum calculated (legacy receive descriptor) */
+#define INTEL_DESC_STATUS_TCPCS 0x00000020UL
+
 /** Receive error */
 #define INTEL_DESC_STATUS_RXE 0x00000100UL
 
+/** TCP/UDP checksum error (legacy receive descriptor) */
+#define INTEL_DESC_STATUS_TCPE 0x00002000UL
+
+/** IPv4 header checksum error (legacy receive descriptor) */
+#define INTEL_DESC_STATUS_IPE 0x00004000UL
+
+/** Checksum start (legacy transmit descriptor) */
+#define INTEL_DESC_STATUS_CSS( start ) ( (start) << 8 )
+
+/** VLAN tag control information (legacy descriptors) */
+#define INTEL_DESC_STATUS_VLAN( tci ) ( (tci) << 16 )
+
+/** Extract VLAN tag control information (legacy receive descriptor) */
+#define INTEL_DESC_STATUS_VLAN_TCI( status ) ( (status) >> 16 )
+
 /** Payload length */
 #define INTEL_DESC_STATUS_PAYLEN( len ) ( (len) << 14 )
 
@@ -63,6 +96,7 @@ struct intel_descriptor {
 #define INTEL_CTRL_FRCSPD	0x00000800UL	/**< Force speed */
 #define INTEL_CTRL_FRCDPLX	0x00001000UL	/**< Force duplex */
 #define INTEL_CTRL_RST		0x04000000UL	/**< Device reset */
+#define INTEL_CTRL_VME		0x40000000UL	/**< VLAN mode enable */
 #define INTEL_CTRL_PHY_RST	0x80000000UL	/**< PHY reset */
 
 /** Time to delay for device reset, in milliseconds */
@@ -134,6 +168,11 @@ struct intel_descriptor {
 /** Packet Buffer Allocation */
 #define INTEL_PBA 0x01000UL
 
+/** Receive Checksum Control Register */
+#define INTEL_RXCSUM 0x05000UL
+#define INTEL_RXCSUM_IPOFL	0x00000100UL	/**< IP checksum offload */
+#define INTEL_RXCSUM_TUOFL	0x00000200UL	/**< TCP/UDP checksum offload */
+
 /** Packet Buffer Size */
 #define INTEL_PBS 0x01008UL
 
@@ -145,10 +184,13 @@ struct intel_descriptor {
  * Minimum value is 8, since the descriptor ring length must be a
  * multiple of 128.
  */
-#define INTEL_NUM_RX_DESC 16
+#define INTEL_NUM_RX_DESC 64
+
+/** Receive descriptor ring maximum fill level */
+#define INTEL_RX_FILL ( INTEL_NUM_RX_DESC - 1 )
 
-/** Receive descriptor ring fill level */
-#define INTEL_RX_FILL 8
+/** Maximum number of receive descriptors supported by any variant */
+#define INTEL_MAX_RX_DESC 256
 
 /** Receive buffer length */
 #define INTEL_RX_MAX_LEN 2048
@@ -161,7 +203,7 @@ struct intel_descriptor {
  * Descriptor ring length must be a multiple of 16.  ICH8/9/10
  * requires a minimum of 16 TX descriptors.
  */
-#define INTEL_NUM_TX_DESC 16
+#define INTEL_NUM_TX_DESC 64
 
 /** Transmit descriptor ring maximum fill level */
 #define INTEL_TX_FILL ( INTEL_NUM_TX_DESC - 1 )
@@ -212,6 +254,10 @@ struct intel_ring {
 	unsigned int prod;
 	/** Consumer index */
 	unsigned int cons;
+	/** Fill level */
+	unsigned int fill;
+	/** Number of descriptors */
+	unsigned int count;
 
 	/** Register block */
 	unsigned int reg;
@@ -241,6 +287,7 @@ intel_init_ring ( struct intel_ring *ring, unsigned int count, unsigned int reg,
 		  void ( * describe ) ( struct intel_descriptor *desc,
 					physaddr_t addr, size_t len ) ) {
 
+	ring->count = count;
 	ring->len = ( count * sizeof ( ring->desc[0] ) );
 	ring->reg = reg;
 	ring->describe = describe;
@@ -295,7 +342,7 @@ struct intel_nic {
 	/** Receive descriptor ring */
 	struct intel_ring rx;
 	/** Receive I/O buffers */
-	struct io_buffer *rx_iobuf[INTEL_NUM_RX_DESC];
+	struct io_buffer *rx_iobuf[INTEL_MAX_RX_DESC];
 };
 
 /** Driver flags */
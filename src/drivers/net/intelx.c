@@ -257,6 +257,8 @@ static int intelx_open ( struct net_device *netdev ) {
 	writel ( rxctrl, intel->regs + INTELX_RXCTRL );
 
 	/* Fill receive ring */
+	intel->rx.fill = netdev_rx_fill ( netdev, INTELX_RX_FILL,
+					  INTEL_RX_MAX_LEN );
 	intel_refill_rx ( intel );
 
 	/* Update link state */
@@ -396,9 +398,9 @@ static int intelx_probe ( struct pci_device *pci ) {
 	netdev->dev = &pci->dev;
 	memset ( intel, 0, sizeof ( *intel ) );
 	intel->port = PCI_FUNC ( pci->busdevfn );
-	intel_init_ring ( &intel->tx, INTEL_NUM_TX_DESC, INTELX_TD,
+	intel_init_ring ( &intel->tx, INTELX_NUM_TX_DESC, INTELX_TD,
 			  intel_describe_tx );
-	intel_init_ring ( &intel->rx, INTEL_NUM_RX_DESC, INTELX_RD,
+	intel_init_ring ( &intel->rx, INTELX_NUM_RX_DESC, INTELX_RD,
 			  intel_describe_rx );
 
 	/* Fix up PCI device */
@@ -71,6 +71,18 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Receive Descriptor register block */
 #define INTELX_RD 0x01000UL
 
+/** Number of receive descriptors
+ *
+ * A 10Gbps link can fill the shared default ring within a fraction
+ * of a millisecond, so we use a deeper ring.  Must be a multiple of
+ * 8 (since the ring length must be a multiple of 128 bytes), and no
+ * greater than INTEL_MAX_RX_DESC.
+ */
+#define INTELX_NUM_RX_DESC 256
+
+/** Receive descriptor ring maximum fill level */
+#define INTELX_RX_FILL ( INTELX_NUM_RX_DESC - 1 )
+
 /** Receive Descriptor Control Register */
 #define INTELX_RXDCTL_VME	0x40000000UL	/**< Strip VLAN tag */
 
@@ -95,6 +107,13 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Transmit Descriptor register block */
 #define INTELX_TD 0x06000UL
 
+/** Number of transmit descriptors
+ *
+ * Must be a multiple of 8 (since the ring length must be a multiple
+ * of 128 bytes).
+ */
+#define INTELX_NUM_TX_DESC 128
+
 /** RX DCA Control Register */
 #define INTELX_DCA_RXCTRL 0x02200UL
 #define INTELX_DCA_RXCTRL_MUST_BE_ZERO 0x00001000UL /**< Must be zero */
@@ -310,6 +310,8 @@ static int intelxvf_open ( struct net_device *netdev ) {
 	writel ( dca_rxctrl, intel->regs + INTELXVF_DCA_RXCTRL );
 
 	/* Fill receive ring */
+	intel->rx.fill = netdev_rx_fill ( netdev, INTEL_RX_FILL,
+					  INTEL_RX_MAX_LEN );
 	intel_refill_rx ( intel );
 
 	/* Update link state */
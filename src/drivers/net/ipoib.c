@@ -28,6 +28,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <strings.h>
 #include <byteswap.h>
 #include <errno.h>
 #include <ipxe/errortab.h>
@@ -42,6 +43,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/infiniband.h>
 #include <ipxe/ib_pathrec.h>
 #include <ipxe/ib_mcast.h>
+#include <ipxe/ib_cm.h>
 #include <ipxe/retry.h>
 #include <ipxe/ipoib.h>
 
@@ -67,11 +69,37 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Number of IPoIB send work queue entries */
 #define IPOIB_NUM_SEND_WQES 8
 
-/** Number of IPoIB receive work queue entries */
-#define IPOIB_NUM_RECV_WQES 4
+/** Minimum number of IPoIB receive work queue entries */
+#define IPOIB_MIN_RECV_WQES 4
 
-/** Number of IPoIB completion entries */
-#define IPOIB_NUM_CQES 16
+/** Maximum number of IPoIB receive work queue entries */
+#define IPOIB_MAX_RECV_WQES 64
+
+/** Maximum proportion of free memory to use for IPoIB receive buffers
+ *
+ * This is expressed as a right shift applied to the amount of free
+ * memory.
+ */
+#define IPOIB_RECV_MEM_SHIFT 2
+
+/** IPoIB connected mode MTU
+ *
+ * This is the largest MTU supported by other IPoIB connected mode
+ * implementations (e.g. Linux).
+ */
+#define IPOIB_CM_MTU 65520
+
+/** Length of IPoIB connected mode receive buffers */
+#define IPOIB_CM_BUF_LEN ( IPOIB_CM_MTU + IPOIB_HLEN )
+
+/** Minimum number of IPoIB connected mode receive work queue entries */
+#define IPOIB_CM_MIN_RECV_WQES 2
+
+/** Maximum number of IPoIB connected mode receive work queue entries */
+#define IPOIB_CM_MAX_RECV_WQES 8
+
+/** Maximum number of IPoIB connected mode connections */
+#define IPOIB_CM_MAX_CONNS 4
 
 /** An IPoIB broadcast address */
 struct ipoib_broadcast {
@@ -101,6 +129,34 @@ struct ipoib_device {
 	struct ipoib_broadcast broadcast;
 	/** REMAC cache */
 	struct list_head peers;
+
+	/** Connected mode listener */
+	struct ib_cm_listener listener;
+	/** Connected mode connection reply private data */
+	struct ipoib_cm_data cm_data;
+	/** Connected mode connections */
+	struct list_head connections;
+};
+
+/** An IPoIB connected mode connection
+ *
+ * Connected mode is used only for receiving packets: the remote peer
+ * establishes a reliable connection to us, and we continue to
+ * transmit all packets via the UD queue pair.
+ */
+struct ipoib_connection {
+	/** IPoIB device */
+	struct ipoib_device *ipoib;
+	/** List of connections */
+	struct list_head list;
+	/** Communication management connection */
+	struct ib_connection *conn;
+	/** Completion queue */
+	struct ib_completion_queue *cq;
+	/** Queue pair */
+	struct ib_queue_pair *qp;
+	/** Remote UD queue pair number */
+	unsigned long qpn;
 };
 
 /** Broadcast IPoIB address */
@@ -586,6 +642,16 @@ static int ipoib_transmit ( struct net_device *netdev,
 	ipoib_hdr->proto = net_proto;
 	ipoib_hdr->reserved = 0;
 
+	/* All transmissions use the UD queue pair, which cannot carry
+	 * packets larger than the Infiniband payload size (even if
+	 * connected mode has increased the MTU).
+	 */
+	if ( iob_len ( iobuf ) > IB_MAX_PAYLOAD_SIZE ) {
+		DBGC ( ipoib, "IPoIB %p cannot transmit %zd-byte packet\n",
+		       ipoib, iob_len ( iobuf ) );
+		return -ERANGE;
+	}
+
 	/* Transmit packet */
 	return ib_post_send ( ibdev, ipoib->qp, dest, iobuf );
 }
@@ -607,21 +673,18 @@ static void ipoib_complete_send ( struct ib_device *ibdev __unused,
 }
 
 /**
- * Handle IPoIB receive completion
+ * Receive packet via IPoIB network device
  *
- * @v ibdev		Infiniband device
- * @v qp		Queue pair
+ * @v ipoib		IPoIB device
  * @v dest		Destination address vector, or NULL
  * @v source		Source address vector, or NULL
  * @v iobuf		I/O buffer
  * @v rc		Completion status code
  */
-static void ipoib_complete_recv ( struct ib_device *ibdev __unused,
-				  struct ib_queue_pair *qp,
-				  struct ib_address_vector *dest,
-				  struct ib_address_vector *source,
-				  struct io_buffer *iobuf, int rc ) {
-	struct ipoib_device *ipoib = ib_qp_get_ownerdata ( qp );
+static void ipoib_rx ( struct ipoib_device *ipoib,
+		       struct ib_address_vector *dest,
+		       struct ib_address_vector *source,
+		       struct io_buffer *iobuf, int rc ) {
 	struct net_device *netdev = ipoib->netdev;
 	struct ipoib_hdr *ipoib_hdr;
 	struct ethhdr *ethhdr;
@@ -685,6 +748,26 @@ static void ipoib_complete_recv ( struct ib_device *ibdev __unused,
 	netdev_rx ( netdev, iobuf );
 }
 
+/**
+ * Handle IPoIB receive completion
+ *
+ * @v ibdev		Infiniband device
+ * @v qp		Queue pair
+ * @v dest		Destination address vector, or NULL
+ * @v source		Source address vector, or NULL
+ * @v iobuf		I/O buffer
+ * @v rc		Completion status code
+ */
+static void ipoib_complete_recv ( struct ib_device *ibdev __unused,
+				  struct ib_queue_pair *qp,
+				  struct ib_address_vector *dest,
+				  struct ib_address_vector *source,
+				  struct io_buffer *iobuf, int rc ) {
+	struct ipoib_device *ipoib = ib_qp_get_ownerdata ( qp );
+
+	ipoib_rx ( ipoib, dest, source, iobuf, rc );
+}
+
 /** IPoIB completion operations */
 static struct ib_completion_queue_operations ipoib_cq_op = {
 	.complete_send = ipoib_complete_send,
@@ -727,6 +810,314 @@ static struct ib_queue_pair_operations ipoib_qp_op = {
 	.alloc_iob = ipoib_alloc_iob,
 };
 
+/****************************************************************************
+ *
+ * IPoIB connected mode
+ *
+ ****************************************************************************
+ */
+
+/**
+ * Handle IPoIB connected mode send completion
+ *
+ * @v ibdev		Infiniband device
+ * @v qp		Queue pair
+ * @v iobuf		I/O buffer
+ * @v rc		Completion status code
+ */
+static void ipoib_cm_complete_send ( struct ib_device *ibdev __unused,
+				     struct ib_queue_pair *qp __unused,
+				     struct io_buffer *iobuf,
+				     int rc __unused ) {
+
+	/* We never transmit via a connected mode queue pair */
+	free_iob ( iobuf );
+}
+
+/**
+ * Handle IPoIB connected mode receive completion
+ *
+ * @v ibdev		Infiniband device
+ * @v qp		Queue pair
+ * @v dest		Destination address vector, or NULL
+ * @v source		Source address vector, or NULL
+ * @v iobuf		I/O buffer
+ * @v rc		Completion status code
+ */
+static void ipoib_cm_complete_recv ( struct ib_device *ibdev __unused,
+				     struct ib_queue_pair *qp,
+				     struct ib_address_vector *dest,
+				     struct ib_address_vector *source __unused,
+				     struct io_buffer *iobuf, int rc ) {
+	struct ipoib_connection *ipoib_conn = ib_qp_get_ownerdata ( qp );
+	struct ib_address_vector remote;
+
+	/* Construct source address vector using the remote UD queue
+	 * pair number, so that the packet appears to have arrived
+	 * via the UD queue pair.
+	 */
+	memcpy ( &remote, &qp->av, sizeof ( remote ) );
+	remote.qpn = ipoib_conn->qpn;
+
+	ipoib_rx ( ipoib_conn->ipoib, dest, &remote, iobuf, rc );
+}
+
+/** IPoIB connected mode completion operations */
+static struct ib_completion_queue_operations ipoib_cm_cq_op = {
+	.complete_send = ipoib_cm_complete_send,
+	.complete_recv = ipoib_cm_complete_recv,
+};
+
+/**
+ * Allocate IPoIB connected mode receive I/O buffer
+ *
+ * @v len		Length of buffer (ignored)
+ * @ret iobuf		I/O buffer, or NULL
+ *
+ * As with the UD queue pair, we reserve space for the eIPoIB
+ * link-layer pseudo-header.  There is no need to align the buffer to
+ * its own length.
+ */
+static struct io_buffer * ipoib_cm_alloc_iob ( size_t len __unused ) {
+	struct io_buffer *iobuf;
+	size_t reserve_len;
+
+	/* Calculate additional length required at start of buffer */
+	reserve_len = ( sizeof ( struct ethhdr ) -
+			sizeof ( struct ipoib_hdr ) );
+
+	/* Allocate buffer */
+	iobuf = alloc_iob_raw ( ( IPOIB_CM_BUF_LEN + reserve_len ),
+				IB_MAX_PAYLOAD_SIZE, -reserve_len );
+	if ( iobuf ) {
+		iob_reserve ( iobuf, reserve_len );
+	}
+	return iobuf;
+}
+
+/** IPoIB connected mode queue pair operations */
+static struct ib_queue_pair_operations ipoib_cm_qp_op = {
+	.alloc_iob = ipoib_cm_alloc_iob,
+};
+
+/**
+ * Destroy IPoIB connected mode connection
+ *
+ * @v ipoib_conn	IPoIB connection
+ */
+static void ipoib_cm_destroy ( struct ipoib_connection *ipoib_conn ) {
+	struct ipoib_device *ipoib = ipoib_conn->ipoib;
+	struct ib_device *ibdev = ipoib->ibdev;
+
+	ib_destroy_conn ( ibdev, ipoib_conn->qp, ipoib_conn->conn );
+	ib_destroy_qp ( ibdev, ipoib_conn->qp );
+	ib_destroy_cq ( ibdev, ipoib_conn->cq );
+	list_del ( &ipoib_conn->list );
+	free ( ipoib_conn );
+}
+
+/**
+ * Accept IPoIB connected mode connection
+ *
+ * @v ibdev		Infiniband device
+ * @v conn		Connection
+ * @v av		Address vector of remote queue pair
+ * @v private_data	Connection request private data
+ * @v private_data_len	Length of connection request private data
+ * @ret qp		Queue pair, or NULL to reject connection
+ */
+static struct ib_queue_pair *
+ipoib_cm_accept ( struct ib_device *ibdev, struct ib_connection *conn,
+		  struct ib_address_vector *av, void *private_data,
+		  size_t private_data_len ) {
+	struct net_device *netdev = ipoib_netdev ( ibdev );
+	struct ipoib_cm_data *data = private_data;
+	struct ipoib_connection *ipoib_conn;
+	struct ipoib_device *ipoib;
+	unsigned int num_conns = 0;
+	unsigned int num_recv_wqes;
+
+	/* Sanity checks */
+	if ( ! netdev )
+		goto err_netdev;
+	ipoib = netdev->priv;
+	if ( private_data_len < sizeof ( *data ) ) {
+		DBGC ( ipoib, "IPoIB %p connection request too short\n",
+		       ipoib );
+		goto err_len;
+	}
+
+	/* Limit number of connections */
+	list_for_each_entry ( ipoib_conn, &ipoib->connections, list )
+		num_conns++;
+	if ( num_conns >= IPOIB_CM_MAX_CONNS ) {
+		DBGC ( ipoib, "IPoIB %p too many connections\n", ipoib );
+		goto err_max_conns;
+	}
+
+	/* Choose receive ring size.  Each entry consumes a large
+	 * receive buffer, so scale the ring to the available memory.
+	 */
+	num_recv_wqes = IPOIB_CM_MAX_RECV_WQES;
+	while ( ( num_recv_wqes > IPOIB_CM_MIN_RECV_WQES ) &&
+		( ( num_recv_wqes * IPOIB_CM_BUF_LEN ) >
+		  ( freemem >> IPOIB_RECV_MEM_SHIFT ) ) ) {
+		num_recv_wqes >>= 1;
+	}
+
+	/* Allocate and initialise structure */
+	ipoib_conn = zalloc ( sizeof ( *ipoib_conn ) );
+	if ( ! ipoib_conn )
+		goto err_alloc;
+	ipoib_conn->ipoib = ipoib;
+	ipoib_conn->conn = conn;
+	ipoib_conn->qpn = ( ntohl ( data->qpn ) & IB_QPN_MASK );
+
+	/* Allocate completion queue */
+	ipoib_conn->cq = ib_create_cq ( ibdev, ( num_recv_wqes + 1 ),
+					&ipoib_cm_cq_op );
+	if ( ! ipoib_conn->cq ) {
+		DBGC ( ipoib, "IPoIB %p could not allocate connected mode "
+		       "completion queue\n", ipoib );
+		goto err_create_cq;
+	}
+
+	/* Allocate queue pair */
+	ipoib_conn->qp = ib_create_qp ( ibdev, IB_QPT_RC, 1, ipoib_conn->cq,
+					num_recv_wqes, ipoib_conn->cq,
+					&ipoib_cm_qp_op, netdev->name );
+	if ( ! ipoib_conn->qp ) {
+		DBGC ( ipoib, "IPoIB %p could not allocate connected mode "
+		       "queue pair\n", ipoib );
+		goto err_create_qp;
+	}
+	ib_qp_set_ownerdata ( ipoib_conn->qp, ipoib_conn );
+
+	/* Fill receive ring */
+	ib_refill_recv ( ibdev, ipoib_conn->qp );
+
+	/* Add to list of connections */
+	list_add ( &ipoib_conn->list, &ipoib->connections );
+
+	DBGC ( ipoib, "IPoIB %p accepted connection from " IB_GID_FMT
+	       " QPN %#lx (MTU %d) on QPN %#lx with %d receive WQEs\n", ipoib,
+	       IB_GID_ARGS ( &av->gid ), ipoib_conn->qpn, ntohl ( data->mtu ),
+	       ipoib_conn->qp->qpn, num_recv_wqes );
+	return ipoib_conn->qp;
+
+	ib_destroy_qp ( ibdev, ipoib_conn->qp );
+ err_create_qp:
+	ib_destroy_cq ( ibdev, ipoib_conn->cq );
+ err_create_cq:
+	free ( ipoib_conn );
+ err_alloc:
+ err_max_conns:
+ err_len:
+ err_netdev:
+	return NULL;
+}
+
+/**
+ * Handle change of IPoIB connected mode connection status
+ *
+ * @v ibdev		Infiniband device
+ * @v qp		Queue pair
+ * @v conn		Connection
+ * @v rc		Connection status code
+ * @v private_data	Private data, if available
+ * @v private_data_len	Length of private data
+ */
+static void ipoib_cm_changed ( struct ib_device *ibdev __unused,
+			       struct ib_queue_pair *qp,
+			       struct ib_connection *conn __unused, int rc,
+			       void *private_data __unused,
+			       size_t private_data_len __unused ) {
+	struct ipoib_connection *ipoib_conn = ib_qp_get_ownerdata ( qp );
+	struct ipoib_device *ipoib = ipoib_conn->ipoib;
+
+	/* Nothing to do when connection is established */
+	if ( rc == 0 ) {
+		DBGC ( ipoib, "IPoIB %p QPN %#lx connection established\n",
+		       ipoib, qp->qpn );
+		return;
+	}
+
+	/* Destroy connection */
+	DBGC ( ipoib, "IPoIB %p QPN %#lx connection closed: %s\n",
+	       ipoib, qp->qpn, strerror ( rc ) );
+	ipoib_cm_destroy ( ipoib_conn );
+}
+
+/** IPoIB connected mode connection operations */
+static struct ib_connection_operations ipoib_cm_op = {
+	.changed = ipoib_cm_changed,
+	.accept = ipoib_cm_accept,
+};
+
+/**
+ * Enable IPoIB connected mode
+ *
+ * @v ipoib		IPoIB device
+ */
+static void ipoib_cm_open ( struct ipoib_device *ipoib ) {
+	struct ib_device *ibdev = ipoib->ibdev;
+	union ib_guid service_id;
+
+	/* Do nothing unless there is sufficient memory for a minimal
+	 * connected mode receive ring.
+	 */
+	if ( ( IPOIB_CM_MIN_RECV_WQES * IPOIB_CM_BUF_LEN ) >
+	     ( freemem >> IPOIB_RECV_MEM_SHIFT ) ) {
+		DBGC ( ipoib, "IPoIB %p insufficient memory for connected "
+		       "mode\n", ipoib );
+		return;
+	}
+
+	/* Construct service ID and connection reply private data */
+	service_id.dwords[0] = htonl ( IPOIB_CM_SERVICE_ID_HIGH );
+	service_id.dwords[1] = htonl ( ipoib->qp->qpn );
+	ipoib->cm_data.qpn = htonl ( ipoib->qp->qpn );
+	ipoib->cm_data.mtu = htonl ( IPOIB_CM_BUF_LEN );
+
+	/* Listen for incoming connections */
+	ib_cm_listen ( ibdev, &ipoib->listener, &service_id, &ipoib->cm_data,
+		       sizeof ( ipoib->cm_data ), &ipoib_cm_op );
+
+	/* Advertise connected mode support in our MAC address */
+	ipoib->mac.flags__qpn |= htonl ( IPOIB_MAC_FLAG_CM );
+
+	/* Leave the network device MTU unchanged.  We transmit only
+	 * via the unreliable datagram queue pair, and so cannot send
+	 * packets larger than the datagram MTU.  Peers will still use
+	 * the larger connected mode MTU when sending to us.
+	 */
+	DBGC ( ipoib, "IPoIB %p connected mode enabled (receive MTU %d)\n",
+	       ipoib, IPOIB_CM_MTU );
+}
+
+/**
+ * Disable IPoIB connected mode
+ *
+ * @v ipoib		IPoIB device
+ */
+static void ipoib_cm_close ( struct ipoib_device *ipoib ) {
+	struct ipoib_connection *ipoib_conn;
+	struct ipoib_connection *tmp;
+
+	/* Do nothing unless connected mode is enabled */
+	if ( ! ( ipoib->mac.flags__qpn & htonl ( IPOIB_MAC_FLAG_CM ) ) )
+		return;
+
+	/* Stop listening for incoming connections */
+	ib_cm_unlisten ( &ipoib->listener );
+
+	/* Destroy any existing connections */
+	list_for_each_entry_safe ( ipoib_conn, tmp, &ipoib->connections,
+				   list ) {
+		ipoib_cm_destroy ( ipoib_conn );
+	}
+}
+
 /**
  * Poll IPoIB network device
  *
@@ -844,8 +1235,25 @@ static void ipoib_link_state_changed ( struct ipoib_device *ipoib ) {
 static int ipoib_open ( struct net_device *netdev ) {
 	struct ipoib_device *ipoib = netdev->priv;
 	struct ib_device *ibdev = ipoib->ibdev;
+	unsigned int num_recv_wqes;
+	unsigned int num_cqes;
 	int rc;
 
+	/* Choose receive ring size.  A deeper ring reduces packet
+	 * loss during bursts of received data, but each entry
+	 * consumes a full-sized receive buffer (allowing for
+	 * alignment), so scale the ring to the available memory.
+	 */
+	num_recv_wqes = IPOIB_MAX_RECV_WQES;
+	while ( ( num_recv_wqes > IPOIB_MIN_RECV_WQES ) &&
+		( ( num_recv_wqes * 2 * IB_MAX_PAYLOAD_SIZE ) >
+		  ( freemem >> IPOIB_RECV_MEM_SHIFT ) ) ) {
+		num_recv_wqes >>= 1;
+	}
+	num_cqes = ( 1 << fls ( IPOIB_NUM_SEND_WQES + num_recv_wqes - 1 ) );
+	DBGC ( ipoib, "IPoIB %p using %d receive WQEs and %d CQEs\n",
+	       ipoib, num_recv_wqes, num_cqes );
+
 	/* Open IB device */
 	if ( ( rc = ib_open ( ibdev ) ) != 0 ) {
 		DBGC ( ipoib, "IPoIB %p could not open device: %s\n",
@@ -854,7 +1262,7 @@ static int ipoib_open ( struct net_device *netdev ) {
 	}
 
 	/* Allocate completion queue */
-	ipoib->cq = ib_create_cq ( ibdev, IPOIB_NUM_CQES, &ipoib_cq_op );
+	ipoib->cq = ib_create_cq ( ibdev, num_cqes, &ipoib_cq_op );
 	if ( ! ipoib->cq ) {
 		DBGC ( ipoib, "IPoIB %p could not allocate completion queue\n",
 		       ipoib );
@@ -864,7 +1272,7 @@ static int ipoib_open ( struct net_device *netdev ) {
 
 	/* Allocate queue pair */
 	ipoib->qp = ib_create_qp ( ibdev, IB_QPT_UD, IPOIB_NUM_SEND_WQES,
-				   ipoib->cq, IPOIB_NUM_RECV_WQES, ipoib->cq,
+				   ipoib->cq, num_recv_wqes, ipoib->cq,
 				   &ipoib_qp_op, netdev->name );
 	if ( ! ipoib->qp ) {
 		DBGC ( ipoib, "IPoIB %p could not allocate queue pair\n",
@@ -880,6 +1288,9 @@ static int ipoib_open ( struct net_device *netdev ) {
 	/* Fill receive rings */
 	ib_refill_recv ( ibdev, ipoib->qp );
 
+	/* Enable connected mode, if possible */
+	ipoib_cm_open ( ipoib );
+
 	/* Fake a link status change to join the broadcast group */
 	ipoib_link_state_changed ( ipoib );
 
@@ -909,6 +1320,9 @@ static void ipoib_close ( struct net_device *netdev ) {
 	/* Leave broadcast group */
 	ipoib_leave_broadcast_group ( ipoib );
 
+	/* Disable connected mode */
+	ipoib_cm_close ( ipoib );
+
 	/* Remove QPN from MAC address */
 	ipoib->mac.flags__qpn = 0;
 
@@ -952,6 +1366,7 @@ static int ipoib_probe ( struct ib_device *ibdev ) {
 	ipoib->netdev = netdev;
 	ipoib->ibdev = ibdev;
 	INIT_LIST_HEAD ( &ipoib->peers );
+	INIT_LIST_HEAD ( &ipoib->connections );
 
 	/* Extract hardware address */
 	memcpy ( netdev->hw_addr, &ibdev->gid.s.guid,
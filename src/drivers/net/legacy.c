@@ -23,6 +23,12 @@ struct nic nic;
 
 static int legacy_registered = 0;
 
+/* Maximum number of packets to receive per poll.  Old-API drivers
+ * return at most one packet per call to their poll method, so we
+ * call it repeatedly to drain any backlog.
+ */
+#define LEGACY_RX_BATCH 16
+
 static int legacy_transmit ( struct net_device *netdev, struct io_buffer *iobuf ) {
 	struct nic *nic = netdev->priv;
 	struct ethhdr *ethhdr;
@@ -41,18 +47,23 @@ static int legacy_transmit ( struct net_device *netdev, struct io_buffer *iobuf
 static void legacy_poll ( struct net_device *netdev ) {
 	struct nic *nic = netdev->priv;
 	struct io_buffer *iobuf;
+	unsigned int i;
+
+	for ( i = 0 ; i < LEGACY_RX_BATCH ; i++ ) {
+
+		iobuf = alloc_iob ( ETH_FRAME_LEN );
+		if ( ! iobuf )
+			return;
 
-	iobuf = alloc_iob ( ETH_FRAME_LEN );
-	if ( ! iobuf )
-		return;
+		nic->packet = iobuf->data;
+		if ( ! nic->nic_op->poll ( nic, 1 ) ) {
+			free_iob ( iobuf );
+			return;
+		}
 
-	nic->packet = iobuf->data;
-	if ( nic->nic_op->poll ( nic, 1 ) ) {
 		DBG ( "Received %d bytes\n", nic->packetlen );
 		iob_put ( iobuf, nic->packetlen );
 		netdev_rx ( netdev, iobuf );
-	} else {
-		free_iob ( iobuf );
 	}
 }
 
@@ -394,6 +394,144 @@ static int ncm_out_transmit ( struct ncm_device *ncm,
 	return 0;
 }
 
+/**
+ * Calculate alignment padding for a transmitted datagram
+ *
+ * @v ncm		CDC-NCM device
+ * @v offset		Offset of datagram within NTB
+ * @ret pad		Length of padding required before datagram
+ */
+static inline size_t ncm_out_pad ( struct ncm_device *ncm, size_t offset ) {
+
+	return ( ( ncm->remainder - ETH_HLEN - offset ) &
+		 ( ncm->divisor - 1 ) );
+}
+
+/**
+ * Transmit queued packets as a single aggregate NTB
+ *
+ * @v ncm		CDC-NCM device
+ * @ret rc		Return status code
+ *
+ * The queued packets are copied into a newly allocated NTB, which is
+ * completed as a whole when the bulk OUT transfer completes.
+ */
+static int ncm_out_aggregate ( struct ncm_device *ncm ) {
+	struct net_device *netdev = ncm->netdev;
+	struct ncm_transfer_header *nth;
+	struct ncm_datagram_pointer *ndp;
+	struct ncm_datagram_descriptor *desc;
+	struct io_buffer *iobuf;
+	struct io_buffer *ntb;
+	size_t ndp_len;
+	size_t offset;
+	size_t pad;
+	size_t len;
+	unsigned int count;
+	unsigned int i;
+	int rc;
+
+	/* Calculate number of queued packets that will fit */
+	ndp_len = ( sizeof ( *ndp ) +
+		    ( ( ncm->out_max + 1 ) * sizeof ( ndp->desc[0] ) ) );
+	offset = ( sizeof ( *nth ) + ndp_len );
+	count = 0;
+	list_for_each_entry ( iobuf, &netdev->tx_queue, list ) {
+		if ( count >= ncm->out_max )
+			break;
+		len = ( offset + ncm_out_pad ( ncm, offset ) +
+			iob_len ( iobuf ) );
+		if ( len > ncm->out_mtu )
+			break;
+		offset = len;
+		count++;
+	}
+	if ( count < 2 )
+		return -ENOSPC;
+
+	/* Allocate NTB */
+	ntb = alloc_iob ( offset );
+	if ( ! ntb )
+		return -ENOMEM;
+
+	/* Construct headers */
+	nth = iob_put ( ntb, sizeof ( *nth ) );
+	ndp = iob_put ( ntb, ndp_len );
+	memset ( ndp, 0, ndp_len );
+	nth->magic = cpu_to_le32 ( NCM_TRANSFER_HEADER_MAGIC );
+	nth->header_len = cpu_to_le16 ( sizeof ( *nth ) );
+	nth->sequence = cpu_to_le16 ( ncm->sequence );
+	nth->offset = cpu_to_le16 ( sizeof ( *nth ) );
+	ndp->magic = cpu_to_le32 ( NCM_DATAGRAM_POINTER_MAGIC );
+	ndp->header_len = cpu_to_le16 ( ndp_len );
+
+	/* Copy datagrams */
+	desc = ndp->desc;
+	i = 0;
+	list_for_each_entry ( iobuf, &netdev->tx_queue, list ) {
+		if ( i++ >= count )
+			break;
+		pad = ncm_out_pad ( ncm, iob_len ( ntb ) );
+		memset ( iob_put ( ntb, pad ), 0, pad );
+		len = iob_len ( iobuf );
+		desc->offset = cpu_to_le16 ( iob_len ( ntb ) );
+		desc->len = cpu_to_le16 ( len );
+		desc++;
+		memcpy ( iob_put ( ntb, len ), iobuf->data, len );
+	}
+	nth->len = cpu_to_le16 ( iob_len ( ntb ) );
+
+	/* Enqueue NTB */
+	if ( ( rc = usb_stream ( &ncm->usbnet.out, ntb, 0 ) ) != 0 ) {
+		free_iob ( ntb );
+		return rc;
+	}
+
+	/* Record aggregate NTB */
+	ncm->ntb = ntb;
+	ncm->ntb_count = count;
+
+	/* Increment sequence number */
+	ncm->sequence++;
+
+	return 0;
+}
+
+/**
+ * Transmit queued packets
+ *
+ * @v ncm		CDC-NCM device
+ *
+ * Packets are queued (in the network device's transmit queue) while
+ * a bulk OUT transfer is in progress.  Once the endpoint becomes
+ * idle, all queued packets are transmitted together within a single
+ * NTB if possible, to amortise the per-transfer USB overhead.
+ */
+static void ncm_out_flush ( struct ncm_device *ncm ) {
+	struct net_device *netdev = ncm->netdev;
+	struct io_buffer *iobuf;
+	int rc;
+
+	/* Do nothing if a transfer is already in progress */
+	if ( ncm->usbnet.out.fill )
+		return;
+
+	/* Do nothing if there are no queued packets */
+	iobuf = list_first_entry ( &netdev->tx_queue, struct io_buffer, list );
+	if ( ! iobuf )
+		return;
+
+	/* Aggregate multiple packets into a single NTB, if possible */
+	if ( ( ! list_is_singular ( &netdev->tx_queue ) ) &&
+	     ( ncm_out_aggregate ( ncm ) == 0 ) ) {
+		return;
+	}
+
+	/* Otherwise, transmit first packet within its own NTB */
+	if ( ( rc = ncm_out_transmit ( ncm, iobuf ) ) != 0 )
+		netdev_tx_complete_err ( netdev, iobuf, rc );
+}
+
 /**
  * Complete bulk OUT transfer
  *
@@ -407,6 +545,15 @@ static void ncm_out_complete ( struct usb_endpoint *ep, struct io_buffer *iobuf,
 						usbnet.out );
 	struct net_device *netdev = ncm->netdev;
 
+	/* Report TX completion for all packets within an aggregate NTB */
+	if ( iobuf == ncm->ntb ) {
+		free_iob ( iobuf );
+		ncm->ntb = NULL;
+		for ( ; ncm->ntb_count ; ncm->ntb_count-- )
+			netdev_tx_complete_next_err ( netdev, rc );
+		return;
+	}
+
 	/* Report TX completion */
 	netdev_tx_complete_err ( netdev, iobuf, rc );
 }
@@ -437,6 +584,7 @@ static int ncm_open ( struct net_device *netdev ) {
 
 	/* Reset sequence number */
 	ncm->sequence = 0;
+	assert ( ncm->ntb == NULL );
 
 	/* Prefill I/O buffers */
 	if ( ( rc = ncm_in_prefill ( ncm ) ) != 0 )
@@ -499,13 +647,13 @@ static void ncm_close ( struct net_device *netdev ) {
  * @ret rc		Return status code
  */
 static int ncm_transmit ( struct net_device *netdev,
-			  struct io_buffer *iobuf ) {
+			  struct io_buffer *iobuf __unused ) {
 	struct ncm_device *ncm = netdev->priv;
-	int rc;
 
-	/* Transmit packet */
-	if ( ( rc = ncm_out_transmit ( ncm, iobuf ) ) != 0 )
-		return rc;
+	/* Transmit packet (along with any other queued packets) if
+	 * the bulk OUT endpoint is idle, otherwise leave it queued.
+	 */
+	ncm_out_flush ( ncm );
 
 	return 0;
 }
@@ -526,6 +674,9 @@ static void ncm_poll ( struct net_device *netdev ) {
 	if ( ( rc = usbnet_refill ( &ncm->usbnet ) ) != 0 )
 		netdev_rx_err ( netdev, NULL, rc );
 
+	/* Transmit any queued packets */
+	ncm_out_flush ( ncm );
+
 }
 
 /** CDC-NCM network device operations */
@@ -624,6 +775,20 @@ static int ncm_probe ( struct usb_function *func,
 	assert ( ( ( sizeof ( struct ncm_ntb_header ) + ncm->padding +
 		     ETH_HLEN ) % le16_to_cpu ( params.out.divisor ) ) ==
 		 le16_to_cpu ( params.out.remainder ) );
+	ncm->divisor = le16_to_cpu ( params.out.divisor );
+	ncm->remainder = le16_to_cpu ( params.out.remainder );
+	netdev->tx_headroom = ( sizeof ( struct ncm_ntb_header ) +
+				ncm->padding );
+
+	/* Get maximum supported output size and datagram count */
+	ncm->out_mtu = le32_to_cpu ( params.out.mtu );
+	if ( ncm->out_mtu > NCM_OUT_MAX_SIZE )
+		ncm->out_mtu = NCM_OUT_MAX_SIZE;
+	ncm->out_max = le16_to_cpu ( params.max );
+	if ( ( ncm->out_max == 0 ) || ( ncm->out_max > NCM_OUT_MAX_DATAGRAMS ) )
+		ncm->out_max = NCM_OUT_MAX_DATAGRAMS;
+	DBGC2 ( ncm, "NCM %p using up to %dx datagrams in %zd-byte OUT NTB\n",
+		ncm, ncm->out_max, ncm->out_mtu );
 
 	/* Register network device */
 	if ( ( rc = register_netdev ( netdev ) ) != 0 )
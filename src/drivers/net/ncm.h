@@ -149,6 +149,18 @@ struct ncm_device {
 	uint16_t sequence;
 	/** Alignment padding required on transmitted packets */
 	size_t padding;
+	/** Transmit alignment divisor */
+	size_t divisor;
+	/** Transmit alignment remainder */
+	size_t remainder;
+	/** Maximum size of a transmitted aggregate NTB */
+	size_t out_mtu;
+	/** Maximum number of datagrams within a transmitted NTB */
+	unsigned int out_max;
+	/** Aggregate NTB currently being transmitted (if any) */
+	struct io_buffer *ntb;
+	/** Number of packets within aggregate NTB */
+	unsigned int ntb_count;
 };
 
 /** Bulk IN ring minimum buffer count
@@ -161,7 +173,7 @@ struct ncm_device {
  *
  * This is a policy decision.
  */
-#define NCM_IN_MIN_SIZE 16384
+#define NCM_IN_MIN_SIZE 65536
 
 /** Bulk IN ring maximum total buffer size
  *
@@ -169,6 +181,18 @@ struct ncm_device {
  */
 #define NCM_IN_MAX_SIZE 131072
 
+/** Maximum size of a transmitted aggregate NTB
+ *
+ * This is a policy decision.
+ */
+#define NCM_OUT_MAX_SIZE 16384
+
+/** Maximum number of datagrams within a transmitted aggregate NTB
+ *
+ * This is a policy decision.
+ */
+#define NCM_OUT_MAX_DATAGRAMS 16
+
 /** Interrupt ring buffer count
  *
  * This is a policy decision.
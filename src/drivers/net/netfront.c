@@ -25,6 +25,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <ipxe/netdevice.h>
 #include <ipxe/ethernet.h>
@@ -522,7 +523,7 @@ static void netfront_refill_rx ( struct net_device *netdev ) {
 	do {
 
 		/* Allocate I/O buffer */
-		iobuf = alloc_iob ( PAGE_SIZE );
+		iobuf = alloc_rx_iob ( PAGE_SIZE );
 		if ( ! iobuf ) {
 			/* Wait for next refill */
 			break;
@@ -617,6 +618,8 @@ static int netfront_open ( struct net_device *netdev ) {
 	}
 
 	/* Refill receive descriptor ring */
+	netfront->rx.fill = netdev_rx_fill ( netdev, netfront->rx.count,
+					     PAGE_SIZE );
 	netfront_refill_rx ( netdev );
 
 	/* Set link up */
@@ -778,12 +781,23 @@ static void netfront_poll_tx ( struct net_device *netdev ) {
  * Poll for received packets
  *
  * @v netdev		Network device
+ *
+ * Receive buffers are persistent: each received packet is copied out
+ * to a freshly allocated I/O buffer, and the receive page (along
+ * with its existing grant reference) is immediately reposted to the
+ * backend.  This avoids reallocating and regranting a page for every
+ * received packet.
  */
 static void netfront_poll_rx ( struct net_device *netdev ) {
 	struct netfront_nic *netfront = netdev->priv;
 	struct xen_device *xendev = netfront->xendev;
 	struct netif_rx_response *response;
+	struct netif_rx_request *request;
+	struct io_buffer *page;
 	struct io_buffer *iobuf;
+	unsigned int received = 0;
+	unsigned int id;
+	int notify;
 	int status;
 	size_t len;
 	int rc;
@@ -794,26 +808,57 @@ static void netfront_poll_rx ( struct net_device *netdev ) {
 		/* Get next response */
 		response = RING_GET_RESPONSE ( &netfront->rx_fring,
 					       netfront->rx_fring.rsp_cons++ );
+		id = response->id;
+		assert ( id < netfront->rx.count );
+		page = netfront->rx.iobufs[id];
+		assert ( page != NULL );
 
-		/* Retrieve from descriptor ring */
-		iobuf = netfront_pull ( netfront, &netfront->rx, response->id );
+		/* Copy out received data */
 		status = response->status;
-		if ( status >= 0 ) {
+		if ( ( status >= 0 ) &&
+		     ( ( response->offset + status ) <= PAGE_SIZE ) ) {
 			len = status;
-			iob_reserve ( iobuf, response->offset );
-			iob_put ( iobuf, len );
-			DBGC2 ( netfront, "NETFRONT %s RX id %d complete "
-				"%#08lx+%zx\n", xendev->key, response->id,
-				virt_to_phys ( iobuf->data ), len );
-			netdev_rx ( netdev, iobuf );
+			iobuf = alloc_iob ( len );
+			if ( iobuf ) {
+				memcpy ( iob_put ( iobuf, len ),
+					 ( page->data + response->offset ),
+					 len );
+				DBGC2 ( netfront, "NETFRONT %s RX id %d "
+					"complete %#08lx+%zx\n", xendev->key,
+					id, virt_to_phys ( page->data ), len );
+				netdev_rx ( netdev, iobuf );
+			} else {
+				netdev_rx_err ( netdev, NULL, -ENOMEM );
+			}
 		} else {
-			rc = -EIO_NETIF_RSP ( status );
+			rc = ( ( status < 0 ) ? -EIO_NETIF_RSP ( status ) :
+			       -ERANGE );
 			DBGC2 ( netfront, "NETFRONT %s RX id %d error %d: %s\n",
-				xendev->key, response->id, status,
-				strerror ( rc ) );
-			netdev_rx_err ( netdev, iobuf, rc );
+				xendev->key, id, status, strerror ( rc ) );
+			netdev_rx_err ( netdev, NULL, rc );
 		}
+
+		/* Repost receive page, retaining its grant reference */
+		request = RING_GET_REQUEST ( &netfront->rx_fring,
+					     netfront->rx_fring.req_prod_pvt++ );
+		request->id = id;
+		request->gref = netfront->rx.refs[id];
+		received++;
 	}
+
+	/* Push reposted descriptors and notify backend (once per
+	 * batch) if applicable.
+	 */
+	if ( received ) {
+		RING_PUSH_REQUESTS_AND_CHECK_NOTIFY ( &netfront->rx_fring,
+						      notify );
+		if ( notify )
+			netfront_send_event ( netfront );
+	}
+
+	/* Record overflow if all posted buffers were consumed */
+	if ( received >= netfront->rx.fill )
+		netdev_rx_overflow ( netdev );
 }
 
 /**
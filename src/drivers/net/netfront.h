@@ -15,8 +15,13 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Number of transmit ring entries */
 #define NETFRONT_NUM_TX_DESC 16
 
-/** Number of receive ring entries */
-#define NETFRONT_NUM_RX_DESC 8
+/** Number of receive ring entries
+ *
+ * Must be a power of two, and no larger than the number of entries
+ * in a single-page shared ring (which is the largest ring supported
+ * by the backend).
+ */
+#define NETFRONT_NUM_RX_DESC 256
 
 /** Grant reference indices */
 enum netfront_ref_index {
@@ -50,6 +55,8 @@ struct netfront_ring {
 
 	/** Maximum number of used descriptors */
 	size_t count;
+	/** Fill level */
+	unsigned int fill;
 	/** I/O buffers, indexed by buffer ID */
 	struct io_buffer **iobufs;
 	/** I/O buffer grant references, indexed by buffer ID */
@@ -83,6 +90,7 @@ netfront_init_ring ( struct netfront_ring *ring, const char *ref_key,
 	ring->ref_key = ref_key;
 	ring->ref = ref;
 	ring->count = count;
+	ring->fill = count;
 	ring->iobufs = iobufs;
 	ring->refs = refs;
 	ring->ids = ids;
@@ -100,7 +108,7 @@ netfront_ring_is_full ( struct netfront_ring *ring ) {
 
 	fill_level = ( ring->id_prod - ring->id_cons );
 	assert ( fill_level <= ring->count );
-	return ( fill_level >= ring->count );
+	return ( fill_level >= ring->fill );
 }
 
 /**
@@ -450,8 +450,7 @@ static void netvsc_poll ( struct rndis_device *rndis ) {
 	struct vmbus_device *vmdev = netvsc->vmdev;
 
 	/* Poll VMBus device */
-	while ( vmbus_has_data ( vmdev ) )
-		vmbus_poll ( vmdev );
+	vmbus_poll_all ( vmdev );
 }
 
 /**
@@ -711,7 +710,8 @@ static int netvsc_open ( struct rndis_device *rndis ) {
 
 	/* Open channel */
 	if ( ( rc = vmbus_open ( netvsc->vmdev, &netvsc_channel_operations,
-				 PAGE_SIZE, PAGE_SIZE, NETVSC_MTU ) ) != 0 ) {
+				 NETVSC_OUT_RING_LEN, NETVSC_IN_RING_LEN,
+				 NETVSC_MTU ) ) != 0 ) {
 		DBGC ( netvsc, "NETVSC %s could not open VMBus: %s\n",
 		       netvsc->name, strerror ( rc ) );
 		goto err_vmbus_open;
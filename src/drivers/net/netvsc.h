@@ -9,8 +9,29 @@
 
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
-/** Maximum supported NetVSC message length */
-#define NETVSC_MTU 512
+/** Maximum supported NetVSC message length
+ *
+ * A single transfer page packet may describe many received packets
+ * (one range per packet), and so this must be large enough to allow
+ * the host to batch a substantial fraction of the receive buffer
+ * into one notification.
+ */
+#define NETVSC_MTU PAGE_SIZE
+
+/** Outbound VMBus ring buffer length
+ *
+ * Must be a power of two and a multiple of PAGE_SIZE.  This is a
+ * policy decision.
+ */
+#define NETVSC_OUT_RING_LEN ( 4 * PAGE_SIZE )
+
+/** Inbound VMBus ring buffer length
+ *
+ * Must be a power of two and a multiple of PAGE_SIZE.  This is a
+ * policy decision.  This value must be sufficiently large to hold
+ * the notifications for a full receive buffer.
+ */
+#define NETVSC_IN_RING_LEN ( 8 * PAGE_SIZE )
 
 /** Maximum time to wait for a transaction to complete
  *
@@ -24,7 +45,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  * must be sufficiently small to guarantee that we never run out of
  * space in the VMBus outbound ring buffer.
  */
-#define NETVSC_TX_NUM_DESC 32
+#define NETVSC_TX_NUM_DESC 64
 
 /** RX data buffer page set ID
  *
@@ -34,9 +55,11 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 /** RX data buffer length
  *
- * This is a policy decision.
+ * This is a policy decision.  The host can deliver packets only as
+ * fast as we return ranges of this buffer, and so it should be large
+ * enough to cover the bandwidth-delay product of the host's batching.
  */
-#define NETVSC_RX_BUF_LEN ( 16 * PAGE_SIZE )
+#define NETVSC_RX_BUF_LEN ( 256 * PAGE_SIZE )
 
 /** Base transaction ID
  *
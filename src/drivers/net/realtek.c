@@ -637,18 +637,18 @@ static void realtek_refill_rx ( struct realtek_nic *rtl ) {
 	if ( rtl->legacy )
 		return;
 
-	while ( ( rtl->rx.prod - rtl->rx.cons ) < RTL_NUM_RX_DESC ) {
+	while ( ( rtl->rx.prod - rtl->rx.cons ) < rtl->rx.fill ) {
 
 		/* Allocate I/O buffer */
-		iobuf = alloc_iob ( RTL_RX_MAX_LEN );
+		iobuf = alloc_rx_iob ( RTL_RX_MAX_LEN );
 		if ( ! iobuf ) {
 			/* Wait for next refill */
 			return;
 		}
 
 		/* Get next receive descriptor */
-		rx_idx = ( rtl->rx.prod++ % RTL_NUM_RX_DESC );
-		is_last = ( rx_idx == ( RTL_NUM_RX_DESC - 1 ) );
+		rx_idx = ( rtl->rx.prod++ % rtl->rx.count );
+		is_last = ( rx_idx == ( rtl->rx.count - 1 ) );
 		rx = &rtl->rx.desc[rx_idx];
 
 		/* Populate receive descriptor */
@@ -719,6 +719,8 @@ static int realtek_open ( struct net_device *netdev ) {
 	writel ( rcr, rtl->regs + RTL_RCR );
 
 	/* Fill receive ring */
+	rtl->rx.fill = netdev_rx_fill ( netdev, rtl->rx.count,
+					RTL_RX_MAX_LEN );
 	realtek_refill_rx ( rtl );
 
 	/* Update link state */
@@ -780,11 +782,11 @@ static int realtek_transmit ( struct net_device *netdev,
 	int is_last;
 
 	/* Get next transmit descriptor */
-	if ( ( rtl->tx.prod - rtl->tx.cons ) >= RTL_NUM_TX_DESC ) {
+	if ( ( rtl->tx.prod - rtl->tx.cons ) >= rtl->tx.count ) {
 		netdev_tx_defer ( netdev, iobuf );
 		return 0;
 	}
-	tx_idx = ( rtl->tx.prod++ % RTL_NUM_TX_DESC );
+	tx_idx = ( rtl->tx.prod++ % rtl->tx.count );
 
 	/* Transmit packet */
 	if ( rtl->legacy ) {
@@ -809,7 +811,7 @@ static int realtek_transmit ( struct net_device *netdev,
 
 		/* Populate transmit descriptor */
 		address = virt_to_bus ( iobuf->data );
-		is_last = ( tx_idx == ( RTL_NUM_TX_DESC - 1 ) );
+		is_last = ( tx_idx == ( rtl->tx.count - 1 ) );
 		tx = &rtl->tx.desc[tx_idx];
 		tx->address = cpu_to_le64 ( address );
 		tx->length = cpu_to_le16 ( iob_len ( iobuf ) );
@@ -845,7 +847,7 @@ static void realtek_poll_tx ( struct net_device *netdev ) {
 	while ( rtl->tx.cons != rtl->tx.prod ) {
 
 		/* Get next transmit descriptor */
-		tx_idx = ( rtl->tx.cons % RTL_NUM_TX_DESC );
+		tx_idx = ( rtl->tx.cons % rtl->tx.count );
 
 		/* Stop if descriptor is still in use */
 		if ( rtl->legacy ) {
@@ -949,7 +951,7 @@ static void realtek_poll_rx ( struct net_device *netdev ) {
 	while ( rtl->rx.cons != rtl->rx.prod ) {
 
 		/* Get next receive descriptor */
-		rx_idx = ( rtl->rx.cons % RTL_NUM_RX_DESC );
+		rx_idx = ( rtl->rx.cons % rtl->rx.count );
 		rx = &rtl->rx.desc[rx_idx];
 
 		/* Stop if descriptor is still in use */
@@ -1115,8 +1117,6 @@ static int realtek_probe ( struct pci_device *pci ) {
 	pci_set_drvdata ( pci, netdev );
 	netdev->dev = &pci->dev;
 	memset ( rtl, 0, sizeof ( *rtl ) );
-	realtek_init_ring ( &rtl->tx, RTL_NUM_TX_DESC, RTL_TNPDS );
-	realtek_init_ring ( &rtl->rx, RTL_NUM_RX_DESC, RTL_RDSAR );
 
 	/* Fix up PCI device */
 	adjust_pci_device ( pci );
@@ -1134,6 +1134,9 @@ static int realtek_probe ( struct pci_device *pci ) {
 
 	/* Detect device type */
 	realtek_detect ( rtl );
+	realtek_init_ring ( &rtl->tx, ( rtl->legacy ? RTL_LEGACY_NUM_TX_DESC :
+					RTL_NUM_TX_DESC ), RTL_TNPDS );
+	realtek_init_ring ( &rtl->rx, RTL_NUM_RX_DESC, RTL_RDSAR );
 
 	/* Initialise EEPROM */
 	if ( rtl->eeprom.bus &&
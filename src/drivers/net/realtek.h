@@ -86,11 +86,17 @@ enum realtek_legacy_status {
 /** Transmit Normal Priority Descriptors (qword) */
 #define RTL_TNPDS 0x20
 
-/** Number of transmit descriptors
+/** Number of transmit descriptors (C+ mode)
+ *
+ * This is a policy decision.
+ */
+#define RTL_NUM_TX_DESC 64
+
+/** Number of transmit descriptors (legacy mode)
  *
  * This is a hardware limit when using legacy mode.
  */
-#define RTL_NUM_TX_DESC 4
+#define RTL_LEGACY_NUM_TX_DESC 4
 
 /** Receive Buffer Start Address (dword, 8139 only) */
 #define RTL_RBSTART 0x30
@@ -237,7 +243,7 @@ enum realtek_legacy_status {
 #define RTL_RDSAR 0xe4
 
 /** Number of receive descriptors */
-#define RTL_NUM_RX_DESC 4
+#define RTL_NUM_RX_DESC 64
 
 /** Receive buffer length */
 #define RTL_RX_MAX_LEN \
@@ -251,6 +257,10 @@ struct realtek_ring {
 	unsigned int prod;
 	/** Consumer index */
 	unsigned int cons;
+	/** Number of descriptors */
+	unsigned int count;
+	/** Fill level */
+	unsigned int fill;
 
 	/** Descriptor start address register */
 	unsigned int reg;
@@ -268,6 +278,8 @@ struct realtek_ring {
 static inline __attribute__ (( always_inline)) void
 realtek_init_ring ( struct realtek_ring *ring, unsigned int count,
 		    unsigned int reg ) {
+	ring->count = count;
+	ring->fill = count;
 	ring->len = ( count * sizeof ( ring->desc[0] ) );
 	ring->reg = reg;
 }
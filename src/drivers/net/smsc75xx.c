@@ -977,6 +977,7 @@ static int smsc75xx_probe ( struct usb_function *func,
 	}
 	netdev_init ( netdev, &smsc75xx_operations );
 	netdev->dev = &func->dev;
+	netdev->tx_headroom = sizeof ( struct smsc75xx_tx_header );
 	smsc75xx = netdev->priv;
 	memset ( smsc75xx, 0, sizeof ( *smsc75xx ) );
 	smsc75xx->usb = usb;
@@ -299,7 +299,7 @@ struct smsc75xx_device {
  *
  * This is a policy decision.
  */
-#define SMSC75XX_IN_MAX_FILL 8
+#define SMSC75XX_IN_MAX_FILL 16
 
 /** Bulk IN buffer size */
 #define SMSC75XX_IN_MTU						\
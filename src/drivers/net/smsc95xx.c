@@ -1133,6 +1133,7 @@ static int smsc95xx_probe ( struct usb_function *func,
 	}
 	netdev_init ( netdev, &smsc95xx_operations );
 	netdev->dev = &func->dev;
+	netdev->tx_headroom = sizeof ( struct smsc95xx_tx_header );
 	smsc95xx = netdev->priv;
 	memset ( smsc95xx, 0, sizeof ( *smsc95xx ) );
 	smsc95xx->usb = usb;
@@ -255,7 +255,7 @@ struct smsc95xx_device {
  *
  * This is a policy decision.
  */
-#define SMSC95XX_IN_MAX_FILL 8
+#define SMSC95XX_IN_MAX_FILL 16
 
 /** Bulk IN buffer size */
 #define SMSC95XX_IN_MTU						\
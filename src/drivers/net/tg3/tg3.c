@@ -247,6 +247,8 @@ static int tg3_open(struct net_device *dev)
 		return err;
 
 	tpr->rx_std_iob_cnt = 0;
+	tpr->rx_std_fill = netdev_rx_fill(dev, TG3_DEF_RX_RING_PENDING,
+					  TG3_RX_STD_DMA_SZ);
 
 	err = tg3_init_hw(tp, 1);
 	if (err != 0)
@@ -405,7 +407,7 @@ static void tg3_refill_prod_ring(struct tg3 *tp)
 
 	DBGCP(tp->dev, "%s\n", __func__);
 
-	while (tpr->rx_std_iob_cnt < TG3_DEF_RX_RING_PENDING) {
+	while (tpr->rx_std_iob_cnt < tpr->rx_std_fill) {
 		if (tpr->rx_iobufs[idx % TG3_DEF_RX_RING_PENDING] == NULL) {
 			if (tg3_alloc_rx_iob(tpr, idx) < 0) {
 				DBGC(tp->dev, "alloc_iob() failed for descriptor %d\n", idx);
@@ -2923,13 +2923,16 @@ struct tg3_ethtool_stats {
 	u64		mbuf_lwm_thresh_hit;
 };
 
-/* number of io_buffers to allocate */
-#define TG3_DEF_RX_RING_PENDING		8
+/* maximum number of io_buffers to allocate (must divide
+ * TG3_RX_STD_MAX_SIZE_5700)
+ */
+#define TG3_DEF_RX_RING_PENDING		64
 
 struct tg3_rx_prodring_set {
 	u32				rx_std_prod_idx;
 	u32				rx_std_cons_idx;
 	u32				rx_std_iob_cnt;
+	u32				rx_std_fill;
 	struct tg3_rx_buffer_desc	*rx_std;
 	struct io_buffer		*rx_iobufs[TG3_DEF_RX_RING_PENDING];
 	dma_addr_t			rx_std_mapping;
@@ -1883,10 +1883,12 @@ static void tg3_setup_rxbd_thresholds(struct tg3 *tp)
 		bdcache_maxcnt = TG3_SRAM_RX_STD_BDCACHE_SIZE_5906;
 
 
-	/* NOTE: legacy driver uses RX_PENDING / 8, we only use 4 descriptors
-	 * for now, use / 4 so the result is > 0
+	/* NOTE: legacy driver uses RX_PENDING / 8; ensure the result is > 0
+	 * for small fill levels
 	 */
-	val = TG3_DEF_RX_RING_PENDING / 4;
+	val = tp->prodring.rx_std_fill / 8;
+	if (!val)
+		val = 1;
 	tw32(RCVBDI_STD_THRESH, val);
 
 	if (tg3_flag(tp, 57765_PLUS))
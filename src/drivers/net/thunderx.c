@@ -366,7 +366,7 @@ static void txnic_refill_rq ( struct txnic *vnic ) {
 	size_t offset;
 
 	/* Refill ring */
-	while ( ( vnic->rq.prod - vnic->rq.cons ) < TXNIC_RQ_FILL ) {
+	while ( ( vnic->rq.prod - vnic->rq.cons ) < vnic->rq.fill ) {
 
 		/* Allocate I/O buffer */
 		iobuf = alloc_iob ( TXNIC_RQE_SIZE );
@@ -597,6 +597,10 @@ static int txnic_open ( struct txnic *vnic ) {
 	if ( ( rc = txnic_create_rq ( vnic ) ) != 0 )
 		goto err_create_rq;
 
+	/* Choose receive queue fill level */
+	vnic->rq.fill = netdev_rx_fill ( vnic->netdev, TXNIC_RQ_FILL,
+					 TXNIC_RQE_SIZE );
+
 	/* Refill receive queue */
 	txnic_refill_rq ( vnic );
 
@@ -252,9 +252,11 @@ struct txnic_rqe {
 
 /** Receive queue maximum fill level
  *
- * This is a policy decision.  Must not exceed TXNIC_RQES.
+ * This is a policy decision.  Must not exceed TXNIC_RQES, and the
+ * send and receive queues together must not be able to overflow the
+ * completion queue.
  */
-#define TXNIC_RQ_FILL 32
+#define TXNIC_RQ_FILL 128
 
 /** Receive queue entry size
  *
@@ -279,6 +281,8 @@ struct txnic_rq {
 	unsigned int prod;
 	/** Consumer counter */
 	unsigned int cons;
+	/** Fill level */
+	unsigned int fill;
 	/** Receive queue entries */
 	userptr_t rqe;
 	/** I/O buffers */
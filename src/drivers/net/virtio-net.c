@@ -22,9 +22,11 @@
 
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
+#include <string.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <byteswap.h>
 #include <ipxe/list.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/netdevice.h>
@@ -33,6 +35,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/ethernet.h>
 #include <ipxe/virtio-pci.h>
 #include <ipxe/virtio-ring.h>
+#include <ipxe/tcp.h>
 #include "virtio-net.h"
 
 /*
@@ -64,6 +67,11 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  * enable/disable flags but these are only hints.  The hypervisor may still
  * raise an interrupt.  Nevertheless, this driver disables callbacks in the
  * hopes of avoiding interrupts.
+ *
+ * Where the device supports them, the packed virtqueue layout and
+ * event index notification suppression are used in preference to the
+ * split layout and the simple notification flags, since both reduce
+ * the number of notifications and cache lines touched per packet.
  */
 
 /* Driver types are declared here so virtio-net.h can be easily synced with its
@@ -80,6 +88,22 @@ enum {
 /** Max number of pending rx packets */
 #define NUM_RX_BUF 8
 
+/** Length of each mergeable rx buffer */
+#define MRG_RX_BUF_LEN 4096
+
+/** Max number of pending mergeable rx buffers */
+#define MAX_MRG_RX_BUF 64
+
+/** Min number of pending mergeable rx buffers to allow large receive offload
+ *
+ * A maximum-sized (64kB) segment plus its header must fit within the
+ * posted buffers, otherwise the device will wait indefinitely for
+ * more buffers to become available.
+ */
+#define MIN_MRG_RX_BUF_TSO \
+	( ( ( 65536 + sizeof ( struct virtio_net_hdr_modern ) ) / \
+	    MRG_RX_BUF_LEN ) + 1 )
+
 struct virtnet_nic {
 	/** Base pio register address */
 	unsigned long ioaddr;
@@ -99,10 +123,27 @@ struct virtnet_nic {
 	/** Pending rx packet count */
 	unsigned int rx_num_iobufs;
 
-	/** Virtio net dummy packet headers */
-	struct virtio_net_hdr_modern empty_header[QUEUE_NB];
+	/** Max number of pending rx packets */
+	unsigned int rx_fill;
+
+	/** Mergeable rx buffers are in use */
+	int mergeable;
+
+	/** Transmit packet headers (one per transmit descriptor) */
+	struct virtio_net_hdr_modern *tx_header;
 };
 
+/** Get virtio net packet header length
+ *
+ * @v virtnet		Virtio-net device
+ * @ret len		Packet header length
+ */
+static inline size_t virtnet_header_len ( struct virtnet_nic *virtnet ) {
+	return ( ( virtnet->virtio_version || virtnet->mergeable ) ?
+		 sizeof ( struct virtio_net_hdr_modern ) :
+		 sizeof ( struct virtio_net_hdr ) );
+}
+
 /** Add an iobuf to a virtqueue
  *
  * @v netdev		Network device
@@ -115,31 +156,69 @@ static void virtnet_enqueue_iob ( struct net_device *netdev,
 				  int vq_idx, struct io_buffer *iobuf ) {
 	struct virtnet_nic *virtnet = netdev->priv;
 	struct vring_virtqueue *vq = &virtnet->virtqueue[vq_idx];
-	struct virtio_net_hdr_modern *header = &virtnet->empty_header[vq_idx];
+	struct virtio_net_hdr_modern *header;
+	struct tcp_header *tcphdr;
 	unsigned int out = ( vq_idx == TX_INDEX ) ? 2 : 0;
 	unsigned int in = ( vq_idx == TX_INDEX ) ? 0 : 2;
-	size_t header_len = ( virtnet->virtio_version ?
-			      sizeof ( *header ) : sizeof ( header->legacy ) );
-	struct vring_list list[] = {
-		{
-			/* Share a single zeroed virtio net header between all
-			 * packets in a ring.  This works because this driver
-			 * does not use any advanced features so none of the
-			 * header fields get used.
-			 *
-			 * Some host implementations (notably Google Compute
-			 * Platform) are known to unconditionally write back
-			 * to header->flags for received packets.  Work around
-			 * this by using separate RX and TX headers.
-			 */
-			.addr = ( char* ) header,
-			.length = header_len,
-		},
-		{
-			.addr = ( char* ) iobuf->data,
-			.length = iob_len ( iobuf ),
-		},
-	};
+	unsigned int count = 2;
+	size_t header_len = virtnet_header_len ( virtnet );
+	struct vring_list list[2];
+	size_t start;
+
+	if ( vq_idx == TX_INDEX ) {
+
+		/* Use the header dedicated to this transmit descriptor
+		 * (or, for packed virtqueues, this buffer ID),
+		 * requesting checksum and segmentation offload if
+		 * applicable.
+		 */
+		header = &virtnet->tx_header[vq->free_head];
+		memset ( header, 0, sizeof ( *header ) );
+		if ( iobuf->flags & IOB_FL_CSUM_OFFLOAD ) {
+			start = iob_csum_start ( iobuf );
+			header->legacy.flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+			header->legacy.csum_start = cpu_to_le16 ( start );
+			header->legacy.csum_offset =
+				cpu_to_le16 ( iobuf->csum_offset );
+			if ( iobuf->flags & IOB_FL_TSO ) {
+				tcphdr = ( iobuf->data + start );
+				header->legacy.gso_type =
+					( ( iobuf->flags & IOB_FL_TSO6 ) ?
+					  VIRTIO_NET_HDR_GSO_TCPV6 :
+					  VIRTIO_NET_HDR_GSO_TCPV4 );
+				header->legacy.hdr_len = cpu_to_le16 (
+					( start + ( ( tcphdr->hlen &
+						      TCP_MASK_HLEN ) / 4 ) ) );
+				header->legacy.gso_size =
+					cpu_to_le16 ( iobuf->mss );
+			}
+		}
+		list[1].addr = ( char * ) iobuf->data;
+		list[1].length = iob_len ( iobuf );
+
+	} else if ( virtnet->mergeable ) {
+
+		/* Mergeable rx buffers are posted as a single
+		 * descriptor, with the header received into the
+		 * start of the first buffer of each packet.
+		 */
+		header = iobuf->data;
+		in = count = 1;
+
+	} else {
+
+		/* Receive the header into the start of the I/O buffer.
+		 * Some host implementations (notably Google Compute
+		 * Platform) are known to unconditionally write back
+		 * to header->flags for received packets, so the
+		 * header must never be shared.
+		 */
+		header = iobuf->data;
+		list[1].addr = ( char * ) ( iobuf->data + header_len );
+		list[1].length = ( iob_len ( iobuf ) - header_len );
+	}
+	list[0].addr = ( char * ) header;
+	list[0].length = ( ( count == 1 ) ? iob_len ( iobuf ) : header_len );
 
 	DBGC2 ( virtnet, "VIRTIO-NET %p enqueuing iobuf %p on vq %d\n",
 		virtnet, iobuf, vq_idx );
@@ -155,13 +234,15 @@ static void virtnet_enqueue_iob ( struct net_device *netdev,
  */
 static void virtnet_refill_rx_virtqueue ( struct net_device *netdev ) {
 	struct virtnet_nic *virtnet = netdev->priv;
-	size_t len = ( netdev->max_pkt_len + 4 /* VLAN */ );
+	size_t len = ( virtnet->mergeable ? MRG_RX_BUF_LEN :
+		       ( virtnet_header_len ( virtnet ) +
+			 netdev->max_pkt_len + 4 /* VLAN */ ) );
 
-	while ( virtnet->rx_num_iobufs < NUM_RX_BUF ) {
+	while ( virtnet->rx_num_iobufs < virtnet->rx_fill ) {
 		struct io_buffer *iobuf;
 
 		/* Try to allocate a buffer, stop for now if out of memory */
-		iobuf = alloc_iob ( len );
+		iobuf = alloc_rx_iob ( len );
 		if ( ! iobuf )
 			break;
 
@@ -191,6 +272,156 @@ static void virtnet_free_virtqueues ( struct net_device *netdev ) {
 
 	free ( virtnet->virtqueue );
 	virtnet->virtqueue = NULL;
+	free ( virtnet->tx_header );
+	virtnet->tx_header = NULL;
+}
+
+/** Allocate transmit packet headers
+ *
+ * @v netdev		Network device
+ * @ret rc		Return status code
+ */
+static int virtnet_alloc_tx_headers ( struct net_device *netdev ) {
+	struct virtnet_nic *virtnet = netdev->priv;
+	unsigned int num = vring_num ( &virtnet->virtqueue[TX_INDEX] );
+
+	virtnet->tx_header = zalloc ( num * sizeof ( virtnet->tx_header[0] ) );
+	if ( ! virtnet->tx_header )
+		return -ENOMEM;
+	return 0;
+}
+
+/** Select offload features
+ *
+ * @v features		Features offered by device
+ * @ret features	Offload features to be negotiated
+ */
+static u64 virtnet_offloads ( u64 features ) {
+
+	/* Segmentation offload requires checksum offload */
+	if ( ! ( features & ( 1ULL << VIRTIO_NET_F_CSUM ) ) ) {
+		features &= ~( ( 1ULL << VIRTIO_NET_F_HOST_TSO4 ) |
+			       ( 1ULL << VIRTIO_NET_F_HOST_TSO6 ) );
+	}
+
+	return ( features & ( ( 1ULL << VIRTIO_NET_F_CSUM ) |
+			      ( 1ULL << VIRTIO_NET_F_GUEST_CSUM ) |
+			      ( 1ULL << VIRTIO_NET_F_HOST_TSO4 ) |
+			      ( 1ULL << VIRTIO_NET_F_HOST_TSO6 ) ) );
+}
+
+/** Select virtqueue features
+ *
+ * @v features		Features offered by device
+ * @ret features	Virtqueue features to be negotiated
+ */
+static u64 virtnet_ring_features ( u64 features ) {
+
+	return ( features & ( ( 1ULL << VIRTIO_RING_F_EVENT_IDX ) |
+			      ( 1ULL << VIRTIO_F_RING_PACKED ) ) );
+}
+
+/** Record negotiated virtqueue features
+ *
+ * @v netdev		Network device
+ * @v features		Negotiated features
+ *
+ * This must be called before the virtqueues are created.
+ */
+static void virtnet_set_ring_features ( struct net_device *netdev,
+				        u64 features ) {
+	struct virtnet_nic *virtnet = netdev->priv;
+	struct vring_virtqueue *vq;
+	int i;
+
+	for ( i = 0; i < QUEUE_NB; i++ ) {
+		vq = &virtnet->virtqueue[i];
+		vq->packed = ( !! ( features &
+				    ( 1ULL << VIRTIO_F_RING_PACKED ) ) );
+		vq->event_idx = ( !! ( features &
+				       ( 1ULL << VIRTIO_RING_F_EVENT_IDX ) ) );
+	}
+	DBGC ( virtnet, "VIRTIO-NET %p using %s virtqueues%s\n", virtnet,
+	       ( virtnet->virtqueue[0].packed ? "packed" : "split" ),
+	       ( virtnet->virtqueue[0].event_idx ? " with event index" : "" ));
+}
+
+/** Select receive buffer features
+ *
+ * @v netdev		Network device
+ * @v features		Features offered by device
+ * @ret features	Receive buffer features to be negotiated
+ *
+ * This also chooses the rx fill level, which must be known in order
+ * to decide whether or not large received segments can be accepted.
+ */
+static u64 virtnet_rx_features ( struct net_device *netdev, u64 features ) {
+	struct virtnet_nic *virtnet = netdev->priv;
+
+	/* Use single-packet rx buffers unless buffers can be merged */
+	if ( ! ( features & ( 1ULL << VIRTIO_NET_F_MRG_RXBUF ) ) ) {
+		virtnet->rx_fill = NUM_RX_BUF;
+		return 0;
+	}
+	virtnet->rx_fill = netdev_rx_fill ( netdev, MAX_MRG_RX_BUF,
+					    MRG_RX_BUF_LEN );
+
+	/* Accept large segments only if received checksums need not
+	 * be verified, and if enough buffers will be posted to hold a
+	 * maximum-sized segment.
+	 */
+	if ( ( features & ( 1ULL << VIRTIO_NET_F_GUEST_CSUM ) ) &&
+	     ( virtnet->rx_fill >= MIN_MRG_RX_BUF_TSO ) ) {
+		return ( features & ( ( 1ULL << VIRTIO_NET_F_MRG_RXBUF ) |
+				      ( 1ULL << VIRTIO_NET_F_GUEST_TSO4 ) |
+				      ( 1ULL << VIRTIO_NET_F_GUEST_TSO6 ) ) );
+	}
+	return ( 1ULL << VIRTIO_NET_F_MRG_RXBUF );
+}
+
+/** Record negotiated receive buffer features
+ *
+ * @v netdev		Network device
+ * @v features		Negotiated features
+ */
+static void virtnet_set_rx_features ( struct net_device *netdev,
+				      u64 features ) {
+	struct virtnet_nic *virtnet = netdev->priv;
+	unsigned int max;
+
+	virtnet->mergeable =
+		( !! ( features & ( 1ULL << VIRTIO_NET_F_MRG_RXBUF ) ) );
+
+	/* Limit fill level to the rx virtqueue size */
+	max = vring_num ( &virtnet->virtqueue[RX_INDEX] );
+	if ( ! virtnet->mergeable )
+		max /= 2;
+	if ( virtnet->rx_fill > max )
+		virtnet->rx_fill = max;
+	DBGC ( virtnet, "VIRTIO-NET %p using %d %s rx buffers%s\n", virtnet,
+	       virtnet->rx_fill, ( virtnet->mergeable ? "mergeable" : "fixed" ),
+	       ( ( features & ( 1ULL << VIRTIO_NET_F_GUEST_TSO4 ) ) ?
+		 " with large receive offload" : "" ) );
+}
+
+/** Record negotiated offload features
+ *
+ * @v netdev		Network device
+ * @v features		Negotiated features
+ */
+static void virtnet_set_offloads ( struct net_device *netdev,
+				   u64 features ) {
+
+	netdev->state &= ~( NETDEV_TX_CSUM | NETDEV_RX_CSUM |
+			    NETDEV_TX_TSO4 | NETDEV_TX_TSO6 );
+	if ( features & ( 1ULL << VIRTIO_NET_F_CSUM ) )
+		netdev->state |= NETDEV_TX_CSUM;
+	if ( features & ( 1ULL << VIRTIO_NET_F_GUEST_CSUM ) )
+		netdev->state |= NETDEV_RX_CSUM;
+	if ( features & ( 1ULL << VIRTIO_NET_F_HOST_TSO4 ) )
+		netdev->state |= NETDEV_TX_TSO4;
+	if ( features & ( 1ULL << VIRTIO_NET_F_HOST_TSO6 ) )
+		netdev->state |= NETDEV_TX_TSO6;
 }
 
 /** Open network device, legacy virtio 0.9.5
@@ -202,6 +433,7 @@ static int virtnet_open_legacy ( struct net_device *netdev ) {
 	struct virtnet_nic *virtnet = netdev->priv;
 	unsigned long ioaddr = virtnet->ioaddr;
 	u32 features;
+	int rc;
 	int i;
 
 	/* Reset for sanity */
@@ -213,6 +445,18 @@ static int virtnet_open_legacy ( struct net_device *netdev ) {
 	if ( ! virtnet->virtqueue )
 		return -ENOMEM;
 
+	/* Select features.  Legacy devices cannot use packed
+	 * virtqueues, but the split virtqueue layout already allows
+	 * for the event index fields.
+	 */
+	features = vp_get_features ( ioaddr );
+	features = ( virtnet_offloads ( features ) |
+		     virtnet_rx_features ( netdev, features ) |
+		     ( features & ( ( 1 << VIRTIO_NET_F_MAC ) |
+				    ( 1 << VIRTIO_NET_F_MTU ) |
+				    ( 1 << VIRTIO_RING_F_EVENT_IDX ) ) ) );
+	virtnet_set_ring_features ( netdev, features );
+
 	/* Initialize rx/tx virtqueues */
 	for ( i = 0; i < QUEUE_NB; i++ ) {
 		if ( vp_find_vq ( ioaddr, i, &virtnet->virtqueue[i] ) == -1 ) {
@@ -223,6 +467,13 @@ static int virtnet_open_legacy ( struct net_device *netdev ) {
 		}
 	}
 
+	/* Allocate transmit packet headers */
+	if ( ( rc = virtnet_alloc_tx_headers ( netdev ) ) != 0 ) {
+		virtnet_free_virtqueues ( netdev );
+		return rc;
+	}
+	virtnet_set_rx_features ( netdev, features );
+
 	/* Initialize rx packets */
 	INIT_LIST_HEAD ( &virtnet->rx_iobufs );
 	virtnet->rx_num_iobufs = 0;
@@ -232,9 +483,8 @@ static int virtnet_open_legacy ( struct net_device *netdev ) {
 	netdev_irq ( netdev, 0 );
 
 	/* Driver is ready */
-	features = vp_get_features ( ioaddr );
-	vp_set_features ( ioaddr, features & ( ( 1 << VIRTIO_NET_F_MAC ) |
-					       ( 1 << VIRTIO_NET_F_MTU ) ) );
+	vp_set_features ( ioaddr, features );
+	virtnet_set_offloads ( netdev, features );
 	vp_set_status ( ioaddr, VIRTIO_CONFIG_S_DRIVER | VIRTIO_CONFIG_S_DRIVER_OK );
 	return 0;
 }
@@ -248,6 +498,7 @@ static int virtnet_open_modern ( struct net_device *netdev ) {
 	struct virtnet_nic *virtnet = netdev->priv;
 	u64 features;
 	u8 status;
+	int rc;
 
 	/* Negotiate features */
 	features = vpm_get_features ( &virtnet->vdev );
@@ -255,11 +506,14 @@ static int virtnet_open_modern ( struct net_device *netdev ) {
 		vpm_add_status ( &virtnet->vdev, VIRTIO_CONFIG_S_FAILED );
 		return -EINVAL;
 	}
-	vpm_set_features ( &virtnet->vdev, features & (
-		( 1ULL << VIRTIO_NET_F_MAC ) |
-		( 1ULL << VIRTIO_NET_F_MTU ) |
-		( 1ULL << VIRTIO_F_VERSION_1 ) |
-		( 1ULL << VIRTIO_F_ANY_LAYOUT ) ) );
+	features = ( virtnet_offloads ( features ) |
+		     virtnet_ring_features ( features ) |
+		     virtnet_rx_features ( netdev, features ) |
+		     ( features & ( ( 1ULL << VIRTIO_NET_F_MAC ) |
+				    ( 1ULL << VIRTIO_NET_F_MTU ) |
+				    ( 1ULL << VIRTIO_F_VERSION_1 ) |
+				    ( 1ULL << VIRTIO_F_ANY_LAYOUT ) ) ) );
+	vpm_set_features ( &virtnet->vdev, features );
 	vpm_add_status ( &virtnet->vdev, VIRTIO_CONFIG_S_FEATURES_OK );
 
 	status = vpm_get_status ( &virtnet->vdev );
@@ -277,6 +531,7 @@ static int virtnet_open_modern ( struct net_device *netdev ) {
 		vpm_add_status ( &virtnet->vdev, VIRTIO_CONFIG_S_FAILED );
 		return -ENOMEM;
 	}
+	virtnet_set_ring_features ( netdev, features );
 
 	/* Initialize rx/tx virtqueues */
 	if ( vpm_find_vqs ( &virtnet->vdev, QUEUE_NB, virtnet->virtqueue ) ) {
@@ -287,6 +542,15 @@ static int virtnet_open_modern ( struct net_device *netdev ) {
 		return -ENOENT;
 	}
 
+	/* Allocate transmit packet headers */
+	if ( ( rc = virtnet_alloc_tx_headers ( netdev ) ) != 0 ) {
+		virtnet_free_virtqueues ( netdev );
+		vpm_add_status ( &virtnet->vdev, VIRTIO_CONFIG_S_FAILED );
+		return rc;
+	}
+	virtnet_set_rx_features ( netdev, features );
+	virtnet_set_offloads ( netdev, features );
+
 	/* Disable interrupts before starting */
 	netdev_irq ( netdev, 0 );
 
@@ -338,6 +602,10 @@ static void virtnet_close ( struct net_device *netdev ) {
 	}
 	INIT_LIST_HEAD ( &virtnet->rx_iobufs );
 	virtnet->rx_num_iobufs = 0;
+
+	/* Offload and rx buffer features must be renegotiated */
+	virtnet_set_offloads ( netdev, 0 );
+	virtnet->mergeable = 0;
 }
 
 /** Transmit packet
@@ -370,6 +638,100 @@ static void virtnet_process_tx_packets ( struct net_device *netdev ) {
 	}
 }
 
+/** Retrieve a completed rx buffer
+ *
+ * @v netdev	Network device
+ * @ret iobuf	I/O buffer (with length set to the received length)
+ */
+static struct io_buffer * virtnet_get_rx_buf ( struct net_device *netdev ) {
+	struct virtnet_nic *virtnet = netdev->priv;
+	struct vring_virtqueue *rx_vq = &virtnet->virtqueue[RX_INDEX];
+	struct io_buffer *iobuf;
+	unsigned int len;
+
+	iobuf = vring_get_buf ( rx_vq, &len );
+
+	/* Release ownership of iobuf */
+	list_del ( &iobuf->list );
+	virtnet->rx_num_iobufs--;
+
+	/* Update iobuf length */
+	iob_unput ( iobuf, iob_len ( iobuf ) );
+	iob_put ( iobuf, len );
+
+	return iobuf;
+}
+
+/** Merge a packet received into multiple rx buffers
+ *
+ * @v netdev	Network device
+ * @v iobuf	First I/O buffer (with virtio net header stripped)
+ * @v count	Number of rx buffers used by the packet
+ * @ret iobuf	Merged I/O buffer, or NULL on error
+ *
+ * The first I/O buffer will be consumed.  All buffers used by the
+ * packet are consumed even if the packet has to be dropped, so that
+ * the remainder of the packet is not mistaken for a new packet.
+ */
+static struct io_buffer * virtnet_merge_rx ( struct net_device *netdev,
+					     struct io_buffer *iobuf,
+					     unsigned int count ) {
+	struct virtnet_nic *virtnet = netdev->priv;
+	struct vring_virtqueue *rx_vq = &virtnet->virtqueue[RX_INDEX];
+	struct io_buffer *merged = NULL;
+	unsigned int i;
+	int rc = 0;
+
+	/* Sanity check */
+	if ( count > virtnet->rx_fill ) {
+		DBGC ( virtnet, "VIRTIO-NET %p rx impossible buffer count "
+		       "%d\n", virtnet, count );
+		rc = -EPROTO;
+	}
+
+	/* Allocate merged buffer */
+	if ( rc == 0 ) {
+		merged = alloc_iob ( count * MRG_RX_BUF_LEN );
+		if ( merged ) {
+			merged->flags = iobuf->flags;
+		} else {
+			rc = -ENOMEM;
+		}
+	}
+
+	/* Consume each buffer, copying in data if possible.  The
+	 * device makes all buffers for a packet available at the same
+	 * time.
+	 */
+	for ( i = 0 ; i < count ; i++ ) {
+		if ( i ) {
+			if ( ! vring_more_used ( rx_vq ) ) {
+				DBGC ( virtnet, "VIRTIO-NET %p rx missing "
+				       "buffer %d/%d\n", virtnet, i, count );
+				rc = -EPROTO;
+				break;
+			}
+			iobuf = virtnet_get_rx_buf ( netdev );
+		}
+		if ( merged ) {
+			memcpy ( iob_put ( merged, iob_len ( iobuf ) ),
+				 iobuf->data, iob_len ( iobuf ) );
+		}
+		free_iob ( iobuf );
+	}
+	if ( rc != 0 )
+		goto err;
+
+	DBGC2 ( virtnet, "VIRTIO-NET %p rx merged %d buffers (len %zd)\n",
+		virtnet, count, iob_len ( merged ) );
+	return merged;
+
+ err:
+	free_iob ( merged );
+	netdev_rx_err ( netdev, NULL, rc );
+	return NULL;
+}
+
 /** Complete packet reception
  *
  * @v netdev	Network device
@@ -377,18 +739,32 @@ static void virtnet_process_tx_packets ( struct net_device *netdev ) {
 static void virtnet_process_rx_packets ( struct net_device *netdev ) {
 	struct virtnet_nic *virtnet = netdev->priv;
 	struct vring_virtqueue *rx_vq = &virtnet->virtqueue[RX_INDEX];
+	struct virtio_net_hdr_modern *header;
+	struct io_buffer *iobuf;
+	unsigned int count;
 
 	while ( vring_more_used ( rx_vq ) ) {
-		unsigned int len;
-		struct io_buffer *iobuf = vring_get_buf ( rx_vq, &len );
 
-		/* Release ownership of iobuf */
-		list_del ( &iobuf->list );
-		virtnet->rx_num_iobufs--;
+		/* Retrieve completed buffer */
+		iobuf = virtnet_get_rx_buf ( netdev );
 
-		/* Update iobuf length */
-		iob_unput ( iobuf, iob_len ( iobuf ) );
-		iob_put ( iobuf, len - sizeof ( struct virtio_net_hdr ) );
+		/* Record checksum status and strip virtio net header */
+		header = iobuf->data;
+		if ( ( netdev->state & NETDEV_RX_CSUM ) &&
+		     ( header->legacy.flags & ( VIRTIO_NET_HDR_F_NEEDS_CSUM |
+						VIRTIO_NET_HDR_F_DATA_VALID ) ) ) {
+			iobuf->flags |= IOB_FL_CSUM_VERIFIED;
+		}
+		count = ( virtnet->mergeable ?
+			  le16_to_cpu ( header->num_buffers ) : 1 );
+		iob_pull ( iobuf, virtnet_header_len ( virtnet ) );
+
+		/* Merge packets spanning multiple buffers */
+		if ( count > 1 ) {
+			iobuf = virtnet_merge_rx ( netdev, iobuf, count );
+			if ( ! iobuf )
+				continue;
+		}
 
 		DBGC2 ( virtnet, "VIRTIO-NET %p rx complete iobuf %p len %zd\n",
 			virtnet, iobuf, iob_len ( iobuf ) );
@@ -214,7 +214,7 @@ static void vmxnet3_refill_rx ( struct net_device *netdev ) {
 	unsigned int generation;
 
 	/* Fill receive ring to specified fill level */
-	while ( vmxnet->count.rx_fill < VMXNET3_RX_FILL ) {
+	while ( vmxnet->count.rx_fill < vmxnet->rx_target ) {
 
 		/* Locate receive descriptor */
 		desc_idx = ( vmxnet->count.rx_prod % VMXNET3_NUM_RX_DESC );
@@ -223,7 +223,7 @@ static void vmxnet3_refill_rx ( struct net_device *netdev ) {
 		assert ( vmxnet->rx_iobuf[desc_idx] == NULL );
 
 		/* Allocate I/O buffer */
-		iobuf = alloc_iob ( VMXNET3_MTU + NET_IP_ALIGN );
+		iobuf = alloc_rx_iob ( VMXNET3_MTU + NET_IP_ALIGN );
 		if ( ! iobuf ) {
 			/* Non-fatal low memory condition */
 			break;
@@ -267,6 +267,7 @@ static void vmxnet3_poll_rx ( struct net_device *netdev ) {
 	unsigned int comp_idx;
 	unsigned int desc_idx;
 	unsigned int generation;
+	unsigned int received = 0;
 	size_t len;
 
 	while ( 1 ) {
@@ -306,7 +307,12 @@ static void vmxnet3_poll_rx ( struct net_device *netdev ) {
 			vmxnet, comp_idx, desc_idx, len );
 		iob_put ( iobuf, len );
 		netdev_rx ( netdev, iobuf );
+		received++;
 	}
+
+	/* Record overflow if all posted buffers were consumed */
+	if ( received && ( vmxnet->count.rx_fill == 0 ) )
+		netdev_rx_overflow ( netdev );
 }
 
 /**
@@ -533,6 +539,8 @@ static int vmxnet3_open ( struct net_device *netdev ) {
 	}
 
 	/* Fill receive ring */
+	vmxnet->rx_target = netdev_rx_fill ( netdev, VMXNET3_RX_FILL,
+					     ( VMXNET3_MTU + NET_IP_ALIGN ) );
 	vmxnet3_refill_rx ( netdev );
 
 	return 0;
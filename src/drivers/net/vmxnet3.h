@@ -423,11 +423,15 @@ struct vmxnet3_queues {
 /** Number of TX completion descriptors */
 #define VMXNET3_NUM_TX_COMP 32
 
-/** Number of RX descriptors */
-#define VMXNET3_NUM_RX_DESC 32
+/** Number of RX descriptors
+ *
+ * Must be a power of two, since the generation bit is derived from
+ * the producer counter.
+ */
+#define VMXNET3_NUM_RX_DESC 64
 
 /** Number of RX completion descriptors */
-#define VMXNET3_NUM_RX_COMP 32
+#define VMXNET3_NUM_RX_COMP 64
 
 /**
  * DMA areas
@@ -478,6 +482,8 @@ struct vmxnet3_nic {
 	struct vmxnet3_dma *dma;
 	/** Producer and consumer counters */
 	struct vmxnet3_counters count;
+	/** Receive ring target fill level */
+	unsigned int rx_target;
 	/** Transmit I/O buffers */
 	struct io_buffer *tx_iobuf[VMXNET3_NUM_TX_DESC];
 	/** Receive I/O buffers */
@@ -497,7 +503,7 @@ struct vmxnet3_nic {
 #define VMXNET3_TX_FILL ( VMXNET3_NUM_TX_DESC - 1 )
 
 /** Receive ring maximum fill level */
-#define VMXNET3_RX_FILL 8
+#define VMXNET3_RX_FILL ( VMXNET3_NUM_RX_DESC - 1 )
 
 /** Received packet alignment padding */
 #define NET_IP_ALIGN 2
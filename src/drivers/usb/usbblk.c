@@ -0,0 +1,813 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <byteswap.h>
+#include <ipxe/usb.h>
+#include <ipxe/scsi.h>
+#include <ipxe/xfer.h>
+#include <ipxe/uri.h>
+#include <ipxe/open.h>
+#include "usbblk.h"
+
+/** @file
+ *
+ * USB mass storage driver
+ *
+ * This driver supports SCSI devices using the bulk-only transport
+ * (BOT) protocol, and exposes each device as a SCSI command-issuing
+ * interface that may be opened via a "usb:<function>" URI.
+ *
+ */
+
+/** List of USB mass storage devices */
+static LIST_HEAD ( usbblk_devices );
+
+/** Most recently allocated command tag */
+static uint32_t usbblk_tag;
+
+/**
+ * Finish current command
+ *
+ * @v usbblk		USB mass storage device
+ * @v rc		Reason for finishing
+ */
+static void usbblk_stop ( struct usbblk_device *usbblk, int rc ) {
+	struct usbblk_command *cmd = &usbblk->cmd;
+
+	/* Do nothing if no command is in progress */
+	if ( ! cmd->tag )
+		return;
+
+	/* Mark command as complete */
+	if ( rc != 0 ) {
+		DBGC ( usbblk, "USBBLK %s tag %08x failed: %s\n",
+		       usbblk->func->name, cmd->tag, strerror ( rc ) );
+	}
+	cmd->tag = 0;
+
+	/* Close command data interface */
+	intf_restart ( &usbblk->data, rc );
+
+	/* Notify SCSI device that we are ready for a new command */
+	if ( usbblk->opened )
+		xfer_window_changed ( &usbblk->scsi );
+}
+
+/**
+ * Fail current command and schedule reset recovery
+ *
+ * @v usbblk		USB mass storage device
+ * @v rc		Reason for failure
+ */
+static void usbblk_fail ( struct usbblk_device *usbblk, int rc ) {
+
+	/* Schedule reset recovery */
+	usbblk->reset = 1;
+
+	/* Fail command */
+	usbblk_stop ( usbblk, rc );
+}
+
+/**
+ * Close USB mass storage device
+ *
+ * @v usbblk		USB mass storage device
+ * @v rc		Reason for close
+ */
+static void usbblk_close ( struct usbblk_device *usbblk, int rc ) {
+
+	/* Do nothing if device is not open */
+	if ( ! usbblk->opened )
+		return;
+
+	/* Fail any command in progress */
+	usbblk_stop ( usbblk, rc );
+
+	/* Close endpoints (if not already closed by a failed reset)
+	 * and stop process.
+	 */
+	usbblk->opened = 0;
+	if ( usbblk->in.open )
+		usb_endpoint_close ( &usbblk->in );
+	if ( usbblk->out.open )
+		usb_endpoint_close ( &usbblk->out );
+	process_del ( &usbblk->process );
+	DBGC ( usbblk, "USBBLK %s closed\n", usbblk->func->name );
+
+	/* Shut down SCSI command-issuing interface */
+	intf_restart ( &usbblk->scsi, rc );
+}
+
+/**
+ * Perform reset recovery
+ *
+ * @v usbblk		USB mass storage device
+ * @ret rc		Return status code
+ */
+static int usbblk_reset ( struct usbblk_device *usbblk ) {
+	struct usb_device *usb = usbblk->func->usb;
+	int rc;
+
+	DBGC ( usbblk, "USBBLK %s performing reset recovery\n",
+	       usbblk->func->name );
+
+	/* Close endpoints (cancelling any outstanding transfers) */
+	usb_endpoint_close ( &usbblk->in );
+	usb_endpoint_close ( &usbblk->out );
+
+	/* Issue mass storage reset */
+	if ( ( rc = usb_control ( usb, USBBLK_RESET, 0, usbblk->interface,
+				  NULL, 0 ) ) != 0 ) {
+		DBGC ( usbblk, "USBBLK %s could not reset: %s\n",
+		       usbblk->func->name, strerror ( rc ) );
+		goto err_reset;
+	}
+
+	/* Clear halt conditions on both bulk endpoints */
+	if ( ( rc = usb_clear_feature ( usb, USB_RECIP_ENDPOINT,
+					USB_ENDPOINT_HALT,
+					usbblk->in.address ) ) != 0 ) {
+		goto err_clear_in;
+	}
+	if ( ( rc = usb_clear_feature ( usb, USB_RECIP_ENDPOINT,
+					USB_ENDPOINT_HALT,
+					usbblk->out.address ) ) != 0 ) {
+		goto err_clear_out;
+	}
+
+	/* Reopen endpoints */
+	if ( ( rc = usb_endpoint_open ( &usbblk->out ) ) != 0 )
+		goto err_open_out;
+	if ( ( rc = usb_endpoint_open ( &usbblk->in ) ) != 0 )
+		goto err_open_in;
+
+	return 0;
+
+	usb_endpoint_close ( &usbblk->in );
+ err_open_in:
+	usb_endpoint_close ( &usbblk->out );
+ err_open_out:
+ err_clear_out:
+ err_clear_in:
+ err_reset:
+	return rc;
+}
+
+/**
+ * Calculate length of next data phase transfer
+ *
+ * @v usbblk		USB mass storage device
+ * @ret len		Length of transfer
+ */
+static size_t usbblk_chunk ( struct usbblk_device *usbblk ) {
+	struct usbblk_command *cmd = &usbblk->cmd;
+	size_t len = ( cmd->len - cmd->offset );
+
+	if ( len > USBBLK_MAX_LEN )
+		len = USBBLK_MAX_LEN;
+	return len;
+}
+
+/**
+ * Enqueue next data-out transfer
+ *
+ * @v usbblk		USB mass storage device
+ * @ret rc		Return status code
+ */
+static int usbblk_out_data ( struct usbblk_device *usbblk ) {
+	struct usbblk_command *cmd = &usbblk->cmd;
+	struct io_buffer *iobuf;
+	size_t len = usbblk_chunk ( usbblk );
+	int rc;
+
+	/* Allocate and populate I/O buffer */
+	iobuf = alloc_iob ( len );
+	if ( ! iobuf )
+		return -ENOMEM;
+	copy_from_user ( iob_put ( iobuf, len ), cmd->scsi.data_out,
+			 cmd->offset, len );
+
+	/* Enqueue I/O buffer */
+	if ( ( rc = usb_stream ( &usbblk->out, iobuf, 0 ) ) != 0 ) {
+		free_iob ( iobuf );
+		return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * Enqueue next data-in transfer
+ *
+ * @v usbblk		USB mass storage device
+ * @ret rc		Return status code
+ */
+static int usbblk_in_data ( struct usbblk_device *usbblk ) {
+	struct io_buffer *iobuf;
+	size_t len = usbblk_chunk ( usbblk );
+	int rc;
+
+	/* Allocate I/O buffer */
+	iobuf = alloc_iob ( len );
+	if ( ! iobuf )
+		return -ENOMEM;
+	iob_put ( iobuf, len );
+
+	/* Enqueue I/O buffer */
+	if ( ( rc = usb_stream ( &usbblk->in, iobuf, 0 ) ) != 0 ) {
+		free_iob ( iobuf );
+		return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * Enqueue command status transfer
+ *
+ * @v usbblk		USB mass storage device
+ * @ret rc		Return status code
+ */
+static int usbblk_in_status ( struct usbblk_device *usbblk ) {
+	struct usbblk_command *cmd = &usbblk->cmd;
+	struct io_buffer *iobuf;
+	size_t len = usbblk->in.mtu;
+	int rc;
+
+	/* Fail if we have already retried */
+	if ( cmd->attempts++ >= USBBLK_MAX_ATTEMPTS )
+		return -EPROTO;
+
+	/* Allocate a full-packet I/O buffer, to avoid babble errors */
+	assert ( len >= sizeof ( struct usbblk_status_wrapper ) );
+	iobuf = alloc_iob ( len );
+	if ( ! iobuf )
+		return -ENOMEM;
+	iob_put ( iobuf, len );
+
+	/* Enqueue I/O buffer */
+	if ( ( rc = usb_stream ( &usbblk->in, iobuf, 0 ) ) != 0 ) {
+		free_iob ( iobuf );
+		return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * USB mass storage process
+ *
+ * @v usbblk		USB mass storage device
+ */
+static void usbblk_step ( struct usbblk_device *usbblk ) {
+	struct usbblk_command *cmd = &usbblk->cmd;
+	int rc;
+
+	/* Poll USB bus */
+	usb_poll ( usbblk->bus );
+
+	/* Perform reset recovery, if required */
+	if ( usbblk->reset ) {
+		usbblk->reset = 0;
+		if ( ( rc = usbblk_reset ( usbblk ) ) != 0 ) {
+			usbblk_close ( usbblk, rc );
+			return;
+		}
+	}
+
+	/* Do nothing unless a command is in progress and both
+	 * endpoints are idle.
+	 */
+	if ( ! ( cmd->tag && cmd->sent ) )
+		return;
+	if ( usbblk->out.fill || usbblk->in.fill )
+		return;
+
+	/* Continue data phase, or read command status */
+	if ( cmd->offset < cmd->len ) {
+		if ( cmd->scsi.data_in_len ) {
+			rc = usbblk_in_data ( usbblk );
+		} else {
+			rc = usbblk_out_data ( usbblk );
+		}
+	} else {
+		rc = usbblk_in_status ( usbblk );
+	}
+	if ( rc != 0 )
+		usbblk_fail ( usbblk, rc );
+}
+
+/** USB mass storage process descriptor */
+static struct process_descriptor usbblk_process_desc =
+	PROC_DESC ( struct usbblk_device, process, usbblk_step );
+
+/**
+ * Complete bulk OUT transfer
+ *
+ * @v ep		USB endpoint
+ * @v iobuf		I/O buffer
+ * @v rc		Completion status code
+ */
+static void usbblk_out_complete ( struct usb_endpoint *ep,
+				  struct io_buffer *iobuf, int rc ) {
+	struct usbblk_device *usbblk =
+		container_of ( ep, struct usbblk_device, out );
+	struct usbblk_command *cmd = &usbblk->cmd;
+	size_t len = iob_len ( iobuf );
+
+	/* Free I/O buffer */
+	free_iob ( iobuf );
+
+	/* Ignore transfers cancelled when the endpoint closes, or
+	 * completing after the command has been abandoned.
+	 */
+	if ( ! ( ep->open && cmd->tag ) )
+		return;
+
+	/* Handle command block wrapper completion */
+	if ( ! cmd->sent ) {
+		if ( rc != 0 ) {
+			usbblk_fail ( usbblk, rc );
+			return;
+		}
+		cmd->sent = 1;
+		return;
+	}
+
+	/* Handle data-out completion.  A stalled data phase is ended
+	 * early; the endpoint halt will be cleared automatically and
+	 * the command status will report the residue.
+	 */
+	if ( rc != 0 ) {
+		DBGC ( usbblk, "USBBLK %s tag %08x data-out failed: %s\n",
+		       usbblk->func->name, cmd->tag, strerror ( rc ) );
+		cmd->len = cmd->offset;
+		return;
+	}
+	cmd->offset += len;
+}
+
+/**
+ * Handle command status
+ *
+ * @v usbblk		USB mass storage device
+ * @v iobuf		I/O buffer
+ */
+static void usbblk_status ( struct usbblk_device *usbblk,
+			    struct io_buffer *iobuf ) {
+	struct usbblk_command *cmd = &usbblk->cmd;
+	struct usbblk_status_wrapper *csw = iobuf->data;
+	struct scsi_rsp response;
+
+	/* Sanity checks */
+	if ( ( iob_len ( iobuf ) != sizeof ( *csw ) ) ||
+	     ( csw->signature != cpu_to_le32 ( USBBLK_STATUS_SIGNATURE ) ) ||
+	     ( csw->tag != cpu_to_le32 ( cmd->tag ) ) ) {
+		DBGC ( usbblk, "USBBLK %s tag %08x invalid status:\n",
+		       usbblk->func->name, cmd->tag );
+		DBGC_HDA ( usbblk, 0, iobuf->data, iob_len ( iobuf ) );
+		usbblk_fail ( usbblk, -EPROTO );
+		return;
+	}
+
+	/* Treat phase errors as fatal */
+	if ( csw->status >= USBBLK_STATUS_PHASE_ERROR ) {
+		DBGC ( usbblk, "USBBLK %s tag %08x phase error\n",
+		       usbblk->func->name, cmd->tag );
+		usbblk_fail ( usbblk, -EPROTO );
+		return;
+	}
+
+	/* Construct SCSI response.  The bulk-only transport does not
+	 * provide autosense data, so a failed command is reported as
+	 * CHECK CONDITION with empty sense data.
+	 */
+	memset ( &response, 0, sizeof ( response ) );
+	if ( csw->status != USBBLK_STATUS_PASSED )
+		response.status = USBBLK_SCSI_CHECK_CONDITION;
+	response.overrun = -( ( ssize_t ) le32_to_cpu ( csw->residue ) );
+
+	/* Report SCSI response and complete command */
+	scsi_response ( &usbblk->data, &response );
+	usbblk_stop ( usbblk, 0 );
+}
+
+/**
+ * Complete bulk IN transfer
+ *
+ * @v ep		USB endpoint
+ * @v iobuf		I/O buffer
+ * @v rc		Completion status code
+ */
+static void usbblk_in_complete ( struct usb_endpoint *ep,
+				 struct io_buffer *iobuf, int rc ) {
+	struct usbblk_device *usbblk =
+		container_of ( ep, struct usbblk_device, in );
+	struct usbblk_command *cmd = &usbblk->cmd;
+	size_t expected;
+	size_t len;
+
+	/* Ignore transfers cancelled when the endpoint closes, or
+	 * completing after the command has been abandoned.
+	 */
+	if ( ! ( ep->open && cmd->tag ) )
+		goto done;
+
+	/* Handle data-in completion */
+	if ( cmd->offset < cmd->len ) {
+
+		/* End data phase early on any error (e.g. a stall) */
+		if ( rc != 0 ) {
+			DBGC ( usbblk, "USBBLK %s tag %08x data-in failed: "
+			       "%s\n", usbblk->func->name, cmd->tag,
+			       strerror ( rc ) );
+			cmd->len = cmd->offset;
+			goto done;
+		}
+
+		/* Copy out data */
+		expected = usbblk_chunk ( usbblk );
+		len = iob_len ( iobuf );
+		if ( len > expected )
+			len = expected;
+		copy_to_user ( cmd->scsi.data_in, cmd->offset,
+			       iobuf->data, len );
+		cmd->offset += len;
+
+		/* A short transfer ends the data phase */
+		if ( len < expected )
+			cmd->len = cmd->offset;
+		goto done;
+	}
+
+	/* Handle command status completion.  A failed status read
+	 * will be retried (if permitted) by the command process.
+	 */
+	if ( rc != 0 ) {
+		DBGC ( usbblk, "USBBLK %s tag %08x status failed: %s\n",
+		       usbblk->func->name, cmd->tag, strerror ( rc ) );
+		goto done;
+	}
+	usbblk_status ( usbblk, iobuf );
+
+ done:
+	free_iob ( iobuf );
+}
+
+/** Bulk OUT endpoint operations */
+static struct usb_endpoint_driver_operations usbblk_out_operations = {
+	.complete = usbblk_out_complete,
+};
+
+/** Bulk IN endpoint operations */
+static struct usb_endpoint_driver_operations usbblk_in_operations = {
+	.complete = usbblk_in_complete,
+};
+
+/**
+ * Check SCSI command flow-control window
+ *
+ * @v usbblk		USB mass storage device
+ * @ret len		Length of window
+ */
+static size_t usbblk_window ( struct usbblk_device *usbblk ) {
+
+	/* We can handle only one command at a time */
+	return ( ( usbblk->opened && ( ! usbblk->cmd.tag ) &&
+		   ( ! usbblk->reset ) ) ? 1 : 0 );
+}
+
+/**
+ * Issue SCSI command
+ *
+ * @v usbblk		USB mass storage device
+ * @v data		SCSI data interface
+ * @v command		SCSI command
+ * @ret tag		Command tag, or negative error
+ */
+static int usbblk_scsi_command ( struct usbblk_device *usbblk,
+				 struct interface *data,
+				 struct scsi_cmd *command ) {
+	struct usbblk_command *cmd = &usbblk->cmd;
+	struct usbblk_command_wrapper *cbw;
+	struct io_buffer *iobuf;
+	int rc;
+
+	/* Fail if we cannot accept a new command */
+	if ( ! usbblk_window ( usbblk ) ) {
+		DBGC ( usbblk, "USBBLK %s cannot handle concurrent "
+		       "commands\n", usbblk->func->name );
+		return -EBUSY;
+	}
+
+	/* Bidirectional commands are not supported by the bulk-only
+	 * transport.
+	 */
+	if ( command->data_in_len && command->data_out_len )
+		return -ENOTSUP;
+
+	/* Allocate command block wrapper */
+	iobuf = alloc_iob ( sizeof ( *cbw ) );
+	if ( ! iobuf )
+		return -ENOMEM;
+
+	/* Record command */
+	memset ( cmd, 0, sizeof ( *cmd ) );
+	memcpy ( &cmd->scsi, command, sizeof ( cmd->scsi ) );
+	cmd->len = ( command->data_in_len + command->data_out_len );
+	usbblk_tag = ( ( usbblk_tag + 1 ) & 0x7fffffffUL );
+	if ( ! usbblk_tag )
+		usbblk_tag = 1;
+
+	/* Construct command block wrapper */
+	cbw = iob_put ( iobuf, sizeof ( *cbw ) );
+	memset ( cbw, 0, sizeof ( *cbw ) );
+	cbw->signature = cpu_to_le32 ( USBBLK_COMMAND_SIGNATURE );
+	cbw->tag = cpu_to_le32 ( usbblk_tag );
+	cbw->len = cpu_to_le32 ( cmd->len );
+	cbw->flags = ( command->data_in_len ? USBBLK_COMMAND_FLAG_IN : 0 );
+	cbw->cblen = sizeof ( cbw->cb );
+	linker_assert ( sizeof ( cbw->cb ) == sizeof ( command->cdb ),
+			cdb_size_mismatch );
+	memcpy ( cbw->cb, &command->cdb, sizeof ( cbw->cb ) );
+
+	/* Enqueue command block wrapper */
+	if ( ( rc = usb_stream ( &usbblk->out, iobuf, 0 ) ) != 0 ) {
+		DBGC ( usbblk, "USBBLK %s could not send command: %s\n",
+		       usbblk->func->name, strerror ( rc ) );
+		free_iob ( iobuf );
+		return rc;
+	}
+
+	/* Mark command as in progress and attach to data interface */
+	cmd->tag = usbblk_tag;
+	intf_plug_plug ( &usbblk->data, data );
+	DBGC2 ( usbblk, "USBBLK %s tag %08x " SCSI_CDB_FORMAT " %s %#zx\n",
+		usbblk->func->name, cmd->tag, SCSI_CDB_DATA ( command->cdb ),
+		( command->data_in_len ? "in" : "out" ), cmd->len );
+
+	return cmd->tag;
+}
+
+/**
+ * Close SCSI command data interface
+ *
+ * @v usbblk		USB mass storage device
+ * @v rc		Reason for close
+ */
+static void usbblk_data_close ( struct usbblk_device *usbblk, int rc ) {
+
+	/* An abandoned command leaves the device in an unknown
+	 * state, so fail it and perform reset recovery.
+	 */
+	if ( usbblk->cmd.tag ) {
+		usbblk_fail ( usbblk, ( ( rc == 0 ) ? -ECANCELED : rc ) );
+	} else {
+		intf_restart ( &usbblk->data, rc );
+	}
+}
+
+/** USB mass storage SCSI command-issuing interface operations */
+static struct interface_operation usbblk_scsi_op[] = {
+	INTF_OP ( scsi_command, struct usbblk_device *, usbblk_scsi_command ),
+	INTF_OP ( xfer_window, struct usbblk_device *, usbblk_window ),
+	INTF_OP ( intf_close, struct usbblk_device *, usbblk_close ),
+};
+
+/** USB mass storage SCSI command-issuing interface descriptor */
+static struct interface_descriptor usbblk_scsi_desc =
+	INTF_DESC ( struct usbblk_device, scsi, usbblk_scsi_op );
+
+/** USB mass storage SCSI data interface operations */
+static struct interface_operation usbblk_data_op[] = {
+	INTF_OP ( intf_close, struct usbblk_device *, usbblk_data_close ),
+};
+
+/** USB mass storage SCSI data interface descriptor */
+static struct interface_descriptor usbblk_data_desc =
+	INTF_DESC ( struct usbblk_device, data, usbblk_data_op );
+
+/**
+ * Open USB mass storage device
+ *
+ * @v usbblk		USB mass storage device
+ * @v block		Block control interface
+ * @ret rc		Return status code
+ */
+static int usbblk_open ( struct usbblk_device *usbblk,
+			 struct interface *block ) {
+	struct scsi_lun lun;
+	int rc;
+
+	/* Fail if device is already open */
+	if ( usbblk->opened ) {
+		DBGC ( usbblk, "USBBLK %s is already open\n",
+		       usbblk->func->name );
+		rc = -EBUSY;
+		goto err_opened;
+	}
+
+	/* Open endpoints */
+	if ( ( rc = usb_endpoint_open ( &usbblk->out ) ) != 0 ) {
+		DBGC ( usbblk, "USBBLK %s could not open bulk OUT: %s\n",
+		       usbblk->func->name, strerror ( rc ) );
+		goto err_open_out;
+	}
+	if ( ( rc = usb_endpoint_open ( &usbblk->in ) ) != 0 ) {
+		DBGC ( usbblk, "USBBLK %s could not open bulk IN: %s\n",
+		       usbblk->func->name, strerror ( rc ) );
+		goto err_open_in;
+	}
+
+	/* Start process */
+	usbblk->opened = 1;
+	usbblk->reset = 0;
+	process_add ( &usbblk->process );
+
+	/* Attach SCSI device to parent interface (using LUN 0) */
+	memset ( &lun, 0, sizeof ( lun ) );
+	if ( ( rc = scsi_open ( block, &usbblk->scsi, &lun ) ) != 0 ) {
+		DBGC ( usbblk, "USBBLK %s could not create SCSI device: %s\n",
+		       usbblk->func->name, strerror ( rc ) );
+		goto err_scsi_open;
+	}
+	DBGC ( usbblk, "USBBLK %s opened\n", usbblk->func->name );
+
+	return 0;
+
+ err_scsi_open:
+	usbblk_close ( usbblk, rc );
+	return rc;
+
+	usb_endpoint_close ( &usbblk->in );
+ err_open_in:
+	usb_endpoint_close ( &usbblk->out );
+ err_open_out:
+ err_opened:
+	return rc;
+}
+
+/**
+ * Open USB mass storage device URI
+ *
+ * @v parent		Parent interface
+ * @v uri		URI
+ * @ret rc		Return status code
+ *
+ * The URI opaque part identifies the USB function by name (e.g.
+ * "usb:0000:00:14.0-3-1.0").  If no name is given, the first USB
+ * mass storage device is used.
+ */
+static int usbblk_open_uri ( struct interface *parent, struct uri *uri ) {
+	struct usbblk_device *usbblk;
+	const char *name = uri->opaque;
+
+	/* Find matching device */
+	list_for_each_entry ( usbblk, &usbblk_devices, list ) {
+		if ( name && name[0] &&
+		     ( strcmp ( usbblk->func->name, name ) != 0 ) )
+			continue;
+		return usbblk_open ( usbblk, parent );
+	}
+
+	DBG ( "USBBLK could not find device \"%s\"\n", ( name ? name : "" ) );
+	return -ENOENT;
+}
+
+/** USB mass storage URI opener */
+struct uri_opener usbblk_uri_opener __uri_opener = {
+	.scheme = "usb",
+	.open = usbblk_open_uri,
+};
+
+/**
+ * Probe device
+ *
+ * @v func		USB function
+ * @v config		Configuration descriptor
+ * @ret rc		Return status code
+ */
+static int usbblk_probe ( struct usb_function *func,
+			  struct usb_configuration_descriptor *config ) {
+	struct usb_device *usb = func->usb;
+	struct usbblk_device *usbblk;
+	struct usb_interface_descriptor *desc;
+	int rc;
+
+	/* Allocate and initialise structure */
+	usbblk = zalloc ( sizeof ( *usbblk ) );
+	if ( ! usbblk ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	ref_init ( &usbblk->refcnt, NULL );
+	usbblk->func = func;
+	usbblk->bus = usb->port->hub->bus;
+	usbblk->interface = func->interface[0];
+	usb_endpoint_init ( &usbblk->out, usb, &usbblk_out_operations );
+	usb_endpoint_init ( &usbblk->in, usb, &usbblk_in_operations );
+	intf_init ( &usbblk->scsi, &usbblk_scsi_desc, &usbblk->refcnt );
+	intf_init ( &usbblk->data, &usbblk_data_desc, &usbblk->refcnt );
+	process_init_stopped ( &usbblk->process, &usbblk_process_desc,
+			       &usbblk->refcnt );
+
+	/* Locate interface descriptor */
+	desc = usb_interface_descriptor ( config, usbblk->interface, 0 );
+	if ( ! desc ) {
+		DBGC ( usbblk, "USBBLK %s missing interface descriptor\n",
+		       func->name );
+		rc = -ENOENT;
+		goto err_desc;
+	}
+
+	/* Describe endpoints */
+	if ( ( rc = usb_endpoint_described ( &usbblk->out, config, desc,
+					     USB_BULK_OUT, 0 ) ) != 0 ) {
+		DBGC ( usbblk, "USBBLK %s could not describe bulk OUT: %s\n",
+		       func->name, strerror ( rc ) );
+		goto err_out;
+	}
+	if ( ( rc = usb_endpoint_described ( &usbblk->in, config, desc,
+					     USB_BULK_IN, 0 ) ) != 0 ) {
+		DBGC ( usbblk, "USBBLK %s could not describe bulk IN: %s\n",
+		       func->name, strerror ( rc ) );
+		goto err_in;
+	}
+
+	/* Add to list of devices */
+	list_add_tail ( &usbblk->list, &usbblk_devices );
+	usb_func_set_drvdata ( func, usbblk );
+	DBGC ( usbblk, "USBBLK %s is a mass storage device\n", func->name );
+
+	return 0;
+
+ err_in:
+ err_out:
+ err_desc:
+	ref_put ( &usbblk->refcnt );
+ err_alloc:
+	return rc;
+}
+
+/**
+ * Remove device
+ *
+ * @v func		USB function
+ */
+static void usbblk_remove ( struct usb_function *func ) {
+	struct usbblk_device *usbblk = usb_func_get_drvdata ( func );
+
+	/* Close device */
+	usbblk_close ( usbblk, -ENODEV );
+
+	/* Remove from list of devices */
+	list_del ( &usbblk->list );
+
+	/* Drop reference */
+	ref_put ( &usbblk->refcnt );
+}
+
+/** USB mass storage device IDs */
+static struct usb_device_id usbblk_ids[] = {
+	{
+		.name = "usbblk",
+		.vendor = USB_ANY_ID,
+		.product = USB_ANY_ID,
+	},
+};
+
+/** USB mass storage driver */
+struct usb_driver usbblk_driver __usb_driver = {
+	.ids = usbblk_ids,
+	.id_count = ( sizeof ( usbblk_ids ) / sizeof ( usbblk_ids[0] ) ),
+	.class = USB_CLASS_ID ( USB_CLASS_MSC, USB_SUBCLASS_MSC_SCSI,
+				USB_PROTOCOL_MSC_BULK ),
+	.score = USB_SCORE_NORMAL,
+	.probe = usbblk_probe,
+	.remove = usbblk_remove,
+};
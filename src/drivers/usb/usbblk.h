@@ -0,0 +1,145 @@
+#ifndef _USBBLK_H
+#define _USBBLK_H
+
+/** @file
+ *
+ * USB mass storage driver
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <ipxe/usb.h>
+#include <ipxe/scsi.h>
+#include <ipxe/interface.h>
+#include <ipxe/process.h>
+
+/** Mass storage class code */
+#define USB_CLASS_MSC 0x08
+
+/** SCSI command set subclass code */
+#define USB_SUBCLASS_MSC_SCSI 0x06
+
+/** Bulk-only transport protocol */
+#define USB_PROTOCOL_MSC_BULK 0x50
+
+/** Mass storage reset command */
+#define USBBLK_RESET ( USB_DIR_OUT | USB_TYPE_CLASS |			\
+		       USB_RECIP_INTERFACE | USB_REQUEST_TYPE ( 255 ) )
+
+/** Command block wrapper */
+struct usbblk_command_wrapper {
+	/** Signature */
+	uint32_t signature;
+	/** Tag */
+	uint32_t tag;
+	/** Data transfer length */
+	uint32_t len;
+	/** Flags */
+	uint8_t flags;
+	/** LUN */
+	uint8_t lun;
+	/** Command block length */
+	uint8_t cblen;
+	/** Command block */
+	uint8_t cb[16];
+} __attribute__ (( packed ));
+
+/** Command block wrapper signature */
+#define USBBLK_COMMAND_SIGNATURE 0x43425355UL
+
+/** Data-in command flag */
+#define USBBLK_COMMAND_FLAG_IN 0x80
+
+/** Command status wrapper */
+struct usbblk_status_wrapper {
+	/** Signature */
+	uint32_t signature;
+	/** Tag */
+	uint32_t tag;
+	/** Data residue */
+	uint32_t residue;
+	/** Status */
+	uint8_t status;
+} __attribute__ (( packed ));
+
+/** Command status wrapper signature */
+#define USBBLK_STATUS_SIGNATURE 0x53425355UL
+
+/** Command passed status */
+#define USBBLK_STATUS_PASSED 0x00
+
+/** Command failed status */
+#define USBBLK_STATUS_FAILED 0x01
+
+/** Phase error status */
+#define USBBLK_STATUS_PHASE_ERROR 0x02
+
+/** SCSI CHECK CONDITION status */
+#define USBBLK_SCSI_CHECK_CONDITION 0x02
+
+/** A USB mass storage command */
+struct usbblk_command {
+	/** SCSI command */
+	struct scsi_cmd scsi;
+	/** Command tag (or zero if no command is in progress) */
+	uint32_t tag;
+	/** Command block wrapper has been sent */
+	int sent;
+	/** Length of data phase */
+	size_t len;
+	/** Offset within data phase */
+	size_t offset;
+	/** Number of attempts to read command status */
+	unsigned int attempts;
+};
+
+/** A USB mass storage device */
+struct usbblk_device {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** List of all USB mass storage devices */
+	struct list_head list;
+
+	/** USB function */
+	struct usb_function *func;
+	/** USB bus */
+	struct usb_bus *bus;
+	/** Interface number */
+	unsigned int interface;
+	/** Bulk OUT endpoint */
+	struct usb_endpoint out;
+	/** Bulk IN endpoint */
+	struct usb_endpoint in;
+
+	/** SCSI command-issuing interface */
+	struct interface scsi;
+	/** SCSI command data interface */
+	struct interface data;
+	/** Command process */
+	struct process process;
+	/** Device is open */
+	int opened;
+	/** Device requires reset recovery */
+	int reset;
+
+	/** Current command (if any) */
+	struct usbblk_command cmd;
+};
+
+/** Maximum length of a single data phase transfer
+ *
+ * This is a policy decision.  Larger transfers reduce the per-transfer
+ * overhead, at the cost of requiring a larger bounce buffer.
+ */
+#define USBBLK_MAX_LEN ( 64 * 1024 )
+
+/** Maximum number of attempts to read command status
+ *
+ * As per the bulk-only transport specification, a stalled status
+ * read is retried once (after clearing the halt condition).
+ */
+#define USBBLK_MAX_ATTEMPTS 2
+
+#endif /* _USBBLK_H */
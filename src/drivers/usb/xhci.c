@@ -2619,13 +2619,26 @@ static int xhci_endpoint_stream ( struct usb_endpoint *ep,
 					 count ) ) != 0 )
 		return rc;
 
-	/* Ring the doorbell */
-	xhci_doorbell ( &endpoint->ring );
+	/* Ring the doorbell, unless deferred until the end of a batch */
+	if ( ! ep->batch )
+		xhci_doorbell ( &endpoint->ring );
 
 	profile_stop ( &xhci_stream_profiler );
 	return 0;
 }
 
+/**
+ * Start batched stream transfers
+ *
+ * @v ep		USB endpoint
+ */
+static void xhci_endpoint_doorbell ( struct usb_endpoint *ep ) {
+	struct xhci_endpoint *endpoint = usb_endpoint_get_hostdata ( ep );
+
+	/* Ring the doorbell */
+	xhci_doorbell ( &endpoint->ring );
+}
+
 /******************************************************************************
  *
  * Device operations
@@ -3138,6 +3151,7 @@ static struct usb_host_operations xhci_operations = {
 		.mtu = xhci_endpoint_mtu,
 		.message = xhci_endpoint_message,
 		.stream = xhci_endpoint_stream,
+		.doorbell = xhci_endpoint_doorbell,
 	},
 	.device = {
 		.open = xhci_device_open,
@@ -967,9 +967,11 @@ xhci_ring_consumed ( struct xhci_trb_ring *ring ) {
 
 /** Number of TRBs in a transfer ring
  *
- * This is a policy decision.
+ * This is a policy decision.  The ring (including its Link TRB)
+ * must fit within a single page, and must be deep enough to hold
+ * the maximum fill level of any bulk endpoint.
  */
-#define XHCI_TRANSFER_TRBS_LOG2 6
+#define XHCI_TRANSFER_TRBS_LOG2 7
 
 /** Maximum time to wait for BIOS to release ownership
  *
@@ -0,0 +1,87 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdio.h>
+#include <errno.h>
+#include <getopt.h>
+#include <ipxe/uri.h>
+#include <ipxe/command.h>
+#include <ipxe/parseopt.h>
+#include <usr/diskwrite.h>
+
+/** @file
+ *
+ * Local disk writing commands
+ *
+ */
+
+/** "diskwrite" options */
+struct diskwrite_options {
+	/** Download timeout */
+	unsigned long timeout;
+};
+
+/** "diskwrite" option list */
+static struct option_descriptor diskwrite_opts[] = {
+	OPTION_DESC ( "timeout", 't', required_argument,
+		      struct diskwrite_options, timeout, parse_timeout ),
+};
+
+/** "diskwrite" command descriptor */
+static struct command_descriptor diskwrite_cmd =
+	COMMAND_DESC ( struct diskwrite_options, diskwrite_opts, 2, 2,
+		       "<disk> <uri>" );
+
+/**
+ * The "diskwrite" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int diskwrite_exec ( int argc, char **argv ) {
+	struct diskwrite_options opts;
+	struct uri *uri;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &diskwrite_cmd, &opts ) ) != 0 )
+		return rc;
+
+	/* Parse URI */
+	uri = parse_uri ( argv[ optind + 1 ] );
+	if ( ! uri )
+		return -ENOMEM;
+
+	/* Write to disk */
+	rc = diskwrite ( argv[optind], uri, opts.timeout );
+	uri_put ( uri );
+
+	return rc;
+}
+
+/** Local disk writing commands */
+struct command diskwrite_command __command = {
+	.name = "diskwrite",
+	.exec = diskwrite_exec,
+};
@@ -0,0 +1,93 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+#include <stdio.h>
+#include <errno.h>
+#include <getopt.h>
+#include <ipxe/uri.h>
+#include <ipxe/command.h>
+#include <ipxe/parseopt.h>
+#include <usr/httpbench.h>
+
+/** @file
+ *
+ * Download benchmarking commands
+ *
+ */
+
+/** "httpbench" options */
+struct httpbench_options {
+	/** Download timeout */
+	unsigned long timeout;
+};
+
+/** "httpbench" option list */
+static struct option_descriptor httpbench_opts[] = {
+	OPTION_DESC ( "timeout", 't', required_argument,
+		      struct httpbench_options, timeout, parse_timeout ),
+};
+
+/** "httpbench" command descriptor */
+static struct command_descriptor httpbench_cmd =
+	COMMAND_DESC ( struct httpbench_options, httpbench_opts, 1,
+		       MAX_ARGUMENTS, "<uri> [<uri>...]" );
+
+/**
+ * The "httpbench" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int httpbench_exec ( int argc, char **argv ) {
+	struct httpbench_options opts;
+	struct uri *uri;
+	int i;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &httpbench_cmd, &opts ) ) != 0 )
+		return rc;
+
+	/* Benchmark each URI in turn */
+	for ( i = optind ; i < argc ; i++ ) {
+
+		/* Parse URI */
+		uri = parse_uri ( argv[i] );
+		if ( ! uri )
+			return -ENOMEM;
+
+		/* Benchmark download */
+		rc = httpbench ( uri, opts.timeout );
+		uri_put ( uri );
+		if ( rc != 0 )
+			return rc;
+	}
+
+	return 0;
+}
+
+/** Download benchmarking commands */
+struct command httpbench_command __command = {
+	.name = "httpbench",
+	.exec = httpbench_exec,
+};
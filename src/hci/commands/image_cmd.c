@@ -32,6 +32,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/command.h>
 #include <ipxe/parseopt.h>
 #include <ipxe/shell.h>
+#include <ipxe/uri.h>
 #include <usr/imgmgmt.h>
 
 /** @file
@@ -50,6 +51,8 @@ struct imgsingle_options {
 	int replace;
 	/** Free image after execution */
 	int autofree;
+	/** Download image in the background */
+	int background;
 };
 
 /** "img{single}" option list */
@@ -124,7 +127,11 @@ static int imgsingle_exec ( int argc, char **argv,
 	}
 
 	/* Acquire the image */
-	if ( name_uri ) {
+	if ( name_uri && opts.background ) {
+		if ( ( rc = imgdownload_background ( name_uri,
+						     &image ) ) != 0 )
+			goto err_acquire;
+	} else if ( name_uri ) {
 		if ( ( rc = desc->acquire ( name_uri, opts.timeout,
 					    &image ) ) != 0 )
 			goto err_acquire;
@@ -184,9 +191,21 @@ static int imgsingle_exec ( int argc, char **argv,
 	return rc;
 }
 
+/** "imgfetch" option list */
+static struct option_descriptor imgfetch_opts[] = {
+	OPTION_DESC ( "name", 'n', required_argument,
+		      struct imgsingle_options, name, parse_string ),
+	OPTION_DESC ( "timeout", 't', required_argument,
+		      struct imgsingle_options, timeout, parse_timeout),
+	OPTION_DESC ( "autofree", 'a', no_argument,
+		      struct imgsingle_options, autofree, parse_flag ),
+	OPTION_DESC ( "background", 'b', no_argument,
+		      struct imgsingle_options, background, parse_flag ),
+};
+
 /** "imgfetch" command descriptor */
 static struct command_descriptor imgfetch_cmd =
-	COMMAND_DESC ( struct imgsingle_options, opts.imgsingle,
+	COMMAND_DESC ( struct imgsingle_options, imgfetch_opts,
 		       1, MAX_ARGUMENTS, "<uri> [<arguments>...]" );
 
 /** "imgfetch" family command descriptor */
@@ -392,6 +411,147 @@ static int imgfree_exec ( int argc, char **argv ) {
 	return imgmulti_exec ( argc, argv, unregister_image );
 }
 
+/** "prefetch" options */
+struct prefetch_options {};
+
+/** "prefetch" option list */
+static struct option_descriptor prefetch_opts[] = {};
+
+/** "prefetch" command descriptor */
+static struct command_descriptor prefetch_cmd =
+	COMMAND_DESC ( struct prefetch_options, prefetch_opts, 1, MAX_ARGUMENTS,
+		       "<uri> [<uri>...]" );
+
+/**
+ * The "prefetch" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int prefetch_exec ( int argc, char **argv ) {
+	struct prefetch_options opts;
+	struct uri *uri;
+	int i;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &prefetch_cmd, &opts ) ) != 0 )
+		return rc;
+
+	/* Start downloading each image in the background */
+	for ( i = optind ; i < argc ; i++ ) {
+		uri = parse_uri ( argv[i] );
+		if ( ! uri )
+			return -ENOMEM;
+		rc = imgprefetch ( uri );
+		uri_put ( uri );
+		if ( rc != 0 )
+			return rc;
+	}
+
+	return 0;
+}
+
+/** "imgwait" options */
+struct imgwait_options {
+	/** Download timeout */
+	unsigned long timeout;
+};
+
+/** "imgwait" option list */
+static struct option_descriptor imgwait_opts[] = {
+	OPTION_DESC ( "timeout", 't', required_argument,
+		      struct imgwait_options, timeout, parse_timeout ),
+};
+
+/** "imgwait" command descriptor */
+static struct command_descriptor imgwait_cmd =
+	COMMAND_DESC ( struct imgwait_options, imgwait_opts, 0, MAX_ARGUMENTS,
+		       "[<name>...]" );
+
+/**
+ * The "imgwait" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int imgwait_exec ( int argc, char **argv ) {
+	struct imgwait_options opts;
+	int i;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &imgwait_cmd, &opts ) ) != 0 )
+		return rc;
+
+	/* Wait for all background downloads if no names are specified */
+	if ( optind == argc )
+		return imgwait ( NULL, opts.timeout );
+
+	/* Otherwise, wait for each named image */
+	for ( i = optind ; i < argc ; i++ ) {
+		if ( ( rc = imgwait ( argv[i], opts.timeout ) ) != 0 )
+			return rc;
+	}
+
+	return 0;
+}
+
+/** "imgbatch" options */
+struct imgbatch_options {
+	/** Download timeout */
+	unsigned long timeout;
+};
+
+/** "imgbatch" option list */
+static struct option_descriptor imgbatch_opts[] = {
+	OPTION_DESC ( "timeout", 't', required_argument,
+		      struct imgbatch_options, timeout, parse_timeout ),
+};
+
+/** "imgbatch" command descriptor */
+static struct command_descriptor imgbatch_cmd =
+	COMMAND_DESC ( struct imgbatch_options, imgbatch_opts, 1, 1,
+		       "<manifest>" );
+
+/**
+ * The "imgbatch" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ *
+ * The manifest image is freed once all listed images have been
+ * downloaded, so that it does not itself become (for example) a
+ * multiboot module.
+ */
+static int imgbatch_exec ( int argc, char **argv ) {
+	struct imgbatch_options opts;
+	struct image *manifest;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &imgbatch_cmd, &opts ) ) != 0 )
+		goto err_parse_options;
+
+	/* Acquire manifest */
+	if ( ( rc = imgacquire ( argv[optind], opts.timeout,
+				 &manifest ) ) != 0 )
+		goto err_acquire;
+
+	/* Download all listed images */
+	if ( ( rc = imgbatch ( manifest, opts.timeout ) ) != 0 )
+		goto err_batch;
+
+ err_batch:
+	unregister_image ( manifest );
+ err_acquire:
+ err_parse_options:
+	return rc;
+}
+
 /** Image management commands */
 struct command image_commands[] __command = {
 	{
@@ -442,4 +602,16 @@ struct command image_commands[] __command = {
 		.name = "imgfree",
 		.exec = imgfree_exec,
 	},
+	{
+		.name = "prefetch",
+		.exec = prefetch_exec,
+	},
+	{
+		.name = "imgwait",
+		.exec = imgwait_exec,
+	},
+	{
+		.name = "imgbatch",
+		.exec = imgbatch_exec,
+	},
 };
@@ -25,7 +25,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdint.h>
 #include <stdio.h>
+#include <errno.h>
 #include <getopt.h>
+#include <ipxe/uri.h>
 #include <ipxe/image.h>
 #include <ipxe/command.h>
 #include <ipxe/parseopt.h>
@@ -120,8 +122,10 @@ static int imgverify_exec ( int argc, char **argv ) {
 	struct imgverify_options opts;
 	const char *image_name_uri;
 	const char *signature_name_uri;
+	struct digest_algorithm *digest;
 	struct image *image;
 	struct image *signature;
+	struct uri *uri;
 	int rc;
 
 	/* Parse options */
@@ -134,15 +138,29 @@ static int imgverify_exec ( int argc, char **argv ) {
 	/* Parse signature name/URI string */
 	signature_name_uri = argv[ optind + 1 ];
 
-	/* Acquire the image */
-	if ( ( rc = imgacquire ( image_name_uri, opts.timeout, &image ) ) != 0 )
-		goto err_acquire_image;
-
 	/* Acquire the signature image */
 	if ( ( rc = imgacquire ( signature_name_uri, opts.timeout,
 				 &signature ) ) != 0 )
 		goto err_acquire_signature;
 
+	/* Acquire the image.  If the image must be downloaded, then
+	 * calculate the signer's digest while downloading, so that
+	 * only the public-key operation remains to be performed.
+	 */
+	image = find_image ( image_name_uri );
+	if ( ! image ) {
+		uri = parse_uri ( image_name_uri );
+		if ( ! uri ) {
+			rc = -ENOMEM;
+			goto err_parse_uri;
+		}
+		digest = imgverify_digest ( signature );
+		rc = imgdownload ( uri, opts.timeout, digest, &image );
+		uri_put ( uri );
+		if ( rc != 0 )
+			goto err_acquire_image;
+	}
+
 	/* Verify image */
 	if ( ( rc = imgverify ( image, signature, opts.signer ) ) != 0 ) {
 		printf ( "Could not verify: %s\n", strerror ( rc ) );
@@ -153,11 +171,12 @@ static int imgverify_exec ( int argc, char **argv ) {
 	rc = 0;
 
  err_verify:
+ err_acquire_image:
+ err_parse_uri:
 	/* Discard signature unless --keep was specified */
 	if ( ! opts.keep )
 		unregister_image ( signature );
  err_acquire_signature:
- err_acquire_image:
 	return rc;
 }
 
@@ -36,10 +36,16 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 
 /** "ipstat" options */
-struct ipstat_options {};
+struct ipstat_options {
+	/** Print in machine-readable form */
+	int raw;
+};
 
 /** "ipstat" option list */
-static struct option_descriptor ipstat_opts[] = {};
+static struct option_descriptor ipstat_opts[] = {
+	OPTION_DESC ( "raw", 'r', no_argument,
+		      struct ipstat_options, raw, parse_flag ),
+};
 
 /** "ipstat" command descriptor */
 static struct command_descriptor ipstat_cmd =
@@ -60,7 +66,12 @@ static int ipstat_exec ( int argc, char **argv ) {
 	if ( ( rc = parse_options ( argc, argv, &ipstat_cmd, &opts ) ) != 0 )
 		return rc;
 
-	ipstat();
+	/* Print statistics */
+	if ( opts.raw ) {
+		ipstat_raw();
+	} else {
+		ipstat();
+	}
 
 	return 0;
 }
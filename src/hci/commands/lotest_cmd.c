@@ -99,8 +99,82 @@ static int lotest_exec ( int argc, char **argv ) {
 	return 0;
 }
 
+/** "netbench" options */
+struct netbench_options {
+	/** MTU */
+	unsigned int mtu;
+	/** Number of packets per packet size */
+	unsigned int count;
+	/** Maximum number of packets in flight */
+	unsigned int window;
+};
+
+/** "netbench" option list */
+static struct option_descriptor netbench_opts[] = {
+	OPTION_DESC ( "mtu", 'm', required_argument,
+		      struct netbench_options, mtu, parse_integer ),
+	OPTION_DESC ( "count", 'c', required_argument,
+		      struct netbench_options, count, parse_integer ),
+	OPTION_DESC ( "window", 'w', required_argument,
+		      struct netbench_options, window, parse_integer ),
+};
+
+/** "netbench" command descriptor */
+static struct command_descriptor netbench_cmd =
+	COMMAND_DESC ( struct netbench_options, netbench_opts, 2, 2,
+		       "<sending interface> <receiving interface>" );
+
+/**
+ * "netbench" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int netbench_exec ( int argc, char **argv ) {
+	struct netbench_options opts;
+	struct net_device *sender;
+	struct net_device *receiver;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &netbench_cmd, &opts ) ) != 0 )
+		return rc;
+
+	/* Parse sending interface name */
+	if ( ( rc = parse_netdev ( argv[optind], &sender ) ) != 0 )
+		return rc;
+
+	/* Parse receiving interface name */
+	if ( ( rc = parse_netdev ( argv[ optind + 1 ], &receiver ) ) != 0 )
+		return rc;
+
+	/* Use defaults if not specified */
+	if ( ! opts.mtu )
+		opts.mtu = ETH_MAX_MTU;
+	if ( ! opts.count )
+		opts.count = LOTEST_BENCH_COUNT;
+	if ( ! opts.window )
+		opts.window = LOTEST_BENCH_WINDOW;
+
+	/* Perform benchmark */
+	if ( ( rc = loopback_bench ( sender, receiver, opts.mtu, opts.count,
+				     opts.window ) ) != 0 ) {
+		printf ( "Benchmark failed: %s\n", strerror ( rc ) );
+		return rc;
+	}
+
+	return 0;
+}
+
 /** Loopback testing commands */
 struct command lotest_command __command = {
 	.name = "lotest",
 	.exec = lotest_exec,
 };
+
+/** Network benchmarking command */
+struct command netbench_command __command = {
+	.name = "netbench",
+	.exec = netbench_exec,
+};
@@ -37,14 +37,21 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 
 /** "ntp" options */
-struct ntp_options {};
+struct ntp_options {
+	/** Run in background */
+	int background;
+};
 
 /** "ntp" option list */
-static struct option_descriptor ntp_opts[] = {};
+static struct option_descriptor ntp_opts[] = {
+	OPTION_DESC ( "background", 'b', no_argument,
+		      struct ntp_options, background, parse_flag ),
+};
 
 /** "ntp" command descriptor */
 static struct command_descriptor ntp_cmd =
-	COMMAND_DESC ( struct ntp_options, ntp_opts, 1, 1, "<server>" );
+	COMMAND_DESC ( struct ntp_options, ntp_opts, 1, MAX_ARGUMENTS,
+		       "<server> [<server>...]" );
 
 /**
  * "ntp" command
@@ -55,18 +62,25 @@ static struct command_descriptor ntp_cmd =
  */
 static int ntp_exec ( int argc, char **argv ) {
 	struct ntp_options opts;
-	const char *hostname;
+	char **hostnames;
+	unsigned int count;
 	int rc;
 
 	/* Parse options */
 	if ( ( rc = parse_options ( argc, argv, &ntp_cmd, &opts ) ) != 0 )
 		return rc;
 
-	/* Parse hostname */
-	hostname = argv[optind];
+	/* Parse hostnames */
+	hostnames = &argv[optind];
+	count = ( argc - optind );
 
 	/* Get time and date via NTP */
-	if ( ( rc = ntp ( hostname ) ) != 0 ) {
+	if ( opts.background ) {
+		rc = ntp_background ( hostnames, count );
+	} else {
+		rc = ntp ( hostnames, count );
+	}
+	if ( rc != 0 ) {
 		printf ( "Could not get time and date: %s\n", strerror ( rc ) );
 		return rc;
 	}
@@ -46,28 +46,47 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Default timeout */
 #define PING_DEFAULT_TIMEOUT TICKS_PER_SEC
 
+/** Default number of packets to send at each payload length in a sweep */
+#define PING_DEFAULT_SWEEP_COUNT 4
+
 /** "ping" options */
 struct ping_options {
 	/** Payload length */
 	unsigned int size;
+	/** Maximum payload length (for a sweep) */
+	unsigned int max_size;
+	/** Payload length increment (for a sweep) */
+	unsigned int step;
 	/** Timeout (in ms) */
 	unsigned long timeout;
 	/** Number of packets to send (or zero for no limit) */
 	unsigned int count;
 	/** Inhibit output */
 	int quiet;
+	/** Send each packet as soon as a response is received */
+	int flood;
+	/** Show statistics in machine-readable form */
+	int raw;
 };
 
 /** "ping" option list */
 static struct option_descriptor ping_opts[] = {
 	OPTION_DESC ( "size", 's', required_argument,
 		      struct ping_options, size, parse_integer ),
+	OPTION_DESC ( "max-size", 'm', required_argument,
+		      struct ping_options, max_size, parse_integer ),
+	OPTION_DESC ( "step", 'i', required_argument,
+		      struct ping_options, step, parse_integer ),
 	OPTION_DESC ( "timeout", 't', required_argument,
 		      struct ping_options, timeout, parse_timeout ),
 	OPTION_DESC ( "count", 'c', required_argument,
 		      struct ping_options, count, parse_integer ),
 	OPTION_DESC ( "quiet", 'q', no_argument,
 		      struct ping_options, quiet, parse_flag ),
+	OPTION_DESC ( "flood", 'f', no_argument,
+		      struct ping_options, flood, parse_flag ),
+	OPTION_DESC ( "raw", 'r', no_argument,
+		      struct ping_options, raw, parse_flag ),
 };
 
 /** "ping" command descriptor */
@@ -84,6 +103,7 @@ static struct command_descriptor ping_cmd =
 static int ping_exec ( int argc, char **argv ) {
 	struct ping_options opts;
 	const char *hostname;
+	unsigned int flags;
 	int rc;
 
 	/* Initialise options */
@@ -98,9 +118,19 @@ static int ping_exec ( int argc, char **argv ) {
 	/* Parse hostname */
 	hostname = argv[optind];
 
+	/* Sweep payload lengths only a limited number of times each */
+	if ( ( opts.max_size > opts.size ) && ! opts.count )
+		opts.count = PING_DEFAULT_SWEEP_COUNT;
+
+	/* Construct flags */
+	flags = ( ( opts.quiet ? PING_QUIET : 0 ) |
+		  ( opts.flood ? PING_FLOOD : 0 ) |
+		  ( opts.raw ? PING_RAW : 0 ) );
+
 	/* Ping */
-	if ( ( rc = ping ( hostname, opts.timeout, opts.size,
-			   opts.count, opts.quiet ) ) != 0 )
+	if ( ( rc = ping ( hostname, opts.timeout, opts.size, opts.max_size,
+			   ( opts.step ? opts.step : opts.size ), opts.count,
+			   flags ) ) != 0 )
 		return rc;
 
 	return 0;
@@ -36,10 +36,16 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 
 /** "profstat" options */
-struct profstat_options {};
+struct profstat_options {
+	/** Print in machine-readable form */
+	int raw;
+};
 
 /** "profstat" option list */
-static struct option_descriptor profstat_opts[] = {};
+static struct option_descriptor profstat_opts[] = {
+	OPTION_DESC ( "raw", 'r', no_argument,
+		      struct profstat_options, raw, parse_flag ),
+};
 
 /** "profstat" command descriptor */
 static struct command_descriptor profstat_cmd =
@@ -60,7 +66,12 @@ static int profstat_exec ( int argc, char **argv ) {
 	if ( ( rc = parse_options ( argc, argv, &profstat_cmd, &opts ) ) != 0 )
 		return rc;
 
-	profstat();
+	/* Print statistics */
+	if ( opts.raw ) {
+		profstat_raw();
+	} else {
+		profstat();
+	}
 
 	return 0;
 }
@@ -0,0 +1,98 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdio.h>
+#include <getopt.h>
+#include <syslog.h>
+#include <ipxe/command.h>
+#include <ipxe/parseopt.h>
+#include <ipxe/trace.h>
+
+/** @file
+ *
+ * Tracepoint commands
+ *
+ */
+
+/** "trace" options */
+struct trace_options {
+	/** Write to system log instead of console */
+	int log;
+};
+
+/** "trace" option list */
+static struct option_descriptor trace_opts[] = {
+	OPTION_DESC ( "log", 'l', no_argument,
+		      struct trace_options, log, parse_flag ),
+};
+
+/** "trace" command descriptor */
+static struct command_descriptor trace_cmd =
+	COMMAND_DESC ( struct trace_options, trace_opts, 0, 0, NULL );
+
+/**
+ * The "trace" command
+ *
+ * @v argc		Argument count
+ * @v argv		Argument list
+ * @ret rc		Return status code
+ */
+static int trace_exec ( int argc, char **argv ) {
+	struct trace_options opts;
+	unsigned int count;
+	unsigned int i;
+	int len;
+	int rc;
+
+	/* Parse options */
+	if ( ( rc = parse_options ( argc, argv, &trace_cmd, &opts ) ) != 0 )
+		return rc;
+
+	/* Print each record */
+	count = trace_count();
+	for ( i = 0 ; i < count ; i++ ) {
+		len = trace_format ( i, NULL, 0 );
+		if ( len < 0 )
+			return len;
+		{
+			char buf[ len + 1 /* NUL */ ];
+
+			trace_format ( i, buf, sizeof ( buf ) );
+			if ( opts.log ) {
+				log_printf ( "trace %s\n", buf );
+			} else {
+				printf ( "%s\n", buf );
+			}
+		}
+	}
+
+	return 0;
+}
+
+/** Tracepoint commands */
+struct command trace_commands[] __command = {
+	{
+		.name = "trace",
+		.exec = trace_exec,
+	},
+};
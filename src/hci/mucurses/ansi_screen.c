@@ -1,10 +1,24 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <curses.h>
 #include <ipxe/ansicol.h>
 #include <ipxe/console.h>
 
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
+/** @file
+ *
+ * ANSI screen
+ *
+ * A shadow copy of the screen contents is maintained, so that
+ * redrawing a character rendition that is already present on the
+ * screen generates no output.  Cursor movements are deferred until
+ * a character is actually written (or until the cursor position
+ * becomes visible to the user), so that redrawing an unchanged
+ * screen generates no output at all.  This matters for large menus
+ * displayed via slow serial consoles.
+ */
+
 static void ansiscr_reset(struct _curses_screen *scr) __nonnull;
 static void ansiscr_movetoyx(struct _curses_screen *scr,
                                unsigned int y, unsigned int x) __nonnull;
@@ -12,6 +26,59 @@ static void ansiscr_putc(struct _curses_screen *scr, chtype c) __nonnull;
 
 static unsigned int saved_usage;
 
+/** Shadow copy of screen contents (if allocated) */
+static chtype *ansiscr_shadow;
+
+/** Dimensions of shadow copy */
+static unsigned int ansiscr_lines, ansiscr_cols;
+
+/** Position at which next character is to be written */
+static unsigned int ansiscr_y, ansiscr_x;
+
+/**
+ * Get shadow copy of screen cell
+ *
+ * @v y			Y position
+ * @v x			X position
+ * @ret cell		Shadow cell, or NULL if not available
+ */
+static chtype * ansiscr_cell ( unsigned int y, unsigned int x ) {
+
+	if ( ( ! ansiscr_shadow ) || ( y >= ansiscr_lines ) ||
+	     ( x >= ansiscr_cols ) )
+		return NULL;
+	return &ansiscr_shadow[ ( y * ansiscr_cols ) + x ];
+}
+
+/**
+ * Fill shadow copy of screen contents
+ *
+ * @v c			Character rendition (or 0 if unknown)
+ */
+static void ansiscr_fill ( chtype c ) {
+	unsigned int i;
+
+	if ( ! ansiscr_shadow )
+		return;
+	for ( i = 0 ; i < ( ansiscr_lines * ansiscr_cols ) ; i++ )
+		ansiscr_shadow[i] = c;
+}
+
+/**
+ * Move terminal cursor to position of next character
+ *
+ * @v scr		Screen
+ */
+static void ansiscr_sync ( struct _curses_screen *scr ) {
+
+	if ( ( ansiscr_x != scr->curs_x ) || ( ansiscr_y != scr->curs_y ) ) {
+		/* ANSI escape sequence to update cursor position */
+		printf ( "\033[%d;%dH", ( ansiscr_y + 1 ), ( ansiscr_x + 1 ) );
+		scr->curs_x = ansiscr_x;
+		scr->curs_y = ansiscr_y;
+	}
+}
+
 static void ansiscr_attrs ( struct _curses_screen *scr, attr_t attrs ) {
 	int bold = ( attrs & A_BOLD );
 	attr_t cpair = PAIR_NUMBER ( attrs );
@@ -30,63 +97,95 @@ static void ansiscr_reset ( struct _curses_screen *scr ) {
 	scr->attrs = 0;
 	scr->curs_x = 0;
 	scr->curs_y = 0;
+	ansiscr_x = 0;
+	ansiscr_y = 0;
 	printf ( "\0330m" );
 	ansicol_set_pair ( CPAIR_DEFAULT );
 	printf ( "\033[2J" );
+
+	/* Treat screen contents as unknown */
+	ansiscr_fill ( 0 );
 }
 
 static void ansiscr_init ( struct _curses_screen *scr ) {
 	saved_usage = console_set_usage ( CONSOLE_USAGE_TUI );
+
+	/* Allocate shadow copy of screen contents.  Failure is not
+	 * an error; every character will then be written out.
+	 */
+	ansiscr_lines = LINES;
+	ansiscr_cols = COLS;
+	ansiscr_shadow = malloc ( ansiscr_lines * ansiscr_cols *
+				  sizeof ( ansiscr_shadow[0] ) );
+
 	ansiscr_reset ( scr );
 }
 
 static void ansiscr_exit ( struct _curses_screen *scr ) {
 	ansiscr_reset ( scr );
+	free ( ansiscr_shadow );
+	ansiscr_shadow = NULL;
 	console_set_usage ( saved_usage );
 }
 
 static void ansiscr_erase ( struct _curses_screen *scr, attr_t attrs ) {
 	ansiscr_attrs ( scr, attrs );
 	printf ( "\033[2J" );
+	ansiscr_fill ( ' ' | attrs );
 }
 
-static void ansiscr_movetoyx ( struct _curses_screen *scr,
+static void ansiscr_movetoyx ( struct _curses_screen *scr __unused,
 			       unsigned int y, unsigned int x ) {
-	if ( ( x != scr->curs_x ) || ( y != scr->curs_y ) ) {
-		/* ANSI escape sequence to update cursor position */
-		printf ( "\033[%d;%dH", ( y + 1 ), ( x + 1 ) );
-		scr->curs_x = x;
-		scr->curs_y = y;
-	}
+	/* Defer cursor movement until needed */
+	ansiscr_y = y;
+	ansiscr_x = x;
 }
 
 static void ansiscr_putc ( struct _curses_screen *scr, chtype c ) {
 	unsigned int character = ( c & A_CHARTEXT );
 	attr_t attrs = ( c & ( A_ATTRIBUTES | A_COLOR ) );
+	chtype *cell = ansiscr_cell ( ansiscr_y, ansiscr_x );
 
-	/* Update attributes if changed */
-	ansiscr_attrs ( scr, attrs );
+	/* Print character only if not already present on screen */
+	if ( ! ( cell && ( *cell == c ) ) ) {
+
+		/* Move cursor if required */
+		ansiscr_sync ( scr );
 
-	/* Print the actual character */
-	putchar ( character );
+		/* Update attributes if changed */
+		ansiscr_attrs ( scr, attrs );
+
+		/* Print the actual character */
+		putchar ( character );
+		if ( cell )
+			*cell = c;
+
+		/* Update expected cursor position */
+		if ( ++(scr->curs_x) == COLS ) {
+			scr->curs_x = 0;
+			++scr->curs_y;
+		}
+	}
 
-	/* Update expected cursor position */
-	if ( ++(scr->curs_x) == COLS ) {
-		scr->curs_x = 0;
-		++scr->curs_y;
+	/* Update position of next character */
+	if ( ++ansiscr_x == COLS ) {
+		ansiscr_x = 0;
+		++ansiscr_y;
 	}
 }
 
-static int ansiscr_getc ( struct _curses_screen *scr __unused ) {
+static int ansiscr_getc ( struct _curses_screen *scr ) {
+	ansiscr_sync ( scr );
 	return getchar();
 }
 
-static bool ansiscr_peek ( struct _curses_screen *scr __unused ) {
+static bool ansiscr_peek ( struct _curses_screen *scr ) {
+	ansiscr_sync ( scr );
 	return iskey();
 }
 
-static void ansiscr_cursor ( struct _curses_screen *scr __unused,
-			     int visibility ) {
+static void ansiscr_cursor ( struct _curses_screen *scr, int visibility ) {
+	ansiscr_sync ( scr );
 	printf ( "\033[?25%c", ( visibility ? 'h' : 'l' ) );
 }
 
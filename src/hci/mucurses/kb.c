@@ -1,6 +1,8 @@
 #include <curses.h>
 #include <stddef.h>
 #include <unistd.h>
+#include <ipxe/process.h>
+#include <ipxe/timer.h>
 #include "mucurses.h"
 
 /** @file
@@ -21,6 +23,24 @@ int m_delay; /*
 bool m_echo;
 bool m_cbreak;
 
+/**
+ * Wait for input delay period, or until a character is available
+ *
+ * @v win		Window
+ *
+ * Background processes continue to run while waiting.
+ */
+static void _wdelay ( WINDOW *win ) {
+	unsigned long start = currticks();
+
+	while ( ( currticks() - start ) <
+		( ( INPUT_DELAY * TICKS_PER_SEC ) / 1000 ) ) {
+		step();
+		if ( win->scr->peek ( win->scr ) )
+			return;
+	}
+}
+
 static int _wgetc ( WINDOW *win ) {
 	int timer, c;
 
@@ -34,7 +54,7 @@ static int _wgetc ( WINDOW *win ) {
 		if ( timer > 0 ) {  // time-limited blocking read
 			if ( m_delay > 0 )
 				timer -= INPUT_DELAY;
-			mdelay( INPUT_DELAY );
+			_wdelay ( win );
 		} else { return ERR; } // non-blocking read
 	}
 
@@ -30,6 +30,8 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/efi/efi_strings.h>
 #include <ipxe/efi/efi_wrap.h>
 #include <ipxe/efi/efi_pxe.h>
+#include <ipxe/efi/efi_handover.h>
+#include <ipxe/efi/efi_pe.h>
 #include <ipxe/image.h>
 #include <ipxe/init.h>
 #include <ipxe/features.h>
@@ -125,6 +127,22 @@ static wchar_t * efi_image_cmdline ( struct image *image ) {
 	return cmdline;
 }
 
+/**
+ * Install state handover configuration table (when not enabled)
+ *
+ */
+__weak void efi_handover_install ( void ) {
+	/* Nothing to do */
+}
+
+/**
+ * Uninstall state handover configuration table (when not enabled)
+ *
+ */
+__weak void efi_handover_uninstall ( void ) {
+	/* Nothing to do */
+}
+
 /**
  * Execute EFI image
  *
@@ -240,6 +258,9 @@ static int efi_image_exec ( struct image *image ) {
 	/* Reset console since image will probably use it */
 	console_reset();
 
+	/* Hand over state to any chained iPXE */
+	efi_handover_install();
+
 	/* Start the image */
 	if ( ( efirc = bs->StartImage ( handle, NULL, NULL ) ) != 0 ) {
 		rc = -EEFI_START ( efirc );
@@ -252,6 +273,7 @@ static int efi_image_exec ( struct image *image ) {
 	rc = 0;
 
  err_start_image:
+	efi_handover_uninstall();
 	efi_snp_claim();
  err_open_protocol:
 	/* If there was no error, then the image must have been
@@ -292,33 +314,15 @@ static int efi_image_exec ( struct image *image ) {
  * @ret rc		Return status code
  */
 static int efi_image_probe ( struct image *image ) {
-	EFI_BOOT_SERVICES *bs = efi_systab->BootServices;
-	static EFI_DEVICE_PATH_PROTOCOL empty_path = {
-		.Type = END_DEVICE_PATH_TYPE,
-		.SubType = END_ENTIRE_DEVICE_PATH_SUBTYPE,
-		.Length[0] = sizeof ( empty_path ),
-	};
-	EFI_HANDLE handle;
-	EFI_STATUS efirc;
-	int rc;
-
-	/* Attempt loading image */
-	if ( ( efirc = bs->LoadImage ( FALSE, efi_image_handle, &empty_path,
-				       user_to_virt ( image->data, 0 ),
-				       image->len, &handle ) ) != 0 ) {
-		/* Not an EFI image */
-		rc = -EEFI_LOAD ( efirc );
-		DBGC ( image, "EFIIMAGE %p could not load: %s\n",
-		       image, strerror ( rc ) );
-		return rc;
-	}
 
-	/* Unload the image.  We can't leave it loaded, because we
-	 * have no "unload" operation.
+	/* Check headers.  We do not ask the firmware to load the
+	 * image at this point, since that would involve copying and
+	 * relocating (and possibly hashing) the whole image only to
+	 * immediately discard the result.  Any image that the
+	 * firmware is unable to load will be reported by
+	 * efi_image_exec() instead.
 	 */
-	bs->UnloadImage ( handle );
-
-	return 0;
+	return efi_pe_check ( image, EFI_PE_MACHINE );
 }
 
 /** EFI image type */
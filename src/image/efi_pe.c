@@ -0,0 +1,105 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+/** @file
+ *
+ * EFI PE image headers
+ *
+ * The headers are checked without reference to the platform
+ * firmware, so that unsuitable images may be rejected cheaply (and
+ * so that the checks may be exercised by the self-tests).
+ *
+ */
+
+#include <errno.h>
+#include <ipxe/image.h>
+#include <ipxe/uaccess.h>
+#include <ipxe/efi/efi_pe.h>
+
+/**
+ * Check EFI PE image headers
+ *
+ * @v image		EFI file
+ * @v machine		Required PE machine type
+ * @ret rc		Return status code
+ */
+int efi_pe_check ( struct image *image, unsigned int machine ) {
+	EFI_IMAGE_DOS_HEADER dos;
+	EFI_IMAGE_OPTIONAL_HEADER_UNION pe;
+	unsigned int subsystem;
+
+	/* Check DOS header */
+	if ( image->len < sizeof ( dos ) ) {
+		DBGC ( image, "EFIIMAGE %p too short for DOS header\n",
+		       image );
+		return -ENOEXEC;
+	}
+	copy_from_user ( &dos, image->data, 0, sizeof ( dos ) );
+	if ( dos.e_magic != EFI_IMAGE_DOS_SIGNATURE ) {
+		DBGC ( image, "EFIIMAGE %p invalid DOS signature\n", image );
+		return -ENOEXEC;
+	}
+
+	/* Check PE header */
+	if ( ( dos.e_lfanew > image->len ) ||
+	     ( ( image->len - dos.e_lfanew ) < sizeof ( pe ) ) ) {
+		DBGC ( image, "EFIIMAGE %p too short for PE header\n",
+		       image );
+		return -ENOEXEC;
+	}
+	copy_from_user ( &pe, image->data, dos.e_lfanew, sizeof ( pe ) );
+	if ( pe.Pe32.Signature != EFI_IMAGE_NT_SIGNATURE ) {
+		DBGC ( image, "EFIIMAGE %p invalid PE signature\n", image );
+		return -ENOEXEC;
+	}
+
+	/* Check machine type */
+	if ( pe.Pe32.FileHeader.Machine != machine ) {
+		DBGC ( image, "EFIIMAGE %p machine type %#04x (expected "
+		       "%#04x)\n", image, pe.Pe32.FileHeader.Machine,
+		       machine );
+		return -ENOEXEC;
+	}
+
+	/* Check subsystem */
+	switch ( pe.Pe32.OptionalHeader.Magic ) {
+	case EFI_IMAGE_NT_OPTIONAL_HDR32_MAGIC:
+		subsystem = pe.Pe32.OptionalHeader.Subsystem;
+		break;
+	case EFI_IMAGE_NT_OPTIONAL_HDR64_MAGIC:
+		subsystem = pe.Pe32Plus.OptionalHeader.Subsystem;
+		break;
+	default:
+		DBGC ( image, "EFIIMAGE %p unknown optional header magic "
+		       "%#04x\n", image, pe.Pe32.OptionalHeader.Magic );
+		return -ENOEXEC;
+	}
+	switch ( subsystem ) {
+	case EFI_IMAGE_SUBSYSTEM_EFI_APPLICATION:
+	case EFI_IMAGE_SUBSYSTEM_EFI_BOOT_SERVICE_DRIVER:
+	case EFI_IMAGE_SUBSYSTEM_EFI_RUNTIME_DRIVER:
+		break;
+	default:
+		DBGC ( image, "EFIIMAGE %p non-EFI subsystem %d\n",
+		       image, subsystem );
+		return -ENOEXEC;
+	}
+
+	return 0;
+}
@@ -0,0 +1,237 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <byteswap.h>
+#include <ipxe/deflate.h>
+#include <ipxe/uaccess.h>
+#include <ipxe/umalloc.h>
+#include <ipxe/crc32.h>
+#include <ipxe/image.h>
+#include <ipxe/gzip.h>
+
+/** @file
+ *
+ * gzip compressed images
+ *
+ */
+
+/**
+ * Extract gzip image
+ *
+ * @v image		Image
+ * @v extracted		Extracted image
+ * @ret rc		Return status code
+ */
+static int gzip_extract ( struct image *image, struct image *extracted ) {
+	struct gzip_header header;
+	struct gzip_extra_header extra;
+	struct gzip_trailer trailer;
+	struct deflate_chunk in;
+	struct deflate_chunk out;
+	struct deflate *deflate;
+	size_t data_len;
+	size_t offset;
+	size_t len;
+	off_t nul;
+	uint32_t crc;
+	int rc;
+
+	/* Sanity check */
+	assert ( image->len >= ( sizeof ( header ) + sizeof ( trailer ) ) );
+	data_len = ( image->len - sizeof ( trailer ) );
+
+	/* Extract header */
+	copy_from_user ( &header, image->data, 0, sizeof ( header ) );
+	offset = sizeof ( header );
+
+	/* Skip extra header, if present */
+	if ( header.flags & GZIP_FEXTRA ) {
+		if ( ( offset + sizeof ( extra ) ) > data_len ) {
+			DBGC ( image, "GZIP %s overlength extra header\n",
+			       image->name );
+			return -EINVAL;
+		}
+		copy_from_user ( &extra, image->data, offset,
+				 sizeof ( extra ) );
+		offset += sizeof ( extra );
+		len = le16_to_cpu ( extra.len );
+		if ( len > ( data_len - offset ) ) {
+			DBGC ( image, "GZIP %s overlength extra header\n",
+			       image->name );
+			return -EINVAL;
+		}
+		offset += len;
+	}
+
+	/* Skip name, if present */
+	if ( header.flags & GZIP_FNAME ) {
+		nul = memchr_user ( image->data, offset, 0,
+				    ( data_len - offset ) );
+		if ( nul < 0 ) {
+			DBGC ( image, "GZIP %s overlength name\n",
+			       image->name );
+			return -EINVAL;
+		}
+		offset = ( nul + 1 /* NUL */ );
+	}
+
+	/* Skip comment, if present */
+	if ( header.flags & GZIP_FCOMMENT ) {
+		nul = memchr_user ( image->data, offset, 0,
+				    ( data_len - offset ) );
+		if ( nul < 0 ) {
+			DBGC ( image, "GZIP %s overlength comment\n",
+			       image->name );
+			return -EINVAL;
+		}
+		offset = ( nul + 1 /* NUL */ );
+	}
+
+	/* Skip header CRC, if present */
+	if ( header.flags & GZIP_FHCRC ) {
+		offset += sizeof ( struct gzip_crc_header );
+		if ( offset > data_len ) {
+			DBGC ( image, "GZIP %s overlength header CRC\n",
+			       image->name );
+			return -EINVAL;
+		}
+	}
+
+	/* Extract trailer */
+	copy_from_user ( &trailer, image->data, data_len, sizeof ( trailer ) );
+	len = le32_to_cpu ( trailer.isize );
+
+	/* Allocate extracted image data.  The trailer records the
+	 * uncompressed length, so we can decompress directly into
+	 * place in a single pass.
+	 */
+	extracted->data = umalloc ( len );
+	if ( ! extracted->data ) {
+		rc = -ENOMEM;
+		goto err_alloc_data;
+	}
+	extracted->len = len;
+
+	/* Allocate decompressor */
+	deflate = malloc ( sizeof ( *deflate ) );
+	if ( ! deflate ) {
+		rc = -ENOMEM;
+		goto err_alloc_deflate;
+	}
+
+	/* Decompress data */
+	deflate_init ( deflate, DEFLATE_RAW );
+	deflate_chunk_init ( &in, image->data, offset, data_len );
+	deflate_chunk_init ( &out, extracted->data, 0, len );
+	if ( ( rc = deflate_inflate ( deflate, &in, &out ) ) != 0 ) {
+		DBGC ( image, "GZIP %s could not decompress: %s\n",
+		       image->name, strerror ( rc ) );
+		goto err_inflate;
+	}
+
+	/* Check that decompression is valid */
+	if ( ! deflate_finished ( deflate ) ) {
+		DBGC ( image, "GZIP %s decompression incomplete\n",
+		       image->name );
+		rc = -EINVAL;
+		goto err_unfinished;
+	}
+	if ( out.offset != len ) {
+		DBGC ( image, "GZIP %s length mismatch (expected %#zx, got "
+		       "%#zx)\n", image->name, len, out.offset );
+		rc = -EINVAL;
+		goto err_len;
+	}
+
+	/* Verify CRC */
+	crc = ( crc32_le ( ~0U, user_to_virt ( extracted->data, 0 ),
+			   len ) ^ ~0U );
+	if ( crc != le32_to_cpu ( trailer.crc ) ) {
+		DBGC ( image, "GZIP %s CRC mismatch (expected %08x, got "
+		       "%08x)\n", image->name, le32_to_cpu ( trailer.crc ),
+		       crc );
+		rc = -EINVAL;
+		goto err_crc;
+	}
+
+	/* Free decompressor */
+	free ( deflate );
+
+	DBGC ( image, "GZIP %s decompressed [%#zx,%#zx) to %#zx bytes\n",
+	       image->name, offset, data_len, len );
+	return 0;
+
+ err_crc:
+ err_len:
+ err_unfinished:
+ err_inflate:
+	free ( deflate );
+ err_alloc_deflate:
+ err_alloc_data:
+	return rc;
+}
+
+/**
+ * Probe gzip image
+ *
+ * @v image		gzip image
+ * @ret rc		Return status code
+ */
+static int gzip_probe ( struct image *image ) {
+	struct gzip_header header;
+
+	/* Sanity check */
+	if ( image->len < ( sizeof ( header ) +
+			    sizeof ( struct gzip_trailer ) ) ) {
+		DBGC ( image, "GZIP %s image too short\n", image->name );
+		return -ENOEXEC;
+	}
+
+	/* Check magic header */
+	copy_from_user ( &header, image->data, 0, sizeof ( header ) );
+	if ( header.magic != cpu_to_le16 ( GZIP_MAGIC ) ) {
+		DBGC ( image, "GZIP %s invalid magic\n", image->name );
+		return -ENOEXEC;
+	}
+
+	/* Check compression method and flags */
+	if ( ( header.cm != GZIP_CM_DEFLATE ) ||
+	     ( header.flags & GZIP_FRESERVED ) ) {
+		DBGC ( image, "GZIP %s unsupported method %d flags %#02x\n",
+		       image->name, header.cm, header.flags );
+		return -ENOTSUP;
+	}
+
+	return 0;
+}
+
+/** gzip image type */
+struct image_type gzip_image_type __image_type ( PROBE_NORMAL ) = {
+	.name = "gzip",
+	.probe = gzip_probe,
+	.extract = gzip_extract,
+	.exec = image_extract_exec,
+};
@@ -352,71 +352,74 @@ static int png_image_data ( struct image *image, struct png_context *png,
 }
 
 /**
- * Unfilter byte using the "None" filter
+ * Unfilter scanline using the "None" filter
  *
- * @v current		Filtered current byte
- * @v left		Unfiltered left byte
- * @v above		Unfiltered above byte
- * @v above_left	Unfiltered above-left byte
- * @ret current		Unfiltered current byte
+ * @v current		Filtered current scanline
+ * @v above		Unfiltered above scanline
+ * @v len		Length of scanline (excluding filter byte)
+ * @v pixel_len		Pixel length
  */
-static unsigned int png_unfilter_none ( unsigned int current,
-					unsigned int left __unused,
-					unsigned int above __unused,
-					unsigned int above_left __unused ) {
+static void png_unfilter_none ( uint8_t *current __unused,
+				const uint8_t *above __unused,
+				size_t len __unused, size_t pixel_len __unused ) {
 
-	return current;
+	/* Nothing to do */
 }
 
 /**
- * Unfilter byte using the "Sub" filter
+ * Unfilter scanline using the "Sub" filter
  *
- * @v current		Filtered current byte
- * @v left		Unfiltered left byte
- * @v above		Unfiltered above byte
- * @v above_left	Unfiltered above-left byte
- * @ret current		Unfiltered current byte
+ * @v current		Filtered current scanline
+ * @v above		Unfiltered above scanline
+ * @v len		Length of scanline (excluding filter byte)
+ * @v pixel_len		Pixel length
  */
-static unsigned int png_unfilter_sub ( unsigned int current,
-				       unsigned int left,
-				       unsigned int above __unused,
-				       unsigned int above_left __unused ) {
+static void png_unfilter_sub ( uint8_t *current, const uint8_t *above __unused,
+			       size_t len, size_t pixel_len ) {
+	size_t i;
 
-	return ( current + left );
+	for ( i = pixel_len ; i < len ; i++ )
+		current[i] += current[ i - pixel_len ];
 }
 
 /**
- * Unfilter byte using the "Up" filter
+ * Unfilter scanline using the "Up" filter
  *
- * @v current		Filtered current byte
- * @v left		Unfiltered left byte
- * @v above		Unfiltered above byte
- * @v above_left	Unfiltered above-left byte
- * @ret current		Unfiltered current byte
+ * @v current		Filtered current scanline
+ * @v above		Unfiltered above scanline
+ * @v len		Length of scanline (excluding filter byte)
+ * @v pixel_len		Pixel length
  */
-static unsigned int png_unfilter_up ( unsigned int current,
-				      unsigned int left __unused,
-				      unsigned int above,
-				      unsigned int above_left __unused ) {
+static void png_unfilter_up ( uint8_t *current, const uint8_t *above,
+			      size_t len, size_t pixel_len __unused ) {
+	size_t i;
 
-	return ( current + above );
+	/* No dependencies between bytes: the compiler is free to
+	 * vectorise this loop.
+	 */
+	for ( i = 0 ; i < len ; i++ )
+		current[i] += above[i];
 }
 
 /**
- * Unfilter byte using the "Average" filter
+ * Unfilter scanline using the "Average" filter
  *
- * @v current		Filtered current byte
- * @v left		Unfiltered left byte
- * @v above		Unfiltered above byte
- * @v above_left	Unfiltered above-left byte
- * @ret current		Unfiltered current byte
+ * @v current		Filtered current scanline
+ * @v above		Unfiltered above scanline
+ * @v len		Length of scanline (excluding filter byte)
+ * @v pixel_len		Pixel length
  */
-static unsigned int png_unfilter_average ( unsigned int current,
-					   unsigned int left,
-					   unsigned int above,
-					   unsigned int above_left __unused ) {
-
-	return ( current + ( ( above + left ) >> 1 ) );
+static void png_unfilter_average ( uint8_t *current, const uint8_t *above,
+				   size_t len, size_t pixel_len ) {
+	size_t i;
+
+	/* Left bytes of the first pixel are taken to be zero */
+	for ( i = 0 ; ( i < pixel_len ) && ( i < len ) ; i++ )
+		current[i] += ( above[i] >> 1 );
+	for ( ; i < len ; i++ ) {
+		current[i] += ( ( current[ i - pixel_len ] +
+				  above[i] ) >> 1 );
+	}
 }
 
 /**
@@ -427,18 +430,25 @@ static unsigned int png_unfilter_average ( unsigned int current,
  * @v c			Pixel C
  * @ret predictor	Predictor pixel
  */
-static unsigned int png_paeth_predictor ( unsigned int a, unsigned int b,
-					  unsigned int c ) {
-	unsigned int p;
-	unsigned int pa;
-	unsigned int pb;
-	unsigned int pc;
-
-	/* Algorithm as defined in RFC 2083 section 6.6 */
-	p = ( a + b - c );
-	pa = abs ( p - a );
-	pb = abs ( p - b );
-	pc = abs ( p - c );
+static inline __attribute__ (( always_inline )) unsigned int
+png_paeth_predictor ( unsigned int a, unsigned int b, unsigned int c ) {
+	int p;
+	int pa;
+	int pb;
+	int pc;
+
+	/* Algorithm as defined in RFC 2083 section 6.6, using
+	 * simplified expressions for the distances:
+	 *
+	 *   |p - a| = |b - c|
+	 *   |p - b| = |a - c|
+	 *   |p - c| = |a + b - 2c|
+	 */
+	p = ( b - c );
+	pc = ( a - c );
+	pa = abs ( p );
+	pb = abs ( pc );
+	pc = abs ( p + pc );
 	if ( ( pa <= pb ) && ( pa <= pc ) ) {
 		return a;
 	} else if ( pb <= pc ) {
@@ -449,37 +459,42 @@ static unsigned int png_paeth_predictor ( unsigned int a, unsigned int b,
 }
 
 /**
- * Unfilter byte using the "Paeth" filter
+ * Unfilter scanline using the "Paeth" filter
  *
- * @v current		Filtered current byte
- * @v above_left	Unfiltered above-left byte
- * @v above		Unfiltered above byte
- * @v left		Unfiltered left byte
- * @ret current		Unfiltered current byte
+ * @v current		Filtered current scanline
+ * @v above		Unfiltered above scanline
+ * @v len		Length of scanline (excluding filter byte)
+ * @v pixel_len		Pixel length
  */
-static unsigned int png_unfilter_paeth ( unsigned int current,
-					 unsigned int left,
-					 unsigned int above,
-					 unsigned int above_left ) {
+static void png_unfilter_paeth ( uint8_t *current, const uint8_t *above,
+				 size_t len, size_t pixel_len ) {
+	size_t i;
 
-	return ( current + png_paeth_predictor ( left, above, above_left ) );
+	/* Left and above-left bytes of the first pixel are taken to
+	 * be zero, in which case the predictor is always the above
+	 * byte.
+	 */
+	for ( i = 0 ; ( i < pixel_len ) && ( i < len ) ; i++ )
+		current[i] += above[i];
+	for ( ; i < len ; i++ ) {
+		current[i] += png_paeth_predictor ( current[ i - pixel_len ],
+						    above[i],
+						    above[ i - pixel_len ] );
+	}
 }
 
 /** A PNG filter */
 struct png_filter {
 	/**
-	 * Unfilter byte
+	 * Unfilter scanline
 	 *
-	 * @v current		Filtered current byte
-	 * @v left		Unfiltered left byte
-	 * @v above		Unfiltered above byte
-	 * @v above_left	Unfiltered above-left byte
-	 * @ret current		Unfiltered current byte
+	 * @v current		Filtered current scanline
+	 * @v above		Unfiltered above scanline
+	 * @v len		Length of scanline (excluding filter byte)
+	 * @v pixel_len		Pixel length
 	 */
-	unsigned int ( * unfilter ) ( unsigned int current,
-				      unsigned int left,
-				      unsigned int above,
-				      unsigned int above_left );
+	void ( * unfilter ) ( uint8_t *current, const uint8_t *above,
+			      size_t len, size_t pixel_len );
 };
 
 /** PNG filter types */
@@ -501,25 +516,34 @@ static struct png_filter png_filters[] = {
  *
  * This routine may assume that it is impossible to overrun the raw
  * data buffer, since the size is determined by the image dimensions.
+ *
+ * Each scanline is unfiltered as a whole within a local buffer,
+ * rather than accessing the raw data buffer once per byte.
  */
 static int png_unfilter_pass ( struct image *image, struct png_context *png,
 			       struct png_interlace *interlace ) {
 	size_t offset = png->raw.offset;
 	size_t pixel_len = png_pixel_len ( png );
-	size_t scanline_len = png_scanline_len ( png, interlace );
+	size_t len = ( png_scanline_len ( png, interlace ) - 1 );
 	struct png_filter *filter;
 	unsigned int scanline;
-	unsigned int byte;
 	uint8_t filter_type;
-	uint8_t left;
-	uint8_t above;
-	uint8_t above_left;
-	uint8_t current;
+	uint8_t *buffer;
+	uint8_t *current;
+	uint8_t *above;
+	uint8_t *tmp;
+	int rc;
 
-	/* On the first scanline of a pass, above bytes are assumed to
-	 * be zero.
+	/* Allocate scanline buffers.  On the first scanline of a
+	 * pass, above bytes are assumed to be zero.
 	 */
-	above = 0;
+	buffer = zalloc ( 2 * len );
+	if ( ! buffer ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	above = buffer;
+	current = ( buffer + len );
 
 	/* Iterate over each scanline in turn */
 	for ( scanline = 0 ; scanline < interlace->height ; scanline++ ) {
@@ -531,54 +555,36 @@ static int png_unfilter_pass ( struct image *image, struct png_context *png,
 				      sizeof ( png_filters[0] ) ) ) {
 			DBGC ( image, "PNG %s unknown filter type %d\n",
 			       image->name, filter_type );
-			return -ENOTSUP;
+			rc = -ENOTSUP;
+			goto err_filter;
 		}
 		filter = &png_filters[filter_type];
 		assert ( filter->unfilter != NULL );
 		DBGC2 ( image, "PNG %s pass %d scanline %d filter type %d\n",
 			image->name, interlace->pass, scanline, filter_type );
 
-		/* At the start of a line, both above-left and left
-		 * bytes are taken to be zero.
-		 */
-		left = 0;
-		above_left = 0;
+		/* Unfilter scanline */
+		copy_from_user ( current, png->raw.data, offset, len );
+		filter->unfilter ( current, above, len, pixel_len );
+		copy_to_user ( png->raw.data, offset, current, len );
+		offset += len;
 
-		/* Iterate over each byte (not pixel) in turn */
-		for ( byte = 0 ; byte < ( scanline_len - 1 ) ; byte++ ) {
-
-			/* Extract predictor bytes, if applicable */
-			if ( byte >= pixel_len ) {
-				copy_from_user ( &left, png->raw.data,
-						 ( offset - pixel_len ),
-						 sizeof ( left ) );
-			}
-			if ( scanline > 0 ) {
-				copy_from_user ( &above, png->raw.data,
-						 ( offset - scanline_len ),
-						 sizeof ( above ) );
-			}
-			if ( ( scanline > 0 ) && ( byte >= pixel_len ) ) {
-				copy_from_user ( &above_left, png->raw.data,
-						 ( offset - scanline_len -
-						   pixel_len ),
-						 sizeof ( above_left ) );
-			}
-
-			/* Unfilter current byte */
-			copy_from_user ( &current, png->raw.data,
-					 offset, sizeof ( current ) );
-			current = filter->unfilter ( current, left, above,
-						     above_left );
-			copy_to_user ( png->raw.data, offset++,
-				       &current, sizeof ( current ) );
-		}
+		/* Current scanline becomes the above scanline */
+		tmp = above;
+		above = current;
+		current = tmp;
 	}
 
 	/* Update offset */
 	png->raw.offset = offset;
 
-	return 0;
+	/* Success */
+	rc = 0;
+
+ err_filter:
+	free ( buffer );
+ err_alloc:
+	return rc;
 }
 
 /**
@@ -43,82 +43,128 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <usr/prompt.h>
 #include <ipxe/script.h>
 
-/** Offset within current script
+/** A script line */
+struct script_line {
+	/** Offset within script image (for debugging) */
+	size_t offset;
+	/** Label, or NULL */
+	const char *label;
+	/** Command, or NULL if line has an unterminated continuation */
+	const char *command;
+};
+
+/** A parsed script
+ *
+ * A script is parsed once when it starts executing, so that "goto"
+ * may jump directly to a line without re-reading the script image.
+ */
+struct script {
+	/** Script image */
+	struct image *image;
+	/** Script text (modified in place to hold labels and commands) */
+	char *text;
+	/** Number of lines */
+	unsigned int count;
+	/** Index of next line to execute */
+	unsigned int next;
+	/** Lines */
+	struct script_line lines[0];
+};
+
+/** Currently executing script
  *
- * This is a global in order to allow goto_exec() to update the
- * offset.
+ * This is a global in order to allow goto_exec() to update the next
+ * line to be executed.
  */
-static size_t script_offset;
+static struct script *current_script;
 
 /**
- * Process script lines
+ * Parse script
  *
  * @v image		Script
- * @v process_line	Line processor
- * @v terminate		Termination check
- * @ret rc		Return status code
+ * @ret script		Parsed script, or NULL on error
  */
-static int process_script ( struct image *image,
-			    int ( * process_line ) ( struct image *image,
-						     size_t offset,
-						     const char *label,
-						     const char *command ),
-			    int ( * terminate ) ( int rc ) ) {
-	size_t len = 0;
-	char *line = NULL;
-	size_t line_offset;
+static struct script * parse_script ( struct image *image ) {
+	struct script *script;
+	struct script_line *line;
+	unsigned int max = 1;
+	size_t frag_len;
+	char *text;
+	char *start;
 	char *label;
 	char *command;
-	off_t eol;
-	size_t frag_len;
-	char *tmp;
-	int rc;
-
-	/* Initialise script and line offsets */
-	script_offset = 0;
-	line_offset = 0;
-
-	do {
-
-		/* Find length of next line, excluding any terminating '\n' */
-		eol = memchr_user ( image->data, script_offset, '\n',
-				    ( image->len - script_offset ) );
-		if ( eol < 0 )
-			eol = image->len;
-		frag_len = ( eol - script_offset );
-
-		/* Allocate buffer for line */
-		tmp = realloc ( line, ( len + frag_len + 1 /* NUL */ ) );
-		if ( ! tmp ) {
-			rc = -ENOMEM;
-			goto err_alloc;
-		}
-		line = tmp;
-
-		/* Copy line */
-		copy_from_user ( ( line + len ), image->data, script_offset,
-				 frag_len );
-		len += frag_len;
-
-		/* Move to next line in script */
-		script_offset += ( frag_len + 1 );
-
-		/* Strip trailing CR, if present */
-		if ( len && ( line[ len - 1 ] == '\r' ) )
-			len--;
+	char *src;
+	char *dst;
+	char *end;
+	char *eol;
+
+	/* Allocate and populate script text */
+	text = malloc ( image->len + 1 /* NUL */ );
+	if ( ! text )
+		return NULL;
+	copy_from_user ( text, image->data, 0, image->len );
+	end = ( text + image->len );
+	*end = '\0';
+
+	/* Allocate script with space for the maximum number of lines */
+	for ( src = text ; src < end ; src++ ) {
+		if ( *src == '\n' )
+			max++;
+	}
+	script = zalloc ( sizeof ( *script ) +
+			  ( max * sizeof ( script->lines[0] ) ) );
+	if ( ! script ) {
+		free ( text );
+		return NULL;
+	}
+	script->image = image;
+	script->text = text;
 
-		/* Handle backslash continuations */
-		if ( len && ( line[ len - 1 ] == '\\' ) ) {
-			len--;
-			rc = -EINVAL;
-			continue;
+	/* Split script into lines, joining any backslash continuations
+	 * in place.  The joined line is never longer than the original
+	 * text from which it was constructed, so the write pointer can
+	 * never overtake the read pointer.
+	 */
+	for ( src = dst = text ; src < end ; ) {
+
+		/* Start new line */
+		line = &script->lines[ script->count++ ];
+		line->offset = ( src - text );
+		start = dst;
+
+		while ( 1 ) {
+
+			/* Find end of next line fragment */
+			eol = memchr ( src, '\n', ( end - src ) );
+			if ( ! eol )
+				eol = end;
+			frag_len = ( eol - src );
+
+			/* Copy fragment and move to next line in script */
+			memmove ( dst, src, frag_len );
+			dst += frag_len;
+			src = ( eol + 1 );
+
+			/* Strip trailing CR, if present */
+			if ( ( dst > start ) && ( dst[-1] == '\r' ) )
+				dst--;
+
+			/* Handle backslash continuations */
+			if ( ( dst > start ) && ( dst[-1] == '\\' ) ) {
+				dst--;
+				if ( src < end )
+					continue;
+				/* Leave line with no command */
+				return script;
+			}
+			break;
 		}
 
 		/* Terminate line */
-		line[len] = '\0';
+		*(dst++) = '\0';
 
 		/* Split line into (optional) label and command */
-		command = line;
+		command = start;
 		while ( isspace ( *command ) )
 			command++;
 		if ( *command == ':' ) {
@@ -130,58 +176,44 @@ static int process_script ( struct image *image,
 		} else {
 			label = NULL;
 		}
+		line->label = label;
+		line->command = command;
+	}
 
-		/* Process line */
-		rc = process_line ( image, line_offset, label, command );
-		if ( terminate ( rc ) )
-			goto err_process;
-
-		/* Free line */
-		free ( line );
-		line = NULL;
-		len = 0;
-
-		/* Update line offset */
-		line_offset = script_offset;
-
-	} while ( script_offset < image->len );
-
- err_process:
- err_alloc:
-	free ( line );
-	return rc;
+	DBGC ( image, "Parsed %d script lines\n", script->count );
+	return script;
 }
 
 /**
- * Terminate script processing on shell exit or command failure
+ * Free parsed script
  *
- * @v rc		Line processing status
- * @ret terminate	Terminate script processing
+ * @v script		Parsed script
  */
-static int terminate_on_exit_or_failure ( int rc ) {
+static void free_script ( struct script *script ) {
 
-	return ( shell_stopped ( SHELL_STOP_COMMAND_SEQUENCE ) ||
-		 ( rc != 0 ) );
+	free ( script->text );
+	free ( script );
 }
 
 /**
  * Execute script line
  *
- * @v image		Script
- * @v offset		Offset within script
- * @v label		Label, or NULL
- * @v command		Command
+ * @v script		Parsed script
+ * @v line		Script line
  * @ret rc		Return status code
  */
-static int script_exec_line ( struct image *image, size_t offset,
-			      const char *label __unused,
-			      const char *command ) {
+static int script_exec_line ( struct script *script,
+			      struct script_line *line ) {
 	int rc;
 
-	DBGC ( image, "[%04zx] $ %s\n", offset, command );
+	/* Fail on an unterminated continuation */
+	if ( ! line->command )
+		return -EINVAL;
+
+	DBGC ( script->image, "[%04zx] $ %s\n", line->offset, line->command );
 
 	/* Execute command */
-	if ( ( rc = system ( command ) ) != 0 )
+	if ( ( rc = system ( line->command ) ) != 0 )
 		return rc;
 
 	return 0;
@@ -194,8 +226,15 @@ static int script_exec_line ( struct image *image, size_t offset,
  * @ret rc		Return status code
  */
 static int script_exec ( struct image *image ) {
-	size_t saved_offset;
-	int rc;
+	struct script *saved_script;
+	struct script *script;
+	struct script_line *line;
+	int rc = 0;
+
+	/* Parse script */
+	script = parse_script ( image );
+	if ( ! script )
+		return -ENOMEM;
 
 	/* Temporarily de-register image, so that a "boot" command
 	 * doesn't throw us into an execution loop.
@@ -203,19 +242,28 @@ static int script_exec ( struct image *image ) {
 	unregister_image ( image );
 
 	/* Preserve state of any currently-running script */
-	saved_offset = script_offset;
-
-	/* Process script */
-	rc = process_script ( image, script_exec_line,
-			      terminate_on_exit_or_failure );
+	saved_script = current_script;
+	current_script = script;
+
+	/* Execute lines until shell exit or command failure */
+	while ( script->next < script->count ) {
+		line = &script->lines[ script->next++ ];
+		rc = script_exec_line ( script, line );
+		if ( shell_stopped ( SHELL_STOP_COMMAND_SEQUENCE ) ||
+		     ( rc != 0 ) )
+			break;
+	}
 
 	/* Restore saved state */
-	script_offset = saved_offset;
+	current_script = saved_script;
 
 	/* Re-register image (unless we have been replaced) */
 	if ( ! image->replacement )
 		register_image ( image );
 
+	/* Free parsed script */
+	free_script ( script );
+
 	return rc;
 }
 
@@ -269,47 +317,23 @@ static struct command_descriptor goto_cmd =
 	COMMAND_DESC ( struct goto_options, goto_opts, 1, 1, "<label>" );
 
 /**
- * Current "goto" label
+ * Find label within script
  *
- * Valid only during goto_exec().  Consider this part of a closure.
- */
-static const char *goto_label;
-
-/**
- * Check for presence of label
- *
- * @v image		Script
- * @v offset		Offset within script
+ * @v script		Parsed script
  * @v label		Label
- * @v command		Command
- * @ret rc		Return status code
+ * @ret line		Script line, or NULL if not found
  */
-static int goto_find_label ( struct image *image, size_t offset,
-			     const char *label, const char *command __unused ) {
-
-	/* Check label exists */
-	if ( ! label )
-		return -ENOENT;
-
-	/* Check label matches */
-	if ( strcmp ( goto_label, label ) != 0 )
-		return -ENOENT;
-
-	/* Update script offset */
-	script_offset = offset;
-	DBGC ( image, "[%04zx] Gone to :%s\n", offset, label );
-
-	return 0;
-}
-
-/**
- * Terminate script processing when label is found
- *
- * @v rc		Line processing status
- * @ret terminate	Terminate script processing
- */
-static int terminate_on_label_found ( int rc ) {
-	return ( rc == 0 );
+static struct script_line * script_find_label ( struct script *script,
+						const char *label ) {
+	struct script_line *line;
+	unsigned int i;
+
+	for ( i = 0 ; i < script->count ; i++ ) {
+		line = &script->lines[i];
+		if ( line->label && ( strcmp ( line->label, label ) == 0 ) )
+			return line;
+	}
+	return NULL;
 }
 
 /**
@@ -321,7 +345,8 @@ static int terminate_on_label_found ( int rc ) {
  */
 static int goto_exec ( int argc, char **argv ) {
 	struct goto_options opts;
-	size_t saved_offset;
+	struct script_line *line;
+	const char *label;
 	int rc;
 
 	/* Parse options */
@@ -329,25 +354,27 @@ static int goto_exec ( int argc, char **argv ) {
 		return rc;
 
 	/* Sanity check */
-	if ( ! current_image ) {
+	if ( ! current_script ) {
 		rc = -ENOTTY;
 		printf ( "Not in a script: %s\n", strerror ( rc ) );
 		return rc;
 	}
 
 	/* Parse label */
-	goto_label = argv[optind];
+	label = argv[optind];
 
 	/* Find label */
-	saved_offset = script_offset;
-	if ( ( rc = process_script ( current_image, goto_find_label,
-				     terminate_on_label_found ) ) != 0 ) {
-		script_offset = saved_offset;
-		DBGC ( current_image, "[%04zx] No such label :%s\n",
-		       script_offset, goto_label );
-		return rc;
+	line = script_find_label ( current_script, label );
+	if ( ! line ) {
+		DBGC ( current_script->image, "No such label :%s\n", label );
+		return -ENOENT;
 	}
 
+	/* Continue execution from the labelled line */
+	current_script->next = ( line - current_script->lines );
+	DBGC ( current_script->image, "[%04zx] Gone to :%s\n",
+	       line->offset, label );
+
 	/* Terminate processing of current command */
 	shell_stop ( SHELL_STOP_COMMAND );
 
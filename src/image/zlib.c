@@ -0,0 +1,243 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <byteswap.h>
+#include <ipxe/deflate.h>
+#include <ipxe/uaccess.h>
+#include <ipxe/umalloc.h>
+#include <ipxe/image.h>
+#include <ipxe/zlib.h>
+
+/** @file
+ *
+ * zlib compressed images
+ *
+ */
+
+/** Compression method LSB (within big-endian zlib header) */
+#define ZLIB_CM_LSB 8
+
+/** Preset dictionary flag (within big-endian zlib header) */
+#define ZLIB_FDICT 0x0020
+
+/** Adler-32 modulus */
+#define ADLER32_MODULUS 65521
+
+/** Maximum number of bytes summed before Adler-32 reduction
+ *
+ * This is the largest number of bytes that can be summed without
+ * the 32-bit running sums overflowing.
+ */
+#define ADLER32_NMAX 5552
+
+/**
+ * Calculate Adler-32 checksum
+ *
+ * @v data		Data
+ * @v len		Length of data
+ * @ret adler		Adler-32 checksum
+ */
+static uint32_t zlib_adler32 ( const uint8_t *data, size_t len ) {
+	uint32_t a = 1;
+	uint32_t b = 0;
+	size_t frag_len;
+
+	while ( len ) {
+		frag_len = len;
+		if ( frag_len > ADLER32_NMAX )
+			frag_len = ADLER32_NMAX;
+		len -= frag_len;
+		while ( frag_len-- ) {
+			a += *(data++);
+			b += a;
+		}
+		a %= ADLER32_MODULUS;
+		b %= ADLER32_MODULUS;
+	}
+	return ( ( b << 16 ) | a );
+}
+
+/**
+ * Decompress zlib image
+ *
+ * @v image		Image
+ * @v deflate		Decompressor
+ * @v out		Output data chunk
+ * @ret end		Offset to end of compressed data, or negative error
+ *
+ * The decompressor may read ahead beyond the end of the compressed
+ * data into its accumulator.  The returned offset accounts for any
+ * such bytes, and so marks the end of the Adler-32 trailer.
+ */
+static int zlib_inflate ( struct image *image, struct deflate *deflate,
+			  struct deflate_chunk *out ) {
+	struct deflate_chunk in;
+	int rc;
+
+	/* Decompress data */
+	deflate_init ( deflate, DEFLATE_ZLIB );
+	deflate_chunk_init ( &in, image->data, 0, image->len );
+	if ( ( rc = deflate_inflate ( deflate, &in, out ) ) != 0 ) {
+		DBGC ( image, "ZLIB %s could not decompress: %s\n",
+		       image->name, strerror ( rc ) );
+		return rc;
+	}
+
+	/* Check that decompression is valid */
+	if ( ! deflate_finished ( deflate ) ) {
+		DBGC ( image, "ZLIB %s decompression incomplete\n",
+		       image->name );
+		return -EINVAL;
+	}
+
+	/* Identify end of trailer.  The accumulator is byte-aligned
+	 * at this point, and holds the trailer followed by any bytes
+	 * read ahead.
+	 */
+	assert ( ( deflate->bits % 8 ) == 0 );
+	assert ( deflate->bits >= ZLIB_ADLER32_BITS );
+	return ( in.offset - ( ( deflate->bits - ZLIB_ADLER32_BITS ) / 8 ) );
+}
+
+/**
+ * Extract zlib image
+ *
+ * @v image		Image
+ * @v extracted		Extracted image
+ * @ret rc		Return status code
+ */
+static int zlib_extract ( struct image *image, struct image *extracted ) {
+	struct deflate_chunk out;
+	struct deflate *deflate;
+	uint32_t expected;
+	uint32_t adler;
+	size_t len;
+	int end;
+	int rc;
+
+	/* Allocate decompressor */
+	deflate = malloc ( sizeof ( *deflate ) );
+	if ( ! deflate ) {
+		rc = -ENOMEM;
+		goto err_alloc_deflate;
+	}
+
+	/* Calculate decompressed length.  The zlib format does not
+	 * record the uncompressed length, so we must decompress once
+	 * without an output buffer in order to find it.
+	 */
+	deflate_chunk_init ( &out, UNULL, 0, 0 );
+	if ( ( rc = zlib_inflate ( image, deflate, &out ) ) < 0 )
+		goto err_len;
+	len = out.offset;
+
+	/* Allocate extracted image data */
+	extracted->data = umalloc ( len );
+	if ( ! extracted->data ) {
+		rc = -ENOMEM;
+		goto err_alloc_data;
+	}
+	extracted->len = len;
+
+	/* Decompress data */
+	deflate_chunk_init ( &out, extracted->data, 0, len );
+	if ( ( rc = zlib_inflate ( image, deflate, &out ) ) < 0 )
+		goto err_inflate;
+	end = rc;
+
+	/* Verify checksum (which the decompressor itself ignores) */
+	copy_from_user ( &expected, image->data,
+			 ( end - sizeof ( expected ) ), sizeof ( expected ) );
+	adler = zlib_adler32 ( user_to_virt ( extracted->data, 0 ), len );
+	if ( adler != be32_to_cpu ( expected ) ) {
+		DBGC ( image, "ZLIB %s checksum mismatch (expected %08x, got "
+		       "%08x)\n", image->name, be32_to_cpu ( expected ),
+		       adler );
+		rc = -EINVAL;
+		goto err_adler32;
+	}
+
+	/* Free decompressor */
+	free ( deflate );
+
+	DBGC ( image, "ZLIB %s decompressed [0,%#x) to %#zx bytes\n",
+	       image->name, end, len );
+	return 0;
+
+ err_adler32:
+ err_inflate:
+ err_alloc_data:
+ err_len:
+	free ( deflate );
+ err_alloc_deflate:
+	return rc;
+}
+
+/**
+ * Probe zlib image
+ *
+ * @v image		zlib image
+ * @ret rc		Return status code
+ */
+static int zlib_probe ( struct image *image ) {
+	uint16_t raw;
+	unsigned int header;
+
+	/* Sanity check */
+	if ( image->len < ( sizeof ( raw ) + ( ZLIB_ADLER32_BITS / 8 ) ) ) {
+		DBGC ( image, "ZLIB %s image too short\n", image->name );
+		return -ENOEXEC;
+	}
+
+	/* Check header */
+	copy_from_user ( &raw, image->data, 0, sizeof ( raw ) );
+	header = be16_to_cpu ( raw );
+	if ( ( ( header >> ZLIB_CM_LSB ) & ZLIB_HEADER_CM_MASK ) !=
+	     ZLIB_HEADER_CM_DEFLATE ) {
+		DBGC ( image, "ZLIB %s invalid compression method\n",
+		       image->name );
+		return -ENOEXEC;
+	}
+	if ( ( header % 31 ) != 0 ) {
+		DBGC ( image, "ZLIB %s invalid header check\n", image->name );
+		return -ENOEXEC;
+	}
+	if ( header & ZLIB_FDICT ) {
+		DBGC ( image, "ZLIB %s preset dictionary unsupported\n",
+		       image->name );
+		return -ENOTSUP;
+	}
+
+	return 0;
+}
+
+/** zlib image type */
+struct image_type zlib_image_type __image_type ( PROBE_NORMAL ) = {
+	.name = "zlib",
+	.probe = zlib_probe,
+	.extract = zlib_extract,
+	.exec = image_extract_exec,
+};
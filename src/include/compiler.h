@@ -321,6 +321,8 @@ char __debug_disable(OBJECT) = ( DBGLVL_MAX & ~DBGLVL_DFLT );
 #define DBG_PROFILE	( DBGLVL & DBGLVL_PROFILE )
 #define DBGLVL_IO	8
 #define DBG_IO		( DBGLVL & DBGLVL_IO )
+#define DBGLVL_TRACE	16
+#define DBG_TRACE	( DBGLVL & DBGLVL_TRACE )
 
 /**
  * Print debugging message if we are at a certain debug level
@@ -0,0 +1,45 @@
+#ifndef _IPXE_ACCELERATOR_H
+#define _IPXE_ACCELERATOR_H
+
+/** @file
+ *
+ * Accelerated implementations
+ *
+ * Several algorithms allow for architecture-specific accelerated
+ * implementations, each placed into a linker table.  Every entry in
+ * such a table must provide a "name" field and a "supported()"
+ * method.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <ipxe/tables.h>
+
+/**
+ * Select accelerated implementation
+ *
+ * @v table		Accelerator table
+ * @ret accel		First supported accelerator, or NULL
+ *
+ * The table is probed only on first use, and the result is cached
+ * for subsequent calls.  This must therefore be invoked from a single
+ * function per table.
+ */
+#define accelerator_select( table ) ( {					\
+	static __table_type ( table ) *selected;			\
+	static int probed;						\
+	__table_type ( table ) *accel;					\
+	if ( ! probed ) {						\
+		probed = 1;						\
+		for_each_table_entry ( accel, table ) {			\
+			if ( accel->supported() ) {			\
+				DBG ( "Using %s for %s\n", accel->name,	\
+				      __table_name ( table ) );		\
+				selected = accel;			\
+				break;					\
+			}						\
+		}							\
+	}								\
+	selected; } )
+
+#endif /* _IPXE_ACCELERATOR_H */
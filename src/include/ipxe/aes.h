@@ -10,6 +10,7 @@
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <ipxe/crypto.h>
+#include <ipxe/tables.h>
 
 /** AES blocksize */
 #define AES_BLOCKSIZE 16
@@ -39,14 +40,80 @@ struct aes_context {
 	struct aes_round_keys decrypt;
 	/** Number of rounds */
 	unsigned int rounds;
+	/** Accelerated implementation (if any) */
+	struct aes_accelerator *accel;
 };
 
+/** An accelerated AES implementation
+ *
+ * Accelerated implementations use the round keys as constructed by
+ * the portable implementation: the encryption keys are the expanded
+ * key, and the decryption keys are those of the equivalent inverse
+ * cipher.
+ */
+struct aes_accelerator {
+	/** Name */
+	const char *name;
+	/**
+	 * Check if accelerator is supported
+	 *
+	 * @ret supported	Accelerator is supported
+	 */
+	int ( * supported ) ( void );
+	/**
+	 * Encrypt single block
+	 *
+	 * @v aes		AES context
+	 * @v src		Data to encrypt
+	 * @v dst		Buffer for encrypted data
+	 */
+	void ( * encrypt ) ( struct aes_context *aes, const void *src,
+			     void *dst );
+	/**
+	 * Decrypt single block
+	 *
+	 * @v aes		AES context
+	 * @v src		Data to decrypt
+	 * @v dst		Buffer for decrypted data
+	 */
+	void ( * decrypt ) ( struct aes_context *aes, const void *src,
+			     void *dst );
+	/**
+	 * Encrypt multiple blocks (optional)
+	 *
+	 * @v aes		AES context
+	 * @v src		Data to encrypt
+	 * @v dst		Buffer for encrypted data
+	 * @v len		Length of data (a multiple of the block size)
+	 */
+	void ( * bulk_encrypt ) ( struct aes_context *aes, const void *src,
+				  void *dst, size_t len );
+	/**
+	 * Decrypt multiple blocks (optional)
+	 *
+	 * @v aes		AES context
+	 * @v src		Data to decrypt
+	 * @v dst		Buffer for decrypted data
+	 * @v len		Length of data (a multiple of the block size)
+	 */
+	void ( * bulk_decrypt ) ( struct aes_context *aes, const void *src,
+				  void *dst, size_t len );
+};
+
+/** AES accelerator table */
+#define AES_ACCELERATORS \
+	__table ( struct aes_accelerator, "aes_accelerators" )
+
+/** Declare an AES accelerator */
+#define __aes_accelerator __table_entry ( AES_ACCELERATORS, 01 )
+
 /** AES context size */
 #define AES_CTX_SIZE sizeof ( struct aes_context )
 
 extern struct cipher_algorithm aes_algorithm;
 extern struct cipher_algorithm aes_ecb_algorithm;
 extern struct cipher_algorithm aes_cbc_algorithm;
+extern struct cipher_algorithm aes_gcm_algorithm;
 
 int aes_wrap ( const void *kek, const void *src, void *dest, int nblk );
 int aes_unwrap ( const void *kek, const void *src, void *dest, int nblk );
@@ -221,6 +221,16 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 		bigint_t ( size * 2 ) temp_modulus;			\
 	} ); } )
 
+/** Window size for sliding-window modular exponentiation */
+#define BIGINT_MOD_EXP_WINDOW 4
+
+/** Number of precomputed powers for sliding-window modular exponentiation
+ *
+ * Only odd powers need to be precomputed, since every window starts
+ * and ends with a set bit.
+ */
+#define BIGINT_MOD_EXP_POWERS ( 1 << ( BIGINT_MOD_EXP_WINDOW - 1 ) )
+
 /**
  * Perform modular exponentiation of big integers
  *
@@ -247,12 +257,12 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 #define bigint_mod_exp_tmp_len( modulus, exponent ) ( {			\
 	unsigned int size = bigint_size (modulus);			\
-	unsigned int exponent_size = bigint_size (exponent);		\
 	size_t mod_multiply_len =					\
 		bigint_mod_multiply_tmp_len (modulus);			\
+	( void ) bigint_size (exponent);				\
 	sizeof ( struct {						\
-		bigint_t ( size ) temp_base;				\
-		bigint_t ( exponent_size ) temp_exponent;		\
+		bigint_t ( size * 2 ) temp_product;			\
+		bigint_t ( size ) temp_powers[BIGINT_MOD_EXP_POWERS];	\
 		uint8_t mod_multiply[mod_multiply_len];			\
 	} ); } )
 
@@ -286,6 +296,10 @@ void bigint_multiply_raw ( const bigint_element_t *multiplicand0,
 			   const bigint_element_t *multiplier0,
 			   bigint_element_t *result0,
 			   unsigned int size );
+bigint_element_t
+bigint_multiply_accumulate_raw ( const bigint_element_t *multiplicand0,
+				 bigint_element_t multiplier,
+				 bigint_element_t *value0, unsigned int size );
 void bigint_mod_multiply_raw ( const bigint_element_t *multiplicand0,
 			       const bigint_element_t *multiplier0,
 			       const bigint_element_t *modulus0,
@@ -69,6 +69,11 @@ cms_put ( struct cms_signature *sig ) {
 
 extern int cms_signature ( const void *data, size_t len,
 			   struct cms_signature **sig );
+extern int cms_verify_digested ( struct cms_signature *sig, userptr_t data,
+				 size_t len, struct digest_algorithm *digested,
+				 const void *value, const char *name,
+				 time_t time, struct x509_chain *store,
+				 struct x509_root *root );
 extern int cms_verify ( struct cms_signature *sig, userptr_t data, size_t len,
 			const char *name, time_t time, struct x509_chain *store,
 			struct x509_root *root );
@@ -0,0 +1,48 @@
+#ifndef _IPXE_CRC32C_H
+#define _IPXE_CRC32C_H
+
+/** @file
+ *
+ * CRC32C (Castagnoli) checksum
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <ipxe/tables.h>
+
+/** CRC32C polynomial (in bit-reversed form) */
+#define CRC32C_POLY 0x82f63b78UL
+
+/** An accelerated CRC32C implementation */
+struct crc32c_accelerator {
+	/** Name */
+	const char *name;
+	/**
+	 * Check if accelerator is supported
+	 *
+	 * @ret supported	Accelerator is supported
+	 */
+	int ( * supported ) ( void );
+	/**
+	 * Update CRC32C
+	 *
+	 * @v crc		Current CRC value
+	 * @v data		Data
+	 * @v len		Length of data
+	 * @ret crc		Updated CRC value
+	 */
+	uint32_t ( * update ) ( uint32_t crc, const void *data, size_t len );
+};
+
+/** CRC32C accelerator table */
+#define CRC32C_ACCELERATORS \
+	__table ( struct crc32c_accelerator, "crc32c_accelerators" )
+
+/** Declare a CRC32C accelerator */
+#define __crc32c_accelerator __table_entry ( CRC32C_ACCELERATORS, 01 )
+
+extern uint32_t crc32c_le ( uint32_t seed, const void *data, size_t len );
+
+#endif /* _IPXE_CRC32C_H */
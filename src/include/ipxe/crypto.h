@@ -52,6 +52,10 @@ struct cipher_algorithm {
 	size_t ctxsize;
 	/** Block size */
 	size_t blocksize;
+	/** Authentication tag size, or zero if not an authenticating
+	 * cipher
+	 */
+	size_t authsize;
 	/** Set key
 	 *
 	 * @v ctx		Context
@@ -74,6 +78,11 @@ struct cipher_algorithm {
 	 * @v len		Length of data
 	 *
 	 * @v len is guaranteed to be a multiple of @c blocksize.
+	 *
+	 * For an authenticating cipher, @v dst may be NULL, in which
+	 * case @v src is additional data to be authenticated but not
+	 * encrypted.  All additional data must be provided before any
+	 * data to be encrypted.
 	 */
 	void ( * encrypt ) ( void *ctx, const void *src, void *dst,
 			     size_t len );
@@ -85,9 +94,54 @@ struct cipher_algorithm {
 	 * @v len		Length of data
 	 *
 	 * @v len is guaranteed to be a multiple of @c blocksize.
+	 *
+	 * For an authenticating cipher, @v dst may be NULL, in which
+	 * case @v src is additional data to be authenticated but not
+	 * decrypted.  All additional data must be provided before any
+	 * data to be decrypted.
 	 */
 	void ( * decrypt ) ( void *ctx, const void *src, void *dst,
 			     size_t len );
+	/** Encrypt multiple independent blocks
+	 *
+	 * @v ctx		Context
+	 * @v src		Data to encrypt
+	 * @v dst		Buffer for encrypted data
+	 * @v len		Length of data
+	 *
+	 * @v len is guaranteed to be a multiple of @c blocksize.
+	 *
+	 * This optional method may be provided by a raw block cipher.
+	 * Each block is encrypted independently (as for ECB mode),
+	 * allowing an implementation to process several blocks in
+	 * parallel.  If present, @c bulk_decrypt must also be present.
+	 */
+	void ( * bulk_encrypt ) ( void *ctx, const void *src, void *dst,
+				  size_t len );
+	/** Decrypt multiple independent blocks
+	 *
+	 * @v ctx		Context
+	 * @v src		Data to decrypt
+	 * @v dst		Buffer for decrypted data
+	 * @v len		Length of data
+	 *
+	 * @v len is guaranteed to be a multiple of @c blocksize.
+	 *
+	 * This optional method may be provided by a raw block cipher.
+	 * Each block is decrypted independently (as for ECB mode),
+	 * allowing an implementation to process several blocks in
+	 * parallel.
+	 */
+	void ( * bulk_decrypt ) ( void *ctx, const void *src, void *dst,
+				  size_t len );
+	/** Generate authentication tag
+	 *
+	 * @v ctx		Context
+	 * @v auth		Buffer for authentication tag
+	 *
+	 * This method is required only for authenticating ciphers.
+	 */
+	void ( * auth ) ( void *ctx, void *auth );
 };
 
 /** A public key algorithm */
@@ -169,6 +223,23 @@ struct pubkey_algorithm {
 			  const void *public_key, size_t public_key_len );
 };
 
+/** An elliptic curve */
+struct elliptic_curve {
+	/** Curve name */
+	const char *name;
+	/** Key size (i.e. length of a point or scalar) */
+	size_t keysize;
+	/** Multiply scalar by curve point
+	 *
+	 * @v base		Base point (or NULL to use generator)
+	 * @v scalar		Scalar multiple
+	 * @v result		Result point to fill in
+	 * @ret rc		Return status code
+	 */
+	int ( * multiply ) ( const void *base, const void *scalar,
+			     void *result );
+};
+
 static inline void digest_init ( struct digest_algorithm *digest,
 				 void *ctx ) {
 	digest->init ( ctx );
@@ -214,10 +285,43 @@ static inline void cipher_decrypt ( struct cipher_algorithm *cipher,
 	cipher_decrypt ( (cipher), (ctx), (src), (dst), (len) );	\
 	} while ( 0 )
 
+static inline void cipher_bulk_encrypt ( struct cipher_algorithm *cipher,
+					 void *ctx, const void *src,
+					 void *dst, size_t len ) {
+	cipher->bulk_encrypt ( ctx, src, dst, len );
+}
+#define cipher_bulk_encrypt( cipher, ctx, src, dst, len ) do {		\
+	assert ( ( (len) & ( (cipher)->blocksize - 1 ) ) == 0 );	\
+	cipher_bulk_encrypt ( (cipher), (ctx), (src), (dst), (len) );	\
+	} while ( 0 )
+
+static inline void cipher_bulk_decrypt ( struct cipher_algorithm *cipher,
+					 void *ctx, const void *src,
+					 void *dst, size_t len ) {
+	cipher->bulk_decrypt ( ctx, src, dst, len );
+}
+#define cipher_bulk_decrypt( cipher, ctx, src, dst, len ) do {		\
+	assert ( ( (len) & ( (cipher)->blocksize - 1 ) ) == 0 );	\
+	cipher_bulk_decrypt ( (cipher), (ctx), (src), (dst), (len) );	\
+	} while ( 0 )
+
+static inline void cipher_auth ( struct cipher_algorithm *cipher, void *ctx,
+				 void *auth ) {
+	cipher->auth ( ctx, auth );
+}
+
 static inline int is_stream_cipher ( struct cipher_algorithm *cipher ) {
 	return ( cipher->blocksize == 1 );
 }
 
+static inline int is_auth_cipher ( struct cipher_algorithm *cipher ) {
+	return ( cipher->authsize != 0 );
+}
+
+static inline int is_bulk_cipher ( struct cipher_algorithm *cipher ) {
+	return ( cipher->bulk_encrypt != NULL );
+}
+
 static inline int pubkey_init ( struct pubkey_algorithm *pubkey, void *ctx,
 				const void *key, size_t key_len ) {
 	return pubkey->init ( ctx, key, key_len );
@@ -263,6 +367,12 @@ static inline int pubkey_match ( struct pubkey_algorithm *pubkey,
 			       public_key_len );
 }
 
+static inline int elliptic_multiply ( struct elliptic_curve *curve,
+				      const void *base, const void *scalar,
+				      void *result ) {
+	return curve->multiply ( base, scalar, result );
+}
+
 extern struct digest_algorithm digest_null;
 extern struct cipher_algorithm cipher_null;
 extern struct pubkey_algorithm pubkey_null;
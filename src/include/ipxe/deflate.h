@@ -72,18 +72,51 @@ enum deflate_format {
 /** Maximum length of a Huffman symbol (in bits) */
 #define DEFLATE_HUFFMAN_BITS 15
 
-/** Quick lookup length for a Huffman symbol (in bits)
+/** Literal/length Huffman decoding root table index length (in bits)
  *
  * This is a policy decision.
  */
-#define DEFLATE_HUFFMAN_QL_BITS 7
+#define DEFLATE_LITLEN_ROOT_BITS 9
 
-/** Quick lookup shift */
-#define DEFLATE_HUFFMAN_QL_SHIFT ( 16 - DEFLATE_HUFFMAN_QL_BITS )
+/** Distance and code length Huffman decoding root table index length
+ * (in bits)
+ *
+ * This is a policy decision, subject to the constraint that all code
+ * length symbols (which have a maximum length of 7 bits) must fit
+ * within the root table.
+ */
+#define DEFLATE_DISTANCE_ROOT_BITS 8
+
+/** Maximum number of Huffman decoding table entries
+ *
+ * A subsidiary table of 2^n entries can be required only if there
+ * are at least (n+1) symbols sharing its root table prefix, and the
+ * size of any subsidiary table is limited by the maximum symbol
+ * length.  Since 2^n/(n+1) increases with n, the worst case is given
+ * by assigning as many symbols as possible to subsidiary tables of
+ * the maximum size.
+ *
+ * @v count		Number of symbols
+ * @v root		Root table index length (in bits)
+ */
+#define DEFLATE_TABLE_LEN( count, root )				\
+	( ( 1 << (root) ) +						\
+	  ( ( (count) / ( DEFLATE_HUFFMAN_BITS - (root) + 1 ) ) <<	\
+	    ( DEFLATE_HUFFMAN_BITS - (root) ) ) )
 
 /** Literal/length end of block code */
 #define DEFLATE_LITLEN_END 256
 
+/** Maximum length of a duplicated string */
+#define DEFLATE_DUP_MAX_LEN 258
+
+/** Minimum output buffer space required for the fast decoding path
+ *
+ * Duplicated strings may be copied a word at a time, and so may
+ * overrun by up to one word.
+ */
+#define DEFLATE_FAST_OUT ( DEFLATE_DUP_MAX_LEN + sizeof ( uint64_t ) )
+
 /** Maximum value of a literal/length code */
 #define DEFLATE_LITLEN_MAX_CODE 287
 
@@ -111,37 +144,30 @@ enum deflate_format {
 /** ZLIB ADLER32 length (in bits) */
 #define ZLIB_ADLER32_BITS 32
 
-/** A Huffman-coded set of symbols of a given length */
-struct deflate_huf_symbols {
-	/** Length of Huffman-coded symbols */
+/** A Huffman decoding table entry */
+struct deflate_huf_entry {
+	/** Raw symbol, or index of subsidiary table */
+	uint16_t raw;
+	/** Length of Huffman-coded symbol (in bits) */
 	uint8_t bits;
-	/** Shift to normalise symbols of this length to 16 bits */
-	uint8_t shift;
-	/** Number of Huffman-coded symbols having this length */
-	uint16_t freq;
-	/** First symbol of this length (normalised to 16 bits)
-	 *
-	 * Stored as a 32-bit value to allow the value 0x10000 to be
-	 * used for empty sets of symbols longer than the maximum
-	 * utilised length.
-	 */
-	uint32_t start;
-	/** Raw symbols having this length */
-	uint16_t *raw;
+	/** Subsidiary table index length (in bits), or zero for a symbol */
+	uint8_t sub_bits;
 };
 
-/** A Huffman-coded alphabet */
+/** A Huffman-coded alphabet
+ *
+ * Symbols are decoded by direct lookup into a root table indexed by
+ * the next few (bit-reversed) input bits.  Symbols longer than the
+ * root table index are decoded via a subsidiary table indexed by the
+ * subsequent input bits.
+ */
 struct deflate_alphabet {
-	/** Huffman-coded symbol set for each length */
-	struct deflate_huf_symbols huf[DEFLATE_HUFFMAN_BITS];
-	/** Quick lookup table */
-	uint8_t lookup[ 1 << DEFLATE_HUFFMAN_QL_BITS ];
-	/** Raw symbols
-	 *
-	 * Ordered by Huffman-coded symbol length, then by symbol
-	 * value.  This field has a variable length.
-	 */
-	uint16_t raw[0];
+	/** Decoding table */
+	struct deflate_huf_entry *table;
+	/** Root table index length (in bits) */
+	unsigned int root;
+	/** Maximum number of decoding table entries */
+	unsigned int max;
 };
 
 /** A static Huffman alphabet length pattern */
@@ -164,12 +190,7 @@ struct deflate {
 	enum deflate_format format;
 
 	/** Accumulator */
-	uint32_t accumulator;
-	/** Bit-reversed accumulator
-	 *
-	 * Don't ask.
-	 */
-	uint32_t rotalumucca;
+	uint64_t accumulator;
 	/** Number of bits within the accumulator */
 	unsigned int bits;
 
@@ -192,11 +213,10 @@ struct deflate {
 
 	/** Literal/length Huffman alphabet */
 	struct deflate_alphabet litlen;
-	/** Literal/length raw symbols
-	 *
-	 * Must immediately follow the literal/length Huffman alphabet.
-	 */
-	uint16_t litlen_raw[ DEFLATE_LITLEN_MAX_CODE + 1 ];
+	/** Literal/length Huffman decoding table */
+	struct deflate_huf_entry
+		litlen_table[ DEFLATE_TABLE_LEN ( DEFLATE_LITLEN_MAX_CODE + 1,
+						  DEFLATE_LITLEN_ROOT_BITS ) ];
 	/** Number of symbols in the literal/length Huffman alphabet */
 	unsigned int litlen_count;
 
@@ -210,12 +230,11 @@ struct deflate {
 	 * temporarily hold the code length alphabet.
 	 */
 	struct deflate_alphabet distance_codelen;
-	/** Distance and code length raw symbols
-	 *
-	 * Must immediately follow the distance and code length
-	 * Huffman alphabet.
-	 */
-	uint16_t distance_codelen_raw[ DEFLATE_DISTANCE_MAX_CODE + 1 ];
+	/** Distance and code length Huffman decoding table */
+	struct deflate_huf_entry
+		distance_codelen_table[ DEFLATE_TABLE_LEN (
+						( DEFLATE_DISTANCE_MAX_CODE + 1 ),
+						DEFLATE_DISTANCE_ROOT_BITS ) ];
 	/** Number of symbols in the distance Huffman alphabet */
 	unsigned int distance_count;
 
@@ -235,6 +254,11 @@ struct deflate {
 	uint8_t lengths[ ( ( DEFLATE_LITLEN_MAX_CODE + 1 ) +
 			   ( DEFLATE_DISTANCE_MAX_CODE + 1 ) +
 			   1 /* round up */ ) / 2 ];
+	/** Raw symbols sorted by Huffman-coded value
+	 *
+	 * Used only while constructing a Huffman alphabet.
+	 */
+	uint16_t sorted[ DEFLATE_LITLEN_MAX_CODE + 1 ];
 };
 
 /** A chunk of data */
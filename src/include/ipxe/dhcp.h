@@ -264,6 +264,14 @@ struct dhcp_client_id {
 /** User class identifier */
 #define DHCP_USER_CLASS_ID 77
 
+/** Rapid commit
+ *
+ * This zero-length option is sent in a DHCPDISCOVER to indicate that
+ * the client will accept a DHCPACK in place of a DHCPOFFER (as per
+ * RFC 4039).
+ */
+#define DHCP_RAPID_COMMIT 80
+
 /** Client system architecture */
 #define DHCP_CLIENT_ARCHITECTURE 93
 
@@ -0,0 +1,18 @@
+#ifndef _IPXE_DISKWRITE_H
+#define _IPXE_DISKWRITE_H
+
+/** @file
+ *
+ * Local disk writing
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+struct interface;
+struct uri;
+
+extern int create_disk_writer ( struct interface *job, const char *disk,
+				struct uri *uri );
+
+#endif /* _IPXE_DISKWRITE_H */
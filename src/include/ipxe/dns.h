@@ -61,6 +61,34 @@ struct dns_name {
  */
 #define DNS_MAX_CNAME_RECURSION 32
 
+/** Maximum number of cached DNS responses */
+#define DNS_CACHE_MAX 16
+
+/** Maximum time for which a DNS response will be cached (in seconds)
+ *
+ * This is a policy decision, and also serves to keep the lifetime
+ * (in ticks) well within the range of an unsigned long.
+ */
+#define DNS_CACHE_MAX_TTL 3600
+
+/** Time for which a nonexistent name will be cached (in seconds)
+ *
+ * We do not parse the SOA record that RFC2308 uses to convey the
+ * negative caching time, and so use a short fixed value instead.
+ */
+#define DNS_NEGATIVE_TTL 30
+
+/** Maximum number of concurrent queries per DNS request */
+#define DNS_MAX_QUERIES 2
+
+/** Resolution delay
+ *
+ * When an A record arrives while an AAAA query is still outstanding,
+ * we wait for this long (as recommended by RFC8305 section 3) before
+ * giving up on the AAAA record.
+ */
+#define DNS_RESOLUTION_DELAY ( TICKS_PER_SEC / 20 )
+
 /** A DNS packet header */
 struct dns_header {
 	/** Query identifier */
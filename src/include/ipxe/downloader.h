@@ -11,7 +11,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 struct interface;
 struct image;
+struct digest_algorithm;
 
-extern int create_downloader ( struct interface *job, struct image *image );
+extern int create_downloader ( struct interface *job, struct image *image,
+			       struct digest_algorithm *digest );
 
 #endif /* _IPXE_DOWNLOADER_H */
@@ -0,0 +1,47 @@
+#ifndef _IPXE_DROPSTAT_H
+#define _IPXE_DROPSTAT_H
+
+/** @file
+ *
+ * Packet drop statistics
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <ipxe/tables.h>
+
+/** A packet drop counter
+ *
+ * Each counter records the number of times that a packet (or other
+ * unit of received data) has been discarded for a particular reason.
+ * Counters are always compiled in, since incrementing a counter is
+ * negligibly cheap compared to the cost of the drop itself.
+ */
+struct drop_counter {
+	/** Name
+	 *
+	 * By convention this is "<layer>.<reason>", e.g. "tcp.csum".
+	 */
+	const char *name;
+	/** Number of drops */
+	unsigned long count;
+};
+
+/** Packet drop counter table */
+#define DROP_COUNTERS __table ( struct drop_counter, "drop_counters" )
+
+/** Declare a packet drop counter */
+#define __drop_counter __table_entry ( DROP_COUNTERS, 01 )
+
+/**
+ * Record a packet drop
+ *
+ * @v counter		Packet drop counter
+ */
+static inline void drop_count ( struct drop_counter *counter ) {
+
+	counter->count++;
+}
+
+#endif /* _IPXE_DROPSTAT_H */
@@ -29,6 +29,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
  */
 
 typedef struct _IPXE_DOWNLOAD_PROTOCOL IPXE_DOWNLOAD_PROTOCOL;
+typedef struct _IPXE_DOWNLOAD_BUFFER_PROTOCOL IPXE_DOWNLOAD_BUFFER_PROTOCOL;
 
 /** Token to represent a currently downloading file */
 typedef VOID *IPXE_DOWNLOAD_FILE;
@@ -39,6 +40,9 @@ typedef VOID *IPXE_DOWNLOAD_FILE;
  * Not all protocols will deliver data in order. Clients should not rely on the
  * order of data delivery matching the order in the file.
  *
+ * Data is aggregated into blocks of up to 64kB before being delivered, where
+ * possible.
+ *
  * Some protocols are capable of determining the file size near the beginning
  * of data transfer. To allow the client to allocate memory more efficiently,
  * iPXE may give a hint about the file size by calling the Data callback with
@@ -134,6 +138,28 @@ EFI_STATUS
   IN IPXE_DOWNLOAD_PROTOCOL *This
   );
 
+/**
+ * Download a file directly into a caller-supplied buffer.
+ *
+ * This function blocks until the download is complete.  If the buffer
+ * is too small, EFI_BUFFER_TOO_SMALL is returned and BufferLength is
+ * updated to indicate the required length (if known).
+ *
+ * @v This		iPXE Download Buffer Protocol instance
+ * @v Url		URL to download from
+ * @v Buffer		Buffer to fill
+ * @v BufferLength	On entry, length of buffer; on exit, length of file
+ * @ret Status		EFI status code
+ */
+typedef
+EFI_STATUS
+(EFIAPI *IPXE_DOWNLOAD_TO_BUFFER)(
+  IN IPXE_DOWNLOAD_BUFFER_PROTOCOL *This,
+  IN CHAR8 *Url,
+  OUT VOID *Buffer,
+  IN OUT UINTN *BufferLength
+  );
+
 /**
  * The iPXE Download Protocol.
  *
@@ -151,6 +177,22 @@ struct _IPXE_DOWNLOAD_PROTOCOL {
     0x3eaeaebd, 0xdecf, 0x493b, { 0x9b, 0xd1, 0xcd, 0xb2, 0xde, 0xca, 0xe7, 0x19 } \
   }
 
+/**
+ * The iPXE Download Buffer Protocol.
+ *
+ * iPXE will attach a iPXE Download Buffer Protocol alongside each iPXE
+ * Download Protocol.  It is published under a separate GUID so that
+ * the layout of the iPXE Download Protocol remains unchanged.
+ */
+struct _IPXE_DOWNLOAD_BUFFER_PROTOCOL {
+   IPXE_DOWNLOAD_TO_BUFFER DownloadToBuffer;
+};
+
+#define IPXE_DOWNLOAD_BUFFER_PROTOCOL_GUID \
+  { \
+    0x3943503b, 0x6640, 0x44a2, { 0x9f, 0xb9, 0x91, 0x8a, 0xb9, 0x5a, 0x0b, 0x46 } \
+  }
+
 extern int efi_download_install ( EFI_HANDLE handle );
 extern void efi_download_uninstall ( EFI_HANDLE handle );
 
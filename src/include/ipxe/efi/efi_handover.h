@@ -0,0 +1,20 @@
+#ifndef _IPXE_EFI_HANDOVER_H
+#define _IPXE_EFI_HANDOVER_H
+
+/** @file
+ *
+ * EFI state handover to a chained iPXE
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** iPXE state handover configuration table GUID */
+#define IPXE_HANDOVER_TABLE_GUID					\
+	{ 0xd5edcd7b, 0x1597, 0x4448,					\
+	  { 0x8a, 0x07, 0xcd, 0x5d, 0x3e, 0x17, 0x72, 0x71 } }
+
+extern void efi_handover_install ( void );
+extern void efi_handover_uninstall ( void );
+
+#endif /* _IPXE_EFI_HANDOVER_H */
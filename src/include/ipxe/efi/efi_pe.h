@@ -0,0 +1,30 @@
+#ifndef _IPXE_EFI_PE_H
+#define _IPXE_EFI_PE_H
+
+/** @file
+ *
+ * EFI PE image headers
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+#include <ipxe/efi/efi.h>
+#include <ipxe/efi/IndustryStandard/PeImage.h>
+
+struct image;
+
+/** PE machine type for images that this build can execute */
+#if defined ( __i386__ )
+#define EFI_PE_MACHINE IMAGE_FILE_MACHINE_I386
+#elif defined ( __x86_64__ )
+#define EFI_PE_MACHINE IMAGE_FILE_MACHINE_X64
+#elif defined ( __arm__ )
+#define EFI_PE_MACHINE IMAGE_FILE_MACHINE_ARMTHUMB_MIXED
+#elif defined ( __aarch64__ )
+#define EFI_PE_MACHINE IMAGE_FILE_MACHINE_ARM64
+#endif
+
+extern int efi_pe_check ( struct image *image, unsigned int machine );
+
+#endif /* _IPXE_EFI_PE_H */
@@ -21,6 +21,16 @@
 /** SNP transmit completion ring size */
 #define EFI_SNP_NUM_TX 32
 
+/** Maximum number of packets held in the SNP receive queue
+ *
+ * A single poll of the underlying device may harvest an entire
+ * receive ring's worth of packets, which are then handed out by
+ * successive calls to Receive() without further polling.  The limit
+ * exists only to bound memory usage if the SNP consumer stops
+ * receiving.
+ */
+#define EFI_SNP_MAX_RX 256
+
 /** An SNP device */
 struct efi_snp_device {
 	/** List of SNP devices */
@@ -47,6 +57,8 @@ struct efi_snp_device {
 	unsigned int tx_cons;
 	/** Receive queue */
 	struct list_head rx;
+	/** Number of packets in receive queue */
+	unsigned int rx_fill;
 	/** The network interface identifier */
 	EFI_NETWORK_INTERFACE_IDENTIFIER_PROTOCOL nii;
 	/** Component name protocol */
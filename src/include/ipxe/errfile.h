@@ -73,6 +73,11 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define ERRFILE_pixbuf		       ( ERRFILE_CORE | 0x00210000 )
 #define ERRFILE_efi_block	       ( ERRFILE_CORE | 0x00220000 )
 #define ERRFILE_sanboot		       ( ERRFILE_CORE | 0x00230000 )
+#define ERRFILE_timeline	       ( ERRFILE_CORE | 0x00240000 )
+#define ERRFILE_archive		       ( ERRFILE_CORE | 0x00250000 )
+#define ERRFILE_fec		       ( ERRFILE_CORE | 0x00260000 )
+#define ERRFILE_handover	       ( ERRFILE_CORE | 0x00270000 )
+#define ERRFILE_trace		       ( ERRFILE_CORE | 0x00280000 )
 
 #define ERRFILE_eisa		     ( ERRFILE_DRIVER | 0x00000000 )
 #define ERRFILE_isa		     ( ERRFILE_DRIVER | 0x00010000 )
@@ -89,6 +94,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define ERRFILE_usbhid		     ( ERRFILE_DRIVER | 0x000c0000 )
 #define ERRFILE_usbkbd		     ( ERRFILE_DRIVER | 0x000d0000 )
 #define ERRFILE_usbio		     ( ERRFILE_DRIVER | 0x000e0000 )
+#define ERRFILE_usbblk		     ( ERRFILE_DRIVER | 0x000f0000 )
 
 #define ERRFILE_nvs		     ( ERRFILE_DRIVER | 0x00100000 )
 #define ERRFILE_spi		     ( ERRFILE_DRIVER | 0x00110000 )
@@ -271,6 +277,15 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define ERRFILE_peermux			( ERRFILE_NET | 0x00470000 )
 #define ERRFILE_xsigo			( ERRFILE_NET | 0x00480000 )
 #define ERRFILE_ntp			( ERRFILE_NET | 0x00490000 )
+#define ERRFILE_httpmux			( ERRFILE_NET | 0x004a0000 )
+#define ERRFILE_http2			( ERRFILE_NET | 0x004b0000 )
+#define ERRFILE_hpack			( ERRFILE_NET | 0x004c0000 )
+#define ERRFILE_httpgzip		( ERRFILE_NET | 0x004d0000 )
+#define ERRFILE_mcfec			( ERRFILE_NET | 0x004e0000 )
+#define ERRFILE_peerserv		( ERRFILE_NET | 0x004f0000 )
+#define ERRFILE_fragment		( ERRFILE_NET | 0x00500000 )
+#define ERRFILE_syslog			( ERRFILE_NET | 0x00510000 )
+#define ERRFILE_syslogs			( ERRFILE_NET | 0x00520000 )
 
 #define ERRFILE_image		      ( ERRFILE_IMAGE | 0x00000000 )
 #define ERRFILE_elf		      ( ERRFILE_IMAGE | 0x00010000 )
@@ -282,6 +297,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define ERRFILE_png		      ( ERRFILE_IMAGE | 0x00070000 )
 #define ERRFILE_der		      ( ERRFILE_IMAGE | 0x00080000 )
 #define ERRFILE_pem		      ( ERRFILE_IMAGE | 0x00090000 )
+#define ERRFILE_gzip		      ( ERRFILE_IMAGE | 0x000a0000 )
+#define ERRFILE_zlib		      ( ERRFILE_IMAGE | 0x000b0000 )
+#define ERRFILE_efi_pe		      ( ERRFILE_IMAGE | 0x000c0000 )
 
 #define ERRFILE_asn1		      ( ERRFILE_OTHER | 0x00000000 )
 #define ERRFILE_chap		      ( ERRFILE_OTHER | 0x00010000 )
@@ -363,6 +381,18 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define ERRFILE_efi_local	      ( ERRFILE_OTHER | 0x004d0000 )
 #define ERRFILE_efi_entropy	      ( ERRFILE_OTHER | 0x004e0000 )
 #define ERRFILE_cert_cmd	      ( ERRFILE_OTHER | 0x004f0000 )
+#define ERRFILE_x25519		      ( ERRFILE_OTHER | 0x00500000 )
+#define ERRFILE_httpbench	      ( ERRFILE_OTHER | 0x00510000 )
+#define ERRFILE_httpbench_cmd	      ( ERRFILE_OTHER | 0x00520000 )
+#define ERRFILE_efi_handover	      ( ERRFILE_OTHER | 0x00530000 )
+#define ERRFILE_image_trust_cmd	      ( ERRFILE_OTHER | 0x00540000 )
+#define ERRFILE_efi_cache	      ( ERRFILE_OTHER | 0x00550000 )
+#define ERRFILE_efi_diskwrite	      ( ERRFILE_OTHER | 0x00560000 )
+#define ERRFILE_diskwrite	      ( ERRFILE_OTHER | 0x00570000 )
+#define ERRFILE_diskwrite_cmd	      ( ERRFILE_OTHER | 0x00580000 )
+#define ERRFILE_timeline_test	      ( ERRFILE_OTHER | 0x00590000 )
+#define ERRFILE_efi_pe_test	      ( ERRFILE_OTHER | 0x005a0000 )
+#define ERRFILE_process_test	      ( ERRFILE_OTHER | 0x005b0000 )
 
 /** @} */
 
@@ -140,6 +140,13 @@ struct fbcon {
 	struct ansiesc_context ctx;
 	/** Text array */
 	struct fbcon_text text;
+	/** Displayed text array
+	 *
+	 * This records the cell most recently drawn at each position
+	 * (including any cursor highlighting), allowing cells that are
+	 * already displayed to be skipped when redrawing.
+	 */
+	struct fbcon_text display;
 	/** Background picture */
 	struct fbcon_picture picture;
 	/** Display cursor */
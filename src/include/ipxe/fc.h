@@ -284,6 +284,24 @@ struct fc_port {
 
 	/** List of active exchanges */
 	struct list_head xchgs;
+	/** List of discovered peer port IDs */
+	struct list_head discovered;
+};
+
+/** A Fibre Channel peer port ID discovered via a fabric
+ *
+ * Peer port IDs remain valid for as long as the local port remains
+ * logged in to the fabric, and so may be reused to avoid repeating
+ * name server lookups when a peer is logged in again (e.g. by a
+ * subsequent "sanboot" following a "sanhook").
+ */
+struct fc_discovered {
+	/** List of discovered peer port IDs */
+	struct list_head list;
+	/** Peer port name */
+	struct fc_name port_wwn;
+	/** Peer port ID */
+	struct fc_port_id port_id;
 };
 
 /** Fibre Channel port flags */
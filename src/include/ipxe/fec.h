@@ -0,0 +1,28 @@
+#ifndef _IPXE_FEC_H
+#define _IPXE_FEC_H
+
+/** @file
+ *
+ * Reed-Solomon forward error correction
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** Maximum number of encoding symbols (source plus repair) per block
+ *
+ * Encoding symbol indices are elements of GF(2^8).
+ */
+#define FEC_MAX_SYMBOLS 256
+
+extern void fec_encode ( unsigned int k, const void **source,
+			 unsigned int index, void *repair, size_t len );
+extern int fec_decode ( unsigned int k, void **source,
+			const uint8_t *missing, void **repair,
+			const uint8_t *index, unsigned int count,
+			size_t len );
+
+#endif /* _IPXE_FEC_H */
@@ -17,14 +17,29 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Fragment reassembly timeout */
 #define FRAGMENT_TIMEOUT ( TICKS_PER_SEC / 2 )
 
+/** Maximum total size of I/O buffers held for fragment reassembly
+ *
+ * The least recently used reassembly buffers are discarded when this
+ * limit is exceeded.
+ */
+#define FRAGMENT_MAX_BUFFERED ( 256 * 1024 )
+
 /** A fragment reassembly buffer */
 struct fragment {
-	/* List of fragment reassembly buffers */
+	/** List of fragment reassembly buffers */
 	struct list_head list;
-	/** Reassembled packet */
+	/** Non-fragmentable portion of packet */
 	struct io_buffer *iobuf;
-	/** Length of non-fragmentable portion of reassembled packet */
+	/** Length of non-fragmentable portion of packet */
 	size_t hdrlen;
+	/** Received fragment data, in order of offset */
+	struct list_head queue;
+	/** Length of received fragment data */
+	size_t len;
+	/** Length of reassembled fragment data (or zero if not yet known) */
+	size_t total;
+	/** Total size of I/O buffers held */
+	size_t size;
 	/** Reassembly timer */
 	struct retry_timer timer;
 	/** Fragment reassembler */
@@ -33,8 +48,6 @@ struct fragment {
 
 /** A fragment reassembler */
 struct fragment_reassembler {
-	/** List of fragment reassembly buffers */
-	struct list_head list;
 	/**
 	 * Check if fragment matches fragment reassembly buffer
 	 *
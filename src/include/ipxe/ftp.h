@@ -9,7 +9,62 @@
 
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
+#include <stdint.h>
+#include <ipxe/refcnt.h>
+#include <ipxe/interface.h>
+#include <ipxe/uri.h>
+
 /** FTP default port */
 #define FTP_PORT 21
 
+/** Maximum number of concurrent connections for a parallel download */
+#define FTPMUX_MAX_CONNECTIONS 8
+
+/** Minimum length of data to be downloaded over each connection
+ *
+ * Small files are not worth the overhead of additional connections,
+ * each of which requires a full login sequence.
+ */
+#define FTPMUX_MIN_LEN ( 256 * 1024 )
+
+/** An FTP multiplexed segment download */
+struct ftp_multiplexed_segment {
+	/** FTP download multiplexer */
+	struct ftp_multiplexer *ftpmux;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Starting offset within file */
+	size_t start;
+	/** Ending offset within file */
+	size_t end;
+	/** Current offset within file */
+	size_t pos;
+};
+
+/** An FTP download multiplexer */
+struct ftp_multiplexer {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Primary download interface */
+	struct interface primary;
+	/** Original URI */
+	struct uri *uri;
+
+	/** Maximum number of concurrent connections */
+	unsigned int count;
+	/** Number of downloads in progress (including primary) */
+	unsigned int busy;
+	/** Total file size, or zero if not yet known */
+	size_t len;
+	/** Current offset within file of primary download */
+	size_t pos;
+	/** Ending offset of primary download, or zero if unlimited */
+	size_t limit;
+
+	/** Segment downloads */
+	struct ftp_multiplexed_segment segment[ FTPMUX_MAX_CONNECTIONS - 1 ];
+};
+
 #endif /* _IPXE_FTP_H */
@@ -0,0 +1,191 @@
+#ifndef _IPXE_GCM_H
+#define _IPXE_GCM_H
+
+/** @file
+ *
+ * Galois/Counter Mode (GCM)
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <ipxe/crypto.h>
+#include <ipxe/tables.h>
+
+/** GCM block size */
+#define GCM_BLOCKSIZE 16
+
+/** GCM initialisation vector length
+ *
+ * Only 96-bit initialisation vectors are supported.  This is the
+ * length recommended by NIST SP 800-38D, and is the only length used
+ * by TLS.
+ */
+#define GCM_IV_LEN 12
+
+/** GCM authentication tag length */
+#define GCM_AUTH_LEN 16
+
+/** A GCM counter block */
+struct gcm_counter {
+	/** Initialisation vector */
+	uint8_t iv[GCM_IV_LEN];
+	/** Counter value */
+	uint32_t value;
+} __attribute__ (( packed ));
+
+/** GCM lengths block */
+struct gcm_lengths {
+	/** Length of additional data (in bits) */
+	uint64_t add;
+	/** Length of data (in bits) */
+	uint64_t data;
+} __attribute__ (( packed ));
+
+/** A GCM block */
+union gcm_block {
+	/** Raw bytes */
+	uint8_t byte[GCM_BLOCKSIZE];
+	/** Raw qwords */
+	uint64_t qword[ GCM_BLOCKSIZE / sizeof ( uint64_t ) ];
+	/** Counter block */
+	struct gcm_counter ctr;
+	/** Lengths block */
+	struct gcm_lengths len;
+};
+
+/** A GCM multiplication table
+ *
+ * This holds the products of the hash key with each of the sixteen
+ * possible 4-bit values, allowing multiplication by the hash key to
+ * be performed four bits at a time.
+ */
+struct gcm_table {
+	/** High qwords of products */
+	uint64_t hi[16];
+	/** Low qwords of products */
+	uint64_t lo[16];
+};
+
+/** GCM context */
+struct gcm_context {
+	/** Hash key (H) */
+	union gcm_block key;
+	/** Accumulated hash (X) */
+	union gcm_block hash;
+	/** Counter (Y) */
+	union gcm_block ctr;
+	/** Encrypted counter (keystream for current block) */
+	union gcm_block stream;
+	/** Length of additional data processed (in bytes) */
+	size_t add_len;
+	/** Length of data processed (in bytes) */
+	size_t data_len;
+	/** Accelerated implementation (if any) */
+	struct gcm_accelerator *accel;
+	/** Multiplication table (if not accelerated) */
+	struct gcm_table table;
+};
+
+/** An accelerated GCM implementation */
+struct gcm_accelerator {
+	/** Name */
+	const char *name;
+	/**
+	 * Check if accelerator is supported
+	 *
+	 * @ret supported	Accelerator is supported
+	 */
+	int ( * supported ) ( void );
+	/**
+	 * Multiply by hash key
+	 *
+	 * @v poly		Polynomial to multiply (in place)
+	 * @v key		Hash key
+	 */
+	void ( * multiply ) ( union gcm_block *poly,
+			      const union gcm_block *key );
+};
+
+/** GCM accelerator table */
+#define GCM_ACCELERATORS \
+	__table ( struct gcm_accelerator, "gcm_accelerators" )
+
+/** Declare a GCM accelerator */
+#define __gcm_accelerator __table_entry ( GCM_ACCELERATORS, 01 )
+
+extern int gcm_setkey ( void *ctx, const void *key, size_t keylen,
+			struct cipher_algorithm *raw_cipher,
+			struct gcm_context *gcm );
+extern void gcm_setiv ( void *ctx, const void *iv,
+			struct cipher_algorithm *raw_cipher,
+			struct gcm_context *gcm );
+extern void gcm_encrypt ( void *ctx, const void *src, void *dst, size_t len,
+			  struct cipher_algorithm *raw_cipher,
+			  struct gcm_context *gcm );
+extern void gcm_decrypt ( void *ctx, const void *src, void *dst, size_t len,
+			  struct cipher_algorithm *raw_cipher,
+			  struct gcm_context *gcm );
+extern void gcm_auth ( void *ctx, void *auth,
+		       struct cipher_algorithm *raw_cipher,
+		       struct gcm_context *gcm );
+
+/**
+ * Create a GCM mode of behaviour of an existing cipher
+ *
+ * @v _gcm_name		Name for the new GCM cipher
+ * @v _gcm_cipher	New cipher algorithm
+ * @v _raw_cipher	Underlying cipher algorithm
+ * @v _raw_context	Context structure for the underlying cipher
+ * @v _blocksize	Cipher block size
+ */
+#define GCM_CIPHER( _gcm_name, _gcm_cipher, _raw_cipher, _raw_context,	\
+		    _blocksize )					\
+struct _gcm_name ## _context {						\
+	_raw_context raw_ctx;						\
+	struct gcm_context gcm_ctx;					\
+};									\
+static int _gcm_name ## _setkey ( void *ctx, const void *key,		\
+				  size_t keylen ) {			\
+	struct _gcm_name ## _context * _gcm_name ## _ctx = ctx;		\
+	linker_assert ( _blocksize == GCM_BLOCKSIZE,			\
+			_gcm_name ## _unsupported );			\
+	return gcm_setkey ( &_gcm_name ## _ctx->raw_ctx, key, keylen,	\
+			    &_raw_cipher, &_gcm_name ## _ctx->gcm_ctx );\
+}									\
+static void _gcm_name ## _setiv ( void *ctx, const void *iv ) {		\
+	struct _gcm_name ## _context * _gcm_name ## _ctx = ctx;		\
+	gcm_setiv ( &_gcm_name ## _ctx->raw_ctx, iv,			\
+		    &_raw_cipher, &_gcm_name ## _ctx->gcm_ctx );	\
+}									\
+static void _gcm_name ## _encrypt ( void *ctx, const void *src,		\
+				    void *dst, size_t len ) {		\
+	struct _gcm_name ## _context * _gcm_name ## _ctx = ctx;		\
+	gcm_encrypt ( &_gcm_name ## _ctx->raw_ctx, src, dst, len,	\
+		      &_raw_cipher, &_gcm_name ## _ctx->gcm_ctx );	\
+}									\
+static void _gcm_name ## _decrypt ( void *ctx, const void *src,		\
+				    void *dst, size_t len ) {		\
+	struct _gcm_name ## _context * _gcm_name ## _ctx = ctx;		\
+	gcm_decrypt ( &_gcm_name ## _ctx->raw_ctx, src, dst, len,	\
+		      &_raw_cipher, &_gcm_name ## _ctx->gcm_ctx );	\
+}									\
+static void _gcm_name ## _auth ( void *ctx, void *auth ) {		\
+	struct _gcm_name ## _context * _gcm_name ## _ctx = ctx;		\
+	gcm_auth ( &_gcm_name ## _ctx->raw_ctx, auth,			\
+		   &_raw_cipher, &_gcm_name ## _ctx->gcm_ctx );		\
+}									\
+struct cipher_algorithm _gcm_cipher = {					\
+	.name		= #_gcm_name,					\
+	.ctxsize	= sizeof ( struct _gcm_name ## _context ),	\
+	.blocksize	= 1,						\
+	.authsize	= GCM_AUTH_LEN,					\
+	.setkey		= _gcm_name ## _setkey,				\
+	.setiv		= _gcm_name ## _setiv,				\
+	.encrypt	= _gcm_name ## _encrypt,			\
+	.decrypt	= _gcm_name ## _decrypt,			\
+	.auth		= _gcm_name ## _auth,				\
+};
+
+#endif /* _IPXE_GCM_H */
@@ -0,0 +1,74 @@
+#ifndef _IPXE_GZIP_H
+#define _IPXE_GZIP_H
+
+/** @file
+ *
+ * gzip compressed data format
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <ipxe/image.h>
+
+/** A gzip member header (RFC 1952) */
+struct gzip_header {
+	/** Magic signature */
+	uint16_t magic;
+	/** Compression method */
+	uint8_t cm;
+	/** Flags */
+	uint8_t flags;
+	/** Modification time */
+	uint32_t mtime;
+	/** Extra flags */
+	uint8_t xfl;
+	/** Operating system */
+	uint8_t os;
+} __attribute__ (( packed ));
+
+/** gzip magic signature */
+#define GZIP_MAGIC 0x8b1f
+
+/** gzip "deflate" compression method */
+#define GZIP_CM_DEFLATE 8
+
+/** gzip header CRC16 present flag */
+#define GZIP_FHCRC 0x02
+
+/** gzip extra field present flag */
+#define GZIP_FEXTRA 0x04
+
+/** gzip original file name present flag */
+#define GZIP_FNAME 0x08
+
+/** gzip file comment present flag */
+#define GZIP_FCOMMENT 0x10
+
+/** gzip reserved flags */
+#define GZIP_FRESERVED 0xe0
+
+/** A gzip extra field length */
+struct gzip_extra_header {
+	/** Extra field length (excluding this length field) */
+	uint16_t len;
+} __attribute__ (( packed ));
+
+/** A gzip header CRC16 */
+struct gzip_crc_header {
+	/** CRC16 */
+	uint16_t crc;
+} __attribute__ (( packed ));
+
+/** A gzip member trailer (RFC 1952) */
+struct gzip_trailer {
+	/** CRC32 of uncompressed data */
+	uint32_t crc;
+	/** Length of uncompressed data (modulo 2^32) */
+	uint32_t isize;
+} __attribute__ (( packed ));
+
+extern struct image_type gzip_image_type __image_type ( PROBE_NORMAL );
+
+#endif /* _IPXE_GZIP_H */
@@ -0,0 +1,99 @@
+#ifndef _IPXE_HANDOVER_H
+#define _IPXE_HANDOVER_H
+
+/** @file
+ *
+ * State handover to a chained iPXE
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <ipxe/tables.h>
+
+/** A state handover block header */
+struct handover_header {
+	/** Signature */
+	uint32_t magic;
+	/** Version */
+	uint16_t version;
+	/** Reserved */
+	uint8_t reserved[6];
+	/** Total length (including this header) */
+	uint32_t len;
+} __attribute__ (( packed ));
+
+/** State handover block signature */
+#define HANDOVER_MAGIC 0x4f485869UL /* "iXHO" */
+
+/** State handover block version
+ *
+ * Record formats are private to the providers that generate them.
+ * This version number must be incremented whenever any record
+ * format changes.
+ */
+#define HANDOVER_VERSION 1
+
+/** A state handover record */
+struct handover_record {
+	/** Type */
+	uint16_t type;
+	/** Reserved */
+	uint16_t reserved;
+	/** Length of data */
+	uint32_t len;
+	/** Data */
+	uint8_t data[0];
+} __attribute__ (( packed ));
+
+/** State handover record alignment */
+#define HANDOVER_ALIGN 8
+
+/** Neighbour cache state handover record */
+#define HANDOVER_NEIGHBOUR 0x0001
+
+/** DNS cache state handover record */
+#define HANDOVER_DNS 0x0002
+
+/** A state handover provider */
+struct handover_provider {
+	/** Name */
+	const char *name;
+	/** Record type */
+	unsigned int type;
+	/**
+	 * Save state
+	 *
+	 * @v data		Buffer to fill with state, or NULL
+	 * @v len		Length of buffer
+	 * @ret len		Length of state, or zero if no state exists
+	 *
+	 * No more than @c len bytes will be written to the buffer.
+	 * The returned length may exceed the buffer length, in which
+	 * case the caller should retry with a larger buffer.
+	 */
+	size_t ( * save ) ( void *data, size_t len );
+	/**
+	 * Restore state
+	 *
+	 * @v data		State
+	 * @v len		Length of state
+	 * @ret rc		Return status code
+	 *
+	 * The state will not remain valid after this call returns.
+	 */
+	int ( * restore ) ( const void *data, size_t len );
+};
+
+/** State handover provider table */
+#define HANDOVER_PROVIDERS \
+	__table ( struct handover_provider, "handover_providers" )
+
+/** Declare a state handover provider */
+#define __handover_provider __table_entry ( HANDOVER_PROVIDERS, 01 )
+
+extern int handover_save ( void **data, size_t *len );
+extern int handover_restore ( const void *data, size_t len );
+
+#endif /* _IPXE_HANDOVER_H */
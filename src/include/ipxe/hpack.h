@@ -0,0 +1,111 @@
+#ifndef _IPXE_HPACK_H
+#define _IPXE_HPACK_H
+
+/** @file
+ *
+ * HPACK header compression for HTTP/2
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <ipxe/list.h>
+
+/** Default maximum size of an HPACK dynamic table */
+#define HPACK_TABLE_SIZE 4096
+
+/** Overhead of each entry within an HPACK dynamic table
+ *
+ * RFC 7541 section 4.1 defines the size of an entry as the sum of
+ * the lengths of its name and value plus 32 bytes.
+ */
+#define HPACK_ENTRY_OVERHEAD 32
+
+/** Number of entries in the HPACK static table */
+#define HPACK_STATIC_COUNT 61
+
+/** HPACK indexed header field representation */
+#define HPACK_INDEXED 0x80
+
+/** HPACK literal header field with incremental indexing representation */
+#define HPACK_LITERAL_INDEXED 0x40
+
+/** HPACK dynamic table size update */
+#define HPACK_SIZE_UPDATE 0x20
+
+/** HPACK literal header field never indexed representation */
+#define HPACK_LITERAL_NEVER 0x10
+
+/** HPACK literal header field without indexing representation */
+#define HPACK_LITERAL 0x00
+
+/** HPACK Huffman-encoded string literal flag */
+#define HPACK_HUFFMAN 0x80
+
+/** Static table index of ":authority" */
+#define HPACK_AUTHORITY 1
+
+/** Static table index of ":method: GET" */
+#define HPACK_METHOD_GET 2
+
+/** Static table index of ":method: POST" */
+#define HPACK_METHOD_POST 3
+
+/** Static table index of ":method" */
+#define HPACK_METHOD HPACK_METHOD_GET
+
+/** Static table index of ":path" */
+#define HPACK_PATH 4
+
+/** Static table index of ":scheme: http" */
+#define HPACK_SCHEME_HTTP 6
+
+/** Static table index of ":scheme: https" */
+#define HPACK_SCHEME_HTTPS 7
+
+/** An HPACK dynamic table entry */
+struct hpack_entry {
+	/** List of entries (most recently added first) */
+	struct list_head list;
+	/** Size (as defined by RFC 7541) */
+	size_t size;
+	/** Name (NUL-terminated) */
+	char *name;
+	/** Value (NUL-terminated) */
+	char *value;
+};
+
+/** An HPACK dynamic table */
+struct hpack_table {
+	/** Entries (most recently added first) */
+	struct list_head entries;
+	/** Number of entries */
+	unsigned int count;
+	/** Current size */
+	size_t size;
+	/** Maximum size (as most recently set by the encoder) */
+	size_t max;
+	/** Limit on maximum size (as advertised to the encoder) */
+	size_t limit;
+};
+
+/**
+ * Handle decoded header field
+ *
+ * @v opaque		Opaque pointer
+ * @v name		Header name
+ * @v value		Header value
+ * @ret rc		Return status code
+ */
+typedef int ( * hpack_header_t ) ( void *opaque, const char *name,
+				   const char *value );
+
+extern void hpack_init ( struct hpack_table *table, size_t limit );
+extern void hpack_fini ( struct hpack_table *table );
+extern int hpack_decode ( struct hpack_table *table, const void *data,
+			  size_t len, hpack_header_t header, void *opaque );
+extern size_t hpack_encode ( void *data, unsigned int index,
+			     const char *name, const char *value );
+
+#endif /* _IPXE_HPACK_H */
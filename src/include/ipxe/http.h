@@ -44,11 +44,12 @@ struct http_scheme {
 	 *
 	 * @v xfer		Data transfer interface
 	 * @v name		Host name
+	 * @v port		Port
 	 * @v next		Next interface
 	 * @ret rc		Return status code
 	 */
 	int ( * filter ) ( struct interface *xfer, const char *name,
-			   struct interface **next );
+			   unsigned int port, struct interface **next );
 };
 
 /** HTTP scheme table */
@@ -87,8 +88,64 @@ struct http_connection {
 	struct interface xfer;
 	/** Pooled connection */
 	struct pooled_connection pool;
+	/** List of connections in use */
+	struct list_head list;
+	/** Flags */
+	unsigned int flags;
+	/** Pipelined requests awaiting their turn */
+	struct list_head pipeline;
+	/** Number of pipelined requests */
+	unsigned int pipelined;
+	/** Received data belonging to a subsequent response (if any) */
+	struct io_buffer *excess;
+};
+
+/** HTTP connection flags */
+enum http_connection_flags {
+	/** Request may be pipelined behind other requests */
+	HTTP_CONN_PIPELINE = 0x0001,
+	/** Request has been transmitted */
+	HTTP_CONN_SENT = 0x0002,
+	/** Server has agreed to keep the connection alive */
+	HTTP_CONN_PERSISTENT = 0x0004,
 };
 
+/** Maximum number of pipelined requests per connection */
+#define HTTP_CONN_PIPELINE_MAX 4
+
+/** Maximum length of a range request eligible for pipelining
+ *
+ * Pipelining is intended for the small block reads issued by a SAN
+ * device, for which the round-trip time dominates.  Large downloads
+ * gain nothing from pipelining and would merely delay the requests
+ * queued behind them.
+ */
+#define HTTP_PIPELINE_MAX_LEN ( 128 * 1024 )
+
+/** A pipelined HTTP request
+ *
+ * This represents a request waiting to be transmitted (or awaiting
+ * its response) on a connection that is still in use by an earlier
+ * request.
+ */
+struct http_pipelined_request {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** HTTP connection */
+	struct http_connection *conn;
+	/** List of pipelined requests */
+	struct list_head list;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Flags */
+	unsigned int flags;
+};
+
+extern int http_conn_pushback ( struct interface *intf,
+				struct io_buffer *iobuf );
+#define http_conn_pushback_TYPE( object_type ) \
+	typeof ( int ( object_type, struct io_buffer *iobuf ) )
+
 /******************************************************************************
  *
  * HTTP methods
@@ -150,6 +207,14 @@ struct http_request_content {
 	size_t len;
 };
 
+/** HTTP request conditional descriptor */
+struct http_request_conditional {
+	/** Entity tag to match via "If-None-Match" (if any) */
+	const char *etag;
+	/** Date to match via "If-Modified-Since" (if any) */
+	const char *modified;
+};
+
 /** HTTP request authentication descriptor */
 struct http_request_auth {
 	/** Authentication scheme (if any) */
@@ -188,6 +253,8 @@ struct http_request {
 	struct http_request_range range;
 	/** Content descriptor */
 	struct http_request_content content;
+	/** Conditional descriptor */
+	struct http_request_conditional conditional;
 	/** Authentication descriptor */
 	struct http_request_auth auth;
 };
@@ -283,6 +350,10 @@ struct http_response {
 	int rc;
 	/** Redirection location */
 	const char *location;
+	/** Entity tag (if any) */
+	const char *etag;
+	/** Last modification date (if any) */
+	const char *modified;
 	/** Transfer descriptor */
 	struct http_response_transfer transfer;
 	/** Content descriptor */
@@ -388,6 +459,8 @@ struct http_transaction {
 	size_t len;
 	/** Chunk length remaining */
 	size_t remaining;
+	/** Coalesced chunk data not yet delivered (if any) */
+	struct io_buffer *chunk;
 };
 
 /******************************************************************************
@@ -493,10 +566,25 @@ struct http_authentication {
  */
 
 extern char * http_token ( char **line, char **value );
-extern int http_connect ( struct interface *xfer, struct uri *uri );
+extern unsigned long http_conn_expiry ( void );
+extern int http_connect ( struct interface *xfer, struct uri *uri,
+			  unsigned int flags );
+extern int http2_connect ( struct interface *xfer, struct http_scheme *scheme,
+			   struct uri *uri, unsigned int port );
 extern int http_open ( struct interface *xfer, struct http_method *method,
 		       struct uri *uri, struct http_request_range *range,
-		       struct http_request_content *content );
+		       struct http_request_content *content,
+		       struct http_request_conditional *conditional );
 extern int http_open_uri ( struct interface *xfer, struct uri *uri );
+extern int http_etag ( struct interface *intf, const char *etag );
+#define http_etag_TYPE( object_type ) \
+	typeof ( int ( object_type, const char *etag ) )
+extern int http_last_modified ( struct interface *intf, const char *modified );
+#define http_last_modified_TYPE( object_type ) \
+	typeof ( int ( object_type, const char *modified ) )
+extern int http_not_modified ( struct interface *intf );
+#define http_not_modified_TYPE( object_type ) \
+	typeof ( int ( object_type ) )
+extern int httpmux_open ( struct interface *xfer, struct uri *uri );
 
 #endif /* _IPXE_HTTP_H */
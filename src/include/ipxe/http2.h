@@ -0,0 +1,315 @@
+#ifndef _IPXE_HTTP2_H
+#define _IPXE_HTTP2_H
+
+/** @file
+ *
+ * Hyper Text Transfer Protocol version 2 (HTTP/2)
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <ipxe/refcnt.h>
+#include <ipxe/interface.h>
+#include <ipxe/list.h>
+#include <ipxe/retry.h>
+#include <ipxe/hpack.h>
+
+/** HTTP/2 connection preface */
+#define HTTP2_PREFACE "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+
+/** HTTP/2 ALPN protocol list (in ALPN wire format) */
+#define HTTP2_ALPN "\x02" "h2" "\x08" "http/1.1"
+
+/** HTTP/2 ALPN protocol name */
+#define HTTP2_PROTOCOL "h2"
+
+/** An HTTP/2 frame header */
+struct http2_frame_header {
+	/** Length of payload (24-bit, big-endian) */
+	uint8_t len[3];
+	/** Type */
+	uint8_t type;
+	/** Flags */
+	uint8_t flags;
+	/** Stream identifier (high bit reserved) */
+	uint32_t stream;
+} __attribute__ (( packed ));
+
+/** HTTP/2 DATA frame */
+#define HTTP2_DATA 0x00
+
+/** HTTP/2 HEADERS frame */
+#define HTTP2_HEADERS 0x01
+
+/** HTTP/2 PRIORITY frame */
+#define HTTP2_PRIORITY 0x02
+
+/** HTTP/2 RST_STREAM frame */
+#define HTTP2_RST_STREAM 0x03
+
+/** HTTP/2 SETTINGS frame */
+#define HTTP2_SETTINGS 0x04
+
+/** HTTP/2 PUSH_PROMISE frame */
+#define HTTP2_PUSH_PROMISE 0x05
+
+/** HTTP/2 PING frame */
+#define HTTP2_PING 0x06
+
+/** HTTP/2 GOAWAY frame */
+#define HTTP2_GOAWAY 0x07
+
+/** HTTP/2 WINDOW_UPDATE frame */
+#define HTTP2_WINDOW_UPDATE 0x08
+
+/** HTTP/2 CONTINUATION frame */
+#define HTTP2_CONTINUATION 0x09
+
+/** HTTP/2 end of stream flag (DATA and HEADERS frames) */
+#define HTTP2_END_STREAM 0x01
+
+/** HTTP/2 acknowledgement flag (SETTINGS and PING frames) */
+#define HTTP2_ACK 0x01
+
+/** HTTP/2 end of header block flag (HEADERS and CONTINUATION frames) */
+#define HTTP2_END_HEADERS 0x04
+
+/** HTTP/2 padded flag (DATA and HEADERS frames) */
+#define HTTP2_PADDED 0x08
+
+/** HTTP/2 priority flag (HEADERS frames) */
+#define HTTP2_PRIORITY_FLAG 0x20
+
+/** Length of HTTP/2 HEADERS frame priority fields */
+#define HTTP2_PRIORITY_LEN 5
+
+/** Mask for HTTP/2 stream identifiers and window increments */
+#define HTTP2_ID_MASK 0x7fffffffUL
+
+/** An HTTP/2 setting */
+struct http2_setting {
+	/** Identifier */
+	uint16_t id;
+	/** Value */
+	uint32_t value;
+} __attribute__ (( packed ));
+
+/** HTTP/2 header table size setting */
+#define HTTP2_SETTINGS_HEADER_TABLE_SIZE 0x0001
+
+/** HTTP/2 server push setting */
+#define HTTP2_SETTINGS_ENABLE_PUSH 0x0002
+
+/** HTTP/2 maximum concurrent streams setting */
+#define HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS 0x0003
+
+/** HTTP/2 initial window size setting */
+#define HTTP2_SETTINGS_INITIAL_WINDOW_SIZE 0x0004
+
+/** HTTP/2 maximum frame size setting */
+#define HTTP2_SETTINGS_MAX_FRAME_SIZE 0x0005
+
+/** HTTP/2 client settings */
+struct http2_client_settings {
+	/** Disable server push */
+	struct http2_setting push;
+	/** Initial stream window size */
+	struct http2_setting window;
+} __attribute__ (( packed ));
+
+/** An HTTP/2 RST_STREAM frame payload */
+struct http2_rst_stream {
+	/** Error code */
+	uint32_t code;
+} __attribute__ (( packed ));
+
+/** An HTTP/2 GOAWAY frame payload */
+struct http2_goaway {
+	/** Last processed stream identifier */
+	uint32_t last;
+	/** Error code */
+	uint32_t code;
+} __attribute__ (( packed ));
+
+/** An HTTP/2 WINDOW_UPDATE frame payload */
+struct http2_window_update {
+	/** Window size increment */
+	uint32_t increment;
+} __attribute__ (( packed ));
+
+/** Length of HTTP/2 PING frame payload */
+#define HTTP2_PING_LEN 8
+
+/** HTTP/2 no error */
+#define HTTP2_NO_ERROR 0x0
+
+/** HTTP/2 protocol error */
+#define HTTP2_PROTOCOL_ERROR 0x1
+
+/** HTTP/2 internal error */
+#define HTTP2_INTERNAL_ERROR 0x2
+
+/** HTTP/2 flow control error */
+#define HTTP2_FLOW_CONTROL_ERROR 0x3
+
+/** HTTP/2 frame size error */
+#define HTTP2_FRAME_SIZE_ERROR 0x6
+
+/** HTTP/2 refused stream error */
+#define HTTP2_REFUSED_STREAM 0x7
+
+/** HTTP/2 cancel error */
+#define HTTP2_CANCEL 0x8
+
+/** HTTP/2 compression error */
+#define HTTP2_COMPRESSION_ERROR 0x9
+
+/** HTTP/2 maximum frame payload length
+ *
+ * This is the default maximum, which we never increase.  Since a
+ * server may not reduce its own maximum below this value, we use the
+ * same limit for transmitted frames.
+ */
+#define HTTP2_MAX_FRAME 16384
+
+/** HTTP/2 largest permitted maximum frame payload length */
+#define HTTP2_MAX_FRAME_LIMIT 16777215
+
+/** Maximum length of a received header block
+ *
+ * A header block may be split across any number of CONTINUATION
+ * frames, and must be reassembled before it can be decoded.
+ */
+#define HTTP2_MAX_BLOCK ( 64 * 1024 )
+
+/** HTTP/2 default initial window size */
+#define HTTP2_DEFAULT_WINDOW 65535
+
+/** HTTP/2 maximum window size */
+#define HTTP2_MAX_WINDOW 0x7fffffffL
+
+/** HTTP/2 receive window size
+ *
+ * This is applied to both the connection and to each stream.
+ * Received data is passed up immediately, and so the window needs to
+ * be large enough only to cover the bandwidth-delay product.
+ */
+#define HTTP2_WINDOW ( 1024 * 1024 )
+
+/** HTTP/2 default maximum number of concurrent streams
+ *
+ * The protocol places no limit until the server's SETTINGS frame
+ * says otherwise.  We assume a modest limit until then, to avoid
+ * having a burst of streams refused.
+ */
+#define HTTP2_DEFAULT_MAX_STREAMS 16
+
+/** An HTTP/2 connection */
+struct http2_connection {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Connection URI */
+	struct uri *uri;
+	/** Port */
+	unsigned int port;
+	/** Transport layer interface */
+	struct interface socket;
+	/** List of connections */
+	struct list_head list;
+	/** Streams */
+	struct list_head streams;
+	/** Flags */
+	unsigned int flags;
+	/** Idle timer */
+	struct retry_timer timer;
+
+	/** Next stream identifier */
+	uint32_t next_id;
+	/** Number of streams awaiting or receiving a response */
+	unsigned int active;
+	/** Maximum number of concurrent streams (as set by server) */
+	unsigned long max_streams;
+	/** Initial stream transmit window (as set by server) */
+	long initial_window;
+	/** Connection transmit window */
+	long tx_window;
+	/** Received data not yet reflected in the connection window */
+	size_t rx_consumed;
+
+	/** Header decompression table */
+	struct hpack_table hpack;
+	/** Partial header block (awaiting CONTINUATION frames) */
+	uint8_t *block;
+	/** Length of partial header block */
+	size_t block_len;
+	/** Stream identifier of partial header block */
+	uint32_t block_id;
+	/** Flags from HEADERS frame of partial header block */
+	unsigned int block_flags;
+
+	/** Length of received frame data */
+	size_t rx_len;
+	/** Received frame */
+	struct {
+		/** Frame header */
+		struct http2_frame_header hdr;
+		/** Payload */
+		uint8_t payload[HTTP2_MAX_FRAME];
+	} __attribute__ (( packed )) rx;
+};
+
+/** HTTP/2 connection flags */
+enum http2_connection_flags {
+	/** Connection preface has been sent */
+	HTTP2_CONN_READY = 0x0001,
+	/** No new streams may be created */
+	HTTP2_CONN_GOAWAY = 0x0002,
+	/** Connection has been closed */
+	HTTP2_CONN_CLOSED = 0x0004,
+};
+
+/** An HTTP/2 stream */
+struct http2_stream {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** HTTP/2 connection */
+	struct http2_connection *conn;
+	/** List of streams */
+	struct list_head list;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Stream identifier (or zero if not yet sent) */
+	uint32_t id;
+	/** Flags */
+	unsigned int flags;
+	/** Transmit window */
+	long tx_window;
+	/** Request body not yet transmitted (if any) */
+	struct io_buffer *body;
+	/** Received data not yet reflected in the stream window */
+	size_t rx_consumed;
+	/** Response header being constructed (if any) */
+	char *headers;
+	/** Length of response header being constructed */
+	size_t headers_len;
+};
+
+/** HTTP/2 stream flags */
+enum http2_stream_flags {
+	/** Request headers have been sent */
+	HTTP2_STREAM_SENT = 0x0001,
+	/** Request has been sent in its entirety */
+	HTTP2_STREAM_DONE = 0x0002,
+	/** Response headers have been received */
+	HTTP2_STREAM_RESPONSE = 0x0004,
+	/** Response has been received in its entirety */
+	HTTP2_STREAM_ENDED = 0x0008,
+	/** A regular (non-pseudo) header field has been received */
+	HTTP2_STREAM_REGULAR = 0x0010,
+	/** Response header being received is interim (1xx) */
+	HTTP2_STREAM_INTERIM = 0x0020,
+};
+
+#endif /* _IPXE_HTTP2_H */
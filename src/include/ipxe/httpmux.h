@@ -0,0 +1,66 @@
+#ifndef _IPXE_HTTPMUX_H
+#define _IPXE_HTTPMUX_H
+
+/** @file
+ *
+ * Hyper Text Transfer Protocol (HTTP) parallel range download multiplexer
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <ipxe/refcnt.h>
+#include <ipxe/interface.h>
+#include <ipxe/uri.h>
+
+/** Maximum number of concurrent connections */
+#define HTTPMUX_MAX_CONNECTIONS 8
+
+/** Minimum length of data to be downloaded over each connection
+ *
+ * Small files are not worth the overhead of additional connections.
+ */
+#define HTTPMUX_MIN_LEN ( 256 * 1024 )
+
+/** An HTTP multiplexed range download */
+struct http_multiplexed_range {
+	/** HTTP download multiplexer */
+	struct http_multiplexer *httpmux;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Starting offset within content */
+	size_t start;
+	/** Ending offset within content */
+	size_t end;
+	/** Current offset within content */
+	size_t pos;
+};
+
+/** An HTTP download multiplexer */
+struct http_multiplexer {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Primary download interface */
+	struct interface primary;
+	/** Original URI */
+	struct uri *uri;
+
+	/** Maximum number of concurrent connections */
+	unsigned int count;
+	/** Number of downloads in progress (including primary) */
+	unsigned int busy;
+	/** Total content length, or zero if not yet known */
+	size_t len;
+	/** Current offset within content of primary download */
+	size_t pos;
+	/** Ending offset of primary download, or zero if unlimited */
+	size_t limit;
+
+	/** Range downloads */
+	struct http_multiplexed_range range[ HTTPMUX_MAX_CONNECTIONS - 1 ];
+};
+
+#endif /* _IPXE_HTTPMUX_H */
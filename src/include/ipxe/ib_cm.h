@@ -29,6 +29,24 @@ struct ib_connection_operations {
 	void ( * changed ) ( struct ib_device *ibdev, struct ib_queue_pair *qp,
 			     struct ib_connection *conn, int rc,
 			     void *private_data, size_t private_data_len );
+	/** Accept incoming connection request
+	 *
+	 * @v ibdev		Infiniband device
+	 * @v conn		Connection
+	 * @v av		Address vector of remote queue pair
+	 * @v private_data	Connection request private data
+	 * @v private_data_len	Length of connection request private data
+	 * @ret qp		Queue pair, or NULL to reject connection
+	 *
+	 * This is required only for connections accepted via a
+	 * listener.  The returned queue pair must be a newly created
+	 * reliable connected queue pair.
+	 */
+	struct ib_queue_pair * ( * accept ) ( struct ib_device *ibdev,
+					      struct ib_connection *conn,
+					      struct ib_address_vector *av,
+					      void *private_data,
+					      size_t private_data_len );
 };
 
 /** An Infiniband connection */
@@ -54,12 +72,28 @@ struct ib_connection {
 	/** Connection request management transaction */
 	struct ib_mad_transaction *madx;
 
-	/** Length of connection request private data */
+	/** Length of connection request (or reply) private data */
 	size_t private_data_len;
-	/** Connection request private data */
+	/** Connection request (or reply) private data */
 	uint8_t private_data[0];
 };
 
+/** An Infiniband connection listener */
+struct ib_cm_listener {
+	/** Infiniband device */
+	struct ib_device *ibdev;
+	/** Service ID */
+	union ib_guid service_id;
+	/** Connection operations */
+	struct ib_connection_operations *op;
+	/** List of listeners */
+	struct list_head list;
+	/** Connection reply private data */
+	const void *private_data;
+	/** Length of connection reply private data */
+	size_t private_data_len;
+};
+
 extern struct ib_connection *
 ib_create_conn ( struct ib_device *ibdev, struct ib_queue_pair *qp,
 		 union ib_gid *dgid, union ib_guid *service_id,
@@ -68,5 +102,11 @@ ib_create_conn ( struct ib_device *ibdev, struct ib_queue_pair *qp,
 extern void ib_destroy_conn ( struct ib_device *ibdev,
 			      struct ib_queue_pair *qp,
 			      struct ib_connection *conn );
+extern void ib_cm_listen ( struct ib_device *ibdev,
+			   struct ib_cm_listener *listener,
+			   union ib_guid *service_id,
+			   const void *private_data, size_t private_data_len,
+			   struct ib_connection_operations *op );
+extern void ib_cm_unlisten ( struct ib_cm_listener *listener );
 
 #endif /* _IPXE_IB_CM_H */
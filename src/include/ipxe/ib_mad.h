@@ -423,6 +423,11 @@ struct ib_cm_connect_reject {
 	uint8_t private_data[148];
 } __attribute__ (( packed ));
 
+/** CM rejected message types */
+#define IB_CM_REJECT_MESSAGE_REQ	0
+#define IB_CM_REJECT_MESSAGE_REP	1
+#define IB_CM_REJECT_MESSAGE_OTHER	2
+
 /** CM rejection reasons */
 #define IB_CM_REJECT_BAD_SERVICE_ID	8
 #define IB_CM_REJECT_STALE_CONN		10
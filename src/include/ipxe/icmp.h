@@ -25,6 +25,16 @@ struct icmp_header {
 	uint16_t chksum;
 } __attribute__ (( packed ));
 
+/** An ICMP fragmentation needed message */
+struct icmp_frag_needed {
+	/** ICMP header */
+	struct icmp_header icmp;
+	/** Unused */
+	uint16_t unused;
+	/** Next-hop MTU (or zero if not reported) */
+	uint16_t mtu;
+} __attribute__ (( packed ));
+
 /** An ICMP echo request/reply */
 struct icmp_echo {
 	/** ICMPv6 header */
@@ -59,6 +69,8 @@ struct icmp_echo_protocol {
 #define __icmp_echo_protocol __table_entry ( ICMP_ECHO_PROTOCOLS, 01 )
 
 #define ICMP_ECHO_REPLY 0
+#define ICMP_DESTINATION_UNREACHABLE 3
+#define ICMP_FRAGMENTATION_NEEDED 4
 #define ICMP_ECHO_REQUEST 8
 
 extern int icmp_tx_echo_request ( struct io_buffer *iobuf,
@@ -46,6 +46,14 @@ struct icmpv6_handler {
 /** ICMPv6 packet too big */
 #define ICMPV6_PACKET_TOO_BIG 2
 
+/** An ICMPv6 packet too big message */
+struct icmpv6_packet_too_big {
+	/** ICMPv6 header */
+	struct icmp_header icmp;
+	/** MTU */
+	uint32_t mtu;
+} __attribute__ (( packed ));
+
 /** ICMPv6 time exceeded */
 #define ICMPV6_TIME_EXCEEDED 3
 
@@ -19,6 +19,10 @@ struct uri;
 struct pixel_buffer;
 struct asn1_cursor;
 struct image_type;
+struct digest_algorithm;
+
+/** Maximum length of a precomputed image digest (sufficient for SHA-512) */
+#define IMAGE_DIGEST_MAX_LEN 64
 
 /** An executable image */
 struct image {
@@ -41,6 +45,15 @@ struct image {
 	userptr_t data;
 	/** Length of raw file image */
 	size_t len;
+	/** Algorithm of precomputed digest of raw file image, if any
+	 *
+	 * This is set only if the digest was calculated as the image
+	 * was downloaded, and allows signature verification to avoid
+	 * making a second pass over the image data.
+	 */
+	struct digest_algorithm *digest;
+	/** Precomputed digest of raw file image */
+	uint8_t digest_value[IMAGE_DIGEST_MAX_LEN];
 
 	/** Image type, if known */
 	struct image_type *type;
@@ -113,6 +126,17 @@ struct image_type {
 	 */
 	int ( * asn1 ) ( struct image *image, size_t offset,
 			 struct asn1_cursor **cursor );
+	/**
+	 * Extract archive image
+	 *
+	 * @v image		Image
+	 * @v extracted		Extracted image to fill in
+	 * @ret rc		Return status code
+	 *
+	 * The method must fill in the extracted image's data and
+	 * length.  The data will eventually be freed using ufree().
+	 */
+	int ( * extract ) ( struct image *image, struct image *extracted );
 };
 
 /**
@@ -183,9 +207,14 @@ extern int image_replace ( struct image *replacement );
 extern int image_select ( struct image *image );
 extern struct image * image_find_selected ( void );
 extern int image_set_trust ( int require_trusted, int permanent );
+extern void image_digest ( struct image *image,
+			   struct digest_algorithm *digest, void *out );
 extern int image_pixbuf ( struct image *image, struct pixel_buffer **pixbuf );
 extern int image_asn1 ( struct image *image, size_t offset,
 			struct asn1_cursor **cursor );
+extern int image_extract ( struct image *image, const char *name,
+			   struct image **extracted );
+extern int image_extract_exec ( struct image *image );
 
 /**
  * Increment reference count on an image
@@ -105,6 +105,18 @@ struct interface_descriptor {
 		.passthru_offset = 0,					      \
 	}
 
+/** A cached object interface operation lookup */
+struct interface_cache {
+	/** Lookup generation (or zero if nothing is cached) */
+	unsigned long generation;
+	/** Operation type */
+	void *type;
+	/** Implementing method (or NULL) */
+	void *func;
+	/** Destination object interface */
+	struct interface *dest;
+};
+
 /** An object interface */
 struct interface {
 	/** Destination object interface
@@ -129,8 +141,30 @@ struct interface {
 	 * Used by intf_reinit().
 	 */
 	struct interface_descriptor *original;
+	/** Most recent operation lookup
+	 *
+	 * This is valid only if no interface has been plugged,
+	 * unplugged, or had its descriptor changed since the lookup
+	 * was performed.
+	 */
+	struct interface_cache cache;
 };
 
+extern unsigned long intf_generation;
+
+/**
+ * Invalidate all cached object interface operation lookups
+ *
+ * This must be called after any change to an interface's destination
+ * or descriptor.
+ */
+static inline void intf_invalidate ( void ) {
+
+	/* Skip zero, which marks an empty cache */
+	if ( ! ++intf_generation )
+		intf_generation++;
+}
+
 extern void intf_plug ( struct interface *intf, struct interface *dest );
 extern void intf_plug_plug ( struct interface *a, struct interface *b );
 extern void intf_unplug ( struct interface *intf );
@@ -177,6 +211,7 @@ static inline void intf_init ( struct interface *intf,
 	intf->refcnt = refcnt;
 	intf->desc = desc;
 	intf->original = desc;
+	intf->cache.generation = 0;
 }
 
 /**
@@ -257,6 +292,7 @@ static inline void intf_reinit ( struct interface *intf ) {
 
 	/* Restore original interface descriptor */
 	intf->desc = intf->original;
+	intf_invalidate();
 }
 
 #endif /* _IPXE_INTERFACE_H */
@@ -22,6 +22,12 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 #define IOB_ZLEN 64
 
+/** Maximum number of distinct receive buffer lengths to be pooled */
+#define IOB_POOL_COUNT 4
+
+/** Maximum number of free I/O buffers held in each receive buffer pool */
+#define IOB_POOL_MAX 64
+
 /**
  * A persistent I/O buffer
  *
@@ -46,8 +52,86 @@ struct io_buffer {
 	void *tail;
 	/** End of the buffer */
         void *end;
+
+	/** Flags */
+	unsigned int flags;
+	/** Offset to start of transport-layer checksummed data
+	 *
+	 * This is relative to the start of the buffer, and is valid
+	 * only if @c IOB_FL_CSUM_OFFLOAD is set.
+	 */
+	uint16_t csum_start;
+	/** Offset to transport-layer checksum field
+	 *
+	 * This is relative to the start of the checksummed data, and
+	 * is valid only if @c IOB_FL_CSUM_OFFLOAD is set.
+	 */
+	uint16_t csum_offset;
+	/** Maximum segment payload length
+	 *
+	 * This is valid only if @c IOB_FL_TSO4 or @c IOB_FL_TSO6 is
+	 * set.
+	 */
+	uint16_t mss;
+	/** VLAN tag control information
+	 *
+	 * This is valid only if @c IOB_FL_VLAN is set.
+	 */
+	uint16_t vlan_tci;
+};
+
+/** I/O buffer flags */
+enum io_buffer_flags {
+	/** Transport-layer checksum has been verified by hardware */
+	IOB_FL_CSUM_VERIFIED = 0x0001,
+	/** Transport-layer checksum has not yet been calculated
+	 *
+	 * The transport layer sets this flag (and leaves the checksum
+	 * field zeroed) to delegate calculation of the checksum to
+	 * the network layer, which may in turn delegate it to the
+	 * network device.
+	 */
+	IOB_FL_CSUM_PENDING = 0x0002,
+	/** Transport-layer checksum must be calculated by hardware
+	 *
+	 * The checksum field holds the (non-inverted) pseudo-header
+	 * checksum.  The network device must calculate the checksum
+	 * over the data starting at @c csum_start and place it in
+	 * the field at @c csum_offset.
+	 */
+	IOB_FL_CSUM_OFFLOAD = 0x0004,
+	/** TCP/IPv4 segment must be segmented by hardware
+	 *
+	 * The network device must split the payload into segments
+	 * of at most @c mss bytes, replicating the link-layer,
+	 * network-layer and TCP headers for each segment.  This
+	 * flag is valid only in combination with @c
+	 * IOB_FL_CSUM_OFFLOAD.
+	 */
+	IOB_FL_TSO4 = 0x0008,
+	/** TCP/IPv6 segment must be segmented by hardware
+	 *
+	 * As for @c IOB_FL_TSO4, but for TCP over IPv6.
+	 */
+	IOB_FL_TSO6 = 0x0010,
+	/** Network-layer datagram must not be fragmented
+	 *
+	 * The transport layer sets this flag to request that the
+	 * network layer mark the datagram as non-fragmentable, in
+	 * order to receive feedback for path MTU discovery.
+	 */
+	IOB_FL_DONTFRAG = 0x0020,
+	/** VLAN tag must be inserted by hardware
+	 *
+	 * The network device must insert an 802.1Q header carrying
+	 * the tag control information @c vlan_tci.
+	 */
+	IOB_FL_VLAN = 0x0040,
 };
 
+/** I/O buffer requires TCP segmentation offload */
+#define IOB_FL_TSO ( IOB_FL_TSO4 | IOB_FL_TSO6 )
+
 /**
  * Reserve space at start of I/O buffer
  *
@@ -188,6 +272,17 @@ static inline void iob_populate ( struct io_buffer *iobuf,
 	iobuf->head = iobuf->data = data;
 	iobuf->tail = ( data + len );
 	iobuf->end = ( data + max_len );
+	iobuf->flags = 0;
+}
+
+/**
+ * Get offset to start of transport-layer checksummed data
+ *
+ * @v iobuf	I/O buffer
+ * @ret offset	Offset from start of data
+ */
+static inline size_t iob_csum_start ( struct io_buffer *iobuf ) {
+	return ( iobuf->head + iobuf->csum_start - iobuf->data );
 }
 
 /**
@@ -213,6 +308,7 @@ static inline void iob_populate ( struct io_buffer *iobuf,
 extern struct io_buffer * __malloc alloc_iob_raw ( size_t len, size_t align,
 						   size_t offset );
 extern struct io_buffer * __malloc alloc_iob ( size_t len );
+extern struct io_buffer * __malloc alloc_rx_iob ( size_t len );
 extern void free_iob ( struct io_buffer *iobuf );
 extern void iob_pad ( struct io_buffer *iobuf, size_t min_len );
 extern int iob_ensure_headroom ( struct io_buffer *iobuf, size_t len );
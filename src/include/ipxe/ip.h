@@ -54,6 +54,12 @@ struct ipv4_pseudo_header {
 	uint16_t len;
 };
 
+/** Number of IPv4 route cache entries
+ *
+ * Must be a power of two.
+ */
+#define IPV4_ROUTE_CACHE_SIZE 8
+
 /** An IPv4 address/routing table entry */
 struct ipv4_miniroute {
 	/** List of miniroutes */
@@ -74,6 +80,7 @@ extern struct list_head ipv4_miniroutes;
 
 extern struct net_protocol ipv4_protocol __net_protocol;
 
+extern void ipv4_route_flush ( void );
 extern int ipv4_has_any_addr ( struct net_device *netdev );
 extern int parse_ipv4_setting ( const struct setting_type *type,
 				const char *value, void *buf, size_t len );
@@ -26,6 +26,9 @@ struct ipoib_mac {
 	union ib_gid gid;
 } __attribute__ (( packed ));
 
+/** IPoIB MAC address "connected mode" flag */
+#define IPOIB_MAC_FLAG_CM 0x80000000UL
+
 /** IPoIB link-layer header length */
 #define IPOIB_HLEN 4
 
@@ -37,6 +40,21 @@ struct ipoib_hdr {
 	uint16_t reserved;
 } __attribute__ (( packed ));
 
+/** IPoIB connected mode service ID (high dword)
+ *
+ * RFC 4755 defines the connected mode service ID as this value in
+ * the upper dword and the UD queue pair number in the lower dword.
+ */
+#define IPOIB_CM_SERVICE_ID_HIGH 0x10000000UL
+
+/** IPoIB connected mode connection request and reply private data */
+struct ipoib_cm_data {
+	/** UD queue pair number */
+	uint32_t qpn;
+	/** Maximum received packet length (including IPoIB header) */
+	uint32_t mtu;
+} __attribute__ (( packed ));
+
 /** GUID mask used for constructing eIPoIB Local Ethernet MAC address (LEMAC) */
 #define IPOIB_GUID_MASK 0xe7
 
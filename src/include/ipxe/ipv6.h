@@ -288,6 +288,12 @@ enum ipv6_settings_order {
 	IPV6_ORDER_DHCPV6 = -1,
 };
 
+/** Number of IPv6 route cache entries
+ *
+ * Must be a power of two.
+ */
+#define IPV6_ROUTE_CACHE_SIZE 8
+
 /** IPv6 link-local address settings block name */
 #define IPV6_SETTINGS_NAME "link"
 
@@ -295,6 +301,7 @@ extern struct list_head ipv6_miniroutes;
 
 extern struct net_protocol ipv6_protocol __net_protocol;
 
+extern void ipv6_route_flush ( void );
 extern int ipv6_has_addr ( struct net_device *netdev, struct in6_addr *addr );
 extern int ipv6_add_miniroute ( struct net_device *netdev,
 				struct in6_addr *address,
@@ -20,6 +20,34 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Default iSCSI port */
 #define ISCSI_PORT 3260
 
+/** Default MaxRecvDataSegmentLength (as defined by RFC 7143) */
+#define ISCSI_DEFAULT_MAX_RECV_LEN 8192
+
+/** Default FirstBurstLength (as defined by RFC 7143) */
+#define ISCSI_DEFAULT_FIRST_BURST_LEN 65536
+
+/** Default MaxBurstLength (as defined by RFC 7143) */
+#define ISCSI_DEFAULT_MAX_BURST_LEN 262144
+
+/** MaxRecvDataSegmentLength that we declare, unless overridden */
+#define ISCSI_MAX_RECV_LEN 262144
+
+/** MaxBurstLength that we propose, unless overridden */
+#define ISCSI_MAX_BURST_LEN ( 1024 * 1024 )
+
+/** Minimum permitted data segment length */
+#define ISCSI_MIN_DATA_LEN 512
+
+/** Maximum permitted data segment or burst length */
+#define ISCSI_MAX_DATA_LEN 0xffffff
+
+/** Maximum length of a Data-Out PDU that we will construct
+ *
+ * This limits the size of each transmit I/O buffer, regardless of
+ * the target's MaxRecvDataSegmentLength.
+ */
+#define ISCSI_MAX_DATA_OUT_LEN 65536
+
 /**
  * iSCSI segment lengths
  *
@@ -523,10 +551,14 @@ enum iscsi_rx_state {
 	ISCSI_RX_BHS = 0,
 	/** Receiving the additional header segment */
 	ISCSI_RX_AHS,
+	/** Receiving the header digest */
+	ISCSI_RX_HEADER_DIGEST,
 	/** Receiving the data segment */
 	ISCSI_RX_DATA,
 	/** Receiving the data segment padding */
 	ISCSI_RX_DATA_PADDING,
+	/** Receiving the data digest */
+	ISCSI_RX_DATA_DIGEST,
 };
 
 /** An iSCSI session */
@@ -605,6 +637,37 @@ struct iscsi_session {
 	 * PDUs in response to an R2T.
 	 */
 	uint32_t transfer_len;
+	/** Deferred R2T, if any
+	 *
+	 * An R2T may arrive while we are still transmitting
+	 * unsolicited data-out PDUs.  Its transfer is started once
+	 * the current sequence is complete.
+	 */
+	struct {
+		/** Target transfer tag */
+		uint32_t ttt;
+		/** Transfer offset */
+		uint32_t offset;
+		/** Transfer length (or zero if no R2T is deferred) */
+		uint32_t len;
+	} r2t;
+
+	/** Maximum data segment length that we are able to receive */
+	size_t max_recv_len;
+	/** Maximum data segment length that the target is able to receive */
+	size_t target_max_recv_len;
+	/** Maximum length of a solicited or data-in sequence that we offer */
+	size_t local_max_burst_len;
+	/** Maximum length of a solicited or data-in sequence */
+	size_t max_burst_len;
+	/** Maximum length of unsolicited data (including immediate data) */
+	size_t first_burst_len;
+	/** Negotiated data transfer options
+	 *
+	 * This is the bitwise-OR of zero or more ISCSI_OPT_XXX
+	 * constants.
+	 */
+	unsigned int options;
 	/** Command sequence number
 	 *
 	 * This is the sequence number of the current command, used to
@@ -639,6 +702,16 @@ struct iscsi_session {
 	size_t rx_len;
 	/** Buffer for received data (not always used) */
 	void *rx_buffer;
+	/** Digests present in the current RX PDU
+	 *
+	 * This is the bitwise-OR of zero or more of
+	 * ISCSI_OPT_HEADER_DIGEST and ISCSI_OPT_DATA_DIGEST.
+	 */
+	unsigned int rx_digests;
+	/** Running CRC32C of the current RX header or data segment */
+	uint32_t rx_crc;
+	/** Received digest */
+	uint32_t rx_digest;
 
 	/** Current SCSI command, if any */
 	struct scsi_cmd *command;
@@ -694,6 +767,18 @@ struct iscsi_session {
 /** Target authenticated itself correctly */
 #define ISCSI_STATUS_AUTH_REVERSE_OK 0x00040000
 
+/** Target accepts immediate data (ImmediateData=Yes) */
+#define ISCSI_OPT_IMMEDIATE_DATA 0x0001
+
+/** Target accepts unsolicited data-out PDUs (InitialR2T=No) */
+#define ISCSI_OPT_UNSOLICITED_DATA 0x0002
+
+/** Target selected CRC32C header digests (HeaderDigest=CRC32C) */
+#define ISCSI_OPT_HEADER_DIGEST 0x0004
+
+/** Target selected CRC32C data digests (DataDigest=CRC32C) */
+#define ISCSI_OPT_DATA_DIGEST 0x0008
+
 /** Default initiator IQN prefix */
 #define ISCSI_DEFAULT_IQN_PREFIX "iqn.2010-04.org.ipxe"
 
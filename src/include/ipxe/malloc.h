@@ -21,12 +21,48 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/tables.h>
 #include <valgrind/memcheck.h>
 
+/** Number of free block size classes
+ *
+ * Size class @c n contains free blocks with sizes in the range
+ * [2^n,2^(n+1)).
+ */
+#define MEMBLOCK_BINS ( 8 * sizeof ( unsigned long ) )
+
+/** Free memory block statistics */
+struct memblock_stats {
+	/** Number of free blocks within each size class */
+	unsigned int count[MEMBLOCK_BINS];
+	/** Total size of free blocks within each size class */
+	size_t size[MEMBLOCK_BINS];
+	/** Size of largest free block */
+	size_t largest;
+};
+
+/** An allocation call site (when allocation profiling is enabled) */
+struct malloc_site {
+	/** Caller address (or NULL if this entry is unused) */
+	void *caller;
+	/** Number of allocations */
+	unsigned long count;
+	/** Total number of bytes ever allocated */
+	unsigned long total;
+	/** Number of bytes currently allocated */
+	size_t used;
+	/** Maximum number of bytes simultaneously allocated */
+	size_t max;
+};
+
 extern size_t freemem;
+extern size_t heapmem;
+extern size_t maxusedmem;
+extern unsigned long memblock_allocs;
 
 extern void * __malloc alloc_memblock ( size_t size, size_t align,
 					size_t offset );
 extern void free_memblock ( void *ptr, size_t size );
 extern void mpopulate ( void *start, size_t len );
+extern void memblock_stats ( struct memblock_stats *stats );
+extern struct malloc_site * malloc_site ( unsigned int index );
 extern void mdumpfree ( void );
 
 /**
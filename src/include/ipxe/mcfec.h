@@ -0,0 +1,69 @@
+#ifndef _IPXE_MCFEC_H
+#define _IPXE_MCFEC_H
+
+/** @file
+ *
+ * Multicast file transfer with forward error correction
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <ipxe/timer.h>
+
+/** Default multicast port */
+#define MCFEC_DEFAULT_PORT 10002
+
+/** Protocol version */
+#define MCFEC_VERSION 1
+
+/** A multicast FEC packet header
+ *
+ * All fields are in network byte order.
+ */
+struct mcfec_header {
+	/** Protocol version */
+	uint8_t version;
+	/** Number of source symbols per source block
+	 *
+	 * The final source block may contain fewer source symbols.
+	 */
+	uint8_t k;
+	/** Encoding symbol index within source block
+	 *
+	 * Indices below the number of source symbols in the block
+	 * identify source symbols; higher indices identify repair
+	 * symbols.
+	 */
+	uint8_t index;
+	/** Reserved (must be zero) */
+	uint8_t reserved;
+	/** Session identifier */
+	uint32_t session;
+	/** Total length of file */
+	uint64_t len;
+	/** Source block number */
+	uint32_t block;
+	/** Symbol length */
+	uint16_t symbol_len;
+	/** Reserved (must be zero) */
+	uint16_t reserved2;
+} __attribute__ (( packed ));
+
+/** Maximum number of source blocks received concurrently
+ *
+ * A server will normally transmit all symbols for one source block
+ * before moving on to the next, but may choose to interleave a small
+ * number of blocks to protect against burst losses.
+ */
+#define MCFEC_MAX_BLOCKS 4
+
+/** Idle timeout
+ *
+ * The transfer is abandoned if no packets are received for this
+ * long.
+ */
+#define MCFEC_TIMEOUT ( 10 * TICKS_PER_SEC )
+
+#endif /* _IPXE_MCFEC_H */
@@ -33,12 +33,21 @@ struct neighbour_discovery {
 			       const void *net_dest, const void *net_source );
 };
 
+/** Number of neighbour cache hash buckets
+ *
+ * Neighbour cache entries are hashed by network-layer destination
+ * address.  Must be a power of two.
+ */
+#define NEIGHBOUR_HASH_BUCKETS 16
+
 /** A neighbour cache entry */
 struct neighbour {
 	/** Reference count */
 	struct refcnt refcnt;
 	/** List of neighbour cache entries */
 	struct list_head list;
+	/** List of neighbour cache entries within the same hash bucket */
+	struct list_head hash;
 
 	/** Network device */
 	struct net_device *netdev;
@@ -289,6 +289,10 @@ struct net_device_stats {
 	unsigned int good;
 	/** Count of error completions */
 	unsigned int bad;
+	/** Count of ring overflows (all posted buffers consumed) */
+	unsigned int overflow;
+	/** Total length of successful completions */
+	unsigned long bytes;
 	/** Error breakdowns */
 	struct net_device_error errors[NETDEV_MAX_UNIQUE_ERRORS];
 };
@@ -407,6 +411,13 @@ struct net_device {
 	 * link-layer headers) configured for the link.
 	 */
 	size_t mtu;
+	/** Additional transmit headroom
+	 *
+	 * This is the headroom (in addition to the link-layer header)
+	 * required in front of each transmitted packet, such as a USB
+	 * device's transfer header.
+	 */
+	size_t tx_headroom;
 	/** TX packet queue */
 	struct list_head tx_queue;
 	/** Deferred TX packet queue */
@@ -417,6 +428,8 @@ struct net_device {
 	struct net_device_stats tx_stats;
 	/** RX statistics */
 	struct net_device_stats rx_stats;
+	/** Time at which device was last opened (in ticks) */
+	unsigned long opened;
 
 	/** Configuration settings applicable to this device */
 	struct generic_settings settings;
@@ -445,6 +458,70 @@ struct net_device {
  */
 #define NETDEV_IRQ_UNSUPPORTED 0x0008
 
+/** Network device can calculate transport-layer transmit checksums
+ *
+ * This flag can be used by a network device to indicate that it is
+ * able to handle transmitted I/O buffers marked with
+ * @c IOB_FL_CSUM_OFFLOAD.
+ */
+#define NETDEV_TX_CSUM 0x0010
+
+/** Network device can verify transport-layer receive checksums
+ *
+ * This flag can be used by a network device to indicate that it may
+ * mark received I/O buffers with @c IOB_FL_CSUM_VERIFIED.
+ */
+#define NETDEV_RX_CSUM 0x0020
+
+/** Network device can perform TCP/IPv4 segmentation offload
+ *
+ * This flag can be used by a network device that also advertises
+ * @c NETDEV_TX_CSUM to indicate that it is able to handle
+ * transmitted I/O buffers marked with @c IOB_FL_TSO4.
+ */
+#define NETDEV_TX_TSO4 0x0040
+
+/** Network device can perform TCP/IPv6 segmentation offload
+ *
+ * This flag can be used by a network device that also advertises
+ * @c NETDEV_TX_CSUM to indicate that it is able to handle
+ * transmitted I/O buffers marked with @c IOB_FL_TSO6.
+ */
+#define NETDEV_TX_TSO6 0x0080
+
+/** Network device can insert VLAN tags
+ *
+ * This flag can be used by a network device to indicate that it is
+ * able to handle transmitted I/O buffers marked with @c IOB_FL_VLAN.
+ */
+#define NETDEV_TX_VLAN 0x0100
+
+/** Network device can strip VLAN tags
+ *
+ * This flag can be used by a network device to indicate that it may
+ * strip the VLAN tags from received packets, and will deliver such
+ * packets via vlan_netdev_rx().
+ */
+#define NETDEV_RX_VLAN 0x0200
+
+/** Network device receive budget
+ *
+ * This is the maximum number of packets that will be received from
+ * a network device (by repeatedly polling the device) before the
+ * received packets are processed.
+ */
+#define NETDEV_RX_BUDGET 64
+
+/** Networking stack process scheduling weight
+ *
+ * This is the number of consecutive scheduler steps given to the
+ * networking stack process in each turn, so that received packets
+ * continue to be drained promptly while many other processes are
+ * running.  The remainder of the turn is given up as soon as a step
+ * finds no packets to process.
+ */
+#define NET_PROCESS_WEIGHT 4
+
 /** Link-layer protocol table */
 #define LL_PROTOCOLS __table ( struct ll_protocol, "ll_protocols" )
 
@@ -706,6 +783,12 @@ extern void netdev_rx ( struct net_device *netdev, struct io_buffer *iobuf );
 extern void netdev_rx_err ( struct net_device *netdev,
 			    struct io_buffer *iobuf, int rc );
 extern void netdev_poll ( struct net_device *netdev );
+/* Drivers size their receive rings for the hardware maximum, and
+ * post only as many receive buffers as netdev_rx_fill() returns (as
+ * chosen at runtime via the "rxfill" setting and free memory).
+ */
+extern unsigned int netdev_rx_fill ( struct net_device *netdev,
+				     unsigned int max, size_t len );
 extern struct io_buffer * netdev_rx_dequeue ( struct net_device *netdev );
 extern struct net_device * alloc_netdev ( size_t priv_size );
 extern int register_netdev ( struct net_device *netdev );
@@ -727,6 +810,7 @@ extern int net_rx ( struct io_buffer *iobuf, struct net_device *netdev,
 		    uint16_t net_proto, const void *ll_dest,
 		    const void *ll_source, unsigned int flags );
 extern void net_poll ( void );
+extern void net_nap ( void );
 extern struct net_device_configurator *
 find_netdev_configurator ( const char *name );
 extern int netdev_configure ( struct net_device *netdev,
@@ -769,4 +853,18 @@ netdev_link_up ( struct net_device *netdev ) {
 	netdev_link_err ( netdev, 0 );
 }
 
+/**
+ * Record receive ring overflow
+ *
+ * @v netdev		Network device
+ *
+ * Drivers should call this when a single poll finds that every
+ * posted receive buffer has been consumed, since the hardware is then
+ * likely to have dropped packets for lack of buffers.
+ */
+static inline __attribute__ (( always_inline )) void
+netdev_rx_overflow ( struct net_device *netdev ) {
+	netdev->rx_stats.overflow++;
+}
+
 #endif /* _IPXE_NETDEVICE_H */
@@ -105,5 +105,7 @@ struct ntp_header {
 #define NTP_MAX_TIMEOUT ( 10 * TICKS_PER_SEC )
 
 extern int start_ntp ( struct interface *job, const char *hostname );
+extern int start_ntp_sync ( struct interface *job, char **hostnames,
+			    unsigned int count );
 
 #endif /* _IPXE_NTP_H */
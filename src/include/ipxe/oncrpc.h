@@ -22,6 +22,10 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** ONC RPC System Authentication (also called UNIX Authentication) */
 #define ONCRPC_AUTH_SYS  1
 
+/** Set most significant bit to 1. */
+#define SET_LAST_FRAME( x ) ( (x) | 1 << 31 )
+#define GET_FRAME_SIZE( x ) ( (x) & ~( 1 << 31 ) )
+
 /** Size of an ONC RPC header */
 #define ONCRPC_HEADER_SIZE ( 11 * sizeof ( uint32_t ) )
 
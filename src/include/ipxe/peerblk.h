@@ -17,6 +17,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/xferbuf.h>
 #include <ipxe/retry.h>
 #include <ipxe/process.h>
+#include <ipxe/bitmap.h>
 #include <ipxe/pccrc.h>
 #include <ipxe/peerdisc.h>
 
@@ -106,11 +107,15 @@ struct peerdist_block {
 	size_t cipher_remaining;
 	/** Remaining digest length (excluding AES padding bytes) */
 	size_t digest_remaining;
+	/** Decryption chunk buffer (dynamically allocated as needed) */
+	void *chunk;
 
 	/** Discovery client */
 	struct peerdisc_client discovery;
 	/** Current position in discovered peer list */
 	struct peerdisc_peer *peer;
+	/** Peers attempted during current attempt cycle */
+	struct bitmap tried;
 	/** Retry timer */
 	struct retry_timer timer;
 	/** Number of full attempt cycles completed */
@@ -122,6 +127,10 @@ struct peerdist_block {
 	unsigned long started;
 	/** Time at which most recent attempt was started */
 	unsigned long attempted;
+	/** Time at which current retrieval request was issued */
+	unsigned long requested;
+	/** Response time for current retrieval request (in ticks) */
+	unsigned long rtt;
 };
 
 /** Retrieval protocol block fetch response (including transport header)
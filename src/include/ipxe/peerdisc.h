@@ -71,6 +71,14 @@ struct peerdisc_segment {
 struct peerdisc_peer {
 	/** List of peers */
 	struct list_head list;
+	/** Index within list of peers */
+	unsigned int index;
+	/** Smoothed response time (in ticks) */
+	unsigned long rtt;
+	/** Smoothed throughput (in bytes per tick, or zero if unmeasured) */
+	unsigned long rate;
+	/** Number of consecutive failed download attempts */
+	unsigned int failures;
 	/** Peer location */
 	char location[0];
 };
@@ -107,10 +115,29 @@ peerdisc_init ( struct peerdisc_client *peerdisc,
 	peerdisc->op = op;
 }
 
+/**
+ * Estimate time required to retrieve data from PeerDist peer
+ *
+ * @v peer		PeerDist discovery peer
+ * @v len		Length of data
+ * @ret cost		Estimated time (in ticks), or zero if unmeasured
+ */
+static inline __attribute__ (( always_inline )) unsigned long
+peerdisc_cost ( struct peerdisc_peer *peer, size_t len ) {
+
+	if ( ! peer->rate )
+		return 0;
+	return ( peer->rtt + ( len / peer->rate ) );
+}
+
 extern unsigned int peerdisc_timeout_secs;
 
 extern int peerdisc_open ( struct peerdisc_client *peerdisc, const void *id,
 			   size_t len );
 extern void peerdisc_close ( struct peerdisc_client *peerdisc );
+extern unsigned int peerdisc_count ( const void *id, size_t len );
+extern void peerdisc_succeeded ( struct peerdisc_peer *peer, unsigned long rtt,
+				 unsigned long rate );
+extern void peerdisc_failed ( struct peerdisc_peer *peer );
 
 #endif /* _IPXE_PEERDISC_H */
@@ -19,7 +19,17 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/pccrc.h>
 
 /** Maximum number of concurrent block downloads */
-#define PEERMUX_MAX_BLOCKS 32
+#define PEERMUX_MAX_BLOCKS 256
+
+/** Minimum number of concurrent block downloads */
+#define PEERMUX_MIN_BLOCKS 4
+
+/** Number of concurrent block downloads permitted per source
+ *
+ * The origin server counts as one source, and each discovered peer
+ * counts as an additional source.
+ */
+#define PEERMUX_BLOCKS_PER_SOURCE 32
 
 /** PeerDist download content information cache */
 struct peerdist_info_cache {
@@ -63,8 +73,21 @@ struct peerdist_multiplexer {
 	struct list_head busy;
 	/** List of idle block downloads */
 	struct list_head idle;
-	/** Block downloads */
-	struct peerdist_multiplexed_block block[PEERMUX_MAX_BLOCKS];
+	/** Number of busy block downloads */
+	unsigned int active;
+	/** Maximum number of concurrent block downloads */
+	unsigned int limit;
+	/** Maximum number of peers discovered for any segment */
+	unsigned int peers;
+
+	/** Start time of current throughput measurement */
+	unsigned long started;
+	/** Length of data received during current measurement */
+	size_t len;
+	/** Number of blocks completed during current measurement */
+	unsigned int completed;
+	/** Throughput of previous measurement (in bytes per tick) */
+	unsigned long rate;
 };
 
 extern int peermux_filter ( struct interface *xfer, struct interface *info,
@@ -0,0 +1,35 @@
+#ifndef _IPXE_PEERSERV_H
+#define _IPXE_PEERSERV_H
+
+/** @file
+ *
+ * Peer Content Caching and Retrieval (PeerDist) protocol content server
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <ipxe/pccrc.h>
+
+/** PeerDist retrieval server port */
+#define PEERSERV_PORT 80
+
+/** Maximum number of served content information entries
+ *
+ * Once this limit is reached, the least recently downloaded content
+ * will no longer be served.
+ */
+#define PEERSERV_MAX_CONTENT 8
+
+/** Maximum length of a received retrieval request (including headers) */
+#define PEERSERV_MAX_REQUEST 1024
+
+/** Maximum length of a retrieval response header */
+#define PEERSERV_MAX_HEADER 128
+
+/** Idle retrieval connection timeout */
+#define PEERSERV_IDLE_TIMEOUT ( 15 * TICKS_PER_SEC )
+
+extern void peerserv_add ( const struct peerdist_info *info );
+
+#endif /* _IPXE_PEERSERV_H */
@@ -15,10 +15,11 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 extern int create_pinger ( struct interface *job, const char *hostname,
 			   unsigned long timeout, size_t len,
-			   unsigned int count,
+			   unsigned int count, int flood,
 			   void ( * callback ) ( struct sockaddr *peer,
 						 unsigned int sequence,
 						 size_t len,
+						 unsigned long elapsed,
 						 int rc ) );
 
 #endif /* _IPXE_PINGER_H */
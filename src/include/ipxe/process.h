@@ -41,6 +41,14 @@ struct process_descriptor {
 	void ( * step ) ( void *object );
 	/** Automatically reschedule the process */
 	int reschedule;
+	/** Scheduling weight
+	 *
+	 * This is the number of consecutive steps that the process
+	 * will be given before being moved to the end of the run
+	 * queue.  Zero is treated as one.  The process may give up
+	 * the remainder of its turn using process_yield().
+	 */
+	unsigned int weight;
 };
 
 /**
@@ -116,6 +124,8 @@ process_object ( struct process *process );
 extern void process_add ( struct process *process );
 extern void process_del ( struct process *process );
 extern void step ( void );
+extern void process_yield ( struct process *process );
+extern int process_idle ( void );
 
 /**
  * Initialise process without adding to process list
@@ -181,6 +191,25 @@ struct process name __permanent_process = {				      \
 	.refcnt = NULL,							      \
 };
 
+/** Define a weighted permanent process
+ *
+ * @v name		Process name
+ * @v _step		Process' step() method
+ * @v _weight		Scheduling weight
+ */
+#define PERMANENT_PROCESS_WEIGHTED( name, _step, _weight )		      \
+static struct process_descriptor name ## _desc = {			      \
+	.offset = 0,							      \
+	.step = PROC_STEP ( struct process, _step ),			      \
+	.reschedule = 1,						      \
+	.weight = (_weight),						      \
+};									      \
+struct process name __permanent_process = {				      \
+	.list = LIST_HEAD_INIT ( name.list ),				      \
+	.desc = & name ## _desc,					      \
+	.refcnt = NULL,							      \
+};
+
 /**
  * Find debugging colourisation for a process
  *
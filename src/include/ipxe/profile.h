@@ -12,6 +12,15 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <bits/profile.h>
 #include <ipxe/tables.h>
 
+/** Number of latency histogram buckets
+ *
+ * Bucket @c n counts samples for which flsl(sample) is @c n,
+ * i.e. samples in the range [ 2^(n-1), 2^n ).  Bucket zero counts
+ * zero-valued samples, and the final bucket absorbs all samples too
+ * large to fit elsewhere.
+ */
+#define PROFILE_HIST_BUCKETS 32
+
 #ifndef PROFILING
 #ifdef NDEBUG
 #define PROFILING 0
@@ -48,6 +57,8 @@ struct profiler {
 	 * (i.e. one less than would be returned by flsll(raw_accvar)).
 	 */
 	unsigned int accvar_msb;
+	/** Log2 sample value histogram */
+	unsigned int hist[PROFILE_HIST_BUCKETS];
 };
 
 /** Profiler table */
@@ -11,6 +11,16 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <ipxe/list.h>
 
+/** Number of slots in the retry timer wheel
+ *
+ * Running timers are kept in the slot corresponding to their expiry
+ * time (modulo the number of slots), so that polling need examine
+ * only the timers due to expire within the current tick (and those
+ * due to expire in later revolutions of the wheel).  Must be a power
+ * of two.
+ */
+#define RETRY_WHEEL_SLOTS 256
+
 /** Default minimum timeout value (in ticks) */
 #define DEFAULT_MIN_TIMEOUT ( TICKS_PER_SEC / 4 )
 
@@ -19,7 +29,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 /** A retry timer */
 struct retry_timer {
-	/** List of active timers */
+	/** List of active timers within the same timer wheel slot */
 	struct list_head list;
 	/** Timer is currently running */
 	unsigned int running;
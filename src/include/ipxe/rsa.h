@@ -75,8 +75,20 @@ struct rsa_context {
 	bigint_element_t *output0;
 	/** Temporary working space for modular exponentiation */
 	void *tmp;
+	/** Chinese Remainder Theorem storage (private keys only)
+	 *
+	 * This is NULL if the CRT components are not available.
+	 */
+	void *crt;
+	/** Size of CRT prime factors, exponents, and coefficient */
+	unsigned int crt_size;
+	/** Size of public exponent (used to verify CRT results) */
+	unsigned int public_exponent_size;
+	/** Length of CRT temporary working space */
+	size_t crt_tmp_len;
 };
 
 extern struct pubkey_algorithm rsa_algorithm;
+extern struct pubkey_algorithm rsa_pss_algorithm;
 
 #endif /* _IPXE_RSA_H */
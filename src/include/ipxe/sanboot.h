@@ -19,6 +19,92 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/blockdev.h>
 #include <config/sanboot.h>
 
+/** Number of SAN device block cache hash buckets */
+#define SAN_CACHE_BUCKETS 64
+
+/** A SAN device block cache line */
+struct san_cache_line {
+	/** List of cache lines within the same hash bucket
+	 *
+	 * An unused cache line is not present in any hash bucket.
+	 */
+	struct list_head hash;
+	/** List of cache lines in least-recently-used order */
+	struct list_head lru;
+	/** Starting (underlying) logical block address */
+	uint64_t lba;
+};
+
+/** A SAN device block cache */
+struct san_cache {
+	/** Cache lines */
+	struct san_cache_line *lines;
+	/** Number of cache lines */
+	unsigned int count;
+	/** Number of underlying blocks per cache line */
+	unsigned int blocks;
+	/** Cached data */
+	userptr_t data;
+	/** Fetch buffer */
+	userptr_t fetch;
+	/** Number of underlying blocks in fetch buffer */
+	unsigned int fetch_blocks;
+	/** Next logical block address expected for a sequential read */
+	uint64_t next_lba;
+	/** Number of underlying blocks to read ahead on next sequential miss */
+	unsigned int readahead;
+	/** Hash buckets */
+	struct list_head hash[SAN_CACHE_BUCKETS];
+	/** Cache lines, most recently used first */
+	struct list_head lru;
+	/** Write-back buffer */
+	userptr_t dirty;
+	/** Number of underlying blocks in write-back buffer */
+	unsigned int dirty_max;
+	/** Starting logical block address of buffered writes */
+	uint64_t dirty_lba;
+	/** Number of underlying blocks of buffered writes */
+	unsigned int dirty_count;
+};
+
+/** Maximum number of concurrent commands per SAN device */
+#define SAN_COMMAND_MAX 8
+
+/** A SAN device path
+ *
+ * A SAN device may be reachable via several paths (e.g. several
+ * iSCSI portals serving the same LUN).  Commands are spread across
+ * all paths that are currently available.
+ */
+struct san_path {
+	/** SAN device */
+	struct san_device *sandev;
+	/** Path index */
+	unsigned int index;
+	/** SAN device URI */
+	struct uri *uri;
+	/** Underlying block device interface */
+	struct interface block;
+	/** Current path status */
+	int path_rc;
+	/** Number of commands in progress via this path */
+	unsigned int active;
+};
+
+/** A SAN device command */
+struct san_command {
+	/** SAN device */
+	struct san_device *sandev;
+	/** SAN path used by command in progress (if any) */
+	struct san_path *path;
+	/** Command interface */
+	struct interface command;
+	/** Command timeout timer */
+	struct retry_timer timer;
+	/** Command status */
+	int rc;
+};
+
 /** A SAN device */
 struct san_device {
 	/** Reference count */
@@ -26,22 +112,20 @@ struct san_device {
 	/** List of SAN devices */
 	struct list_head list;
 
-	/** SAN device URI */
-	struct uri *uri;
 	/** Drive number */
 	unsigned int drive;
 
-	/** Underlying block device interface */
-	struct interface block;
 	/** Current device status */
 	int block_rc;
+	/** Primary available path (if any) */
+	struct san_path *active;
+	/** Path from which to start the next search for a free path */
+	unsigned int next;
 
-	/** Command interface */
-	struct interface command;
-	/** Command timeout timer */
-	struct retry_timer timer;
-	/** Command status */
-	int command_rc;
+	/** Commands */
+	struct san_command commands[SAN_COMMAND_MAX];
+	/** Device has been seen to accept concurrent commands */
+	int concurrent;
 
 	/** Raw block device capacity */
 	struct block_device_capacity capacity;
@@ -54,9 +138,22 @@ struct san_device {
 	unsigned int blksize_shift;
 	/** Drive is a CD-ROM */
 	int is_cdrom;
+	/** Drive will be flushed before handover to an operating system
+	 *
+	 * Write-back buffering is permitted only if this is set.
+	 */
+	int handover_flush;
+
+	/** Block cache */
+	struct san_cache cache;
 
 	/** Driver private data */
 	void *priv;
+
+	/** Number of paths */
+	unsigned int paths;
+	/** Paths */
+	struct san_path path[0];
 };
 
 /**
@@ -98,11 +195,14 @@ struct san_device {
 /**
  * Hook SAN device
  *
- * @v uri		URI
+ * @v uris		List of URIs
+ * @v count		Number of URIs
  * @v drive		Drive number
  * @ret drive		Drive number, or negative error
+ *
+ * Each URI describes an alternative path to the same SAN device.
  */
-int san_hook ( struct uri *uri, unsigned int drive );
+int san_hook ( struct uri **uris, unsigned int count, unsigned int drive );
 
 /**
  * Unhook SAN device
@@ -196,13 +296,16 @@ static inline int sandev_needs_reopen ( struct san_device *sandev ) {
 extern struct san_device * sandev_find ( unsigned int drive );
 extern int sandev_reopen ( struct san_device *sandev );
 extern int sandev_reset ( struct san_device *sandev );
+extern int sandev_flush ( struct san_device *sandev );
 extern int sandev_rw ( struct san_device *sandev, uint64_t lba,
 		       unsigned int count, userptr_t buffer,
 		       int ( * block_rw ) ( struct interface *control,
 					    struct interface *data,
 					    uint64_t lba, unsigned int count,
 					    userptr_t buffer, size_t len ) );
-extern struct san_device * alloc_sandev ( struct uri *uri, size_t priv_size );
+extern struct san_device * alloc_sandev ( struct uri **uris,
+					   unsigned int count,
+					   size_t priv_size );
 extern int register_sandev ( struct san_device *sandev );
 extern void unregister_sandev ( struct san_device *sandev );
 extern unsigned int san_default_drive ( void );
@@ -318,6 +318,12 @@ union scsi_sns {
 /** SCSI sense key mask */
 #define SCSI_SENSE_KEY_MASK 0x0f
 
+/** SCSI "busy" status */
+#define SCSI_STATUS_BUSY 0x08
+
+/** SCSI "task set full" status */
+#define SCSI_STATUS_TASK_SET_FULL 0x28
+
 /** A SCSI response information unit */
 struct scsi_rsp {
 	/** SCSI status code */
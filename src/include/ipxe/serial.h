@@ -11,6 +11,12 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <ipxe/uart.h>
 
+/** Length of serial console transmit buffer
+ *
+ * Must be a power of two.
+ */
+#define SERIAL_TX_LEN 256
+
 extern struct uart serial_console;
 
 #endif /* _IPXE_SERIAL_H */
@@ -11,6 +11,7 @@ FILE_LICENCE ( GPL2_OR_LATER );
 
 #include <stdint.h>
 #include <ipxe/crypto.h>
+#include <ipxe/tables.h>
 
 /** An SHA-1 digest */
 struct sha1_digest {
@@ -62,6 +63,37 @@ struct sha1_context {
 	union sha1_digest_data_dwords ddd;
 } __attribute__ (( packed ));
 
+/** An accelerated SHA-1 block compression function
+ *
+ * Accelerated implementations operate on the digest as stored within
+ * the SHA-1 context, i.e. as big-endian values.
+ */
+struct sha1_accelerator {
+	/** Name */
+	const char *name;
+	/**
+	 * Check if accelerator is supported
+	 *
+	 * @ret supported	Accelerator is supported
+	 */
+	int ( * supported ) ( void );
+	/**
+	 * Digest single block
+	 *
+	 * @v digest		Digest to update (in big-endian form)
+	 * @v data		Data block
+	 */
+	void ( * digest ) ( struct sha1_digest *digest,
+			    const union sha1_block *data );
+};
+
+/** SHA-1 accelerator table */
+#define SHA1_ACCELERATORS \
+	__table ( struct sha1_accelerator, "sha1_accelerators" )
+
+/** Declare an SHA-1 accelerator */
+#define __sha1_accelerator __table_entry ( SHA1_ACCELERATORS, 01 )
+
 /** SHA-1 context size */
 #define SHA1_CTX_SIZE sizeof ( struct sha1_context )
 
@@ -11,6 +11,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdint.h>
 #include <ipxe/crypto.h>
+#include <ipxe/tables.h>
 
 /** SHA-256 number of rounds */
 #define SHA256_ROUNDS 64
@@ -67,6 +68,37 @@ struct sha256_context {
 	union sha256_digest_data_dwords ddd;
 } __attribute__ (( packed ));
 
+/** An accelerated SHA-256 block compression function
+ *
+ * Accelerated implementations operate on the digest as stored within
+ * the SHA-256 context, i.e. as big-endian values.
+ */
+struct sha256_accelerator {
+	/** Name */
+	const char *name;
+	/**
+	 * Check if accelerator is supported
+	 *
+	 * @ret supported	Accelerator is supported
+	 */
+	int ( * supported ) ( void );
+	/**
+	 * Digest single block
+	 *
+	 * @v digest		Digest to update (in big-endian form)
+	 * @v data		Data block
+	 */
+	void ( * digest ) ( struct sha256_digest *digest,
+			    const union sha256_block *data );
+};
+
+/** SHA-256 accelerator table */
+#define SHA256_ACCELERATORS \
+	__table ( struct sha256_accelerator, "sha256_accelerators" )
+
+/** Declare an SHA-256 accelerator */
+#define __sha256_accelerator __table_entry ( SHA256_ACCELERATORS, 01 )
+
 /** SHA-256 context size */
 #define SHA256_CTX_SIZE sizeof ( struct sha256_context )
 
@@ -76,6 +108,8 @@ struct sha256_context {
 /** SHA-224 digest size */
 #define SHA224_DIGEST_SIZE ( SHA256_DIGEST_SIZE * 224 / 256 )
 
+extern const uint32_t sha256_k[SHA256_ROUNDS];
+
 extern void sha256_family_init ( struct sha256_context *context,
 				 const struct sha256_digest *init,
 				 size_t digestsize );
@@ -35,6 +35,8 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Syslog priority */
 #define SYSLOG_PRIORITY( facility, severity ) ( 8 * (facility) + (severity) )
 
+extern size_t syslog_format ( char *buf, size_t size, unsigned int severity,
+			      const char *message, const char *terminator );
 extern int syslog_send ( struct interface *xfer, unsigned int severity,
 			 const char *message, const char *terminator );
 
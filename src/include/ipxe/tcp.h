@@ -12,6 +12,7 @@
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <ipxe/tcpip.h>
+#include <ipxe/tables.h>
 
 /**
  * A TCP header
@@ -112,6 +113,12 @@ struct tcp_sack_block {
  */
 #define TCP_SACK_MAX 3
 
+/** Maximum number of received selective acknowledgement blocks
+ *
+ * This is the maximum that can fit within the TCP option space.
+ */
+#define TCP_RX_SACK_MAX 4
+
 /** Padded TCP selective acknowledgement option (used for sending) */
 struct tcp_sack_padded_option {
 	uint8_t nop[2];
@@ -140,10 +147,14 @@ struct tcp_timestamp_padded_option {
 
 /** Parsed TCP options */
 struct tcp_options {
+	/** MSS option, if present */
+	const struct tcp_mss_option *mssopt;
 	/** Window scale option, if present */
 	const struct tcp_window_scale_option *wsopt;
 	/** SACK permitted option, if present */
 	const struct tcp_sack_permitted_option *spopt;
+	/** SACK option, if present */
+	const struct tcp_sack_option *sackopt;
 	/** Timestamp option, if present */
 	const struct tcp_timestamp_option *tsopt;
 };
@@ -351,20 +362,60 @@ struct tcp_options {
  * bandwidth), since in the event of a lost packet the window size
  * represents the maximum amount that will need to be retransmitted.
  *
- * We therefore choose a maximum window size of 256kB.
+ * We therefore choose a default maximum window size of 256kB.  This
+ * may be overridden using the "tcp-window" setting, to allow for
+ * links with a high bandwidth-delay product.
  */
 #define TCP_MAX_WINDOW_SIZE	( 256 * 1024 )
 
+/** Largest window representable using our advertised window scale */
+#define TCP_MAX_SCALED_WINDOW_SIZE ( 0xffffUL << TCP_RX_WINDOW_SCALE )
+
+/**
+ * Maximum length of transmit queue
+ *
+ * Data remains in the transmit queue until it has been acknowledged
+ * by the peer.  We limit the amount of data that the application may
+ * enqueue in order to conserve memory usage.
+ */
+#define TCP_MAX_TX_QUEUE	( 64 * 1024 )
+
+/**
+ * Duplicate acknowledgement threshold
+ *
+ * This is the number of duplicate acknowledgements that will trigger
+ * a fast retransmission, as per RFC 5681 section 3.2.
+ */
+#define TCP_DUPACK_THRESHOLD 3
+
+/**
+ * Minimum retransmission timeout
+ *
+ * This applies only once a round-trip time estimate is available
+ * from the timestamp option, at which point the retransmission
+ * timeout also accounts for the variation in round-trip time.  This
+ * is much shorter than the minimum of one second recommended by RFC
+ * 6298, to allow fast recovery on local networks.
+ */
+#define TCP_MIN_RTO ( TICKS_PER_SEC / 16 )
+
+/**
+ * Maximum plausible round-trip time
+ *
+ * Longer round-trip time samples (e.g. from a peer echoing
+ * nonsensical timestamps) are ignored.
+ */
+#define TCP_MAX_RTT ( 60 * TICKS_PER_SEC )
+
 /**
  * Path MTU
  *
  * IPv6 requires all data link layers to support a datagram size of
- * 1280 bytes.  We choose to use this as our maximum transmitted
- * datagram size, on the assumption that any practical link layer we
- * encounter will allow this size.  This is a very conservative
- * assumption in practice, but the impact of making such a
- * conservative assumption is insignificant since the amount of data
- * that we transmit (rather than receive) is negligible.
+ * 1280 bytes.  We choose to use this as our initial (and minimum)
+ * transmitted datagram size, on the assumption that any practical
+ * link layer we encounter will allow this size.  Larger segments
+ * are used only once path MTU discovery has shown them to be
+ * deliverable.
  *
  * We allow space within this 1280 bytes for an IPv6 header, a TCP
  * header, and a (padded) TCP timestamp option.
@@ -372,12 +423,64 @@ struct tcp_options {
 #define TCP_PATH_MTU							\
 	( 1280 - 40 /* IPv6 */ - 20 /* TCP */ - 12 /* TCP timestamp */ )
 
+/**
+ * Maximum length of options within a transmitted data segment
+ *
+ * This allows for a (padded) timestamp option and a (padded)
+ * selective acknowledgement option with the maximum number of
+ * blocks.
+ */
+#define TCP_MAX_DATA_OPTIONS_LEN					\
+	( sizeof ( struct tcp_timestamp_padded_option ) +		\
+	  sizeof ( struct tcp_sack_padded_option ) +			\
+	  ( TCP_SACK_MAX * sizeof ( struct tcp_sack_block ) ) )
+
+/**
+ * Minimum segment size increase worth probing for
+ *
+ * Packetization layer path MTU discovery (RFC 4821) stops searching
+ * once the difference between the largest segment size known to be
+ * deliverable and the smallest segment size known not to be
+ * deliverable falls below this value.
+ */
+#define TCP_PROBE_MIN_STEP 64
+
+/**
+ * Maximum length of data payload in a segmentation offload segment
+ *
+ * Network devices capable of TCP segmentation offload will split
+ * such segments into segments of at most @c mss bytes.  The
+ * maximum length is chosen to ensure that the resulting IPv4 or
+ * IPv6 datagram length remains representable.
+ */
+#define TCP_TSO_MAX_LEN ( 60 * 1024 )
+
+/**
+ * Maximum length of data payload in a coalesced received segment
+ *
+ * Consecutive received segments are merged only up to this length,
+ * which bounds the size of each coalesced I/O buffer.
+ */
+#define TCP_GRO_MAX_LEN ( 32 * 1024 )
+
 /** TCP maximum segment lifetime
  *
  * Currently set to 2 minutes, as per RFC 793.
  */
 #define TCP_MSL ( 2 * 60 * TICKS_PER_SEC )
 
+/**
+ * TCP delayed acknowledgement timeout
+ *
+ * An acknowledgement of in-order data may be delayed (as per RFC 1122
+ * section 4.2.3.2) in the hope of coalescing it with the
+ * acknowledgement of a subsequent segment.  RFC 1122 requires this
+ * delay to be less than 0.5 seconds; we use a much shorter delay to
+ * avoid stalling peers that are waiting for the acknowledgement
+ * before sending further data.
+ */
+#define TCP_DELAYED_ACK_TIMEOUT ( TICKS_PER_SEC / 25 )
+
 /**
  * TCP keepalive period
  *
@@ -387,16 +490,22 @@ struct tcp_options {
 #define TCP_KEEPALIVE_DELAY ( 15 * TICKS_PER_SEC )
 
 /**
- * TCP maximum header length
+ * TCP maximum segment header length (including options)
  *
  */
-#define TCP_MAX_HEADER_LEN					\
-	( MAX_LL_NET_HEADER_LEN +				\
-	  sizeof ( struct tcp_header ) +			\
+#define TCP_MAX_SEGMENT_HEADER_LEN				\
+	( sizeof ( struct tcp_header ) +			\
 	  sizeof ( struct tcp_mss_option ) +			\
 	  sizeof ( struct tcp_window_scale_padded_option ) +	\
 	  sizeof ( struct tcp_timestamp_padded_option ) )
 
+/**
+ * TCP maximum header length
+ *
+ */
+#define TCP_MAX_HEADER_LEN					\
+	( MAX_LL_NET_HEADER_LEN + TCP_MAX_SEGMENT_HEADER_LEN )
+
 /**
  * Compare TCP sequence numbers
  *
@@ -433,6 +542,217 @@ static inline int tcp_in_window ( uint32_t seq, uint32_t start,
  */
 #define TCP_FINISH_TIMEOUT ( 1 * TICKS_PER_SEC )
 
+/** Number of TCP connection hash buckets
+ *
+ * Connections are hashed by local port number.  Must be a power of
+ * two.
+ */
+#define TCP_HASH_BUCKETS 32
+
+/** TCP congestion control state */
+struct tcp_congestion {
+	/** Congestion window (in bytes) */
+	uint32_t cwnd;
+	/** Slow start threshold (in bytes) */
+	uint32_t ssthresh;
+	/** Data acknowledged since last congestion window increase */
+	uint32_t acked;
+	/** Congestion window prior to last reduction (in bytes) */
+	uint32_t w_max;
+	/** Start of current congestion avoidance epoch (in ticks) */
+	unsigned long epoch;
+};
+
+/** A TCP congestion control algorithm */
+struct tcp_congestion_algorithm {
+	/** Name */
+	const char *name;
+	/** Initialise congestion control state
+	 *
+	 * @v cong		Congestion control state
+	 * @v mss		Sender maximum segment size
+	 */
+	void ( * init ) ( struct tcp_congestion *cong, size_t mss );
+	/** Handle acknowledgement of new data
+	 *
+	 * @v cong		Congestion control state
+	 * @v mss		Sender maximum segment size
+	 * @v len		Length of newly acknowledged data
+	 */
+	void ( * acked ) ( struct tcp_congestion *cong, size_t mss,
+			   size_t len );
+	/** Handle retransmission timeout
+	 *
+	 * @v cong		Congestion control state
+	 * @v mss		Sender maximum segment size
+	 * @v flight		Amount of data in flight
+	 */
+	void ( * timeout ) ( struct tcp_congestion *cong, size_t mss,
+			     size_t flight );
+	/** Handle loss detected via duplicate acknowledgements
+	 *
+	 * @v cong		Congestion control state
+	 * @v mss		Sender maximum segment size
+	 * @v flight		Amount of data in flight
+	 */
+	void ( * loss ) ( struct tcp_congestion *cong, size_t mss,
+			  size_t flight );
+};
+
+/** TCP congestion control algorithm table */
+#define TCP_CONGESTION_ALGORITHMS \
+	__table ( struct tcp_congestion_algorithm, "tcp_congestion_algorithms" )
+
+/** Declare a TCP congestion control algorithm */
+#define __tcp_congestion_algorithm( order ) \
+	__table_entry ( TCP_CONGESTION_ALGORITHMS, order )
+
+struct interface;
+
+/** A TCP server
+ *
+ * A TCP server accepts incoming connections on a fixed local port.
+ * Each accepted connection is distinguished by its peer socket
+ * address.
+ */
+struct tcp_server {
+	/** Name */
+	const char *name;
+	/** Local port */
+	unsigned int port;
+	/**
+	 * Accept incoming connection
+	 *
+	 * @v xfer		TCP data transfer interface
+	 * @v peer		Peer socket address
+	 * @ret rc		Return status code
+	 *
+	 * The server must plug its own interface into @c xfer.  If
+	 * the connection is refused, the received SYN will be
+	 * silently dropped.
+	 */
+	int ( * accept ) ( struct interface *xfer,
+			   struct sockaddr_tcpip *peer );
+};
+
+/** TCP server table */
+#define TCP_SERVERS __table ( struct tcp_server, "tcp_servers" )
+
+/** Declare a TCP server */
+#define __tcp_server __table_entry ( TCP_SERVERS, 01 )
+
+/** @defgroup tcpcongorder TCP congestion control algorithm orders
+ *
+ * The first algorithm in the table is used unless an alternative is
+ * selected via the "tcp-congestion" setting.
+ *
+ * @{
+ */
+
+#define TCP_CONGESTION_DEFAULT	01	/**< Default algorithm */
+#define TCP_CONGESTION_EXTRA	02	/**< Optional algorithms */
+
+/** @} */
+
+/**
+ * Calculate initial TCP congestion window
+ *
+ * @v mss		Sender maximum segment size
+ * @ret cwnd		Initial congestion window
+ *
+ * This is the initial window defined in RFC 3390.
+ */
+static inline uint32_t tcp_initial_cwnd ( size_t mss ) {
+	uint32_t cwnd = 4380;
+
+	if ( cwnd < ( 2 * mss ) )
+		cwnd = ( 2 * mss );
+	if ( cwnd > ( 4 * mss ) )
+		cwnd = ( 4 * mss );
+	return cwnd;
+}
+
+/**
+ * Calculate TCP slow start threshold following loss
+ *
+ * @v flight		Amount of data in flight
+ * @v mss		Sender maximum segment size
+ * @ret ssthresh	Slow start threshold
+ *
+ * This is the calculation defined in RFC 5681 equation (4).
+ */
+static inline uint32_t tcp_loss_ssthresh ( size_t flight, size_t mss ) {
+	uint32_t ssthresh = ( flight / 2 );
+
+	if ( ssthresh < ( 2 * mss ) )
+		ssthresh = ( 2 * mss );
+	return ssthresh;
+}
+
+/** TCP connection statistics */
+struct tcp_statistics {
+	/** Number of segments transmitted */
+	unsigned long tx_segments;
+	/** Number of payload bytes transmitted (including retransmissions) */
+	unsigned long tx_bytes;
+	/** Number of segments retransmitted */
+	unsigned long retransmits;
+	/** Number of retransmission timeouts */
+	unsigned long timeouts;
+	/** Number of fast recoveries */
+	unsigned long recoveries;
+	/** Number of SACK blocks transmitted */
+	unsigned long tx_sacks;
+	/** Number of segments received */
+	unsigned long rx_segments;
+	/** Number of payload bytes received */
+	unsigned long rx_bytes;
+	/** Number of out-of-order segments received */
+	unsigned long rx_ooo;
+	/** Maximum length of receive queue (including internal headers) */
+	size_t rx_queued_max;
+	/** Number of SACK blocks received */
+	unsigned long rx_sacks;
+	/** Number of zero receive window advertisements from peer */
+	unsigned long zero_windows;
+};
+
+/** TCP connection information */
+struct tcp_info {
+	/** Remote socket address */
+	struct sockaddr_tcpip peer;
+	/** Local port */
+	unsigned int local_port;
+	/** Name of current TCP state */
+	const char *state;
+	/** Send maximum segment size */
+	size_t snd_mss;
+	/** Send window */
+	uint32_t snd_win;
+	/** Receive window */
+	uint32_t rcv_win;
+	/** Congestion window */
+	uint32_t cwnd;
+	/** Slow start threshold */
+	uint32_t ssthresh;
+	/** Smoothed round-trip time (in ticks), or zero if unknown */
+	unsigned long srtt;
+	/** Round-trip time variation (in ticks), or zero if unknown */
+	unsigned long rttvar;
+	/** Unacknowledged sequence count */
+	uint32_t snd_sent;
+	/** Length of data held in transmit queue */
+	size_t tx_queued;
+	/** Length of data held in receive queue */
+	size_t rx_queued;
+	/** Statistics */
+	struct tcp_statistics stats;
+};
+
 extern struct tcpip_protocol tcp_protocol __tcpip_protocol;
 
+extern void tcp_gro ( struct net_device *netdev );
+extern int tcp_info ( unsigned int index, struct tcp_info *info );
+extern void tcp_closed_stats ( struct tcp_statistics *stats );
+
 #endif /* _IPXE_TCP_H */
@@ -17,6 +17,40 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 extern uint16_t generic_tcpip_continue_chksum ( uint16_t partial,
 						const void *data, size_t len );
 
+/** An accelerated TCP/IP checksum implementation */
+struct tcpip_chksum_accelerator {
+	/** Name */
+	const char *name;
+	/** Minimum length of data worth accelerating */
+	size_t min_len;
+	/**
+	 * Check if accelerator is supported
+	 *
+	 * @ret supported	Accelerator is supported
+	 */
+	int ( * supported ) ( void );
+	/**
+	 * Calculate continued TCP/IP checksum
+	 *
+	 * @v partial		Checksum of already-summed data
+	 * @v data		Data buffer
+	 * @v len		Length of data buffer
+	 * @ret cksum		Updated checksum
+	 */
+	uint16_t ( * chksum ) ( uint16_t partial, const void *data,
+				size_t len );
+};
+
+/** TCP/IP checksum accelerator table */
+#define TCPIP_CHKSUM_ACCELERATORS \
+	__table ( struct tcpip_chksum_accelerator, "tcpip_chksum_accelerators" )
+
+/** Declare a TCP/IP checksum accelerator */
+#define __tcpip_chksum_accelerator \
+	__table_entry ( TCPIP_CHKSUM_ACCELERATORS, 01 )
+
+extern struct tcpip_chksum_accelerator * tcpip_chksum_accelerator ( void );
+
 #include <bits/tcpip.h>
 
 struct io_buffer;
@@ -132,6 +166,16 @@ struct tcpip_protocol {
 	 * This is a constant of the type IP_XXX
          */
         uint8_t tcpip_proto;
+	/**
+	 * Handle path MTU notification (optional)
+	 *
+	 * @v st_dest		Destination address of original packet
+	 * @v data		Transport-layer header of original packet
+	 * @v len		Length of transport-layer header (may be truncated)
+	 * @v mtu		Path MTU (excluding network-layer header)
+	 */
+	void ( * pmtu ) ( struct sockaddr_tcpip *st_dest, const void *data,
+			  size_t len, size_t mtu );
 };
 
 /**
@@ -196,9 +240,15 @@ extern int tcpip_tx ( struct io_buffer *iobuf, struct tcpip_protocol *tcpip,
 		      struct sockaddr_tcpip *st_dest,
 		      struct net_device *netdev,
 		      uint16_t *trans_csum );
+extern int tcpip_tx_chksum ( struct io_buffer *iobuf,
+			     struct net_device *netdev, void *trans,
+			     uint16_t *trans_csum );
 extern struct tcpip_net_protocol * tcpip_net_protocol ( sa_family_t sa_family );
 extern struct net_device * tcpip_netdev ( struct sockaddr_tcpip *st_dest );
 extern size_t tcpip_mtu ( struct sockaddr_tcpip *st_dest );
+extern size_t tcpip_headroom ( struct sockaddr_tcpip *st_dest );
+extern void tcpip_pmtu ( uint8_t tcpip_proto, struct sockaddr_tcpip *st_dest,
+			 const void *data, size_t len, size_t mtu );
 extern uint16_t tcpip_chksum ( const void *data, size_t len );
 extern int tcpip_bind ( struct sockaddr_tcpip *st_local,
 			int ( * available ) ( int port ) );
@@ -51,6 +51,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <bits/time.h>
 
 extern signed long time_offset;
+extern unsigned int time_sync_pending;
 
 /**
  * Get current time in seconds (ignoring system clock offset)
@@ -0,0 +1,43 @@
+#ifndef _IPXE_TIMELINE_H
+#define _IPXE_TIMELINE_H
+
+/** @file
+ *
+ * Boot timeline
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stddef.h>
+
+/** Maximum number of recorded timeline events
+ *
+ * Older events are overwritten once this limit is reached.
+ */
+#define TIMELINE_MAX_EVENTS 64
+
+/** Maximum length of timeline event detail (including NUL) */
+#define TIMELINE_DETAIL_LEN 32
+
+/** A timeline event */
+struct timeline_event {
+	/** Timestamp (in ticks) */
+	unsigned long ticks;
+	/** Phase (e.g. "dhcp", "tcp", "http") */
+	const char *phase;
+	/** Event within phase (e.g. "open", "done") */
+	const char *event;
+	/** Status code */
+	int rc;
+	/** Detail (e.g. network device name, host name) */
+	char detail[TIMELINE_DETAIL_LEN];
+};
+
+extern void timeline_record ( const char *phase, const char *event,
+			      const char *detail, int rc );
+extern unsigned int timeline_count ( void );
+extern const struct timeline_event * timeline_get ( unsigned int index );
+extern int timeline_format ( unsigned int index, char *buf, size_t len );
+
+#endif /* _IPXE_TIMELINE_H */
@@ -47,6 +47,9 @@ struct tls_header {
 /** TLS version 1.2 */
 #define TLS_VERSION_TLS_1_2 0x0303
 
+/** TLS version 1.3 */
+#define TLS_VERSION_TLS_1_3 0x0304
+
 /** Change cipher content type */
 #define TLS_TYPE_CHANGE_CIPHER 20
 
@@ -63,6 +66,8 @@ struct tls_header {
 #define TLS_HELLO_REQUEST 0
 #define TLS_CLIENT_HELLO 1
 #define TLS_SERVER_HELLO 2
+#define TLS_NEW_SESSION_TICKET 4
+#define TLS_ENCRYPTED_EXTENSIONS 8
 #define TLS_CERTIFICATE 11
 #define TLS_SERVER_KEY_EXCHANGE 12
 #define TLS_CERTIFICATE_REQUEST 13
@@ -70,6 +75,8 @@ struct tls_header {
 #define TLS_CERTIFICATE_VERIFY 15
 #define TLS_CLIENT_KEY_EXCHANGE 16
 #define TLS_FINISHED 20
+#define TLS_CERTIFICATE_STATUS 22
+#define TLS_KEY_UPDATE 24
 
 /* TLS alert levels */
 #define TLS_ALERT_WARNING 1
@@ -82,6 +89,12 @@ struct tls_header {
 #define TLS_RSA_WITH_AES_256_CBC_SHA 0x0035
 #define TLS_RSA_WITH_AES_128_CBC_SHA256 0x003c
 #define TLS_RSA_WITH_AES_256_CBC_SHA256 0x003d
+#define TLS_RSA_WITH_AES_128_GCM_SHA256 0x009c
+#define TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA 0xc013
+#define TLS_ECDHE_RSA_WITH_AES_256_CBC_SHA 0xc014
+#define TLS_ECDHE_RSA_WITH_AES_128_CBC_SHA256 0xc027
+#define TLS_ECDHE_RSA_WITH_AES_128_GCM_SHA256 0xc02f
+#define TLS_AES_128_GCM_SHA256 0x1301
 
 /* TLS hash algorithm identifiers */
 #define TLS_MD5_ALGORITHM 1
@@ -90,10 +103,16 @@ struct tls_header {
 #define TLS_SHA256_ALGORITHM 4
 #define TLS_SHA384_ALGORITHM 5
 #define TLS_SHA512_ALGORITHM 6
+#define TLS_INTRINSIC_ALGORITHM 8
 
 /* TLS signature algorithm identifiers */
 #define TLS_RSA_ALGORITHM 1
 
+/* TLS intrinsic signature algorithm identifiers (used with the
+ * TLS_INTRINSIC_ALGORITHM hash algorithm identifier)
+ */
+#define TLS_RSA_PSS_RSAE_SHA256_ALGORITHM 4
+
 /* TLS server name extension */
 #define TLS_SERVER_NAME 0
 #define TLS_SERVER_NAME_HOST_NAME 0
@@ -105,9 +124,43 @@ struct tls_header {
 #define TLS_MAX_FRAGMENT_LENGTH_2048 3
 #define TLS_MAX_FRAGMENT_LENGTH_4096 4
 
+/* TLS certificate status request extension */
+#define TLS_STATUS_REQUEST 5
+#define TLS_STATUS_REQUEST_OCSP 1
+
+/* TLS named curve extension */
+#define TLS_NAMED_CURVE 10
+#define TLS_NAMED_CURVE_X25519 29
+
+/* TLS EC point formats extension */
+#define TLS_POINT_FORMATS 11
+#define TLS_POINT_FORMAT_UNCOMPRESSED 0
+
 /* TLS signature algorithms extension */
 #define TLS_SIGNATURE_ALGORITHMS 13
 
+/* TLS application-layer protocol negotiation extension */
+#define TLS_ALPN 16
+
+/* TLS pre-shared key extension */
+#define TLS_PRE_SHARED_KEY 41
+
+/* TLS supported versions extension */
+#define TLS_SUPPORTED_VERSIONS 43
+
+/* TLS pre-shared key exchange modes extension */
+#define TLS_PSK_KEY_EXCHANGE_MODES 45
+#define TLS_PSK_DHE_KE 1
+
+/* TLS key share extension */
+#define TLS_KEY_SHARE 51
+
+/** TLSv1.3 Key Update requested */
+#define TLS_KEY_UPDATE_REQUESTED 1
+
+/** Maximum length of a negotiated application-layer protocol name */
+#define TLS_MAX_PROTOCOL_LEN 15
+
 /** TLS RX state machine state */
 enum tls_rx_state {
 	TLS_RX_HEADER = 0,
@@ -122,10 +175,33 @@ enum tls_tx_pending {
 	TLS_TX_CERTIFICATE_VERIFY = 0x0008,
 	TLS_TX_CHANGE_CIPHER = 0x0010,
 	TLS_TX_FINISHED = 0x0020,
+	TLS_TX_KEY_UPDATE = 0x0040,
+};
+
+/** TLS named curve type for ECDHE parameters */
+#define TLS_NAMED_CURVE_TYPE 3
+
+struct tls_session;
+
+/** A TLS key exchange algorithm */
+struct tls_key_exchange_algorithm {
+	/** Algorithm name */
+	const char *name;
+	/**
+	 * Transmit Client Key Exchange record
+	 *
+	 * @v tls		TLS session
+	 * @ret rc		Return status code
+	 *
+	 * This must also generate the master secret.
+	 */
+	int ( * exchange ) ( struct tls_session *tls );
 };
 
 /** A TLS cipher suite */
 struct tls_cipher_suite {
+	/** Key exchange algorithm */
+	struct tls_key_exchange_algorithm *exchange;
 	/** Public-key encryption algorithm */
 	struct pubkey_algorithm *pubkey;
 	/** Bulk encryption cipher algorithm */
@@ -134,6 +210,14 @@ struct tls_cipher_suite {
 	struct digest_algorithm *digest;
 	/** Key length */
 	uint16_t key_len;
+	/** Fixed initialisation vector length */
+	uint8_t fixed_iv_len;
+	/** Record initialisation vector length
+	 *
+	 * This is the length of the explicit initialisation vector
+	 * (or nonce) included within each record.
+	 */
+	uint8_t record_iv_len;
 	/** Numeric code (in network-endian order) */
 	uint16_t code;
 };
@@ -146,6 +230,22 @@ struct tls_cipher_suite {
 #define __tls_cipher_suite( pref )					\
 	__table_entry ( TLS_CIPHER_SUITES, pref )
 
+/** A TLS named curve */
+struct tls_named_curve {
+	/** Elliptic curve */
+	struct elliptic_curve *curve;
+	/** Numeric code (in network-endian order) */
+	uint16_t code;
+};
+
+/** TLS named curve table */
+#define TLS_NAMED_CURVES						\
+	__table ( struct tls_named_curve, "tls_named_curves" )
+
+/** Declare a TLS named curve */
+#define __tls_named_curve( pref )					\
+	__table_entry ( TLS_NAMED_CURVES, pref )
+
 /** A TLS cipher specification */
 struct tls_cipherspec {
 	/** Cipher suite */
@@ -160,6 +260,12 @@ struct tls_cipherspec {
 	void *cipher_next_ctx;
 	/** MAC secret */
 	void *mac_secret;
+	/** MAC digest context after absorbing the HMAC inner pad */
+	void *mac_inner_ctx;
+	/** MAC digest context after absorbing the HMAC outer pad */
+	void *mac_outer_ctx;
+	/** Fixed initialisation vector */
+	void *fixed_iv;
 };
 
 /** A TLS signature and hash algorithm identifier */
@@ -231,6 +337,70 @@ struct md5_sha1_digest {
 /** MD5+SHA1 digest size */
 #define MD5_SHA1_DIGEST_SIZE sizeof ( struct md5_sha1_digest )
 
+/** Maximum length of a TLS session ID */
+#define TLS_MAX_SESSION_ID_LEN 32
+
+/** Maximum number of cached TLS sessions */
+#define TLS_MAX_CACHED_SESSIONS 8
+
+/** Length of TLSv1.3 secrets
+ *
+ * We support only TLSv1.3 cipher suites using SHA-256, which is also
+ * the handshake verification digest for TLSv1.2 and later.
+ */
+#define TLS13_SECRET_LEN SHA256_DIGEST_SIZE
+
+/** Maximum length of a TLSv1.3 ephemeral private key */
+#define TLS13_MAX_PRIVATE_LEN 32
+
+/** Maximum lifetime of a TLSv1.3 session ticket (in seconds) */
+#define TLS13_MAX_TICKET_LIFETIME ( 7 * 24 * 60 * 60 )
+
+/** A cached TLS session
+ *
+ * A session is cached only after a handshake has completed
+ * successfully, which implies that the server certificate chain was
+ * validated.  A subsequent connection to the same server may resume
+ * the session using an abbreviated handshake, which avoids both the
+ * public-key operation and the certificate validation.
+ */
+struct tls_cached_session {
+	/** List of cached sessions */
+	struct list_head list;
+	/** Server name */
+	char *name;
+	/** Server port */
+	unsigned int port;
+	/** Trusted root certificate fingerprints */
+	const void *fingerprints;
+	/** Number of trusted root certificates */
+	unsigned int count;
+	/** Client certificate sent to server (or NULL) */
+	struct x509_certificate *cert;
+	/** Protocol version */
+	uint16_t version;
+	/** Cipher suite (in network-endian order) */
+	uint16_t cipher_suite;
+	/** Session ID */
+	uint8_t id[TLS_MAX_SESSION_ID_LEN];
+	/** Length of session ID */
+	size_t id_len;
+	/** Master secret */
+	uint8_t master_secret[48];
+	/** TLSv1.3 session ticket (or NULL) */
+	void *ticket;
+	/** Length of TLSv1.3 session ticket */
+	size_t ticket_len;
+	/** TLSv1.3 session ticket lifetime (in seconds) */
+	unsigned long lifetime;
+	/** TLSv1.3 session ticket age obfuscation value */
+	uint32_t age_add;
+	/** Time at which TLSv1.3 session ticket was received (in ticks) */
+	unsigned long received;
+	/** TLSv1.3 pre-shared key */
+	uint8_t psk[TLS13_SECRET_LEN];
+};
+
 /** A TLS session */
 struct tls_session {
 	/** Reference counter */
@@ -238,6 +408,17 @@ struct tls_session {
 
 	/** Server name */
 	const char *name;
+	/** Server port */
+	unsigned int port;
+	/** Offered application-layer protocols, or NULL
+	 *
+	 * This is a list of protocol names in the wire format used by
+	 * the ALPN extension, i.e. each name is preceded by a single
+	 * length byte.
+	 */
+	const char *alpn;
+	/** Negotiated application-layer protocol (or empty string) */
+	char protocol[ TLS_MAX_PROTOCOL_LEN + 1 /* NUL */ ];
 	/** Plaintext stream */
 	struct interface plainstream;
 	/** Ciphertext stream */
@@ -259,6 +440,47 @@ struct tls_session {
 	uint8_t master_secret[48];
 	/** Server random bytes */
 	uint8_t server_random[32];
+	/** Server Key Exchange record (if any) */
+	void *server_key;
+	/** Server Key Exchange record length */
+	size_t server_key_len;
+	/** Session ID */
+	uint8_t session_id[TLS_MAX_SESSION_ID_LEN];
+	/** Length of session ID */
+	size_t session_id_len;
+	/** Protocol version of session to be resumed */
+	uint16_t resume_version;
+	/** Cipher suite of session to be resumed (in network-endian order) */
+	uint16_t resume_cipher_suite;
+	/** Session has been resumed */
+	int resumed;
+	/** TLSv1.3 session ticket to be offered (or NULL) */
+	void *ticket;
+	/** Length of TLSv1.3 session ticket */
+	size_t ticket_len;
+	/** Obfuscated age of TLSv1.3 session ticket */
+	uint32_t ticket_age;
+	/** TLSv1.3 pre-shared key */
+	uint8_t psk[TLS13_SECRET_LEN];
+	/** TLSv1.3 ephemeral private key */
+	uint8_t private[TLS13_MAX_PRIVATE_LEN];
+	/** TLSv1.3 handshake secret, master secret, or resumption
+	 * master secret (according to handshake progress)
+	 */
+	uint8_t secret[TLS13_SECRET_LEN];
+	/** TLSv1.3 client traffic secret */
+	uint8_t client_secret[TLS13_SECRET_LEN];
+	/** TLSv1.3 server traffic secret */
+	uint8_t server_secret[TLS13_SECRET_LEN];
+	/** TLSv1.3 client application traffic secret
+	 *
+	 * This is not used until the client Finished has been sent.
+	 */
+	uint8_t client_secret_pending[TLS13_SECRET_LEN];
+	/** Server Certificate Verify has been verified (TLSv1.3 only) */
+	int verified;
+	/** Server certificate chain has been validated (TLSv1.3 only) */
+	int validated;
 	/** Client random bytes */
 	struct tls_client_random client_random;
 	/** MD5+SHA1 context for handshake verification */
@@ -274,6 +496,10 @@ struct tls_session {
 
 	/** Server certificate chain */
 	struct x509_chain *chain;
+	/** Stapled OCSP response for server certificate (if any) */
+	void *ocsp;
+	/** Length of stapled OCSP response */
+	size_t ocsp_len;
 	/** Certificate validator */
 	struct interface validator;
 
@@ -322,7 +548,26 @@ struct tls_session {
 /** RX I/O buffer alignment */
 #define TLS_RX_ALIGN 16
 
+/** Maximum length of transmitted record data
+ *
+ * We request a maximum fragment length of 4kB, and so must not send
+ * longer records if the server accepts the request.  Records of this
+ * length are permitted whether or not the server accepts it.
+ */
+#define TLS_TX_BUFSIZE 4096
+
+extern struct tls_key_exchange_algorithm tls_pubkey_exchange_algorithm;
+extern struct tls_key_exchange_algorithm tls_ecdhe_exchange_algorithm;
+extern struct tls_key_exchange_algorithm tls13_exchange_algorithm;
+
+extern const char * tls_protocol ( struct interface *intf );
+#define tls_protocol_TYPE( object_type ) \
+	typeof ( const char * ( object_type ) )
+
+extern int add_tls_alpn ( struct interface *xfer, const char *name,
+			  unsigned int port, const char *alpn,
+			  struct interface **next );
 extern int add_tls ( struct interface *xfer, const char *name,
-		     struct interface **next );
+		     unsigned int port, struct interface **next );
 
 #endif /* _IPXE_TLS_H */
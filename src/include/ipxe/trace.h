@@ -0,0 +1,57 @@
+#ifndef _IPXE_TRACE_H
+#define _IPXE_TRACE_H
+
+/** @file
+ *
+ * Tracepoints
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stddef.h>
+
+/** Maximum number of recorded trace records
+ *
+ * Older records are overwritten once this limit is reached.
+ */
+#define TRACE_MAX_RECORDS 512
+
+/** A trace record */
+struct trace_record {
+	/** Timestamp (from profile_timestamp()) */
+	unsigned long timestamp;
+	/** Tracepoint name (e.g. "tcp_rx") */
+	const char *name;
+	/** Object identifier */
+	const void *id;
+	/** Value */
+	unsigned long value;
+};
+
+extern void trace_record ( const char *name, const void *id,
+			   unsigned long value );
+extern unsigned int trace_count ( void );
+extern const struct trace_record * trace_get ( unsigned int index );
+extern int trace_format ( unsigned int index, char *buf, size_t len );
+
+/**
+ * Record tracepoint
+ *
+ * @v name		Tracepoint name (must be a static string)
+ * @v id		Object identifier
+ * @v value		Value
+ *
+ * Tracepoints are compiled in only for objects built with the trace
+ * debug level enabled (e.g. "make DEBUG=tcp:16").  Recording a
+ * tracepoint is cheap enough to leave the timing of the traced code
+ * substantially unaffected.
+ */
+#define TRACE( name, id, value ) do {					\
+		if ( DBG_TRACE ) {					\
+			trace_record ( (name), (id),			\
+				       ( ( unsigned long ) (value) ) );	\
+		}							\
+	} while ( 0 )
+
+#endif /* _IPXE_TRACE_H */
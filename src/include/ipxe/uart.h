@@ -24,6 +24,10 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define UART_FCR 0x02
 #define UART_FCR_FE	0x01	/**< FIFO enable */
 
+/** Interrupt identification register */
+#define UART_IIR 0x02
+#define UART_IIR_FIFO	0xc0	/**< FIFOs enabled */
+
 /** Line control register */
 #define UART_LCR 0x03
 #define UART_LCR_WLS0	0x01	/**< Word length select bit 0 */
@@ -76,6 +80,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Maximum baud rate */
 #define UART_MAX_BAUD 115200
 
+/** Length of a 16550 transmit FIFO */
+#define UART_FIFO_LEN 16
+
 /** A 16550-compatible UART */
 struct uart {
 	/** I/O port base address */
@@ -84,6 +91,8 @@ struct uart {
 	uint16_t divisor;
 	/** Line control register */
 	uint8_t lcr;
+	/** Number of bytes that may be written when transmitter is empty */
+	uint8_t fifo;
 };
 
 /** Symbolic names for port indexes */
@@ -124,6 +133,19 @@ static inline uint8_t uart_receive ( struct uart *uart ) {
 	return uart_read ( uart, UART_RBR );
 }
 
+/**
+ * Check if transmitter holding register is empty
+ *
+ * @v uart		UART
+ * @ret ready		Transmitter is ready for more data
+ */
+static inline int uart_transmit_ready ( struct uart *uart ) {
+	uint8_t lsr;
+
+	lsr = uart_read ( uart, UART_LSR );
+	return ( lsr & UART_LSR_THRE );
+}
+
 extern void uart_transmit ( struct uart *uart, uint8_t data );
 extern void uart_flush ( struct uart *uart );
 extern int uart_exists ( struct uart *uart );
@@ -23,6 +23,13 @@ struct sockaddr;
  * UDP constants
  */
 
+/** Number of UDP connection hash buckets
+ *
+ * Connections bound to a local port are hashed by local port number.
+ * Must be a power of two.
+ */
+#define UDP_HASH_BUCKETS 32
+
 /**
  * A UDP header
  */
@@ -208,6 +208,7 @@ extern struct uri * resolve_uri ( const struct uri *base_uri,
 				  struct uri *relative_uri );
 extern struct uri * pxe_uri ( struct sockaddr *sa_server,
 			      const char *filename );
+extern struct uri * pxe_mirror_uri ( struct uri *tftp );
 extern void churi ( struct uri *uri );
 
 #endif /* _IPXE_URI_H */
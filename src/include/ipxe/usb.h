@@ -420,6 +420,13 @@ struct usb_endpoint {
 	size_t len;
 	/** Maximum fill level */
 	unsigned int max;
+	/** Stream transfers are being enqueued as a batch
+	 *
+	 * While this flag is set, the host controller may defer
+	 * starting any enqueued stream transfers until its @c
+	 * doorbell method is called.
+	 */
+	int batch;
 };
 
 /** USB endpoint host controller operations */
@@ -465,6 +472,11 @@ struct usb_endpoint_host_operations {
 	 */
 	int ( * stream ) ( struct usb_endpoint *ep, struct io_buffer *iobuf,
 			   int zlp );
+	/** Start batched stream transfers (optional)
+	 *
+	 * @v ep		USB endpoint
+	 */
+	void ( * doorbell ) ( struct usb_endpoint *ep );
 };
 
 /** USB endpoint driver operations */
@@ -18,8 +18,12 @@
 /* Virtio feature flags used to negotiate device and driver features. */
 /* Can the device handle any descriptor layout? */
 #define VIRTIO_F_ANY_LAYOUT             27
+/* Can the driver and device use used_event and avail_event? */
+#define VIRTIO_RING_F_EVENT_IDX         29
 /* v1.0 compliant. */
 #define VIRTIO_F_VERSION_1              32
+/* Packed virtqueue layout supported. */
+#define VIRTIO_F_RING_PACKED            34
 
 #define MAX_QUEUE_NUM      (256)
 
@@ -30,6 +34,18 @@
 
 #define VRING_USED_F_NO_NOTIFY     1
 
+/* Packed descriptor availability flags */
+#define VRING_PACKED_DESC_F_AVAIL  (1 << 7)
+#define VRING_PACKED_DESC_F_USED   (1 << 15)
+
+/* Packed ring event suppression flags */
+#define VRING_PACKED_EVENT_FLAG_ENABLE  0
+#define VRING_PACKED_EVENT_FLAG_DISABLE 1
+#define VRING_PACKED_EVENT_FLAG_DESC    2
+
+/* Wrap counter bit within packed ring event offset */
+#define VRING_PACKED_EVENT_F_WRAP_CTR   15
+
 struct vring_desc
 {
    u64 addr;
@@ -63,13 +79,43 @@ struct vring {
    struct vring_desc *desc;
    struct vring_avail *avail;
    struct vring_used *used;
+   /* Event index fields (valid only if VIRTIO_RING_F_EVENT_IDX) */
+   u16 *used_event;
+   u16 *avail_event;
+};
+
+struct vring_packed_desc
+{
+   u64 addr;
+   u32 len;
+   u16 id;
+   u16 flags;
+};
+
+struct vring_packed_desc_event
+{
+   u16 off_wrap;
+   u16 flags;
 };
 
+struct vring_packed {
+   unsigned int num;
+   struct vring_packed_desc *desc;
+   struct vring_packed_desc_event *driver;
+   struct vring_packed_desc_event *device;
+};
+
+/* The split ring size includes the used_event and avail_event fields */
 #define vring_size(num) \
    (((((sizeof(struct vring_desc) * num) + \
-      (sizeof(struct vring_avail) + sizeof(u16) * num)) \
+      (sizeof(struct vring_avail) + sizeof(u16) * (num + 1))) \
          + PAGE_MASK) & ~PAGE_MASK) + \
-         (sizeof(struct vring_used) + sizeof(struct vring_used_elem) * num))
+         (sizeof(struct vring_used) + sizeof(struct vring_used_elem) * num) + \
+         sizeof(u16))
+
+#define vring_packed_size(num) \
+   ((sizeof(struct vring_packed_desc) * num) + \
+    (2 * sizeof(struct vring_packed_desc_event)))
 
 struct vring_virtqueue {
    unsigned char *queue;
@@ -77,6 +123,17 @@ struct vring_virtqueue {
    u16 free_head;
    u16 last_used_idx;
    void **vdata;
+   /* Negotiated ring features */
+   int packed;
+   int event_idx;
+   /* Packed ring state */
+   struct vring_packed vpacked;
+   u16 next_avail_idx;
+   u16 num_added;
+   u8 avail_wrap;
+   u8 used_wrap;
+   u16 *next_id;
+   u16 *chain_len;
    /* PCI */
    int queue_index;
    struct virtio_pci_region notification;
@@ -105,23 +162,92 @@ static inline void vring_init(struct vring *vr,
 
    /* physical address of used must be page aligned */
 
-   pa = virt_to_phys(&vr->avail->ring[num]);
+   pa = virt_to_phys(&vr->avail->ring[num + 1]);
    pa = (pa + PAGE_MASK) & ~PAGE_MASK;
    vr->used = phys_to_virt(pa);
 
+   vr->used_event = &vr->avail->ring[num];
+   vr->avail_event = (u16 *)&vr->used->ring[num];
+
    for (i = 0; i < num - 1; i++)
            vr->desc[i].next = i + 1;
    vr->desc[i].next = 0;
 }
 
+static inline void vring_packed_init(struct vring_virtqueue *vq,
+                                     unsigned int num, unsigned char *queue)
+{
+   struct vring_packed *vr = &vq->vpacked;
+   unsigned int i;
+   unsigned long pa;
+
+   vr->num = num;
+
+   /* physical address of desc must be page aligned */
+
+   pa = virt_to_phys(queue);
+   pa = (pa + PAGE_MASK) & ~PAGE_MASK;
+   vr->desc = phys_to_virt(pa);
+
+   vr->driver = (struct vring_packed_desc_event *)&vr->desc[num];
+   vr->device = &vr->driver[1];
+
+   /* all buffer IDs are initially free */
+
+   for (i = 0; i < num - 1; i++)
+           vq->next_id[i] = i + 1;
+   vq->next_id[i] = 0;
+   vq->free_head = 0;
+
+   /* both wrap counters start at 1 */
+
+   vq->next_avail_idx = 0;
+   vq->last_used_idx = 0;
+   vq->avail_wrap = 1;
+   vq->used_wrap = 1;
+}
+
+/*
+ * vring_need_event
+ *
+ * has the other side asked to be notified about the entry at
+ * event_idx, given that entries [old,new) have just been added ?
+ *
+ */
+
+static inline int vring_need_event(u16 event_idx, u16 new_idx, u16 old)
+{
+   return (u16)(new_idx - event_idx - 1) < (u16)(new_idx - old);
+}
+
+static inline unsigned int vring_num(struct vring_virtqueue *vq)
+{
+   return (vq->packed ? vq->vpacked.num : vq->vring.num);
+}
+
 static inline void vring_enable_cb(struct vring_virtqueue *vq)
 {
+   if (vq->packed) {
+           vq->vpacked.driver->flags = VRING_PACKED_EVENT_FLAG_ENABLE;
+           return;
+   }
    vq->vring.avail->flags &= ~VRING_AVAIL_F_NO_INTERRUPT;
+   if (vq->event_idx)
+           *vq->vring.used_event = vq->last_used_idx;
 }
 
 static inline void vring_disable_cb(struct vring_virtqueue *vq)
 {
+   if (vq->packed) {
+           vq->vpacked.driver->flags = VRING_PACKED_EVENT_FLAG_DISABLE;
+           return;
+   }
    vq->vring.avail->flags |= VRING_AVAIL_F_NO_INTERRUPT;
+   /* the device ignores the flag when event indices are in use, so
+    * instead request an interrupt only after the index next wraps
+    */
+   if (vq->event_idx)
+           *vq->vring.used_event = vq->last_used_idx - 1;
 }
 
 
@@ -134,7 +260,16 @@ static inline void vring_disable_cb(struct vring_virtqueue *vq)
 
 static inline int vring_more_used(struct vring_virtqueue *vq)
 {
+   u16 flags;
+   int avail, used;
+
    wmb();
+   if (vq->packed) {
+           flags = vq->vpacked.desc[vq->last_used_idx].flags;
+           avail = !!(flags & VRING_PACKED_DESC_F_AVAIL);
+           used = !!(flags & VRING_PACKED_DESC_F_USED);
+           return (avail == used) && (used == vq->used_wrap);
+   }
    return vq->last_used_idx != vq->vring.used->idx;
 }
 
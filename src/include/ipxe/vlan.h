@@ -66,5 +66,7 @@ extern int vlan_can_be_trunk ( struct net_device *trunk );
 extern int vlan_create ( struct net_device *trunk, unsigned int tag,
 			 unsigned int priority );
 extern int vlan_destroy ( struct net_device *netdev );
+extern void vlan_netdev_rx ( struct net_device *trunk, unsigned int tag,
+			     struct io_buffer *iobuf );
 
 #endif /* _IPXE_VLAN_H */
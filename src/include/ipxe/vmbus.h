@@ -85,6 +85,7 @@ enum vmbus_message_type {
 	VMBUS_OPEN_CHANNEL_RESULT = 6,
 	VMBUS_CLOSE_CHANNEL = 7,
 	VMBUS_GPADL_HEADER = 8,
+	VMBUS_GPADL_BODY = 9,
 	VMBUS_GPADL_CREATED = 10,
 	VMBUS_GPADL_TEARDOWN = 11,
 	VMBUS_GPADL_TORNDOWN = 12,
@@ -178,6 +179,18 @@ struct vmbus_gpadl_header {
 	struct vmbus_gpa_range range[0];
 } __attribute__ (( packed ));
 
+/** VMBus "GPADL body" message */
+struct vmbus_gpadl_body {
+	/** Message header */
+	struct vmbus_message_header header;
+	/** Message number */
+	uint32_t msgnum;
+	/** GPADL ID */
+	uint32_t gpadl;
+	/** Page frame numbers */
+	uint64_t pfn[0];
+} __attribute__ (( packed ));
+
 /** VMBus "GPADL created" message */
 struct vmbus_gpadl_created {
 	/** Message header */
@@ -626,6 +639,7 @@ extern int vmbus_send_completion ( struct vmbus_device *vmdev, uint64_t xid,
 				   const void *data, size_t len );
 extern int vmbus_send_cancellation ( struct vmbus_device *vmdev, uint64_t xid );
 extern int vmbus_poll ( struct vmbus_device *vmdev );
+extern void vmbus_poll_all ( struct vmbus_device *vmdev );
 extern void vmbus_dump_channel ( struct vmbus_device *vmdev );
 
 extern int vmbus_probe ( struct hv_hypervisor *hv, struct device *parent );
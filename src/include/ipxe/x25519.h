@@ -0,0 +1,30 @@
+#ifndef _IPXE_X25519_H
+#define _IPXE_X25519_H
+
+/** @file
+ *
+ * X25519 key exchange
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <ipxe/crypto.h>
+
+/** Length of an X25519 key (i.e. of a scalar or a u-coordinate) */
+#define X25519_SIZE 32
+
+/** An X25519 key (in little-endian byte order) */
+struct x25519_value {
+	/** Raw value */
+	uint8_t raw[X25519_SIZE];
+};
+
+extern struct elliptic_curve x25519_curve;
+
+extern int x25519_key ( const struct x25519_value *base,
+			const struct x25519_value *scalar,
+			struct x25519_value *result );
+
+#endif /* _IPXE_X25519_H */
@@ -130,6 +130,8 @@ struct x509_ocsp_responder {
 	struct asn1_cursor uri;
 	/** OCSP status is good */
 	int good;
+	/** OCSP status expiry time (including margin of error) */
+	time_t expiry;
 };
 
 /** X.509 certificate authority information access */
@@ -153,6 +155,14 @@ enum x509_general_name_types {
 
 /** An X.509 certificate extensions set */
 struct x509_extensions {
+	/** Raw extensions
+	 *
+	 * Extensions are decoded only when first required (via
+	 * x509_decode_extensions()), since many parsed certificates
+	 * (e.g. surplus certificates supplied by a TLS server or
+	 * within a CMS signature) are never validated.
+	 */
+	struct asn1_cursor raw;
 	/** Basic constraints */
 	struct x509_basic_constraints basic;
 	/** Key usage */
@@ -188,11 +198,17 @@ struct x509_certificate {
 
 	/** Link in certificate store */
 	struct x509_link store;
+	/** Link in certificate store raw data index */
+	struct list_head raw_index;
+	/** Link in certificate store subject index */
+	struct list_head subject_index;
 
 	/** Flags */
 	unsigned int flags;
 	/** Maximum number of subsequent certificates in chain */
 	unsigned int path_remaining;
+	/** Validation expiry time (including margin of error) */
+	time_t expiry;
 
 	/** Raw certificate */
 	struct asn1_cursor raw;
@@ -224,6 +240,8 @@ enum x509_flags {
 	X509_FL_PERMANENT = 0x0002,
 	/** Certificate was added explicitly at run time */
 	X509_FL_EXPLICIT = 0x0004,
+	/** Extensions have been decoded */
+	X509_FL_DECODED = 0x0008,
 };
 
 /**
@@ -353,6 +371,7 @@ struct x509_root {
 extern const char * x509_name ( struct x509_certificate *cert );
 extern int x509_parse ( struct x509_certificate *cert,
 			const struct asn1_cursor *raw );
+extern int x509_decode_extensions ( struct x509_certificate *cert );
 extern int x509_certificate ( const void *data, size_t len,
 			      struct x509_certificate **cert );
 extern int x509_validate ( struct x509_certificate *cert,
@@ -392,6 +411,20 @@ static inline int x509_is_valid ( struct x509_certificate *cert ) {
 	return ( cert->flags & X509_FL_VALIDATED );
 }
 
+/**
+ * Check if X.509 certificate has a current OCSP response
+ *
+ * @v cert		X.509 certificate
+ * @v time		Time at which to check OCSP response
+ * @ret is_good		Certificate has a current good OCSP response
+ */
+static inline int x509_ocsp_is_good ( struct x509_certificate *cert,
+				      time_t time ) {
+	struct x509_ocsp_responder *ocsp = &cert->extensions.auth_info.ocsp;
+
+	return ( ocsp->good && ( time <= ocsp->expiry ) );
+}
+
 /**
  * Invalidate X.509 certificate
  *
@@ -103,6 +103,7 @@ extern int xfer_vprintf ( struct interface *intf,
 extern int __attribute__ (( format ( printf, 2, 3 ) ))
 xfer_printf ( struct interface *intf, const char *format, ... );
 extern int xfer_seek ( struct interface *intf, off_t offset );
+extern int xfer_presize ( struct interface *intf, size_t len );
 extern int xfer_check_order ( struct xfer_metadata *meta, size_t *pos,
 			      size_t len );
 
@@ -15,12 +15,27 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/interface.h>
 #include <ipxe/xfer.h>
 
+/** Data transfer buffer growth ratio
+ *
+ * When a data transfer buffer must be extended, the allocation will
+ * be extended by an additional (1/XFERBUF_GROW_RATIO) of its current
+ * length.
+ */
+#define XFERBUF_GROW_RATIO 4
+
 /** A data transfer buffer */
 struct xfer_buffer {
 	/** Data */
 	void *data;
 	/** Size of data */
 	size_t len;
+	/** Allocated size of data
+	 *
+	 * This may exceed the size of data, since the buffer is
+	 * extended in large increments when the final length is not
+	 * known in advance.
+	 */
+	size_t size;
 	/** Current offset within data */
 	size_t pos;
 	/** Data transfer buffer operations */
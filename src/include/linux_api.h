@@ -51,6 +51,40 @@ struct sockaddr;
 #define MAP_FAILED ( ( void * ) -1 )
 #define SEEK_SET 0
 
+/** A scatter/gather list entry (as used by recvmmsg() and sendmmsg()) */
+struct linux_iovec {
+	/** Start address */
+	void *iov_base;
+	/** Length */
+	__kernel_size_t iov_len;
+};
+
+/** A message header (as used by recvmmsg() and sendmmsg()) */
+struct linux_msghdr {
+	/** Socket address */
+	void *msg_name;
+	/** Length of socket address */
+	int msg_namelen;
+	/** Scatter/gather list */
+	struct linux_iovec *msg_iov;
+	/** Number of scatter/gather list entries */
+	__kernel_size_t msg_iovlen;
+	/** Ancillary data */
+	void *msg_control;
+	/** Length of ancillary data */
+	__kernel_size_t msg_controllen;
+	/** Flags on received message */
+	unsigned int msg_flags;
+};
+
+/** A multiple message header entry */
+struct linux_mmsghdr {
+	/** Message header */
+	struct linux_msghdr msg_hdr;
+	/** Number of bytes transferred */
+	unsigned int msg_len;
+};
+
 extern long linux_syscall ( int number, ... );
 
 extern int linux_open ( const char *pathname, int flags );
@@ -70,11 +104,19 @@ extern void * linux_mmap ( void *addr, __kernel_size_t length, int prot,
 extern void * linux_mremap ( void *old_address, __kernel_size_t old_size,
 			     __kernel_size_t new_size, int flags );
 extern int linux_munmap ( void *addr, __kernel_size_t length );
+extern int linux_madvise ( void *addr, __kernel_size_t length, int advice );
 extern int linux_socket ( int domain, int type_, int protocol );
 extern int linux_bind ( int fd, const struct sockaddr *addr,
 			socklen_t addrlen );
 extern ssize_t linux_sendto ( int fd, const void *buf, size_t len, int flags,
 			      const struct sockaddr *daddr, socklen_t addrlen );
+extern int linux_setsockopt ( int fd, int level, int optname,
+			      const void *optval, socklen_t optlen );
+extern int linux_recvmmsg ( int fd, struct linux_mmsghdr *msgvec,
+			    unsigned int vlen, unsigned int flags,
+			    struct timespec *timeout );
+extern int linux_sendmmsg ( int fd, struct linux_mmsghdr *msgvec,
+			    unsigned int vlen, unsigned int flags );
 
 extern const char * linux_strerror ( int errnum );
 
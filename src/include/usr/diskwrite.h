@@ -0,0 +1,17 @@
+#ifndef _USR_DISKWRITE_H
+#define _USR_DISKWRITE_H
+
+/** @file
+ *
+ * Local disk writing
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+struct uri;
+
+extern int diskwrite ( const char *disk, struct uri *uri,
+		       unsigned long timeout );
+
+#endif /* _USR_DISKWRITE_H */
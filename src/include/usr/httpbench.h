@@ -0,0 +1,16 @@
+#ifndef _USR_HTTPBENCH_H
+#define _USR_HTTPBENCH_H
+
+/** @file
+ *
+ * Download benchmarking
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+struct uri;
+
+extern int httpbench ( struct uri *uri, unsigned long timeout );
+
+#endif /* _USR_HTTPBENCH_H */
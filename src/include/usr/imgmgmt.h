@@ -12,11 +12,17 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/image.h>
 
 extern int imgdownload ( struct uri *uri, unsigned long timeout,
+			 struct digest_algorithm *digest,
 			 struct image **image );
+extern int imgprefetch ( struct uri *uri );
 extern int imgdownload_string ( const char *uri_string, unsigned long timeout,
 				struct image **image );
 extern int imgacquire ( const char *name, unsigned long timeout,
 			struct image **image );
+extern int imgdownload_background ( const char *uri_string,
+				    struct image **image );
+extern int imgwait ( const char *name, unsigned long timeout );
+extern int imgbatch ( struct image *manifest, unsigned long timeout );
 extern void imgstat ( struct image *image );
 
 #endif /* _USR_IMGMGMT_H */
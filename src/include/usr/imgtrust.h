@@ -11,6 +11,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <ipxe/image.h>
 
+extern struct digest_algorithm * imgverify_digest ( struct image *signature );
 extern int imgverify ( struct image *image, struct image *signature,
 		       const char *name );
 
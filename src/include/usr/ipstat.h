@@ -10,5 +10,6 @@
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 extern void ipstat ( void );
+extern void ipstat_raw ( void );
 
 #endif /* _USR_IPSTAT_H */
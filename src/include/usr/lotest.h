@@ -9,8 +9,20 @@
 
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
+/** Minimum packet size used for benchmarking */
+#define LOTEST_BENCH_MIN_LEN 64
+
+/** Default number of packets transmitted per packet size when benchmarking */
+#define LOTEST_BENCH_COUNT 10000
+
+/** Default number of packets in flight when benchmarking */
+#define LOTEST_BENCH_WINDOW 8
+
 extern int loopback_test ( struct net_device *sender,
 			   struct net_device *receiver,
 			   size_t mtu, int broadcast );
+extern int loopback_bench ( struct net_device *sender,
+			    struct net_device *receiver, size_t mtu,
+			    unsigned int count, unsigned int window );
 
 #endif /* _USR_LOTEST_H */
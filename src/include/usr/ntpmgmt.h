@@ -9,6 +9,7 @@
 
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
-extern int ntp ( const char *hostname );
+extern int ntp ( char **hostnames, unsigned int count );
+extern int ntp_background ( char **hostnames, unsigned int count );
 
 #endif /* _USR_NTPMGMT_H */
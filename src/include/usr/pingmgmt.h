@@ -11,7 +11,18 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdint.h>
 
+/** Ping flags */
+enum ping_flags {
+	/** Inhibit output */
+	PING_QUIET = 0x0001,
+	/** Send each request as soon as a response is received */
+	PING_FLOOD = 0x0002,
+	/** Show statistics in machine-readable form */
+	PING_RAW = 0x0004,
+};
+
 extern int ping ( const char *hostname, unsigned long timeout, size_t len,
-		  unsigned int count, int quiet );
+		  size_t max_len, size_t step, unsigned int count,
+		  unsigned int flags );
 
 #endif /* _USR_PINGMGMT_H */
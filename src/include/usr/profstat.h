@@ -10,5 +10,6 @@
 FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 extern void profstat ( void );
+extern void profstat_raw ( void );
 
 #endif /* _USR_PROFSTAT_H */
@@ -0,0 +1,15 @@
+#ifndef _USR_TCPSTAT_H
+#define _USR_TCPSTAT_H
+
+/** @file
+ *
+ * TCP statistics
+ *
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+extern void tcpstat ( void );
+extern void tcpstat_raw ( void );
+
+#endif /* _USR_TCPSTAT_H */
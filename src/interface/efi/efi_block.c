@@ -34,6 +34,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#include <assert.h>
 #include <ipxe/refcnt.h>
 #include <ipxe/list.h>
 #include <ipxe/uri.h>
@@ -48,6 +49,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/iso9660.h>
 #include <ipxe/efi/efi.h>
 #include <ipxe/efi/Protocol/BlockIo.h>
+#include <ipxe/efi/Protocol/BlockIo2.h>
 #include <ipxe/efi/Protocol/SimpleFileSystem.h>
 #include <ipxe/efi/efi_driver.h>
 #include <ipxe/efi/efi_strings.h>
@@ -67,6 +69,20 @@ static wchar_t efi_block_boot_filename[] = EFI_REMOVABLE_MEDIA_FILE_NAME;
 static EFI_GUID ipxe_block_device_path_guid
 	= IPXE_BLOCK_DEVICE_PATH_GUID;
 
+/** Event group signalled before ExitBootServices() */
+#define EFI_EVENT_BEFORE_EXIT_BOOT_SERVICES_GUID			\
+	{ 0x8be0e274, 0x3970, 0x4b44,					\
+	  { 0x80, 0xc5, 0x1a, 0xb9, 0x50, 0x2f, 0x3b, 0xfc } }
+
+/** Event group signalled before ExitBootServices() */
+static EFI_GUID efi_before_exit_boot_services_guid
+	= EFI_EVENT_BEFORE_EXIT_BOOT_SERVICES_GUID;
+
+/** First system table revision to signal the before-ExitBootServices()
+ * event group (UEFI 2.8)
+ */
+#define EFI_BLOCK_HANDOVER_REVISION ( ( 2 << 16 ) | ( 80 ) )
+
 /** An iPXE EFI block device vendor device path */
 struct efi_block_vendor_path {
 	/** Generic vendor device path */
@@ -75,6 +91,13 @@ struct efi_block_vendor_path {
 	CHAR16 uri[0];
 } __attribute__ (( packed ));
 
+/** Maximum length of a coalesced asynchronous read
+ *
+ * Adjacent asynchronous reads are combined into a single read from
+ * the SAN device, up to this total length.
+ */
+#define EFI_BLOCK_COALESCE_MAX ( 256 * 1024 )
+
 /** EFI SAN device private data */
 struct efi_block_data {
 	/** SAN device */
@@ -85,10 +108,45 @@ struct efi_block_data {
 	EFI_BLOCK_IO_MEDIA media;
 	/** Block I/O protocol */
 	EFI_BLOCK_IO_PROTOCOL block_io;
+	/** Block I/O 2 protocol */
+	EFI_BLOCK_IO2_PROTOCOL block_io2;
 	/** Device path protocol */
 	EFI_DEVICE_PATH_PROTOCOL *path;
+	/** Pending asynchronous requests */
+	struct list_head requests;
+	/** Asynchronous request processing event */
+	EFI_EVENT event;
+	/** Operating system handover event (if any) */
+	EFI_EVENT handover;
 };
 
+/** An asynchronous EFI block I/O request */
+struct efi_block_request {
+	/** List of pending requests */
+	struct list_head list;
+	/** Completion token */
+	EFI_BLOCK_IO2_TOKEN *token;
+	/** Starting LBA */
+	EFI_LBA lba;
+	/** Data buffer */
+	void *data;
+	/** Size of buffer */
+	size_t len;
+	/** Block read/write method, or NULL for a flush request */
+	int ( * block_rw ) ( struct interface *control, struct interface *data,
+			     uint64_t lba, unsigned int count,
+			     userptr_t buffer, size_t len );
+};
+
+/** Number of EFI block device operations currently in progress
+ *
+ * Asynchronous requests are processed from a timer event, which may
+ * fire while iPXE is already in the middle of a synchronous block
+ * device operation.  Processing is deferred in this case, since the
+ * underlying SAN device code is not reentrant.
+ */
+static unsigned int efi_block_busy;
+
 /**
  * Read from or write to EFI block device
  *
@@ -118,8 +176,10 @@ static int efi_block_rw ( struct san_device *sandev, uint64_t lba,
 	}
 
 	/* Read from / write to block device */
-	if ( ( rc = sandev_rw ( sandev, lba, count, virt_to_user ( data ),
-				block_rw ) ) != 0 ) {
+	efi_block_busy++;
+	rc = sandev_rw ( sandev, lba, count, virt_to_user ( data ), block_rw );
+	efi_block_busy--;
+	if ( rc != 0 ) {
 		DBGC ( sandev, "EFIBLK %#02x I/O failed: %s\n",
 		       sandev->drive, strerror ( rc ) );
 		return rc;
@@ -128,6 +188,223 @@ static int efi_block_rw ( struct san_device *sandev, uint64_t lba,
 	return 0;
 }
 
+/**
+ * Complete asynchronous EFI block device request
+ *
+ * @v request		Request
+ * @v rc		Completion status code
+ */
+static void efi_block_complete ( struct efi_block_request *request, int rc ) {
+	EFI_BOOT_SERVICES *bs = efi_systab->BootServices;
+	EFI_BLOCK_IO2_TOKEN *token = request->token;
+
+	/* Free request (which must already have been dequeued) */
+	free ( request );
+
+	/* Report completion to caller */
+	token->TransactionStatus = EFIRC ( rc );
+	bs->SignalEvent ( token->Event );
+}
+
+/**
+ * Abort all pending asynchronous EFI block device requests
+ *
+ * @v block		EFI block device
+ * @v rc		Reason for abort
+ */
+static void efi_block_abort ( struct efi_block_data *block, int rc ) {
+	struct efi_block_request *request;
+
+	while ( ( request = list_first_entry ( &block->requests,
+					       struct efi_block_request,
+					       list ) ) ) {
+		list_del ( &request->list );
+		efi_block_complete ( request, rc );
+	}
+}
+
+/**
+ * Process next asynchronous EFI block device request
+ *
+ * @v block		EFI block device
+ *
+ * Reads of consecutive blocks that are queued together are coalesced
+ * into a single read from the SAN device, via a temporary buffer.
+ * Requests are removed from the queue before their completion events
+ * are signalled, since the caller's notification function may submit
+ * further requests.
+ */
+static void efi_block_step ( struct efi_block_data *block ) {
+	struct san_device *sandev = block->sandev;
+	struct efi_block_request *first;
+	struct efi_block_request *request;
+	struct efi_block_request *tmp;
+	LIST_HEAD ( batch );
+	EFI_LBA next_lba;
+	size_t offset;
+	size_t len;
+	void *buffer;
+	int rc;
+
+	/* Dequeue first request */
+	first = list_first_entry ( &block->requests, struct efi_block_request,
+				   list );
+	assert ( first != NULL );
+	list_del ( &first->list );
+
+	/* Flush requests write out any buffered writes */
+	if ( ! first->block_rw ) {
+		efi_block_busy++;
+		rc = sandev_flush ( sandev );
+		efi_block_busy--;
+		efi_block_complete ( first, rc );
+		return;
+	}
+
+	/* Gather any following reads of consecutive blocks */
+	len = first->len;
+	next_lba = ( first->lba + ( len / block->media.BlockSize ) );
+	list_for_each_entry_safe ( request, tmp, &block->requests, list ) {
+		if ( ( first->block_rw != block_read ) ||
+		     ( request->block_rw != block_read ) ||
+		     ( request->lba != next_lba ) ||
+		     ( ( len + request->len ) > EFI_BLOCK_COALESCE_MAX ) )
+			break;
+		list_del ( &request->list );
+		list_add_tail ( &request->list, &batch );
+		len += request->len;
+		next_lba += ( request->len / block->media.BlockSize );
+	}
+
+	/* Allocate temporary buffer for coalesced reads, if applicable */
+	buffer = NULL;
+	if ( ! list_empty ( &batch ) ) {
+		buffer = malloc ( len );
+		if ( ! buffer ) {
+			/* Return gathered requests to the queue */
+			list_splice ( &batch, &block->requests );
+			INIT_LIST_HEAD ( &batch );
+		}
+	}
+
+	/* Perform a single request directly */
+	if ( ! buffer ) {
+		rc = efi_block_rw ( sandev, first->lba, first->data,
+				    first->len, first->block_rw );
+		efi_block_complete ( first, rc );
+		return;
+	}
+
+	/* Perform coalesced read via temporary buffer */
+	DBGC2 ( sandev, "EFIBLK %#02x coalesced read LBA %#08llx+%#08zx\n",
+		sandev->drive, first->lba, len );
+	list_add ( &first->list, &batch );
+	rc = efi_block_rw ( sandev, first->lba, buffer, len, block_read );
+	offset = 0;
+	list_for_each_entry_safe ( request, tmp, &batch, list ) {
+		list_del ( &request->list );
+		if ( rc == 0 ) {
+			memcpy ( request->data, ( buffer + offset ),
+				 request->len );
+		}
+		offset += request->len;
+		efi_block_complete ( request, rc );
+	}
+	free ( buffer );
+}
+
+/**
+ * Process all pending asynchronous EFI block device requests
+ *
+ * @v block		EFI block device
+ */
+static void efi_block_drain ( struct efi_block_data *block ) {
+
+	while ( ! list_empty ( &block->requests ) )
+		efi_block_step ( block );
+}
+
+/**
+ * Schedule processing of asynchronous EFI block device requests
+ *
+ * @v block		EFI block device
+ */
+static void efi_block_schedule ( struct efi_block_data *block ) {
+	EFI_BOOT_SERVICES *bs = efi_systab->BootServices;
+
+	/* Process requests on the next timer tick */
+	bs->SetTimer ( block->event, TimerRelative, 0 );
+}
+
+/**
+ * Process asynchronous EFI block device requests (from timer event)
+ *
+ * @v event		EFI event
+ * @v context		EFI block device
+ */
+static VOID EFIAPI efi_block_notify ( EFI_EVENT event __unused,
+				      VOID *context ) {
+	struct efi_block_data *block = context;
+
+	/* Defer processing if a block device operation is in progress */
+	if ( efi_block_busy ) {
+		efi_block_schedule ( block );
+		return;
+	}
+
+	/* Process requests */
+	efi_snp_claim();
+	efi_block_drain ( block );
+	efi_snp_release();
+}
+
+/**
+ * Submit asynchronous EFI block device request
+ *
+ * @v block		EFI block device
+ * @v token		Completion token
+ * @v lba		Starting LBA
+ * @v len		Size of buffer
+ * @v data		Data buffer
+ * @v block_rw		Block read/write method, or NULL for a flush request
+ * @ret rc		Return status code
+ */
+static int efi_block_submit ( struct efi_block_data *block,
+			      EFI_BLOCK_IO2_TOKEN *token, EFI_LBA lba,
+			      size_t len, void *data,
+			      int ( * block_rw ) ( struct interface *control,
+						   struct interface *data,
+						   uint64_t lba,
+						   unsigned int count,
+						   userptr_t buffer,
+						   size_t len ) ) {
+	struct san_device *sandev = block->sandev;
+	struct efi_block_request *request;
+
+	/* Sanity check */
+	if ( ( len % block->media.BlockSize ) != 0 ) {
+		DBGC ( sandev, "EFIBLK %#02x impossible length %#zx\n",
+		       sandev->drive, len );
+		return -EINVAL;
+	}
+
+	/* Allocate and initialise request */
+	request = zalloc ( sizeof ( *request ) );
+	if ( ! request )
+		return -ENOMEM;
+	request->token = token;
+	request->lba = lba;
+	request->data = data;
+	request->len = len;
+	request->block_rw = block_rw;
+
+	/* Enqueue request and schedule processing */
+	list_add_tail ( &request->list, &block->requests );
+	efi_block_schedule ( block );
+
+	return 0;
+}
+
 /**
  * Reset EFI block device
  *
@@ -143,8 +420,11 @@ static EFI_STATUS EFIAPI efi_block_io_reset ( EFI_BLOCK_IO_PROTOCOL *block_io,
 	int rc;
 
 	DBGC2 ( sandev, "EFIBLK %#02x reset\n", sandev->drive );
+	efi_block_abort ( block, -ECANCELED );
 	efi_snp_claim();
+	efi_block_busy++;
 	rc = sandev_reset ( sandev );
+	efi_block_busy--;
 	efi_snp_release();
 	return EFIRC ( rc );
 }
@@ -170,6 +450,7 @@ efi_block_io_read ( EFI_BLOCK_IO_PROTOCOL *block_io, UINT32 media __unused,
 	DBGC2 ( sandev, "EFIBLK %#02x read LBA %#08llx to %p+%#08zx\n",
 		sandev->drive, lba, data, ( ( size_t ) len ) );
 	efi_snp_claim();
+	efi_block_drain ( block );
 	rc = efi_block_rw ( sandev, lba, data, len, block_read );
 	efi_snp_release();
 	return EFIRC ( rc );
@@ -196,6 +477,7 @@ efi_block_io_write ( EFI_BLOCK_IO_PROTOCOL *block_io, UINT32 media __unused,
 	DBGC2 ( sandev, "EFIBLK %#02x write LBA %#08llx from %p+%#08zx\n",
 		sandev->drive, lba, data, ( ( size_t ) len ) );
 	efi_snp_claim();
+	efi_block_drain ( block );
 	rc = efi_block_rw ( sandev, lba, data, len, block_write );
 	efi_snp_release();
 	return EFIRC ( rc );
@@ -212,11 +494,192 @@ efi_block_io_flush ( EFI_BLOCK_IO_PROTOCOL *block_io ) {
 	struct efi_block_data *block =
 		container_of ( block_io, struct efi_block_data, block_io );
 	struct san_device *sandev = block->sandev;
+	int rc;
 
 	DBGC2 ( sandev, "EFIBLK %#02x flush\n", sandev->drive );
 
-	/* Nothing to do */
-	return 0;
+	/* Complete any pending asynchronous requests */
+	efi_snp_claim();
+	efi_block_drain ( block );
+
+	/* Write out any buffered writes */
+	efi_block_busy++;
+	rc = sandev_flush ( sandev );
+	efi_block_busy--;
+	efi_snp_release();
+
+	return EFIRC ( rc );
+}
+
+/**
+ * Flush EFI block device before operating system handover
+ *
+ * @v event		EFI event
+ * @v context		EFI block device
+ *
+ * This is signalled before ExitBootServices() does any work, while
+ * boot services (including memory allocation and the network) remain
+ * usable.  The ExitBootServices() event itself is too late for any
+ * SAN device I/O.  Flushing may change the memory map, in which case
+ * ExitBootServices() will fail and the caller must retry it; the
+ * retry will find nothing left to flush.
+ */
+static VOID EFIAPI efi_block_handover ( EFI_EVENT event __unused,
+					VOID *context ) {
+	struct efi_block_data *block = context;
+
+	/* Write out any buffered writes (ignoring errors) */
+	efi_block_io_flush ( &block->block_io );
+}
+
+/**
+ * Create EFI block device operating system handover event
+ *
+ * @v block		EFI block device
+ *
+ * The before-ExitBootServices() event group exists only as of UEFI
+ * 2.8.  On older firmware, the SAN device is left without a handover
+ * flush, and so will not use write-back buffering.
+ */
+static void efi_block_create_handover ( struct efi_block_data *block ) {
+	EFI_BOOT_SERVICES *bs = efi_systab->BootServices;
+	struct san_device *sandev = block->sandev;
+	EFI_STATUS efirc;
+	int rc;
+
+	/* Check that firmware will signal the event group */
+	if ( efi_systab->Hdr.Revision < EFI_BLOCK_HANDOVER_REVISION ) {
+		DBGC ( sandev, "EFIBLK %#02x has no handover event on EFI "
+		       "%d.%02d\n", sandev->drive,
+		       ( efi_systab->Hdr.Revision >> 16 ),
+		       ( efi_systab->Hdr.Revision & 0xffff ) );
+		return;
+	}
+
+	/* Create event */
+	if ( ( efirc = bs->CreateEventEx ( EVT_NOTIFY_SIGNAL, TPL_CALLBACK,
+					   efi_block_handover, block,
+					   &efi_before_exit_boot_services_guid,
+					   &block->handover ) ) != 0 ) {
+		rc = -EEFI ( efirc );
+		DBGC ( sandev, "EFIBLK %#02x could not create handover event: "
+		       "%s\n", sandev->drive, strerror ( rc ) );
+		block->handover = NULL;
+		return;
+	}
+	sandev->handover_flush = 1;
+}
+
+/**
+ * Close EFI block device operating system handover event
+ *
+ * @v block		EFI block device
+ */
+static void efi_block_close_handover ( struct efi_block_data *block ) {
+	EFI_BOOT_SERVICES *bs = efi_systab->BootServices;
+
+	if ( block->handover )
+		bs->CloseEvent ( block->handover );
+}
+
+/**
+ * Reset EFI block device (via Block I/O 2 protocol)
+ *
+ * @v block_io2		Block I/O 2 protocol
+ * @v verify		Perform extended verification
+ * @ret efirc		EFI status code
+ */
+static EFI_STATUS EFIAPI
+efi_block_io2_reset ( EFI_BLOCK_IO2_PROTOCOL *block_io2, BOOLEAN verify ) {
+	struct efi_block_data *block =
+		container_of ( block_io2, struct efi_block_data, block_io2 );
+
+	return efi_block_io_reset ( &block->block_io, verify );
+}
+
+/**
+ * Read from EFI block device (via Block I/O 2 protocol)
+ *
+ * @v block_io2		Block I/O 2 protocol
+ * @v media		Media identifier
+ * @v lba		Starting LBA
+ * @v token		Completion token, or NULL
+ * @v len		Size of buffer
+ * @v data		Data buffer
+ * @ret efirc		EFI status code
+ */
+static EFI_STATUS EFIAPI
+efi_block_io2_read ( EFI_BLOCK_IO2_PROTOCOL *block_io2, UINT32 media,
+		     EFI_LBA lba, EFI_BLOCK_IO2_TOKEN *token, UINTN len,
+		     VOID *data ) {
+	struct efi_block_data *block =
+		container_of ( block_io2, struct efi_block_data, block_io2 );
+	struct san_device *sandev = block->sandev;
+	int rc;
+
+	/* Perform blocking I/O if no completion event is provided */
+	if ( ! ( token && token->Event ) )
+		return efi_block_io_read ( &block->block_io, media, lba,
+					   len, data );
+
+	DBGC2 ( sandev, "EFIBLK %#02x async read LBA %#08llx to %p+%#08zx\n",
+		sandev->drive, lba, data, ( ( size_t ) len ) );
+	rc = efi_block_submit ( block, token, lba, len, data, block_read );
+	return EFIRC ( rc );
+}
+
+/**
+ * Write to EFI block device (via Block I/O 2 protocol)
+ *
+ * @v block_io2		Block I/O 2 protocol
+ * @v media		Media identifier
+ * @v lba		Starting LBA
+ * @v token		Completion token, or NULL
+ * @v len		Size of buffer
+ * @v data		Data buffer
+ * @ret efirc		EFI status code
+ */
+static EFI_STATUS EFIAPI
+efi_block_io2_write ( EFI_BLOCK_IO2_PROTOCOL *block_io2, UINT32 media,
+		      EFI_LBA lba, EFI_BLOCK_IO2_TOKEN *token, UINTN len,
+		      VOID *data ) {
+	struct efi_block_data *block =
+		container_of ( block_io2, struct efi_block_data, block_io2 );
+	struct san_device *sandev = block->sandev;
+	int rc;
+
+	/* Perform blocking I/O if no completion event is provided */
+	if ( ! ( token && token->Event ) )
+		return efi_block_io_write ( &block->block_io, media, lba,
+					    len, data );
+
+	DBGC2 ( sandev, "EFIBLK %#02x async write LBA %#08llx from "
+		"%p+%#08zx\n", sandev->drive, lba, data, ( ( size_t ) len ) );
+	rc = efi_block_submit ( block, token, lba, len, data, block_write );
+	return EFIRC ( rc );
+}
+
+/**
+ * Flush data to EFI block device (via Block I/O 2 protocol)
+ *
+ * @v block_io2		Block I/O 2 protocol
+ * @v token		Completion token, or NULL
+ * @ret efirc		EFI status code
+ */
+static EFI_STATUS EFIAPI
+efi_block_io2_flush ( EFI_BLOCK_IO2_PROTOCOL *block_io2,
+		      EFI_BLOCK_IO2_TOKEN *token ) {
+	struct efi_block_data *block =
+		container_of ( block_io2, struct efi_block_data, block_io2 );
+	int rc;
+
+	/* Perform blocking flush if no completion event is provided */
+	if ( ! ( token && token->Event ) )
+		return efi_block_io_flush ( &block->block_io );
+
+	/* Complete flush once all preceding requests have completed */
+	rc = efi_block_submit ( block, token, 0, 0, NULL, NULL );
+	return EFIRC ( rc );
 }
 
 /**
@@ -245,11 +708,13 @@ static void efi_block_connect ( struct san_device *sandev ) {
 /**
  * Hook EFI block device
  *
- * @v uri		URI
+ * @v uris		List of URIs
+ * @v count		Number of URIs
  * @v drive		Drive number
  * @ret drive		Drive number, or negative error
  */
-static int efi_block_hook ( struct uri *uri, unsigned int drive ) {
+static int efi_block_hook ( struct uri **uris, unsigned int count,
+			    unsigned int drive ) {
 	EFI_BOOT_SERVICES *bs = efi_systab->BootServices;
 	EFI_DEVICE_PATH_PROTOCOL *end;
 	struct efi_block_vendor_path *vendor;
@@ -274,14 +739,14 @@ static int efi_block_hook ( struct uri *uri, unsigned int drive ) {
 
 	/* Calculate length of private data */
 	prefix_len = efi_devpath_len ( snpdev->path );
-	uri_len = format_uri ( uri, NULL, 0 );
+	uri_len = format_uri ( uris[0], NULL, 0 );
 	vendor_len = ( sizeof ( *vendor ) +
 		       ( ( uri_len + 1 /* NUL */ ) * sizeof ( wchar_t ) ) );
 	len = ( sizeof ( *block ) + uri_len + 1 /* NUL */ + prefix_len +
 		vendor_len + sizeof ( *end ) );
 
 	/* Allocate and initialise structure */
-	sandev = alloc_sandev ( uri, len );
+	sandev = alloc_sandev ( uris, count, len );
 	if ( ! sandev ) {
 		rc = -ENOMEM;
 		goto err_alloc;
@@ -297,6 +762,12 @@ static int efi_block_hook ( struct uri *uri, unsigned int drive ) {
 	block->block_io.ReadBlocks = efi_block_io_read;
 	block->block_io.WriteBlocks = efi_block_io_write;
 	block->block_io.FlushBlocks = efi_block_io_flush;
+	block->block_io2.Media = &block->media;
+	block->block_io2.Reset = efi_block_io2_reset;
+	block->block_io2.ReadBlocksEx = efi_block_io2_read;
+	block->block_io2.WriteBlocksEx = efi_block_io2_write;
+	block->block_io2.FlushBlocksEx = efi_block_io2_flush;
+	INIT_LIST_HEAD ( &block->requests );
 	uri_buf = ( ( ( void * ) block ) + sizeof ( *block ) );
 	block->path = ( ( ( void * ) uri_buf ) + uri_len + 1 /* NUL */ );
 
@@ -309,7 +780,7 @@ static int efi_block_hook ( struct uri *uri, unsigned int drive ) {
 	vendor->vendor.Header.Length[1] = ( vendor_len >> 8 );
 	memcpy ( &vendor->vendor.Guid, &ipxe_block_device_path_guid,
 		 sizeof ( vendor->vendor.Guid ) );
-	format_uri ( uri, uri_buf, ( uri_len + 1 /* NUL */ ) );
+	format_uri ( uris[0], uri_buf, ( uri_len + 1 /* NUL */ ) );
 	efi_snprintf ( vendor->uri, ( uri_len + 1 /* NUL */ ), "%s", uri_buf );
 	end = ( ( ( void * ) vendor ) + vendor_len );
 	end->Type = END_DEVICE_PATH_TYPE;
@@ -318,6 +789,9 @@ static int efi_block_hook ( struct uri *uri, unsigned int drive ) {
 	DBGC ( sandev, "EFIBLK %#02x has device path %s\n",
 	       sandev->drive, efi_devpath_text ( block->path ) );
 
+	/* Create handover event (before any write-back buffer exists) */
+	efi_block_create_handover ( block );
+
 	/* Register SAN device */
 	if ( ( rc = register_sandev ( sandev ) ) != 0 ) {
 		DBGC ( sandev, "EFIBLK %#02x could not register: %s\n",
@@ -331,10 +805,21 @@ static int efi_block_hook ( struct uri *uri, unsigned int drive ) {
 	block->media.LastBlock =
 		( ( sandev->capacity.blocks >> sandev->blksize_shift ) - 1 );
 
+	/* Create asynchronous request processing event */
+	if ( ( efirc = bs->CreateEvent ( ( EVT_TIMER | EVT_NOTIFY_SIGNAL ),
+					 TPL_CALLBACK, efi_block_notify, block,
+					 &block->event ) ) != 0 ) {
+		rc = -EEFI ( efirc );
+		DBGC ( sandev, "EFIBLK %#02x could not create event: %s\n",
+		       sandev->drive, strerror ( rc ) );
+		goto err_event;
+	}
+
 	/* Install protocols */
 	if ( ( efirc = bs->InstallMultipleProtocolInterfaces (
 			&block->handle,
 			&efi_block_io_protocol_guid, &block->block_io,
+			&efi_block_io2_protocol_guid, &block->block_io2,
 			&efi_device_path_protocol_guid, block->path,
 			NULL ) ) != 0 ) {
 		rc = -EEFI ( efirc );
@@ -351,10 +836,14 @@ static int efi_block_hook ( struct uri *uri, unsigned int drive ) {
 	bs->UninstallMultipleProtocolInterfaces (
 			block->handle,
 			&efi_block_io_protocol_guid, &block->block_io,
+			&efi_block_io2_protocol_guid, &block->block_io2,
 			&efi_device_path_protocol_guid, block->path, NULL );
  err_install:
+	bs->CloseEvent ( block->event );
+ err_event:
 	unregister_sandev ( sandev );
  err_register:
+	efi_block_close_handover ( block );
 	sandev_put ( sandev );
  err_alloc:
  err_no_snpdev:
@@ -383,10 +872,17 @@ static void efi_block_unhook ( unsigned int drive ) {
 	bs->UninstallMultipleProtocolInterfaces (
 			block->handle,
 			&efi_block_io_protocol_guid, &block->block_io,
+			&efi_block_io2_protocol_guid, &block->block_io2,
 			&efi_device_path_protocol_guid, block->path, NULL );
 
-	/* Unregister SAN device */
+	/* Abort any pending asynchronous requests */
+	bs->SetTimer ( block->event, TimerCancel, 0 );
+	bs->CloseEvent ( block->event );
+	efi_block_abort ( block, -ECANCELED );
+
+	/* Unregister SAN device (flushing any buffered writes) */
 	unregister_sandev ( sandev );
+	efi_block_close_handover ( block );
 
 	/* Drop reference to drive */
 	sandev_put ( sandev );
@@ -0,0 +1,896 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <assert.h>
+#include <ipxe/refcnt.h>
+#include <ipxe/xfer.h>
+#include <ipxe/open.h>
+#include <ipxe/uri.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/process.h>
+#include <ipxe/http.h>
+#include <ipxe/crypto.h>
+#include <ipxe/sha256.h>
+#include <ipxe/base16.h>
+#include <ipxe/efi/efi.h>
+#include <ipxe/efi/efi_strings.h>
+#include <ipxe/efi/Protocol/SimpleFileSystem.h>
+
+/** @file
+ *
+ * EFI local disk download cache
+ *
+ * A URI of the form "cache:<uri>" retrieves <uri> via a read-through
+ * cache held in the "\ipxe\cache" directory of any local filesystem.
+ * Caching is enabled on a given machine simply by creating this
+ * directory; in its absence the origin URI is opened directly.
+ *
+ * Each cached file is named using a hash of its origin URI, and is
+ * stored alongside the strong entity tag reported by the origin
+ * server.  Every use of a cached file issues a conditional HTTP GET
+ * request carrying this entity tag: if the server responds with "304
+ * Not Modified" then the file is served from the local disk,
+ * otherwise the new content is downloaded (and the cache updated)
+ * within the same request.  Files without a strong entity tag, or
+ * which are reached via a redirection, are never cached.
+ */
+
+/** Cache directory */
+#define EFI_CACHE_DIR "\\ipxe\\cache"
+
+/** Length of cache key (in bytes of URI hash) */
+#define EFI_CACHE_KEY_LEN 16
+
+/** Suffix of entity tag files */
+#define EFI_CACHE_TAG_SUFFIX ".tag"
+
+/** Maximum length of a cacheable entity tag */
+#define EFI_CACHE_TAG_MAX_LEN 128
+
+/** Read blocksize */
+#define EFI_CACHE_BLKSIZE 4096
+
+/** Cache states */
+enum efi_cache_state {
+	/** Awaiting response to conditional request */
+	EFI_CACHE_CHECK = 0,
+	/** Origin server has confirmed that cached file is current */
+	EFI_CACHE_VALID,
+	/** Serving file from local disk */
+	EFI_CACHE_HIT,
+	/** Downloading file from origin server */
+	EFI_CACHE_FETCH,
+};
+
+/** A cached download */
+struct efi_cache {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Origin server interface */
+	struct interface origin;
+	/** Local disk process */
+	struct process process;
+
+	/** Origin URI */
+	struct uri *uri;
+	/** State */
+	enum efi_cache_state state;
+	/** Cache key (as hex string) */
+	char key[ EFI_CACHE_KEY_LEN * 2 + 1 /* NUL */ ];
+	/** Entity tag reported by origin server (if any) */
+	char *etag;
+
+	/** Cache directory (if any) */
+	EFI_FILE_PROTOCOL *dir;
+	/** Cached file (if open) */
+	EFI_FILE_PROTOCOL *file;
+	/** Length of cached file */
+	size_t len;
+	/** Current position within downloaded file */
+	size_t pos;
+};
+
+/**
+ * Free cached download
+ *
+ * @v refcnt		Reference count
+ */
+static void efi_cache_free ( struct refcnt *refcnt ) {
+	struct efi_cache *cache =
+		container_of ( refcnt, struct efi_cache, refcnt );
+
+	uri_put ( cache->uri );
+	free ( cache->etag );
+	free ( cache );
+}
+
+/**
+ * Check for a cacheable entity tag
+ *
+ * @v etag		Entity tag, or NULL
+ * @ret cacheable	Entity tag is cacheable
+ *
+ * Weak entity tags (prefixed with "W/") do not guarantee that the
+ * content is byte-for-byte identical, and so cannot be used.
+ */
+static int efi_cache_is_cacheable ( const char *etag ) {
+
+	return ( etag && ( etag[0] == '"' ) &&
+		 ( strlen ( etag ) <= EFI_CACHE_TAG_MAX_LEN ) );
+}
+
+/**
+ * Open file within cache directory
+ *
+ * @v cache		Cached download
+ * @v suffix		File name suffix
+ * @v mode		Open mode
+ * @v file		File handle to fill in
+ * @ret rc		Return status code
+ */
+static int efi_cache_open_file ( struct efi_cache *cache, const char *suffix,
+				 UINT64 mode, EFI_FILE_PROTOCOL **file ) {
+	CHAR16 name[ sizeof ( cache->key ) + sizeof ( EFI_CACHE_TAG_SUFFIX ) ];
+	EFI_STATUS efirc;
+	int rc;
+
+	/* Construct file name */
+	efi_snprintf ( name, ( sizeof ( name ) / sizeof ( name[0] ) ),
+		       "%s%s", cache->key, suffix );
+
+	/* Open file */
+	if ( ( efirc = cache->dir->Open ( cache->dir, file, name,
+					  mode, 0 ) ) != 0 ) {
+		rc = -EEFI ( efirc );
+		DBGC2 ( cache, "CACHE %p could not open %ls: %s\n",
+			cache, name, strerror ( rc ) );
+		*file = NULL;
+		return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * Delete file within cache directory
+ *
+ * @v cache		Cached download
+ * @v suffix		File name suffix
+ */
+static void efi_cache_delete ( struct efi_cache *cache, const char *suffix ) {
+	EFI_FILE_PROTOCOL *file;
+
+	if ( efi_cache_open_file ( cache, suffix, ( EFI_FILE_MODE_READ |
+						    EFI_FILE_MODE_WRITE ),
+				   &file ) == 0 ) {
+		file->Delete ( file );
+	}
+}
+
+/**
+ * Abandon partially cached file
+ *
+ * @v cache		Cached download
+ */
+static void efi_cache_abandon ( struct efi_cache *cache ) {
+
+	/* Do nothing unless we are writing to the cache */
+	if ( ! ( cache->file && ( cache->state == EFI_CACHE_FETCH ) ) )
+		return;
+
+	/* Delete partial file */
+	DBGC ( cache, "CACHE %p not caching %s\n", cache, cache->key );
+	cache->file->Delete ( cache->file );
+	cache->file = NULL;
+}
+
+/**
+ * Close cached download
+ *
+ * @v cache		Cached download
+ * @v rc		Reason for close
+ */
+static void efi_cache_close ( struct efi_cache *cache, int rc ) {
+
+	/* Stop process */
+	process_del ( &cache->process );
+
+	/* Discard any partially cached file */
+	efi_cache_abandon ( cache );
+
+	/* Close files */
+	if ( cache->file ) {
+		cache->file->Close ( cache->file );
+		cache->file = NULL;
+	}
+	if ( cache->dir ) {
+		cache->dir->Close ( cache->dir );
+		cache->dir = NULL;
+	}
+
+	/* Shut down interfaces */
+	intf_shutdown ( &cache->origin, rc );
+	intf_shutdown ( &cache->xfer, rc );
+}
+
+/**
+ * Read cached entity tag
+ *
+ * @v cache		Cached download
+ * @v etag		Buffer to fill in
+ * @v len		Length of buffer
+ * @ret rc		Return status code
+ */
+static int efi_cache_read_tag ( struct efi_cache *cache, char *etag,
+				size_t len ) {
+	EFI_FILE_PROTOCOL *file;
+	UINTN size;
+	EFI_STATUS efirc;
+	int rc;
+
+	/* Read entity tag */
+	if ( ( rc = efi_cache_open_file ( cache, EFI_CACHE_TAG_SUFFIX,
+					  EFI_FILE_MODE_READ, &file ) ) != 0 )
+		return rc;
+	size = ( len - 1 /* NUL */ );
+	efirc = file->Read ( file, &size, etag );
+	file->Close ( file );
+	if ( efirc != 0 )
+		return -EEFI ( efirc );
+	etag[size] = '\0';
+
+	/* Fail unless entity tag is cacheable */
+	if ( ! efi_cache_is_cacheable ( etag ) )
+		return -EINVAL;
+
+	return 0;
+}
+
+/**
+ * Open cached file, if still valid
+ *
+ * @v cache		Cached download
+ * @ret rc		Return status code
+ */
+static int efi_cache_open_hit ( struct efi_cache *cache ) {
+	EFI_FILE_PROTOCOL *file;
+	char etag[ EFI_CACHE_TAG_MAX_LEN + 1 /* NUL */ ];
+	UINT64 len;
+	EFI_STATUS efirc;
+	int rc;
+
+	/* Fail unless origin server reported a cacheable entity tag */
+	if ( ! efi_cache_is_cacheable ( cache->etag ) )
+		return -ENOENT;
+
+	/* Read cached entity tag */
+	if ( ( rc = efi_cache_read_tag ( cache, etag, sizeof ( etag ) ) ) != 0 )
+		return rc;
+
+	/* Check that cached file is still current.  The origin server
+	 * may use weak comparison when evaluating "If-None-Match", so
+	 * the entity tag in the "304 Not Modified" response must also
+	 * be checked.
+	 */
+	if ( strcmp ( etag, cache->etag ) != 0 ) {
+		DBGC ( cache, "CACHE %p %s is stale (%s, now %s)\n",
+		       cache, cache->key, etag, cache->etag );
+		return -ESTALE;
+	}
+
+	/* Open cached file */
+	if ( ( rc = efi_cache_open_file ( cache, "", EFI_FILE_MODE_READ,
+					  &file ) ) != 0 )
+		return rc;
+
+	/* Determine file length */
+	if ( ( ( efirc = file->SetPosition ( file, ~( ( UINT64 ) 0 ) ) ) != 0)||
+	     ( ( efirc = file->GetPosition ( file, &len ) ) != 0 ) ||
+	     ( ( efirc = file->SetPosition ( file, 0 ) ) != 0 ) ) {
+		rc = -EEFI ( efirc );
+		DBGC ( cache, "CACHE %p could not size %s: %s\n",
+		       cache, cache->key, strerror ( rc ) );
+		file->Close ( file );
+		return rc;
+	}
+
+	/* Record cached file */
+	cache->file = file;
+	cache->len = len;
+
+	return 0;
+}
+
+/**
+ * Start writing downloaded file to cache
+ *
+ * @v cache		Cached download
+ */
+static void efi_cache_begin ( struct efi_cache *cache ) {
+
+	/* Discard any stale cached file.  Delete the entity tag
+	 * first, so that an interrupted update can never leave a
+	 * partial file that appears to be valid.
+	 */
+	efi_cache_delete ( cache, EFI_CACHE_TAG_SUFFIX );
+	efi_cache_delete ( cache, "" );
+
+	/* Create cached file (failure is not fatal) */
+	efi_cache_open_file ( cache, "", ( EFI_FILE_MODE_READ |
+					   EFI_FILE_MODE_WRITE |
+					   EFI_FILE_MODE_CREATE ),
+			      &cache->file );
+	cache->state = EFI_CACHE_FETCH;
+}
+
+/**
+ * Download afresh from origin server
+ *
+ * @v cache		Cached download
+ * @ret rc		Return status code
+ */
+static int efi_cache_refetch ( struct efi_cache *cache ) {
+	int rc;
+
+	/* Forget entity tag from previous response */
+	free ( cache->etag );
+	cache->etag = NULL;
+
+	/* Start writing to cache */
+	efi_cache_begin ( cache );
+
+	/* Open origin URI */
+	if ( ( rc = xfer_open_uri ( &cache->origin, cache->uri ) ) != 0 ) {
+		DBGC ( cache, "CACHE %p could not open origin: %s\n",
+		       cache, strerror ( rc ) );
+		return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * Commit downloaded file to cache
+ *
+ * @v cache		Cached download
+ */
+static void efi_cache_commit ( struct efi_cache *cache ) {
+	EFI_FILE_PROTOCOL *file;
+	UINTN size;
+	EFI_STATUS efirc;
+	int rc;
+
+	/* Do nothing unless we are writing to the cache */
+	if ( ! cache->file )
+		return;
+
+	/* Abandon file unless it has a cacheable entity tag */
+	if ( ! efi_cache_is_cacheable ( cache->etag ) ) {
+		efi_cache_abandon ( cache );
+		return;
+	}
+
+	/* Flush and close cached file */
+	if ( ( efirc = cache->file->Flush ( cache->file ) ) != 0 ) {
+		rc = -EEFI ( efirc );
+		DBGC ( cache, "CACHE %p could not flush %s: %s\n",
+		       cache, cache->key, strerror ( rc ) );
+		efi_cache_abandon ( cache );
+		return;
+	}
+	cache->file->Close ( cache->file );
+	cache->file = NULL;
+
+	/* Record entity tag */
+	if ( ( rc = efi_cache_open_file ( cache, EFI_CACHE_TAG_SUFFIX,
+					  ( EFI_FILE_MODE_READ |
+					    EFI_FILE_MODE_WRITE |
+					    EFI_FILE_MODE_CREATE ),
+					  &file ) ) != 0 )
+		goto err_open;
+	size = strlen ( cache->etag );
+	if ( ( efirc = file->Write ( file, &size, cache->etag ) ) != 0 ) {
+		rc = -EEFI ( efirc );
+		goto err_write;
+	}
+	if ( ( efirc = file->Flush ( file ) ) != 0 ) {
+		rc = -EEFI ( efirc );
+		goto err_flush;
+	}
+	file->Close ( file );
+	DBGC ( cache, "CACHE %p cached %s (%zd bytes) with tag %s\n",
+	       cache, cache->key, cache->pos, cache->etag );
+
+	return;
+
+ err_flush:
+ err_write:
+	file->Delete ( file );
+ err_open:
+	DBGC ( cache, "CACHE %p could not record tag for %s: %s\n",
+	       cache, cache->key, strerror ( rc ) );
+	efi_cache_delete ( cache, "" );
+}
+
+/**
+ * Transfer data from local disk
+ *
+ * @v cache		Cached download
+ */
+static void efi_cache_step ( struct efi_cache *cache ) {
+	EFI_FILE_PROTOCOL *file = cache->file;
+	struct io_buffer *iobuf = NULL;
+	size_t remaining;
+	size_t frag_len;
+	UINTN size;
+	EFI_STATUS efirc;
+	int rc;
+
+	/* Wait until data transfer interface is ready */
+	if ( ! xfer_window ( &cache->xfer ) )
+		return;
+
+	/* Presize receive buffer */
+	remaining = cache->len;
+	xfer_presize ( &cache->xfer, remaining );
+
+	/* Get file contents */
+	while ( remaining ) {
+
+		/* Calculate length for this fragment */
+		frag_len = remaining;
+		if ( frag_len > EFI_CACHE_BLKSIZE )
+			frag_len = EFI_CACHE_BLKSIZE;
+
+		/* Allocate I/O buffer */
+		iobuf = xfer_alloc_iob ( &cache->xfer, frag_len );
+		if ( ! iobuf ) {
+			rc = -ENOMEM;
+			goto err;
+		}
+
+		/* Read block */
+		size = frag_len;
+		if ( ( efirc = file->Read ( file, &size, iobuf->data ) ) != 0 ){
+			rc = -EEFI ( efirc );
+			DBGC ( cache, "CACHE %p could not read from %s: %s\n",
+			       cache, cache->key, strerror ( rc ) );
+			goto err;
+		}
+		assert ( size <= frag_len );
+		iob_put ( iobuf, size );
+
+		/* Deliver data */
+		if ( ( rc = xfer_deliver_iob ( &cache->xfer,
+					       iob_disown ( iobuf ) ) ) != 0 ) {
+			DBGC ( cache, "CACHE %p could not deliver data: %s\n",
+			       cache, strerror ( rc ) );
+			goto err;
+		}
+
+		/* Move to next block */
+		remaining -= frag_len;
+	}
+
+	/* Close download */
+	efi_cache_close ( cache, 0 );
+
+	return;
+
+ err:
+	free_iob ( iobuf );
+	efi_cache_close ( cache, rc );
+}
+
+/**
+ * Handle data transfer window change
+ *
+ * @v cache		Cached download
+ */
+static void efi_cache_window_changed ( struct efi_cache *cache ) {
+
+	/* Resume local disk process or pass through to origin */
+	if ( cache->state == EFI_CACHE_HIT ) {
+		process_add ( &cache->process );
+	} else {
+		xfer_window_changed ( &cache->origin );
+	}
+}
+
+/** Data transfer interface operations */
+static struct interface_operation efi_cache_xfer_operations[] = {
+	INTF_OP ( xfer_window_changed, struct efi_cache *,
+		  efi_cache_window_changed ),
+	INTF_OP ( intf_close, struct efi_cache *, efi_cache_close ),
+};
+
+/** Data transfer interface descriptor */
+static struct interface_descriptor efi_cache_xfer_desc =
+	INTF_DESC ( struct efi_cache, xfer, efi_cache_xfer_operations );
+
+/**
+ * Record entity tag reported by origin server
+ *
+ * @v cache		Cached download
+ * @v etag		Entity tag
+ * @ret rc		Return status code
+ */
+static int efi_cache_etag ( struct efi_cache *cache, const char *etag ) {
+
+	/* Record entity tag (failure is not fatal) */
+	free ( cache->etag );
+	cache->etag = strdup ( etag );
+
+	return 0;
+}
+
+/**
+ * Handle confirmation that cached file is current
+ *
+ * @v cache		Cached download
+ * @ret rc		Return status code
+ */
+static int efi_cache_not_modified ( struct efi_cache *cache ) {
+
+	/* Serve from local disk once origin server connection closes */
+	cache->state = EFI_CACHE_VALID;
+
+	return 0;
+}
+
+/**
+ * Receive data from origin server
+ *
+ * @v cache		Cached download
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int efi_cache_deliver ( struct efi_cache *cache,
+			       struct io_buffer *iobuf,
+			       struct xfer_metadata *meta ) {
+	size_t len = iob_len ( iobuf );
+	UINTN size = len;
+	EFI_STATUS efirc;
+	int rc;
+
+	/* Start writing to cache on receiving new content */
+	if ( cache->state == EFI_CACHE_CHECK )
+		efi_cache_begin ( cache );
+
+	/* Ignore any content accompanying a confirmation */
+	if ( cache->state != EFI_CACHE_FETCH ) {
+		free_iob ( iobuf );
+		return 0;
+	}
+
+	/* Write to cached file, if applicable */
+	if ( cache->file ) {
+		if ( ( rc = xfer_check_order ( meta, &cache->pos,
+					       len ) ) != 0 ) {
+			DBGC ( cache, "CACHE %p received out-of-order data\n",
+			       cache );
+			efi_cache_abandon ( cache );
+		} else if ( len &&
+			    ( ( efirc = cache->file->Write ( cache->file,
+							     &size,
+							     iobuf->data ) )
+			      != 0 ) ) {
+			rc = -EEFI ( efirc );
+			DBGC ( cache, "CACHE %p could not write to %s: %s\n",
+			       cache, cache->key, strerror ( rc ) );
+			efi_cache_abandon ( cache );
+		}
+	}
+
+	/* Pass through data */
+	return xfer_deliver ( &cache->xfer, iob_disown ( iobuf ), meta );
+}
+
+/**
+ * Check origin server flow control window
+ *
+ * @v cache		Cached download
+ * @ret len		Length of window
+ */
+static size_t efi_cache_window ( struct efi_cache *cache ) {
+
+	return xfer_window ( &cache->xfer );
+}
+
+/**
+ * Handle redirection from origin server
+ *
+ * @v cache		Cached download
+ * @v type		New location type
+ * @v args		Remaining arguments depend upon location type
+ * @ret rc		Return status code
+ */
+static int efi_cache_vredirect ( struct efi_cache *cache, int type,
+				 va_list args ) {
+	int rc;
+
+	/* Never cache a redirected file, since the redirection itself
+	 * may change without altering the original entity tag.
+	 */
+	efi_cache_abandon ( cache );
+	cache->state = EFI_CACHE_FETCH;
+
+	/* Reopen at new location */
+	if ( ( rc = xfer_vreopen ( &cache->origin, type, args ) ) != 0 )
+		return rc;
+	xfer_window_changed ( &cache->origin );
+
+	return 0;
+}
+
+/**
+ * Handle origin server close
+ *
+ * @v cache		Cached download
+ * @v rc		Reason for close
+ */
+static void efi_cache_origin_close ( struct efi_cache *cache, int rc ) {
+
+	/* Restart interface */
+	intf_restart ( &cache->origin, rc );
+
+	/* Handle completion according to current state */
+	switch ( cache->state ) {
+	case EFI_CACHE_CHECK:
+		/* Cache any successful response with no content */
+		if ( rc == 0 ) {
+			efi_cache_begin ( cache );
+			efi_cache_commit ( cache );
+		}
+		break;
+	case EFI_CACHE_VALID:
+		if ( rc != 0 )
+			break;
+		/* Serve from local disk if cached file is still valid */
+		if ( efi_cache_open_hit ( cache ) == 0 ) {
+			DBGC ( cache, "CACHE %p serving %s from cache\n",
+			       cache, cache->key );
+			cache->state = EFI_CACHE_HIT;
+			process_add ( &cache->process );
+			return;
+		}
+		/* Otherwise, download afresh from origin server */
+		if ( ( rc = efi_cache_refetch ( cache ) ) != 0 )
+			break;
+		return;
+	case EFI_CACHE_FETCH:
+		/* Commit successfully downloaded file to cache */
+		if ( rc == 0 )
+			efi_cache_commit ( cache );
+		break;
+	default:
+		break;
+	}
+
+	/* Close download */
+	efi_cache_close ( cache, rc );
+}
+
+/** Origin server interface operations */
+static struct interface_operation efi_cache_origin_operations[] = {
+	INTF_OP ( http_etag, struct efi_cache *, efi_cache_etag ),
+	INTF_OP ( http_not_modified, struct efi_cache *,
+		  efi_cache_not_modified ),
+	INTF_OP ( xfer_deliver, struct efi_cache *, efi_cache_deliver ),
+	INTF_OP ( xfer_window, struct efi_cache *, efi_cache_window ),
+	INTF_OP ( xfer_vredirect, struct efi_cache *, efi_cache_vredirect ),
+	INTF_OP ( intf_close, struct efi_cache *, efi_cache_origin_close ),
+};
+
+/** Origin server interface descriptor */
+static struct interface_descriptor efi_cache_origin_desc =
+	INTF_DESC ( struct efi_cache, origin, efi_cache_origin_operations );
+
+/** Process descriptor */
+static struct process_descriptor efi_cache_process_desc =
+	PROC_DESC_ONCE ( struct efi_cache, process, efi_cache_step );
+
+/**
+ * Open cache directory
+ *
+ * @v cache		Cached download
+ * @ret rc		Return status code
+ */
+static int efi_cache_open_dir ( struct efi_cache *cache ) {
+	EFI_BOOT_SERVICES *bs = efi_systab->BootServices;
+	EFI_GUID *protocol = &efi_simple_file_system_protocol_guid;
+	union {
+		void *interface;
+		EFI_SIMPLE_FILE_SYSTEM_PROTOCOL *fs;
+	} u;
+	CHAR16 path[ sizeof ( EFI_CACHE_DIR ) ];
+	EFI_FILE_PROTOCOL *root;
+	EFI_FILE_PROTOCOL *dir;
+	EFI_HANDLE *handles;
+	EFI_HANDLE device;
+	UINTN num_handles;
+	UINTN i;
+	EFI_STATUS efirc;
+	int rc;
+
+	/* Construct directory path */
+	efi_snprintf ( path, ( sizeof ( path ) / sizeof ( path[0] ) ),
+		       "%s", EFI_CACHE_DIR );
+
+	/* Locate all filesystem handles */
+	if ( ( efirc = bs->LocateHandleBuffer ( ByProtocol, protocol, NULL,
+						&num_handles,
+						&handles ) ) != 0 ) {
+		rc = -EEFI ( efirc );
+		DBGC ( cache, "CACHE %p could not enumerate handles: %s\n",
+		       cache, strerror ( rc ) );
+		return rc;
+	}
+
+	/* Use first filesystem containing a cache directory */
+	for ( i = 0 ; i < num_handles ; i++ ) {
+		device = handles[i];
+
+		/* Open root directory */
+		if ( ( efirc = bs->OpenProtocol ( device, protocol,
+						  &u.interface,
+						  efi_image_handle, device,
+					EFI_OPEN_PROTOCOL_GET_PROTOCOL ) ) !=0 )
+			continue;
+		efirc = u.fs->OpenVolume ( u.fs, &root );
+		bs->CloseProtocol ( device, protocol, efi_image_handle,
+				    device );
+		if ( efirc != 0 )
+			continue;
+
+		/* Open cache directory */
+		efirc = root->Open ( root, &dir, path, ( EFI_FILE_MODE_READ |
+							 EFI_FILE_MODE_WRITE ),
+				     0 );
+		root->Close ( root );
+		if ( efirc == 0 ) {
+			DBGC ( cache, "CACHE %p using %s\n",
+			       cache, efi_handle_name ( device ) );
+			cache->dir = dir;
+			break;
+		}
+	}
+
+	/* Free handles */
+	bs->FreePool ( handles );
+
+	return ( cache->dir ? 0 : -ENOENT );
+}
+
+/**
+ * Check if origin URI may be cached
+ *
+ * @v uri		Origin URI
+ * @ret cacheable	Origin URI may be cached
+ */
+static int efi_cache_uri_is_cacheable ( struct uri *uri ) {
+
+	/* Only HTTP(S) servers provide entity tags */
+	return ( uri->scheme &&
+		 ( ( strcasecmp ( uri->scheme, "http" ) == 0 ) ||
+		   ( strcasecmp ( uri->scheme, "https" ) == 0 ) ) );
+}
+
+/**
+ * Open cached download
+ *
+ * @v xfer		Data transfer interface
+ * @v uri		Request URI
+ * @ret rc		Return status code
+ */
+static int efi_cache_open ( struct interface *xfer, struct uri *uri ) {
+	struct http_request_conditional conditional;
+	char etag[ EFI_CACHE_TAG_MAX_LEN + 1 /* NUL */ ];
+	uint8_t ctx[SHA256_CTX_SIZE];
+	uint8_t hash[SHA256_DIGEST_SIZE];
+	struct efi_cache *cache;
+	int rc;
+
+	/* Sanity check */
+	if ( ! uri->opaque ) {
+		rc = -EINVAL;
+		goto err_sanity;
+	}
+
+	/* Allocate and initialise structure */
+	cache = zalloc ( sizeof ( *cache ) );
+	if ( ! cache ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	ref_init ( &cache->refcnt, efi_cache_free );
+	intf_init ( &cache->xfer, &efi_cache_xfer_desc, &cache->refcnt );
+	intf_init ( &cache->origin, &efi_cache_origin_desc, &cache->refcnt );
+	process_init_stopped ( &cache->process, &efi_cache_process_desc,
+			       &cache->refcnt );
+
+	/* Parse origin URI */
+	cache->uri = parse_uri ( uri->opaque );
+	if ( ! cache->uri ) {
+		rc = -ENOMEM;
+		goto err_parse;
+	}
+
+	/* Construct cache key */
+	digest_init ( &sha256_algorithm, ctx );
+	digest_update ( &sha256_algorithm, ctx, uri->opaque,
+			strlen ( uri->opaque ) );
+	digest_final ( &sha256_algorithm, ctx, hash );
+	base16_encode ( hash, EFI_CACHE_KEY_LEN, cache->key,
+			sizeof ( cache->key ) );
+	DBGC ( cache, "CACHE %p using key %s for %s\n",
+	       cache, cache->key, uri->opaque );
+
+	/* Issue conditional request to origin server if caching is
+	 * possible, otherwise download directly from origin server.
+	 */
+	if ( efi_cache_uri_is_cacheable ( cache->uri ) &&
+	     ( efi_cache_open_dir ( cache ) == 0 ) ) {
+		memset ( &conditional, 0, sizeof ( conditional ) );
+		if ( efi_cache_read_tag ( cache, etag, sizeof ( etag ) ) == 0 )
+			conditional.etag = etag;
+		cache->state = EFI_CACHE_CHECK;
+		rc = http_open ( &cache->origin, &http_get, cache->uri,
+				 NULL, NULL, &conditional );
+	} else {
+		cache->state = EFI_CACHE_FETCH;
+		rc = xfer_open_uri ( &cache->origin, cache->uri );
+	}
+	if ( rc != 0 ) {
+		DBGC ( cache, "CACHE %p could not open origin: %s\n",
+		       cache, strerror ( rc ) );
+		goto err_open;
+	}
+
+	/* Attach to parent interface, mortalise self, and return */
+	intf_plug_plug ( &cache->xfer, xfer );
+	ref_put ( &cache->refcnt );
+	return 0;
+
+ err_open:
+ err_parse:
+	efi_cache_close ( cache, rc );
+	ref_put ( &cache->refcnt );
+ err_alloc:
+ err_sanity:
+	return rc;
+}
+
+/** EFI local disk cache URI opener */
+struct uri_opener efi_cache_uri_opener __uri_opener = {
+	.scheme	= "cache",
+	.open	= efi_cache_open,
+};
@@ -0,0 +1,584 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <assert.h>
+#include <ipxe/refcnt.h>
+#include <ipxe/interface.h>
+#include <ipxe/xfer.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/open.h>
+#include <ipxe/job.h>
+#include <ipxe/process.h>
+#include <ipxe/umalloc.h>
+#include <ipxe/diskwrite.h>
+#include <ipxe/efi/efi.h>
+#include <ipxe/efi/Protocol/BlockIo.h>
+
+/** @file
+ *
+ * EFI local disk writing
+ *
+ * Downloaded data is written directly to an EFI block device, without
+ * first staging the complete file in memory.  Received data is
+ * gathered into large aligned buffers, each of which is written out
+ * as a single block I/O request.  While one buffer is awaiting its
+ * write, the next may continue to be filled from the network.
+ */
+
+/** Size of each write buffer
+ *
+ * This must be a multiple of the device block size.
+ */
+#define EFI_DISKWRITE_BUFSIZE ( 1024 * 1024 )
+
+/** Number of write buffers */
+#define EFI_DISKWRITE_NUM_BUFS 2
+
+/** Total size of write buffers */
+#define EFI_DISKWRITE_SIZE ( EFI_DISKWRITE_BUFSIZE * EFI_DISKWRITE_NUM_BUFS )
+
+/** An EFI disk writer */
+struct efi_diskwrite {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Job control interface */
+	struct interface job;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Write process */
+	struct process process;
+
+	/** Block device handle */
+	EFI_HANDLE handle;
+	/** Block I/O protocol */
+	EFI_BLOCK_IO_PROTOCOL *blockio;
+	/** Block size */
+	size_t blksize;
+	/** Device capacity (in bytes) */
+	uint64_t capacity;
+
+	/** Write buffers */
+	userptr_t buffer;
+	/** Number of bytes received */
+	size_t pos;
+	/** Number of bytes written to device */
+	size_t written;
+	/** Expected total length (if known) */
+	size_t len;
+};
+
+/**
+ * Free disk writer
+ *
+ * @v refcnt		Reference count
+ */
+static void efi_diskwrite_free ( struct refcnt *refcnt ) {
+	struct efi_diskwrite *diskwrite =
+		container_of ( refcnt, struct efi_diskwrite, refcnt );
+
+	ufree ( diskwrite->buffer );
+	free ( diskwrite );
+}
+
+/**
+ * Close disk writer
+ *
+ * @v diskwrite		Disk writer
+ * @v rc		Reason for close
+ */
+static void efi_diskwrite_close ( struct efi_diskwrite *diskwrite, int rc ) {
+
+	/* Stop process */
+	process_del ( &diskwrite->process );
+
+	/* Shut down interfaces */
+	intf_shutdown ( &diskwrite->xfer, rc );
+	intf_shutdown ( &diskwrite->job, rc );
+}
+
+/**
+ * Get write buffer for a given stream position
+ *
+ * @v diskwrite		Disk writer
+ * @v pos		Stream position
+ * @ret data		Write buffer
+ */
+static void * efi_diskwrite_data ( struct efi_diskwrite *diskwrite,
+				   size_t pos ) {
+
+	return user_to_virt ( diskwrite->buffer,
+			      ( pos % EFI_DISKWRITE_SIZE ) );
+}
+
+/**
+ * Write data to device
+ *
+ * @v diskwrite		Disk writer
+ * @v len		Length to write (must be a multiple of block size)
+ * @ret rc		Return status code
+ */
+static int efi_diskwrite_blocks ( struct efi_diskwrite *diskwrite,
+				  size_t len ) {
+	EFI_BLOCK_IO_PROTOCOL *blockio = diskwrite->blockio;
+	EFI_LBA lba = ( diskwrite->written / diskwrite->blksize );
+	EFI_STATUS efirc;
+	int rc;
+
+	/* Sanity checks */
+	assert ( ( len % diskwrite->blksize ) == 0 );
+	assert ( ( diskwrite->written + len ) <= diskwrite->capacity );
+
+	/* Write blocks */
+	if ( ( efirc = blockio->WriteBlocks ( blockio,
+					      blockio->Media->MediaId, lba, len,
+					      efi_diskwrite_data ( diskwrite,
+						diskwrite->written ) ) ) != 0 ){
+		rc = -EEFI ( efirc );
+		DBGC ( diskwrite, "DISKWRITE %p could not write %#zx bytes at "
+		       "LBA %#llx: %s\n", diskwrite, len,
+		       ( ( unsigned long long ) lba ), strerror ( rc ) );
+		return rc;
+	}
+	diskwrite->written += len;
+
+	return 0;
+}
+
+/**
+ * Write any remaining data to device
+ *
+ * @v diskwrite		Disk writer
+ * @ret rc		Return status code
+ */
+static int efi_diskwrite_finish ( struct efi_diskwrite *diskwrite ) {
+	EFI_BLOCK_IO_PROTOCOL *blockio = diskwrite->blockio;
+	size_t remaining;
+	size_t partial;
+	void *data;
+	void *block;
+	EFI_LBA lba;
+	EFI_STATUS efirc;
+	int rc;
+
+	/* Write any remaining full buffers */
+	while ( ( diskwrite->pos - diskwrite->written ) >=
+		EFI_DISKWRITE_BUFSIZE ) {
+		if ( ( rc = efi_diskwrite_blocks ( diskwrite,
+						   EFI_DISKWRITE_BUFSIZE ) ) != 0 )
+			return rc;
+	}
+
+	/* Preserve existing content of any partial final block, using
+	 * the (now unused) next write buffer as a bounce buffer.
+	 */
+	remaining = ( diskwrite->pos - diskwrite->written );
+	partial = ( remaining % diskwrite->blksize );
+	if ( partial ) {
+		data = efi_diskwrite_data ( diskwrite, diskwrite->pos );
+		block = efi_diskwrite_data ( diskwrite, ( diskwrite->written +
+						  EFI_DISKWRITE_BUFSIZE ) );
+		lba = ( diskwrite->pos / diskwrite->blksize );
+		if ( ( efirc = blockio->ReadBlocks ( blockio,
+						     blockio->Media->MediaId,
+						     lba, diskwrite->blksize,
+						     block ) ) != 0 ) {
+			rc = -EEFI ( efirc );
+			DBGC ( diskwrite, "DISKWRITE %p could not read LBA "
+			       "%#llx: %s\n", diskwrite,
+			       ( ( unsigned long long ) lba ), strerror ( rc ));
+			return rc;
+		}
+		memcpy ( data, ( block + partial ),
+			 ( diskwrite->blksize - partial ) );
+		remaining += ( diskwrite->blksize - partial );
+	}
+
+	/* Write final partial buffer */
+	if ( remaining &&
+	     ( ( rc = efi_diskwrite_blocks ( diskwrite, remaining ) ) != 0 ) )
+		return rc;
+
+	/* Flush device */
+	if ( ( efirc = blockio->FlushBlocks ( blockio ) ) != 0 ) {
+		rc = -EEFI ( efirc );
+		DBGC ( diskwrite, "DISKWRITE %p could not flush: %s\n",
+		       diskwrite, strerror ( rc ) );
+		return rc;
+	}
+
+	DBGC ( diskwrite, "DISKWRITE %p wrote %#zx bytes\n",
+	       diskwrite, diskwrite->pos );
+	return 0;
+}
+
+/**
+ * Write full buffers to device
+ *
+ * @v diskwrite		Disk writer
+ */
+static void efi_diskwrite_step ( struct efi_diskwrite *diskwrite ) {
+	int rc;
+
+	/* Stop process if there are no full buffers */
+	if ( ( diskwrite->pos - diskwrite->written ) <
+	     EFI_DISKWRITE_BUFSIZE ) {
+		process_del ( &diskwrite->process );
+		return;
+	}
+
+	/* Write one buffer, allowing the network to be polled before
+	 * writing the next.
+	 */
+	if ( ( rc = efi_diskwrite_blocks ( diskwrite,
+					   EFI_DISKWRITE_BUFSIZE ) ) != 0 ) {
+		efi_diskwrite_close ( diskwrite, rc );
+		return;
+	}
+
+	/* A buffer is now free to receive further data */
+	xfer_window_changed ( &diskwrite->xfer );
+}
+
+/** Write process descriptor */
+static struct process_descriptor efi_diskwrite_process_desc =
+	PROC_DESC ( struct efi_diskwrite, process, efi_diskwrite_step );
+
+/**
+ * Check flow control window
+ *
+ * @v diskwrite		Disk writer
+ * @ret len		Length of window
+ */
+static size_t efi_diskwrite_window ( struct efi_diskwrite *diskwrite ) {
+
+	/* Allow data up to the end of the free buffers */
+	return ( diskwrite->written + EFI_DISKWRITE_SIZE - diskwrite->pos );
+}
+
+/**
+ * Receive data
+ *
+ * @v diskwrite		Disk writer
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int efi_diskwrite_deliver ( struct efi_diskwrite *diskwrite,
+				   struct io_buffer *iobuf,
+				   struct xfer_metadata *meta ) {
+	const void *data = iobuf->data;
+	size_t len = iob_len ( iobuf );
+	size_t pos = diskwrite->pos;
+	size_t offset;
+	size_t frag_len;
+	int rc;
+
+	/* Record expected length, if reported */
+	if ( ( len == 0 ) && ( meta->flags & XFER_FL_ABS_OFFSET ) &&
+	     meta->offset ) {
+		diskwrite->len = meta->offset;
+		if ( diskwrite->len > diskwrite->capacity ) {
+			DBGC ( diskwrite, "DISKWRITE %p cannot fit %#zx bytes "
+			       "(capacity %#llx)\n", diskwrite, diskwrite->len,
+			       ( ( unsigned long long ) diskwrite->capacity ) );
+			rc = -ENOSPC;
+			goto err;
+		}
+	}
+
+	/* Data must be written strictly in order */
+	if ( ( rc = xfer_check_order ( meta, &pos, len ) ) != 0 ) {
+		DBGC ( diskwrite, "DISKWRITE %p received out-of-order data\n",
+		       diskwrite );
+		goto err;
+	}
+
+	/* Check device capacity */
+	if ( pos > diskwrite->capacity ) {
+		DBGC ( diskwrite, "DISKWRITE %p exceeded capacity %#llx\n",
+		       diskwrite,
+		       ( ( unsigned long long ) diskwrite->capacity ) );
+		rc = -ENOSPC;
+		goto err;
+	}
+
+	/* Copy data to write buffers */
+	while ( len ) {
+
+		/* Write a buffer immediately if none are free */
+		if ( ( diskwrite->pos - diskwrite->written ) ==
+		     EFI_DISKWRITE_SIZE ) {
+			if ( ( rc = efi_diskwrite_blocks ( diskwrite,
+					EFI_DISKWRITE_BUFSIZE ) ) != 0 )
+				goto err;
+		}
+
+		/* Copy up to end of current buffer */
+		offset = ( diskwrite->pos % EFI_DISKWRITE_BUFSIZE );
+		frag_len = ( EFI_DISKWRITE_BUFSIZE - offset );
+		if ( frag_len > len )
+			frag_len = len;
+		memcpy ( efi_diskwrite_data ( diskwrite, diskwrite->pos ),
+			 data, frag_len );
+		diskwrite->pos += frag_len;
+		data += frag_len;
+		len -= frag_len;
+
+		/* Schedule write of any newly filled buffer */
+		if ( ( diskwrite->pos % EFI_DISKWRITE_BUFSIZE ) == 0 )
+			process_add ( &diskwrite->process );
+	}
+
+	free_iob ( iobuf );
+	return 0;
+
+ err:
+	free_iob ( iobuf );
+	efi_diskwrite_close ( diskwrite, rc );
+	return rc;
+}
+
+/**
+ * Handle completion of download
+ *
+ * @v diskwrite		Disk writer
+ * @v rc		Reason for close
+ */
+static void efi_diskwrite_xfer_close ( struct efi_diskwrite *diskwrite,
+				       int rc ) {
+
+	/* Write any remaining data, if download was successful */
+	if ( rc == 0 )
+		rc = efi_diskwrite_finish ( diskwrite );
+
+	/* Close disk writer */
+	efi_diskwrite_close ( diskwrite, rc );
+}
+
+/** Data transfer interface operations */
+static struct interface_operation efi_diskwrite_xfer_operations[] = {
+	INTF_OP ( xfer_deliver, struct efi_diskwrite *, efi_diskwrite_deliver ),
+	INTF_OP ( xfer_window, struct efi_diskwrite *, efi_diskwrite_window ),
+	INTF_OP ( intf_close, struct efi_diskwrite *,
+		  efi_diskwrite_xfer_close ),
+};
+
+/** Data transfer interface descriptor */
+static struct interface_descriptor efi_diskwrite_xfer_desc =
+	INTF_DESC ( struct efi_diskwrite, xfer, efi_diskwrite_xfer_operations );
+
+/**
+ * Report progress of disk write
+ *
+ * @v diskwrite		Disk writer
+ * @v progress		Progress report to fill in
+ * @ret ongoing_rc	Ongoing job status code (if known)
+ */
+static int efi_diskwrite_progress ( struct efi_diskwrite *diskwrite,
+				    struct job_progress *progress ) {
+
+	progress->completed = diskwrite->pos;
+	progress->total = diskwrite->len;
+
+	return 0;
+}
+
+/** Job control interface operations */
+static struct interface_operation efi_diskwrite_job_operations[] = {
+	INTF_OP ( job_progress, struct efi_diskwrite *,
+		  efi_diskwrite_progress ),
+	INTF_OP ( intf_close, struct efi_diskwrite *, efi_diskwrite_close ),
+};
+
+/** Job control interface descriptor */
+static struct interface_descriptor efi_diskwrite_job_desc =
+	INTF_DESC ( struct efi_diskwrite, job, efi_diskwrite_job_operations );
+
+/**
+ * Open block device
+ *
+ * @v diskwrite		Disk writer
+ * @v disk		Disk name (as a device path)
+ * @ret rc		Return status code
+ */
+static int efi_diskwrite_open_disk ( struct efi_diskwrite *diskwrite,
+				     const char *disk ) {
+	EFI_BOOT_SERVICES *bs = efi_systab->BootServices;
+	EFI_GUID *protocol = &efi_block_io_protocol_guid;
+	EFI_HANDLE *handles;
+	EFI_HANDLE handle;
+	union {
+		EFI_BLOCK_IO_PROTOCOL *blockio;
+		void *interface;
+	} u;
+	EFI_BLOCK_IO_MEDIA *media;
+	UINTN num_handles;
+	UINTN i;
+	EFI_STATUS efirc;
+	int rc;
+
+	/* Locate all block device handles */
+	if ( ( efirc = bs->LocateHandleBuffer ( ByProtocol, protocol, NULL,
+						&num_handles,
+						&handles ) ) != 0 ) {
+		rc = -EEFI ( efirc );
+		DBGC ( diskwrite, "DISKWRITE %p could not enumerate handles: "
+		       "%s\n", diskwrite, strerror ( rc ) );
+		goto err_locate;
+	}
+
+	/* Find matching device */
+	handle = NULL;
+	for ( i = 0 ; i < num_handles ; i++ ) {
+		if ( strcasecmp ( efi_handle_name ( handles[i] ), disk ) == 0 ){
+			handle = handles[i];
+			break;
+		}
+	}
+	if ( ! handle ) {
+		DBGC ( diskwrite, "DISKWRITE %p could not find \"%s\"\n",
+		       diskwrite, disk );
+		rc = -ENODEV;
+		goto err_find;
+	}
+
+	/* Open block I/O protocol */
+	if ( ( efirc = bs->OpenProtocol ( handle, protocol, &u.interface,
+					  efi_image_handle, handle,
+					  EFI_OPEN_PROTOCOL_GET_PROTOCOL ))!=0){
+		rc = -EEFI ( efirc );
+		DBGC ( diskwrite, "DISKWRITE %p could not open %s: %s\n",
+		       diskwrite, efi_handle_name ( handle ), strerror ( rc ) );
+		goto err_open;
+	}
+	media = u.blockio->Media;
+
+	/* Check that device is usable */
+	if ( ! media->MediaPresent ) {
+		DBGC ( diskwrite, "DISKWRITE %p %s has no media\n",
+		       diskwrite, efi_handle_name ( handle ) );
+		rc = -ENXIO;
+		goto err_media;
+	}
+	if ( media->ReadOnly ) {
+		DBGC ( diskwrite, "DISKWRITE %p %s is read-only\n",
+		       diskwrite, efi_handle_name ( handle ) );
+		rc = -EROFS;
+		goto err_media;
+	}
+	if ( ( media->BlockSize == 0 ) ||
+	     ( media->BlockSize & ( media->BlockSize - 1 ) ) ||
+	     ( media->BlockSize > EFI_DISKWRITE_BUFSIZE ) ||
+	     ( media->IoAlign > EFI_PAGE_SIZE ) ) {
+		DBGC ( diskwrite, "DISKWRITE %p %s has unsupported block "
+		       "size %#x (alignment %#x)\n", diskwrite,
+		       efi_handle_name ( handle ), media->BlockSize,
+		       media->IoAlign );
+		rc = -ENOTSUP;
+		goto err_media;
+	}
+
+	/* Record device */
+	diskwrite->handle = handle;
+	diskwrite->blockio = u.blockio;
+	diskwrite->blksize = media->BlockSize;
+	diskwrite->capacity = ( ( media->LastBlock + 1 ) * media->BlockSize );
+	DBGC ( diskwrite, "DISKWRITE %p writing to %s (%#llx bytes)\n",
+	       diskwrite, efi_handle_name ( handle ),
+	       ( ( unsigned long long ) diskwrite->capacity ) );
+
+	/* Success */
+	rc = 0;
+
+ err_media:
+ err_open:
+ err_find:
+	bs->FreePool ( handles );
+ err_locate:
+	return rc;
+}
+
+/**
+ * Create disk writer
+ *
+ * @v job		Job control interface
+ * @v disk		Disk name (as a device path)
+ * @v uri		URI to download
+ * @ret rc		Return status code
+ */
+int create_disk_writer ( struct interface *job, const char *disk,
+			 struct uri *uri ) {
+	struct efi_diskwrite *diskwrite;
+	int rc;
+
+	/* Allocate and initialise structure */
+	diskwrite = zalloc ( sizeof ( *diskwrite ) );
+	if ( ! diskwrite ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	ref_init ( &diskwrite->refcnt, efi_diskwrite_free );
+	intf_init ( &diskwrite->job, &efi_diskwrite_job_desc,
+		    &diskwrite->refcnt );
+	intf_init ( &diskwrite->xfer, &efi_diskwrite_xfer_desc,
+		    &diskwrite->refcnt );
+	process_init_stopped ( &diskwrite->process,
+			       &efi_diskwrite_process_desc,
+			       &diskwrite->refcnt );
+
+	/* Open block device */
+	if ( ( rc = efi_diskwrite_open_disk ( diskwrite, disk ) ) != 0 )
+		goto err_open_disk;
+
+	/* Allocate write buffers.  These are page-aligned, and so
+	 * satisfy the alignment requirement of any device that we
+	 * have accepted.
+	 */
+	diskwrite->buffer = umalloc ( EFI_DISKWRITE_SIZE );
+	if ( ! diskwrite->buffer ) {
+		rc = -ENOMEM;
+		goto err_buffer;
+	}
+
+	/* Open URI */
+	if ( ( rc = xfer_open_uri ( &diskwrite->xfer, uri ) ) != 0 )
+		goto err_open_uri;
+
+	/* Attach to parent interface, mortalise self, and return */
+	intf_plug_plug ( &diskwrite->job, job );
+	ref_put ( &diskwrite->refcnt );
+	return 0;
+
+ err_open_uri:
+ err_buffer:
+ err_open_disk:
+	efi_diskwrite_close ( diskwrite, rc );
+	ref_put ( &diskwrite->refcnt );
+ err_alloc:
+	return rc;
+}
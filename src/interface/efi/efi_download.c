@@ -33,6 +33,18 @@ FILE_LICENCE ( GPL2_OR_LATER );
 static EFI_GUID ipxe_download_protocol_guid
 	= IPXE_DOWNLOAD_PROTOCOL_GUID;
 
+/** iPXE download buffer protocol GUID */
+static EFI_GUID ipxe_download_buffer_protocol_guid
+	= IPXE_DOWNLOAD_BUFFER_PROTOCOL_GUID;
+
+/** Size of data aggregation buffer
+ *
+ * Received data is accumulated into blocks of up to this size before
+ * being passed to the data callback, to avoid making a callback for
+ * every received packet.
+ */
+#define EFI_DOWNLOAD_CHUNK ( 64 * 1024 )
+
 /** A single in-progress file */
 struct efi_download_file {
 	/** Data transfer interface that provides downloaded data */
@@ -41,18 +53,52 @@ struct efi_download_file {
 	/** Current file position */
 	size_t pos;
 
-	/** Data callback */
+	/** Data callback (or NULL for direct delivery) */
 	IPXE_DOWNLOAD_DATA_CALLBACK data_callback;
 
-	/** Finish callback */
+	/** Finish callback (or NULL for direct delivery) */
 	IPXE_DOWNLOAD_FINISH_CALLBACK finish_callback;
 
 	/** Callback context */
 	void *context;
+
+	/** Aggregation buffer, or caller-supplied buffer */
+	uint8_t *buffer;
+	/** Length of buffer */
+	size_t max;
+	/** Length of data awaiting delivery to data callback */
+	size_t fill;
+	/** Length of file (for direct delivery) */
+	size_t len;
+	/** Completion status (for direct delivery) */
+	int rc;
 };
 
 /* xfer interface */
 
+/**
+ * Deliver any aggregated data to data callback
+ *
+ * @v file		Data transfer file
+ * @ret rc		Return status code
+ */
+static int efi_download_flush ( struct efi_download_file *file ) {
+	size_t fill = file->fill;
+	EFI_STATUS efirc;
+
+	/* Do nothing unless we have aggregated data */
+	if ( ! fill )
+		return 0;
+	file->fill = 0;
+
+	/* Call out to the data handler */
+	if ( ( efirc = file->data_callback ( file->context, file->buffer, fill,
+					     ( file->pos - fill ) ) ) != 0 )
+		return -EEFI ( efirc );
+
+	return 0;
+}
+
 /**
  * Transfer finished or was aborted
  *
@@ -61,13 +107,99 @@ struct efi_download_file {
  */
 static void efi_download_close ( struct efi_download_file *file, int rc ) {
 
-	file->finish_callback ( file->context, EFIRC ( rc ) );
+	if ( file->data_callback ) {
+
+		/* Deliver any remaining aggregated data */
+		if ( rc == 0 )
+			rc = efi_download_flush ( file );
+		free ( file->buffer );
+		file->buffer = NULL;
+		file->fill = 0;
+
+		file->finish_callback ( file->context, EFIRC ( rc ) );
+
+	} else {
+
+		/* Record completion status */
+		file->rc = rc;
+	}
 
 	intf_shutdown ( &file->xfer, rc );
 
 	efi_snp_release();
 }
 
+/**
+ * Process received data via data callback
+ *
+ * @v file		Data transfer file
+ * @v pos		File position
+ * @v data		Data
+ * @v len		Length of data
+ * @ret rc		Return status code
+ */
+static int efi_download_aggregate ( struct efi_download_file *file,
+				    size_t pos, const void *data,
+				    size_t len ) {
+	EFI_STATUS efirc;
+	int rc;
+
+	/* Deliver any aggregated data unless the new data is
+	 * contiguous with it and will fit within the buffer.
+	 */
+	if ( ( pos != file->pos ) || ( len > ( file->max - file->fill ) ) ||
+	     ( len == 0 ) ) {
+		if ( ( rc = efi_download_flush ( file ) ) != 0 )
+			return rc;
+	}
+
+	/* Pass through file size hints and oversized blocks directly */
+	if ( ( len == 0 ) || ( len > file->max ) ) {
+		if ( ( efirc = file->data_callback ( file->context,
+						     ( ( void * ) data ), len,
+						     pos ) ) != 0 )
+			return -EEFI ( efirc );
+		return 0;
+	}
+
+	/* Otherwise, add to aggregated data */
+	memcpy ( ( file->buffer + file->fill ), data, len );
+	file->fill += len;
+
+	return 0;
+}
+
+/**
+ * Process received data via direct delivery
+ *
+ * @v file		Data transfer file
+ * @v pos		File position
+ * @v data		Data
+ * @v len		Length of data
+ * @ret rc		Return status code
+ */
+static int efi_download_copy ( struct efi_download_file *file,
+			       size_t pos, const void *data, size_t len ) {
+
+	/* Record file length */
+	if ( file->len < ( pos + len ) )
+		file->len = ( pos + len );
+
+	/* Give up immediately if a file size hint shows that the
+	 * buffer is too small.
+	 */
+	if ( ( len == 0 ) && ( pos > file->max ) ) {
+		efi_download_close ( file, -ERANGE );
+		return -ERANGE;
+	}
+
+	/* Copy data to buffer, if it fits */
+	if ( ( pos <= file->max ) && ( len <= ( file->max - pos ) ) )
+		memcpy ( ( file->buffer + pos ), data, len );
+
+	return 0;
+}
+
 /**
  * Process received data
  *
@@ -79,29 +211,24 @@ static void efi_download_close ( struct efi_download_file *file, int rc ) {
 static int efi_download_deliver_iob ( struct efi_download_file *file,
 				      struct io_buffer *iobuf,
 				      struct xfer_metadata *meta ) {
-	EFI_STATUS efirc;
 	size_t len = iob_len ( iobuf );
+	size_t pos;
 	int rc;
 
 	/* Calculate new buffer position */
-	if ( meta->flags & XFER_FL_ABS_OFFSET )
-		file->pos = 0;
-	file->pos += meta->offset;
-
-	/* Call out to the data handler */
-	if ( ( efirc = file->data_callback ( file->context, iobuf->data,
-					     len, file->pos ) ) != 0 ) {
-		rc = -EEFI ( efirc );
-		goto err_callback;
+	pos = ( ( meta->flags & XFER_FL_ABS_OFFSET ) ? 0 : file->pos );
+	pos += meta->offset;
+
+	/* Hand off to data handler */
+	if ( file->data_callback ) {
+		rc = efi_download_aggregate ( file, pos, iobuf->data, len );
+	} else {
+		rc = efi_download_copy ( file, pos, iobuf->data, len );
 	}
 
 	/* Update current buffer position */
-	file->pos += len;
-
-	/* Success */
-	rc = 0;
+	file->pos = ( pos + len );
 
- err_callback:
 	free_iob ( iobuf );
 	return rc;
 }
@@ -138,20 +265,26 @@ efi_download_start ( IPXE_DOWNLOAD_PROTOCOL *This __unused,
 	struct efi_download_file *file;
 	int rc;
 
-	file = malloc ( sizeof ( struct efi_download_file ) );
+	file = zalloc ( sizeof ( struct efi_download_file ) );
 	if ( file == NULL ) {
 		return EFI_OUT_OF_RESOURCES;
 	}
+	file->buffer = malloc ( EFI_DOWNLOAD_CHUNK );
+	if ( file->buffer == NULL ) {
+		free ( file );
+		return EFI_OUT_OF_RESOURCES;
+	}
+	file->max = EFI_DOWNLOAD_CHUNK;
 
 	intf_init ( &file->xfer, &efi_download_file_xfer_desc, NULL );
 	rc = xfer_open ( &file->xfer, LOCATION_URI_STRING, Url );
 	if ( rc ) {
+		free ( file->buffer );
 		free ( file );
 		return EFIRC ( rc );
 	}
 
 	efi_snp_claim();
-	file->pos = 0;
 	file->data_callback = DataCallback;
 	file->finish_callback = FinishCallback;
 	file->context = Context;
@@ -192,11 +325,56 @@ efi_download_poll ( IPXE_DOWNLOAD_PROTOCOL *This __unused ) {
 	return EFI_SUCCESS;
 }
 
+/**
+ * Download a file directly into a buffer
+ *
+ * @v This		iPXE Download Buffer Protocol instance
+ * @v Url		URL to download from
+ * @v Buffer		Buffer to fill
+ * @v BufferLength	Length of buffer, updated to length of file
+ * @ret Status		EFI status code
+ */
+static EFI_STATUS EFIAPI
+efi_download_to_buffer ( IPXE_DOWNLOAD_BUFFER_PROTOCOL *This __unused,
+			 CHAR8 *Url, VOID *Buffer, UINTN *BufferLength ) {
+	struct efi_download_file file;
+	int rc;
+
+	/* Initialise file */
+	memset ( &file, 0, sizeof ( file ) );
+	intf_init ( &file.xfer, &efi_download_file_xfer_desc, NULL );
+	file.buffer = Buffer;
+	file.max = *BufferLength;
+	file.rc = -EINPROGRESS;
+
+	/* Start download */
+	if ( ( rc = xfer_open ( &file.xfer, LOCATION_URI_STRING, Url ) ) != 0 )
+		return EFIRC ( rc );
+	efi_snp_claim();
+
+	/* Wait for download to complete */
+	while ( file.rc == -EINPROGRESS )
+		step();
+	rc = file.rc;
+
+	/* Check that file fitted within buffer */
+	if ( ( rc == 0 ) && ( file.len > file.max ) )
+		rc = -ERANGE;
+	*BufferLength = file.len;
+
+	return EFIRC ( rc );
+}
+
 /** Publicly exposed iPXE download protocol */
 static IPXE_DOWNLOAD_PROTOCOL ipxe_download_protocol_interface = {
 	.Start = efi_download_start,
 	.Abort = efi_download_abort,
-	.Poll = efi_download_poll
+	.Poll = efi_download_poll,
+};
+
+/** Publicly exposed iPXE download buffer protocol */
+static IPXE_DOWNLOAD_BUFFER_PROTOCOL ipxe_download_buffer_protocol_interface = {
+	.DownloadToBuffer = efi_download_to_buffer,
 };
 
 /**
@@ -214,6 +392,8 @@ int efi_download_install ( EFI_HANDLE handle ) {
 			&handle,
 			&ipxe_download_protocol_guid,
 			&ipxe_download_protocol_interface,
+			&ipxe_download_buffer_protocol_guid,
+			&ipxe_download_buffer_protocol_interface,
 			NULL );
 	if ( efirc ) {
 		rc = -EEFI ( efirc );
@@ -236,5 +416,7 @@ void efi_download_uninstall ( EFI_HANDLE handle ) {
 	bs->UninstallMultipleProtocolInterfaces (
 			handle,
 			&ipxe_download_protocol_guid,
-			&ipxe_download_protocol_interface, NULL );
+			&ipxe_download_protocol_interface,
+			&ipxe_download_buffer_protocol_guid,
+			&ipxe_download_buffer_protocol_interface, NULL );
 }
@@ -38,6 +38,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <errno.h>
 #include <wchar.h>
 #include <ipxe/image.h>
+#include <ipxe/uri.h>
+#include <ipxe/blockdev.h>
+#include <ipxe/sanboot.h>
 #include <ipxe/efi/efi.h>
 #include <ipxe/efi/Protocol/SimpleFileSystem.h>
 #include <ipxe/efi/Protocol/BlockIo.h>
@@ -50,12 +53,18 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** EFI media ID */
 #define EFI_MEDIA_ID_MAGIC 0x69505845
 
-/** An image exposed as an EFI file */
+/** An image or SAN device exposed as an EFI file */
 struct efi_file {
 	/** EFI file protocol */
 	EFI_FILE_PROTOCOL file;
-	/** Image */
+	/** Image (if applicable) */
 	struct image *image;
+	/** SAN device (if applicable) */
+	struct san_device *sandev;
+	/** Name */
+	const char *name;
+	/** Length */
+	size_t len;
 	/** Current file position */
 	size_t pos;
 };
@@ -70,21 +79,19 @@ static struct efi_file efi_file_root;
  */
 static const char * efi_file_name ( struct efi_file *file ) {
 
-	return ( file->image ? file->image->name : "<root>" );
+	return ( file->name ? file->name : "<root>" );
 }
 
 /**
  * Find EFI file image
  *
- * @v wname		Filename
+ * @v name		Filename
  * @ret image		Image, or NULL
  */
-static struct image * efi_file_find ( const CHAR16 *wname ) {
-	char name[ wcslen ( wname ) + 1 /* NUL */ ];
+static struct image * efi_file_find ( const char *name ) {
 	struct image *image;
 
 	/* Find image */
-	snprintf ( name, sizeof ( name ), "%ls", wname );
 	list_for_each_entry ( image, &images, list ) {
 		if ( strcasecmp ( image->name, name ) == 0 )
 			return image;
@@ -94,6 +101,60 @@ static struct image * efi_file_find ( const CHAR16 *wname ) {
 
 }
 
+/**
+ * Get EFI file name of SAN device
+ *
+ * @v sandev		SAN device
+ * @ret name		Filename, or NULL if not exposed as a file
+ *
+ * A SAN device is exposed as a file named after the final component
+ * of its URI path (e.g. "huge.iso" for an HTTP SAN device at
+ * "http://server/images/huge.iso").  The file contents are read on
+ * demand from the SAN device, and so need not be downloaded in full.
+ */
+static const char * efi_file_sandev_name ( struct san_device *sandev ) {
+	const char *path = sandev->path[0].uri->path;
+	const char *name;
+
+	/* Use final path component, if any */
+	if ( ! path )
+		return NULL;
+	name = strrchr ( path, '/' );
+	name = ( name ? ( name + 1 ) : path );
+	return ( name[0] ? name : NULL );
+}
+
+/**
+ * Get length of SAN device
+ *
+ * @v sandev		SAN device
+ * @ret len		Length
+ */
+static size_t efi_file_sandev_len ( struct san_device *sandev ) {
+
+	return ( sandev_capacity ( sandev ) * sandev_blksize ( sandev ) );
+}
+
+/**
+ * Find EFI file SAN device
+ *
+ * @v name		Filename
+ * @ret sandev		SAN device, or NULL
+ */
+static struct san_device * efi_file_find_sandev ( const char *name ) {
+	struct san_device *sandev;
+	const char *sandev_name;
+
+	/* Find SAN device */
+	for_each_sandev ( sandev ) {
+		sandev_name = efi_file_sandev_name ( sandev );
+		if ( sandev_name && ( strcasecmp ( sandev_name, name ) == 0 ) )
+			return sandev;
+	}
+
+	return NULL;
+}
+
 /**
  * Open file
  *
@@ -109,7 +170,9 @@ efi_file_open ( EFI_FILE_PROTOCOL *this, EFI_FILE_PROTOCOL **new,
 		CHAR16 *wname, UINT64 mode __unused,
 		UINT64 attributes __unused ) {
 	struct efi_file *file = container_of ( this, struct efi_file, file );
+	char name[ wcslen ( wname ) + 1 /* NUL */ ];
 	struct efi_file *new_file;
+	struct san_device *sandev = NULL;
 	struct image *image;
 
 	/* Initial '\' indicates opening from the root directory */
@@ -125,31 +188,44 @@ efi_file_open ( EFI_FILE_PROTOCOL *this, EFI_FILE_PROTOCOL **new,
 	}
 
 	/* Fail unless opening from the root */
-	if ( file->image ) {
+	if ( file != &efi_file_root ) {
 		DBGC ( file, "EFIFILE %s is not a directory\n",
 		       efi_file_name ( file ) );
 		return EFI_NOT_FOUND;
 	}
 
-	/* Identify image */
-	image = efi_file_find ( wname );
-	if ( ! image ) {
-		DBGC ( file, "EFIFILE \"%ls\" does not exist\n", wname );
+	/* Identify image or SAN device */
+	snprintf ( name, sizeof ( name ), "%ls", wname );
+	image = efi_file_find ( name );
+	if ( ! image )
+		sandev = efi_file_find_sandev ( name );
+	if ( ! ( image || sandev ) ) {
+		DBGC ( file, "EFIFILE \"%s\" does not exist\n", name );
 		return EFI_NOT_FOUND;
 	}
 
 	/* Fail unless opening read-only */
 	if ( mode != EFI_FILE_MODE_READ ) {
 		DBGC ( file, "EFIFILE %s cannot be opened in mode %#08llx\n",
-		       image->name, mode );
+		       name, mode );
 		return EFI_WRITE_PROTECTED;
 	}
 
 	/* Allocate and initialise file */
 	new_file = zalloc ( sizeof ( *new_file ) );
+	if ( ! new_file )
+		return EFI_OUT_OF_RESOURCES;
 	memcpy ( &new_file->file, &efi_file_root.file,
 		 sizeof ( new_file->file ) );
-	new_file->image = image_get ( image );
+	if ( image ) {
+		new_file->image = image_get ( image );
+		new_file->name = image->name;
+		new_file->len = image->len;
+	} else {
+		new_file->sandev = sandev_get ( sandev );
+		new_file->name = efi_file_sandev_name ( sandev );
+		new_file->len = efi_file_sandev_len ( sandev );
+	}
 	*new = &new_file->file;
 	DBGC ( new_file, "EFIFILE %s opened\n", efi_file_name ( new_file ) );
 
@@ -166,12 +242,15 @@ static EFI_STATUS EFIAPI efi_file_close ( EFI_FILE_PROTOCOL *this ) {
 	struct efi_file *file = container_of ( this, struct efi_file, file );
 
 	/* Do nothing if this is the root */
-	if ( ! file->image )
+	if ( file == &efi_file_root )
 		return 0;
 
 	/* Close file */
 	DBGC ( file, "EFIFILE %s closed\n", efi_file_name ( file ) );
-	image_put ( file->image );
+	if ( file->image )
+		image_put ( file->image );
+	if ( file->sandev )
+		sandev_put ( file->sandev );
 	free ( file );
 
 	return 0;
@@ -229,23 +308,22 @@ static EFI_STATUS efi_file_varlen ( UINT64 *base, size_t base_len,
 /**
  * Return file information structure
  *
- * @v image		Image, or NULL for the root directory
+ * @v name		Filename, or NULL for the root directory
+ * @v size		File size
  * @v len		Length of data buffer
  * @v data		Data buffer
  * @ret efirc		EFI status code
  */
-static EFI_STATUS efi_file_info ( struct image *image, UINTN *len,
+static EFI_STATUS efi_file_info ( const char *name, size_t size, UINTN *len,
 				  VOID *data ) {
 	EFI_FILE_INFO info;
-	const char *name;
 
 	/* Populate file information */
 	memset ( &info, 0, sizeof ( info ) );
-	if ( image ) {
-		info.FileSize = image->len;
-		info.PhysicalSize = image->len;
+	if ( name ) {
+		info.FileSize = size;
+		info.PhysicalSize = size;
 		info.Attribute = EFI_FILE_READ_ONLY;
-		name = image->name;
 	} else {
 		info.Attribute = ( EFI_FILE_READ_ONLY | EFI_FILE_DIRECTORY );
 		name = "";
@@ -266,14 +344,30 @@ static EFI_STATUS efi_file_info ( struct image *image, UINTN *len,
 static EFI_STATUS efi_file_read_dir ( struct efi_file *file, UINTN *len,
 				      VOID *data ) {
 	EFI_STATUS efirc;
+	struct san_device *sandev;
 	struct image *image;
+	const char *name;
 	unsigned int index;
 
 	/* Construct directory entry at current position */
 	index = file->pos;
 	for_each_image ( image ) {
 		if ( index-- == 0 ) {
-			efirc = efi_file_info ( image, len, data );
+			efirc = efi_file_info ( image->name, image->len,
+						len, data );
+			if ( efirc == 0 )
+				file->pos++;
+			return efirc;
+		}
+	}
+	for_each_sandev ( sandev ) {
+		name = efi_file_sandev_name ( sandev );
+		if ( ! name )
+			continue;
+		if ( index-- == 0 ) {
+			efirc = efi_file_info ( name,
+						efi_file_sandev_len ( sandev ),
+						len, data );
 			if ( efirc == 0 )
 				file->pos++;
 			return efirc;
@@ -285,6 +379,84 @@ static EFI_STATUS efi_file_read_dir ( struct efi_file *file, UINTN *len,
 	return 0;
 }
 
+/**
+ * Read from SAN device
+ *
+ * @v file		EFI file
+ * @v data		Data buffer
+ * @v len		Length to read
+ * @ret rc		Return status code
+ *
+ * Whole blocks are read directly into the caller's buffer.  Any
+ * partial blocks at the start or end are read via a bounce buffer.
+ */
+static int efi_file_read_sandev ( struct efi_file *file, void *data,
+				  size_t len ) {
+	struct san_device *sandev = file->sandev;
+	size_t blksize = sandev_blksize ( sandev );
+	size_t pos = file->pos;
+	void *block = NULL;
+	unsigned int count;
+	size_t offset;
+	size_t frag_len;
+	uint64_t lba;
+	int rc;
+
+	while ( len ) {
+
+		/* Identify starting block */
+		lba = ( pos / blksize );
+		offset = ( pos % blksize );
+
+		if ( ( offset == 0 ) && ( len >= blksize ) ) {
+
+			/* Read whole blocks directly */
+			count = ( len / blksize );
+			frag_len = ( count * blksize );
+			if ( ( rc = sandev_rw ( sandev, lba, count,
+						virt_to_user ( data ),
+						block_read ) ) != 0 )
+				goto err_rw;
+
+		} else {
+
+			/* Read partial block via bounce buffer */
+			if ( ! block ) {
+				block = malloc ( blksize );
+				if ( ! block ) {
+					rc = -ENOMEM;
+					goto err_alloc;
+				}
+			}
+			if ( ( rc = sandev_rw ( sandev, lba, 1,
+						virt_to_user ( block ),
+						block_read ) ) != 0 )
+				goto err_rw;
+			frag_len = ( blksize - offset );
+			if ( frag_len > len )
+				frag_len = len;
+			memcpy ( data, ( block + offset ), frag_len );
+		}
+
+		/* Move to next fragment */
+		data += frag_len;
+		pos += frag_len;
+		len -= frag_len;
+	}
+
+	/* Success */
+	rc = 0;
+
+ err_rw:
+ err_alloc:
+	free ( block );
+	if ( rc != 0 ) {
+		DBGC ( file, "EFIFILE %s could not read: %s\n",
+		       efi_file_name ( file ), strerror ( rc ) );
+	}
+	return rc;
+}
+
 /**
  * Read from file
  *
@@ -297,19 +469,27 @@ static EFI_STATUS EFIAPI efi_file_read ( EFI_FILE_PROTOCOL *this,
 					 UINTN *len, VOID *data ) {
 	struct efi_file *file = container_of ( this, struct efi_file, file );
 	size_t remaining;
+	int rc;
 
 	/* If this is the root directory, then construct a directory entry */
-	if ( ! file->image )
+	if ( file == &efi_file_root )
 		return efi_file_read_dir ( file, len, data );
 
 	/* Read from the file */
-	remaining = ( file->image->len - file->pos );
+	remaining = ( file->len - file->pos );
 	if ( *len > remaining )
 		*len = remaining;
 	DBGC ( file, "EFIFILE %s read [%#08zx,%#08zx)\n",
 	       efi_file_name ( file ), file->pos,
 	       ( ( size_t ) ( file->pos + *len ) ) );
-	copy_from_user ( data, file->image->data, file->pos, *len );
+	if ( file->sandev ) {
+		if ( ( rc = efi_file_read_sandev ( file, data, *len ) ) != 0 ) {
+			*len = 0;
+			return EFIRC ( rc );
+		}
+	} else {
+		copy_from_user ( data, file->image->data, file->pos, *len );
+	}
 	file->pos += *len;
 	return 0;
 }
@@ -344,7 +524,7 @@ static EFI_STATUS EFIAPI efi_file_set_position ( EFI_FILE_PROTOCOL *this,
 	struct efi_file *file = container_of ( this, struct efi_file, file );
 
 	/* If this is the root directory, reset to the start */
-	if ( ! file->image ) {
+	if ( file == &efi_file_root ) {
 		DBGC ( file, "EFIFILE root directory rewound\n" );
 		file->pos = 0;
 		return 0;
@@ -352,14 +532,14 @@ static EFI_STATUS EFIAPI efi_file_set_position ( EFI_FILE_PROTOCOL *this,
 
 	/* Check for the magic end-of-file value */
 	if ( position == 0xffffffffffffffffULL )
-		position = file->image->len;
+		position = file->len;
 
 	/* Fail if we attempt to seek past the end of the file (since
 	 * we do not support writes).
 	 */
-	if ( position > file->image->len ) {
+	if ( position > file->len ) {
 		DBGC ( file, "EFIFILE %s cannot seek to %#08llx of %#08zx\n",
-		       efi_file_name ( file ), position, file->image->len );
+		       efi_file_name ( file ), position, file->len );
 		return EFI_UNSUPPORTED;
 	}
 
@@ -400,6 +580,7 @@ static EFI_STATUS EFIAPI efi_file_get_info ( EFI_FILE_PROTOCOL *this,
 					     UINTN *len, VOID *data ) {
 	struct efi_file *file = container_of ( this, struct efi_file, file );
 	EFI_FILE_SYSTEM_INFO fsinfo;
+	struct san_device *sandev;
 	struct image *image;
 
 	/* Determine information to return */
@@ -408,7 +589,7 @@ static EFI_STATUS EFIAPI efi_file_get_info ( EFI_FILE_PROTOCOL *this,
 		/* Get file information */
 		DBGC ( file, "EFIFILE %s get file information\n",
 		       efi_file_name ( file ) );
-		return efi_file_info ( file->image, len, data );
+		return efi_file_info ( file->name, file->len, len, data );
 
 	} else if ( memcmp ( type, &efi_file_system_info_id,
 			     sizeof ( *type ) ) == 0 ) {
@@ -420,6 +601,11 @@ static EFI_STATUS EFIAPI efi_file_get_info ( EFI_FILE_PROTOCOL *this,
 		fsinfo.ReadOnly = 1;
 		for_each_image ( image )
 			fsinfo.VolumeSize += image->len;
+		for_each_sandev ( sandev ) {
+			if ( efi_file_sandev_name ( sandev ) )
+				fsinfo.VolumeSize +=
+					efi_file_sandev_len ( sandev );
+		}
 		return efi_file_varlen ( &fsinfo.Size,
 					 SIZE_OF_EFI_FILE_SYSTEM_INFO, "iPXE",
 					 len, data );
@@ -481,7 +667,6 @@ static struct efi_file efi_file_root = {
 		.SetInfo = efi_file_set_info,
 		.Flush = efi_file_flush,
 	},
-	.image = NULL,
 };
 
 /**
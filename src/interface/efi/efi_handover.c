@@ -0,0 +1,134 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <ipxe/init.h>
+#include <ipxe/handover.h>
+#include <ipxe/efi/efi.h>
+#include <ipxe/efi/efi_handover.h>
+
+/** @file
+ *
+ * EFI state handover to a chained iPXE
+ *
+ * The state handover block is passed to the chained image as an EFI
+ * configuration table, installed only for the duration of the call
+ * to StartImage().
+ *
+ */
+
+/** iPXE state handover configuration table GUID */
+static EFI_GUID efi_handover_guid = IPXE_HANDOVER_TABLE_GUID;
+
+/** Handed over state (if any) */
+static struct handover_header *efi_handover_table;
+EFI_USE_TABLE ( IPXE_HANDOVER_TABLE, &efi_handover_table, 0 );
+
+/** Installed state handover block (if any) */
+static void *efi_handover_data;
+
+/**
+ * Install state handover configuration table
+ *
+ * Failure is not fatal, since the chained image will simply have to
+ * rediscover any state.
+ */
+void efi_handover_install ( void ) {
+	EFI_BOOT_SERVICES *bs = efi_systab->BootServices;
+	size_t len;
+	EFI_STATUS efirc;
+	int rc;
+
+	/* Construct state handover block */
+	assert ( efi_handover_data == NULL );
+	if ( ( rc = handover_save ( &efi_handover_data, &len ) ) != 0 ) {
+		DBG ( "EFIHANDOVER could not save state: %s\n",
+		      strerror ( rc ) );
+		goto err_save;
+	}
+
+	/* Install configuration table */
+	if ( ( efirc = bs->InstallConfigurationTable ( &efi_handover_guid,
+						       efi_handover_data ) ) !=0){
+		rc = -EEFI ( efirc );
+		DBG ( "EFIHANDOVER could not install table: %s\n",
+		      strerror ( rc ) );
+		goto err_install;
+	}
+	DBG ( "EFIHANDOVER installed %zd-byte table at %p\n",
+	      len, efi_handover_data );
+
+	return;
+
+ err_install:
+	free ( efi_handover_data );
+	efi_handover_data = NULL;
+ err_save:
+	return;
+}
+
+/**
+ * Uninstall state handover configuration table
+ *
+ */
+void efi_handover_uninstall ( void ) {
+	EFI_BOOT_SERVICES *bs = efi_systab->BootServices;
+
+	/* Do nothing unless a table was installed */
+	if ( ! efi_handover_data )
+		return;
+
+	/* Uninstall configuration table */
+	bs->InstallConfigurationTable ( &efi_handover_guid, NULL );
+	free ( efi_handover_data );
+	efi_handover_data = NULL;
+}
+
+/**
+ * Restore handed over state
+ *
+ */
+static void efi_handover_startup ( void ) {
+	int rc;
+
+	/* Do nothing unless we were handed a state handover block */
+	if ( ! efi_handover_table )
+		return;
+
+	/* Restore state */
+	if ( ( rc = handover_restore ( efi_handover_table,
+				       efi_handover_table->len ) ) != 0 ) {
+		DBG ( "EFIHANDOVER could not restore state: %s\n",
+		      strerror ( rc ) );
+	}
+
+	/* Never restore the same state twice */
+	efi_handover_table = NULL;
+}
+
+/** EFI state handover startup function */
+struct startup_fn efi_handover_startup_fn __startup_fn ( STARTUP_NORMAL ) = {
+	.startup = efi_handover_startup,
+};
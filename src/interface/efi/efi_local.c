@@ -115,8 +115,7 @@ static void efi_local_step ( struct efi_local *local ) {
 
 	/* Presize receive buffer */
 	remaining = local->len;
-	xfer_seek ( &local->xfer, remaining );
-	xfer_seek ( &local->xfer, 0 );
+	xfer_presize ( &local->xfer, remaining );
 
 	/* Get file contents */
 	while ( remaining ) {
@@ -420,11 +420,13 @@ static struct interface_descriptor efi_pxe_tftp_desc =
  * @v pxe		PXE base code
  * @v ip		EFI IP address
  * @v filename		Filename
+ * @v mirror		Use HTTP mirror
  * @ret rc		Return status code
  */
 static int efi_pxe_tftp_open ( struct efi_pxe *pxe, EFI_IP_ADDRESS *ip,
-			       const char *filename ) {
+			       const char *filename, int mirror ) {
 	struct sockaddr server;
+	struct uri *mirror_uri;
 	struct uri *uri;
 	int rc;
 
@@ -438,6 +440,18 @@ static int efi_pxe_tftp_open ( struct efi_pxe *pxe, EFI_IP_ADDRESS *ip,
 		goto err_parse;
 	}
 
+	/* Use HTTP mirror, if applicable */
+	if ( mirror ) {
+		mirror_uri = pxe_mirror_uri ( uri );
+		if ( ! mirror_uri ) {
+			rc = -ENOTSUP;
+			goto err_mirror;
+		}
+		uri_put ( uri );
+		uri = mirror_uri;
+		DBGC ( pxe, "PXE %s using mirror %s\n", pxe->name, uri->host );
+	}
+
 	/* Open URI */
 	if ( ( rc = xfer_open_uri ( &pxe->tftp, uri ) ) != 0 ) {
 		DBGC ( pxe, "PXE %s could not open: %s\n",
@@ -446,11 +460,49 @@ static int efi_pxe_tftp_open ( struct efi_pxe *pxe, EFI_IP_ADDRESS *ip,
 	}
 
  err_open:
+ err_mirror:
 	uri_put ( uri );
  err_parse:
 	return rc;
 }
 
+/**
+ * Perform (M)TFTP download
+ *
+ * @v pxe		PXE base code
+ * @v ip		EFI IP address
+ * @v filename		Filename
+ * @v data		Data buffer
+ * @v len		Length of data buffer
+ * @v mirror		Use HTTP mirror
+ * @ret rc		Return status code
+ */
+static int efi_pxe_tftp_download ( struct efi_pxe *pxe, EFI_IP_ADDRESS *ip,
+				   const char *filename, void *data,
+				   size_t len, int mirror ) {
+	int rc;
+
+	/* Initialise data transfer buffer */
+	pxe->buf.data = data;
+	pxe->buf.len = len;
+	pxe->buf.pos = 0;
+
+	/* Open download */
+	if ( ( rc = efi_pxe_tftp_open ( pxe, ip, filename, mirror ) ) != 0 )
+		return rc;
+
+	/* Wait for download to complete */
+	pxe->rc = -EINPROGRESS;
+	while ( pxe->rc == -EINPROGRESS )
+		step();
+	rc = pxe->rc;
+
+	/* Close download */
+	efi_pxe_tftp_close ( pxe, rc );
+
+	return rc;
+}
+
 /******************************************************************************
  *
  * UDP interface
@@ -963,28 +1015,19 @@ efi_pxe_mtftp ( EFI_PXE_BASE_CODE_PROTOCOL *base,
 	 */
 	pxe->blksize = ( ( callback && blksize ) ? *blksize : -1UL );
 
-	/* Initialise data transfer buffer */
-	pxe->buf.data = data;
-	pxe->buf.len = *len;
-
-	/* Open download */
-	if ( ( rc = efi_pxe_tftp_open ( pxe, ip,
-					( ( const char * ) filename ) ) ) != 0 )
-		goto err_open;
-
-	/* Wait for download to complete */
-	pxe->rc = -EINPROGRESS;
-	while ( pxe->rc == -EINPROGRESS )
-		step();
-	if ( ( rc = pxe->rc ) != 0 ) {
+	/* Download via HTTP mirror, if applicable, falling back to
+	 * downloading from the original server.
+	 */
+	if ( ( rc = efi_pxe_tftp_download ( pxe, ip, ( ( char * ) filename ),
+					    data, *len, 1 ) ) != 0 ) {
+		rc = efi_pxe_tftp_download ( pxe, ip, ( ( char * ) filename ),
+					     data, *len, 0 );
+	}
+	if ( rc != 0 ) {
 		DBGC ( pxe, "PXE %s download failed: %s\n",
 		       pxe->name, strerror ( rc ) );
-		goto err_download;
 	}
 
- err_download:
-	efi_pxe_tftp_close ( pxe, rc );
- err_open:
 	efi_snp_release();
  err_opcode:
 	return EFIRC ( rc );
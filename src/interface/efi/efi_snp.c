@@ -36,9 +36,15 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/efi/efi_utils.h>
 #include <ipxe/efi/efi_watchdog.h>
 #include <ipxe/efi/efi_snp.h>
+#include <ipxe/dropstat.h>
 #include <usr/autoboot.h>
 #include <config/general.h>
 
+/** Packets dropped due to a full SNP receive queue */
+static struct drop_counter efi_snp_rx_drops __drop_counter = {
+	.name = "snp.rxqueue",
+};
+
 /** List of SNP devices */
 static LIST_HEAD ( efi_snp_devices );
 
@@ -152,6 +158,7 @@ static void efi_snp_flush ( struct efi_snp_device *snpdev ) {
 		list_del ( &iobuf->list );
 		free_iob ( iobuf );
 	}
+	snpdev->rx_fill = 0;
 }
 
 /**
@@ -162,13 +169,26 @@ static void efi_snp_flush ( struct efi_snp_device *snpdev ) {
 static void efi_snp_poll ( struct efi_snp_device *snpdev ) {
 	EFI_BOOT_SERVICES *bs = efi_systab->BootServices;
 	struct io_buffer *iobuf;
+	int received = 0;
 
 	/* Poll network device */
 	netdev_poll ( snpdev->netdev );
 
 	/* Retrieve any received packets */
 	while ( ( iobuf = netdev_rx_dequeue ( snpdev->netdev ) ) ) {
+		if ( snpdev->rx_fill >= EFI_SNP_MAX_RX ) {
+			DBGC ( snpdev, "SNPDEV %p RX queue full\n", snpdev );
+			drop_count ( &efi_snp_rx_drops );
+			free_iob ( iobuf );
+			continue;
+		}
 		list_add_tail ( &iobuf->list, &snpdev->rx );
+		snpdev->rx_fill++;
+		received = 1;
+	}
+
+	/* Signal the arrival of the whole batch at once */
+	if ( received ) {
 		snpdev->interrupts |= EFI_SIMPLE_NETWORK_RECEIVE_INTERRUPT;
 		bs->SignalEvent ( &snpdev->snp.WaitForPacket );
 	}
@@ -719,8 +739,13 @@ efi_snp_receive ( EFI_SIMPLE_NETWORK_PROTOCOL *snp,
 	if ( efi_snp_claimed )
 		return EFI_NOT_READY;
 
-	/* Poll the network device */
-	efi_snp_poll ( snpdev );
+	/* Poll the network device only if we have no packets already
+	 * queued.  A single poll will typically harvest many packets,
+	 * which can then be returned by subsequent calls without the
+	 * overhead of polling the hardware each time.
+	 */
+	if ( list_empty ( &snpdev->rx ) )
+		efi_snp_poll ( snpdev );
 
 	/* Dequeue a packet, if one is available */
 	iobuf = list_first_entry ( &snpdev->rx, struct io_buffer, list );
@@ -729,7 +754,15 @@ efi_snp_receive ( EFI_SIMPLE_NETWORK_PROTOCOL *snp,
 		rc = -EAGAIN;
 		goto out_no_packet;
 	}
+
+	/* Leave packet queued if caller's buffer is too small */
+	if ( *len < iob_len ( iobuf ) ) {
+		DBGC2 ( snpdev, " too small for +%zx\n", iob_len ( iobuf ) );
+		*len = iob_len ( iobuf );
+		return EFI_BUFFER_TOO_SMALL;
+	}
 	list_del ( &iobuf->list );
+	snpdev->rx_fill--;
 	DBGC2 ( snpdev, "+%zx\n", iob_len ( iobuf ) );
 
 	/* Return packet to caller */
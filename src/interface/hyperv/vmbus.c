@@ -275,38 +275,69 @@ int vmbus_establish_gpadl ( struct vmbus_device *vmdev, userptr_t data,
 	struct vmbus *vmbus = hv->vmbus;
 	physaddr_t addr = user_to_phys ( data, 0 );
 	unsigned int pfn_count = hv_pfn_count ( addr, len );
-	struct {
-		struct vmbus_gpadl_header gpadlhdr;
-		struct vmbus_gpa_range range;
-		uint64_t pfn[pfn_count];
-	} __attribute__ (( packed )) gpadlhdr;
+	union {
+		struct {
+			struct vmbus_gpadl_header gpadlhdr;
+			struct vmbus_gpa_range range;
+			uint64_t pfn[0];
+		} __attribute__ (( packed )) hdr;
+		struct vmbus_gpadl_body body;
+		uint8_t bytes[ sizeof ( ( ( struct hv_post_message * )
+					  NULL )->data ) ];
+	} __attribute__ (( packed )) msg;
 	const struct vmbus_gpadl_created *created = &vmbus->message->created;
 	static unsigned int gpadl = VMBUS_GPADL_MAGIC;
+	unsigned int pfn = 0;
+	unsigned int max;
+	size_t msg_len;
 	unsigned int i;
 	int rc;
 
 	/* Allocate GPADL ID */
 	gpadl++;
 
-	/* Construct message */
-	memset ( &gpadlhdr, 0, sizeof ( gpadlhdr ) );
-	gpadlhdr.gpadlhdr.header.type = cpu_to_le32 ( VMBUS_GPADL_HEADER );
-	gpadlhdr.gpadlhdr.channel = cpu_to_le32 ( vmdev->channel );
-	gpadlhdr.gpadlhdr.gpadl = cpu_to_le32 ( gpadl );
-	gpadlhdr.gpadlhdr.range_len =
-		cpu_to_le16 ( ( sizeof ( gpadlhdr.range ) +
-				sizeof ( gpadlhdr.pfn ) ) );
-	gpadlhdr.gpadlhdr.range_count = cpu_to_le16 ( 1 );
-	gpadlhdr.range.len = cpu_to_le32 ( len );
-	gpadlhdr.range.offset = cpu_to_le32 ( addr & ( PAGE_SIZE - 1 ) );
-	for ( i = 0 ; i < pfn_count ; i++ )
-		gpadlhdr.pfn[i] = ( ( addr / PAGE_SIZE ) + i );
-
-	/* Post message */
-	if ( ( rc = vmbus_post_message ( hv, &gpadlhdr.gpadlhdr.header,
-					 sizeof ( gpadlhdr ) ) ) != 0 )
+	/* Construct header message.  A large buffer may have more
+	 * page frame numbers than will fit within a single message;
+	 * any remaining page frame numbers are sent via subsequent
+	 * "GPADL body" messages.
+	 */
+	memset ( &msg, 0, sizeof ( msg ) );
+	msg.hdr.gpadlhdr.header.type = cpu_to_le32 ( VMBUS_GPADL_HEADER );
+	msg.hdr.gpadlhdr.channel = cpu_to_le32 ( vmdev->channel );
+	msg.hdr.gpadlhdr.gpadl = cpu_to_le32 ( gpadl );
+	msg.hdr.gpadlhdr.range_len =
+		cpu_to_le16 ( ( sizeof ( msg.hdr.range ) +
+				( pfn_count * sizeof ( msg.hdr.pfn[0] ) ) ) );
+	msg.hdr.gpadlhdr.range_count = cpu_to_le16 ( 1 );
+	msg.hdr.range.len = cpu_to_le32 ( len );
+	msg.hdr.range.offset = cpu_to_le32 ( addr & ( PAGE_SIZE - 1 ) );
+	max = ( ( sizeof ( msg ) - sizeof ( msg.hdr ) ) /
+		sizeof ( msg.hdr.pfn[0] ) );
+	for ( i = 0 ; ( ( i < max ) && ( pfn < pfn_count ) ) ; i++ )
+		msg.hdr.pfn[i] = ( ( addr / PAGE_SIZE ) + pfn++ );
+
+	/* Post header message */
+	msg_len = ( sizeof ( msg.hdr ) + ( i * sizeof ( msg.hdr.pfn[0] ) ) );
+	if ( ( rc = vmbus_post_message ( hv, &msg.hdr.gpadlhdr.header,
+					 msg_len ) ) != 0 )
 		return rc;
 
+	/* Post body messages, if applicable */
+	max = ( ( sizeof ( msg ) - sizeof ( msg.body ) ) /
+		sizeof ( msg.body.pfn[0] ) );
+	while ( pfn < pfn_count ) {
+		memset ( &msg, 0, sizeof ( msg ) );
+		msg.body.header.type = cpu_to_le32 ( VMBUS_GPADL_BODY );
+		msg.body.gpadl = cpu_to_le32 ( gpadl );
+		for ( i = 0 ; ( ( i < max ) && ( pfn < pfn_count ) ) ; i++ )
+			msg.body.pfn[i] = ( ( addr / PAGE_SIZE ) + pfn++ );
+		msg_len = ( sizeof ( msg.body ) +
+			    ( i * sizeof ( msg.body.pfn[0] ) ) );
+		if ( ( rc = vmbus_post_message ( hv, &msg.body.header,
+						 msg_len ) ) != 0 )
+			return rc;
+	}
+
 	/* Wait for response */
 	if ( ( rc = vmbus_wait_for_message ( hv, VMBUS_GPADL_CREATED ) ) != 0 )
 		return rc;
@@ -1063,6 +1094,30 @@ int vmbus_poll ( struct vmbus_device *vmdev ) {
 	return 0;
 }
 
+/**
+ * Poll ring buffer until empty
+ *
+ * @v vmdev		VMBus device
+ *
+ * Host interrupts are masked while the ring buffer is drained, so
+ * that the host need not signal us for each packet that it adds
+ * during the batch.
+ */
+void vmbus_poll_all ( struct vmbus_device *vmdev ) {
+
+	/* Mask inbound interrupts for the duration of the batch */
+	vmdev->in->intr_mask = cpu_to_le32 ( 1 );
+	mb();
+
+	/* Process all available packets */
+	while ( vmbus_has_data ( vmdev ) )
+		vmbus_poll ( vmdev );
+
+	/* Unmask inbound interrupts */
+	mb();
+	vmdev->in->intr_mask = 0;
+}
+
 /**
  * Dump channel status (for debugging)
  *
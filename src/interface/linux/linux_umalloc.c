@@ -47,6 +47,25 @@ struct metadata
 
 #define SIZE_MD (sizeof(struct metadata))
 
+/** Minimum size of an allocation to be backed by huge pages
+ *
+ * Large allocations (such as downloaded images) are advised to be
+ * backed by transparent huge pages, to reduce TLB pressure.  This
+ * makes profiling of the linux build reflect the cost of the network
+ * stack rather than the cost of page faults.
+ */
+#define HUGEPAGE_MIN_SIZE (2 * 1024 * 1024)
+
+/** Advise that a large allocation be backed by huge pages */
+static void linux_hugepage(struct metadata *mdptr, size_t size)
+{
+	if (size < HUGEPAGE_MIN_SIZE)
+		return;
+	/* Failure is harmless (e.g. transparent huge pages not available) */
+	if (linux_madvise(mdptr, size + SIZE_MD, MADV_HUGEPAGE) != 0)
+		DBG2("linux_realloc madvise failed: %s\n", linux_strerror(linux_errno));
+}
+
 /** Simple realloc which passes most of the work to mmap(), mremap() and munmap() */
 static void * linux_realloc(void *ptr, size_t size)
 {
@@ -125,6 +144,9 @@ static void * linux_realloc(void *ptr, size_t size)
 		VALGRIND_MALLOCLIKE_BLOCK(ptr, size, SIZE_MD, 0);
 	}
 
+	/* Request huge pages for large allocations */
+	linux_hugepage(mdptr, size);
+
 	/* Update the metadata */
 	VALGRIND_MAKE_MEM_DEFINED(mdptr, SIZE_MD);
 	mdptr->poison = POISON;
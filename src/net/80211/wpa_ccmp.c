@@ -171,142 +171,122 @@ static int ccmp_init ( struct net80211_crypto *crypto, const void *key,
 
 
 /**
- * Encrypt or decrypt data stream using AES in Counter mode
+ * Exclusive-OR one block into another
  *
- * @v ctx	CCMP cryptosystem context
- * @v nonce	Nonce value, 13 bytes
- * @v srcv	Data to encrypt or decrypt
- * @v len	Number of bytes pointed to by @a src
- * @v msrcv	MIC value to encrypt or decrypt (may be NULL)
- * @ret destv	Encrypted or decrypted data
- * @ret mdestv	Encrypted or decrypted MIC value
- *
- * This assumes CCMP parameters of L=2 and M=8. The algorithm is
- * defined in RFC 3610.
+ * @v src	Source block
+ * @v dst	Destination block
  */
-static void ccmp_ctr_xor ( struct ccmp_ctx *ctx, const void *nonce,
-			   const void *srcv, void *destv, int len,
-			   const void *msrcv, void *mdestv )
+static inline void ccmp_xor ( const union aes_matrix *src,
+			      union aes_matrix *dst )
 {
-	u8 A[16], S[16];
-	u16 ctr;
-	int i;
-	const u8 *src = srcv, *msrc = msrcv;
-	u8 *dest = destv, *mdest = mdestv;
-
-	A[0] = 0x01;		/* flags, L' = L - 1 = 1, other bits rsvd */
-	memcpy ( A + 1, nonce, CCMP_NONCE_LEN );
-
-	if ( msrcv ) {
-		A[14] = A[15] = 0;
+	unsigned int i;
 
-		cipher_encrypt ( &aes_algorithm, ctx->aes_ctx, A, S, 16 );
-
-		for ( i = 0; i < 8; i++ ) {
-			*mdest++ = *msrc++ ^ S[i];
-		}
-	}
-
-	for ( ctr = 1 ;; ctr++ ) {
-		A[14] = ctr >> 8;
-		A[15] = ctr & 0xFF;
-
-		cipher_encrypt ( &aes_algorithm, ctx->aes_ctx, A, S, 16 );
-
-		for ( i = 0; i < len && i < 16; i++ )
-			*dest++ = *src++ ^ S[i];
-
-		if ( len <= 16 )
-			break;	/* we're done */
-
-		len -= 16;
-	}
+	for ( i = 0; i < ( sizeof ( dst->column ) /
+			   sizeof ( dst->column[0] ) ); i++ )
+		dst->column[i] ^= src->column[i];
 }
 
 
 /**
- * Advance one block in CBC-MAC calculation
- *
- * @v aes_ctx	AES encryption context with key set
- * @v B		Cleartext block to incorporate (16 bytes)
- * @v X		Previous ciphertext block (16 bytes)
- * @ret B	Clobbered
- * @ret X	New ciphertext block (16 bytes)
- *
- * This function does X := E[key] ( X ^ B ).
- */
-static void ccmp_feed_cbc_mac ( void *aes_ctx, u8 *B, u8 *X )
-{
-	int i;
-	for ( i = 0; i < 16; i++ )
-		B[i] ^= X[i];
-	cipher_encrypt ( &aes_algorithm, aes_ctx, B, X, 16 );
-}
-
-
-/**
- * Calculate MIC on plaintext data using CBC-MAC
+ * Encrypt or decrypt data and calculate MIC in a single pass
  *
  * @v ctx	CCMP cryptosystem context
  * @v nonce	Nonce value, 13 bytes
- * @v data	Data to calculate MIC over
- * @v datalen	Length of @a data
- * @v aad	Additional authentication data, for MIC but not encryption
- * @ret mic	MIC value (unencrypted), 8 bytes
+ * @v aadv	Additional authentication data, for MIC but not encryption
+ * @v srcv	Data to encrypt or decrypt
+ * @v destv	Buffer for encrypted or decrypted data
+ * @v len	Length of data
+ * @v decrypt	Data is to be decrypted
+ * @ret emic	Encrypted MIC value, 8 bytes
+ *
+ * This assumes CCMP parameters of L=2 and M=8, and an AAD length of
+ * 22 bytes (as it always is for 802.11 use when transmitting non-QoS,
+ * not-between-APs frames, the only type we deal with).  The algorithm
+ * is defined in RFC 3610.
  *
- * @a aadlen is assumed to be 22 bytes long, as it always is for
- * 802.11 use when transmitting non-QoS, not-between-APs frames (the
- * only type we deal with).
+ * Each block is encrypted in AES Counter mode and incorporated into
+ * the CBC-MAC before moving on to the next block, so that the data is
+ * traversed only once.  The counter block encryption does not depend
+ * upon the CBC-MAC, allowing the two AES operations to overlap on
+ * CPUs with pipelined AES instructions.
  */
-static void ccmp_cbc_mac ( struct ccmp_ctx *ctx, const void *nonce,
-			   const void *data, u16 datalen,
-			   const void *aad, void *mic )
+static void ccmp_crypt ( struct ccmp_ctx *ctx, const void *nonce,
+			 const void *aadv, const void *srcv, void *destv,
+			 size_t len, int decrypt, void *emic )
 {
-	u8 X[16], B[16];
+	const u8 *aad = aadv;
+	const u8 *src = srcv;
+	u8 *dest = destv;
+	union aes_matrix A, S, B, X;
+	size_t frag;
+	u16 ctr;
 
-	/* Zeroth block: flags, nonce, length */
+	/* Zeroth CBC-MAC block: flags, nonce, length */
 
 	/* Rsv AAD - M'-  - L'-
 	 *  0   1  0 1 1  0 0 1   for an 8-byte MAC and 2-byte message length
 	 */
-	B[0] = 0x59;
-	memcpy ( B + 1, nonce, CCMP_NONCE_LEN );
-	B[14] = datalen >> 8;
-	B[15] = datalen & 0xFF;
-
-	cipher_encrypt ( &aes_algorithm, ctx->aes_ctx, B, X, 16 );
-
-	/* First block: AAD length field and 14 bytes of AAD */
-	B[0] = 0;
-	B[1] = CCMP_AAD_LEN;
-	memcpy ( B + 2, aad, 14 );
-
-	ccmp_feed_cbc_mac ( ctx->aes_ctx, B, X );
-
-	/* Second block: Remaining 8 bytes of AAD, 8 bytes zero pad */
-	memcpy ( B, aad + 14, 8 );
-	memset ( B + 8, 0, 8 );
-
-	ccmp_feed_cbc_mac ( ctx->aes_ctx, B, X );
+	B.byte[0] = 0x59;
+	memcpy ( &B.byte[1], nonce, CCMP_NONCE_LEN );
+	B.byte[14] = len >> 8;
+	B.byte[15] = len & 0xFF;
+	cipher_encrypt ( &aes_algorithm, ctx->aes_ctx, &B, &X, sizeof ( X ) );
+
+	/* First CBC-MAC block: AAD length field and 14 bytes of AAD */
+	B.byte[0] = 0;
+	B.byte[1] = CCMP_AAD_LEN;
+	memcpy ( &B.byte[2], aad, 14 );
+	ccmp_xor ( &B, &X );
+	cipher_encrypt ( &aes_algorithm, ctx->aes_ctx, &X, &X, sizeof ( X ) );
+
+	/* Second CBC-MAC block: remaining 8 bytes of AAD, zero pad */
+	memcpy ( &B.byte[0], aad + 14, 8 );
+	memset ( &B.byte[8], 0, 8 );
+	ccmp_xor ( &B, &X );
+	cipher_encrypt ( &aes_algorithm, ctx->aes_ctx, &X, &X, sizeof ( X ) );
+
+	/* Counter block: flags, L' = L - 1 = 1, other bits rsvd */
+	A.byte[0] = 0x01;
+	memcpy ( &A.byte[1], nonce, CCMP_NONCE_LEN );
 
 	/* Message blocks */
-	while ( datalen ) {
-		if ( datalen >= 16 ) {
-			memcpy ( B, data, 16 );
-			datalen -= 16;
+	for ( ctr = 1 ; len ; ctr++ ) {
+		frag = ( ( len < sizeof ( B ) ) ? len : sizeof ( B ) );
+
+		/* Generate key stream block */
+		A.byte[14] = ctr >> 8;
+		A.byte[15] = ctr & 0xFF;
+		cipher_encrypt ( &aes_algorithm, ctx->aes_ctx, &A, &S,
+				 sizeof ( S ) );
+
+		/* Encrypt or decrypt, and incorporate cleartext
+		 * (zero-padded) into CBC-MAC.
+		 */
+		memcpy ( &B, src, frag );
+		if ( decrypt ) {
+			ccmp_xor ( &S, &B );
+			memset ( &B.byte[frag], 0, ( sizeof ( B ) - frag ) );
+			memcpy ( dest, &B, frag );
+			ccmp_xor ( &B, &X );
 		} else {
-			memcpy ( B, data, datalen );
-			memset ( B + datalen, 0, 16 - datalen );
-			datalen = 0;
+			memset ( &B.byte[frag], 0, ( sizeof ( B ) - frag ) );
+			ccmp_xor ( &B, &X );
+			ccmp_xor ( &S, &B );
+			memcpy ( dest, &B, frag );
 		}
+		cipher_encrypt ( &aes_algorithm, ctx->aes_ctx, &X, &X,
+				 sizeof ( X ) );
 
-		ccmp_feed_cbc_mac ( ctx->aes_ctx, B, X );
-
-		data += 16;
+		src += frag;
+		dest += frag;
+		len -= frag;
 	}
 
-	/* Get MIC from final value of X */
-	memcpy ( mic, X, 8 );
+	/* Encrypt MIC using zeroth key stream block */
+	A.byte[14] = A.byte[15] = 0;
+	cipher_encrypt ( &aes_algorithm, ctx->aes_ctx, &A, &S, sizeof ( S ) );
+	ccmp_xor ( &S, &X );
+	memcpy ( emic, &X, CCMP_MIC_LEN );
 }
 
 
@@ -328,7 +308,7 @@ struct io_buffer * ccmp_encrypt ( struct net80211_crypto *crypto,
 	struct ccmp_head head;
 	struct ccmp_nonce nonce;
 	struct ccmp_aad aad;
-	u8 mic[8], tx_pn[6];
+	u8 tx_pn[6];
 	void *edata, *emic;
 
 	ctx->tx_seq++;
@@ -361,15 +341,11 @@ struct io_buffer * ccmp_encrypt ( struct net80211_crypto *crypto,
 	memcpy ( aad.a1, hdr->addr1, 3 * ETH_ALEN ); /* all 3 at once */
 	aad.seq = hdr->seq & CCMP_AAD_SEQ_MASK;
 
-	/* Calculate MIC over the data */
-	ccmp_cbc_mac ( ctx, &nonce, iob->data + hdrlen, datalen, &aad, mic );
-
-	/* Copy and encrypt data and MIC */
+	/* Copy and encrypt data, and calculate MIC */
 	edata = iob_put ( eiob, datalen );
 	emic = iob_put ( eiob, CCMP_MIC_LEN );
-	ccmp_ctr_xor ( ctx, &nonce,
-		       iob->data + hdrlen, edata, datalen,
-		       mic, emic );
+	ccmp_crypt ( ctx, &nonce, &aad, iob->data + hdrlen, edata, datalen,
+		     0, emic );
 
 	/* Done! */
 	DBGC2 ( ctx, "WPA-CCMP %p: encrypted packet %p -> %p\n", ctx,
@@ -396,7 +372,7 @@ static struct io_buffer * ccmp_decrypt ( struct net80211_crypto *crypto,
 	struct ccmp_head *head;
 	struct ccmp_nonce nonce;
 	struct ccmp_aad aad;
-	u8 rx_pn[6], their_mic[8], our_mic[8];
+	u8 rx_pn[6], our_mic[8];
 
 	iob = alloc_iob ( hdrlen + datalen );
 	if ( ! iob )
@@ -433,16 +409,13 @@ static struct io_buffer * ccmp_decrypt ( struct net80211_crypto *crypto,
 	memcpy ( aad.a1, hdr->addr1, 3 * ETH_ALEN ); /* all 3 at once */
 	aad.seq = hdr->seq & CCMP_AAD_SEQ_MASK;
 
-	/* Copy-decrypt data and MIC */
-	ccmp_ctr_xor ( ctx, &nonce, eiob->data + hdrlen + sizeof ( *head ),
-		       iob_put ( iob, datalen ), datalen,
-		       eiob->tail - CCMP_MIC_LEN, their_mic );
+	/* Copy-decrypt data, and calculate MIC */
+	ccmp_crypt ( ctx, &nonce, &aad, eiob->data + hdrlen + sizeof ( *head ),
+		     iob_put ( iob, datalen ), datalen, 1, our_mic );
 
 	/* Check MIC */
-	ccmp_cbc_mac ( ctx, &nonce, iob->data + hdrlen, datalen, &aad,
-		       our_mic );
-
-	if ( memcmp ( their_mic, our_mic, CCMP_MIC_LEN ) != 0 ) {
+	if ( memcmp ( eiob->tail - CCMP_MIC_LEN, our_mic,
+		      CCMP_MIC_LEN ) != 0 ) {
 		DBGC2 ( ctx, "WPA-CCMP %p: MIC failure\n", ctx );
 		free_iob ( iob );
 		return NULL;
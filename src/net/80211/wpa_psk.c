@@ -22,14 +22,120 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <string.h>
 #include <ipxe/net80211.h>
 #include <ipxe/sha1.h>
+#include <ipxe/hmac.h>
+#include <ipxe/settings.h>
 #include <ipxe/wpa.h>
 #include <errno.h>
 
 /** @file
  *
  * Frontend for WPA using a pre-shared key.
+ *
+ * Deriving the PMK from a passphrase requires 8192 SHA-1 block
+ * operations, which can take several seconds on a slow CPU.  The
+ * derived PMK is therefore cached in the "wpa-pmk" setting, along
+ * with a check value binding it to the SSID and passphrase from which
+ * it was derived.  A cached PMK may be reused on any subsequent
+ * association, and may be persisted (e.g. in non-volatile options)
+ * or supplied by a script.  Anyone able to read the setting can join
+ * the network, so it must be protected in the same way as the
+ * passphrase itself.
  */
 
+/** A cached WPA-PSK pairwise master key */
+struct wpa_psk_cache {
+	/** Check value (HMAC-SHA1 of SSID and passphrase, keyed by PMK) */
+	u8 check[SHA1_DIGEST_SIZE];
+	/** Pairwise master key */
+	u8 pmk[WPA_PMK_LEN];
+} __attribute__ (( packed ));
+
+/** Cached WPA-PSK pairwise master key setting */
+const struct setting wpa_psk_cache_setting __setting ( SETTING_NETDEV_EXTRA,
+						       wpa-pmk ) = {
+	.name = "wpa-pmk",
+	.description = "Cached WPA-PSK pairwise master key",
+	.type = &setting_type_hex,
+};
+
+/**
+ * Calculate check value for cached PMK
+ *
+ * @v essid	Network name
+ * @v passphrase Passphrase
+ * @v len	Length of passphrase
+ * @v cache	Cached PMK to fill in check value
+ */
+static void wpa_psk_cache_check ( const char *essid, const char *passphrase,
+				  size_t len, struct wpa_psk_cache *cache )
+{
+	u8 sha1_ctx[SHA1_CTX_SIZE];
+	u8 key[WPA_PMK_LEN];
+	size_t key_len = sizeof ( key );
+
+	memcpy ( key, cache->pmk, sizeof ( key ) );
+	hmac_init ( &sha1_algorithm, sha1_ctx, key, &key_len );
+	hmac_update ( &sha1_algorithm, sha1_ctx, essid,
+		      ( strlen ( essid ) + 1 ) );
+	hmac_update ( &sha1_algorithm, sha1_ctx, passphrase, len );
+	hmac_final ( &sha1_algorithm, sha1_ctx, key, &key_len, cache->check );
+}
+
+/**
+ * Fetch cached PMK
+ *
+ * @v dev	802.11 device
+ * @v passphrase Passphrase
+ * @v len	Length of passphrase
+ * @v pmk	PMK to fill in
+ * @ret rc	Return status code
+ */
+static int wpa_psk_cache_fetch ( struct net80211_device *dev,
+				 const char *passphrase, size_t len, u8 *pmk )
+{
+	struct wpa_psk_cache cache;
+	struct wpa_psk_cache check;
+	int cache_len;
+
+	/* Fetch cached PMK, if any */
+	cache_len = fetch_raw_setting ( netdev_settings ( dev->netdev ),
+					&wpa_psk_cache_setting, &cache,
+					sizeof ( cache ) );
+	if ( cache_len != sizeof ( cache ) )
+		return -ENOENT;
+
+	/* Check that PMK was derived from this SSID and passphrase */
+	memcpy ( check.pmk, cache.pmk, sizeof ( check.pmk ) );
+	wpa_psk_cache_check ( dev->essid, passphrase, len, &check );
+	if ( memcmp ( check.check, cache.check, sizeof ( check.check ) ) != 0 )
+		return -ENOENT;
+
+	memcpy ( pmk, cache.pmk, sizeof ( cache.pmk ) );
+	return 0;
+}
+
+/**
+ * Store cached PMK
+ *
+ * @v dev	802.11 device
+ * @v passphrase Passphrase
+ * @v len	Length of passphrase
+ * @v pmk	PMK
+ * @ret rc	Return status code
+ */
+static int wpa_psk_cache_store ( struct net80211_device *dev,
+				 const char *passphrase, size_t len,
+				 const u8 *pmk )
+{
+	struct wpa_psk_cache cache;
+
+	memcpy ( cache.pmk, pmk, sizeof ( cache.pmk ) );
+	wpa_psk_cache_check ( dev->essid, passphrase, len, &cache );
+	return store_setting ( netdev_settings ( dev->netdev ),
+			       &wpa_psk_cache_setting, &cache,
+			       sizeof ( cache ) );
+}
+
 /**
  * Initialise WPA-PSK state
  *
@@ -52,6 +158,7 @@ static int wpa_psk_start ( struct net80211_device *dev )
 	char passphrase[64+1];
 	u8 pmk[WPA_PMK_LEN];
 	int len;
+	int rc;
 	struct wpa_common_ctx *ctx = dev->handshaker->priv;
 
 	len = fetch_string_setting ( netdev_settings ( dev->netdev ),
@@ -64,6 +171,12 @@ static int wpa_psk_start ( struct net80211_device *dev )
 		return -EACCES;
 	}
 
+	/* Reuse cached PMK, if available */
+	if ( wpa_psk_cache_fetch ( dev, passphrase, len, pmk ) == 0 ) {
+		DBGC ( ctx, "WPA-PSK %p: using cached PMK\n", ctx );
+		return wpa_start ( dev, ctx, pmk, WPA_PMK_LEN );
+	}
+
 	pbkdf2_sha1 ( passphrase, len, dev->essid, strlen ( dev->essid ),
 		      4096, pmk, WPA_PMK_LEN );
 
@@ -71,6 +184,12 @@ static int wpa_psk_start ( struct net80211_device *dev )
 	       passphrase );
 	DBGC_HD ( ctx, pmk, WPA_PMK_LEN );
 
+	/* Cache PMK for subsequent associations (failure is not fatal) */
+	if ( ( rc = wpa_psk_cache_store ( dev, passphrase, len, pmk ) ) != 0 ) {
+		DBGC ( ctx, "WPA-PSK %p: could not cache PMK: %s\n",
+		       ctx, strerror ( rc ) );
+	}
+
 	return wpa_start ( dev, ctx, pmk, WPA_PMK_LEN );
 }
 
@@ -53,6 +53,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 FEATURE ( FEATURE_PROTOCOL, "AoE", DHCP_EB_FEATURE_AOE, 1 );
 
 struct net_protocol aoe_protocol __net_protocol;
+static struct aoe_command_type aoecmd_ata;
 
 /******************************************************************************
  *
@@ -86,6 +87,12 @@ struct aoe_device {
 
 	/** Saved timeout value */
 	unsigned long timeout;
+	/** Maximum number of sectors per ATA command */
+	unsigned int max_count;
+	/** Maximum number of outstanding ATA commands */
+	unsigned int max_active;
+	/** Number of outstanding ATA commands */
+	unsigned int active;
 
 	/** Configuration command interface */
 	struct interface config;
@@ -237,6 +244,10 @@ static void aoecmd_close ( struct aoe_command *aoecmd, int rc ) {
 
 	/* Remove from list of commands */
 	if ( ! list_empty ( &aoecmd->list ) ) {
+		if ( aoecmd->type == &aoecmd_ata ) {
+			assert ( aoedev->active > 0 );
+			aoedev->active--;
+		}
 		list_del ( &aoecmd->list );
 		INIT_LIST_HEAD ( &aoecmd->list );
 		aoecmd_put ( aoecmd );
@@ -550,6 +561,19 @@ static int aoecmd_cfg_rsp ( struct aoe_command *aoecmd, const void *data,
 	       aoedev_name ( aoedev ), aoecmd->tag, ntohs ( aoecfg->bufcnt ),
 	       aoecfg->fwver, aoecfg->scnt );
 
+	/* Record target limits.  A target that fails to report a
+	 * sector count or queue depth is treated as supporting only
+	 * the minimum.
+	 */
+	if ( aoecfg->scnt < aoedev->max_count )
+		aoedev->max_count = ( aoecfg->scnt ? aoecfg->scnt : 1 );
+	aoedev->max_active = ntohs ( aoecfg->bufcnt );
+	if ( ! aoedev->max_active )
+		aoedev->max_active = 1;
+	DBGC ( aoedev, "AoE %s using up to %d commands of %d sectors\n",
+	       aoedev_name ( aoedev ), aoedev->max_active,
+	       aoedev->max_count );
+
 	/* Record target MAC address */
 	memcpy ( aoedev->target, ll_source, ll_protocol->ll_addr_len );
 	DBGC ( aoedev, "AoE %s has MAC address %s\n",
@@ -669,6 +693,7 @@ static int aoedev_ata_command ( struct aoe_device *aoedev,
 	if ( ! aoecmd )
 		return -ENOMEM;
 	memcpy ( &aoecmd->command, command, sizeof ( aoecmd->command ) );
+	aoedev->active++;
 
 	/* Attempt to send command.  Allow failures to be handled by
 	 * the retry timer.
@@ -754,7 +779,25 @@ static void aoedev_close ( struct aoe_device *aoedev, int rc ) {
  * @ret len		Length of window
  */
 static size_t aoedev_window ( struct aoe_device *aoedev ) {
-	return ( aoedev->configured ? ~( ( size_t ) 0 ) : 0 );
+
+	/* Allow no commands until device is configured */
+	if ( ! aoedev->configured )
+		return 0;
+
+	/* Allow as many outstanding commands as the target can queue */
+	if ( aoedev->active >= aoedev->max_active )
+		return 0;
+	return ~( ( size_t ) 0 );
+}
+
+/**
+ * Get maximum number of sectors per ATA command
+ *
+ * @v aoedev		AoE device
+ * @ret max_count	Maximum number of sectors
+ */
+static unsigned int aoedev_max_count ( struct aoe_device *aoedev ) {
+	return aoedev->max_count;
 }
 
 /**
@@ -822,6 +865,7 @@ static int aoedev_describe ( struct aoe_device *aoedev,
 static struct interface_operation aoedev_ata_op[] = {
 	INTF_OP ( ata_command, struct aoe_device *, aoedev_ata_command ),
 	INTF_OP ( xfer_window, struct aoe_device *, aoedev_window ),
+	INTF_OP ( ata_max_count, struct aoe_device *, aoedev_max_count ),
 	INTF_OP ( intf_close, struct aoe_device *, aoedev_close ),
 	INTF_OP ( acpi_describe, struct aoe_device *, aoedev_describe ),
 	INTF_OP ( identify_device, struct aoe_device *,
@@ -853,6 +897,7 @@ static struct interface_descriptor aoedev_config_desc =
 static int aoedev_open ( struct interface *parent, struct net_device *netdev,
 			 unsigned int major, unsigned int minor ) {
 	struct aoe_device *aoedev;
+	size_t max_len;
 	int rc;
 
 	/* Allocate and initialise structure */
@@ -870,6 +915,16 @@ static int aoedev_open ( struct interface *parent, struct net_device *netdev,
 	memcpy ( aoedev->target, netdev->ll_broadcast,
 		 netdev->ll_protocol->ll_addr_len );
 
+	/* Determine number of sectors that fit within a packet */
+	max_len = ( sizeof ( struct aoehdr ) + sizeof ( struct aoeata ) );
+	max_len = ( ( netdev->mtu > max_len ) ? ( netdev->mtu - max_len ) : 0 );
+	aoedev->max_count = ( max_len / ATA_SECTOR_SIZE );
+	if ( aoedev->max_count > AOE_MAX_COUNT )
+		aoedev->max_count = AOE_MAX_COUNT;
+	if ( ! aoedev->max_count )
+		aoedev->max_count = 1;
+	aoedev->max_active = 1;
+
 	/* Initiate configuration */
 	if ( ( rc = aoedev_cfg_command ( aoedev, &aoedev->config ) ) < 0 ) {
 		DBGC ( aoedev, "AoE %s could not initiate configuration: %s\n",
@@ -879,7 +934,7 @@ static int aoedev_open ( struct interface *parent, struct net_device *netdev,
 
 	/* Attach ATA device to parent interface */
 	if ( ( rc = ata_open ( parent, &aoedev->ata, ATA_DEV_MASTER,
-			       AOE_MAX_COUNT ) ) != 0 ) {
+			       aoedev->max_count ) ) != 0 ) {
 		DBGC ( aoedev, "AoE %s could not create ATA device: %s\n",
 		       aoedev_name ( aoedev ), strerror ( rc ) );
 		goto err_ata_open;
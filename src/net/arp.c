@@ -47,6 +47,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 struct net_protocol arp_protocol __net_protocol;
 
+/** An unspecified network-layer address */
+static const uint8_t arp_zero_pa[MAX_NET_ADDR_LEN];
+
 /**
  * Transmit ARP request
  *
@@ -181,6 +184,17 @@ static int arp_rx ( struct io_buffer *iobuf, struct net_device *netdev,
 		goto done;
 	}
 
+	/* Record sender in neighbour cache, since we are likely to
+	 * need to transmit to it shortly (RFC 826).  Ignore probes
+	 * with an unspecified sender address (RFC 5227).
+	 */
+	if ( memcmp ( arp_sender_pa ( arphdr ), arp_zero_pa,
+		      arphdr->ar_pln ) != 0 ) {
+		neighbour_define ( netdev, net_protocol,
+				   arp_sender_pa ( arphdr ),
+				   arp_sender_ha ( arphdr ) );
+	}
+
 	/* Change request to a reply */
 	DBGC2 ( netdev, "ARP %s %s %s reply => %s %s\n",
 		netdev->name, net_protocol->name,
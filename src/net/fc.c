@@ -797,6 +797,80 @@ static struct fc_exchange * fc_xchg_respond ( struct fc_port *port,
  ******************************************************************************
  */
 
+/**
+ * Record discovered peer port ID
+ *
+ * @v port		Fibre Channel port
+ * @v port_wwn		Peer port name
+ * @v port_id		Peer port ID
+ */
+static void fc_port_discovered ( struct fc_port *port,
+				 const struct fc_name *port_wwn,
+				 const struct fc_port_id *port_id ) {
+	struct fc_discovered *discovered;
+
+	/* Update existing entry, if any */
+	list_for_each_entry ( discovered, &port->discovered, list ) {
+		if ( memcmp ( &discovered->port_wwn, port_wwn,
+			      sizeof ( discovered->port_wwn ) ) == 0 )
+			goto found;
+	}
+
+	/* Otherwise, create new entry.  Failure is not fatal, since
+	 * the port ID can always be rediscovered.
+	 */
+	discovered = malloc ( sizeof ( *discovered ) );
+	if ( ! discovered )
+		return;
+	memcpy ( &discovered->port_wwn, port_wwn,
+		 sizeof ( discovered->port_wwn ) );
+	list_add ( &discovered->list, &port->discovered );
+
+ found:
+	memcpy ( &discovered->port_id, port_id,
+		 sizeof ( discovered->port_id ) );
+}
+
+/**
+ * Find discovered peer port ID
+ *
+ * @v port		Fibre Channel port
+ * @v port_wwn		Peer port name
+ * @ret port_id		Peer port ID, or NULL if not known
+ */
+static struct fc_port_id * fc_port_find_discovered ( struct fc_port *port,
+					const struct fc_name *port_wwn ) {
+	struct fc_discovered *discovered;
+
+	list_for_each_entry ( discovered, &port->discovered, list ) {
+		if ( memcmp ( &discovered->port_wwn, port_wwn,
+			      sizeof ( discovered->port_wwn ) ) == 0 )
+			return &discovered->port_id;
+	}
+	return NULL;
+}
+
+/**
+ * Forget discovered peer port IDs
+ *
+ * @v port		Fibre Channel port
+ * @v port_wwn		Peer port name, or NULL to forget all peers
+ */
+static void fc_port_forget ( struct fc_port *port,
+			     const struct fc_name *port_wwn ) {
+	struct fc_discovered *discovered;
+	struct fc_discovered *tmp;
+
+	list_for_each_entry_safe ( discovered, tmp, &port->discovered, list ) {
+		if ( port_wwn &&
+		     ( memcmp ( &discovered->port_wwn, port_wwn,
+				sizeof ( discovered->port_wwn ) ) != 0 ) )
+			continue;
+		list_del ( &discovered->list );
+		free ( discovered );
+	}
+}
+
 /**
  * Close Fibre Channel port
  *
@@ -813,6 +887,9 @@ static void fc_port_close ( struct fc_port *port, int rc ) {
 	if ( fc_link_ok ( &port->link ) )
 		fc_port_logout ( port, rc );
 
+	/* Forget all discovered peer port IDs */
+	fc_port_forget ( port, NULL );
+
 	/* Stop link monitor */
 	fc_link_stop ( &port->link );
 
@@ -1047,6 +1124,11 @@ void fc_port_logout ( struct fc_port *port, int rc ) {
 	memset ( &port->port_id, 0, sizeof ( port->port_id ) );
 	port->flags = 0;
 
+	/* Forget all discovered peer port IDs, since these may change
+	 * when we next log in to the fabric.
+	 */
+	fc_port_forget ( port, NULL );
+
 	/* Record logout */
 	fc_link_err ( &port->link, rc );
 
@@ -1079,6 +1161,8 @@ static void fc_port_flogi_done ( struct fc_port *port, int rc ) {
  * @v rc		Reason for completion
  */
 static void fc_port_ns_plogi_done ( struct fc_port *port, int rc ) {
+	struct fc_peer *peer;
+	struct fc_peer *tmp;
 
 	intf_restart ( &port->ns_plogi, rc );
 
@@ -1086,6 +1170,14 @@ static void fc_port_ns_plogi_done ( struct fc_port *port, int rc ) {
 		port->flags |= FC_PORT_HAS_NS;
 		DBGC ( port, "FCPORT %s logged in to name server\n",
 		       port->name );
+		/* Notify peers immediately, rather than leaving them
+		 * to wait for their next link retry.
+		 */
+		list_for_each_entry_safe ( peer, tmp, &fc_peers, list ) {
+			fc_peer_get ( peer );
+			fc_link_examine ( &peer->link );
+			fc_peer_put ( peer );
+		}
 	} else {
 		DBGC ( port, "FCPORT %s could not log in to name server: %s\n",
 		       port->name, strerror ( rc ) );
@@ -1201,6 +1293,7 @@ int fc_port_open ( struct interface *transport, const struct fc_name *node_wwn,
 	intf_init ( &port->ns_plogi, &fc_port_ns_plogi_desc, &port->refcnt );
 	list_add_tail ( &port->list, &fc_ports );
 	INIT_LIST_HEAD ( &port->xchgs );
+	INIT_LIST_HEAD ( &port->discovered );
 	memcpy ( &port->node_wwn, node_wwn, sizeof ( port->node_wwn ) );
 	memcpy ( &port->port_wwn, port_wwn, sizeof ( port->port_wwn ) );
 	snprintf ( port->name, sizeof ( port->name ), "%s", name );
@@ -1325,6 +1418,10 @@ int fc_peer_login ( struct fc_peer *peer, struct fc_port *port,
 		fc_peer_get ( peer );
 	}
 
+	/* Record port ID for reuse in subsequent logins */
+	if ( port->flags & FC_PORT_HAS_FABRIC )
+		fc_port_discovered ( port, &peer->port_wwn, port_id );
+
 	/* Record login */
 	fc_link_up ( &peer->link );
 
@@ -1381,11 +1478,16 @@ void fc_peer_logout ( struct fc_peer *peer, int rc ) {
  * @v rc		Reason for completion
  */
 static void fc_peer_plogi_done ( struct fc_peer *peer, int rc ) {
+	struct fc_port *port;
 
 	intf_restart ( &peer->plogi, rc );
 
-	if ( rc != 0 )
+	if ( rc != 0 ) {
+		/* Any discovered port ID may be stale */
+		list_for_each_entry ( port, &fc_ports, list )
+			fc_port_forget ( port, &peer->port_wwn );
 		fc_peer_logout ( peer, rc );
+	}
 }
 
 /**
@@ -1400,8 +1502,18 @@ static int fc_peer_plogi ( struct fc_peer *peer, struct fc_port *port,
 			   struct fc_port_id *peer_port_id ) {
 	int rc;
 
+	/* Do not cancel a PLOGI already in progress.  Name server
+	 * lookups are issued concurrently on all ports, and the
+	 * first port to resolve the peer is used.
+	 */
+	if ( peer->plogi.dest != &null_intf ) {
+		DBGC ( peer, "FCPEER %s ignoring %s via %s: PLOGI in "
+		       "progress\n", fc_ntoa ( &peer->port_wwn ),
+		       fc_id_ntoa ( peer_port_id ), port->name );
+		return 0;
+	}
+
 	/* Try to create PLOGI ELS */
-	intf_restart ( &peer->plogi, -ECANCELED );
 	if ( ( rc = fc_els_plogi ( &peer->plogi, port, peer_port_id ) ) != 0 ) {
 		DBGC ( peer, "FCPEER %s could not initiate PLOGI: %s\n",
 		       fc_ntoa ( &peer->port_wwn ), strerror ( rc ) );
@@ -1420,6 +1532,7 @@ static int fc_peer_plogi ( struct fc_peer *peer, struct fc_port *port,
 static void fc_peer_examine ( struct fc_link_state *link ) {
 	struct fc_peer *peer = container_of ( link, struct fc_peer, link );
 	struct fc_port *port;
+	struct fc_port_id *port_id;
 	int rc;
 
 	/* Check to see if underlying port link has gone down */
@@ -1428,8 +1541,8 @@ static void fc_peer_examine ( struct fc_link_state *link ) {
 		return;
 	}
 
-	/* Do nothing if already logged in */
-	if ( fc_link_ok ( &peer->link ) )
+	/* Do nothing if already logged in, or if login is in progress */
+	if ( fc_link_ok ( &peer->link ) || ( peer->plogi.dest != &null_intf ) )
 		return;
 
 	DBGC ( peer, "FCPEER %s attempting login\n",
@@ -1452,6 +1565,22 @@ static void fc_peer_examine ( struct fc_link_state *link ) {
 		}
 	}
 
+	/* Next, look for a port via which the peer's port ID has
+	 * previously been discovered.
+	 */
+	list_for_each_entry ( port, &fc_ports, list ) {
+		if ( fc_link_ok ( &port->link ) &&
+		     ( port->flags & FC_PORT_HAS_FABRIC ) &&
+		     ( ( port_id = fc_port_find_discovered ( port,
+						&peer->port_wwn ) ) ) ) {
+			DBGC ( peer, "FCPEER %s using discovered %s via "
+			       "%s\n", fc_ntoa ( &peer->port_wwn ),
+			       fc_id_ntoa ( port_id ), port->name );
+			fc_peer_plogi ( peer, port, port_id );
+			return;
+		}
+	}
+
 	/* If the peer is not directly attached, try initiating a name
 	 * server lookup on any suitable ports.
 	 */
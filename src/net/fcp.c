@@ -157,6 +157,15 @@ struct fcp_device {
 	struct interface scsi;
 	/** List of active commands */
 	struct list_head fcpcmds;
+	/** Number of outstanding commands */
+	unsigned int active;
+	/** Maximum number of outstanding commands
+	 *
+	 * FCP provides no way to discover the depth of the target's
+	 * command queue.  We start with no limit, and reduce the
+	 * limit whenever the target reports that its queue is full.
+	 */
+	unsigned int max_active;
 
 	/** Fibre Channel WWN (for boot firmware table) */
 	struct fc_name wwn;
@@ -186,12 +195,20 @@ struct fcp_command {
 	int ( * send ) ( struct fcp_command *fcpcmd );
 	/** SCSI command */
 	struct scsi_cmd command;
-	/** Data offset within command */
+	/** Data offset within command
+	 *
+	 * For write data, this is the offset of the next data to be
+	 * sent.  For read data, which is placed directly into the
+	 * data buffer using the relative offset of each frame, this
+	 * is the total length of data received.
+	 */
 	size_t offset;
 	/** Length of data remaining to be sent within this IU */
 	size_t remaining;
 	/** Exchange ID */
 	uint16_t xchg_id;
+	/** Command is counted as outstanding */
+	int active;
 };
 
 /**
@@ -292,6 +309,13 @@ static void fcpcmd_close ( struct fcp_command *fcpcmd, int rc ) {
 		       fcpdev, fcpcmd->xchg_id, strerror ( rc ) );
 	}
 
+	/* Stop counting as an outstanding command */
+	if ( fcpcmd->active ) {
+		fcpcmd->active = 0;
+		assert ( fcpdev->active > 0 );
+		fcpdev->active--;
+	}
+
 	/* Stop sending */
 	fcpcmd_stop_send ( fcpcmd );
 
@@ -396,24 +420,24 @@ static int fcpcmd_recv_rddata ( struct fcp_command *fcpcmd,
 		rc = -ERANGE_READ_DATA_ORDERING;
 		goto done;
 	}
-	if ( offset != fcpcmd->offset ) {
-		DBGC ( fcpdev, "FCP %p xchg %04x read data out of order "
-		       "(expected %zd, received %zd)\n",
-		       fcpdev, fcpcmd->xchg_id, fcpcmd->offset, offset );
-		rc = -ERANGE_READ_DATA_ORDERING;
-		goto done;
-	}
-	if ( ( offset + len ) > command->data_in_len ) {
+	if ( ( offset > command->data_in_len ) ||
+	     ( len > ( command->data_in_len - offset ) ) ||
+	     ( len > ( command->data_in_len - fcpcmd->offset ) ) ) {
 		DBGC ( fcpdev, "FCP %p xchg %04x read data overrun (max %zd, "
-		       "received %zd)\n", fcpdev, fcpcmd->xchg_id,
-		       command->data_in_len, ( offset + len ) );
+		       "received [%08zx,%08zx) after %zd)\n", fcpdev,
+		       fcpcmd->xchg_id, command->data_in_len, offset,
+		       ( offset + len ), fcpcmd->offset );
 		rc = -ERANGE_READ_DATA_OVERRUN;
 		goto done;
 	}
 	DBGC2 ( fcpdev, "FCP %p xchg %04x RDDATA [%08zx,%08zx)\n",
 		fcpdev, fcpcmd->xchg_id, offset, ( offset + len ) );
 
-	/* Copy to user buffer */
+	/* Place data directly at its relative offset within the user
+	 * buffer.  Data IUs need not arrive in order; the total
+	 * length received is checked against the expected length
+	 * when the response arrives.
+	 */
 	copy_to_user ( command->data_in, offset, iobuf->data, len );
 	fcpcmd->offset += len;
 	assert ( fcpcmd->offset <= command->data_in_len );
@@ -601,6 +625,19 @@ static int fcpcmd_recv_rsp ( struct fcp_command *fcpcmd,
 		goto done;
 	}
 
+	/* Reduce the number of outstanding commands if the target's
+	 * command queue is full.
+	 */
+	if ( ( ( rsp->status == SCSI_STATUS_TASK_SET_FULL ) ||
+	       ( rsp->status == SCSI_STATUS_BUSY ) ) &&
+	     ( fcpdev->active <= fcpdev->max_active ) ) {
+		fcpdev->max_active =
+			( ( fcpdev->active > 1 ) ? ( fcpdev->active - 1 ) : 1 );
+		DBGC ( fcpdev, "FCP %p xchg %04x queue full; limiting to %d "
+		       "outstanding commands\n", fcpdev, fcpcmd->xchg_id,
+		       fcpdev->max_active );
+	}
+
 	/* Build SCSI response */
 	memset ( &response, 0, sizeof ( response ) );
 	response.status = rsp->status;
@@ -776,6 +813,8 @@ static int fcpdev_scsi_command ( struct fcp_device *fcpdev,
 	fcpcmd->fcpdev = fcpdev_get ( fcpdev );
 	list_add ( &fcpcmd->list, &fcpdev->fcpcmds );
 	memcpy ( &fcpcmd->command, command, sizeof ( fcpcmd->command ) );
+	fcpcmd->active = 1;
+	fcpdev->active++;
 
 	/* Create new exchange */
 	if ( ( xchg_id = fc_xchg_originate ( &fcpcmd->xchg,
@@ -839,8 +878,15 @@ static void fcpdev_close ( struct fcp_device *fcpdev, int rc ) {
  * @ret len		Length of window
  */
 static size_t fcpdev_window ( struct fcp_device *fcpdev ) {
-	return ( fc_link_ok ( &fcpdev->user.ulp->link ) ?
-		 ~( ( size_t ) 0 ) : 0 );
+
+	/* Allow no commands while link is down */
+	if ( ! fc_link_ok ( &fcpdev->user.ulp->link ) )
+		return 0;
+
+	/* Allow as many outstanding commands as the target can queue */
+	if ( fcpdev->active >= fcpdev->max_active )
+		return 0;
+	return ~( ( size_t ) 0 );
 }
 
 /**
@@ -977,6 +1023,7 @@ static int fcpdev_open ( struct interface *parent, struct fc_name *wwn,
 	ref_init ( &fcpdev->refcnt, NULL );
 	intf_init ( &fcpdev->scsi, &fcpdev_scsi_desc, &fcpdev->refcnt );
 	INIT_LIST_HEAD ( &fcpdev->fcpcmds );
+	fcpdev->max_active = -1U;
 	fc_ulp_user_init ( &fcpdev->user, fcpdev_examine, &fcpdev->refcnt );
 
 	DBGC ( fcpdev, "FCP %p opened for %s\n", fcpdev, fc_ntoa ( wwn ) );
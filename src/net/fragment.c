@@ -26,8 +26,10 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <ipxe/retry.h>
 #include <ipxe/timer.h>
+#include <ipxe/malloc.h>
 #include <ipxe/ipstat.h>
 #include <ipxe/fragment.h>
 
@@ -37,6 +39,79 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
+/** A fragment descriptor
+ *
+ * This is prepended to the fragment data within each queued I/O
+ * buffer, occupying part of the space formerly used by the
+ * non-fragmentable portion.
+ */
+struct fragment_descriptor {
+	/** Offset of fragment data */
+	size_t offset;
+};
+
+/** Fragment reassembly buffers (most recently used first) */
+static LIST_HEAD ( fragment_buffers );
+
+/** Total size of I/O buffers held for fragment reassembly */
+static size_t fragment_buffered;
+
+/**
+ * Get size of I/O buffer held for fragment reassembly
+ *
+ * @v iobuf		I/O buffer
+ * @ret size		Size of I/O buffer
+ */
+static inline size_t fragment_iob_size ( struct io_buffer *iobuf ) {
+
+	return ( iobuf->end - iobuf->head );
+}
+
+/**
+ * Account for I/O buffer held for fragment reassembly
+ *
+ * @v fragment		Fragment reassembly buffer
+ * @v iobuf		I/O buffer
+ */
+static void fragment_hold ( struct fragment *fragment,
+			    struct io_buffer *iobuf ) {
+	size_t size = fragment_iob_size ( iobuf );
+
+	fragment->size += size;
+	fragment_buffered += size;
+}
+
+/**
+ * Free fragment reassembly buffer
+ *
+ * @v fragment		Fragment reassembly buffer
+ */
+static void fragment_free ( struct fragment *fragment ) {
+	struct io_buffer *iobuf;
+	struct io_buffer *tmp;
+
+	stop_timer ( &fragment->timer );
+	list_for_each_entry_safe ( iobuf, tmp, &fragment->queue, list ) {
+		list_del ( &iobuf->list );
+		free_iob ( iobuf );
+	}
+	free_iob ( fragment->iobuf );
+	fragment_buffered -= fragment->size;
+	list_del ( &fragment->list );
+	free ( fragment );
+}
+
+/**
+ * Discard fragment reassembly buffer
+ *
+ * @v fragment		Fragment reassembly buffer
+ */
+static void fragment_discard ( struct fragment *fragment ) {
+
+	fragment->fragments->stats->reasm_fails++;
+	fragment_free ( fragment );
+}
+
 /**
  * Expire fragment reassembly buffer
  *
@@ -48,10 +123,7 @@ static void fragment_expired ( struct retry_timer *timer, int fail __unused ) {
 		container_of ( timer, struct fragment, timer );
 
 	DBGC ( fragment, "FRAG %p expired\n", fragment );
-	free_iob ( fragment->iobuf );
-	list_del ( &fragment->list );
-	fragment->fragments->stats->reasm_fails++;
-	free ( fragment );
+	fragment_discard ( fragment );
 }
 
 /**
@@ -67,13 +139,89 @@ static struct fragment * fragment_find ( struct fragment_reassembler *fragments,
 					 size_t hdrlen ) {
 	struct fragment *fragment;
 
-	list_for_each_entry ( fragment, &fragments->list, list ) {
-		if ( fragments->is_fragment ( fragment, iobuf, hdrlen ) )
+	list_for_each_entry ( fragment, &fragment_buffers, list ) {
+		if ( ( fragment->fragments == fragments ) &&
+		     fragments->is_fragment ( fragment, iobuf, hdrlen ) )
 			return fragment;
 	}
 	return NULL;
 }
 
+/**
+ * Record non-fragmentable portion of packet
+ *
+ * @v fragment		Fragment reassembly buffer
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+ * @ret rc		Return status code
+ *
+ * The I/O buffer headroom is preserved, to allow for code which
+ * modifies and resends the reassembled packet (e.g. ICMP echo
+ * responses).
+ */
+static int fragment_header ( struct fragment *fragment,
+			     struct io_buffer *iobuf, size_t hdrlen ) {
+	size_t headroom = iob_headroom ( iobuf );
+	struct io_buffer *header;
+
+	/* Allocate and populate copy of non-fragmentable portion */
+	header = alloc_iob ( headroom + hdrlen );
+	if ( ! header ) {
+		DBGC ( fragment, "FRAG %p could not allocate header\n",
+		       fragment );
+		return -ENOMEM;
+	}
+	iob_reserve ( header, headroom );
+	memcpy ( iob_put ( header, hdrlen ), iobuf->data, hdrlen );
+
+	/* Replace any existing copy */
+	if ( fragment->iobuf ) {
+		fragment->size -= fragment_iob_size ( fragment->iobuf );
+		fragment_buffered -= fragment_iob_size ( fragment->iobuf );
+		free_iob ( fragment->iobuf );
+	}
+	fragment->iobuf = header;
+	fragment->hdrlen = hdrlen;
+	fragment_hold ( fragment, header );
+
+	return 0;
+}
+
+/**
+ * Construct reassembled packet
+ *
+ * @v fragment		Fragment reassembly buffer
+ * @ret iobuf		Reassembled packet, or NULL on error
+ */
+static struct io_buffer * fragment_assemble ( struct fragment *fragment ) {
+	struct fragment_descriptor *desc;
+	struct io_buffer *iobuf;
+	struct io_buffer *queued;
+	size_t headroom = iob_headroom ( fragment->iobuf );
+	size_t len;
+
+	/* Allocate reassembled packet */
+	iobuf = alloc_iob ( headroom + fragment->hdrlen + fragment->total );
+	if ( ! iobuf ) {
+		DBGC ( fragment, "FRAG %p could not allocate %zd-byte "
+		       "reassembly buffer\n", fragment,
+		       ( fragment->hdrlen + fragment->total ) );
+		return NULL;
+	}
+	iob_reserve ( iobuf, headroom );
+
+	/* Copy non-fragmentable portion and fragment data */
+	memcpy ( iob_put ( iobuf, fragment->hdrlen ), fragment->iobuf->data,
+		 fragment->hdrlen );
+	list_for_each_entry ( queued, &fragment->queue, list ) {
+		len = ( iob_len ( queued ) - sizeof ( *desc ) );
+		memcpy ( iob_put ( iobuf, len ),
+			 ( queued->data + sizeof ( *desc ) ), len );
+	}
+
+	return iobuf;
+}
+
 /**
  * Reassemble packet
  *
@@ -84,92 +232,132 @@ static struct fragment * fragment_find ( struct fragment_reassembler *fragments,
  *
  * This function takes ownership of the I/O buffer.  Note that the
  * length of the non-fragmentable portion may be modified.
+ *
+ * Fragments may arrive in any order.  Each fragment is queued in
+ * order of offset, and the packet is reassembled once the final
+ * fragment has been received and no holes remain.  Fragments which
+ * overlap previously received data are dropped.
  */
 struct io_buffer * fragment_reassemble ( struct fragment_reassembler *fragments,
 					 struct io_buffer *iobuf,
 					 size_t *hdrlen ) {
+	struct fragment_descriptor *desc;
 	struct fragment *fragment;
-	struct io_buffer *new_iobuf;
-	size_t new_len;
+	struct fragment *oldest;
+	struct io_buffer *queued;
+	struct list_head *prev;
 	size_t offset;
-	size_t expected_offset;
+	size_t len;
+	size_t end;
+	size_t queued_end;
 	int more_frags;
 
 	/* Update statistics */
 	fragments->stats->reasm_reqds++;
 
-	/* Find matching fragment reassembly buffer, if any */
-	fragment = fragment_find ( fragments, iobuf, *hdrlen );
-
-	/* Drop out-of-order fragments */
+	/* Parse fragment */
 	offset = fragments->fragment_offset ( iobuf, *hdrlen );
-	expected_offset = ( fragment ? ( iob_len ( fragment->iobuf ) -
-					 fragment->hdrlen ) : 0 );
-	if ( offset != expected_offset ) {
-		DBGC ( fragment, "FRAG %p dropping out-of-sequence fragment "
-		       "[%zd,%zd), expected [%zd,...)\n", fragment, offset,
-		       ( offset + iob_len ( iobuf ) - *hdrlen ),
-		       expected_offset );
+	more_frags = fragments->more_fragments ( iobuf, *hdrlen );
+	len = ( iob_len ( iobuf ) - *hdrlen );
+	end = ( offset + len );
+
+	/* Sanity check: there must be room for a fragment descriptor */
+	if ( *hdrlen < sizeof ( *desc ) )
 		goto drop;
-	}
 
-	/* Create or extend fragment reassembly buffer as applicable */
+	/* Find or create fragment reassembly buffer */
+	fragment = fragment_find ( fragments, iobuf, *hdrlen );
 	if ( ! fragment ) {
-
-		/* Create new fragment reassembly buffer */
 		fragment = zalloc ( sizeof ( *fragment ) );
 		if ( ! fragment )
 			goto drop;
-		list_add ( &fragment->list, &fragments->list );
-		fragment->iobuf = iobuf;
-		fragment->hdrlen = *hdrlen;
+		list_add ( &fragment->list, &fragment_buffers );
+		INIT_LIST_HEAD ( &fragment->queue );
 		timer_init ( &fragment->timer, fragment_expired, NULL );
 		fragment->fragments = fragments;
-		DBGC ( fragment, "FRAG %p [0,%zd)\n", fragment,
-		       ( iob_len ( iobuf ) - *hdrlen ) );
-
-	} else {
+		if ( fragment_header ( fragment, iobuf, *hdrlen ) != 0 ) {
+			fragment_free ( fragment );
+			goto drop;
+		}
+		DBGC ( fragment, "FRAG %p created\n", fragment );
+	}
 
-		/* Check if this is the final fragment */
-		more_frags = fragments->more_fragments ( iobuf, *hdrlen );
-		DBGC ( fragment, "FRAG %p [%zd,%zd)%s\n", fragment,
-		       offset, ( offset + iob_len ( iobuf ) - *hdrlen ),
-		       ( more_frags ? "" : " complete" ) );
-
-		/* Extend fragment reassembly buffer.  Preserve I/O
-		 * buffer headroom to allow for code which modifies
-		 * and resends the buffer (e.g. ICMP echo responses).
-		 */
-		iob_pull ( iobuf, *hdrlen );
-		new_len = ( iob_headroom ( fragment->iobuf ) +
-			    iob_len ( fragment->iobuf ) + iob_len ( iobuf ) );
-		new_iobuf = alloc_iob ( new_len );
-		if ( ! new_iobuf ) {
-			DBGC ( fragment, "FRAG %p could not extend reassembly "
-			       "buffer to %zd bytes\n", fragment, new_len );
+	/* Find insertion point, checking for overlaps */
+	prev = &fragment->queue;
+	list_for_each_entry ( queued, &fragment->queue, list ) {
+		desc = queued->data;
+		if ( desc->offset >= end )
+			break;
+		queued_end = ( desc->offset + iob_len ( queued ) -
+			       sizeof ( *desc ) );
+		if ( queued_end > offset ) {
+			DBGC ( fragment, "FRAG %p dropping overlapping "
+			       "fragment [%zd,%zd)\n", fragment, offset, end );
 			goto drop;
 		}
-		iob_reserve ( new_iobuf, iob_headroom ( fragment->iobuf ) );
-		memcpy ( iob_put ( new_iobuf, iob_len ( fragment->iobuf ) ),
-			 fragment->iobuf->data, iob_len ( fragment->iobuf ) );
-		memcpy ( iob_put ( new_iobuf, iob_len ( iobuf ) ),
-			 iobuf->data, iob_len ( iobuf ) );
-		free_iob ( fragment->iobuf );
-		fragment->iobuf = new_iobuf;
-		free_iob ( iobuf );
+		prev = &queued->list;
+	}
 
-		/* Stop fragment reassembly timer */
-		stop_timer ( &fragment->timer );
-
-		/* If this is the final fragment, return it */
-		if ( ! more_frags ) {
-			iobuf = fragment->iobuf;
-			*hdrlen = fragment->hdrlen;
-			list_del ( &fragment->list );
-			free ( fragment );
-			fragments->stats->reasm_oks++;
-			return iobuf;
+	/* Check consistency with final fragment */
+	if ( fragment->total ?
+	     ( ( end > fragment->total ) ||
+	       ( ( ! more_frags ) && ( end != fragment->total ) ) ) :
+	     ( ( ! more_frags ) && ( prev != fragment->queue.prev ) ) ) {
+		DBGC ( fragment, "FRAG %p dropping inconsistent fragment "
+		       "[%zd,%zd)%s\n", fragment, offset, end,
+		       ( more_frags ? "" : " final" ) );
+		goto drop;
+	}
+
+	/* Use non-fragmentable portion from first fragment, if
+	 * not already taken from this fragment.
+	 */
+	if ( ( offset == 0 ) && ( ! list_empty ( &fragment->queue ) ) &&
+	     ( fragment_header ( fragment, iobuf, *hdrlen ) != 0 ) )
+		goto drop;
+
+	/* Queue fragment data */
+	DBGC ( fragment, "FRAG %p [%zd,%zd)%s\n", fragment, offset, end,
+	       ( more_frags ? "" : " final" ) );
+	iob_pull ( iobuf, *hdrlen );
+	desc = iob_push ( iobuf, sizeof ( *desc ) );
+	desc->offset = offset;
+	list_add ( &iobuf->list, prev );
+	fragment_hold ( fragment, iobuf );
+	fragment->len += len;
+	if ( ! more_frags )
+		fragment->total = end;
+
+	/* Mark as most recently used */
+	list_del ( &fragment->list );
+	list_add ( &fragment->list, &fragment_buffers );
+
+	/* If no holes remain, return reassembled packet */
+	if ( fragment->total && ( fragment->len == fragment->total ) ) {
+		DBGC ( fragment, "FRAG %p complete\n", fragment );
+		iobuf = fragment_assemble ( fragment );
+		*hdrlen = fragment->hdrlen;
+		fragment_free ( fragment );
+		if ( ! iobuf ) {
+			fragments->stats->reasm_fails++;
+			return NULL;
 		}
+		fragments->stats->reasm_oks++;
+		return iobuf;
+	}
+
+	/* Discard least recently used reassembly buffers while over
+	 * the memory limit.  This may include the current buffer,
+	 * which will happen only if it alone exceeds the limit.
+	 */
+	while ( fragment_buffered > FRAGMENT_MAX_BUFFERED ) {
+		oldest = list_last_entry ( &fragment_buffers, struct fragment,
+					   list );
+		DBGC ( oldest, "FRAG %p discarded (%zd bytes buffered)\n",
+		       oldest, fragment_buffered );
+		fragment_discard ( oldest );
+		if ( oldest == fragment )
+			return NULL;
 	}
 
 	/* (Re)start fragment reassembly timer */
@@ -182,3 +370,33 @@ struct io_buffer * fragment_reassemble ( struct fragment_reassembler *fragments,
 	free_iob ( iobuf );
 	return NULL;
 }
+
+/**
+ * Discard some cached fragment reassembly buffers
+ *
+ * @ret discarded	Number of cached items discarded
+ */
+static unsigned int fragment_discarder_discard ( void ) {
+	struct fragment *fragment;
+
+	/* Discard least recently used reassembly buffer, if any */
+	fragment = list_last_entry ( &fragment_buffers, struct fragment, list );
+	if ( fragment ) {
+		DBGC ( fragment, "FRAG %p discarded to free memory\n",
+		       fragment );
+		fragment_discard ( fragment );
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+/**
+ * Fragment reassembly buffer discarder
+ *
+ * Partially reassembled packets are cheap to discard, since the
+ * sender will eventually retransmit the whole packet in any case.
+ */
+struct cache_discarder fragment_discarder __cache_discarder ( CACHE_CHEAP ) = {
+	.discard = fragment_discarder_discard,
+};
@@ -27,6 +27,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <errno.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/in.h>
+#include <ipxe/ip.h>
 #include <ipxe/tcpip.h>
 #include <ipxe/icmp.h>
 
@@ -38,6 +39,52 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 struct icmp_echo_protocol icmpv4_echo_protocol __icmp_echo_protocol;
 
+/**
+ * Process received fragmentation needed message
+ *
+ * @v iobuf		I/O buffer
+ */
+static void icmpv4_rx_frag_needed ( struct io_buffer *iobuf ) {
+	struct icmp_frag_needed *frag = iobuf->data;
+	struct iphdr *iphdr = ( iobuf->data + sizeof ( *frag ) );
+	size_t len = iob_len ( iobuf );
+	union {
+		struct sockaddr_in sin;
+		struct sockaddr_tcpip st;
+	} dest;
+	size_t hdrlen;
+	size_t mtu;
+
+	/* Sanity check */
+	if ( len < ( sizeof ( *frag ) + sizeof ( *iphdr ) ) ) {
+		DBG ( "ICMP fragmentation needed too short at %zd bytes\n",
+		      len );
+		return;
+	}
+	hdrlen = ( ( iphdr->verhdrlen & IP_MASK_HLEN ) * 4 );
+	if ( ( hdrlen < sizeof ( *iphdr ) ) ||
+	     ( len < ( sizeof ( *frag ) + hdrlen ) ) ) {
+		DBG ( "ICMP fragmentation needed has invalid header\n" );
+		return;
+	}
+	len -= ( sizeof ( *frag ) + hdrlen );
+
+	/* Ignore messages from routers that do not report the MTU */
+	mtu = ntohs ( frag->mtu );
+	if ( mtu <= sizeof ( *iphdr ) ) {
+		DBG ( "ICMP fragmentation needed without MTU\n" );
+		return;
+	}
+
+	/* Notify transport-layer protocol */
+	memset ( &dest, 0, sizeof ( dest ) );
+	dest.sin.sin_family = AF_INET;
+	dest.sin.sin_addr = iphdr->dest;
+	DBG ( "ICMP path MTU to %s is %zd\n", inet_ntoa ( iphdr->dest ), mtu );
+	tcpip_pmtu ( iphdr->protocol, &dest.st, ( ( ( void * ) iphdr ) + hdrlen ),
+		     len, ( mtu - sizeof ( *iphdr ) ) );
+}
+
 /**
  * Process a received packet
  *
@@ -85,6 +132,11 @@ static int icmpv4_rx ( struct io_buffer *iobuf,
 					      &icmpv4_echo_protocol );
 	case ICMP_ECHO_REPLY:
 		return icmp_rx_echo_reply ( iobuf, st_src );
+	case ICMP_DESTINATION_UNREACHABLE:
+		if ( icmp->code == ICMP_FRAGMENTATION_NEEDED )
+			icmpv4_rx_frag_needed ( iobuf );
+		rc = 0;
+		break;
 	default:
 		DBG ( "ICMP ignoring type %d\n", type );
 		rc = 0;
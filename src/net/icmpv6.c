@@ -29,6 +29,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/in.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/tcpip.h>
+#include <ipxe/ipv6.h>
 #include <ipxe/ping.h>
 #include <ipxe/icmpv6.h>
 
@@ -149,6 +150,71 @@ struct icmpv6_handler icmpv6_echo_reply_handler __icmpv6_handler = {
 	.rx = icmpv6_rx_echo_reply,
 };
 
+/**
+ * Process received ICMPv6 packet too big message
+ *
+ * @v iobuf		I/O buffer
+ * @v netdev		Network device
+ * @v sin6_src		Source socket address
+ * @v sin6_dest		Destination socket address
+ * @ret rc		Return status code
+ */
+static int icmpv6_rx_packet_too_big ( struct io_buffer *iobuf,
+				      struct net_device *netdev,
+				      struct sockaddr_in6 *sin6_src __unused,
+				      struct sockaddr_in6 *sin6_dest __unused ) {
+	struct icmpv6_packet_too_big *too_big = iobuf->data;
+	struct ipv6_header *iphdr = ( iobuf->data + sizeof ( *too_big ) );
+	size_t len = iob_len ( iobuf );
+	union {
+		struct sockaddr_in6 sin6;
+		struct sockaddr_tcpip st;
+	} dest;
+	size_t mtu;
+	int rc;
+
+	/* Sanity check */
+	if ( len < ( sizeof ( *too_big ) + sizeof ( *iphdr ) ) ) {
+		DBGC ( netdev, "ICMPv6 packet too big too short at %zd "
+		       "bytes\n", len );
+		rc = -EINVAL;
+		goto done;
+	}
+	len -= ( sizeof ( *too_big ) + sizeof ( *iphdr ) );
+	mtu = ntohl ( too_big->mtu );
+	if ( mtu <= sizeof ( *iphdr ) ) {
+		DBGC ( netdev, "ICMPv6 packet too big has invalid MTU %zd\n",
+		       mtu );
+		rc = -EINVAL;
+		goto done;
+	}
+
+	/* Notify transport-layer protocol.  We never transmit
+	 * extension headers, so the transport-layer header (if any)
+	 * immediately follows the IPv6 header.
+	 */
+	memset ( &dest, 0, sizeof ( dest ) );
+	dest.sin6.sin6_family = AF_INET6;
+	memcpy ( &dest.sin6.sin6_addr, &iphdr->dest,
+		 sizeof ( dest.sin6.sin6_addr ) );
+	dest.sin6.sin6_scope_id = netdev->index;
+	DBGC ( netdev, "ICMPv6 path MTU to %s is %zd\n",
+	       sock_ntoa ( ( struct sockaddr * ) &dest.sin6 ), mtu );
+	tcpip_pmtu ( iphdr->next_header, &dest.st, ( iphdr + 1 ), len,
+		     ( mtu - sizeof ( *iphdr ) ) );
+	rc = 0;
+
+ done:
+	free_iob ( iobuf );
+	return rc;
+}
+
+/** ICMPv6 packet too big handler */
+struct icmpv6_handler icmpv6_packet_too_big_handler __icmpv6_handler = {
+	.type = ICMPV6_PACKET_TOO_BIG,
+	.rx = icmpv6_rx_packet_too_big,
+};
+
 /**
  * Identify ICMPv6 handler
  *
@@ -211,9 +277,6 @@ static int icmpv6_rx ( struct io_buffer *iobuf, struct net_device *netdev,
 		case ICMPV6_DESTINATION_UNREACHABLE:
 			rc = -EHOSTUNREACH_CODE ( icmp->code );
 			break;
-		case ICMPV6_PACKET_TOO_BIG:
-			rc = -ERANGE;
-			break;
 		case ICMPV6_TIME_EXCEEDED:
 			rc = -ETIMEDOUT_CODE ( icmp->code );
 			break;
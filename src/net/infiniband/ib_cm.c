@@ -44,6 +44,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** List of connections */
 static LIST_HEAD ( ib_cm_conns );
 
+/** List of connection listeners */
+static LIST_HEAD ( ib_cm_listeners );
+
 /**
  * Find connection by local communication ID
  *
@@ -60,6 +63,46 @@ static struct ib_connection * ib_cm_find ( uint32_t local_id ) {
 	return NULL;
 }
 
+/**
+ * Find connection by remote communication ID
+ *
+ * @v remote_id		Remote communication ID
+ * @v service_id	Service ID
+ * @ret conn		Connection, or NULL
+ */
+static struct ib_connection * ib_cm_find_remote ( uint32_t remote_id,
+						  union ib_guid *service_id ) {
+	struct ib_connection *conn;
+
+	list_for_each_entry ( conn, &ib_cm_conns, list ) {
+		if ( ( conn->remote_id == remote_id ) &&
+		     ( memcmp ( &conn->service_id, service_id,
+				sizeof ( conn->service_id ) ) == 0 ) )
+			return conn;
+	}
+	return NULL;
+}
+
+/**
+ * Find connection listener
+ *
+ * @v ibdev		Infiniband device
+ * @v service_id	Service ID
+ * @ret listener	Connection listener, or NULL
+ */
+static struct ib_cm_listener * ib_cm_find_listener ( struct ib_device *ibdev,
+						     union ib_guid *service_id){
+	struct ib_cm_listener *listener;
+
+	list_for_each_entry ( listener, &ib_cm_listeners, list ) {
+		if ( ( listener->ibdev == ibdev ) &&
+		     ( memcmp ( &listener->service_id, service_id,
+				sizeof ( listener->service_id ) ) == 0 ) )
+			return listener;
+	}
+	return NULL;
+}
+
 /**
  * Send "ready to use" response
  *
@@ -134,6 +177,263 @@ static void ib_cm_recv_rep ( struct ib_device *ibdev,
 	}
 }
 
+/**
+ * Send connection reply
+ *
+ * @v ibdev		Infiniband device
+ * @v mi		Management interface
+ * @v tid		Transaction identifier
+ * @v av		Address vector
+ * @v conn		Connection
+ * @ret rc		Return status code
+ */
+static int ib_cm_send_rep ( struct ib_device *ibdev,
+			    struct ib_mad_interface *mi,
+			    struct ib_mad_tid *tid,
+			    struct ib_address_vector *av,
+			    struct ib_connection *conn ) {
+	struct ib_queue_pair *qp = conn->qp;
+	union ib_mad mad;
+	struct ib_cm_connect_reply *rep = &mad.cm.cm_data.connect_reply;
+	size_t private_data_len;
+	int rc;
+
+	/* Construct connection reply */
+	memset ( &mad, 0, sizeof ( mad ) );
+	mad.hdr.mgmt_class = IB_MGMT_CLASS_CM;
+	mad.hdr.class_version = IB_CM_CLASS_VERSION;
+	mad.hdr.method = IB_MGMT_METHOD_SEND;
+	memcpy ( &mad.hdr.tid, tid, sizeof ( mad.hdr.tid ) );
+	mad.hdr.attr_id = htons ( IB_CM_ATTR_CONNECT_REPLY );
+	rep->local_id = htonl ( conn->local_id );
+	rep->remote_id = htonl ( conn->remote_id );
+	rep->local_qpn = htonl ( qp->qpn << 8 );
+	rep->starting_psn = htonl ( qp->recv.psn << 8 );
+	rep->target_ack_delay__failover_accepted__ee_flow_ctrl =
+		( ( 0x14 << 3 ) | ( 0 << 1 ) | ( 1 << 0 ) );
+	rep->rnr_retry__srq = ( ( 0x07 << 5 ) | ( 0 << 4 ) );
+	memcpy ( &rep->local_ca, &ibdev->node_guid, sizeof ( rep->local_ca ) );
+	private_data_len = conn->private_data_len;
+	if ( private_data_len > sizeof ( rep->private_data ) )
+		private_data_len = sizeof ( rep->private_data );
+	memcpy ( &rep->private_data, &conn->private_data, private_data_len );
+	if ( ( rc = ib_mi_send ( ibdev, mi, &mad, av ) ) != 0 ) {
+		DBGC ( conn->local_id, "CM %08x could not send REP: %s\n",
+		       conn->local_id, strerror ( rc ) );
+		return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * Send connection rejection
+ *
+ * @v ibdev		Infiniband device
+ * @v mi		Management interface
+ * @v tid		Transaction identifier
+ * @v av		Address vector
+ * @v local_id		Local communication ID
+ * @v remote_id		Remote communication ID
+ * @v reason		Rejection reason
+ * @ret rc		Return status code
+ */
+static int ib_cm_send_rej ( struct ib_device *ibdev,
+			    struct ib_mad_interface *mi,
+			    struct ib_mad_tid *tid,
+			    struct ib_address_vector *av,
+			    uint32_t local_id, uint32_t remote_id,
+			    unsigned int reason ) {
+	union ib_mad mad;
+	struct ib_cm_connect_reject *rej = &mad.cm.cm_data.connect_reject;
+	int rc;
+
+	/* Construct connection rejection */
+	memset ( &mad, 0, sizeof ( mad ) );
+	mad.hdr.mgmt_class = IB_MGMT_CLASS_CM;
+	mad.hdr.class_version = IB_CM_CLASS_VERSION;
+	mad.hdr.method = IB_MGMT_METHOD_SEND;
+	memcpy ( &mad.hdr.tid, tid, sizeof ( mad.hdr.tid ) );
+	mad.hdr.attr_id = htons ( IB_CM_ATTR_CONNECT_REJECT );
+	rej->local_id = htonl ( local_id );
+	rej->remote_id = htonl ( remote_id );
+	rej->message = ( IB_CM_REJECT_MESSAGE_REQ << 6 );
+	rej->reason = htons ( reason );
+	if ( ( rc = ib_mi_send ( ibdev, mi, &mad, av ) ) != 0 ) {
+		DBGC ( local_id, "CM %08x could not send REJ: %s\n",
+		       local_id, strerror ( rc ) );
+		return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * Handle connection requests
+ *
+ * @v ibdev		Infiniband device
+ * @v mi		Management interface
+ * @v mad		Received MAD
+ * @v av		Source address vector
+ */
+static void ib_cm_recv_req ( struct ib_device *ibdev,
+			     struct ib_mad_interface *mi,
+			     union ib_mad *mad,
+			     struct ib_address_vector *av ) {
+	struct ib_cm_connect_request *req = &mad->cm.cm_data.connect_request;
+	struct ib_cm_listener *listener;
+	struct ib_connection *conn;
+	struct ib_queue_pair *qp;
+	struct ib_address_vector remote;
+	union ib_guid service_id;
+	uint32_t remote_id = ntohl ( req->local_id );
+	uint32_t local_id;
+	unsigned int service_type;
+	unsigned int reason;
+	int rc;
+
+	/* Resend reply to any duplicate request (the original reply
+	 * may have been lost).
+	 */
+	memcpy ( &service_id, &req->service_id, sizeof ( service_id ) );
+	conn = ib_cm_find_remote ( remote_id, &service_id );
+	if ( conn ) {
+		DBGC ( conn->local_id, "CM %08x duplicate REQ\n",
+		       conn->local_id );
+		if ( ( rc = ib_cm_send_rep ( ibdev, mi, &mad->hdr.tid, av,
+					     conn ) ) != 0 ) {
+			/* Ignore errors; the remote end will retry */
+		}
+		return;
+	}
+	local_id = random();
+
+	/* Identify listener */
+	listener = ib_cm_find_listener ( ibdev, &service_id );
+	if ( ! listener ) {
+		DBGC ( local_id, "CM %08x no listener for " IB_GUID_FMT "\n",
+		       local_id, IB_GUID_ARGS ( &service_id ) );
+		reason = IB_CM_REJECT_BAD_SERVICE_ID;
+		goto err_listener;
+	}
+
+	/* Only reliable connections are supported */
+	service_type =
+	      ntohl ( req->remote_eecn__remote_timeout__service_type__ee_flow_ctrl );
+	service_type = ( ( service_type >> 1 ) & 0x03 );
+	if ( service_type != IB_CM_TRANSPORT_RC ) {
+		DBGC ( local_id, "CM %08x unsupported transport type %d\n",
+		       local_id, service_type );
+		reason = IB_CM_REJECT_CONSUMER;
+		goto err_service_type;
+	}
+
+	/* Allocate and initialise connection */
+	conn = zalloc ( sizeof ( *conn ) + listener->private_data_len );
+	if ( ! conn ) {
+		reason = IB_CM_REJECT_CONSUMER;
+		goto err_alloc_conn;
+	}
+	conn->ibdev = ibdev;
+	conn->local_id = local_id;
+	conn->remote_id = remote_id;
+	memcpy ( &conn->service_id, &service_id, sizeof ( conn->service_id ) );
+	conn->op = listener->op;
+	conn->private_data_len = listener->private_data_len;
+	memcpy ( &conn->private_data, listener->private_data,
+		 listener->private_data_len );
+
+	/* Construct remote queue pair address vector from primary path */
+	memset ( &remote, 0, sizeof ( remote ) );
+	remote.qpn = ( ntohl ( req->local_qpn__responder_resources ) >> 8 );
+	remote.lid = ntohs ( req->primary.local_lid );
+	remote.rate = ( ntohl ( req->primary.flow_label__rate ) & 0x3f );
+	remote.sl = ( req->primary.sl__subnet_local >> 4 );
+	remote.gid_present = 1;
+	memcpy ( &remote.gid, &req->primary.local_gid, sizeof ( remote.gid ) );
+	DBGC ( local_id, "CM %08x request from " IB_GID_FMT " QPN %#lx for "
+	       IB_GUID_FMT "\n", local_id, IB_GID_ARGS ( &remote.gid ),
+	       remote.qpn, IB_GUID_ARGS ( &conn->service_id ) );
+
+	/* Ask upper layer to accept connection */
+	qp = conn->op->accept ( ibdev, conn, &remote, &req->private_data,
+				sizeof ( req->private_data ) );
+	if ( ! qp ) {
+		DBGC ( local_id, "CM %08x connection not accepted\n",
+		       local_id );
+		reason = IB_CM_REJECT_CONSUMER;
+		goto err_accept;
+	}
+	conn->qp = qp;
+
+	/* Add to list of connections.  From this point on, the upper
+	 * layer owns the connection and is responsible for destroying
+	 * it.
+	 */
+	list_add ( &conn->list, &ib_cm_conns );
+
+	/* Modify queue pair */
+	memcpy ( &qp->av, &remote, sizeof ( qp->av ) );
+	qp->send.psn = ( ntohl ( req->starting_psn__local_timeout__retry_count )
+			 >> 8 );
+	if ( ( rc = ib_modify_qp ( ibdev, qp ) ) != 0 ) {
+		DBGC ( local_id, "CM %08x could not modify queue pair: %s\n",
+		       local_id, strerror ( rc ) );
+		ib_cm_send_rej ( ibdev, mi, &mad->hdr.tid, av, local_id,
+				 remote_id, IB_CM_REJECT_CONSUMER );
+		conn->op->changed ( ibdev, qp, conn, rc, NULL, 0 );
+		return;
+	}
+
+	/* Send reply.  The connection is usable as soon as the first
+	 * packet arrives, regardless of whether or not the reply is
+	 * acknowledged by a "ready to use" response.
+	 */
+	DBGC ( local_id, "CM %08x accepted on QPN %#lx PSN %#x\n",
+	       local_id, qp->qpn, qp->recv.psn );
+	if ( ( rc = ib_cm_send_rep ( ibdev, mi, &mad->hdr.tid, av,
+				     conn ) ) != 0 ) {
+		/* Ignore errors; the remote end will retry */
+	}
+	return;
+
+ err_accept:
+	free ( conn );
+ err_alloc_conn:
+ err_service_type:
+ err_listener:
+	ib_cm_send_rej ( ibdev, mi, &mad->hdr.tid, av, local_id, remote_id,
+			 reason );
+}
+
+/**
+ * Handle "ready to use" responses
+ *
+ * @v ibdev		Infiniband device
+ * @v mi		Management interface
+ * @v mad		Received MAD
+ * @v av		Source address vector
+ */
+static void ib_cm_recv_rtu ( struct ib_device *ibdev,
+			     struct ib_mad_interface *mi __unused,
+			     union ib_mad *mad,
+			     struct ib_address_vector *av __unused ) {
+	struct ib_cm_ready_to_use *rtu = &mad->cm.cm_data.ready_to_use;
+	struct ib_connection *conn;
+	uint32_t local_id = ntohl ( rtu->remote_id );
+
+	/* Identify connection */
+	conn = ib_cm_find ( local_id );
+	if ( conn ) {
+		/* Notify upper layer */
+		conn->op->changed ( ibdev, conn->qp, conn, 0,
+				    &rtu->private_data,
+				    sizeof ( rtu->private_data ) );
+	} else {
+		DBGC ( local_id, "CM %08x unexpected RTU\n", local_id );
+	}
+}
+
 /**
  * Send reply to disconnection request
  *
@@ -224,6 +524,18 @@ struct ib_mad_agent ib_cm_agent[] __ib_mad_agent = {
 		.attr_id = htons ( IB_CM_ATTR_DISCONNECT_REQUEST ),
 		.handle = ib_cm_recv_dreq,
 	},
+	{
+		.mgmt_class = IB_MGMT_CLASS_CM,
+		.class_version = IB_CM_CLASS_VERSION,
+		.attr_id = htons ( IB_CM_ATTR_CONNECT_REQUEST ),
+		.handle = ib_cm_recv_req,
+	},
+	{
+		.mgmt_class = IB_MGMT_CLASS_CM,
+		.class_version = IB_CM_CLASS_VERSION,
+		.attr_id = htons ( IB_CM_ATTR_READY_TO_USE ),
+		.handle = ib_cm_recv_rtu,
+	},
 };
 
 /**
@@ -512,3 +824,43 @@ void ib_destroy_conn ( struct ib_device *ibdev,
 		ib_destroy_path ( ibdev, conn->path );
 	free ( conn );
 }
+
+/**
+ * Listen for incoming connections
+ *
+ * @v ibdev		Infiniband device
+ * @v listener		Connection listener
+ * @v service_id	Service ID
+ * @v private_data	Connection reply private data
+ * @v private_data_len	Length of connection reply private data
+ * @v op		Connection operations
+ *
+ * The private data must remain valid until the listener is removed.
+ */
+void ib_cm_listen ( struct ib_device *ibdev, struct ib_cm_listener *listener,
+		    union ib_guid *service_id, const void *private_data,
+		    size_t private_data_len,
+		    struct ib_connection_operations *op ) {
+
+	listener->ibdev = ibdev;
+	memcpy ( &listener->service_id, service_id,
+		 sizeof ( listener->service_id ) );
+	listener->private_data = private_data;
+	listener->private_data_len = private_data_len;
+	listener->op = op;
+	list_add ( &listener->list, &ib_cm_listeners );
+	DBGC ( listener, "CM %p listening on IBDEV %s for " IB_GUID_FMT "\n",
+	       listener, ibdev->name, IB_GUID_ARGS ( service_id ) );
+}
+
+/**
+ * Stop listening for incoming connections
+ *
+ * @v listener		Connection listener
+ *
+ * Existing connections accepted via the listener are not affected.
+ */
+void ib_cm_unlisten ( struct ib_cm_listener *listener ) {
+
+	list_del ( &listener->list );
+}
@@ -40,6 +40,7 @@
 #include <ipxe/settings.h>
 #include <ipxe/fragment.h>
 #include <ipxe/ipstat.h>
+#include <ipxe/dropstat.h>
 #include <ipxe/profile.h>
 
 /** @file
@@ -56,6 +57,30 @@ static uint8_t next_ident_high = 0;
 /** List of IPv4 miniroutes */
 struct list_head ipv4_miniroutes = LIST_HEAD_INIT ( ipv4_miniroutes );
 
+/** An IPv4 route cache entry */
+struct ipv4_route_cache {
+	/** Routing table generation for which this entry is valid */
+	unsigned int generation;
+	/** Destination address scope ID */
+	unsigned int scope_id;
+	/** Final destination address */
+	struct in_addr dest;
+	/** Next hop destination address */
+	struct in_addr next_hop;
+	/** Routing table entry */
+	struct ipv4_miniroute *miniroute;
+};
+
+/** IPv4 route cache */
+static struct ipv4_route_cache ipv4_route_cache[IPV4_ROUTE_CACHE_SIZE];
+
+/** IPv4 routing table generation
+ *
+ * This is incremented whenever the routing table (or the state of
+ * any network device) changes, invalidating all route cache entries.
+ */
+static unsigned int ipv4_route_generation = 1;
+
 /** IPv4 statistics */
 static struct ip_statistics ipv4_stats;
 
@@ -72,6 +97,36 @@ static struct profiler ipv4_tx_profiler __profiler = { .name = "ipv4.tx" };
 /** Receive profiler */
 static struct profiler ipv4_rx_profiler __profiler = { .name = "ipv4.rx" };
 
+/** Packets dropped due to a malformed header */
+static struct drop_counter ipv4_header_drops __drop_counter = {
+	.name = "ipv4.header",
+};
+
+/** Packets dropped due to an incorrect header checksum */
+static struct drop_counter ipv4_csum_drops __drop_counter = {
+	.name = "ipv4.csum",
+};
+
+/** Packets dropped due to truncation */
+static struct drop_counter ipv4_truncated_drops __drop_counter = {
+	.name = "ipv4.truncated",
+};
+
+/** Packets dropped due to not being addressed to us */
+static struct drop_counter ipv4_addr_drops __drop_counter = {
+	.name = "ipv4.addr",
+};
+
+/**
+ * Invalidate IPv4 route cache
+ *
+ * This must be called whenever the routing table is modified.
+ */
+void ipv4_route_flush ( void ) {
+
+	ipv4_route_generation++;
+}
+
 /**
  * Add IPv4 minirouting table entry
  *
@@ -113,6 +168,7 @@ static int add_ipv4_miniroute ( struct net_device *netdev,
 	} else {
 		list_add ( &miniroute->list, &ipv4_miniroutes );
 	}
+	ipv4_route_flush();
 
 	return 0;
 }
@@ -134,10 +190,11 @@ static void del_ipv4_miniroute ( struct ipv4_miniroute *miniroute ) {
 	netdev_put ( miniroute->netdev );
 	list_del ( &miniroute->list );
 	free ( miniroute );
+	ipv4_route_flush();
 }
 
 /**
- * Perform IPv4 routing
+ * Perform IPv4 routing without using the route cache
  *
  * @v scope_id		Destination address scope ID
  * @v dest		Final destination address
@@ -147,8 +204,8 @@ static void del_ipv4_miniroute ( struct ipv4_miniroute *miniroute ) {
  * If the route requires use of a gateway, the next hop destination
  * address will be overwritten with the gateway address.
  */
-static struct ipv4_miniroute * ipv4_route ( unsigned int scope_id,
-					    struct in_addr *dest ) {
+static struct ipv4_miniroute *
+ipv4_route_uncached ( unsigned int scope_id, struct in_addr *dest ) {
 	struct ipv4_miniroute *miniroute;
 
 	/* Find first usable route in routing table */
@@ -189,6 +246,46 @@ static struct ipv4_miniroute * ipv4_route ( unsigned int scope_id,
 	return NULL;
 }
 
+/**
+ * Perform IPv4 routing
+ *
+ * @v scope_id		Destination address scope ID
+ * @v dest		Final destination address
+ * @ret dest		Next hop destination address
+ * @ret miniroute	Routing table entry to use, or NULL if no route
+ *
+ * If the route requires use of a gateway, the next hop destination
+ * address will be overwritten with the gateway address.
+ */
+static struct ipv4_miniroute * ipv4_route ( unsigned int scope_id,
+					    struct in_addr *dest ) {
+	struct ipv4_route_cache *cache;
+	struct ipv4_miniroute *miniroute;
+	struct in_addr final = *dest;
+
+	/* Use cached route, if available */
+	cache = &ipv4_route_cache[ ( ntohl ( final.s_addr ) ^ scope_id ) %
+				   IPV4_ROUTE_CACHE_SIZE ];
+	if ( ( cache->generation == ipv4_route_generation ) &&
+	     ( cache->dest.s_addr == final.s_addr ) &&
+	     ( cache->scope_id == scope_id ) ) {
+		*dest = cache->next_hop;
+		return cache->miniroute;
+	}
+
+	/* Find route and record in cache */
+	miniroute = ipv4_route_uncached ( scope_id, dest );
+	if ( miniroute ) {
+		cache->generation = ipv4_route_generation;
+		cache->scope_id = scope_id;
+		cache->dest = final;
+		cache->next_hop = *dest;
+		cache->miniroute = miniroute;
+	}
+
+	return miniroute;
+}
+
 /**
  * Determine transmitting network device
  *
@@ -256,7 +353,6 @@ static int ipv4_more_fragments ( struct io_buffer *iobuf,
 
 /** IPv4 fragment reassembler */
 static struct fragment_reassembler ipv4_reassembler = {
-	.list = LIST_HEAD_INIT ( ipv4_reassembler.list ),
 	.is_fragment = ipv4_is_fragment,
 	.fragment_offset = ipv4_fragment_offset,
 	.more_fragments = ipv4_more_fragments,
@@ -313,6 +409,7 @@ static int ipv4_tx ( struct io_buffer *iobuf,
 	struct in_addr netmask = { .s_addr = 0 };
 	uint8_t ll_dest_buf[MAX_LL_ADDR_LEN];
 	const void *ll_dest;
+	int offload;
 	int rc;
 
 	/* Start profiling */
@@ -329,6 +426,8 @@ static int ipv4_tx ( struct io_buffer *iobuf,
 	iphdr->ttl = IP_TTL;
 	iphdr->protocol = tcpip_protocol->tcpip_proto;
 	iphdr->dest = sin_dest->sin_addr;
+	if ( iobuf->flags & IOB_FL_DONTFRAG )
+		iphdr->frags = htons ( IP_MASK_DONOTFRAG );
 
 	/* Use routing table to identify next hop and transmitting netdev */
 	next_hop = iphdr->dest;
@@ -359,9 +458,18 @@ static int ipv4_tx ( struct io_buffer *iobuf,
 
 	/* Fix up checksums */
 	if ( trans_csum ) {
+		if ( ( offload = tcpip_tx_chksum ( iobuf, netdev,
+						   ( iphdr + 1 ),
+						   trans_csum ) ) < 0 ) {
+			rc = offload;
+			goto err;
+		}
 		*trans_csum = ipv4_pshdr_chksum ( iobuf, *trans_csum );
-		if ( ! *trans_csum )
+		if ( offload ) {
+			*trans_csum = ~*trans_csum;
+		} else if ( ! *trans_csum ) {
 			*trans_csum = tcpip_protocol->zero_csum;
+		}
 	}
 	iphdr->chksum = tcpip_chksum ( iphdr, sizeof ( *iphdr ) );
 
@@ -526,7 +634,8 @@ static int ipv4_rx ( struct io_buffer *iobuf,
 	if ( ( csum = tcpip_chksum ( iphdr, hdrlen ) ) != 0 ) {
 		DBGC ( iphdr->src, "IPv4 checksum incorrect (is %04x "
 		       "including checksum field, should be 0000)\n", csum );
-		goto err_header;
+		drop_count ( &ipv4_csum_drops );
+		goto err_csum;
 	}
 	len = ntohs ( iphdr->len );
 	if ( len < hdrlen ) {
@@ -538,6 +647,7 @@ static int ipv4_rx ( struct io_buffer *iobuf,
 		DBGC ( iphdr->src, "IPv4 length too long at %zd bytes "
 		       "(packet is %zd bytes)\n", len, iob_len ( iobuf ) );
 		ipv4_stats.in_truncated_pkts++;
+		drop_count ( &ipv4_truncated_drops );
 		goto err_other;
 	}
 
@@ -558,6 +668,7 @@ static int ipv4_rx ( struct io_buffer *iobuf,
 		DBGC ( iphdr->src, "IPv4 discarding non-local unicast packet "
 		       "for %s\n", inet_ntoa ( iphdr->dest ) );
 		ipv4_stats.in_addr_errors++;
+		drop_count ( &ipv4_addr_drops );
 		goto err_other;
 	}
 
@@ -595,6 +706,8 @@ static int ipv4_rx ( struct io_buffer *iobuf,
 	return 0;
 
  err_header:
+	drop_count ( &ipv4_header_drops );
+ err_csum:
 	ipv4_stats.in_hdr_errors++;
  err_other:
 	free_iob ( iobuf );
@@ -922,6 +1035,23 @@ static int ipv4_create_routes ( void ) {
 	return 0;
 }
 
+/**
+ * Invalidate IPv4 route cache on network device state change
+ *
+ * @v netdev		Network device
+ */
+static void ipv4_notify ( struct net_device *netdev __unused ) {
+
+	ipv4_route_flush();
+}
+
+/** IPv4 network device driver */
+struct net_driver ipv4_driver __net_driver = {
+	.name = "IPv4",
+	.notify = ipv4_notify,
+	.remove = ipv4_notify,
+};
+
 /** IPv4 settings applicator */
 struct settings_applicator ipv4_settings_applicator __settings_applicator = {
 	.apply = ipv4_create_routes,
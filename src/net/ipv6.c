@@ -59,6 +59,30 @@ FILE_LICENCE ( GPL2_OR_LATER );
 /** List of IPv6 miniroutes */
 struct list_head ipv6_miniroutes = LIST_HEAD_INIT ( ipv6_miniroutes );
 
+/** An IPv6 route cache entry */
+struct ipv6_route_cache {
+	/** Routing table generation for which this entry is valid */
+	unsigned int generation;
+	/** Destination address scope ID */
+	unsigned int scope_id;
+	/** Final destination address */
+	struct in6_addr dest;
+	/** Routing table entry */
+	struct ipv6_miniroute *miniroute;
+	/** Next hop is the routing table entry's router */
+	int via_router;
+};
+
+/** IPv6 route cache */
+static struct ipv6_route_cache ipv6_route_cache[IPV6_ROUTE_CACHE_SIZE];
+
+/** IPv6 routing table generation
+ *
+ * This is incremented whenever the routing table (or the state of
+ * any network device) changes, invalidating all route cache entries.
+ */
+static unsigned int ipv6_route_generation = 1;
+
 /** IPv6 statistics */
 static struct ip_statistics ipv6_stats;
 
@@ -131,6 +155,16 @@ ipv6_dump_miniroute ( struct ipv6_miniroute *miniroute ) {
 	DBGC ( netdev, "\n" );
 }
 
+/**
+ * Invalidate IPv6 route cache
+ *
+ * This must be called whenever the routing table is modified.
+ */
+void ipv6_route_flush ( void ) {
+
+	ipv6_route_generation++;
+}
+
 /**
  * Check if network device has a specific IPv6 address
  *
@@ -281,6 +315,7 @@ int ipv6_add_miniroute ( struct net_device *netdev, struct in6_addr *address,
 	}
 
 	ipv6_dump_miniroute ( miniroute );
+	ipv6_route_flush();
 	return 0;
 }
 
@@ -294,18 +329,19 @@ void ipv6_del_miniroute ( struct ipv6_miniroute *miniroute ) {
 	netdev_put ( miniroute->netdev );
 	list_del ( &miniroute->list );
 	free ( miniroute );
+	ipv6_route_flush();
 }
 
 /**
- * Perform IPv6 routing
+ * Perform IPv6 routing without using the route cache
  *
  * @v scope_id		Destination address scope ID (for link-local addresses)
  * @v dest		Final destination address
  * @ret dest		Next hop destination address
  * @ret miniroute	Routing table entry to use, or NULL if no route
  */
-struct ipv6_miniroute * ipv6_route ( unsigned int scope_id,
-				     struct in6_addr **dest ) {
+static struct ipv6_miniroute *
+ipv6_route_uncached ( unsigned int scope_id, struct in6_addr **dest ) {
 	struct ipv6_miniroute *miniroute;
 	struct ipv6_miniroute *chosen = NULL;
 	unsigned int best = 0;
@@ -374,6 +410,48 @@ struct ipv6_miniroute * ipv6_route ( unsigned int scope_id,
 	return NULL;
 }
 
+/**
+ * Perform IPv6 routing
+ *
+ * @v scope_id		Destination address scope ID (for link-local addresses)
+ * @v dest		Final destination address
+ * @ret dest		Next hop destination address
+ * @ret miniroute	Routing table entry to use, or NULL if no route
+ */
+struct ipv6_miniroute * ipv6_route ( unsigned int scope_id,
+				     struct in6_addr **dest ) {
+	struct ipv6_route_cache *cache;
+	struct ipv6_miniroute *miniroute;
+	struct in6_addr *final = *dest;
+	unsigned int hash;
+
+	/* Use cached route, if available */
+	hash = ( ntohl ( final->s6_addr32[0] ^ final->s6_addr32[1] ^
+			 final->s6_addr32[2] ^ final->s6_addr32[3] ) ^
+		 scope_id );
+	cache = &ipv6_route_cache[ hash % IPV6_ROUTE_CACHE_SIZE ];
+	if ( ( cache->generation == ipv6_route_generation ) &&
+	     ( cache->scope_id == scope_id ) &&
+	     ( memcmp ( &cache->dest, final, sizeof ( cache->dest ) ) == 0 )){
+		miniroute = cache->miniroute;
+		if ( cache->via_router )
+			*dest = &miniroute->router;
+		return miniroute;
+	}
+
+	/* Find route and record in cache */
+	miniroute = ipv6_route_uncached ( scope_id, dest );
+	if ( miniroute ) {
+		cache->generation = ipv6_route_generation;
+		cache->scope_id = scope_id;
+		memcpy ( &cache->dest, final, sizeof ( cache->dest ) );
+		cache->miniroute = miniroute;
+		cache->via_router = ( *dest != final );
+	}
+
+	return miniroute;
+}
+
 /**
  * Determine transmitting network device
  *
@@ -477,7 +555,6 @@ static int ipv6_more_fragments ( struct io_buffer *iobuf, size_t hdrlen ) {
 
 /** Fragment reassembler */
 static struct fragment_reassembler ipv6_reassembler = {
-	.list = LIST_HEAD_INIT ( ipv6_reassembler.list ),
 	.is_fragment = ipv6_is_fragment,
 	.fragment_offset = ipv6_fragment_offset,
 	.more_fragments = ipv6_more_fragments,
@@ -537,6 +614,7 @@ static int ipv6_tx ( struct io_buffer *iobuf,
 	uint8_t ll_dest_buf[MAX_LL_ADDR_LEN];
 	const void *ll_dest;
 	size_t len;
+	int offload;
 	int rc;
 
 	/* Update statistics */
@@ -573,11 +651,20 @@ static int ipv6_tx ( struct io_buffer *iobuf,
 
 	/* Fix up checksums */
 	if ( trans_csum ) {
+		if ( ( offload = tcpip_tx_chksum ( iobuf, netdev,
+						   ( iphdr + 1 ),
+						   trans_csum ) ) < 0 ) {
+			rc = offload;
+			goto err;
+		}
 		*trans_csum = ipv6_pshdr_chksum ( iphdr, len,
 						  tcpip_protocol->tcpip_proto,
 						  *trans_csum );
-		if ( ! *trans_csum )
+		if ( offload ) {
+			*trans_csum = ~*trans_csum;
+		} else if ( ! *trans_csum ) {
 			*trans_csum = tcpip_protocol->zero_csum;
+		}
 	}
 
 	/* Print IPv6 header for debugging */
@@ -1253,10 +1340,22 @@ static int ipv6_register_settings ( struct net_device *netdev ) {
 	return rc;
 }
 
+/**
+ * Invalidate IPv6 route cache on network device state change
+ *
+ * @v netdev		Network device
+ */
+static void ipv6_notify ( struct net_device *netdev __unused ) {
+
+	ipv6_route_flush();
+}
+
 /** IPv6 network device driver */
 struct net_driver ipv6_driver __net_driver = {
 	.name = "IPv6",
 	.probe = ipv6_register_settings,
+	.notify = ipv6_notify,
+	.remove = ipv6_notify,
 };
 
 /**
@@ -1061,6 +1061,14 @@ struct ipv6conf {
 
 	/** Retransmission timer */
 	struct retry_timer timer;
+
+	/** Speculative stateless DHCPv6 status
+	 *
+	 * This is -EINPROGRESS while a stateless DHCPv6 session that
+	 * was started ahead of the first router advertisement is
+	 * still running, and the final status code thereafter.
+	 */
+	int dhcp_rc;
 };
 
 /** List of IPv6 configurators */
@@ -1182,6 +1190,19 @@ ipv6conf_rx_router_advertisement ( struct net_device *netdev,
 	/* Start DHCPv6 if required */
 	if ( radv->flags & ( NDP_ROUTER_MANAGED | NDP_ROUTER_OTHER ) ) {
 		stateful = ( radv->flags & NDP_ROUTER_MANAGED );
+
+		/* Use speculative stateless DHCPv6, if sufficient */
+		if ( ! stateful ) {
+			if ( ipv6conf->dhcp_rc == -EINPROGRESS )
+				return 0;
+			if ( ipv6conf->dhcp_rc == 0 ) {
+				ipv6conf_done ( ipv6conf, 0 );
+				return 0;
+			}
+		}
+
+		/* Otherwise, (re)start DHCPv6 in the required mode */
+		intf_restart ( &ipv6conf->dhcp, 0 );
 		if ( ( rc = start_dhcpv6 ( &ipv6conf->dhcp, netdev,
 					   stateful ) ) != 0 ) {
 			DBGC ( netdev, "NDP %s could not start state%s DHCPv6: "
@@ -1208,9 +1229,34 @@ static struct interface_operation ipv6conf_job_op[] = {
 static struct interface_descriptor ipv6conf_job_desc =
 	INTF_DESC ( struct ipv6conf, job, ipv6conf_job_op );
 
+/**
+ * Handle completion of DHCPv6
+ *
+ * @v ipv6conf		IPv6 configurator
+ * @v rc		Reason for completion
+ */
+static void ipv6conf_dhcp_done ( struct ipv6conf *ipv6conf, int rc ) {
+
+	/* Restart interface (to allow DHCPv6 to be restarted) */
+	intf_restart ( &ipv6conf->dhcp, rc );
+
+	/* Record status and continue waiting for a router
+	 * advertisement, if this was a speculative DHCPv6 session.
+	 */
+	if ( timer_running ( &ipv6conf->timer ) ) {
+		DBGC ( ipv6conf->netdev, "NDP %s speculative DHCPv6 complete: "
+		       "%s\n", ipv6conf->netdev->name, strerror ( rc ) );
+		ipv6conf->dhcp_rc = rc;
+		return;
+	}
+
+	/* Otherwise, terminate autoconfiguration */
+	ipv6conf_done ( ipv6conf, rc );
+}
+
 /** IPv6 configurator DHCPv6 interface operations */
 static struct interface_operation ipv6conf_dhcp_op[] = {
-	INTF_OP ( intf_close, struct ipv6conf *, ipv6conf_done ),
+	INTF_OP ( intf_close, struct ipv6conf *, ipv6conf_dhcp_done ),
 };
 
 /** IPv6 configurator DHCPv6 interface descriptor */
@@ -1226,6 +1272,7 @@ static struct interface_descriptor ipv6conf_dhcp_desc =
  */
 int start_ipv6conf ( struct interface *job, struct net_device *netdev ) {
 	struct ipv6conf *ipv6conf;
+	int rc;
 
 	/* Allocate and initialise structure */
 	ipv6conf = zalloc ( sizeof ( *ipv6conf ) );
@@ -1240,6 +1287,19 @@ int start_ipv6conf ( struct interface *job, struct net_device *netdev ) {
 	/* Start timer to initiate router solicitation */
 	start_timer_nodelay ( &ipv6conf->timer );
 
+	/* Start stateless DHCPv6 immediately, rather than waiting to
+	 * discover whether or not the router advertisement requests
+	 * it.  This will usually have completed by the time that the
+	 * router advertisement arrives.
+	 */
+	if ( ( rc = start_dhcpv6 ( &ipv6conf->dhcp, netdev, 0 ) ) == 0 ) {
+		ipv6conf->dhcp_rc = -EINPROGRESS;
+	} else {
+		DBGC ( netdev, "NDP %s could not start speculative DHCPv6: "
+		       "%s\n", netdev->name, strerror ( rc ) );
+		ipv6conf->dhcp_rc = rc;
+	}
+
 	/* Attach parent interface, transfer reference to list, and return */
 	intf_plug_plug ( &ipv6conf->job, job );
 	list_add ( &ipv6conf->list, &ipv6confs );
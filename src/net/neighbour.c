@@ -32,6 +32,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/timer.h>
 #include <ipxe/malloc.h>
 #include <ipxe/neighbour.h>
+#include <ipxe/handover.h>
 
 /** @file
  *
@@ -51,8 +52,37 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** The neighbour cache */
 struct list_head neighbours = LIST_HEAD_INIT ( neighbours );
 
+/** Neighbour cache hash table (indexed by network-layer address) */
+static struct list_head neighbour_hash[NEIGHBOUR_HASH_BUCKETS];
+
 static void neighbour_expired ( struct retry_timer *timer, int over );
 
+/**
+ * Get neighbour cache hash bucket
+ *
+ * @v net_protocol	Network-layer protocol
+ * @v net_dest		Destination network-layer address
+ * @ret list		List of entries within hash bucket
+ */
+static struct list_head * neighbour_bucket ( struct net_protocol *net_protocol,
+					     const void *net_dest ) {
+	const uint8_t *bytes = net_dest;
+	unsigned int hash = 0;
+	unsigned int i;
+
+	/* Initialise hash table, if not already done */
+	if ( ! neighbour_hash[0].next ) {
+		for ( i = 0 ; i < NEIGHBOUR_HASH_BUCKETS ; i++ )
+			INIT_LIST_HEAD ( &neighbour_hash[i] );
+	}
+
+	/* Hash network-layer address */
+	for ( i = 0 ; i < net_protocol->net_addr_len ; i++ )
+		hash = ( ( hash * 31 ) + bytes[i] );
+
+	return &neighbour_hash[ hash % NEIGHBOUR_HASH_BUCKETS ];
+}
+
 /**
  * Free neighbour cache entry
  *
@@ -101,6 +131,8 @@ static struct neighbour * neighbour_create ( struct net_device *netdev,
 
 	/* Transfer ownership to cache */
 	list_add ( &neighbour->list, &neighbours );
+	list_add ( &neighbour->hash,
+		   neighbour_bucket ( net_protocol, net_dest ) );
 
 	DBGC ( neighbour, "NEIGHBOUR %s %s %s created\n", netdev->name,
 	       net_protocol->name, net_protocol->ntoa ( net_dest ) );
@@ -118,17 +150,20 @@ static struct neighbour * neighbour_create ( struct net_device *netdev,
 static struct neighbour * neighbour_find ( struct net_device *netdev,
 					   struct net_protocol *net_protocol,
 					   const void *net_dest ) {
+	struct list_head *bucket = neighbour_bucket ( net_protocol, net_dest );
 	struct neighbour *neighbour;
 
-	list_for_each_entry ( neighbour, &neighbours, list ) {
+	list_for_each_entry ( neighbour, bucket, hash ) {
 		if ( ( neighbour->netdev == netdev ) &&
 		     ( neighbour->net_protocol == net_protocol ) &&
 		     ( memcmp ( neighbour->net_dest, net_dest,
 				net_protocol->net_addr_len ) == 0 ) ) {
 
-			/* Move to start of cache */
+			/* Move to start of cache and of hash bucket */
 			list_del ( &neighbour->list );
 			list_add ( &neighbour->list, &neighbours );
+			list_del ( &neighbour->hash );
+			list_add ( &neighbour->hash, bucket );
 
 			return neighbour;
 		}
@@ -223,6 +258,7 @@ static void neighbour_destroy ( struct neighbour *neighbour, int rc ) {
 
 	/* Take ownership from cache */
 	list_del ( &neighbour->list );
+	list_del ( &neighbour->hash );
 
 	/* Stop timer */
 	stop_timer ( &neighbour->timer );
@@ -395,10 +431,192 @@ static void neighbour_flush ( struct net_device *netdev ) {
 	}
 }
 
+/******************************************************************************
+ *
+ * State handover
+ *
+ ******************************************************************************
+ */
+
+/** A neighbour cache state handover entry */
+struct neighbour_handover_entry {
+	/** Network-layer protocol (in network byte order) */
+	uint16_t net_proto;
+	/** Length of link-layer addresses */
+	uint8_t ll_addr_len;
+	/** Length of network-layer address */
+	uint8_t net_addr_len;
+	/** Network device link-layer address */
+	uint8_t ll_addr[MAX_LL_ADDR_LEN];
+	/** Network-layer destination address */
+	uint8_t net_dest[MAX_NET_ADDR_LEN];
+	/** Link-layer destination address */
+	uint8_t ll_dest[MAX_LL_ADDR_LEN];
+} __attribute__ (( packed ));
+
+/** Handed over neighbour cache entries awaiting use (if any) */
+static struct neighbour_handover_entry *neighbour_handover;
+
+/** Number of handed over neighbour cache entries */
+static unsigned int neighbour_handover_count;
+
+/**
+ * Save neighbour cache state for handover
+ *
+ * @v data		Buffer to fill with state, or NULL
+ * @v len		Length of buffer
+ * @ret len		Length of state, or zero if no state exists
+ */
+static size_t neighbour_handover_save ( void *data, size_t len ) {
+	struct neighbour_handover_entry *entry = data;
+	struct neighbour *neighbour;
+	struct net_device *netdev;
+	struct ll_protocol *ll_protocol;
+	struct net_protocol *net_protocol;
+	size_t used = 0;
+
+	/* Record oldest entries first, so that the restored cache has
+	 * the same ordering.
+	 */
+	list_for_each_entry_reverse ( neighbour, &neighbours, list ) {
+
+		/* Skip entries still undergoing discovery */
+		if ( ! neighbour_has_ll_dest ( neighbour ) )
+			continue;
+
+		/* Record entry */
+		if ( ( used + sizeof ( *entry ) ) <= len ) {
+			netdev = neighbour->netdev;
+			ll_protocol = netdev->ll_protocol;
+			net_protocol = neighbour->net_protocol;
+			memset ( entry, 0, sizeof ( *entry ) );
+			entry->net_proto = net_protocol->net_proto;
+			entry->ll_addr_len = ll_protocol->ll_addr_len;
+			entry->net_addr_len = net_protocol->net_addr_len;
+			memcpy ( entry->ll_addr, netdev->ll_addr,
+				 ll_protocol->ll_addr_len );
+			memcpy ( entry->net_dest, neighbour->net_dest,
+				 net_protocol->net_addr_len );
+			memcpy ( entry->ll_dest, neighbour->ll_dest,
+				 ll_protocol->ll_addr_len );
+			entry++;
+		}
+		used += sizeof ( *entry );
+	}
+
+	return used;
+}
+
+/**
+ * Restore neighbour cache state from handover
+ *
+ * @v data		State
+ * @v len		Length of state
+ * @ret rc		Return status code
+ *
+ * The entries are retained until the corresponding network device is
+ * opened, since the neighbour cache is flushed whenever any network
+ * device is closed.
+ */
+static int neighbour_handover_restore ( const void *data, size_t len ) {
+
+	/* Retain copy of state */
+	free ( neighbour_handover );
+	neighbour_handover_count = ( len / sizeof ( *neighbour_handover ) );
+	neighbour_handover = malloc ( len );
+	if ( ! neighbour_handover ) {
+		neighbour_handover_count = 0;
+		return -ENOMEM;
+	}
+	memcpy ( neighbour_handover, data, len );
+
+	return 0;
+}
+
+/**
+ * Identify network-layer protocol for handed over neighbour cache entry
+ *
+ * @v entry		Handed over neighbour cache entry
+ * @ret net_protocol	Network-layer protocol, or NULL if not found
+ */
+static struct net_protocol *
+neighbour_handover_protocol ( struct neighbour_handover_entry *entry ) {
+	struct net_protocol *net_protocol;
+
+	for_each_table_entry ( net_protocol, NET_PROTOCOLS ) {
+		if ( ( net_protocol->net_proto == entry->net_proto ) &&
+		     ( net_protocol->net_addr_len == entry->net_addr_len ) )
+			return net_protocol;
+	}
+	return NULL;
+}
+
+/**
+ * Apply handed over neighbour cache entries (if applicable)
+ *
+ * @v netdev		Network device
+ */
+static void neighbour_handover_apply ( struct net_device *netdev ) {
+	struct ll_protocol *ll_protocol = netdev->ll_protocol;
+	struct neighbour_handover_entry *entry;
+	struct net_protocol *net_protocol;
+	unsigned int i;
+
+	/* Do nothing unless the network device is open */
+	if ( ! netdev_is_open ( netdev ) )
+		return;
+
+	/* Define any entries belonging to this network device */
+	for ( i = 0 ; i < neighbour_handover_count ; i++ ) {
+		entry = &neighbour_handover[i];
+
+		/* Check for a matching network device */
+		if ( ( entry->ll_addr_len != ll_protocol->ll_addr_len ) ||
+		     ( memcmp ( entry->ll_addr, netdev->ll_addr,
+				ll_protocol->ll_addr_len ) != 0 ) )
+			continue;
+
+		/* Identify network-layer protocol */
+		net_protocol = neighbour_handover_protocol ( entry );
+		if ( ! net_protocol )
+			continue;
+
+		/* Define entry, and mark as used */
+		DBGC ( netdev, "NEIGHBOUR %s %s %s restored\n", netdev->name,
+		       net_protocol->name,
+		       net_protocol->ntoa ( entry->net_dest ) );
+		neighbour_define ( netdev, net_protocol, entry->net_dest,
+				   entry->ll_dest );
+		entry->ll_addr_len = 0;
+	}
+}
+
+/** Neighbour cache state handover provider */
+struct handover_provider neighbour_handover_provider __handover_provider = {
+	.name = "neighbour",
+	.type = HANDOVER_NEIGHBOUR,
+	.save = neighbour_handover_save,
+	.restore = neighbour_handover_restore,
+};
+
+/**
+ * Handle network device state change
+ *
+ * @v netdev		Network device
+ */
+static void neighbour_notify ( struct net_device *netdev ) {
+
+	/* Flush cache if required */
+	neighbour_flush ( netdev );
+
+	/* Use any handed over entries */
+	neighbour_handover_apply ( netdev );
+}
+
 /** Neighbour driver (for net device notifications) */
 struct net_driver neighbour_net_driver __net_driver = {
 	.name = "Neighbour",
-	.notify = neighbour_flush,
+	.notify = neighbour_notify,
 	.remove = neighbour_flush,
 };
 
@@ -32,6 +32,8 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/device.h>
 #include <ipxe/netdevice.h>
 #include <ipxe/init.h>
+#include <ipxe/malloc.h>
+#include <config/general.h>
 
 /** @file
  *
@@ -76,6 +78,11 @@ const struct setting mtu_setting __setting ( SETTING_NETDEV, mtu ) = {
 	.type = &setting_type_int16,
 	.tag = DHCP_MTU,
 };
+const struct setting rxfill_setting __setting ( SETTING_NETDEV, rxfill ) = {
+	.name = "rxfill",
+	.description = "Receive ring fill level",
+	.type = &setting_type_int16,
+};
 
 /**
  * Store MAC address setting
@@ -442,6 +449,46 @@ static int apply_netdev_settings ( void ) {
 	return 0;
 }
 
+/**
+ * Determine receive ring fill level
+ *
+ * @v netdev		Network device
+ * @v max		Maximum fill level supported by hardware ring
+ * @v len		Length of each receive buffer
+ * @ret fill		Receive ring fill level
+ *
+ * The fill level is taken from the "rxfill" setting if present, or
+ * from the build-time default otherwise, and is limited so that the
+ * posted receive buffers do not consume more than a quarter of the
+ * currently free heap memory.
+ */
+unsigned int netdev_rx_fill ( struct net_device *netdev, unsigned int max,
+			      size_t len ) {
+	unsigned int fill;
+	unsigned int limit;
+
+	/* Get configured fill level, if any */
+	fill = fetch_uintz_setting ( netdev_settings ( netdev ),
+				     &rxfill_setting );
+	if ( ! fill )
+		fill = NETDEV_RX_FILL;
+
+	/* Limit fill level according to available memory */
+	limit = ( ( freemem / 4 ) / ( len ? len : 1 ) );
+	if ( fill > limit )
+		fill = limit;
+
+	/* Limit fill level to hardware ring size */
+	if ( fill > max )
+		fill = max;
+	if ( ! fill )
+		fill = 1;
+
+	DBGC ( netdev, "NETDEV %s RX fill level is %d/%d\n",
+	       netdev->name, fill, max );
+	return fill;
+}
+
 /** Network device settings applicator */
 struct settings_applicator netdev_applicator __settings_applicator = {
 	.apply = apply_netdev_settings,
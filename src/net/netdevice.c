@@ -34,13 +34,17 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/iobuf.h>
 #include <ipxe/tables.h>
 #include <ipxe/process.h>
+#include <ipxe/timer.h>
 #include <ipxe/init.h>
 #include <ipxe/malloc.h>
 #include <ipxe/device.h>
 #include <ipxe/errortab.h>
 #include <ipxe/profile.h>
+#include <ipxe/dropstat.h>
 #include <ipxe/fault.h>
 #include <ipxe/vlan.h>
+#include <ipxe/tcp.h>
+#include <ipxe/trace.h>
 #include <ipxe/netdevice.h>
 
 /** @file
@@ -67,6 +71,21 @@ static struct profiler net_rx_profiler __profiler = { .name = "net.rx" };
 /** Network transmit profiler */
 static struct profiler net_tx_profiler __profiler = { .name = "net.tx" };
 
+/** Packets dropped due to a malformed link-layer header */
+static struct drop_counter net_ll_drops __drop_counter = {
+	.name = "net.llheader",
+};
+
+/** Packets dropped due to an unknown network-layer protocol */
+static struct drop_counter net_proto_drops __drop_counter = {
+	.name = "net.proto",
+};
+
+/** Packets dropped due to the device being closed */
+static struct drop_counter net_flush_drops __drop_counter = {
+	.name = "net.flush",
+};
+
 /** Default unknown link status code */
 #define EUNKNOWN_LINK_STATUS __einfo_error ( EINFO_EUNKNOWN_LINK_STATUS )
 #define EINFO_EUNKNOWN_LINK_STATUS \
@@ -126,6 +145,37 @@ static void netdev_notify ( struct net_device *netdev ) {
 	}
 }
 
+/**
+ * Restart any ongoing network device configurations
+ *
+ * @v netdev		Network device
+ *
+ * Configurators typically back off exponentially while waiting for a
+ * response.  When the link becomes usable (e.g. once a switch port
+ * has finished spanning tree or link aggregation negotiation), any
+ * ongoing configurations are restarted so that they do not have to
+ * wait out the remainder of their backoff period.
+ */
+static void netdev_config_restart ( struct net_device *netdev ) {
+	struct net_device_configurator *configurator;
+	struct net_device_configuration *config;
+
+	/* Do nothing unless device is open and link is usable */
+	if ( ! ( netdev_is_open ( netdev ) && netdev_link_ok ( netdev ) &&
+		 ( ! netdev_link_blocked ( netdev ) ) ) )
+		return;
+
+	/* Restart each ongoing configuration */
+	for_each_table_entry ( configurator, NET_DEVICE_CONFIGURATORS ) {
+		config = netdev_configuration ( netdev, configurator );
+		if ( config->rc != -EINPROGRESS_CONFIG )
+			continue;
+		DBGC ( netdev, "NETDEV %s restarting configuration via %s\n",
+		       netdev->name, configurator->name );
+		netdev_configure ( netdev, configurator );
+	}
+}
+
 /**
  * Freeze network device receive queue processing
  *
@@ -161,6 +211,7 @@ void netdev_rx_unfreeze ( struct net_device *netdev ) {
  * @v rc		Link status code
  */
 void netdev_link_err ( struct net_device *netdev, int rc ) {
+	int was_ok = netdev_link_ok ( netdev );
 
 	/* Stop link block timer */
 	stop_timer ( &netdev->link_block );
@@ -176,6 +227,10 @@ void netdev_link_err ( struct net_device *netdev, int rc ) {
 
 	/* Notify drivers of link state change */
 	netdev_notify ( netdev );
+
+	/* Restart any ongoing configurations if link has come up */
+	if ( ! was_ok )
+		netdev_config_restart ( netdev );
 }
 
 /**
@@ -217,10 +272,16 @@ void netdev_link_block ( struct net_device *netdev, unsigned long timeout ) {
  */
 void netdev_link_unblock ( struct net_device *netdev ) {
 
+	/* Do nothing unless link is currently blocked */
+	if ( ! netdev_link_blocked ( netdev ) )
+		return;
+
 	/* Stop link block timer */
-	if ( netdev_link_blocked ( netdev ) )
-		DBGC ( netdev, "NETDEV %s link unblocked\n", netdev->name );
+	DBGC ( netdev, "NETDEV %s link unblocked\n", netdev->name );
 	stop_timer ( &netdev->link_block );
+
+	/* Restart any ongoing configurations */
+	netdev_config_restart ( netdev );
 }
 
 /**
@@ -236,6 +297,9 @@ static void netdev_link_block_expired ( struct retry_timer *timer,
 
 	/* Assume link is no longer blocked */
 	DBGC ( netdev, "NETDEV %s link block expired\n", netdev->name );
+
+	/* Restart any ongoing configurations */
+	netdev_config_restart ( netdev );
 }
 
 /**
@@ -292,6 +356,7 @@ int netdev_tx ( struct net_device *netdev, struct io_buffer *iobuf ) {
 
 	DBGC2 ( netdev, "NETDEV %s transmitting %p (%p+%zx)\n",
 		netdev->name, iobuf, iobuf->data, iob_len ( iobuf ) );
+	TRACE ( "netdev_tx_len", netdev, iob_len ( iobuf ) );
 	profile_start ( &net_tx_profiler );
 
 	/* Enqueue packet */
@@ -369,8 +434,10 @@ void netdev_tx_defer ( struct net_device *netdev, struct io_buffer *iobuf ) {
 void netdev_tx_err ( struct net_device *netdev,
 		     struct io_buffer *iobuf, int rc ) {
 
-	/* Update statistics counter */
+	/* Update statistics counters */
 	netdev_record_stat ( &netdev->tx_stats, rc );
+	if ( ( rc == 0 ) && iobuf )
+		netdev->tx_stats.bytes += iob_len ( iobuf );
 	if ( rc == 0 ) {
 		DBGC2 ( netdev, "NETDEV %s transmission %p complete\n",
 			netdev->name, iobuf );
@@ -459,6 +526,7 @@ void netdev_rx ( struct net_device *netdev, struct io_buffer *iobuf ) {
 
 	DBGC2 ( netdev, "NETDEV %s received %p (%p+%zx)\n",
 		netdev->name, iobuf, iobuf->data, iob_len ( iobuf ) );
+	TRACE ( "netdev_rx_len", netdev, iob_len ( iobuf ) );
 
 	/* Discard packet (for test purposes) if applicable */
 	if ( ( rc = inject_fault ( NETDEV_DISCARD_RATE ) ) != 0 ) {
@@ -469,8 +537,9 @@ void netdev_rx ( struct net_device *netdev, struct io_buffer *iobuf ) {
 	/* Enqueue packet */
 	list_add_tail ( &iobuf->list, &netdev->rx_queue );
 
-	/* Update statistics counter */
+	/* Update statistics counters */
 	netdev_record_stat ( &netdev->rx_stats, 0 );
+	netdev->rx_stats.bytes += iob_len ( iobuf );
 }
 
 /**
@@ -543,6 +612,7 @@ static void netdev_rx_flush ( struct net_device *netdev ) {
 
 	/* Discard any packets in the RX queue */
 	while ( ( iobuf = netdev_rx_dequeue ( netdev ) ) ) {
+		drop_count ( &net_flush_drops );
 		netdev_rx_err ( netdev, iobuf, -ECANCELED );
 	}
 }
@@ -767,6 +837,9 @@ int netdev_open ( struct net_device *netdev ) {
 	if ( ( rc = netdev->op->open ( netdev ) ) != 0 )
 		goto err;
 
+	/* Record time of opening */
+	netdev->opened = currticks();
+
 	/* Add to head of open devices list */
 	list_add ( &netdev->open_list, &open_net_devices );
 
@@ -1029,6 +1102,7 @@ int net_rx ( struct io_buffer *iobuf, struct net_device *netdev,
 
 	DBGC ( netdev, "NETDEV %s unknown network protocol %04x\n",
 	       netdev->name, ntohs ( net_proto ) );
+	drop_count ( &net_proto_drops );
 	free_iob ( iobuf );
 	return -ENOTSUP;
 }
@@ -1046,16 +1120,33 @@ void net_poll ( void ) {
 	const void *ll_dest;
 	const void *ll_source;
 	uint16_t net_proto;
+	unsigned int budget;
+	unsigned int count;
 	unsigned int flags;
 	int rc;
 
 	/* Poll and process each network device */
 	list_for_each_entry ( netdev, &net_devices, list ) {
 
-		/* Poll for new packets */
-		profile_start ( &net_poll_profiler );
-		netdev_poll ( netdev );
-		profile_stop ( &net_poll_profiler );
+		/* Poll for new packets.  Keep polling for as long as
+		 * new packets continue to arrive (up to the receive
+		 * budget), so that the device's receive ring is
+		 * drained and refilled several times before the
+		 * received packets are processed as a single batch.
+		 */
+		budget = NETDEV_RX_BUDGET;
+		do {
+			count = ( netdev->rx_stats.good +
+				  netdev->rx_stats.bad );
+			profile_start ( &net_poll_profiler );
+			netdev_poll ( netdev );
+			profile_stop ( &net_poll_profiler );
+			count = ( netdev->rx_stats.good +
+				  netdev->rx_stats.bad - count );
+			if ( count >= budget )
+				break;
+			budget -= count;
+		} while ( count );
 
 		/* Leave received packets on the queue if receive
 		 * queue processing is currently frozen.  This will
@@ -1066,6 +1157,9 @@ void net_poll ( void ) {
 		if ( netdev_rx_frozen ( netdev ) )
 			continue;
 
+		/* Coalesce received TCP segments, if applicable */
+		tcp_gro ( netdev );
+
 		/* Process all received packets */
 		while ( ( iobuf = netdev_rx_dequeue ( netdev ) ) ) {
 
@@ -1080,6 +1174,7 @@ void net_poll ( void ) {
 							&ll_dest, &ll_source,
 							&net_proto,
 							&flags ) ) != 0 ) {
+				drop_count ( &net_ll_drops );
 				free_iob ( iobuf );
 				continue;
 			}
@@ -1096,13 +1191,39 @@ void net_poll ( void ) {
 	}
 }
 
+/**
+ * Count network packets
+ *
+ * @ret count		Total number of packets transmitted or received
+ */
+static unsigned long net_packets ( void ) {
+	struct net_device *netdev;
+	unsigned long count = 0;
+
+	for_each_netdev ( netdev ) {
+		count += ( netdev->tx_stats.good + netdev->tx_stats.bad +
+			   netdev->rx_stats.good + netdev->rx_stats.bad );
+	}
+	return count;
+}
+
 /**
  * Single-step the network stack
  *
  * @v process		Network stack process
+ *
+ * The remainder of the scheduling turn is given up whenever a step
+ * finds no packets to process, so that the scheduling weight applies
+ * only while there is network traffic (e.g. during a download).
  */
-static void net_step ( struct process *process __unused ) {
+static void net_step ( struct process *process ) {
+	unsigned long packets;
+
+	net_nap();
+	packets = net_packets();
 	net_poll();
+	if ( net_packets() == packets )
+		process_yield ( process );
 }
 
 /**
@@ -1127,8 +1248,39 @@ __weak struct net_device * vlan_find ( struct net_device *trunk __unused,
 	return NULL;
 }
 
+/**
+ * Process incoming packet with VLAN tag stripped by hardware (when
+ * VLAN support is not present)
+ *
+ * @v trunk		Trunk network device
+ * @v tag		VLAN tag
+ * @v iobuf		I/O buffer
+ */
+__weak void vlan_netdev_rx ( struct net_device *trunk,
+			     unsigned int tag __unused,
+			     struct io_buffer *iobuf ) {
+	netdev_rx_err ( trunk, iobuf, -ENODEV );
+}
+
+/**
+ * Coalesce received TCP segments (when TCP coalescing is not present)
+ *
+ * @v netdev		Network device
+ */
+__weak void tcp_gro ( struct net_device *netdev __unused ) {
+	/* Nothing to do */
+}
+
+/**
+ * Sleep while network is idle (when adaptive idle is not present)
+ *
+ */
+__weak void net_nap ( void ) {
+	/* Nothing to do */
+}
+
 /** Networking stack process */
-PERMANENT_PROCESS ( net_process, net_step );
+PERMANENT_PROCESS_WEIGHTED ( net_process, net_step, NET_PROCESS_WEIGHT );
 
 /**
  * Discard some cached network device data
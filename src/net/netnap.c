@@ -0,0 +1,105 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Adaptive idle for the network stack
+ *
+ * Rather than spinning continuously through the network device poll
+ * loop, the CPU is put to sleep until the next interrupt (typically
+ * the firmware timer tick) whenever both the network and the process
+ * run queue have been idle for a short while.  Busy polling resumes
+ * as soon as any packet is transmitted or received, so that active
+ * transfers are not slowed down.
+ *
+ */
+
+#include <ipxe/list.h>
+#include <ipxe/timer.h>
+#include <ipxe/nap.h>
+#include <ipxe/process.h>
+#include <ipxe/netdevice.h>
+
+/** Minimum idle period before sleeping
+ *
+ * This is a policy decision.
+ */
+#define NET_NAP_IDLE ( TICKS_PER_SEC / 4 )
+
+/** Network activity count at time of most recent activity */
+static unsigned long net_nap_count;
+
+/** Time of most recent network activity */
+static unsigned long net_nap_active;
+
+/**
+ * Count network activity
+ *
+ * @ret count		Activity count
+ *
+ * The count changes whenever any packet is transmitted or received
+ * (successfully or otherwise).  A nonzero count is also returned
+ * whenever any transmission is still outstanding.
+ */
+static unsigned long net_nap_activity ( void ) {
+	struct net_device *netdev;
+	unsigned long count = 0;
+
+	for_each_netdev ( netdev ) {
+		if ( ! list_empty ( &netdev->tx_queue ) )
+			return ~0UL;
+		count += ( netdev->tx_stats.good + netdev->tx_stats.bad +
+			   netdev->rx_stats.good + netdev->rx_stats.bad );
+	}
+	return count;
+}
+
+/**
+ * Sleep while network is idle
+ *
+ */
+void net_nap ( void ) {
+	unsigned long now = currticks();
+	unsigned long count;
+
+	/* Reset idle period on any network activity */
+	count = net_nap_activity();
+	if ( ( count != net_nap_count ) || ( count == ~0UL ) ) {
+		net_nap_count = count;
+		net_nap_active = now;
+		return;
+	}
+
+	/* Continue busy polling while any other work is pending */
+	if ( ! process_idle() ) {
+		net_nap_active = now;
+		return;
+	}
+
+	/* Continue busy polling until idle period has elapsed */
+	if ( ( now - net_nap_active ) < NET_NAP_IDLE )
+		return;
+
+	/* Sleep until next interrupt */
+	cpu_nap();
+}
@@ -50,7 +50,37 @@
 
 FEATURE ( FEATURE_PROTOCOL, "NFS", DHCP_EB_FEATURE_NFS, 1 );
 
-#define NFS_RSIZE 100000
+/** Default NFS READ request size
+ *
+ * This is used if the server does not report its maximum READ
+ * request size via FSINFO.
+ */
+#define NFS_DEFAULT_RSIZE 32768
+
+/** Maximum NFS READ request size
+ *
+ * READ data is passed up as it arrives, so there is no need to
+ * buffer an entire READ reply.
+ */
+#define NFS_MAX_RSIZE ( 1024 * 1024 )
+
+/** Maximum number of concurrent NFS READ requests
+ *
+ * Keeping several READ requests outstanding allows the server to
+ * keep the connection full while each reply is being consumed.
+ */
+#define NFS_MAX_READS 4
+
+/** Maximum length of a buffered NFS reply
+ *
+ * Replies other than READ are buffered in their entirety.  Only the
+ * first part of a READ reply is buffered, which is sufficient to
+ * include the complete reply header.
+ */
+#define NFS_MAX_REPLY_LEN 4096
+
+/** Minimum length of an ONC RPC reply record (excluding record mark) */
+#define NFS_MIN_REPLY_LEN ( 6 * sizeof ( uint32_t ) )
 
 enum nfs_pm_state {
 	NFS_PORTMAP_NONE = 0,
@@ -68,15 +98,29 @@ enum nfs_mount_state {
 
 enum nfs_state {
 	NFS_NONE = 0,
+	NFS_FSINFO,
+	NFS_FSINFO_SENT,
 	NFS_LOOKUP,
 	NFS_LOOKUP_SENT,
 	NFS_READLINK,
 	NFS_READLINK_SENT,
 	NFS_READ,
-	NFS_READ_SENT,
 	NFS_CLOSED,
 };
 
+/**
+ * An outstanding NFS READ request
+ *
+ */
+struct nfs_read_request {
+	/** Transaction ID */
+	uint32_t                xid;
+	/** File offset */
+	uint64_t                offset;
+	/** Length (or zero if unused) */
+	uint32_t                len;
+};
+
 /**
  * A NFS request
  *
@@ -106,8 +150,29 @@ struct nfs_request {
 
 	struct nfs_fh           readlink_fh;
 	struct nfs_fh           current_fh;
+	/** Offset of next READ request */
 	uint64_t                file_offset;
-
+	/** File size (if known) */
+	uint64_t                filesize;
+	/** File size is known */
+	int                     size_known;
+	/** READ request size */
+	uint32_t                rsize;
+	/** Outstanding READ requests */
+	struct nfs_read_request reads[NFS_MAX_READS];
+	/** Number of outstanding READ requests */
+	unsigned int            num_reads;
+
+	/** Partially received reply (if any) */
+	struct io_buffer        *rx;
+	/** Length of reply to be buffered (or zero if not yet known) */
+	size_t                  rx_len;
+	/** Length of current reply record not yet received */
+	size_t                  rx_remaining;
+	/** File offset of next received READ data */
+	uint64_t                rx_offset;
+
+	/** Length of READ data not yet received */
 	size_t                  remaining;
 	int                     eof;
 };
@@ -127,6 +192,7 @@ static void nfs_free ( struct refcnt *refcnt ) {
 
 	nfs_uri_free ( &nfs->uri );
 
+	free_iob ( nfs->rx );
 	free ( nfs->hostname );
 	free ( nfs->auth_sys.hostname );
 	free ( nfs );
@@ -343,7 +409,7 @@ static int nfs_mount_deliver ( struct nfs_request *nfs,
 		}
 
 		nfs->current_fh = mnt_reply.fh;
-		nfs->nfs_state = NFS_LOOKUP;
+		nfs->nfs_state = NFS_FSINFO;
 		nfs_step ( nfs );
 
 		goto done;
@@ -364,13 +430,119 @@ done:
 	return 0;
 }
 
+/**
+ * Send NFS READ request
+ *
+ * @v nfs		NFS request
+ * @v read		READ request slot
+ * @v offset		File offset
+ * @v len		Length
+ * @ret rc		Return status code
+ */
+static int nfs_read_send ( struct nfs_request *nfs,
+			   struct nfs_read_request *read, uint64_t offset,
+			   uint32_t len ) {
+	int     rc;
+
+	DBGC2 ( nfs, "NFS_OPEN %p READ call (%#llx+%#x)\n",
+		nfs, ( ( unsigned long long ) offset ), len );
+
+	rc = nfs_read ( &nfs->nfs_intf, &nfs->nfs_session,
+	                &nfs->current_fh, offset, len );
+	if ( rc != 0 )
+		return rc;
+
+	/* Record transaction ID for matching against the reply */
+	read->xid    = nfs->nfs_session.rpc_id;
+	read->offset = offset;
+	read->len    = len;
+	nfs->num_reads++;
+
+	return 0;
+}
+
+/**
+ * Send NFS READ requests and check for completion
+ *
+ * @v nfs		NFS request
+ * @ret rc		Return status code
+ */
+static int nfs_read_step ( struct nfs_request *nfs ) {
+	struct nfs_read_request *read;
+	unsigned int            max_reads;
+	uint32_t                len;
+	int                     rc;
+
+	/* Without a known file size, the end of the file is found
+	 * only from the EOF indicator, so read one block at a time.
+	 */
+	max_reads = ( nfs->size_known ? NFS_MAX_READS : 1 );
+
+	/* Fill the pipeline */
+	while ( ( nfs->num_reads < max_reads ) && ( ! nfs->eof ) &&
+	        xfer_window ( &nfs->nfs_intf ) ) {
+
+		len = nfs->rsize;
+		if ( nfs->size_known ) {
+			if ( nfs->file_offset >= nfs->filesize )
+				break;
+			if ( len > ( nfs->filesize - nfs->file_offset ) )
+				len = ( nfs->filesize - nfs->file_offset );
+		}
+
+		for ( read = nfs->reads ; read->len ; read++ ) {}
+
+		rc = nfs_read_send ( nfs, read, nfs->file_offset, len );
+		if ( rc != 0 )
+			return rc;
+
+		nfs->file_offset += len;
+	}
+
+	/* Check for completion */
+	if ( nfs->num_reads || nfs->remaining )
+		return 0;
+	if ( ! ( nfs->eof || ( nfs->size_known &&
+	                       ( nfs->file_offset >= nfs->filesize ) ) ) )
+		return 0;
+
+	DBGC ( nfs, "NFS_OPEN %p read complete\n", nfs );
+
+	intf_shutdown ( &nfs->nfs_intf, 0 );
+	nfs->nfs_state = NFS_CLOSED;
+	nfs->mount_state++;
+	nfs_mount_step ( nfs );
+
+	return 0;
+}
+
 static void nfs_step ( struct nfs_request *nfs ) {
 	int     rc;
 	char    *path_component;
 
+	if ( nfs->nfs_state == NFS_READ ) {
+		rc = nfs_read_step ( nfs );
+		if ( rc != 0 )
+			goto err;
+
+		return;
+	}
+
 	if ( ! xfer_window ( &nfs->nfs_intf ) )
 		return;
 
+	if ( nfs->nfs_state == NFS_FSINFO ) {
+		DBGC ( nfs, "NFS_OPEN %p FSINFO call\n", nfs );
+
+		rc = nfs_fsinfo ( &nfs->nfs_intf, &nfs->nfs_session,
+		                  &nfs->current_fh );
+		if ( rc != 0 )
+			goto err;
+
+		nfs->nfs_state++;
+		return;
+	}
+
 	if ( nfs->nfs_state == NFS_LOOKUP ) {
 		path_component = nfs_uri_next_path_component ( &nfs->uri );
 
@@ -399,36 +571,163 @@ static void nfs_step ( struct nfs_request *nfs ) {
 		return;
 	}
 
-	if ( nfs->nfs_state == NFS_READ ) {
-		DBGC ( nfs, "NFS_OPEN %p READ call\n", nfs );
+	return;
+err:
+	nfs_done ( nfs, rc );
+}
+
+/**
+ * Pass received READ data to the data transfer interface
+ *
+ * @v nfs		NFS request
+ * @v io_buf		I/O buffer
+ * @ret rc		Return status code
+ */
+static int nfs_read_data ( struct nfs_request *nfs,
+                           struct io_buffer *io_buf ) {
+	struct xfer_metadata    meta;
+	size_t                  len = iob_len ( io_buf );
+
+	DBGC2 ( nfs, "NFS_OPEN %p got %zd bytes at %#llx\n", nfs, len,
+		( ( unsigned long long ) nfs->rx_offset ) );
+
+	/* Replies may complete out of order, so use absolute offsets */
+	memset ( &meta, 0, sizeof ( meta ) );
+	meta.flags  = XFER_FL_ABS_OFFSET;
+	meta.offset = nfs->rx_offset;
 
-		rc = nfs_read ( &nfs->nfs_intf, &nfs->nfs_session,
-		                &nfs->current_fh, nfs->file_offset,
-		                NFS_RSIZE );
+	nfs->rx_offset += len;
+	nfs->remaining -= len;
+
+	return xfer_deliver ( &nfs->xfer, io_buf, &meta );
+}
+
+/**
+ * Handle NFS READ reply
+ *
+ * @v nfs		NFS request
+ * @v reply		ONC RPC reply
+ * @ret rc		Return status code
+ */
+static int nfs_read_reply ( struct nfs_request *nfs,
+                            struct oncrpc_reply *reply ) {
+	struct nfs_read_reply   read_reply;
+	struct nfs_read_request *read;
+	struct io_buffer        *io_buf = reply->data;
+	uint64_t                offset;
+	uint32_t                len;
+	unsigned int            i;
+	int                     rc;
+
+	/* Identify READ request */
+	for ( i = 0 ; i < NFS_MAX_READS ; i++ ) {
+		read = &nfs->reads[i];
+		if ( read->len && ( read->xid == reply->rpc_id ) )
+			break;
+	}
+	if ( i == NFS_MAX_READS ) {
+		DBGC ( nfs, "NFS_OPEN %p unexpected reply %#08x\n",
+		       nfs, reply->rpc_id );
+		return 0;
+	}
+	offset = read->offset;
+	len = read->len;
+	read->len = 0;
+	nfs->num_reads--;
+
+	/* Parse reply */
+	if ( reply->accept_state != 0 )
+		return -EPROTO;
+	rc = nfs_get_read_reply ( &read_reply, reply );
+	if ( rc != 0 )
+		return rc;
+	if ( ( read_reply.count > len ) ||
+	     ( read_reply.count > ( iob_len ( io_buf ) +
+	                            nfs->rx_remaining ) ) )
+		return -EPROTO;
+
+	DBGC2 ( nfs, "NFS_OPEN %p got READ reply (%#llx+%#x%s)\n", nfs,
+		( ( unsigned long long ) offset ), read_reply.count,
+		( read_reply.eof ? ", EOF" : "" ) );
+
+	/* Reissue remainder of any short read */
+	if ( read_reply.eof ) {
+		nfs->eof = 1;
+	} else if ( read_reply.count < len ) {
+		if ( ! read_reply.count )
+			return -EPROTO;
+		rc = nfs_read_send ( nfs, read, ( offset + read_reply.count ),
+		                     ( len - read_reply.count ) );
 		if ( rc != 0 )
-			goto err;
+			return rc;
+	}
 
-		nfs->nfs_state++;
-		return;
+	/* Pass through any data already received */
+	nfs->rx_offset = offset;
+	nfs->remaining = read_reply.count;
+	if ( iob_len ( io_buf ) > nfs->remaining )
+		iob_unput ( io_buf, ( iob_len ( io_buf ) - nfs->remaining ) );
+	if ( iob_len ( io_buf ) ) {
+		rc = nfs_read_data ( nfs, iob_disown ( reply->data ) );
+		if ( rc != 0 )
+			return rc;
 	}
 
-	return;
-err:
-	nfs_done ( nfs, rc );
+	return 0;
 }
 
-static int nfs_deliver ( struct nfs_request *nfs,
-                         struct io_buffer *io_buf,
-                         struct xfer_metadata *meta __unused ) {
+/**
+ * Handle NFS reply
+ *
+ * @v nfs		NFS request
+ * @v io_buf		I/O buffer containing (at least the start of) reply
+ * @ret rc		Return status code
+ */
+static int nfs_reply ( struct nfs_request *nfs, struct io_buffer *io_buf ) {
 	int                     rc;
 	struct oncrpc_reply     reply;
 
-	if ( nfs->remaining == 0 ) {
-		oncrpc_get_reply ( &nfs->nfs_session, &reply, io_buf );
-		if ( reply.accept_state != 0 ) {
-			rc = -EPROTO;
-			goto err;
+	rc = oncrpc_get_reply ( &nfs->nfs_session, &reply, io_buf );
+	if ( rc != 0 )
+		goto done;
+
+	if ( nfs->nfs_state == NFS_READ ) {
+		rc = nfs_read_reply ( nfs, &reply );
+		io_buf = reply.data;
+		goto done;
+	}
+
+	if ( reply.rpc_id != nfs->nfs_session.rpc_id ) {
+		DBGC ( nfs, "NFS_OPEN %p unexpected reply %#08x\n",
+		       nfs, reply.rpc_id );
+		goto done;
+	}
+
+	if ( nfs->nfs_state == NFS_FSINFO_SENT ) {
+		struct nfs_fsinfo_reply fsinfo_reply;
+
+		DBGC ( nfs, "NFS_OPEN %p got FSINFO reply\n", nfs );
+
+		/* Failure is not fatal: fall back to the default size */
+		nfs->rsize = NFS_DEFAULT_RSIZE;
+		if ( ( reply.accept_state == 0 ) &&
+		     ( nfs_get_fsinfo_reply ( &fsinfo_reply, &reply ) == 0 ) &&
+		     fsinfo_reply.rtmax ) {
+			nfs->rsize = fsinfo_reply.rtmax;
+			if ( nfs->rsize > NFS_MAX_RSIZE )
+				nfs->rsize = NFS_MAX_RSIZE;
 		}
+		DBGC ( nfs, "NFS_OPEN %p using READ size %d\n",
+		       nfs, nfs->rsize );
+
+		nfs->nfs_state = NFS_LOOKUP;
+		nfs_step ( nfs );
+		goto done;
+	}
+
+	if ( reply.accept_state != 0 ) {
+		rc = -EPROTO;
+		goto done;
 	}
 
 	if ( nfs->nfs_state == NFS_LOOKUP_SENT ) {
@@ -438,18 +737,29 @@ static int nfs_deliver ( struct nfs_request *nfs,
 
 		rc = nfs_get_lookup_reply ( &lookup_reply, &reply );
 		if ( rc != 0 )
-			goto err;
+			goto done;
 
-		if ( lookup_reply.ent_type == NFS_ATTR_SYMLINK ) {
+		if ( lookup_reply.attributes &&
+		     ( lookup_reply.ent_type == NFS_ATTR_SYMLINK ) ) {
 			nfs->readlink_fh = lookup_reply.fh;
 			nfs->nfs_state   = NFS_READLINK;
 		} else {
 			nfs->current_fh = lookup_reply.fh;
 
-			if ( nfs->uri.lookup_pos[0] == '\0' )
-				nfs->nfs_state = NFS_READ;
-			else
+			if ( nfs->uri.lookup_pos[0] != '\0' ) {
 				nfs->nfs_state--;
+			} else {
+				nfs->nfs_state = NFS_READ;
+				if ( lookup_reply.attributes ) {
+					DBGC2 ( nfs, "NFS_OPEN %p size: %llu "
+					        "bytes\n", nfs,
+					        lookup_reply.filesize );
+					nfs->filesize = lookup_reply.filesize;
+					nfs->size_known = 1;
+					xfer_presize ( &nfs->xfer,
+						       nfs->filesize );
+				}
+			}
 		}
 
 		nfs_step ( nfs );
@@ -464,19 +774,19 @@ static int nfs_deliver ( struct nfs_request *nfs,
 
 		rc = nfs_get_readlink_reply ( &readlink_reply, &reply );
 		if ( rc != 0 )
-			goto err;
+			goto done;
 
 		if ( readlink_reply.path_len == 0 )
 		{
 			rc = -EINVAL;
-			goto err;
+			goto done;
 		}
 
 		if ( ! ( path = strndup ( readlink_reply.path,
 		                          readlink_reply.path_len ) ) )
 		{
 			rc = -ENOMEM;
-			goto err;
+			goto done;
 		}
 
 		nfs_uri_symlink ( &nfs->uri, path );
@@ -490,62 +800,122 @@ static int nfs_deliver ( struct nfs_request *nfs,
 		goto done;
 	}
 
-	if ( nfs->nfs_state == NFS_READ_SENT ) {
-		if ( nfs->remaining == 0 ) {
-			DBGC ( nfs, "NFS_OPEN %p got READ reply\n", nfs );
-
-			struct nfs_read_reply read_reply;
-
-			rc = nfs_get_read_reply ( &read_reply, &reply );
-			if ( rc != 0 )
-				goto err;
-
-			if ( nfs->file_offset == 0 ) {
-				DBGC2 ( nfs, "NFS_OPEN %p size: %llu bytes\n",
-				        nfs, read_reply.filesize );
-
-				xfer_seek ( &nfs->xfer, read_reply.filesize );
-				xfer_seek ( &nfs->xfer, 0 );
-			}
-
-			nfs->file_offset += read_reply.count;
-			nfs->remaining    = read_reply.count;
-			nfs->eof          = read_reply.eof;
-		}
+	rc = -EPROTO;
+done:
+	free_iob ( io_buf );
+	return rc;
+}
 
-		size_t len = iob_len ( io_buf );
-		if ( len > nfs->remaining )
-			iob_unput ( io_buf, len - nfs->remaining );
+/**
+ * Receive start of NFS reply
+ *
+ * @v nfs		NFS request
+ * @v io_buf		I/O buffer
+ * @ret rc		Return status code
+ *
+ * Replies are buffered until complete, except for READ replies (for
+ * which only the header and the start of the data are buffered).
+ */
+static int nfs_rx ( struct nfs_request *nfs, struct io_buffer *io_buf ) {
+	struct io_buffer        *rx;
+	uint32_t                *mark;
+	size_t                  frame_size;
+	size_t                  len;
+
+	/* Allocate reply buffer, if applicable */
+	if ( ! nfs->rx ) {
+		nfs->rx = alloc_iob ( NFS_MAX_REPLY_LEN );
+		if ( ! nfs->rx )
+			return -ENOMEM;
+	}
+	rx = nfs->rx;
+
+	/* Buffer as much as is wanted */
+	len = ( ( nfs->rx_len ? nfs->rx_len : sizeof ( *mark ) ) -
+	        iob_len ( rx ) );
+	if ( len > iob_len ( io_buf ) )
+		len = iob_len ( io_buf );
+	memcpy ( iob_put ( rx, len ), io_buf->data, len );
+	iob_pull ( io_buf, len );
+
+	/* Parse record mark, if applicable */
+	if ( ( ! nfs->rx_len ) && ( iob_len ( rx ) == sizeof ( *mark ) ) ) {
+		mark = rx->data;
+		frame_size = GET_FRAME_SIZE ( ntohl ( *mark ) );
+		if ( frame_size < NFS_MIN_REPLY_LEN )
+			return -EPROTO;
+		nfs->rx_len = ( sizeof ( *mark ) + frame_size );
+		if ( nfs->rx_len > NFS_MAX_REPLY_LEN )
+			nfs->rx_len = NFS_MAX_REPLY_LEN;
+		nfs->rx_remaining = ( sizeof ( *mark ) + frame_size -
+		                      nfs->rx_len );
+	}
 
-		nfs->remaining -= iob_len ( io_buf );
+	/* Wait for rest of buffered portion of reply */
+	if ( ( ! nfs->rx_len ) || ( iob_len ( rx ) < nfs->rx_len ) )
+		return 0;
 
-		DBGC ( nfs, "NFS_OPEN %p got %zd bytes\n", nfs,
-		       iob_len ( io_buf ) );
+	/* Handle reply */
+	nfs->rx = NULL;
+	nfs->rx_len = 0;
+	return nfs_reply ( nfs, rx );
+}
 
-		rc = xfer_deliver_iob ( &nfs->xfer, iob_disown ( io_buf ) );
-		if ( rc != 0 )
-			goto err;
+static int nfs_deliver ( struct nfs_request *nfs,
+                         struct io_buffer *io_buf,
+                         struct xfer_metadata *meta __unused ) {
+	struct io_buffer        *data;
+	size_t                  len;
+	int                     rc;
 
-		if ( nfs->remaining == 0 ) {
-			if ( ! nfs->eof ) {
-				nfs->nfs_state--;
-				nfs_step ( nfs );
+	while ( io_buf && iob_len ( io_buf ) &&
+	        ( nfs->nfs_state != NFS_CLOSED ) ) {
+
+		/* Pass through READ data */
+		if ( nfs->remaining ) {
+			len = iob_len ( io_buf );
+			if ( len > nfs->remaining )
+				len = nfs->remaining;
+			nfs->rx_remaining -= len;
+			if ( len == iob_len ( io_buf ) ) {
+				data = iob_disown ( io_buf );
 			} else {
-				intf_shutdown ( &nfs->nfs_intf, 0 );
-				nfs->nfs_state++;
-				nfs->mount_state++;
-				nfs_mount_step ( nfs );
+				data = alloc_iob ( len );
+				if ( ! data ) {
+					rc = -ENOMEM;
+					goto err;
+				}
+				memcpy ( iob_put ( data, len ), io_buf->data,
+				         len );
+				iob_pull ( io_buf, len );
 			}
+			if ( ( rc = nfs_read_data ( nfs, data ) ) != 0 )
+				goto err;
+			continue;
 		}
 
-		return 0;
+		/* Discard remainder of a partially buffered reply */
+		if ( nfs->rx_remaining && ( ! nfs->rx ) ) {
+			len = iob_len ( io_buf );
+			if ( len > nfs->rx_remaining )
+				len = nfs->rx_remaining;
+			iob_pull ( io_buf, len );
+			nfs->rx_remaining -= len;
+			continue;
+		}
+
+		/* Receive start of next reply */
+		if ( ( rc = nfs_rx ( nfs, io_buf ) ) != 0 )
+			goto err;
 	}
 
-	rc = -EPROTO;
+	free_iob ( io_buf );
+	nfs_step ( nfs );
+	return 0;
+
 err:
-	nfs_done ( nfs, rc );
-done:
 	free_iob ( io_buf );
+	nfs_done ( nfs, rc );
 	return 0;
 }
 
@@ -93,6 +93,63 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 	  "</soap:Body>"						      \
 	"</soap:Envelope>"
 
+/** Discovery response format */
+#define PEERDIST_DISCOVERY_RESPONSE					      \
+	"<?xml version=\"1.0\" encoding=\"utf-8\"?>"			      \
+	"<soap:Envelope "						      \
+	    "xmlns:soap=\"http://www.w3.org/2003/05/soap-envelope\" "	      \
+	    "xmlns:wsa=\"http://schemas.xmlsoap.org/ws/2004/08/addressing\" " \
+	    "xmlns:wsd=\"http://schemas.xmlsoap.org/ws/2005/04/discovery\" "  \
+	    "xmlns:PeerDist=\"http://schemas.microsoft.com/p2p/"	      \
+			     "2007/09/PeerDistributionDiscovery\">"	      \
+	  "<soap:Header>"						      \
+	    "<wsa:To>"							      \
+	      "http://schemas.xmlsoap.org/ws/2004/08/addressing/role/"	      \
+	      "anonymous"						      \
+	    "</wsa:To>"							      \
+	    "<wsa:Action>"						      \
+	      "http://schemas.xmlsoap.org/ws/2005/04/discovery/ProbeMatches"  \
+	    "</wsa:Action>"						      \
+	    "<wsa:MessageID>"						      \
+	      "urn:uuid:%s"						      \
+	    "</wsa:MessageID>"						      \
+	    "<wsa:RelatesTo>"						      \
+	      "%s"							      \
+	    "</wsa:RelatesTo>"						      \
+	  "</soap:Header>"						      \
+	  "<soap:Body>"							      \
+	    "<wsd:ProbeMatches>"					      \
+	      "<wsd:ProbeMatch>"					      \
+		"<wsa:EndpointReference>"				      \
+		  "<wsa:Address>"					      \
+		    "urn:uuid:%s"					      \
+		  "</wsa:Address>"					      \
+		"</wsa:EndpointReference>"				      \
+		"<wsd:Types>"						      \
+		  "PeerDist:PeerDistData"				      \
+		"</wsd:Types>"						      \
+		"<wsd:Scopes>"						      \
+		  "%s"							      \
+		"</wsd:Scopes>"						      \
+		"<wsd:XAddrs>"						      \
+		  "%s"							      \
+		"</wsd:XAddrs>"						      \
+		"<wsd:MetadataVersion>"					      \
+		  "1"							      \
+		"</wsd:MetadataVersion>"				      \
+		"<PeerDist:PeerDistData>"				      \
+		  "<PeerDist:BlockCount>"				      \
+		    "%s"						      \
+		  "</PeerDist:BlockCount>"				      \
+		"</PeerDist:PeerDistData>"				      \
+	      "</wsd:ProbeMatch>"					      \
+	    "</wsd:ProbeMatches>"					      \
+	  "</soap:Body>"						      \
+	"</soap:Envelope>"
+
+/** Discovery probe type */
+#define PEERDIST_DISCOVERY_TYPE "PeerDist:PeerDistData"
+
 /**
  * Construct discovery request
  *
@@ -115,6 +172,34 @@ char * peerdist_discovery_request ( const char *uuid, const char *id ) {
 	return request;
 }
 
+/**
+ * Construct discovery response
+ *
+ * @v uuid		Message UUID string
+ * @v relates		Message ID of discovery request
+ * @v ids		Space-separated list of segment identifier strings
+ * @v counts		Concatenated list of eight-digit hex block counts
+ * @v location		Peer location
+ * @ret response	Discovery response, or NULL on failure
+ *
+ * The response is dynamically allocated; the caller must eventually
+ * free() the response.
+ */
+char * peerdist_discovery_response ( const char *uuid, const char *relates,
+				     const char *ids, const char *counts,
+				     const char *location ) {
+	char *response;
+	int len;
+
+	/* Construct response */
+	len = asprintf ( &response, PEERDIST_DISCOVERY_RESPONSE, uuid,
+			 relates, uuid, ids, location, counts );
+	if ( len < 0 )
+		return NULL;
+
+	return response;
+}
+
 /**
  * Locate discovery reply tag
  *
@@ -157,6 +242,7 @@ static char * peerdist_discovery_reply_tag ( char *data, size_t len,
 static char * peerdist_discovery_reply_values ( char *data, size_t len,
 						const char *name ) {
 	char buf[ 2 /* "</" */ + strlen ( name ) + 1 /* ">" */ + 1 /* NUL */ ];
+	size_t tag_len;
 	char *open;
 	char *close;
 	char *start;
@@ -165,12 +251,20 @@ static char * peerdist_discovery_reply_values ( char *data, size_t len,
 	char *out;
 	char c;
 
-	/* Locate opening tag */
-	snprintf ( buf, sizeof ( buf ), "<%s>", name );
-	open = peerdist_discovery_reply_tag ( data, len, buf );
-	if ( ! open )
+	/* Locate opening tag, which may include attributes */
+	snprintf ( buf, sizeof ( buf ), "<%s", name );
+	tag_len = strlen ( buf );
+	do {
+		open = peerdist_discovery_reply_tag ( data, len, buf );
+		if ( ! open )
+			return NULL;
+		len -= ( open + tag_len - data );
+		data = ( open + tag_len );
+	} while ( ! ( len && ( ( *data == '>' ) || isspace ( *data ) ) ) );
+	start = memchr ( data, '>', len );
+	if ( ! start )
 		return NULL;
-	start = ( open + strlen ( buf ) );
+	start++;
 	len -= ( start - data );
 	data = start;
 
@@ -284,3 +378,64 @@ int peerdist_discovery_reply ( char *data, size_t len,
 
 	return 0;
 }
+
+/**
+ * Parse discovery probe
+ *
+ * @v data		Probe data (not NUL-terminated, will be modified)
+ * @v len		Length of probe data
+ * @v probe		Discovery probe to fill in
+ * @ret rc		Return status code
+ *
+ * The discovery probe includes pointers to strings within the
+ * modified probe data.  Probes for anything other than PeerDist
+ * content (e.g. the WS-Discovery probes used to locate printers,
+ * which share the same multicast group) are rejected.
+ */
+int peerdist_discovery_probe ( char *data, size_t len,
+			       struct peerdist_discovery_probe *probe ) {
+	char *types;
+	char *type;
+	char *message;
+	char *scopes;
+
+	/* Find <wsd:Types> tag */
+	types = peerdist_discovery_reply_values ( data, len, "wsd:Types" );
+	if ( ! types ) {
+		DBGC ( probe, "PCCRD %p missing <wsd:Types> tag\n", probe );
+		return -ENOENT;
+	}
+
+	/* Check for PeerDist type */
+	for ( type = types ; *type ; type += ( strlen ( type ) + 1 ) ) {
+		if ( strcmp ( type, PEERDIST_DISCOVERY_TYPE ) == 0 )
+			break;
+	}
+	if ( ! *type ) {
+		DBGC2 ( probe, "PCCRD %p ignoring non-PeerDist probe\n",
+			probe );
+		return -ENOTTY;
+	}
+
+	/* Find <wsa:MessageID> tag */
+	message = peerdist_discovery_reply_values ( data, len,
+						    "wsa:MessageID" );
+	if ( ! message ) {
+		DBGC ( probe, "PCCRD %p missing <wsa:MessageID> tag\n",
+		       probe );
+		return -ENOENT;
+	}
+
+	/* Find <wsd:Scopes> tag */
+	scopes = peerdist_discovery_reply_values ( data, len, "wsd:Scopes" );
+	if ( ! scopes ) {
+		DBGC ( probe, "PCCRD %p missing <wsd:Scopes> tag\n", probe );
+		return -ENOENT;
+	}
+
+	/* Fill in discovery probe */
+	probe->message = message;
+	probe->ids = scopes;
+
+	return 0;
+}
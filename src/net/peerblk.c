@@ -43,10 +43,16 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 
 /** PeerDist decryption chunksize
+ *
+ * Each step of the decryption process reads, decrypts, digests and
+ * writes back one chunk.  Larger chunks amortise the per-step
+ * overhead (and allow the accelerated digest algorithms to process
+ * long runs of complete blocks), while smaller chunks allow other
+ * block downloads to make progress between steps.
  *
  * This is a policy decision.
  */
-#define PEERBLK_DECRYPT_CHUNKSIZE 2048
+#define PEERBLK_DECRYPT_CHUNKSIZE 8192
 
 /** PeerDist raw block download attempt initial progress timeout
  *
@@ -72,6 +78,23 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 #define PEERBLK_RETRIEVAL_RX_TIMEOUT ( 5 * TICKS_PER_SEC )
 
+/** PeerDist retrieval protocol minimum initial progress timeout
+ *
+ * For a peer with a measured response time, the initial progress
+ * timeout is reduced to a multiple of the response time (subject to
+ * this minimum), so that a slow peer is abandoned quickly in favour
+ * of the next best peer or the origin server.
+ *
+ * This is a policy decision.
+ */
+#define PEERBLK_RETRIEVAL_MIN_OPEN_TIMEOUT ( TICKS_PER_SEC / 4 )
+
+/** PeerDist retrieval protocol response time multiplier
+ *
+ * This is a policy decision.
+ */
+#define PEERBLK_RETRIEVAL_RTT_MULTIPLIER 8
+
 /** PeerDist maximum number of full download attempt cycles
  *
  * This is the maximum number of times that we will try a full cycle
@@ -132,6 +155,8 @@ static void peerblk_free ( struct refcnt *refcnt ) {
 		container_of ( refcnt, struct peerdist_block, refcnt );
 
 	uri_put ( peerblk->uri );
+	bitmap_free ( &peerblk->tried );
+	free ( peerblk->chunk );
 	free ( peerblk->cipherctx );
 	free ( peerblk );
 }
@@ -164,6 +189,10 @@ static void peerblk_reset ( struct peerdist_block *peerblk, int rc ) {
 	peerblk->cipherctx = NULL;
 	peerblk->cipher = NULL;
 
+	/* Free decryption chunk buffer */
+	free ( peerblk->chunk );
+	peerblk->chunk = NULL;
+
 	/* Reset trim thresholds */
 	peerblk->start = ( peerblk->trim.start - peerblk->range.start );
 	peerblk->end = ( peerblk->trim.end - peerblk->range.start );
@@ -195,6 +224,21 @@ static void peerblk_close ( struct peerdist_block *peerblk, int rc ) {
 	intf_shutdown ( &peerblk->xfer, rc );
 }
 
+/**
+ * Get peer used for current retrieval protocol download attempt
+ *
+ * @v peerblk		PeerDist block download
+ * @ret peer		PeerDist discovery peer, or NULL if not applicable
+ */
+static struct peerdisc_peer * peerblk_peer ( struct peerdist_block *peerblk ) {
+	struct peerdisc_segment *segment = peerblk->discovery.segment;
+	struct peerdisc_peer *head;
+
+	/* The list head is used to indicate a raw download attempt */
+	head = list_entry ( &segment->peers, struct peerdisc_peer, list );
+	return ( ( peerblk->peer == head ) ? NULL : peerblk->peer );
+}
+
 /**
  * Calculate offset within overall download
  *
@@ -270,8 +314,10 @@ static int peerblk_deliver ( struct peerdist_block *peerblk,
  */
 static void peerblk_done ( struct peerdist_block *peerblk, int rc ) {
 	struct digest_algorithm *digest = peerblk->digest;
+	struct peerdisc_peer *peer = peerblk_peer ( peerblk );
 	uint8_t hash[digest->digestsize];
 	unsigned long now = peerblk_timestamp();
+	unsigned long elapsed;
 
 	/* Check for errors on completion */
 	if ( rc != 0 ) {
@@ -296,6 +342,15 @@ static void peerblk_done ( struct peerdist_block *peerblk, int rc ) {
 	profile_custom ( &peerblk_attempt_success_profiler,
 			 ( now - peerblk->attempted ) );
 
+	/* Record peer statistics, if applicable */
+	if ( peer ) {
+		elapsed = ( currticks() - peerblk->requested - peerblk->rtt );
+		if ( ! elapsed )
+			elapsed = 1;
+		peerdisc_succeeded ( peer, peerblk->rtt,
+				     ( peerblk->pos / elapsed ) );
+	}
+
 	/* Close download */
 	peerblk_close ( peerblk, 0 );
 	return;
@@ -304,6 +359,8 @@ static void peerblk_done ( struct peerdist_block *peerblk, int rc ) {
 	/* Record failure reason and schedule a retry attempt */
 	profile_custom ( &peerblk_attempt_failure_profiler,
 			 ( now - peerblk->attempted ) );
+	if ( peer )
+		peerdisc_failed ( peer );
 	peerblk_reset ( peerblk, rc );
 	peerblk->rc = rc;
 	start_timer_nodelay ( &peerblk->timer );
@@ -336,7 +393,7 @@ static int peerblk_raw_open ( struct peerdist_block *peerblk ) {
 
 	/* Initiate range request to retrieve block */
 	if ( ( rc = http_open ( &peerblk->raw, &http_get, peerblk->uri,
-				&range, NULL ) ) != 0 ) {
+				&range, NULL, NULL ) ) != 0 ) {
 		DBGC ( peerblk, "PEERBLK %p %d.%d could not create range "
 		       "request: %s\n", peerblk, peerblk->segment,
 		       peerblk->block, strerror ( rc ) );
@@ -500,7 +557,7 @@ static int peerblk_retrieval_open ( struct peerdist_block *peerblk,
 
 	/* Initiate HTTP POST to retrieve block */
 	if ( ( rc = http_open ( &peerblk->retrieval, &http_post, uri,
-				NULL, &content ) ) != 0 ) {
+				NULL, &content, NULL ) ) != 0 ) {
 		DBGC ( peerblk, "PEERBLK %p %d.%d could not create retrieval "
 		       "request: %s\n", peerblk, peerblk->segment,
 		       peerblk->block, strerror ( rc ) );
@@ -571,6 +628,10 @@ static int peerblk_retrieval_rx ( struct peerdist_block *peerblk,
 	start += meta->offset;
 	end = ( start + len );
 
+	/* Record response time */
+	if ( ! peerblk->pos )
+		peerblk->rtt = ( currticks() - peerblk->requested );
+
 	/* Buffer any data before the trimmed content */
 	if ( ( start < peerblk->start ) && ( len > 0 ) ) {
 
@@ -1001,12 +1062,15 @@ static void peerblk_decrypt ( struct peerdist_block *peerblk ) {
 		digest_len = peerblk->digest_remaining;
 	assert ( ( cipher_len & ( cipher->blocksize - 1 ) ) == 0 );
 
-	/* Allocate temporary data buffer */
-	data = malloc ( cipher_len );
-	if ( ! data ) {
-		rc = -ENOMEM;
-		goto err_alloc_data;
+	/* Allocate chunk buffer, if not already allocated */
+	if ( ! peerblk->chunk ) {
+		peerblk->chunk = malloc ( PEERBLK_DECRYPT_CHUNKSIZE );
+		if ( ! peerblk->chunk ) {
+			rc = -ENOMEM;
+			goto err_alloc_data;
+		}
 	}
+	data = peerblk->chunk;
 
 	/* Read ciphertext */
 	if ( ( rc = peerblk_decrypt_read ( peerblk, data, cipher_len ) ) != 0 ){
@@ -1034,9 +1098,6 @@ static void peerblk_decrypt ( struct peerdist_block *peerblk ) {
 	peerblk->cipher_remaining -= cipher_len;
 	peerblk->digest_remaining -= digest_len;
 
-	/* Free temporary data buffer */
-	free ( data );
-
 	/* Continue processing until all input is consumed */
 	if ( peerblk->cipher_remaining )
 		return;
@@ -1047,7 +1108,6 @@ static void peerblk_decrypt ( struct peerdist_block *peerblk ) {
 
  err_write:
  err_read:
-	free ( data );
  err_alloc_data:
  err_xfer_buffer:
 	peerblk_done ( peerblk, rc );
@@ -1124,6 +1184,60 @@ static void peerblk_retrieval_close ( struct peerdist_block *peerblk, int rc ) {
  ******************************************************************************
  */
 
+/**
+ * Select next peer for retrieval protocol download attempt
+ *
+ * @v peerblk		PeerDist block download
+ * @ret peer		PeerDist discovery peer, or NULL if none remaining
+ *
+ * Peers that have not yet been attempted during this attempt cycle
+ * are ranked by their number of consecutive failures and then by
+ * their estimated retrieval time.  Peers without any measurements
+ * are ranked ahead of measured peers (with the same number of
+ * failures), in order that their performance may be measured.
+ */
+static struct peerdisc_peer * peerblk_select ( struct peerdist_block *peerblk ){
+	struct peerdisc_segment *segment = peerblk->discovery.segment;
+	size_t len = ( peerblk->range.end - peerblk->range.start );
+	struct peerdisc_peer *peer;
+	struct peerdisc_peer *best = NULL;
+
+	list_for_each_entry ( peer, &segment->peers, list ) {
+		if ( bitmap_test ( &peerblk->tried, peer->index ) )
+			continue;
+		if ( best && ( ( peer->failures > best->failures ) ||
+			       ( ( peer->failures == best->failures ) &&
+				 ( peerdisc_cost ( peer, len ) >=
+				   peerdisc_cost ( best, len ) ) ) ) )
+			continue;
+		best = peer;
+	}
+
+	return best;
+}
+
+/**
+ * Calculate initial progress timeout for retrieval protocol attempt
+ *
+ * @v peer		PeerDist discovery peer
+ * @ret timeout		Timeout (in ticks)
+ */
+static unsigned long peerblk_retrieval_timeout ( struct peerdisc_peer *peer ) {
+	unsigned long timeout;
+
+	/* Use default timeout unless response time has been measured */
+	if ( ! peer->rate )
+		return PEERBLK_RETRIEVAL_OPEN_TIMEOUT;
+
+	/* Scale timeout to measured response time */
+	timeout = ( PEERBLK_RETRIEVAL_RTT_MULTIPLIER * peer->rtt );
+	if ( timeout < PEERBLK_RETRIEVAL_MIN_OPEN_TIMEOUT )
+		timeout = PEERBLK_RETRIEVAL_MIN_OPEN_TIMEOUT;
+	if ( timeout > PEERBLK_RETRIEVAL_OPEN_TIMEOUT )
+		timeout = PEERBLK_RETRIEVAL_OPEN_TIMEOUT;
+	return timeout;
+}
+
 /**
  * Handle PeerDist retry timer expiry
  *
@@ -1135,6 +1249,7 @@ static void peerblk_expired ( struct retry_timer *timer, int over __unused ) {
 		container_of ( timer, struct peerdist_block, timer );
 	struct peerdisc_segment *segment = peerblk->discovery.segment;
 	struct peerdisc_peer *head;
+	struct peerdisc_peer *peer;
 	unsigned long now = peerblk_timestamp();
 	const char *location;
 	int rc;
@@ -1155,6 +1270,8 @@ static void peerblk_expired ( struct retry_timer *timer, int over __unused ) {
 		DBGC ( peerblk, "PEERBLK %p %d.%d timed out after %ld ticks\n",
 		       peerblk, peerblk->segment, peerblk->block,
 		       timer->timeout );
+		if ( ( peer = peerblk_peer ( peerblk ) ) )
+			peerdisc_failed ( peer );
 	}
 
 	/* Abort any current download attempt */
@@ -1169,24 +1286,33 @@ static void peerblk_expired ( struct retry_timer *timer, int over __unused ) {
 	 * origin server), then abort the overall download.
 	 */
 	head = list_entry ( &segment->peers, struct peerdisc_peer, list );
-	if ( ( peerblk->peer == head ) &&
-	     ( ++peerblk->cycles >= PEERBLK_MAX_ATTEMPT_CYCLES ) ) {
-		rc = peerblk->rc;
-		assert ( rc != 0 );
-		goto err;
+	if ( peerblk->peer == head ) {
+		if ( ++peerblk->cycles >= PEERBLK_MAX_ATTEMPT_CYCLES ) {
+			rc = peerblk->rc;
+			assert ( rc != 0 );
+			goto err;
+		}
+		bitmap_free ( &peerblk->tried );
+		memset ( &peerblk->tried, 0, sizeof ( peerblk->tried ) );
 	}
 
-	/* If we have not yet made any download attempts, then move to
-	 * the start of the peer list.
-	 */
-	if ( peerblk->peer == NULL )
-		peerblk->peer = head;
+	/* Attempt retrieval protocol download from best untried peer */
+	while ( ( peer = peerblk_select ( peerblk ) ) != NULL ) {
 
-	/* Attempt retrieval protocol download from next usable peer */
-	list_for_each_entry_continue ( peerblk->peer, &segment->peers, list ) {
+		/* Mark peer as attempted */
+		if ( ( peer->index >= peerblk->tried.length ) &&
+		     ( bitmap_resize ( &peerblk->tried,
+				       ( peer->index + 1 ) ) != 0 ) ) {
+			/* Non-fatal: fall back to raw download */
+			break;
+		}
+		bitmap_set ( &peerblk->tried, peer->index );
+		peerblk->peer = peer;
 
 		/* Attempt retrieval protocol download from this peer */
-		location = peerblk->peer->location;
+		location = peer->location;
+		peerblk->requested = currticks();
+		peerblk->rtt = 0;
 		if ( ( rc = peerblk_retrieval_open ( peerblk,
 						     location ) ) != 0 ) {
 			/* Non-fatal: continue to try next peer */
@@ -1196,11 +1322,12 @@ static void peerblk_expired ( struct retry_timer *timer, int over __unused ) {
 		/* Start download attempt timer */
 		peerblk->rc = -ETIMEDOUT;
 		start_timer_fixed ( &peerblk->timer,
-				    PEERBLK_RETRIEVAL_OPEN_TIMEOUT );
+				    peerblk_retrieval_timeout ( peer ) );
 		return;
 	}
 
 	/* Attempt raw download */
+	peerblk->peer = head;
 	if ( ( rc = peerblk_raw_open ( peerblk ) ) != 0 )
 		goto err;
 
@@ -337,6 +337,28 @@ static struct peerdisc_segment * peerdisc_find ( const char *id ) {
 	return NULL;
 }
 
+/**
+ * Find PeerDist peer with known statistics
+ *
+ * @v location		Peer location
+ * @ret peer		PeerDist discovery peer, or NULL if not found
+ */
+static struct peerdisc_peer * peerdisc_known ( const char *location ) {
+	struct peerdisc_segment *segment;
+	struct peerdisc_peer *peer;
+
+	/* Look for a matching peer within any segment */
+	list_for_each_entry ( segment, &peerdisc_segments, list ) {
+		list_for_each_entry ( peer, &segment->peers, list ) {
+			if ( ( peer->rate || peer->failures ) &&
+			     ( strcmp ( location, peer->location ) == 0 ) )
+				return peer;
+		}
+	}
+
+	return NULL;
+}
+
 /**
  * Add discovered PeerDist peer
  *
@@ -347,8 +369,10 @@ static struct peerdisc_segment * peerdisc_find ( const char *id ) {
 static int peerdisc_discovered ( struct peerdisc_segment *segment,
 				 const char *location ) {
 	struct peerdisc_peer *peer;
+	struct peerdisc_peer *known;
 	struct peerdisc_client *peerdisc;
 	struct peerdisc_client *tmp;
+	unsigned int index = 0;
 
 	/* Ignore duplicate peers */
 	list_for_each_entry ( peer, &segment->peers, list ) {
@@ -357,6 +381,7 @@ static int peerdisc_discovered ( struct peerdisc_segment *segment,
 				segment, location );
 			return 0;
 		}
+		index++;
 	}
 	DBGC2 ( segment, "PEERDISC %p discovered %s\n", segment, location );
 
@@ -364,8 +389,17 @@ static int peerdisc_discovered ( struct peerdisc_segment *segment,
 	peer = zalloc ( sizeof ( *peer ) + strlen ( location ) + 1 /* NUL */ );
 	if ( ! peer )
 		return -ENOMEM;
+	peer->index = index;
 	strcpy ( peer->location, location );
 
+	/* Inherit statistics for this peer from any other segment */
+	known = peerdisc_known ( location );
+	if ( known ) {
+		peer->rtt = known->rtt;
+		peer->rate = known->rate;
+		peer->failures = known->failures;
+	}
+
 	/* Add to end of list of peers */
 	list_add_tail ( &peer->list, &segment->peers );
 
@@ -474,6 +508,98 @@ static void peerdisc_destroy ( struct peerdisc_segment *segment ) {
  ******************************************************************************
  */
 
+/**
+ * Record successful download attempt from PeerDist peer
+ *
+ * @v peer		PeerDist discovery peer
+ * @v rtt		Response time (in ticks)
+ * @v rate		Throughput (in bytes per tick)
+ *
+ * Statistics are updated for this peer within all segments, since
+ * the same peer will typically serve many segments of a download.
+ */
+void peerdisc_succeeded ( struct peerdisc_peer *peer, unsigned long rtt,
+			  unsigned long rate ) {
+	struct peerdisc_segment *segment;
+	struct peerdisc_peer *other;
+
+	/* Sanity check */
+	if ( ! rate )
+		rate = 1;
+
+	/* Update smoothed statistics */
+	if ( peer->rate ) {
+		rtt = ( ( ( 7 * peer->rtt ) + rtt ) / 8 );
+		rate = ( ( ( 7 * peer->rate ) + rate ) / 8 );
+		if ( ! rate )
+			rate = 1;
+	}
+	DBGC2 ( peer, "PEERDISC peer %s rtt %ld rate %ld\n",
+		peer->location, rtt, rate );
+
+	/* Apply to all segments */
+	list_for_each_entry ( segment, &peerdisc_segments, list ) {
+		list_for_each_entry ( other, &segment->peers, list ) {
+			if ( strcmp ( peer->location, other->location ) != 0 )
+				continue;
+			other->rtt = rtt;
+			other->rate = rate;
+			other->failures = 0;
+		}
+	}
+}
+
+/**
+ * Record failed download attempt from PeerDist peer
+ *
+ * @v peer		PeerDist discovery peer
+ */
+void peerdisc_failed ( struct peerdisc_peer *peer ) {
+	struct peerdisc_segment *segment;
+	struct peerdisc_peer *other;
+	unsigned int failures = ( peer->failures + 1 );
+
+	DBGC2 ( peer, "PEERDISC peer %s failures %d\n",
+		peer->location, failures );
+
+	/* Apply to all segments */
+	list_for_each_entry ( segment, &peerdisc_segments, list ) {
+		list_for_each_entry ( other, &segment->peers, list ) {
+			if ( strcmp ( peer->location, other->location ) == 0 )
+				other->failures = failures;
+		}
+	}
+}
+
+/**
+ * Count discovered PeerDist peers
+ *
+ * @v id		Segment ID
+ * @v len		Length of segment ID
+ * @ret count		Number of peers discovered for this segment
+ */
+unsigned int peerdisc_count ( const void *id, size_t len ) {
+	struct peerdisc_segment *segment;
+	struct peerdisc_peer *peer;
+	char id_string[ base16_encoded_len ( len ) + 1 /* NUL */ ];
+	char *id_chr;
+	unsigned int count = 0;
+
+	/* Construct ID string */
+	base16_encode ( id, len, id_string, sizeof ( id_string ) );
+	for ( id_chr = id_string ; *id_chr ; id_chr++ )
+		*id_chr = toupper ( *id_chr );
+
+	/* Count peers, if segment is currently being discovered */
+	segment = peerdisc_find ( id_string );
+	if ( segment ) {
+		list_for_each_entry ( peer, &segment->peers, list )
+			count++;
+	}
+
+	return count;
+}
+
 /**
  * Open PeerDist discovery client
  *
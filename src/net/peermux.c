@@ -27,8 +27,11 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <errno.h>
 #include <ipxe/uri.h>
 #include <ipxe/xferbuf.h>
+#include <ipxe/timer.h>
+#include <ipxe/peerdisc.h>
 #include <ipxe/peerblk.h>
 #include <ipxe/peermux.h>
+#include <ipxe/peerserv.h>
 
 /** @file
  *
@@ -36,6 +39,20 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
+static struct interface_descriptor peermux_block_desc;
+
+/**
+ * Serve downloaded content to other peers
+ *
+ * @v info		Content information
+ *
+ * This is a dummy implementation used when the PeerDist content
+ * server is not present.
+ */
+__weak void peerserv_add ( const struct peerdist_info *info __unused ) {
+	/* Nothing to do */
+}
+
 /**
  * Free PeerDist download multiplexer
  *
@@ -44,7 +61,13 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 static void peermux_free ( struct refcnt *refcnt ) {
 	struct peerdist_multiplexer *peermux =
 		container_of ( refcnt, struct peerdist_multiplexer, refcnt );
+	struct peerdist_multiplexed_block *peermblk;
+	struct peerdist_multiplexed_block *tmp;
 
+	list_for_each_entry_safe ( peermblk, tmp, &peermux->busy, list )
+		free ( peermblk );
+	list_for_each_entry_safe ( peermblk, tmp, &peermux->idle, list )
+		free ( peermblk );
 	uri_put ( peermux->uri );
 	xferbuf_free ( &peermux->buffer );
 	free ( peermux );
@@ -57,14 +80,16 @@ static void peermux_free ( struct refcnt *refcnt ) {
  * @v rc		Reason for close
  */
 static void peermux_close ( struct peerdist_multiplexer *peermux, int rc ) {
-	unsigned int i;
+	struct peerdist_multiplexed_block *peermblk;
 
 	/* Stop block download initiation process */
 	process_del ( &peermux->process );
 
 	/* Shut down all block downloads */
-	for ( i = 0 ; i < PEERMUX_MAX_BLOCKS ; i++ )
-		intf_shutdown ( &peermux->block[i].xfer, rc );
+	list_for_each_entry ( peermblk, &peermux->busy, list )
+		intf_shutdown ( &peermblk->xfer, rc );
+	list_for_each_entry ( peermblk, &peermux->idle, list )
+		intf_shutdown ( &peermblk->xfer, rc );
 
 	/* Shut down all other interfaces (which may be connected to
 	 * the same object).
@@ -130,14 +155,14 @@ static void peermux_info_close ( struct peerdist_multiplexer *peermux, int rc ){
 
 	/* Notify recipient of total download size */
 	len = ( info->trim.end - info->trim.start );
-	if ( ( rc = xfer_seek ( &peermux->xfer, len ) ) != 0 ) {
+	if ( ( rc = xfer_presize ( &peermux->xfer, len ) ) != 0 ) {
 		DBGC ( peermux, "PEERMUX %p could not presize buffer: %s\n",
 		       peermux, strerror ( rc ) );
 		goto err;
 	}
-	xfer_seek ( &peermux->xfer, 0 );
 
 	/* Start block download process */
+	peermux->started = currticks();
 	process_add ( &peermux->process );
 
 	return;
@@ -146,6 +171,90 @@ static void peermux_info_close ( struct peerdist_multiplexer *peermux, int rc ){
 	peermux_close ( peermux, rc );
 }
 
+/**
+ * Get maximum number of concurrent block downloads
+ *
+ * @v peermux		PeerDist download multiplexer
+ * @ret limit		Maximum number of concurrent block downloads
+ *
+ * The limit is the lower of the adaptive limit (as adjusted according
+ * to measured throughput) and a ceiling determined by the number of
+ * available sources.  Peers for a new segment will not be known until
+ * discovery has completed, so the highest number of peers seen for
+ * any segment is used.
+ */
+static unsigned int peermux_limit ( struct peerdist_multiplexer *peermux ) {
+	struct peerdist_info_segment *segment = &peermux->cache.segment;
+	unsigned int peers;
+	unsigned int max;
+
+	/* Update number of discovered peers */
+	if ( segment->info ) {
+		peers = peerdisc_count ( segment->id,
+					 segment->info->digestsize );
+		if ( peers > peermux->peers ) {
+			DBGC ( peermux, "PEERMUX %p discovered %d peers\n",
+			       peermux, peers );
+			peermux->peers = peers;
+		}
+	}
+
+	/* Calculate ceiling based on number of sources */
+	max = PEERMUX_MAX_BLOCKS;
+	if ( peermux->peers < ( PEERMUX_MAX_BLOCKS /
+				PEERMUX_BLOCKS_PER_SOURCE ) ) {
+		max = ( ( peermux->peers + 1 /* origin */ ) *
+			PEERMUX_BLOCKS_PER_SOURCE );
+	}
+
+	return ( ( peermux->limit < max ) ? peermux->limit : max );
+}
+
+/**
+ * Adapt maximum number of concurrent block downloads
+ *
+ * @v peermux		PeerDist download multiplexer
+ *
+ * Throughput is measured over each round of completed blocks (i.e. as
+ * many blocks as the current limit).  The limit is increased while
+ * throughput continues to improve, and decreased if throughput
+ * deteriorates (e.g. due to congestion or overloaded peers).
+ */
+static void peermux_adapt ( struct peerdist_multiplexer *peermux ) {
+	unsigned long elapsed;
+	unsigned long rate;
+	unsigned int limit;
+
+	/* Calculate throughput for this round */
+	elapsed = ( currticks() - peermux->started );
+	if ( ! elapsed )
+		elapsed = 1;
+	rate = ( peermux->len / elapsed );
+
+	/* Adjust limit */
+	limit = peermux_limit ( peermux );
+	if ( rate > ( peermux->rate + ( peermux->rate / 8 ) ) ) {
+		limit += ( limit / 2 );
+	} else if ( rate < ( peermux->rate - ( peermux->rate / 8 ) ) ) {
+		limit -= ( limit / 4 );
+	}
+	if ( limit < PEERMUX_MIN_BLOCKS )
+		limit = PEERMUX_MIN_BLOCKS;
+	if ( limit > PEERMUX_MAX_BLOCKS )
+		limit = PEERMUX_MAX_BLOCKS;
+	if ( limit != peermux->limit ) {
+		DBGC ( peermux, "PEERMUX %p %ld bytes/tick, limit %d->%d\n",
+		       peermux, rate, peermux->limit, limit );
+	}
+	peermux->limit = limit;
+
+	/* Start next round */
+	peermux->rate = rate;
+	peermux->started = currticks();
+	peermux->len = 0;
+	peermux->completed = 0;
+}
+
 /**
  * Initiate multiplexed block download
  *
@@ -160,12 +269,32 @@ static void peermux_step ( struct peerdist_multiplexer *peermux ) {
 	unsigned int next_block;
 	int rc;
 
-	/* Stop initiation process if all block downloads are busy */
+	/* Stop initiation process if all permitted block downloads
+	 * are busy.
+	 */
+	if ( peermux->active >= peermux_limit ( peermux ) ) {
+		process_del ( &peermux->process );
+		return;
+	}
+
+	/* Use an idle block download, or allocate a new one */
 	peermblk = list_first_entry ( &peermux->idle,
 				      struct peerdist_multiplexed_block, list );
 	if ( ! peermblk ) {
-		process_del ( &peermux->process );
-		return;
+		peermblk = zalloc ( sizeof ( *peermblk ) );
+		if ( ! peermblk ) {
+			/* Retry once a busy block download completes */
+			process_del ( &peermux->process );
+			if ( ! peermux->active ) {
+				rc = -ENOMEM;
+				goto err;
+			}
+			return;
+		}
+		peermblk->peermux = peermux;
+		intf_init ( &peermblk->xfer, &peermux_block_desc,
+			    &peermux->refcnt );
+		list_add_tail ( &peermblk->list, &peermux->idle );
 	}
 
 	/* Increment block index */
@@ -185,8 +314,10 @@ static void peermux_step ( struct peerdist_multiplexer *peermux ) {
 		 */
 		if ( next_segment >= info->segments ) {
 			process_del ( &peermux->process );
-			if ( list_empty ( &peermux->busy ) )
+			if ( list_empty ( &peermux->busy ) ) {
+				peerserv_add ( info );
 				peermux_close ( peermux, 0 );
+			}
 			return;
 		}
 
@@ -227,6 +358,7 @@ static void peermux_step ( struct peerdist_multiplexer *peermux ) {
 	/* Move to list of busy block downloads */
 	list_del ( &peermblk->list );
 	list_add_tail ( &peermblk->list, &peermux->busy );
+	peermux->active++;
 
 	return;
 
@@ -252,6 +384,9 @@ static int peermux_block_deliver ( struct peerdist_multiplexed_block *peermblk,
 	 */
 	assert ( meta->flags & XFER_FL_ABS_OFFSET );
 
+	/* Record data for throughput measurement */
+	peermux->len += iob_len ( iobuf );
+
 	/* We can't use a simple passthrough interface descriptor,
 	 * since there are multiple block download interfaces.
 	 */
@@ -287,6 +422,7 @@ static void peermux_block_close ( struct peerdist_multiplexed_block *peermblk,
 	/* Move to list of idle downloads */
 	list_del ( &peermblk->list );
 	list_add_tail ( &peermblk->list, &peermux->idle );
+	peermux->active--;
 
 	/* If any error occurred, terminate the whole multiplexer */
 	if ( rc != 0 ) {
@@ -294,6 +430,10 @@ static void peermux_block_close ( struct peerdist_multiplexed_block *peermblk,
 		return;
 	}
 
+	/* Adapt concurrency limit after each round of blocks */
+	if ( ++peermux->completed >= peermux->limit )
+		peermux_adapt ( peermux );
+
 	/* Restart data transfer interface */
 	intf_restart ( &peermblk->xfer, rc );
 
@@ -354,8 +494,6 @@ static struct process_descriptor peermux_process_desc =
 int peermux_filter ( struct interface *xfer, struct interface *info,
 		     struct uri *uri ) {
 	struct peerdist_multiplexer *peermux;
-	struct peerdist_multiplexed_block *peermblk;
-	unsigned int i;
 
 	/* Allocate and initialise structure */
 	peermux = zalloc ( sizeof ( *peermux ) );
@@ -371,13 +509,7 @@ int peermux_filter ( struct interface *xfer, struct interface *info,
 			       &peermux->refcnt );
 	INIT_LIST_HEAD ( &peermux->busy );
 	INIT_LIST_HEAD ( &peermux->idle );
-	for ( i = 0 ; i < PEERMUX_MAX_BLOCKS ; i++ ) {
-		peermblk = &peermux->block[i];
-		peermblk->peermux = peermux;
-		list_add_tail ( &peermblk->list, &peermux->idle );
-		intf_init ( &peermblk->xfer, &peermux_block_desc,
-			    &peermux->refcnt );
-	}
+	peermux->limit = PEERMUX_BLOCKS_PER_SOURCE;
 
 	/* Attach to parent interfaces, mortalise self, and return */
 	intf_plug_plug ( &peermux->xfer, xfer );
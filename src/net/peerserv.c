@@ -0,0 +1,987 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <assert.h>
+#include <byteswap.h>
+#include <ipxe/refcnt.h>
+#include <ipxe/list.h>
+#include <ipxe/interface.h>
+#include <ipxe/xfer.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/open.h>
+#include <ipxe/socket.h>
+#include <ipxe/in.h>
+#include <ipxe/ip.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/tcp.h>
+#include <ipxe/retry.h>
+#include <ipxe/timer.h>
+#include <ipxe/init.h>
+#include <ipxe/uuid.h>
+#include <ipxe/base16.h>
+#include <ipxe/uaccess.h>
+#include <ipxe/image.h>
+#include <ipxe/crypto.h>
+#include <ipxe/aes.h>
+#include <ipxe/pccrc.h>
+#include <ipxe/pccrd.h>
+#include <ipxe/pccrr.h>
+#include <ipxe/peerserv.h>
+
+/** @file
+ *
+ * Peer Content Caching and Retrieval (PeerDist) protocol content server
+ *
+ * Once a PeerDist download has completed, the downloaded content may
+ * be served to other booting peers on the local network.  We respond
+ * to discovery probes for any segment that we hold, and answer block
+ * fetch requests from the content held within an image in memory.
+ *
+ * We do not retain a separate copy of the content.  Served blocks
+ * are read directly from whichever image has the expected length,
+ * and each block is verified against its hash before being served.
+ * Any image that has since been freed or modified will therefore
+ * simply cause the block to be reported as not found.
+ */
+
+/** A served content information segment */
+struct peerserv_segment {
+	/** Segment identifier */
+	uint8_t id[PEERDIST_DIGEST_MAX_SIZE];
+	/** Number of blocks held in their entirety */
+	unsigned int blocks;
+};
+
+/** A served content information entry */
+struct peerserv_content {
+	/** List of content information entries */
+	struct list_head list;
+	/** Content information
+	 *
+	 * The raw content information is copied into storage
+	 * immediately following the list of segments.
+	 */
+	struct peerdist_info info;
+	/** Segments */
+	struct peerserv_segment *segments;
+};
+
+/** A PeerDist retrieval connection */
+struct peerserv_connection {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Idle timer */
+	struct retry_timer timer;
+	/** Close connection after current response */
+	int close;
+
+	/** Content information segment */
+	struct peerdist_info_segment segment;
+	/** Content information block */
+	struct peerdist_info_block block;
+
+	/** Length of received request data */
+	size_t len;
+	/** Received request data (plus terminating NUL) */
+	char rx[ PEERSERV_MAX_REQUEST + 1 ];
+};
+
+/** A PeerDist discovery responder socket */
+struct peerserv_socket {
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Socket is open */
+	int open;
+};
+
+/** List of served content information entries (most recent first) */
+static LIST_HEAD ( peerserv_contents );
+
+/** Number of served content information entries */
+static unsigned int peerserv_count;
+
+/******************************************************************************
+ *
+ * Served content
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Free served content information entry
+ *
+ * @v content		Served content information entry
+ */
+static void peerserv_del ( struct peerserv_content *content ) {
+
+	DBGC ( content, "PEERSERV %p no longer serving content\n", content );
+	list_del ( &content->list );
+	peerserv_count--;
+	free ( content );
+}
+
+/**
+ * Find served content information segment
+ *
+ * @v id		Segment identifier
+ * @v digestsize	Length of segment identifier
+ * @v index		Segment index to fill in
+ * @ret content		Served content information entry, or NULL
+ */
+static struct peerserv_content * peerserv_find ( const void *id,
+						 size_t digestsize,
+						 unsigned int *index ) {
+	struct peerserv_content *content;
+	unsigned int i;
+
+	list_for_each_entry ( content, &peerserv_contents, list ) {
+		if ( content->info.digestsize != digestsize )
+			continue;
+		for ( i = 0 ; i < content->info.segments ; i++ ) {
+			if ( memcmp ( content->segments[i].id, id,
+				      digestsize ) == 0 ) {
+				*index = i;
+				return content;
+			}
+		}
+	}
+	return NULL;
+}
+
+/**
+ * Read and verify served block
+ *
+ * @v content		Served content information entry
+ * @v block		Content information block
+ * @v data		Data buffer to fill in
+ * @ret rc		Return status code
+ */
+static int peerserv_read ( struct peerserv_content *content,
+			   const struct peerdist_info_block *block,
+			   void *data ) {
+	struct peerdist_info *info = &content->info;
+	struct digest_algorithm *digest = info->digest;
+	uint8_t ctx[digest->ctxsize];
+	uint8_t hash[digest->digestsize];
+	size_t offset = ( block->range.start - info->trim.start );
+	size_t len = ( block->range.end - block->range.start );
+	struct image *image;
+
+	/* Try each image of the correct length */
+	for_each_image ( image ) {
+
+		/* Skip images of the wrong length */
+		if ( image->len != ( info->trim.end - info->trim.start ) )
+			continue;
+
+		/* Read and verify block */
+		copy_from_user ( data, image->data, offset, len );
+		digest_init ( digest, ctx );
+		digest_update ( digest, ctx, data, len );
+		digest_final ( digest, ctx, hash );
+		if ( memcmp ( hash, block->hash, info->digestsize ) == 0 )
+			return 0;
+	}
+
+	return -ENOENT;
+}
+
+/******************************************************************************
+ *
+ * Retrieval protocol
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Free PeerDist retrieval connection
+ *
+ * @v refcnt		Reference count
+ */
+static void peerserv_free ( struct refcnt *refcnt ) {
+	struct peerserv_connection *conn =
+		container_of ( refcnt, struct peerserv_connection, refcnt );
+
+	free ( conn );
+}
+
+/**
+ * Close PeerDist retrieval connection
+ *
+ * @v conn		PeerDist retrieval connection
+ * @v rc		Reason for close
+ */
+static void peerserv_close ( struct peerserv_connection *conn, int rc ) {
+
+	/* Stop idle timer */
+	stop_timer ( &conn->timer );
+
+	/* Shut down interfaces */
+	intf_shutdown ( &conn->xfer, rc );
+
+	DBGC ( conn, "PEERSERV %p closed: %s\n", conn, strerror ( rc ) );
+}
+
+/**
+ * Handle idle timer expiry
+ *
+ * @v timer		Idle timer
+ * @v over		Failure indicator
+ */
+static void peerserv_expired ( struct retry_timer *timer, int over __unused ) {
+	struct peerserv_connection *conn =
+		container_of ( timer, struct peerserv_connection, timer );
+
+	/* Close idle connection */
+	peerserv_close ( conn, -ETIMEDOUT );
+}
+
+/**
+ * Construct block fetch response
+ *
+ * @v conn		PeerDist retrieval connection
+ * @v body		Request body
+ * @v len		Length of request body
+ * @ret iobuf		Response, or NULL on error
+ *
+ * The response has space reserved for the HTTP response header.  A
+ * block that we do not hold is reported as a zero-length block.
+ */
+static struct io_buffer * peerserv_blk ( struct peerserv_connection *conn,
+					 const void *body, size_t len ) {
+	struct peerdist_info_segment *segment = &conn->segment;
+	struct peerdist_info_block *block = &conn->block;
+	const struct peerdist_msg_getblks *getblks = body;
+	const struct peerdist_msg_segment *reqseg =
+		( body + sizeof ( *getblks ) );
+	const struct peerdist_msg_ranges *ranges;
+	const struct peerdist_msg_range *range;
+	struct cipher_algorithm *cipher = &aes_cbc_algorithm;
+	struct {
+		struct peerdist_msg_transport_header hdr;
+		struct peerdist_msg_header msg;
+	} __attribute__ (( packed )) *rsphdr;
+	struct peerdist_msg_segment *rspseg;
+	struct peerdist_msg_block *rspblk;
+	struct peerdist_msg_useless_vrf *vrf;
+	struct peerdist_msg_iv *rspiv;
+	struct peerserv_content *content;
+	struct io_buffer *iobuf;
+	uint32_t *indices;
+	uint32_t *iv;
+	const uint8_t *id;
+	void *ctx = NULL;
+	void *data;
+	size_t digestsize;
+	size_t pad;
+	size_t data_len = 0;
+	size_t padded_len = 0;
+	unsigned int segidx;
+	unsigned int index;
+	unsigned int i;
+
+	/* Parse request */
+	if ( len < ( sizeof ( *getblks ) + sizeof ( *reqseg ) ) )
+		return NULL;
+	if ( getblks->hdr.type != htonl ( PEERDIST_MSG_GETBLKS_TYPE ) )
+		return NULL;
+	digestsize = ntohl ( reqseg->digestsize );
+	if ( ( digestsize == 0 ) || ( digestsize > PEERDIST_DIGEST_MAX_SIZE ) )
+		return NULL;
+	id = ( ( ( const void * ) reqseg ) + sizeof ( *reqseg ) );
+	pad = ( ( -digestsize ) & 0x3 );
+	ranges = ( ( ( const void * ) id ) + digestsize + pad );
+	range = ( ( ( const void * ) ranges ) + sizeof ( *ranges ) );
+	if ( len < ( sizeof ( *getblks ) + sizeof ( *reqseg ) + digestsize +
+		     pad + sizeof ( *ranges ) + sizeof ( *range ) ) )
+		return NULL;
+	if ( ntohl ( ranges->count ) == 0 )
+		return NULL;
+	index = ntohl ( range->first );
+
+	/* Identify block, if held in its entirety */
+	content = peerserv_find ( id, digestsize, &segidx );
+	if ( content &&
+	     ( peerdist_info_segment ( &content->info, segment,
+				       segidx ) == 0 ) &&
+	     ( index < segment->blocks ) &&
+	     ( peerdist_info_block ( segment, block, index ) == 0 ) &&
+	     ( block->trim.start == block->range.start ) &&
+	     ( block->trim.end == block->range.end ) ) {
+		data_len = ( block->range.end - block->range.start );
+		padded_len = ( ( data_len + cipher->blocksize - 1 ) &
+			       ~( cipher->blocksize - 1 ) );
+	}
+
+	/* Allocate response */
+	iobuf = alloc_iob ( PEERSERV_MAX_HEADER + sizeof ( *rsphdr ) +
+			    sizeof ( *rspseg ) + digestsize + pad +
+			    ( 2 * sizeof ( *indices ) ) + sizeof ( *rspblk ) +
+			    padded_len + sizeof ( *vrf ) + sizeof ( *rspiv ) +
+			    cipher->blocksize );
+	if ( ! iobuf )
+		return NULL;
+	iob_reserve ( iobuf, PEERSERV_MAX_HEADER );
+
+	/* Construct response */
+	rsphdr = iob_put ( iobuf, sizeof ( *rsphdr ) );
+	rsphdr->msg.version.raw = htonl ( PEERDIST_MSG_BLK_VERSION );
+	rsphdr->msg.type = htonl ( PEERDIST_MSG_BLK_TYPE );
+	rsphdr->msg.algorithm = htonl ( PEERDIST_MSG_AES_128_CBC );
+	rspseg = iob_put ( iobuf, sizeof ( *rspseg ) );
+	rspseg->digestsize = htonl ( digestsize );
+	memcpy ( iob_put ( iobuf, digestsize ), id, digestsize );
+	memset ( iob_put ( iobuf, pad ), 0, pad );
+	indices = iob_put ( iobuf, ( 2 * sizeof ( *indices ) ) );
+	indices[0] = htonl ( index );
+	indices[1] = htonl ( ( data_len && ( ( index + 1 ) < segment->blocks ) ) ?
+			     ( index + 1 ) : 0 );
+	rspblk = iob_put ( iobuf, sizeof ( *rspblk ) );
+	data = iob_put ( iobuf, padded_len );
+
+	/* Read and verify block, if applicable */
+	if ( data_len ) {
+		ctx = malloc ( cipher->ctxsize );
+		if ( ctx && ( peerserv_read ( content, block, data ) == 0 ) &&
+		     ( cipher_setkey ( cipher, ctx, segment->secret,
+				       ( 128 / 8 ) ) == 0 ) ) {
+			memset ( ( data + data_len ), 0,
+				 ( padded_len - data_len ) );
+			DBGC2 ( conn, "PEERSERV %p serving %d.%d\n",
+				conn, segidx, index );
+		} else {
+			/* Report block as not found */
+			DBGC ( conn, "PEERSERV %p could not serve %d.%d\n",
+			       conn, segidx, index );
+			iob_unput ( iobuf, padded_len );
+			padded_len = 0;
+		}
+	}
+	rspblk->len = htonl ( padded_len );
+	vrf = iob_put ( iobuf, sizeof ( *vrf ) );
+	vrf->len = 0;
+	rspiv = iob_put ( iobuf, sizeof ( *rspiv ) );
+	rspiv->blksize = htonl ( cipher->blocksize );
+	iv = iob_put ( iobuf, cipher->blocksize );
+
+	/* Generate initialisation vector.  This does not require high
+	 * quality randomness, since the key is known to anyone
+	 * holding the content information.
+	 */
+	for ( i = 0 ; i < ( cipher->blocksize / sizeof ( *iv ) ) ; i++ )
+		iv[i] = random();
+
+	/* Encrypt block, if applicable */
+	if ( padded_len ) {
+		cipher_setiv ( cipher, ctx, iv );
+		cipher_encrypt ( cipher, ctx, data, data, padded_len );
+	}
+	free ( ctx );
+
+	/* Fill in lengths */
+	rsphdr->hdr.len = htonl ( iob_len ( iobuf ) - sizeof ( rsphdr->hdr ) );
+	rsphdr->msg.len = rsphdr->hdr.len;
+
+	return iobuf;
+}
+
+/**
+ * Transmit HTTP response
+ *
+ * @v conn		PeerDist retrieval connection
+ * @v iobuf		Response body (with space reserved for header)
+ * @ret rc		Return status code
+ */
+static int peerserv_respond ( struct peerserv_connection *conn,
+			      struct io_buffer *iobuf ) {
+	char header[PEERSERV_MAX_HEADER];
+	const char *status;
+	size_t len;
+
+	/* Construct header */
+	status = ( iob_len ( iobuf ) ? "200 OK" : "404 Not Found" );
+	len = snprintf ( header, sizeof ( header ),
+			 "HTTP/1.1 %s\r\n"
+			 "Content-Length: %zd\r\n"
+			 "%s"
+			 "\r\n", status, iob_len ( iobuf ),
+			 ( conn->close ? "Connection: close\r\n" : "" ) );
+	assert ( len < sizeof ( header ) );
+	assert ( len <= iob_headroom ( iobuf ) );
+	memcpy ( iob_push ( iobuf, len ), header, len );
+
+	/* Transmit response */
+	return xfer_deliver_iob ( &conn->xfer, iobuf );
+}
+
+/**
+ * Handle HTTP request
+ *
+ * @v conn		PeerDist retrieval connection
+ * @v hdr_len		Length of request header
+ * @v body_len		Length of request body
+ * @v path		Request path (if a POST request), or NULL
+ * @ret rc		Return status code
+ */
+static int peerserv_request ( struct peerserv_connection *conn,
+			      size_t hdr_len, size_t body_len,
+			      const char *path ) {
+	struct io_buffer *iobuf = NULL;
+
+	/* Construct block fetch response, if applicable */
+	if ( path && ( strcmp ( path, PEERDIST_MAGIC_PATH ) == 0 ) )
+		iobuf = peerserv_blk ( conn, &conn->rx[hdr_len], body_len );
+
+	/* Otherwise, construct an empty (not found) response */
+	if ( ! iobuf ) {
+		iobuf = alloc_iob ( PEERSERV_MAX_HEADER );
+		if ( ! iobuf )
+			return -ENOMEM;
+		iob_reserve ( iobuf, PEERSERV_MAX_HEADER );
+	}
+
+	return peerserv_respond ( conn, iobuf );
+}
+
+/**
+ * Match HTTP header name
+ *
+ * @v line		Header line
+ * @v name		Header name (including colon)
+ * @ret value		Header value, or NULL if name does not match
+ */
+static const char * peerserv_header ( const char *line, const char *name ) {
+
+	/* Compare name (case-insensitively) */
+	for ( ; *name ; line++, name++ ) {
+		if ( toupper ( *line ) != toupper ( *name ) )
+			return NULL;
+	}
+
+	/* Skip whitespace */
+	while ( ( *line == ' ' ) || ( *line == '\t' ) )
+		line++;
+
+	return line;
+}
+
+/**
+ * Parse received HTTP requests
+ *
+ * @v conn		PeerDist retrieval connection
+ * @ret rc		Return status code
+ *
+ * Only the request line and the "Content-Length" and "Connection"
+ * headers are significant.  The connection is closed after the
+ * response if the client requests it.
+ */
+static int peerserv_parse ( struct peerserv_connection *conn ) {
+	const char *value;
+	char *end;
+	char *line;
+	char *path;
+	char *space;
+	size_t hdr_len;
+	size_t body_len;
+	size_t total;
+	int rc;
+
+	/* Process each complete request */
+	while ( 1 ) {
+
+		/* Locate end of header */
+		conn->rx[conn->len] = '\0';
+		end = strstr ( conn->rx, "\r\n\r\n" );
+		if ( ! end )
+			return 0;
+		hdr_len = ( end + 4 /* "\r\n\r\n" */ - conn->rx );
+
+		/* Parse header lines */
+		body_len = 0;
+		for ( line = strstr ( conn->rx, "\r\n" ) ; line < end ;
+		      line = strstr ( line, "\r\n" ) ) {
+			line += 2 /* "\r\n" */;
+			if ( ( value = peerserv_header ( line,
+							 "Content-Length:" ) ) )
+				body_len = strtoul ( value, NULL, 10 );
+			if ( ( value = peerserv_header ( line, "Connection:" ) ) &&
+			     ( peerserv_header ( value, "close" ) ) )
+				conn->close = 1;
+		}
+
+		/* Wait for complete body */
+		if ( body_len > ( sizeof ( conn->rx ) - 1 - hdr_len ) )
+			return -ERANGE;
+		total = ( hdr_len + body_len );
+		if ( conn->len < total )
+			return 0;
+
+		/* Parse request line */
+		path = NULL;
+		if ( strncmp ( conn->rx, "POST ", 5 ) == 0 ) {
+			path = ( conn->rx + 5 );
+			space = strchr ( path, ' ' );
+			if ( ( ! space ) || ( space > end ) )
+				return -EINVAL;
+			*space = '\0';
+		}
+
+		/* Handle request */
+		if ( ( rc = peerserv_request ( conn, hdr_len, body_len,
+					       path ) ) != 0 )
+			return rc;
+
+		/* Close connection, if applicable */
+		if ( conn->close ) {
+			peerserv_close ( conn, 0 );
+			return 0;
+		}
+
+		/* Consume request */
+		conn->len -= total;
+		memmove ( conn->rx, &conn->rx[total], conn->len );
+	}
+}
+
+/**
+ * Receive data on PeerDist retrieval connection
+ *
+ * @v conn		PeerDist retrieval connection
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int peerserv_deliver ( struct peerserv_connection *conn,
+			      struct io_buffer *iobuf,
+			      struct xfer_metadata *meta __unused ) {
+	size_t len = iob_len ( iobuf );
+	int rc;
+
+	/* Restart idle timer */
+	stop_timer ( &conn->timer );
+	start_timer_fixed ( &conn->timer, PEERSERV_IDLE_TIMEOUT );
+
+	/* Add data to request buffer */
+	if ( len > ( sizeof ( conn->rx ) - 1 - conn->len ) ) {
+		DBGC ( conn, "PEERSERV %p request too long\n", conn );
+		rc = -ERANGE;
+		goto err;
+	}
+	memcpy ( &conn->rx[conn->len], iobuf->data, len );
+	conn->len += len;
+
+	/* Parse any complete requests */
+	if ( ( rc = peerserv_parse ( conn ) ) != 0 )
+		goto err;
+
+	free_iob ( iobuf );
+	return 0;
+
+ err:
+	free_iob ( iobuf );
+	peerserv_close ( conn, rc );
+	return rc;
+}
+
+/** PeerDist retrieval connection interface operations */
+static struct interface_operation peerserv_xfer_operations[] = {
+	INTF_OP ( xfer_deliver, struct peerserv_connection *,
+		  peerserv_deliver ),
+	INTF_OP ( intf_close, struct peerserv_connection *, peerserv_close ),
+};
+
+/** PeerDist retrieval connection interface descriptor */
+static struct interface_descriptor peerserv_xfer_desc =
+	INTF_DESC ( struct peerserv_connection, xfer,
+		    peerserv_xfer_operations );
+
+/**
+ * Accept PeerDist retrieval connection
+ *
+ * @v xfer		TCP data transfer interface
+ * @v peer		Peer socket address
+ * @ret rc		Return status code
+ */
+static int peerserv_accept ( struct interface *xfer,
+			     struct sockaddr_tcpip *peer __unused ) {
+	struct peerserv_connection *conn;
+
+	/* Refuse connections unless we have content to serve */
+	if ( list_empty ( &peerserv_contents ) )
+		return -ENOENT;
+
+	/* Allocate and initialise structure */
+	conn = zalloc ( sizeof ( *conn ) );
+	if ( ! conn )
+		return -ENOMEM;
+	ref_init ( &conn->refcnt, peerserv_free );
+	intf_init ( &conn->xfer, &peerserv_xfer_desc, &conn->refcnt );
+	timer_init ( &conn->timer, peerserv_expired, &conn->refcnt );
+	start_timer_fixed ( &conn->timer, PEERSERV_IDLE_TIMEOUT );
+	DBGC ( conn, "PEERSERV %p accepted %s\n",
+	       conn, sock_ntoa ( ( struct sockaddr * ) peer ) );
+
+	/* Attach to TCP connection, and drop our reference */
+	intf_plug_plug ( &conn->xfer, xfer );
+	ref_put ( &conn->refcnt );
+	return 0;
+}
+
+/** PeerDist retrieval server */
+struct tcp_server peerserv_server __tcp_server = {
+	.name = "PeerDist",
+	.port = PEERSERV_PORT,
+	.accept = peerserv_accept,
+};
+
+/******************************************************************************
+ *
+ * Discovery protocol
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Identify local address for discovery response
+ *
+ * @v peer		Peer socket address
+ * @v address		Local address to fill in
+ * @ret rc		Return status code
+ */
+static int peerserv_address ( struct sockaddr_in *peer,
+			      struct in_addr *address ) {
+	struct ipv4_miniroute *miniroute;
+
+	/* Use address on the same subnet as the peer */
+	list_for_each_entry ( miniroute, &ipv4_miniroutes, list ) {
+		if ( ( ( miniroute->address.s_addr ^ peer->sin_addr.s_addr ) &
+		       miniroute->netmask.s_addr ) == 0 ) {
+			*address = miniroute->address;
+			return 0;
+		}
+	}
+
+	return -ENETUNREACH;
+}
+
+/**
+ * Handle received PeerDist discovery probe
+ *
+ * @v socket		PeerDist discovery responder socket
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int peerserv_discovery_rx ( struct peerserv_socket *socket,
+				   struct io_buffer *iobuf,
+				   struct xfer_metadata *meta ) {
+	struct sockaddr_in *peer = ( ( struct sockaddr_in * ) meta->src );
+	struct peerdist_discovery_probe probe;
+	struct peerserv_content *content;
+	struct xfer_metadata reply_meta;
+	struct in_addr address;
+	union {
+		union uuid uuid;
+		uint32_t dword[ sizeof ( union uuid ) / sizeof ( uint32_t ) ];
+	} random_uuid;
+	uint8_t raw[PEERDIST_DIGEST_MAX_SIZE];
+	char location[ 16 /* "xxx.xxx.xxx.xxx" */ + 6 /* ":xxxxx" */ ];
+	const char *uuid;
+	char *response;
+	char *ids;
+	char *counts;
+	char *id;
+	char *ids_out;
+	char *counts_out;
+	unsigned int index;
+	unsigned int i;
+	size_t len;
+	int decoded;
+	int rc;
+
+	/* Parse probe */
+	if ( ( rc = peerdist_discovery_probe ( iobuf->data, iob_len ( iobuf ),
+					       &probe ) ) != 0 )
+		goto err_probe;
+
+	/* Identify local address */
+	if ( ( ! peer ) || ( peer->sin_family != AF_INET ) ) {
+		rc = -EAFNOSUPPORT;
+		goto err_address;
+	}
+	if ( ( rc = peerserv_address ( peer, &address ) ) != 0 )
+		goto err_address;
+	snprintf ( location, sizeof ( location ), "%s:%d",
+		   inet_ntoa ( address ), PEERSERV_PORT );
+
+	/* Allocate lists of matched segment IDs and block counts.
+	 * The probe's list of segment IDs lies within the probe
+	 * data, and each ID requires one eight-digit block count.
+	 */
+	len = iob_len ( iobuf );
+	ids = malloc ( len + 1 /* NUL */ );
+	counts = malloc ( ( ( ( len / 2 ) + 1 ) * 8 ) + 1 /* NUL */ );
+	if ( ! ( ids && counts ) ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	ids_out = ids;
+	counts_out = counts;
+	*ids_out = '\0';
+	*counts_out = '\0';
+
+	/* Match each segment ID against served content */
+	for ( id = probe.ids ; *id ; id += ( strlen ( id ) + 1 /* NUL */ ) ) {
+		decoded = base16_decode ( id, raw, sizeof ( raw ) );
+		if ( decoded <= 0 )
+			continue;
+		content = peerserv_find ( raw, decoded, &index );
+		if ( ! ( content && content->segments[index].blocks ) )
+			continue;
+		ids_out += sprintf ( ids_out, "%s%s",
+				     ( ( ids_out == ids ) ? "" : " " ), id );
+		counts_out += sprintf ( counts_out, "%08X",
+					content->segments[index].blocks );
+	}
+	if ( ids_out == ids ) {
+		rc = 0;
+		goto err_nomatch;
+	}
+	DBGC2 ( socket, "PEERSERV responding to %s for %s\n",
+		inet_ntoa ( peer->sin_addr ), ids );
+
+	/* Generate a random message UUID.  This does not require high
+	 * quality randomness.
+	 */
+	for ( i = 0 ; i < ( sizeof ( random_uuid.dword ) /
+			    sizeof ( random_uuid.dword[0] ) ) ; i++ )
+		random_uuid.dword[i] = random();
+
+	/* Construct response */
+	uuid = uuid_ntoa ( &random_uuid.uuid );
+	response = peerdist_discovery_response ( uuid, probe.message, ids,
+						 counts, location );
+	if ( ! response ) {
+		rc = -ENOMEM;
+		goto err_response;
+	}
+
+	/* Transmit response */
+	memset ( &reply_meta, 0, sizeof ( reply_meta ) );
+	reply_meta.dest = meta->src;
+	if ( ( rc = xfer_deliver_raw_meta ( &socket->xfer, response,
+					    strlen ( response ),
+					    &reply_meta ) ) != 0 ) {
+		DBGC ( socket, "PEERSERV could not respond to %s: %s\n",
+		       inet_ntoa ( peer->sin_addr ), strerror ( rc ) );
+		goto err_tx;
+	}
+
+ err_tx:
+	free ( response );
+ err_response:
+ err_nomatch:
+ err_alloc:
+	free ( counts );
+	free ( ids );
+ err_address:
+ err_probe:
+	free_iob ( iobuf );
+	return rc;
+}
+
+/** PeerDist discovery responder socket interface operations */
+static struct interface_operation peerserv_socket_operations[] = {
+	INTF_OP ( xfer_deliver, struct peerserv_socket *,
+		  peerserv_discovery_rx ),
+};
+
+/** PeerDist discovery responder socket interface descriptor */
+static struct interface_descriptor peerserv_socket_desc =
+	INTF_DESC ( struct peerserv_socket, xfer, peerserv_socket_operations );
+
+/** PeerDist discovery responder socket
+ *
+ * Only IPv4 is supported, since the discovery response must include
+ * a literal address at which the peer may contact us.
+ */
+static struct peerserv_socket peerserv_socket = {
+	.xfer = INTF_INIT ( peerserv_socket_desc ),
+};
+
+/**
+ * Open PeerDist discovery responder socket
+ *
+ * @ret rc		Return status code
+ */
+static int peerserv_socket_open ( void ) {
+	struct sockaddr_in peer;
+	struct sockaddr_in local;
+	int rc;
+
+	/* Do nothing if already open */
+	if ( peerserv_socket.open )
+		return 0;
+
+	/* Open socket bound to the discovery port, accepting probes
+	 * sent to any address (including the multicast group).
+	 */
+	memset ( &peer, 0, sizeof ( peer ) );
+	peer.sin_family = AF_INET;
+	memset ( &local, 0, sizeof ( local ) );
+	local.sin_family = AF_INET;
+	local.sin_port = htons ( PEERDIST_DISCOVERY_PORT );
+	if ( ( rc = xfer_open_socket ( &peerserv_socket.xfer, SOCK_DGRAM,
+				       ( struct sockaddr * ) &peer,
+				       ( struct sockaddr * ) &local ) ) != 0 ) {
+		DBGC ( &peerserv_socket, "PEERSERV could not open discovery "
+		       "socket: %s\n", strerror ( rc ) );
+		return rc;
+	}
+	peerserv_socket.open = 1;
+
+	return 0;
+}
+
+/******************************************************************************
+ *
+ * Content management
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Serve downloaded content to other peers
+ *
+ * @v info		Content information
+ *
+ * The raw content information is copied, so the caller need not
+ * retain it.  Failures are not reported, since serving content is
+ * purely an optimisation for other peers.
+ */
+void peerserv_add ( const struct peerdist_info *info ) {
+	struct peerdist_info_segment segment;
+	struct peerdist_info_block block;
+	struct peerserv_content *content;
+	struct peerserv_content *tmp;
+	size_t len = info->raw.len;
+	void *raw;
+	unsigned int i;
+	unsigned int j;
+	int rc;
+
+	/* Remove any existing entry for the same content */
+	list_for_each_entry_safe ( content, tmp, &peerserv_contents, list ) {
+		if ( ( content->info.raw.len == len ) &&
+		     ( memcmp_user ( content->info.raw.data, 0, info->raw.data,
+				     0, len ) == 0 ) ) {
+			peerserv_del ( content );
+		}
+	}
+
+	/* Allocate and initialise structure */
+	content = zalloc ( sizeof ( *content ) +
+			   ( info->segments * sizeof ( content->segments[0] ) ) +
+			   len );
+	if ( ! content )
+		return;
+	content->segments = ( ( ( void * ) content ) + sizeof ( *content ) );
+	raw = ( ( ( void * ) content->segments ) +
+		( info->segments * sizeof ( content->segments[0] ) ) );
+	copy_from_user ( raw, info->raw.data, 0, len );
+	if ( ( rc = peerdist_info ( virt_to_user ( raw ), len,
+				    &content->info ) ) != 0 )
+		goto err;
+
+	/* Record segment identifiers and count wholly held blocks */
+	for ( i = 0 ; i < content->info.segments ; i++ ) {
+		if ( ( rc = peerdist_info_segment ( &content->info, &segment,
+						    i ) ) != 0 )
+			goto err;
+		memcpy ( content->segments[i].id, segment.id,
+			 sizeof ( content->segments[i].id ) );
+		for ( j = 0 ; j < segment.blocks ; j++ ) {
+			if ( ( rc = peerdist_info_block ( &segment, &block,
+							  j ) ) != 0 )
+				goto err;
+			if ( ( block.trim.start == block.range.start ) &&
+			     ( block.trim.end == block.range.end ) )
+				content->segments[i].blocks++;
+		}
+	}
+
+	/* Discard least recently added content, if applicable */
+	if ( peerserv_count >= PEERSERV_MAX_CONTENT ) {
+		tmp = list_last_entry ( &peerserv_contents,
+					struct peerserv_content, list );
+		assert ( tmp != NULL );
+		peerserv_del ( tmp );
+	}
+
+	/* Add to list of served content */
+	list_add ( &content->list, &peerserv_contents );
+	peerserv_count++;
+	DBGC ( content, "PEERSERV %p serving [%08zx,%08zx) in %d segments\n",
+	       content, content->info.trim.start, content->info.trim.end,
+	       content->info.segments );
+
+	/* Start responding to discovery probes */
+	peerserv_socket_open();
+
+	return;
+
+ err:
+	DBGC ( content, "PEERSERV %p could not parse content information: "
+	       "%s\n", content, strerror ( rc ) );
+	free ( content );
+}
+
+/**
+ * Stop serving content
+ *
+ * @v booting		System is shutting down for OS boot
+ */
+static void peerserv_shutdown ( int booting __unused ) {
+	struct peerserv_content *content;
+	struct peerserv_content *tmp;
+
+	/* Close discovery responder socket */
+	intf_restart ( &peerserv_socket.xfer, 0 );
+	peerserv_socket.open = 0;
+
+	/* Discard all served content */
+	list_for_each_entry_safe ( content, tmp, &peerserv_contents, list )
+		peerserv_del ( content );
+}
+
+/** PeerDist content server shutdown function */
+struct startup_fn peerserv_startup_fn __startup_fn ( STARTUP_LATE ) = {
+	.shutdown = peerserv_shutdown,
+};
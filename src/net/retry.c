@@ -48,8 +48,26 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  */
 #define MIN_TIMEOUT 7
 
-/** List of running timers */
-static LIST_HEAD ( timers );
+/** Timer wheel (lists of running timers, indexed by expiry tick) */
+static struct list_head timers[RETRY_WHEEL_SLOTS];
+
+/** Next timer wheel tick to be examined
+ *
+ * This never advances beyond the current time, and so all running
+ * timers have an expiry time at or after this tick.
+ */
+static unsigned long retry_tick;
+
+/**
+ * Get timer wheel slot
+ *
+ * @v tick		Tick
+ * @ret list		List of timers within the timer wheel slot
+ */
+static inline struct list_head * retry_slot ( unsigned long tick ) {
+
+	return &timers[ tick % RETRY_WHEEL_SLOTS ];
+}
 
 /**
  * Start timer with a specified timeout
@@ -62,10 +80,19 @@ static LIST_HEAD ( timers );
  * be stopped and the timer's callback function will be called.
  */
 void start_timer_fixed ( struct retry_timer *timer, unsigned long timeout ) {
+	unsigned int i;
 
-	/* Add to list of running timers (if applicable) */
-	if ( ! timer->running ) {
-		list_add ( &timer->list, &timers );
+	/* Initialise timer wheel, if not already done */
+	if ( ! timers[0].next ) {
+		for ( i = 0 ; i < RETRY_WHEEL_SLOTS ; i++ )
+			INIT_LIST_HEAD ( &timers[i] );
+		retry_tick = currticks();
+	}
+
+	/* Remove from timer wheel (if applicable) */
+	if ( timer->running ) {
+		list_del ( &timer->list );
+	} else {
 		ref_get ( timer->refcnt );
 		timer->running = 1;
 	}
@@ -76,6 +103,10 @@ void start_timer_fixed ( struct retry_timer *timer, unsigned long timeout ) {
 	/* Record timeout */
 	timer->timeout = timeout;
 
+	/* Add to timer wheel slot for expiry time */
+	list_add ( &timer->list,
+		   retry_slot ( timer->start + timer->timeout ) );
+
 	DBGC2 ( timer, "Timer %p started at time %ld (expires at %ld)\n",
 		timer, timer->start, ( timer->start + timer->timeout ) );
 }
@@ -199,17 +230,32 @@ void retry_poll ( void ) {
 	unsigned long now = currticks();
 	unsigned long used;
 
+	/* Do nothing if no timer has ever been started */
+	if ( ! timers[0].next )
+		return;
+
+	/* Examine each slot at most once, however long since the
+	 * previous poll.
+	 */
+	if ( ( now - retry_tick ) >= RETRY_WHEEL_SLOTS )
+		retry_tick = ( now - RETRY_WHEEL_SLOTS + 1 );
+
 	/* Process at most one timer expiry.  We cannot process
 	 * multiple expiries in one pass, because one timer expiring
 	 * may end up triggering another timer's deletion from the
 	 * list.
 	 */
-	list_for_each_entry ( timer, &timers, list ) {
-		used = ( now - timer->start );
-		if ( used >= timer->timeout ) {
-			timer_expired ( timer );
-			break;
+	while ( 1 ) {
+		list_for_each_entry ( timer, retry_slot ( retry_tick ), list ) {
+			used = ( now - timer->start );
+			if ( used >= timer->timeout ) {
+				timer_expired ( timer );
+				return;
+			}
 		}
+		if ( retry_tick == now )
+			break;
+		retry_tick++;
 	}
 }
 
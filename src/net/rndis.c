@@ -772,25 +772,59 @@ static void rndis_rx_message ( struct rndis_device *rndis,
 void rndis_rx ( struct rndis_device *rndis, struct io_buffer *iobuf ) {
 	struct net_device *netdev = rndis->netdev;
 	struct rndis_header *header;
+	struct io_buffer *next;
 	unsigned int type;
+	size_t msg_len;
+	size_t len;
 	int rc;
 
-	/* Sanity check */
-	if ( iob_len ( iobuf ) < sizeof ( *header ) ) {
-		DBGC ( rndis, "RNDIS %s received underlength packet:\n",
-		       rndis->name );
-		DBGC_HDA ( rndis, 0, iobuf->data, iob_len ( iobuf ) );
-		rc = -EINVAL;
-		goto drop;
-	}
-	header = iobuf->data;
+	/* A single transfer may contain several concatenated messages */
+	while ( iobuf ) {
 
-	/* Parse and strip header */
-	type = le32_to_cpu ( header->type );
-	iob_pull ( iobuf, sizeof ( *header ) );
+		/* Sanity check */
+		len = iob_len ( iobuf );
+		if ( len < sizeof ( *header ) ) {
+			DBGC ( rndis, "RNDIS %s received underlength "
+			       "packet:\n", rndis->name );
+			DBGC_HDA ( rndis, 0, iobuf->data, len );
+			rc = -EINVAL;
+			goto drop;
+		}
+		header = iobuf->data;
+		type = le32_to_cpu ( header->type );
+		msg_len = le32_to_cpu ( header->len );
+
+		/* Split off any subsequent messages.  Trailing data
+		 * too short to be a message is treated as padding.
+		 */
+		next = NULL;
+		if ( ( msg_len >= sizeof ( *header ) ) && ( msg_len < len ) ) {
+			if ( ( len - msg_len ) >= sizeof ( *header ) ) {
+				next = alloc_iob ( len - msg_len );
+				if ( ! next ) {
+					DBGC ( rndis, "RNDIS %s could not "
+					       "split message\n", rndis->name );
+					netdev_rx_err ( netdev, NULL,
+							-ENOMEM );
+				} else {
+					memcpy ( iob_put ( next,
+							   ( len - msg_len ) ),
+						 ( iobuf->data + msg_len ),
+						 ( len - msg_len ) );
+				}
+			}
+			iob_unput ( iobuf, ( len - msg_len ) );
+		}
 
-	/* Handle message */
-	rndis_rx_message ( rndis, iob_disown ( iobuf ), type );
+		/* Strip header */
+		iob_pull ( iobuf, sizeof ( *header ) );
+
+		/* Handle message */
+		rndis_rx_message ( rndis, iob_disown ( iobuf ), type );
+
+		/* Move to next message, if any */
+		iobuf = next;
+	}
 
 	return;
 
@@ -16,9 +16,13 @@
 #include <ipxe/uri.h>
 #include <ipxe/netdevice.h>
 #include <ipxe/profile.h>
+#include <ipxe/dropstat.h>
+#include <ipxe/timeline.h>
 #include <ipxe/process.h>
+#include <ipxe/settings.h>
 #include <ipxe/tcpip.h>
 #include <ipxe/tcp.h>
+#include <ipxe/trace.h>
 
 /** @file
  *
@@ -34,6 +38,8 @@ struct tcp_connection {
 	struct refcnt refcnt;
 	/** List of TCP connections */
 	struct list_head list;
+	/** List of TCP connections within the same hash bucket */
+	struct list_head hash;
 
 	/** Flags */
 	unsigned int flags;
@@ -45,8 +51,30 @@ struct tcp_connection {
 	struct sockaddr_tcpip peer;
 	/** Local port */
 	unsigned int local_port;
-	/** Maximum segment size */
+	/** Maximum segment size (as advertised to peer) */
 	size_t mss;
+	/** Transmit headroom (for network- and link-layer headers) */
+	size_t headroom;
+	/** Segmentation offload flag (@c IOB_FL_TSO4 or @c IOB_FL_TSO6)
+	 *
+	 * This is zero if the transmitting network device does not
+	 * support segmentation offload.
+	 */
+	unsigned int tso;
+	/** Send maximum segment size
+	 *
+	 * This is the largest segment payload known to be deliverable
+	 * along the path to the peer.
+	 */
+	size_t snd_mss;
+	/** Largest send maximum segment size permitted by link and peer */
+	size_t max_mss;
+	/** Smallest segment payload known not to be deliverable */
+	size_t fail_mss;
+	/** Path MTU probe sequence number */
+	uint32_t probe_seq;
+	/** Path MTU probe length, or zero if no probe is outstanding */
+	size_t probe_len;
 
 	/** Current TCP state */
 	unsigned int tcp_state;
@@ -65,6 +93,14 @@ struct tcp_connection {
 	 * Equivalent to (SND.NXT-SND.UNA) in RFC 793 terminology.
 	 */
 	uint32_t snd_sent;
+	/** Maximum unacknowledged sequence count
+	 *
+	 * Equivalent to (SND.MAX-SND.UNA), i.e. the highest
+	 * unacknowledged sequence count ever transmitted.  This may
+	 * exceed the current unacknowledged sequence count following
+	 * a retransmission timeout.
+	 */
+	uint32_t snd_max;
 	/** Send window
 	 *
 	 * Equivalent to SND.WND in RFC 793 terminology
@@ -80,6 +116,8 @@ struct tcp_connection {
 	 * Equivalent to RCV.WND in RFC 793 terminology.
 	 */
 	uint32_t rcv_win;
+	/** Length of received sequence space not yet acknowledged */
+	uint32_t rcv_unacked;
 	/** Received timestamp value
 	 *
 	 * Updated when a packet is received; copied to ts_recent when
@@ -91,6 +129,18 @@ struct tcp_connection {
 	 * Equivalent to TS.Recent in RFC 1323 terminology.
 	 */
 	uint32_t ts_recent;
+	/** Smoothed round-trip time (in ticks, scaled by 8)
+	 *
+	 * Equivalent to SRTT in RFC 6298 terminology.  This is valid
+	 * only if @c TCP_RTT_VALID is set.
+	 */
+	unsigned long srtt;
+	/** Round-trip time variation (in ticks, scaled by 4)
+	 *
+	 * Equivalent to RTTVAR in RFC 6298 terminology.  This is
+	 * valid only if @c TCP_RTT_VALID is set.
+	 */
+	unsigned long rttvar;
 	/** Send window scale
 	 *
 	 * Equivalent to Snd.Wind.Scale in RFC 1323 terminology
@@ -101,12 +151,38 @@ struct tcp_connection {
 	 * Equivalent to Rcv.Wind.Scale in RFC 1323 terminology
 	 */
 	uint8_t rcv_win_scale;
+	/** Maximum receive window */
+	uint32_t max_rcv_win;
+	/** Length of data held in receive queue (including internal headers) */
+	size_t rx_queued;
 
 	/** Selective acknowledgement list (in host-endian order) */
 	struct tcp_sack_block sack[TCP_SACK_MAX];
 
+	/** Congestion control algorithm */
+	struct tcp_congestion_algorithm *cong_algorithm;
+	/** Congestion control state */
+	struct tcp_congestion cong;
+	/** Number of consecutive duplicate acknowledgements received */
+	unsigned int dupacks;
+	/** Recovery point
+	 *
+	 * Equivalent to "recover" in RFC 6582 terminology.
+	 */
+	uint32_t snd_recover;
+	/** Highest sequence number retransmitted during recovery */
+	uint32_t snd_rexmit;
+	/** Selective acknowledgements received from peer
+	 *
+	 * These are held in host-endian order, and are replaced by the
+	 * contents of each received acknowledgement.
+	 */
+	struct tcp_sack_block snd_sack[TCP_RX_SACK_MAX];
+
 	/** Transmit queue */
 	struct list_head tx_queue;
+	/** Length of data held in transmit queue */
+	size_t tx_queued;
 	/** Receive queue */
 	struct list_head rx_queue;
 	/** Transmission process */
@@ -117,11 +193,16 @@ struct tcp_connection {
 	struct retry_timer keepalive;
 	/** Shutdown (TIME_WAIT) timer */
 	struct retry_timer wait;
+	/** Delayed acknowledgement timer */
+	struct retry_timer delack;
 
 	/** Pending operations for SYN and FIN */
 	struct pending_operation pending_flags;
 	/** Pending operations for transmit queue */
 	struct pending_operation pending_data;
+
+	/** Statistics */
+	struct tcp_statistics stats;
 };
 
 /** TCP flags */
@@ -134,6 +215,14 @@ enum tcp_flags {
 	TCP_ACK_PENDING = 0x0004,
 	/** TCP selective acknowledgement is enabled */
 	TCP_SACK_ENABLED = 0x0008,
+	/** TCP fast recovery is in progress */
+	TCP_RECOVERY = 0x0010,
+	/** TCP connection was opened by a peer */
+	TCP_PASSIVE = 0x0020,
+	/** TCP round-trip time estimate is valid */
+	TCP_RTT_VALID = 0x0040,
+	/** TCP acknowledgement must not be delayed */
+	TCP_ACK_NOW = 0x0080,
 };
 
 /** TCP internal header
@@ -166,6 +255,12 @@ struct tcp_rx_queued_header {
  */
 static LIST_HEAD ( tcp_conns );
 
+/** Accumulated statistics for deleted TCP connections */
+static struct tcp_statistics tcp_closed;
+
+/** TCP connection hash table (indexed by local port) */
+static struct list_head tcp_hash[TCP_HASH_BUCKETS];
+
 /** Transmit profiler */
 static struct profiler tcp_tx_profiler __profiler = { .name = "tcp.tx" };
 
@@ -175,15 +270,74 @@ static struct profiler tcp_rx_profiler __profiler = { .name = "tcp.rx" };
 /** Data transfer profiler */
 static struct profiler tcp_xfer_profiler __profiler = { .name = "tcp.xfer" };
 
+/** Packets dropped due to a malformed header */
+static struct drop_counter tcp_header_drops __drop_counter = {
+	.name = "tcp.header",
+};
+
+/** Packets dropped due to an incorrect checksum */
+static struct drop_counter tcp_csum_drops __drop_counter = {
+	.name = "tcp.csum",
+};
+
+/** Packets dropped due to not matching any connection */
+static struct drop_counter tcp_noconn_drops __drop_counter = {
+	.name = "tcp.noconn",
+};
+
+/** Packets dropped due to an unacceptable ACK */
+static struct drop_counter tcp_ack_drops __drop_counter = {
+	.name = "tcp.ack",
+};
+
+/** Packets dropped due to an unacceptable RST */
+static struct drop_counter tcp_rst_drops __drop_counter = {
+	.name = "tcp.rst",
+};
+
+/** Packets dropped due to failing the PAWS timestamp check */
+static struct drop_counter tcp_paws_drops __drop_counter = {
+	.name = "tcp.paws",
+};
+
+/** Packets dropped due to lying outside the receive window */
+static struct drop_counter tcp_window_drops __drop_counter = {
+	.name = "tcp.window",
+};
+
+/** Packets dropped due to exceeding the out-of-order queue budget */
+static struct drop_counter tcp_ooo_drops __drop_counter = {
+	.name = "tcp.ooo",
+};
+
+/** TCP receive window setting */
+const struct setting tcp_window_setting __setting ( SETTING_MISC,
+						    tcp-window ) = {
+	.name = "tcp-window",
+	.description = "TCP receive window",
+	.type = &setting_type_uint32,
+};
+
+/** TCP congestion control algorithm setting */
+const struct setting tcp_congestion_setting __setting ( SETTING_MISC,
+							tcp-congestion ) = {
+	.name = "tcp-congestion",
+	.description = "TCP congestion control algorithm",
+	.type = &setting_type_string,
+};
+
 /* Forward declarations */
 static struct process_descriptor tcp_process_desc;
 static struct interface_descriptor tcp_xfer_desc;
 static void tcp_expired ( struct retry_timer *timer, int over );
 static void tcp_keepalive_expired ( struct retry_timer *timer, int over );
 static void tcp_wait_expired ( struct retry_timer *timer, int over );
-static struct tcp_connection * tcp_demux ( unsigned int local_port );
+static void tcp_delack_expired ( struct retry_timer *timer, int over );
+static struct tcp_connection * tcp_demux ( unsigned int local_port,
+					    struct sockaddr_tcpip *peer );
 static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
-			uint32_t win );
+			uint32_t win, const struct tcp_options *options,
+			size_t data_len );
 
 /**
  * Name TCP state
@@ -250,6 +404,35 @@ tcp_dump_flags ( struct tcp_connection *tcp, unsigned int flags ) {
  ***************************************************************************
  */
 
+/**
+ * Get TCP connection hash bucket
+ *
+ * @v local_port	Local port
+ * @ret list		List of connections within hash bucket
+ */
+static struct list_head * tcp_bucket ( unsigned int local_port ) {
+	unsigned int i;
+
+	/* Initialise hash table, if not already done */
+	if ( ! tcp_hash[0].next ) {
+		for ( i = 0 ; i < TCP_HASH_BUCKETS ; i++ )
+			INIT_LIST_HEAD ( &tcp_hash[i] );
+	}
+
+	return &tcp_hash[ local_port % TCP_HASH_BUCKETS ];
+}
+
+/**
+ * Add TCP connection to list of connections
+ *
+ * @v tcp		TCP connection
+ */
+static void tcp_list_add ( struct tcp_connection *tcp ) {
+
+	list_add ( &tcp->list, &tcp_conns );
+	list_add ( &tcp->hash, tcp_bucket ( tcp->local_port ) );
+}
+
 /**
  * Check if local TCP port is available
  *
@@ -258,24 +441,116 @@ tcp_dump_flags ( struct tcp_connection *tcp, unsigned int flags ) {
  */
 static int tcp_port_available ( int port ) {
 
-	return ( tcp_demux ( port ) ? -EADDRINUSE : port );
+	return ( tcp_demux ( port, NULL ) ? -EADDRINUSE : port );
 }
 
 /**
- * Open a TCP connection
+ * Calculate maximum receive window
+ *
+ * @ret max_rcv_win	Maximum receive window
+ */
+static uint32_t tcp_max_rcv_win ( void ) {
+	unsigned long window;
+
+	/* Use "tcp-window" setting, if specified */
+	if ( ( fetch_uint_setting ( NULL, &tcp_window_setting,
+				    &window ) < 0 ) || ( window == 0 ) )
+		window = TCP_MAX_WINDOW_SIZE;
+
+	/* Limit to largest window representable using our window scale */
+	if ( window > TCP_MAX_SCALED_WINDOW_SIZE )
+		window = TCP_MAX_SCALED_WINDOW_SIZE;
+
+	/* Keep everything dword-aligned */
+	return ( window & ~0x03UL );
+}
+
+/**
+ * Calculate maximum length of out-of-order receive queue
+ *
+ * @v tcp		TCP connection
+ * @ret max_rx_queued	Maximum length of receive queue
+ *
+ * Data received in order is delivered immediately to the application
+ * (and so will usually end up in a umalloc()ed buffer), but
+ * out-of-order data must be held in I/O buffers allocated from the
+ * heap until the missing data arrives.  A peer (or a corrupted
+ * packet) could place data beyond the window we advertised, so we
+ * impose an explicit budget on the amount of out-of-order data held
+ * per connection, discarding the packets furthest from the left edge
+ * of the window once the budget is exceeded.
+ *
+ * The budget must never be smaller than the receive window, or we
+ * would discard data that the peer is entitled to send.  We allow one
+ * additional maximum segment to cover the internal headers.
+ */
+static inline size_t tcp_max_rx_queued ( struct tcp_connection *tcp ) {
+	return ( tcp->max_rcv_win + tcp->mss );
+}
+
+/**
+ * Identify TCP congestion control algorithm
+ *
+ * @ret algorithm	Congestion control algorithm
+ */
+static struct tcp_congestion_algorithm * tcp_congestion_algorithm ( void ) {
+	struct tcp_congestion_algorithm *algorithm;
+	char name[16];
+
+	/* Use "tcp-congestion" setting, if specified */
+	if ( fetch_string_setting ( NULL, &tcp_congestion_setting, name,
+				    sizeof ( name ) ) > 0 ) {
+		for_each_table_entry ( algorithm, TCP_CONGESTION_ALGORITHMS ) {
+			if ( strcmp ( algorithm->name, name ) == 0 )
+				return algorithm;
+		}
+		DBG ( "TCP unknown congestion control algorithm \"%s\"\n",
+		      name );
+	}
+
+	/* Otherwise, use the default algorithm */
+	return table_start ( TCP_CONGESTION_ALGORITHMS );
+}
+
+/**
+ * Check availability of TCP segmentation offload
+ *
+ * @v tcp		TCP connection
+ * @ret flags		I/O buffer segmentation offload flag, or zero
+ */
+static unsigned int tcp_tso ( struct tcp_connection *tcp ) {
+	struct net_device *netdev;
+
+	/* Identify transmitting network device */
+	netdev = tcpip_netdev ( &tcp->peer );
+	if ( ! netdev )
+		return 0;
+
+	/* Check network device capabilities */
+	switch ( tcp->peer.st_family ) {
+	case AF_INET:
+		return ( ( netdev->state & NETDEV_TX_TSO4 ) ? IOB_FL_TSO4 : 0 );
+	case AF_INET6:
+		return ( ( netdev->state & NETDEV_TX_TSO6 ) ? IOB_FL_TSO6 : 0 );
+	default:
+		return 0;
+	}
+}
+
+/**
+ * Create a TCP connection
  *
- * @v xfer		Data transfer interface
  * @v peer		Peer socket address
- * @v local		Local socket address, or NULL
+ * @ret new_tcp		TCP connection
  * @ret rc		Return status code
+ *
+ * The connection is created in the SYN_SENT state, without a local
+ * port and without being added to the list of connections.
  */
-static int tcp_open ( struct interface *xfer, struct sockaddr *peer,
-		      struct sockaddr *local ) {
-	struct sockaddr_tcpip *st_peer = ( struct sockaddr_tcpip * ) peer;
-	struct sockaddr_tcpip *st_local = ( struct sockaddr_tcpip * ) local;
+static int tcp_create ( struct sockaddr_tcpip *peer,
+			struct tcp_connection **new_tcp ) {
 	struct tcp_connection *tcp;
 	size_t mtu;
-	int port;
 	int rc;
 
 	/* Allocate and initialise structure */
@@ -289,24 +564,66 @@ static int tcp_open ( struct interface *xfer, struct sockaddr *peer,
 	timer_init ( &tcp->timer, tcp_expired, &tcp->refcnt );
 	timer_init ( &tcp->keepalive, tcp_keepalive_expired, &tcp->refcnt );
 	timer_init ( &tcp->wait, tcp_wait_expired, &tcp->refcnt );
+	timer_init ( &tcp->delack, tcp_delack_expired, &tcp->refcnt );
 	tcp->prev_tcp_state = TCP_CLOSED;
 	tcp->tcp_state = TCP_STATE_SENT ( TCP_SYN );
 	tcp_dump_state ( tcp );
 	tcp->snd_seq = random();
+	tcp->snd_recover = tcp->snd_seq;
 	INIT_LIST_HEAD ( &tcp->tx_queue );
 	INIT_LIST_HEAD ( &tcp->rx_queue );
-	memcpy ( &tcp->peer, st_peer, sizeof ( tcp->peer ) );
+	memcpy ( &tcp->peer, peer, sizeof ( tcp->peer ) );
+	tcp->max_rcv_win = tcp_max_rcv_win();
+	tcp->snd_mss = TCP_PATH_MTU;
+	tcp->max_mss = TCP_PATH_MTU;
+	tcp->fail_mss = ( tcp->max_mss + 1 );
+	tcp->cong_algorithm = tcp_congestion_algorithm();
+	tcp->cong_algorithm->init ( &tcp->cong, tcp->snd_mss );
 
 	/* Calculate MSS */
 	mtu = tcpip_mtu ( &tcp->peer );
 	if ( ! mtu ) {
 		DBGC ( tcp, "TCP %p has no route to %s\n",
-		       tcp, sock_ntoa ( peer ) );
+		       tcp, sock_ntoa ( ( struct sockaddr * ) peer ) );
 		rc = -ENETUNREACH;
 		goto err;
 	}
 	tcp->mss = ( mtu - sizeof ( struct tcp_header ) );
 
+	/* Calculate transmit headroom */
+	tcp->headroom = tcpip_headroom ( &tcp->peer );
+
+	/* Check availability of segmentation offload */
+	tcp->tso = tcp_tso ( tcp );
+
+	*new_tcp = tcp;
+	return 0;
+
+ err:
+	ref_put ( &tcp->refcnt );
+	return rc;
+}
+
+/**
+ * Open a TCP connection
+ *
+ * @v xfer		Data transfer interface
+ * @v peer		Peer socket address
+ * @v local		Local socket address, or NULL
+ * @ret rc		Return status code
+ */
+static int tcp_open ( struct interface *xfer, struct sockaddr *peer,
+		      struct sockaddr *local ) {
+	struct sockaddr_tcpip *st_peer = ( struct sockaddr_tcpip * ) peer;
+	struct sockaddr_tcpip *st_local = ( struct sockaddr_tcpip * ) local;
+	struct tcp_connection *tcp;
+	int port;
+	int rc;
+
+	/* Create connection */
+	if ( ( rc = tcp_create ( st_peer, &tcp ) ) != 0 )
+		return rc;
+
 	/* Bind to local port */
 	port = tcpip_bind ( st_local, tcp_port_available );
 	if ( port < 0 ) {
@@ -316,10 +633,13 @@ static int tcp_open ( struct interface *xfer, struct sockaddr *peer,
 		goto err;
 	}
 	tcp->local_port = port;
-	DBGC ( tcp, "TCP %p bound to port %d\n", tcp, tcp->local_port );
+	DBGC ( tcp, "TCP %p bound to port %d with maximum RX window %#x "
+	       "using %s\n", tcp, tcp->local_port, tcp->max_rcv_win,
+	       tcp->cong_algorithm->name );
 
 	/* Start timer to initiate SYN */
 	start_timer_nodelay ( &tcp->timer );
+	timeline_record ( "tcp", "syn", sock_ntoa ( peer ), 0 );
 
 	/* Add a pending operation for the SYN */
 	pending_get ( &tcp->pending_flags );
@@ -328,7 +648,7 @@ static int tcp_open ( struct interface *xfer, struct sockaddr *peer,
 	 * list and return
 	 */
 	intf_plug_plug ( &tcp->xfer, xfer );
-	list_add ( &tcp->list, &tcp_conns );
+	tcp_list_add ( tcp );
 	return 0;
 
  err:
@@ -336,6 +656,81 @@ static int tcp_open ( struct interface *xfer, struct sockaddr *peer,
 	return rc;
 }
 
+/**
+ * Accept an incoming TCP connection
+ *
+ * @v local_port	Local port
+ * @v peer		Peer socket address
+ * @ret tcp		TCP connection, or NULL
+ *
+ * The connection is created in the SYN_SENT state, and will move to
+ * SYN_RCVD (and transmit a SYN|ACK) when the received SYN is
+ * processed.
+ */
+static struct tcp_connection * tcp_accept ( unsigned int local_port,
+					    struct sockaddr_tcpip *peer ) {
+	struct tcp_server *server;
+	struct tcp_connection *tcp;
+	int rc;
+
+	/* Identify server */
+	for_each_table_entry ( server, TCP_SERVERS ) {
+		if ( server->port == local_port )
+			break;
+	}
+	if ( server == table_end ( TCP_SERVERS ) )
+		return NULL;
+
+	/* Create connection */
+	if ( ( rc = tcp_create ( peer, &tcp ) ) != 0 )
+		return NULL;
+	tcp->local_port = local_port;
+	tcp->flags |= TCP_PASSIVE;
+
+	/* Hand connection to server */
+	if ( ( rc = server->accept ( &tcp->xfer, peer ) ) != 0 ) {
+		DBGC ( tcp, "TCP %p %s server refused %s: %s\n", tcp,
+		       server->name, sock_ntoa ( ( struct sockaddr * ) peer ),
+		       strerror ( rc ) );
+		ref_put ( &tcp->refcnt );
+		return NULL;
+	}
+	DBGC ( tcp, "TCP %p accepted %s on port %d for %s server\n", tcp,
+	       sock_ntoa ( ( struct sockaddr * ) peer ), tcp->local_port,
+	       server->name );
+
+	/* Add a pending operation for the SYN */
+	pending_get ( &tcp->pending_flags );
+
+	/* Transfer reference to connection list and return */
+	tcp_list_add ( tcp );
+	return tcp;
+}
+
+/**
+ * Accumulate TCP statistics
+ *
+ * @v total		Accumulated statistics
+ * @v stats		Statistics to add
+ */
+static void tcp_stats_add ( struct tcp_statistics *total,
+			    const struct tcp_statistics *stats ) {
+
+	total->tx_segments += stats->tx_segments;
+	total->tx_bytes += stats->tx_bytes;
+	total->retransmits += stats->retransmits;
+	total->timeouts += stats->timeouts;
+	total->recoveries += stats->recoveries;
+	total->tx_sacks += stats->tx_sacks;
+	total->rx_segments += stats->rx_segments;
+	total->rx_bytes += stats->rx_bytes;
+	total->rx_ooo += stats->rx_ooo;
+	if ( total->rx_queued_max < stats->rx_queued_max )
+		total->rx_queued_max = stats->rx_queued_max;
+	total->rx_sacks += stats->rx_sacks;
+	total->zero_windows += stats->zero_windows;
+}
+
 /**
  * Close TCP connection
  *
@@ -368,6 +763,7 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
 			list_del ( &iobuf->list );
 			free_iob ( iobuf );
 		}
+		tcp->rx_queued = 0;
 
 		/* Free any unsent I/O buffers */
 		list_for_each_entry_safe ( iobuf, tmp, &tcp->tx_queue, list ) {
@@ -375,18 +771,24 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
 			free_iob ( iobuf );
 			pending_put ( &tcp->pending_data );
 		}
+		tcp->tx_queued = 0;
 		assert ( ! is_pending ( &tcp->pending_data ) );
 
 		/* Remove pending operations for SYN and FIN, if applicable */
 		pending_put ( &tcp->pending_flags );
 		pending_put ( &tcp->pending_flags );
 
+		/* Accumulate statistics */
+		tcp_stats_add ( &tcp_closed, &tcp->stats );
+
 		/* Remove from list and drop reference */
 		process_del ( &tcp->process );
 		stop_timer ( &tcp->timer );
 		stop_timer ( &tcp->keepalive );
 		stop_timer ( &tcp->wait );
+		stop_timer ( &tcp->delack );
 		list_del ( &tcp->list );
+		list_del ( &tcp->hash );
 		ref_put ( &tcp->refcnt );
 		DBGC ( tcp, "TCP %p connection deleted\n", tcp );
 		return;
@@ -397,7 +799,7 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
 	 * can send a FIN without breaking things.
 	 */
 	if ( ! ( tcp->tcp_state & TCP_STATE_ACKED ( TCP_SYN ) ) )
-		tcp_rx_ack ( tcp, ( tcp->snd_seq + 1 ), 0 );
+		tcp_rx_ack ( tcp, ( tcp->snd_seq + 1 ), 0, NULL, 0 );
 
 	/* Stop keepalive timer */
 	stop_timer ( &tcp->keepalive );
@@ -415,6 +817,101 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
 	}
 }
 
+/***************************************************************************
+ *
+ * Congestion control
+ *
+ ***************************************************************************
+ */
+
+/**
+ * Initialise NewReno congestion control state
+ *
+ * @v cong		Congestion control state
+ * @v mss		Sender maximum segment size
+ */
+static void tcp_newreno_init ( struct tcp_congestion *cong, size_t mss ) {
+
+	cong->cwnd = tcp_initial_cwnd ( mss );
+	cong->ssthresh = ~( ( uint32_t ) 0 );
+	cong->acked = 0;
+}
+
+/**
+ * Handle acknowledgement of new data using NewReno
+ *
+ * @v cong		Congestion control state
+ * @v mss		Sender maximum segment size
+ * @v len		Length of newly acknowledged data
+ */
+static void tcp_newreno_acked ( struct tcp_congestion *cong, size_t mss,
+				size_t len ) {
+
+	if ( cong->cwnd < cong->ssthresh ) {
+
+		/* Slow start: increase by at most one segment per ACK */
+		cong->cwnd += ( ( len < mss ) ? len : mss );
+
+	} else {
+
+		/* Congestion avoidance: increase by one segment per
+		 * window of acknowledged data (as per RFC 5681
+		 * section 3.1).
+		 */
+		cong->acked += len;
+		if ( cong->acked >= cong->cwnd ) {
+			cong->acked -= cong->cwnd;
+			cong->cwnd += mss;
+		}
+	}
+}
+
+/**
+ * Handle retransmission timeout using NewReno
+ *
+ * @v cong		Congestion control state
+ * @v mss		Sender maximum segment size
+ * @v flight		Amount of data in flight
+ */
+static void tcp_newreno_timeout ( struct tcp_congestion *cong, size_t mss,
+				  size_t flight ) {
+
+	/* Reduce to loss window, as per RFC 5681 section 3.1 */
+	cong->ssthresh = tcp_loss_ssthresh ( flight, mss );
+	cong->cwnd = mss;
+	cong->acked = 0;
+}
+
+/**
+ * Handle loss detected via duplicate acknowledgements using NewReno
+ *
+ * @v cong		Congestion control state
+ * @v mss		Sender maximum segment size
+ * @v flight		Amount of data in flight
+ */
+static void tcp_newreno_loss ( struct tcp_congestion *cong, size_t mss,
+			       size_t flight ) {
+
+	/* Halve window, as per RFC 5681 section 3.2.  We do not
+	 * artificially inflate the window during recovery, since
+	 * retransmissions are driven directly by the SACK scoreboard
+	 * and by partial acknowledgements.
+	 */
+	cong->ssthresh = tcp_loss_ssthresh ( flight, mss );
+	cong->cwnd = cong->ssthresh;
+	cong->acked = 0;
+}
+
+/** NewReno congestion control algorithm */
+struct tcp_congestion_algorithm tcp_newreno_algorithm
+	__tcp_congestion_algorithm ( TCP_CONGESTION_DEFAULT ) = {
+	.name = "newreno",
+	.init = tcp_newreno_init,
+	.acked = tcp_newreno_acked,
+	.timeout = tcp_newreno_timeout,
+	.loss = tcp_newreno_loss,
+};
+
 /***************************************************************************
  *
  * Transmit data path
@@ -422,23 +919,59 @@ static void tcp_close ( struct tcp_connection *tcp, int rc ) {
  ***************************************************************************
  */
 
+/**
+ * Calculate send window
+ *
+ * @v tcp		TCP connection
+ * @ret win		Send window
+ *
+ * The send window is the minimum of the receiver's window and the
+ * congestion window.
+ */
+static uint32_t tcp_send_win ( struct tcp_connection *tcp ) {
+	uint32_t win;
+
+	win = tcp->snd_win;
+	if ( win > tcp->cong.cwnd )
+		win = tcp->cong.cwnd;
+
+	return win;
+}
+
 /**
  * Calculate transmission window
  *
  * @v tcp		TCP connection
+ * @v probe		Length of path MTU probe to be sent, or zero
  * @ret len		Maximum length that can be sent in a single packet
  */
-static size_t tcp_xmit_win ( struct tcp_connection *tcp ) {
+static size_t tcp_xmit_win ( struct tcp_connection *tcp, size_t probe ) {
+	uint32_t win;
+	size_t max_len;
 	size_t len;
 
 	/* Not ready if we're not in a suitable connection state */
 	if ( ! TCP_CAN_SEND_DATA ( tcp->tcp_state ) )
 		return 0;
 
-	/* Length is the minimum of the receiver's window and the path MTU */
-	len = tcp->snd_win;
-	if ( len > TCP_PATH_MTU )
-		len = TCP_PATH_MTU;
+	/* Length is the remaining send window, less any data already
+	 * in flight, limited to the send maximum segment size (or to
+	 * the maximum segmentation offload length, if available, or
+	 * to the length of the path MTU probe, if applicable).
+	 */
+	win = tcp_send_win ( tcp );
+	if ( win <= tcp->snd_sent )
+		return 0;
+	len = ( win - tcp->snd_sent );
+	if ( probe ) {
+		max_len = probe;
+	} else if ( tcp->tso ) {
+		max_len = TCP_TSO_MAX_LEN;
+	} else {
+		max_len = tcp->snd_mss;
+	}
+	if ( len > max_len )
+		len = max_len;
 
 	return len;
 }
@@ -450,16 +983,24 @@ static size_t tcp_xmit_win ( struct tcp_connection *tcp ) {
  * @ret len		Length of window
  */
 static size_t tcp_xfer_window ( struct tcp_connection *tcp ) {
+	uint32_t win;
+
+	/* Not ready if we're not in a suitable connection state */
+	if ( ! TCP_CAN_SEND_DATA ( tcp->tcp_state ) )
+		return 0;
 
-	/* Not ready if data queue is non-empty.  This imposes a limit
-	 * of only one unACKed packet in the TX queue at any time; we
-	 * do this to conserve memory usage.
+	/* Limit the amount of data held in the transmit queue to the
+	 * amount that could be sent within the current send window.
+	 * We also impose a fixed maximum, in order to conserve memory
+	 * usage.
 	 */
-	if ( ! list_empty ( &tcp->tx_queue ) )
+	win = tcp_send_win ( tcp );
+	if ( win > TCP_MAX_TX_QUEUE )
+		win = TCP_MAX_TX_QUEUE;
+	if ( tcp->tx_queued >= win )
 		return 0;
 
-	/* Return TCP window length */
-	return tcp_xmit_win ( tcp );
+	return ( win - tcp->tx_queued );
 }
 
 /**
@@ -554,39 +1095,53 @@ static unsigned int tcp_sack ( struct tcp_connection *tcp, uint32_t seq ) {
  * Process TCP transmit queue
  *
  * @v tcp		TCP connection
+ * @v offset		Starting offset within transmit queue
  * @v max_len		Maximum length to process
  * @v dest		I/O buffer to fill with data, or NULL
  * @v remove		Remove data from queue
  * @ret len		Length of data processed
  *
  * This processes at most @c max_len bytes from the TCP connection's
- * transmit queue.  Data will be copied into the @c dest I/O buffer
- * (if provided) and, if @c remove is true, removed from the transmit
- * queue.
+ * transmit queue, starting at @c offset bytes from the start of the
+ * queue.  Data will be copied into the @c dest I/O buffer (if
+ * provided) and, if @c remove is true, removed from the transmit
+ * queue.  Data may be removed only from the start of the queue
+ * (i.e. @c offset must be zero if @c remove is true).
  */
-static size_t tcp_process_tx_queue ( struct tcp_connection *tcp, size_t max_len,
+static size_t tcp_process_tx_queue ( struct tcp_connection *tcp,
+				     size_t offset, size_t max_len,
 				     struct io_buffer *dest, int remove ) {
 	struct io_buffer *iobuf;
 	struct io_buffer *tmp;
 	size_t frag_len;
 	size_t len = 0;
 
+	/* Sanity check */
+	assert ( ( offset == 0 ) || ( ! remove ) );
+
 	list_for_each_entry_safe ( iobuf, tmp, &tcp->tx_queue, list ) {
 		frag_len = iob_len ( iobuf );
+		if ( offset >= frag_len ) {
+			offset -= frag_len;
+			continue;
+		}
+		frag_len -= offset;
 		if ( frag_len > max_len )
 			frag_len = max_len;
 		if ( dest ) {
-			memcpy ( iob_put ( dest, frag_len ), iobuf->data,
-				 frag_len );
+			memcpy ( iob_put ( dest, frag_len ),
+				 ( iobuf->data + offset ), frag_len );
 		}
 		if ( remove ) {
 			iob_pull ( iobuf, frag_len );
+			tcp->tx_queued -= frag_len;
 			if ( ! iob_len ( iobuf ) ) {
 				list_del ( &iobuf->list );
 				free_iob ( iobuf );
 				pending_put ( &tcp->pending_data );
 			}
 		}
+		offset = 0;
 		len += frag_len;
 		max_len -= frag_len;
 	}
@@ -594,18 +1149,18 @@ static size_t tcp_process_tx_queue ( struct tcp_connection *tcp, size_t max_len,
 }
 
 /**
- * Transmit any outstanding data (with selective acknowledgement)
+ * Transmit a single segment
  *
  * @v tcp		TCP connection
+ * @v offset		Offset within unacknowledged sequence space
+ * @v len		Length of data payload
+ * @v flags		TCP flags
  * @v sack_seq		SEQ for first selective acknowledgement (if any)
- * 
- * Transmits any outstanding data on the connection.
- *
- * Note that even if an error is returned, the retransmission timer
- * will have been started if necessary, and so the stack will
- * eventually attempt to retransmit the failed packet.
+ * @ret rc		Return status code
  */
-static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
+static int tcp_xmit_segment ( struct tcp_connection *tcp, uint32_t offset,
+			      size_t len, unsigned int flags,
+			      uint32_t sack_seq ) {
 	struct io_buffer *iobuf;
 	struct tcp_header *tcphdr;
 	struct tcp_mss_option *mssopt;
@@ -615,149 +1170,451 @@ static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
 	struct tcp_sack_padded_option *sackopt;
 	struct tcp_sack_block *sack;
 	void *payload;
-	unsigned int flags;
 	unsigned int sack_count;
 	unsigned int i;
-	size_t len = 0;
 	size_t sack_len;
+	size_t headroom;
+	unsigned int sacks = 0;
+	uint32_t seq = ( tcp->snd_seq + offset );
 	uint32_t seq_len;
 	uint32_t max_rcv_win;
 	uint32_t max_representable_win;
+	unsigned int tso = 0;
+	int offer;
 	int rc;
 
 	/* Start profiling */
 	profile_start ( &tcp_tx_profiler );
 
-	/* If retransmission timer is already running, do nothing */
-	if ( timer_running ( &tcp->timer ) )
-		return;
+	/* Calculate sequence space length */
+	seq_len = ( len + ( ( flags & ( TCP_SYN | TCP_FIN ) ) ? 1 : 0 ) );
+
+	/* Allocate I/O buffer */
+	headroom = ( tcp->headroom + TCP_MAX_SEGMENT_HEADER_LEN );
+	iobuf = alloc_iob ( len + headroom );
+	if ( ! iobuf ) {
+		DBGC ( tcp, "TCP %p could not allocate iobuf for %08x..%08x "
+		       "%08x\n", tcp, seq, ( seq + seq_len ), tcp->rcv_ack );
+		return -ENOMEM;
+	}
+	iob_reserve ( iobuf, headroom );
+
+	/* Fill data payload from transmit queue */
+	tcp_process_tx_queue ( tcp, offset, len, iobuf, 0 );
+
+	/* Expand receive window if possible */
+	max_rcv_win = xfer_window ( &tcp->xfer );
+	if ( max_rcv_win > tcp->max_rcv_win )
+		max_rcv_win = tcp->max_rcv_win;
+	max_representable_win = ( 0xffff << tcp->rcv_win_scale );
+	if ( max_rcv_win > max_representable_win )
+		max_rcv_win = max_representable_win;
+	max_rcv_win &= ~0x03; /* Keep everything dword-aligned */
+	if ( tcp->rcv_win < max_rcv_win )
+		tcp->rcv_win = max_rcv_win;
+
+	/* Fill up the TCP header */
+	payload = iobuf->data;
+	offer = ( ( flags & TCP_SYN ) &&
+		  ! ( tcp->tcp_state & TCP_STATE_RCVD ( TCP_SYN ) ) );
+	if ( flags & TCP_SYN ) {
+		/* A SYN|ACK may include only those options offered
+		 * in the peer's SYN.
+		 */
+		mssopt = iob_push ( iobuf, sizeof ( *mssopt ) );
+		mssopt->kind = TCP_OPTION_MSS;
+		mssopt->length = sizeof ( *mssopt );
+		mssopt->mss = htons ( tcp->mss );
+		if ( offer || tcp->rcv_win_scale ) {
+			wsopt = iob_push ( iobuf, sizeof ( *wsopt ) );
+			wsopt->nop = TCP_OPTION_NOP;
+			wsopt->wsopt.kind = TCP_OPTION_WS;
+			wsopt->wsopt.length = sizeof ( wsopt->wsopt );
+			wsopt->wsopt.scale = TCP_RX_WINDOW_SCALE;
+		}
+		if ( offer || ( tcp->flags & TCP_SACK_ENABLED ) ) {
+			spopt = iob_push ( iobuf, sizeof ( *spopt ) );
+			memset ( spopt->nop, TCP_OPTION_NOP,
+				 sizeof ( spopt ) );
+			spopt->spopt.kind = TCP_OPTION_SACK_PERMITTED;
+			spopt->spopt.length = sizeof ( spopt->spopt );
+		}
+	}
+	if ( offer || ( tcp->flags & TCP_TS_ENABLED ) ) {
+		tsopt = iob_push ( iobuf, sizeof ( *tsopt ) );
+		memset ( tsopt->nop, TCP_OPTION_NOP, sizeof ( tsopt->nop ) );
+		tsopt->tsopt.kind = TCP_OPTION_TS;
+		tsopt->tsopt.length = sizeof ( tsopt->tsopt );
+		tsopt->tsopt.tsval = htonl ( currticks() );
+		tsopt->tsopt.tsecr = htonl ( tcp->ts_recent );
+	}
+	if ( ( tcp->flags & TCP_SACK_ENABLED ) &&
+	     ( ! list_empty ( &tcp->rx_queue ) ) &&
+	     ( ( sack_count = tcp_sack ( tcp, sack_seq ) ) != 0 ) ) {
+		sack_len = ( sack_count * sizeof ( *sack ) );
+		sackopt = iob_push ( iobuf, ( sizeof ( *sackopt ) + sack_len ));
+		memset ( sackopt->nop, TCP_OPTION_NOP, sizeof ( sackopt->nop ));
+		sackopt->sackopt.kind = TCP_OPTION_SACK;
+		sackopt->sackopt.length =
+			( sizeof ( sackopt->sackopt ) + sack_len );
+		sack = ( ( ( void * ) sackopt ) + sizeof ( *sackopt ) );
+		for ( i = 0 ; i < sack_count ; i++, sack++ ) {
+			sack->left = htonl ( tcp->sack[i].left );
+			sack->right = htonl ( tcp->sack[i].right );
+		}
+		sacks = sack_count;
+	}
+	if ( len != 0 )
+		flags |= TCP_PSH;
+	tcphdr = iob_push ( iobuf, sizeof ( *tcphdr ) );
+	memset ( tcphdr, 0, sizeof ( *tcphdr ) );
+	tcphdr->src = htons ( tcp->local_port );
+	tcphdr->dest = tcp->peer.st_port;
+	tcphdr->seq = htonl ( seq );
+	tcphdr->ack = htonl ( tcp->rcv_ack );
+	tcphdr->hlen = ( ( payload - iobuf->data ) << 2 );
+	tcphdr->flags = flags;
+	if ( flags & TCP_SYN ) {
+		/* Window in a SYN or SYN|ACK is never scaled */
+		tcphdr->win = htons ( ( tcp->rcv_win < 0xffff ) ?
+				      tcp->rcv_win : 0xffff );
+	} else {
+		tcphdr->win = htons ( tcp->rcv_win >> tcp->rcv_win_scale );
+	}
+	iobuf->flags |= IOB_FL_CSUM_PENDING;
+	if ( ( len > tcp->snd_mss ) &&
+	     ! ( tcp->probe_len && ( seq == tcp->probe_seq ) ) ) {
+		tso = tcp->tso;
+		iobuf->flags |= tso;
+		iobuf->mss = tcp->snd_mss;
+	}
+
+	/* Prohibit fragmentation of any segment larger than the
+	 * initial path MTU, so that we receive feedback if the
+	 * segment is too large for the path.
+	 */
+	if ( ( ( iobuf->flags & IOB_FL_TSO ) ? iobuf->mss : len ) >
+	     TCP_PATH_MTU ) {
+		iobuf->flags |= IOB_FL_DONTFRAG;
+	}
+
+	/* Dump header */
+	DBGC2 ( tcp, "TCP %p TX %d->%d %08x..%08x           %08x %4zd",
+		tcp, ntohs ( tcphdr->src ), ntohs ( tcphdr->dest ),
+		ntohl ( tcphdr->seq ), ( ntohl ( tcphdr->seq ) + seq_len ),
+		ntohl ( tcphdr->ack ), len );
+	tcp_dump_flags ( tcp, tcphdr->flags );
+	DBGC2 ( tcp, "\n" );
+	TRACE ( "tcp_tx_seq", tcp, ntohl ( tcphdr->seq ) );
+	TRACE ( "tcp_tx_len", tcp, len );
+
+	/* Transmit packet */
+	if ( ( rc = tcpip_tx ( iobuf, &tcp_protocol, NULL, &tcp->peer, NULL,
+			       &tcphdr->csum ) ) != 0 ) {
+		DBGC ( tcp, "TCP %p could not transmit %08x..%08x %08x: %s\n",
+		       tcp, seq, ( seq + seq_len ), tcp->rcv_ack,
+		       strerror ( rc ) );
+
+		/* If the transmitting network device (which may have
+		 * changed since the connection was opened) cannot
+		 * segment the packet, then stop using segmentation
+		 * offload and resend the data as ordinary segments.
+		 */
+		if ( tso && ( rc == -ENOTSUP ) ) {
+			DBGC ( tcp, "TCP %p disabling segmentation "
+			       "offload\n", tcp );
+			tcp->tso = 0;
+			if ( tcp->snd_sent > offset )
+				tcp->snd_sent = offset;
+			process_add ( &tcp->process );
+		}
+		return rc;
+	}
+
+	/* Update statistics */
+	tcp->stats.tx_segments++;
+	tcp->stats.tx_bytes += len;
+	tcp->stats.tx_sacks += sacks;
+
+	/* Clear ACK-pending flags, since this segment carries the ACK */
+	tcp->flags &= ~( TCP_ACK_PENDING | TCP_ACK_NOW );
+	tcp->rcv_unacked = 0;
+	stop_timer ( &tcp->delack );
+
+	profile_stop ( &tcp_tx_profiler );
+	return 0;
+}
+
+/**
+ * Calculate path MTU probe length
+ *
+ * @v tcp		TCP connection
+ * @ret len		Length of probe to send, or zero
+ *
+ * Packetization layer path MTU discovery (RFC 4821) sends new data
+ * as a single larger-than-usual segment, and adopts the larger
+ * segment size only once this probe has been acknowledged.  The
+ * first probe uses the largest segment size permitted by the local
+ * link and by the peer; subsequent probes perform a binary search.
+ */
+static size_t tcp_probe_len ( struct tcp_connection *tcp ) {
+	size_t len;
+
+	/* Do not probe while a probe is outstanding, during recovery,
+	 * or when retransmitting.
+	 */
+	if ( tcp->probe_len || ( tcp->flags & TCP_RECOVERY ) ||
+	     ( tcp->snd_sent < tcp->snd_max ) )
+		return 0;
+
+	/* Choose probe length */
+	if ( tcp->fail_mss > tcp->max_mss ) {
+		len = tcp->max_mss;
+	} else {
+		len = ( ( tcp->snd_mss + tcp->fail_mss ) / 2 );
+	}
+	if ( len < ( tcp->snd_mss + TCP_PROBE_MIN_STEP ) )
+		return 0;
+
+	return len;
+}
+
+/**
+ * Check if pending acknowledgement may be delayed
+ *
+ * @v tcp		TCP connection
+ * @ret delayable	Acknowledgement may be delayed
+ *
+ * As per RFC 1122 section 4.2.3.2, an acknowledgement of in-order
+ * data may be delayed, but at least every second full-sized segment
+ * must be acknowledged.  A coalesced receive buffer covering more
+ * than one full-sized segment is therefore acknowledged immediately.
+ */
+static int tcp_ack_delayable ( struct tcp_connection *tcp ) {
+
+	return ( ( ! ( tcp->flags & TCP_ACK_NOW ) ) &&
+		 ( tcp->rcv_unacked != 0 ) &&
+		 ( tcp->rcv_unacked <= tcp->mss ) );
+}
+
+/**
+ * Transmit any outstanding data (with selective acknowledgement)
+ *
+ * @v tcp		TCP connection
+ * @v sack_seq		SEQ for first selective acknowledgement (if any)
+ * 
+ * Transmits any outstanding data on the connection, as permitted by
+ * the send window.
+ *
+ * Note that even if an error is returned, the retransmission timer
+ * will have been started if necessary, and so the stack will
+ * eventually attempt to retransmit the failed packet.
+ */
+static void tcp_xmit_sack ( struct tcp_connection *tcp, uint32_t sack_seq ) {
+	unsigned int flags;
+	uint32_t offset;
+	uint32_t seq_len;
+	size_t probe;
+	size_t len;
+
+	/* Transmit as many segments as are permitted */
+	flags = TCP_FLAGS_SENDING ( tcp->tcp_state );
+	do {
+
+		/* Calculate both the actual (payload) and sequence
+		 * space lengths that we wish to transmit.
+		 */
+		len = 0;
+		probe = 0;
+		if ( flags & ( TCP_SYN | TCP_FIN ) ) {
+
+			/* SYN or FIN consume one byte, and we can
+			 * never send both.  SYN and FIN are always
+			 * sent in isolation, so do nothing if the
+			 * retransmission timer is already running.
+			 */
+			assert ( ! ( ( flags & TCP_SYN ) &&
+				     ( flags & TCP_FIN ) ) );
+			if ( timer_running ( &tcp->timer ) )
+				return;
+			tcp->snd_sent = 0;
+			seq_len = 1;
+
+		} else {
+
+			/* Send as much data as the window allows.
+			 * Send a path MTU probe only if there is
+			 * enough data to fill it.  Avoid sending a
+			 * small segment while data remains in flight,
+			 * if more data is waiting to be sent (as per
+			 * RFC 1122 section 4.2.3.4).
+			 */
+			probe = tcp_probe_len ( tcp );
+			len = tcp_process_tx_queue ( tcp, tcp->snd_sent,
+						     tcp_xmit_win ( tcp, probe ),
+						     NULL, 0 );
+			if ( len < probe ) {
+				probe = 0;
+				if ( len > tcp->snd_mss )
+					len = tcp->snd_mss;
+			}
+			if ( ( len < tcp->snd_mss ) && tcp->snd_sent &&
+			     ( ( tcp->tx_queued - tcp->snd_sent ) > len ) ) {
+				len = 0;
+			}
+			seq_len = len;
+		}
+
+		/* If we have nothing to transmit, stop now */
+		if ( ( seq_len == 0 ) && ! ( tcp->flags & TCP_ACK_PENDING ) )
+			return;
+
+		/* If we have only a delayable ACK to transmit, start
+		 * the delayed acknowledgement timer (if not already
+		 * running) and stop now.
+		 */
+		if ( ( seq_len == 0 ) && tcp_ack_delayable ( tcp ) ) {
+			if ( ! timer_running ( &tcp->delack ) ) {
+				start_timer_fixed ( &tcp->delack,
+						    TCP_DELAYED_ACK_TIMEOUT );
+			}
+			return;
+		}
+
+		/* Record transmitted sequence space */
+		offset = tcp->snd_sent;
+		if ( seq_len && ( offset < tcp->snd_max ) )
+			tcp->stats.retransmits++;
+		tcp->snd_sent += seq_len;
+		if ( tcp->snd_max < tcp->snd_sent )
+			tcp->snd_max = tcp->snd_sent;
+
+		/* If we are transmitting anything that requires
+		 * acknowledgement (i.e. consumes sequence space),
+		 * start the retransmission timer (if not already
+		 * running).  Do this before attempting to allocate
+		 * the I/O buffer, in case allocation itself fails.
+		 */
+		if ( seq_len && ( ! timer_running ( &tcp->timer ) ) )
+			start_timer ( &tcp->timer );
+
+		/* Record path MTU probe, if applicable */
+		if ( probe ) {
+			tcp->probe_seq = ( tcp->snd_seq + offset );
+			tcp->probe_len = probe;
+			DBGC ( tcp, "TCP %p probing path MTU with %08x..%08x\n",
+			       tcp, tcp->probe_seq,
+			       ( ( uint32_t ) ( tcp->probe_seq + probe ) ) );
+		}
+
+		/* Transmit segment */
+		if ( tcp_xmit_segment ( tcp, offset, len, flags,
+					sack_seq ) != 0 )
+			return;
+
+	} while ( seq_len );
+}
+
+/**
+ * Find end of selectively acknowledged data
+ *
+ * @v tcp		TCP connection
+ * @v seq		Sequence number
+ * @ret end		End of SACK block containing @c seq, or @c seq
+ */
+static uint32_t tcp_sacked ( struct tcp_connection *tcp, uint32_t seq ) {
+	struct tcp_sack_block *sack;
+	unsigned int i;
 
-	/* Calculate both the actual (payload) and sequence space
-	 * lengths that we wish to transmit.
-	 */
-	if ( TCP_CAN_SEND_DATA ( tcp->tcp_state ) ) {
-		len = tcp_process_tx_queue ( tcp, tcp_xmit_win ( tcp ),
-					     NULL, 0 );
-	}
-	seq_len = len;
-	flags = TCP_FLAGS_SENDING ( tcp->tcp_state );
-	if ( flags & ( TCP_SYN | TCP_FIN ) ) {
-		/* SYN or FIN consume one byte, and we can never send both */
-		assert ( ! ( ( flags & TCP_SYN ) && ( flags & TCP_FIN ) ) );
-		seq_len++;
+	for ( i = 0 ; i < TCP_RX_SACK_MAX ; i++ ) {
+		sack = &tcp->snd_sack[i];
+		if ( ( tcp_cmp ( seq, sack->left ) >= 0 ) &&
+		     ( tcp_cmp ( seq, sack->right ) < 0 ) )
+			return sack->right;
 	}
-	tcp->snd_sent = seq_len;
+	return seq;
+}
 
-	/* If we have nothing to transmit, stop now */
-	if ( ( seq_len == 0 ) && ! ( tcp->flags & TCP_ACK_PENDING ) )
-		return;
+/**
+ * Retransmit lost data during fast recovery
+ *
+ * @v tcp		TCP connection
+ *
+ * Retransmits the holes in the sequence space lying below the highest
+ * selectively acknowledged sequence number or, if no selective
+ * acknowledgements are available, the first unacknowledged segment.
+ * Each hole is retransmitted at most once per recovery, and at most
+ * one congestion window's worth of data is retransmitted per call.
+ */
+static void tcp_xmit_holes ( struct tcp_connection *tcp ) {
+	struct tcp_sack_block *sack;
+	unsigned int flags = TCP_FLAGS_SENDING ( tcp->tcp_state );
+	uint32_t budget = tcp->cong.cwnd;
+	uint32_t highest;
+	uint32_t seq;
+	uint32_t end;
+	uint32_t len;
+	unsigned int i;
 
-	/* If we are transmitting anything that requires
-	 * acknowledgement (i.e. consumes sequence space), start the
-	 * retransmission timer.  Do this before attempting to
-	 * allocate the I/O buffer, in case allocation itself fails.
-	 */
-	if ( seq_len )
-		start_timer ( &tcp->timer );
+	/* Identify highest selectively acknowledged sequence number */
+	highest = tcp->snd_seq;
+	for ( i = 0 ; i < TCP_RX_SACK_MAX ; i++ ) {
+		sack = &tcp->snd_sack[i];
+		if ( ( sack->left != sack->right ) &&
+		     ( tcp_cmp ( sack->right, highest ) > 0 ) )
+			highest = sack->right;
+	}
 
-	/* Allocate I/O buffer */
-	iobuf = alloc_iob ( len + TCP_MAX_HEADER_LEN );
-	if ( ! iobuf ) {
-		DBGC ( tcp, "TCP %p could not allocate iobuf for %08x..%08x "
-		       "%08x\n", tcp, tcp->snd_seq, ( tcp->snd_seq + seq_len ),
-		       tcp->rcv_ack );
-		return;
+	/* With no selective acknowledgements, assume that only the
+	 * first unacknowledged segment has been lost.
+	 */
+	if ( highest == tcp->snd_seq ) {
+		len = tcp->snd_sent;
+		if ( len > tcp->snd_mss )
+			len = tcp->snd_mss;
+		highest += len;
 	}
-	iob_reserve ( iobuf, TCP_MAX_HEADER_LEN );
 
-	/* Fill data payload from transmit queue */
-	tcp_process_tx_queue ( tcp, len, iobuf, 0 );
+	/* Resume from the first byte not yet retransmitted */
+	seq = tcp->snd_seq;
+	if ( tcp_cmp ( tcp->snd_rexmit, seq ) > 0 )
+		seq = tcp->snd_rexmit;
 
-	/* Expand receive window if possible */
-	max_rcv_win = xfer_window ( &tcp->xfer );
-	if ( max_rcv_win > TCP_MAX_WINDOW_SIZE )
-		max_rcv_win = TCP_MAX_WINDOW_SIZE;
-	max_representable_win = ( 0xffff << tcp->rcv_win_scale );
-	if ( max_rcv_win > max_representable_win )
-		max_rcv_win = max_representable_win;
-	max_rcv_win &= ~0x03; /* Keep everything dword-aligned */
-	if ( tcp->rcv_win < max_rcv_win )
-		tcp->rcv_win = max_rcv_win;
+	/* Retransmit each hole */
+	while ( ( tcp_cmp ( seq, highest ) < 0 ) && budget ) {
 
-	/* Fill up the TCP header */
-	payload = iobuf->data;
-	if ( flags & TCP_SYN ) {
-		mssopt = iob_push ( iobuf, sizeof ( *mssopt ) );
-		mssopt->kind = TCP_OPTION_MSS;
-		mssopt->length = sizeof ( *mssopt );
-		mssopt->mss = htons ( tcp->mss );
-		wsopt = iob_push ( iobuf, sizeof ( *wsopt ) );
-		wsopt->nop = TCP_OPTION_NOP;
-		wsopt->wsopt.kind = TCP_OPTION_WS;
-		wsopt->wsopt.length = sizeof ( wsopt->wsopt );
-		wsopt->wsopt.scale = TCP_RX_WINDOW_SCALE;
-		spopt = iob_push ( iobuf, sizeof ( *spopt ) );
-		memset ( spopt->nop, TCP_OPTION_NOP, sizeof ( spopt ) );
-		spopt->spopt.kind = TCP_OPTION_SACK_PERMITTED;
-		spopt->spopt.length = sizeof ( spopt->spopt );
-	}
-	if ( ( flags & TCP_SYN ) || ( tcp->flags & TCP_TS_ENABLED ) ) {
-		tsopt = iob_push ( iobuf, sizeof ( *tsopt ) );
-		memset ( tsopt->nop, TCP_OPTION_NOP, sizeof ( tsopt->nop ) );
-		tsopt->tsopt.kind = TCP_OPTION_TS;
-		tsopt->tsopt.length = sizeof ( tsopt->tsopt );
-		tsopt->tsopt.tsval = htonl ( currticks() );
-		tsopt->tsopt.tsecr = htonl ( tcp->ts_recent );
-	}
-	if ( ( tcp->flags & TCP_SACK_ENABLED ) &&
-	     ( ! list_empty ( &tcp->rx_queue ) ) &&
-	     ( ( sack_count = tcp_sack ( tcp, sack_seq ) ) != 0 ) ) {
-		sack_len = ( sack_count * sizeof ( *sack ) );
-		sackopt = iob_push ( iobuf, ( sizeof ( *sackopt ) + sack_len ));
-		memset ( sackopt->nop, TCP_OPTION_NOP, sizeof ( sackopt->nop ));
-		sackopt->sackopt.kind = TCP_OPTION_SACK;
-		sackopt->sackopt.length =
-			( sizeof ( sackopt->sackopt ) + sack_len );
-		sack = ( ( ( void * ) sackopt ) + sizeof ( *sackopt ) );
-		for ( i = 0 ; i < sack_count ; i++, sack++ ) {
-			sack->left = htonl ( tcp->sack[i].left );
-			sack->right = htonl ( tcp->sack[i].right );
+		/* Skip any selectively acknowledged data */
+		end = tcp_sacked ( tcp, seq );
+		if ( end != seq ) {
+			seq = end;
+			continue;
 		}
-	}
-	if ( len != 0 )
-		flags |= TCP_PSH;
-	tcphdr = iob_push ( iobuf, sizeof ( *tcphdr ) );
-	memset ( tcphdr, 0, sizeof ( *tcphdr ) );
-	tcphdr->src = htons ( tcp->local_port );
-	tcphdr->dest = tcp->peer.st_port;
-	tcphdr->seq = htonl ( tcp->snd_seq );
-	tcphdr->ack = htonl ( tcp->rcv_ack );
-	tcphdr->hlen = ( ( payload - iobuf->data ) << 2 );
-	tcphdr->flags = flags;
-	tcphdr->win = htons ( tcp->rcv_win >> tcp->rcv_win_scale );
-	tcphdr->csum = tcpip_chksum ( iobuf->data, iob_len ( iobuf ) );
 
-	/* Dump header */
-	DBGC2 ( tcp, "TCP %p TX %d->%d %08x..%08x           %08x %4zd",
-		tcp, ntohs ( tcphdr->src ), ntohs ( tcphdr->dest ),
-		ntohl ( tcphdr->seq ), ( ntohl ( tcphdr->seq ) + seq_len ),
-		ntohl ( tcphdr->ack ), len );
-	tcp_dump_flags ( tcp, tcphdr->flags );
-	DBGC2 ( tcp, "\n" );
+		/* Find end of hole */
+		end = highest;
+		for ( i = 0 ; i < TCP_RX_SACK_MAX ; i++ ) {
+			sack = &tcp->snd_sack[i];
+			if ( ( tcp_cmp ( sack->left, seq ) > 0 ) &&
+			     ( tcp_cmp ( sack->left, end ) < 0 ) )
+				end = sack->left;
+		}
 
-	/* Transmit packet */
-	if ( ( rc = tcpip_tx ( iobuf, &tcp_protocol, NULL, &tcp->peer, NULL,
-			       &tcphdr->csum ) ) != 0 ) {
-		DBGC ( tcp, "TCP %p could not transmit %08x..%08x %08x: %s\n",
-		       tcp, tcp->snd_seq, ( tcp->snd_seq + tcp->snd_sent ),
-		       tcp->rcv_ack, strerror ( rc ) );
-		return;
+		/* Retransmit (part of) hole */
+		len = ( end - seq );
+		if ( len > tcp->snd_mss )
+			len = tcp->snd_mss;
+		if ( len > budget )
+			len = budget;
+		DBGC ( tcp, "TCP %p retransmitting %08x..%08x\n",
+		       tcp, seq, ( seq + len ) );
+		if ( tcp_xmit_segment ( tcp, ( seq - tcp->snd_seq ), len,
+					flags, tcp->rcv_ack ) != 0 )
+			break;
+		tcp->stats.retransmits++;
+		seq += len;
+		budget -= len;
+		tcp->snd_rexmit = seq;
 	}
-
-	/* Clear ACK-pending flag */
-	tcp->flags &= ~TCP_ACK_PENDING;
-
-	profile_stop ( &tcp_tx_profiler );
 }
 
 /**
@@ -775,6 +1632,35 @@ static void tcp_xmit ( struct tcp_connection *tcp ) {
 static struct process_descriptor tcp_process_desc =
 	PROC_DESC_ONCE ( struct tcp_connection, process, tcp_xmit );
 
+/**
+ * Conclude path MTU probe following loss
+ *
+ * @v tcp		TCP connection
+ *
+ * This is called when loss is detected.  A probe which has not been
+ * selectively acknowledged is assumed to have been lost due to its
+ * size.
+ */
+static void tcp_probe_lost ( struct tcp_connection *tcp ) {
+	uint32_t end = ( tcp->probe_seq + tcp->probe_len );
+
+	/* Do nothing unless a probe is outstanding */
+	if ( ! tcp->probe_len )
+		return;
+
+	/* Record probe result */
+	if ( tcp_cmp ( tcp_sacked ( tcp, tcp->probe_seq ), end ) >= 0 ) {
+		tcp->snd_mss = tcp->probe_len;
+		DBGC ( tcp, "TCP %p path MTU probe succeeded (MSS %zd)\n",
+		       tcp, tcp->snd_mss );
+	} else {
+		tcp->fail_mss = tcp->probe_len;
+		DBGC ( tcp, "TCP %p path MTU probe failed (MSS %zd)\n",
+		       tcp, tcp->fail_mss );
+	}
+	tcp->probe_len = 0;
+}
+
 /**
  * Retransmission timer expired
  *
@@ -804,7 +1690,27 @@ static void tcp_expired ( struct retry_timer *timer, int over ) {
 		tcp_dump_state ( tcp );
 		tcp_close ( tcp, -ETIMEDOUT );
 	} else {
-		/* Otherwise, retransmit the packet */
+		/* Otherwise, update the congestion control state and
+		 * retransmit starting from the first unacknowledged
+		 * packet.
+		 */
+		tcp->stats.timeouts++;
+		tcp_probe_lost ( tcp );
+		if ( tcp->snd_max ) {
+			tcp->cong_algorithm->timeout ( &tcp->cong,
+						       tcp->snd_mss,
+						       tcp->snd_max );
+		}
+
+		/* Abandon any fast recovery, and disregard any
+		 * duplicate acknowledgements for data sent prior to
+		 * the timeout (as per RFC 6582 section 3.2 step 4).
+		 */
+		tcp->flags &= ~TCP_RECOVERY;
+		tcp->dupacks = 0;
+		tcp->snd_recover = ( tcp->snd_seq + tcp->snd_max );
+		memset ( tcp->snd_sack, 0, sizeof ( tcp->snd_sack ) );
+		tcp->snd_sent = 0;
 		tcp_xmit ( tcp );
 	}
 }
@@ -831,7 +1737,7 @@ static void tcp_keepalive_expired ( struct retry_timer *timer,
 	 * that the peer is still alive.  We therefore send just a
 	 * pure ACK, to keep our transmit path simple.
 	 */
-	tcp->flags |= TCP_ACK_PENDING;
+	tcp->flags |= ( TCP_ACK_PENDING | TCP_ACK_NOW );
 	tcp_xmit ( tcp );
 }
 
@@ -856,6 +1762,25 @@ static void tcp_wait_expired ( struct retry_timer *timer, int over __unused ) {
 	tcp_close ( tcp, 0 );
 }
 
+/**
+ * Delayed acknowledgement timer expired
+ *
+ * @v timer		Delayed acknowledgement timer
+ * @v over		Failure indicator
+ */
+static void tcp_delack_expired ( struct retry_timer *timer,
+				 int over __unused ) {
+	struct tcp_connection *tcp =
+		container_of ( timer, struct tcp_connection, delack );
+
+	DBGC2 ( tcp, "TCP %p sending delayed ACK for %08x\n",
+		tcp, tcp->rcv_ack );
+
+	/* Send pending ACK */
+	tcp->flags |= TCP_ACK_NOW;
+	tcp_xmit ( tcp );
+}
+
 /**
  * Send RST response to incoming packet
  *
@@ -889,7 +1814,7 @@ static int tcp_xmit_reset ( struct tcp_connection *tcp,
 	tcphdr->hlen = ( ( sizeof ( *tcphdr ) / 4 ) << 4 );
 	tcphdr->flags = ( TCP_RST | TCP_ACK );
 	tcphdr->win = htons ( 0 );
-	tcphdr->csum = tcpip_chksum ( iobuf->data, iob_len ( iobuf ) );
+	iobuf->flags |= IOB_FL_CSUM_PENDING;
 
 	/* Dump header */
 	DBGC2 ( tcp, "TCP %p TX %d->%d %08x..%08x           %08x %4d",
@@ -923,14 +1848,24 @@ static int tcp_xmit_reset ( struct tcp_connection *tcp,
  * Identify TCP connection by local port number
  *
  * @v local_port	Local port
+ * @v peer		Peer socket address, or NULL to match any peer
  * @ret tcp		TCP connection, or NULL
+ *
+ * Actively opened connections each have a unique local port.
+ * Passively opened connections share the server's local port, and
+ * are distinguished by the peer socket address.
  */
-static struct tcp_connection * tcp_demux ( unsigned int local_port ) {
+static struct tcp_connection * tcp_demux ( unsigned int local_port,
+					    struct sockaddr_tcpip *peer ) {
 	struct tcp_connection *tcp;
 
-	list_for_each_entry ( tcp, &tcp_conns, list ) {
-		if ( tcp->local_port == local_port )
-			return tcp;
+	list_for_each_entry ( tcp, tcp_bucket ( local_port ), hash ) {
+		if ( tcp->local_port != local_port )
+			continue;
+		if ( peer && ( tcp->flags & TCP_PASSIVE ) &&
+		     ( memcmp ( &tcp->peer, peer, sizeof ( *peer ) ) != 0 ) )
+			continue;
+		return tcp;
 	}
 	return NULL;
 }
@@ -977,7 +1912,8 @@ static int tcp_rx_opts ( struct tcp_connection *tcp,
 		min = sizeof ( *option );
 		switch ( kind ) {
 		case TCP_OPTION_MSS:
-			/* Ignore received MSS */
+			options->mssopt = data;
+			min = sizeof ( *options->mssopt );
 			break;
 		case TCP_OPTION_WS:
 			options->wsopt = data;
@@ -988,7 +1924,8 @@ static int tcp_rx_opts ( struct tcp_connection *tcp,
 			min = sizeof ( *options->spopt );
 			break;
 		case TCP_OPTION_SACK:
-			/* Ignore received SACKs */
+			options->sackopt = data;
+			min = sizeof ( *options->sackopt );
 			break;
 		case TCP_OPTION_TS:
 			options->tsopt = data;
@@ -1057,6 +1994,7 @@ static void tcp_rx_seq ( struct tcp_connection *tcp, uint32_t seq_len ) {
 
 	/* Mark ACK as pending */
 	tcp->flags |= TCP_ACK_PENDING;
+	tcp->rcv_unacked += seq_len;
 }
 
 /**
@@ -1069,10 +2007,25 @@ static void tcp_rx_seq ( struct tcp_connection *tcp, uint32_t seq_len ) {
  */
 static int tcp_rx_syn ( struct tcp_connection *tcp, uint32_t seq,
 			struct tcp_options *options ) {
+	size_t max_mss;
 
 	/* Synchronise sequence numbers on first SYN */
 	if ( ! ( tcp->tcp_state & TCP_STATE_RCVD ( TCP_SYN ) ) ) {
 		tcp->rcv_ack = seq;
+
+		/* Calculate largest permissible segment size.  The
+		 * MSS option excludes any TCP options, as per RFC
+		 * 6691.  We never use less than the initial path MTU.
+		 */
+		max_mss = tcp->mss;
+		if ( options->mssopt &&
+		     ( ntohs ( options->mssopt->mss ) < max_mss ) )
+			max_mss = ntohs ( options->mssopt->mss );
+		if ( max_mss > ( tcp->max_mss + TCP_MAX_DATA_OPTIONS_LEN ) ) {
+			tcp->max_mss = ( max_mss - TCP_MAX_DATA_OPTIONS_LEN );
+			tcp->fail_mss = ( tcp->max_mss + 1 );
+		}
+
 		if ( options->tsopt )
 			tcp->flags |= TCP_TS_ENABLED;
 		if ( options->spopt )
@@ -1082,11 +2035,11 @@ static int tcp_rx_syn ( struct tcp_connection *tcp, uint32_t seq,
 			tcp->rcv_win_scale = TCP_RX_WINDOW_SCALE;
 		}
 		DBGC ( tcp, "TCP %p using %stimestamps, %sSACK, TX window "
-		       "x%d, RX window x%d\n", tcp,
+		       "x%d, RX window x%d, MSS up to %zd\n", tcp,
 		       ( ( tcp->flags & TCP_TS_ENABLED ) ? "" : "no " ),
 		       ( ( tcp->flags & TCP_SACK_ENABLED ) ? "" : "no " ),
 		       ( 1 << tcp->snd_win_scale ),
-		       ( 1 << tcp->rcv_win_scale ) );
+		       ( 1 << tcp->rcv_win_scale ), tcp->max_mss );
 	}
 
 	/* Ignore duplicate SYN */
@@ -1103,26 +2056,163 @@ static int tcp_rx_syn ( struct tcp_connection *tcp, uint32_t seq,
 	return 0;
 }
 
+/**
+ * Record TCP received selective acknowledgements
+ *
+ * @v tcp		TCP connection
+ * @v ack		ACK value (in host-endian order)
+ * @v sackopt		SACK option, or NULL
+ */
+static void tcp_rx_sack ( struct tcp_connection *tcp, uint32_t ack,
+			  const struct tcp_sack_option *sackopt ) {
+	const struct tcp_sack_block *block;
+	uint32_t max = ( tcp->snd_seq + tcp->snd_max );
+	uint32_t left;
+	uint32_t right;
+	unsigned int count;
+	unsigned int i = 0;
+
+	/* Discard any previous selective acknowledgements */
+	memset ( tcp->snd_sack, 0, sizeof ( tcp->snd_sack ) );
+
+	/* Do nothing unless SACK is enabled and present */
+	if ( ! ( ( tcp->flags & TCP_SACK_ENABLED ) && sackopt ) )
+		return;
+
+	/* Record each plausible block */
+	block = ( ( const void * ) ( sackopt + 1 ) );
+	count = ( ( sackopt->length - sizeof ( *sackopt ) ) /
+		  sizeof ( *block ) );
+	for ( ; count-- && ( i < TCP_RX_SACK_MAX ) ; block++ ) {
+		left = ntohl ( block->left );
+		right = ntohl ( block->right );
+		if ( ( tcp_cmp ( left, ack ) <= 0 ) ||
+		     ( tcp_cmp ( right, left ) <= 0 ) ||
+		     ( tcp_cmp ( right, max ) > 0 ) ) {
+			DBGC2 ( tcp, "TCP %p ignoring SACK %08x..%08x\n",
+				tcp, left, right );
+			continue;
+		}
+		tcp->snd_sack[i].left = left;
+		tcp->snd_sack[i].right = right;
+		i++;
+	}
+	tcp->stats.rx_sacks += i;
+}
+
+/**
+ * Handle TCP received duplicate ACK
+ *
+ * @v tcp		TCP connection
+ */
+static void tcp_rx_dupack ( struct tcp_connection *tcp ) {
+
+	/* Retransmit any newly reported holes if already recovering */
+	if ( tcp->flags & TCP_RECOVERY ) {
+		tcp_xmit_holes ( tcp );
+		return;
+	}
+
+	/* Do nothing until the threshold is reached */
+	if ( ++tcp->dupacks < TCP_DUPACK_THRESHOLD )
+		return;
+
+	/* Do nothing if a SYN or FIN is outstanding */
+	if ( TCP_FLAGS_SENDING ( tcp->tcp_state ) & ( TCP_SYN | TCP_FIN ) )
+		return;
+
+	/* Ignore duplicate ACKs for data sent before the most recent
+	 * loss, as per RFC 6582 section 3.2 step 2.
+	 */
+	if ( tcp_cmp ( tcp->snd_seq, tcp->snd_recover ) < 0 )
+		return;
+
+	/* Enter fast recovery */
+	tcp->stats.recoveries++;
+	tcp->flags |= TCP_RECOVERY;
+	tcp->snd_recover = ( tcp->snd_seq + tcp->snd_max );
+	tcp->snd_rexmit = tcp->snd_seq;
+	tcp_probe_lost ( tcp );
+	tcp->cong_algorithm->loss ( &tcp->cong, tcp->snd_mss, tcp->snd_sent );
+	DBGC ( tcp, "TCP %p entering recovery for %08x..%08x\n",
+	       tcp, tcp->snd_seq, tcp->snd_recover );
+
+	/* Fast retransmit */
+	tcp_xmit_holes ( tcp );
+}
+
+/**
+ * Update round-trip time estimate
+ *
+ * @v tcp		TCP connection
+ * @v tsecr		Echoed timestamp (in host-endian order)
+ *
+ * Round-trip times are measured using the echoed timestamp (as per
+ * RFC 7323 section 4), which remains valid even for acknowledgements
+ * of retransmitted segments.  The retransmission timeout is then
+ * calculated as per RFC 6298 section 2, and replaces the generic
+ * retry timer's own estimate.
+ */
+static void tcp_rx_rtt ( struct tcp_connection *tcp, uint32_t tsecr ) {
+	uint32_t rtt = ( currticks() - tsecr );
+	unsigned long rto;
+	long delta;
+
+	/* Ignore implausible samples */
+	if ( rtt > TCP_MAX_RTT )
+		return;
+
+	/* Update smoothed round-trip time and variation */
+	if ( tcp->flags & TCP_RTT_VALID ) {
+		delta = ( rtt - ( tcp->srtt >> 3 ) );
+		tcp->srtt += delta;
+		if ( delta < 0 )
+			delta = -delta;
+		tcp->rttvar += ( delta - ( tcp->rttvar >> 2 ) );
+	} else {
+		tcp->srtt = ( rtt << 3 );
+		tcp->rttvar = ( rtt << 1 );
+		tcp->flags |= TCP_RTT_VALID;
+	}
+
+	/* Calculate retransmission timeout, allowing for a clock
+	 * granularity of one tick.
+	 */
+	rto = ( ( tcp->srtt >> 3 ) + ( tcp->rttvar ? tcp->rttvar : 1 ) );
+	if ( tcp->timer.timeout != rto ) {
+		DBGC2 ( tcp, "TCP %p RTT %d SRTT %ld RTTVAR %ld RTO %ld\n",
+			tcp, rtt, ( tcp->srtt >> 3 ), ( tcp->rttvar >> 2 ),
+			rto );
+	}
+	tcp->timer.timeout = rto;
+	tcp->timer.min = TCP_MIN_RTO;
+	tcp->timer.count = 0;
+}
+
 /**
  * Handle TCP received ACK
  *
  * @v tcp		TCP connection
  * @v ack		ACK value (in host-endian order)
  * @v win		WIN value (in host-endian order)
+ * @v options		TCP options, or NULL
+ * @v data_len		Length of data carried with ACK
  * @ret rc		Return status code
  */
 static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
-			uint32_t win ) {
+			uint32_t win, const struct tcp_options *options,
+			size_t data_len ) {
 	uint32_t ack_len = ( ack - tcp->snd_seq );
+	uint32_t old_win = tcp->snd_win;
 	size_t len;
 	unsigned int acked_flags;
 
 	/* Check for out-of-range or old duplicate ACKs */
-	if ( ack_len > tcp->snd_sent ) {
+	if ( ack_len > tcp->snd_max ) {
 		DBGC ( tcp, "TCP %p received ACK for %08x..%08x, "
 		       "sent only %08x..%08x\n", tcp, tcp->snd_seq,
 		       ( tcp->snd_seq + ack_len ), tcp->snd_seq,
-		       ( tcp->snd_seq + tcp->snd_sent ) );
+		       ( tcp->snd_seq + tcp->snd_max ) );
 
 		if ( TCP_HAS_BEEN_ESTABLISHED ( tcp->tcp_state ) ) {
 			/* Just ignore what might be old duplicate ACKs */
@@ -1137,8 +2227,13 @@ static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
 	}
 
 	/* Update window size */
+	if ( ( win == 0 ) && ( old_win != 0 ) )
+		tcp->stats.zero_windows++;
 	tcp->snd_win = win;
 
+	/* Record selective acknowledgements */
+	tcp_rx_sack ( tcp, ack, ( options ? options->sackopt : NULL ) );
+
 	/* Hold off (or start) the keepalive timer, if applicable */
 	if ( ! ( tcp->tcp_state & TCP_STATE_SENT ( TCP_FIN ) ) )
 		start_timer_fixed ( &tcp->keepalive, TCP_KEEPALIVE_DELAY );
@@ -1148,13 +2243,28 @@ static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
 	 * avoids creating a sorceror's apprentice syndrome when a
 	 * duplicate ACK is received and we still have data in our
 	 * transmit queue.)
+	 *
+	 * An ACK that carries no data and does not change the window
+	 * while data is outstanding is a duplicate ACK, which may
+	 * indicate a lost segment.
 	 */
-	if ( ack_len == 0 )
+	if ( ack_len == 0 ) {
+		if ( options && ( data_len == 0 ) && ( win == old_win ) &&
+		     tcp->snd_sent ) {
+			tcp_rx_dupack ( tcp );
+		}
 		return 0;
+	}
 
 	/* Stop the retransmission timer */
 	stop_timer ( &tcp->timer );
 
+	/* Update round-trip time estimate, if possible */
+	if ( ( tcp->flags & TCP_TS_ENABLED ) && options && options->tsopt &&
+	     options->tsopt->tsecr ) {
+		tcp_rx_rtt ( tcp, ntohl ( options->tsopt->tsecr ) );
+	}
+
 	/* Determine acknowledged flags and data length */
 	len = ack_len;
 	acked_flags = ( TCP_FLAGS_SENDING ( tcp->tcp_state ) &
@@ -1162,15 +2272,52 @@ static int tcp_rx_ack ( struct tcp_connection *tcp, uint32_t ack,
 	if ( acked_flags ) {
 		len--;
 		pending_put ( &tcp->pending_flags );
+		if ( acked_flags & TCP_SYN ) {
+			timeline_record ( "tcp", "established",
+					  sock_ntoa ( ( struct sockaddr * )
+						      &tcp->peer ), 0 );
+		}
 	}
 
 	/* Update SEQ and sent counters */
 	tcp->snd_seq = ack;
-	tcp->snd_sent = 0;
+	tcp->snd_sent = ( ( tcp->snd_sent > ack_len ) ?
+			  ( tcp->snd_sent - ack_len ) : 0 );
+	tcp->snd_max -= ack_len;
 
 	/* Remove any acknowledged data from transmit queue */
-	tcp_process_tx_queue ( tcp, len, NULL, 1 );
-		
+	tcp_process_tx_queue ( tcp, 0, len, NULL, 1 );
+
+	/* Adopt larger segment size once path MTU probe is acknowledged */
+	if ( tcp->probe_len &&
+	     ( tcp_cmp ( ack, ( tcp->probe_seq + tcp->probe_len ) ) >= 0 ) ) {
+		tcp->snd_mss = tcp->probe_len;
+		tcp->probe_len = 0;
+		DBGC ( tcp, "TCP %p path MTU probe succeeded (MSS %zd)\n",
+		       tcp, tcp->snd_mss );
+	}
+
+	/* Update congestion window and recovery state */
+	tcp->dupacks = 0;
+	if ( ! ( tcp->flags & TCP_RECOVERY ) ) {
+		if ( len ) {
+			tcp->cong_algorithm->acked ( &tcp->cong, tcp->snd_mss,
+						     len );
+		}
+	} else if ( tcp_cmp ( ack, tcp->snd_recover ) >= 0 ) {
+		DBGC ( tcp, "TCP %p completed recovery at %08x\n", tcp, ack );
+		tcp->flags &= ~TCP_RECOVERY;
+	} else {
+		/* Partial acknowledgement: retransmit the next hole */
+		tcp_xmit_holes ( tcp );
+	}
+
+	/* Restart the retransmission timer if any data remains in
+	 * flight.
+	 */
+	if ( tcp->snd_sent )
+		start_timer ( &tcp->timer );
+
 	/* Mark SYN/FIN as acknowledged if applicable. */
 	if ( acked_flags )
 		tcp->tcp_state |= TCP_STATE_ACKED ( acked_flags );
@@ -1318,10 +2465,16 @@ static void tcp_rx_enqueue ( struct tcp_connection *tcp, uint32_t seq,
 	     ( tcp_cmp ( seq, tcp->rcv_ack + tcp->rcv_win ) >= 0 ) ||
 	     ( tcp_cmp ( nxt, tcp->rcv_ack ) < 0 ) ||
 	     ( seq_len == 0 ) ) {
+		if ( seq_len )
+			drop_count ( &tcp_window_drops );
 		free_iob ( iobuf );
 		return;
 	}
 
+	/* Record out-of-order segments */
+	if ( tcp_cmp ( seq, tcp->rcv_ack ) > 0 )
+		tcp->stats.rx_ooo++;
+
 	/* Add internal header */
 	tcpqhdr = iob_push ( iobuf, sizeof ( *tcpqhdr ) );
 	tcpqhdr->seq = seq;
@@ -1335,6 +2488,29 @@ static void tcp_rx_enqueue ( struct tcp_connection *tcp, uint32_t seq,
 			break;
 	}
 	list_add_tail ( &iobuf->list, &queued->list );
+	tcp->rx_queued += iob_len ( iobuf );
+	if ( tcp->stats.rx_queued_max < tcp->rx_queued )
+		tcp->stats.rx_queued_max = tcp->rx_queued;
+
+	/* Enforce out-of-order queue budget by discarding the packets
+	 * furthest from the left edge of the window.  Never discard
+	 * the packet at the head of the queue, since it may be
+	 * immediately processable.
+	 */
+	while ( tcp->rx_queued > tcp_max_rx_queued ( tcp ) ) {
+		queued = list_last_entry ( &tcp->rx_queue, struct io_buffer,
+					   list );
+		if ( queued == list_first_entry ( &tcp->rx_queue,
+						  struct io_buffer, list ) )
+			break;
+		tcpqhdr = queued->data;
+		DBGC2 ( tcp, "TCP %p discarding queued %08x..%08x\n",
+			tcp, tcpqhdr->seq, tcpqhdr->nxt );
+		list_del ( &queued->list );
+		tcp->rx_queued -= iob_len ( queued );
+		free_iob ( queued );
+		drop_count ( &tcp_ooo_drops );
+	}
 }
 
 /**
@@ -1364,6 +2540,7 @@ static void tcp_process_rx_queue ( struct tcp_connection *tcp ) {
 
 		/* Strip internal header and remove from RX queue */
 		list_del ( &iobuf->list );
+		tcp->rx_queued -= iob_len ( iobuf );
 		seq = tcpqhdr->seq;
 		flags = tcpqhdr->flags;
 		iob_pull ( iobuf, sizeof ( *tcpqhdr ) );
@@ -1419,40 +2596,48 @@ static int tcp_rx ( struct io_buffer *iobuf,
 		DBG ( "TCP packet too short at %zd bytes (min %zd bytes)\n",
 		      iob_len ( iobuf ), sizeof ( *tcphdr ) );
 		rc = -EINVAL;
-		goto discard;
+		goto err_header;
 	}
 	hlen = ( ( tcphdr->hlen & TCP_MASK_HLEN ) / 16 ) * 4;
 	if ( hlen < sizeof ( *tcphdr ) ) {
 		DBG ( "TCP header too short at %zd bytes (min %zd bytes)\n",
 		      hlen, sizeof ( *tcphdr ) );
 		rc = -EINVAL;
-		goto discard;
+		goto err_header;
 	}
 	if ( hlen > iob_len ( iobuf ) ) {
 		DBG ( "TCP header too long at %zd bytes (max %zd bytes)\n",
 		      hlen, iob_len ( iobuf ) );
 		rc = -EINVAL;
-		goto discard;
+		goto err_header;
 	}
-	csum = tcpip_continue_chksum ( pshdr_csum, iobuf->data,
-				       iob_len ( iobuf ) );
-	if ( csum != 0 ) {
-		DBG ( "TCP checksum incorrect (is %04x including checksum "
-		      "field, should be 0000)\n", csum );
-		rc = -EINVAL;
-		goto discard;
+	if ( ! ( iobuf->flags & IOB_FL_CSUM_VERIFIED ) ) {
+		csum = tcpip_continue_chksum ( pshdr_csum, iobuf->data,
+					       iob_len ( iobuf ) );
+		if ( csum != 0 ) {
+			DBG ( "TCP checksum incorrect (is %04x including "
+			      "checksum field, should be 0000)\n", csum );
+			drop_count ( &tcp_csum_drops );
+			rc = -EINVAL;
+			goto discard;
+		}
 	}
 	
+	/* Identify connection, accepting a new connection if applicable */
+	st_src->st_port = tcphdr->src;
+	tcp = tcp_demux ( ntohs ( tcphdr->dest ), st_src );
+	if ( ( ! tcp ) && ( ( tcphdr->flags & ( TCP_SYN | TCP_ACK |
+						TCP_RST ) ) == TCP_SYN ) ) {
+		tcp = tcp_accept ( ntohs ( tcphdr->dest ), st_src );
+	}
+
 	/* Parse parameters from header and strip header */
-	tcp = tcp_demux ( ntohs ( tcphdr->dest ) );
 	seq = ntohl ( tcphdr->seq );
 	ack = ntohl ( tcphdr->ack );
 	raw_win = ntohs ( tcphdr->win );
 	flags = tcphdr->flags;
 	if ( ( rc = tcp_rx_opts ( tcp, tcphdr, hlen, &options ) ) != 0 )
-		goto discard;
-	if ( tcp && options.tsopt )
-		tcp->ts_val = ntohl ( options.tsopt->tsval );
+		goto err_header;
 	iob_pull ( iobuf, hlen );
 	len = iob_len ( iobuf );
 	seq_len = ( len + ( ( flags & TCP_SYN ) ? 1 : 0 ) +
@@ -1465,30 +2650,66 @@ static int tcp_rx ( struct io_buffer *iobuf,
 		( ntohl ( tcphdr->seq ) + seq_len ), len );
 	tcp_dump_flags ( tcp, tcphdr->flags );
 	DBGC2 ( tcp, "\n" );
+	TRACE ( "tcp_rx_seq", tcp, ntohl ( tcphdr->seq ) );
+	TRACE ( "tcp_rx_len", tcp, len );
 
 	/* If no connection was found, silently drop packet */
 	if ( ! tcp ) {
+		drop_count ( &tcp_noconn_drops );
 		rc = -ENOTCONN;
 		goto discard;
 	}
 
+	/* Update statistics */
+	tcp->stats.rx_segments++;
+	tcp->stats.rx_bytes += len;
+
+	/* Discard old duplicate segments (as per RFC 7323 section 5),
+	 * and record received timestamp.
+	 */
+	if ( options.tsopt ) {
+		if ( ( tcp->flags & TCP_TS_ENABLED ) &&
+		     ( tcp->tcp_state & TCP_STATE_RCVD ( TCP_SYN ) ) &&
+		     ( ! ( flags & TCP_RST ) ) &&
+		     ( tcp_cmp ( ntohl ( options.tsopt->tsval ),
+				 tcp->ts_recent ) < 0 ) ) {
+			DBGC ( tcp, "TCP %p discarding old timestamp %08x "
+			       "(recent %08x)\n", tcp,
+			       ntohl ( options.tsopt->tsval ), tcp->ts_recent );
+			drop_count ( &tcp_paws_drops );
+			tcp->flags |= ( TCP_ACK_PENDING | TCP_ACK_NOW );
+			process_add ( &tcp->process );
+			rc = 0;
+			goto discard;
+		}
+		tcp->ts_val = ntohl ( options.tsopt->tsval );
+	}
+
 	/* Record old data-transfer window */
 	old_xfer_window = tcp_xfer_window ( tcp );
 
 	/* Handle ACK, if present */
 	if ( flags & TCP_ACK ) {
 		win = ( raw_win << tcp->snd_win_scale );
-		if ( ( rc = tcp_rx_ack ( tcp, ack, win ) ) != 0 ) {
+		if ( ( rc = tcp_rx_ack ( tcp, ack, win, &options,
+					 len ) ) != 0 ) {
 			tcp_xmit_reset ( tcp, st_src, tcphdr );
+			drop_count ( &tcp_ack_drops );
 			goto discard;
 		}
 	}
 
-	/* Force an ACK if this packet is out of order */
+	/* Force an immediate ACK if this packet is out of order, or
+	 * if it may fill a gap in the received sequence space (as per
+	 * RFC 5681 section 4.2), or if it carries a SYN or FIN.
+	 */
 	if ( ( tcp->tcp_state & TCP_STATE_RCVD ( TCP_SYN ) ) &&
-	     ( seq != tcp->rcv_ack ) ) {
-		tcp->flags |= TCP_ACK_PENDING;
+	     ( ( seq != tcp->rcv_ack ) ||
+	       ( ! list_empty ( &tcp->rx_queue ) ) ) ) {
+		tcp->flags |= ( TCP_ACK_PENDING | TCP_ACK_NOW );
 	}
+	if ( flags & ( TCP_SYN | TCP_FIN ) )
+		tcp->flags |= TCP_ACK_NOW;
 
 	/* Handle SYN, if present */
 	if ( flags & TCP_SYN ) {
@@ -1498,8 +2719,10 @@ static int tcp_rx ( struct io_buffer *iobuf,
 
 	/* Handle RST, if present */
 	if ( flags & TCP_RST ) {
-		if ( ( rc = tcp_rx_rst ( tcp, seq ) ) != 0 )
+		if ( ( rc = tcp_rx_rst ( tcp, seq ) ) != 0 ) {
+			drop_count ( &tcp_rst_drops );
 			goto discard;
+		}
 	}
 
 	/* Enqueue received data */
@@ -1515,6 +2738,8 @@ static int tcp_rx ( struct io_buffer *iobuf,
 	 * have received any out-of-order packets (i.e. if the receive
 	 * queue remains non-empty after processing) then send the ACK
 	 * immediately in order to trigger Fast Retransmission.
+	 * Otherwise, the transmission process may choose to delay a
+	 * pure ACK of in-order data.
 	 */
 	if ( list_empty ( &tcp->rx_queue ) ) {
 		process_add ( &tcp->process );
@@ -1537,16 +2762,86 @@ static int tcp_rx ( struct io_buffer *iobuf,
 	profile_stop ( &tcp_rx_profiler );
 	return 0;
 
+ err_header:
+	drop_count ( &tcp_header_drops );
  discard:
 	/* Free received packet */
 	free_iob ( iobuf );
 	return rc;
 }
 
+/**
+ * Handle path MTU notification
+ *
+ * @v st_dest		Destination address of original packet
+ * @v data		Transport-layer header of original packet
+ * @v len		Length of transport-layer header (may be truncated)
+ * @v mtu		Path MTU (excluding network-layer header)
+ */
+static void tcp_pmtu ( struct sockaddr_tcpip *st_dest, const void *data,
+		       size_t len, size_t mtu ) {
+	const struct tcp_header *tcphdr = data;
+	struct tcp_connection *tcp;
+	uint32_t offset;
+	size_t mss;
+
+	/* Sanity check.  The ICMP error includes at least the first
+	 * eight bytes of the original segment.
+	 */
+	if ( len < ( offsetof ( struct tcp_header, seq ) +
+		     sizeof ( tcphdr->seq ) ) )
+		return;
+
+	/* Identify connection */
+	st_dest->st_port = tcphdr->dest;
+	tcp = tcp_demux ( ntohs ( tcphdr->src ), st_dest );
+	if ( ! tcp )
+		return;
+
+	/* Ignore notifications for data not in flight, as per RFC
+	 * 5927 section 4.1.
+	 */
+	offset = ( ntohl ( tcphdr->seq ) - tcp->snd_seq );
+	if ( offset >= tcp->snd_max ) {
+		DBGC ( tcp, "TCP %p ignoring path MTU for %08x\n",
+		       tcp, ntohl ( tcphdr->seq ) );
+		return;
+	}
+
+	/* Calculate segment size, never going below the initial
+	 * path MTU.
+	 */
+	mss = ( sizeof ( *tcphdr ) + TCP_MAX_DATA_OPTIONS_LEN +
+		TCP_PATH_MTU );
+	mss = ( ( ( mtu > mss ) ? mtu : mss ) -
+		( sizeof ( *tcphdr ) + TCP_MAX_DATA_OPTIONS_LEN ) );
+	DBGC ( tcp, "TCP %p path MTU %zd (MSS %zd)\n", tcp, mtu, mss );
+
+	/* Never probe beyond the reported path MTU */
+	if ( tcp->max_mss > mss )
+		tcp->max_mss = mss;
+	if ( tcp->fail_mss > ( tcp->max_mss + 1 ) )
+		tcp->fail_mss = ( tcp->max_mss + 1 );
+	if ( tcp->probe_len > mss )
+		tcp->probe_len = 0;
+
+	/* Reduce segment size, and retransmit the affected data
+	 * (which will all have been too large) immediately.
+	 */
+	if ( tcp->snd_mss > mss ) {
+		tcp->snd_mss = mss;
+		if ( tcp->snd_sent > offset ) {
+			tcp->snd_sent = offset;
+			tcp_xmit ( tcp );
+		}
+	}
+}
+
 /** TCP protocol */
 struct tcpip_protocol tcp_protocol __tcpip_protocol = {
 	.name = "TCP",
 	.rx = tcp_rx,
+	.pmtu = tcp_pmtu,
 	.tcpip_proto = IP_TCP,
 };
 
@@ -1566,6 +2861,7 @@ static unsigned int tcp_discard ( void ) {
 
 			/* Remove packet from queue */
 			list_del ( &iobuf->list );
+			tcp->rx_queued -= iob_len ( iobuf );
 			free_iob ( iobuf );
 
 			/* Report discard */
@@ -1657,6 +2953,58 @@ struct startup_fn tcp_startup_fn __startup_fn ( STARTUP_LATE ) = {
 	.shutdown = tcp_shutdown,
 };
 
+/***************************************************************************
+ *
+ * Statistics
+ *
+ ***************************************************************************
+ */
+
+/**
+ * Get TCP connection information
+ *
+ * @v index		Connection index
+ * @v info		Connection information to fill in
+ * @ret rc		Return status code
+ */
+int tcp_info ( unsigned int index, struct tcp_info *info ) {
+	struct tcp_connection *tcp;
+
+	list_for_each_entry ( tcp, &tcp_conns, list ) {
+		if ( index-- )
+			continue;
+		memset ( info, 0, sizeof ( *info ) );
+		memcpy ( &info->peer, &tcp->peer, sizeof ( info->peer ) );
+		info->local_port = tcp->local_port;
+		info->state = tcp_state ( tcp->tcp_state );
+		info->snd_mss = tcp->snd_mss;
+		info->snd_win = tcp->snd_win;
+		info->rcv_win = tcp->rcv_win;
+		info->cwnd = tcp->cong.cwnd;
+		info->ssthresh = tcp->cong.ssthresh;
+		if ( tcp->flags & TCP_RTT_VALID ) {
+			info->srtt = ( tcp->srtt >> 3 );
+			info->rttvar = ( tcp->rttvar >> 2 );
+		}
+		info->snd_sent = tcp->snd_sent;
+		info->tx_queued = tcp->tx_queued;
+		info->rx_queued = tcp->rx_queued;
+		memcpy ( &info->stats, &tcp->stats, sizeof ( info->stats ) );
+		return 0;
+	}
+	return -ENOENT;
+}
+
+/**
+ * Get accumulated statistics for deleted TCP connections
+ *
+ * @v stats		Statistics to fill in
+ */
+void tcp_closed_stats ( struct tcp_statistics *stats ) {
+
+	memcpy ( stats, &tcp_closed, sizeof ( *stats ) );
+}
+
 /***************************************************************************
  *
  * Data transfer interface
@@ -1693,6 +3041,7 @@ static int tcp_xfer_deliver ( struct tcp_connection *tcp,
 
 	/* Enqueue packet */
 	list_add_tail ( &iobuf->list, &tcp->tx_queue );
+	tcp->tx_queued += iob_len ( iobuf );
 
 	/* Each enqueued packet is a pending operation */
 	pending_get ( &tcp->pending_data );
@@ -1765,3 +3114,6 @@ struct uri_opener tcp_uri_opener __uri_opener = {
 	.open		= tcp_open_uri,
 };
 
+/* Drag in TCP extensions */
+REQUIRING_SYMBOL ( tcp_protocol );
+REQUIRE_OBJECT ( config_tcp );
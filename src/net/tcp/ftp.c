@@ -30,15 +30,24 @@
 #include <ipxe/in.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/xfer.h>
+#include <ipxe/xferbuf.h>
 #include <ipxe/open.h>
 #include <ipxe/uri.h>
 #include <ipxe/features.h>
+#include <ipxe/settings.h>
 #include <ipxe/ftp.h>
 
 /** @file
  *
  * File transfer protocol
  *
+ * A single TCP data connection may be unable to make full use of a
+ * link with a high bandwidth-delay product.  If the "ftp-parallel"
+ * setting is present, then a large file will be split into several
+ * segments, each retrieved over a separate control and data
+ * connection using the REST command.  This is analogous to parallel
+ * HTTP range downloads.
+ *
  */
 
 FEATURE ( FEATURE_PROTOCOL, "FTP", DHCP_EB_FEATURE_FTP, 1 );
@@ -56,6 +65,7 @@ enum ftp_state {
 	FTP_TYPE,
 	FTP_SIZE,
 	FTP_PASV,
+	FTP_REST,
 	FTP_RETR,
 	FTP_WAIT,
 	FTP_QUIT,
@@ -91,6 +101,18 @@ struct ftp_request {
 	char passive_text[24]; /* "aaa,bbb,ccc,ddd,eee,fff" */
 	/** File size, as text */
 	char filesize[20];
+	/** Starting offset within file */
+	size_t offset;
+	/** Starting offset within file, as text */
+	char offset_text[24];
+};
+
+/** FTP parallel connection count setting */
+const struct setting ftp_parallel_setting __setting ( SETTING_MISC,
+						      ftp-parallel ) = {
+	.name = "ftp-parallel",
+	.description = "FTP parallel connections",
+	.type = &setting_type_uint8,
 };
 
 /**
@@ -152,6 +174,16 @@ static const char * ftp_uri_path ( struct ftp_request *ftp ) {
 	return ftp->uri->path;
 }
 
+/**
+ * Retrieve FTP starting offset
+ *
+ * @v ftp		FTP request
+ * @ret offset		FTP starting offset
+ */
+static const char * ftp_offset ( struct ftp_request *ftp ) {
+	return ftp->offset_text;
+}
+
 /**
  * Retrieve FTP user
  *
@@ -182,6 +214,7 @@ static struct ftp_control_string ftp_strings[] = {
 	[FTP_TYPE]	= { "TYPE I", NULL },
 	[FTP_SIZE]	= { "SIZE ", ftp_uri_path },
 	[FTP_PASV]	= { "PASV", NULL },
+	[FTP_REST]	= { "REST ", ftp_offset },
 	[FTP_RETR]	= { "RETR ", ftp_uri_path },
 	[FTP_WAIT]	= { NULL, NULL },
 	[FTP_QUIT]	= { "QUIT", NULL },
@@ -226,6 +259,10 @@ static void ftp_next_state ( struct ftp_request *ftp ) {
 	if ( ftp->state < FTP_DONE )
 		ftp->state++;
 
+	/* Skip REST command unless retrieving from a non-zero offset */
+	if ( ( ftp->state == FTP_REST ) && ( ftp->offset == 0 ) )
+		ftp->state++;
+
 	/* Send control string if needed */
 	ftp_string = &ftp_strings[ftp->state];
 	literal = ftp_string->literal;
@@ -267,11 +304,14 @@ static void ftp_reply ( struct ftp_request *ftp ) {
 	}
 
 	/* Anything other than success (2xx) or, in the case of a
-	 * repsonse to a "USER" command, a password prompt (3xx), is a
-	 * fatal error.
+	 * repsonse to a "USER" command, a password prompt (3xx), or
+	 * in the case of a "REST" command, a request for further
+	 * information (3xx), is a fatal error.
 	 */
 	if ( ! ( ( status_major == '2' ) ||
-		 ( ( status_major == '3' ) && ( ftp->state == FTP_USER ) ) ) ){
+		 ( ( status_major == '3' ) &&
+		   ( ( ftp->state == FTP_USER ) ||
+		     ( ftp->state == FTP_REST ) ) ) ) ) {
 		/* Flag protocol error and close connections */
 		ftp_done ( ftp, -EPROTO );
 		return;
@@ -291,10 +331,9 @@ static void ftp_reply ( struct ftp_request *ftp ) {
 			return;
 		}
 
-		/* Use seek() to notify recipient of filesize */
+		/* Notify recipient of filesize */
 		DBGC ( ftp, "FTP %p file size is %zd bytes\n", ftp, filesize );
-		xfer_seek ( &ftp->xfer, filesize );
-		xfer_seek ( &ftp->xfer, 0 );
+		xfer_presize ( &ftp->xfer, filesize );
 	}
 
 	/* Open passive connection when we get "PASV" response */
@@ -484,9 +523,11 @@ static int ftp_check_string ( const char *string ) {
  *
  * @v xfer		Data transfer interface
  * @v uri		Uniform Resource Identifier
+ * @v offset		Starting offset within file
  * @ret rc		Return status code
  */
-static int ftp_open ( struct interface *xfer, struct uri *uri ) {
+static int ftp_open_offset ( struct interface *xfer, struct uri *uri,
+			     size_t offset ) {
 	struct ftp_request *ftp;
 	struct sockaddr_tcpip server;
 	int rc;
@@ -515,8 +556,12 @@ static int ftp_open ( struct interface *xfer, struct uri *uri ) {
 	ftp->uri = uri_get ( uri );
 	ftp->recvbuf = ftp->status_text;
 	ftp->recvsize = sizeof ( ftp->status_text ) - 1;
+	ftp->offset = offset;
+	snprintf ( ftp->offset_text, sizeof ( ftp->offset_text ), "%zd",
+		   offset );
 
-	DBGC ( ftp, "FTP %p fetching %s\n", ftp, ftp->uri->path );
+	DBGC ( ftp, "FTP %p fetching %s from offset %zd\n",
+	       ftp, ftp->uri->path, offset );
 
 	/* Open control connection */
 	memset ( &server, 0, sizeof ( server ) );
@@ -539,6 +584,453 @@ static int ftp_open ( struct interface *xfer, struct uri *uri ) {
 	return rc;
 }
 
+/*****************************************************************************
+ *
+ * Parallel segment downloads
+ *
+ */
+
+/**
+ * Free FTP download multiplexer
+ *
+ * @v refcnt		Reference count
+ */
+static void ftpmux_free ( struct refcnt *refcnt ) {
+	struct ftp_multiplexer *ftpmux =
+		container_of ( refcnt, struct ftp_multiplexer, refcnt );
+
+	uri_put ( ftpmux->uri );
+	free ( ftpmux );
+}
+
+/**
+ * Close FTP download multiplexer
+ *
+ * @v ftpmux		FTP download multiplexer
+ * @v rc		Reason for close
+ */
+static void ftpmux_close ( struct ftp_multiplexer *ftpmux, int rc ) {
+	unsigned int i;
+
+	/* Shut down all segment downloads */
+	for ( i = 0 ; i < ( FTPMUX_MAX_CONNECTIONS - 1 ) ; i++ )
+		intf_shutdown ( &ftpmux->segment[i].xfer, rc );
+
+	/* Shut down all other interfaces */
+	intf_shutdown ( &ftpmux->primary, rc );
+	intf_shutdown ( &ftpmux->xfer, rc );
+}
+
+/**
+ * Record completion of a download
+ *
+ * @v ftpmux		FTP download multiplexer
+ */
+static void ftpmux_done ( struct ftp_multiplexer *ftpmux ) {
+
+	/* Close multiplexer once all downloads have completed */
+	assert ( ftpmux->busy > 0 );
+	if ( --ftpmux->busy == 0 )
+		ftpmux_close ( ftpmux, 0 );
+}
+
+/**
+ * Abandon segment downloads
+ *
+ * @v ftpmux		FTP download multiplexer
+ * @v rc		Reason for abandonment
+ */
+static void ftpmux_abandon ( struct ftp_multiplexer *ftpmux, int rc ) {
+	struct ftp_multiplexed_segment *segment;
+	unsigned int i;
+
+	DBGC ( ftpmux, "FTPMUX %p abandoning segment downloads: %s\n",
+	       ftpmux, strerror ( rc ) );
+
+	/* Shut down all segment downloads */
+	for ( i = 0 ; i < ( FTPMUX_MAX_CONNECTIONS - 1 ) ; i++ ) {
+		segment = &ftpmux->segment[i];
+		if ( segment->start == segment->end )
+			continue;
+		intf_restart ( &segment->xfer, rc );
+		segment->start = segment->end = 0;
+	}
+
+	/* Allow primary download to run to completion */
+	ftpmux->limit = 0;
+	ftpmux->busy = 1;
+}
+
+/**
+ * Start segment downloads
+ *
+ * @v ftpmux		FTP download multiplexer
+ * @v len		File size
+ */
+static void ftpmux_start ( struct ftp_multiplexer *ftpmux, size_t len ) {
+	struct ftp_multiplexed_segment *segment;
+	unsigned int count;
+	unsigned int i;
+	size_t chunk;
+	int rc;
+
+	/* Record file size */
+	ftpmux->len = len;
+
+	/* Calculate number of connections */
+	count = ftpmux->count;
+	if ( count > ( len / FTPMUX_MIN_LEN ) )
+		count = ( len / FTPMUX_MIN_LEN );
+	if ( count < 2 )
+		return;
+	chunk = ( len / count );
+
+	/* Truncate primary download */
+	ftpmux->limit = chunk;
+	DBGC ( ftpmux, "FTPMUX %p splitting %#zx bytes across %d "
+	       "connections\n", ftpmux, len, count );
+
+	/* Open segment downloads */
+	for ( i = 0 ; i < ( count - 1 ) ; i++ ) {
+		segment = &ftpmux->segment[i];
+		segment->start = ( ( i + 1 ) * chunk );
+		segment->end = ( ( i == ( count - 2 ) ) ? len :
+				 ( segment->start + chunk ) );
+		segment->pos = segment->start;
+		if ( ( rc = ftp_open_offset ( &segment->xfer, ftpmux->uri,
+					      segment->start ) ) != 0 ) {
+			DBGC ( ftpmux, "FTPMUX %p could not open segment "
+			       "%#zx-%#zx: %s\n", ftpmux, segment->start,
+			       segment->end, strerror ( rc ) );
+			segment->start = segment->end = 0;
+			ftpmux_abandon ( ftpmux, rc );
+			return;
+		}
+		ftpmux->busy++;
+	}
+}
+
+/**
+ * Receive data from primary download
+ *
+ * @v ftpmux		FTP download multiplexer
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int ftpmux_primary_deliver ( struct ftp_multiplexer *ftpmux,
+				    struct io_buffer *iobuf,
+				    struct xfer_metadata *meta ) {
+	struct xfer_metadata abs_meta;
+	size_t len = iob_len ( iobuf );
+	size_t pos;
+	int rc;
+
+	/* Calculate absolute position */
+	pos = ftpmux->pos;
+	if ( meta->flags & XFER_FL_ABS_OFFSET )
+		pos = 0;
+	pos += meta->offset;
+
+	/* Start segment downloads when the file size becomes known
+	 * (via the seek issued in response to the SIZE command).
+	 */
+	if ( ( len == 0 ) && pos && ( ftpmux->len == 0 ) )
+		ftpmux_start ( ftpmux, pos );
+
+	/* Discard any data beyond the end of the primary download */
+	if ( ftpmux->limit && len ) {
+		if ( pos >= ftpmux->limit ) {
+			iob_unput ( iobuf, len );
+		} else if ( ( pos + len ) > ftpmux->limit ) {
+			iob_unput ( iobuf, ( pos + len - ftpmux->limit ) );
+		}
+		len = iob_len ( iobuf );
+		if ( ! len ) {
+			free_iob ( iobuf );
+			return 0;
+		}
+	}
+
+	/* Deliver to data transfer interface using absolute position */
+	memcpy ( &abs_meta, meta, sizeof ( abs_meta ) );
+	abs_meta.flags |= XFER_FL_ABS_OFFSET;
+	abs_meta.offset = pos;
+	ftpmux->pos = ( pos + len );
+	if ( ( rc = xfer_deliver ( &ftpmux->xfer, iob_disown ( iobuf ),
+				   &abs_meta ) ) != 0 )
+		return rc;
+
+	/* Close primary download once it reaches its limit */
+	if ( len && ftpmux->limit && ( ftpmux->pos >= ftpmux->limit ) ) {
+		DBGC ( ftpmux, "FTPMUX %p primary download complete\n",
+		       ftpmux );
+		ftpmux->limit = 0;
+		intf_restart ( &ftpmux->primary, 0 );
+		ftpmux_done ( ftpmux );
+	}
+
+	return 0;
+}
+
+/**
+ * Close primary download
+ *
+ * @v ftpmux		FTP download multiplexer
+ * @v rc		Reason for close
+ */
+static void ftpmux_primary_close ( struct ftp_multiplexer *ftpmux, int rc ) {
+
+	/* Terminate download on error */
+	if ( rc != 0 ) {
+		ftpmux_close ( ftpmux, rc );
+		return;
+	}
+
+	/* Restart interface and record completion */
+	intf_restart ( &ftpmux->primary, rc );
+	ftpmux_done ( ftpmux );
+}
+
+/**
+ * Receive data from segment download
+ *
+ * @v segment		FTP multiplexed segment download
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int ftpmux_segment_deliver ( struct ftp_multiplexed_segment *segment,
+				    struct io_buffer *iobuf,
+				    struct xfer_metadata *meta ) {
+	struct ftp_multiplexer *ftpmux = segment->ftpmux;
+	struct xfer_metadata abs_meta;
+	size_t len = iob_len ( iobuf );
+	size_t pos;
+	int rc;
+
+	/* Ignore presizing seeks, which are relative to the segment */
+	if ( ! len ) {
+		free_iob ( iobuf );
+		return 0;
+	}
+
+	/* Calculate absolute position.  The server will send
+	 * everything from the starting offset to the end of the file,
+	 * so discard anything beyond the end of the segment.
+	 */
+	pos = segment->pos;
+	if ( meta->flags & XFER_FL_ABS_OFFSET )
+		pos = segment->start;
+	pos += meta->offset;
+	if ( pos >= segment->end ) {
+		free_iob ( iobuf );
+		return 0;
+	}
+	if ( ( pos + len ) > segment->end )
+		iob_unput ( iobuf, ( pos + len - segment->end ) );
+	len = iob_len ( iobuf );
+	segment->pos = ( pos + len );
+
+	/* Deliver to data transfer interface using absolute position.
+	 * We can't use a simple passthrough interface descriptor,
+	 * since there are multiple segment download interfaces.
+	 */
+	memcpy ( &abs_meta, meta, sizeof ( abs_meta ) );
+	abs_meta.flags |= XFER_FL_ABS_OFFSET;
+	abs_meta.offset = pos;
+	if ( ( rc = xfer_deliver ( &ftpmux->xfer, iob_disown ( iobuf ),
+				   &abs_meta ) ) != 0 )
+		return rc;
+
+	/* Close segment download once it reaches its end */
+	if ( segment->pos == segment->end ) {
+		DBGC ( ftpmux, "FTPMUX %p segment %#zx-%#zx complete\n",
+		       ftpmux, segment->start, segment->end );
+		intf_restart ( &segment->xfer, 0 );
+		ftpmux_done ( ftpmux );
+	}
+
+	return 0;
+}
+
+/**
+ * Check segment download flow control window
+ *
+ * @v segment		FTP multiplexed segment download
+ * @ret len		Length of window
+ */
+static size_t
+ftpmux_segment_window ( struct ftp_multiplexed_segment *segment ) {
+	struct ftp_multiplexer *ftpmux = segment->ftpmux;
+
+	return xfer_window ( &ftpmux->xfer );
+}
+
+/**
+ * Get segment download underlying data transfer buffer
+ *
+ * @v segment		FTP multiplexed segment download
+ * @ret xferbuf		Data transfer buffer, or NULL on error
+ */
+static struct xfer_buffer *
+ftpmux_segment_buffer ( struct ftp_multiplexed_segment *segment ) {
+	struct ftp_multiplexer *ftpmux = segment->ftpmux;
+
+	return xfer_buffer ( &ftpmux->xfer );
+}
+
+/**
+ * Close segment download
+ *
+ * @v segment		FTP multiplexed segment download
+ * @v rc		Reason for close
+ */
+static void ftpmux_segment_close ( struct ftp_multiplexed_segment *segment,
+				   int rc ) {
+	struct ftp_multiplexer *ftpmux = segment->ftpmux;
+
+	/* Restart data transfer interface */
+	intf_restart ( &segment->xfer, rc );
+
+	/* Handle errors */
+	if ( rc != 0 ) {
+
+		/* Fall back to using only the primary download, if
+		 * it has not yet been truncated.
+		 */
+		if ( ftpmux->limit ) {
+			ftpmux_abandon ( ftpmux, rc );
+			return;
+		}
+
+		/* Otherwise, terminate the whole multiplexer */
+		DBGC ( ftpmux, "FTPMUX %p segment %#zx-%#zx failed: %s\n",
+		       ftpmux, segment->start, segment->end, strerror ( rc ) );
+		ftpmux_close ( ftpmux, rc );
+		return;
+	}
+
+	/* A segment download ends only when closed by us, so a clean
+	 * close from the server means that the file was truncated.
+	 */
+	DBGC ( ftpmux, "FTPMUX %p segment %#zx-%#zx incomplete at %#zx\n",
+	       ftpmux, segment->start, segment->end, segment->pos );
+	ftpmux_close ( ftpmux, -EIO );
+}
+
+/** Data transfer interface operations */
+static struct interface_operation ftpmux_xfer_operations[] = {
+	INTF_OP ( intf_close, struct ftp_multiplexer *, ftpmux_close ),
+};
+
+/** Data transfer interface descriptor */
+static struct interface_descriptor ftpmux_xfer_desc =
+	INTF_DESC_PASSTHRU ( struct ftp_multiplexer, xfer,
+			     ftpmux_xfer_operations, primary );
+
+/** Primary download interface operations */
+static struct interface_operation ftpmux_primary_operations[] = {
+	INTF_OP ( xfer_deliver, struct ftp_multiplexer *,
+		  ftpmux_primary_deliver ),
+	INTF_OP ( intf_close, struct ftp_multiplexer *,
+		  ftpmux_primary_close ),
+};
+
+/** Primary download interface descriptor */
+static struct interface_descriptor ftpmux_primary_desc =
+	INTF_DESC_PASSTHRU ( struct ftp_multiplexer, primary,
+			     ftpmux_primary_operations, xfer );
+
+/** Segment download interface operations */
+static struct interface_operation ftpmux_segment_operations[] = {
+	INTF_OP ( xfer_deliver, struct ftp_multiplexed_segment *,
+		  ftpmux_segment_deliver ),
+	INTF_OP ( xfer_window, struct ftp_multiplexed_segment *,
+		  ftpmux_segment_window ),
+	INTF_OP ( xfer_buffer, struct ftp_multiplexed_segment *,
+		  ftpmux_segment_buffer ),
+	INTF_OP ( intf_close, struct ftp_multiplexed_segment *,
+		  ftpmux_segment_close ),
+};
+
+/** Segment download interface descriptor */
+static struct interface_descriptor ftpmux_segment_desc =
+	INTF_DESC ( struct ftp_multiplexed_segment, xfer,
+		    ftpmux_segment_operations );
+
+/**
+ * Open parallel FTP download
+ *
+ * @v xfer		Data transfer interface
+ * @v uri		Uniform Resource Identifier
+ * @v count		Maximum number of concurrent connections
+ * @ret rc		Return status code
+ */
+static int ftpmux_open ( struct interface *xfer, struct uri *uri,
+			 unsigned int count ) {
+	struct ftp_multiplexer *ftpmux;
+	struct ftp_multiplexed_segment *segment;
+	unsigned int i;
+	int rc;
+
+	/* Allocate and initialise structure */
+	ftpmux = zalloc ( sizeof ( *ftpmux ) );
+	if ( ! ftpmux ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	ref_init ( &ftpmux->refcnt, ftpmux_free );
+	intf_init ( &ftpmux->xfer, &ftpmux_xfer_desc, &ftpmux->refcnt );
+	intf_init ( &ftpmux->primary, &ftpmux_primary_desc,
+		    &ftpmux->refcnt );
+	ftpmux->uri = uri_get ( uri );
+	ftpmux->count = count;
+	ftpmux->busy = 1;
+	for ( i = 0 ; i < ( FTPMUX_MAX_CONNECTIONS - 1 ) ; i++ ) {
+		segment = &ftpmux->segment[i];
+		segment->ftpmux = ftpmux;
+		intf_init ( &segment->xfer, &ftpmux_segment_desc,
+			    &ftpmux->refcnt );
+	}
+
+	/* Open primary download */
+	if ( ( rc = ftp_open_offset ( &ftpmux->primary, uri, 0 ) ) != 0 )
+		goto err_open;
+
+	/* Attach to parent interface, mortalise self, and return */
+	intf_plug_plug ( &ftpmux->xfer, xfer );
+	ref_put ( &ftpmux->refcnt );
+	return 0;
+
+ err_open:
+	ftpmux_close ( ftpmux, rc );
+	ref_put ( &ftpmux->refcnt );
+ err_alloc:
+	return rc;
+}
+
+/**
+ * Initiate an FTP download
+ *
+ * @v xfer		Data transfer interface
+ * @v uri		Uniform Resource Identifier
+ * @ret rc		Return status code
+ */
+static int ftp_open ( struct interface *xfer, struct uri *uri ) {
+	unsigned long count;
+
+	/* Use parallel segment downloads, if enabled */
+	if ( ( fetch_uint_setting ( NULL, &ftp_parallel_setting,
+				    &count ) >= 0 ) && ( count >= 2 ) ) {
+		if ( count > FTPMUX_MAX_CONNECTIONS )
+			count = FTPMUX_MAX_CONNECTIONS;
+		return ftpmux_open ( xfer, uri, count );
+	}
+
+	return ftp_open_offset ( xfer, uri, 0 );
+}
+
 /** FTP URI opener */
 struct uri_opener ftp_uri_opener __uri_opener = {
 	.scheme	= "ftp",
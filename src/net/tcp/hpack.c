@@ -0,0 +1,675 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * HPACK header compression for HTTP/2
+ *
+ * This implements the decoder defined in RFC 7541, including the
+ * dynamic table and Huffman-coded string literals.  The encoder
+ * never adds entries to the dynamic table and never uses Huffman
+ * coding, which keeps the encoder stateless at the cost of a few
+ * bytes per request.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <ipxe/hpack.h>
+
+/** Maximum number of bits in an HPACK Huffman code */
+#define HPACK_HUFFMAN_MAX_BITS 30
+
+/** Maximum number of continuation bits in an HPACK integer
+ *
+ * Integers are used only for indices, lengths and table sizes, none
+ * of which can legitimately approach this limit.
+ */
+#define HPACK_INT_MAX_SHIFT 21
+
+/** An HPACK static table entry */
+struct hpack_static_entry {
+	/** Name */
+	const char *name;
+	/** Value */
+	const char *value;
+};
+
+/** HPACK static table (RFC 7541 appendix A) */
+static const struct hpack_static_entry hpack_static[HPACK_STATIC_COUNT] = {
+	{ ":authority", "" },
+	{ ":method", "GET" },
+	{ ":method", "POST" },
+	{ ":path", "/" },
+	{ ":path", "/index.html" },
+	{ ":scheme", "http" },
+	{ ":scheme", "https" },
+	{ ":status", "200" },
+	{ ":status", "204" },
+	{ ":status", "206" },
+	{ ":status", "304" },
+	{ ":status", "400" },
+	{ ":status", "404" },
+	{ ":status", "500" },
+	{ "accept-charset", "" },
+	{ "accept-encoding", "gzip, deflate" },
+	{ "accept-language", "" },
+	{ "accept-ranges", "" },
+	{ "accept", "" },
+	{ "access-control-allow-origin", "" },
+	{ "age", "" },
+	{ "allow", "" },
+	{ "authorization", "" },
+	{ "cache-control", "" },
+	{ "content-disposition", "" },
+	{ "content-encoding", "" },
+	{ "content-language", "" },
+	{ "content-length", "" },
+	{ "content-location", "" },
+	{ "content-range", "" },
+	{ "content-type", "" },
+	{ "cookie", "" },
+	{ "date", "" },
+	{ "etag", "" },
+	{ "expect", "" },
+	{ "expires", "" },
+	{ "from", "" },
+	{ "host", "" },
+	{ "if-match", "" },
+	{ "if-modified-since", "" },
+	{ "if-none-match", "" },
+	{ "if-range", "" },
+	{ "if-unmodified-since", "" },
+	{ "last-modified", "" },
+	{ "link", "" },
+	{ "location", "" },
+	{ "max-forwards", "" },
+	{ "proxy-authenticate", "" },
+	{ "proxy-authorization", "" },
+	{ "range", "" },
+	{ "referer", "" },
+	{ "refresh", "" },
+	{ "retry-after", "" },
+	{ "server", "" },
+	{ "set-cookie", "" },
+	{ "strict-transport-security", "" },
+	{ "transfer-encoding", "" },
+	{ "user-agent", "" },
+	{ "vary", "" },
+	{ "via", "" },
+	{ "www-authenticate", "" },
+};
+
+/** Number of HPACK Huffman codes of each length (RFC 7541 appendix B)
+ *
+ * The HPACK Huffman code is canonical, and so may be reconstructed
+ * from the number of codes of each length together with the list of
+ * symbols in order of increasing code value.  The count for the
+ * maximum length includes the end-of-string symbol.
+ */
+static const uint8_t hpack_huffman_counts[ HPACK_HUFFMAN_MAX_BITS + 1 ] = {
+	0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3,
+	0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 4
+};
+
+/** HPACK Huffman symbols in order of increasing code value
+ *
+ * The end-of-string symbol (which has the final code) is omitted.
+ */
+static const uint8_t hpack_huffman_symbols[256] = {
+	0x30, 0x31, 0x32, 0x61, 0x63, 0x65, 0x69, 0x6f, 0x73, 0x74, 0x20, 0x25,
+	0x2d, 0x2e, 0x2f, 0x33, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3d, 0x41,
+	0x5f, 0x62, 0x64, 0x66, 0x67, 0x68, 0x6c, 0x6d, 0x6e, 0x70, 0x72, 0x75,
+	0x3a, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4a, 0x4b, 0x4c,
+	0x4d, 0x4e, 0x4f, 0x50, 0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x59,
+	0x6a, 0x6b, 0x71, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x26, 0x2a, 0x2c, 0x3b,
+	0x58, 0x5a, 0x21, 0x22, 0x28, 0x29, 0x3f, 0x27, 0x2b, 0x7c, 0x23, 0x3e,
+	0x00, 0x24, 0x40, 0x5b, 0x5d, 0x7e, 0x5e, 0x7d, 0x3c, 0x60, 0x7b, 0x5c,
+	0xc3, 0xd0, 0x80, 0x82, 0x83, 0xa2, 0xb8, 0xc2, 0xe0, 0xe2, 0x99, 0xa1,
+	0xa7, 0xac, 0xb0, 0xb1, 0xb3, 0xd1, 0xd8, 0xd9, 0xe3, 0xe5, 0xe6, 0x81,
+	0x84, 0x85, 0x86, 0x88, 0x92, 0x9a, 0x9c, 0xa0, 0xa3, 0xa4, 0xa9, 0xaa,
+	0xad, 0xb2, 0xb5, 0xb9, 0xba, 0xbb, 0xbd, 0xbe, 0xc4, 0xc6, 0xe4, 0xe8,
+	0xe9, 0x01, 0x87, 0x89, 0x8a, 0x8b, 0x8c, 0x8d, 0x8f, 0x93, 0x95, 0x96,
+	0x97, 0x98, 0x9b, 0x9d, 0x9e, 0xa5, 0xa6, 0xa8, 0xae, 0xaf, 0xb4, 0xb6,
+	0xb7, 0xbc, 0xbf, 0xc5, 0xe7, 0xef, 0x09, 0x8e, 0x90, 0x91, 0x94, 0x9f,
+	0xab, 0xce, 0xd7, 0xe1, 0xec, 0xed, 0xc7, 0xcf, 0xea, 0xeb, 0xc0, 0xc1,
+	0xc8, 0xc9, 0xca, 0xcd, 0xd2, 0xd5, 0xda, 0xdb, 0xee, 0xf0, 0xf2, 0xf3,
+	0xff, 0xcb, 0xcc, 0xd3, 0xd4, 0xd6, 0xdd, 0xde, 0xdf, 0xf1, 0xf4, 0xf5,
+	0xf6, 0xf7, 0xf8, 0xfa, 0xfb, 0xfc, 0xfd, 0xfe, 0x02, 0x03, 0x04, 0x05,
+	0x06, 0x07, 0x08, 0x0b, 0x0c, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14,
+	0x15, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x7f, 0xdc,
+	0xf9, 0x0a, 0x0d, 0x16
+};
+
+/**
+ * Initialise HPACK dynamic table
+ *
+ * @v table		Dynamic table
+ * @v limit		Maximum size (as advertised to the encoder)
+ */
+void hpack_init ( struct hpack_table *table, size_t limit ) {
+
+	INIT_LIST_HEAD ( &table->entries );
+	table->count = 0;
+	table->size = 0;
+	table->max = limit;
+	table->limit = limit;
+}
+
+/**
+ * Evict entries from HPACK dynamic table
+ *
+ * @v table		Dynamic table
+ * @v size		Maximum permitted size
+ */
+static void hpack_evict ( struct hpack_table *table, size_t size ) {
+	struct hpack_entry *entry;
+
+	/* Remove oldest entries until table fits within size */
+	while ( table->size > size ) {
+		entry = list_last_entry ( &table->entries, struct hpack_entry,
+					  list );
+		list_del ( &entry->list );
+		table->count--;
+		table->size -= entry->size;
+		free ( entry );
+	}
+}
+
+/**
+ * Free HPACK dynamic table
+ *
+ * @v table		Dynamic table
+ */
+void hpack_fini ( struct hpack_table *table ) {
+
+	hpack_evict ( table, 0 );
+}
+
+/**
+ * Add entry to HPACK dynamic table
+ *
+ * @v table		Dynamic table
+ * @v name		Name
+ * @v value		Value
+ * @ret rc		Return status code
+ */
+static int hpack_insert ( struct hpack_table *table, const char *name,
+			  const char *value ) {
+	struct hpack_entry *entry;
+	size_t name_len = strlen ( name );
+	size_t value_len = strlen ( value );
+	size_t size = ( name_len + value_len + HPACK_ENTRY_OVERHEAD );
+
+	/* An entry larger than the table simply empties the table */
+	if ( size > table->max ) {
+		hpack_evict ( table, 0 );
+		return 0;
+	}
+
+	/* Allocate and populate entry before evicting anything, since
+	 * the name may refer to an entry that is about to be evicted.
+	 */
+	entry = malloc ( sizeof ( *entry ) + name_len + 1 /* NUL */ +
+			 value_len + 1 /* NUL */ );
+	if ( ! entry )
+		return -ENOMEM;
+	entry->size = size;
+	entry->name = ( ( ( void * ) entry ) + sizeof ( *entry ) );
+	entry->value = ( entry->name + name_len + 1 /* NUL */ );
+	memcpy ( entry->name, name, ( name_len + 1 /* NUL */ ) );
+	memcpy ( entry->value, value, ( value_len + 1 /* NUL */ ) );
+
+	/* Make room and add entry */
+	hpack_evict ( table, ( table->max - size ) );
+	list_add ( &entry->list, &table->entries );
+	table->count++;
+	table->size += size;
+
+	return 0;
+}
+
+/**
+ * Look up HPACK table entry
+ *
+ * @v table		Dynamic table
+ * @v index		Index
+ * @v name		Name to fill in
+ * @v value		Value to fill in
+ * @ret rc		Return status code
+ */
+static int hpack_lookup ( struct hpack_table *table, unsigned long index,
+			  const char **name, const char **value ) {
+	struct hpack_entry *entry;
+
+	/* Index zero is never valid */
+	if ( ! index )
+		return -EINVAL;
+
+	/* Check static table */
+	if ( index <= HPACK_STATIC_COUNT ) {
+		*name = hpack_static[ index - 1 ].name;
+		*value = hpack_static[ index - 1 ].value;
+		return 0;
+	}
+
+	/* Check dynamic table */
+	index -= ( HPACK_STATIC_COUNT + 1 );
+	if ( index >= table->count )
+		return -ENOENT;
+	list_for_each_entry ( entry, &table->entries, list ) {
+		if ( index-- == 0 ) {
+			*name = entry->name;
+			*value = entry->value;
+			return 0;
+		}
+	}
+
+	/* Unreachable */
+	return -ENOENT;
+}
+
+/**
+ * Decode HPACK integer
+ *
+ * @v data		Data pointer to update
+ * @v end		End of data
+ * @v bits		Number of bits in prefix
+ * @v value		Value to fill in
+ * @ret rc		Return status code
+ */
+static int hpack_decode_int ( const uint8_t **data, const uint8_t *end,
+			      unsigned int bits, unsigned long *value ) {
+	unsigned int mask = ( ( 1 << bits ) - 1 );
+	unsigned int shift = 0;
+	uint8_t byte;
+
+	/* Decode prefix */
+	if ( *data >= end )
+		return -EINVAL;
+	*value = ( *((*data)++) & mask );
+	if ( *value < mask )
+		return 0;
+
+	/* Decode continuation bytes */
+	do {
+		if ( *data >= end )
+			return -EINVAL;
+		if ( shift > HPACK_INT_MAX_SHIFT )
+			return -ERANGE;
+		byte = *((*data)++);
+		*value += ( ( ( unsigned long ) ( byte & 0x7f ) ) << shift );
+		shift += 7;
+	} while ( byte & 0x80 );
+
+	return 0;
+}
+
+/**
+ * Decode HPACK Huffman-coded string
+ *
+ * @v data		Huffman-coded data
+ * @v len		Length of Huffman-coded data
+ * @v out		Output buffer
+ * @ret out_len		Length of decoded string, or negative error
+ */
+static int hpack_decode_huffman ( const uint8_t *data, size_t len,
+				  char *out ) {
+	unsigned int count;
+	unsigned int first = 0;
+	unsigned int index = 0;
+	unsigned int code = 0;
+	unsigned int raw = 0;
+	unsigned int bits = 0;
+	unsigned int bit;
+	char *start = out;
+	uint8_t byte;
+
+	while ( len-- ) {
+		byte = *(data++);
+		for ( bit = 0x80 ; bit ; bit >>= 1 ) {
+
+			/* Extend current code by one bit */
+			code |= ( ( byte & bit ) ? 1 : 0 );
+			raw = ( ( raw << 1 ) | ( code & 1 ) );
+			bits++;
+
+			/* Check for a complete code of this length */
+			count = hpack_huffman_counts[bits];
+			if ( code < ( first + count ) ) {
+				index += ( code - first );
+				if ( index >= sizeof ( hpack_huffman_symbols ) )
+					return -EINVAL;
+				*(out++) = hpack_huffman_symbols[index];
+				first = index = code = raw = bits = 0;
+				continue;
+			}
+
+			/* Move on to codes of the next length */
+			if ( bits >= HPACK_HUFFMAN_MAX_BITS )
+				return -EINVAL;
+			index += count;
+			first = ( ( first + count ) << 1 );
+			code <<= 1;
+		}
+	}
+
+	/* Any padding must be a (strict) prefix of the end-of-string
+	 * symbol, i.e. fewer than eight bits, all of which are set.
+	 */
+	if ( ( bits > 7 ) || ( raw != ( ( 1U << bits ) - 1 ) ) )
+		return -EINVAL;
+
+	return ( out - start );
+}
+
+/**
+ * Decode HPACK string literal
+ *
+ * @v data		Data pointer to update
+ * @v end		End of data
+ * @v out		Output buffer
+ * @ret len		Length of decoded string (excluding NUL), or negative error
+ *
+ * The output buffer must be large enough to hold the decoded string
+ * and a terminating NUL.  Since no Huffman code is shorter than five
+ * bits, the decoded string is never longer than 8/5 of the encoded
+ * length.
+ */
+static int hpack_decode_string ( const uint8_t **data, const uint8_t *end,
+				 char *out ) {
+	unsigned long len;
+	int huffman;
+	int out_len;
+	int rc;
+
+	/* Decode length */
+	if ( *data >= end )
+		return -EINVAL;
+	huffman = ( **data & HPACK_HUFFMAN );
+	if ( ( rc = hpack_decode_int ( data, end, 7, &len ) ) != 0 )
+		return rc;
+	if ( len > ( ( size_t ) ( end - *data ) ) )
+		return -EINVAL;
+
+	/* Decode string */
+	if ( huffman ) {
+		out_len = hpack_decode_huffman ( *data, len, out );
+		if ( out_len < 0 )
+			return out_len;
+	} else {
+		memcpy ( out, *data, len );
+		out_len = len;
+	}
+	out[out_len] = '\0';
+	*data += len;
+
+	return out_len;
+}
+
+/**
+ * Decode HPACK literal header field
+ *
+ * @v table		Dynamic table
+ * @v data		Data pointer to update
+ * @v end		End of data
+ * @v bits		Number of bits in name index prefix
+ * @v scratch		Scratch buffer for decoded strings
+ * @v name		Name to fill in
+ * @v value		Value to fill in
+ * @ret rc		Return status code
+ */
+static int hpack_decode_literal ( struct hpack_table *table,
+				  const uint8_t **data, const uint8_t *end,
+				  unsigned int bits, char *scratch,
+				  const char **name, const char **value ) {
+	const char *unused;
+	unsigned long index;
+	int len;
+	int rc;
+
+	/* Decode name */
+	if ( ( rc = hpack_decode_int ( data, end, bits, &index ) ) != 0 )
+		return rc;
+	if ( index ) {
+		if ( ( rc = hpack_lookup ( table, index, name,
+					   &unused ) ) != 0 )
+			return rc;
+	} else {
+		len = hpack_decode_string ( data, end, scratch );
+		if ( len < 0 )
+			return len;
+		*name = scratch;
+		scratch += ( len + 1 /* NUL */ );
+	}
+
+	/* Decode value */
+	len = hpack_decode_string ( data, end, scratch );
+	if ( len < 0 )
+		return len;
+	*value = scratch;
+
+	return 0;
+}
+
+/**
+ * Decode HPACK header block
+ *
+ * @v table		Dynamic table
+ * @v data		Header block
+ * @v len		Length of header block
+ * @v header		Method to handle each decoded header field
+ * @v opaque		Opaque pointer to pass to header method
+ * @ret rc		Return status code
+ *
+ * The dynamic table is updated as a side effect, and so every header
+ * block received on a connection must be decoded (in order) even if
+ * the headers themselves are of no interest.
+ */
+int hpack_decode ( struct hpack_table *table, const void *data, size_t len,
+		   hpack_header_t header, void *opaque ) {
+	const uint8_t *bytes = data;
+	const uint8_t *end = ( bytes + len );
+	const char *name;
+	const char *value;
+	unsigned long index;
+	unsigned long size;
+	char *scratch;
+	uint8_t byte;
+	int rc;
+
+	/* Allocate scratch buffer large enough for any single field */
+	scratch = malloc ( ( ( len * 8 ) / 5 ) + 2 /* NULs */ );
+	if ( ! scratch ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+
+	/* Decode each field */
+	while ( bytes < end ) {
+		byte = *bytes;
+		if ( byte & HPACK_INDEXED ) {
+
+			/* Indexed header field */
+			if ( ( rc = hpack_decode_int ( &bytes, end, 7,
+						       &index ) ) != 0 )
+				goto err;
+			if ( ( rc = hpack_lookup ( table, index, &name,
+						   &value ) ) != 0 )
+				goto err;
+			if ( ( rc = header ( opaque, name, value ) ) != 0 )
+				goto err;
+
+		} else if ( byte & HPACK_LITERAL_INDEXED ) {
+
+			/* Literal header field with incremental indexing.
+			 * Report the field before adding it to the table,
+			 * since the insertion may evict the entry
+			 * providing the name.
+			 */
+			if ( ( rc = hpack_decode_literal ( table, &bytes, end,
+							   6, scratch, &name,
+							   &value ) ) != 0 )
+				goto err;
+			if ( ( rc = header ( opaque, name, value ) ) != 0 )
+				goto err;
+			if ( ( rc = hpack_insert ( table, name, value ) ) != 0 )
+				goto err;
+
+		} else if ( byte & HPACK_SIZE_UPDATE ) {
+
+			/* Dynamic table size update */
+			if ( ( rc = hpack_decode_int ( &bytes, end, 5,
+						       &size ) ) != 0 )
+				goto err;
+			if ( size > table->limit ) {
+				rc = -ERANGE;
+				goto err;
+			}
+			table->max = size;
+			hpack_evict ( table, size );
+
+		} else {
+
+			/* Literal header field without indexing, or
+			 * never indexed.
+			 */
+			if ( ( rc = hpack_decode_literal ( table, &bytes, end,
+							   4, scratch, &name,
+							   &value ) ) != 0 )
+				goto err;
+			if ( ( rc = header ( opaque, name, value ) ) != 0 )
+				goto err;
+		}
+	}
+
+	rc = 0;
+ err:
+	free ( scratch );
+ err_alloc:
+	return rc;
+}
+
+/**
+ * Encode HPACK integer
+ *
+ * @v data		Output buffer, or NULL
+ * @v flags		Flags to include in first byte
+ * @v bits		Number of bits in prefix
+ * @v value		Value
+ * @ret len		Length of encoded integer
+ */
+static size_t hpack_encode_int ( uint8_t *data, unsigned int flags,
+				 unsigned int bits, unsigned long value ) {
+	unsigned int mask = ( ( 1 << bits ) - 1 );
+	size_t len = 1;
+
+	/* Encode prefix */
+	if ( value < mask ) {
+		if ( data )
+			data[0] = ( flags | value );
+		return len;
+	}
+	if ( data )
+		data[0] = ( flags | mask );
+	value -= mask;
+
+	/* Encode continuation bytes */
+	do {
+		if ( data ) {
+			data[len] = ( ( value & 0x7f ) |
+				      ( ( value >= 0x80 ) ? 0x80 : 0 ) );
+		}
+		len++;
+		value >>= 7;
+	} while ( value );
+
+	return len;
+}
+
+/**
+ * Encode HPACK string literal
+ *
+ * @v data		Output buffer, or NULL
+ * @v string		String
+ * @v lower		Convert string to lower case
+ * @ret len		Length of encoded string literal
+ */
+static size_t hpack_encode_string ( uint8_t *data, const char *string,
+				    int lower ) {
+	size_t string_len = strlen ( string );
+	size_t len;
+	unsigned int i;
+
+	/* Encode length (without Huffman coding) */
+	len = hpack_encode_int ( data, 0, 7, string_len );
+
+	/* Encode string */
+	if ( data ) {
+		data += len;
+		for ( i = 0 ; i < string_len ; i++ ) {
+			data[i] = ( lower ? tolower ( string[i] ) :
+				    string[i] );
+		}
+	}
+
+	return ( len + string_len );
+}
+
+/**
+ * Encode HPACK header field
+ *
+ * @v data		Output buffer, or NULL to calculate length
+ * @v index		Static table index, or zero
+ * @v name		Name (if not indexed)
+ * @v value		Value, or NULL to use indexed value
+ * @ret len		Length of encoded header field
+ *
+ * If @c value is NULL then the header field is encoded as an indexed
+ * header field.  Otherwise, it is encoded as a literal header field
+ * without indexing, using either the indexed name (if @c index is
+ * non-zero) or a literal name (converted to lower case as required
+ * by HTTP/2).
+ */
+size_t hpack_encode ( void *data, unsigned int index, const char *name,
+		      const char *value ) {
+	uint8_t *bytes = data;
+	size_t len;
+
+	/* Encode indexed header field, if applicable */
+	if ( ! value )
+		return hpack_encode_int ( bytes, HPACK_INDEXED, 7, index );
+
+	/* Encode literal header field without indexing */
+	len = hpack_encode_int ( bytes, HPACK_LITERAL, 4, index );
+	if ( ! index ) {
+		len += hpack_encode_string ( ( bytes ? ( bytes + len ) : NULL ),
+					     name, 1 );
+	}
+	len += hpack_encode_string ( ( bytes ? ( bytes + len ) : NULL ),
+				     value, 0 );
+
+	return len;
+}
@@ -0,0 +1,1946 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/**
+ * @file
+ *
+ * Hyper Text Transfer Protocol version 2 (HTTP/2)
+ *
+ * HTTP/2 is offered (via TLS application-layer protocol negotiation)
+ * to HTTPS servers, and allows any number of concurrent HTTP
+ * transactions to share a single connection without the head-of-line
+ * blocking inherent in HTTP/1.1 pipelining.
+ *
+ * Each stream accepts an HTTP/1.1 request from the HTTP core and
+ * translates it into HEADERS and DATA frames, and translates the
+ * response back into HTTP/1.1 form.  The HTTP core therefore does
+ * not need to be aware of the protocol version in use.
+ *
+ * Servers that do not select HTTP/2 are remembered, and any streams
+ * are asked to reopen their connections, which will then be made
+ * using HTTP/1.1.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <byteswap.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/xfer.h>
+#include <ipxe/open.h>
+#include <ipxe/pool.h>
+#include <ipxe/socket.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/uri.h>
+#include <ipxe/tls.h>
+#include <ipxe/http.h>
+#include <ipxe/http2.h>
+
+/* Disambiguate the various error causes */
+#define EPROTO_FRAME_SIZE __einfo_error ( EINFO_EPROTO_FRAME_SIZE )
+#define EINFO_EPROTO_FRAME_SIZE						\
+	__einfo_uniqify ( EINFO_EPROTO, 0x01, "Invalid frame size" )
+#define EPROTO_STREAM __einfo_error ( EINFO_EPROTO_STREAM )
+#define EINFO_EPROTO_STREAM						\
+	__einfo_uniqify ( EINFO_EPROTO, 0x02, "Invalid stream identifier" )
+#define EPROTO_PADDING __einfo_error ( EINFO_EPROTO_PADDING )
+#define EINFO_EPROTO_PADDING						\
+	__einfo_uniqify ( EINFO_EPROTO, 0x03, "Invalid padding" )
+#define EPROTO_CONTINUATION __einfo_error ( EINFO_EPROTO_CONTINUATION )
+#define EINFO_EPROTO_CONTINUATION					\
+	__einfo_uniqify ( EINFO_EPROTO, 0x04, "Unexpected CONTINUATION" )
+#define EPROTO_HPACK __einfo_error ( EINFO_EPROTO_HPACK )
+#define EINFO_EPROTO_HPACK						\
+	__einfo_uniqify ( EINFO_EPROTO, 0x05, "Invalid header block" )
+#define EPROTO_HEADER __einfo_error ( EINFO_EPROTO_HEADER )
+#define EINFO_EPROTO_HEADER						\
+	__einfo_uniqify ( EINFO_EPROTO, 0x06, "Invalid header field" )
+#define EPROTO_FLOW __einfo_error ( EINFO_EPROTO_FLOW )
+#define EINFO_EPROTO_FLOW						\
+	__einfo_uniqify ( EINFO_EPROTO, 0x07, "Flow control error" )
+#define EPROTO_PUSH __einfo_error ( EINFO_EPROTO_PUSH )
+#define EINFO_EPROTO_PUSH						\
+	__einfo_uniqify ( EINFO_EPROTO, 0x08, "Unexpected server push" )
+#define EPROTO_SETTING __einfo_error ( EINFO_EPROTO_SETTING )
+#define EINFO_EPROTO_SETTING						\
+	__einfo_uniqify ( EINFO_EPROTO, 0x09, "Invalid setting" )
+#define EPROTO_RESPONSE __einfo_error ( EINFO_EPROTO_RESPONSE )
+#define EINFO_EPROTO_RESPONSE						\
+	__einfo_uniqify ( EINFO_EPROTO, 0x0a, "Malformed response" )
+#define ECONNRESET_STREAM __einfo_error ( EINFO_ECONNRESET_STREAM )
+#define EINFO_ECONNRESET_STREAM						\
+	__einfo_uniqify ( EINFO_ECONNRESET, 0x01, "Stream reset by server" )
+#define ECONNRESET_CLOSED __einfo_error ( EINFO_ECONNRESET_CLOSED )
+#define EINFO_ECONNRESET_CLOSED						\
+	__einfo_uniqify ( EINFO_ECONNRESET, 0x02, "Connection closed" )
+#define EINVAL_REQUEST __einfo_error ( EINFO_EINVAL_REQUEST )
+#define EINFO_EINVAL_REQUEST						\
+	__einfo_uniqify ( EINFO_EINVAL, 0x01, "Malformed request" )
+
+/** Maximum number of servers remembered as not supporting HTTP/2 */
+#define HTTP2_REFUSALS_MAX 16
+
+/** A server known not to support HTTP/2 */
+struct http2_refusal {
+	/** List of refusals (most recent first) */
+	struct list_head list;
+	/** Port */
+	unsigned int port;
+	/** Host name */
+	char host[0];
+};
+
+/** An HTTP/1.1 request header field */
+struct http2_field {
+	/** Name */
+	const char *name;
+	/** Value */
+	const char *value;
+};
+
+/** HTTP/1.1 request header fields that must not be sent via HTTP/2
+ *
+ * These are either connection-specific (and so forbidden by RFC 9113)
+ * or are represented by pseudo-header fields.
+ */
+static const char *http2_excluded[] = {
+	"Connection", "Keep-Alive", "Proxy-Connection", "Transfer-Encoding",
+	"Upgrade", "TE", "Host",
+};
+
+/** HTTP/2 connections */
+static LIST_HEAD ( http2_connections );
+
+/** Servers known not to support HTTP/2 */
+static LIST_HEAD ( http2_refusals );
+
+/** Number of servers known not to support HTTP/2 */
+static unsigned int http2_refusal_count;
+
+static void http2_conn_close ( struct http2_connection *conn, int rc );
+static void http2_stream_close ( struct http2_stream *stream, int rc );
+
+/******************************************************************************
+ *
+ * Servers not supporting HTTP/2
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Find record of server not supporting HTTP/2
+ *
+ * @v host		Host name
+ * @v port		Port
+ * @ret refusal		Refusal, or NULL if not found
+ */
+static struct http2_refusal * http2_refusal ( const char *host,
+					      unsigned int port ) {
+	struct http2_refusal *refusal;
+
+	list_for_each_entry ( refusal, &http2_refusals, list ) {
+		if ( ( refusal->port == port ) &&
+		     ( strcmp ( refusal->host, host ) == 0 ) )
+			return refusal;
+	}
+	return NULL;
+}
+
+/**
+ * Record server as not supporting HTTP/2
+ *
+ * @v host		Host name
+ * @v port		Port
+ */
+static void http2_refuse ( const char *host, unsigned int port ) {
+	struct http2_refusal *refusal;
+	size_t host_len = strlen ( host );
+
+	/* Do nothing if already recorded */
+	if ( http2_refusal ( host, port ) )
+		return;
+
+	/* Discard oldest record, if applicable */
+	if ( http2_refusal_count >= HTTP2_REFUSALS_MAX ) {
+		refusal = list_last_entry ( &http2_refusals,
+					    struct http2_refusal, list );
+		list_del ( &refusal->list );
+		free ( refusal );
+		http2_refusal_count--;
+	}
+
+	/* Allocate and add record.  Failure is harmless: we will
+	 * merely offer HTTP/2 again next time.
+	 */
+	refusal = zalloc ( sizeof ( *refusal ) + host_len + 1 /* NUL */ );
+	if ( ! refusal )
+		return;
+	refusal->port = port;
+	memcpy ( refusal->host, host, host_len );
+	list_add ( &refusal->list, &http2_refusals );
+	http2_refusal_count++;
+}
+
+/******************************************************************************
+ *
+ * Frame transmission
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Get HTTP/2 frame payload length
+ *
+ * @v hdr		Frame header
+ * @ret len		Payload length
+ */
+static inline size_t http2_frame_len ( struct http2_frame_header *hdr ) {
+
+	return ( ( hdr->len[0] << 16 ) | ( hdr->len[1] << 8 ) | hdr->len[2] );
+}
+
+/**
+ * Transmit HTTP/2 frame
+ *
+ * @v conn		HTTP/2 connection
+ * @v type		Frame type
+ * @v flags		Frame flags
+ * @v id		Stream identifier
+ * @v data		Payload
+ * @v len		Length of payload
+ * @ret rc		Return status code
+ */
+static int http2_tx ( struct http2_connection *conn, unsigned int type,
+		      unsigned int flags, uint32_t id, const void *data,
+		      size_t len ) {
+	struct http2_frame_header *hdr;
+	struct io_buffer *iobuf;
+
+	/* Sanity check */
+	assert ( len <= HTTP2_MAX_FRAME );
+
+	/* Allocate I/O buffer */
+	iobuf = xfer_alloc_iob ( &conn->socket, ( sizeof ( *hdr ) + len ) );
+	if ( ! iobuf )
+		return -ENOMEM;
+
+	/* Construct frame */
+	hdr = iob_put ( iobuf, sizeof ( *hdr ) );
+	hdr->len[0] = ( len >> 16 );
+	hdr->len[1] = ( len >> 8 );
+	hdr->len[2] = ( len >> 0 );
+	hdr->type = type;
+	hdr->flags = flags;
+	hdr->stream = htonl ( id );
+	memcpy ( iob_put ( iobuf, len ), data, len );
+
+	/* Transmit frame */
+	return xfer_deliver_iob ( &conn->socket, iobuf );
+}
+
+/**
+ * Transmit HTTP/2 RST_STREAM frame
+ *
+ * @v conn		HTTP/2 connection
+ * @v id		Stream identifier
+ * @v code		Error code
+ * @ret rc		Return status code
+ */
+static int http2_tx_rst_stream ( struct http2_connection *conn, uint32_t id,
+				 unsigned int code ) {
+	struct http2_rst_stream rst;
+
+	rst.code = htonl ( code );
+	return http2_tx ( conn, HTTP2_RST_STREAM, 0, id, &rst, sizeof ( rst ) );
+}
+
+/**
+ * Transmit HTTP/2 WINDOW_UPDATE frame
+ *
+ * @v conn		HTTP/2 connection
+ * @v id		Stream identifier (or zero for the connection)
+ * @v increment		Window size increment
+ * @ret rc		Return status code
+ */
+static int http2_tx_window_update ( struct http2_connection *conn,
+				    uint32_t id, size_t increment ) {
+	struct http2_window_update update;
+
+	update.increment = htonl ( increment );
+	return http2_tx ( conn, HTTP2_WINDOW_UPDATE, 0, id, &update,
+			  sizeof ( update ) );
+}
+
+/**
+ * Transmit HTTP/2 GOAWAY frame
+ *
+ * @v conn		HTTP/2 connection
+ * @v code		Error code
+ * @ret rc		Return status code
+ */
+static int http2_tx_goaway ( struct http2_connection *conn,
+			     unsigned int code ) {
+	struct http2_goaway goaway;
+
+	/* We never accept server-initiated streams */
+	goaway.last = htonl ( 0 );
+	goaway.code = htonl ( code );
+	return http2_tx ( conn, HTTP2_GOAWAY, 0, 0, &goaway,
+			  sizeof ( goaway ) );
+}
+
+/**
+ * Determine HTTP/2 error code for a connection error
+ *
+ * @v rc		Return status code
+ * @ret code		HTTP/2 error code
+ */
+static unsigned int http2_error_code ( int rc ) {
+
+	if ( rc == -EPROTO_FRAME_SIZE )
+		return HTTP2_FRAME_SIZE_ERROR;
+	if ( rc == -EPROTO_FLOW )
+		return HTTP2_FLOW_CONTROL_ERROR;
+	if ( rc == -EPROTO_HPACK )
+		return HTTP2_COMPRESSION_ERROR;
+	if ( rc == -ENOMEM )
+		return HTTP2_INTERNAL_ERROR;
+	return HTTP2_PROTOCOL_ERROR;
+}
+
+/**
+ * Transmit pending request bodies
+ *
+ * @v conn		HTTP/2 connection
+ * @ret rc		Return status code
+ */
+static int http2_tx_data ( struct http2_connection *conn ) {
+	struct http2_stream *stream;
+	struct io_buffer *body;
+	unsigned int flags;
+	size_t avail;
+	size_t len;
+	long window;
+	int rc;
+
+	list_for_each_entry ( stream, &conn->streams, list ) {
+		while ( ( body = stream->body ) ) {
+
+			/* Calculate permitted length */
+			window = conn->tx_window;
+			if ( window > stream->tx_window )
+				window = stream->tx_window;
+			if ( window <= 0 )
+				break;
+			len = iob_len ( body );
+			if ( len > ( ( size_t ) window ) )
+				len = window;
+			if ( len > HTTP2_MAX_FRAME )
+				len = HTTP2_MAX_FRAME;
+			avail = xfer_window ( &conn->socket );
+			if ( len > avail )
+				len = avail;
+			if ( ! len )
+				break;
+
+			/* Transmit DATA frame */
+			flags = ( ( len == iob_len ( body ) ) ?
+				  HTTP2_END_STREAM : 0 );
+			if ( ( rc = http2_tx ( conn, HTTP2_DATA, flags,
+					       stream->id, body->data,
+					       len ) ) != 0 )
+				return rc;
+			iob_pull ( body, len );
+			conn->tx_window -= len;
+			stream->tx_window -= len;
+
+			/* Free body once completely transmitted */
+			if ( flags ) {
+				free_iob ( body );
+				stream->body = NULL;
+				stream->flags |= HTTP2_STREAM_DONE;
+			}
+		}
+	}
+
+	return 0;
+}
+
+/******************************************************************************
+ *
+ * Streams
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Free HTTP/2 stream
+ *
+ * @v refcnt		Reference count
+ */
+static void http2_stream_free ( struct refcnt *refcnt ) {
+	struct http2_stream *stream =
+		container_of ( refcnt, struct http2_stream, refcnt );
+
+	free ( stream->headers );
+	free_iob ( stream->body );
+	ref_put ( &stream->conn->refcnt );
+	free ( stream );
+}
+
+/**
+ * Find HTTP/2 stream
+ *
+ * @v conn		HTTP/2 connection
+ * @v id		Stream identifier
+ * @ret stream		Stream, or NULL if not found
+ */
+static struct http2_stream * http2_stream ( struct http2_connection *conn,
+					    uint32_t id ) {
+	struct http2_stream *stream;
+
+	list_for_each_entry ( stream, &conn->streams, list ) {
+		if ( ( stream->flags & HTTP2_STREAM_SENT ) &&
+		     ( stream->id == id ) )
+			return stream;
+	}
+	return NULL;
+}
+
+/**
+ * Notify streams that are waiting to transmit
+ *
+ * @v conn		HTTP/2 connection
+ */
+static void http2_notify ( struct http2_connection *conn ) {
+	struct http2_stream *stream;
+	struct http2_stream *tmp;
+
+	list_for_each_entry_safe ( stream, tmp, &conn->streams, list ) {
+		if ( conn->flags & HTTP2_CONN_CLOSED )
+			break;
+		if ( ! ( stream->flags & HTTP2_STREAM_SENT ) )
+			xfer_window_changed ( &stream->xfer );
+	}
+}
+
+/**
+ * Close HTTP/2 stream
+ *
+ * @v stream		HTTP/2 stream
+ * @v rc		Reason for close
+ */
+static void http2_stream_close ( struct http2_stream *stream, int rc ) {
+	struct http2_connection *conn = stream->conn;
+
+	/* Do nothing if already closed */
+	if ( list_empty ( &stream->list ) )
+		return;
+
+	/* Remove from connection */
+	list_del ( &stream->list );
+	INIT_LIST_HEAD ( &stream->list );
+	if ( stream->flags & HTTP2_STREAM_SENT ) {
+		assert ( conn->active > 0 );
+		conn->active--;
+
+		/* Cancel stream if still in progress */
+		if ( ( ( stream->flags &
+			 ( HTTP2_STREAM_DONE | HTTP2_STREAM_ENDED ) ) !=
+		       ( HTTP2_STREAM_DONE | HTTP2_STREAM_ENDED ) ) &&
+		     ! ( conn->flags & HTTP2_CONN_CLOSED ) ) {
+			http2_tx_rst_stream ( conn, stream->id, HTTP2_CANCEL );
+		}
+	}
+
+	/* Shut down interface */
+	intf_shutdown ( &stream->xfer, rc );
+	DBGC2 ( conn, "HTTP2 %p stream %d closed: %s\n",
+		conn, stream->id, strerror ( rc ) );
+
+	/* Close an abandoned connection, start the idle timer, or
+	 * allow a waiting stream to use the newly available slot.
+	 */
+	if ( ! ( conn->flags & HTTP2_CONN_CLOSED ) ) {
+		if ( ! list_empty ( &conn->streams ) ) {
+			http2_notify ( conn );
+		} else if ( conn->flags & HTTP2_CONN_GOAWAY ) {
+			http2_conn_close ( conn, 0 );
+		} else {
+			start_timer_fixed ( &conn->timer, http_conn_expiry() );
+		}
+	}
+
+	/* Drop list's reference */
+	ref_put ( &stream->refcnt );
+}
+
+/**
+ * Ask HTTP/2 stream to reopen its connection
+ *
+ * @v stream		HTTP/2 stream
+ *
+ * This may be used only for streams that the server has not started
+ * to process, and which are therefore always safe to retry.
+ */
+static void http2_stream_reopen ( struct http2_stream *stream ) {
+
+	/* There is nothing to cancel */
+	stream->flags |= ( HTTP2_STREAM_DONE | HTTP2_STREAM_ENDED );
+
+	/* Ask parent to reopen, then close stream */
+	intf_nullify ( &stream->xfer );
+	pool_reopen ( &stream->xfer );
+	http2_stream_close ( stream, 0 );
+}
+
+/**
+ * Reset HTTP/2 stream
+ *
+ * @v stream		HTTP/2 stream
+ * @v code		Error code
+ * @v rc		Reason for reset
+ */
+static void http2_stream_reset ( struct http2_stream *stream,
+				 unsigned int code, int rc ) {
+	struct http2_connection *conn = stream->conn;
+
+	DBGC ( conn, "HTTP2 %p stream %d reset: %s\n",
+	       conn, stream->id, strerror ( rc ) );
+	http2_tx_rst_stream ( conn, stream->id, code );
+	stream->flags |= ( HTTP2_STREAM_DONE | HTTP2_STREAM_ENDED );
+	http2_stream_close ( stream, rc );
+}
+
+/**
+ * Append to HTTP/2 stream response header
+ *
+ * @v stream		HTTP/2 stream
+ * @v fmt		Format string
+ * @v ...		Arguments
+ * @ret rc		Return status code
+ */
+static int http2_stream_append ( struct http2_stream *stream,
+				 const char *fmt, ... ) {
+	va_list args;
+	char *headers;
+	size_t len;
+
+	/* Calculate length */
+	va_start ( args, fmt );
+	len = vsnprintf ( NULL, 0, fmt, args );
+	va_end ( args );
+
+	/* Extend buffer */
+	headers = realloc ( stream->headers,
+			    ( stream->headers_len + len + 1 /* NUL */ ) );
+	if ( ! headers )
+		return -ENOMEM;
+	stream->headers = headers;
+
+	/* Append to buffer */
+	va_start ( args, fmt );
+	vsnprintf ( ( headers + stream->headers_len ), ( len + 1 /* NUL */ ),
+		    fmt, args );
+	va_end ( args );
+	stream->headers_len += len;
+
+	return 0;
+}
+
+/**
+ * Handle decoded response header field
+ *
+ * @v opaque		HTTP/2 stream
+ * @v name		Header name
+ * @v value		Header value
+ * @ret rc		Return status code
+ */
+static int http2_stream_header ( void *opaque, const char *name,
+				 const char *value ) {
+	struct http2_stream *stream = opaque;
+	struct http2_connection *conn = stream->conn;
+
+	/* Ignore trailers */
+	if ( stream->flags & HTTP2_STREAM_RESPONSE )
+		return 0;
+
+	/* Reject anything that cannot be represented in HTTP/1.1 */
+	if ( ( ! name[0] ) || strpbrk ( ( name + 1 ), ":\r\n" ) ||
+	     strpbrk ( value, "\r\n" ) ) {
+		DBGC ( conn, "HTTP2 %p stream %d invalid header \"%s\"\n",
+		       conn, stream->id, name );
+		return -EPROTO_HEADER;
+	}
+
+	/* Translate ":status" pseudo-header into a status line */
+	if ( name[0] == ':' ) {
+		if ( ( stream->flags & HTTP2_STREAM_REGULAR ) ||
+		     stream->headers || ( strcmp ( name, ":status" ) != 0 ) ) {
+			DBGC ( conn, "HTTP2 %p stream %d unexpected \"%s\"\n",
+			       conn, stream->id, name );
+			return -EPROTO_HEADER;
+		}
+		if ( value[0] == '1' )
+			stream->flags |= HTTP2_STREAM_INTERIM;
+		return http2_stream_append ( stream, "HTTP/2.0 %s \r\n",
+					     value );
+	}
+
+	/* Pass through regular header fields */
+	if ( ! stream->headers ) {
+		DBGC ( conn, "HTTP2 %p stream %d missing status\n",
+		       conn, stream->id );
+		return -EPROTO_HEADER;
+	}
+	stream->flags |= HTTP2_STREAM_REGULAR;
+	return http2_stream_append ( stream, "%s: %s\r\n", name, value );
+}
+
+/**
+ * Ignore decoded header field
+ *
+ * @v opaque		Opaque pointer
+ * @v name		Header name
+ * @v value		Header value
+ * @ret rc		Return status code
+ */
+static int http2_ignore_header ( void *opaque __unused,
+				 const char *name __unused,
+				 const char *value __unused ) {
+	return 0;
+}
+
+/**
+ * Deliver response header to HTTP/2 stream
+ *
+ * @v stream		HTTP/2 stream
+ * @v flags		HEADERS frame flags
+ */
+static void http2_stream_response ( struct http2_stream *stream,
+				    unsigned int flags ) {
+	struct io_buffer *iobuf;
+	char *headers;
+	size_t len;
+	int rc;
+
+	/* Take ownership of constructed header */
+	headers = stream->headers;
+	len = stream->headers_len;
+	stream->headers = NULL;
+	stream->headers_len = 0;
+	stream->flags &= ~( HTTP2_STREAM_REGULAR | HTTP2_STREAM_INTERIM );
+
+	/* Handle trailers, which must end the stream */
+	if ( stream->flags & HTTP2_STREAM_RESPONSE ) {
+		assert ( headers == NULL );
+		if ( ! ( flags & HTTP2_END_STREAM ) ) {
+			rc = -EPROTO_RESPONSE;
+			goto err;
+		}
+		stream->flags |= HTTP2_STREAM_ENDED;
+		http2_stream_close ( stream, 0 );
+		return;
+	}
+
+	/* Require a status line */
+	if ( ! headers ) {
+		rc = -EPROTO_RESPONSE;
+		goto err;
+	}
+
+	/* Discard interim responses */
+	if ( headers[ strlen ( "HTTP/2.0 " ) ] == '1' ) {
+		free ( headers );
+		if ( flags & HTTP2_END_STREAM ) {
+			rc = -EPROTO_RESPONSE;
+			goto err;
+		}
+		return;
+	}
+
+	/* Construct HTTP/1.1-style response header */
+	iobuf = xfer_alloc_iob ( &stream->xfer, ( len + 2 /* "\r\n" */ ) );
+	if ( ! iobuf ) {
+		free ( headers );
+		rc = -ENOMEM;
+		goto err;
+	}
+	memcpy ( iob_put ( iobuf, len ), headers, len );
+	memcpy ( iob_put ( iobuf, 2 ), "\r\n", 2 );
+	free ( headers );
+	stream->flags |= HTTP2_STREAM_RESPONSE;
+	if ( flags & HTTP2_END_STREAM )
+		stream->flags |= HTTP2_STREAM_ENDED;
+
+	/* Deliver response header */
+	xfer_deliver_iob ( &stream->xfer, iobuf );
+
+	/* Close stream if response is complete */
+	if ( flags & HTTP2_END_STREAM )
+		http2_stream_close ( stream, 0 );
+
+	return;
+
+ err:
+	http2_stream_reset ( stream, HTTP2_PROTOCOL_ERROR, rc );
+}
+
+/**
+ * Add field to encoded request header block
+ *
+ * @v data		Header block, or NULL
+ * @v len		Length of header block to update
+ * @v index		Static table index, or zero
+ * @v name		Name
+ * @v value		Value, or NULL
+ */
+static void http2_encode_field ( uint8_t *data, size_t *len,
+				 unsigned int index, const char *name,
+				 const char *value ) {
+
+	*len += hpack_encode ( ( data ? ( data + *len ) : NULL ),
+			       index, name, value );
+}
+
+/**
+ * Encode request header block
+ *
+ * @v data		Header block, or NULL to calculate length
+ * @v method		Request method
+ * @v path		Request path
+ * @v authority		Authority, or NULL
+ * @v fields		Regular header fields
+ * @v count		Number of regular header fields
+ * @ret len		Length of header block
+ */
+static size_t http2_encode_request ( uint8_t *data, const char *method,
+				     const char *path, const char *authority,
+				     struct http2_field *fields,
+				     unsigned int count ) {
+	size_t len = 0;
+
+	/* Encode pseudo-header fields */
+	if ( strcmp ( method, "GET" ) == 0 ) {
+		http2_encode_field ( data, &len, HPACK_METHOD_GET, NULL, NULL );
+	} else if ( strcmp ( method, "POST" ) == 0 ) {
+		http2_encode_field ( data, &len, HPACK_METHOD_POST, NULL, NULL);
+	} else {
+		http2_encode_field ( data, &len, HPACK_METHOD, NULL, method );
+	}
+	http2_encode_field ( data, &len, HPACK_SCHEME_HTTPS, NULL, NULL );
+	if ( authority )
+		http2_encode_field ( data, &len, HPACK_AUTHORITY, NULL,
+				     authority );
+	if ( strcmp ( path, "/" ) == 0 ) {
+		http2_encode_field ( data, &len, HPACK_PATH, NULL, NULL );
+	} else {
+		http2_encode_field ( data, &len, HPACK_PATH, NULL, path );
+	}
+
+	/* Encode regular header fields */
+	for ( ; count-- ; fields++ ) {
+		http2_encode_field ( data, &len, 0, fields->name,
+				     fields->value );
+	}
+
+	return len;
+}
+
+/**
+ * Check whether or not request header field must be excluded
+ *
+ * @v name		Header name
+ * @ret excluded	Header field must be excluded
+ */
+static int http2_excluded_field ( const char *name ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < ( sizeof ( http2_excluded ) /
+			    sizeof ( http2_excluded[0] ) ) ; i++ ) {
+		if ( strcasecmp ( name, http2_excluded[i] ) == 0 )
+			return 1;
+	}
+	return 0;
+}
+
+/**
+ * Transmit request
+ *
+ * @v stream		HTTP/2 stream
+ * @v iobuf		I/O buffer containing HTTP/1.1 request
+ * @ret rc		Return status code
+ */
+static int http2_stream_tx_request ( struct http2_stream *stream,
+				     struct io_buffer *iobuf ) {
+	struct http2_connection *conn = stream->conn;
+	const char *authority = NULL;
+	const char *method;
+	const char *path;
+	unsigned int count;
+	unsigned int type;
+	unsigned int flags;
+	uint8_t *block;
+	size_t block_len;
+	size_t offset;
+	size_t frag_len;
+	size_t len;
+	char *header;
+	char *line;
+	char *eol;
+	char *sep;
+	char *value;
+	int rc;
+
+	/* Locate end of request header */
+	len = iob_len ( iobuf );
+	for ( offset = 0 ; ( offset + 4 ) <= len ; offset++ ) {
+		if ( memcmp ( ( iobuf->data + offset ), "\r\n\r\n", 4 ) == 0 )
+			break;
+	}
+	if ( ( offset + 4 ) > len ) {
+		rc = -EINVAL_REQUEST;
+		goto err_header;
+	}
+
+	/* Take a (NUL-terminated) copy of the request header, and
+	 * leave only the request body in the I/O buffer.
+	 */
+	len = ( offset + 2 /* final "\r\n" */ );
+	header = malloc ( len + 1 /* NUL */ );
+	if ( ! header ) {
+		rc = -ENOMEM;
+		goto err_header;
+	}
+	memcpy ( header, iobuf->data, len );
+	header[len] = '\0';
+	iob_pull ( iobuf, ( len + 2 /* blank line */ ) );
+
+	/* Count header lines */
+	count = 0;
+	for ( line = header ; ( line = strstr ( line, "\r\n" ) ) ; line += 2 )
+		count++;
+
+	/* Parse request line and header fields */
+	{
+		struct http2_field fields[count];
+
+		/* Parse request line */
+		line = header;
+		eol = strstr ( line, "\r\n" );
+		*eol = '\0';
+		method = line;
+		path = NULL;
+		if ( ( sep = strchr ( line, ' ' ) ) ) {
+			*(sep++) = '\0';
+			path = sep;
+			if ( ( sep = strchr ( sep, ' ' ) ) )
+				*sep = '\0';
+		}
+		if ( ( ! path ) || ( ! sep ) ) {
+			DBGC ( conn, "HTTP2 %p malformed request \"%s\"\n",
+			       conn, method );
+			rc = -EINVAL_REQUEST;
+			goto err_parse;
+		}
+
+		/* Parse header fields */
+		count = 0;
+		for ( line = ( eol + 2 ) ; ( eol = strstr ( line, "\r\n" ) ) ;
+		      line = ( eol + 2 ) ) {
+			*eol = '\0';
+			sep = strchr ( line, ':' );
+			if ( ! sep ) {
+				rc = -EINVAL_REQUEST;
+				goto err_parse;
+			}
+			*(sep++) = '\0';
+			for ( value = sep ; *value == ' ' ; value++ ) {}
+			if ( strcasecmp ( line, "Host" ) == 0 )
+				authority = value;
+			if ( http2_excluded_field ( line ) )
+				continue;
+			fields[count].name = line;
+			fields[count].value = value;
+			count++;
+		}
+
+		/* Construct header block */
+		block_len = http2_encode_request ( NULL, method, path,
+						   authority, fields, count );
+		block = malloc ( block_len );
+		if ( ! block ) {
+			rc = -ENOMEM;
+			goto err_parse;
+		}
+		http2_encode_request ( block, method, path, authority,
+				       fields, count );
+	}
+
+	/* Allocate stream identifier */
+	stream->id = conn->next_id;
+	conn->next_id += 2;
+	if ( conn->next_id > HTTP2_ID_MASK )
+		conn->flags |= HTTP2_CONN_GOAWAY;
+	stream->flags |= HTTP2_STREAM_SENT;
+	stream->tx_window = conn->initial_window;
+	conn->active++;
+	DBGC2 ( conn, "HTTP2 %p stream %d %s %s\n",
+		conn, stream->id, method, path );
+
+	/* Transmit HEADERS frame and any CONTINUATION frames */
+	type = HTTP2_HEADERS;
+	flags = ( iob_len ( iobuf ) ? 0 : HTTP2_END_STREAM );
+	for ( offset = 0 ; offset < block_len ; offset += frag_len ) {
+		frag_len = ( block_len - offset );
+		if ( frag_len > HTTP2_MAX_FRAME )
+			frag_len = HTTP2_MAX_FRAME;
+		if ( ( offset + frag_len ) == block_len )
+			flags |= HTTP2_END_HEADERS;
+		if ( ( rc = http2_tx ( conn, type, flags, stream->id,
+				       ( block + offset ), frag_len ) ) != 0 )
+			goto err_tx;
+		type = HTTP2_CONTINUATION;
+		flags = 0;
+	}
+
+	/* Retain request body, if any */
+	if ( iob_len ( iobuf ) ) {
+		stream->body = iob_disown ( iobuf );
+	} else {
+		stream->flags |= HTTP2_STREAM_DONE;
+	}
+
+ err_tx:
+	free ( block );
+ err_parse:
+	free ( header );
+ err_header:
+	free_iob ( iobuf );
+	return rc;
+}
+
+/**
+ * Transmit data on behalf of HTTP/2 stream
+ *
+ * @v stream		HTTP/2 stream
+ * @v iobuf		I/O buffer
+ * @v meta		Transfer metadata
+ * @ret rc		Return status code
+ */
+static int http2_stream_xfer_deliver ( struct http2_stream *stream,
+				       struct io_buffer *iobuf,
+				       struct xfer_metadata *meta __unused ) {
+	struct http2_connection *conn = stream->conn;
+	int rc;
+
+	/* The entire request must be delivered at once */
+	if ( stream->flags & HTTP2_STREAM_SENT ) {
+		DBGC ( conn, "HTTP2 %p stream %d unexpected data\n",
+		       conn, stream->id );
+		free_iob ( iobuf );
+		return -EINVAL_REQUEST;
+	}
+
+	/* Transmit request */
+	if ( ( rc = http2_stream_tx_request ( stream, iobuf ) ) != 0 ) {
+		DBGC ( conn, "HTTP2 %p could not transmit request: %s\n",
+		       conn, strerror ( rc ) );
+		return rc;
+	}
+
+	/* Transmit as much of the request body as possible */
+	if ( ( rc = http2_tx_data ( conn ) ) != 0 )
+		return rc;
+
+	return 0;
+}
+
+/**
+ * Check flow control window for HTTP/2 stream
+ *
+ * @v stream		HTTP/2 stream
+ * @ret len		Length of window
+ */
+static size_t http2_stream_xfer_window ( struct http2_stream *stream ) {
+	struct http2_connection *conn = stream->conn;
+
+	/* Only a single request may be transmitted */
+	if ( stream->flags & HTTP2_STREAM_SENT )
+		return 0;
+
+	/* Wait until connection is ready and a stream slot is free */
+	if ( ! ( conn->flags & HTTP2_CONN_READY ) )
+		return 0;
+	if ( conn->flags & HTTP2_CONN_GOAWAY )
+		return 0;
+	if ( conn->active >= conn->max_streams )
+		return 0;
+
+	/* Use transport layer window */
+	return xfer_window ( &conn->socket );
+}
+
+/** HTTP/2 stream data transfer interface operations */
+static struct interface_operation http2_stream_xfer_operations[] = {
+	INTF_OP ( xfer_deliver, struct http2_stream *,
+		  http2_stream_xfer_deliver ),
+	INTF_OP ( xfer_window, struct http2_stream *,
+		  http2_stream_xfer_window ),
+	INTF_OP ( intf_close, struct http2_stream *, http2_stream_close ),
+};
+
+/** HTTP/2 stream data transfer interface descriptor */
+static struct interface_descriptor http2_stream_xfer_desc =
+	INTF_DESC ( struct http2_stream, xfer, http2_stream_xfer_operations );
+
+/**
+ * Open HTTP/2 stream
+ *
+ * @v conn		HTTP/2 connection
+ * @v xfer		Data transfer interface
+ * @ret rc		Return status code
+ */
+static int http2_stream_open ( struct http2_connection *conn,
+			       struct interface *xfer ) {
+	struct http2_stream *stream;
+
+	/* Allocate and initialise structure */
+	stream = zalloc ( sizeof ( *stream ) );
+	if ( ! stream )
+		return -ENOMEM;
+	ref_init ( &stream->refcnt, http2_stream_free );
+	stream->conn = conn;
+	ref_get ( &conn->refcnt );
+	intf_init ( &stream->xfer, &http2_stream_xfer_desc, &stream->refcnt );
+
+	/* Add to connection (which holds our only reference), and
+	 * attach to parent interface.
+	 */
+	list_add_tail ( &stream->list, &conn->streams );
+	stop_timer ( &conn->timer );
+	intf_plug_plug ( &stream->xfer, xfer );
+
+	return 0;
+}
+
+/******************************************************************************
+ *
+ * Frame reception
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Remove padding from HTTP/2 frame payload
+ *
+ * @v flags		Frame flags
+ * @v payload		Payload to update
+ * @v len		Length of payload to update
+ * @ret rc		Return status code
+ */
+static int http2_unpad ( unsigned int flags, uint8_t **payload,
+			 size_t *len ) {
+	size_t pad_len;
+
+	/* Do nothing unless frame is padded */
+	if ( ! ( flags & HTTP2_PADDED ) )
+		return 0;
+
+	/* Strip padding length and padding */
+	if ( ! *len )
+		return -EPROTO_PADDING;
+	pad_len = **payload;
+	(*payload)++;
+	(*len)--;
+	if ( pad_len > *len )
+		return -EPROTO_PADDING;
+	*len -= pad_len;
+
+	return 0;
+}
+
+/**
+ * Receive HTTP/2 DATA frame
+ *
+ * @v conn		HTTP/2 connection
+ * @v id		Stream identifier
+ * @v flags		Frame flags
+ * @v payload		Payload
+ * @v len		Length of payload
+ * @ret rc		Return status code
+ */
+static int http2_rx_data ( struct http2_connection *conn, uint32_t id,
+			   unsigned int flags, uint8_t *payload, size_t len ) {
+	struct http2_stream *stream;
+	struct io_buffer *iobuf;
+	size_t frame_len = len;
+	int rc;
+
+	/* Sanity check */
+	if ( ! id )
+		return -EPROTO_STREAM;
+
+	/* Replenish connection window (including for cancelled streams) */
+	conn->rx_consumed += frame_len;
+	if ( conn->rx_consumed >= ( HTTP2_WINDOW / 2 ) ) {
+		if ( ( rc = http2_tx_window_update ( conn, 0,
+						     conn->rx_consumed ) ) != 0)
+			return rc;
+		conn->rx_consumed = 0;
+	}
+
+	/* Strip padding */
+	if ( ( rc = http2_unpad ( flags, &payload, &len ) ) != 0 )
+		return rc;
+
+	/* Ignore data for cancelled streams */
+	stream = http2_stream ( conn, id );
+	if ( ! stream )
+		return 0;
+
+	/* Data must follow the response header */
+	if ( ! ( stream->flags & HTTP2_STREAM_RESPONSE ) ) {
+		http2_stream_reset ( stream, HTTP2_PROTOCOL_ERROR,
+				     -EPROTO_RESPONSE );
+		return 0;
+	}
+
+	/* Replenish stream window, unless stream is ending */
+	if ( flags & HTTP2_END_STREAM ) {
+		stream->flags |= HTTP2_STREAM_ENDED;
+	} else {
+		stream->rx_consumed += frame_len;
+		if ( stream->rx_consumed >= ( HTTP2_WINDOW / 2 ) ) {
+			if ( ( rc = http2_tx_window_update ( conn, id,
+					     stream->rx_consumed ) ) != 0 )
+				return rc;
+			stream->rx_consumed = 0;
+		}
+	}
+
+	/* Deliver data, and close stream if response is complete.
+	 * The parent may close the stream as soon as it receives the
+	 * data, so hold a reference while doing so.
+	 */
+	ref_get ( &stream->refcnt );
+	if ( len ) {
+		iobuf = xfer_alloc_iob ( &stream->xfer, len );
+		if ( iobuf ) {
+			memcpy ( iob_put ( iobuf, len ), payload, len );
+			xfer_deliver_iob ( &stream->xfer, iobuf );
+		} else {
+			http2_stream_reset ( stream, HTTP2_INTERNAL_ERROR,
+					     -ENOMEM );
+		}
+	}
+	if ( flags & HTTP2_END_STREAM )
+		http2_stream_close ( stream, 0 );
+	ref_put ( &stream->refcnt );
+
+	return 0;
+}
+
+/**
+ * Receive complete HTTP/2 header block
+ *
+ * @v conn		HTTP/2 connection
+ * @v id		Stream identifier
+ * @v flags		HEADERS frame flags
+ * @v block		Header block
+ * @v len		Length of header block
+ * @ret rc		Return status code
+ */
+static int http2_rx_block ( struct http2_connection *conn, uint32_t id,
+			    unsigned int flags, const void *block,
+			    size_t len ) {
+	struct http2_stream *stream;
+	int rc;
+
+	/* Identify stream (which may have been cancelled) */
+	stream = http2_stream ( conn, id );
+
+	/* Decode header block.  This must be done even for cancelled
+	 * streams, since it updates the decompression table.
+	 */
+	if ( stream ) {
+		rc = hpack_decode ( &conn->hpack, block, len,
+				    http2_stream_header, stream );
+	} else {
+		rc = hpack_decode ( &conn->hpack, block, len,
+				    http2_ignore_header, NULL );
+	}
+	if ( rc != 0 ) {
+		DBGC ( conn, "HTTP2 %p stream %d could not decode headers: "
+		       "%s\n", conn, id, strerror ( rc ) );
+		if ( ( rc != -ENOMEM ) && ( rc != -EPROTO_HEADER ) )
+			rc = -EPROTO_HPACK;
+		return rc;
+	}
+
+	/* Deliver response header, if applicable */
+	if ( stream ) {
+		ref_get ( &stream->refcnt );
+		http2_stream_response ( stream, flags );
+		ref_put ( &stream->refcnt );
+	}
+
+	return 0;
+}
+
+/**
+ * Receive HTTP/2 HEADERS frame
+ *
+ * @v conn		HTTP/2 connection
+ * @v id		Stream identifier
+ * @v flags		Frame flags
+ * @v payload		Payload
+ * @v len		Length of payload
+ * @ret rc		Return status code
+ */
+static int http2_rx_headers ( struct http2_connection *conn, uint32_t id,
+			      unsigned int flags, uint8_t *payload,
+			      size_t len ) {
+	int rc;
+
+	/* Sanity check */
+	if ( ! id )
+		return -EPROTO_STREAM;
+
+	/* Strip padding and priority fields */
+	if ( ( rc = http2_unpad ( flags, &payload, &len ) ) != 0 )
+		return rc;
+	if ( flags & HTTP2_PRIORITY_FLAG ) {
+		if ( len < HTTP2_PRIORITY_LEN )
+			return -EPROTO_FRAME_SIZE;
+		payload += HTTP2_PRIORITY_LEN;
+		len -= HTTP2_PRIORITY_LEN;
+	}
+
+	/* Process header block, if complete */
+	if ( flags & HTTP2_END_HEADERS )
+		return http2_rx_block ( conn, id, flags, payload, len );
+
+	/* Otherwise, hold header block until CONTINUATION frames arrive */
+	assert ( conn->block == NULL );
+	conn->block = malloc ( len );
+	if ( len && ( ! conn->block ) )
+		return -ENOMEM;
+	memcpy ( conn->block, payload, len );
+	conn->block_len = len;
+	conn->block_id = id;
+	conn->block_flags = flags;
+
+	return 0;
+}
+
+/**
+ * Receive HTTP/2 CONTINUATION frame
+ *
+ * @v conn		HTTP/2 connection
+ * @v id		Stream identifier
+ * @v flags		Frame flags
+ * @v payload		Payload
+ * @v len		Length of payload
+ * @ret rc		Return status code
+ */
+static int http2_rx_continuation ( struct http2_connection *conn,
+				   uint32_t id, unsigned int flags,
+				   uint8_t *payload, size_t len ) {
+	uint8_t *block;
+	size_t block_len;
+	int rc;
+
+	/* Must continue an incomplete header block */
+	if ( ( ! conn->block_id ) || ( id != conn->block_id ) )
+		return -EPROTO_CONTINUATION;
+
+	/* Append to header block */
+	block_len = ( conn->block_len + len );
+	if ( block_len > HTTP2_MAX_BLOCK )
+		return -EPROTO_FRAME_SIZE;
+	block = realloc ( conn->block, block_len );
+	if ( block_len && ( ! block ) )
+		return -ENOMEM;
+	memcpy ( ( block + conn->block_len ), payload, len );
+	conn->block = block;
+	conn->block_len = block_len;
+
+	/* Wait for remaining CONTINUATION frames, if applicable */
+	if ( ! ( flags & HTTP2_END_HEADERS ) )
+		return 0;
+
+	/* Process header block */
+	conn->block = NULL;
+	conn->block_id = 0;
+	rc = http2_rx_block ( conn, id, conn->block_flags, block, block_len );
+	free ( block );
+	return rc;
+}
+
+/**
+ * Receive HTTP/2 RST_STREAM frame
+ *
+ * @v conn		HTTP/2 connection
+ * @v id		Stream identifier
+ * @v payload		Payload
+ * @v len		Length of payload
+ * @ret rc		Return status code
+ */
+static int http2_rx_rst_stream ( struct http2_connection *conn, uint32_t id,
+				 uint8_t *payload, size_t len ) {
+	struct http2_rst_stream *rst = ( ( void * ) payload );
+	struct http2_stream *stream;
+	unsigned int code;
+
+	/* Sanity checks */
+	if ( ! id )
+		return -EPROTO_STREAM;
+	if ( len != sizeof ( *rst ) )
+		return -EPROTO_FRAME_SIZE;
+	code = ntohl ( rst->code );
+
+	/* Identify stream */
+	stream = http2_stream ( conn, id );
+	if ( ! stream )
+		return 0;
+	DBGC ( conn, "HTTP2 %p stream %d reset by server (code %#x)\n",
+	       conn, id, code );
+
+	/* Retry refused streams, and fail any others */
+	stream->flags |= ( HTTP2_STREAM_DONE | HTTP2_STREAM_ENDED );
+	if ( code == HTTP2_REFUSED_STREAM ) {
+		http2_stream_reopen ( stream );
+	} else {
+		http2_stream_close ( stream, -ECONNRESET_STREAM );
+	}
+
+	return 0;
+}
+
+/**
+ * Receive HTTP/2 SETTINGS frame
+ *
+ * @v conn		HTTP/2 connection
+ * @v id		Stream identifier
+ * @v flags		Frame flags
+ * @v payload		Payload
+ * @v len		Length of payload
+ * @ret rc		Return status code
+ */
+static int http2_rx_settings ( struct http2_connection *conn, uint32_t id,
+			       unsigned int flags, uint8_t *payload,
+			       size_t len ) {
+	struct http2_setting *setting = ( ( void * ) payload );
+	struct http2_stream *stream;
+	unsigned long value;
+	long delta;
+	int rc;
+
+	/* Sanity checks */
+	if ( id )
+		return -EPROTO_STREAM;
+	if ( flags & HTTP2_ACK )
+		return ( len ? -EPROTO_FRAME_SIZE : 0 );
+	if ( len % sizeof ( *setting ) )
+		return -EPROTO_FRAME_SIZE;
+
+	/* Apply settings */
+	for ( ; len ; setting++, len -= sizeof ( *setting ) ) {
+		value = ntohl ( setting->value );
+		switch ( ntohs ( setting->id ) ) {
+		case HTTP2_SETTINGS_MAX_CONCURRENT_STREAMS:
+			conn->max_streams = value;
+			break;
+		case HTTP2_SETTINGS_INITIAL_WINDOW_SIZE:
+			if ( value > HTTP2_MAX_WINDOW )
+				return -EPROTO_FLOW;
+			delta = ( value - conn->initial_window );
+			list_for_each_entry ( stream, &conn->streams, list ) {
+				if ( ( stream->tx_window + delta ) >
+				     HTTP2_MAX_WINDOW )
+					return -EPROTO_FLOW;
+				stream->tx_window += delta;
+			}
+			conn->initial_window = value;
+			break;
+		case HTTP2_SETTINGS_MAX_FRAME_SIZE:
+			if ( ( value < HTTP2_MAX_FRAME ) ||
+			     ( value > HTTP2_MAX_FRAME_LIMIT ) )
+				return -EPROTO_SETTING;
+			break;
+		default:
+			/* Ignore unused or unknown settings */
+			break;
+		}
+	}
+
+	/* Acknowledge settings */
+	if ( ( rc = http2_tx ( conn, HTTP2_SETTINGS, HTTP2_ACK, 0,
+			       NULL, 0 ) ) != 0 )
+		return rc;
+
+	/* Windows and stream limit may have changed */
+	if ( ( rc = http2_tx_data ( conn ) ) != 0 )
+		return rc;
+	http2_notify ( conn );
+
+	return 0;
+}
+
+/**
+ * Receive HTTP/2 PING frame
+ *
+ * @v conn		HTTP/2 connection
+ * @v id		Stream identifier
+ * @v flags		Frame flags
+ * @v payload		Payload
+ * @v len		Length of payload
+ * @ret rc		Return status code
+ */
+static int http2_rx_ping ( struct http2_connection *conn, uint32_t id,
+			   unsigned int flags, uint8_t *payload, size_t len ) {
+
+	/* Sanity checks */
+	if ( id )
+		return -EPROTO_STREAM;
+	if ( len != HTTP2_PING_LEN )
+		return -EPROTO_FRAME_SIZE;
+
+	/* Ignore responses (since we never send a PING) */
+	if ( flags & HTTP2_ACK )
+		return 0;
+
+	/* Respond to PING */
+	return http2_tx ( conn, HTTP2_PING, HTTP2_ACK, 0, payload, len );
+}
+
+/**
+ * Receive HTTP/2 GOAWAY frame
+ *
+ * @v conn		HTTP/2 connection
+ * @v id		Stream identifier
+ * @v payload		Payload
+ * @v len		Length of payload
+ * @ret rc		Return status code
+ */
+static int http2_rx_goaway ( struct http2_connection *conn, uint32_t id,
+			     uint8_t *payload, size_t len ) {
+	struct http2_goaway *goaway = ( ( void * ) payload );
+	struct http2_stream *stream;
+	struct http2_stream *tmp;
+	uint32_t last;
+	unsigned int code;
+
+	/* Sanity checks */
+	if ( id )
+		return -EPROTO_STREAM;
+	if ( len < sizeof ( *goaway ) )
+		return -EPROTO_FRAME_SIZE;
+	last = ( ntohl ( goaway->last ) & HTTP2_ID_MASK );
+	code = ntohl ( goaway->code );
+	DBGC ( conn, "HTTP2 %p GOAWAY after stream %d (code %#x)\n",
+	       conn, last, code );
+
+	/* Create no further streams on this connection */
+	conn->flags |= HTTP2_CONN_GOAWAY;
+
+	/* Retry any streams that the server has not processed.  Note
+	 * that the connection will be closed when the last stream is
+	 * closed.
+	 */
+	ref_get ( &conn->refcnt );
+	list_for_each_entry_safe ( stream, tmp, &conn->streams, list ) {
+		if ( conn->flags & HTTP2_CONN_CLOSED )
+			break;
+		if ( ( ! ( stream->flags & HTTP2_STREAM_SENT ) ) ||
+		     ( stream->id > last ) ) {
+			http2_stream_reopen ( stream );
+		}
+	}
+	if ( list_empty ( &conn->streams ) )
+		http2_conn_close ( conn, 0 );
+	ref_put ( &conn->refcnt );
+
+	return 0;
+}
+
+/**
+ * Receive HTTP/2 WINDOW_UPDATE frame
+ *
+ * @v conn		HTTP/2 connection
+ * @v id		Stream identifier
+ * @v payload		Payload
+ * @v len		Length of payload
+ * @ret rc		Return status code
+ */
+static int http2_rx_window_update ( struct http2_connection *conn,
+				    uint32_t id, uint8_t *payload,
+				    size_t len ) {
+	struct http2_window_update *update = ( ( void * ) payload );
+	struct http2_stream *stream;
+	long increment;
+
+	/* Sanity check */
+	if ( len != sizeof ( *update ) )
+		return -EPROTO_FRAME_SIZE;
+	increment = ( ntohl ( update->increment ) & HTTP2_ID_MASK );
+
+	/* Update connection or stream window */
+	if ( ! id ) {
+		if ( ( ! increment ) ||
+		     ( ( conn->tx_window + increment ) > HTTP2_MAX_WINDOW ) )
+			return -EPROTO_FLOW;
+		conn->tx_window += increment;
+	} else {
+		stream = http2_stream ( conn, id );
+		if ( ! stream )
+			return 0;
+		if ( ( ! increment ) ||
+		     ( ( stream->tx_window + increment ) > HTTP2_MAX_WINDOW ) ) {
+			http2_stream_reset ( stream, HTTP2_FLOW_CONTROL_ERROR,
+					     -EPROTO_FLOW );
+			return 0;
+		}
+		stream->tx_window += increment;
+	}
+
+	/* Transmit any request data now permitted */
+	return http2_tx_data ( conn );
+}
+
+/**
+ * Receive HTTP/2 frame
+ *
+ * @v conn		HTTP/2 connection
+ * @ret rc		Return status code
+ */
+static int http2_rx_frame ( struct http2_connection *conn ) {
+	struct http2_frame_header *hdr = &conn->rx.hdr;
+	uint8_t *payload = conn->rx.payload;
+	size_t len = http2_frame_len ( hdr );
+	uint32_t id = ( ntohl ( hdr->stream ) & HTTP2_ID_MASK );
+	unsigned int flags = hdr->flags;
+
+	/* An incomplete header block may be followed only by its
+	 * CONTINUATION frames.
+	 */
+	if ( conn->block_id && ( hdr->type != HTTP2_CONTINUATION ) )
+		return -EPROTO_CONTINUATION;
+
+	/* Handle frame */
+	switch ( hdr->type ) {
+	case HTTP2_DATA:
+		return http2_rx_data ( conn, id, flags, payload, len );
+	case HTTP2_HEADERS:
+		return http2_rx_headers ( conn, id, flags, payload, len );
+	case HTTP2_RST_STREAM:
+		return http2_rx_rst_stream ( conn, id, payload, len );
+	case HTTP2_SETTINGS:
+		return http2_rx_settings ( conn, id, flags, payload, len );
+	case HTTP2_PUSH_PROMISE:
+		/* We disable server push in our SETTINGS frame */
+		return -EPROTO_PUSH;
+	case HTTP2_PING:
+		return http2_rx_ping ( conn, id, flags, payload, len );
+	case HTTP2_GOAWAY:
+		return http2_rx_goaway ( conn, id, payload, len );
+	case HTTP2_WINDOW_UPDATE:
+		return http2_rx_window_update ( conn, id, payload, len );
+	case HTTP2_CONTINUATION:
+		return http2_rx_continuation ( conn, id, flags, payload, len );
+	default:
+		/* Ignore PRIORITY and unknown frame types */
+		return 0;
+	}
+}
+
+/******************************************************************************
+ *
+ * Connections
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Free HTTP/2 connection
+ *
+ * @v refcnt		Reference count
+ */
+static void http2_conn_free ( struct refcnt *refcnt ) {
+	struct http2_connection *conn =
+		container_of ( refcnt, struct http2_connection, refcnt );
+
+	hpack_fini ( &conn->hpack );
+	free ( conn->block );
+	uri_put ( conn->uri );
+	free ( conn );
+}
+
+/**
+ * Close HTTP/2 connection
+ *
+ * @v conn		HTTP/2 connection
+ * @v rc		Reason for close
+ */
+static void http2_conn_close ( struct http2_connection *conn, int rc ) {
+	struct http2_stream *stream;
+	struct http2_stream *tmp;
+
+	/* Do nothing if already closed */
+	if ( conn->flags & HTTP2_CONN_CLOSED )
+		return;
+	conn->flags |= ( HTTP2_CONN_CLOSED | HTTP2_CONN_GOAWAY );
+
+	/* Stop idle timer */
+	stop_timer ( &conn->timer );
+
+	/* Retry streams not yet sent on an orderly close of an
+	 * established connection, and fail all other streams.
+	 */
+	list_for_each_entry_safe ( stream, tmp, &conn->streams, list ) {
+		if ( ( rc == 0 ) && ( conn->flags & HTTP2_CONN_READY ) &&
+		     ! ( stream->flags & HTTP2_STREAM_SENT ) ) {
+			http2_stream_reopen ( stream );
+		} else {
+			http2_stream_close ( stream,
+					     ( rc ? rc : -ECONNRESET_CLOSED ) );
+		}
+	}
+
+	/* Shut down transport layer interface */
+	intf_shutdown ( &conn->socket, rc );
+	DBGC ( conn, "HTTP2 %p closed https://%s:%d: %s\n",
+	       conn, conn->uri->host, conn->port, strerror ( rc ) );
+
+	/* Remove from list of connections and drop list's reference */
+	list_del ( &conn->list );
+	ref_put ( &conn->refcnt );
+}
+
+/**
+ * Abort HTTP/2 connection due to a connection error
+ *
+ * @v conn		HTTP/2 connection
+ * @v rc		Reason for abort
+ */
+static void http2_conn_abort ( struct http2_connection *conn, int rc ) {
+
+	DBGC ( conn, "HTTP2 %p connection error: %s\n", conn, strerror ( rc ) );
+	if ( ! ( conn->flags & HTTP2_CONN_CLOSED ) )
+		http2_tx_goaway ( conn, http2_error_code ( rc ) );
+	http2_conn_close ( conn, rc );
+}
+
+/**
+ * Handle idle HTTP/2 connection timer expiry
+ *
+ * @v timer		Idle timer
+ * @v over		Failure indicator
+ */
+static void http2_conn_expired ( struct retry_timer *timer,
+				 int over __unused ) {
+	struct http2_connection *conn =
+		container_of ( timer, struct http2_connection, timer );
+
+	/* Close connection gracefully */
+	assert ( list_empty ( &conn->streams ) );
+	DBGC2 ( conn, "HTTP2 %p idle\n", conn );
+	http2_tx_goaway ( conn, HTTP2_NO_ERROR );
+	http2_conn_close ( conn, 0 );
+}
+
+/**
+ * Start HTTP/2 connection
+ *
+ * @v conn		HTTP/2 connection
+ * @ret rc		Return status code
+ */
+static int http2_conn_start ( struct http2_connection *conn ) {
+	struct http2_client_settings settings;
+	int rc;
+
+	/* Transmit connection preface */
+	if ( ( rc = xfer_deliver_raw ( &conn->socket, HTTP2_PREFACE,
+				       ( sizeof ( HTTP2_PREFACE ) - 1 ) ) ) !=0)
+		return rc;
+
+	/* Transmit SETTINGS frame */
+	settings.push.id = htons ( HTTP2_SETTINGS_ENABLE_PUSH );
+	settings.push.value = htonl ( 0 );
+	settings.window.id = htons ( HTTP2_SETTINGS_INITIAL_WINDOW_SIZE );
+	settings.window.value = htonl ( HTTP2_WINDOW );
+	if ( ( rc = http2_tx ( conn, HTTP2_SETTINGS, 0, 0, &settings,
+			       sizeof ( settings ) ) ) != 0 )
+		return rc;
+
+	/* Enlarge connection window */
+	if ( ( rc = http2_tx_window_update ( conn, 0,
+					     ( HTTP2_WINDOW -
+					       HTTP2_DEFAULT_WINDOW ) ) ) != 0 )
+		return rc;
+
+	/* Mark connection as ready */
+	conn->flags |= HTTP2_CONN_READY;
+	DBGC2 ( conn, "HTTP2 %p ready\n", conn );
+
+	return 0;
+}
+
+/**
+ * Abandon HTTP/2 connection to server not supporting HTTP/2
+ *
+ * @v conn		HTTP/2 connection
+ */
+static void http2_conn_refused ( struct http2_connection *conn ) {
+	struct http2_stream *stream;
+	struct http2_stream *tmp;
+
+	/* Ask all streams to reopen their connections.  Note that
+	 * the connection will be closed when the last stream is
+	 * closed.
+	 */
+	conn->flags |= HTTP2_CONN_GOAWAY;
+	ref_get ( &conn->refcnt );
+	list_for_each_entry_safe ( stream, tmp, &conn->streams, list ) {
+		if ( conn->flags & HTTP2_CONN_CLOSED )
+			break;
+		http2_stream_reopen ( stream );
+	}
+	http2_conn_close ( conn, 0 );
+	ref_put ( &conn->refcnt );
+}
+
+/**
+ * Handle transport layer window change
+ *
+ * @v conn		HTTP/2 connection
+ */
+static void http2_conn_socket_window_changed ( struct http2_connection *conn ){
+	const char *protocol;
+	int rc;
+
+	/* Start connection once protocol negotiation is complete */
+	if ( ! ( conn->flags & HTTP2_CONN_READY ) ) {
+
+		/* Wait for TLS handshake to complete */
+		protocol = tls_protocol ( &conn->socket );
+		if ( ! protocol )
+			return;
+
+		/* Fall back to HTTP/1.1 if server did not select HTTP/2 */
+		if ( strcmp ( protocol, HTTP2_PROTOCOL ) != 0 ) {
+			DBGC ( conn, "HTTP2 %p https://%s:%d does not support "
+			       "HTTP/2\n", conn, conn->uri->host, conn->port );
+			http2_refuse ( conn->uri->host, conn->port );
+			http2_conn_refused ( conn );
+			return;
+		}
+
+		/* Start connection */
+		if ( ( rc = http2_conn_start ( conn ) ) != 0 ) {
+			http2_conn_close ( conn, rc );
+			return;
+		}
+	}
+
+	/* Transmit any pending request data */
+	if ( ( rc = http2_tx_data ( conn ) ) != 0 ) {
+		http2_conn_close ( conn, rc );
+		return;
+	}
+
+	/* Notify streams waiting to transmit */
+	http2_notify ( conn );
+}
+
+/**
+ * Receive data from transport layer interface
+ *
+ * @v conn		HTTP/2 connection
+ * @v iobuf		I/O buffer
+ * @v meta		Transfer metadata
+ * @ret rc		Return status code
+ */
+static int http2_conn_socket_deliver ( struct http2_connection *conn,
+				       struct io_buffer *iobuf,
+				       struct xfer_metadata *meta __unused ) {
+	size_t frame_len;
+	size_t frag_len;
+	int rc = 0;
+
+	/* Processing a frame may close the connection */
+	ref_get ( &conn->refcnt );
+
+	/* Reassemble and process frames */
+	while ( iob_len ( iobuf ) && ! ( conn->flags & HTTP2_CONN_CLOSED ) ) {
+
+		/* Determine length of frame header or frame */
+		frame_len = sizeof ( conn->rx.hdr );
+		if ( conn->rx_len >= frame_len )
+			frame_len += http2_frame_len ( &conn->rx.hdr );
+
+		/* Accumulate data */
+		frag_len = ( frame_len - conn->rx_len );
+		if ( frag_len > iob_len ( iobuf ) )
+			frag_len = iob_len ( iobuf );
+		memcpy ( ( ( ( void * ) &conn->rx ) + conn->rx_len ),
+			 iobuf->data, frag_len );
+		iob_pull ( iobuf, frag_len );
+		conn->rx_len += frag_len;
+		if ( conn->rx_len < frame_len )
+			continue;
+
+		/* Check payload length once frame header is complete */
+		if ( frame_len == sizeof ( conn->rx.hdr ) ) {
+			frag_len = http2_frame_len ( &conn->rx.hdr );
+			if ( frag_len > HTTP2_MAX_FRAME ) {
+				rc = -EPROTO_FRAME_SIZE;
+				goto err;
+			}
+			if ( frag_len )
+				continue;
+		}
+
+		/* Process frame */
+		conn->rx_len = 0;
+		if ( ( rc = http2_rx_frame ( conn ) ) != 0 )
+			goto err;
+	}
+
+	free_iob ( iobuf );
+	ref_put ( &conn->refcnt );
+	return 0;
+
+ err:
+	free_iob ( iobuf );
+	http2_conn_abort ( conn, rc );
+	ref_put ( &conn->refcnt );
+	return rc;
+}
+
+/** HTTP/2 connection socket interface operations */
+static struct interface_operation http2_conn_socket_operations[] = {
+	INTF_OP ( xfer_deliver, struct http2_connection *,
+		  http2_conn_socket_deliver ),
+	INTF_OP ( xfer_window_changed, struct http2_connection *,
+		  http2_conn_socket_window_changed ),
+	INTF_OP ( intf_close, struct http2_connection *, http2_conn_close ),
+};
+
+/** HTTP/2 connection socket interface descriptor */
+static struct interface_descriptor http2_conn_socket_desc =
+	INTF_DESC ( struct http2_connection, socket,
+		    http2_conn_socket_operations );
+
+/**
+ * Connect to an HTTP/2 server
+ *
+ * @v xfer		Data transfer interface
+ * @v scheme		HTTP scheme
+ * @v uri		Connection URI
+ * @v port		Port
+ * @ret rc		Return status code
+ *
+ * HTTP/2 is attempted only for HTTPS servers not already known to
+ * lack support for HTTP/2.  If the server does not select HTTP/2
+ * during the TLS handshake, then the caller will receive a
+ * pool_reopen() message and should connect again.
+ */
+int http2_connect ( struct interface *xfer, struct http_scheme *scheme,
+		    struct uri *uri, unsigned int port ) {
+	struct http2_connection *conn;
+	struct sockaddr_tcpip server;
+	struct interface *socket;
+	int rc;
+
+	/* HTTP/2 is negotiated only via TLS */
+	if ( strcmp ( scheme->name, "https" ) != 0 )
+		return -ENOTSUP;
+
+	/* Do not attempt HTTP/2 if server is known not to support it */
+	if ( http2_refusal ( uri->host, port ) )
+		return -ENOTSUP;
+
+	/* Use an existing connection, if possible */
+	list_for_each_entry ( conn, &http2_connections, list ) {
+		if ( ( ! ( conn->flags & HTTP2_CONN_GOAWAY ) ) &&
+		     ( conn->port == port ) &&
+		     ( strcmp ( conn->uri->host, uri->host ) == 0 ) ) {
+			DBGC2 ( conn, "HTTP2 %p reused https://%s:%d\n",
+				conn, uri->host, port );
+			return http2_stream_open ( conn, xfer );
+		}
+	}
+
+	/* Allocate and initialise structure */
+	conn = zalloc ( sizeof ( *conn ) );
+	if ( ! conn )
+		return -ENOMEM;
+	ref_init ( &conn->refcnt, http2_conn_free );
+	conn->uri = uri_get ( uri );
+	conn->port = port;
+	intf_init ( &conn->socket, &http2_conn_socket_desc, &conn->refcnt );
+	INIT_LIST_HEAD ( &conn->streams );
+	timer_init ( &conn->timer, http2_conn_expired, &conn->refcnt );
+	conn->next_id = 1;
+	conn->max_streams = HTTP2_DEFAULT_MAX_STREAMS;
+	conn->initial_window = HTTP2_DEFAULT_WINDOW;
+	conn->tx_window = HTTP2_DEFAULT_WINDOW;
+	hpack_init ( &conn->hpack, HPACK_TABLE_SIZE );
+
+	/* Add to list of connections (which holds our only reference) */
+	list_add ( &conn->list, &http2_connections );
+
+	/* Open TLS connection offering HTTP/2 */
+	memset ( &server, 0, sizeof ( server ) );
+	server.st_port = htons ( port );
+	socket = &conn->socket;
+	if ( ( rc = add_tls_alpn ( socket, uri->host, port, HTTP2_ALPN,
+				   &socket ) ) != 0 )
+		goto err_tls;
+	if ( ( rc = xfer_open_named_socket ( socket, SOCK_STREAM,
+					     ( struct sockaddr * ) &server,
+					     uri->host, NULL ) ) != 0 )
+		goto err_open;
+
+	/* Open stream */
+	if ( ( rc = http2_stream_open ( conn, xfer ) ) != 0 )
+		goto err_stream;
+
+	DBGC2 ( conn, "HTTP2 %p created https://%s:%d\n",
+		conn, uri->host, port );
+	return 0;
+
+ err_stream:
+ err_open:
+ err_tls:
+	DBGC ( conn, "HTTP2 %p could not create https://%s:%d: %s\n",
+	       conn, uri->host, port, strerror ( rc ) );
+	http2_conn_close ( conn, rc );
+	return rc;
+}
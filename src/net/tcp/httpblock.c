@@ -66,7 +66,7 @@ int http_block_read ( struct http_transaction *http, struct interface *data,
 
 	/* Start a range request to retrieve the block(s) */
 	if ( ( rc = http_open ( data, &http_get, http->uri, &range,
-				NULL ) ) != 0 )
+				NULL, NULL ) ) != 0 )
 		goto err_open;
 
 	/* Insert block device translator */
@@ -97,7 +97,7 @@ int http_block_read_capacity ( struct http_transaction *http,
 
 	/* Start a HEAD request to retrieve the capacity */
 	if ( ( rc = http_open ( data, &http_head, http->uri, NULL,
-				NULL ) ) != 0 )
+				NULL, NULL ) ) != 0 )
 		goto err_open;
 
 	/* Insert block device translator */
@@ -40,14 +40,37 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/xfer.h>
 #include <ipxe/open.h>
 #include <ipxe/pool.h>
+#include <ipxe/settings.h>
 #include <ipxe/http.h>
 
 /** HTTP pooled connection expiry time */
 #define HTTP_CONN_EXPIRY ( 10 * TICKS_PER_SEC )
 
+/** Maximum number of pooled connections per server */
+#define HTTP_CONN_POOL_MAX 8
+
+/** HTTP pooled connection expiry time setting */
+const struct setting http_keepalive_setting __setting ( SETTING_MISC,
+							http-keepalive ) = {
+	.name = "http-keepalive",
+	.description = "HTTP idle connection timeout",
+	.type = &setting_type_uint16,
+};
+
+/** HTTP pooled connection limit setting */
+const struct setting http_pool_setting __setting ( SETTING_MISC,
+						   http-pool ) = {
+	.name = "http-pool",
+	.description = "HTTP idle connections per server",
+	.type = &setting_type_uint8,
+};
+
 /** HTTP connection pool */
 static LIST_HEAD ( http_connection_pool );
 
+/** HTTP connections in use */
+static LIST_HEAD ( http_connections );
+
 /**
  * Identify HTTP scheme
  *
@@ -70,6 +93,60 @@ static struct http_scheme * http_scheme ( struct uri *uri ) {
 	return NULL;
 }
 
+/**
+ * Check if HTTP connection is to a given server
+ *
+ * @v conn		HTTP connection
+ * @v scheme		HTTP scheme
+ * @v uri		URI
+ * @v port		Port
+ * @ret is_server	Connection is to the given server
+ */
+static int http_conn_is_server ( struct http_connection *conn,
+				 struct http_scheme *scheme, struct uri *uri,
+				 unsigned int port ) {
+
+	/* Sanity checks */
+	assert ( conn->uri != NULL );
+	assert ( conn->uri->host != NULL );
+
+	return ( ( scheme == conn->scheme ) &&
+		 ( strcmp ( uri->host, conn->uri->host ) == 0 ) &&
+		 ( port == uri_port ( conn->uri, scheme->port ) ) );
+}
+
+/**
+ * Calculate pooled connection expiry time
+ *
+ * @ret expiry		Expiry time
+ */
+unsigned long http_conn_expiry ( void ) {
+	unsigned long timeout;
+
+	/* Use "http-keepalive" setting, if specified */
+	if ( ( fetch_uint_setting ( NULL, &http_keepalive_setting,
+				    &timeout ) < 0 ) || ( timeout == 0 ) )
+		return HTTP_CONN_EXPIRY;
+
+	return ( timeout * TICKS_PER_SEC );
+}
+
+/**
+ * Calculate maximum number of pooled connections per server
+ *
+ * @ret max		Maximum number of pooled connections
+ */
+static unsigned int http_conn_pool_max ( void ) {
+	unsigned long max;
+
+	/* Use "http-pool" setting, if specified */
+	if ( ( fetch_uint_setting ( NULL, &http_pool_setting,
+				    &max ) < 0 ) || ( max == 0 ) )
+		return HTTP_CONN_POOL_MAX;
+
+	return max;
+}
+
 /**
  * Free HTTP connection
  *
@@ -84,6 +161,35 @@ static void http_conn_free ( struct refcnt *refcnt ) {
 	free ( conn );
 }
 
+/**
+ * Free pipelined HTTP request
+ *
+ * @v refcnt		Reference count
+ */
+static void http_pipe_free ( struct refcnt *refcnt ) {
+	struct http_pipelined_request *pipe =
+		container_of ( refcnt, struct http_pipelined_request, refcnt );
+
+	/* Free pipelined request */
+	ref_put ( &pipe->conn->refcnt );
+	free ( pipe );
+}
+
+/**
+ * Remove pipelined HTTP request from connection
+ *
+ * @v pipe		Pipelined request
+ */
+static void http_pipe_del ( struct http_pipelined_request *pipe ) {
+	struct http_connection *conn = pipe->conn;
+
+	/* Remove from list of pipelined requests */
+	list_del ( &pipe->list );
+	INIT_LIST_HEAD ( &pipe->list );
+	assert ( conn->pipelined > 0 );
+	conn->pipelined--;
+}
+
 /**
  * Close HTTP connection
  *
@@ -91,10 +197,32 @@ static void http_conn_free ( struct refcnt *refcnt ) {
  * @v rc		Reason for close
  */
 static void http_conn_close ( struct http_connection *conn, int rc ) {
+	struct http_pipelined_request *pipe;
+	struct http_pipelined_request *tmp;
 
 	/* Remove from connection pool, if applicable */
 	pool_del ( &conn->pool );
 
+	/* Remove from list of connections in use, if applicable */
+	list_del ( &conn->list );
+	INIT_LIST_HEAD ( &conn->list );
+
+	/* Discard any unclaimed received data */
+	free_iob ( conn->excess );
+	conn->excess = NULL;
+
+	/* Ask any pipelined requests to reopen their connections.
+	 * Responses to pipelined requests can never be partially
+	 * delivered, so it is always safe to retry them.
+	 */
+	list_for_each_entry_safe ( pipe, tmp, &conn->pipeline, list ) {
+		http_pipe_del ( pipe );
+		intf_nullify ( &pipe->xfer );
+		pool_reopen ( &pipe->xfer );
+		intf_shutdown ( &pipe->xfer, rc );
+		ref_put ( &pipe->refcnt );
+	}
+
 	/* Shut down interfaces */
 	intf_shutdown ( &conn->socket, rc );
 	intf_shutdown ( &conn->xfer, rc );
@@ -121,6 +249,65 @@ static void http_conn_expired ( struct pooled_connection *pool ) {
 	http_conn_close ( conn, 0 /* Not an error to close idle connection */ );
 }
 
+/**
+ * Make room in the connection pool for a connection
+ *
+ * @v conn		HTTP connection about to be pooled
+ *
+ * Discard the least recently pooled connections to the same server
+ * until there is room for one more within the per-server limit.
+ */
+static void http_conn_pool_trim ( struct http_connection *conn ) {
+	struct http_scheme *scheme = conn->scheme;
+	struct uri *uri = conn->uri;
+	unsigned int port = uri_port ( uri, scheme->port );
+	unsigned int max = http_conn_pool_max();
+	struct http_connection *pooled;
+	struct http_connection *tmp;
+	unsigned int count = 0;
+
+	/* Count pooled connections to this server */
+	list_for_each_entry ( pooled, &http_connection_pool, pool.list ) {
+		if ( http_conn_is_server ( pooled, scheme, uri, port ) )
+			count++;
+	}
+
+	/* Discard oldest connections to this server, if applicable */
+	list_for_each_entry_safe ( pooled, tmp, &http_connection_pool,
+				   pool.list ) {
+		if ( count < max )
+			break;
+		if ( ! http_conn_is_server ( pooled, scheme, uri, port ) )
+			continue;
+		DBGC2 ( pooled, "HTTPCONN %p evicted from pool\n", pooled );
+		ref_get ( &pooled->refcnt );
+		http_conn_close ( pooled, 0 );
+		ref_put ( &pooled->refcnt );
+		count--;
+	}
+}
+
+/**
+ * Notify next pipelined request that it may be transmitted
+ *
+ * @v conn		HTTP connection
+ */
+static void http_conn_pipeline_step ( struct http_connection *conn ) {
+	struct http_pipelined_request *pipe;
+
+	/* Do nothing until the active request has been transmitted */
+	if ( ! ( conn->flags & HTTP_CONN_SENT ) )
+		return;
+
+	/* Notify first untransmitted pipelined request, if any */
+	list_for_each_entry ( pipe, &conn->pipeline, list ) {
+		if ( ! ( pipe->flags & HTTP_CONN_SENT ) ) {
+			xfer_window_changed ( &pipe->xfer );
+			return;
+		}
+	}
+}
+
 /**
  * Receive data from transport layer interface
  *
@@ -140,6 +327,20 @@ static int http_conn_socket_deliver ( struct http_connection *conn,
 	return xfer_deliver ( &conn->xfer, iobuf, meta );
 }
 
+/**
+ * Handle transport layer window change
+ *
+ * @v conn		HTTP connection
+ */
+static void http_conn_socket_window_changed ( struct http_connection *conn ) {
+
+	/* Notify active request */
+	xfer_window_changed ( &conn->xfer );
+
+	/* Notify pipelined requests */
+	http_conn_pipeline_step ( conn );
+}
+
 /**
  * Close HTTP connection transport layer interface
  *
@@ -160,6 +361,54 @@ static void http_conn_socket_close ( struct http_connection *conn, int rc ) {
 	http_conn_close ( conn, rc );
 }
 
+/**
+ * Transmit data on behalf of active request
+ *
+ * @v conn		HTTP connection
+ * @v iobuf		I/O buffer
+ * @v meta		Transfer metadata
+ * @ret rc		Return status code
+ */
+static int http_conn_xfer_deliver ( struct http_connection *conn,
+				    struct io_buffer *iobuf,
+				    struct xfer_metadata *meta ) {
+	int rc;
+
+	/* Mark request as transmitted */
+	conn->flags |= HTTP_CONN_SENT;
+
+	/* Pass on to transport layer interface */
+	if ( ( rc = xfer_deliver ( &conn->socket, iobuf, meta ) ) != 0 )
+		return rc;
+
+	/* Allow next pipelined request to be transmitted */
+	http_conn_pipeline_step ( conn );
+
+	return 0;
+}
+
+/**
+ * Hand back received data belonging to a subsequent response
+ *
+ * @v conn		HTTP connection
+ * @v iobuf		I/O buffer
+ * @ret rc		Return status code
+ */
+static int http_conn_xfer_pushback ( struct http_connection *conn,
+				     struct io_buffer *iobuf ) {
+
+	/* Refuse if data is already held */
+	if ( conn->excess ) {
+		DBGC ( conn, "HTTPCONN %p already holds excess data\n", conn );
+		free_iob ( iobuf );
+		return -ENOBUFS;
+	}
+
+	/* Hold data until the subsequent request becomes active */
+	conn->excess = iobuf;
+	return 0;
+}
+
 /**
  * Recycle this connection after closing
  *
@@ -172,6 +421,52 @@ static void http_conn_xfer_recycle ( struct http_connection *conn ) {
 	DBGC2 ( conn, "HTTPCONN %p keepalive enabled\n", conn );
 }
 
+/**
+ * Promote first pipelined request to be the active request
+ *
+ * @v conn		HTTP connection
+ */
+static void http_conn_promote ( struct http_connection *conn ) {
+	struct http_pipelined_request *pipe;
+	struct io_buffer *iobuf;
+	int rc;
+
+	/* Identify first pipelined request */
+	pipe = list_first_entry ( &conn->pipeline,
+				  struct http_pipelined_request, list );
+	assert ( pipe != NULL );
+	http_pipe_del ( pipe );
+
+	/* Transfer parent interface to connection */
+	intf_restart ( &conn->xfer, 0 );
+	intf_nullify ( &pipe->xfer );
+	intf_plug_plug ( &conn->xfer, pipe->xfer.dest );
+	intf_unplug ( &pipe->xfer );
+	conn->flags = ( ( conn->flags & HTTP_CONN_PERSISTENT ) |
+			( pipe->flags & ( HTTP_CONN_PIPELINE |
+					  HTTP_CONN_SENT ) ) );
+	conn->pool.flags &= ~POOL_RECYCLABLE;
+	ref_put ( &pipe->refcnt );
+	DBGC2 ( conn, "HTTPCONN %p promoted pipelined request\n", conn );
+
+	/* Pass on any data already received for this request */
+	if ( ( iobuf = conn->excess ) ) {
+		conn->excess = NULL;
+		if ( ! ( conn->flags & HTTP_CONN_SENT ) ) {
+			DBGC ( conn, "HTTPCONN %p unsolicited data\n", conn );
+			free_iob ( iobuf );
+			http_conn_close ( conn, -EPROTO );
+			return;
+		}
+		if ( ( rc = xfer_deliver_iob ( &conn->xfer, iobuf ) ) != 0 )
+			return;
+	}
+
+	/* Allow newly active request to be transmitted, if applicable */
+	if ( ! ( conn->flags & HTTP_CONN_SENT ) )
+		xfer_window_changed ( &conn->xfer );
+}
+
 /**
  * Close HTTP connection data transfer interface
  *
@@ -180,26 +475,124 @@ static void http_conn_xfer_recycle ( struct http_connection *conn ) {
  */
 static void http_conn_xfer_close ( struct http_connection *conn, int rc ) {
 
-	/* Add to the connection pool if keepalive is enabled and no
-	 * error occurred.
+	/* Reuse the connection if keepalive is enabled and no error
+	 * occurred.
 	 */
 	if ( ( rc == 0 ) && pool_is_recyclable ( &conn->pool ) ) {
-		intf_restart ( &conn->xfer, rc );
-		pool_add ( &conn->pool, &http_connection_pool,
-			   HTTP_CONN_EXPIRY );
-		DBGC2 ( conn, "HTTPCONN %p pooled %s://%s\n",
-			conn, conn->scheme->name, conn->uri->host );
-		return;
+
+		/* Record that the server supports persistent connections */
+		conn->flags |= HTTP_CONN_PERSISTENT;
+
+		/* Hand over to the next pipelined request, if any */
+		if ( ! list_empty ( &conn->pipeline ) ) {
+			http_conn_promote ( conn );
+			return;
+		}
+
+		/* Add to the connection pool, unless we have received
+		 * data that no request will claim.
+		 */
+		if ( ! conn->excess ) {
+			intf_restart ( &conn->xfer, rc );
+			list_del ( &conn->list );
+			INIT_LIST_HEAD ( &conn->list );
+			http_conn_pool_trim ( conn );
+			pool_add ( &conn->pool, &http_connection_pool,
+				   http_conn_expiry() );
+			DBGC2 ( conn, "HTTPCONN %p pooled %s://%s\n",
+				conn, conn->scheme->name, conn->uri->host );
+			return;
+		}
+		DBGC ( conn, "HTTPCONN %p unsolicited data\n", conn );
+		rc = -EPROTO;
 	}
 
 	/* Otherwise, close the connection */
 	http_conn_close ( conn, rc );
 }
 
+/**
+ * Check flow control window for pipelined request
+ *
+ * @v pipe		Pipelined request
+ * @ret len		Length of window
+ */
+static size_t http_pipe_xfer_window ( struct http_pipelined_request *pipe ) {
+	struct http_connection *conn = pipe->conn;
+	struct http_pipelined_request *prev;
+
+	/* Requests must be transmitted in order */
+	if ( ! ( conn->flags & HTTP_CONN_SENT ) )
+		return 0;
+	list_for_each_entry ( prev, &conn->pipeline, list ) {
+		if ( prev == pipe )
+			break;
+		if ( ! ( prev->flags & HTTP_CONN_SENT ) )
+			return 0;
+	}
+
+	/* Use transport layer window */
+	return xfer_window ( &conn->socket );
+}
+
+/**
+ * Transmit pipelined request
+ *
+ * @v pipe		Pipelined request
+ * @v iobuf		I/O buffer
+ * @v meta		Transfer metadata
+ * @ret rc		Return status code
+ */
+static int http_pipe_xfer_deliver ( struct http_pipelined_request *pipe,
+				    struct io_buffer *iobuf,
+				    struct xfer_metadata *meta ) {
+	struct http_connection *conn = pipe->conn;
+	int rc;
+
+	/* Mark request as transmitted */
+	pipe->flags |= HTTP_CONN_SENT;
+
+	/* Pass on to transport layer interface */
+	if ( ( rc = xfer_deliver ( &conn->socket, iobuf, meta ) ) != 0 )
+		return rc;
+
+	/* Allow next pipelined request to be transmitted */
+	http_conn_pipeline_step ( conn );
+
+	return 0;
+}
+
+/**
+ * Close pipelined request
+ *
+ * @v pipe		Pipelined request
+ * @v rc		Reason for close
+ */
+static void http_pipe_xfer_close ( struct http_pipelined_request *pipe,
+				   int rc ) {
+	struct http_connection *conn = pipe->conn;
+
+	/* Shut down interface and remove from connection */
+	intf_shutdown ( &pipe->xfer, rc );
+	http_pipe_del ( pipe );
+
+	/* If the request has already been transmitted, then the
+	 * response will still arrive and there is no way to discard
+	 * it without parsing it.  Close the whole connection.
+	 */
+	if ( pipe->flags & HTTP_CONN_SENT )
+		http_conn_close ( conn, ( rc ? rc : -ECANCELED ) );
+
+	/* Drop list's reference */
+	ref_put ( &pipe->refcnt );
+}
+
 /** HTTP connection socket interface operations */
 static struct interface_operation http_conn_socket_operations[] = {
 	INTF_OP ( xfer_deliver, struct http_connection *,
 		  http_conn_socket_deliver ),
+	INTF_OP ( xfer_window_changed, struct http_connection *,
+		  http_conn_socket_window_changed ),
 	INTF_OP ( intf_close, struct http_connection *,
 		  http_conn_socket_close ),
 };
@@ -211,6 +604,10 @@ static struct interface_descriptor http_conn_socket_desc =
 
 /** HTTP connection data transfer interface operations */
 static struct interface_operation http_conn_xfer_operations[] = {
+	INTF_OP ( xfer_deliver, struct http_connection *,
+		  http_conn_xfer_deliver ),
+	INTF_OP ( http_conn_pushback, struct http_connection *,
+		  http_conn_xfer_pushback ),
 	INTF_OP ( pool_recycle, struct http_connection *,
 		  http_conn_xfer_recycle ),
 	INTF_OP ( intf_close, struct http_connection *,
@@ -222,17 +619,142 @@ static struct interface_descriptor http_conn_xfer_desc =
 	INTF_DESC_PASSTHRU ( struct http_connection, xfer,
 			     http_conn_xfer_operations, socket );
 
+/** Pipelined HTTP request data transfer interface operations */
+static struct interface_operation http_pipe_xfer_operations[] = {
+	INTF_OP ( xfer_deliver, struct http_pipelined_request *,
+		  http_pipe_xfer_deliver ),
+	INTF_OP ( xfer_window, struct http_pipelined_request *,
+		  http_pipe_xfer_window ),
+	INTF_OP ( intf_close, struct http_pipelined_request *,
+		  http_pipe_xfer_close ),
+};
+
+/** Pipelined HTTP request data transfer interface descriptor */
+static struct interface_descriptor http_pipe_xfer_desc =
+	INTF_DESC ( struct http_pipelined_request, xfer,
+		    http_pipe_xfer_operations );
+
+/**
+ * Hand back received data belonging to a subsequent response
+ *
+ * @v intf		Data transfer interface
+ * @v iobuf		I/O buffer
+ * @ret rc		Return status code
+ *
+ * A persistent connection may deliver the end of one response and
+ * the start of the next (pipelined) response within a single I/O
+ * buffer.  The consumer of the first response uses this method to
+ * return the data that does not belong to it.
+ */
+int http_conn_pushback ( struct interface *intf, struct io_buffer *iobuf ) {
+	struct interface *dest;
+	http_conn_pushback_TYPE ( void * ) *op =
+		intf_get_dest_op ( intf, http_conn_pushback, &dest );
+	void *object = intf_object ( dest );
+	int rc;
+
+	if ( op ) {
+		rc = op ( object, iobuf );
+	} else {
+		/* Default is to discard the data */
+		free_iob ( iobuf );
+		rc = -ENOTSUP;
+	}
+
+	intf_put ( dest );
+	return rc;
+}
+
+/**
+ * Connect to an HTTP/2 server (when HTTP/2 support is not present)
+ *
+ * @v xfer		Data transfer interface
+ * @v scheme		HTTP scheme
+ * @v uri		Connection URI
+ * @v port		Port
+ * @ret rc		Return status code
+ */
+__weak int http2_connect ( struct interface *xfer __unused,
+			   struct http_scheme *scheme __unused,
+			   struct uri *uri __unused,
+			   unsigned int port __unused ) {
+	return -ENOTSUP;
+}
+
+/**
+ * Pipeline request behind an existing request
+ *
+ * @v xfer		Data transfer interface
+ * @v scheme		HTTP scheme
+ * @v uri		Connection URI
+ * @v port		Port
+ * @ret rc		Return status code
+ */
+static int http_pipeline ( struct interface *xfer, struct http_scheme *scheme,
+			   struct uri *uri, unsigned int port ) {
+	struct http_pipelined_request *pipe;
+	struct http_connection *conn;
+
+	/* Look for a suitable connection in use */
+	list_for_each_entry ( conn, &http_connections, list ) {
+
+		/* Skip connections to other servers */
+		if ( ! http_conn_is_server ( conn, scheme, uri, port ) )
+			continue;
+
+		/* Skip connections that do not permit pipelining */
+		if ( ( conn->flags & ( HTTP_CONN_PIPELINE |
+				       HTTP_CONN_PERSISTENT ) ) !=
+		     ( HTTP_CONN_PIPELINE | HTTP_CONN_PERSISTENT ) )
+			continue;
+
+		/* Skip connections with a full pipeline */
+		if ( conn->pipelined >= HTTP_CONN_PIPELINE_MAX )
+			continue;
+
+		/* Allocate and initialise structure */
+		pipe = zalloc ( sizeof ( *pipe ) );
+		if ( ! pipe )
+			return -ENOMEM;
+		ref_init ( &pipe->refcnt, http_pipe_free );
+		pipe->conn = conn;
+		ref_get ( &conn->refcnt );
+		intf_init ( &pipe->xfer, &http_pipe_xfer_desc, &pipe->refcnt );
+		pipe->flags = HTTP_CONN_PIPELINE;
+
+		/* Add to pipeline (which holds our only reference),
+		 * and attach to parent interface.
+		 */
+		list_add_tail ( &pipe->list, &conn->pipeline );
+		conn->pipelined++;
+		intf_plug_plug ( &pipe->xfer, xfer );
+		DBGC2 ( conn, "HTTPCONN %p pipelined request %d %s://%s:%d\n",
+			conn, conn->pipelined, conn->scheme->name,
+			conn->uri->host, port );
+		return 0;
+	}
+
+	return -ENOENT;
+}
+
 /**
  * Connect to an HTTP server
  *
  * @v xfer		Data transfer interface
  * @v uri		Connection URI
+ * @v flags		Connection flags
  * @ret rc		Return status code
  *
  * HTTP connections are pooled.  The caller should be prepared to
  * receive a pool_reopen() message.
+ *
+ * If @c HTTP_CONN_PIPELINE is specified, then the request may be
+ * transmitted on a connection that is still awaiting the response to
+ * an earlier request.  Responses are delivered in order, and the
+ * caller will not see a window until its turn to transmit arrives.
  */
-int http_connect ( struct interface *xfer, struct uri *uri ) {
+int http_connect ( struct interface *xfer, struct uri *uri,
+		   unsigned int flags ) {
 	struct http_connection *conn;
 	struct http_scheme *scheme;
 	struct sockaddr_tcpip server;
@@ -252,22 +774,25 @@ int http_connect ( struct interface *xfer, struct uri *uri ) {
 	/* Identify port */
 	port = uri_port ( uri, scheme->port );
 
+	/* Retain only flags meaningful to the caller */
+	flags &= HTTP_CONN_PIPELINE;
+
+	/* Use HTTP/2, if supported by both ends */
+	if ( http2_connect ( xfer, scheme, uri, port ) == 0 )
+		return 0;
+
 	/* Look for a reusable connection in the pool */
 	list_for_each_entry ( conn, &http_connection_pool, pool.list ) {
 
-		/* Sanity checks */
-		assert ( conn->uri != NULL );
-		assert ( conn->uri->host != NULL );
-
 		/* Reuse connection, if possible */
-		if ( ( scheme == conn->scheme ) &&
-		     ( strcmp ( uri->host, conn->uri->host ) == 0 ) &&
-		     ( port == uri_port ( conn->uri, scheme->port ) ) ) {
+		if ( http_conn_is_server ( conn, scheme, uri, port ) ) {
 
 			/* Remove from connection pool, stop timer,
 			 * attach to parent interface, and return.
 			 */
 			pool_del ( &conn->pool );
+			list_add ( &conn->list, &http_connections );
+			conn->flags = ( flags | HTTP_CONN_PERSISTENT );
 			intf_plug_plug ( &conn->xfer, xfer );
 			DBGC2 ( conn, "HTTPCONN %p reused %s://%s:%d\n", conn,
 				conn->scheme->name, conn->uri->host, port );
@@ -275,21 +800,32 @@ int http_connect ( struct interface *xfer, struct uri *uri ) {
 		}
 	}
 
+	/* Pipeline behind an existing request, if permitted */
+	if ( ( flags & HTTP_CONN_PIPELINE ) &&
+	     ( http_pipeline ( xfer, scheme, uri, port ) == 0 ) )
+		return 0;
+
 	/* Allocate and initialise structure */
 	conn = zalloc ( sizeof ( *conn ) );
+	if ( ! conn )
+		return -ENOMEM;
 	ref_init ( &conn->refcnt, http_conn_free );
 	conn->uri = uri_get ( uri );
 	conn->scheme = scheme;
+	conn->flags = flags;
 	intf_init ( &conn->socket, &http_conn_socket_desc, &conn->refcnt );
 	intf_init ( &conn->xfer, &http_conn_xfer_desc, &conn->refcnt );
 	pool_init ( &conn->pool, http_conn_expired, &conn->refcnt );
+	INIT_LIST_HEAD ( &conn->pipeline );
+	list_add ( &conn->list, &http_connections );
 
 	/* Open socket */
 	memset ( &server, 0, sizeof ( server ) );
 	server.st_port = htons ( port );
 	socket = &conn->socket;
 	if ( scheme->filter &&
-	     ( ( rc = scheme->filter ( socket, uri->host, &socket ) ) != 0 ) )
+	     ( ( rc = scheme->filter ( socket, uri->host, port,
+				       &socket ) ) != 0 ) )
 		goto err_filter;
 	if ( ( rc = xfer_open_named_socket ( socket, SOCK_STREAM,
 					     ( struct sockaddr * ) &server,
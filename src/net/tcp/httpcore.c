@@ -54,6 +54,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/version.h>
 #include <ipxe/params.h>
 #include <ipxe/profile.h>
+#include <ipxe/dropstat.h>
+#include <ipxe/timeline.h>
+#include <ipxe/trace.h>
 #include <ipxe/vsprintf.h>
 #include <ipxe/http.h>
 
@@ -94,6 +97,12 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #define ENOTSUP_TRANSFER __einfo_error ( EINFO_ENOTSUP_TRANSFER )
 #define EINFO_ENOTSUP_TRANSFER \
 	__einfo_uniqify ( EINFO_ENOTSUP, 0x02, "Unsupported transfer encoding" )
+#define ENOTSUP_RANGE __einfo_error ( EINFO_ENOTSUP_RANGE )
+#define EINFO_ENOTSUP_RANGE \
+	__einfo_uniqify ( EINFO_ENOTSUP, 0x03, "Range request not honoured" )
+#define ENOTSUP_NOT_MODIFIED __einfo_error ( EINFO_ENOTSUP_NOT_MODIFIED )
+#define EINFO_ENOTSUP_NOT_MODIFIED \
+	__einfo_uniqify ( EINFO_ENOTSUP, 0x04, "Not modified" )
 #define EPERM_403 __einfo_error ( EINFO_EPERM_403 )
 #define EINFO_EPERM_403 \
 	__einfo_uniqify ( EINFO_EPERM, 0x01, "HTTP 403 Forbidden" )
@@ -104,12 +113,48 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Retry delay used when we cannot understand the Retry-After header */
 #define HTTP_RETRY_SECONDS 5
 
+/** Initial estimate of request header length (excluding request-URI)
+ *
+ * This is large enough for the headers of a typical request
+ * (including a Range header), so that the headers usually need to be
+ * constructed only once.
+ */
+#define HTTP_TX_LEN 512
+
+/** Length of buffer used to coalesce small chunks
+ *
+ * Data from chunks which do not fill a received I/O buffer is copied
+ * into a buffer of this size, so that small chunks are delivered as
+ * a single write rather than individually.
+ */
+#define HTTP_CHUNK_COALESCE_LEN 16384
+
 /** Receive profiler */
 static struct profiler http_rx_profiler __profiler = { .name = "http.rx" };
 
 /** Data transfer profiler */
 static struct profiler http_xfer_profiler __profiler = { .name = "http.xfer" };
 
+/** Data dropped due to arriving when no data was expected */
+static struct drop_counter http_unsolicited_drops __drop_counter = {
+	.name = "http.unsolicited",
+};
+
+/** Data dropped due to a malformed response header */
+static struct drop_counter http_header_drops __drop_counter = {
+	.name = "http.header",
+};
+
+/** Data dropped due to a malformed chunk length */
+static struct drop_counter http_chunk_drops __drop_counter = {
+	.name = "http.chunk",
+};
+
+/** Data dropped due to any other receive failure */
+static struct drop_counter http_rx_drops __drop_counter = {
+	.name = "http.rx",
+};
+
 static struct http_state http_request;
 static struct http_state http_headers;
 static struct http_state http_trailers;
@@ -257,6 +302,7 @@ static void http_free ( struct refcnt *refcnt ) {
 
 	empty_line_buffer ( &http->response.headers );
 	empty_line_buffer ( &http->linebuf );
+	free_iob ( http->chunk );
 	uri_put ( http->uri );
 	free ( http );
 }
@@ -269,6 +315,9 @@ static void http_free ( struct refcnt *refcnt ) {
  */
 static void http_close ( struct http_transaction *http, int rc ) {
 
+	/* Record close */
+	timeline_record ( "http", "close", http->request.host, rc );
+
 	/* Stop process */
 	process_del ( &http->process );
 
@@ -292,6 +341,26 @@ static void http_close_error ( struct http_transaction *http, int rc ) {
 	http_close ( http, ( rc ? rc : -EPIPE ) );
 }
 
+/**
+ * Determine connection flags for HTTP transaction
+ *
+ * @v http		HTTP transaction
+ * @ret flags		Connection flags
+ */
+static unsigned int http_connect_flags ( struct http_transaction *http ) {
+
+	/* Allow small range requests (e.g. SAN block reads) to be
+	 * pipelined.  Such requests are idempotent and have responses
+	 * of a bounded and known length.
+	 */
+	if ( ( http->request.method == &http_get ) &&
+	     ( http->request.range.len != 0 ) &&
+	     ( http->request.range.len <= HTTP_PIPELINE_MAX_LEN ) )
+		return HTTP_CONN_PIPELINE;
+
+	return 0;
+}
+
 /**
  * Reopen stale HTTP connection
  *
@@ -304,7 +373,8 @@ static void http_reopen ( struct http_transaction *http ) {
 	intf_restart ( &http->conn, -ECANCELED );
 
 	/* Reopen connection */
-	if ( ( rc = http_connect ( &http->conn, http->uri ) ) != 0 ) {
+	if ( ( rc = http_connect ( &http->conn, http->uri,
+				   http_connect_flags ( http ) ) ) != 0 ) {
 		DBGC ( http, "HTTP %p could not reconnect: %s\n",
 		       http, strerror ( rc ) );
 		goto err_connect;
@@ -389,12 +459,23 @@ static int http_conn_deliver ( struct http_transaction *http,
 		if ( ( ! http->state ) || ( ! http->state->rx ) ) {
 			DBGC ( http, "HTTP %p unexpected data\n", http );
 			rc = -EPROTO_UNSOLICITED;
+			drop_count ( &http_unsolicited_drops );
 			goto err;
 		}
 
 		/* Receive (some) data */
-		if ( ( rc = http->state->rx ( http, &iobuf ) ) != 0 )
+		if ( ( rc = http->state->rx ( http, &iobuf ) ) != 0 ) {
+			if ( ( rc == -EINVAL_STATUS ) ||
+			     ( rc == -EINVAL_HEADER ) ||
+			     ( rc == -EINVAL_CONTENT_LENGTH ) ) {
+				drop_count ( &http_header_drops );
+			} else if ( rc == -EINVAL_CHUNK_LENGTH ) {
+				drop_count ( &http_chunk_drops );
+			} else {
+				drop_count ( &http_rx_drops );
+			}
 			goto err;
+		}
 	}
 
 	/* Free I/O buffer, if applicable */
@@ -524,6 +605,19 @@ __weak int http_acpi_describe ( struct http_transaction *http __unused,
 	return -ENOTSUP;
 }
 
+/**
+ * Open parallel HTTP download (when parallel download support is not present)
+ *
+ * @v xfer		Data transfer interface
+ * @v uri		Request URI
+ * @ret rc		Return status code
+ */
+__weak int httpmux_open ( struct interface *xfer __unused,
+			  struct uri *uri __unused ) {
+
+	return -ENOTSUP;
+}
+
 /** HTTP data transfer interface operations */
 static struct interface_operation http_xfer_operations[] = {
 	INTF_OP ( block_read, struct http_transaction *, http_block_read ),
@@ -588,20 +682,26 @@ static struct process_descriptor http_process_desc =
  * @v uri		Request URI
  * @v range		Content range (if any)
  * @v content		Request content (if any)
+ * @v conditional	Request conditions (if any)
  * @ret rc		Return status code
  */
 int http_open ( struct interface *xfer, struct http_method *method,
 		struct uri *uri, struct http_request_range *range,
-		struct http_request_content *content ) {
+		struct http_request_content *content,
+		struct http_request_conditional *conditional ) {
 	struct http_transaction *http;
 	struct uri request_uri;
 	struct uri request_host;
 	size_t request_uri_len;
 	size_t request_host_len;
 	size_t content_len;
+	size_t etag_len;
+	size_t modified_len;
 	char *request_uri_string;
 	char *request_host_string;
 	void *content_data;
+	char *etag;
+	char *modified;
 	int rc;
 
 	/* Calculate request URI length */
@@ -621,9 +721,15 @@ int http_open ( struct interface *xfer, struct http_method *method,
 	/* Calculate request content length */
 	content_len = ( content ? content->len : 0 );
 
+	/* Calculate request condition lengths */
+	etag_len = ( ( conditional && conditional->etag ) ?
+		     ( strlen ( conditional->etag ) + 1 /* NUL */ ) : 0 );
+	modified_len = ( ( conditional && conditional->modified ) ?
+			 ( strlen ( conditional->modified ) + 1 /* NUL */ ) : 0);
+
 	/* Allocate and initialise structure */
 	http = zalloc ( sizeof ( *http ) + request_uri_len + request_host_len +
-			content_len );
+			content_len + etag_len + modified_len );
 	if ( ! http ) {
 		rc = -ENOMEM;
 		goto err_alloc;
@@ -631,6 +737,8 @@ int http_open ( struct interface *xfer, struct http_method *method,
 	request_uri_string = ( ( ( void * ) http ) + sizeof ( *http ) );
 	request_host_string = ( request_uri_string + request_uri_len );
 	content_data = ( request_host_string + request_host_len );
+	etag = ( content_data + content_len );
+	modified = ( etag + etag_len );
 	format_uri ( &request_uri, request_uri_string, request_uri_len );
 	format_uri ( &request_host, request_host_string, request_host_len );
 	ref_init ( &http->refcnt, http_free );
@@ -655,12 +763,21 @@ int http_open ( struct interface *xfer, struct http_method *method,
 		http->request.content.len = content_len;
 		memcpy ( content_data, content->data, content_len );
 	}
+	if ( etag_len ) {
+		http->request.conditional.etag = etag;
+		memcpy ( etag, conditional->etag, etag_len );
+	}
+	if ( modified_len ) {
+		http->request.conditional.modified = modified;
+		memcpy ( modified, conditional->modified, modified_len );
+	}
 	http->state = &http_request;
 	DBGC2 ( http, "HTTP %p %s://%s%s\n", http, http->uri->scheme,
 		http->request.host, http->request.uri );
 
 	/* Open connection */
-	if ( ( rc = http_connect ( &http->conn, uri ) ) != 0 ) {
+	if ( ( rc = http_connect ( &http->conn, uri,
+				   http_connect_flags ( http ) ) ) != 0 ) {
 		DBGC ( http, "HTTP %p could not connect: %s\n",
 		       http, strerror ( rc ) );
 		goto err_connect;
@@ -811,6 +928,7 @@ static int http_transfer_complete ( struct http_transaction *http ) {
 static int http_format_headers ( struct http_transaction *http, char *buf,
 				 size_t len ) {
 	struct http_request_header *header;
+	size_t start;
 	size_t used;
 	size_t remaining;
 	char *line;
@@ -827,23 +945,28 @@ static int http_format_headers ( struct http_transaction *http, char *buf,
 	/* Construct all headers */
 	for_each_table_entry ( header, HTTP_REQUEST_HEADERS ) {
 
-		/* Determine header value length */
-		value_len = header->format ( http, NULL, 0 );
+		/* Construct header name */
+		start = used;
+		line = ( buf + used );
+		used += ssnprintf ( ( buf + used ), ( len - used ), "%s: ",
+				    header->name );
+
+		/* Construct header value */
+		remaining = ( ( used < len ) ? ( len - used ) : 0 );
+		value_len = header->format ( http, ( buf + used ), remaining );
 		if ( value_len < 0 ) {
 			rc = value_len;
 			return rc;
 		}
 
-		/* Skip zero-length headers */
-		if ( ! value_len )
+		/* Omit zero-length headers */
+		if ( ! value_len ) {
+			used = start;
 			continue;
+		}
 
-		/* Construct header */
-		line = ( buf + used );
-		used += ssnprintf ( ( buf + used ), ( len - used ), "%s: ",
-				    header->name );
-		remaining = ( ( used < len ) ? ( len - used ) : 0 );
-		used += header->format ( http, ( buf + used ), remaining );
+		/* Complete header */
+		used += value_len;
 		if ( used < len )
 			DBGC2 ( http, "HTTP %p TX %s\n", http, line );
 		used += ssnprintf ( ( buf + used ), ( len - used ), "\r\n" );
@@ -946,6 +1069,59 @@ struct http_request_header http_request_range __http_request_header = {
 	.format = http_format_range,
 };
 
+/**
+ * Construct HTTP "If-None-Match" header
+ *
+ * @v http		HTTP transaction
+ * @v buf		Buffer
+ * @v len		Length of buffer
+ * @ret len		Length of header value, or negative error
+ */
+static int http_format_if_none_match ( struct http_transaction *http,
+				       char *buf, size_t len ) {
+
+	/* Construct entity tag, if applicable */
+	if ( http->request.conditional.etag ) {
+		return snprintf ( buf, len, "%s",
+				  http->request.conditional.etag );
+	} else {
+		return 0;
+	}
+}
+
+/** HTTP "If-None-Match" header */
+struct http_request_header http_request_if_none_match __http_request_header = {
+	.name = "If-None-Match",
+	.format = http_format_if_none_match,
+};
+
+/**
+ * Construct HTTP "If-Modified-Since" header
+ *
+ * @v http		HTTP transaction
+ * @v buf		Buffer
+ * @v len		Length of buffer
+ * @ret len		Length of header value, or negative error
+ */
+static int http_format_if_modified_since ( struct http_transaction *http,
+					   char *buf, size_t len ) {
+
+	/* Construct modification date, if applicable */
+	if ( http->request.conditional.modified ) {
+		return snprintf ( buf, len, "%s",
+				  http->request.conditional.modified );
+	} else {
+		return 0;
+	}
+}
+
+/** HTTP "If-Modified-Since" header */
+struct http_request_header http_request_if_modified_since
+	__http_request_header = {
+	.name = "If-Modified-Since",
+	.format = http_format_if_modified_since,
+};
+
 /**
  * Construct HTTP "Content-Type" header
  *
@@ -1036,30 +1212,42 @@ struct http_request_header http_request_accept_encoding __http_request_header ={
  */
 static int http_tx_request ( struct http_transaction *http ) {
 	struct io_buffer *iobuf;
+	size_t max_len;
 	int len;
-	int check_len;
 	int rc;
 
-	/* Calculate request length */
-	len = http_format_headers ( http, NULL, 0 );
-	if ( len < 0 ) {
-		rc = len;
-		DBGC ( http, "HTTP %p could not construct request: %s\n",
-		       http, strerror ( rc ) );
-		goto err_len;
-	}
+	/* Construct request.  Start with a buffer that is large
+	 * enough for a typical request, so that the headers need to
+	 * be constructed only once in the common case.
+	 */
+	max_len = ( HTTP_TX_LEN + strlen ( http->request.uri ) );
+	while ( 1 ) {
 
-	/* Allocate I/O buffer */
-	iobuf = alloc_iob ( len + 1 /* NUL */ + http->request.content.len );
-	if ( ! iobuf ) {
-		rc = -ENOMEM;
-		goto err_alloc;
-	}
+		/* Allocate I/O buffer */
+		iobuf = alloc_iob ( max_len + 1 /* NUL */ +
+				    http->request.content.len );
+		if ( ! iobuf ) {
+			rc = -ENOMEM;
+			goto err_alloc;
+		}
 
-	/* Construct request */
-	check_len = http_format_headers ( http, iob_put ( iobuf, len ),
-					  ( len + 1 /* NUL */ ) );
-	assert ( check_len == len );
+		/* Construct request headers */
+		len = http_format_headers ( http, iobuf->data,
+					    ( max_len + 1 /* NUL */ ) );
+		if ( len < 0 ) {
+			rc = len;
+			DBGC ( http, "HTTP %p could not construct request: "
+			       "%s\n", http, strerror ( rc ) );
+			goto err_len;
+		}
+		if ( ( ( size_t ) len ) <= max_len )
+			break;
+
+		/* Retry with a buffer of the required length */
+		free_iob ( iobuf );
+		max_len = len;
+	}
+	iob_put ( iobuf, len );
 	memcpy ( iob_put ( iobuf, http->request.content.len ),
 		 http->request.content.data, http->request.content.len );
 
@@ -1074,6 +1262,8 @@ static int http_tx_request ( struct http_transaction *http ) {
 	/* Clear any previous response */
 	empty_line_buffer ( &http->response.headers );
 	memset ( &http->response, 0, sizeof ( http->response ) );
+	timeline_record ( "http", "request", http->request.host, 0 );
+	TRACE ( "http_tx_request", http, len );
 
 	/* Move to response headers state */
 	http->state = &http_headers;
@@ -1081,9 +1271,9 @@ static int http_tx_request ( struct http_transaction *http ) {
 	return 0;
 
  err_deliver:
+ err_len:
 	free_iob ( iobuf );
  err_alloc:
- err_len:
 	return rc;
 }
 
@@ -1147,6 +1337,11 @@ static int http_parse_status ( struct http_transaction *http, char *line ) {
 	if ( status[0] == '2' ) {
 		/* 2xx Success */
 		response_rc = 0;
+	} else if ( ( http->response.status == 304 ) &&
+		    ( http->request.conditional.etag ||
+		      http->request.conditional.modified ) ) {
+		/* 304 Not Modified (in response to a conditional request) */
+		response_rc = 0;
 	} else if ( status[0] == '3' ) {
 		/* 3xx Redirection */
 		response_rc = -EXDEV;
@@ -1170,6 +1365,7 @@ static int http_parse_status ( struct http_transaction *http, char *line ) {
 		response_rc = -EIO_OTHER;
 	}
 	http->response.rc = response_rc;
+	TRACE ( "http_rx_status", http, http->response.status );
 
 	return 0;
 }
@@ -1268,6 +1464,132 @@ struct http_response_header http_response_location __http_response_header = {
 	.parse = http_parse_location,
 };
 
+/**
+ * Parse HTTP "ETag" header
+ *
+ * @v http		HTTP transaction
+ * @v line		Remaining header line
+ * @ret rc		Return status code
+ */
+static int http_parse_etag ( struct http_transaction *http, char *line ) {
+
+	/* Store entity tag */
+	http->response.etag = line;
+
+	return 0;
+}
+
+/** HTTP "ETag" header */
+struct http_response_header http_response_etag __http_response_header = {
+	.name = "ETag",
+	.parse = http_parse_etag,
+};
+
+/**
+ * Parse HTTP "Last-Modified" header
+ *
+ * @v http		HTTP transaction
+ * @v line		Remaining header line
+ * @ret rc		Return status code
+ */
+static int http_parse_last_modified ( struct http_transaction *http,
+				      char *line ) {
+
+	/* Store last modification date */
+	http->response.modified = line;
+
+	return 0;
+}
+
+/** HTTP "Last-Modified" header */
+struct http_response_header http_response_last_modified
+	__http_response_header = {
+	.name = "Last-Modified",
+	.parse = http_parse_last_modified,
+};
+
+/**
+ * Report entity tag
+ *
+ * @v intf		Data transfer interface
+ * @v etag		Entity tag
+ * @ret rc		Return status code
+ *
+ * The entity tag is valid only for the duration of the call.
+ */
+int http_etag ( struct interface *intf, const char *etag ) {
+	struct interface *dest;
+	http_etag_TYPE ( void * ) *op =
+		intf_get_dest_op ( intf, http_etag, &dest );
+	void *object = intf_object ( dest );
+	int rc;
+
+	if ( op ) {
+		rc = op ( object, etag );
+	} else {
+		/* Default is to ignore the entity tag */
+		rc = 0;
+	}
+
+	intf_put ( dest );
+	return rc;
+}
+
+/**
+ * Report last modification date
+ *
+ * @v intf		Data transfer interface
+ * @v modified		Last modification date
+ * @ret rc		Return status code
+ *
+ * The date is valid only for the duration of the call.
+ */
+int http_last_modified ( struct interface *intf, const char *modified ) {
+	struct interface *dest;
+	http_last_modified_TYPE ( void * ) *op =
+		intf_get_dest_op ( intf, http_last_modified, &dest );
+	void *object = intf_object ( dest );
+	int rc;
+
+	if ( op ) {
+		rc = op ( object, modified );
+	} else {
+		/* Default is to ignore the date */
+		rc = 0;
+	}
+
+	intf_put ( dest );
+	return rc;
+}
+
+/**
+ * Report that conditionally requested content is not modified
+ *
+ * @v intf		Data transfer interface
+ * @ret rc		Return status code
+ *
+ * The recipient is expected to already hold a copy of the content.
+ * No content will be delivered, and the transfer will then complete
+ * successfully.
+ */
+int http_not_modified ( struct interface *intf ) {
+	struct interface *dest;
+	http_not_modified_TYPE ( void * ) *op =
+		intf_get_dest_op ( intf, http_not_modified, &dest );
+	void *object = intf_object ( dest );
+	int rc;
+
+	if ( op ) {
+		rc = op ( object );
+	} else {
+		/* Default is to fail, since no content will be delivered */
+		rc = -ENOTSUP_NOT_MODIFIED;
+	}
+
+	intf_put ( dest );
+	return rc;
+}
+
 /**
  * Parse HTTP "Transfer-Encoding" header
  *
@@ -1447,11 +1769,27 @@ static int http_rx_headers ( struct http_transaction *http,
 	struct http_transfer_encoding *transfer;
 	struct http_content_encoding *content;
 	char *line;
+	int consumed;
 	int rc;
 
-	/* Buffer header line */
-	if ( ( rc = http_rx_linebuf ( http, *iobuf,
-				      &http->response.headers ) ) != 0 )
+	/* Buffer complete header block in a single pass, if possible.
+	 * This avoids reallocating the header buffer for each line
+	 * in the common case that all headers arrive together.
+	 */
+	consumed = line_buffer_block ( &http->response.headers,
+				       ( *iobuf )->data, iob_len ( *iobuf ) );
+	if ( consumed < 0 ) {
+		rc = consumed;
+		DBGC ( http, "HTTP %p could not buffer headers: %s\n",
+		       http, strerror ( rc ) );
+		return rc;
+	}
+	iob_pull ( *iobuf, consumed );
+
+	/* Otherwise, buffer header line */
+	if ( ( ! consumed ) &&
+	     ( ( rc = http_rx_linebuf ( http, *iobuf,
+					&http->response.headers ) ) != 0 ) )
 		return rc;
 
 	/* Wait until we see the empty line marking end of headers */
@@ -1462,6 +1800,41 @@ static int http_rx_headers ( struct http_transaction *http,
 	/* Process headers */
 	if ( ( rc = http_parse_headers ( http ) ) != 0 )
 		return rc;
+	timeline_record ( "http", "response", http->request.host,
+			  http->response.rc );
+
+	/* Report entity tag, if applicable */
+	if ( http->response.etag && ( http->response.rc == 0 ) &&
+	     ( ( rc = http_etag ( &http->transfer,
+				  http->response.etag ) ) != 0 ) )
+		return rc;
+
+	/* Report last modification date, if applicable */
+	if ( http->response.modified && ( http->response.rc == 0 ) &&
+	     ( ( rc = http_last_modified ( &http->transfer,
+					   http->response.modified ) ) != 0 ) )
+		return rc;
+
+	/* Complete transfer if conditionally requested content is
+	 * not modified.  No content will follow, regardless of any
+	 * content length or encoding headers.
+	 */
+	if ( ( http->response.status == 304 ) &&
+	     ( http->response.rc == 0 ) ) {
+		if ( ( rc = http_not_modified ( &http->transfer ) ) != 0 )
+			return rc;
+		if ( ( rc = http_transfer_complete ( http ) ) != 0 )
+			return rc;
+		return 0;
+	}
+
+	/* Fail if a requested range was not honoured by the server */
+	if ( http->request.range.len && ( http->response.rc == 0 ) &&
+	     ( http->response.status != 206 ) ) {
+		DBGC ( http, "HTTP %p range request not honoured (status %d)\n",
+		       http, http->response.status );
+		return -ENOTSUP_RANGE;
+	}
 
 	/* Initialise content encoding, if applicable */
 	if ( ( content = http->response.content.encoding ) &&
@@ -1472,10 +1845,8 @@ static int http_rx_headers ( struct http_transaction *http,
 	}
 
 	/* Presize receive buffer, if we have a content length */
-	if ( http->response.content.len ) {
-		xfer_seek ( &http->transfer, http->response.content.len );
-		xfer_seek ( &http->transfer, 0 );
-	}
+	if ( http->response.content.len )
+		xfer_presize ( &http->transfer, http->response.content.len );
 
 	/* Complete transfer if this is a HEAD request */
 	if ( http->request.method == &http_head ) {
@@ -1543,20 +1914,36 @@ static int http_init_transfer_identity ( struct http_transaction *http ) {
 static int http_rx_transfer_identity ( struct http_transaction *http,
 				       struct io_buffer **iobuf ) {
 	size_t len = iob_len ( *iobuf );
+	struct io_buffer *excess;
+	size_t remaining;
 	int rc;
 
-	/* Update lengths */
-	http->len += len;
-
-	/* Fail if this transfer would overrun the expected content
-	 * length (if any).
+	/* Hand back any data beyond the expected content length (if
+	 * any) to the connection.  On a persistent connection, this
+	 * may be the start of the response to a pipelined request.
 	 */
-	if ( ( http->response.flags & HTTP_RESPONSE_CONTENT_LEN ) &&
-	     ( http->len > http->response.content.len ) ) {
-		DBGC ( http, "HTTP %p content length overrun\n", http );
-		return -EIO_CONTENT_LENGTH;
+	if ( http->response.flags & HTTP_RESPONSE_CONTENT_LEN ) {
+		remaining = ( http->response.content.len - http->len );
+		if ( len > remaining ) {
+			excess = *iobuf;
+			*iobuf = iob_split ( excess, remaining );
+			if ( ! *iobuf ) {
+				*iobuf = excess;
+				return -ENOMEM;
+			}
+			len = remaining;
+			if ( ( rc = http_conn_pushback ( &http->conn,
+							 excess ) ) != 0 ) {
+				DBGC ( http, "HTTP %p content length overrun\n",
+				       http );
+				return -EIO_CONTENT_LENGTH;
+			}
+		}
 	}
 
+	/* Update lengths */
+	http->len += len;
+
 	/* Hand off to content encoding */
 	if ( ( rc = xfer_deliver_iob ( &http->transfer,
 				       iob_disown ( *iobuf ) ) ) != 0 )
@@ -1634,6 +2021,57 @@ static int http_init_transfer_chunked ( struct http_transaction *http ) {
 	/* Sanity checks */
 	assert ( http->remaining == 0 );
 	assert ( http->linebuf.len == 0 );
+	assert ( http->chunk == NULL );
+
+	return 0;
+}
+
+/**
+ * Deliver coalesced chunk data
+ *
+ * @v http		HTTP transaction
+ * @ret rc		Return status code
+ */
+static int http_flush_chunks ( struct http_transaction *http ) {
+
+	/* Do nothing unless there is coalesced data */
+	if ( ! http->chunk )
+		return 0;
+
+	/* Hand off to content encoding */
+	return xfer_deliver_iob ( &http->transfer, iob_disown ( http->chunk ) );
+}
+
+/**
+ * Coalesce chunk data
+ *
+ * @v http		HTTP transaction
+ * @v data		Chunk data
+ * @v len		Length of chunk data
+ * @ret rc		Return status code
+ */
+static int http_coalesce_chunk ( struct http_transaction *http,
+				 const void *data, size_t len ) {
+	size_t size;
+	int rc;
+
+	/* Deliver any existing coalesced data if there is no room */
+	if ( http->chunk && ( iob_tailroom ( http->chunk ) < len ) ) {
+		if ( ( rc = http_flush_chunks ( http ) ) != 0 )
+			return rc;
+	}
+
+	/* Allocate coalescing buffer, if applicable */
+	if ( ! http->chunk ) {
+		size = ( ( len > HTTP_CHUNK_COALESCE_LEN ) ?
+			 len : HTTP_CHUNK_COALESCE_LEN );
+		http->chunk = alloc_iob ( size );
+		if ( ! http->chunk )
+			return -ENOMEM;
+	}
+
+	/* Append data */
+	memcpy ( iob_put ( http->chunk, len ), data, len );
 
 	return 0;
 }
@@ -1672,10 +2110,16 @@ static int http_rx_chunk_len ( struct http_transaction *http,
 	/* Empty line buffer */
 	empty_line_buffer ( &http->linebuf );
 
-	/* Update expected length */
+	/* Update expected length, allowing for any coalesced data
+	 * which has not yet been delivered.
+	 */
 	len = ( http->len + http->remaining );
 	xfer_seek ( &http->transfer, len );
-	xfer_seek ( &http->transfer, http->len );
+	if ( http->chunk )
+		len = ( http->len - iob_len ( http->chunk ) );
+	else
+		len = http->len;
+	xfer_seek ( &http->transfer, len );
 
 	/* If chunk length is zero, then move to response trailers state */
 	if ( ! http->remaining )
@@ -1694,8 +2138,10 @@ static int http_rx_chunk_len ( struct http_transaction *http,
 static int http_rx_chunk_data ( struct http_transaction *http,
 				struct io_buffer **iobuf ) {
 	struct io_buffer *payload;
+	struct io_buffer *original;
 	uint8_t *crlf;
 	size_t len;
+	size_t tail;
 	int rc;
 
 	/* In the common case of a final chunk in a packet which also
@@ -1720,23 +2166,46 @@ static int http_rx_chunk_data ( struct http_transaction *http,
 		http->len += len;
 		http->remaining -= len;
 
-	} else {
+	} else if ( http->remaining > ( tail = ( len - http->remaining ) ) ) {
 
-		/* Partial buffer is to be consumed: copy data to a
-		 * temporary I/O buffer.
+		/* Partial buffer is to be consumed, but most of the
+		 * buffer is chunk data: copy the (shorter) remainder
+		 * to a new I/O buffer and use the original I/O
+		 * buffer as payload.
 		 */
-		payload = alloc_iob ( http->remaining );
+		original = *iobuf;
+		payload = alloc_iob ( tail );
 		if ( ! payload ) {
 			rc = -ENOMEM;
 			goto err;
 		}
-		memcpy ( iob_put ( payload, http->remaining ), (*iobuf)->data,
-			 http->remaining );
+		memcpy ( iob_put ( payload, tail ),
+			 ( (*iobuf)->data + http->remaining ), tail );
+		iob_unput ( *iobuf, tail );
+		*iobuf = payload;
+		payload = original;
+		http->len += http->remaining;
+		http->remaining = 0;
+
+	} else {
+
+		/* Partial buffer is to be consumed, and most of the
+		 * buffer is not chunk data: coalesce data with any
+		 * preceding small chunks.
+		 */
+		if ( ( rc = http_coalesce_chunk ( http, (*iobuf)->data,
+						  http->remaining ) ) != 0 )
+			return rc;
 		iob_pull ( *iobuf, http->remaining );
 		http->len += http->remaining;
 		http->remaining = 0;
+		return 0;
 	}
 
+	/* Deliver any preceding coalesced data */
+	if ( ( rc = http_flush_chunks ( http ) ) != 0 )
+		goto err_flush;
+
 	/* Hand off to content encoding */
 	if ( ( rc = xfer_deliver_iob ( &http->transfer,
 				       iob_disown ( payload ) ) ) != 0 )
@@ -1744,8 +2213,9 @@ static int http_rx_chunk_data ( struct http_transaction *http,
 
 	return 0;
 
+ err_flush:
+	free_iob ( payload );
  err:
-	assert ( payload == NULL );
 	return rc;
 }
 
@@ -1758,13 +2228,27 @@ static int http_rx_chunk_data ( struct http_transaction *http,
  */
 static int http_rx_transfer_chunked ( struct http_transaction *http,
 				      struct io_buffer **iobuf ) {
+	int rc;
 
 	/* Handle as chunk length or chunk data as appropriate */
 	if ( http->remaining ) {
-		return http_rx_chunk_data ( http, iobuf );
+		rc = http_rx_chunk_data ( http, iobuf );
 	} else {
-		return http_rx_chunk_len ( http, iobuf );
+		rc = http_rx_chunk_len ( http, iobuf );
 	}
+	if ( rc != 0 )
+		return rc;
+
+	/* Deliver coalesced data once the received I/O buffer has
+	 * been exhausted or the final chunk has been reached.
+	 */
+	if ( ( ! *iobuf ) || ( ! iob_len ( *iobuf ) ) ||
+	     ( http->state == &http_trailers ) ) {
+		if ( ( rc = http_flush_chunks ( http ) ) != 0 )
+			return rc;
+	}
+
+	return 0;
 }
 
 /** Chunked transfer encoding */
@@ -1889,8 +2373,13 @@ static size_t http_params ( struct parameters *params, char *buf, size_t len ) {
  * @ret rc		Return status code
  */
 static int http_open_get_uri ( struct interface *xfer, struct uri *uri ) {
+	int rc;
+
+	/* Use parallel range downloads, if applicable */
+	if ( ( rc = httpmux_open ( xfer, uri ) ) != -ENOTSUP )
+		return rc;
 
-	return http_open ( xfer, &http_get, uri, NULL, NULL );
+	return http_open ( xfer, &http_get, uri, NULL, NULL, NULL );
 }
 
 /**
@@ -1928,7 +2417,8 @@ static int http_open_post_uri ( struct interface *xfer, struct uri *uri ) {
 	content.len = len;
 
 	/* Open HTTP transaction */
-	if ( ( rc = http_open ( xfer, &http_post, uri, NULL, &content ) ) != 0 )
+	if ( ( rc = http_open ( xfer, &http_post, uri, NULL, &content,
+				NULL ) ) != 0 )
 		goto err_open;
 
  err_open:
@@ -0,0 +1,607 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/**
+ * @file
+ *
+ * Hyper Text Transfer Protocol (HTTP) gzip and deflate content encodings
+ *
+ * Compressed content is inflated on the fly as it is received, so
+ * that the consumer sees only the decoded content.  The decompressor
+ * writes into a private output buffer which retains the most recent
+ * 32kB of output (the maximum back-reference distance permitted by
+ * RFC 1951), and newly decoded data is passed up as soon as each
+ * received I/O buffer has been consumed.
+ *
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <byteswap.h>
+#include <ipxe/refcnt.h>
+#include <ipxe/interface.h>
+#include <ipxe/xfer.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/uaccess.h>
+#include <ipxe/deflate.h>
+#include <ipxe/crc32.h>
+#include <ipxe/gzip.h>
+#include <ipxe/http.h>
+
+/* Disambiguate the various error causes */
+#define EINVAL_GZIP_HEADER __einfo_error ( EINFO_EINVAL_GZIP_HEADER )
+#define EINFO_EINVAL_GZIP_HEADER					\
+	__einfo_uniqify ( EINFO_EINVAL, 0x01,				\
+			  "Invalid gzip header" )
+#define EIO_GZIP_CRC __einfo_error ( EINFO_EIO_GZIP_CRC )
+#define EINFO_EIO_GZIP_CRC						\
+	__einfo_uniqify ( EINFO_EIO, 0x01,				\
+			  "gzip CRC32 mismatch" )
+#define EIO_GZIP_LEN __einfo_error ( EINFO_EIO_GZIP_LEN )
+#define EINFO_EIO_GZIP_LEN						\
+	__einfo_uniqify ( EINFO_EIO, 0x02,				\
+			  "gzip length mismatch" )
+#define EPIPE_TRUNCATED __einfo_error ( EINFO_EPIPE_TRUNCATED )
+#define EINFO_EPIPE_TRUNCATED						\
+	__einfo_uniqify ( EINFO_EPIPE, 0x01,				\
+			  "Compressed content truncated" )
+
+/** Decompressor history window length */
+#define HTTP_GZIP_WINDOW 32768
+
+/** Maximum length of compressed data passed to each decompressor call
+ *
+ * The decompressor does not stop when its output buffer is full, so
+ * compressed data must be fed in slices small enough that the output
+ * of a single call can never overflow the space remaining.
+ */
+#define HTTP_GZIP_SLICE 64
+
+/** Maximum expansion factor of a single compressed byte
+ *
+ * The most extreme case is a 258-byte match encoded using two
+ * single-bit Huffman codes, i.e. 129 bytes per input bit.
+ */
+#define HTTP_GZIP_EXPANSION ( 8 * 129 )
+
+/** Maximum output from a single decompressor call
+ *
+ * The decompressor may additionally be holding up to eight bytes of
+ * previously consumed input within its accumulator.
+ */
+#define HTTP_GZIP_MAX_OUT \
+	( ( HTTP_GZIP_SLICE + sizeof ( uint64_t ) ) * HTTP_GZIP_EXPANSION )
+
+/** Output buffer length */
+#define HTTP_GZIP_BUF_LEN ( HTTP_GZIP_WINDOW + HTTP_GZIP_MAX_OUT )
+
+/** gzip framing state */
+enum http_gzip_state {
+	/** Receiving fixed-length member header */
+	HTTP_GZIP_HEADER = 0,
+	/** Receiving extra field length */
+	HTTP_GZIP_XLEN,
+	/** Skipping fixed-length optional field */
+	HTTP_GZIP_SKIP,
+	/** Skipping NUL-terminated optional field */
+	HTTP_GZIP_STRING,
+	/** Receiving compressed data */
+	HTTP_GZIP_DATA,
+	/** Receiving member trailer */
+	HTTP_GZIP_TRAILER,
+	/** Content complete */
+	HTTP_GZIP_DONE,
+};
+
+/** An HTTP gzip or deflate content decoder */
+struct http_gzip {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Decoded data transfer interface */
+	struct interface xfer;
+	/** Encoded data transfer interface */
+	struct interface raw;
+
+	/** Content uses gzip framing */
+	int gzip;
+	/** Framing state */
+	enum http_gzip_state state;
+	/** Optional header fields not yet processed */
+	unsigned int flags;
+	/** Length of fixed-length field received or remaining */
+	size_t len;
+	/** Fixed-length field being received */
+	union {
+		/** Member header */
+		struct gzip_header header;
+		/** Extra field length */
+		uint16_t xlen;
+		/** Member trailer */
+		struct gzip_trailer trailer;
+		/** Raw bytes */
+		uint8_t bytes[ sizeof ( struct gzip_header ) ];
+	} field;
+	/** CRC32 of decoded data (not inverted) */
+	uint32_t crc;
+	/** Length of decoded data (modulo 2^32) */
+	uint32_t isize;
+	/** Number of complete gzip members */
+	unsigned int members;
+
+	/** Decompressor */
+	struct deflate deflate;
+	/** Output buffer */
+	uint8_t *buf;
+	/** Length of data within output buffer */
+	size_t fill;
+	/** Length of data within output buffer already passed up */
+	size_t done;
+};
+
+/**
+ * Free HTTP content decoder
+ *
+ * @v refcnt		Reference count
+ */
+static void http_gzip_free ( struct refcnt *refcnt ) {
+	struct http_gzip *gzip =
+		container_of ( refcnt, struct http_gzip, refcnt );
+
+	free ( gzip->buf );
+	free ( gzip );
+}
+
+/**
+ * Close HTTP content decoder
+ *
+ * @v gzip		HTTP content decoder
+ * @v rc		Reason for close
+ */
+static void http_gzip_close ( struct http_gzip *gzip, int rc ) {
+
+	/* Shut down all interfaces */
+	intf_shutdown ( &gzip->raw, rc );
+	intf_shutdown ( &gzip->xfer, rc );
+}
+
+/**
+ * Pass up decoded data
+ *
+ * @v gzip		HTTP content decoder
+ * @ret rc		Return status code
+ */
+static int http_gzip_flush ( struct http_gzip *gzip ) {
+	const void *data = ( gzip->buf + gzip->done );
+	size_t len = ( gzip->fill - gzip->done );
+	int rc;
+
+	/* Do nothing if there is no new data */
+	if ( ! len )
+		return 0;
+
+	/* Update checksum and length */
+	gzip->crc = crc32_le ( gzip->crc, data, len );
+	gzip->isize += len;
+	gzip->done = gzip->fill;
+
+	/* Pass up data */
+	if ( ( rc = xfer_deliver_raw ( &gzip->xfer, data, len ) ) != 0 ) {
+		DBGC ( gzip, "HTTPGZIP %p could not deliver: %s\n",
+		       gzip, strerror ( rc ) );
+		return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * Select next gzip optional header field
+ *
+ * @v gzip		HTTP content decoder
+ */
+static void http_gzip_next_field ( struct http_gzip *gzip ) {
+
+	/* Fields appear in a fixed order as defined by RFC 1952 */
+	gzip->len = 0;
+	if ( gzip->flags & GZIP_FEXTRA ) {
+		gzip->flags &= ~GZIP_FEXTRA;
+		gzip->state = HTTP_GZIP_XLEN;
+	} else if ( gzip->flags & GZIP_FNAME ) {
+		gzip->flags &= ~GZIP_FNAME;
+		gzip->state = HTTP_GZIP_STRING;
+	} else if ( gzip->flags & GZIP_FCOMMENT ) {
+		gzip->flags &= ~GZIP_FCOMMENT;
+		gzip->state = HTTP_GZIP_STRING;
+	} else if ( gzip->flags & GZIP_FHCRC ) {
+		gzip->flags &= ~GZIP_FHCRC;
+		gzip->state = HTTP_GZIP_SKIP;
+		gzip->len = sizeof ( uint16_t );
+	} else {
+		gzip->state = HTTP_GZIP_DATA;
+		deflate_init ( &gzip->deflate, DEFLATE_RAW );
+	}
+}
+
+/**
+ * Process gzip framing byte
+ *
+ * @v gzip		HTTP content decoder
+ * @v byte		Received byte
+ * @ret rc		Return status code
+ */
+static int http_gzip_frame ( struct http_gzip *gzip, uint8_t byte ) {
+	struct gzip_header *header = &gzip->field.header;
+	struct gzip_trailer *trailer = &gzip->field.trailer;
+
+	switch ( gzip->state ) {
+
+	case HTTP_GZIP_HEADER:
+		gzip->field.bytes[ gzip->len++ ] = byte;
+		if ( gzip->len < sizeof ( *header ) )
+			break;
+		if ( ( header->magic != cpu_to_le16 ( GZIP_MAGIC ) ) ||
+		     ( header->cm != GZIP_CM_DEFLATE ) ||
+		     ( header->flags & GZIP_FRESERVED ) ) {
+			if ( gzip->members ) {
+				DBGC ( gzip, "HTTPGZIP %p ignoring trailing "
+				       "garbage\n", gzip );
+				gzip->state = HTTP_GZIP_DONE;
+				break;
+			}
+			DBGC ( gzip, "HTTPGZIP %p invalid header:\n", gzip );
+			DBGC_HDA ( gzip, 0, header, sizeof ( *header ) );
+			return -EINVAL_GZIP_HEADER;
+		}
+		gzip->flags = header->flags;
+		http_gzip_next_field ( gzip );
+		break;
+
+	case HTTP_GZIP_XLEN:
+		gzip->field.bytes[ gzip->len++ ] = byte;
+		if ( gzip->len < sizeof ( gzip->field.xlen ) )
+			break;
+		gzip->len = le16_to_cpu ( gzip->field.xlen );
+		gzip->state = HTTP_GZIP_SKIP;
+		if ( ! gzip->len )
+			http_gzip_next_field ( gzip );
+		break;
+
+	case HTTP_GZIP_SKIP:
+		if ( ! --gzip->len )
+			http_gzip_next_field ( gzip );
+		break;
+
+	case HTTP_GZIP_STRING:
+		if ( ! byte )
+			http_gzip_next_field ( gzip );
+		break;
+
+	case HTTP_GZIP_TRAILER:
+		gzip->field.bytes[ gzip->len++ ] = byte;
+		if ( gzip->len < sizeof ( *trailer ) )
+			break;
+		if ( le32_to_cpu ( trailer->crc ) != ~gzip->crc ) {
+			DBGC ( gzip, "HTTPGZIP %p CRC32 mismatch (got %08x, "
+			       "expected %08x)\n", gzip, ~gzip->crc,
+			       le32_to_cpu ( trailer->crc ) );
+			return -EIO_GZIP_CRC;
+		}
+		if ( le32_to_cpu ( trailer->isize ) != gzip->isize ) {
+			DBGC ( gzip, "HTTPGZIP %p length mismatch (got %#08x, "
+			       "expected %#08x)\n", gzip, gzip->isize,
+			       le32_to_cpu ( trailer->isize ) );
+			return -EIO_GZIP_LEN;
+		}
+
+		/* Prepare for any further member, which (as per RFC
+		 * 1952) forms a continuation of the decoded content.
+		 */
+		gzip->members++;
+		gzip->state = HTTP_GZIP_HEADER;
+		gzip->len = 0;
+		gzip->crc = 0xffffffffUL;
+		gzip->isize = 0;
+		break;
+
+	default:
+		/* Trailing garbage is ignored */
+		break;
+	}
+
+	return 0;
+}
+
+/**
+ * Complete compressed data
+ *
+ * @v gzip		HTTP content decoder
+ * @ret rc		Return status code
+ */
+static int http_gzip_finish ( struct http_gzip *gzip ) {
+	struct deflate *deflate = &gzip->deflate;
+	uint64_t accumulator;
+	unsigned int bits;
+	int rc;
+
+	/* Pass up any remaining decoded data */
+	if ( ( rc = http_gzip_flush ( gzip ) ) != 0 )
+		return rc;
+
+	/* Complete immediately if there is no gzip trailer */
+	if ( ! gzip->gzip ) {
+		gzip->state = HTTP_GZIP_DONE;
+		return 0;
+	}
+
+	/* The decompressor may already have consumed some bytes of
+	 * the trailer into its accumulator.  Discard any bits up to
+	 * the next byte boundary, and process any whole bytes.  (These
+	 * may extend beyond the trailer into the header of a further
+	 * member.)
+	 */
+	gzip->state = HTTP_GZIP_TRAILER;
+	gzip->len = 0;
+	bits = ( deflate->bits & ~7U );
+	accumulator = ( deflate->accumulator >> ( deflate->bits & 7 ) );
+	for ( ; bits ; bits -= 8, accumulator >>= 8 ) {
+		if ( ( rc = http_gzip_frame ( gzip, accumulator ) ) != 0 )
+			return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * Inflate compressed data
+ *
+ * @v gzip		HTTP content decoder
+ * @v data		Compressed data
+ * @v len		Length of compressed data
+ * @ret used		Length of compressed data consumed, or negative error
+ */
+static int http_gzip_inflate ( struct http_gzip *gzip, const void *data,
+			       size_t len ) {
+	struct deflate_chunk in;
+	struct deflate_chunk out;
+	size_t keep;
+	int rc;
+
+	/* Limit input to a single slice */
+	if ( len > HTTP_GZIP_SLICE )
+		len = HTTP_GZIP_SLICE;
+
+	/* Discard all but the history window if output space is low */
+	if ( ( gzip->fill + HTTP_GZIP_MAX_OUT ) > HTTP_GZIP_BUF_LEN ) {
+		if ( ( rc = http_gzip_flush ( gzip ) ) != 0 )
+			return rc;
+		keep = HTTP_GZIP_WINDOW;
+		memmove ( gzip->buf, ( gzip->buf + gzip->fill - keep ), keep );
+		gzip->fill = gzip->done = keep;
+	}
+
+	/* Inflate slice */
+	deflate_chunk_init ( &in, virt_to_user ( data ), 0, len );
+	deflate_chunk_init ( &out, virt_to_user ( gzip->buf ), gzip->fill,
+			     HTTP_GZIP_BUF_LEN );
+	if ( ( rc = deflate_inflate ( &gzip->deflate, &in, &out ) ) != 0 ) {
+		DBGC ( gzip, "HTTPGZIP %p could not inflate: %s\n",
+		       gzip, strerror ( rc ) );
+		return rc;
+	}
+	assert ( out.offset <= HTTP_GZIP_BUF_LEN );
+	gzip->fill = out.offset;
+
+	/* Handle end of compressed data */
+	if ( deflate_finished ( &gzip->deflate ) &&
+	     ( ( rc = http_gzip_finish ( gzip ) ) != 0 ) )
+		return rc;
+
+	return in.offset;
+}
+
+/**
+ * Receive encoded data
+ *
+ * @v gzip		HTTP content decoder
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int http_gzip_deliver ( struct http_gzip *gzip,
+			       struct io_buffer *iobuf,
+			       struct xfer_metadata *meta __unused ) {
+	int used;
+	int rc;
+
+	/* Positioning metadata (e.g. the presizing hint derived from
+	 * Content-Length) describes the encoded data and so is
+	 * ignored.  Encoded data is always delivered sequentially.
+	 */
+	while ( iob_len ( iobuf ) ) {
+		if ( gzip->state == HTTP_GZIP_DATA ) {
+			used = http_gzip_inflate ( gzip, iobuf->data,
+						   iob_len ( iobuf ) );
+			if ( used < 0 ) {
+				rc = used;
+				goto err;
+			}
+		} else {
+			if ( ( rc = http_gzip_frame ( gzip,
+						      *( ( uint8_t * )
+							 iobuf->data ) ) ) != 0)
+				goto err;
+			used = 1;
+		}
+		iob_pull ( iobuf, used );
+	}
+
+	/* Pass up decoded data */
+	if ( ( rc = http_gzip_flush ( gzip ) ) != 0 )
+		goto err;
+
+	free_iob ( iobuf );
+	return 0;
+
+ err:
+	free_iob ( iobuf );
+	http_gzip_close ( gzip, rc );
+	return rc;
+}
+
+/**
+ * Close encoded data transfer interface
+ *
+ * @v gzip		HTTP content decoder
+ * @v rc		Reason for close
+ */
+static void http_gzip_raw_close ( struct http_gzip *gzip, int rc ) {
+
+	/* Treat premature end of content as an error.  Content may
+	 * end after any complete gzip member.
+	 */
+	if ( ( rc == 0 ) && ( gzip->state != HTTP_GZIP_DONE ) &&
+	     ! ( ( gzip->state == HTTP_GZIP_HEADER ) && gzip->members ) ) {
+		DBGC ( gzip, "HTTPGZIP %p content truncated\n", gzip );
+		rc = -EPIPE_TRUNCATED;
+	}
+
+	/* Close decoder */
+	http_gzip_close ( gzip, rc );
+}
+
+/** Decoded data transfer interface operations */
+static struct interface_operation http_gzip_xfer_operations[] = {
+	INTF_OP ( intf_close, struct http_gzip *, http_gzip_close ),
+};
+
+/** Decoded data transfer interface descriptor */
+static struct interface_descriptor http_gzip_xfer_desc =
+	INTF_DESC_PASSTHRU ( struct http_gzip, xfer,
+			     http_gzip_xfer_operations, raw );
+
+/** Encoded data transfer interface operations */
+static struct interface_operation http_gzip_raw_operations[] = {
+	INTF_OP ( xfer_deliver, struct http_gzip *, http_gzip_deliver ),
+	INTF_OP ( intf_close, struct http_gzip *, http_gzip_raw_close ),
+};
+
+/** Encoded data transfer interface descriptor */
+static struct interface_descriptor http_gzip_raw_desc =
+	INTF_DESC_PASSTHRU ( struct http_gzip, raw,
+			     http_gzip_raw_operations, xfer );
+
+/**
+ * Check if gzip or deflate content encoding is supported
+ *
+ * @v http		HTTP transaction
+ * @ret supported	Content encoding is supported for this request
+ */
+static int http_gzip_supported ( struct http_transaction *http ) {
+
+	/* Range requests (e.g. for parallel downloads or SAN block
+	 * access) address the encoded content, and so cannot be
+	 * satisfied by a compressed response.  A HEAD request has no
+	 * content to decode.
+	 */
+	return ( ( http->request.range.len == 0 ) &&
+		 ( http->request.method != &http_head ) );
+}
+
+/**
+ * Initialise gzip or deflate content decoder
+ *
+ * @v http		HTTP transaction
+ * @v gzip_framing	Content uses gzip framing
+ * @ret rc		Return status code
+ */
+static int http_gzip_init_format ( struct http_transaction *http,
+				   int gzip_framing ) {
+	struct http_gzip *gzip;
+
+	/* Allocate and initialise structure */
+	gzip = zalloc ( sizeof ( *gzip ) );
+	if ( ! gzip )
+		return -ENOMEM;
+	ref_init ( &gzip->refcnt, http_gzip_free );
+	intf_init ( &gzip->xfer, &http_gzip_xfer_desc, &gzip->refcnt );
+	intf_init ( &gzip->raw, &http_gzip_raw_desc, &gzip->refcnt );
+	gzip->gzip = gzip_framing;
+	gzip->state = ( gzip_framing ? HTTP_GZIP_HEADER : HTTP_GZIP_DATA );
+	gzip->crc = 0xffffffffUL;
+	deflate_init ( &gzip->deflate,
+		       ( gzip_framing ? DEFLATE_RAW : DEFLATE_ZLIB ) );
+
+	/* Allocate output buffer */
+	gzip->buf = malloc ( HTTP_GZIP_BUF_LEN );
+	if ( ! gzip->buf ) {
+		ref_put ( &gzip->refcnt );
+		return -ENOMEM;
+	}
+	DBGC ( gzip, "HTTPGZIP %p decoding %s for %p\n",
+	       gzip, ( gzip_framing ? "gzip" : "deflate" ), http );
+
+	/* Attach to parent interfaces, mortalise self, and return */
+	intf_plug_plug ( &gzip->xfer, &http->content );
+	intf_plug_plug ( &gzip->raw, &http->transfer );
+	ref_put ( &gzip->refcnt );
+	return 0;
+}
+
+/**
+ * Initialise gzip content decoder
+ *
+ * @v http		HTTP transaction
+ * @ret rc		Return status code
+ */
+static int http_gzip_init ( struct http_transaction *http ) {
+
+	return http_gzip_init_format ( http, 1 );
+}
+
+/**
+ * Initialise deflate content decoder
+ *
+ * @v http		HTTP transaction
+ * @ret rc		Return status code
+ */
+static int http_deflate_init ( struct http_transaction *http ) {
+
+	return http_gzip_init_format ( http, 0 );
+}
+
+/** gzip HTTP content encoding */
+struct http_content_encoding http_gzip_encoding __http_content_encoding = {
+	.name = "gzip",
+	.supported = http_gzip_supported,
+	.init = http_gzip_init,
+};
+
+/** deflate HTTP content encoding */
+struct http_content_encoding http_deflate_encoding __http_content_encoding = {
+	.name = "deflate",
+	.supported = http_gzip_supported,
+	.init = http_deflate_init,
+};
@@ -0,0 +1,485 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/**
+ * @file
+ *
+ * Hyper Text Transfer Protocol (HTTP) parallel range download multiplexer
+ *
+ * A single TCP connection may be unable to make full use of a link
+ * with a high bandwidth-delay product or a non-negligible packet
+ * loss rate.  We therefore allow a large download to be split into
+ * several ranges, each retrieved over a separate connection.
+ *
+ * The download is started as an ordinary GET request (the "primary"
+ * download).  If the server provides a content length (which we see
+ * as the presizing seek issued by the HTTP core), then we open range
+ * requests for the latter portions of the content, and truncate the
+ * primary download at the start of the first range.  If any range
+ * request fails before the primary download has been truncated
+ * (e.g. because the server does not support range requests), then we
+ * simply abandon the range requests and allow the primary download
+ * to run to completion.
+ *
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/xfer.h>
+#include <ipxe/xferbuf.h>
+#include <ipxe/settings.h>
+#include <ipxe/http.h>
+#include <ipxe/httpmux.h>
+
+/** HTTP parallel connection count setting */
+const struct setting http_parallel_setting __setting ( SETTING_MISC,
+						       http-parallel ) = {
+	.name = "http-parallel",
+	.description = "HTTP parallel connections",
+	.type = &setting_type_uint8,
+};
+
+/**
+ * Free HTTP download multiplexer
+ *
+ * @v refcnt		Reference count
+ */
+static void httpmux_free ( struct refcnt *refcnt ) {
+	struct http_multiplexer *httpmux =
+		container_of ( refcnt, struct http_multiplexer, refcnt );
+
+	uri_put ( httpmux->uri );
+	free ( httpmux );
+}
+
+/**
+ * Close HTTP download multiplexer
+ *
+ * @v httpmux		HTTP download multiplexer
+ * @v rc		Reason for close
+ */
+static void httpmux_close ( struct http_multiplexer *httpmux, int rc ) {
+	unsigned int i;
+
+	/* Shut down all range downloads */
+	for ( i = 0 ; i < ( HTTPMUX_MAX_CONNECTIONS - 1 ) ; i++ )
+		intf_shutdown ( &httpmux->range[i].xfer, rc );
+
+	/* Shut down all other interfaces */
+	intf_shutdown ( &httpmux->primary, rc );
+	intf_shutdown ( &httpmux->xfer, rc );
+}
+
+/**
+ * Record completion of a download
+ *
+ * @v httpmux		HTTP download multiplexer
+ */
+static void httpmux_done ( struct http_multiplexer *httpmux ) {
+
+	/* Close multiplexer once all downloads have completed */
+	assert ( httpmux->busy > 0 );
+	if ( --httpmux->busy == 0 )
+		httpmux_close ( httpmux, 0 );
+}
+
+/**
+ * Abandon range downloads
+ *
+ * @v httpmux		HTTP download multiplexer
+ * @v rc		Reason for abandonment
+ */
+static void httpmux_abandon ( struct http_multiplexer *httpmux, int rc ) {
+	struct http_multiplexed_range *range;
+	unsigned int i;
+
+	DBGC ( httpmux, "HTTPMUX %p abandoning range downloads: %s\n",
+	       httpmux, strerror ( rc ) );
+
+	/* Shut down all range downloads */
+	for ( i = 0 ; i < ( HTTPMUX_MAX_CONNECTIONS - 1 ) ; i++ ) {
+		range = &httpmux->range[i];
+		if ( range->start == range->end )
+			continue;
+		intf_restart ( &range->xfer, rc );
+		range->start = range->end = 0;
+	}
+
+	/* Allow primary download to run to completion */
+	httpmux->limit = 0;
+	httpmux->busy = 1;
+}
+
+/**
+ * Start range downloads
+ *
+ * @v httpmux		HTTP download multiplexer
+ * @v len		Total content length
+ */
+static void httpmux_start ( struct http_multiplexer *httpmux, size_t len ) {
+	struct http_multiplexed_range *range;
+	struct http_request_range request;
+	unsigned int count;
+	unsigned int i;
+	size_t chunk;
+	int rc;
+
+	/* Record content length */
+	httpmux->len = len;
+
+	/* Calculate number of connections */
+	count = httpmux->count;
+	if ( count > ( len / HTTPMUX_MIN_LEN ) )
+		count = ( len / HTTPMUX_MIN_LEN );
+	if ( count < 2 )
+		return;
+	chunk = ( len / count );
+
+	/* Truncate primary download */
+	httpmux->limit = chunk;
+	DBGC ( httpmux, "HTTPMUX %p splitting %#zx bytes across %d "
+	       "connections\n", httpmux, len, count );
+
+	/* Open range downloads */
+	for ( i = 0 ; i < ( count - 1 ) ; i++ ) {
+		range = &httpmux->range[i];
+		range->start = ( ( i + 1 ) * chunk );
+		range->end = ( ( i == ( count - 2 ) ) ? len :
+			       ( range->start + chunk ) );
+		range->pos = range->start;
+		request.start = range->start;
+		request.len = ( range->end - range->start );
+		if ( ( rc = http_open ( &range->xfer, &http_get, httpmux->uri,
+					&request, NULL, NULL ) ) != 0 ) {
+			DBGC ( httpmux, "HTTPMUX %p could not open range "
+			       "%#zx-%#zx: %s\n", httpmux, range->start,
+			       range->end, strerror ( rc ) );
+			range->start = range->end = 0;
+			httpmux_abandon ( httpmux, rc );
+			return;
+		}
+		httpmux->busy++;
+	}
+}
+
+/**
+ * Receive data from primary download
+ *
+ * @v httpmux		HTTP download multiplexer
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int httpmux_primary_deliver ( struct http_multiplexer *httpmux,
+				     struct io_buffer *iobuf,
+				     struct xfer_metadata *meta ) {
+	struct xfer_metadata abs_meta;
+	size_t len = iob_len ( iobuf );
+	size_t pos;
+	int rc;
+
+	/* Calculate absolute position */
+	pos = httpmux->pos;
+	if ( meta->flags & XFER_FL_ABS_OFFSET )
+		pos = 0;
+	pos += meta->offset;
+
+	/* Start range downloads when the content length becomes
+	 * known (via the presizing seek).
+	 */
+	if ( ( len == 0 ) && pos && ( httpmux->len == 0 ) )
+		httpmux_start ( httpmux, pos );
+
+	/* Discard any data beyond the end of the primary download */
+	if ( httpmux->limit && len ) {
+		if ( pos >= httpmux->limit ) {
+			iob_unput ( iobuf, len );
+		} else if ( ( pos + len ) > httpmux->limit ) {
+			iob_unput ( iobuf, ( pos + len - httpmux->limit ) );
+		}
+		len = iob_len ( iobuf );
+		if ( ! len ) {
+			free_iob ( iobuf );
+			return 0;
+		}
+	}
+
+	/* Deliver to data transfer interface using absolute position */
+	memcpy ( &abs_meta, meta, sizeof ( abs_meta ) );
+	abs_meta.flags |= XFER_FL_ABS_OFFSET;
+	abs_meta.offset = pos;
+	httpmux->pos = ( pos + len );
+	if ( ( rc = xfer_deliver ( &httpmux->xfer, iob_disown ( iobuf ),
+				   &abs_meta ) ) != 0 )
+		return rc;
+
+	/* Close primary download once it reaches its limit */
+	if ( len && httpmux->limit && ( httpmux->pos >= httpmux->limit ) ) {
+		DBGC ( httpmux, "HTTPMUX %p primary download complete\n",
+		       httpmux );
+		httpmux->limit = 0;
+		intf_restart ( &httpmux->primary, 0 );
+		httpmux_done ( httpmux );
+	}
+
+	return 0;
+}
+
+/**
+ * Close primary download
+ *
+ * @v httpmux		HTTP download multiplexer
+ * @v rc		Reason for close
+ */
+static void httpmux_primary_close ( struct http_multiplexer *httpmux,
+				    int rc ) {
+
+	/* Terminate download on error */
+	if ( rc != 0 ) {
+		httpmux_close ( httpmux, rc );
+		return;
+	}
+
+	/* Restart interface and record completion */
+	intf_restart ( &httpmux->primary, rc );
+	httpmux_done ( httpmux );
+}
+
+/**
+ * Receive data from range download
+ *
+ * @v range		HTTP multiplexed range download
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int httpmux_range_deliver ( struct http_multiplexed_range *range,
+				   struct io_buffer *iobuf,
+				   struct xfer_metadata *meta ) {
+	struct http_multiplexer *httpmux = range->httpmux;
+	struct xfer_metadata abs_meta;
+	size_t len = iob_len ( iobuf );
+	size_t pos;
+
+	/* Ignore presizing seeks, which are relative to the range */
+	if ( ! len ) {
+		free_iob ( iobuf );
+		return 0;
+	}
+
+	/* Calculate absolute position */
+	pos = range->pos;
+	if ( meta->flags & XFER_FL_ABS_OFFSET )
+		pos = range->start;
+	pos += meta->offset;
+	if ( ( pos + len ) > range->end ) {
+		DBGC ( httpmux, "HTTPMUX %p range %#zx-%#zx overrun at "
+		       "%#zx+%#zx\n", httpmux, range->start, range->end,
+		       pos, len );
+		free_iob ( iobuf );
+		return -ERANGE;
+	}
+	range->pos = ( pos + len );
+
+	/* Deliver to data transfer interface using absolute position.
+	 * We can't use a simple passthrough interface descriptor,
+	 * since there are multiple range download interfaces.
+	 */
+	memcpy ( &abs_meta, meta, sizeof ( abs_meta ) );
+	abs_meta.flags |= XFER_FL_ABS_OFFSET;
+	abs_meta.offset = pos;
+	return xfer_deliver ( &httpmux->xfer, iob_disown ( iobuf ), &abs_meta );
+}
+
+/**
+ * Check range download flow control window
+ *
+ * @v range		HTTP multiplexed range download
+ * @ret len		Length of window
+ */
+static size_t httpmux_range_window ( struct http_multiplexed_range *range ) {
+	struct http_multiplexer *httpmux = range->httpmux;
+
+	return xfer_window ( &httpmux->xfer );
+}
+
+/**
+ * Get range download underlying data transfer buffer
+ *
+ * @v range		HTTP multiplexed range download
+ * @ret xferbuf		Data transfer buffer, or NULL on error
+ */
+static struct xfer_buffer *
+httpmux_range_buffer ( struct http_multiplexed_range *range ) {
+	struct http_multiplexer *httpmux = range->httpmux;
+
+	return xfer_buffer ( &httpmux->xfer );
+}
+
+/**
+ * Close range download
+ *
+ * @v range		HTTP multiplexed range download
+ * @v rc		Reason for close
+ */
+static void httpmux_range_close ( struct http_multiplexed_range *range,
+				  int rc ) {
+	struct http_multiplexer *httpmux = range->httpmux;
+
+	/* Restart data transfer interface */
+	intf_restart ( &range->xfer, rc );
+
+	/* Handle errors */
+	if ( rc != 0 ) {
+
+		/* Fall back to using only the primary download, if
+		 * it has not yet been truncated.
+		 */
+		if ( httpmux->limit ) {
+			httpmux_abandon ( httpmux, rc );
+			return;
+		}
+
+		/* Otherwise, terminate the whole multiplexer */
+		DBGC ( httpmux, "HTTPMUX %p range %#zx-%#zx failed: %s\n",
+		       httpmux, range->start, range->end, strerror ( rc ) );
+		httpmux_close ( httpmux, rc );
+		return;
+	}
+
+	/* Check that range is complete */
+	if ( range->pos != range->end ) {
+		DBGC ( httpmux, "HTTPMUX %p range %#zx-%#zx incomplete at "
+		       "%#zx\n", httpmux, range->start, range->end,
+		       range->pos );
+		httpmux_close ( httpmux, -EIO );
+		return;
+	}
+
+	/* Record completion */
+	httpmux_done ( httpmux );
+}
+
+/** Data transfer interface operations */
+static struct interface_operation httpmux_xfer_operations[] = {
+	INTF_OP ( intf_close, struct http_multiplexer *, httpmux_close ),
+};
+
+/** Data transfer interface descriptor */
+static struct interface_descriptor httpmux_xfer_desc =
+	INTF_DESC_PASSTHRU ( struct http_multiplexer, xfer,
+			     httpmux_xfer_operations, primary );
+
+/** Primary download interface operations */
+static struct interface_operation httpmux_primary_operations[] = {
+	INTF_OP ( xfer_deliver, struct http_multiplexer *,
+		  httpmux_primary_deliver ),
+	INTF_OP ( intf_close, struct http_multiplexer *,
+		  httpmux_primary_close ),
+};
+
+/** Primary download interface descriptor */
+static struct interface_descriptor httpmux_primary_desc =
+	INTF_DESC_PASSTHRU ( struct http_multiplexer, primary,
+			     httpmux_primary_operations, xfer );
+
+/** Range download interface operations */
+static struct interface_operation httpmux_range_operations[] = {
+	INTF_OP ( xfer_deliver, struct http_multiplexed_range *,
+		  httpmux_range_deliver ),
+	INTF_OP ( xfer_window, struct http_multiplexed_range *,
+		  httpmux_range_window ),
+	INTF_OP ( xfer_buffer, struct http_multiplexed_range *,
+		  httpmux_range_buffer ),
+	INTF_OP ( intf_close, struct http_multiplexed_range *,
+		  httpmux_range_close ),
+};
+
+/** Range download interface descriptor */
+static struct interface_descriptor httpmux_range_desc =
+	INTF_DESC ( struct http_multiplexed_range, xfer,
+		    httpmux_range_operations );
+
+/**
+ * Open parallel HTTP download
+ *
+ * @v xfer		Data transfer interface
+ * @v uri		Request URI
+ * @ret rc		Return status code
+ *
+ * Returns -ENOTSUP if parallel downloads are not enabled, in which
+ * case the caller should fall back to an ordinary download.
+ */
+int httpmux_open ( struct interface *xfer, struct uri *uri ) {
+	struct http_multiplexer *httpmux;
+	struct http_multiplexed_range *range;
+	unsigned long count;
+	unsigned int i;
+	int rc;
+
+	/* Use "http-parallel" setting, if specified */
+	if ( ( fetch_uint_setting ( NULL, &http_parallel_setting,
+				    &count ) < 0 ) || ( count < 2 ) )
+		return -ENOTSUP;
+	if ( count > HTTPMUX_MAX_CONNECTIONS )
+		count = HTTPMUX_MAX_CONNECTIONS;
+
+	/* Allocate and initialise structure */
+	httpmux = zalloc ( sizeof ( *httpmux ) );
+	if ( ! httpmux ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	ref_init ( &httpmux->refcnt, httpmux_free );
+	intf_init ( &httpmux->xfer, &httpmux_xfer_desc, &httpmux->refcnt );
+	intf_init ( &httpmux->primary, &httpmux_primary_desc,
+		    &httpmux->refcnt );
+	httpmux->uri = uri_get ( uri );
+	httpmux->count = count;
+	httpmux->busy = 1;
+	for ( i = 0 ; i < ( HTTPMUX_MAX_CONNECTIONS - 1 ) ; i++ ) {
+		range = &httpmux->range[i];
+		range->httpmux = httpmux;
+		intf_init ( &range->xfer, &httpmux_range_desc,
+			    &httpmux->refcnt );
+	}
+
+	/* Open primary download */
+	if ( ( rc = http_open ( &httpmux->primary, &http_get, uri, NULL,
+				NULL, NULL ) ) != 0 )
+		goto err_open;
+
+	/* Attach to parent interface, mortalise self, and return */
+	intf_plug_plug ( &httpmux->xfer, xfer );
+	ref_put ( &httpmux->refcnt );
+	return 0;
+
+ err_open:
+	httpmux_close ( httpmux, rc );
+	ref_put ( &httpmux->refcnt );
+ err_alloc:
+	return rc;
+}
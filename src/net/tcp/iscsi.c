@@ -45,6 +45,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/features.h>
 #include <ipxe/base16.h>
 #include <ipxe/base64.h>
+#include <ipxe/crc32c.h>
 #include <ipxe/ibft.h>
 #include <ipxe/iscsi.h>
 
@@ -93,6 +94,10 @@ FEATURE ( FEATURE_PROTOCOL, "iSCSI", DHCP_EB_FEATURE_ISCSI, 1 );
 	__einfo_error ( EINFO_EIO_TARGET_NO_RESOURCES )
 #define EINFO_EIO_TARGET_NO_RESOURCES \
 	__einfo_uniqify ( EINFO_EIO, 0x02, "Target out of resources" )
+#define EIO_DIGEST \
+	__einfo_error ( EINFO_EIO_DIGEST )
+#define EINFO_EIO_DIGEST \
+	__einfo_uniqify ( EINFO_EIO, 0x03, "Digest mismatch" )
 #define ENOTSUP_INITIATOR_STATUS \
 	__einfo_error ( EINFO_ENOTSUP_INITIATOR_STATUS )
 #define EINFO_ENOTSUP_INITIATOR_STATUS \
@@ -187,6 +192,37 @@ static int iscsi_rx_buffered_data ( struct iscsi_session *iscsi,
 	return 0;
 }
 
+/**
+ * Get digests in use for new PDUs
+ *
+ * @v iscsi		iSCSI session
+ * @ret digests		Digests in use (as ISCSI_OPT_XXX_DIGEST flags)
+ *
+ * Negotiated digests take effect only once the login phase is
+ * complete, starting with the first PDU after the final login
+ * response.
+ */
+static unsigned int iscsi_digests ( struct iscsi_session *iscsi ) {
+
+	if ( ( iscsi->status & ISCSI_STATUS_PHASE_MASK ) !=
+	     ISCSI_STATUS_FULL_FEATURE_PHASE )
+		return 0;
+	return ( iscsi->options &
+		 ( ISCSI_OPT_HEADER_DIGEST | ISCSI_OPT_DATA_DIGEST ) );
+}
+
+/**
+ * Calculate digest
+ *
+ * @v data		Data
+ * @v len		Length of data
+ * @ret digest		CRC32C digest (in wire byte order)
+ */
+static uint32_t iscsi_digest ( const void *data, size_t len ) {
+
+	return cpu_to_le32 ( ~crc32c_le ( 0xffffffffUL, data, len ) );
+}
+
 /**
  * Free iSCSI session
  *
@@ -274,6 +310,15 @@ static int iscsi_open_connection ( struct iscsi_session *iscsi ) {
 	if ( iscsi->target_username )
 		iscsi->status |= ISCSI_STATUS_AUTH_REVERSE_REQUIRED;
 
+	/* Reset negotiable parameters to their default values */
+	iscsi->target_max_recv_len = ISCSI_DEFAULT_MAX_RECV_LEN;
+	iscsi->max_burst_len = iscsi->local_max_burst_len;
+	iscsi->first_burst_len = ISCSI_DEFAULT_FIRST_BURST_LEN;
+	if ( iscsi->first_burst_len > iscsi->max_burst_len )
+		iscsi->first_burst_len = iscsi->max_burst_len;
+	iscsi->options = 0;
+	iscsi->r2t.len = 0;
+
 	/* Assign new ISID */
 	iscsi->isid_iana_qual = ( random() & 0xffff );
 
@@ -307,6 +352,7 @@ static void iscsi_close_connection ( struct iscsi_session *iscsi, int rc ) {
 	iscsi->tx_state = ISCSI_TX_IDLE;
 	iscsi->rx_state = ISCSI_RX_BHS;
 	iscsi->rx_offset = 0;
+	iscsi->rx_digests = 0;
 
 	/* Free any temporary dynamically allocated memory */
 	chap_finish ( &iscsi->chap );
@@ -355,6 +401,88 @@ static void iscsi_scsi_done ( struct iscsi_session *iscsi, int rc,
  *
  */
 
+/**
+ * Calculate maximum length of a data-out data segment
+ *
+ * @v iscsi		iSCSI session
+ * @ret len		Maximum data segment length
+ */
+static size_t iscsi_data_out_max_len ( struct iscsi_session *iscsi ) {
+	size_t len = iscsi->target_max_recv_len;
+
+	if ( len > ISCSI_MAX_DATA_OUT_LEN )
+		len = ISCSI_MAX_DATA_OUT_LEN;
+	return len;
+}
+
+/**
+ * Calculate length of immediate data for current command
+ *
+ * @v iscsi		iSCSI session
+ * @ret len		Length of immediate data
+ */
+static size_t iscsi_immediate_len ( struct iscsi_session *iscsi ) {
+	size_t len = iscsi->command->data_out_len;
+
+	/* Immediate data may be sent only if negotiated */
+	if ( ! ( iscsi->options & ISCSI_OPT_IMMEDIATE_DATA ) )
+		return 0;
+
+	/* Limit to the first burst and to a single data segment */
+	if ( len > iscsi->first_burst_len )
+		len = iscsi->first_burst_len;
+	if ( len > iscsi_data_out_max_len ( iscsi ) )
+		len = iscsi_data_out_max_len ( iscsi );
+
+	return len;
+}
+
+/**
+ * Calculate length of unsolicited data for current command
+ *
+ * @v iscsi		iSCSI session
+ * @ret len		Length of unsolicited data (including immediate data)
+ */
+static size_t iscsi_unsolicited_len ( struct iscsi_session *iscsi ) {
+	size_t len = iscsi->command->data_out_len;
+
+	/* Unsolicited data may be sent only if negotiated */
+	if ( ! ( iscsi->options & ( ISCSI_OPT_IMMEDIATE_DATA |
+				    ISCSI_OPT_UNSOLICITED_DATA ) ) )
+		return 0;
+
+	/* Limit to the first burst */
+	if ( len > iscsi->first_burst_len )
+		len = iscsi->first_burst_len;
+
+	/* Limit to immediate data if no unsolicited data-out PDUs
+	 * are permitted.
+	 */
+	if ( ! ( iscsi->options & ISCSI_OPT_UNSOLICITED_DATA ) )
+		len = iscsi_immediate_len ( iscsi );
+
+	return len;
+}
+
+/**
+ * Complete iSCSI SCSI command PDU transmission
+ *
+ * @v iscsi		iSCSI session
+ */
+static void iscsi_scsi_command_done ( struct iscsi_session *iscsi ) {
+	struct iscsi_bhs_scsi_command *command = &iscsi->tx_bhs.scsi_command;
+	size_t immediate_len = ISCSI_DATA_LEN ( command->lengths );
+
+	/* Start sending unsolicited data-out PDUs, if applicable */
+	if ( ! ( command->flags & ISCSI_FLAG_FINAL ) ) {
+		iscsi->ttt = ISCSI_TAG_RESERVED;
+		iscsi->transfer_offset = immediate_len;
+		iscsi->transfer_len = ( iscsi_unsolicited_len ( iscsi ) -
+					immediate_len );
+		iscsi_start_data_out ( iscsi, 0 );
+	}
+}
+
 /**
  * Build iSCSI SCSI command BHS
  *
@@ -367,19 +495,21 @@ static void iscsi_scsi_done ( struct iscsi_session *iscsi, int rc,
  */
 static void iscsi_start_command ( struct iscsi_session *iscsi ) {
 	struct iscsi_bhs_scsi_command *command = &iscsi->tx_bhs.scsi_command;
+	size_t immediate_len = iscsi_immediate_len ( iscsi );
 
 	assert ( ! ( iscsi->command->data_in && iscsi->command->data_out ) );
 
 	/* Construct BHS and initiate transmission */
 	iscsi_start_tx ( iscsi );
 	command->opcode = ISCSI_OPCODE_SCSI_COMMAND;
-	command->flags = ( ISCSI_FLAG_FINAL |
-			   ISCSI_COMMAND_ATTR_SIMPLE );
+	command->flags = ISCSI_COMMAND_ATTR_SIMPLE;
+	if ( iscsi_unsolicited_len ( iscsi ) == immediate_len )
+		command->flags |= ISCSI_FLAG_FINAL;
 	if ( iscsi->command->data_in )
 		command->flags |= ISCSI_COMMAND_FLAG_READ;
 	if ( iscsi->command->data_out )
 		command->flags |= ISCSI_COMMAND_FLAG_WRITE;
-	/* lengths left as zero */
+	ISCSI_SET_LENGTHS ( command->lengths, 0, immediate_len );
 	memcpy ( &command->lun, &iscsi->command->lun,
 		 sizeof ( command->lun ) );
 	command->itt = htonl ( iscsi->itt );
@@ -500,6 +630,15 @@ static int iscsi_rx_r2t ( struct iscsi_session *iscsi,
 			  size_t remaining __unused ) {
 	struct iscsi_bhs_r2t *r2t = &iscsi->rx_bhs.r2t;
 
+	/* Defer R2T if we are still sending unsolicited data */
+	if ( iscsi->tx_state != ISCSI_TX_IDLE ) {
+		DBGC2 ( iscsi, "iSCSI %p deferring R2T\n", iscsi );
+		iscsi->r2t.ttt = ntohl ( r2t->ttt );
+		iscsi->r2t.offset = ntohl ( r2t->offset );
+		iscsi->r2t.len = ntohl ( r2t->len );
+		return 0;
+	}
+
 	/* Record transfer parameters and trigger first data-out */
 	iscsi->ttt = ntohl ( r2t->ttt );
 	iscsi->transfer_offset = ntohl ( r2t->offset );
@@ -519,18 +658,19 @@ static int iscsi_rx_r2t ( struct iscsi_session *iscsi,
 static void iscsi_start_data_out ( struct iscsi_session *iscsi,
 				   unsigned int datasn ) {
 	struct iscsi_bhs_data_out *data_out = &iscsi->tx_bhs.data_out;
+	unsigned long max_len = iscsi_data_out_max_len ( iscsi );
 	unsigned long offset;
 	unsigned long remaining;
 	unsigned long len;
 
-	/* We always send 512-byte Data-Out PDUs; this removes the
-	 * need to worry about the target's MaxRecvDataSegmentLength.
+	/* Send Data-Out PDUs of the maximum length permitted by the
+	 * target's MaxRecvDataSegmentLength.
 	 */
-	offset = datasn * 512;
+	offset = datasn * max_len;
 	remaining = iscsi->transfer_len - offset;
 	len = remaining;
-	if ( len > 512 )
-		len = 512;
+	if ( len > max_len )
+		len = max_len;
 
 	/* Construct BHS and initiate transmission */
 	iscsi_start_tx ( iscsi );
@@ -560,42 +700,92 @@ static void iscsi_data_out_done ( struct iscsi_session *iscsi ) {
 	/* If we haven't reached the end of the sequence, start
 	 * sending the next data-out PDU.
 	 */
-	if ( ! ( data_out->flags & ISCSI_FLAG_FINAL ) )
+	if ( ! ( data_out->flags & ISCSI_FLAG_FINAL ) ) {
 		iscsi_start_data_out ( iscsi, ntohl ( data_out->datasn ) + 1 );
+		return;
+	}
+
+	/* Otherwise, start any deferred R2T */
+	if ( iscsi->r2t.len ) {
+		iscsi->ttt = iscsi->r2t.ttt;
+		iscsi->transfer_offset = iscsi->r2t.offset;
+		iscsi->transfer_len = iscsi->r2t.len;
+		iscsi->r2t.len = 0;
+		iscsi_start_data_out ( iscsi, 0 );
+	}
 }
 
 /**
- * Send iSCSI data-out data segment
+ * Send iSCSI write data segment
  *
  * @v iscsi		iSCSI session
+ * @v offset		Offset within data-out buffer
+ * @v lengths		Segment lengths
  * @ret rc		Return status code
  */
-static int iscsi_tx_data_out ( struct iscsi_session *iscsi ) {
-	struct iscsi_bhs_data_out *data_out = &iscsi->tx_bhs.data_out;
+static int iscsi_tx_write_data ( struct iscsi_session *iscsi,
+				 unsigned long offset,
+				 union iscsi_segment_lengths lengths ) {
 	struct io_buffer *iobuf;
-	unsigned long offset;
+	uint32_t *digest;
 	size_t len;
 	size_t pad_len;
 
-	offset = ntohl ( data_out->offset );
-	len = ISCSI_DATA_LEN ( data_out->lengths );
-	pad_len = ISCSI_DATA_PAD_LEN ( data_out->lengths );
+	len = ISCSI_DATA_LEN ( lengths );
+	pad_len = ISCSI_DATA_PAD_LEN ( lengths );
 
 	assert ( iscsi->command != NULL );
 	assert ( iscsi->command->data_out );
 	assert ( ( offset + len ) <= iscsi->command->data_out_len );
 
-	iobuf = xfer_alloc_iob ( &iscsi->socket, ( len + pad_len ) );
+	iobuf = xfer_alloc_iob ( &iscsi->socket, ( len + pad_len +
+						   sizeof ( *digest ) ) );
 	if ( ! iobuf )
 		return -ENOMEM;
-	
+
 	copy_from_user ( iob_put ( iobuf, len ),
 			 iscsi->command->data_out, offset, len );
 	memset ( iob_put ( iobuf, pad_len ), 0, pad_len );
 
+	/* Append data digest, if applicable */
+	if ( len && ( iscsi_digests ( iscsi ) & ISCSI_OPT_DATA_DIGEST ) ) {
+		digest = iob_put ( iobuf, sizeof ( *digest ) );
+		*digest = iscsi_digest ( iobuf->data, ( len + pad_len ) );
+	}
+
 	return xfer_deliver_iob ( &iscsi->socket, iobuf );
 }
 
+/**
+ * Send iSCSI data-out data segment
+ *
+ * @v iscsi		iSCSI session
+ * @ret rc		Return status code
+ */
+static int iscsi_tx_data_out ( struct iscsi_session *iscsi ) {
+	struct iscsi_bhs_data_out *data_out = &iscsi->tx_bhs.data_out;
+
+	return iscsi_tx_write_data ( iscsi, ntohl ( data_out->offset ),
+				     data_out->lengths );
+}
+
+/**
+ * Send iSCSI SCSI command immediate data segment
+ *
+ * @v iscsi		iSCSI session
+ * @ret rc		Return status code
+ */
+static int iscsi_tx_scsi_command ( struct iscsi_session *iscsi ) {
+	struct iscsi_bhs_scsi_command *command = &iscsi->tx_bhs.scsi_command;
+
+	/* Do nothing unless immediate data is present */
+	if ( ! ISCSI_DATA_LEN ( command->lengths ) )
+		return 0;
+
+	return iscsi_tx_write_data ( iscsi, 0, command->lengths );
+}
+
+
 /**
  * Receive data segment of an iSCSI NOP-In
  *
@@ -642,14 +832,14 @@ static int iscsi_rx_nop_in ( struct iscsi_session *iscsi,
  * These are the initial set of strings sent in the first login
  * request PDU.  We want the following settings:
  *
- *     HeaderDigest=None
- *     DataDigest=None
+ *     HeaderDigest=None,CRC32C [5]
+ *     DataDigest=None,CRC32C [5]
  *     MaxConnections is irrelevant; we make only one connection anyway [4]
- *     InitialR2T=Yes [1]
- *     ImmediateData is irrelevant; we never send immediate data [4]
- *     MaxRecvDataSegmentLength=8192 (default; we don't care) [3]
- *     MaxBurstLength=262144 (default; we don't care) [3]
- *     FirstBurstLength=262144 (default; we don't care)
+ *     InitialR2T=No [1]
+ *     ImmediateData=Yes [1]
+ *     MaxRecvDataSegmentLength (from "iscsi-max-recv" setting) [3]
+ *     MaxBurstLength (from "iscsi-max-burst" setting) [3]
+ *     FirstBurstLength (same as MaxBurstLength)
  *     DefaultTime2Wait=0 [2]
  *     DefaultTime2Retain=0 [2]
  *     MaxOutstandingR2T=1
@@ -657,23 +847,27 @@ static int iscsi_rx_nop_in ( struct iscsi_session *iscsi,
  *     DataSequenceInOrder=Yes
  *     ErrorRecoveryLevel=0
  *
- * [1] InitialR2T has an OR resolution function, so the target may
- * force us to use it.  We therefore simplify our logic by always
- * using it.
+ * [1] InitialR2T has an OR resolution function and ImmediateData has
+ * an AND resolution function, so the target may force us to wait
+ * for an R2T before sending any write data.  We send unsolicited
+ * write data only if the target agrees.
  *
  * [2] These ensure that we can safely start a new task once we have
  * reconnected after a failure, without having to manually tidy up
  * after the old one.
  *
- * [3] We are quite happy to use the RFC-defined default values for
- * these parameters, but some targets (notably OpenSolaris)
- * incorrectly assume a default value of zero, so we explicitly
- * specify the default values.
+ * [3] Larger values reduce the number of PDUs (and hence the
+ * per-PDU processing overhead) required for each read.  We always
+ * specify these values explicitly, since some targets (notably
+ * OpenSolaris) incorrectly assume a default value of zero.
  *
  * [4] We are quite happy to use the RFC-defined default values for
  * these parameters, but some targets (notably a QNAP TS-639Pro) fail
  * unless they are supplied, so we explicitly specify the default
  * values.
+ *
+ * [5] We prefer to avoid the per-PDU overhead of digests, but will
+ * use CRC32C digests if the target's policy requires them.
  */
 static int iscsi_build_login_request_strings ( struct iscsi_session *iscsi,
 					       void *data, size_t len ) {
@@ -725,20 +919,23 @@ static int iscsi_build_login_request_strings ( struct iscsi_session *iscsi,
 
 	if ( iscsi->status & ISCSI_STATUS_STRINGS_OPERATIONAL ) {
 		used += ssnprintf ( data + used, len - used,
-				    "HeaderDigest=None%c"
-				    "DataDigest=None%c"
+				    "HeaderDigest=None,CRC32C%c"
+				    "DataDigest=None,CRC32C%c"
 				    "MaxConnections=1%c"
-				    "InitialR2T=Yes%c"
-				    "ImmediateData=No%c"
-				    "MaxRecvDataSegmentLength=8192%c"
-				    "MaxBurstLength=262144%c"
+				    "InitialR2T=No%c"
+				    "ImmediateData=Yes%c"
+				    "MaxRecvDataSegmentLength=%zd%c"
+				    "MaxBurstLength=%zd%c"
+				    "FirstBurstLength=%zd%c"
 				    "DefaultTime2Wait=0%c"
 				    "DefaultTime2Retain=0%c"
 				    "MaxOutstandingR2T=1%c"
 				    "DataPDUInOrder=Yes%c"
 				    "DataSequenceInOrder=Yes%c"
 				    "ErrorRecoveryLevel=0%c",
-				    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 );
+				    0, 0, 0, 0, 0, iscsi->max_recv_len, 0,
+				    iscsi->max_burst_len, 0,
+				    iscsi->max_burst_len, 0, 0, 0, 0, 0, 0, 0 );
 	}
 
 	return used;
@@ -1091,6 +1288,170 @@ static int iscsi_handle_chap_r_value ( struct iscsi_session *iscsi,
 	return 0;
 }
 
+/**
+ * Parse iSCSI numeric text value
+ *
+ * @v iscsi		iSCSI session
+ * @v value		Text value
+ * @v len		Length to fill in
+ * @ret rc		Return status code
+ */
+static int iscsi_parse_length ( struct iscsi_session *iscsi,
+				const char *value, size_t *len ) {
+	char *end;
+
+	*len = strtoul ( value, &end, 0 );
+	if ( *end || ( *len < ISCSI_MIN_DATA_LEN ) ||
+	     ( *len > ISCSI_MAX_DATA_LEN ) ) {
+		DBGC ( iscsi, "iSCSI %p invalid length \"%s\"\n",
+		       iscsi, value );
+		return -EPROTO_INVALID_KEY_VALUE_PAIR;
+	}
+
+	return 0;
+}
+
+/**
+ * Handle iSCSI MaxRecvDataSegmentLength text value
+ *
+ * @v iscsi		iSCSI session
+ * @v value		MaxRecvDataSegmentLength value
+ * @ret rc		Return status code
+ */
+static int iscsi_handle_maxrecvdatasegmentlength_value ( struct iscsi_session
+							 *iscsi,
+							 const char *value ) {
+
+	/* This is a declaration of the target's own limit */
+	return iscsi_parse_length ( iscsi, value,
+				    &iscsi->target_max_recv_len );
+}
+
+/**
+ * Handle iSCSI MaxBurstLength text value
+ *
+ * @v iscsi		iSCSI session
+ * @v value		MaxBurstLength value
+ * @ret rc		Return status code
+ */
+static int iscsi_handle_maxburstlength_value ( struct iscsi_session *iscsi,
+					       const char *value ) {
+	size_t len;
+	int rc;
+
+	/* Negotiated value is the minimum of both offers */
+	if ( ( rc = iscsi_parse_length ( iscsi, value, &len ) ) != 0 )
+		return rc;
+	if ( iscsi->max_burst_len > len )
+		iscsi->max_burst_len = len;
+	if ( iscsi->first_burst_len > len )
+		iscsi->first_burst_len = len;
+
+	return 0;
+}
+
+/**
+ * Handle iSCSI FirstBurstLength text value
+ *
+ * @v iscsi		iSCSI session
+ * @v value		FirstBurstLength value
+ * @ret rc		Return status code
+ */
+static int iscsi_handle_firstburstlength_value ( struct iscsi_session *iscsi,
+						 const char *value ) {
+	size_t len;
+	int rc;
+
+	/* Negotiated value is the minimum of both offers */
+	if ( ( rc = iscsi_parse_length ( iscsi, value, &len ) ) != 0 )
+		return rc;
+	iscsi->first_burst_len = iscsi->max_burst_len;
+	if ( iscsi->first_burst_len > len )
+		iscsi->first_burst_len = len;
+
+	return 0;
+}
+
+/**
+ * Handle iSCSI InitialR2T text value
+ *
+ * @v iscsi		iSCSI session
+ * @v value		InitialR2T value
+ * @ret rc		Return status code
+ */
+static int iscsi_handle_initialr2t_value ( struct iscsi_session *iscsi,
+					   const char *value ) {
+
+	/* We offered "No"; the result is "No" only if the target agrees */
+	if ( strcmp ( value, "No" ) == 0 ) {
+		iscsi->options |= ISCSI_OPT_UNSOLICITED_DATA;
+	} else {
+		iscsi->options &= ~ISCSI_OPT_UNSOLICITED_DATA;
+	}
+
+	return 0;
+}
+
+/**
+ * Handle iSCSI ImmediateData text value
+ *
+ * @v iscsi		iSCSI session
+ * @v value		ImmediateData value
+ * @ret rc		Return status code
+ */
+static int iscsi_handle_immediatedata_value ( struct iscsi_session *iscsi,
+					      const char *value ) {
+
+	/* We offered "Yes"; the result is "Yes" only if the target agrees */
+	if ( strcmp ( value, "Yes" ) == 0 ) {
+		iscsi->options |= ISCSI_OPT_IMMEDIATE_DATA;
+	} else {
+		iscsi->options &= ~ISCSI_OPT_IMMEDIATE_DATA;
+	}
+
+	return 0;
+}
+
+/**
+ * Handle iSCSI HeaderDigest text value
+ *
+ * @v iscsi		iSCSI session
+ * @v value		HeaderDigest value
+ * @ret rc		Return status code
+ */
+static int iscsi_handle_headerdigest_value ( struct iscsi_session *iscsi,
+					     const char *value ) {
+
+	/* We offered "None,CRC32C"; the target selects one of these */
+	if ( strcmp ( value, "CRC32C" ) == 0 ) {
+		iscsi->options |= ISCSI_OPT_HEADER_DIGEST;
+	} else {
+		iscsi->options &= ~ISCSI_OPT_HEADER_DIGEST;
+	}
+
+	return 0;
+}
+
+/**
+ * Handle iSCSI DataDigest text value
+ *
+ * @v iscsi		iSCSI session
+ * @v value		DataDigest value
+ * @ret rc		Return status code
+ */
+static int iscsi_handle_datadigest_value ( struct iscsi_session *iscsi,
+					   const char *value ) {
+
+	/* We offered "None,CRC32C"; the target selects one of these */
+	if ( strcmp ( value, "CRC32C" ) == 0 ) {
+		iscsi->options |= ISCSI_OPT_DATA_DIGEST;
+	} else {
+		iscsi->options &= ~ISCSI_OPT_DATA_DIGEST;
+	}
+
+	return 0;
+}
+
 /** An iSCSI text string that we want to handle */
 struct iscsi_string_type {
 	/** String key
@@ -1117,6 +1478,14 @@ static struct iscsi_string_type iscsi_string_types[] = {
 	{ "CHAP_C", iscsi_handle_chap_c_value },
 	{ "CHAP_N", iscsi_handle_chap_n_value },
 	{ "CHAP_R", iscsi_handle_chap_r_value },
+	{ "MaxRecvDataSegmentLength",
+	  iscsi_handle_maxrecvdatasegmentlength_value },
+	{ "MaxBurstLength", iscsi_handle_maxburstlength_value },
+	{ "FirstBurstLength", iscsi_handle_firstburstlength_value },
+	{ "InitialR2T", iscsi_handle_initialr2t_value },
+	{ "ImmediateData", iscsi_handle_immediatedata_value },
+	{ "HeaderDigest", iscsi_handle_headerdigest_value },
+	{ "DataDigest", iscsi_handle_datadigest_value },
 	{ NULL, NULL }
 };
 
@@ -1392,8 +1761,25 @@ static int iscsi_tx_nothing ( struct iscsi_session *iscsi __unused ) {
  * @ret rc		Return status code
  */
 static int iscsi_tx_bhs ( struct iscsi_session *iscsi ) {
-	return xfer_deliver_raw ( &iscsi->socket,  &iscsi->tx_bhs,
-				  sizeof ( iscsi->tx_bhs ) );
+	struct io_buffer *iobuf;
+	uint32_t *digest;
+
+	iobuf = xfer_alloc_iob ( &iscsi->socket, ( sizeof ( iscsi->tx_bhs ) +
+						   sizeof ( *digest ) ) );
+	if ( ! iobuf )
+		return -ENOMEM;
+
+	memcpy ( iob_put ( iobuf, sizeof ( iscsi->tx_bhs ) ), &iscsi->tx_bhs,
+		 sizeof ( iscsi->tx_bhs ) );
+
+	/* Append header digest, if applicable */
+	if ( iscsi_digests ( iscsi ) & ISCSI_OPT_HEADER_DIGEST ) {
+		digest = iob_put ( iobuf, sizeof ( *digest ) );
+		*digest = iscsi_digest ( &iscsi->tx_bhs,
+					 sizeof ( iscsi->tx_bhs ) );
+	}
+
+	return xfer_deliver_iob ( &iscsi->socket, iobuf );
 }
 
 /**
@@ -1409,6 +1795,8 @@ static int iscsi_tx_data ( struct iscsi_session *iscsi ) {
 	struct iscsi_bhs_common *common = &iscsi->tx_bhs.common;
 
 	switch ( common->opcode & ISCSI_OPCODE_MASK ) {
+	case ISCSI_OPCODE_SCSI_COMMAND:
+		return iscsi_tx_scsi_command ( iscsi );
 	case ISCSI_OPCODE_DATA_OUT:
 		return iscsi_tx_data_out ( iscsi );
 	case ISCSI_OPCODE_LOGIN_REQUEST:
@@ -1435,6 +1823,9 @@ static void iscsi_tx_done ( struct iscsi_session *iscsi ) {
 	iscsi_tx_pause ( iscsi );
 
 	switch ( common->opcode & ISCSI_OPCODE_MASK ) {
+	case ISCSI_OPCODE_SCSI_COMMAND:
+		iscsi_scsi_command_done ( iscsi );
+		break;
 	case ISCSI_OPCODE_DATA_OUT:
 		iscsi_data_out_done ( iscsi );
 		break;
@@ -1564,6 +1955,47 @@ static int iscsi_rx_discard ( struct iscsi_session *iscsi __unused,
 	return 0;
 }
 
+/**
+ * Receive header or data digest of an iSCSI PDU
+ *
+ * @v iscsi		iSCSI session
+ * @v data		Received data
+ * @v len		Length of received data
+ * @v remaining		Data remaining after this data
+ * @ret rc		Return status code
+ *
+ * This fills in iscsi::rx_digest, and verifies it against the
+ * running CRC once complete.
+ */
+static int iscsi_rx_digest ( struct iscsi_session *iscsi, const void *data,
+			     size_t len, size_t remaining ) {
+	uint32_t expected;
+
+	/* Do nothing if no digest is present */
+	if ( ! iscsi->rx_len )
+		return 0;
+
+	/* Accumulate digest */
+	memcpy ( ( ( ( void * ) &iscsi->rx_digest ) + iscsi->rx_offset ),
+		 data, len );
+	if ( remaining )
+		return 0;
+
+	/* Verify digest */
+	expected = cpu_to_le32 ( ~iscsi->rx_crc );
+	if ( iscsi->rx_digest != expected ) {
+		DBGC ( iscsi, "iSCSI %p %s digest mismatch (got %08x, "
+		       "expected %08x)\n", iscsi,
+		       ( ( iscsi->rx_state == ISCSI_RX_HEADER_DIGEST ) ?
+			 "header" : "data" ),
+		       le32_to_cpu ( iscsi->rx_digest ),
+		       le32_to_cpu ( expected ) );
+		return -EIO_DIGEST;
+	}
+
+	return 0;
+}
+
 /**
  * Receive data segment of an iSCSI PDU
  *
@@ -1605,6 +2037,44 @@ static int iscsi_rx_data ( struct iscsi_session *iscsi, const void *data,
 	}
 }
 
+/**
+ * Receive data digest of an iSCSI PDU
+ *
+ * @v iscsi		iSCSI session
+ * @v data		Received data
+ * @v len		Length of received data
+ * @v remaining		Data remaining after this data
+ * @ret rc		Return status code
+ *
+ * When a data digest is present, the final portion of the data
+ * segment is withheld from iscsi_rx_data() until the digest has been
+ * verified, so that a PDU is never acted upon (e.g. by completing a
+ * SCSI command) on the strength of corrupted data.
+ */
+static int iscsi_rx_data_digest ( struct iscsi_session *iscsi,
+				  const void *data, size_t len,
+				  size_t remaining ) {
+	struct iscsi_bhs_common *common = &iscsi->rx_bhs.common;
+	size_t rx_offset = iscsi->rx_offset;
+	size_t rx_len = iscsi->rx_len;
+	int rc;
+
+	/* Receive and verify digest */
+	if ( ( rc = iscsi_rx_digest ( iscsi, data, len, remaining ) ) != 0 )
+		return rc;
+	if ( remaining || ( ! rx_len ) )
+		return 0;
+
+	/* Complete processing of the (now verified) data segment */
+	iscsi->rx_len = ISCSI_DATA_LEN ( common->lengths );
+	iscsi->rx_offset = iscsi->rx_len;
+	rc = iscsi_rx_data ( iscsi, data, 0, 0 );
+	iscsi->rx_offset = rx_offset;
+	iscsi->rx_len = rx_len;
+
+	return rc;
+}
+
 /**
  * Receive new data
  *
@@ -1619,6 +2089,10 @@ static int iscsi_rx_data ( struct iscsi_session *iscsi, const void *data,
  * portion as it arrives.  The data processing routine therefore
  * always has a full copy of the BHS available, even for portions of
  * the data in different packets to the BHS.
+ *
+ * If digests have been negotiated, a running CRC32C is maintained
+ * over the header and data segments and checked against the
+ * corresponding received digest.
  */
 static int iscsi_socket_deliver ( struct iscsi_session *iscsi,
 				  struct io_buffer *iobuf,
@@ -1637,20 +2111,41 @@ static int iscsi_socket_deliver ( struct iscsi_session *iscsi,
 			rx = iscsi_rx_bhs;
 			iscsi->rx_len = sizeof ( iscsi->rx_bhs );
 			next_state = ISCSI_RX_AHS;			
+			if ( iscsi->rx_offset == 0 ) {
+				iscsi->rx_digests = iscsi_digests ( iscsi );
+				iscsi->rx_crc = 0xffffffffUL;
+			}
 			break;
 		case ISCSI_RX_AHS:
 			rx = iscsi_rx_discard;
 			iscsi->rx_len = 4 * ISCSI_AHS_LEN ( common->lengths );
+			next_state = ISCSI_RX_HEADER_DIGEST;
+			break;
+		case ISCSI_RX_HEADER_DIGEST:
+			rx = iscsi_rx_digest;
+			iscsi->rx_len = ( ( iscsi->rx_digests &
+					    ISCSI_OPT_HEADER_DIGEST ) ?
+					  sizeof ( iscsi->rx_digest ) : 0 );
 			next_state = ISCSI_RX_DATA;
 			break;
 		case ISCSI_RX_DATA:
 			rx = iscsi_rx_data;
 			iscsi->rx_len = ISCSI_DATA_LEN ( common->lengths );
 			next_state = ISCSI_RX_DATA_PADDING;
+			if ( iscsi->rx_offset == 0 )
+				iscsi->rx_crc = 0xffffffffUL;
 			break;
 		case ISCSI_RX_DATA_PADDING:
 			rx = iscsi_rx_discard;
 			iscsi->rx_len = ISCSI_DATA_PAD_LEN ( common->lengths );
+			next_state = ISCSI_RX_DATA_DIGEST;
+			break;
+		case ISCSI_RX_DATA_DIGEST:
+			rx = iscsi_rx_data_digest;
+			iscsi->rx_len = ( ( ( iscsi->rx_digests &
+					      ISCSI_OPT_DATA_DIGEST ) &&
+					    ISCSI_DATA_LEN ( common->lengths ) ) ?
+					  sizeof ( iscsi->rx_digest ) : 0 );
 			next_state = ISCSI_RX_BHS;
 			break;
 		default:
@@ -1663,6 +2158,24 @@ static int iscsi_socket_deliver ( struct iscsi_session *iscsi,
 		if ( frag_len > iob_len ( iobuf ) )
 			frag_len = iob_len ( iobuf );
 		remaining = iscsi->rx_len - iscsi->rx_offset - frag_len;
+
+		/* Defer completion of the data segment until the data
+		 * digest (if any) has been verified.
+		 */
+		if ( ( iscsi->rx_state == ISCSI_RX_DATA ) && iscsi->rx_len &&
+		     ( iscsi->rx_digests & ISCSI_OPT_DATA_DIGEST ) ) {
+			remaining += ( ISCSI_DATA_PAD_LEN ( common->lengths ) +
+				       sizeof ( iscsi->rx_digest ) );
+		}
+
+		/* Update running CRC for header and data segments */
+		if ( iscsi->rx_digests &&
+		     ( iscsi->rx_state != ISCSI_RX_HEADER_DIGEST ) &&
+		     ( iscsi->rx_state != ISCSI_RX_DATA_DIGEST ) ) {
+			iscsi->rx_crc = crc32c_le ( iscsi->rx_crc, iobuf->data,
+						    frag_len );
+		}
+
 		if ( ( rc = rx ( iscsi, iobuf->data, frag_len,
 				 remaining ) ) != 0 ) {
 			DBGC ( iscsi, "iSCSI %p could not process received "
@@ -1874,6 +2387,22 @@ const struct setting initiator_iqn_setting __setting ( SETTING_SANBOOT_EXTRA,
 	.type = &setting_type_string,
 };
 
+/** iSCSI maximum receive data segment length setting */
+const struct setting iscsi_max_recv_setting __setting ( SETTING_SANBOOT_EXTRA,
+							iscsi-max-recv ) = {
+	.name = "iscsi-max-recv",
+	.description = "iSCSI maximum receive data segment length",
+	.type = &setting_type_uint32,
+};
+
+/** iSCSI maximum burst length setting */
+const struct setting iscsi_max_burst_setting __setting ( SETTING_SANBOOT_EXTRA,
+							 iscsi-max-burst ) = {
+	.name = "iscsi-max-burst",
+	.description = "iSCSI maximum burst length",
+	.type = &setting_type_uint32,
+};
+
 /** iSCSI reverse username setting */
 const struct setting reverse_username_setting __setting ( SETTING_AUTH_EXTRA,
 							  reverse-username ) = {
@@ -1942,6 +2471,21 @@ static int iscsi_parse_root_path ( struct iscsi_session *iscsi,
 	return 0;
 }
 
+/**
+ * Clamp iSCSI data segment or burst length to permitted range
+ *
+ * @v len		Length
+ * @ret len		Clamped length
+ */
+static size_t iscsi_clamp_len ( unsigned long len ) {
+
+	if ( len < ISCSI_MIN_DATA_LEN )
+		return ISCSI_MIN_DATA_LEN;
+	if ( len > ISCSI_MAX_DATA_LEN )
+		return ISCSI_MAX_DATA_LEN;
+	return len;
+}
+
 /**
  * Fetch iSCSI settings
  *
@@ -1949,10 +2493,21 @@ static int iscsi_parse_root_path ( struct iscsi_session *iscsi,
  * @ret rc		Return status code
  */
 static int iscsi_fetch_settings ( struct iscsi_session *iscsi ) {
+	unsigned long max_len;
 	char *hostname;
 	union uuid uuid;
 	int len;
 
+	/* Fetch data transfer lengths */
+	if ( fetch_uint_setting ( NULL, &iscsi_max_recv_setting,
+				  &max_len ) < 0 )
+		max_len = ISCSI_MAX_RECV_LEN;
+	iscsi->max_recv_len = iscsi_clamp_len ( max_len );
+	if ( fetch_uint_setting ( NULL, &iscsi_max_burst_setting,
+				  &max_len ) < 0 )
+		max_len = ISCSI_MAX_BURST_LEN;
+	iscsi->local_max_burst_len = iscsi_clamp_len ( max_len );
+
 	/* Fetch relevant settings.  Don't worry about freeing on
 	 * error, since iscsi_free() will take care of that anyway.
 	 */
@@ -45,10 +45,6 @@
  *
  */
 
-/** Set most significant bit to 1. */
-#define SET_LAST_FRAME( x ) ( (x) | 1 << 31 )
-#define GET_FRAME_SIZE( x ) ( (x) & ~( 1 << 31 ) )
-
 #define ONCRPC_CALL     0
 #define ONCRPC_REPLY    1
 
@@ -126,6 +122,19 @@ void oncrpc_init_session ( struct oncrpc_session *session,
 	session->prog_vers  = prog_vers;
 }
 
+/**
+ * Send a ONC RPC call
+ *
+ * @v intf              Interface to send the call on
+ * @v session           ONC RPC session
+ * @v proc_name         Procedure number
+ * @v fields            Procedure arguments
+ * @ret rc              Return status code
+ *
+ * The transaction ID (XID) of the call is left in @c session->rpc_id.
+ * A caller with several calls outstanding on the same session may
+ * use this to match each reply (via @c reply->rpc_id) to its call.
+ */
 int oncrpc_call ( struct interface *intf, struct oncrpc_session *session,
                   uint32_t proc_name, const struct oncrpc_field fields[] ) {
 	int              rc;
@@ -31,9 +31,13 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
 #include <byteswap.h>
 #include <ipxe/xfer.h>
 #include <ipxe/open.h>
+#include <ipxe/retry.h>
+#include <ipxe/timer.h>
 #include <ipxe/tcpip.h>
 #include <ipxe/dhcp.h>
 #include <ipxe/settings.h>
@@ -51,11 +55,166 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 struct console_driver syslogs_console __console_driver;
 
+/** Encrypted syslog transmit queue size
+ *
+ * This is a policy decision.  Messages are dropped (and counted) if
+ * the queue fills while the connection is unable to accept data.
+ */
+#define SYSLOGS_QUEUE_SIZE 4096
+
+/** Encrypted syslog transmit queue flush threshold
+ *
+ * This is a policy decision.
+ */
+#define SYSLOGS_FLUSH_LEN 1024
+
+/** Encrypted syslog transmit queue flush delay
+ *
+ * This is a policy decision.
+ */
+#define SYSLOGS_FLUSH_DELAY ( TICKS_PER_SEC / 4 )
+
 /** The encrypted syslog server */
 static struct sockaddr_tcpip logserver = {
 	.st_port = htons ( SYSLOG_PORT ),
 };
 
+static struct interface syslogs;
+
+/** Encrypted syslog transmit queue */
+static char syslogs_queue[SYSLOGS_QUEUE_SIZE];
+
+/** Length of encrypted syslog transmit queue */
+static size_t syslogs_queued;
+
+/** Number of messages within encrypted syslog transmit queue */
+static unsigned int syslogs_count;
+
+/** Number of dropped encrypted syslog messages */
+static unsigned int syslogs_dropped;
+
+/** Encrypted syslog recursion marker */
+static int syslogs_entered;
+
+/**
+ * Discard encrypted syslog transmit queue
+ *
+ */
+static void syslogs_discard ( void ) {
+
+	syslogs_dropped += syslogs_count;
+	syslogs_queued = 0;
+	syslogs_count = 0;
+}
+
+/**
+ * Flush encrypted syslog transmit queue
+ *
+ * All queued messages are transmitted as a single block (and hence
+ * usually as a single TLS record).  If the connection is currently
+ * unable to accept data, the queue will be flushed when the
+ * transmit window next opens.
+ */
+static void syslogs_flush ( void ) {
+	int entered = syslogs_entered;
+	int rc;
+
+	/* Do nothing if queue is empty or connection is busy */
+	if ( ! ( syslogs_queued && xfer_window ( &syslogs ) ) )
+		return;
+
+	/* Guard against re-entry */
+	syslogs_entered = 1;
+
+	/* Transmit queued messages */
+	if ( ( rc = xfer_deliver_raw ( &syslogs, syslogs_queue,
+				       syslogs_queued ) ) != 0 ) {
+		DBG ( "SYSLOGS could not send %d log messages: %s\n",
+		      syslogs_count, strerror ( rc ) );
+		syslogs_discard();
+	}
+	syslogs_queued = 0;
+	syslogs_count = 0;
+
+	/* Restore re-entry flag */
+	syslogs_entered = entered;
+}
+
+/**
+ * Handle encrypted syslog flush timer expiry
+ *
+ * @v timer		Flush timer
+ * @v over		Failure indicator
+ */
+static void syslogs_expired ( struct retry_timer *timer __unused,
+			      int over __unused ) {
+
+	syslogs_flush();
+}
+
+/** Encrypted syslog flush timer */
+static struct retry_timer syslogs_timer = TIMER_INIT ( syslogs_expired );
+
+/**
+ * Add message to encrypted syslog transmit queue
+ *
+ * @v severity		Severity
+ * @v message		Message
+ * @ret rc		Return status code
+ */
+static int syslogs_enqueue ( unsigned int severity, const char *message ) {
+	size_t remaining = ( sizeof ( syslogs_queue ) - syslogs_queued );
+	size_t len;
+
+	/* Format message into queue */
+	len = syslog_format ( &syslogs_queue[syslogs_queued], remaining,
+			      severity, message, "\n" );
+	if ( len >= remaining )
+		return -ENOBUFS;
+
+	/* Record message */
+	syslogs_queued += len;
+	syslogs_count++;
+	return 0;
+}
+
+/**
+ * Queue encrypted syslog message
+ *
+ * @v severity		Severity
+ * @v message		Message
+ */
+static void syslogs_send ( unsigned int severity, const char *message ) {
+	char note[40];
+
+	/* Report any previously dropped messages */
+	if ( syslogs_dropped ) {
+		snprintf ( note, sizeof ( note ), "%d log messages dropped",
+			   syslogs_dropped );
+		if ( syslogs_enqueue ( LOG_WARNING, note ) == 0 )
+			syslogs_dropped = 0;
+	}
+
+	/* Add message to queue, flushing queue if full */
+	if ( syslogs_enqueue ( severity, message ) != 0 ) {
+		syslogs_flush();
+		if ( syslogs_enqueue ( severity, message ) != 0 ) {
+			syslogs_dropped++;
+			return;
+		}
+	}
+
+	/* Flush immediately if queue is sufficiently full, otherwise
+	 * wait for further messages.
+	 */
+	if ( syslogs_queued >= SYSLOGS_FLUSH_LEN ) {
+		stop_timer ( &syslogs_timer );
+		syslogs_flush();
+	} else if ( ! timer_running ( &syslogs_timer ) ) {
+		start_timer_fixed ( &syslogs_timer, SYSLOGS_FLUSH_DELAY );
+	}
+}
+
 /**
  * Handle encrypted syslog TLS interface close
  *
@@ -65,6 +224,10 @@ static struct sockaddr_tcpip logserver = {
 static void syslogs_close ( struct interface *intf __unused, int rc ) {
 
 	DBG ( "SYSLOGS console disconnected: %s\n", strerror ( rc ) );
+
+	/* Discard any queued messages */
+	stop_timer ( &syslogs_timer );
+	syslogs_discard();
 }
 
 /**
@@ -84,6 +247,12 @@ static void syslogs_window_changed ( struct interface *intf ) {
 			DBG ( "SYSLOGS console connected\n" );
 		syslogs_console.disabled = 0;
 	}
+
+	/* Flush any deferred messages, unless still waiting for
+	 * further messages to arrive.
+	 */
+	if ( ! timer_running ( &syslogs_timer ) )
+		syslogs_flush();
 }
 
 /** Encrypted syslog TLS interface operations */
@@ -145,16 +314,12 @@ static struct line_console syslogs_line = {
 	},
 };
 
-/** Encrypted syslog recursion marker */
-static int syslogs_entered;
-
 /**
  * Print a character to encrypted syslog console
  *
  * @v character		Character to be printed
  */
 static void syslogs_putchar ( int character ) {
-	int rc;
 
 	/* Ignore if we are already mid-logging */
 	if ( syslogs_entered )
@@ -167,12 +332,8 @@ static void syslogs_putchar ( int character ) {
 	/* Guard against re-entry */
 	syslogs_entered = 1;
 
-	/* Send log message */
-	if ( ( rc = syslog_send ( &syslogs, syslogs_severity,
-				  syslogs_buffer, "\n" ) ) != 0 ) {
-		DBG ( "SYSLOGS could not send log message: %s\n",
-		      strerror ( rc ) );
-	}
+	/* Queue log message */
+	syslogs_send ( syslogs_severity, syslogs_buffer );
 
 	/* Clear re-entry flag */
 	syslogs_entered = 0;
@@ -227,6 +388,9 @@ static int apply_syslogs_settings ( void ) {
 	/* Reset encrypted syslog connection */
 	syslogs_console.disabled = CONSOLE_DISABLED;
 	intf_restart ( &syslogs, 0 );
+	stop_timer ( &syslogs_timer );
+	syslogs_discard();
+	syslogs_dropped = 0;
 
 	/* Do nothing unless we have a log server */
 	if ( ! server ) {
@@ -236,7 +400,8 @@ static int apply_syslogs_settings ( void ) {
 	}
 
 	/* Add TLS filter */
-	if ( ( rc = add_tls ( &syslogs, server, &socket ) ) != 0 ) {
+	if ( ( rc = add_tls ( &syslogs, server, ntohs ( logserver.st_port ),
+			      &socket ) ) != 0 ) {
 		DBG ( "SYSLOGS cannot create TLS filter: %s\n",
 		      strerror ( rc ) );
 		goto err_add_tls;
@@ -0,0 +1,253 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * TCP CUBIC congestion control
+ *
+ * This is a simplified implementation of the window growth function
+ * described in RFC 8312, using fixed-point integer arithmetic.  The
+ * TCP-friendly region is not implemented.
+ *
+ * Time is measured in units of 1/1024 seconds, and window sizes in
+ * segments, so that the cubic function
+ *
+ *    W(t) = C * ( t - K )^3 + W_max
+ *
+ * with C = 0.4 evaluates to
+ *
+ *    W(t) = ( ( 410 * ( t - K )^3 ) >> 40 ) + W_max
+ *
+ * and
+ *
+ *    K = cbrt ( W_max * ( 1 - beta ) / C ) = cbrt ( W_max * 3 / 4 )
+ *
+ * evaluates to
+ *
+ *    K = cbrt ( ( W_max * 3 ) << 28 )
+ */
+
+#include <stdint.h>
+#include <ipxe/timer.h>
+#include <ipxe/tcp.h>
+
+/** CUBIC multiplicative decrease factor (scaled by 1024) */
+#define CUBIC_BETA 717
+
+/**
+ * Calculate integer cube root
+ *
+ * @v value		Value
+ * @ret root		Cube root (rounded down)
+ */
+static uint32_t cubic_cbrt ( uint64_t value ) {
+	uint32_t root = 0;
+	uint32_t trial;
+	unsigned int bit;
+
+	/* Calculate root one bit at a time.  The largest possible
+	 * root of a 64-bit value fits within 22 bits.
+	 */
+	for ( bit = 22 ; bit-- ; ) {
+		trial = ( root | ( 1 << bit ) );
+		if ( ( ( uint64_t ) trial * trial * trial ) <= value )
+			root = trial;
+	}
+	return root;
+}
+
+/**
+ * Calculate CUBIC target window
+ *
+ * @v cong		Congestion control state
+ * @v mss		Sender maximum segment size
+ * @ret target		Target congestion window (in bytes)
+ */
+static uint32_t cubic_target ( struct tcp_congestion *cong, size_t mss ) {
+	uint32_t w_max = ( cong->w_max / mss );
+	uint32_t elapsed;
+	uint32_t k;
+	int64_t delta;
+	uint64_t cube;
+	int64_t offset;
+	int64_t target;
+
+	/* Calculate time elapsed since start of epoch (in 1/1024s) */
+	elapsed = ( ( ( currticks() - cong->epoch ) * 1024 ) /
+		    TICKS_PER_SEC );
+
+	/* Calculate time period K (in 1/1024s) */
+	k = cubic_cbrt ( ( ( uint64_t ) ( w_max * 3 ) ) << 28 );
+
+	/* Calculate offset from W_max (in segments), limiting the
+	 * elapsed time to avoid overflow.
+	 */
+	delta = ( ( int64_t ) elapsed - k );
+	if ( delta > ( 64 * 1024 ) )
+		delta = ( 64 * 1024 );
+	if ( delta < -( 64 * 1024 ) )
+		delta = -( 64 * 1024 );
+	cube = ( ( delta < 0 ) ? -delta : delta );
+	cube = ( ( ( ( cube * cube * cube ) >> 20 ) * 410 ) >> 20 );
+	offset = ( ( delta < 0 ) ? -( ( int64_t ) cube ) : ( int64_t ) cube );
+
+	/* Calculate target window (in bytes) */
+	target = ( ( w_max + offset ) * ( int64_t ) mss );
+	if ( target < ( int64_t ) mss )
+		target = mss;
+	if ( target > 0xffffffffLL )
+		target = 0xffffffffLL;
+	return target;
+}
+
+/**
+ * Initialise CUBIC congestion control state
+ *
+ * @v cong		Congestion control state
+ * @v mss		Sender maximum segment size
+ */
+static void cubic_init ( struct tcp_congestion *cong, size_t mss ) {
+
+	cong->cwnd = tcp_initial_cwnd ( mss );
+	cong->ssthresh = ~( ( uint32_t ) 0 );
+	cong->acked = 0;
+	cong->w_max = 0;
+	cong->epoch = 0;
+}
+
+/**
+ * Handle acknowledgement of new data using CUBIC
+ *
+ * @v cong		Congestion control state
+ * @v mss		Sender maximum segment size
+ * @v len		Length of newly acknowledged data
+ */
+static void cubic_acked ( struct tcp_congestion *cong, size_t mss,
+			  size_t len ) {
+	uint32_t target;
+	uint32_t increment;
+	uint32_t delta;
+
+	/* Use standard slow start below the slow start threshold */
+	if ( cong->cwnd < cong->ssthresh ) {
+		cong->cwnd += ( ( len < mss ) ? len : mss );
+		return;
+	}
+
+	/* Start a new epoch if applicable */
+	if ( ! cong->epoch ) {
+		cong->epoch = currticks();
+		if ( cong->w_max < cong->cwnd )
+			cong->w_max = cong->cwnd;
+		cong->acked = 0;
+	}
+
+	/* Increase by ( target - cwnd ) / cwnd segments per segment
+	 * acknowledged, or by a token amount if the target has
+	 * already been reached.
+	 */
+	target = cubic_target ( cong, mss );
+	if ( target > cong->cwnd ) {
+		increment = ( target - cong->cwnd );
+	} else {
+		increment = ( mss / 16 );
+	}
+	delta = ( ( ( uint64_t ) increment * len ) / cong->cwnd );
+
+	/* Never increase by more than half a window per round trip,
+	 * and apply the increase in whole segments.
+	 */
+	if ( delta > ( len / 2 ) )
+		delta = ( len / 2 );
+	cong->acked += delta;
+	while ( cong->acked >= mss ) {
+		cong->cwnd += mss;
+		cong->acked -= mss;
+	}
+}
+
+/**
+ * Reduce window following loss using CUBIC
+ *
+ * @v cong		Congestion control state
+ * @v mss		Sender maximum segment size
+ * @v flight		Amount of data in flight
+ */
+static void cubic_reduce ( struct tcp_congestion *cong, size_t mss,
+			   size_t flight ) {
+
+	/* Record window prior to reduction, with fast convergence */
+	if ( cong->cwnd < cong->w_max ) {
+		cong->w_max = ( ( ( uint64_t ) cong->cwnd *
+				  ( 1024 + CUBIC_BETA ) ) / 2048 );
+	} else {
+		cong->w_max = cong->cwnd;
+	}
+
+	/* Reduce slow start threshold */
+	cong->ssthresh = ( ( ( uint64_t ) flight * CUBIC_BETA ) / 1024 );
+	if ( cong->ssthresh < ( 2 * mss ) )
+		cong->ssthresh = ( 2 * mss );
+	cong->acked = 0;
+	cong->epoch = 0;
+}
+
+/**
+ * Handle retransmission timeout using CUBIC
+ *
+ * @v cong		Congestion control state
+ * @v mss		Sender maximum segment size
+ * @v flight		Amount of data in flight
+ */
+static void cubic_timeout ( struct tcp_congestion *cong, size_t mss,
+			    size_t flight ) {
+
+	/* Reduce slow start threshold and collapse to loss window */
+	cubic_reduce ( cong, mss, flight );
+	cong->cwnd = mss;
+}
+
+/**
+ * Handle loss detected via duplicate acknowledgements using CUBIC
+ *
+ * @v cong		Congestion control state
+ * @v mss		Sender maximum segment size
+ * @v flight		Amount of data in flight
+ */
+static void cubic_loss ( struct tcp_congestion *cong, size_t mss,
+			 size_t flight ) {
+
+	/* Reduce slow start threshold and continue from there */
+	cubic_reduce ( cong, mss, flight );
+	cong->cwnd = cong->ssthresh;
+}
+
+/** CUBIC congestion control algorithm */
+struct tcp_congestion_algorithm tcp_cubic_algorithm
+	__tcp_congestion_algorithm ( TCP_CONGESTION_EXTRA ) = {
+	.name = "cubic",
+	.init = cubic_init,
+	.acked = cubic_acked,
+	.timeout = cubic_timeout,
+	.loss = cubic_loss,
+};
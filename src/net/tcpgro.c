@@ -0,0 +1,377 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * TCP receive segment coalescing
+ *
+ * Consecutive in-order TCP segments belonging to the same connection
+ * are merged within a network device's receive queue before being
+ * handed to the network stack, so that the per-packet cost of the
+ * network, transport and application layers is incurred only once
+ * per coalesced segment.
+ *
+ * Only segments carrying data with no flags other than ACK (and PSH
+ * on the final segment) and with identical TCP options are merged.
+ * Each merged segment's checksum is verified before merging, and the
+ * coalesced segment is marked as having a verified checksum.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include <byteswap.h>
+#include <ipxe/list.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/if_ether.h>
+#include <ipxe/ethernet.h>
+#include <ipxe/in.h>
+#include <ipxe/ip.h>
+#include <ipxe/ipv6.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/tcp.h>
+
+/** A parsed TCP segment */
+struct tcp_gro_segment {
+	/** Network-layer protocol (in network byte order) */
+	uint16_t net_proto;
+	/** Network-layer header */
+	union {
+		/** IPv4 header */
+		struct iphdr *ipv4;
+		/** IPv6 header */
+		struct ipv6_header *ipv6;
+		/** Raw header */
+		void *raw;
+	} net;
+	/** TCP header */
+	struct tcp_header *tcphdr;
+	/** TCP header length (including options) */
+	size_t hlen;
+	/** Data payload */
+	void *payload;
+	/** Length of data payload */
+	size_t len;
+};
+
+/**
+ * Verify TCP checksum
+ *
+ * @v iobuf		I/O buffer
+ * @v seg		Parsed TCP segment
+ * @ret ok		Checksum is correct
+ */
+static int tcp_gro_chksum_ok ( struct io_buffer *iobuf,
+			       struct tcp_gro_segment *seg ) {
+	struct ipv4_pseudo_header pshdr4;
+	struct ipv6_pseudo_header pshdr6;
+	size_t len = ( seg->hlen + seg->len );
+	uint16_t csum;
+
+	/* Skip verification if already verified */
+	if ( iobuf->flags & IOB_FL_CSUM_VERIFIED )
+		return 1;
+
+	/* Calculate pseudo-header checksum */
+	if ( seg->net_proto == htons ( ETH_P_IP ) ) {
+		memset ( &pshdr4, 0, sizeof ( pshdr4 ) );
+		pshdr4.src = seg->net.ipv4->src;
+		pshdr4.dest = seg->net.ipv4->dest;
+		pshdr4.protocol = IP_TCP;
+		pshdr4.len = htons ( len );
+		csum = tcpip_chksum ( &pshdr4, sizeof ( pshdr4 ) );
+	} else {
+		memset ( &pshdr6, 0, sizeof ( pshdr6 ) );
+		memcpy ( &pshdr6.src, &seg->net.ipv6->src,
+			 sizeof ( pshdr6.src ) );
+		memcpy ( &pshdr6.dest, &seg->net.ipv6->dest,
+			 sizeof ( pshdr6.dest ) );
+		pshdr6.len = htonl ( len );
+		pshdr6.next_header = IP_TCP;
+		csum = tcpip_chksum ( &pshdr6, sizeof ( pshdr6 ) );
+	}
+
+	/* Verify checksum */
+	csum = tcpip_continue_chksum ( csum, seg->tcphdr, len );
+	if ( csum != 0 )
+		return 0;
+
+	/* Record verification */
+	iobuf->flags |= IOB_FL_CSUM_VERIFIED;
+	return 1;
+}
+
+/**
+ * Parse TCP segment
+ *
+ * @v iobuf		I/O buffer
+ * @v seg		Parsed TCP segment to fill in
+ * @ret ok		Segment is a candidate for coalescing
+ */
+static int tcp_gro_parse ( struct io_buffer *iobuf,
+			   struct tcp_gro_segment *seg ) {
+	struct ethhdr *ethhdr = iobuf->data;
+	struct iphdr *iphdr;
+	struct ipv6_header *ip6hdr;
+	size_t remaining = iob_len ( iobuf );
+	size_t len;
+
+	/* Parse link-layer header */
+	if ( remaining < sizeof ( *ethhdr ) )
+		return 0;
+	seg->net_proto = ethhdr->h_protocol;
+	seg->net.raw = ( ethhdr + 1 );
+	remaining -= sizeof ( *ethhdr );
+
+	/* Parse network-layer header */
+	if ( seg->net_proto == htons ( ETH_P_IP ) ) {
+		iphdr = seg->net.ipv4;
+		if ( remaining < sizeof ( *iphdr ) )
+			return 0;
+		if ( iphdr->verhdrlen != ( IP_VER | ( sizeof ( *iphdr ) / 4 ) ))
+			return 0;
+		if ( iphdr->frags & htons ( IP_MASK_OFFSET |
+					    IP_MASK_MOREFRAGS ) )
+			return 0;
+		if ( iphdr->protocol != IP_TCP )
+			return 0;
+		len = ntohs ( iphdr->len );
+		if ( ( len < sizeof ( *iphdr ) ) || ( len > remaining ) )
+			return 0;
+		if ( tcpip_chksum ( iphdr, sizeof ( *iphdr ) ) != 0 )
+			return 0;
+		seg->tcphdr = ( ( ( void * ) iphdr ) + sizeof ( *iphdr ) );
+		remaining = ( len - sizeof ( *iphdr ) );
+	} else if ( seg->net_proto == htons ( ETH_P_IPV6 ) ) {
+		ip6hdr = seg->net.ipv6;
+		if ( remaining < sizeof ( *ip6hdr ) )
+			return 0;
+		if ( ( ip6hdr->ver_tc_label & htonl ( IPV6_MASK_VER ) ) !=
+		     htonl ( IPV6_VER ) )
+			return 0;
+		if ( ip6hdr->next_header != IP_TCP )
+			return 0;
+		len = ntohs ( ip6hdr->len );
+		if ( len > ( remaining - sizeof ( *ip6hdr ) ) )
+			return 0;
+		seg->tcphdr = ( ( ( void * ) ip6hdr ) + sizeof ( *ip6hdr ) );
+		remaining = len;
+	} else {
+		return 0;
+	}
+
+	/* Parse TCP header */
+	if ( remaining < sizeof ( *seg->tcphdr ) )
+		return 0;
+	seg->hlen = ( ( seg->tcphdr->hlen & TCP_MASK_HLEN ) / 16 ) * 4;
+	if ( ( seg->hlen < sizeof ( *seg->tcphdr ) ) ||
+	     ( seg->hlen > remaining ) )
+		return 0;
+	if ( seg->tcphdr->flags & ~( TCP_ACK | TCP_PSH ) )
+		return 0;
+	if ( ! ( seg->tcphdr->flags & TCP_ACK ) )
+		return 0;
+	seg->payload = ( ( ( void * ) seg->tcphdr ) + seg->hlen );
+	seg->len = ( remaining - seg->hlen );
+	if ( ! seg->len )
+		return 0;
+
+	/* Verify checksum */
+	if ( ! tcp_gro_chksum_ok ( iobuf, seg ) )
+		return 0;
+
+	return 1;
+}
+
+/**
+ * Check if TCP segment may be appended to a preceding segment
+ *
+ * @v head		Preceding segment
+ * @v seg		Following segment
+ * @ret ok		Segment may be appended
+ */
+static int tcp_gro_mergeable ( struct tcp_gro_segment *head,
+			       struct tcp_gro_segment *seg ) {
+	struct tcp_header *head_tcphdr = head->tcphdr;
+	struct tcp_header *seg_tcphdr = seg->tcphdr;
+
+	/* Must be the same connection */
+	if ( seg->net_proto != head->net_proto )
+		return 0;
+	if ( seg->net_proto == htons ( ETH_P_IP ) ) {
+		if ( ( seg->net.ipv4->src.s_addr !=
+		       head->net.ipv4->src.s_addr ) ||
+		     ( seg->net.ipv4->dest.s_addr !=
+		       head->net.ipv4->dest.s_addr ) )
+			return 0;
+	} else {
+		if ( memcmp ( &seg->net.ipv6->src, &head->net.ipv6->src,
+			      ( sizeof ( seg->net.ipv6->src ) +
+				sizeof ( seg->net.ipv6->dest ) ) ) != 0 )
+			return 0;
+	}
+	if ( ( seg_tcphdr->src != head_tcphdr->src ) ||
+	     ( seg_tcphdr->dest != head_tcphdr->dest ) )
+		return 0;
+
+	/* Must follow on directly from the preceding segment */
+	if ( ntohl ( seg_tcphdr->seq ) !=
+	     ( ( uint32_t ) ( ntohl ( head_tcphdr->seq ) + head->len ) ) )
+		return 0;
+
+	/* Must not follow a pushed segment */
+	if ( head_tcphdr->flags & TCP_PSH )
+		return 0;
+
+	/* Must carry the same acknowledgement and options */
+	if ( seg_tcphdr->ack != head_tcphdr->ack )
+		return 0;
+	if ( ( seg->hlen != head->hlen ) ||
+	     ( memcmp ( ( seg_tcphdr + 1 ), ( head_tcphdr + 1 ),
+			( seg->hlen - sizeof ( *seg_tcphdr ) ) ) != 0 ) )
+		return 0;
+
+	/* Must not exceed maximum coalesced length */
+	if ( ( head->len + seg->len ) > TCP_GRO_MAX_LEN )
+		return 0;
+
+	return 1;
+}
+
+/**
+ * Append TCP segment to a preceding segment
+ *
+ * @v head		Preceding segment I/O buffer
+ * @v head_seg		Preceding parsed segment
+ * @v iobuf		Following segment I/O buffer
+ * @v seg		Following parsed segment
+ * @ret head		Coalesced segment I/O buffer, or NULL on error
+ *
+ * On success, the following segment's I/O buffer is removed from the
+ * receive queue and freed, and the preceding segment may have been
+ * reallocated.
+ */
+static struct io_buffer * tcp_gro_merge ( struct io_buffer *head,
+					  struct tcp_gro_segment *head_seg,
+					  struct io_buffer *iobuf,
+					  struct tcp_gro_segment *seg ) {
+	struct io_buffer *new;
+	struct iphdr *iphdr;
+	struct ipv6_header *ip6hdr;
+	size_t net_offset;
+	size_t tcp_offset;
+	size_t offset;
+
+	/* Strip any link-layer padding from preceding segment */
+	offset = ( head_seg->payload - head->data );
+	iob_unput ( head, ( iob_len ( head ) - offset - head_seg->len ) );
+
+	/* Reallocate preceding segment if necessary */
+	if ( iob_tailroom ( head ) < seg->len ) {
+		new = alloc_iob ( offset + TCP_GRO_MAX_LEN );
+		if ( ! new )
+			return NULL;
+		memcpy ( iob_put ( new, iob_len ( head ) ), head->data,
+			 iob_len ( head ) );
+		new->flags = head->flags;
+		net_offset = ( head_seg->net.raw - head->data );
+		tcp_offset = ( ( ( void * ) head_seg->tcphdr ) - head->data );
+		head_seg->net.raw = ( new->data + net_offset );
+		head_seg->tcphdr = ( new->data + tcp_offset );
+		head_seg->payload = ( new->data + offset );
+		list_add ( &new->list, &head->list );
+		list_del ( &head->list );
+		free_iob ( head );
+		head = new;
+	}
+
+	/* Append data */
+	memcpy ( iob_put ( head, seg->len ), seg->payload, seg->len );
+	head_seg->len += seg->len;
+
+	/* Update headers */
+	if ( head_seg->net_proto == htons ( ETH_P_IP ) ) {
+		iphdr = head_seg->net.ipv4;
+		iphdr->len = htons ( ntohs ( iphdr->len ) + seg->len );
+		iphdr->chksum = 0;
+		iphdr->chksum = tcpip_chksum ( iphdr, sizeof ( *iphdr ) );
+	} else {
+		ip6hdr = head_seg->net.ipv6;
+		ip6hdr->len = htons ( ntohs ( ip6hdr->len ) + seg->len );
+	}
+	head_seg->tcphdr->flags |= seg->tcphdr->flags;
+	head_seg->tcphdr->win = seg->tcphdr->win;
+
+	/* Free following segment */
+	list_del ( &iobuf->list );
+	free_iob ( iobuf );
+
+	return head;
+}
+
+/**
+ * Coalesce TCP segments within a network device's receive queue
+ *
+ * @v netdev		Network device
+ */
+void tcp_gro ( struct net_device *netdev ) {
+	struct io_buffer *iobuf;
+	struct io_buffer *tmp;
+	struct io_buffer *head = NULL;
+	struct io_buffer *merged;
+	struct tcp_gro_segment head_seg;
+	struct tcp_gro_segment seg;
+	unsigned int count = 0;
+
+	/* Only Ethernet devices are supported */
+	if ( netdev->ll_protocol != &ethernet_protocol )
+		return;
+
+	/* Coalesce adjacent segments */
+	list_for_each_entry_safe ( iobuf, tmp, &netdev->rx_queue, list ) {
+
+		/* Parse segment, breaking any chain if not a candidate */
+		if ( ! tcp_gro_parse ( iobuf, &seg ) ) {
+			head = NULL;
+			continue;
+		}
+
+		/* Append to preceding segment, if possible */
+		if ( head && tcp_gro_mergeable ( &head_seg, &seg ) &&
+		     ( ( merged = tcp_gro_merge ( head, &head_seg, iobuf,
+						  &seg ) ) != NULL ) ) {
+			head = merged;
+			count++;
+			continue;
+		}
+
+		/* Otherwise, start a new chain */
+		head = iobuf;
+		memcpy ( &head_seg, &seg, sizeof ( head_seg ) );
+	}
+
+	if ( count ) {
+		DBGC2 ( netdev, "NETDEV %s coalesced %d TCP segments\n",
+			netdev->name, count );
+	}
+}
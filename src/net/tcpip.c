@@ -7,6 +7,7 @@
 #include <ipxe/tables.h>
 #include <ipxe/ipstat.h>
 #include <ipxe/netdevice.h>
+#include <ipxe/accelerator.h>
 #include <ipxe/tcpip.h>
 
 /** @file
@@ -105,6 +106,59 @@ int tcpip_tx ( struct io_buffer *iobuf, struct tcpip_protocol *tcpip_protocol,
 	return -EAFNOSUPPORT;
 }
 
+/**
+ * Prepare transport-layer checksum for transmission
+ *
+ * @v iobuf		I/O buffer
+ * @v netdev		Transmitting network device
+ * @v trans		Start of transport-layer data
+ * @v trans_csum	Transport-layer checksum field
+ * @ret offload		Checksum is to be calculated by the network device,
+ *			or negative error
+ *
+ * If the transport layer has left its checksum pending, then either
+ * calculate the checksum over the transport-layer data or arrange for
+ * the network device to do so.  The network layer must then add in
+ * its pseudo-header checksum as usual.  If the checksum is to be
+ * calculated by the network device, then the network layer must
+ * finally invert the checksum field (so that it holds the
+ * non-inverted pseudo-header checksum expected by the hardware).
+ *
+ * An I/O buffer requiring TCP segmentation offload will be rejected
+ * unless the network device is able to perform the segmentation.
+ */
+int tcpip_tx_chksum ( struct io_buffer *iobuf, struct net_device *netdev,
+		      void *trans, uint16_t *trans_csum ) {
+
+	/* Do nothing unless checksum is pending */
+	if ( ! ( iobuf->flags & IOB_FL_CSUM_PENDING ) )
+		return 0;
+	iobuf->flags &= ~IOB_FL_CSUM_PENDING;
+
+	/* Refuse segmentation offload if not supported */
+	if ( ( ( iobuf->flags & IOB_FL_TSO4 ) &&
+	       ! ( netdev->state & NETDEV_TX_TSO4 ) ) ||
+	     ( ( iobuf->flags & IOB_FL_TSO6 ) &&
+	       ! ( netdev->state & NETDEV_TX_TSO6 ) ) ) {
+		DBGC ( netdev, "TCPIP %s cannot segment %zd-byte packet\n",
+		       netdev->name, iob_len ( iobuf ) );
+		return -ENOTSUP;
+	}
+
+	/* Use hardware checksum offload, if available */
+	if ( netdev->state & NETDEV_TX_CSUM ) {
+		iobuf->flags |= IOB_FL_CSUM_OFFLOAD;
+		iobuf->csum_start = ( trans - iobuf->head );
+		iobuf->csum_offset = ( ( ( void * ) trans_csum ) - trans );
+		*trans_csum = TCPIP_EMPTY_CSUM;
+		return 1;
+	}
+
+	/* Otherwise, calculate checksum in software */
+	*trans_csum = tcpip_chksum ( trans, ( iobuf->tail - trans ) );
+	return 0;
+}
+
 /**
  * Determine transmitting network device
  *
@@ -149,6 +203,68 @@ size_t tcpip_mtu ( struct sockaddr_tcpip *st_dest ) {
 	return mtu;
 }
 
+/**
+ * Determine transmit headroom
+ *
+ * @v st_dest		Destination address
+ * @ret headroom	Headroom required for network- and link-layer headers
+ *
+ * The headroom is calculated for the network device via which the
+ * destination is currently routed, including any headroom required
+ * by the device itself.  The headroom is never less than
+ * MAX_LL_NET_HEADER_LEN, so that buffers allocated using this value
+ * remain usable even if the route subsequently changes.
+ */
+size_t tcpip_headroom ( struct sockaddr_tcpip *st_dest ) {
+	struct tcpip_net_protocol *tcpip_net;
+	struct net_device *netdev;
+	size_t headroom;
+
+	/* Find appropriate network-layer protocol */
+	tcpip_net = tcpip_net_protocol ( st_dest->st_family );
+	if ( ! tcpip_net )
+		return MAX_LL_NET_HEADER_LEN;
+
+	/* Find transmitting network device */
+	netdev = tcpip_net->netdev ( st_dest );
+	if ( ! netdev )
+		return MAX_LL_NET_HEADER_LEN;
+
+	/* Calculate headroom */
+	headroom = ( tcpip_net->header_len +
+		     netdev->ll_protocol->ll_header_len +
+		     netdev->tx_headroom );
+	if ( headroom < MAX_LL_NET_HEADER_LEN )
+		headroom = MAX_LL_NET_HEADER_LEN;
+
+	return headroom;
+}
+
+/**
+ * Handle path MTU notification
+ *
+ * @v tcpip_proto	Transport-layer protocol number
+ * @v st_dest		Destination address of original packet
+ * @v data		Transport-layer header of original packet
+ * @v len		Length of transport-layer header (may be truncated)
+ * @v mtu		Path MTU (excluding network-layer header)
+ *
+ * This is called by the network layer (via ICMP) to report that a
+ * transmitted packet was too large for the path to its destination.
+ */
+void tcpip_pmtu ( uint8_t tcpip_proto, struct sockaddr_tcpip *st_dest,
+		  const void *data, size_t len, size_t mtu ) {
+	struct tcpip_protocol *tcpip;
+
+	/* Hand off to the appropriate transport-layer protocol */
+	for_each_table_entry ( tcpip, TCPIP_PROTOCOLS ) {
+		if ( ( tcpip->tcpip_proto == tcpip_proto ) && tcpip->pmtu ) {
+			tcpip->pmtu ( st_dest, data, len, mtu );
+			return;
+		}
+	}
+}
+
 /**
  * Calculate continued TCP/IP checkum
  *
@@ -190,6 +306,15 @@ uint16_t generic_tcpip_continue_chksum ( uint16_t partial,
 	return ( ~cksum );
 }
 
+/**
+ * Find accelerated TCP/IP checksum implementation
+ *
+ * @ret accel		Accelerated implementation, or NULL
+ */
+struct tcpip_chksum_accelerator * tcpip_chksum_accelerator ( void ) {
+	return accelerator_select ( TCPIP_CHKSUM_ACCELERATORS );
+}
+
 /**
  * Calculate TCP/IP checkum
  *
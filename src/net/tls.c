@@ -33,7 +33,9 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <errno.h>
 #include <byteswap.h>
 #include <ipxe/pending.h>
+#include <ipxe/malloc.h>
 #include <ipxe/hmac.h>
+#include <ipxe/hkdf.h>
 #include <ipxe/md5.h>
 #include <ipxe/sha1.h>
 #include <ipxe/sha256.h>
@@ -45,9 +47,14 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #include <ipxe/x509.h>
 #include <ipxe/privkey.h>
 #include <ipxe/certstore.h>
+#include <ipxe/rootcert.h>
 #include <ipxe/rbg.h>
 #include <ipxe/validator.h>
 #include <ipxe/tls.h>
+#include <ipxe/dropstat.h>
+#include <ipxe/timeline.h>
+#include <ipxe/timer.h>
+#include <ipxe/trace.h>
 
 /* Disambiguate the various error causes */
 #define EINVAL_CHANGE_CIPHER __einfo_error ( EINFO_EINVAL_CHANGE_CIPHER )
@@ -102,6 +109,36 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define EINFO_EINVAL_MAC						\
 	__einfo_uniqify ( EINFO_EINVAL, 0x0d,				\
 			  "Invalid MAC" )
+#define EINVAL_AUTH __einfo_error ( EINFO_EINVAL_AUTH )
+#define EINFO_EINVAL_AUTH						\
+	__einfo_uniqify ( EINFO_EINVAL, 0x0e,				\
+			  "Invalid authenticated-encryption record" )
+#define EINVAL_KEY_EXCHANGE __einfo_error ( EINFO_EINVAL_KEY_EXCHANGE )
+#define EINFO_EINVAL_KEY_EXCHANGE					\
+	__einfo_uniqify ( EINFO_EINVAL, 0x0f,				\
+			  "Invalid Server Key Exchange record" )
+#define EINVAL_CERTIFICATE_VERIFY					\
+	__einfo_error ( EINFO_EINVAL_CERTIFICATE_VERIFY )
+#define EINFO_EINVAL_CERTIFICATE_VERIFY					\
+	__einfo_uniqify ( EINFO_EINVAL, 0x10,				\
+			  "Invalid Certificate Verify record" )
+#define EINVAL_TICKET __einfo_error ( EINFO_EINVAL_TICKET )
+#define EINFO_EINVAL_TICKET						\
+	__einfo_uniqify ( EINFO_EINVAL, 0x11,				\
+			  "Invalid New Session Ticket record" )
+#define EINVAL_KEY_UPDATE __einfo_error ( EINFO_EINVAL_KEY_UPDATE )
+#define EINFO_EINVAL_KEY_UPDATE						\
+	__einfo_uniqify ( EINFO_EINVAL, 0x12,				\
+			  "Invalid Key Update record" )
+#define EINVAL_CONTENT_TYPE __einfo_error ( EINFO_EINVAL_CONTENT_TYPE )
+#define EINFO_EINVAL_CONTENT_TYPE					\
+	__einfo_uniqify ( EINFO_EINVAL, 0x13,				\
+			  "Missing record content type" )
+#define EINVAL_CERTIFICATE_STATUS					\
+	__einfo_error ( EINFO_EINVAL_CERTIFICATE_STATUS )
+#define EINFO_EINVAL_CERTIFICATE_STATUS					\
+	__einfo_uniqify ( EINFO_EINVAL, 0x14,				\
+			  "Invalid Certificate Status record" )
 #define EIO_ALERT __einfo_error ( EINFO_EIO_ALERT )
 #define EINFO_EIO_ALERT							\
 	__einfo_uniqify ( EINFO_EINVAL, 0x01,				\
@@ -118,10 +155,6 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define EINFO_ENOMEM_CHAIN						\
 	__einfo_uniqify ( EINFO_ENOMEM, 0x03,				\
 			  "Not enough space for certificate chain" )
-#define ENOMEM_TX_PLAINTEXT __einfo_error ( EINFO_ENOMEM_TX_PLAINTEXT )
-#define EINFO_ENOMEM_TX_PLAINTEXT					\
-	__einfo_uniqify ( EINFO_ENOMEM, 0x04,				\
-			  "Not enough space for transmitted plaintext" )
 #define ENOMEM_TX_CIPHERTEXT __einfo_error ( EINFO_ENOMEM_TX_CIPHERTEXT )
 #define EINFO_ENOMEM_TX_CIPHERTEXT					\
 	__einfo_uniqify ( EINFO_ENOMEM, 0x05,				\
@@ -134,6 +167,15 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define EINFO_ENOMEM_RX_CONCAT						\
 	__einfo_uniqify ( EINFO_ENOMEM, 0x08,				\
 			  "Not enough space to concatenate received data" )
+#define ENOMEM_KEY_EXCHANGE __einfo_error ( EINFO_ENOMEM_KEY_EXCHANGE )
+#define EINFO_ENOMEM_KEY_EXCHANGE					\
+	__einfo_uniqify ( EINFO_ENOMEM, 0x09,				\
+			  "Not enough space for Server Key Exchange record" )
+#define ENOMEM_CERTIFICATE_STATUS					\
+	__einfo_error ( EINFO_ENOMEM_CERTIFICATE_STATUS )
+#define EINFO_ENOMEM_CERTIFICATE_STATUS					\
+	__einfo_uniqify ( EINFO_ENOMEM, 0x0a,				\
+			  "Not enough space for Certificate Status record" )
 #define ENOTSUP_CIPHER __einfo_error ( EINFO_ENOTSUP_CIPHER )
 #define EINFO_ENOTSUP_CIPHER						\
 	__einfo_uniqify ( EINFO_ENOTSUP, 0x01,				\
@@ -150,6 +192,14 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define EINFO_ENOTSUP_VERSION						\
 	__einfo_uniqify ( EINFO_ENOTSUP, 0x04,				\
 			  "Unsupported protocol version" )
+#define ENOTSUP_CURVE __einfo_error ( EINFO_ENOTSUP_CURVE )
+#define EINFO_ENOTSUP_CURVE						\
+	__einfo_uniqify ( EINFO_ENOTSUP, 0x05,				\
+			  "Unsupported elliptic curve" )
+#define ENOTSUP_RETRY __einfo_error ( EINFO_ENOTSUP_RETRY )
+#define EINFO_ENOTSUP_RETRY						\
+	__einfo_uniqify ( EINFO_ENOTSUP, 0x06,				\
+			  "Hello Retry Request not supported" )
 #define EPERM_ALERT __einfo_error ( EINFO_EPERM_ALERT )
 #define EINFO_EPERM_ALERT						\
 	__einfo_uniqify ( EINFO_EPERM, 0x01,				\
@@ -162,15 +212,38 @@ FILE_LICENCE ( GPL2_OR_LATER );
 #define EINFO_EPERM_CLIENT_CERT						\
 	__einfo_uniqify ( EINFO_EPERM, 0x03,				\
 			  "No suitable client certificate available" )
+#define EPERM_KEY_EXCHANGE __einfo_error ( EINFO_EPERM_KEY_EXCHANGE )
+#define EINFO_EPERM_KEY_EXCHANGE					\
+	__einfo_uniqify ( EINFO_EPERM, 0x04,				\
+			  "Server Key Exchange verification failed" )
+#define EPERM_CERTIFICATE_VERIFY					\
+	__einfo_error ( EINFO_EPERM_CERTIFICATE_VERIFY )
+#define EINFO_EPERM_CERTIFICATE_VERIFY					\
+	__einfo_uniqify ( EINFO_EPERM, 0x05,				\
+			  "Certificate Verify verification failed" )
 #define EPROTO_VERSION __einfo_error ( EINFO_EPROTO_VERSION )
 #define EINFO_EPROTO_VERSION						\
 	__einfo_uniqify ( EINFO_EPROTO, 0x01,				\
 			  "Illegal protocol version upgrade" )
+#define EPROTO_RESUME __einfo_error ( EINFO_EPROTO_RESUME )
+#define EINFO_EPROTO_RESUME						\
+	__einfo_uniqify ( EINFO_EPROTO, 0x02,				\
+			  "Illegal change of parameters on session resumption" )
+#define EPROTO_ALPN __einfo_error ( EINFO_EPROTO_ALPN )
+#define EINFO_EPROTO_ALPN						\
+	__einfo_uniqify ( EINFO_EPROTO, 0x03,				\
+			  "Illegal application-layer protocol selection" )
+#define EPROTO_DOWNGRADE __einfo_error ( EINFO_EPROTO_DOWNGRADE )
+#define EINFO_EPROTO_DOWNGRADE						\
+	__einfo_uniqify ( EINFO_EPROTO, 0x04,				\
+			  "Illegal protocol version downgrade" )
 
 static int tls_send_plaintext ( struct tls_session *tls, unsigned int type,
 				const void *data, size_t len );
 static void tls_clear_cipher ( struct tls_session *tls,
 			       struct tls_cipherspec *cipherspec );
+static int tls_new_server_key_exchange ( struct tls_session *tls,
+					 const void *data, size_t len );
 
 /******************************************************************************
  *
@@ -227,6 +300,21 @@ static int tls_ready ( struct tls_session *tls ) {
 		 ( ! is_pending ( &tls->server_negotiation ) ) );
 }
 
+/**
+ * Determine legacy protocol version
+ *
+ * @v tls		TLS session
+ * @ret version		Protocol version for use in legacy version fields
+ *
+ * TLSv1.3 continues to use the TLSv1.2 version number within the
+ * record layer and the Client Hello, and negotiates the real version
+ * via the supported versions extension.
+ */
+static unsigned int tls_legacy_version ( struct tls_session *tls ) {
+	return ( ( tls->version > TLS_VERSION_TLS_1_2 ) ?
+		 TLS_VERSION_TLS_1_2 : tls->version );
+}
+
 /******************************************************************************
  *
  * Hybrid MD5+SHA1 hash as used by TLSv1.1 and earlier
@@ -292,6 +380,283 @@ struct rsa_digestinfo_prefix rsa_md5_sha1_prefix __rsa_digestinfo_prefix = {
 	.len = 0,
 };
 
+/** Records dropped due to failed MAC or authentication tag verification */
+static struct drop_counter tls_mac_drops __drop_counter = {
+	.name = "tls.mac",
+};
+
+/** Records dropped due to invalid padding */
+static struct drop_counter tls_padding_drops __drop_counter = {
+	.name = "tls.padding",
+};
+
+/** Records dropped due to any other processing failure */
+static struct drop_counter tls_record_drops __drop_counter = {
+	.name = "tls.record",
+};
+
+/******************************************************************************
+ *
+ * Session cache
+ *
+ ******************************************************************************
+ */
+
+/** List of cached TLS sessions (most recently used first) */
+static LIST_HEAD ( tls_cached_sessions );
+
+/** Number of cached TLS sessions */
+static unsigned int tls_num_cached_sessions;
+
+/**
+ * Discard cached session
+ *
+ * @v cached		Cached session
+ */
+static void tls_discard_cached ( struct tls_cached_session *cached ) {
+
+	list_del ( &cached->list );
+	tls_num_cached_sessions--;
+	x509_put ( cached->cert );
+	free ( cached->ticket );
+	free ( cached );
+}
+
+/**
+ * Find cached session
+ *
+ * @v tls		TLS session
+ * @ret cached		Cached session, or NULL if not found
+ *
+ * Any cached session for the same server that was established using
+ * a different root of trust or client certificate will be discarded.
+ */
+static struct tls_cached_session *
+tls_find_cached ( struct tls_session *tls ) {
+	struct tls_cached_session *cached;
+	struct tls_cached_session *tmp;
+	int stale;
+
+	list_for_each_entry_safe ( cached, tmp, &tls_cached_sessions, list ) {
+
+		/* Check server name and port */
+		if ( ( strcmp ( cached->name, tls->name ) != 0 ) ||
+		     ( cached->port != tls->port ) )
+			continue;
+
+		/* Check that trust configuration is unchanged.  The
+		 * client certificate needs to be checked only if the
+		 * server requested one when the session was
+		 * established.
+		 */
+		stale = ( ( cached->fingerprints !=
+			    root_certificates.fingerprints ) ||
+			  ( cached->count != root_certificates.count ) );
+		if ( cached->cert && ( ! stale ) )
+			stale = ( certstore_find_key ( &private_key ) !=
+				  cached->cert );
+		if ( stale ) {
+			DBGC ( tls, "TLS %p discarding stale cached session "
+			       "for %s:%d\n", tls, tls->name, tls->port );
+			tls_discard_cached ( cached );
+			continue;
+		}
+
+		return cached;
+	}
+	return NULL;
+}
+
+/**
+ * Prepare to resume cached session, if any
+ *
+ * @v tls		TLS session
+ */
+static void tls_resume_cached ( struct tls_session *tls ) {
+	struct tls_cached_session *cached;
+	unsigned long elapsed;
+
+	/* Find cached session, if any */
+	cached = tls_find_cached ( tls );
+	if ( ! cached )
+		return;
+
+	/* Record session parameters.  These will be used only if the
+	 * server agrees to resume the session.
+	 */
+	if ( cached->ticket ) {
+
+		/* Discard expired TLSv1.3 session tickets */
+		elapsed = ( currticks() - cached->received );
+		if ( ( elapsed / TICKS_PER_SEC ) >= cached->lifetime ) {
+			DBGC ( tls, "TLS %p discarding expired session "
+			       "ticket for %s\n", tls, tls->name );
+			tls_discard_cached ( cached );
+			return;
+		}
+
+		/* Record TLSv1.3 session ticket */
+		tls->ticket = malloc ( cached->ticket_len );
+		if ( ! tls->ticket ) {
+			/* Not a fatal error; session will not be resumed */
+			return;
+		}
+		memcpy ( tls->ticket, cached->ticket, cached->ticket_len );
+		tls->ticket_len = cached->ticket_len;
+		tls->ticket_age = ( ( ( elapsed / TICKS_PER_SEC ) * 1000 ) +
+				    ( ( ( elapsed % TICKS_PER_SEC ) * 1000 ) /
+				      TICKS_PER_SEC ) + cached->age_add );
+		memcpy ( tls->psk, cached->psk, sizeof ( tls->psk ) );
+		DBGC ( tls, "TLS %p attempting to resume session using "
+		       "ticket:\n", tls );
+		DBGC_HDA ( tls, 0, tls->ticket, tls->ticket_len );
+
+	} else {
+
+		/* Record TLSv1.2 session ID */
+		memcpy ( tls->session_id, cached->id, cached->id_len );
+		tls->session_id_len = cached->id_len;
+		tls->resume_version = cached->version;
+		tls->resume_cipher_suite = cached->cipher_suite;
+		memcpy ( tls->master_secret, cached->master_secret,
+			 sizeof ( tls->master_secret ) );
+		DBGC ( tls, "TLS %p attempting to resume session:\n", tls );
+		DBGC_HD ( tls, tls->session_id, tls->session_id_len );
+	}
+
+	/* Mark as most recently used */
+	list_del ( &cached->list );
+	list_add ( &cached->list, &tls_cached_sessions );
+}
+
+/**
+ * Create cache entry
+ *
+ * @v tls		TLS session
+ * @ret cached		Cached session, or NULL on error
+ *
+ * Any existing entry for the same server will be reused, with any
+ * session ticket discarded.
+ */
+static struct tls_cached_session * tls_new_cached ( struct tls_session *tls ) {
+	struct tls_cached_session *cached;
+	size_t name_len;
+
+	/* Reuse any existing entry for this server */
+	cached = tls_find_cached ( tls );
+	if ( cached ) {
+		list_del ( &cached->list );
+		free ( cached->ticket );
+		cached->ticket = NULL;
+		cached->ticket_len = 0;
+	} else {
+		name_len = ( strlen ( tls->name ) + 1 /* NUL */ );
+		cached = zalloc ( sizeof ( *cached ) + name_len );
+		if ( ! cached )
+			return NULL;
+		cached->name = ( ( ( void * ) cached ) + sizeof ( *cached ) );
+		memcpy ( cached->name, tls->name, name_len );
+		cached->port = tls->port;
+		tls_num_cached_sessions++;
+	}
+	list_add ( &cached->list, &tls_cached_sessions );
+
+	/* Record trust configuration.  A resumed session retains the
+	 * client certificate (if any) from the original handshake.
+	 */
+	cached->fingerprints = root_certificates.fingerprints;
+	cached->count = root_certificates.count;
+	if ( tls->cert ) {
+		x509_put ( cached->cert );
+		cached->cert = x509_get ( tls->cert );
+	}
+
+	/* Discard least recently used session, if applicable */
+	if ( tls_num_cached_sessions > TLS_MAX_CACHED_SESSIONS ) {
+		tls_discard_cached ( list_last_entry ( &tls_cached_sessions,
+						       struct tls_cached_session,
+						       list ) );
+	}
+
+	return cached;
+}
+
+/**
+ * Add session to cache
+ *
+ * @v tls		TLS session
+ */
+static void tls_add_cached ( struct tls_session *tls ) {
+	struct tls_cached_session *cached;
+
+	/* Do nothing unless server assigned a session ID */
+	if ( ! tls->session_id_len )
+		return;
+
+	/* Create cache entry */
+	cached = tls_new_cached ( tls );
+	if ( ! cached ) {
+		/* Not a fatal error; session will not be cached */
+		return;
+	}
+
+	/* Record session parameters */
+	cached->version = tls->version;
+	cached->cipher_suite = tls->rx_cipherspec.suite->code;
+	memcpy ( cached->id, tls->session_id, tls->session_id_len );
+	cached->id_len = tls->session_id_len;
+	memcpy ( cached->master_secret, tls->master_secret,
+		 sizeof ( cached->master_secret ) );
+	DBGC ( tls, "TLS %p cached session for %s\n", tls, tls->name );
+}
+
+/**
+ * Remove session from cache
+ *
+ * @v tls		TLS session
+ */
+static void tls_remove_cached ( struct tls_session *tls ) {
+	struct tls_cached_session *cached;
+
+	/* Discard cached session, if any */
+	cached = tls_find_cached ( tls );
+	if ( cached ) {
+		DBGC ( tls, "TLS %p discarding cached session for %s\n",
+		       tls, tls->name );
+		tls_discard_cached ( cached );
+	}
+}
+
+/**
+ * Discard some cached TLS sessions
+ *
+ * @ret discarded	Number of cached items discarded
+ */
+static unsigned int tls_discard ( void ) {
+	struct tls_cached_session *cached;
+
+	/* Drop least recently used session, if any */
+	cached = list_last_entry ( &tls_cached_sessions,
+				   struct tls_cached_session, list );
+	if ( cached ) {
+		tls_discard_cached ( cached );
+		return 1;
+	} else {
+		return 0;
+	}
+}
+
+/**
+ * TLS session cache discarder
+ *
+ * Cached sessions are deemed to have a high replacement cost, since
+ * discarding a session forces the next connection to the same server
+ * to perform a full handshake.
+ */
+struct cache_discarder tls_discarder __cache_discarder ( CACHE_EXPENSIVE ) = {
+	.discard = tls_discard,
+};
+
 /******************************************************************************
  *
  * Cleanup functions
@@ -319,8 +684,11 @@ static void free_tls ( struct refcnt *refcnt ) {
 		list_del ( &iobuf->list );
 		free_iob ( iobuf );
 	}
+	free ( tls->server_key );
+	free ( tls->ticket );
 	x509_put ( tls->cert );
 	x509_chain_put ( tls->chain );
+	free ( tls->ocsp );
 
 	/* Free TLS structure itself */
 	free ( tls );	
@@ -334,6 +702,18 @@ static void free_tls ( struct refcnt *refcnt ) {
  */
 static void tls_close ( struct tls_session *tls, int rc ) {
 
+	/* Record failure, if applicable */
+	if ( rc != 0 )
+		timeline_record ( "tls", "close", tls->name, rc );
+
+	/* Discard any cached session if negotiation failed, to avoid
+	 * repeatedly attempting to resume an unusable session.
+	 */
+	if ( ( rc != 0 ) && ( tls->session_id_len || tls->ticket ) &&
+	     ( ! tls_ready ( tls ) ) ) {
+		tls_remove_cached ( tls );
+	}
+
 	/* Remove pending operations, if applicable */
 	pending_put ( &tls->client_negotiation );
 	pending_put ( &tls->server_negotiation );
@@ -546,21 +926,22 @@ static void tls_prf ( struct tls_session *tls, void *secret, size_t secret_len,
  * Generate master secret
  *
  * @v tls		TLS session
+ * @v pre_master_secret	Pre-master secret
+ * @v pre_master_secret_len Length of pre-master secret
  *
- * The pre-master secret and the client and server random values must
- * already be known.
+ * The client and server random values must already be known.
  */
-static void tls_generate_master_secret ( struct tls_session *tls ) {
+static void tls_generate_master_secret ( struct tls_session *tls,
+					 void *pre_master_secret,
+					 size_t pre_master_secret_len ) {
 	DBGC ( tls, "TLS %p pre-master-secret:\n", tls );
-	DBGC_HD ( tls, &tls->pre_master_secret,
-		  sizeof ( tls->pre_master_secret ) );
+	DBGC_HD ( tls, pre_master_secret, pre_master_secret_len );
 	DBGC ( tls, "TLS %p client random bytes:\n", tls );
 	DBGC_HD ( tls, &tls->client_random, sizeof ( tls->client_random ) );
 	DBGC ( tls, "TLS %p server random bytes:\n", tls );
 	DBGC_HD ( tls, &tls->server_random, sizeof ( tls->server_random ) );
 
-	tls_prf_label ( tls, &tls->pre_master_secret,
-			sizeof ( tls->pre_master_secret ),
+	tls_prf_label ( tls, pre_master_secret, pre_master_secret_len,
 			&tls->master_secret, sizeof ( tls->master_secret ),
 			"master secret",
 			&tls->client_random, sizeof ( tls->client_random ),
@@ -570,6 +951,35 @@ static void tls_generate_master_secret ( struct tls_session *tls ) {
 	DBGC_HD ( tls, &tls->master_secret, sizeof ( tls->master_secret ) );
 }
 
+/**
+ * Precalculate HMAC pad states for record MACs
+ *
+ * @v cipherspec	Cipher specification
+ *
+ * The MAC secret must already be known.  The digest states after
+ * absorbing the inner and outer pads are calculated once here, and
+ * cloned for each record.
+ */
+static void tls_hmac_setkey ( struct tls_cipherspec *cipherspec ) {
+	struct digest_algorithm *digest = cipherspec->suite->digest;
+	size_t key_len = digest->digestsize;
+	uint8_t k_opad[digest->blocksize];
+	unsigned int i;
+
+	/* Calculate inner pad state */
+	hmac_init ( digest, cipherspec->mac_inner_ctx,
+		    cipherspec->mac_secret, &key_len );
+
+	/* Calculate outer pad state */
+	memset ( k_opad, 0, sizeof ( k_opad ) );
+	memcpy ( k_opad, cipherspec->mac_secret, key_len );
+	for ( i = 0 ; i < sizeof ( k_opad ) ; i++ )
+		k_opad[i] ^= 0x5c;
+	digest_init ( digest, cipherspec->mac_outer_ctx );
+	digest_update ( digest, cipherspec->mac_outer_ctx, k_opad,
+			sizeof ( k_opad ) );
+}
+
 /**
  * Generate key material
  *
@@ -582,7 +992,7 @@ static int tls_generate_keys ( struct tls_session *tls ) {
 	struct tls_cipherspec *rx_cipherspec = &tls->rx_cipherspec_pending;
 	size_t hash_size = tx_cipherspec->suite->digest->digestsize;
 	size_t key_size = tx_cipherspec->suite->key_len;
-	size_t iv_size = tx_cipherspec->suite->cipher->blocksize;
+	size_t iv_size = tx_cipherspec->suite->fixed_iv_len;
 	size_t total = ( 2 * ( hash_size + key_size + iv_size ) );
 	uint8_t key_block[total];
 	uint8_t *key;
@@ -599,12 +1009,14 @@ static int tls_generate_keys ( struct tls_session *tls ) {
 
 	/* TX MAC secret */
 	memcpy ( tx_cipherspec->mac_secret, key, hash_size );
+	tls_hmac_setkey ( tx_cipherspec );
 	DBGC ( tls, "TLS %p TX MAC secret:\n", tls );
 	DBGC_HD ( tls, key, hash_size );
 	key += hash_size;
 
 	/* RX MAC secret */
 	memcpy ( rx_cipherspec->mac_secret, key, hash_size );
+	tls_hmac_setkey ( rx_cipherspec );
 	DBGC ( tls, "TLS %p RX MAC secret:\n", tls );
 	DBGC_HD ( tls, key, hash_size );
 	key += hash_size;
@@ -634,15 +1046,21 @@ static int tls_generate_keys ( struct tls_session *tls ) {
 	key += key_size;
 
 	/* TX initialisation vector */
-	cipher_setiv ( tx_cipherspec->suite->cipher,
-		       tx_cipherspec->cipher_ctx, key );
+	memcpy ( tx_cipherspec->fixed_iv, key, iv_size );
+	if ( ! is_auth_cipher ( tx_cipherspec->suite->cipher ) ) {
+		cipher_setiv ( tx_cipherspec->suite->cipher,
+			       tx_cipherspec->cipher_ctx, key );
+	}
 	DBGC ( tls, "TLS %p TX IV:\n", tls );
 	DBGC_HD ( tls, key, iv_size );
 	key += iv_size;
 
 	/* RX initialisation vector */
-	cipher_setiv ( rx_cipherspec->suite->cipher,
-		       rx_cipherspec->cipher_ctx, key );
+	memcpy ( rx_cipherspec->fixed_iv, key, iv_size );
+	if ( ! is_auth_cipher ( rx_cipherspec->suite->cipher ) ) {
+		cipher_setiv ( rx_cipherspec->suite->cipher,
+			       rx_cipherspec->cipher_ctx, key );
+	}
 	DBGC ( tls, "TLS %p RX IV:\n", tls );
 	DBGC_HD ( tls, key, iv_size );
 	key += iv_size;
@@ -661,6 +1079,7 @@ static int tls_generate_keys ( struct tls_session *tls ) {
 
 /** Null cipher suite */
 struct tls_cipher_suite tls_cipher_suite_null = {
+	.exchange = &tls_pubkey_exchange_algorithm,
 	.pubkey = &pubkey_null,
 	.cipher = &cipher_null,
 	.digest = &digest_null,
@@ -726,7 +1145,8 @@ static int tls_set_cipher ( struct tls_session *tls,
 	tls_clear_cipher ( tls, cipherspec );
 	
 	/* Allocate dynamic storage */
-	total = ( pubkey->ctxsize + 2 * cipher->ctxsize + digest->digestsize );
+	total = ( pubkey->ctxsize + 2 * cipher->ctxsize + digest->digestsize +
+		  2 * digest->ctxsize + suite->fixed_iv_len );
 	dynamic = zalloc ( total );
 	if ( ! dynamic ) {
 		DBGC ( tls, "TLS %p could not allocate %zd bytes for crypto "
@@ -740,6 +1160,9 @@ static int tls_set_cipher ( struct tls_session *tls,
 	cipherspec->cipher_ctx = dynamic;	dynamic += cipher->ctxsize;
 	cipherspec->cipher_next_ctx = dynamic;	dynamic += cipher->ctxsize;
 	cipherspec->mac_secret = dynamic;	dynamic += digest->digestsize;
+	cipherspec->mac_inner_ctx = dynamic;	dynamic += digest->ctxsize;
+	cipherspec->mac_outer_ctx = dynamic;	dynamic += digest->ctxsize;
+	cipherspec->fixed_iv = dynamic;		dynamic += suite->fixed_iv_len;
 	assert ( ( cipherspec->dynamic + total ) == dynamic );
 
 	/* Store parameters */
@@ -768,6 +1191,20 @@ static int tls_select_cipher ( struct tls_session *tls,
 		return -ENOTSUP_CIPHER;
 	}
 
+	/* Authenticated encryption is defined only for TLSv1.2 and
+	 * later, and TLSv1.3 cipher suites are usable only with (and
+	 * are the only cipher suites usable with) TLSv1.3.
+	 */
+	if ( ( is_auth_cipher ( suite->cipher ) &&
+	       ( tls->version < TLS_VERSION_TLS_1_2 ) ) ||
+	     ( ( suite->exchange == &tls13_exchange_algorithm ) !=
+	       ( tls->version >= TLS_VERSION_TLS_1_3 ) ) ) {
+		DBGC ( tls, "TLS %p cannot use cipher %04x with protocol "
+		       "version %d.%d\n", tls, ntohs ( cipher_suite ),
+		       ( tls->version >> 8 ), ( tls->version & 0xff ) );
+		return -ENOTSUP_CIPHER;
+	}
+
 	/* Set ciphers */
 	if ( ( rc = tls_set_cipher ( tls, &tls->tx_cipherspec_pending,
 				     suite ) ) != 0 )
@@ -776,9 +1213,9 @@ static int tls_select_cipher ( struct tls_session *tls,
 				     suite ) ) != 0 )
 		return rc;
 
-	DBGC ( tls, "TLS %p selected %s-%s-%d-%s\n", tls, suite->pubkey->name,
-	       suite->cipher->name, ( suite->key_len * 8 ),
-	       suite->digest->name );
+	DBGC ( tls, "TLS %p selected %s-%s-%s-%d-%s\n", tls,
+	       suite->exchange->name, suite->pubkey->name, suite->cipher->name,
+	       ( suite->key_len * 8 ), suite->digest->name );
 
 	return 0;
 }
@@ -808,141 +1245,628 @@ static int tls_change_cipher ( struct tls_session *tls,
 
 /******************************************************************************
  *
- * Signature and hash algorithms
+ * TLSv1.3 key schedule
  *
  ******************************************************************************
  */
 
-/** Number of supported signature and hash algorithms */
-#define TLS_NUM_SIG_HASH_ALGORITHMS \
-	table_num_entries ( TLS_SIG_HASH_ALGORITHMS )
+/**
+ * Expand TLSv1.3 secret using label
+ *
+ * @v tls		TLS session
+ * @v secret		Secret
+ * @v label		Label (excluding the "tls13 " prefix)
+ * @v context		Context
+ * @v context_len	Length of context
+ * @v out		Output buffer
+ * @v out_len		Length of output buffer
+ *
+ * This is HKDF-Expand-Label as defined in RFC 8446 section 7.1.
+ */
+static void tls13_expand_label ( struct tls_session *tls, const void *secret,
+				 const char *label, const void *context,
+				 size_t context_len, void *out,
+				 size_t out_len ) {
+	static const char prefix[] = "tls13 ";
+	size_t label_len = ( sizeof ( prefix ) - 1 /* NUL */ +
+			     strlen ( label ) );
+	struct {
+		uint16_t len;
+		uint8_t label_len;
+		char label[label_len];
+		uint8_t context_len;
+		uint8_t context[context_len];
+	} __attribute__ (( packed )) info;
+
+	/* Construct HkdfLabel */
+	info.len = htons ( out_len );
+	info.label_len = label_len;
+	memcpy ( info.label, prefix, ( sizeof ( prefix ) - 1 /* NUL */ ) );
+	memcpy ( ( info.label + sizeof ( prefix ) - 1 /* NUL */ ), label,
+		 ( label_len - ( sizeof ( prefix ) - 1 /* NUL */ ) ) );
+	info.context_len = context_len;
+	memcpy ( info.context, context, context_len );
+
+	/* Expand secret */
+	hkdf_expand ( tls->handshake_digest, secret, TLS13_SECRET_LEN,
+		      &info, sizeof ( info ), out, out_len );
+}
 
 /**
- * Find TLS signature and hash algorithm
+ * Derive TLSv1.3 secret
  *
- * @v pubkey		Public-key algorithm
- * @v digest		Digest algorithm
- * @ret sig_hash	Signature and hash algorithm, or NULL
+ * @v tls		TLS session
+ * @v secret		Secret
+ * @v label		Label
+ * @v hash		Transcript hash, or NULL to use the empty hash
+ * @v out		Derived secret to fill in
+ *
+ * This is Derive-Secret as defined in RFC 8446 section 7.1, with the
+ * transcript hash calculated by the caller.
  */
-static struct tls_signature_hash_algorithm *
-tls_signature_hash_algorithm ( struct pubkey_algorithm *pubkey,
-			       struct digest_algorithm *digest ) {
-	struct tls_signature_hash_algorithm *sig_hash;
+static void tls13_derive_secret ( struct tls_session *tls, const void *secret,
+				  const char *label, const void *hash,
+				  void *out ) {
+	struct digest_algorithm *digest = tls->handshake_digest;
+	uint8_t ctx[digest->ctxsize];
+	uint8_t empty[digest->digestsize];
 
-	/* Identify signature and hash algorithm */
-	for_each_table_entry ( sig_hash, TLS_SIG_HASH_ALGORITHMS ) {
-		if ( ( sig_hash->pubkey == pubkey ) &&
-		     ( sig_hash->digest == digest ) ) {
-			return sig_hash;
-		}
+	/* Calculate empty hash, if applicable */
+	if ( ! hash ) {
+		digest_init ( digest, ctx );
+		digest_final ( digest, ctx, empty );
+		hash = empty;
 	}
 
-	return NULL;
+	/* Derive secret */
+	tls13_expand_label ( tls, secret, label, hash, digest->digestsize,
+			     out, TLS13_SECRET_LEN );
 }
 
-/******************************************************************************
- *
- * Handshake verification
+/**
+ * Generate TLSv1.3 early secret
  *
- ******************************************************************************
+ * @v tls		TLS session
+ * @v psk		Pre-shared key, or NULL
+ * @v out		Early secret to fill in
  */
+static void tls13_generate_early_secret ( struct tls_session *tls,
+					  const void *psk, void *out ) {
+	static const uint8_t zero[TLS13_SECRET_LEN];
+
+	/* Extract early secret */
+	hkdf_extract ( tls->handshake_digest, zero, sizeof ( zero ),
+		       ( psk ? psk : zero ), TLS13_SECRET_LEN, out );
+}
 
 /**
- * Add handshake record to verification hash
+ * Calculate TLSv1.3 Finished verification data
  *
  * @v tls		TLS session
- * @v data		Handshake record
- * @v len		Length of handshake record
+ * @v secret		Base key
+ * @v hash		Transcript hash
+ * @v out		Verification data to fill in
  */
-static void tls_add_handshake ( struct tls_session *tls,
-				const void *data, size_t len ) {
+static void tls13_verify_data ( struct tls_session *tls, const void *secret,
+				const void *hash, void *out ) {
+	struct digest_algorithm *digest = tls->handshake_digest;
+	uint8_t ctx[digest->ctxsize];
+	uint8_t key[TLS13_SECRET_LEN];
+	size_t key_len = sizeof ( key );
 
-	digest_update ( &md5_sha1_algorithm, tls->handshake_md5_sha1_ctx,
-			data, len );
-	digest_update ( &sha256_algorithm, tls->handshake_sha256_ctx,
-			data, len );
+	/* Calculate finished key */
+	tls13_expand_label ( tls, secret, "finished", NULL, 0,
+			     key, sizeof ( key ) );
+
+	/* Calculate verification data */
+	hmac_init ( digest, ctx, key, &key_len );
+	hmac_update ( digest, ctx, hash, digest->digestsize );
+	hmac_final ( digest, ctx, key, &key_len, out );
 }
 
 /**
- * Calculate handshake verification hash
+ * Generate TLSv1.3 handshake secret
  *
  * @v tls		TLS session
- * @v out		Output buffer
- *
- * Calculates the MD5+SHA1 or SHA256 digest over all handshake
- * messages seen so far.
+ * @v shared		Shared (EC)DHE secret
+ * @v shared_len	Length of shared secret
  */
-static void tls_verify_handshake ( struct tls_session *tls, void *out ) {
-	struct digest_algorithm *digest = tls->handshake_digest;
-	uint8_t ctx[ digest->ctxsize ];
-
-	memcpy ( ctx, tls->handshake_ctx, sizeof ( ctx ) );
-	digest_final ( digest, ctx, out );
+static void tls13_generate_handshake_secret ( struct tls_session *tls,
+					      const void *shared,
+					      size_t shared_len ) {
+	uint8_t early[TLS13_SECRET_LEN];
+	uint8_t derived[TLS13_SECRET_LEN];
+
+	/* Generate early secret */
+	tls13_generate_early_secret ( tls, ( tls->resumed ? tls->psk : NULL ),
+				      early );
+
+	/* Extract handshake secret */
+	tls13_derive_secret ( tls, early, "derived", NULL, derived );
+	hkdf_extract ( tls->handshake_digest, derived, sizeof ( derived ),
+		       shared, shared_len, tls->secret );
+	DBGC ( tls, "TLS %p generated handshake secret:\n", tls );
+	DBGC_HD ( tls, tls->secret, sizeof ( tls->secret ) );
 }
 
-/******************************************************************************
+/**
+ * Activate TLSv1.3 traffic keys
  *
- * Record handling
+ * @v tls		TLS session
+ * @v pending		Pending cipher specification
+ * @v active		Active cipher specification to replace
+ * @v secret		Traffic secret
+ * @ret rc		Return status code
  *
- ******************************************************************************
+ * The cipher suite is taken from the pending cipher specification if
+ * one has been selected, otherwise from the active cipher
+ * specification.
  */
+static int tls13_change_cipher ( struct tls_session *tls,
+				 struct tls_cipherspec *pending,
+				 struct tls_cipherspec *active,
+				 const void *secret ) {
+	struct tls_cipher_suite *suite =
+		( ( pending->suite != &tls_cipher_suite_null ) ?
+		  pending->suite : active->suite );
+	uint8_t key[suite->key_len];
+	int rc;
+
+	/* Allocate cipher specification */
+	if ( ( rc = tls_set_cipher ( tls, pending, suite ) ) != 0 )
+		return rc;
+
+	/* Set key */
+	tls13_expand_label ( tls, secret, "key", NULL, 0, key, sizeof ( key ) );
+	if ( ( rc = cipher_setkey ( suite->cipher, pending->cipher_ctx,
+				    key, sizeof ( key ) ) ) != 0 ) {
+		DBGC ( tls, "TLS %p could not set key: %s\n",
+		       tls, strerror ( rc ) );
+		return rc;
+	}
+
+	/* Set initialisation vector */
+	tls13_expand_label ( tls, secret, "iv", NULL, 0, pending->fixed_iv,
+			     suite->fixed_iv_len );
+
+	/* Activate cipher specification */
+	return tls_change_cipher ( tls, pending, active );
+}
 
 /**
- * Resume TX state machine
+ * Activate TLSv1.3 transmit traffic keys
  *
  * @v tls		TLS session
+ * @ret rc		Return status code
  */
-static void tls_tx_resume ( struct tls_session *tls ) {
-	process_add ( &tls->process );
+static int tls13_change_tx_cipher ( struct tls_session *tls ) {
+	int rc;
+
+	if ( ( rc = tls13_change_cipher ( tls, &tls->tx_cipherspec_pending,
+					  &tls->tx_cipherspec,
+					  tls->client_secret ) ) != 0 )
+		return rc;
+	tls->tx_seq = 0;
+	return 0;
 }
 
 /**
- * Transmit Handshake record
+ * Activate TLSv1.3 receive traffic keys
  *
  * @v tls		TLS session
- * @v data		Plaintext record
- * @v len		Length of plaintext record
  * @ret rc		Return status code
+ *
+ * Receive keys are changed only while processing a received record.
+ * The sequence number will be incremented once the record has been
+ * processed.
  */
-static int tls_send_handshake ( struct tls_session *tls,
-				void *data, size_t len ) {
-
-	/* Add to handshake digest */
-	tls_add_handshake ( tls, data, len );
+static int tls13_change_rx_cipher ( struct tls_session *tls ) {
+	int rc;
 
-	/* Send record */
-	return tls_send_plaintext ( tls, TLS_TYPE_HANDSHAKE, data, len );
+	if ( ( rc = tls13_change_cipher ( tls, &tls->rx_cipherspec_pending,
+					  &tls->rx_cipherspec,
+					  tls->server_secret ) ) != 0 )
+		return rc;
+	tls->rx_seq = ~( ( uint64_t ) 0 );
+	return 0;
 }
 
 /**
- * Transmit Client Hello record
+ * Update TLSv1.3 traffic secret
  *
  * @v tls		TLS session
- * @ret rc		Return status code
+ * @v secret		Traffic secret to update
  */
-static int tls_send_client_hello ( struct tls_session *tls ) {
-	struct {
-		uint32_t type_length;
-		uint16_t version;
-		uint8_t random[32];
-		uint8_t session_id_len;
-		uint16_t cipher_suite_len;
-		uint16_t cipher_suites[TLS_NUM_CIPHER_SUITES];
-		uint8_t compression_methods_len;
-		uint8_t compression_methods[1];
-		uint16_t extensions_len;
-		struct {
-			uint16_t server_name_type;
-			uint16_t server_name_len;
-			struct {
-				uint16_t len;
-				struct {
-					uint8_t type;
-					uint16_t len;
-					uint8_t name[ strlen ( tls->name ) ];
-				} __attribute__ (( packed )) list[1];
-			} __attribute__ (( packed )) server_name;
-			uint16_t max_fragment_length_type;
+static void tls13_update_secret ( struct tls_session *tls, void *secret ) {
+	uint8_t next[TLS13_SECRET_LEN];
+
+	tls13_expand_label ( tls, secret, "traffic upd", NULL, 0,
+			     next, sizeof ( next ) );
+	memcpy ( secret, next, sizeof ( next ) );
+}
+
+/******************************************************************************
+ *
+ * Signature and hash algorithms
+ *
+ ******************************************************************************
+ */
+
+/** Number of supported signature and hash algorithms */
+#define TLS_NUM_SIG_HASH_ALGORITHMS \
+	table_num_entries ( TLS_SIG_HASH_ALGORITHMS )
+
+/**
+ * Find TLS signature and hash algorithm
+ *
+ * @v pubkey		Public-key algorithm
+ * @v digest		Digest algorithm
+ * @ret sig_hash	Signature and hash algorithm, or NULL
+ */
+static struct tls_signature_hash_algorithm *
+tls_signature_hash_algorithm ( struct pubkey_algorithm *pubkey,
+			       struct digest_algorithm *digest ) {
+	struct tls_signature_hash_algorithm *sig_hash;
+
+	/* Identify signature and hash algorithm */
+	for_each_table_entry ( sig_hash, TLS_SIG_HASH_ALGORITHMS ) {
+		if ( ( sig_hash->pubkey == pubkey ) &&
+		     ( sig_hash->digest == digest ) ) {
+			return sig_hash;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Identify TLS signature and hash algorithm
+ *
+ * @v code		Signature and hash algorithm identifier
+ * @ret sig_hash	Signature and hash algorithm, or NULL
+ */
+static struct tls_signature_hash_algorithm *
+tls_find_signature_hash ( struct tls_signature_hash_id code ) {
+	struct tls_signature_hash_algorithm *sig_hash;
+
+	/* Identify signature and hash algorithm */
+	for_each_table_entry ( sig_hash, TLS_SIG_HASH_ALGORITHMS ) {
+		if ( ( sig_hash->code.signature == code.signature ) &&
+		     ( sig_hash->code.hash == code.hash ) ) {
+			return sig_hash;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Find TLSv1.3 signature algorithm
+ *
+ * @v digest		Digest algorithm
+ * @ret sig_hash	Signature and hash algorithm, or NULL
+ *
+ * TLSv1.3 does not permit PKCS #1 v1.5 signatures within the
+ * handshake.  Of the signature algorithms that we support, only the
+ * RSA-PSS algorithms (which are identified as having an intrinsic
+ * hash algorithm) are therefore usable.
+ */
+static struct tls_signature_hash_algorithm *
+tls13_signature_hash_algorithm ( struct digest_algorithm *digest ) {
+	struct tls_signature_hash_algorithm *sig_hash;
+
+	/* Identify signature algorithm */
+	for_each_table_entry ( sig_hash, TLS_SIG_HASH_ALGORITHMS ) {
+		if ( ( sig_hash->code.hash == TLS_INTRINSIC_ALGORITHM ) &&
+		     ( sig_hash->digest == digest ) ) {
+			return sig_hash;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * Verify signature using server certificate
+ *
+ * @v tls		TLS session
+ * @v pubkey		Public-key algorithm
+ * @v digest		Digest algorithm
+ * @v hash		Digest value
+ * @v signature		Signature
+ * @v signature_len	Length of signature
+ * @ret rc		Return status code
+ *
+ * The specified public-key algorithm may differ from that of the
+ * server certificate (e.g. when an RSA-PSS signature is made using an
+ * RSA key).
+ */
+static int tls_verify_signature ( struct tls_session *tls,
+				  struct pubkey_algorithm *pubkey,
+				  struct digest_algorithm *digest,
+				  const void *hash, const void *signature,
+				  size_t signature_len ) {
+	struct x509_certificate *cert;
+	uint8_t ctx[pubkey->ctxsize];
+	int rc;
+
+	/* Identify server certificate */
+	cert = ( tls->chain ? x509_first ( tls->chain ) : NULL );
+	if ( ! cert ) {
+		DBGC ( tls, "TLS %p has no server certificate\n", tls );
+		rc = -EINVAL_CERTIFICATE;
+		goto err_cert;
+	}
+
+	/* Initialise public-key algorithm */
+	if ( ( rc = pubkey_init ( pubkey, ctx,
+				  cert->subject.public_key.raw.data,
+				  cert->subject.public_key.raw.len ) ) != 0 ) {
+		DBGC ( tls, "TLS %p cannot initialise %s public key: %s\n",
+		       tls, pubkey->name, strerror ( rc ) );
+		goto err_init;
+	}
+
+	/* Verify signature */
+	if ( ( rc = pubkey_verify ( pubkey, ctx, digest, hash, signature,
+				    signature_len ) ) != 0 ) {
+		DBGC ( tls, "TLS %p %s signature verification failed: %s\n",
+		       tls, pubkey->name, strerror ( rc ) );
+		goto err_verify;
+	}
+
+ err_verify:
+	pubkey_final ( pubkey, ctx );
+ err_init:
+ err_cert:
+	return rc;
+}
+
+/******************************************************************************
+ *
+ * Named curves
+ *
+ ******************************************************************************
+ */
+
+/** Number of supported named curves */
+#define TLS_NUM_NAMED_CURVES table_num_entries ( TLS_NAMED_CURVES )
+
+/**
+ * Identify named curve
+ *
+ * @v named_curve	Named curve specification
+ * @ret curve		Named curve, or NULL
+ */
+static struct tls_named_curve *
+tls_find_named_curve ( unsigned int named_curve ) {
+	struct tls_named_curve *curve;
+
+	/* Identify named curve */
+	for_each_table_entry ( curve, TLS_NAMED_CURVES ) {
+		if ( curve->code == named_curve )
+			return curve;
+	}
+
+	return NULL;
+}
+
+/**
+ * Identify named curve for TLSv1.3 key share
+ *
+ * @ret curve		Named curve
+ *
+ * We send a key share only for our most preferred named curve.
+ */
+static __attribute__ (( noinline )) struct tls_named_curve *
+tls13_key_share_curve ( void ) {
+
+	/* Use first (i.e. most preferred) named curve */
+	return table_start ( TLS_NAMED_CURVES );
+}
+
+/**
+ * Determine maximum supported protocol version
+ *
+ * @ret version		Protocol version
+ */
+static unsigned int tls_max_version ( void ) {
+	struct tls_cipher_suite *suite;
+
+	/* TLSv1.3 requires a TLSv1.3 cipher suite, and a named curve
+	 * with which to construct the key share.
+	 */
+	if ( TLS_NUM_NAMED_CURVES ) {
+		for_each_table_entry ( suite, TLS_CIPHER_SUITES ) {
+			if ( suite->exchange == &tls13_exchange_algorithm )
+				return TLS_VERSION_TLS_1_3;
+		}
+	}
+
+	return TLS_VERSION_TLS_1_2;
+}
+
+/******************************************************************************
+ *
+ * Handshake verification
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Add handshake record to verification hash
+ *
+ * @v tls		TLS session
+ * @v data		Handshake record
+ * @v len		Length of handshake record
+ */
+static void tls_add_handshake ( struct tls_session *tls,
+				const void *data, size_t len ) {
+
+	digest_update ( &md5_sha1_algorithm, tls->handshake_md5_sha1_ctx,
+			data, len );
+	digest_update ( &sha256_algorithm, tls->handshake_sha256_ctx,
+			data, len );
+}
+
+/**
+ * Calculate handshake verification hash
+ *
+ * @v tls		TLS session
+ * @v out		Output buffer
+ *
+ * Calculates the MD5+SHA1 or SHA256 digest over all handshake
+ * messages seen so far.
+ */
+static void tls_verify_handshake ( struct tls_session *tls, void *out ) {
+	struct digest_algorithm *digest = tls->handshake_digest;
+	uint8_t ctx[ digest->ctxsize ];
+
+	memcpy ( ctx, tls->handshake_ctx, sizeof ( ctx ) );
+	digest_final ( digest, ctx, out );
+}
+
+/** TLSv1.3 server Certificate Verify context string */
+static const char tls13_server_verify[] = "TLS 1.3, server CertificateVerify";
+
+/** TLSv1.3 client Certificate Verify context string */
+static const char tls13_client_verify[] = "TLS 1.3, client CertificateVerify";
+
+/**
+ * Calculate TLSv1.3 Certificate Verify digest
+ *
+ * @v tls		TLS session
+ * @v digest		Digest algorithm
+ * @v context		Context string
+ * @v out		Output buffer
+ *
+ * The signed content comprises 64 spaces, the context string
+ * (including the terminating NUL), and the transcript hash, as
+ * described in RFC 8446 section 4.4.3.
+ */
+static void tls13_verify_digest ( struct tls_session *tls,
+				  struct digest_algorithm *digest,
+				  const char *context, void *out ) {
+	uint8_t hash[ tls->handshake_digest->digestsize ];
+	uint8_t ctx[ digest->ctxsize ];
+	uint8_t padding[64];
+
+	/* Calculate transcript hash */
+	tls_verify_handshake ( tls, hash );
+
+	/* Calculate digest of signed content */
+	memset ( padding, ' ', sizeof ( padding ) );
+	digest_init ( digest, ctx );
+	digest_update ( digest, ctx, padding, sizeof ( padding ) );
+	digest_update ( digest, ctx, context,
+			( strlen ( context ) + 1 /* NUL */ ) );
+	digest_update ( digest, ctx, hash, sizeof ( hash ) );
+	digest_final ( digest, ctx, out );
+}
+
+/******************************************************************************
+ *
+ * Record handling
+ *
+ ******************************************************************************
+ */
+
+/**
+ * Resume TX state machine
+ *
+ * @v tls		TLS session
+ */
+static void tls_tx_resume ( struct tls_session *tls ) {
+	process_add ( &tls->process );
+}
+
+/**
+ * Transmit Handshake record
+ *
+ * @v tls		TLS session
+ * @v data		Plaintext record
+ * @v len		Length of plaintext record
+ * @ret rc		Return status code
+ */
+static int tls_send_handshake ( struct tls_session *tls,
+				void *data, size_t len ) {
+
+	/* Add to handshake digest */
+	tls_add_handshake ( tls, data, len );
+
+	/* Send record */
+	return tls_send_plaintext ( tls, TLS_TYPE_HANDSHAKE, data, len );
+}
+
+/**
+ * Calculate TLSv1.3 pre-shared key binder
+ *
+ * @v tls		TLS session
+ * @v hello		Partial Client Hello
+ * @v len		Length of partial Client Hello
+ * @v binder		Binder to fill in
+ *
+ * The binder covers the Client Hello up to (but excluding) the list
+ * of binders, as described in RFC 8446 section 4.2.11.2.
+ */
+static void tls13_binder ( struct tls_session *tls, const void *hello,
+			   size_t len, void *binder ) {
+	struct digest_algorithm *digest = tls->handshake_digest;
+	uint8_t ctx[digest->ctxsize];
+	uint8_t hash[digest->digestsize];
+	uint8_t early[TLS13_SECRET_LEN];
+	uint8_t binder_key[TLS13_SECRET_LEN];
+
+	/* Calculate binder key */
+	tls13_generate_early_secret ( tls, tls->psk, early );
+	tls13_derive_secret ( tls, early, "res binder", NULL, binder_key );
+
+	/* Calculate hash of partial Client Hello */
+	digest_init ( digest, ctx );
+	digest_update ( digest, ctx, hello, len );
+	digest_final ( digest, ctx, hash );
+
+	/* Calculate binder */
+	tls13_verify_data ( tls, binder_key, hash, binder );
+}
+
+/**
+ * Transmit Client Hello record
+ *
+ * @v tls		TLS session
+ * @ret rc		Return status code
+ */
+static int tls_send_client_hello ( struct tls_session *tls ) {
+	size_t alpn_len = ( tls->alpn ? strlen ( tls->alpn ) : 0 );
+	int tls13 = ( tls->version >= TLS_VERSION_TLS_1_3 );
+	struct tls_named_curve *share =
+		( tls13 ? tls13_key_share_curve() : NULL );
+	size_t share_len = ( share ? share->curve->keysize : 0 );
+	int use_ticket = ( tls13 && tls->ticket );
+	size_t ticket_len = ( use_ticket ? tls->ticket_len : 0 );
+	struct {
+		uint32_t type_length;
+		uint16_t version;
+		uint8_t random[32];
+		uint8_t session_id_len;
+		uint8_t session_id[tls->session_id_len];
+		uint16_t cipher_suite_len;
+		uint16_t cipher_suites[TLS_NUM_CIPHER_SUITES];
+		uint8_t compression_methods_len;
+		uint8_t compression_methods[1];
+		uint16_t extensions_len;
+		struct {
+			uint16_t server_name_type;
+			uint16_t server_name_len;
+			struct {
+				uint16_t len;
+				struct {
+					uint8_t type;
+					uint16_t len;
+					uint8_t name[ strlen ( tls->name ) ];
+				} __attribute__ (( packed )) list[1];
+			} __attribute__ (( packed )) server_name;
+			uint16_t max_fragment_length_type;
 			uint16_t max_fragment_length_len;
 			struct {
 				uint8_t max;
@@ -954,18 +1878,101 @@ static int tls_send_client_hello ( struct tls_session *tls ) {
 				struct tls_signature_hash_id
 					code[TLS_NUM_SIG_HASH_ALGORITHMS];
 			} __attribute__ (( packed )) signature_algorithms;
+			uint16_t status_request_type;
+			uint16_t status_request_len;
+			struct {
+				uint8_t type;
+				uint16_t responder_id_list_len;
+				uint16_t request_extensions_len;
+			} __attribute__ (( packed )) status_request;
+			struct {
+				uint16_t type;
+				uint16_t len;
+				uint16_t list_len;
+				char list[alpn_len];
+			} __attribute__ (( packed )) alpn[ alpn_len ? 1 : 0 ];
+			struct {
+				uint16_t type;
+				uint16_t len;
+				struct {
+					uint16_t len;
+					uint16_t code[TLS_NUM_NAMED_CURVES];
+				} __attribute__ (( packed )) data;
+			} __attribute__ (( packed )) named_curve
+				[ TLS_NUM_NAMED_CURVES ? 1 : 0 ];
+			struct {
+				uint16_t type;
+				uint16_t len;
+				struct {
+					uint8_t len;
+					uint8_t format[1];
+				} __attribute__ (( packed )) data;
+			} __attribute__ (( packed )) point_formats
+				[ TLS_NUM_NAMED_CURVES ? 1 : 0 ];
+			struct {
+				uint16_t type;
+				uint16_t len;
+				struct {
+					uint8_t len;
+					uint16_t code[4];
+				} __attribute__ (( packed )) data;
+			} __attribute__ (( packed )) supported_versions
+				[ tls13 ? 1 : 0 ];
+			struct {
+				uint16_t type;
+				uint16_t len;
+				struct {
+					uint16_t len;
+					uint16_t group;
+					uint16_t key_len;
+					uint8_t key[share_len];
+				} __attribute__ (( packed )) data;
+			} __attribute__ (( packed )) key_share[ tls13 ? 1 : 0 ];
+			struct {
+				uint16_t type;
+				uint16_t len;
+				struct {
+					uint8_t len;
+					uint8_t mode[1];
+				} __attribute__ (( packed )) data;
+			} __attribute__ (( packed )) psk_modes
+				[ use_ticket ? 1 : 0 ];
+			/* Pre-shared key extension must be last */
+			struct {
+				uint16_t type;
+				uint16_t len;
+				struct {
+					uint16_t identities_len;
+					struct {
+						uint16_t len;
+						uint8_t ticket[ticket_len];
+						uint32_t age;
+					} __attribute__ (( packed )) identity;
+					uint16_t binders_len;
+					struct {
+						uint8_t len;
+						uint8_t binder
+							[TLS13_SECRET_LEN];
+					} __attribute__ (( packed )) binder;
+				} __attribute__ (( packed )) data;
+			} __attribute__ (( packed )) psk[ use_ticket ? 1 : 0 ];
 		} __attribute__ (( packed )) extensions;
 	} __attribute__ (( packed )) hello;
 	struct tls_cipher_suite *suite;
 	struct tls_signature_hash_algorithm *sighash;
+	struct tls_named_curve *curve;
 	unsigned int i;
+	int rc;
 
 	memset ( &hello, 0, sizeof ( hello ) );
 	hello.type_length = ( cpu_to_le32 ( TLS_CLIENT_HELLO ) |
 			      htonl ( sizeof ( hello ) -
 				      sizeof ( hello.type_length ) ) );
-	hello.version = htons ( tls->version );
+	hello.version = htons ( tls_legacy_version ( tls ) );
 	memcpy ( &hello.random, &tls->client_random, sizeof ( hello.random ) );
+	hello.session_id_len = sizeof ( hello.session_id );
+	memcpy ( hello.session_id, tls->session_id,
+		 sizeof ( hello.session_id ) );
 	hello.cipher_suite_len = htons ( sizeof ( hello.cipher_suites ) );
 	i = 0 ; for_each_table_entry ( suite, TLS_CIPHER_SUITES )
 		hello.cipher_suites[i++] = suite->code;
@@ -979,7 +1986,7 @@ static int tls_send_client_hello ( struct tls_session *tls ) {
 	hello.extensions.server_name.list[0].type = TLS_SERVER_NAME_HOST_NAME;
 	hello.extensions.server_name.list[0].len
 		= htons ( sizeof ( hello.extensions.server_name.list[0].name ));
-	memcpy ( hello.extensions.server_name.list[0].name, tls->name,
+	memcpy ( hello.extensions.server_name.list->name, tls->name,
 		 sizeof ( hello.extensions.server_name.list[0].name ) );
 	hello.extensions.max_fragment_length_type
 		= htons ( TLS_MAX_FRAGMENT_LENGTH );
@@ -995,6 +2002,119 @@ static int tls_send_client_hello ( struct tls_session *tls ) {
 		= htons ( sizeof ( hello.extensions.signature_algorithms.code));
 	i = 0 ; for_each_table_entry ( sighash, TLS_SIG_HASH_ALGORITHMS )
 		hello.extensions.signature_algorithms.code[i++] = sighash->code;
+	hello.extensions.status_request_type = htons ( TLS_STATUS_REQUEST );
+	hello.extensions.status_request_len
+		= htons ( sizeof ( hello.extensions.status_request ) );
+	hello.extensions.status_request.type = TLS_STATUS_REQUEST_OCSP;
+	if ( alpn_len ) {
+		hello.extensions.alpn[0].type = htons ( TLS_ALPN );
+		hello.extensions.alpn[0].len
+			= htons ( sizeof ( hello.extensions.alpn[0].list_len ) +
+				  sizeof ( hello.extensions.alpn[0].list ) );
+		hello.extensions.alpn[0].list_len
+			= htons ( sizeof ( hello.extensions.alpn[0].list ) );
+		memcpy ( hello.extensions.alpn->list, tls->alpn,
+			 sizeof ( hello.extensions.alpn[0].list ) );
+	}
+	if ( TLS_NUM_NAMED_CURVES ) {
+		hello.extensions.named_curve[0].type
+			= htons ( TLS_NAMED_CURVE );
+		hello.extensions.named_curve[0].len
+			= htons ( sizeof ( hello.extensions.named_curve[0].data));
+		hello.extensions.named_curve[0].data.len
+			= htons ( sizeof ( hello.extensions.named_curve[0]
+					   .data.code ) );
+		i = 0 ; for_each_table_entry ( curve, TLS_NAMED_CURVES )
+			hello.extensions.named_curve[0].data.code[i++] =
+				curve->code;
+		hello.extensions.point_formats[0].type
+			= htons ( TLS_POINT_FORMATS );
+		hello.extensions.point_formats[0].len
+			= htons ( sizeof ( hello.extensions.point_formats[0].data));
+		hello.extensions.point_formats[0].data.len
+			= sizeof ( hello.extensions.point_formats[0].data.format );
+		hello.extensions.point_formats[0].data.format[0]
+			= TLS_POINT_FORMAT_UNCOMPRESSED;
+	}
+	if ( tls13 ) {
+		hello.extensions.supported_versions[0].type
+			= htons ( TLS_SUPPORTED_VERSIONS );
+		hello.extensions.supported_versions[0].len
+			= htons ( sizeof ( hello.extensions.supported_versions[0]
+					   .data ) );
+		hello.extensions.supported_versions[0].data.len
+			= sizeof ( hello.extensions.supported_versions[0]
+				   .data.code );
+		hello.extensions.supported_versions[0].data.code[0]
+			= htons ( TLS_VERSION_TLS_1_3 );
+		hello.extensions.supported_versions[0].data.code[1]
+			= htons ( TLS_VERSION_TLS_1_2 );
+		hello.extensions.supported_versions[0].data.code[2]
+			= htons ( TLS_VERSION_TLS_1_1 );
+		hello.extensions.supported_versions[0].data.code[3]
+			= htons ( TLS_VERSION_TLS_1_0 );
+		hello.extensions.key_share[0].type = htons ( TLS_KEY_SHARE );
+		hello.extensions.key_share[0].len
+			= htons ( sizeof ( hello.extensions.key_share[0].data ) );
+		hello.extensions.key_share[0].data.len
+			= htons ( sizeof ( hello.extensions.key_share[0].data ) -
+				  sizeof ( hello.extensions.key_share[0]
+					   .data.len ) );
+		hello.extensions.key_share[0].data.group = share->code;
+		hello.extensions.key_share[0].data.key_len
+			= htons ( sizeof ( hello.extensions.key_share[0]
+					   .data.key ) );
+		if ( ( rc = tls_generate_random ( tls, tls->private,
+						  share_len ) ) != 0 )
+			return rc;
+		if ( ( rc = elliptic_multiply ( share->curve, NULL,
+						tls->private,
+						hello.extensions.key_share
+						->data.key ) ) != 0 ) {
+			DBGC ( tls, "TLS %p could not generate key share: "
+			       "%s\n", tls, strerror ( rc ) );
+			return rc;
+		}
+	}
+	if ( use_ticket ) {
+		/* The binder follows the variable-length ticket, so
+		 * is calculated within an aligned local copy.
+		 */
+		typeof ( hello.extensions.psk->data.binder ) binder;
+
+		hello.extensions.psk_modes[0].type
+			= htons ( TLS_PSK_KEY_EXCHANGE_MODES );
+		hello.extensions.psk_modes[0].len
+			= htons ( sizeof ( hello.extensions.psk_modes[0].data ) );
+		hello.extensions.psk_modes[0].data.len
+			= sizeof ( hello.extensions.psk_modes[0].data.mode );
+		hello.extensions.psk_modes[0].data.mode[0] = TLS_PSK_DHE_KE;
+		hello.extensions.psk[0].type = htons ( TLS_PRE_SHARED_KEY );
+		hello.extensions.psk[0].len
+			= htons ( sizeof ( hello.extensions.psk[0].data ) );
+		hello.extensions.psk[0].data.identities_len
+			= htons ( sizeof ( hello.extensions.psk[0]
+					   .data.identity ) );
+		hello.extensions.psk[0].data.identity.len
+			= htons ( sizeof ( hello.extensions.psk[0]
+					   .data.identity.ticket ) );
+		memcpy ( hello.extensions.psk->data.identity.ticket,
+			 tls->ticket, tls->ticket_len );
+		hello.extensions.psk[0].data.identity.age
+			= htonl ( tls->ticket_age );
+		hello.extensions.psk[0].data.binders_len
+			= htons ( sizeof ( hello.extensions.psk[0]
+					   .data.binder ) );
+		binder.len = sizeof ( binder.binder );
+		tls13_binder ( tls, &hello,
+			       ( sizeof ( hello ) -
+				 sizeof ( hello.extensions.psk[0]
+					  .data.binders_len ) -
+				 sizeof ( hello.extensions.psk[0]
+					  .data.binder ) ),
+			       binder.binder );
+		hello.extensions.psk[0].data.binder = binder;
+	}
 
 	return tls_send_handshake ( tls, &hello, sizeof ( hello ) );
 }
@@ -1006,14 +2126,18 @@ static int tls_send_client_hello ( struct tls_session *tls ) {
  * @ret rc		Return status code
  */
 static int tls_send_certificate ( struct tls_session *tls ) {
+	int tls13 = ( tls->version >= TLS_VERSION_TLS_1_3 );
 	struct {
 		uint32_t type_length;
+		uint8_t context_len[ tls13 ? 1 : 0 ];
 		tls24_t length;
 		struct {
 			tls24_t length;
 			uint8_t data[ tls->cert->raw.len ];
+			uint16_t extensions_len[ tls13 ? 1 : 0 ];
 		} __attribute__ (( packed )) certificates[1];
 	} __attribute__ (( packed )) *certificate;
+	tls24_t length;
 	int rc;
 
 	/* Allocate storage for Certificate record (which may be too
@@ -1028,8 +2152,8 @@ static int tls_send_certificate ( struct tls_session *tls ) {
 		( cpu_to_le32 ( TLS_CERTIFICATE ) |
 		  htonl ( sizeof ( *certificate ) -
 			  sizeof ( certificate->type_length ) ) );
-	tls_set_uint24 ( &certificate->length,
-			 sizeof ( certificate->certificates ) );
+	tls_set_uint24 ( &length, sizeof ( certificate->certificates ) );
+	certificate->length = length;
 	tls_set_uint24 ( &certificate->certificates[0].length,
 			 sizeof ( certificate->certificates[0].data ) );
 	memcpy ( certificate->certificates[0].data,
@@ -1046,12 +2170,12 @@ static int tls_send_certificate ( struct tls_session *tls ) {
 }
 
 /**
- * Transmit Client Key Exchange record
+ * Transmit Client Key Exchange record using public key exchange
  *
  * @v tls		TLS session
  * @ret rc		Return status code
  */
-static int tls_send_client_key_exchange ( struct tls_session *tls ) {
+static int tls_send_client_key_exchange_pubkey ( struct tls_session *tls ) {
 	struct tls_cipherspec *cipherspec = &tls->tx_cipherspec_pending;
 	struct pubkey_algorithm *pubkey = cipherspec->suite->pubkey;
 	size_t max_len = pubkey_max_len ( pubkey, cipherspec->pubkey_ctx );
@@ -1075,18 +2199,294 @@ static int tls_send_client_key_exchange ( struct tls_session *tls ) {
 		DBGC ( tls, "TLS %p could not encrypt pre-master secret: %s\n",
 		       tls, strerror ( rc ) );
 		return rc;
-	}
-	unused = ( max_len - len );
-	key_xchg.type_length =
-		( cpu_to_le32 ( TLS_CLIENT_KEY_EXCHANGE ) |
-		  htonl ( sizeof ( key_xchg ) -
-			  sizeof ( key_xchg.type_length ) - unused ) );
-	key_xchg.encrypted_pre_master_secret_len =
-		htons ( sizeof ( key_xchg.encrypted_pre_master_secret ) -
-			unused );
+	}
+
+	/* Generate master secret */
+	tls_generate_master_secret ( tls, &tls->pre_master_secret,
+				     sizeof ( tls->pre_master_secret ) );
+
+	/* Construct Client Key Exchange record */
+	unused = ( max_len - len );
+	key_xchg.type_length =
+		( cpu_to_le32 ( TLS_CLIENT_KEY_EXCHANGE ) |
+		  htonl ( sizeof ( key_xchg ) -
+			  sizeof ( key_xchg.type_length ) - unused ) );
+	key_xchg.encrypted_pre_master_secret_len =
+		htons ( sizeof ( key_xchg.encrypted_pre_master_secret ) -
+			unused );
+
+	return tls_send_handshake ( tls, &key_xchg,
+				    ( sizeof ( key_xchg ) - unused ) );
+}
+
+/** Public key exchange algorithm */
+struct tls_key_exchange_algorithm tls_pubkey_exchange_algorithm = {
+	.name = "pubkey",
+	.exchange = tls_send_client_key_exchange_pubkey,
+};
+
+/**
+ * Verify Diffie-Hellman parameter signature
+ *
+ * @v tls		TLS session
+ * @v param_len		Diffie-Hellman parameter length
+ * @ret rc		Return status code
+ *
+ * The signature follows the parameters within the Server Key
+ * Exchange record, and covers the client and server random values
+ * along with the parameters.
+ */
+static int tls_verify_dh_params ( struct tls_session *tls,
+				  size_t param_len ) {
+	struct tls_cipherspec *cipherspec = &tls->tx_cipherspec_pending;
+	struct pubkey_algorithm *pubkey = cipherspec->suite->pubkey;
+	struct tls_signature_hash_algorithm *sig_hash;
+	struct digest_algorithm *digest;
+	int use_sig_hash = ( ( tls->version >= TLS_VERSION_TLS_1_2 ) ? 1 : 0 );
+	const struct {
+		struct tls_signature_hash_id sig_hash[use_sig_hash];
+		uint16_t signature_len;
+		uint8_t signature[0];
+	} __attribute__ (( packed )) *sig;
+	const void *data;
+	size_t remaining;
+	int rc;
+
+	/* Signature follows parameters */
+	assert ( param_len <= tls->server_key_len );
+	data = ( tls->server_key + param_len );
+	sig = data;
+	remaining = ( tls->server_key_len - param_len );
+
+	/* Parse signature from ServerKeyExchange */
+	if ( ( sizeof ( *sig ) > remaining ) ||
+	     ( ntohs ( sig->signature_len ) > ( remaining -
+						sizeof ( *sig ) ) ) ) {
+		DBGC ( tls, "TLS %p received underlength Server Key "
+		       "Exchange\n", tls );
+		DBGC_HD ( tls, tls->server_key, tls->server_key_len );
+		return -EINVAL_KEY_EXCHANGE;
+	}
+
+	/* Identify signature and hash algorithm */
+	if ( use_sig_hash ) {
+		sig_hash = tls_find_signature_hash ( sig->sig_hash[0] );
+		if ( ! sig_hash ) {
+			DBGC ( tls, "TLS %p Server Key Exchange unsupported "
+			       "signature and hash algorithm\n", tls );
+			return -ENOTSUP_SIG_HASH;
+		}
+		pubkey = sig_hash->pubkey;
+		digest = sig_hash->digest;
+	} else {
+		digest = &md5_sha1_algorithm;
+	}
+
+	/* Verify signature */
+	{
+		uint8_t ctx[digest->ctxsize];
+		uint8_t hash[digest->digestsize];
+
+		/* Calculate digest */
+		digest_init ( digest, ctx );
+		digest_update ( digest, ctx, &tls->client_random,
+				sizeof ( tls->client_random ) );
+		digest_update ( digest, ctx, tls->server_random,
+				sizeof ( tls->server_random ) );
+		digest_update ( digest, ctx, tls->server_key, param_len );
+		digest_final ( digest, ctx, hash );
+
+		/* Verify signature */
+		if ( ( rc = tls_verify_signature ( tls, pubkey, digest, hash,
+						   sig->signature,
+						   ntohs ( sig->signature_len )
+						   ) ) != 0 ) {
+			DBGC ( tls, "TLS %p Server Key Exchange failed "
+			       "verification: %s\n", tls, strerror ( rc ) );
+			DBGC_HD ( tls, tls->server_key, tls->server_key_len );
+			return -EPERM_KEY_EXCHANGE;
+		}
+	}
+
+	return 0;
+}
+
+/**
+ * Transmit Client Key Exchange record using ECDHE key exchange
+ *
+ * @v tls		TLS session
+ * @ret rc		Return status code
+ */
+static int tls_send_client_key_exchange_ecdhe ( struct tls_session *tls ) {
+	struct tls_named_curve *curve;
+	const struct {
+		uint8_t curve_type;
+		uint16_t named_curve;
+		uint8_t public_len;
+		uint8_t public[0];
+	} __attribute__ (( packed )) *ecdh;
+	size_t param_len;
+	size_t len;
+	int rc;
+
+	/* Parse ServerKeyExchange record */
+	ecdh = tls->server_key;
+	if ( ( sizeof ( *ecdh ) > tls->server_key_len ) ||
+	     ( ecdh->public_len > ( tls->server_key_len -
+				    sizeof ( *ecdh ) ) ) ) {
+		DBGC ( tls, "TLS %p received underlength Server Key "
+		       "Exchange\n", tls );
+		DBGC_HD ( tls, tls->server_key, tls->server_key_len );
+		return -EINVAL_KEY_EXCHANGE;
+	}
+	param_len = ( sizeof ( *ecdh ) + ecdh->public_len );
+
+	/* Verify parameter signature */
+	if ( ( rc = tls_verify_dh_params ( tls, param_len ) ) != 0 )
+		return rc;
+
+	/* Identify named curve */
+	if ( ecdh->curve_type != TLS_NAMED_CURVE_TYPE ) {
+		DBGC ( tls, "TLS %p unsupported curve type %d\n",
+		       tls, ecdh->curve_type );
+		DBGC_HD ( tls, tls->server_key, tls->server_key_len );
+		return -ENOTSUP_CURVE;
+	}
+	curve = tls_find_named_curve ( ecdh->named_curve );
+	if ( ! curve ) {
+		DBGC ( tls, "TLS %p unsupported named curve %d\n",
+		       tls, ntohs ( ecdh->named_curve ) );
+		DBGC_HD ( tls, tls->server_key, tls->server_key_len );
+		return -ENOTSUP_CURVE;
+	}
+	DBGC ( tls, "TLS %p using named curve %s\n", tls, curve->curve->name );
+
+	/* Check key length */
+	len = curve->curve->keysize;
+	if ( ecdh->public_len != len ) {
+		DBGC ( tls, "TLS %p invalid %s key\n",
+		       tls, curve->curve->name );
+		DBGC_HD ( tls, tls->server_key, tls->server_key_len );
+		return -EINVAL_KEY_EXCHANGE;
+	}
+
+	/* Construct pre-master secret and Client Key Exchange record */
+	{
+		uint8_t private[len];
+		uint8_t pre_master_secret[len];
+		struct {
+			uint32_t type_length;
+			uint8_t public_len;
+			uint8_t public[len];
+		} __attribute__ (( packed )) key_xchg;
+
+		/* Generate ephemeral private key */
+		if ( ( rc = tls_generate_random ( tls, private,
+						  sizeof ( private ) ) ) != 0)
+			return rc;
+
+		/* Calculate client's ephemeral public key */
+		if ( ( rc = elliptic_multiply ( curve->curve, NULL, private,
+						key_xchg.public ) ) != 0 ) {
+			DBGC ( tls, "TLS %p could not generate %s key: %s\n",
+			       tls, curve->curve->name, strerror ( rc ) );
+			return rc;
+		}
+
+		/* Calculate shared secret, which forms the pre-master
+		 * secret.
+		 */
+		if ( ( rc = elliptic_multiply ( curve->curve, ecdh->public,
+						private,
+						pre_master_secret ) ) != 0 ) {
+			DBGC ( tls, "TLS %p could not exchange %s key: %s\n",
+			       tls, curve->curve->name, strerror ( rc ) );
+			return rc;
+		}
+
+		/* Generate master secret */
+		tls_generate_master_secret ( tls, pre_master_secret, len );
+
+		/* Transmit Client Key Exchange record */
+		key_xchg.type_length =
+			( cpu_to_le32 ( TLS_CLIENT_KEY_EXCHANGE ) |
+			  htonl ( sizeof ( key_xchg ) -
+				  sizeof ( key_xchg.type_length ) ) );
+		key_xchg.public_len = len;
+		if ( ( rc = tls_send_handshake ( tls, &key_xchg,
+						 sizeof ( key_xchg ) ) ) != 0 )
+			return rc;
+	}
+
+	return 0;
+}
+
+/** Ephemeral Elliptic Curve Diffie-Hellman key exchange algorithm */
+struct tls_key_exchange_algorithm tls_ecdhe_exchange_algorithm = {
+	.name = "ecdhe",
+	.exchange = tls_send_client_key_exchange_ecdhe,
+};
+
+/** TLSv1.3 key exchange algorithm
+ *
+ * TLSv1.3 cipher suites do not specify a key exchange algorithm.  The
+ * (EC)DHE key exchange is carried out via the key share extensions
+ * within the Client Hello and Server Hello, and no Client Key
+ * Exchange record is ever sent.
+ */
+struct tls_key_exchange_algorithm tls13_exchange_algorithm = {
+	.name = "tls13",
+	.exchange = NULL,
+};
+
+/**
+ * Transmit Client Key Exchange record
+ *
+ * @v tls		TLS session
+ * @ret rc		Return status code
+ */
+static int tls_send_client_key_exchange ( struct tls_session *tls ) {
+	struct tls_cipherspec *cipherspec = &tls->tx_cipherspec_pending;
+	struct tls_cipher_suite *suite = cipherspec->suite;
+	int rc;
+
+	/* Transmit Client Key Exchange record (and generate master
+	 * secret) using the cipher suite's key exchange algorithm.
+	 */
+	if ( ( rc = suite->exchange->exchange ( tls ) ) != 0 )
+		return rc;
+
+	/* Generate keys from master secret */
+	if ( ( rc = tls_generate_keys ( tls ) ) != 0 )
+		return rc;
 
-	return tls_send_handshake ( tls, &key_xchg,
-				    ( sizeof ( key_xchg ) - unused ) );
+	return 0;
+}
+
+/**
+ * Identify client Certificate Verify signature and hash algorithm
+ *
+ * @v tls		TLS session
+ * @v cert		Client certificate
+ * @v digest		Digest algorithm
+ * @ret sig_hash	Signature and hash algorithm, or NULL
+ *
+ * Versions prior to TLSv1.2 do not use explicit algorithm
+ * identifiers, and so will always return NULL.
+ */
+static struct tls_signature_hash_algorithm *
+tls_client_signature_hash ( struct tls_session *tls,
+			    struct x509_certificate *cert,
+			    struct digest_algorithm *digest ) {
+
+	if ( tls->version >= TLS_VERSION_TLS_1_3 ) {
+		return tls13_signature_hash_algorithm ( digest );
+	} else if ( tls->version >= TLS_VERSION_TLS_1_2 ) {
+		return tls_signature_hash_algorithm ( cert->signature_algorithm
+						      ->pubkey, digest );
+	} else {
+		return NULL;
+	}
 }
 
 /**
@@ -1098,14 +2498,29 @@ static int tls_send_client_key_exchange ( struct tls_session *tls ) {
 static int tls_send_certificate_verify ( struct tls_session *tls ) {
 	struct digest_algorithm *digest = tls->handshake_digest;
 	struct x509_certificate *cert = tls->cert;
-	struct pubkey_algorithm *pubkey = cert->signature_algorithm->pubkey;
+	struct tls_signature_hash_algorithm *sig_hash =
+		tls_client_signature_hash ( tls, cert, digest );
+	struct pubkey_algorithm *pubkey =
+		( sig_hash ? sig_hash->pubkey :
+		  cert->signature_algorithm->pubkey );
 	uint8_t digest_out[ digest->digestsize ];
 	uint8_t ctx[ pubkey->ctxsize ];
-	struct tls_signature_hash_algorithm *sig_hash = NULL;
 	int rc;
 
+	/* TLSv1.2 and later use explicit algorithm identifiers */
+	if ( ( tls->version >= TLS_VERSION_TLS_1_2 ) && ( ! sig_hash ) ) {
+		DBGC ( tls, "TLS %p could not identify (%s,%s) signature and "
+		       "hash algorithm\n", tls, pubkey->name, digest->name );
+		return -ENOTSUP_SIG_HASH;
+	}
+
 	/* Generate digest to be signed */
-	tls_verify_handshake ( tls, digest_out );
+	if ( tls->version >= TLS_VERSION_TLS_1_3 ) {
+		tls13_verify_digest ( tls, digest, tls13_client_verify,
+				      digest_out );
+	} else {
+		tls_verify_handshake ( tls, digest_out );
+	}
 
 	/* Initialise public-key algorithm */
 	if ( ( rc = pubkey_init ( pubkey, ctx, private_key.data,
@@ -1115,18 +2530,6 @@ static int tls_send_certificate_verify ( struct tls_session *tls ) {
 		goto err_pubkey_init;
 	}
 
-	/* TLSv1.2 and later use explicit algorithm identifiers */
-	if ( tls->version >= TLS_VERSION_TLS_1_2 ) {
-		sig_hash = tls_signature_hash_algorithm ( pubkey, digest );
-		if ( ! sig_hash ) {
-			DBGC ( tls, "TLS %p could not identify (%s,%s) "
-			       "signature and hash algorithm\n", tls,
-			       pubkey->name, digest->name );
-			rc = -ENOTSUP_SIG_HASH;
-			goto err_sig_hash;
-		}
-	}
-
 	/* Generate and transmit record */
 	{
 		size_t max_len = pubkey_max_len ( pubkey, ctx );
@@ -1173,7 +2576,6 @@ static int tls_send_certificate_verify ( struct tls_session *tls ) {
 	}
 
  err_pubkey_sign:
- err_sig_hash:
 	pubkey_final ( pubkey, ctx );
  err_pubkey_init:
 	return rc;
@@ -1199,9 +2601,10 @@ static int tls_send_change_cipher ( struct tls_session *tls ) {
  */
 static int tls_send_finished ( struct tls_session *tls ) {
 	struct digest_algorithm *digest = tls->handshake_digest;
+	int tls13 = ( tls->version >= TLS_VERSION_TLS_1_3 );
 	struct {
 		uint32_t type_length;
-		uint8_t verify_data[12];
+		uint8_t verify_data[ tls13 ? digest->digestsize : 12 ];
 	} __attribute__ (( packed )) finished;
 	uint8_t digest_out[ digest->digestsize ];
 	int rc;
@@ -1212,18 +2615,77 @@ static int tls_send_finished ( struct tls_session *tls ) {
 				 htonl ( sizeof ( finished ) -
 					 sizeof ( finished.type_length ) ) );
 	tls_verify_handshake ( tls, digest_out );
-	tls_prf_label ( tls, &tls->master_secret, sizeof ( tls->master_secret ),
-			finished.verify_data, sizeof ( finished.verify_data ),
-			"client finished", digest_out, sizeof ( digest_out ) );
+	if ( tls13 ) {
+		tls13_verify_data ( tls, tls->client_secret, digest_out,
+				    finished.verify_data );
+	} else {
+		tls_prf_label ( tls, &tls->master_secret,
+				sizeof ( tls->master_secret ),
+				finished.verify_data,
+				sizeof ( finished.verify_data ),
+				"client finished", digest_out,
+				sizeof ( digest_out ) );
+	}
 
 	/* Transmit record */
 	if ( ( rc = tls_send_handshake ( tls, &finished,
 					 sizeof ( finished ) ) ) != 0 )
 		return rc;
 
+	/* Switch to application traffic keys for TLSv1.3 */
+	if ( tls13 ) {
+
+		/* Generate resumption master secret */
+		tls_verify_handshake ( tls, digest_out );
+		tls13_derive_secret ( tls, tls->secret, "res master",
+				      digest_out, tls->secret );
+
+		/* Activate client application traffic keys */
+		memcpy ( tls->client_secret, tls->client_secret_pending,
+			 sizeof ( tls->client_secret ) );
+		if ( ( rc = tls13_change_tx_cipher ( tls ) ) != 0 )
+			return rc;
+	}
+
 	/* Mark client as finished */
 	pending_put ( &tls->client_negotiation );
 
+	/* Send notification of a window change, if applicable */
+	if ( tls13 )
+		xfer_window_changed ( &tls->plainstream );
+
+	return 0;
+}
+
+/**
+ * Transmit Key Update record
+ *
+ * @v tls		TLS session
+ * @ret rc		Return status code
+ */
+static int tls13_send_key_update ( struct tls_session *tls ) {
+	struct {
+		uint32_t type_length;
+		uint8_t request;
+	} __attribute__ (( packed )) key_update;
+	int rc;
+
+	/* Construct record */
+	key_update.type_length = ( cpu_to_le32 ( TLS_KEY_UPDATE ) |
+				   htonl ( sizeof ( key_update ) -
+					   sizeof ( key_update.type_length ) ) );
+	key_update.request = 0;
+
+	/* Transmit record */
+	if ( ( rc = tls_send_handshake ( tls, &key_update,
+					 sizeof ( key_update ) ) ) != 0 )
+		return rc;
+
+	/* Update client traffic secret */
+	tls13_update_secret ( tls, tls->client_secret );
+	if ( ( rc = tls13_change_tx_cipher ( tls ) ) != 0 )
+		return rc;
+
 	return 0;
 }
 
@@ -1245,6 +2707,10 @@ static int tls_new_change_cipher ( struct tls_session *tls,
 		return -EINVAL_CHANGE_CIPHER;
 	}
 
+	/* Ignore Change Cipher in TLSv1.3 */
+	if ( tls->version >= TLS_VERSION_TLS_1_3 )
+		return 0;
+
 	if ( ( rc = tls_change_cipher ( tls, &tls->rx_cipherspec_pending,
 					&tls->rx_cipherspec ) ) != 0 ) {
 		DBGC ( tls, "TLS %p could not activate RX cipher: %s\n",
@@ -1295,6 +2761,283 @@ static int tls_new_alert ( struct tls_session *tls, const void *data,
 	}
 }
 
+/**
+ * Receive application-layer protocol negotiation extension
+ *
+ * @v tls		TLS session
+ * @v data		Extension data
+ * @v len		Length of extension data
+ * @ret rc		Return status code
+ */
+static int tls_new_server_hello_alpn ( struct tls_session *tls,
+				       const void *data, size_t len ) {
+	const struct {
+		uint16_t list_len;
+		uint8_t name_len;
+		char name[0];
+	} __attribute__ (( packed )) *alpn = data;
+	const char *offered;
+	size_t name_len;
+
+	/* Parse extension */
+	if ( ( sizeof ( *alpn ) > len ) ||
+	     ( ntohs ( alpn->list_len ) != ( len - sizeof ( alpn->list_len ) ) )||
+	     ( alpn->name_len != ( len - sizeof ( *alpn ) ) ) ||
+	     ( alpn->name_len == 0 ) ) {
+		DBGC ( tls, "TLS %p received malformed ALPN extension\n", tls );
+		DBGC_HD ( tls, data, len );
+		return -EINVAL_HELLO;
+	}
+	name_len = alpn->name_len;
+
+	/* Check that the server selected a protocol that we offered */
+	for ( offered = tls->alpn ; ( offered && *offered ) ;
+	      offered += ( 1 /* length byte */ + *offered ) ) {
+		if ( ( ( ( size_t ) *offered ) == name_len ) &&
+		     ( name_len < sizeof ( tls->protocol ) ) &&
+		     ( memcmp ( ( offered + 1 ), alpn->name,
+				name_len ) == 0 ) ) {
+			memcpy ( tls->protocol, alpn->name, name_len );
+			tls->protocol[name_len] = '\0';
+			DBGC ( tls, "TLS %p using application protocol %s\n",
+			       tls, tls->protocol );
+			return 0;
+		}
+	}
+
+	DBGC ( tls, "TLS %p server selected unoffered application "
+	       "protocol:\n", tls );
+	DBGC_HD ( tls, alpn->name, name_len );
+	return -EPROTO_ALPN;
+}
+
+/**
+ * Receive Server Hello supported versions extension
+ *
+ * @v tls		TLS session
+ * @v data		Extension data
+ * @v len		Length of extension data
+ * @v version		Protocol version to fill in
+ * @ret rc		Return status code
+ */
+static int tls_new_server_hello_version ( struct tls_session *tls,
+					  const void *data, size_t len,
+					  uint16_t *version ) {
+	const struct {
+		uint16_t version;
+	} __attribute__ (( packed )) *supported = data;
+
+	/* Parse extension */
+	if ( sizeof ( *supported ) != len ) {
+		DBGC ( tls, "TLS %p received malformed supported versions "
+		       "extension\n", tls );
+		DBGC_HD ( tls, data, len );
+		return -EINVAL_HELLO;
+	}
+
+	/* The supported versions extension may select only TLSv1.3 or
+	 * later, since earlier versions are negotiated via the legacy
+	 * version field.
+	 */
+	*version = ntohs ( supported->version );
+	if ( *version < TLS_VERSION_TLS_1_3 ) {
+		DBGC ( tls, "TLS %p server selected protocol version %d.%d "
+		       "via supported versions extension\n",
+		       tls, ( *version >> 8 ), ( *version & 0xff ) );
+		return -EINVAL_HELLO;
+	}
+
+	return 0;
+}
+
+/**
+ * Receive Server Hello pre-shared key extension
+ *
+ * @v tls		TLS session
+ * @v data		Extension data
+ * @v len		Length of extension data
+ * @ret rc		Return status code
+ */
+static int tls_new_server_hello_psk ( struct tls_session *tls,
+				      const void *data, size_t len ) {
+	const struct {
+		uint16_t identity;
+	} __attribute__ (( packed )) *psk = data;
+
+	/* Parse extension */
+	if ( sizeof ( *psk ) != len ) {
+		DBGC ( tls, "TLS %p received malformed pre-shared key "
+		       "extension\n", tls );
+		DBGC_HD ( tls, data, len );
+		return -EINVAL_HELLO;
+	}
+
+	/* We offer at most a single identity */
+	if ( ( ! tls->ticket ) || ( psk->identity != htons ( 0 ) ) ) {
+		DBGC ( tls, "TLS %p server selected unoffered pre-shared "
+		       "key %d\n", tls, ntohs ( psk->identity ) );
+		return -EINVAL_HELLO;
+	}
+	DBGC ( tls, "TLS %p resuming session using ticket\n", tls );
+	tls->resumed = 1;
+
+	return 0;
+}
+
+/**
+ * Receive Server Hello or Encrypted Extensions extensions
+ *
+ * @v tls		TLS session
+ * @v data		Extensions (including length field)
+ * @v len		Length of extensions
+ * @v version		Protocol version to update, or NULL
+ * @ret rc		Return status code
+ *
+ * Extensions that may appear only within a Server Hello are ignored
+ * unless a protocol version is provided.
+ */
+static int tls_new_server_hello_extensions ( struct tls_session *tls,
+					     const void *data, size_t len,
+					     uint16_t *version ) {
+	const struct {
+		uint16_t len;
+		uint8_t data[0];
+	} __attribute__ (( packed )) *extensions = data;
+	const struct {
+		uint16_t type;
+		uint16_t len;
+		uint8_t data[0];
+	} __attribute__ (( packed )) *ext;
+	size_t remaining;
+	size_t ext_len;
+	int rc;
+
+	/* Extensions are optional */
+	tls->protocol[0] = '\0';
+	if ( ! len )
+		return 0;
+
+	/* Parse extensions header */
+	if ( ( sizeof ( *extensions ) > len ) ||
+	     ( ntohs ( extensions->len ) != ( len - sizeof ( *extensions ) ))){
+		DBGC ( tls, "TLS %p received malformed Server Hello "
+		       "extensions\n", tls );
+		DBGC_HD ( tls, data, len );
+		return -EINVAL_HELLO;
+	}
+
+	/* Parse each extension */
+	remaining = ntohs ( extensions->len );
+	ext = ( ( const void * ) extensions->data );
+	while ( remaining ) {
+		if ( ( sizeof ( *ext ) > remaining ) ||
+		     ( ntohs ( ext->len ) > ( remaining - sizeof ( *ext ) ) ) ){
+			DBGC ( tls, "TLS %p received underlength Server Hello "
+			       "extension\n", tls );
+			DBGC_HD ( tls, data, len );
+			return -EINVAL_HELLO;
+		}
+		ext_len = ntohs ( ext->len );
+		switch ( ntohs ( ext->type ) ) {
+		case TLS_ALPN:
+			rc = tls_new_server_hello_alpn ( tls, ext->data,
+							 ext_len );
+			break;
+		case TLS_SUPPORTED_VERSIONS:
+			rc = ( version ?
+			       tls_new_server_hello_version ( tls, ext->data,
+							      ext_len,
+							      version ) : 0 );
+			break;
+		case TLS_KEY_SHARE:
+			rc = ( version ?
+			       tls_new_server_key_exchange ( tls, ext->data,
+							     ext_len ) : 0 );
+			break;
+		case TLS_PRE_SHARED_KEY:
+			rc = ( version ?
+			       tls_new_server_hello_psk ( tls, ext->data,
+							  ext_len ) : 0 );
+			break;
+		default:
+			rc = 0;
+			break;
+		}
+		if ( rc != 0 )
+			return rc;
+		remaining -= ( sizeof ( *ext ) + ext_len );
+		ext = ( ( ( const void * ) ext->data ) + ext_len );
+	}
+
+	return 0;
+}
+
+/** TLSv1.3 Hello Retry Request magic random value */
+static const uint8_t tls13_hello_retry_request[32] = {
+	0xcf, 0x21, 0xad, 0x74, 0xe5, 0x9a, 0x61, 0x11, 0xbe, 0x1d, 0x8c,
+	0x02, 0x1e, 0x65, 0xb8, 0x91, 0xc2, 0xa2, 0x11, 0x16, 0x7a, 0xbb,
+	0x8c, 0x5e, 0x07, 0x9e, 0x09, 0xe2, 0xc8, 0xa8, 0x33, 0x9c,
+};
+
+/** TLSv1.3 downgrade protection sentinel value
+ *
+ * The final byte is 0x01 for a downgrade to TLSv1.2, or 0x00 for a
+ * downgrade to TLSv1.1 or earlier.
+ */
+static const uint8_t tls13_downgrade[8] = {
+	'D', 'O', 'W', 'N', 'G', 'R', 'D', 0x01
+};
+
+/**
+ * Process TLSv1.3 key share
+ *
+ * @v tls		TLS session
+ * @ret rc		Return status code
+ */
+static int tls13_new_key_share ( struct tls_session *tls ) {
+	struct tls_named_curve *curve = tls13_key_share_curve();
+	size_t len = curve->curve->keysize;
+	const struct {
+		uint16_t group;
+		uint16_t key_len;
+		uint8_t key[len];
+	} __attribute__ (( packed )) *share = tls->server_key;
+	uint8_t shared[len];
+	int rc;
+
+	/* Parse key share */
+	if ( ! share ) {
+		DBGC ( tls, "TLS %p received no key share\n", tls );
+		return -EINVAL_HELLO;
+	}
+	if ( ( sizeof ( share->group ) > tls->server_key_len ) ||
+	     ( share->group != curve->code ) ) {
+		DBGC ( tls, "TLS %p received key share for unrequested "
+		       "named curve\n", tls );
+		DBGC_HD ( tls, tls->server_key, tls->server_key_len );
+		return -ENOTSUP_CURVE;
+	}
+	if ( ( sizeof ( *share ) != tls->server_key_len ) ||
+	     ( ntohs ( share->key_len ) != len ) ) {
+		DBGC ( tls, "TLS %p received malformed key share\n", tls );
+		DBGC_HD ( tls, tls->server_key, tls->server_key_len );
+		return -EINVAL_HELLO;
+	}
+
+	/* Calculate shared secret */
+	if ( ( rc = elliptic_multiply ( curve->curve, share->key,
+					tls->private, shared ) ) != 0 ) {
+		DBGC ( tls, "TLS %p could not calculate shared secret: %s\n",
+		       tls, strerror ( rc ) );
+		return rc;
+	}
+
+	/* Generate handshake secret */
+	tls13_generate_handshake_secret ( tls, shared, sizeof ( shared ) );
+
+	return 0;
+}
+
 /**
  * Receive new Server Hello handshake record
  *
@@ -1318,6 +3061,7 @@ static int tls_new_server_hello ( struct tls_session *tls,
 		char next[0];
 	} __attribute__ (( packed )) *hello_b;
 	uint16_t version;
+	size_t ext_len;
 	int rc;
 
 	/* Parse header */
@@ -1331,44 +3075,223 @@ static int tls_new_server_hello ( struct tls_session *tls,
 	}
 	session_id = hello_a->session_id;
 	hello_b = ( ( void * ) ( session_id + hello_a->session_id_len ) );
+	ext_len = ( len - sizeof ( *hello_a ) - hello_a->session_id_len -
+		    sizeof ( *hello_b ) );
 
-	/* Check and store protocol version */
+	/* Reject Hello Retry Request, which is a Server Hello with a
+	 * magic random value.  We send a key share for our preferred
+	 * named curve and so have nothing else to offer.
+	 */
+	if ( memcmp ( hello_a->random, tls13_hello_retry_request,
+		      sizeof ( hello_a->random ) ) == 0 ) {
+		DBGC ( tls, "TLS %p received Hello Retry Request\n", tls );
+		return -ENOTSUP_RETRY;
+	}
+
+	/* Process extensions (which may select TLSv1.3) */
 	version = ntohs ( hello_a->version );
+	if ( ( rc = tls_new_server_hello_extensions ( tls, hello_b->next,
+						      ext_len,
+						      &version ) ) != 0 )
+		return rc;
+
+	/* Check and store protocol version */
 	if ( version < TLS_VERSION_TLS_1_0 ) {
 		DBGC ( tls, "TLS %p does not support protocol version %d.%d\n",
 		       tls, ( version >> 8 ), ( version & 0xff ) );
 		return -ENOTSUP_VERSION;
 	}
-	if ( version > tls->version ) {
-		DBGC ( tls, "TLS %p server attempted to illegally upgrade to "
-		       "protocol version %d.%d\n",
-		       tls, ( version >> 8 ), ( version & 0xff ) );
-		return -EPROTO_VERSION;
+	if ( version > tls->version ) {
+		DBGC ( tls, "TLS %p server attempted to illegally upgrade to "
+		       "protocol version %d.%d\n",
+		       tls, ( version >> 8 ), ( version & 0xff ) );
+		return -EPROTO_VERSION;
+	}
+	if ( ( tls->version >= TLS_VERSION_TLS_1_3 ) &&
+	     ( version < TLS_VERSION_TLS_1_3 ) &&
+	     ( memcmp ( ( hello_a->random + sizeof ( hello_a->random ) -
+			  sizeof ( tls13_downgrade ) ), tls13_downgrade,
+			( sizeof ( tls13_downgrade ) - 1 ) ) == 0 ) &&
+	     ( hello_a->random[ sizeof ( hello_a->random ) - 1 ] <= 1 ) ) {
+		DBGC ( tls, "TLS %p server attempted to illegally downgrade "
+		       "to protocol version %d.%d\n",
+		       tls, ( version >> 8 ), ( version & 0xff ) );
+		return -EPROTO_DOWNGRADE;
+	}
+	tls->version = version;
+	DBGC ( tls, "TLS %p using protocol version %d.%d\n",
+	       tls, ( version >> 8 ), ( version & 0xff ) );
+
+	/* Reject TLSv1.3 extensions in earlier versions */
+	if ( ( tls->version < TLS_VERSION_TLS_1_3 ) &&
+	     ( tls->server_key || tls->resumed ) ) {
+		DBGC ( tls, "TLS %p received TLSv1.3 extensions in protocol "
+		       "version %d.%d\n",
+		       tls, ( version >> 8 ), ( version & 0xff ) );
+		return -EINVAL_HELLO;
+	}
+
+	/* Use MD5+SHA1 digest algorithm for handshake verification
+	 * for versions earlier than TLSv1.2.
+	 */
+	if ( tls->version < TLS_VERSION_TLS_1_2 ) {
+		tls->handshake_digest = &md5_sha1_algorithm;
+		tls->handshake_ctx = tls->handshake_md5_sha1_ctx;
+	}
+
+	/* Copy out server random bytes */
+	memcpy ( &tls->server_random, &hello_a->random,
+		 sizeof ( tls->server_random ) );
+
+	/* Select cipher suite */
+	if ( ( rc = tls_select_cipher ( tls, hello_b->cipher_suite ) ) != 0 )
+		return rc;
+
+	/* Handle TLSv1.3 separately */
+	if ( tls->version >= TLS_VERSION_TLS_1_3 ) {
+
+		/* Server must echo our legacy session ID */
+		if ( ( hello_a->session_id_len != tls->session_id_len ) ||
+		     ( memcmp ( session_id, tls->session_id,
+				tls->session_id_len ) != 0 ) ) {
+			DBGC ( tls, "TLS %p server did not echo session ID\n",
+			       tls );
+			return -EINVAL_HELLO;
+		}
+
+		/* Generate handshake secret from key share */
+		return tls13_new_key_share ( tls );
+	}
+
+	/* Check for session resumption */
+	if ( tls->session_id_len &&
+	     ( hello_a->session_id_len == tls->session_id_len ) &&
+	     ( memcmp ( session_id, tls->session_id,
+			tls->session_id_len ) == 0 ) ) {
+
+		/* Server has resumed the session.  The master secret
+		 * is already known, and the server will not send its
+		 * certificate chain.
+		 */
+		if ( ( version != tls->resume_version ) ||
+		     ( hello_b->cipher_suite != tls->resume_cipher_suite ) ) {
+			DBGC ( tls, "TLS %p server illegally changed "
+			       "parameters on session resumption\n", tls );
+			return -EPROTO_RESUME;
+		}
+		DBGC ( tls, "TLS %p resuming session\n", tls );
+		tls->resumed = 1;
+
+	} else {
+
+		/* Record new session ID, if any */
+		if ( hello_a->session_id_len > sizeof ( tls->session_id ) ) {
+			DBGC ( tls, "TLS %p received overlength session ID\n",
+			       tls );
+			DBGC_HD ( tls, data, len );
+			return -EINVAL_HELLO;
+		}
+		memcpy ( tls->session_id, session_id,
+			 hello_a->session_id_len );
+		tls->session_id_len = hello_a->session_id_len;
+
+		/* The master secret and keys will be generated when
+		 * the Client Key Exchange record is sent.
+		 */
+		return 0;
+	}
+
+	/* Generate keys from resumed master secret */
+	if ( ( rc = tls_generate_keys ( tls ) ) != 0 )
+		return rc;
+
+	return 0;
+}
+
+/**
+ * Receive certificate status
+ *
+ * @v tls		TLS session
+ * @v data		Certificate status
+ * @v len		Length of certificate status
+ * @ret rc		Return status code
+ *
+ * This is used both for the TLSv1.2 Certificate Status handshake
+ * record and for the TLSv1.3 status request certificate extension.
+ */
+static int tls_new_certificate_status ( struct tls_session *tls,
+					const void *data, size_t len ) {
+	const struct {
+		uint8_t type;
+		tls24_t length;
+		uint8_t response[0];
+	} __attribute__ (( packed )) *status = data;
+	size_t response_len;
+
+	/* Parse header */
+	if ( ( sizeof ( *status ) > len ) ||
+	     ( status->type != TLS_STATUS_REQUEST_OCSP ) ) {
+		DBGC ( tls, "TLS %p received invalid Certificate Status\n",
+		       tls );
+		DBGC_HD ( tls, data, len );
+		return -EINVAL_CERTIFICATE_STATUS;
+	}
+	response_len = tls_uint24 ( &status->length );
+	if ( response_len != ( len - sizeof ( *status ) ) ) {
+		DBGC ( tls, "TLS %p received malformed Certificate Status\n",
+		       tls );
+		DBGC_HD ( tls, data, len );
+		return -EINVAL_CERTIFICATE_STATUS;
 	}
-	tls->version = version;
-	DBGC ( tls, "TLS %p using protocol version %d.%d\n",
-	       tls, ( version >> 8 ), ( version & 0xff ) );
 
-	/* Use MD5+SHA1 digest algorithm for handshake verification
-	 * for versions earlier than TLSv1.2.
-	 */
-	if ( tls->version < TLS_VERSION_TLS_1_2 ) {
-		tls->handshake_digest = &md5_sha1_algorithm;
-		tls->handshake_ctx = tls->handshake_md5_sha1_ctx;
-	}
+	/* Record stapled OCSP response */
+	free ( tls->ocsp );
+	tls->ocsp_len = 0;
+	tls->ocsp = malloc ( response_len );
+	if ( ! tls->ocsp )
+		return -ENOMEM_CERTIFICATE_STATUS;
+	memcpy ( tls->ocsp, status->response, response_len );
+	tls->ocsp_len = response_len;
+	DBGC ( tls, "TLS %p received stapled OCSP response\n", tls );
 
-	/* Copy out server random bytes */
-	memcpy ( &tls->server_random, &hello_a->random,
-		 sizeof ( tls->server_random ) );
+	return 0;
+}
 
-	/* Select cipher suite */
-	if ( ( rc = tls_select_cipher ( tls, hello_b->cipher_suite ) ) != 0 )
-		return rc;
+/**
+ * Parse TLSv1.3 certificate extensions
+ *
+ * @v tls		TLS session
+ * @v data		Certificate extensions
+ * @v len		Length of certificate extensions
+ * @ret rc		Return status code
+ */
+static int tls13_parse_certificate_extensions ( struct tls_session *tls,
+						const void *data,
+						size_t len ) {
+	const struct {
+		uint16_t type;
+		uint16_t len;
+		uint8_t data[0];
+	} __attribute__ (( packed )) *ext = data;
+	size_t ext_len;
+	int rc;
 
-	/* Generate secrets */
-	tls_generate_master_secret ( tls );
-	if ( ( rc = tls_generate_keys ( tls ) ) != 0 )
-		return rc;
+	/* Parse each extension */
+	while ( len ) {
+		if ( ( sizeof ( *ext ) > len ) ||
+		     ( ntohs ( ext->len ) > ( len - sizeof ( *ext ) ) ) ) {
+			DBGC ( tls, "TLS %p received underlength certificate "
+			       "extension\n", tls );
+			return -EINVAL_CERTIFICATE;
+		}
+		ext_len = ntohs ( ext->len );
+		if ( ( ntohs ( ext->type ) == TLS_STATUS_REQUEST ) &&
+		     ( ( rc = tls_new_certificate_status ( tls, ext->data,
+							   ext_len ) ) != 0 ) )
+			return rc;
+		len -= ( sizeof ( *ext ) + ext_len );
+		ext = ( ( ( const void * ) ext->data ) + ext_len );
+	}
 
 	return 0;
 }
@@ -1386,9 +3309,12 @@ static int tls_parse_chain ( struct tls_session *tls,
 	size_t remaining = len;
 	int rc;
 
-	/* Free any existing certificate chain */
+	/* Free any existing certificate chain and stapled OCSP response */
 	x509_chain_put ( tls->chain );
 	tls->chain = NULL;
+	free ( tls->ocsp );
+	tls->ocsp = NULL;
+	tls->ocsp_len = 0;
 
 	/* Create certificate chain */
 	tls->chain = x509_alloc_chain();
@@ -1423,6 +3349,39 @@ static int tls_parse_chain ( struct tls_session *tls,
 		}
 		record_len = ( sizeof ( *certificate ) + certificate_len );
 
+		/* Parse TLSv1.3 certificate extensions.  Only the
+		 * server's own (i.e. first) certificate may carry a
+		 * stapled OCSP response that we can use.
+		 */
+		if ( tls->version >= TLS_VERSION_TLS_1_3 ) {
+			const struct {
+				uint16_t len;
+				uint8_t data[0];
+			} __attribute__ (( packed )) *extensions =
+				( data + record_len );
+
+			if ( ( sizeof ( *extensions ) >
+			       ( remaining - record_len ) ) ||
+			     ( ntohs ( extensions->len ) >
+			       ( remaining - record_len -
+				 sizeof ( *extensions ) ) ) ) {
+				DBGC ( tls, "TLS %p overlength certificate "
+				       "extensions:\n", tls );
+				DBGC_HDA ( tls, 0, data, remaining );
+				rc = -EINVAL_CERTIFICATE;
+				goto err_overlength;
+			}
+			if ( ( remaining == len ) &&
+			     ( ( rc = tls13_parse_certificate_extensions
+				 ( tls, extensions->data,
+				   ntohs ( extensions->len ) ) ) != 0 ) ) {
+				DBGC_HDA ( tls, 0, data, remaining );
+				goto err_extensions;
+			}
+			record_len += ( sizeof ( *extensions ) +
+					ntohs ( extensions->len ) );
+		}
+
 		/* Add certificate to chain */
 		if ( ( rc = x509_append_raw ( tls->chain, certificate->data,
 					      certificate_len ) ) != 0 ) {
@@ -1443,6 +3402,7 @@ static int tls_parse_chain ( struct tls_session *tls,
 	return 0;
 
  err_parse:
+ err_extensions:
  err_overlength:
  err_underlength:
 	x509_chain_put ( tls->chain );
@@ -1451,6 +3411,26 @@ static int tls_parse_chain ( struct tls_session *tls,
 	return rc;
 }
 
+/**
+ * Begin certificate validation
+ *
+ * @v tls		TLS session
+ * @ret rc		Return status code
+ */
+static int tls_validate ( struct tls_session *tls ) {
+	int rc;
+
+	/* Begin certificate validation */
+	if ( ( rc = create_validator ( &tls->validator, tls->chain,
+				       tls->ocsp, tls->ocsp_len ) ) != 0 ) {
+		DBGC ( tls, "TLS %p could not start certificate validation: "
+		       "%s\n", tls, strerror ( rc ) );
+		return rc;
+	}
+
+	return 0;
+}
+
 /**
  * Receive new Certificate handshake record
  *
@@ -1461,13 +3441,30 @@ static int tls_parse_chain ( struct tls_session *tls,
  */
 static int tls_new_certificate ( struct tls_session *tls,
 				 const void *data, size_t len ) {
+	int tls13 = ( tls->version >= TLS_VERSION_TLS_1_3 );
 	const struct {
 		tls24_t length;
 		uint8_t certificates[0];
-	} __attribute__ (( packed )) *certificate = data;
+	} __attribute__ (( packed )) *certificate;
+	const struct {
+		uint8_t len;
+	} __attribute__ (( packed )) *context = data;
 	size_t certificates_len;
 	int rc;
 
+	/* Skip (empty) TLSv1.3 certificate request context */
+	if ( tls13 ) {
+		if ( ( sizeof ( *context ) > len ) || context->len ) {
+			DBGC ( tls, "TLS %p received invalid Server "
+			       "Certificate context\n", tls );
+			DBGC_HD ( tls, data, len );
+			return -EINVAL_CERTIFICATES;
+		}
+		data += sizeof ( *context );
+		len -= sizeof ( *context );
+	}
+	certificate = data;
+
 	/* Parse header */
 	if ( sizeof ( *certificate ) > len ) {
 		DBGC ( tls, "TLS %p received underlength Server Certificate\n",
@@ -1488,6 +3485,12 @@ static int tls_new_certificate ( struct tls_session *tls,
 				      certificates_len ) ) != 0 )
 		return rc;
 
+	/* TLSv1.3 has no Server Hello Done, so begin certificate
+	 * validation immediately.
+	 */
+	if ( tls13 && ( ( rc = tls_validate ( tls ) ) != 0 ) )
+		return rc;
+
 	return 0;
 }
 
@@ -1525,33 +3528,414 @@ static int tls_new_certificate_request ( struct tls_session *tls,
 }
 
 /**
- * Receive new Server Hello Done handshake record
+ * Receive new Server Key Exchange handshake record
+ *
+ * @v tls		TLS session
+ * @v data		Plaintext handshake record
+ * @v len		Length of plaintext handshake record
+ * @ret rc		Return status code
+ *
+ * The record cannot be verified until the server certificate has
+ * been validated, and so is stored for use when constructing the
+ * Client Key Exchange record.
+ */
+static int tls_new_server_key_exchange ( struct tls_session *tls,
+					 const void *data, size_t len ) {
+
+	/* Free any existing server key exchange record */
+	free ( tls->server_key );
+	tls->server_key_len = 0;
+
+	/* Allocate copy of server key exchange record */
+	tls->server_key = malloc ( len );
+	if ( ! tls->server_key )
+		return -ENOMEM_KEY_EXCHANGE;
+
+	/* Store copy of server key exchange record */
+	memcpy ( tls->server_key, data, len );
+	tls->server_key_len = len;
+
+	return 0;
+}
+
+/**
+ * Receive new Server Hello Done handshake record
+ *
+ * @v tls		TLS session
+ * @v data		Plaintext handshake record
+ * @v len		Length of plaintext handshake record
+ * @ret rc		Return status code
+ */
+static int tls_new_server_hello_done ( struct tls_session *tls,
+				       const void *data, size_t len ) {
+	const struct {
+		char next[0];
+	} __attribute__ (( packed )) *hello_done = data;
+	int rc;
+
+	/* Sanity check */
+	if ( sizeof ( *hello_done ) != len ) {
+		DBGC ( tls, "TLS %p received overlength Server Hello Done\n",
+		       tls );
+		DBGC_HD ( tls, data, len );
+		return -EINVAL_HELLO_DONE;
+	}
+
+	/* Begin certificate validation */
+	if ( ( rc = tls_validate ( tls ) ) != 0 )
+		return rc;
+
+	return 0;
+}
+
+/**
+ * Schedule TLSv1.3 client handshake completion, if possible
+ *
+ * @v tls		TLS session
+ *
+ * The client Finished (preceded by the client Certificate and
+ * Certificate Verify, if applicable) may be sent only once the server
+ * Finished has been received and the server certificate chain (if
+ * any) has been validated.
+ */
+static void tls13_tx_finished ( struct tls_session *tls ) {
+
+	/* Do nothing until server is finished and validated */
+	if ( is_pending ( &tls->server_negotiation ) ||
+	     ! ( tls->resumed || tls->validated ) )
+		return;
+
+	/* Schedule Certificate, Certificate Verify, and Finished */
+	tls->tx_pending |= TLS_TX_FINISHED;
+	if ( tls->cert ) {
+		tls->tx_pending |= ( TLS_TX_CERTIFICATE |
+				     TLS_TX_CERTIFICATE_VERIFY );
+	}
+	tls_tx_resume ( tls );
+}
+
+/**
+ * Receive new Encrypted Extensions handshake record
+ *
+ * @v tls		TLS session
+ * @v data		Plaintext handshake record
+ * @v len		Length of plaintext handshake record
+ * @ret rc		Return status code
+ */
+static int tls13_new_encrypted_extensions ( struct tls_session *tls,
+					    const void *data, size_t len ) {
+
+	/* Process extensions */
+	return tls_new_server_hello_extensions ( tls, data, len, NULL );
+}
+
+/**
+ * Receive new Certificate Verify handshake record
+ *
+ * @v tls		TLS session
+ * @v data		Plaintext handshake record
+ * @v len		Length of plaintext handshake record
+ * @ret rc		Return status code
+ */
+static int tls13_new_certificate_verify ( struct tls_session *tls,
+					  const void *data, size_t len ) {
+	const struct {
+		struct tls_signature_hash_id sig_hash;
+		uint16_t signature_len;
+		uint8_t signature[0];
+	} __attribute__ (( packed )) *verify = data;
+	struct tls_signature_hash_algorithm *sig_hash;
+	struct digest_algorithm *digest;
+	int rc;
+
+	/* Parse header */
+	if ( ( sizeof ( *verify ) > len ) ||
+	     ( ntohs ( verify->signature_len ) !=
+	       ( len - sizeof ( *verify ) ) ) ) {
+		DBGC ( tls, "TLS %p received malformed Certificate Verify\n",
+		       tls );
+		DBGC_HD ( tls, data, len );
+		return -EINVAL_CERTIFICATE_VERIFY;
+	}
+
+	/* Identify signature algorithm */
+	sig_hash = tls_find_signature_hash ( verify->sig_hash );
+	if ( ( ! sig_hash ) ||
+	     ( sig_hash->code.hash != TLS_INTRINSIC_ALGORITHM ) ) {
+		DBGC ( tls, "TLS %p Certificate Verify unsupported signature "
+		       "algorithm %02x%02x\n", tls, verify->sig_hash.hash,
+		       verify->sig_hash.signature );
+		return -ENOTSUP_SIG_HASH;
+	}
+	digest = sig_hash->digest;
+
+	/* Verify signature */
+	{
+		uint8_t hash[digest->digestsize];
+
+		tls13_verify_digest ( tls, digest, tls13_server_verify, hash );
+		if ( ( rc = tls_verify_signature ( tls, sig_hash->pubkey,
+						   digest, hash,
+						   verify->signature,
+						   ntohs ( verify->signature_len )
+						   ) ) != 0 ) {
+			DBGC ( tls, "TLS %p Certificate Verify failed "
+			       "verification: %s\n", tls, strerror ( rc ) );
+			return -EPERM_CERTIFICATE_VERIFY;
+		}
+	}
+	tls->verified = 1;
+
+	return 0;
+}
+
+/**
+ * Receive new TLSv1.3 Finished handshake record
+ *
+ * @v tls		TLS session
+ * @v data		Plaintext handshake record
+ * @v len		Length of plaintext handshake record
+ * @ret rc		Return status code
+ */
+static int tls13_new_finished ( struct tls_session *tls,
+				const void *data, size_t len ) {
+	struct digest_algorithm *digest = tls->handshake_digest;
+	uint8_t digest_out[ digest->digestsize ];
+	uint8_t verify_data[ digest->digestsize ];
+
+	/* Sanity check */
+	if ( sizeof ( verify_data ) != len ) {
+		DBGC ( tls, "TLS %p received malformed Finished\n", tls );
+		DBGC_HD ( tls, data, len );
+		return -EINVAL_FINISHED;
+	}
+
+	/* Server must have authenticated itself, unless resuming */
+	if ( ! ( tls->resumed || tls->verified ) ) {
+		DBGC ( tls, "TLS %p received Finished without Certificate "
+		       "Verify\n", tls );
+		return -EPERM_VERIFY;
+	}
+
+	/* Verify data */
+	tls_verify_handshake ( tls, digest_out );
+	tls13_verify_data ( tls, tls->server_secret, digest_out,
+			    verify_data );
+	if ( memcmp ( verify_data, data, sizeof ( verify_data ) ) != 0 ) {
+		DBGC ( tls, "TLS %p verification failed\n", tls );
+		return -EPERM_VERIFY;
+	}
+
+	/* Mark server as finished */
+	pending_put ( &tls->server_negotiation );
+	timeline_record ( "tls", "established", tls->name, 0 );
+
+	return 0;
+}
+
+/**
+ * Receive new New Session Ticket handshake record
+ *
+ * @v tls		TLS session
+ * @v data		Plaintext handshake record
+ * @v len		Length of plaintext handshake record
+ * @ret rc		Return status code
+ */
+static int tls13_new_session_ticket ( struct tls_session *tls,
+				      const void *data, size_t len ) {
+	const struct {
+		uint32_t lifetime;
+		uint32_t age_add;
+		uint8_t nonce_len;
+		uint8_t nonce[0];
+	} __attribute__ (( packed )) *ticket_a = data;
+	const struct {
+		uint16_t ticket_len;
+		uint8_t ticket[0];
+	} __attribute__ (( packed )) *ticket_b;
+	struct tls_cached_session *cached;
+	unsigned long lifetime;
+	size_t remaining;
+	size_t ticket_len;
+
+	/* Session tickets may be sent only after the handshake */
+	if ( ! tls_ready ( tls ) ) {
+		DBGC ( tls, "TLS %p received premature New Session Ticket\n",
+		       tls );
+		return -EINVAL_HANDSHAKE;
+	}
+
+	/* Parse header */
+	if ( ( sizeof ( *ticket_a ) > len ) ||
+	     ( ticket_a->nonce_len > ( len - sizeof ( *ticket_a ) ) ) ||
+	     ( sizeof ( *ticket_b ) > ( len - sizeof ( *ticket_a ) -
+					ticket_a->nonce_len ) ) ) {
+		DBGC ( tls, "TLS %p received underlength New Session "
+		       "Ticket\n", tls );
+		DBGC_HD ( tls, data, len );
+		return -EINVAL_TICKET;
+	}
+	ticket_b = ( ( ( void * ) ticket_a->nonce ) + ticket_a->nonce_len );
+	remaining = ( len - sizeof ( *ticket_a ) - ticket_a->nonce_len -
+		      sizeof ( *ticket_b ) );
+	ticket_len = ntohs ( ticket_b->ticket_len );
+	if ( ( ticket_len == 0 ) || ( ticket_len > remaining ) ) {
+		DBGC ( tls, "TLS %p received invalid New Session Ticket\n",
+		       tls );
+		DBGC_HD ( tls, data, len );
+		return -EINVAL_TICKET;
+	}
+
+	/* Ignore tickets that may not be used */
+	lifetime = ntohl ( ticket_a->lifetime );
+	if ( ! lifetime ) {
+		DBGC ( tls, "TLS %p ignoring zero-lifetime session ticket\n",
+		       tls );
+		return 0;
+	}
+	if ( lifetime > TLS13_MAX_TICKET_LIFETIME )
+		lifetime = TLS13_MAX_TICKET_LIFETIME;
+
+	/* Create cache entry */
+	cached = tls_new_cached ( tls );
+	if ( ! cached ) {
+		/* Not a fatal error; session will not be cached */
+		return 0;
+	}
+	cached->ticket = malloc ( ticket_len );
+	if ( ! cached->ticket ) {
+		/* Not a fatal error; session will not be cached */
+		tls_discard_cached ( cached );
+		return 0;
+	}
+
+	/* Record session parameters */
+	cached->version = tls->version;
+	cached->cipher_suite = tls->rx_cipherspec.suite->code;
+	cached->id_len = 0;
+	memcpy ( cached->ticket, ticket_b->ticket, ticket_len );
+	cached->ticket_len = ticket_len;
+	cached->lifetime = lifetime;
+	cached->age_add = ntohl ( ticket_a->age_add );
+	cached->received = currticks();
+	tls13_expand_label ( tls, tls->secret, "resumption", ticket_a->nonce,
+			     ticket_a->nonce_len, cached->psk,
+			     sizeof ( cached->psk ) );
+	DBGC ( tls, "TLS %p cached session ticket for %s\n",
+	       tls, tls->name );
+
+	return 0;
+}
+
+/**
+ * Receive new Key Update handshake record
+ *
+ * @v tls		TLS session
+ * @v data		Plaintext handshake record
+ * @v len		Length of plaintext handshake record
+ * @ret rc		Return status code
+ */
+static int tls13_new_key_update ( struct tls_session *tls,
+				  const void *data, size_t len ) {
+	const struct {
+		uint8_t request;
+	} __attribute__ (( packed )) *key_update = data;
+	int rc;
+
+	/* Key updates may be sent only after the handshake */
+	if ( ! tls_ready ( tls ) ) {
+		DBGC ( tls, "TLS %p received premature Key Update\n", tls );
+		return -EINVAL_HANDSHAKE;
+	}
+
+	/* Sanity check */
+	if ( sizeof ( *key_update ) != len ) {
+		DBGC ( tls, "TLS %p received malformed Key Update\n", tls );
+		DBGC_HD ( tls, data, len );
+		return -EINVAL_KEY_UPDATE;
+	}
+
+	/* Update server traffic secret */
+	tls13_update_secret ( tls, tls->server_secret );
+	if ( ( rc = tls13_change_rx_cipher ( tls ) ) != 0 )
+		return rc;
+	DBGC ( tls, "TLS %p updated RX traffic keys\n", tls );
+
+	/* Schedule our own key update, if requested */
+	if ( key_update->request == TLS_KEY_UPDATE_REQUESTED ) {
+		tls->tx_pending |= TLS_TX_KEY_UPDATE;
+		tls_tx_resume ( tls );
+	}
+
+	return 0;
+}
+
+/**
+ * Update TLSv1.3 keys after handshake record
  *
  * @v tls		TLS session
- * @v data		Plaintext handshake record
- * @v len		Length of plaintext handshake record
+ * @v type		Handshake record type
  * @ret rc		Return status code
+ *
+ * Traffic secrets are derived from a transcript hash that includes
+ * the handshake record which triggers the change of keys, and so can
+ * be generated only after the record has been added to the handshake
+ * digest.
  */
-static int tls_new_server_hello_done ( struct tls_session *tls,
-				       const void *data, size_t len ) {
-	const struct {
-		char next[0];
-	} __attribute__ (( packed )) *hello_done = data;
+static int tls13_new_handshake_keys ( struct tls_session *tls,
+				      unsigned int type ) {
+	struct digest_algorithm *digest = tls->handshake_digest;
+	uint8_t hash[ digest->digestsize ];
+	uint8_t derived[TLS13_SECRET_LEN];
+	static const uint8_t zero[TLS13_SECRET_LEN];
 	int rc;
 
-	/* Sanity check */
-	if ( sizeof ( *hello_done ) != len ) {
-		DBGC ( tls, "TLS %p received overlength Server Hello Done\n",
-		       tls );
-		DBGC_HD ( tls, data, len );
-		return -EINVAL_HELLO_DONE;
-	}
+	switch ( type ) {
 
-	/* Begin certificate validation */
-	if ( ( rc = create_validator ( &tls->validator, tls->chain ) ) != 0 ) {
-		DBGC ( tls, "TLS %p could not start certificate validation: "
-		       "%s\n", tls, strerror ( rc ) );
-		return rc;
+	case TLS_SERVER_HELLO:
+
+		/* Generate handshake traffic secrets */
+		tls_verify_handshake ( tls, hash );
+		tls13_derive_secret ( tls, tls->secret, "c hs traffic", hash,
+				      tls->client_secret );
+		tls13_derive_secret ( tls, tls->secret, "s hs traffic", hash,
+				      tls->server_secret );
+
+		/* Activate handshake traffic keys */
+		if ( ( rc = tls13_change_tx_cipher ( tls ) ) != 0 )
+			return rc;
+		if ( ( rc = tls13_change_rx_cipher ( tls ) ) != 0 )
+			return rc;
+		break;
+
+	case TLS_FINISHED:
+
+		/* Generate master secret */
+		tls13_derive_secret ( tls, tls->secret, "derived", NULL,
+				      derived );
+		hkdf_extract ( digest, derived, sizeof ( derived ),
+			       zero, sizeof ( zero ), tls->secret );
+
+		/* Generate application traffic secrets */
+		tls_verify_handshake ( tls, hash );
+		tls13_derive_secret ( tls, tls->secret, "c ap traffic", hash,
+				      tls->client_secret_pending );
+		tls13_derive_secret ( tls, tls->secret, "s ap traffic", hash,
+				      tls->server_secret );
+
+		/* Activate server application traffic keys.  The
+		 * client application traffic keys will be activated
+		 * after sending the client Finished.
+		 */
+		if ( ( rc = tls13_change_rx_cipher ( tls ) ) != 0 )
+			return rc;
+
+		/* Complete handshake, if possible */
+		tls13_tx_finished ( tls );
+		break;
+
+	default:
+		break;
 	}
 
 	return 0;
@@ -1575,6 +3959,10 @@ static int tls_new_finished ( struct tls_session *tls,
 	uint8_t digest_out[ digest->digestsize ];
 	uint8_t verify_data[ sizeof ( finished->verify_data ) ];
 
+	/* Handle TLSv1.3 separately */
+	if ( tls->version >= TLS_VERSION_TLS_1_3 )
+		return tls13_new_finished ( tls, data, len );
+
 	/* Sanity check */
 	if ( sizeof ( *finished ) != len ) {
 		DBGC ( tls, "TLS %p received overlength Finished\n", tls );
@@ -1595,6 +3983,18 @@ static int tls_new_finished ( struct tls_session *tls,
 
 	/* Mark server as finished */
 	pending_put ( &tls->server_negotiation );
+	timeline_record ( "tls", "established", tls->name, 0 );
+
+	/* Complete an abbreviated handshake by sending our own Change
+	 * Cipher and Finished, which follow those of the server.
+	 */
+	if ( tls->resumed ) {
+		tls->tx_pending |= ( TLS_TX_CHANGE_CIPHER | TLS_TX_FINISHED );
+		tls_tx_resume ( tls );
+	}
+
+	/* Cache session for use by subsequent connections */
+	tls_add_cached ( tls );
 
 	/* Send notification of a window change */
 	xfer_window_changed ( &tls->plainstream );
@@ -1624,6 +4024,7 @@ static int tls_new_handshake ( struct tls_session *tls,
 		const void *payload;
 		size_t payload_len;
 		size_t record_len;
+		int tls13;
 
 		/* Parse header */
 		if ( sizeof ( *handshake ) > remaining ) {
@@ -1641,6 +4042,8 @@ static int tls_new_handshake ( struct tls_session *tls,
 		}
 		payload = &handshake->payload;
 		record_len = ( sizeof ( *handshake ) + payload_len );
+		tls13 = ( tls->version >= TLS_VERSION_TLS_1_3 );
+		TRACE ( "tls_rx_handshake", tls, handshake->type );
 
 		/* Handle payload */
 		switch ( handshake->type ) {
@@ -1650,6 +4053,15 @@ static int tls_new_handshake ( struct tls_session *tls,
 		case TLS_CERTIFICATE:
 			rc = tls_new_certificate ( tls, payload, payload_len );
 			break;
+		case TLS_SERVER_KEY_EXCHANGE:
+			rc = tls_new_server_key_exchange ( tls, payload,
+							   payload_len );
+			break;
+		case TLS_CERTIFICATE_STATUS:
+			rc = ( tls13 ? -EINVAL_HANDSHAKE :
+			       tls_new_certificate_status ( tls, payload,
+							    payload_len ) );
+			break;
 		case TLS_CERTIFICATE_REQUEST:
 			rc = tls_new_certificate_request ( tls, payload,
 							   payload_len );
@@ -1661,6 +4073,30 @@ static int tls_new_handshake ( struct tls_session *tls,
 		case TLS_FINISHED:
 			rc = tls_new_finished ( tls, payload, payload_len );
 			break;
+		case TLS_ENCRYPTED_EXTENSIONS:
+			rc = ( tls13 ?
+			       tls13_new_encrypted_extensions ( tls, payload,
+								payload_len ) :
+			       -EINVAL_HANDSHAKE );
+			break;
+		case TLS_CERTIFICATE_VERIFY:
+			rc = ( tls13 ?
+			       tls13_new_certificate_verify ( tls, payload,
+							      payload_len ) :
+			       -EINVAL_HANDSHAKE );
+			break;
+		case TLS_NEW_SESSION_TICKET:
+			rc = ( tls13 ?
+			       tls13_new_session_ticket ( tls, payload,
+							  payload_len ) :
+			       -EINVAL_HANDSHAKE );
+			break;
+		case TLS_KEY_UPDATE:
+			rc = ( tls13 ?
+			       tls13_new_key_update ( tls, payload,
+						      payload_len ) :
+			       -EINVAL_HANDSHAKE );
+			break;
 		default:
 			DBGC ( tls, "TLS %p ignoring handshake type %d\n",
 			       tls, handshake->type );
@@ -1678,6 +4114,14 @@ static int tls_new_handshake ( struct tls_session *tls,
 		if ( rc != 0 )
 			return rc;
 
+		/* Update TLSv1.3 keys, if applicable */
+		if ( ( tls->version >= TLS_VERSION_TLS_1_3 ) &&
+		     ( ( rc = tls13_new_handshake_keys ( tls,
+							 handshake->type ) )
+		       != 0 ) ) {
+			return rc;
+		}
+
 		/* Move to next handshake record */
 		data += record_len;
 		remaining -= record_len;
@@ -1701,6 +4145,8 @@ static int tls_new_record ( struct tls_session *tls, unsigned int type,
 			    size_t len );
 	int rc;
 
+	TRACE ( "tls_rx_record", tls, type );
+
 	/* Deliver data records to the plainstream interface */
 	if ( type == TLS_TYPE_DATA ) {
 
@@ -1770,12 +4216,16 @@ static int tls_new_record ( struct tls_session *tls, unsigned int type,
  * @v ctx		Context
  * @v seq		Sequence number
  * @v tlshdr		TLS header
+ *
+ * The digest state after absorbing the inner pad is cloned from the
+ * cipher specification, rather than being recalculated for each
+ * record.
  */
 static void tls_hmac_init ( struct tls_cipherspec *cipherspec, void *ctx,
 			    uint64_t seq, struct tls_header *tlshdr ) {
 	struct digest_algorithm *digest = cipherspec->suite->digest;
 
-	hmac_init ( digest, ctx, cipherspec->mac_secret, &digest->digestsize );
+	memcpy ( ctx, cipherspec->mac_inner_ctx, digest->ctxsize );
 	seq = cpu_to_be64 ( seq );
 	hmac_update ( digest, ctx, &seq, sizeof ( seq ) );
 	hmac_update ( digest, ctx, tlshdr, sizeof ( *tlshdr ) );
@@ -1807,8 +4257,13 @@ static void tls_hmac_final ( struct tls_cipherspec *cipherspec, void *ctx,
 			     void *hmac ) {
 	struct digest_algorithm *digest = cipherspec->suite->digest;
 
-	hmac_final ( digest, ctx, cipherspec->mac_secret,
-		     &digest->digestsize, hmac );
+	/* Finish inner hash */
+	digest_final ( digest, ctx, hmac );
+
+	/* Perform outer hash, starting from the precalculated state */
+	memcpy ( ctx, cipherspec->mac_outer_ctx, digest->ctxsize );
+	digest_update ( digest, ctx, hmac, digest->digestsize );
+	digest_final ( digest, ctx, hmac );
 }
 
 /**
@@ -1833,58 +4288,154 @@ static void tls_hmac ( struct tls_cipherspec *cipherspec,
 }
 
 /**
- * Allocate and assemble stream-ciphered record from data and MAC portions
+ * Initialise authenticated encryption for a record
+ *
+ * @v tls		TLS session
+ * @v cipherspec	Cipher specification
+ * @v ctx		Cipher context
+ * @v seq		Sequence number
+ * @v nonce		Explicit nonce
+ * @v tlshdr		TLS header
+ *
+ * The initialisation vector is formed from the fixed portion derived
+ * from the key block followed by the explicit nonce carried within
+ * the record.  The sequence number and header are then supplied as
+ * additional authenticated data.
+ *
+ * TLSv1.3 instead forms the initialisation vector by XORing the
+ * sequence number into the fixed portion, and supplies only the
+ * (ciphertext) record header as additional authenticated data.
+ */
+static void tls_auth_init ( struct tls_session *tls,
+			    struct tls_cipherspec *cipherspec, void *ctx,
+			    uint64_t seq, const void *nonce,
+			    struct tls_header *tlshdr ) {
+	struct tls_cipher_suite *suite = cipherspec->suite;
+	struct cipher_algorithm *cipher = suite->cipher;
+	uint8_t iv[ suite->fixed_iv_len + suite->record_iv_len ];
+	struct {
+		uint64_t seq;
+		struct tls_header tlshdr;
+	} __attribute__ (( packed )) additional;
+	uint8_t *seq_iv;
+	unsigned int i;
+
+	/* Handle TLSv1.3 separately */
+	if ( tls->version >= TLS_VERSION_TLS_1_3 ) {
+		assert ( sizeof ( iv ) >= sizeof ( additional.seq ) );
+		memcpy ( iv, cipherspec->fixed_iv, sizeof ( iv ) );
+		additional.seq = cpu_to_be64 ( seq );
+		seq_iv = ( iv + sizeof ( iv ) - sizeof ( additional.seq ) );
+		for ( i = 0 ; i < sizeof ( additional.seq ) ; i++ )
+			seq_iv[i] ^= ( ( uint8_t * ) &additional.seq )[i];
+		cipher_setiv ( cipher, ctx, iv );
+		cipher_encrypt ( cipher, ctx, tlshdr, NULL,
+				 sizeof ( *tlshdr ) );
+		return;
+	}
+
+	/* Set initialisation vector */
+	memcpy ( iv, cipherspec->fixed_iv, suite->fixed_iv_len );
+	memcpy ( ( iv + suite->fixed_iv_len ), nonce, suite->record_iv_len );
+	cipher_setiv ( cipher, ctx, iv );
+
+	/* Process additional data */
+	additional.seq = cpu_to_be64 ( seq );
+	additional.tlshdr = *tlshdr;
+	cipher_encrypt ( cipher, ctx, &additional, NULL,
+			 sizeof ( additional ) );
+}
+
+/**
+ * Assemble authenticated-encryption record
+ *
+ * @v tls		TLS session
+ * @v type		Content type
+ * @v len		Length of data
+ * @v plaintext		Buffer for plaintext record
+ * @ret plaintext_len	Length of plaintext record
+ *
+ * The sequence number is used as the explicit nonce, since it is
+ * guaranteed to be unique for each record sent using a given key.
+ * The authentication tag is not included in the plaintext record.
+ *
+ * TLSv1.3 records have no explicit nonce, and instead carry the
+ * content type following the data.
+ *
+ * The data portion is left empty, since it will be encrypted directly
+ * from the caller's buffer.
+ */
+static size_t tls_assemble_auth ( struct tls_session *tls, unsigned int type,
+				  size_t len, void *plaintext ) {
+	size_t iv_len = tls->tx_cipherspec.suite->record_iv_len;
+	uint64_t seq = cpu_to_be64 ( tls->tx_seq );
+	uint8_t *inner_type;
+	void *iv;
+
+	/* Append content type for TLSv1.3 */
+	if ( tls->version >= TLS_VERSION_TLS_1_3 ) {
+		assert ( iv_len == 0 );
+		inner_type = ( plaintext + len );
+		*inner_type = type;
+		return ( len + sizeof ( *inner_type ) );
+	}
+
+	/* Fill in authenticated-encryption struct */
+	assert ( iv_len == sizeof ( seq ) );
+	iv = plaintext;
+	memcpy ( iv, &seq, iv_len );
+
+	return ( iv_len + len );
+}
+
+/**
+ * Assemble stream-ciphered record from MAC portion
  *
  * @v tls		TLS session
- * @ret data		Data
- * @ret len		Length of data
- * @ret digest		MAC digest
+ * @v len		Length of data
+ * @v digest		MAC digest
+ * @v plaintext		Buffer for plaintext record
  * @ret plaintext_len	Length of plaintext record
- * @ret plaintext	Allocated plaintext record
+ *
+ * The data portion is left empty, since it will be encrypted directly
+ * from the caller's buffer.
  */
-static void * __malloc tls_assemble_stream ( struct tls_session *tls,
-				    const void *data, size_t len,
-				    void *digest, size_t *plaintext_len ) {
+static size_t tls_assemble_stream ( struct tls_session *tls, size_t len,
+				    void *digest, void *plaintext ) {
 	size_t mac_len = tls->tx_cipherspec.suite->digest->digestsize;
-	void *plaintext;
 	void *content;
 	void *mac;
 
-	/* Calculate stream-ciphered struct length */
-	*plaintext_len = ( len + mac_len );
-
-	/* Allocate stream-ciphered struct */
-	plaintext = malloc ( *plaintext_len );
-	if ( ! plaintext )
-		return NULL;
+	/* Fill in stream-ciphered struct */
 	content = plaintext;
 	mac = ( content + len );
-
-	/* Fill in stream-ciphered struct */
-	memcpy ( content, data, len );
 	memcpy ( mac, digest, mac_len );
 
-	return plaintext;
+	return ( len + mac_len );
 }
 
 /**
- * Allocate and assemble block-ciphered record from data and MAC portions
+ * Assemble block-ciphered record from data and MAC portions
  *
  * @v tls		TLS session
- * @ret data		Data
- * @ret len		Length of data
- * @ret digest		MAC digest
+ * @v data		Data
+ * @v len		Length of data
+ * @v digest		MAC digest
+ * @v plaintext		Buffer for plaintext record
  * @ret plaintext_len	Length of plaintext record
- * @ret plaintext	Allocated plaintext record
+ *
+ * Only the final partial block (if any) of the data portion is
+ * copied.  The whole blocks will be encrypted directly from the
+ * caller's buffer.
  */
-static void * tls_assemble_block ( struct tls_session *tls,
+static size_t tls_assemble_block ( struct tls_session *tls,
 				   const void *data, size_t len,
-				   void *digest, size_t *plaintext_len ) {
+				   void *digest, void *plaintext ) {
 	size_t blocksize = tls->tx_cipherspec.suite->cipher->blocksize;
 	size_t mac_len = tls->tx_cipherspec.suite->digest->digestsize;
 	size_t iv_len;
 	size_t padding_len;
-	void *plaintext;
+	size_t head_len;
 	void *iv;
 	void *content;
 	void *mac;
@@ -1895,24 +4446,20 @@ static void * tls_assemble_block ( struct tls_session *tls,
 
 	/* Calculate block-ciphered struct length */
 	padding_len = ( ( blocksize - 1 ) & -( iv_len + len + mac_len + 1 ) );
-	*plaintext_len = ( iv_len + len + mac_len + padding_len + 1 );
 
-	/* Allocate block-ciphered struct */
-	plaintext = malloc ( *plaintext_len );
-	if ( ! plaintext )
-		return NULL;
+	/* Fill in block-ciphered struct */
 	iv = plaintext;
 	content = ( iv + iv_len );
 	mac = ( content + len );
 	padding = ( mac + mac_len );
-
-	/* Fill in block-ciphered struct */
+	head_len = ( len & ~( blocksize - 1 ) );
 	tls_generate_random ( tls, iv, iv_len );
-	memcpy ( content, data, len );
+	memcpy ( ( content + head_len ), ( data + head_len ),
+		 ( len - head_len ) );
 	memcpy ( mac, digest, mac_len );
 	memset ( padding, padding_len, ( padding_len + 1 ) );
 
-	return plaintext;
+	return ( iv_len + len + mac_len + padding_len + 1 );
 }
 
 /**
@@ -1930,42 +4477,44 @@ static int tls_send_plaintext ( struct tls_session *tls, unsigned int type,
 	struct tls_header *tlshdr;
 	struct tls_cipherspec *cipherspec = &tls->tx_cipherspec;
 	struct cipher_algorithm *cipher = cipherspec->suite->cipher;
-	void *plaintext = NULL;
+	int tls13 = ( is_auth_cipher ( cipher ) &&
+		      ( tls->version >= TLS_VERSION_TLS_1_3 ) );
+	void *plaintext;
+	void *content;
+	void *tail;
 	size_t plaintext_len;
+	size_t content_offset;
+	size_t head_len;
 	struct io_buffer *ciphertext = NULL;
 	size_t ciphertext_len;
+	size_t iv_len = cipherspec->suite->record_iv_len;
 	size_t mac_len = cipherspec->suite->digest->digestsize;
 	uint8_t mac[mac_len];
 	int rc;
 
+	TRACE ( "tls_tx_record", tls, type );
+
 	/* Construct header */
 	plaintext_tlshdr.type = type;
-	plaintext_tlshdr.version = htons ( tls->version );
+	plaintext_tlshdr.version = htons ( tls_legacy_version ( tls ) );
 	plaintext_tlshdr.length = htons ( len );
 
-	/* Calculate MAC */
-	tls_hmac ( cipherspec, tls->tx_seq, &plaintext_tlshdr, data, len, mac );
-
-	/* Allocate and assemble plaintext struct */
-	if ( is_stream_cipher ( cipher ) ) {
-		plaintext = tls_assemble_stream ( tls, data, len, mac,
-						  &plaintext_len );
-	} else {
-		plaintext = tls_assemble_block ( tls, data, len, mac,
-						 &plaintext_len );
-	}
-	if ( ! plaintext ) {
-		DBGC ( tls, "TLS %p could not allocate %zd bytes for "
-		       "plaintext\n", tls, plaintext_len );
-		rc = -ENOMEM_TX_PLAINTEXT;
-		goto done;
+	/* Calculate MAC, if applicable */
+	if ( ! is_auth_cipher ( cipher ) ) {
+		tls_hmac ( cipherspec, tls->tx_seq, &plaintext_tlshdr,
+			   data, len, mac );
 	}
 
-	DBGC2 ( tls, "Sending plaintext data:\n" );
-	DBGC2_HD ( tls, plaintext, plaintext_len );
-
-	/* Allocate ciphertext */
-	ciphertext_len = ( sizeof ( *tlshdr ) + plaintext_len );
+	/* Allocate ciphertext, allowing for the maximum possible
+	 * explicit IV, padding, and authentication tag lengths.
+	 */
+	ciphertext_len = ( sizeof ( *tlshdr ) + len + mac_len );
+	if ( is_auth_cipher ( cipher ) ) {
+		ciphertext_len += ( iv_len + tls13 /* content type */ +
+				    cipher->authsize );
+	} else if ( ! is_stream_cipher ( cipher ) ) {
+		ciphertext_len += ( 2 * cipher->blocksize );
+	}
 	ciphertext = xfer_alloc_iob ( &tls->cipherstream, ciphertext_len );
 	if ( ! ciphertext ) {
 		DBGC ( tls, "TLS %p could not allocate %zd bytes for "
@@ -1974,19 +4523,75 @@ static int tls_send_plaintext ( struct tls_session *tls, unsigned int type,
 		goto done;
 	}
 
-	/* Assemble ciphertext */
+	/* Assemble plaintext directly within the ciphertext buffer.
+	 * The data portion (other than any final partial block) is
+	 * not copied, since it will be encrypted directly from the
+	 * caller's buffer.
+	 */
 	tlshdr = iob_put ( ciphertext, sizeof ( *tlshdr ) );
-	tlshdr->type = type;
-	tlshdr->version = htons ( tls->version );
-	tlshdr->length = htons ( plaintext_len );
+	plaintext = ciphertext->tail;
+	if ( is_auth_cipher ( cipher ) ) {
+		plaintext_len = tls_assemble_auth ( tls, type, len,
+						    plaintext );
+		content_offset = iv_len;
+	} else if ( is_stream_cipher ( cipher ) ) {
+		plaintext_len = tls_assemble_stream ( tls, len, mac,
+						      plaintext );
+		content_offset = 0;
+	} else {
+		plaintext_len = tls_assemble_block ( tls, data, len, mac,
+						     plaintext );
+		content_offset = ( ( tls->version >= TLS_VERSION_TLS_1_1 ) ?
+				   cipher->blocksize : 0 );
+	}
+	iob_put ( ciphertext, plaintext_len );
+	content = ( plaintext + content_offset );
+	head_len = ( len & ~( cipher->blocksize - 1 ) );
+	tail = ( content + head_len );
+
+	/* Construct record header.  All TLSv1.3 records (other than
+	 * those sent before keys are established) use an outer
+	 * content type of application data.
+	 */
+	tlshdr->type = ( tls13 ? TLS_TYPE_DATA : type );
+	tlshdr->version = htons ( tls_legacy_version ( tls ) );
+	tlshdr->length = htons ( plaintext_len +
+				 ( is_auth_cipher ( cipher ) ?
+				   cipher->authsize : 0 ) );
+
+	DBGC2 ( tls, "Sending plaintext data:\n" );
+	DBGC2_HD ( tls, data, len );
+
+	/* Encrypt, reading the data portion directly from the
+	 * caller's buffer and everything else in place.
+	 */
 	memcpy ( cipherspec->cipher_next_ctx, cipherspec->cipher_ctx,
 		 cipher->ctxsize );
-	cipher_encrypt ( cipher, cipherspec->cipher_next_ctx, plaintext,
-			 iob_put ( ciphertext, plaintext_len ), plaintext_len );
-
-	/* Free plaintext as soon as possible to conserve memory */
-	free ( plaintext );
-	plaintext = NULL;
+	if ( is_auth_cipher ( cipher ) ) {
+		tls_auth_init ( tls, cipherspec, cipherspec->cipher_next_ctx,
+				tls->tx_seq, plaintext,
+				( tls13 ? tlshdr : &plaintext_tlshdr ) );
+		cipher_encrypt ( cipher, cipherspec->cipher_next_ctx,
+				 data, content, len );
+		if ( tls13 ) {
+			cipher_encrypt ( cipher, cipherspec->cipher_next_ctx,
+					 ( content + len ), ( content + len ),
+					 ( plaintext_len - len ) );
+		}
+		cipher_auth ( cipher, cipherspec->cipher_next_ctx,
+			      iob_put ( ciphertext, cipher->authsize ) );
+	} else {
+		cipher_encrypt ( cipher, cipherspec->cipher_next_ctx,
+				 plaintext, plaintext, content_offset );
+		cipher_encrypt ( cipher, cipherspec->cipher_next_ctx,
+				 data, content, head_len );
+		cipher_encrypt ( cipher, cipherspec->cipher_next_ctx,
+				 tail, tail, ( plaintext + plaintext_len -
+					       tail ) );
+	}
+	assert ( iob_len ( ciphertext ) <= ciphertext_len );
+	assert ( ntohs ( tlshdr->length ) ==
+		 ( iob_len ( ciphertext ) - sizeof ( *tlshdr ) ) );
 
 	/* Send ciphertext */
 	if ( ( rc = xfer_deliver_iob ( &tls->cipherstream,
@@ -2002,7 +4607,6 @@ static int tls_send_plaintext ( struct tls_session *tls, unsigned int type,
 		 tls->tx_cipherspec.cipher_next_ctx, cipher->ctxsize );
 
  done:
-	free ( plaintext );
 	free_iob ( ciphertext );
 	return rc;
 }
@@ -2092,6 +4696,115 @@ static int tls_split_block ( struct tls_session *tls,
 	return 0;
 }
 
+/**
+ * Decrypt and verify authenticated-encryption record
+ *
+ * @v tls		TLS session
+ * @v tlshdr		Record header
+ * @v rx_data		List of received data buffers
+ * @ret rc		Return status code
+ */
+static int tls_decrypt_auth ( struct tls_session *tls,
+			      struct tls_header *tlshdr,
+			      struct list_head *rx_data ) {
+	struct tls_header plaintext_tlshdr;
+	struct tls_cipherspec *cipherspec = &tls->rx_cipherspec;
+	struct cipher_algorithm *cipher = cipherspec->suite->cipher;
+	size_t iv_len = cipherspec->suite->record_iv_len;
+	uint8_t verify_auth[cipher->authsize];
+	struct io_buffer *iobuf;
+	void *nonce;
+	void *auth;
+	size_t len = 0;
+
+	/* Extract explicit nonce */
+	iobuf = list_first_entry ( rx_data, struct io_buffer, list );
+	assert ( iobuf != NULL );
+	if ( iob_len ( iobuf ) < iv_len ) {
+		DBGC ( tls, "TLS %p received underlength nonce\n", tls );
+		DBGC_HD ( tls, iobuf->data, iob_len ( iobuf ) );
+		return -EINVAL_AUTH;
+	}
+	nonce = iobuf->data;
+	iob_pull ( iobuf, iv_len );
+
+	/* Extract authentication tag */
+	iobuf = list_last_entry ( rx_data, struct io_buffer, list );
+	if ( iob_len ( iobuf ) < sizeof ( verify_auth ) ) {
+		DBGC ( tls, "TLS %p received underlength authentication "
+		       "tag\n", tls );
+		DBGC_HD ( tls, iobuf->data, iob_len ( iobuf ) );
+		return -EINVAL_AUTH;
+	}
+	iob_unput ( iobuf, sizeof ( verify_auth ) );
+	auth = iobuf->tail;
+
+	/* Calculate total length */
+	list_for_each_entry ( iobuf, rx_data, list )
+		len += iob_len ( iobuf );
+
+	/* Decrypt the received data */
+	plaintext_tlshdr.type = tlshdr->type;
+	plaintext_tlshdr.version = tlshdr->version;
+	plaintext_tlshdr.length = htons ( len );
+	tls_auth_init ( tls, cipherspec, cipherspec->cipher_ctx, tls->rx_seq,
+			nonce, ( ( tls->version >= TLS_VERSION_TLS_1_3 ) ?
+				 tlshdr : &plaintext_tlshdr ) );
+	DBGC2 ( tls, "Received plaintext data:\n" );
+	list_for_each_entry ( iobuf, rx_data, list ) {
+		cipher_decrypt ( cipher, cipherspec->cipher_ctx,
+				 iobuf->data, iobuf->data, iob_len ( iobuf ) );
+		DBGC2_HD ( tls, iobuf->data, iob_len ( iobuf ) );
+	}
+
+	/* Verify authentication tag */
+	cipher_auth ( cipher, cipherspec->cipher_ctx, verify_auth );
+	if ( memcmp ( auth, verify_auth, sizeof ( verify_auth ) ) != 0 ) {
+		DBGC ( tls, "TLS %p failed authentication tag verification\n",
+		       tls );
+		return -EINVAL_MAC;
+	}
+
+	return 0;
+}
+
+/**
+ * Split TLSv1.3 record into content and content type
+ *
+ * @v tls		TLS session
+ * @v rx_data		List of received data buffers
+ * @v type		Content type to fill in
+ * @ret rc		Return status code
+ *
+ * The content type is the last non-zero byte of the decrypted record,
+ * and may be followed by any amount of zero padding.  Any I/O buffers
+ * left empty by the removal of padding will be freed.
+ */
+static int tls13_split_type ( struct tls_session *tls,
+			      struct list_head *rx_data,
+			      unsigned int *type ) {
+	struct io_buffer *iobuf;
+	uint8_t *tail;
+
+	/* Strip padding and content type */
+	while ( ( iobuf = list_last_entry ( rx_data, struct io_buffer,
+					    list ) ) ) {
+		while ( iob_len ( iobuf ) ) {
+			tail = ( iobuf->tail - 1 );
+			iob_unput ( iobuf, 1 );
+			if ( *tail ) {
+				*type = *tail;
+				return 0;
+			}
+		}
+		list_del ( &iobuf->list );
+		free_iob ( iobuf );
+	}
+
+	DBGC ( tls, "TLS %p received record with no content type\n", tls );
+	return -EINVAL_CONTENT_TYPE;
+}
+
 /**
  * Receive new ciphertext record
  *
@@ -2110,10 +4823,35 @@ static int tls_new_ciphertext ( struct tls_session *tls,
 	uint8_t ctx[digest->ctxsize];
 	uint8_t verify_mac[digest->digestsize];
 	struct io_buffer *iobuf;
+	unsigned int type;
 	void *mac;
 	size_t len = 0;
 	int rc;
 
+	/* TLSv1.3 Change Cipher records may be sent in plaintext for
+	 * middlebox compatibility, and must then be ignored.
+	 */
+	if ( ( tls->version >= TLS_VERSION_TLS_1_3 ) &&
+	     ( tlshdr->type == TLS_TYPE_CHANGE_CIPHER ) ) {
+		return tls_new_record ( tls, tlshdr->type, rx_data );
+	}
+
+	/* Handle authenticated-encryption records separately */
+	if ( is_auth_cipher ( cipher ) ) {
+		if ( ( rc = tls_decrypt_auth ( tls, tlshdr, rx_data ) ) != 0 )
+			return rc;
+		type = tlshdr->type;
+		if ( ( tls->version >= TLS_VERSION_TLS_1_3 ) &&
+		     ( ( rc = tls13_split_type ( tls, rx_data,
+						 &type ) ) != 0 ) ) {
+			return rc;
+		}
+		if ( ( rc = tls_new_record ( tls, type, rx_data ) ) != 0 )
+			return rc;
+		tls->rx_seq += 1;
+		return 0;
+	}
+
 	/* Decrypt the received data */
 	list_for_each_entry ( iobuf, &tls->rx_data, list ) {
 		cipher_decrypt ( cipher, cipherspec->cipher_ctx,
@@ -2155,6 +4893,9 @@ static int tls_new_ciphertext ( struct tls_session *tls,
 	if ( ( rc = tls_new_record ( tls, tlshdr->type, rx_data ) ) != 0 )
 		return rc;
 
+	/* Increment RX sequence number */
+	tls->rx_seq += 1;
+
 	return 0;
 }
 
@@ -2191,6 +4932,7 @@ static size_t tls_plainstream_window ( struct tls_session *tls ) {
 static int tls_plainstream_deliver ( struct tls_session *tls,
 				     struct io_buffer *iobuf,
 				     struct xfer_metadata *meta __unused ) {
+	size_t frag_len;
 	int rc;
 	
 	/* Refuse unless we are ready to accept data */
@@ -2199,19 +4941,44 @@ static int tls_plainstream_deliver ( struct tls_session *tls,
 		goto done;
 	}
 
-	if ( ( rc = tls_send_plaintext ( tls, TLS_TYPE_DATA, iobuf->data,
-					 iob_len ( iobuf ) ) ) != 0 )
-		goto done;
+	/* Send data as records of the maximum permitted length */
+	do {
+		frag_len = iob_len ( iobuf );
+		if ( frag_len > TLS_TX_BUFSIZE )
+			frag_len = TLS_TX_BUFSIZE;
+		if ( ( rc = tls_send_plaintext ( tls, TLS_TYPE_DATA,
+						 iobuf->data,
+						 frag_len ) ) != 0 )
+			goto done;
+		iob_pull ( iobuf, frag_len );
+	} while ( iob_len ( iobuf ) );
 
  done:
 	free_iob ( iobuf );
 	return rc;
 }
 
+/**
+ * Report negotiated application-layer protocol
+ *
+ * @v tls		TLS session
+ * @ret protocol	Application-layer protocol, or NULL
+ */
+static const char * tls_plainstream_protocol ( struct tls_session *tls ) {
+
+	/* Protocol is not known until we are ready to accept data */
+	if ( ! tls_ready ( tls ) )
+		return NULL;
+
+	return tls->protocol;
+}
+
 /** TLS plaintext stream interface operations */
 static struct interface_operation tls_plainstream_ops[] = {
 	INTF_OP ( xfer_deliver, struct tls_session *, tls_plainstream_deliver ),
 	INTF_OP ( xfer_window, struct tls_session *, tls_plainstream_window ),
+	INTF_OP ( tls_protocol, struct tls_session *,
+		  tls_plainstream_protocol ),
 	INTF_OP ( intf_close, struct tls_session *, tls_close ),
 };
 
@@ -2314,11 +5081,16 @@ static int tls_newdata_process_data ( struct tls_session *tls ) {
 
 	/* Process record */
 	if ( ( rc = tls_new_ciphertext ( tls, &tls->rx_header,
-					 &tls->rx_data ) ) != 0 )
+					 &tls->rx_data ) ) != 0 ) {
+		if ( rc == -EINVAL_MAC ) {
+			drop_count ( &tls_mac_drops );
+		} else if ( rc == -EINVAL_PADDING ) {
+			drop_count ( &tls_padding_drops );
+		} else {
+			drop_count ( &tls_record_drops );
+		}
 		return rc;
-
-	/* Increment RX sequence number */
-	tls->rx_seq += 1;
+	}
 
 	/* Return to header state */
 	assert ( list_empty ( &tls->rx_data ) );
@@ -2439,6 +5211,13 @@ static void tls_validator_done ( struct tls_session *tls, int rc ) {
 		goto err;
 	}
 
+	/* Complete TLSv1.3 handshake, if possible */
+	if ( tls->version >= TLS_VERSION_TLS_1_3 ) {
+		tls->validated = 1;
+		tls13_tx_finished ( tls );
+		return;
+	}
+
 	/* Initialise public key algorithm */
 	if ( ( rc = pubkey_init ( pubkey, cipherspec->pubkey_ctx,
 				  cert->subject.public_key.raw.data,
@@ -2502,6 +5281,7 @@ static void tls_tx_step ( struct tls_session *tls ) {
 			goto err;
 		}
 		tls->tx_pending &= ~TLS_TX_CLIENT_HELLO;
+		timeline_record ( "tls", "hello", tls->name, 0 );
 	} else if ( tls->tx_pending & TLS_TX_CERTIFICATE ) {
 		/* Send Certificate */
 		if ( ( rc = tls_send_certificate ( tls ) ) != 0 ) {
@@ -2550,6 +5330,14 @@ static void tls_tx_step ( struct tls_session *tls ) {
 			goto err;
 		}
 		tls->tx_pending &= ~TLS_TX_FINISHED;
+	} else if ( tls->tx_pending & TLS_TX_KEY_UPDATE ) {
+		/* Send Key Update, and then update the keys in use */
+		if ( ( rc = tls13_send_key_update ( tls ) ) != 0 ) {
+			DBGC ( tls, "TLS %p could not send Key Update: %s\n",
+			       tls, strerror ( rc ) );
+			goto err;
+		}
+		tls->tx_pending &= ~TLS_TX_KEY_UPDATE;
 	}
 
 	/* Reschedule process if pending transmissions remain */
@@ -2573,8 +5361,46 @@ static struct process_descriptor tls_process_desc =
  ******************************************************************************
  */
 
-int add_tls ( struct interface *xfer, const char *name,
-	      struct interface **next ) {
+/**
+ * Report negotiated application-layer protocol
+ *
+ * @v intf		Interface
+ * @ret protocol	Application-layer protocol, or NULL if not yet known
+ *
+ * An empty string indicates that no application-layer protocol was
+ * negotiated.
+ */
+const char * tls_protocol ( struct interface *intf ) {
+	struct interface *dest;
+	tls_protocol_TYPE ( void * ) *op =
+		intf_get_dest_op ( intf, tls_protocol, &dest );
+	void *object = intf_object ( dest );
+	const char *protocol;
+
+	if ( op ) {
+		protocol = op ( object );
+	} else {
+		/* Default is to report no protocol */
+		protocol = "";
+	}
+
+	intf_put ( dest );
+	return protocol;
+}
+
+/**
+ * Add TLS filter offering application-layer protocols
+ *
+ * @v xfer		Data transfer interface
+ * @v name		Server name
+ * @v port		Server port
+ * @v alpn		Offered protocols (in ALPN wire format), or NULL
+ * @v next		Next interface to fill in
+ * @ret rc		Return status code
+ */
+int add_tls_alpn ( struct interface *xfer, const char *name,
+		   unsigned int port, const char *alpn,
+		   struct interface **next ) {
 	struct tls_session *tls;
 	int rc;
 
@@ -2587,11 +5413,14 @@ int add_tls ( struct interface *xfer, const char *name,
 	memset ( tls, 0, sizeof ( *tls ) );
 	ref_init ( &tls->refcnt, free_tls );
 	tls->name = name;
+	tls->port = port;
+	tls->alpn = alpn;
+	tls_resume_cached ( tls );
 	intf_init ( &tls->plainstream, &tls_plainstream_desc, &tls->refcnt );
 	intf_init ( &tls->cipherstream, &tls_cipherstream_desc, &tls->refcnt );
 	intf_init ( &tls->validator, &tls_validator_desc, &tls->refcnt );
 	process_init ( &tls->process, &tls_process_desc, &tls->refcnt );
-	tls->version = TLS_VERSION_TLS_1_2;
+	tls->version = tls_max_version();
 	tls_clear_cipher ( tls, &tls->tx_cipherspec );
 	tls_clear_cipher ( tls, &tls->tx_cipherspec_pending );
 	tls_clear_cipher ( tls, &tls->rx_cipherspec );
@@ -2601,7 +5430,7 @@ int add_tls ( struct interface *xfer, const char *name,
 			  ( sizeof ( tls->client_random.random ) ) ) ) != 0 ) {
 		goto err_random;
 	}
-	tls->pre_master_secret.version = htons ( tls->version );
+	tls->pre_master_secret.version = htons ( tls_legacy_version ( tls ) );
 	if ( ( rc = tls_generate_random ( tls, &tls->pre_master_secret.random,
 		      ( sizeof ( tls->pre_master_secret.random ) ) ) ) != 0 ) {
 		goto err_random;
@@ -2631,6 +5460,21 @@ int add_tls ( struct interface *xfer, const char *name,
 	return rc;
 }
 
+/**
+ * Add TLS filter
+ *
+ * @v xfer		Data transfer interface
+ * @v name		Server name
+ * @v port		Server port
+ * @v next		Next interface to fill in
+ * @ret rc		Return status code
+ */
+int add_tls ( struct interface *xfer, const char *name, unsigned int port,
+	      struct interface **next ) {
+
+	return add_tls_alpn ( xfer, name, port, NULL, next );
+}
+
 /* Drag in objects via add_tls() */
 REQUIRING_SYMBOL ( add_tls );
 
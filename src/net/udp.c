@@ -28,6 +28,8 @@ struct udp_connection {
 	struct refcnt refcnt;
 	/** List of UDP connections */
 	struct list_head list;
+	/** List of UDP connections within the same hash bucket */
+	struct list_head hash;
 
 	/** Data transfer interface */
 	struct interface xfer;
@@ -43,10 +45,34 @@ struct udp_connection {
  */
 static LIST_HEAD ( udp_conns );
 
+/** UDP connection hash table (indexed by local port) */
+static struct list_head udp_hash[UDP_HASH_BUCKETS];
+
+/** List of UDP connections not bound to a local port */
+static LIST_HEAD ( udp_unbound );
+
 /* Forward declatations */
 static struct interface_descriptor udp_xfer_desc;
 struct tcpip_protocol udp_protocol __tcpip_protocol;
 
+/**
+ * Get UDP connection hash bucket
+ *
+ * @v port		Local port (in network byte order)
+ * @ret list		List of connections within hash bucket
+ */
+static struct list_head * udp_bucket ( unsigned int port ) {
+	unsigned int i;
+
+	/* Initialise hash table, if not already done */
+	if ( ! udp_hash[0].next ) {
+		for ( i = 0 ; i < UDP_HASH_BUCKETS ; i++ )
+			INIT_LIST_HEAD ( &udp_hash[i] );
+	}
+
+	return &udp_hash[ ntohs ( port ) % UDP_HASH_BUCKETS ];
+}
+
 /**
  * Check if local UDP port is available
  *
@@ -56,7 +82,7 @@ struct tcpip_protocol udp_protocol __tcpip_protocol;
 static int udp_port_available ( int port ) {
 	struct udp_connection *udp;
 
-	list_for_each_entry ( udp, &udp_conns, list ) {
+	list_for_each_entry ( udp, udp_bucket ( htons ( port ) ), hash ) {
 		if ( udp->local.st_port == htons ( port ) )
 			return -EADDRINUSE;
 	}
@@ -112,6 +138,9 @@ static int udp_open_common ( struct interface *xfer,
 	 */
 	intf_plug_plug ( &udp->xfer, xfer );
 	list_add ( &udp->list, &udp_conns );
+	list_add ( &udp->hash, ( udp->local.st_port ?
+				 udp_bucket ( udp->local.st_port ) :
+				 &udp_unbound ) );
 	return 0;
 
  err:
@@ -158,6 +187,7 @@ static void udp_close ( struct udp_connection *udp, int rc ) {
 
 	/* Remove from list of connections and drop list's reference */
 	list_del ( &udp->list );
+	list_del ( &udp->hash );
 	ref_put ( &udp->refcnt );
 
 	DBGC ( udp, "UDP %p closed\n", udp );
@@ -200,7 +230,7 @@ static int udp_tx ( struct udp_connection *udp, struct io_buffer *iobuf,
 	udphdr->src = src->st_port;
 	udphdr->len = htons ( len );
 	udphdr->chksum = 0;
-	udphdr->chksum = tcpip_chksum ( udphdr, len );
+	iobuf->flags |= IOB_FL_CSUM_PENDING;
 
 	/* Dump debugging information */
 	DBGC2 ( udp, "UDP %p TX %d->%d len %d\n", udp,
@@ -218,6 +248,27 @@ static int udp_tx ( struct udp_connection *udp, struct io_buffer *iobuf,
 	return 0;
 }
 
+/**
+ * Check if UDP connection matches local address
+ *
+ * @v udp		UDP connection
+ * @v local		Local address
+ * @ret matches		Connection matches local address
+ */
+static int udp_matches ( struct udp_connection *udp,
+			 struct sockaddr_tcpip *local ) {
+	static const struct sockaddr_tcpip empty_sockaddr = { .pad = { 0, } };
+
+	return ( ( ( udp->local.st_family == local->st_family ) ||
+		   ( udp->local.st_family == 0 ) ) &&
+		 ( ( udp->local.st_port == local->st_port ) ||
+		   ( udp->local.st_port == 0 ) ) &&
+		 ( ( memcmp ( udp->local.pad, local->pad,
+			      sizeof ( udp->local.pad ) ) == 0 ) ||
+		   ( memcmp ( udp->local.pad, empty_sockaddr.pad,
+			      sizeof ( udp->local.pad ) ) == 0 ) ) );
+}
+
 /**
  * Identify UDP connection by local address
  *
@@ -225,20 +276,24 @@ static int udp_tx ( struct udp_connection *udp, struct io_buffer *iobuf,
  * @ret udp		UDP connection, or NULL
  */
 static struct udp_connection * udp_demux ( struct sockaddr_tcpip *local ) {
-	static const struct sockaddr_tcpip empty_sockaddr = { .pad = { 0, } };
 	struct udp_connection *udp;
 
-	list_for_each_entry ( udp, &udp_conns, list ) {
-		if ( ( ( udp->local.st_family == local->st_family ) ||
-		       ( udp->local.st_family == 0 ) ) &&
-		     ( ( udp->local.st_port == local->st_port ) ||
-		       ( udp->local.st_port == 0 ) ) &&
-		     ( ( memcmp ( udp->local.pad, local->pad,
-				  sizeof ( udp->local.pad ) ) == 0 ) ||
-		       ( memcmp ( udp->local.pad, empty_sockaddr.pad,
-				  sizeof ( udp->local.pad ) ) == 0 ) ) ) {
-			return udp;
+	/* Connections not bound to a local port may match any port,
+	 * and take precedence over any older bound connection.  Fall
+	 * back to scanning all connections (in order) if any exist.
+	 */
+	if ( ! list_empty ( &udp_unbound ) ) {
+		list_for_each_entry ( udp, &udp_conns, list ) {
+			if ( udp_matches ( udp, local ) )
+				return udp;
 		}
+		return NULL;
+	}
+
+	/* Otherwise, consider only connections bound to this port */
+	list_for_each_entry ( udp, udp_bucket ( local->st_port ), hash ) {
+		if ( udp_matches ( udp, local ) )
+			return udp;
 	}
 	return NULL;
 }
@@ -285,7 +340,7 @@ static int udp_rx ( struct io_buffer *iobuf,
 		rc = -EINVAL;
 		goto done;
 	}
-	if ( udphdr->chksum ) {
+	if ( udphdr->chksum && ! ( iobuf->flags & IOB_FL_CSUM_VERIFIED ) ) {
 		csum = tcpip_continue_chksum ( pshdr_csum, iobuf->data, ulen );
 		if ( csum != 0 ) {
 			DBG ( "UDP checksum incorrect (is %04x including "
@@ -349,14 +404,16 @@ struct tcpip_protocol udp_protocol __tcpip_protocol = {
 static struct io_buffer * udp_xfer_alloc_iob ( struct udp_connection *udp,
 					       size_t len ) {
 	struct io_buffer *iobuf;
+	size_t headroom;
 
-	iobuf = alloc_iob ( MAX_LL_NET_HEADER_LEN + len );
+	headroom = tcpip_headroom ( &udp->peer );
+	iobuf = alloc_iob ( headroom + len );
 	if ( ! iobuf ) {
 		DBGC ( udp, "UDP %p cannot allocate buffer of length %zd\n",
 		       udp, len );
 		return NULL;
 	}
-	iob_reserve ( iobuf, MAX_LL_NET_HEADER_LEN );
+	iob_reserve ( iobuf, headroom );
 	return iobuf;
 }
 
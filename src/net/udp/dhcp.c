@@ -48,6 +48,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/dhcppkt.h>
 #include <ipxe/dhcp_arch.h>
 #include <ipxe/features.h>
+#include <ipxe/timeline.h>
 #include <config/dhcp.h>
 
 /** @file
@@ -88,6 +89,7 @@ static uint8_t dhcp_request_options_data[] = {
 	DHCP_STRING ( DHCP_VENDOR_PXECLIENT ( DHCP_ARCH_CLIENT_ARCHITECTURE,
 					      DHCP_ARCH_CLIENT_NDI ) ),
 	DHCP_USER_CLASS_ID, DHCP_STRING ( 'i', 'P', 'X', 'E' ),
+	DHCP_RAPID_COMMIT, 0,
 	DHCP_PARAMETER_REQUEST_LIST,
 	DHCP_OPTION ( DHCP_SUBNET_MASK, DHCP_ROUTERS, DHCP_DNS_SERVERS,
 		      DHCP_LOG_SERVERS, DHCP_HOST_NAME, DHCP_DOMAIN_NAME,
@@ -108,6 +110,15 @@ const struct setting dhcp_server_setting __setting ( SETTING_MISC,
 	.type = &setting_type_ipv4,
 };
 
+/** Skip ProxyDHCP setting */
+const struct setting no_pxedhcp_setting __setting ( SETTING_MISC,
+						    no-pxedhcp ) = {
+	.name = "no-pxedhcp",
+	.description = "Do not wait for ProxyDHCP",
+	.tag = DHCP_EB_NO_PXEDHCP,
+	.type = &setting_type_uint8,
+};
+
 /**
  * Most recent DHCP transaction ID
  *
@@ -185,6 +196,7 @@ struct dhcp_session_state {
 };
 
 static struct dhcp_session_state dhcp_state_discover;
+static struct dhcp_session_state dhcp_state_reboot;
 static struct dhcp_session_state dhcp_state_request;
 static struct dhcp_session_state dhcp_state_proxy;
 static struct dhcp_session_state dhcp_state_pxebs;
@@ -193,6 +205,8 @@ static struct dhcp_session_state dhcp_state_pxebs;
 struct dhcp_session {
 	/** Reference counter */
 	struct refcnt refcnt;
+	/** List of DHCP sessions */
+	struct list_head list;
 	/** Job control interface */
 	struct interface job;
 	/** Data transfer interface */
@@ -213,7 +227,11 @@ struct dhcp_session {
 	struct in_addr server;
 	/** DHCP offer priority */
 	int priority;
+	/** DHCPACK received via rapid commit (if any) */
+	struct dhcp_packet *ack;
 
+	/** ProxyDHCP is not expected */
+	int no_proxy;
 	/** ProxyDHCP protocol extensions should be ignored */
 	int no_pxedhcp;
 	/** ProxyDHCP server */
@@ -236,8 +254,13 @@ struct dhcp_session {
 	unsigned int count;
 	/** Start time of the current state (in ticks) */
 	unsigned long start;
+	/** Waiting for link to become usable */
+	int link_wait;
 };
 
+/** List of DHCP sessions */
+static LIST_HEAD ( dhcp_sessions );
+
 /**
  * Free DHCP session
  *
@@ -248,6 +271,7 @@ static void dhcp_free ( struct refcnt *refcnt ) {
 		container_of ( refcnt, struct dhcp_session, refcnt );
 
 	netdev_put ( dhcp->netdev );
+	dhcppkt_put ( dhcp->ack );
 	dhcppkt_put ( dhcp->proxy_offer );
 	free ( dhcp );
 }
@@ -260,9 +284,16 @@ static void dhcp_free ( struct refcnt *refcnt ) {
  */
 static void dhcp_finished ( struct dhcp_session *dhcp, int rc ) {
 
+	/* Record completion */
+	timeline_record ( "dhcp", "done", dhcp->netdev->name, rc );
+
 	/* Stop retry timer */
 	stop_timer ( &dhcp->timer );
 
+	/* Remove from list of sessions */
+	list_del ( &dhcp->list );
+	INIT_LIST_HEAD ( &dhcp->list );
+
 	/* Shut down interfaces */
 	intf_shutdown ( &dhcp->xfer, rc );
 	intf_shutdown ( &dhcp->job, rc );
@@ -278,6 +309,7 @@ static void dhcp_set_state ( struct dhcp_session *dhcp,
 			     struct dhcp_session_state *state ) {
 
 	DBGC ( dhcp, "DHCP %p entering %s state\n", dhcp, state->name );
+	timeline_record ( "dhcp", state->name, dhcp->netdev->name, 0 );
 	dhcp->state = state;
 	dhcp->start = currticks();
 	stop_timer ( &dhcp->timer );
@@ -316,6 +348,59 @@ static int dhcp_has_pxeopts ( struct dhcp_packet *dhcppkt ) {
  *
  */
 
+/**
+ * Use acknowledged lease
+ *
+ * @v dhcp		DHCP session
+ * @v dhcppkt		DHCPACK packet
+ */
+static void dhcp_bound ( struct dhcp_session *dhcp,
+			 struct dhcp_packet *dhcppkt ) {
+	struct settings *parent;
+	struct settings *settings;
+	int rc;
+
+	/* Record assigned address */
+	dhcp->local.sin_addr = dhcppkt->dhcphdr->yiaddr;
+
+	/* Register settings */
+	parent = netdev_settings ( dhcp->netdev );
+	settings = &dhcppkt->settings;
+	if ( ( rc = register_settings ( settings, parent,
+					DHCP_SETTINGS_NAME ) ) != 0 ) {
+		DBGC ( dhcp, "DHCP %p could not register settings: %s\n",
+		       dhcp, strerror ( rc ) );
+		dhcp_finished ( dhcp, rc );
+		return;
+	}
+
+	/* Perform ProxyDHCP if applicable */
+	if ( dhcp->proxy_offer /* Have ProxyDHCP offer */ &&
+	     ( ! dhcp->no_pxedhcp ) /* ProxyDHCP not disabled */ ) {
+		if ( dhcp_has_pxeopts ( dhcp->proxy_offer ) ) {
+			/* PXE options already present; register settings
+			 * without performing a ProxyDHCPREQUEST
+			 */
+			settings = &dhcp->proxy_offer->settings;
+			if ( ( rc = register_settings ( settings, NULL,
+					   PROXYDHCP_SETTINGS_NAME ) ) != 0 ) {
+				DBGC ( dhcp, "DHCP %p could not register "
+				       "proxy settings: %s\n",
+				       dhcp, strerror ( rc ) );
+				dhcp_finished ( dhcp, rc );
+				return;
+			}
+		} else {
+			/* PXE options not present; use a ProxyDHCPREQUEST */
+			dhcp_set_state ( dhcp, &dhcp_state_proxy );
+			return;
+		}
+	}
+
+	/* Terminate DHCP */
+	dhcp_finished ( dhcp, 0 );
+}
+
 /**
  * Construct transmitted packet for DHCP discovery
  *
@@ -336,6 +421,24 @@ static int dhcp_discovery_tx ( struct dhcp_session *dhcp,
 	return 0;
 }
 
+/**
+ * Complete DHCP discovery
+ *
+ * @v dhcp		DHCP session
+ */
+static void dhcp_discovery_done ( struct dhcp_session *dhcp ) {
+
+	/* Use the selected lease immediately if it has already been
+	 * acknowledged via rapid commit, otherwise request it.
+	 */
+	if ( dhcp->ack ) {
+		DBGC ( dhcp, "DHCP %p using rapid commit DHCPACK\n", dhcp );
+		dhcp_bound ( dhcp, dhcp->ack );
+	} else {
+		dhcp_set_state ( dhcp, &dhcp_state_request );
+	}
+}
+
 /**
  * Handle received packet during DHCP discovery
  *
@@ -357,6 +460,7 @@ static void dhcp_discovery_rx ( struct dhcp_session *dhcp,
 	int has_pxeclient;
 	int8_t priority = 0;
 	uint8_t no_pxedhcp = 0;
+	int rapid_commit;
 	unsigned long elapsed;
 
 	DBGC ( dhcp, "DHCP %p %s from %s:%d", dhcp,
@@ -394,16 +498,29 @@ static void dhcp_discovery_rx ( struct dhcp_session *dhcp,
 			sizeof ( no_pxedhcp ) );
 	if ( no_pxedhcp )
 		DBGC ( dhcp, " nopxe" );
+
+	/* Identify rapid commit flag */
+	rapid_commit = ( dhcppkt_fetch ( dhcppkt, DHCP_RAPID_COMMIT,
+					 NULL, 0 ) >= 0 );
+	if ( rapid_commit )
+		DBGC ( dhcp, " rapid" );
 	DBGC ( dhcp, "\n" );
 
-	/* Select as DHCP offer, if applicable */
+	/* Select as DHCP offer, if applicable.  A DHCPACK sent in
+	 * response to our rapid commit request is treated as an
+	 * offer that has already been acknowledged.
+	 */
 	if ( ip.s_addr && ( peer->sin_port == htons ( BOOTPS_PORT ) ) &&
-	     ( ( msgtype == DHCPOFFER ) || ( ! msgtype /* BOOTP */ ) ) &&
+	     ( ( msgtype == DHCPOFFER ) || ( ! msgtype /* BOOTP */ ) ||
+	       ( ( msgtype == DHCPACK ) && rapid_commit ) ) &&
 	     ( priority >= dhcp->priority ) ) {
 		dhcp->offer = ip;
 		dhcp->server = server_id;
 		dhcp->priority = priority;
-		dhcp->no_pxedhcp = no_pxedhcp;
+		dhcp->no_pxedhcp = ( no_pxedhcp || dhcp->no_proxy );
+		dhcppkt_put ( dhcp->ack );
+		dhcp->ack = ( ( msgtype == DHCPACK ) ?
+			      dhcppkt_get ( dhcppkt ) : NULL );
 	}
 
 	/* Select as ProxyDHCP offer, if applicable */
@@ -434,7 +551,7 @@ static void dhcp_discovery_rx ( struct dhcp_session *dhcp,
 		return;
 
 	/* Transition to DHCPREQUEST */
-	dhcp_set_state ( dhcp, &dhcp_state_request );
+	dhcp_discovery_done ( dhcp );
 }
 
 /**
@@ -449,6 +566,7 @@ static void dhcp_discovery_expired ( struct dhcp_session *dhcp ) {
 	if ( netdev_link_blocked ( dhcp->netdev ) &&
 	     ( dhcp->count <= DHCP_DISC_MAX_DEFERRALS ) ) {
 		DBGC ( dhcp, "DHCP %p deferring discovery\n", dhcp );
+		dhcp->link_wait = 1;
 		dhcp->start = currticks();
 		start_timer_fixed ( &dhcp->timer,
 				    ( DHCP_DISC_START_TIMEOUT_SEC *
@@ -459,7 +577,7 @@ static void dhcp_discovery_expired ( struct dhcp_session *dhcp ) {
 	/* Give up waiting for ProxyDHCP before we reach the failure point */
 	if ( dhcp->offer.s_addr &&
 	     ( elapsed > DHCP_DISC_PROXY_TIMEOUT_SEC * TICKS_PER_SEC ) ) {
-		dhcp_set_state ( dhcp, &dhcp_state_request );
+		dhcp_discovery_done ( dhcp );
 		return;
 	}
 
@@ -478,6 +596,128 @@ static struct dhcp_session_state dhcp_state_discover = {
 	.max_timeout_sec	= DHCP_DISC_END_TIMEOUT_SEC,
 };
 
+/**
+ * Abandon reuse of existing lease
+ *
+ * @v dhcp		DHCP session
+ */
+static void dhcp_reboot_fallback ( struct dhcp_session *dhcp ) {
+
+	/* Forget existing lease and fall back to discovery */
+	dhcp->offer.s_addr = 0;
+	dhcp_set_state ( dhcp, &dhcp_state_discover );
+}
+
+/**
+ * Construct transmitted packet for DHCP reboot
+ *
+ * @v dhcp		DHCP session
+ * @v dhcppkt		DHCP packet
+ * @v peer		Destination address
+ *
+ * This is the INIT-REBOOT state of RFC 2131: the request carries the
+ * address of the existing lease but no server identifier.
+ */
+static int dhcp_reboot_tx ( struct dhcp_session *dhcp,
+			    struct dhcp_packet *dhcppkt,
+			    struct sockaddr_in *peer ) {
+	int rc;
+
+	DBGC ( dhcp, "DHCP %p DHCPREQUEST (reboot) for %s\n",
+	       dhcp, inet_ntoa ( dhcp->offer ) );
+
+	/* Set requested IP address */
+	if ( ( rc = dhcppkt_store ( dhcppkt, DHCP_REQUESTED_ADDRESS,
+				    &dhcp->offer,
+				    sizeof ( dhcp->offer ) ) ) != 0 )
+		return rc;
+
+	/* Set server address */
+	peer->sin_addr.s_addr = INADDR_BROADCAST;
+	peer->sin_port = htons ( BOOTPS_PORT );
+
+	return 0;
+}
+
+/**
+ * Handle received packet during DHCP reboot
+ *
+ * @v dhcp		DHCP session
+ * @v dhcppkt		DHCP packet
+ * @v peer		DHCP server address
+ * @v msgtype		DHCP message type
+ * @v server_id		DHCP server ID
+ * @v pseudo_id		DHCP server pseudo-ID
+ */
+static void dhcp_reboot_rx ( struct dhcp_session *dhcp,
+			     struct dhcp_packet *dhcppkt,
+			     struct sockaddr_in *peer, uint8_t msgtype,
+			     struct in_addr server_id,
+			     struct in_addr pseudo_id __unused ) {
+	struct in_addr ip;
+
+	DBGC ( dhcp, "DHCP %p %s from %s:%d", dhcp,
+	       dhcp_msgtype_name ( msgtype ), inet_ntoa ( peer->sin_addr ),
+	       ntohs ( peer->sin_port ) );
+	if ( server_id.s_addr != peer->sin_addr.s_addr )
+		DBGC ( dhcp, " (%s)", inet_ntoa ( server_id ) );
+
+	/* Identify leased IP address */
+	ip = dhcppkt->dhcphdr->yiaddr;
+	if ( ip.s_addr )
+		DBGC ( dhcp, " for %s", inet_ntoa ( ip ) );
+	DBGC ( dhcp, "\n" );
+
+	/* Filter out unacceptable responses */
+	if ( peer->sin_port != htons ( BOOTPS_PORT ) )
+		return;
+
+	/* Fall back to discovery if existing lease is refused */
+	if ( msgtype == DHCPNAK ) {
+		dhcp_reboot_fallback ( dhcp );
+		return;
+	}
+
+	/* Filter out unacceptable responses */
+	if ( msgtype != DHCPACK )
+		return;
+	if ( ip.s_addr != dhcp->offer.s_addr )
+		return;
+
+	/* Record DHCP server and use acknowledged lease */
+	dhcp->server = server_id;
+	dhcp_bound ( dhcp, dhcppkt );
+}
+
+/**
+ * Handle timer expiry during DHCP reboot
+ *
+ * @v dhcp		DHCP session
+ */
+static void dhcp_reboot_expired ( struct dhcp_session *dhcp ) {
+	unsigned long elapsed = ( currticks() - dhcp->start );
+
+	/* Fall back to discovery before we reach the failure point */
+	if ( elapsed > DHCP_REBOOT_TIMEOUT_SEC * TICKS_PER_SEC ) {
+		dhcp_reboot_fallback ( dhcp );
+		return;
+	}
+
+	/* Retransmit current packet */
+	dhcp_tx ( dhcp );
+}
+
+/** DHCP reboot state operations */
+static struct dhcp_session_state dhcp_state_reboot = {
+	.name			= "reboot",
+	.tx			= dhcp_reboot_tx,
+	.rx			= dhcp_reboot_rx,
+	.expired		= dhcp_reboot_expired,
+	.tx_msgtype		= DHCPREQUEST,
+	.min_timeout_sec	= DHCP_REQ_START_TIMEOUT_SEC,
+	.max_timeout_sec	= DHCP_REQ_END_TIMEOUT_SEC,
+};
+
 /**
  * Construct transmitted packet for DHCP request
  *
@@ -529,9 +769,6 @@ static void dhcp_request_rx ( struct dhcp_session *dhcp,
 			      struct in_addr server_id,
 			      struct in_addr pseudo_id ) {
 	struct in_addr ip;
-	struct settings *parent;
-	struct settings *settings;
-	int rc;
 
 	DBGC ( dhcp, "DHCP %p %s from %s:%d", dhcp,
 	       dhcp_msgtype_name ( msgtype ), inet_ntoa ( peer->sin_addr ),
@@ -558,45 +795,8 @@ static void dhcp_request_rx ( struct dhcp_session *dhcp,
 	if ( ip.s_addr != dhcp->offer.s_addr )
 		return;
 
-	/* Record assigned address */
-	dhcp->local.sin_addr = ip;
-
-	/* Register settings */
-	parent = netdev_settings ( dhcp->netdev );
-	settings = &dhcppkt->settings;
-	if ( ( rc = register_settings ( settings, parent,
-					DHCP_SETTINGS_NAME ) ) != 0 ) {
-		DBGC ( dhcp, "DHCP %p could not register settings: %s\n",
-		       dhcp, strerror ( rc ) );
-		dhcp_finished ( dhcp, rc );
-		return;
-	}
-
-	/* Perform ProxyDHCP if applicable */
-	if ( dhcp->proxy_offer /* Have ProxyDHCP offer */ &&
-	     ( ! dhcp->no_pxedhcp ) /* ProxyDHCP not disabled */ ) {
-		if ( dhcp_has_pxeopts ( dhcp->proxy_offer ) ) {
-			/* PXE options already present; register settings
-			 * without performing a ProxyDHCPREQUEST
-			 */
-			settings = &dhcp->proxy_offer->settings;
-			if ( ( rc = register_settings ( settings, NULL,
-					   PROXYDHCP_SETTINGS_NAME ) ) != 0 ) {
-				DBGC ( dhcp, "DHCP %p could not register "
-				       "proxy settings: %s\n",
-				       dhcp, strerror ( rc ) );
-				dhcp_finished ( dhcp, rc );
-				return;
-			}
-		} else {
-			/* PXE options not present; use a ProxyDHCPREQUEST */
-			dhcp_set_state ( dhcp, &dhcp_state_proxy );
-			return;
-		}
-	}
-
-	/* Terminate DHCP */
-	dhcp_finished ( dhcp, 0 );
+	/* Use acknowledged lease */
+	dhcp_bound ( dhcp, dhcppkt );
 }
 
 /**
@@ -995,6 +1195,15 @@ int dhcp_create_request ( struct dhcp_packet *dhcppkt,
 	/* Set client IP address */
 	dhcppkt->dhcphdr->ciaddr = ciaddr;
 
+	/* Request rapid commit only within DHCPDISCOVER */
+	if ( ( msgtype != DHCPDISCOVER ) &&
+	     ( ( rc = dhcppkt_store ( dhcppkt, DHCP_RAPID_COMMIT,
+				      NULL, 0 ) ) != 0 ) ) {
+		DBG ( "DHCP could not remove rapid commit option: %s\n",
+		      strerror ( rc ) );
+		goto err_store_rapid_commit;
+	}
+
 	/* Add options to identify the feature list */
 	dhcp_features = table_start ( DHCP_FEATURES );
 	dhcp_features_len = table_num_entries ( DHCP_FEATURES );
@@ -1064,6 +1273,7 @@ int dhcp_create_request ( struct dhcp_packet *dhcppkt,
  err_store_client_id:
  err_store_busid:
  err_store_features:
+ err_store_rapid_commit:
  err_create_packet:
 	return rc;
 }
@@ -1099,6 +1309,12 @@ static int dhcp_tx ( struct dhcp_session *dhcp ) {
 	 */
 	start_timer ( &dhcp->timer );
 
+	/* Retransmit as soon as the link becomes usable, if it is not
+	 * usable now.
+	 */
+	dhcp->link_wait = ( ( ! netdev_link_ok ( dhcp->netdev ) ) ||
+			    netdev_link_blocked ( dhcp->netdev ) );
+
 	/* Allocate buffer for packet */
 	iobuf = xfer_alloc_iob ( &dhcp->xfer, DHCP_MIN_LEN );
 	if ( ! iobuf )
@@ -1269,6 +1485,38 @@ static void dhcp_timer_expired ( struct retry_timer *timer, int fail ) {
 	dhcp->state->expired ( dhcp );
 }
 
+/**
+ * Handle network device or link state change
+ *
+ * @v netdev		Network device
+ *
+ * Retransmit immediately on any session that has been waiting for
+ * the link to become usable, rather than waiting for the (possibly
+ * backed-off) retransmission timer to expire.
+ */
+static void dhcp_notify ( struct net_device *netdev ) {
+	struct dhcp_session *dhcp;
+
+	/* Do nothing unless link is usable */
+	if ( ( ! netdev_link_ok ( netdev ) ) || netdev_link_blocked ( netdev ) )
+		return;
+
+	/* Restart any sessions waiting for this link */
+	list_for_each_entry ( dhcp, &dhcp_sessions, list ) {
+		if ( ( dhcp->netdev != netdev ) || ( ! dhcp->link_wait ) )
+			continue;
+		DBGC ( dhcp, "DHCP %p link is now usable\n", dhcp );
+		dhcp->link_wait = 0;
+		start_timer_nodelay ( &dhcp->timer );
+	}
+}
+
+/** DHCP network device driver */
+struct net_driver dhcp_driver __net_driver = {
+	.name = "DHCP",
+	.notify = dhcp_notify,
+};
+
 /****************************************************************************
  *
  * Job control interface
@@ -1314,6 +1562,7 @@ static struct sockaddr dhcp_peer = {
  */
 int start_dhcp ( struct interface *job, struct net_device *netdev ) {
 	struct dhcp_session *dhcp;
+	struct settings *settings;
 	int rc;
 
 	/* Allocate and initialise structure */
@@ -1321,6 +1570,7 @@ int start_dhcp ( struct interface *job, struct net_device *netdev ) {
 	if ( ! dhcp )
 		return -ENOMEM;
 	ref_init ( &dhcp->refcnt, dhcp_free );
+	INIT_LIST_HEAD ( &dhcp->list );
 	intf_init ( &dhcp->job, &dhcp_job_desc, &dhcp->refcnt );
 	intf_init ( &dhcp->xfer, &dhcp_xfer_desc, &dhcp->refcnt );
 	timer_init ( &dhcp->timer, dhcp_timer_expired, &dhcp->refcnt );
@@ -1337,8 +1587,26 @@ int start_dhcp ( struct interface *job, struct net_device *netdev ) {
 				  ( struct sockaddr * ) &dhcp->local ) ) != 0 )
 		goto err;
 
-	/* Enter DHCPDISCOVER state */
-	dhcp_set_state ( dhcp, &dhcp_state_discover );
+	/* Add to list of sessions */
+	list_add ( &dhcp->list, &dhcp_sessions );
+
+	/* Identify whether or not ProxyDHCP is expected */
+	settings = netdev_settings ( netdev );
+	dhcp->no_proxy = fetch_uintz_setting ( settings, &no_pxedhcp_setting );
+
+	/* Reuse any existing lease (e.g. one handed over by a previous
+	 * boot stage) if ProxyDHCP is not expected, otherwise enter
+	 * DHCPDISCOVER state.
+	 */
+	settings = find_child_settings ( settings, DHCP_SETTINGS_NAME );
+	if ( dhcp->no_proxy && settings &&
+	     ( fetch_ipv4_setting ( settings, &ip_setting,
+				    &dhcp->offer ) >= 0 ) ) {
+		dhcp_set_state ( dhcp, &dhcp_state_reboot );
+	} else {
+		dhcp->offer.s_addr = 0;
+		dhcp_set_state ( dhcp, &dhcp_state_discover );
+	}
 
 	/* Attach parent interface, mortalise self, and return */
 	intf_plug_plug ( &dhcp->job, job );
@@ -1429,6 +1697,7 @@ int start_pxebs ( struct interface *job, struct net_device *netdev,
 	if ( ! dhcp )
 		return -ENOMEM;
 	ref_init ( &dhcp->refcnt, dhcp_free );
+	INIT_LIST_HEAD ( &dhcp->list );
 	intf_init ( &dhcp->job, &dhcp_job_desc, &dhcp->refcnt );
 	intf_init ( &dhcp->xfer, &dhcp_xfer_desc, &dhcp->refcnt );
 	timer_init ( &dhcp->timer, dhcp_timer_expired, &dhcp->refcnt );
@@ -1484,6 +1753,9 @@ int start_pxebs ( struct interface *job, struct net_device *netdev,
 				  ( struct sockaddr * ) &dhcp->local ) ) != 0 )
 		goto err;
 
+	/* Add to list of sessions */
+	list_add ( &dhcp->list, &dhcp_sessions );
+
 	/* Enter PXEBS state */
 	dhcp_set_state ( dhcp, &dhcp_state_pxebs );
 
@@ -29,6 +29,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <stdio.h>
 #include <ctype.h>
 #include <errno.h>
@@ -39,12 +40,16 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/open.h>
 #include <ipxe/resolv.h>
 #include <ipxe/retry.h>
+#include <ipxe/timer.h>
+#include <ipxe/process.h>
 #include <ipxe/tcpip.h>
 #include <ipxe/settings.h>
 #include <ipxe/features.h>
 #include <ipxe/dhcp.h>
 #include <ipxe/dhcpv6.h>
 #include <ipxe/dns.h>
+#include <ipxe/timeline.h>
+#include <ipxe/handover.h>
 
 /** @file
  *
@@ -435,18 +440,399 @@ static const char * dns_type ( uint16_t type ) {
 	}
 }
 
-/** A DNS request */
-struct dns_request {
-	/** Reference counter */
-	struct refcnt refcnt;
-	/** Name resolution interface */
-	struct interface resolv;
-	/** Data transfer interface */
-	struct interface socket;
+/******************************************************************************
+ *
+ * Response cache
+ *
+ ******************************************************************************
+ */
+
+/** A cached DNS response */
+struct dns_cache_entry {
+	/** List of cached responses (most recently used first) */
+	struct list_head list;
+	/** Time at which response was cached (in ticks) */
+	unsigned long created;
+	/** Lifetime (in ticks) */
+	unsigned long lifetime;
+	/** Status code (or zero for a resolved address) */
+	int rc;
+	/** Resolved address (if applicable) */
+	union {
+		struct sockaddr sa;
+		struct sockaddr_in sin;
+		struct sockaddr_in6 sin6;
+	} address;
+	/** Name (as requested) */
+	char name[0];
+};
+
+/** DNS response cache */
+static LIST_HEAD ( dns_cache );
+
+/** Number of cached DNS responses */
+static unsigned int dns_cache_count;
+
+/**
+ * Remove cached DNS response
+ *
+ * @v entry		Cached response
+ */
+static void dns_cache_del ( struct dns_cache_entry *entry ) {
+
+	list_del ( &entry->list );
+	dns_cache_count--;
+	free ( entry );
+}
+
+/**
+ * Find cached DNS response
+ *
+ * @v name		Name (as requested)
+ * @ret entry		Cached response, or NULL if not found
+ *
+ * Any expired responses encountered are discarded.
+ */
+static struct dns_cache_entry * dns_cache_find ( const char *name ) {
+	struct dns_cache_entry *entry;
+	struct dns_cache_entry *tmp;
+	unsigned long now = currticks();
+
+	list_for_each_entry_safe ( entry, tmp, &dns_cache, list ) {
+
+		/* Discard expired responses */
+		if ( ( now - entry->created ) >= entry->lifetime ) {
+			dns_cache_del ( entry );
+			continue;
+		}
+
+		/* Check for a matching name */
+		if ( strcasecmp ( entry->name, name ) != 0 )
+			continue;
+
+		/* Mark as most recently used */
+		list_del ( &entry->list );
+		list_add ( &entry->list, &dns_cache );
+		return entry;
+	}
+
+	return NULL;
+}
+
+/**
+ * Add DNS response to cache
+ *
+ * @v name		Name (as requested)
+ * @v rc		Status code (or zero for a resolved address)
+ * @v sa		Resolved address, or NULL
+ * @v ttl		Time to live (in seconds)
+ */
+static void dns_cache_add ( const char *name, int rc, struct sockaddr *sa,
+			    unsigned long ttl ) {
+	struct dns_cache_entry *entry;
+	size_t name_len = ( strlen ( name ) + 1 );
+
+	/* Do not cache responses with a zero time to live */
+	if ( ! ttl )
+		return;
+	if ( ttl > DNS_CACHE_MAX_TTL )
+		ttl = DNS_CACHE_MAX_TTL;
+
+	/* Remove any existing response for this name */
+	entry = dns_cache_find ( name );
+	if ( entry )
+		dns_cache_del ( entry );
+
+	/* Discard least recently used response if cache is full */
+	if ( dns_cache_count >= DNS_CACHE_MAX ) {
+		entry = list_last_entry ( &dns_cache, struct dns_cache_entry,
+					  list );
+		dns_cache_del ( entry );
+	}
+
+	/* Allocate and populate entry */
+	entry = zalloc ( sizeof ( *entry ) + name_len );
+	if ( ! entry )
+		return;
+	entry->created = currticks();
+	entry->lifetime = ( ttl * TICKS_PER_SEC );
+	entry->rc = rc;
+	if ( sa )
+		memcpy ( &entry->address.sa, sa, sizeof ( entry->address ) );
+	memcpy ( entry->name, name, name_len );
+	list_add ( &entry->list, &dns_cache );
+	dns_cache_count++;
+
+	DBG ( "DNS caching \"%s\" as %s for %lds\n", name,
+	      ( sa ? sock_ntoa ( sa ) : strerror ( rc ) ), ttl );
+}
+
+/**
+ * Flush DNS response cache
+ *
+ */
+static void dns_cache_flush ( void ) {
+	struct dns_cache_entry *entry;
+	struct dns_cache_entry *tmp;
+
+	list_for_each_entry_safe ( entry, tmp, &dns_cache, list )
+		dns_cache_del ( entry );
+}
+
+/******************************************************************************
+ *
+ * State handover
+ *
+ ******************************************************************************
+ */
+
+/** A DNS state handover address */
+struct dns_handover_address {
+	/** Address family */
+	uint16_t family;
+	/** Address */
+	uint8_t addr[16];
+} __attribute__ (( packed ));
+
+/** A DNS state handover cached response */
+struct dns_handover_entry {
+	/** Remaining time to live (in seconds) */
+	uint32_t ttl;
+	/** Resolved address */
+	struct dns_handover_address address;
+	/** Length of name */
+	uint16_t name_len;
+	/** Name (as requested, not NUL-terminated) */
+	char name[0];
+} __attribute__ (( packed ));
+
+/** A DNS state handover record */
+struct dns_handover {
+	/** DNS server address */
+	struct dns_handover_address nameserver;
+	/** Cached responses */
+	struct dns_handover_entry entries[0];
+} __attribute__ (( packed ));
+
+/** Handed over DNS state awaiting use (if any) */
+static struct dns_handover *dns_handover;
+
+/** Length of handed over DNS state */
+static size_t dns_handover_len;
+
+/**
+ * Store socket address for state handover
+ *
+ * @v sa		Socket address
+ * @v address		State handover address to fill in
+ */
+static void dns_handover_store ( struct sockaddr *sa,
+				 struct dns_handover_address *address ) {
+	struct sockaddr_in *sin = ( ( struct sockaddr_in * ) sa );
+	struct sockaddr_in6 *sin6 = ( ( struct sockaddr_in6 * ) sa );
+
+	memset ( address, 0, sizeof ( *address ) );
+	address->family = sa->sa_family;
+	if ( sa->sa_family == AF_INET ) {
+		memcpy ( address->addr, &sin->sin_addr,
+			 sizeof ( sin->sin_addr ) );
+	} else if ( sa->sa_family == AF_INET6 ) {
+		memcpy ( address->addr, &sin6->sin6_addr,
+			 sizeof ( sin6->sin6_addr ) );
+	}
+}
+
+/**
+ * Load socket address from state handover
+ *
+ * @v address		State handover address
+ * @v sa		Socket address to fill in
+ * @ret rc		Return status code
+ */
+static int dns_handover_load ( const struct dns_handover_address *address,
+			       struct sockaddr *sa ) {
+	struct sockaddr_in *sin = ( ( struct sockaddr_in * ) sa );
+	struct sockaddr_in6 *sin6 = ( ( struct sockaddr_in6 * ) sa );
+
+	if ( address->family == AF_INET ) {
+		memset ( sin, 0, sizeof ( *sin ) );
+		sin->sin_family = AF_INET;
+		memcpy ( &sin->sin_addr, address->addr,
+			 sizeof ( sin->sin_addr ) );
+	} else if ( address->family == AF_INET6 ) {
+		memset ( sin6, 0, sizeof ( *sin6 ) );
+		sin6->sin6_family = AF_INET6;
+		memcpy ( &sin6->sin6_addr, address->addr,
+			 sizeof ( sin6->sin6_addr ) );
+	} else {
+		return -EINVAL;
+	}
+	return 0;
+}
+
+/**
+ * Save DNS state for handover
+ *
+ * @v data		Buffer to fill with state, or NULL
+ * @v len		Length of buffer
+ * @ret len		Length of state, or zero if no state exists
+ */
+static size_t dns_handover_save ( void *data, size_t len ) {
+	struct dns_handover *handover = data;
+	struct dns_handover_entry *record;
+	struct dns_cache_entry *entry;
+	unsigned long now = currticks();
+	unsigned long elapsed;
+	size_t used = sizeof ( *handover );
+	size_t name_len;
+
+	/* Cached responses are meaningful only for a known server */
+	if ( ! nameserver.sa.sa_family )
+		return 0;
+
+	/* Record DNS server address */
+	if ( used <= len )
+		dns_handover_store ( &nameserver.sa, &handover->nameserver );
+
+	/* Record unexpired positive responses, least recently used
+	 * first so that the restored cache has the same ordering.
+	 */
+	list_for_each_entry_reverse ( entry, &dns_cache, list ) {
+		elapsed = ( now - entry->created );
+		if ( ( entry->rc != 0 ) ||
+		     ( ( elapsed + TICKS_PER_SEC ) > entry->lifetime ) )
+			continue;
+		name_len = strlen ( entry->name );
+		if ( ( used + sizeof ( *record ) + name_len ) <= len ) {
+			record = ( data + used );
+			record->ttl = ( ( entry->lifetime - elapsed ) /
+					TICKS_PER_SEC );
+			dns_handover_store ( &entry->address.sa,
+					     &record->address );
+			record->name_len = name_len;
+			memcpy ( record->name, entry->name, name_len );
+		}
+		used += ( sizeof ( *record ) + name_len );
+	}
+
+	/* Omit record if there are no cached responses */
+	if ( used == sizeof ( *handover ) )
+		return 0;
+
+	return used;
+}
+
+/**
+ * Restore DNS state from handover
+ *
+ * @v data		State
+ * @v len		Length of state
+ * @ret rc		Return status code
+ *
+ * The cached responses are retained until the DNS server address is
+ * known, since they are valid only if the server is unchanged.
+ */
+static int dns_handover_restore ( const void *data, size_t len ) {
+
+	/* Sanity check */
+	if ( len < sizeof ( *dns_handover ) )
+		return -EINVAL;
+
+	/* Retain copy of state */
+	free ( dns_handover );
+	dns_handover = malloc ( len );
+	if ( ! dns_handover )
+		return -ENOMEM;
+	memcpy ( dns_handover, data, len );
+	dns_handover_len = len;
+
+	return 0;
+}
+
+/**
+ * Apply handed over DNS state (if applicable)
+ *
+ */
+static void dns_handover_apply ( void ) {
+	union {
+		struct sockaddr sa;
+		struct sockaddr_in sin;
+		struct sockaddr_in6 sin6;
+	} address;
+	struct dns_handover_address server;
+	const struct dns_handover_entry *record;
+	size_t offset = sizeof ( *dns_handover );
+	size_t remaining;
+	char *name;
+
+	/* Do nothing unless there is state awaiting a DNS server */
+	if ( ! ( dns_handover && nameserver.sa.sa_family ) )
+		return;
+
+	/* Use cached responses only if DNS server is unchanged */
+	dns_handover_store ( &nameserver.sa, &server );
+	if ( memcmp ( &server, &dns_handover->nameserver,
+		      sizeof ( server ) ) != 0 ) {
+		DBG ( "DNS discarding handed over cache for changed server\n" );
+		goto done;
+	}
+
+	/* Populate cache */
+	while ( offset < dns_handover_len ) {
+		record = ( ( ( void * ) dns_handover ) + offset );
+		remaining = ( dns_handover_len - offset );
+		if ( ( remaining < sizeof ( *record ) ) ||
+		     ( record->name_len >
+		       ( remaining - sizeof ( *record ) ) ) ) {
+			DBG ( "DNS handed over cache is malformed\n" );
+			break;
+		}
+		offset += ( sizeof ( *record ) + record->name_len );
+		if ( dns_handover_load ( &record->address, &address.sa ) != 0 )
+			continue;
+		name = strndup ( record->name, record->name_len );
+		if ( ! name )
+			break;
+		dns_cache_add ( name, 0, &address.sa, record->ttl );
+		free ( name );
+	}
+
+ done:
+	free ( dns_handover );
+	dns_handover = NULL;
+}
+
+/** DNS state handover provider */
+struct handover_provider dns_handover_provider __handover_provider = {
+	.name = "DNS",
+	.type = HANDOVER_DNS,
+	.save = dns_handover_save,
+	.restore = dns_handover_restore,
+};
+
+/******************************************************************************
+ *
+ * Name resolution
+ *
+ ******************************************************************************
+ */
+
+/** A DNS query
+ *
+ * A DNS request may issue several queries concurrently (e.g. for
+ * AAAA and A records).  Each query follows its own chain of CNAME
+ * records and search list suffixes.
+ */
+struct dns_query {
+	/** DNS request */
+	struct dns_request *dns;
 	/** Retry timer */
 	struct retry_timer timer;
-
-	/** Socket address to fill in with resolved address */
+	/** Status code (-EINPROGRESS while query is in progress) */
+	int rc;
+	/** Resolved address has been reported */
+	int reported;
+	/** Resolved address */
 	union {
 		struct sockaddr sa;
 		struct sockaddr_in sin;
@@ -475,6 +861,30 @@ struct dns_request {
 	struct dns_name search;
 	/** Recursion counter */
 	unsigned int recursion;
+	/** Minimum time to live of records used (in seconds) */
+	unsigned long ttl;
+};
+
+/** A DNS request */
+struct dns_request {
+	/** Reference counter */
+	struct refcnt refcnt;
+	/** Name resolution interface */
+	struct interface resolv;
+	/** Data transfer interface */
+	struct interface socket;
+	/** Resolution delay timer */
+	struct retry_timer delay;
+	/** Cached response process */
+	struct process process;
+	/** Name (as requested) */
+	char *name;
+	/** Queries (in order of preference) */
+	struct dns_query query[DNS_MAX_QUERIES];
+	/** Number of queries */
+	unsigned int count;
+	/** At least one resolved address has been reported */
+	int reported;
 };
 
 /**
@@ -484,9 +894,16 @@ struct dns_request {
  * @v rc		Return status code
  */
 static void dns_done ( struct dns_request *dns, int rc ) {
+	unsigned int i;
 
-	/* Stop the retry timer */
-	stop_timer ( &dns->timer );
+	/* Record completion */
+	timeline_record ( "dns", "done", dns->name, rc );
+
+	/* Stop the timers and process */
+	for ( i = 0 ; i < dns->count ; i++ )
+		stop_timer ( &dns->query[i].timer );
+	stop_timer ( &dns->delay );
+	process_del ( &dns->process );
 
 	/* Shut down interfaces */
 	intf_shutdown ( &dns->socket, rc );
@@ -494,35 +911,191 @@ static void dns_done ( struct dns_request *dns, int rc ) {
 }
 
 /**
- * Mark DNS request as resolved and complete
+ * Report resolved address
  *
- * @v dns		DNS request
- * @v rc		Return status code
+ * @v query		DNS query
  */
-static void dns_resolved ( struct dns_request *dns ) {
+static void dns_report ( struct dns_query *query ) {
+	struct dns_request *dns = query->dns;
 
 	DBGC ( dns, "DNS %p found address %s\n",
-	       dns, sock_ntoa ( &dns->address.sa ) );
+	       dns, sock_ntoa ( &query->address.sa ) );
+
+	/* Cache first resolved address */
+	if ( ! dns->reported )
+		dns_cache_add ( dns->name, 0, &query->address.sa, query->ttl );
 
 	/* Return resolved address */
-	resolv_done ( &dns->resolv, &dns->address.sa );
+	query->reported = 1;
+	dns->reported = 1;
+	resolv_done ( &dns->resolv, &query->address.sa );
+}
+
+/**
+ * Check progress of DNS request
+ *
+ * @v dns		DNS request
+ *
+ * The resolved address from the most preferred query is reported
+ * first, once all more preferred queries have failed.  If a more
+ * preferred query is still in progress, then we wait for up to the
+ * resolution delay before settling for the less preferred address.
+ *
+ * Any further addresses are reported as they are resolved, so that
+ * a caller that keeps the name resolution interface open (e.g. to
+ * race connection attempts over IPv6 and IPv4) receives all of them.
+ * A caller that closes the interface after the first resolved
+ * address will terminate the request.
+ */
+static void dns_progress ( struct dns_request *dns ) {
+	struct dns_query *query;
+	struct dns_query *pending = NULL;
+	int negative = 1;
+	int rc = -ENXIO_NO_RECORD;
+	unsigned int i;
+
+	for ( i = 0 ; i < dns->count ; i++ ) {
+		query = &dns->query[i];
+
+		/* Note first query still in progress */
+		if ( query->rc == -EINPROGRESS ) {
+			if ( ! pending )
+				pending = query;
+			continue;
+		}
+
+		/* Note failed queries */
+		if ( query->rc != 0 ) {
+			rc = query->rc;
+			if ( rc != -ENXIO_NO_RECORD )
+				negative = 0;
+			continue;
+		}
+
+		/* Skip addresses that have already been reported */
+		if ( query->reported )
+			continue;
+
+		/* Report this address unless a more preferred query
+		 * is still in progress and no address has yet been
+		 * reported.
+		 */
+		if ( pending && ! dns->reported ) {
+			if ( ! timer_running ( &dns->delay ) ) {
+				DBGC ( dns, "DNS %p awaiting %s record\n",
+				       dns, dns_type ( pending->qtype ) );
+				start_timer_fixed ( &dns->delay,
+						    DNS_RESOLUTION_DELAY );
+			}
+			return;
+		}
+		dns_report ( query );
+	}
+
+	/* Wait for any queries still in progress */
+	if ( pending )
+		return;
+
+	/* Succeed if any address has been reported */
+	if ( dns->reported ) {
+		dns_done ( dns, 0 );
+		return;
+	}
 
-	/* Mark operation as complete */
-	dns_done ( dns, 0 );
+	/* All queries have failed.  Cache the failure only if the
+	 * name definitely does not exist.
+	 */
+	if ( negative )
+		dns_cache_add ( dns->name, rc, NULL, DNS_NEGATIVE_TTL );
+	dns_done ( dns, rc );
 }
 
 /**
- * Construct DNS question
+ * Mark DNS query as complete
+ *
+ * @v query		DNS query
+ * @v rc		Return status code
+ */
+static void dns_query_done ( struct dns_query *query, int rc ) {
+
+	/* Stop the retry timer */
+	stop_timer ( &query->timer );
+
+	/* Record status and check progress of overall request */
+	query->rc = rc;
+	dns_progress ( query->dns );
+}
+
+/**
+ * Handle DNS resolution delay timer expiry
+ *
+ * @v timer		Resolution delay timer
+ * @v fail		Failure indicator
+ */
+static void dns_delay_expired ( struct retry_timer *timer,
+				int fail __unused ) {
+	struct dns_request *dns =
+		container_of ( timer, struct dns_request, delay );
+	struct dns_query *query;
+	unsigned int i;
+
+	/* Report first resolved address */
+	for ( i = 0 ; i < dns->count ; i++ ) {
+		query = &dns->query[i];
+		if ( ( query->rc == 0 ) && ! query->reported ) {
+			DBGC ( dns, "DNS %p gave up waiting for preferred "
+			       "record\n", dns );
+			dns_report ( query );
+			return;
+		}
+	}
+}
+
+/**
+ * Report cached DNS response
  *
  * @v dns		DNS request
+ *
+ * The cached response is held in the first query.
+ */
+static void dns_step ( struct dns_request *dns ) {
+	struct dns_query *query = &dns->query[0];
+
+	if ( query->rc == 0 )
+		resolv_done ( &dns->resolv, &query->address.sa );
+	dns_done ( dns, query->rc );
+}
+
+/** Cached DNS response process descriptor */
+static struct process_descriptor dns_process_desc =
+	PROC_DESC_ONCE ( struct dns_request, process, dns_step );
+
+/**
+ * Update minimum time to live of records used by DNS query
+ *
+ * @v query		DNS query
+ * @v rr		Resource record
+ */
+static void dns_ttl ( struct dns_query *query, union dns_rr *rr ) {
+	unsigned long ttl = ntohl ( rr->common.ttl );
+
+	if ( ttl < query->ttl )
+		query->ttl = ttl;
+}
+
+/**
+ * Construct DNS question
+ *
+ * @v query		DNS query
  * @ret rc		Return status code
  */
-static int dns_question ( struct dns_request *dns ) {
+static int dns_question ( struct dns_query *query ) {
 	static struct dns_name search_root = {
 		.data = "",
 		.len = 1,
 	};
-	struct dns_name *search = &dns->search;
+	struct dns_request *dns = query->dns;
+	struct dns_name *search = &query->search;
 	int len;
 	size_t offset;
 
@@ -531,31 +1104,32 @@ static int dns_question ( struct dns_request *dns ) {
 		search = &search_root;
 
 	/* Overwrite current suffix */
-	dns->name.offset = dns->offset;
-	len = dns_copy ( search, &dns->name );
+	query->name.offset = query->offset;
+	len = dns_copy ( search, &query->name );
 	if ( len < 0 )
 		return len;
 
 	/* Sanity check */
-	offset = ( dns->name.offset + len );
-	if ( offset > dns->name.len ) {
+	offset = ( query->name.offset + len );
+	if ( offset > query->name.len ) {
 		DBGC ( dns, "DNS %p name is too long\n", dns );
 		return -EINVAL;
 	}
 
 	/* Construct question */
-	dns->question = ( ( ( void * ) &dns->buf ) + offset );
-	dns->question->qtype = dns->qtype;
-	dns->question->qclass = htons ( DNS_CLASS_IN );
+	query->question = ( ( ( void * ) &query->buf ) + offset );
+	query->question->qtype = query->qtype;
+	query->question->qclass = htons ( DNS_CLASS_IN );
 
 	/* Store length */
-	dns->len = ( offset + sizeof ( *(dns->question) ) );
+	query->len = ( offset + sizeof ( *(query->question) ) );
 
 	/* Restore name */
-	dns->name.offset = offsetof ( typeof ( dns->buf ), name );
+	query->name.offset = offsetof ( typeof ( query->buf ), name );
 
 	DBGC2 ( dns, "DNS %p question is %s type %s\n", dns,
-		dns_name ( &dns->name ), dns_type ( dns->question->qtype ) );
+		dns_name ( &query->name ),
+		dns_type ( query->question->qtype ) );
 
 	return 0;
 }
@@ -563,25 +1137,29 @@ static int dns_question ( struct dns_request *dns ) {
 /**
  * Send DNS query
  *
- * @v dns		DNS request
+ * @v query		DNS query
  * @ret rc		Return status code
  */
-static int dns_send_packet ( struct dns_request *dns ) {
-	struct dns_header *query = &dns->buf.query;
+static int dns_send_packet ( struct dns_query *query ) {
+	struct dns_request *dns = query->dns;
+	struct dns_header *header = &query->buf.query;
+	unsigned int index = ( query - dns->query );
 
 	/* Start retransmission timer */
-	start_timer ( &dns->timer );
+	start_timer ( &query->timer );
 
-	/* Generate query identifier */
-	query->id = random();
+	/* Generate query identifier.  The low-order bits identify the
+	 * query within the request.
+	 */
+	header->id = htons ( ( random() * DNS_MAX_QUERIES ) + index );
 
 	/* Send query */
 	DBGC ( dns, "DNS %p sending query ID %#04x for %s type %s\n", dns,
-	       ntohs ( query->id ), dns_name ( &dns->name ),
-	       dns_type ( dns->question->qtype ) );
+	       ntohs ( header->id ), dns_name ( &query->name ),
+	       dns_type ( query->question->qtype ) );
 
 	/* Send the data */
-	return xfer_deliver_raw ( &dns->socket, query, dns->len );
+	return xfer_deliver_raw ( &dns->socket, header, query->len );
 }
 
 /**
@@ -591,13 +1169,13 @@ static int dns_send_packet ( struct dns_request *dns ) {
  * @v fail		Failure indicator
  */
 static void dns_timer_expired ( struct retry_timer *timer, int fail ) {
-	struct dns_request *dns =
-		container_of ( timer, struct dns_request, timer );
+	struct dns_query *query =
+		container_of ( timer, struct dns_query, timer );
 
 	if ( fail ) {
-		dns_done ( dns, -ETIMEDOUT );
+		dns_query_done ( query, -ETIMEDOUT );
 	} else {
-		dns_send_packet ( dns );
+		dns_send_packet ( query );
 	}
 }
 
@@ -613,8 +1191,10 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 			      struct io_buffer *iobuf,
 			      struct xfer_metadata *meta __unused ) {
 	struct dns_header *response = iobuf->data;
-	struct dns_header *query = &dns->buf.query;
-	unsigned int qtype = dns->question->qtype;
+	struct dns_query *query;
+	struct dns_header *header;
+	unsigned int qtype;
+	unsigned int index;
 	struct dns_name buf;
 	union dns_rr *rr;
 	int offset;
@@ -632,14 +1212,18 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 		goto done;
 	}
 
-	/* Check response ID matches query ID */
-	if ( response->id != query->id ) {
-		DBGC ( dns, "DNS %p received unexpected response ID %#04x "
-		       "(wanted %d)\n", dns, ntohs ( response->id ),
-		       ntohs ( query->id ) );
+	/* Identify query */
+	index = ( ntohs ( response->id ) % DNS_MAX_QUERIES );
+	query = &dns->query[index];
+	header = &query->buf.query;
+	if ( ( index >= dns->count ) || ( query->rc != -EINPROGRESS ) ||
+	     ( response->id != header->id ) ) {
+		DBGC ( dns, "DNS %p received unexpected response ID %#04x\n",
+		       dns, ntohs ( response->id ) );
 		rc = -EINVAL;
 		goto done;
 	}
+	qtype = query->question->qtype;
 	DBGC ( dns, "DNS %p received response ID %#04x\n",
 	       dns, ntohs ( response->id ) );
 
@@ -699,7 +1283,7 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 		}
 
 		/* Skip non-matching names */
-		if ( dns_compare ( &buf, &dns->name ) != 0 ) {
+		if ( dns_compare ( &buf, &query->name ) != 0 ) {
 			DBGC2 ( dns, "DNS %p ignoring response for %s type "
 				"%s\n", dns, dns_name ( &buf ),
 				dns_type ( rr->common.type ) );
@@ -712,43 +1296,46 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 		case htons ( DNS_TYPE_AAAA ):
 
 			/* Found the target AAAA record */
-			if ( rdlength < sizeof ( dns->address.sin6.sin6_addr )){
+			if ( rdlength <
+			     sizeof ( query->address.sin6.sin6_addr ) ) {
 				DBGC ( dns, "DNS %p received response with "
 				       "underlength AAAA\n", dns );
 				rc = -EINVAL;
 				goto done;
 			}
-			dns->address.sin6.sin6_family = AF_INET6;
-			memcpy ( &dns->address.sin6.sin6_addr,
+			query->address.sin6.sin6_family = AF_INET6;
+			memcpy ( &query->address.sin6.sin6_addr,
 				 &rr->aaaa.in6_addr,
-				 sizeof ( dns->address.sin6.sin6_addr ) );
-			dns_resolved ( dns );
+				 sizeof ( query->address.sin6.sin6_addr ) );
+			dns_ttl ( query, rr );
+			dns_query_done ( query, 0 );
 			rc = 0;
 			goto done;
 
 		case htons ( DNS_TYPE_A ):
 
 			/* Found the target A record */
-			if ( rdlength < sizeof ( dns->address.sin.sin_addr ) ) {
+			if ( rdlength < sizeof ( query->address.sin.sin_addr ) ){
 				DBGC ( dns, "DNS %p received response with "
 				       "underlength A\n", dns );
 				rc = -EINVAL;
 				goto done;
 			}
-			dns->address.sin.sin_family = AF_INET;
-			dns->address.sin.sin_addr = rr->a.in_addr;
-			dns_resolved ( dns );
+			query->address.sin.sin_family = AF_INET;
+			query->address.sin.sin_addr = rr->a.in_addr;
+			dns_ttl ( query, rr );
+			dns_query_done ( query, 0 );
 			rc = 0;
 			goto done;
 
 		case htons ( DNS_TYPE_CNAME ):
 
-			/* Terminate the operation if we recurse too far */
-			if ( ++dns->recursion > DNS_MAX_CNAME_RECURSION ) {
+			/* Terminate the query if we recurse too far */
+			if ( ++query->recursion > DNS_MAX_CNAME_RECURSION ) {
 				DBGC ( dns, "DNS %p recursion exceeded\n",
 				       dns );
 				rc = -ELOOP;
-				dns_done ( dns, rc );
+				dns_query_done ( query, rc );
 				goto done;
 			}
 
@@ -756,12 +1343,14 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 			buf.offset = ( offset + sizeof ( rr->cname ) );
 			DBGC ( dns, "DNS %p found CNAME %s\n",
 			       dns, dns_name ( &buf ) );
-			dns->search.offset = dns->search.len;
-			name_len = dns_copy ( &buf, &dns->name );
-			dns->offset = ( offsetof ( typeof ( dns->buf ), name ) +
-					name_len - 1 /* Strip root label */ );
-			if ( ( rc = dns_question ( dns ) ) != 0 ) {
-				dns_done ( dns, rc );
+			dns_ttl ( query, rr );
+			query->search.offset = query->search.len;
+			name_len = dns_copy ( &buf, &query->name );
+			query->offset = ( offsetof ( typeof ( query->buf ),
+						     name ) +
+					  name_len - 1 /* Strip root label */ );
+			if ( ( rc = dns_question ( query ) ) != 0 ) {
+				dns_query_done ( query, rc );
 				goto done;
 			}
 			next_offset = answer_offset;
@@ -776,10 +1365,10 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 
 	/* Stop the retry timer.  After this point, each code path
 	 * must either restart the timer by calling dns_send_packet(),
-	 * or mark the DNS operation as complete by calling
-	 * dns_done()
+	 * or mark the DNS query as complete by calling
+	 * dns_query_done()
 	 */
-	stop_timer ( &dns->timer );
+	stop_timer ( &query->timer );
 
 	/* Determine what to do next based on the type of query we
 	 * issued and the response we received
@@ -787,22 +1376,14 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 	switch ( qtype ) {
 
 	case htons ( DNS_TYPE_AAAA ):
-		/* We asked for an AAAA record and got nothing; try
-		 * the A.
-		 */
-		DBGC ( dns, "DNS %p found no AAAA record; trying A\n", dns );
-		dns->question->qtype = htons ( DNS_TYPE_A );
-		dns_send_packet ( dns );
-		rc = 0;
-		goto done;
-
 	case htons ( DNS_TYPE_A ):
-		/* We asked for an A record and got nothing;
+		/* We asked for an AAAA or A record and got nothing;
 		 * try the CNAME.
 		 */
-		DBGC ( dns, "DNS %p found no A record; trying CNAME\n", dns );
-		dns->question->qtype = htons ( DNS_TYPE_CNAME );
-		dns_send_packet ( dns );
+		DBGC ( dns, "DNS %p found no %s record; trying CNAME\n",
+		       dns, dns_type ( qtype ) );
+		query->question->qtype = htons ( DNS_TYPE_CNAME );
+		dns_send_packet ( query );
 		rc = 0;
 		goto done;
 
@@ -811,19 +1392,19 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 		 * (i.e. if the next AAAA/A query is already set up),
 		 * then issue it.
 		 */
-		if ( qtype == dns->qtype ) {
-			dns_send_packet ( dns );
+		if ( qtype == query->qtype ) {
+			dns_send_packet ( query );
 			rc = 0;
 			goto done;
 		}
 
 		/* If we have already reached the end of the search list,
-		 * then terminate lookup.
+		 * then terminate query.
 		 */
-		if ( dns->search.offset == dns->search.len ) {
+		if ( query->search.offset == query->search.len ) {
 			DBGC ( dns, "DNS %p found no CNAME record\n", dns );
 			rc = -ENXIO_NO_RECORD;
-			dns_done ( dns, rc );
+			dns_query_done ( query, rc );
 			goto done;
 		}
 
@@ -832,18 +1413,18 @@ static int dns_xfer_deliver ( struct dns_request *dns,
 		 */
 		DBGC ( dns, "DNS %p found no CNAME record; trying next "
 		       "suffix\n", dns );
-		dns->search.offset = dns_skip_search ( &dns->search );
-		if ( ( rc = dns_question ( dns ) ) != 0 ) {
-			dns_done ( dns, rc );
+		query->search.offset = dns_skip_search ( &query->search );
+		if ( ( rc = dns_question ( query ) ) != 0 ) {
+			dns_query_done ( query, rc );
 			goto done;
 		}
-		dns_send_packet ( dns );
+		dns_send_packet ( query );
 		goto done;
 
 	default:
 		assert ( 0 );
 		rc = -EINVAL;
-		dns_done ( dns, rc );
+		dns_query_done ( query, rc );
 		goto done;
 	}
 
@@ -893,13 +1474,22 @@ static struct interface_descriptor dns_resolv_desc =
  * @v name		Name to resolve
  * @v sa		Socket address to fill in
  * @ret rc		Return status code
+ *
+ * If the nameserver is reachable via IPv6, then queries for the AAAA
+ * and A records are issued concurrently, with the AAAA record being
+ * preferred.
  */
 static int dns_resolv ( struct interface *resolv,
 			const char *name, struct sockaddr *sa ) {
 	struct dns_request *dns;
-	struct dns_header *query;
+	struct dns_cache_entry *entry;
+	struct dns_query *query;
+	struct dns_header *header;
+	size_t name_len = ( strlen ( name ) + 1 );
 	size_t search_len;
-	int name_len;
+	void *search;
+	unsigned int i;
+	int encoded_len;
 	int rc;
 
 	/* Fail immediately if no DNS servers */
@@ -910,11 +1500,15 @@ static int dns_resolv ( struct interface *resolv,
 		goto err_no_nameserver;
 	}
 
+	/* Check for a cached response */
+	entry = dns_cache_find ( name );
+
 	/* Determine whether or not to use search list */
-	search_len = ( strchr ( name, '.' ) ? 0 : dns_search.len );
+	search_len = ( ( entry || strchr ( name, '.' ) ) ?
+		       0 : dns_search.len );
 
 	/* Allocate DNS structure */
-	dns = zalloc ( sizeof ( *dns ) + search_len );
+	dns = zalloc ( sizeof ( *dns ) + name_len + search_len );
 	if ( ! dns ) {
 		rc = -ENOMEM;
 		goto err_alloc_dns;
@@ -922,41 +1516,81 @@ static int dns_resolv ( struct interface *resolv,
 	ref_init ( &dns->refcnt, NULL );
 	intf_init ( &dns->resolv, &dns_resolv_desc, &dns->refcnt );
 	intf_init ( &dns->socket, &dns_socket_desc, &dns->refcnt );
-	timer_init ( &dns->timer, dns_timer_expired, &dns->refcnt );
-	memcpy ( &dns->address.sa, sa, sizeof ( dns->address.sa ) );
-	dns->search.data = ( ( ( void * ) dns ) + sizeof ( *dns ) );
-	dns->search.len = search_len;
-	memcpy ( dns->search.data, dns_search.data, search_len );
+	timer_init ( &dns->delay, dns_delay_expired, &dns->refcnt );
+	process_init_stopped ( &dns->process, &dns_process_desc,
+			       &dns->refcnt );
+	dns->name = ( ( ( void * ) dns ) + sizeof ( *dns ) );
+	memcpy ( dns->name, name, name_len );
+	search = ( ( ( void * ) dns->name ) + name_len );
+	memcpy ( search, dns_search.data, search_len );
+	for ( i = 0 ; i < DNS_MAX_QUERIES ; i++ ) {
+		query = &dns->query[i];
+		query->dns = dns;
+		timer_init ( &query->timer, dns_timer_expired, &dns->refcnt );
+		query->rc = -EINPROGRESS;
+		memcpy ( &query->address.sa, sa,
+			 sizeof ( query->address.sa ) );
+	}
 
-	/* Determine initial query type */
+	/* Use cached response, if available */
+	if ( entry ) {
+		DBGC ( dns, "DNS %p using cached response for \"%s\"\n",
+		       dns, name );
+		query = &dns->query[0];
+		query->rc = entry->rc;
+		switch ( entry->address.sa.sa_family ) {
+		case AF_INET:
+			query->address.sin.sin_family = AF_INET;
+			query->address.sin.sin_addr =
+				entry->address.sin.sin_addr;
+			break;
+		case AF_INET6:
+			query->address.sin6.sin6_family = AF_INET6;
+			memcpy ( &query->address.sin6.sin6_addr,
+				 &entry->address.sin6.sin6_addr,
+				 sizeof ( query->address.sin6.sin6_addr ) );
+			break;
+		}
+		process_add ( &dns->process );
+		goto attach;
+	}
+
+	/* Determine query types, in order of preference */
 	switch ( nameserver.sa.sa_family ) {
 	case AF_INET:
-		dns->qtype = htons ( DNS_TYPE_A );
+		dns->query[dns->count++].qtype = htons ( DNS_TYPE_A );
 		break;
 	case AF_INET6:
-		dns->qtype = htons ( DNS_TYPE_AAAA );
+		dns->query[dns->count++].qtype = htons ( DNS_TYPE_AAAA );
+		dns->query[dns->count++].qtype = htons ( DNS_TYPE_A );
 		break;
 	default:
 		rc = -ENOTSUP;
 		goto err_type;
 	}
 
-	/* Construct query */
-	query = &dns->buf.query;
-	query->flags = htons ( DNS_FLAG_RD );
-	query->qdcount = htons ( 1 );
-	dns->name.data = &dns->buf;
-	dns->name.offset = offsetof ( typeof ( dns->buf ), name );
-	dns->name.len = offsetof ( typeof ( dns->buf ), padding );
-	name_len = dns_encode ( name, &dns->name );
-	if ( name_len < 0 ) {
-		rc = name_len;
-		goto err_encode;
+	/* Construct queries */
+	for ( i = 0 ; i < dns->count ; i++ ) {
+		query = &dns->query[i];
+		query->search.data = search;
+		query->search.len = search_len;
+		query->ttl = DNS_CACHE_MAX_TTL;
+		header = &query->buf.query;
+		header->flags = htons ( DNS_FLAG_RD );
+		header->qdcount = htons ( 1 );
+		query->name.data = &query->buf;
+		query->name.offset = offsetof ( typeof ( query->buf ), name );
+		query->name.len = offsetof ( typeof ( query->buf ), padding );
+		encoded_len = dns_encode ( name, &query->name );
+		if ( encoded_len < 0 ) {
+			rc = encoded_len;
+			goto err_encode;
+		}
+		query->offset = ( offsetof ( typeof ( query->buf ), name ) +
+				  encoded_len - 1 /* Strip root label */ );
+		if ( ( rc = dns_question ( query ) ) != 0 )
+			goto err_question;
 	}
-	dns->offset = ( offsetof ( typeof ( dns->buf ), name ) +
-			name_len - 1 /* Strip root label */ );
-	if ( ( rc = dns_question ( dns ) ) != 0 )
-		goto err_question;
 
 	/* Open UDP connection */
 	if ( ( rc = xfer_open_socket ( &dns->socket, SOCK_DGRAM,
@@ -966,9 +1600,12 @@ static int dns_resolv ( struct interface *resolv,
 		goto err_open_socket;
 	}
 
-	/* Start timer to trigger first packet */
-	start_timer_nodelay ( &dns->timer );
+	/* Start timers to trigger first packets */
+	for ( i = 0 ; i < dns->count ; i++ )
+		start_timer_nodelay ( &dns->query[i].timer );
+	timeline_record ( "dns", "query", name, 0 );
 
+ attach:
 	/* Attach parent interface, mortalise self, and return */
 	intf_plug_plug ( &dns->resolv, resolv );
 	ref_put ( &dns->refcnt );
@@ -1114,6 +1751,13 @@ static void apply_dns_search ( void ) {
  * @ret rc		Return status code
  */
 static int apply_dns_settings ( void ) {
+	typeof ( nameserver ) old_nameserver;
+	struct dns_name old_search;
+
+	/* Record existing DNS server address and search list */
+	memcpy ( &old_nameserver, &nameserver, sizeof ( old_nameserver ) );
+	memcpy ( &old_search, &dns_search, sizeof ( old_search ) );
+	dns_search.data = NULL;
 
 	/* Fetch DNS server address */
 	nameserver.sa.sa_family = 0;
@@ -1147,6 +1791,22 @@ static int apply_dns_settings ( void ) {
 		DBG ( "\n" );
 	}
 
+	/* Flush cached responses if the DNS server address or search
+	 * list has changed.
+	 */
+	if ( ( memcmp ( &nameserver, &old_nameserver,
+			sizeof ( nameserver ) ) != 0 ) ||
+	     ( dns_search.len != old_search.len ) ||
+	     ( memcmp ( dns_search.data, old_search.data,
+			dns_search.len ) != 0 ) ) {
+		DBG ( "DNS flushing cache\n" );
+		dns_cache_flush();
+	}
+	free ( old_search.data );
+
+	/* Use any handed over cached responses */
+	dns_handover_apply();
+
 	return 0;
 }
 
@@ -0,0 +1,631 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <byteswap.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/bitmap.h>
+#include <ipxe/xfer.h>
+#include <ipxe/open.h>
+#include <ipxe/uri.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/timer.h>
+#include <ipxe/retry.h>
+#include <ipxe/umalloc.h>
+#include <ipxe/uaccess.h>
+#include <ipxe/fec.h>
+#include <ipxe/mcfec.h>
+
+/** @file
+ *
+ * Multicast file transfer with forward error correction
+ *
+ * A server transmits a file to a multicast group repeatedly (as a
+ * "data carousel"), and receivers simply listen until they have
+ * collected enough data to reconstruct the whole file.  Receivers
+ * never transmit anything, and so the protocol scales to an
+ * arbitrary number of receivers regardless of how independent their
+ * packet losses may be.
+ *
+ * The file is divided into source blocks, each of which consists of
+ * (at most) k source symbols of a fixed length.  The final symbol is
+ * padded with zeroes.  For each source block, the server transmits
+ * the source symbols along with some number of repair symbols
+ * constructed using a Reed-Solomon erasure code (see fec.c).  Any k
+ * distinct symbols from a source block are sufficient to reconstruct
+ * that block, so a receiver that misses a few packets from a block
+ * can usually recover them from the same pass of the carousel rather
+ * than waiting for the next.
+ *
+ * Every packet consists of a struct mcfec_header followed by exactly
+ * one encoding symbol.  A receiver locks on to the first session
+ * that it sees, and ignores packets from any other session.
+ *
+ */
+
+/** A block being received */
+struct mcfec_block {
+	/** List of blocks being received */
+	struct list_head list;
+	/** Source block number */
+	unsigned long number;
+	/** Number of source symbols in this block */
+	unsigned int k;
+	/** Number of source symbols received */
+	unsigned int sources;
+	/** Number of repair symbols received */
+	unsigned int repairs;
+	/** Encoding symbols received */
+	uint8_t seen[ FEC_MAX_SYMBOLS / 8 ];
+	/** Encoding symbol indices of received repair symbols */
+	uint8_t index[FEC_MAX_SYMBOLS];
+	/** Symbol storage
+	 *
+	 * This holds k source symbols followed by space for up to k
+	 * repair symbols.
+	 */
+	userptr_t data;
+};
+
+/** A multicast FEC request */
+struct mcfec_request {
+	/** Reference counter */
+	struct refcnt refcnt;
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Multicast socket */
+	struct interface socket;
+	/** Idle timer */
+	struct retry_timer timer;
+
+	/** Session identifier (valid only if @c symbol_len is set) */
+	uint32_t session;
+	/** Total length of file */
+	size_t len;
+	/** Symbol length */
+	size_t symbol_len;
+	/** Number of source symbols per source block */
+	unsigned int k;
+	/** Number of source blocks */
+	unsigned long num_blocks;
+	/** Completed source blocks */
+	struct bitmap done;
+	/** Blocks being received (most recently started first) */
+	struct list_head blocks;
+	/** Number of blocks being received */
+	unsigned int count;
+};
+
+/**
+ * Free block
+ *
+ * @v mcfec		Multicast FEC request
+ * @v block		Block
+ */
+static void mcfec_block_free ( struct mcfec_request *mcfec,
+			       struct mcfec_block *block ) {
+
+	list_del ( &block->list );
+	mcfec->count--;
+	ufree ( block->data );
+	free ( block );
+}
+
+/**
+ * Free multicast FEC request
+ *
+ * @v refcnt		Reference counter
+ */
+static void mcfec_free ( struct refcnt *refcnt ) {
+	struct mcfec_request *mcfec =
+		container_of ( refcnt, struct mcfec_request, refcnt );
+	struct mcfec_block *block;
+	struct mcfec_block *tmp;
+
+	list_for_each_entry_safe ( block, tmp, &mcfec->blocks, list )
+		mcfec_block_free ( mcfec, block );
+	bitmap_free ( &mcfec->done );
+	free ( mcfec );
+}
+
+/**
+ * Mark multicast FEC request as complete
+ *
+ * @v mcfec		Multicast FEC request
+ * @v rc		Return status code
+ */
+static void mcfec_finished ( struct mcfec_request *mcfec, int rc ) {
+
+	DBGC ( mcfec, "MCFEC %p finished: %s\n", mcfec, strerror ( rc ) );
+
+	/* Stop the idle timer */
+	stop_timer ( &mcfec->timer );
+
+	/* Close all data transfer interfaces */
+	intf_shutdown ( &mcfec->socket, rc );
+	intf_shutdown ( &mcfec->xfer, rc );
+}
+
+/**
+ * Handle idle timer expiry
+ *
+ * @v timer		Idle timer
+ * @v fail		Failure indicator
+ */
+static void mcfec_expired ( struct retry_timer *timer, int fail __unused ) {
+	struct mcfec_request *mcfec =
+		container_of ( timer, struct mcfec_request, timer );
+
+	DBGC ( mcfec, "MCFEC %p timed out with %d/%ld blocks complete\n",
+	       mcfec, bitmap_first_gap ( &mcfec->done ), mcfec->num_blocks );
+	mcfec_finished ( mcfec, -ETIMEDOUT );
+}
+
+/**
+ * Lock on to (or check) session
+ *
+ * @v mcfec		Multicast FEC request
+ * @v hdr		Packet header
+ * @ret rc		Return status code
+ */
+static int mcfec_session ( struct mcfec_request *mcfec,
+			   const struct mcfec_header *hdr ) {
+	uint32_t session = be32_to_cpu ( hdr->session );
+	uint64_t len = be64_to_cpu ( hdr->len );
+	size_t symbol_len = be16_to_cpu ( hdr->symbol_len );
+	size_t block_len;
+	int rc;
+
+	/* Check existing session, if any */
+	if ( mcfec->symbol_len ) {
+		if ( session != mcfec->session )
+			return -EPIPE;
+		if ( ( len != mcfec->len ) ||
+		     ( symbol_len != mcfec->symbol_len ) ||
+		     ( hdr->k != mcfec->k ) ) {
+			DBGC ( mcfec, "MCFEC %p session %#08x parameters "
+			       "changed\n", mcfec, session );
+			return -EINVAL;
+		}
+		return 0;
+	}
+
+	/* Sanity checks */
+	if ( ( len == 0 ) || ( symbol_len == 0 ) || ( hdr->k == 0 ) ) {
+		DBGC ( mcfec, "MCFEC %p session %#08x invalid length %lld, "
+		       "k=%d, symbol length %zd\n", mcfec, session,
+		       ( ( unsigned long long ) len ), hdr->k, symbol_len );
+		return -EINVAL;
+	}
+	if ( len != ( ( size_t ) len ) ) {
+		DBGC ( mcfec, "MCFEC %p session %#08x file too large\n",
+		       mcfec, session );
+		return -EFBIG;
+	}
+
+	/* Record session parameters */
+	mcfec->session = session;
+	mcfec->len = len;
+	mcfec->symbol_len = symbol_len;
+	mcfec->k = hdr->k;
+	block_len = ( mcfec->k * mcfec->symbol_len );
+	mcfec->num_blocks = ( ( mcfec->len + block_len - 1 ) / block_len );
+	DBGC ( mcfec, "MCFEC %p session %#08x has length %zd, %ld blocks of "
+	       "%d %zd-byte symbols\n", mcfec, session, mcfec->len,
+	       mcfec->num_blocks, mcfec->k, mcfec->symbol_len );
+
+	/* Allocate completed block bitmap */
+	if ( ( rc = bitmap_resize ( &mcfec->done, mcfec->num_blocks ) ) != 0){
+		DBGC ( mcfec, "MCFEC %p could not allocate bitmap for %ld "
+		       "blocks: %s\n", mcfec, mcfec->num_blocks,
+		       strerror ( rc ) );
+		return rc;
+	}
+
+	/* Notify recipient of file size */
+	xfer_presize ( &mcfec->xfer, mcfec->len );
+
+	return 0;
+}
+
+/**
+ * Calculate file offset of source symbol
+ *
+ * @v mcfec		Multicast FEC request
+ * @v number		Source block number
+ * @v index		Source symbol index
+ * @ret offset		Offset within file
+ */
+static size_t mcfec_offset ( struct mcfec_request *mcfec,
+			     unsigned long number, unsigned int index ) {
+
+	return ( ( ( number * mcfec->k ) + index ) * mcfec->symbol_len );
+}
+
+/**
+ * Calculate length of source symbol data (excluding padding)
+ *
+ * @v mcfec		Multicast FEC request
+ * @v offset		Offset within file
+ * @ret len		Length of data
+ */
+static size_t mcfec_data_len ( struct mcfec_request *mcfec, size_t offset ) {
+	size_t remaining = ( mcfec->len - offset );
+
+	return ( ( remaining < mcfec->symbol_len ) ?
+		 remaining : mcfec->symbol_len );
+}
+
+/**
+ * Find (or start receiving) block
+ *
+ * @v mcfec		Multicast FEC request
+ * @v number		Source block number
+ * @ret block		Block, or NULL on error
+ */
+static struct mcfec_block * mcfec_block ( struct mcfec_request *mcfec,
+					  unsigned long number ) {
+	struct mcfec_block *block;
+	size_t remaining;
+
+	/* Find existing block, if any */
+	list_for_each_entry ( block, &mcfec->blocks, list ) {
+		if ( block->number == number )
+			return block;
+	}
+
+	/* Discard least recently started block, if necessary.  Any
+	 * symbols received for this block will be retransmitted on
+	 * the next pass of the carousel.
+	 */
+	if ( mcfec->count >= MCFEC_MAX_BLOCKS ) {
+		block = list_last_entry ( &mcfec->blocks, struct mcfec_block,
+					  list );
+		DBGC ( mcfec, "MCFEC %p abandoning block %ld with %d/%d "
+		       "symbols\n", mcfec, block->number,
+		       ( block->sources + block->repairs ), block->k );
+		mcfec_block_free ( mcfec, block );
+	}
+
+	/* Allocate and initialise block */
+	block = zalloc ( sizeof ( *block ) );
+	if ( ! block )
+		return NULL;
+	block->number = number;
+	remaining = ( mcfec->len - mcfec_offset ( mcfec, number, 0 ) );
+	block->k = ( ( remaining + mcfec->symbol_len - 1 ) /
+		     mcfec->symbol_len );
+	if ( block->k > mcfec->k )
+		block->k = mcfec->k;
+	block->data = umalloc ( 2 * block->k * mcfec->symbol_len );
+	if ( ! block->data ) {
+		free ( block );
+		return NULL;
+	}
+	list_add ( &block->list, &mcfec->blocks );
+	mcfec->count++;
+
+	return block;
+}
+
+/**
+ * Reconstruct and deliver missing source symbols
+ *
+ * @v mcfec		Multicast FEC request
+ * @v block		Block
+ * @ret rc		Return status code
+ */
+static int mcfec_recover ( struct mcfec_request *mcfec,
+			   struct mcfec_block *block ) {
+	struct xfer_metadata meta;
+	struct io_buffer *iobuf;
+	unsigned int count = ( block->k - block->sources );
+	uint8_t missing[count];
+	void **source;
+	void **repair;
+	unsigned int i;
+	unsigned int j;
+	size_t offset;
+	size_t len;
+	int rc;
+
+	/* Allocate symbol pointer lists */
+	source = malloc ( ( block->k + count ) * sizeof ( source[0] ) );
+	if ( ! source ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	repair = &source[block->k];
+
+	/* Construct symbol pointer lists */
+	for ( i = 0, j = 0 ; i < block->k ; i++ ) {
+		source[i] = user_to_virt ( block->data,
+					   ( i * mcfec->symbol_len ) );
+		if ( ! ( block->seen[ i / 8 ] & ( 1 << ( i % 8 ) ) ) )
+			missing[j++] = i;
+	}
+	assert ( j == count );
+	for ( i = 0 ; i < count ; i++ ) {
+		repair[i] = user_to_virt ( block->data,
+					   ( ( block->k + i ) *
+					     mcfec->symbol_len ) );
+	}
+
+	/* Reconstruct missing source symbols */
+	if ( ( rc = fec_decode ( block->k, source, missing, repair,
+				 block->index, count,
+				 mcfec->symbol_len ) ) != 0 ) {
+		DBGC ( mcfec, "MCFEC %p could not decode block %ld: %s\n",
+		       mcfec, block->number, strerror ( rc ) );
+		goto err_decode;
+	}
+	DBGC2 ( mcfec, "MCFEC %p recovered %d symbols in block %ld\n",
+		mcfec, count, block->number );
+
+	/* Deliver reconstructed source symbols */
+	for ( i = 0 ; i < count ; i++ ) {
+		offset = mcfec_offset ( mcfec, block->number, missing[i] );
+		len = mcfec_data_len ( mcfec, offset );
+		iobuf = xfer_alloc_iob ( &mcfec->xfer, len );
+		if ( ! iobuf ) {
+			rc = -ENOMEM;
+			goto err_alloc_iob;
+		}
+		memcpy ( iob_put ( iobuf, len ), source[ missing[i] ], len );
+		memset ( &meta, 0, sizeof ( meta ) );
+		meta.flags = XFER_FL_ABS_OFFSET;
+		meta.offset = offset;
+		if ( ( rc = xfer_deliver ( &mcfec->xfer, iobuf,
+					   &meta ) ) != 0 )
+			goto err_deliver;
+	}
+
+	/* Success */
+	rc = 0;
+
+ err_deliver:
+ err_alloc_iob:
+ err_decode:
+	free ( source );
+ err_alloc:
+	return rc;
+}
+
+/**
+ * Receive packet
+ *
+ * @v mcfec		Multicast FEC request
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int mcfec_deliver ( struct mcfec_request *mcfec,
+			   struct io_buffer *iobuf,
+			   struct xfer_metadata *meta __unused ) {
+	const struct mcfec_header *hdr = iobuf->data;
+	struct xfer_metadata data_meta;
+	struct mcfec_block *block;
+	unsigned long number;
+	unsigned int index;
+	unsigned int bit;
+	size_t offset;
+	void *slot;
+	int is_source;
+	int rc;
+
+	/* Sanity checks */
+	if ( iob_len ( iobuf ) < sizeof ( *hdr ) ) {
+		DBGC ( mcfec, "MCFEC %p underlength packet:\n", mcfec );
+		DBGC_HDA ( mcfec, 0, iobuf->data, iob_len ( iobuf ) );
+		rc = -EINVAL;
+		goto err_discard;
+	}
+	if ( hdr->version != MCFEC_VERSION ) {
+		DBGC ( mcfec, "MCFEC %p unsupported version %d\n",
+		       mcfec, hdr->version );
+		rc = -ENOTSUP;
+		goto err_discard;
+	}
+
+	/* Identify session */
+	if ( ( rc = mcfec_session ( mcfec, hdr ) ) != 0 )
+		goto err_discard;
+
+	/* Restart idle timer */
+	start_timer_fixed ( &mcfec->timer, MCFEC_TIMEOUT );
+
+	/* Identify encoding symbol */
+	number = be32_to_cpu ( hdr->block );
+	index = hdr->index;
+	iob_pull ( iobuf, sizeof ( *hdr ) );
+	if ( number >= mcfec->num_blocks ) {
+		DBGC ( mcfec, "MCFEC %p received out-of-range block %ld "
+		       "(num_blocks=%ld)\n", mcfec, number, mcfec->num_blocks );
+		rc = -ERANGE;
+		goto err_discard;
+	}
+	if ( iob_len ( iobuf ) != mcfec->symbol_len ) {
+		DBGC ( mcfec, "MCFEC %p received %zd-byte symbol (expected "
+		       "%zd bytes)\n", mcfec, iob_len ( iobuf ),
+		       mcfec->symbol_len );
+		rc = -EINVAL;
+		goto err_discard;
+	}
+
+	/* Ignore symbols for completed blocks */
+	if ( bitmap_test ( &mcfec->done, number ) )
+		goto discard;
+
+	/* Find block */
+	block = mcfec_block ( mcfec, number );
+	if ( ! block ) {
+		DBGC ( mcfec, "MCFEC %p could not allocate block %ld\n",
+		       mcfec, number );
+		rc = -ENOMEM;
+		goto err_block;
+	}
+
+	/* Ignore duplicate symbols */
+	bit = ( 1 << ( index % 8 ) );
+	if ( block->seen[ index / 8 ] & bit )
+		goto discard;
+	block->seen[ index / 8 ] |= bit;
+
+	/* Store symbol */
+	is_source = ( index < block->k );
+	if ( is_source ) {
+		slot = user_to_virt ( block->data,
+				      ( index * mcfec->symbol_len ) );
+		block->sources++;
+	} else {
+		block->index[block->repairs] = index;
+		slot = user_to_virt ( block->data,
+				      ( ( block->k + block->repairs ) *
+					mcfec->symbol_len ) );
+		block->repairs++;
+	}
+	memcpy ( slot, iobuf->data, mcfec->symbol_len );
+
+	/* Complete block, if possible */
+	if ( ( block->sources + block->repairs ) == block->k ) {
+		if ( ( rc = mcfec_recover ( mcfec, block ) ) != 0 )
+			goto err_recover;
+		bitmap_set ( &mcfec->done, number );
+		mcfec_block_free ( mcfec, block );
+	}
+
+	/* Deliver source symbol, or discard repair symbol */
+	if ( is_source ) {
+		offset = mcfec_offset ( mcfec, number, index );
+		iob_unput ( iobuf, ( mcfec->symbol_len -
+				     mcfec_data_len ( mcfec, offset ) ) );
+		memset ( &data_meta, 0, sizeof ( data_meta ) );
+		data_meta.flags = XFER_FL_ABS_OFFSET;
+		data_meta.offset = offset;
+		if ( ( rc = xfer_deliver ( &mcfec->xfer, iob_disown ( iobuf ),
+					   &data_meta ) ) != 0 )
+			goto err_deliver;
+	} else {
+		free_iob ( iobuf );
+	}
+
+	/* Terminate when all blocks are complete */
+	if ( bitmap_full ( &mcfec->done ) )
+		mcfec_finished ( mcfec, 0 );
+
+	return 0;
+
+ err_deliver:
+ err_recover:
+ err_block:
+	mcfec_finished ( mcfec, rc );
+ err_discard:
+ discard:
+	free_iob ( iobuf );
+	return rc;
+}
+
+/** Multicast FEC socket interface operations */
+static struct interface_operation mcfec_socket_operations[] = {
+	INTF_OP ( xfer_deliver, struct mcfec_request *, mcfec_deliver ),
+	INTF_OP ( intf_close, struct mcfec_request *, mcfec_finished ),
+};
+
+/** Multicast FEC socket interface descriptor */
+static struct interface_descriptor mcfec_socket_desc =
+	INTF_DESC ( struct mcfec_request, socket, mcfec_socket_operations );
+
+/** Multicast FEC data transfer interface operations */
+static struct interface_operation mcfec_xfer_operations[] = {
+	INTF_OP ( intf_close, struct mcfec_request *, mcfec_finished ),
+};
+
+/** Multicast FEC data transfer interface descriptor */
+static struct interface_descriptor mcfec_xfer_desc =
+	INTF_DESC ( struct mcfec_request, xfer, mcfec_xfer_operations );
+
+/**
+ * Initiate a multicast FEC request
+ *
+ * @v xfer		Data transfer interface
+ * @v uri		Uniform Resource Identifier
+ * @ret rc		Return status code
+ */
+static int mcfec_open ( struct interface *xfer, struct uri *uri ) {
+	struct mcfec_request *mcfec;
+	union {
+		struct sockaddr sa;
+		struct sockaddr_tcpip st;
+	} multicast;
+	int rc;
+
+	/* Sanity checks */
+	if ( ! uri->host )
+		return -EINVAL;
+
+	/* Parse multicast address */
+	memset ( &multicast, 0, sizeof ( multicast ) );
+	if ( ( rc = sock_aton ( uri->host, &multicast.sa ) ) != 0 )
+		return rc;
+	multicast.st.st_port = htons ( uri_port ( uri, MCFEC_DEFAULT_PORT ) );
+
+	/* Allocate and populate structure */
+	mcfec = zalloc ( sizeof ( *mcfec ) );
+	if ( ! mcfec )
+		return -ENOMEM;
+	ref_init ( &mcfec->refcnt, mcfec_free );
+	intf_init ( &mcfec->xfer, &mcfec_xfer_desc, &mcfec->refcnt );
+	intf_init ( &mcfec->socket, &mcfec_socket_desc, &mcfec->refcnt );
+	timer_init ( &mcfec->timer, mcfec_expired, &mcfec->refcnt );
+	INIT_LIST_HEAD ( &mcfec->blocks );
+
+	/* Open multicast socket */
+	if ( ( rc = xfer_open_socket ( &mcfec->socket, SOCK_DGRAM,
+				       &multicast.sa, &multicast.sa ) ) != 0 ) {
+		DBGC ( mcfec, "MCFEC %p could not open multicast socket: %s\n",
+		       mcfec, strerror ( rc ) );
+		goto err;
+	}
+
+	/* Start idle timer */
+	start_timer_fixed ( &mcfec->timer, MCFEC_TIMEOUT );
+
+	/* Attach to parent interface, mortalise self, and return */
+	intf_plug_plug ( &mcfec->xfer, xfer );
+	ref_put ( &mcfec->refcnt );
+	return 0;
+
+ err:
+	mcfec_finished ( mcfec, rc );
+	ref_put ( &mcfec->refcnt );
+	return rc;
+}
+
+/** Multicast FEC URI opener */
+struct uri_opener mcfec_uri_opener __uri_opener = {
+	.scheme	= "x-mcfec",
+	.open	= mcfec_open,
+};
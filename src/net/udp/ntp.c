@@ -273,3 +273,164 @@ int start_ntp ( struct interface *job, const char *hostname ) {
  err_alloc:
 	return rc;
 }
+
+/******************************************************************************
+ *
+ * Synchronisation against multiple servers
+ *
+ ******************************************************************************
+ */
+
+/** An NTP synchronisation
+ *
+ * A synchronisation races an NTP client against each of several
+ * servers.  The first server to respond is used to set the system
+ * clock, and all other clients are then cancelled.
+ */
+struct ntp_sync {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Job control interface */
+	struct interface job;
+	/** Synchronisation is in progress */
+	int pending;
+	/** Number of clients still in progress */
+	unsigned int remaining;
+	/** Most recent client failure */
+	int rc;
+	/** Number of clients */
+	unsigned int count;
+	/** Client job control interfaces */
+	struct interface clients[0];
+};
+
+/**
+ * Finish NTP synchronisation
+ *
+ * @v sync		NTP synchronisation
+ * @v rc		Reason for finish
+ */
+static void ntp_sync_finished ( struct ntp_sync *sync, int rc ) {
+	unsigned int i;
+
+	/* Record completion */
+	if ( sync->pending ) {
+		sync->pending = 0;
+		time_sync_pending--;
+	}
+
+	/* Cancel any remaining clients */
+	for ( i = 0 ; i < sync->count ; i++ )
+		intf_shutdown ( &sync->clients[i], rc );
+
+	/* Shut down job control interface */
+	intf_shutdown ( &sync->job, rc );
+}
+
+/**
+ * Handle NTP client completion
+ *
+ * @v intf		Client job control interface
+ * @v rc		Reason for close
+ */
+static void ntp_sync_close ( struct interface *intf, int rc ) {
+	struct ntp_sync *sync =
+		container_of ( intf->refcnt, struct ntp_sync, refcnt );
+
+	/* Unplug client */
+	intf_restart ( intf, rc );
+
+	/* Finish if the clock is now set, or if all clients failed */
+	if ( rc == 0 ) {
+		DBGC ( sync, "NTP %p synchronised via client %d\n",
+		       sync, ( ( int ) ( intf - sync->clients ) ) );
+		ntp_sync_finished ( sync, 0 );
+	} else {
+		sync->rc = rc;
+		if ( sync->remaining && ( --sync->remaining == 0 ) )
+			ntp_sync_finished ( sync, sync->rc );
+	}
+}
+
+/** NTP client interface operations */
+static struct interface_operation ntp_sync_client_op[] = {
+	INTF_OP ( intf_close, struct interface *, ntp_sync_close ),
+};
+
+/** NTP client interface descriptor */
+static struct interface_descriptor ntp_sync_client_desc =
+	INTF_DESC_PURE ( ntp_sync_client_op );
+
+/** Job control interface operations */
+static struct interface_operation ntp_sync_job_op[] = {
+	INTF_OP ( intf_close, struct ntp_sync *, ntp_sync_finished ),
+};
+
+/** Job control interface descriptor */
+static struct interface_descriptor ntp_sync_job_desc =
+	INTF_DESC ( struct ntp_sync, job, ntp_sync_job_op );
+
+/**
+ * Start NTP synchronisation against multiple servers
+ *
+ * @v job		Job control interface, or NULL to run in background
+ * @v hostnames		NTP servers
+ * @v count		Number of NTP servers
+ * @ret rc		Return status code
+ *
+ * While a synchronisation is in progress, @c time_sync_pending will
+ * be non-zero.  This allows consumers of the current time (such as
+ * the certificate validator) to wait for the clock to be set only if
+ * it turns out to be necessary.
+ */
+int start_ntp_sync ( struct interface *job, char **hostnames,
+		     unsigned int count ) {
+	struct ntp_sync *sync;
+	unsigned int i;
+	int rc;
+
+	/* Allocate and initialise structure */
+	sync = zalloc ( sizeof ( *sync ) +
+			( count * sizeof ( sync->clients[0] ) ) );
+	if ( ! sync ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	ref_init ( &sync->refcnt, NULL );
+	intf_init ( &sync->job, &ntp_sync_job_desc, &sync->refcnt );
+	sync->count = count;
+	for ( i = 0 ; i < count ; i++ ) {
+		intf_init ( &sync->clients[i], &ntp_sync_client_desc,
+			    &sync->refcnt );
+	}
+	sync->pending = 1;
+	time_sync_pending++;
+
+	/* Start a client for each server.  Failure to start any
+	 * individual client is not fatal unless all clients fail.
+	 */
+	rc = -EINVAL;
+	for ( i = 0 ; i < count ; i++ ) {
+		if ( ( rc = start_ntp ( &sync->clients[i],
+					hostnames[i] ) ) != 0 ) {
+			DBGC ( sync, "NTP %p could not start %s: %s\n",
+			       sync, hostnames[i], strerror ( rc ) );
+			continue;
+		}
+		sync->remaining++;
+	}
+	if ( ! sync->remaining )
+		goto err_start;
+
+	/* Attach parent interface (if any), mortalise self, and return */
+	if ( job )
+		intf_plug_plug ( &sync->job, job );
+	ref_put ( &sync->refcnt );
+	return 0;
+
+ err_start:
+	ntp_sync_finished ( sync, rc );
+	ref_put ( &sync->refcnt );
+ err_alloc:
+	return rc;
+}
@@ -473,7 +473,7 @@ static int slam_pull_header ( struct slam_request *slam,
 	}
 
 	/* Notify recipient of file size */
-	xfer_seek ( &slam->xfer, slam->total_bytes );
+	xfer_presize ( &slam->xfer, slam->total_bytes );
 
 	return 0;
 }
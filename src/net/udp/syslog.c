@@ -31,8 +31,11 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <stdio.h>
 #include <ctype.h>
+#include <errno.h>
 #include <byteswap.h>
+#include <ipxe/iobuf.h>
 #include <ipxe/xfer.h>
 #include <ipxe/open.h>
 #include <ipxe/tcpip.h>
@@ -85,6 +88,29 @@ static char *syslog_hostname;
 /** Domain name (for log messages) */
 static char *syslog_domain;
 
+/**
+ * Format syslog message
+ *
+ * @v buf		Buffer
+ * @v size		Size of buffer
+ * @v severity		Severity
+ * @v message		Message
+ * @v terminator	Message terminator
+ * @ret len		Length of formatted message
+ */
+size_t syslog_format ( char *buf, size_t size, unsigned int severity,
+		       const char *message, const char *terminator ) {
+	const char *hostname = ( syslog_hostname ? syslog_hostname : "" );
+	const char *domain = ( ( hostname[0] && syslog_domain ) ?
+			       syslog_domain : "" );
+
+	return snprintf ( buf, size, "<%d>%s%s%s%sipxe: %s%s",
+			  SYSLOG_PRIORITY ( SYSLOG_DEFAULT_FACILITY,
+					    severity ), hostname,
+			  ( domain[0] ? "." : "" ), domain,
+			  ( hostname[0] ? " " : "" ), message, terminator );
+}
+
 /**
  * Transmit formatted syslog message
  *
@@ -96,15 +122,20 @@ static char *syslog_domain;
  */
 int syslog_send ( struct interface *xfer, unsigned int severity,
 		  const char *message, const char *terminator ) {
-	const char *hostname = ( syslog_hostname ? syslog_hostname : "" );
-	const char *domain = ( ( hostname[0] && syslog_domain ) ?
-			       syslog_domain : "" );
+	struct io_buffer *iobuf;
+	size_t len;
+
+	/* Allocate I/O buffer */
+	len = syslog_format ( NULL, 0, severity, message, terminator );
+	iobuf = xfer_alloc_iob ( xfer, ( len + 1 /* NUL */ ) );
+	if ( ! iobuf )
+		return -ENOMEM;
+
+	/* Format message */
+	syslog_format ( iob_put ( iobuf, len ), ( len + 1 /* NUL */ ),
+			severity, message, terminator );
 
-	return xfer_printf ( xfer, "<%d>%s%s%s%sipxe: %s%s",
-			     SYSLOG_PRIORITY ( SYSLOG_DEFAULT_FACILITY,
-					       severity ), hostname,
-			     ( domain[0] ? "." : "" ), domain,
-			     ( hostname[0] ? " " : "" ), message, terminator );
+	return xfer_deliver_iob ( xfer, iobuf );
 }
 
 /******************************************************************************
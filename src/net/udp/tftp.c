@@ -75,6 +75,17 @@ FEATURE ( FEATURE_PROTOCOL, "TFTP", DHCP_EB_FEATURE_TFTP, 1 );
 #define EINVAL_MC_INVALID_PORT __einfo_error ( EINFO_EINVAL_MC_INVALID_PORT )
 #define EINFO_EINVAL_MC_INVALID_PORT __einfo_uniqify \
 	( EINFO_EINVAL, 0x07, "Invalid multicast port" )
+#define EINVAL_WINDOWSIZE __einfo_error ( EINFO_EINVAL_WINDOWSIZE )
+#define EINFO_EINVAL_WINDOWSIZE __einfo_uniqify \
+	( EINFO_EINVAL, 0x08, "Invalid windowsize" )
+
+/** TFTP window size setting */
+const struct setting tftp_windowsize_setting __setting ( SETTING_MISC,
+							 tftp-windowsize ) = {
+	.name = "tftp-windowsize",
+	.description = "TFTP window size",
+	.type = &setting_type_uint8,
+};
 
 /**
  * A TFTP request
@@ -108,6 +119,16 @@ struct tftp_request {
 	 * "tsize" option, this value will be zero.
 	 */
 	unsigned long tsize;
+	/** Window size
+	 *
+	 * This is the "windowsize" option (RFC 7440) negotiated with
+	 * the TFTP server.  If the TFTP server does not support the
+	 * "windowsize" option, this will default to 1 (i.e. one ACK
+	 * per data block).
+	 */
+	unsigned int windowsize;
+	/** Number of in-order blocks received since the last ACK */
+	unsigned int window;
 	
 	/** Server port
 	 *
@@ -153,6 +174,8 @@ enum {
 	TFTP_FL_RRQ_MULTICAST = 0x0004,
 	/** Perform MTFTP recovery on timeout */
 	TFTP_FL_MTFTP_RECOVERY = 0x0008,
+	/** Out-of-order block has already been acknowledged */
+	TFTP_FL_GAP_ACKED = 0x0010,
 };
 
 /** Maximum number of MTFTP open requests before falling back to TFTP */
@@ -206,7 +229,11 @@ static int tftp_reopen ( struct tftp_request *tftp ) {
 	intf_restart ( &tftp->socket, 0 );
 
 	/* Disable ACK sending. */
-	tftp->flags &= ~TFTP_FL_SEND_ACK;
+	tftp->flags &= ~( TFTP_FL_SEND_ACK | TFTP_FL_GAP_ACKED );
+
+	/* Revert to one ACK per block until the server agrees otherwise */
+	tftp->windowsize = 1;
+	tftp->window = 0;
 
 	/* Reset peer address */
 	memset ( &tftp->peer, 0, sizeof ( tftp->peer ) );
@@ -272,8 +299,7 @@ static int tftp_presize ( struct tftp_request *tftp, size_t filesize ) {
 	tftp->filesize = filesize;
 
 	/* Notify recipient of file size */
-	xfer_seek ( &tftp->xfer, filesize );
-	xfer_seek ( &tftp->xfer, 0 );
+	xfer_presize ( &tftp->xfer, filesize );
 
 	/* Calculate expected number of blocks.  Note that files whose
 	 * length is an exact multiple of the blocksize will have a
@@ -330,6 +356,7 @@ static int tftp_send_rrq ( struct tftp_request *tftp ) {
 	size_t len;
 	struct io_buffer *iobuf;
 	size_t blksize;
+	unsigned long windowsize;
 
 	DBGC ( tftp, "TFTP %p requesting \"%s\"\n", tftp, path );
 
@@ -338,6 +365,7 @@ static int tftp_send_rrq ( struct tftp_request *tftp ) {
 		+ 5 + 1 /* "octet" + NUL */
 		+ 7 + 1 + 5 + 1 /* "blksize" + NUL + ddddd + NUL */
 		+ 5 + 1 + 1 + 1 /* "tsize" + NUL + "0" + NUL */ 
+		+ 10 + 1 + 3 + 1 /* "windowsize" + NUL + ddd + NUL */
 		+ 9 + 1 + 1 /* "multicast" + NUL + NUL */ );
 	iobuf = xfer_alloc_iob ( &tftp->socket, len );
 	if ( ! iobuf )
@@ -348,6 +376,13 @@ static int tftp_send_rrq ( struct tftp_request *tftp ) {
 	if ( blksize > TFTP_MAX_BLKSIZE )
 		blksize = TFTP_MAX_BLKSIZE;
 
+	/* Determine window size */
+	if ( fetch_uint_setting ( NULL, &tftp_windowsize_setting,
+				  &windowsize ) < 0 )
+		windowsize = 1;
+	if ( windowsize > TFTP_MAX_WINDOWSIZE )
+		windowsize = TFTP_MAX_WINDOWSIZE;
+
 	/* Build request */
 	rrq = iob_put ( iobuf, sizeof ( *rrq ) );
 	rrq->opcode = htons ( TFTP_RRQ );
@@ -358,6 +393,12 @@ static int tftp_send_rrq ( struct tftp_request *tftp ) {
 					    iob_tailroom ( iobuf ),
 					    "blksize%c%zd%ctsize%c0",
 					    0, blksize, 0, 0 ) + 1 );
+		if ( windowsize > 1 ) {
+			iob_put ( iobuf, snprintf ( iobuf->tail,
+						    iob_tailroom ( iobuf ),
+						    "windowsize%c%ld",
+						    0, windowsize ) + 1 );
+		}
 	}
 	if ( tftp->flags & TFTP_FL_RRQ_MULTICAST ) {
 		iob_put ( iobuf, snprintf ( iobuf->tail,
@@ -389,6 +430,9 @@ static int tftp_send_ack ( struct tftp_request *tftp ) {
 	block = bitmap_first_gap ( &tftp->bitmap );
 	DBGC2 ( tftp, "TFTP %p sending ACK for block %d\n", tftp, block );
 
+	/* Start a new window */
+	tftp->window = 0;
+
 	/* Allocate buffer */
 	iobuf = xfer_alloc_iob ( &tftp->socket, sizeof ( *ack ) );
 	if ( ! iobuf )
@@ -580,6 +624,30 @@ static int tftp_process_tsize ( struct tftp_request *tftp,
 	return 0;
 }
 
+/**
+ * Process TFTP "windowsize" option
+ *
+ * @v tftp		TFTP connection
+ * @v value		Option value
+ * @ret rc		Return status code
+ */
+static int tftp_process_windowsize ( struct tftp_request *tftp,
+				     const char *value ) {
+	char *end;
+
+	tftp->windowsize = strtoul ( value, &end, 10 );
+	if ( *end || ( tftp->windowsize == 0 ) ||
+	     ( tftp->windowsize > TFTP_MAX_WINDOWSIZE ) ) {
+		DBGC ( tftp, "TFTP %p got invalid windowsize \"%s\"\n",
+		       tftp, value );
+		tftp->windowsize = 1;
+		return -EINVAL_WINDOWSIZE;
+	}
+	DBGC ( tftp, "TFTP %p windowsize=%d\n", tftp, tftp->windowsize );
+
+	return 0;
+}
+
 /**
  * Process TFTP "multicast" option
  *
@@ -667,6 +735,7 @@ struct tftp_option {
 static struct tftp_option tftp_options[] = {
 	{ "blksize", tftp_process_blksize },
 	{ "tsize", tftp_process_tsize },
+	{ "windowsize", tftp_process_windowsize },
 	{ "multicast", tftp_process_multicast },
 	{ NULL, NULL }
 };
@@ -784,6 +853,7 @@ static int tftp_rx_data ( struct tftp_request *tftp,
 	struct tftp_data *data = iobuf->data;
 	struct xfer_metadata meta;
 	unsigned int block;
+	unsigned int gap;
 	off_t offset;
 	size_t data_len;
 	int rc;
@@ -832,10 +902,33 @@ static int tftp_rx_data ( struct tftp_request *tftp,
 		goto done;
 
 	/* Mark block as received */
+	gap = bitmap_first_gap ( &tftp->bitmap );
 	bitmap_set ( &tftp->bitmap, block );
 
-	/* Acknowledge block */
-	tftp_send_packet ( tftp );
+	/* Acknowledge block.  When using a window size greater than
+	 * one, we acknowledge only the final block of each window
+	 * (or of the file).  An out-of-order block indicates packet
+	 * loss: acknowledge the last contiguous block once, so that
+	 * the server will retransmit from the first missing block,
+	 * and rely on the retransmission timer thereafter.
+	 */
+	if ( tftp->windowsize <= 1 ) {
+		tftp_send_packet ( tftp );
+	} else if ( bitmap_first_gap ( &tftp->bitmap ) != gap ) {
+		tftp->flags &= ~TFTP_FL_GAP_ACKED;
+		if ( ( ++tftp->window >= tftp->windowsize ) ||
+		     ( data_len < tftp->blksize ) ) {
+			tftp_send_packet ( tftp );
+		} else {
+			stop_timer ( &tftp->timer );
+			start_timer ( &tftp->timer );
+		}
+	} else if ( ! ( tftp->flags & TFTP_FL_GAP_ACKED ) ) {
+		DBGC ( tftp, "TFTP %p received block %d while expecting "
+		       "block %d\n", tftp, ( block + 1 ), ( gap + 1 ) );
+		tftp->flags |= TFTP_FL_GAP_ACKED;
+		tftp_send_packet ( tftp );
+	}
 
 	/* If all blocks have been received, finish. */
 	if ( bitmap_full ( &tftp->bitmap ) )
@@ -1081,6 +1174,7 @@ static int tftp_core_open ( struct interface *xfer, struct uri *uri,
 	timer_init ( &tftp->timer, tftp_timer_expired, &tftp->refcnt );
 	tftp->uri = uri_get ( uri );
 	tftp->blksize = TFTP_DEFAULT_BLKSIZE;
+	tftp->windowsize = 1;
 	tftp->flags = flags;
 
 	/* Open socket */
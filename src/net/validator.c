@@ -34,6 +34,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/iobuf.h>
 #include <ipxe/xferbuf.h>
 #include <ipxe/process.h>
+#include <ipxe/time.h>
 #include <ipxe/x509.h>
 #include <ipxe/settings.h>
 #include <ipxe/dhcp.h>
@@ -55,21 +56,47 @@ struct validator {
 	struct refcnt refcnt;
 	/** Job control interface */
 	struct interface job;
-	/** Data transfer interface */
-	struct interface xfer;
 
 	/** Process */
 	struct process process;
 
 	/** X.509 certificate chain */
 	struct x509_chain *chain;
-	/** OCSP check */
-	struct ocsp_check *ocsp;
+	/** Stapled OCSP response for first certificate (if any) */
+	void *stapled;
+	/** Length of stapled OCSP response */
+	size_t stapled_len;
+	/** Fetches (in progress or awaiting use) */
+	struct list_head fetches;
+	/** Failure is deferred pending time synchronisation */
+	int time_wait;
+};
+
+/** A certificate validator fetch
+ *
+ * A fetch is either a download of cross-signing certificates, or an
+ * OCSP check.  All applicable fetches are started concurrently.  A
+ * completed OCSP check remains attached to the validator until its
+ * issuing certificate has been validated, at which point the OCSP
+ * response can itself be validated.
+ */
+struct validator_fetch {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Certificate validator */
+	struct validator *validator;
+	/** List of fetches */
+	struct list_head list;
+	/** Data transfer interface */
+	struct interface xfer;
 	/** Data buffer */
 	struct xfer_buffer buffer;
+	/** OCSP check (or NULL for a cross-signing certificate download) */
+	struct ocsp_check *ocsp;
+	/** Fetch has completed */
+	int complete;
 	/** Action to take upon completed transfer */
-	int ( * done ) ( struct validator *validator, const void *data,
-			 size_t len );
+	int ( * done ) ( struct validator_fetch *fetch );
 };
 
 /**
@@ -82,12 +109,28 @@ static void validator_free ( struct refcnt *refcnt ) {
 		container_of ( refcnt, struct validator, refcnt );
 
 	DBGC2 ( validator, "VALIDATOR %p freed\n", validator );
+	assert ( list_empty ( &validator->fetches ) );
 	x509_chain_put ( validator->chain );
-	ocsp_put ( validator->ocsp );
-	xferbuf_free ( &validator->buffer );
+	free ( validator->stapled );
 	free ( validator );
 }
 
+/**
+ * Remove fetch
+ *
+ * @v fetch		Certificate validator fetch
+ * @v rc		Reason for removal
+ */
+static void validator_fetch_del ( struct validator_fetch *fetch, int rc ) {
+
+	/* Close data transfer interface */
+	intf_shutdown ( &fetch->xfer, rc );
+
+	/* Remove from list of fetches and drop list's reference */
+	list_del ( &fetch->list );
+	ref_put ( &fetch->refcnt );
+}
+
 /**
  * Mark certificate validation as finished
  *
@@ -95,12 +138,17 @@ static void validator_free ( struct refcnt *refcnt ) {
  * @v rc		Reason for finishing
  */
 static void validator_finished ( struct validator *validator, int rc ) {
+	struct validator_fetch *fetch;
+	struct validator_fetch *tmp;
 
 	/* Remove process */
 	process_del ( &validator->process );
 
-	/* Close all interfaces */
-	intf_shutdown ( &validator->xfer, rc );
+	/* Abandon all fetches */
+	list_for_each_entry_safe ( fetch, tmp, &validator->fetches, list )
+		validator_fetch_del ( fetch, rc );
+
+	/* Close job control interface */
 	intf_shutdown ( &validator->job, rc );
 }
 
@@ -119,6 +167,166 @@ static struct interface_operation validator_job_operations[] = {
 static struct interface_descriptor validator_job_desc =
 	INTF_DESC ( struct validator, job, validator_job_operations );
 
+/****************************************************************************
+ *
+ * Fetches
+ *
+ */
+
+/**
+ * Free certificate validator fetch
+ *
+ * @v refcnt		Reference count
+ */
+static void validator_fetch_free ( struct refcnt *refcnt ) {
+	struct validator_fetch *fetch =
+		container_of ( refcnt, struct validator_fetch, refcnt );
+
+	ocsp_put ( fetch->ocsp );
+	xferbuf_free ( &fetch->buffer );
+	ref_put ( &fetch->validator->refcnt );
+	free ( fetch );
+}
+
+/**
+ * Handle completed fetch
+ *
+ * @v fetch		Certificate validator fetch
+ * @v rc		Reason for close
+ */
+static void validator_fetch_close ( struct validator_fetch *fetch, int rc ) {
+	struct validator *validator = fetch->validator;
+
+	/* Close data transfer interface */
+	intf_restart ( &fetch->xfer, rc );
+
+	/* Check for errors */
+	if ( rc != 0 ) {
+		DBGC ( validator, "VALIDATOR %p transfer failed: %s\n",
+		       validator, strerror ( rc ) );
+		goto err_transfer;
+	}
+	DBGC2 ( validator, "VALIDATOR %p transfer complete\n", validator );
+
+	/* Process completed download */
+	assert ( fetch->done != NULL );
+	if ( ( rc = fetch->done ( fetch ) ) != 0 )
+		goto err_done;
+
+	/* Resume validation process */
+	process_add ( &validator->process );
+
+	return;
+
+ err_done:
+ err_transfer:
+	validator_finished ( validator, rc );
+}
+
+/**
+ * Receive data
+ *
+ * @v fetch		Certificate validator fetch
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int validator_fetch_deliver ( struct validator_fetch *fetch,
+				     struct io_buffer *iobuf,
+				     struct xfer_metadata *meta ) {
+	struct validator *validator = fetch->validator;
+	int rc;
+
+	/* Add data to buffer */
+	if ( ( rc = xferbuf_deliver ( &fetch->buffer, iob_disown ( iobuf ),
+				      meta ) ) != 0 ) {
+		DBGC ( validator, "VALIDATOR %p could not receive data: %s\n",
+		       validator, strerror ( rc ) );
+		validator_finished ( validator, rc );
+		return rc;
+	}
+
+	return 0;
+}
+
+/** Certificate validator fetch data transfer interface operations */
+static struct interface_operation validator_fetch_xfer_operations[] = {
+	INTF_OP ( xfer_deliver, struct validator_fetch *,
+		  validator_fetch_deliver ),
+	INTF_OP ( intf_close, struct validator_fetch *, validator_fetch_close ),
+};
+
+/** Certificate validator fetch data transfer interface descriptor */
+static struct interface_descriptor validator_fetch_xfer_desc =
+	INTF_DESC ( struct validator_fetch, xfer,
+		    validator_fetch_xfer_operations );
+
+/**
+ * Start fetch
+ *
+ * @v validator		Certificate validator
+ * @v uri_string	URI string
+ * @v ocsp		OCSP check (or NULL for a cross-signing download)
+ * @v done		Action to take upon completed transfer
+ * @ret rc		Return status code
+ */
+static int validator_fetch ( struct validator *validator,
+			     const char *uri_string, struct ocsp_check *ocsp,
+			     int ( * done ) ( struct validator_fetch *fetch ) ){
+	struct validator_fetch *fetch;
+	int rc;
+
+	/* Allocate and initialise structure */
+	fetch = zalloc ( sizeof ( *fetch ) );
+	if ( ! fetch )
+		return -ENOMEM;
+	ref_init ( &fetch->refcnt, validator_fetch_free );
+	fetch->validator = validator;
+	ref_get ( &validator->refcnt );
+	intf_init ( &fetch->xfer, &validator_fetch_xfer_desc,
+		    &fetch->refcnt );
+	xferbuf_malloc_init ( &fetch->buffer );
+	if ( ocsp )
+		fetch->ocsp = ocsp_get ( ocsp );
+	fetch->done = done;
+
+	/* Add to list of fetches (transferring our reference) */
+	list_add_tail ( &fetch->list, &validator->fetches );
+
+	/* Open URI */
+	if ( ( rc = xfer_open_uri_string ( &fetch->xfer,
+					   uri_string ) ) != 0 ) {
+		DBGC ( validator, "VALIDATOR %p could not open %s: %s\n",
+		       validator, uri_string, strerror ( rc ) );
+		validator_fetch_del ( fetch, rc );
+		return rc;
+	}
+
+	return 0;
+}
+
+/**
+ * Find existing fetch
+ *
+ * @v validator		Certificate validator
+ * @v cert		Certificate to be checked via OCSP, or NULL
+ * @ret fetch		Certificate validator fetch, or NULL
+ *
+ * If @c cert is NULL, then this will find any cross-signing
+ * certificate download.
+ */
+static struct validator_fetch *
+validator_find_fetch ( struct validator *validator,
+		       struct x509_certificate *cert ) {
+	struct validator_fetch *fetch;
+
+	list_for_each_entry ( fetch, &validator->fetches, list ) {
+		if ( fetch->ocsp ? ( fetch->ocsp->cert == cert ) : ( ! cert ) )
+			return fetch;
+	}
+	return NULL;
+}
+
 /****************************************************************************
  *
  * Cross-signing certificates
@@ -219,6 +427,26 @@ static int validator_append ( struct validator *validator,
 	return rc;
 }
 
+/**
+ * Handle completed download of cross-signing certificates
+ *
+ * @v fetch		Certificate validator fetch
+ * @ret rc		Return status code
+ */
+static int validator_download_done ( struct validator_fetch *fetch ) {
+	int rc;
+
+	/* Append certificates to chain */
+	if ( ( rc = validator_append ( fetch->validator, fetch->buffer.data,
+				       fetch->buffer.len ) ) != 0 )
+		return rc;
+
+	/* Download is no longer required */
+	validator_fetch_del ( fetch, 0 );
+
+	return 0;
+}
+
 /**
  * Start download of cross-signing certificate
  *
@@ -260,21 +488,15 @@ static int validator_start_download ( struct validator *validator,
 	DBGC ( validator, "VALIDATOR %p downloading cross-signed certificate "
 	       "from %s\n", validator, uri_string );
 
-	/* Set completion handler */
-	validator->done = validator_append;
-
-	/* Open URI */
-	if ( ( rc = xfer_open_uri_string ( &validator->xfer,
-					   uri_string ) ) != 0 ) {
-		DBGC ( validator, "VALIDATOR %p could not open %s: %s\n",
-		       validator, uri_string, strerror ( rc ) );
-		goto err_open_uri_string;
-	}
+	/* Start download */
+	if ( ( rc = validator_fetch ( validator, uri_string, NULL,
+				      validator_download_done ) ) != 0 )
+		goto err_fetch;
 
 	/* Success */
 	rc = 0;
 
- err_open_uri_string:
+ err_fetch:
 	free ( uri_string );
  err_alloc_uri_string:
 	free ( crosscert_copy );
@@ -288,233 +510,294 @@ static int validator_start_download ( struct validator *validator,
  */
 
 /**
- * Validate OCSP response
+ * Handle completed OCSP check
  *
- * @v validator		Certificate validator
- * @v data		Raw OCSP response
- * @v len		Length of raw data
+ * @v fetch		Certificate validator fetch
  * @ret rc		Return status code
+ *
+ * The OCSP response is recorded for later validation, since the
+ * issuing certificate may not yet have been validated.
  */
-static int validator_ocsp_validate ( struct validator *validator,
-				     const void *data, size_t len ) {
-	time_t now;
+static int validator_ocsp_done ( struct validator_fetch *fetch ) {
+	struct validator *validator = fetch->validator;
 	int rc;
 
 	/* Record OCSP response */
-	if ( ( rc = ocsp_response ( validator->ocsp, data, len ) ) != 0 ) {
+	if ( ( rc = ocsp_response ( fetch->ocsp, fetch->buffer.data,
+				    fetch->buffer.len ) ) != 0 ) {
 		DBGC ( validator, "VALIDATOR %p could not record OCSP "
 		       "response: %s\n", validator, strerror ( rc ) );
 		return rc;
 	}
 
+	/* Mark as complete and free downloaded data */
+	fetch->complete = 1;
+	xferbuf_free ( &fetch->buffer );
+
+	return 0;
+}
+
+/**
+ * Validate OCSP response
+ *
+ * @v validator		Certificate validator
+ * @v ocsp		OCSP check with recorded response
+ * @ret rc		Return status code
+ */
+static int validator_ocsp_validate ( struct validator *validator,
+				     struct ocsp_check *ocsp ) {
+	time_t now;
+	int rc;
+
 	/* Validate OCSP response */
 	now = time ( NULL );
-	if ( ( rc = ocsp_validate ( validator->ocsp, now ) ) != 0 ) {
+	if ( ( rc = ocsp_validate ( ocsp, now ) ) != 0 ) {
 		DBGC ( validator, "VALIDATOR %p could not validate OCSP "
 		       "response: %s\n", validator, strerror ( rc ) );
 		return rc;
 	}
 
-	/* Drop reference to OCSP check */
-	ocsp_put ( validator->ocsp );
-	validator->ocsp = NULL;
-
 	return 0;
 }
 
 /**
- * Start OCSP check
+ * Use stapled OCSP response
  *
  * @v validator		Certificate validator
  * @v cert		Certificate to check
  * @v issuer		Issuing certificate
  * @ret rc		Return status code
  */
-static int validator_start_ocsp ( struct validator *validator,
-				  struct x509_certificate *cert,
-				  struct x509_certificate *issuer ) {
-	const char *uri_string;
+static int validator_stapled_ocsp ( struct validator *validator,
+				    struct x509_certificate *cert,
+				    struct x509_certificate *issuer ) {
+	struct ocsp_check *ocsp;
 	int rc;
 
 	/* Create OCSP check */
-	assert ( validator->ocsp == NULL );
-	if ( ( rc = ocsp_check ( cert, issuer, &validator->ocsp ) ) != 0 ) {
+	if ( ( rc = ocsp_check ( cert, issuer, &ocsp ) ) != 0 ) {
 		DBGC ( validator, "VALIDATOR %p could not create OCSP check: "
 		       "%s\n", validator, strerror ( rc ) );
-		return rc;
+		goto err_check;
 	}
 
-	/* Set completion handler */
-	validator->done = validator_ocsp_validate;
-
-	/* Open URI */
-	uri_string = validator->ocsp->uri_string;
-	DBGC ( validator, "VALIDATOR %p performing OCSP check at %s\n",
-	       validator, uri_string );
-	if ( ( rc = xfer_open_uri_string ( &validator->xfer,
-					   uri_string ) ) != 0 ) {
-		DBGC ( validator, "VALIDATOR %p could not open %s: %s\n",
-		       validator, uri_string, strerror ( rc ) );
-		return rc;
-	}
-
-	return 0;
-}
-
-/****************************************************************************
- *
- * Data transfer interface
- *
- */
-
-/**
- * Close data transfer interface
- *
- * @v validator		Certificate validator
- * @v rc		Reason for close
- */
-static void validator_xfer_close ( struct validator *validator, int rc ) {
-
-	/* Close data transfer interface */
-	intf_restart ( &validator->xfer, rc );
-
-	/* Check for errors */
-	if ( rc != 0 ) {
-		DBGC ( validator, "VALIDATOR %p transfer failed: %s\n",
-		       validator, strerror ( rc ) );
-		goto err_transfer;
+	/* Record stapled response */
+	DBGC ( validator, "VALIDATOR %p using stapled OCSP response\n",
+	       validator );
+	if ( ( rc = ocsp_response ( ocsp, validator->stapled,
+				    validator->stapled_len ) ) != 0 ) {
+		DBGC ( validator, "VALIDATOR %p could not record OCSP "
+		       "response: %s\n", validator, strerror ( rc ) );
+		goto err_response;
 	}
-	DBGC2 ( validator, "VALIDATOR %p transfer complete\n", validator );
-
-	/* Process completed download */
-	assert ( validator->done != NULL );
-	if ( ( rc = validator->done ( validator, validator->buffer.data,
-				       validator->buffer.len ) ) != 0 )
-		goto err_append;
-
-	/* Free downloaded data */
-	xferbuf_free ( &validator->buffer );
-
-	/* Resume validation process */
-	process_add ( &validator->process );
 
-	return;
+	/* Validate stapled response */
+	if ( ( rc = validator_ocsp_validate ( validator, ocsp ) ) != 0 )
+		goto err_validate;
 
- err_append:
- err_transfer:
-	validator_finished ( validator, rc );
+ err_validate:
+ err_response:
+	ocsp_put ( ocsp );
+ err_check:
+	return rc;
 }
 
 /**
- * Receive data
+ * Start OCSP check
  *
  * @v validator		Certificate validator
- * @v iobuf		I/O buffer
- * @v meta		Data transfer metadata
+ * @v cert		Certificate to check
+ * @v issuer		Issuing certificate
  * @ret rc		Return status code
+ *
+ * The issuing certificate need not yet have been validated.
  */
-static int validator_xfer_deliver ( struct validator *validator,
-				    struct io_buffer *iobuf,
-				    struct xfer_metadata *meta ) {
+static int validator_start_ocsp ( struct validator *validator,
+				  struct x509_certificate *cert,
+				  struct x509_certificate *issuer ) {
+	struct ocsp_check *ocsp;
 	int rc;
 
-	/* Add data to buffer */
-	if ( ( rc = xferbuf_deliver ( &validator->buffer, iob_disown ( iobuf ),
-				      meta ) ) != 0 ) {
-		DBGC ( validator, "VALIDATOR %p could not receive data: %s\n",
-		       validator, strerror ( rc ) );
-		validator_finished ( validator, rc );
-		return rc;
+	/* Create OCSP check */
+	if ( ( rc = ocsp_check ( cert, issuer, &ocsp ) ) != 0 ) {
+		DBGC ( validator, "VALIDATOR %p could not create OCSP check: "
+		       "%s\n", validator, strerror ( rc ) );
+		goto err_check;
 	}
 
-	return 0;
+	/* Start fetch */
+	DBGC ( validator, "VALIDATOR %p performing OCSP check at %s\n",
+	       validator, ocsp->uri_string );
+	if ( ( rc = validator_fetch ( validator, ocsp->uri_string, ocsp,
+				      validator_ocsp_done ) ) != 0 )
+		goto err_fetch;
+
+ err_fetch:
+	ocsp_put ( ocsp );
+ err_check:
+	return rc;
 }
 
-/** Certificate validator data transfer interface operations */
-static struct interface_operation validator_xfer_operations[] = {
-	INTF_OP ( xfer_deliver, struct validator *, validator_xfer_deliver ),
-	INTF_OP ( intf_close, struct validator *, validator_xfer_close ),
-};
-
-/** Certificate validator data transfer interface descriptor */
-static struct interface_descriptor validator_xfer_desc =
-	INTF_DESC ( struct validator, xfer, validator_xfer_operations );
-
 /****************************************************************************
  *
  * Validation process
  *
  */
 
+/**
+ * Fail certificate validation
+ *
+ * @v validator		Certificate validator
+ * @v rc		Reason for failure
+ *
+ * Validation may have failed only because the system clock has not
+ * yet been set.  If a time synchronisation is still in progress,
+ * then defer the failure and retry validation once the
+ * synchronisation has completed.
+ */
+static void validator_failed ( struct validator *validator, int rc ) {
+
+	/* Defer failure (once) if time synchronisation is in progress */
+	if ( time_sync_pending && ! validator->time_wait ) {
+		DBGC ( validator, "VALIDATOR %p waiting for time "
+		       "synchronisation\n", validator );
+		validator->time_wait = 1;
+		process_add ( &validator->process );
+		return;
+	}
+
+	/* Otherwise, fail */
+	validator_finished ( validator, rc );
+}
+
 /**
  * Certificate validation process
  *
  * @v validator		Certificate validator
+ *
+ * All OCSP checks and cross-signing certificate downloads that may
+ * be required are started concurrently, so that the overall latency
+ * is that of the slowest fetch rather than the sum of all fetches.
  */
 static void validator_step ( struct validator *validator ) {
+	struct validator_fetch *fetch;
+	struct validator_fetch *tmp;
 	struct x509_link *link;
 	struct x509_certificate *cert;
 	struct x509_certificate *issuer = NULL;
 	struct x509_certificate *last;
 	time_t now;
+	int invalid;
 	int rc;
 
+	/* Wait for any time synchronisation on which we are waiting */
+	if ( validator->time_wait && time_sync_pending ) {
+		process_add ( &validator->process );
+		return;
+	}
+
 	/* Try validating chain.  Try even if the chain is incomplete,
 	 * since certificates may already have been validated
 	 * previously.
 	 */
 	now = time ( NULL );
-	if ( ( rc = x509_validate_chain ( validator->chain, now, NULL,
-					  NULL ) ) == 0 ) {
+	if ( ( invalid = x509_validate_chain ( validator->chain, now, NULL,
+					       NULL ) ) == 0 ) {
 		validator_finished ( validator, 0 );
 		return;
 	}
 
-	/* If there is a certificate that could be validated using
-	 * OCSP, try it.
+	/* Validate any received OCSP response for which the issuer
+	 * has now been validated, and then retry validating the chain.
+	 */
+	list_for_each_entry_safe ( fetch, tmp, &validator->fetches, list ) {
+		if ( ! ( fetch->complete &&
+			 x509_is_valid ( fetch->ocsp->issuer ) ) )
+			continue;
+		rc = validator_ocsp_validate ( validator, fetch->ocsp );
+		validator_fetch_del ( fetch, rc );
+		if ( rc != 0 ) {
+			validator_finished ( validator, rc );
+			return;
+		}
+		process_add ( &validator->process );
+		return;
+	}
+
+	/* Start an OCSP check for each certificate that could be
+	 * validated using OCSP.
 	 */
 	list_for_each_entry ( link, &validator->chain->links, list ) {
 		cert = issuer;
 		issuer = link->cert;
-		if ( ! cert )
+		if ( ( ! cert ) || x509_is_valid ( cert ) )
 			continue;
-		if ( ! x509_is_valid ( issuer ) )
+		if ( ( rc = x509_decode_extensions ( cert ) ) != 0 ) {
+			validator_finished ( validator, rc );
+			return;
+		}
+		if ( ! ( cert->extensions.auth_info.ocsp.uri.len &&
+			 ( ! x509_ocsp_is_good ( cert, now ) ) ) ) {
+			/* OCSP is not applicable.  If the issuer is
+			 * valid, then this is a permanent failure.
+			 */
+			if ( x509_is_valid ( issuer ) ) {
+				validator_failed ( validator, invalid );
+				return;
+			}
 			continue;
-		/* The issuer is valid, but this certificate is not
-		 * yet valid.  If OCSP is applicable, start it.
+		}
+		if ( validator_find_fetch ( validator, cert ) )
+			continue;
+		/* Use stapled OCSP response, if applicable.  This is
+		 * attempted only once the issuer is valid, and only
+		 * once: if the stapled response is unusable then fall
+		 * back to querying the OCSP responder.
 		 */
-		if ( cert->extensions.auth_info.ocsp.uri.len &&
-		     ( ! cert->extensions.auth_info.ocsp.good ) ) {
-			/* Start OCSP */
-			if ( ( rc = validator_start_ocsp ( validator, cert,
-							   issuer ) ) != 0 ) {
-				validator_finished ( validator, rc );
+		if ( validator->stapled &&
+		     ( cert == x509_first ( validator->chain ) ) ) {
+			if ( ! x509_is_valid ( issuer ) )
+				continue;
+			rc = validator_stapled_ocsp ( validator, cert, issuer );
+			free ( validator->stapled );
+			validator->stapled = NULL;
+			if ( rc == 0 ) {
+				process_add ( &validator->process );
 				return;
 			}
+		}
+		/* Start OCSP */
+		if ( ( rc = validator_start_ocsp ( validator, cert,
+						   issuer ) ) != 0 ) {
+			validator_finished ( validator, rc );
 			return;
 		}
-		/* Otherwise, this is a permanent failure */
-		validator_finished ( validator, rc );
-		return;
 	}
 
-	/* If chain ends with a self-issued certificate, then there is
-	 * nothing more to do.
+	/* If chain ends with a certificate that is neither valid nor
+	 * self-issued, then try to download a suitable cross-signing
+	 * certificate (unless a download is already in progress).
 	 */
 	last = x509_last ( validator->chain );
-	if ( asn1_compare ( &last->issuer.raw, &last->subject.raw ) == 0 ) {
-		validator_finished ( validator, rc );
-		return;
+	if ( ! ( x509_is_valid ( last ) ||
+		 ( asn1_compare ( &last->issuer.raw,
+				  &last->subject.raw ) == 0 ) ||
+		 validator_find_fetch ( validator, NULL ) ) ) {
+		if ( ( rc = validator_start_download ( validator,
+						       &last->issuer.raw ) ) != 0 ){
+			validator_finished ( validator, rc );
+			return;
+		}
 	}
 
-	/* Otherwise, try to download a suitable cross-signing
-	 * certificate.
-	 */
-	if ( ( rc = validator_start_download ( validator,
-					       &last->issuer.raw ) ) != 0 ) {
-		validator_finished ( validator, rc );
-		return;
+	/* Wait for any fetches still in progress */
+	list_for_each_entry ( fetch, &validator->fetches, list ) {
+		if ( ! fetch->complete )
+			return;
 	}
+
+	/* Otherwise, there is nothing more to do */
+	validator_failed ( validator, invalid );
 }
 
 /** Certificate validator process descriptor */
@@ -532,9 +815,12 @@ static struct process_descriptor validator_process_desc =
  *
  * @v job		Job control interface
  * @v chain		X.509 certificate chain
+ * @v ocsp		Stapled OCSP response for first certificate, or NULL
+ * @v ocsp_len		Length of stapled OCSP response
  * @ret rc		Return status code
  */
-int create_validator ( struct interface *job, struct x509_chain *chain ) {
+int create_validator ( struct interface *job, struct x509_chain *chain,
+		       const void *ocsp, size_t ocsp_len ) {
 	struct validator *validator;
 	int rc;
 
@@ -553,12 +839,21 @@ int create_validator ( struct interface *job, struct x509_chain *chain ) {
 	ref_init ( &validator->refcnt, validator_free );
 	intf_init ( &validator->job, &validator_job_desc,
 		    &validator->refcnt );
-	intf_init ( &validator->xfer, &validator_xfer_desc,
-		    &validator->refcnt );
 	process_init ( &validator->process, &validator_process_desc,
 		       &validator->refcnt );
 	validator->chain = x509_chain_get ( chain );
-	xferbuf_malloc_init ( &validator->buffer );
+	INIT_LIST_HEAD ( &validator->fetches );
+
+	/* Record stapled OCSP response, if any */
+	if ( ocsp_len ) {
+		validator->stapled = malloc ( ocsp_len );
+		if ( ! validator->stapled ) {
+			rc = -ENOMEM;
+			goto err_stapled;
+		}
+		memcpy ( validator->stapled, ocsp, ocsp_len );
+		validator->stapled_len = ocsp_len;
+	}
 
 	/* Attach parent interface, mortalise self, and return */
 	intf_plug_plug ( &validator->job, job );
@@ -567,6 +862,7 @@ int create_validator ( struct interface *job, struct x509_chain *chain ) {
 		validator, validator->chain );
 	return 0;
 
+ err_stapled:
 	validator_finished ( validator, rc );
 	ref_put ( &validator->refcnt );
  err_alloc:
@@ -47,14 +47,38 @@ struct net_protocol vlan_protocol __net_protocol;
 
 /** VLAN device private data */
 struct vlan_device {
+	/** VLAN network device */
+	struct net_device *netdev;
 	/** Trunk network device */
 	struct net_device *trunk;
 	/** VLAN tag */
 	unsigned int tag;
 	/** Default priority */
 	unsigned int priority;
+	/** Next VLAN device in hash bucket */
+	struct vlan_device *next;
 };
 
+/** Number of VLAN device hash buckets
+ *
+ * Must be a power of two.
+ */
+#define VLAN_HASH_SIZE 16
+
+/** Registered VLAN devices, hashed by tag */
+static struct vlan_device *vlan_hash[VLAN_HASH_SIZE];
+
+/**
+ * Get VLAN device hash bucket
+ *
+ * @v tag		VLAN tag
+ * @ret bucket		Hash bucket
+ */
+static inline struct vlan_device ** vlan_bucket ( unsigned int tag ) {
+
+	return &vlan_hash[ tag & ( VLAN_HASH_SIZE - 1 ) ];
+}
+
 /**
  * Open VLAN device
  *
@@ -101,6 +125,22 @@ static int vlan_transmit ( struct net_device *netdev,
 
 	/* Strip link-layer header and preserve link-layer header fields */
 	ll_protocol = netdev->ll_protocol;
+
+	/* Transmit packet unmodified on trunk device, if the trunk is
+	 * able to insert the VLAN tag in hardware.
+	 */
+	if ( ( trunk->state & NETDEV_TX_VLAN ) &&
+	     ( trunk->ll_protocol == ll_protocol ) ) {
+		iobuf->flags |= IOB_FL_VLAN;
+		iobuf->vlan_tci = VLAN_TCI ( vlan->tag, vlan->priority );
+		list_del ( &iobuf->list );
+		netdev_tx ( trunk, iob_disown ( iobuf ) );
+		/* Cannot return an error status, since that would
+		 * cause the I/O buffer to be double-freed.
+		 */
+		return 0;
+	}
+
 	if ( ( rc = ll_protocol->pull ( netdev, iobuf, &ll_dest, &ll_source,
 					&net_proto, &flags ) ) != 0 ) {
 		DBGC ( netdev, "VLAN %s could not parse link-layer header: "
@@ -200,19 +240,43 @@ static void vlan_sync ( struct net_device *netdev ) {
  * @ret netdev		VLAN device, if any
  */
 struct net_device * vlan_find ( struct net_device *trunk, unsigned int tag ) {
-	struct net_device *netdev;
 	struct vlan_device *vlan;
 
-	for_each_netdev ( netdev ) {
-		if ( netdev->op != &vlan_operations )
-			continue;
-		vlan = netdev->priv;
+	for ( vlan = *vlan_bucket ( tag ) ; vlan ; vlan = vlan->next ) {
 		if ( ( vlan->trunk == trunk ) && ( vlan->tag == tag ) )
-			return netdev;
+			return vlan->netdev;
 	}
 	return NULL;
 }
 
+/**
+ * Process incoming packet with VLAN tag stripped by hardware
+ *
+ * @v trunk		Trunk network device
+ * @v tag		VLAN tag
+ * @v iobuf		I/O buffer
+ *
+ * This is called by a network device advertising @c NETDEV_RX_VLAN
+ * in place of netdev_rx(), for each received packet from which the
+ * hardware has stripped a VLAN header.
+ */
+void vlan_netdev_rx ( struct net_device *trunk, unsigned int tag,
+		      struct io_buffer *iobuf ) {
+	struct net_device *netdev;
+
+	/* Identify VLAN device */
+	netdev = vlan_find ( trunk, tag );
+	if ( ! netdev ) {
+		DBGC2 ( trunk, "VLAN %s received packet for unknown VLAN "
+			"%d\n", trunk->name, tag );
+		netdev_rx_err ( trunk, iobuf, -ENODEV );
+		return;
+	}
+
+	/* Enqueue packet on VLAN device */
+	netdev_rx ( netdev, iobuf );
+}
+
 /**
  * Process incoming VLAN packet
  *
@@ -338,6 +402,7 @@ int vlan_create ( struct net_device *trunk, unsigned int tag,
 		  unsigned int priority ) {
 	struct net_device *netdev;
 	struct vlan_device *vlan;
+	struct vlan_device **bucket;
 	int rc;
 
 	/* If VLAN already exists, just update the priority */
@@ -379,8 +444,11 @@ int vlan_create ( struct net_device *trunk, unsigned int tag,
 	}
 	netdev_init ( netdev, &vlan_operations );
 	netdev->dev = trunk->dev;
+	netdev->tx_headroom = ( sizeof ( struct vlan_header ) +
+				trunk->tx_headroom );
 	memcpy ( netdev->hw_addr, trunk->ll_addr, ETH_ALEN );
 	vlan = netdev->priv;
+	vlan->netdev = netdev;
 	vlan->trunk = netdev_get ( trunk );
 	vlan->tag = tag;
 	vlan->priority = priority;
@@ -400,6 +468,11 @@ int vlan_create ( struct net_device *trunk, unsigned int tag,
 		goto err_register;
 	}
 
+	/* Add to VLAN device hash */
+	bucket = vlan_bucket ( tag );
+	vlan->next = *bucket;
+	*bucket = vlan;
+
 	/* Synchronise with trunk device */
 	vlan_sync ( netdev );
 
@@ -426,6 +499,7 @@ int vlan_create ( struct net_device *trunk, unsigned int tag,
  */
 int vlan_destroy ( struct net_device *netdev ) {
 	struct vlan_device *vlan = netdev->priv;
+	struct vlan_device **bucket;
 	struct net_device *trunk;
 
 	/* Sanity check */
@@ -437,6 +511,11 @@ int vlan_destroy ( struct net_device *netdev ) {
 
 	DBGC ( netdev, "VLAN %s destroyed\n", netdev->name );
 
+	/* Remove from VLAN device hash */
+	for ( bucket = vlan_bucket ( vlan->tag ) ; *bucket != vlan ;
+	      bucket = &(*bucket)->next ) {}
+	*bucket = vlan->next;
+
 	/* Remove VLAN device */
 	unregister_netdev ( netdev );
 	trunk = vlan->trunk;
@@ -76,6 +76,11 @@ BASE64 ( random_test,
 		0x65, 0xd1 ),
 	 "NgOE3E4DRqC1LQNu0FbtoDcCrMZl0Q==" );
 
+/** Whitespace test (decoding only) */
+BASE64 ( whitespace_test,
+	 DATA ( 'H', 'e', 'l', 'l', 'o', ' ', 'w', 'o', 'r', 'l', 'd' ),
+	 " SGVs\r\nbG8g\td29y\nbGQ= \n" );
+
 /**
  * Report a base64 encoding test result
  *
@@ -131,6 +136,15 @@ static void base64_test_exec ( void ) {
 
 	base64_encode_ok ( &random_test );
 	base64_decode_ok ( &random_test );
+
+	base64_decode_ok ( &whitespace_test );
+
+	/* Invalid encodings */
+	ok ( base64_decode ( "SGVsbG8*", NULL, 0 ) < 0 );
+	ok ( base64_decode ( "SGVsbG8", NULL, 0 ) < 0 );
+	ok ( base64_decode ( "SGVsbG8gd29ybGQ==", NULL, 0 ) < 0 );
+	ok ( base64_decode ( "SG=Vs", NULL, 0 ) < 0 );
+	ok ( base64_decode ( "SGVs\xc3\xa9", NULL, 0 ) < 0 );
 }
 
 /** Base64 self-test */
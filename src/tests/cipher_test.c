@@ -44,6 +44,23 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /** Number of sample iterations for profiling */
 #define PROFILE_COUNT 16
 
+/**
+ * Choose point at which to split test data
+ *
+ * @v cipher		Cipher algorithm
+ * @v len		Length of test data
+ * @ret split		Length of first portion of test data
+ *
+ * Test data is processed in two portions, in order to exercise the
+ * handling of partial blocks by stream ciphers.
+ */
+static size_t cipher_test_split ( struct cipher_algorithm *cipher,
+				  size_t len ) {
+	size_t blocks = ( len / cipher->blocksize );
+
+	return ( ( blocks / 3 ) * cipher->blocksize );
+}
+
 /**
  * Report a cipher encryption test result
  *
@@ -55,19 +72,37 @@ void cipher_encrypt_okx ( struct cipher_test *test, const char *file,
 			  unsigned int line ) {
 	struct cipher_algorithm *cipher = test->cipher;
 	size_t len = test->len;
+	size_t split = cipher_test_split ( cipher, len );
 	uint8_t ctx[cipher->ctxsize];
 	uint8_t ciphertext[len];
+	uint8_t auth[test->auth_len];
 
 	/* Initialise cipher */
 	okx ( cipher_setkey ( cipher, ctx, test->key, test->key_len ) == 0,
 	      file, line );
 	cipher_setiv ( cipher, ctx, test->iv );
 
+	/* Process additional data, if applicable */
+	okx ( test->auth_len == cipher->authsize, file, line );
+	if ( test->additional_len ) {
+		cipher_encrypt ( cipher, ctx, test->additional, NULL,
+				 test->additional_len );
+	}
+
 	/* Perform encryption */
-	cipher_encrypt ( cipher, ctx, test->plaintext, ciphertext, len );
+	cipher_encrypt ( cipher, ctx, test->plaintext, ciphertext, split );
+	cipher_encrypt ( cipher, ctx, ( test->plaintext + split ),
+			 ( ciphertext + split ), ( len - split ) );
 
 	/* Compare against expected ciphertext */
 	okx ( memcmp ( ciphertext, test->ciphertext, len ) == 0, file, line );
+
+	/* Compare against expected authentication tag, if applicable */
+	if ( is_auth_cipher ( cipher ) ) {
+		cipher_auth ( cipher, ctx, auth );
+		okx ( memcmp ( auth, test->auth, test->auth_len ) == 0,
+		      file, line );
+	}
 }
 
 /**
@@ -81,19 +116,37 @@ void cipher_decrypt_okx ( struct cipher_test *test, const char *file,
 			  unsigned int line ) {
 	struct cipher_algorithm *cipher = test->cipher;
 	size_t len = test->len;
+	size_t split = cipher_test_split ( cipher, len );
 	uint8_t ctx[cipher->ctxsize];
 	uint8_t plaintext[len];
+	uint8_t auth[test->auth_len];
 
 	/* Initialise cipher */
 	okx ( cipher_setkey ( cipher, ctx, test->key, test->key_len ) == 0,
 	      file, line );
 	cipher_setiv ( cipher, ctx, test->iv );
 
-	/* Perform encryption */
-	cipher_decrypt ( cipher, ctx, test->ciphertext, plaintext, len );
+	/* Process additional data, if applicable */
+	okx ( test->auth_len == cipher->authsize, file, line );
+	if ( test->additional_len ) {
+		cipher_decrypt ( cipher, ctx, test->additional, NULL,
+				 test->additional_len );
+	}
+
+	/* Perform decryption */
+	cipher_decrypt ( cipher, ctx, test->ciphertext, plaintext, split );
+	cipher_decrypt ( cipher, ctx, ( test->ciphertext + split ),
+			 ( plaintext + split ), ( len - split ) );
 
 	/* Compare against expected plaintext */
 	okx ( memcmp ( plaintext, test->plaintext, len ) == 0, file, line );
+
+	/* Compare against expected authentication tag, if applicable */
+	if ( is_auth_cipher ( cipher ) ) {
+		cipher_auth ( cipher, ctx, auth );
+		okx ( memcmp ( auth, test->auth, test->auth_len ) == 0,
+		      file, line );
+	}
 }
 
 /**
@@ -111,29 +164,32 @@ void cipher_okx ( struct cipher_test *test, const char *file,
 }
 
 /**
- * Calculate cipher encryption or decryption cost
+ * Profile cipher encryption or decryption
  *
  * @v cipher			Cipher algorithm
  * @v key_len			Length of key
+ * @v len			Length of data
  * @v op			Encryption or decryption operation
- * @ret cost			Cost (in cycles per byte)
+ * @ret cycles			Mean cost (in cycles per operation)
  */
 static unsigned long
-cipher_cost ( struct cipher_algorithm *cipher, size_t key_len,
-	      void ( * op ) ( struct cipher_algorithm *cipher, void *ctx,
-			      const void *src, void *dst, size_t len ) ) {
-	static uint8_t random[8192]; /* Too large for stack */
+cipher_cycles ( struct cipher_algorithm *cipher, size_t key_len, size_t len,
+		void ( * op ) ( struct cipher_algorithm *cipher, void *ctx,
+				const void *src, void *dst, size_t len ) ) {
+	static uint8_t random[CIPHER_COST_MAX_LEN]; /* Too large for stack */
 	uint8_t key[key_len];
-	uint8_t iv[cipher->blocksize];
+	uint8_t iv[16]; /* Large enough for all supported ciphers */
 	uint8_t ctx[cipher->ctxsize];
 	struct profiler profiler;
-	unsigned long cost;
 	unsigned int i;
 	int rc;
 
+	/* Sanity check */
+	assert ( len <= sizeof ( random ) );
+
 	/* Fill buffer with pseudo-random data */
 	srand ( 0x1234568 );
-	for ( i = 0 ; i < sizeof ( random ) ; i++ )
+	for ( i = 0 ; i < len ; i++ )
 		random[i] = rand();
 	for ( i = 0 ; i < sizeof ( key ) ; i++ )
 		key[i] = rand();
@@ -149,13 +205,60 @@ cipher_cost ( struct cipher_algorithm *cipher, size_t key_len,
 	memset ( &profiler, 0, sizeof ( profiler ) );
 	for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
 		profile_start ( &profiler );
-		op ( cipher, ctx, random, random, sizeof ( random ) );
+		op ( cipher, ctx, random, random, len );
 		profile_stop ( &profiler );
 	}
 
+	return profile_mean ( &profiler );
+}
+
+/**
+ * Profile cipher encryption
+ *
+ * @v cipher			Cipher algorithm
+ * @v key_len			Length of key
+ * @v len			Length of data
+ * @ret cycles			Mean cost (in cycles per operation)
+ */
+unsigned long cipher_cycles_encrypt ( struct cipher_algorithm *cipher,
+				      size_t key_len, size_t len ) {
+	return cipher_cycles ( cipher, key_len, len, cipher_encrypt );
+}
+
+/**
+ * Profile cipher decryption
+ *
+ * @v cipher			Cipher algorithm
+ * @v key_len			Length of key
+ * @v len			Length of data
+ * @ret cycles			Mean cost (in cycles per operation)
+ */
+unsigned long cipher_cycles_decrypt ( struct cipher_algorithm *cipher,
+				      size_t key_len, size_t len ) {
+	return cipher_cycles ( cipher, key_len, len, cipher_decrypt );
+}
+
+/**
+ * Calculate cipher encryption or decryption cost
+ *
+ * @v cipher			Cipher algorithm
+ * @v key_len			Length of key
+ * @v op			Encryption or decryption operation
+ * @ret cost			Cost (in cycles per byte)
+ */
+static unsigned long
+cipher_cost ( struct cipher_algorithm *cipher, size_t key_len,
+	      void ( * op ) ( struct cipher_algorithm *cipher, void *ctx,
+			      const void *src, void *dst, size_t len ) ) {
+	unsigned long cycles;
+	unsigned long cost;
+
+	/* Profile cipher operation */
+	cycles = cipher_cycles ( cipher, key_len, CIPHER_COST_MAX_LEN, op );
+
 	/* Round to nearest whole number of cycles per byte */
-	cost = ( ( profile_mean ( &profiler ) + ( sizeof ( random ) / 2 ) ) /
-		 sizeof ( random ) );
+	cost = ( ( cycles + ( CIPHER_COST_MAX_LEN / 2 ) ) /
+		 CIPHER_COST_MAX_LEN );
 
 	return cost;
 }
@@ -1410,6 +1410,56 @@ static void cms_verify_fail_okx ( struct cms_test_signature *sgn,
 	cms_verify_fail_okx ( sgn, code, name, time, store, root,	\
 			      __FILE__, __LINE__ )
 
+/**
+ * Report signature verification using precomputed digest test result
+ *
+ * @v sgn		Test signature
+ * @v code		Test signed code
+ * @v digested		Test code from which to precompute digest
+ * @v name		Test verification name
+ * @v time		Test verification time
+ * @v store		Test certificate store
+ * @v root		Test root certificate list
+ * @v success		Verification is expected to succeed
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void cms_verify_digested_okx ( struct cms_test_signature *sgn,
+				      struct cms_test_code *code,
+				      struct cms_test_code *digested,
+				      const char *name, time_t time,
+				      struct x509_chain *store,
+				      struct x509_root *root, int success,
+				      const char *file, unsigned int line ) {
+	struct cms_signer_info *info =
+		list_first_entry ( &sgn->sig->info, struct cms_signer_info,
+				   list );
+	struct digest_algorithm *digest = info->digest;
+	uint8_t ctx[digest->ctxsize];
+	uint8_t value[digest->digestsize];
+	int rc;
+
+	/* Precompute digest using signer's digest algorithm */
+	digest_init ( digest, ctx );
+	digest_update ( digest, ctx, digested->data, digested->len );
+	digest_final ( digest, ctx, value );
+
+	/* Verify signature */
+	x509_invalidate_chain ( sgn->sig->certificates );
+	rc = cms_verify_digested ( sgn->sig, virt_to_user ( code->data ),
+				   code->len, digest, value, name, time,
+				   store, root );
+	okx ( ( rc == 0 ) == success, file, line );
+}
+#define cms_verify_digested_ok( sgn, code, digested, name, time, store,	\
+				root )					\
+	cms_verify_digested_okx ( sgn, code, digested, name, time, store,	\
+				  root, 1, __FILE__, __LINE__ )
+#define cms_verify_digested_fail_ok( sgn, code, digested, name, time,	\
+				     store, root )			\
+	cms_verify_digested_okx ( sgn, code, digested, name, time, store,	\
+				  root, 0, __FILE__, __LINE__ )
+
 /**
  * Perform CMS self-tests
  *
@@ -1457,6 +1507,13 @@ static void cms_test_exec ( void ) {
 	cms_verify_fail_ok ( &codesigned_sig, &test_code,
 			     NULL, test_expired, &empty_store, &test_root );
 
+	/* Check that precomputed digest is used in place of data */
+	cms_verify_digested_ok ( &codesigned_sig, &bad_code, &test_code,
+				 NULL, test_time, &empty_store, &test_root );
+	cms_verify_digested_fail_ok ( &codesigned_sig, &test_code, &bad_code,
+				      NULL, test_time, &empty_store,
+				      &test_root );
+
 	/* Sanity check */
 	assert ( list_empty ( &empty_store.links ) );
 
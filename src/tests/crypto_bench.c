@@ -0,0 +1,496 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Cryptographic algorithm benchmarks
+ *
+ * Each measurement is reported as a single line of the form
+ *
+ *     bench name=<name> len=<length> cycles=<cycles> [cpb=<cost>]
+ *
+ * where "cycles" is the mean cost of one operation and "cpb" is the
+ * corresponding cost in cycles per byte (to two decimal places), so
+ * that results from different builds (e.g. with and without an
+ * accelerated implementation) may be compared mechanically.
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <ipxe/crypto.h>
+#include <ipxe/aes.h>
+#include <ipxe/md5.h>
+#include <ipxe/sha1.h>
+#include <ipxe/sha256.h>
+#include <ipxe/sha512.h>
+#include <ipxe/hmac_drbg.h>
+#include <ipxe/rsa.h>
+#include <ipxe/bigint.h>
+#include <ipxe/profile.h>
+#include <ipxe/test.h>
+#include "cipher_test.h"
+#include "digest_test.h"
+
+/** Number of sample iterations for profiling */
+#define BENCH_COUNT 16
+
+/** Maximum length of benchmark name */
+#define BENCH_NAME_LEN 32
+
+/** A cipher benchmark */
+struct cipher_bench {
+	/** Cipher algorithm */
+	struct cipher_algorithm *cipher;
+	/** Key length (in bits) */
+	unsigned int keylen;
+};
+
+/** Data lengths used for bulk data benchmarks */
+static const size_t bench_lens[] = { 16, 64, 256, 1024, 4096, 8192 };
+
+/** Cipher benchmarks */
+static struct cipher_bench cipher_benches[] = {
+	{ &aes_ecb_algorithm, 128 },
+	{ &aes_ecb_algorithm, 256 },
+	{ &aes_cbc_algorithm, 128 },
+	{ &aes_cbc_algorithm, 256 },
+	{ &aes_gcm_algorithm, 128 },
+	{ &aes_gcm_algorithm, 256 },
+};
+
+/** Digest benchmarks */
+static struct digest_algorithm *digest_benches[] = {
+	&md5_algorithm,
+	&sha1_algorithm,
+	&sha256_algorithm,
+	&sha512_algorithm,
+};
+
+/** Modulus lengths (in bits) used for modular exponentiation benchmarks */
+static const unsigned int modexp_benches[] = { 512, 1024, 2048, 4096 };
+
+/** RSA private key (2048-bit) */
+static const uint8_t bench_rsa_private[] = {
+	0x30, 0x82, 0x04, 0xa4, 0x02, 0x01, 0x00, 0x02, 0x82, 0x01,
+	0x01, 0x00, 0xd5, 0x87, 0x70, 0x7b, 0xc3, 0x24, 0x1e, 0xce,
+	0x3f, 0x8b, 0x2f, 0xf1, 0xbf, 0x7f, 0x4a, 0xfd, 0x74, 0x90,
+	0x42, 0xfa, 0xdd, 0x5a, 0x70, 0xe8, 0xb2, 0x60, 0x2d, 0x7e,
+	0xc3, 0x89, 0x88, 0x58, 0x4c, 0xff, 0x65, 0xe4, 0x7b, 0x80,
+	0x67, 0xc1, 0x8d, 0xe7, 0xdc, 0x3e, 0x96, 0x88, 0xd5, 0x52,
+	0x76, 0xbc, 0xac, 0x9d, 0xf7, 0x1d, 0xbb, 0xe9, 0x59, 0x7d,
+	0x7a, 0x01, 0x90, 0x47, 0x6a, 0xff, 0x6c, 0x8d, 0x67, 0x90,
+	0x4f, 0x08, 0x88, 0x90, 0x2e, 0xfe, 0x39, 0x6a, 0x18, 0x0f,
+	0x96, 0xdb, 0x97, 0x07, 0x30, 0x41, 0xb0, 0xf1, 0xfe, 0x2d,
+	0x2c, 0x38, 0x0b, 0x8c, 0x21, 0x21, 0xe3, 0xb0, 0x8f, 0x14,
+	0x44, 0xc3, 0xea, 0x61, 0x15, 0x75, 0xb4, 0xf2, 0x72, 0xf8,
+	0xe5, 0x2f, 0x51, 0xbe, 0x64, 0xb2, 0xd8, 0xbb, 0x83, 0x80,
+	0x6e, 0x67, 0xd3, 0x8b, 0x70, 0x6b, 0x16, 0xbb, 0xff, 0x06,
+	0xa2, 0x5c, 0x2d, 0x10, 0x97, 0x08, 0xf1, 0x56, 0x64, 0xce,
+	0x42, 0x30, 0x66, 0x13, 0x9e, 0x71, 0x4d, 0x36, 0x73, 0xb5,
+	0x53, 0x2e, 0x3a, 0x95, 0xaf, 0xa8, 0x6c, 0x62, 0x05, 0x43,
+	0x5f, 0xd2, 0x93, 0x57, 0x46, 0xd1, 0xe9, 0xab, 0xbd, 0x14,
+	0x59, 0xa9, 0x27, 0x60, 0xea, 0x73, 0x22, 0x84, 0x5b, 0x85,
+	0x36, 0xfb, 0x46, 0x6b, 0x82, 0xb7, 0xfb, 0x22, 0xd1, 0xaf,
+	0x68, 0x92, 0x52, 0x5b, 0x11, 0x5d, 0x70, 0x13, 0xa4, 0x08,
+	0x79, 0xd8, 0x74, 0xeb, 0x2b, 0xc2, 0x84, 0x03, 0x41, 0xc1,
+	0x95, 0x94, 0x7f, 0xec, 0x4a, 0x8d, 0x3a, 0x95, 0x6c, 0x16,
+	0x97, 0x23, 0x91, 0xa9, 0x8f, 0x47, 0x5e, 0xe0, 0xf8, 0x86,
+	0x4f, 0xdb, 0xb7, 0xcc, 0x0a, 0x18, 0x74, 0xc2, 0xb8, 0x8c,
+	0x11, 0x4f, 0x3f, 0x0f, 0xa9, 0xee, 0xe0, 0xec, 0xf6, 0x9e,
+	0xd6, 0xf6, 0xa3, 0x2d, 0x4d, 0xee, 0xc9, 0x3d, 0x02, 0x03,
+	0x01, 0x00, 0x01, 0x02, 0x82, 0x01, 0x00, 0x09, 0xca, 0x49,
+	0x72, 0x80, 0x8f, 0xd3, 0x3d, 0x17, 0xf5, 0xc2, 0x44, 0xd3,
+	0xc7, 0xba, 0xd6, 0x4f, 0x20, 0xb4, 0x29, 0x7b, 0x65, 0x03,
+	0xab, 0x44, 0xf9, 0x1a, 0xec, 0xe6, 0x7b, 0x3e, 0x53, 0x4a,
+	0x1d, 0xd0, 0x51, 0x54, 0x5b, 0x9e, 0xa6, 0x3b, 0x0d, 0x92,
+	0x9a, 0xbe, 0x07, 0xd7, 0xbc, 0x0d, 0xb1, 0xf8, 0x8f, 0x7a,
+	0x3e, 0x94, 0x98, 0x8e, 0x35, 0x58, 0xc1, 0x8c, 0x98, 0xc7,
+	0x03, 0x9f, 0x64, 0x5b, 0xb2, 0x11, 0x50, 0x43, 0x59, 0x55,
+	0x06, 0x41, 0x4c, 0xa7, 0x7e, 0x18, 0xd2, 0x72, 0xfa, 0x18,
+	0x90, 0xd2, 0x7e, 0x43, 0x43, 0x55, 0x4a, 0x86, 0x8b, 0xae,
+	0x13, 0x37, 0x34, 0xd2, 0x57, 0xec, 0x0f, 0xe2, 0xdb, 0x01,
+	0x03, 0x0c, 0xc1, 0x01, 0xb0, 0xd4, 0x15, 0x42, 0x2a, 0xb8,
+	0x19, 0x93, 0xcd, 0x59, 0x2a, 0x00, 0xd0, 0x90, 0x31, 0xa2,
+	0xfd, 0xb8, 0xa4, 0xf5, 0xa6, 0xdb, 0x3b, 0x51, 0xfe, 0x8c,
+	0xa0, 0x6b, 0x1e, 0x87, 0x7d, 0x72, 0xf9, 0x6f, 0x1c, 0x6e,
+	0x2a, 0x2e, 0xfd, 0x1c, 0xf6, 0x5b, 0xc0, 0x73, 0xdd, 0x64,
+	0x05, 0xe4, 0xcb, 0x12, 0xc2, 0x64, 0xbc, 0x50, 0x70, 0xd4,
+	0x33, 0x4a, 0x68, 0xd2, 0x1e, 0x89, 0x8c, 0xdf, 0x98, 0x7c,
+	0xd0, 0x11, 0x16, 0x10, 0x10, 0x83, 0xa1, 0x4a, 0x30, 0x89,
+	0xbe, 0x2c, 0x4c, 0xdb, 0xea, 0x35, 0x57, 0xdb, 0x8d, 0x44,
+	0x96, 0xaf, 0x41, 0x37, 0xc5, 0x05, 0x7d, 0x7c, 0x95, 0xd3,
+	0x1b, 0x93, 0xf0, 0x0f, 0xfb, 0xae, 0xdb, 0x5f, 0x91, 0x74,
+	0xd5, 0xa8, 0xc2, 0xaa, 0x36, 0xff, 0xf0, 0x60, 0xcb, 0x80,
+	0xee, 0x63, 0xe8, 0xe9, 0x49, 0x5e, 0x2f, 0x39, 0x60, 0x2c,
+	0x5c, 0x78, 0x73, 0x10, 0xa4, 0xbc, 0xe4, 0x6b, 0xb9, 0x2e,
+	0x9e, 0x6b, 0xa3, 0x2c, 0xc9, 0x3f, 0xf1, 0x62, 0x40, 0x32,
+	0xe8, 0xb7, 0xc3, 0x02, 0x81, 0x81, 0x00, 0xf9, 0xc4, 0xaf,
+	0x5c, 0x76, 0xcc, 0xd3, 0xc3, 0x58, 0xc4, 0xf6, 0x56, 0x7a,
+	0x07, 0x28, 0x04, 0xaf, 0x50, 0xdc, 0xfe, 0xa5, 0xa4, 0x74,
+	0x7c, 0x8a, 0x91, 0xb3, 0xf2, 0x68, 0x54, 0x20, 0xf2, 0x31,
+	0x46, 0x41, 0x89, 0xbc, 0x33, 0x86, 0xb6, 0x02, 0x7b, 0xd3,
+	0x2b, 0x0c, 0x02, 0xd1, 0x0a, 0xf4, 0x07, 0x9a, 0x36, 0x84,
+	0x32, 0xe9, 0xca, 0x9f, 0x0d, 0x0d, 0x96, 0xba, 0xd1, 0xae,
+	0x94, 0x95, 0x9a, 0x23, 0x37, 0xf0, 0x1c, 0xc4, 0x9b, 0x46,
+	0xdd, 0x66, 0x58, 0x7e, 0x36, 0x25, 0xad, 0xdb, 0xf0, 0x15,
+	0x39, 0x56, 0xba, 0xb4, 0x97, 0x31, 0x7c, 0xb2, 0x9b, 0x98,
+	0x84, 0xb9, 0x24, 0xc5, 0x69, 0xca, 0xff, 0x3d, 0x6b, 0x5e,
+	0xdd, 0x2a, 0x42, 0xc4, 0xb9, 0xee, 0xf5, 0xab, 0x2e, 0x9f,
+	0x4e, 0xab, 0x6f, 0x56, 0x57, 0x11, 0x34, 0xc4, 0xd4, 0xaf,
+	0x52, 0x37, 0xf3, 0xa0, 0x8f, 0x02, 0x81, 0x81, 0x00, 0xda,
+	0xdb, 0x49, 0xb0, 0x35, 0xf6, 0x6b, 0x1b, 0x77, 0x0b, 0x5f,
+	0x57, 0xbc, 0x35, 0x5c, 0x92, 0x5f, 0xbc, 0x37, 0x4b, 0xe1,
+	0x6c, 0xab, 0x5f, 0xcb, 0xd2, 0x56, 0x7d, 0xe0, 0xfe, 0xae,
+	0x44, 0x51, 0x36, 0xc0, 0x1e, 0xf6, 0x35, 0xde, 0xde, 0xbb,
+	0x13, 0xba, 0xb2, 0xee, 0x2a, 0xc0, 0x04, 0xf1, 0x4d, 0x8f,
+	0x35, 0xf1, 0x5d, 0x06, 0x42, 0x23, 0xec, 0x83, 0x45, 0x49,
+	0x07, 0xea, 0x4a, 0xf3, 0x8d, 0x78, 0x3b, 0x38, 0x40, 0xa0,
+	0x56, 0x3c, 0x3d, 0xa6, 0x2b, 0x71, 0x38, 0xb4, 0x71, 0x8a,
+	0x27, 0xa3, 0xaa, 0xc8, 0x29, 0xe9, 0x8b, 0xa4, 0x6d, 0xd5,
+	0x4e, 0x3f, 0x45, 0x34, 0xb6, 0x3a, 0xba, 0xef, 0x41, 0x00,
+	0x2f, 0x52, 0xce, 0xc7, 0x21, 0x3a, 0xe6, 0xa1, 0x4e, 0x79,
+	0xe8, 0x66, 0x23, 0x6c, 0x59, 0x8c, 0xeb, 0x98, 0x80, 0xbd,
+	0xeb, 0x4c, 0x06, 0xd5, 0xaa, 0x47, 0x73, 0x02, 0x81, 0x81,
+	0x00, 0xda, 0x40, 0x1f, 0x08, 0x0a, 0x1b, 0x73, 0x93, 0xc8,
+	0x56, 0xdb, 0xf6, 0xb6, 0xcc, 0xd8, 0x10, 0x37, 0xed, 0xce,
+	0x1e, 0x8a, 0x39, 0x89, 0x3c, 0x66, 0x8d, 0x69, 0x13, 0x92,
+	0x4c, 0xa9, 0x39, 0x59, 0x0b, 0x4e, 0x2b, 0x80, 0x13, 0xfa,
+	0x4b, 0xc3, 0x21, 0xd6, 0x65, 0x50, 0x2a, 0x89, 0xe6, 0x2b,
+	0x55, 0x15, 0x51, 0x3b, 0xf5, 0x8d, 0x4b, 0x6b, 0xee, 0x29,
+	0x08, 0xa4, 0x18, 0xa3, 0x97, 0xdc, 0x9e, 0x02, 0xd6, 0x57,
+	0x6f, 0x9b, 0xf1, 0x1f, 0x5c, 0x49, 0x99, 0x5c, 0x38, 0x0e,
+	0x76, 0xbc, 0xb0, 0x2e, 0xab, 0x9a, 0xf8, 0xac, 0xe3, 0x4c,
+	0xef, 0xec, 0xd6, 0x7f, 0xd0, 0xc2, 0x43, 0xba, 0x69, 0x76,
+	0x63, 0xd0, 0x94, 0xa9, 0x21, 0x53, 0x53, 0x62, 0xba, 0x22,
+	0x6f, 0xf3, 0x74, 0x5a, 0xea, 0x90, 0x6d, 0x4a, 0xa1, 0xec,
+	0x3c, 0x13, 0x1e, 0xd2, 0x50, 0x62, 0xe9, 0xf5, 0x4b, 0x02,
+	0x81, 0x81, 0x00, 0xb2, 0x78, 0x2e, 0x70, 0x1e, 0xa1, 0x33,
+	0x18, 0xb3, 0x8c, 0x37, 0x94, 0xb1, 0x2b, 0x06, 0xb1, 0x6a,
+	0x96, 0x6e, 0xb5, 0x57, 0x3f, 0xa9, 0xc4, 0xb5, 0xce, 0x71,
+	0xaf, 0xb7, 0x01, 0x98, 0x94, 0xa7, 0x71, 0xb1, 0x5b, 0xce,
+	0x45, 0x81, 0xd8, 0x39, 0xd0, 0x4d, 0xe8, 0x49, 0xe5, 0xdc,
+	0xae, 0x6b, 0x24, 0x67, 0x4b, 0x82, 0xe6, 0xec, 0x0a, 0x95,
+	0x86, 0xf2, 0x49, 0x56, 0xd3, 0xb8, 0x90, 0xa4, 0x69, 0xd2,
+	0x08, 0xe0, 0xc7, 0x7a, 0xb8, 0xb7, 0xe9, 0x42, 0x0f, 0x9d,
+	0x05, 0xb3, 0xc7, 0xfe, 0xf4, 0x72, 0x37, 0xfb, 0x80, 0x8a,
+	0x2d, 0xd0, 0xc9, 0xac, 0x2f, 0x61, 0xd3, 0x0a, 0xb8, 0x2b,
+	0xce, 0x72, 0xfa, 0x9b, 0xae, 0xfb, 0xa5, 0x19, 0xa7, 0x94,
+	0x83, 0xac, 0x38, 0xf5, 0x9a, 0xb9, 0x67, 0xdb, 0x9c, 0x6f,
+	0x19, 0x54, 0x44, 0x70, 0x1b, 0x67, 0xe5, 0x0e, 0xea, 0x0b,
+	0xd7, 0x02, 0x81, 0x80, 0x59, 0x50, 0xac, 0xfd, 0xab, 0xe1,
+	0x6d, 0xa5, 0xdf, 0xef, 0x81, 0x4c, 0x60, 0x96, 0x73, 0x6f,
+	0x6b, 0x4d, 0x79, 0x95, 0xcc, 0xea, 0xba, 0xbe, 0x9f, 0x71,
+	0x4d, 0x19, 0xa5, 0x14, 0xf1, 0xf0, 0x25, 0xcf, 0xc5, 0xb1,
+	0xe8, 0xe8, 0x9e, 0x9b, 0xc8, 0xbd, 0xd5, 0xb0, 0x79, 0x88,
+	0x59, 0x77, 0x29, 0x83, 0x81, 0x2b, 0x54, 0x61, 0x4e, 0xe1,
+	0x50, 0xc5, 0xec, 0x2a, 0x94, 0x1d, 0xbc, 0x8e, 0x6b, 0x9d,
+	0x5f, 0xd3, 0xe7, 0x81, 0xb2, 0xdf, 0xc5, 0x35, 0xfc, 0xdf,
+	0x58, 0xc3, 0x4b, 0xde, 0x70, 0x2d, 0x58, 0x35, 0x6c, 0x18,
+	0xf9, 0x62, 0xa1, 0xbd, 0x61, 0x66, 0xca, 0x64, 0xf4, 0xc0,
+	0xac, 0xc3, 0xa7, 0xc5, 0xc4, 0x25, 0xcf, 0x45, 0x8b, 0x80,
+	0xa7, 0x37, 0x12, 0xff, 0xa6, 0xe8, 0xe9, 0x33, 0x14, 0x61,
+	0x34, 0x1f, 0xa8, 0x1c, 0xdc, 0x21, 0xc3, 0x29, 0xcd, 0xcb,
+	0x13, 0xe6
+};
+
+/** RSA public key (2048-bit) */
+static const uint8_t bench_rsa_public[] = {
+	0x30, 0x82, 0x01, 0x22, 0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86,
+	0x48, 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x01, 0x05, 0x00, 0x03,
+	0x82, 0x01, 0x0f, 0x00, 0x30, 0x82, 0x01, 0x0a, 0x02, 0x82,
+	0x01, 0x01, 0x00, 0xd5, 0x87, 0x70, 0x7b, 0xc3, 0x24, 0x1e,
+	0xce, 0x3f, 0x8b, 0x2f, 0xf1, 0xbf, 0x7f, 0x4a, 0xfd, 0x74,
+	0x90, 0x42, 0xfa, 0xdd, 0x5a, 0x70, 0xe8, 0xb2, 0x60, 0x2d,
+	0x7e, 0xc3, 0x89, 0x88, 0x58, 0x4c, 0xff, 0x65, 0xe4, 0x7b,
+	0x80, 0x67, 0xc1, 0x8d, 0xe7, 0xdc, 0x3e, 0x96, 0x88, 0xd5,
+	0x52, 0x76, 0xbc, 0xac, 0x9d, 0xf7, 0x1d, 0xbb, 0xe9, 0x59,
+	0x7d, 0x7a, 0x01, 0x90, 0x47, 0x6a, 0xff, 0x6c, 0x8d, 0x67,
+	0x90, 0x4f, 0x08, 0x88, 0x90, 0x2e, 0xfe, 0x39, 0x6a, 0x18,
+	0x0f, 0x96, 0xdb, 0x97, 0x07, 0x30, 0x41, 0xb0, 0xf1, 0xfe,
+	0x2d, 0x2c, 0x38, 0x0b, 0x8c, 0x21, 0x21, 0xe3, 0xb0, 0x8f,
+	0x14, 0x44, 0xc3, 0xea, 0x61, 0x15, 0x75, 0xb4, 0xf2, 0x72,
+	0xf8, 0xe5, 0x2f, 0x51, 0xbe, 0x64, 0xb2, 0xd8, 0xbb, 0x83,
+	0x80, 0x6e, 0x67, 0xd3, 0x8b, 0x70, 0x6b, 0x16, 0xbb, 0xff,
+	0x06, 0xa2, 0x5c, 0x2d, 0x10, 0x97, 0x08, 0xf1, 0x56, 0x64,
+	0xce, 0x42, 0x30, 0x66, 0x13, 0x9e, 0x71, 0x4d, 0x36, 0x73,
+	0xb5, 0x53, 0x2e, 0x3a, 0x95, 0xaf, 0xa8, 0x6c, 0x62, 0x05,
+	0x43, 0x5f, 0xd2, 0x93, 0x57, 0x46, 0xd1, 0xe9, 0xab, 0xbd,
+	0x14, 0x59, 0xa9, 0x27, 0x60, 0xea, 0x73, 0x22, 0x84, 0x5b,
+	0x85, 0x36, 0xfb, 0x46, 0x6b, 0x82, 0xb7, 0xfb, 0x22, 0xd1,
+	0xaf, 0x68, 0x92, 0x52, 0x5b, 0x11, 0x5d, 0x70, 0x13, 0xa4,
+	0x08, 0x79, 0xd8, 0x74, 0xeb, 0x2b, 0xc2, 0x84, 0x03, 0x41,
+	0xc1, 0x95, 0x94, 0x7f, 0xec, 0x4a, 0x8d, 0x3a, 0x95, 0x6c,
+	0x16, 0x97, 0x23, 0x91, 0xa9, 0x8f, 0x47, 0x5e, 0xe0, 0xf8,
+	0x86, 0x4f, 0xdb, 0xb7, 0xcc, 0x0a, 0x18, 0x74, 0xc2, 0xb8,
+	0x8c, 0x11, 0x4f, 0x3f, 0x0f, 0xa9, 0xee, 0xe0, 0xec, 0xf6,
+	0x9e, 0xd6, 0xf6, 0xa3, 0x2d, 0x4d, 0xee, 0xc9, 0x3d, 0x02,
+	0x03, 0x01, 0x00, 0x01
+};
+
+/**
+ * Report benchmark result
+ *
+ * @v name		Benchmark name
+ * @v len		Length of data processed per operation, or zero
+ * @v cycles		Mean cost (in cycles per operation)
+ */
+static void bench_report ( const char *name, size_t len,
+			   unsigned long cycles ) {
+	unsigned long cpb;
+
+	printf ( "bench name=%s len=%zd cycles=%ld", name, len, cycles );
+	if ( len ) {
+		cpb = ( ( ( cycles * 100 ) + ( len / 2 ) ) / len );
+		printf ( " cpb=%ld.%02ld", ( cpb / 100 ), ( cpb % 100 ) );
+	}
+	printf ( "\n" );
+}
+
+/**
+ * Run cipher benchmark
+ *
+ * @v bench		Cipher benchmark
+ */
+static void cipher_bench ( struct cipher_bench *bench ) {
+	struct cipher_algorithm *cipher = bench->cipher;
+	size_t key_len = ( bench->keylen / 8 );
+	char name[BENCH_NAME_LEN];
+	size_t len;
+	unsigned int i;
+
+	for ( i = 0 ; i < ( sizeof ( bench_lens ) /
+			    sizeof ( bench_lens[0] ) ) ; i++ ) {
+		len = bench_lens[i];
+		snprintf ( name, sizeof ( name ), "%s-%d.encrypt",
+			   cipher->name, bench->keylen );
+		bench_report ( name, len,
+			       cipher_cycles_encrypt ( cipher, key_len, len ) );
+		snprintf ( name, sizeof ( name ), "%s-%d.decrypt",
+			   cipher->name, bench->keylen );
+		bench_report ( name, len,
+			       cipher_cycles_decrypt ( cipher, key_len, len ) );
+	}
+}
+
+/**
+ * Run digest benchmark
+ *
+ * @v digest		Digest algorithm
+ */
+static void digest_bench ( struct digest_algorithm *digest ) {
+	size_t len;
+	unsigned int i;
+
+	for ( i = 0 ; i < ( sizeof ( bench_lens ) /
+			    sizeof ( bench_lens[0] ) ) ; i++ ) {
+		len = bench_lens[i];
+		bench_report ( digest->name, len, digest_cycles ( digest, len ) );
+	}
+}
+
+/**
+ * Run HMAC_DRBG benchmark
+ *
+ * @v hash		Underlying hash algorithm
+ */
+static void hmac_drbg_bench ( struct digest_algorithm *hash ) {
+	static uint8_t data[DIGEST_COST_MAX_LEN]; /* Too large for stack */
+	uint8_t entropy[ hash->digestsize + ( hash->digestsize / 2 ) ];
+	struct hmac_drbg_state state;
+	struct profiler profiler;
+	char name[BENCH_NAME_LEN];
+	size_t len;
+	unsigned int i;
+	unsigned int j;
+	int rc;
+
+	/* Instantiate DRBG */
+	srand ( 0x1234568 );
+	for ( i = 0 ; i < sizeof ( entropy ) ; i++ )
+		entropy[i] = rand();
+	hmac_drbg_instantiate ( hash, &state, entropy, sizeof ( entropy ),
+				NULL, 0 );
+
+	/* Profile generation */
+	snprintf ( name, sizeof ( name ), "hmac_drbg_%s", hash->name );
+	for ( i = 0 ; i < ( sizeof ( bench_lens ) /
+			    sizeof ( bench_lens[0] ) ) ; i++ ) {
+		len = bench_lens[i];
+		memset ( &profiler, 0, sizeof ( profiler ) );
+		for ( j = 0 ; j < BENCH_COUNT ; j++ ) {
+			profile_start ( &profiler );
+			rc = hmac_drbg_generate ( hash, &state, NULL, 0,
+						  data, len );
+			profile_stop ( &profiler );
+			ok ( rc == 0 );
+		}
+		bench_report ( name, len, profile_mean ( &profiler ) );
+	}
+}
+
+/**
+ * Run RSA signature benchmark
+ *
+ * @v digest		Digest algorithm
+ */
+static void rsa_bench ( struct digest_algorithm *digest ) {
+	struct pubkey_algorithm *pubkey = &rsa_algorithm;
+	uint8_t ctx[pubkey->ctxsize];
+	uint8_t digestctx[digest->ctxsize];
+	uint8_t value[digest->digestsize];
+	struct profiler profiler;
+	char name[BENCH_NAME_LEN];
+	unsigned int bits;
+	unsigned int i;
+	size_t max_len;
+	int len;
+	int rc;
+
+	/* Calculate digest of an arbitrary message */
+	digest_init ( digest, digestctx );
+	digest_update ( digest, digestctx, bench_rsa_public,
+			sizeof ( bench_rsa_public ) );
+	digest_final ( digest, digestctx, value );
+
+	/* Determine signature length */
+	ok ( pubkey_init ( pubkey, ctx, bench_rsa_private,
+			   sizeof ( bench_rsa_private ) ) == 0 );
+	max_len = pubkey_max_len ( pubkey, ctx );
+	bits = ( max_len * 8 );
+	{
+		uint8_t signature[max_len];
+
+		/* Profile signing */
+		memset ( &profiler, 0, sizeof ( profiler ) );
+		for ( i = 0 ; i < BENCH_COUNT ; i++ ) {
+			profile_start ( &profiler );
+			len = pubkey_sign ( pubkey, ctx, digest, value,
+					    signature );
+			profile_stop ( &profiler );
+			ok ( len == ( ( int ) max_len ) );
+		}
+		pubkey_final ( pubkey, ctx );
+		snprintf ( name, sizeof ( name ), "rsa-%d_%s.sign",
+			   bits, digest->name );
+		bench_report ( name, 0, profile_mean ( &profiler ) );
+
+		/* Profile verification */
+		ok ( pubkey_init ( pubkey, ctx, bench_rsa_public,
+				   sizeof ( bench_rsa_public ) ) == 0 );
+		memset ( &profiler, 0, sizeof ( profiler ) );
+		for ( i = 0 ; i < BENCH_COUNT ; i++ ) {
+			profile_start ( &profiler );
+			rc = pubkey_verify ( pubkey, ctx, digest, value,
+					     signature, max_len );
+			profile_stop ( &profiler );
+			ok ( rc == 0 );
+		}
+		pubkey_final ( pubkey, ctx );
+		snprintf ( name, sizeof ( name ), "rsa-%d_%s.verify",
+			   bits, digest->name );
+		bench_report ( name, 0, profile_mean ( &profiler ) );
+	}
+}
+
+/**
+ * Run big integer modular exponentiation benchmark
+ *
+ * @v bits		Length of modulus (in bits)
+ */
+static void modexp_bench ( unsigned int bits ) {
+	unsigned int size = bigint_required_size ( bits / 8 );
+	bigint_t ( size ) base;
+	bigint_t ( size ) modulus;
+	bigint_t ( size ) exponent;
+	bigint_t ( size ) result;
+	size_t tmp_len = bigint_mod_exp_tmp_len ( &modulus, &exponent );
+	uint8_t tmp[tmp_len];
+	uint8_t raw[ bits / 8 ];
+	struct profiler profiler;
+	char name[BENCH_NAME_LEN];
+	unsigned int i;
+
+	/* Construct an odd full-length modulus, a smaller base, and
+	 * a full-length exponent (as for an RSA private key operation).
+	 */
+	srand ( 0x1234568 );
+	for ( i = 0 ; i < sizeof ( raw ) ; i++ )
+		raw[i] = rand();
+	raw[0] |= 0x80;
+	raw[ sizeof ( raw ) - 1 ] |= 0x01;
+	bigint_init ( &modulus, raw, sizeof ( raw ) );
+	raw[0] &= ~0x80;
+	bigint_init ( &base, raw, sizeof ( raw ) );
+	for ( i = 0 ; i < sizeof ( raw ) ; i++ )
+		raw[i] = rand();
+	bigint_init ( &exponent, raw, sizeof ( raw ) );
+
+	/* Profile modular exponentiation */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < BENCH_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		bigint_mod_exp ( &base, &modulus, &exponent, &result, tmp );
+		profile_stop ( &profiler );
+	}
+	snprintf ( name, sizeof ( name ), "bigint-%d.mod_exp", bits );
+	bench_report ( name, 0, profile_mean ( &profiler ) );
+}
+
+/**
+ * Perform cryptographic algorithm benchmarks
+ *
+ */
+static void crypto_bench_exec ( void ) {
+	unsigned int i;
+
+	for ( i = 0 ; i < ( sizeof ( cipher_benches ) /
+			    sizeof ( cipher_benches[0] ) ) ; i++ ) {
+		cipher_bench ( &cipher_benches[i] );
+	}
+	for ( i = 0 ; i < ( sizeof ( digest_benches ) /
+			    sizeof ( digest_benches[0] ) ) ; i++ ) {
+		digest_bench ( digest_benches[i] );
+	}
+	hmac_drbg_bench ( &sha256_algorithm );
+	rsa_bench ( &sha256_algorithm );
+	for ( i = 0 ; i < ( sizeof ( modexp_benches ) /
+			    sizeof ( modexp_benches[0] ) ) ; i++ ) {
+		modexp_bench ( modexp_benches[i] );
+	}
+}
+
+/** Cryptographic algorithm benchmarks */
+struct self_test crypto_bench __self_test = {
+	.name = "crypto_bench",
+	.exec = crypto_bench_exec,
+};
+
+/* Drag in algorithms required for benchmarks */
+REQUIRING_SYMBOL ( crypto_bench );
+REQUIRE_OBJECT ( rsa_sha256 );
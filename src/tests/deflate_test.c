@@ -37,6 +37,10 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <string.h>
 #include <ipxe/deflate.h>
 #include <ipxe/test.h>
+#include <ipxe/profile.h>
+
+/** Number of sample iterations for profiling */
+#define PROFILE_COUNT 16
 
 /** A DEFLATE test */
 struct deflate_test {
@@ -143,6 +147,160 @@ static struct deflate_test_fragments zlib_fragments[] = {
 	{ { 48, -1UL } },
 };
 
+/** Length of pseudo-random text */
+#define TEXT_LEN 4096
+
+/** Pseudo-random text vocabulary */
+static const char *text_words[16] = {
+	"the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+	"iPXE", "network", "boot", "firmware", "deflate", "huffman", "bits",
+	"data",
+};
+
+/**
+ * Generate pseudo-random text
+ *
+ * @v data		Data buffer
+ * @v len		Length of data buffer
+ *
+ * The text consists of words drawn from a small vocabulary,
+ * interspersed with occasional arbitrary bytes.  This produces a
+ * stream using dynamic Huffman alphabets with a wide range of symbol
+ * lengths, and a mixture of literals and duplicated strings.
+ */
+static void text_generate ( uint8_t *data, size_t len ) {
+	uint32_t seed = 1;
+	const char *word;
+	size_t offset = 0;
+
+	#define TEXT_RANDOM() \
+		( seed = ( ( seed * 1103515245UL ) + 12345 ), ( seed >> 16 ) )
+	while ( offset < len ) {
+		if ( ( TEXT_RANDOM() % 100 ) < 8 ) {
+			data[offset++] = TEXT_RANDOM();
+			continue;
+		}
+		word = text_words[ TEXT_RANDOM() % 16 ];
+		while ( *word && ( offset < len ) )
+			data[offset++] = *(word++);
+		if ( offset < len )
+			data[offset++] = ' ';
+	}
+	#undef TEXT_RANDOM
+}
+
+/* Pseudo-random text, as constructed by text_generate() */
+static const uint8_t text_compressed[] = {
+	0x75, 0x57, 0xb9, 0x8e, 0x13, 0x41, 0x10, 0x15, 0x12, 0x2b,
+	0x91, 0x42, 0x8e, 0x34, 0x01, 0xbf, 0x42, 0x4e, 0xb0, 0x12,
+	0x10, 0xda, 0xd8, 0x66, 0xcd, 0x1e, 0xb3, 0xeb, 0xb5, 0xf7,
+	0x40, 0x02, 0x02, 0x32, 0x22, 0x3e, 0x83, 0x08, 0x89, 0x2f,
+	0x00, 0x89, 0x4f, 0x20, 0x45, 0x44, 0xc4, 0x90, 0x22, 0x44,
+	0xc0, 0x54, 0x55, 0x57, 0xd5, 0x7b, 0xdd, 0xbd, 0x81, 0xc7,
+	0xd3, 0x57, 0x9d, 0xaf, 0x5e, 0xf5, 0xcc, 0xd7, 0xdb, 0xf3,
+	0x61, 0xb5, 0xde, 0x1c, 0x5f, 0xce, 0x36, 0xcb, 0xce, 0xcb,
+	0xd1, 0xec, 0xe5, 0xf5, 0xb0, 0x98, 0x6d, 0x67, 0xc3, 0x62,
+	0xb9, 0x3a, 0x9a, 0x6d, 0x97, 0xc3, 0x62, 0x7c, 0x6e, 0x13,
+	0x3f, 0xe6, 0x9b, 0xf1, 0xf2, 0x44, 0xc7, 0xba, 0xeb, 0x64,
+	0xb9, 0xbd, 0x1c, 0x37, 0x87, 0xc3, 0xfa, 0xd1, 0x93, 0x87,
+	0x31, 0xd0, 0x95, 0x90, 0x36, 0x5e, 0x2c, 0x37, 0xb6, 0xfe,
+	0x62, 0x77, 0x7c, 0x7a, 0x6e, 0x72, 0xe6, 0x64, 0x82, 0x09,
+	0xd5, 0x3d, 0xab, 0xf1, 0x0a, 0xf4, 0xbb, 0x44, 0x1d, 0x98,
+	0xd8, 0x69, 0xfd, 0x60, 0xb7, 0x5a, 0x1d, 0xcf, 0x4e, 0x86,
+	0xf9, 0x38, 0x6e, 0x6d, 0xf6, 0xa7, 0xca, 0xf3, 0xdd, 0x3a,
+	0xd0, 0xf9, 0xd3, 0x50, 0x71, 0xb6, 0x5b, 0x3f, 0x3b, 0x1c,
+	0xf6, 0xd4, 0x18, 0xf7, 0xca, 0xe5, 0xc4, 0x26, 0x17, 0xf0,
+	0xcd, 0x57, 0x54, 0xaf, 0x9e, 0x51, 0x71, 0x6a, 0xa1, 0x19,
+	0xab, 0x3a, 0xec, 0xd5, 0x44, 0xdb, 0x7b, 0xee, 0x95, 0x10,
+	0x51, 0x40, 0xf4, 0x30, 0xe9, 0xf7, 0xff, 0xca, 0x48, 0xf2,
+	0x1c, 0xa6, 0xdc, 0xa8, 0xed, 0x41, 0x09, 0x6a, 0xd8, 0x3f,
+	0xc5, 0x44, 0xed, 0xc9, 0x30, 0x59, 0xa8, 0x35, 0x40, 0xb2,
+	0x6a, 0x52, 0x6c, 0x32, 0xb4, 0x89, 0x1c, 0x10, 0x2f, 0x43,
+	0x70, 0xa2, 0xac, 0x4c, 0x5e, 0x40, 0x76, 0x5e, 0xbb, 0x59,
+	0x26, 0x4a, 0x8e, 0x44, 0xd0, 0x23, 0x19, 0x32, 0x4b, 0xe8,
+	0x49, 0x04, 0xb4, 0x58, 0x8b, 0xe3, 0x16, 0x55, 0x7d, 0x8a,
+	0x00, 0x95, 0x64, 0xd1, 0x9a, 0x4c, 0x90, 0x99, 0x38, 0x62,
+	0xba, 0x2d, 0xc8, 0xa8, 0xc1, 0x52, 0x22, 0x66, 0xd0, 0x76,
+	0x82, 0x86, 0x08, 0x2b, 0xf9, 0x92, 0x8d, 0x7a, 0x4e, 0x02,
+	0x64, 0xd6, 0xc5, 0x19, 0x75, 0x5b, 0x36, 0xfc, 0x0e, 0x8f,
+	0x30, 0xcb, 0x8c, 0xed, 0x8c, 0x7a, 0x0d, 0xac, 0x7d, 0xaa,
+	0x9f, 0xe9, 0x87, 0x19, 0xd3, 0x13, 0x26, 0xd5, 0x9e, 0x6a,
+	0x83, 0x0a, 0x33, 0x0f, 0x55, 0xb8, 0xa8, 0x7e, 0x6b, 0xe3,
+	0x5c, 0xb7, 0xfd, 0x22, 0xc4, 0x1c, 0x87, 0xd8, 0xb9, 0x46,
+	0x95, 0xae, 0x0f, 0xaa, 0x16, 0x1f, 0xa4, 0x84, 0xf2, 0x46,
+	0xb5, 0xdf, 0xf5, 0xb5, 0xa0, 0x47, 0xb0, 0x16, 0xa9, 0x26,
+	0x05, 0xe5, 0x54, 0x16, 0x86, 0xec, 0x75, 0x7b, 0xf6, 0x08,
+	0x76, 0x7e, 0x04, 0xb4, 0x65, 0x8c, 0xa9, 0x8c, 0x89, 0x01,
+	0x78, 0x3d, 0x24, 0xb6, 0xd5, 0x4a, 0xe5, 0x01, 0x47, 0x4b,
+	0xa4, 0xc4, 0x7e, 0x8b, 0xa6, 0xf3, 0x58, 0x04, 0x49, 0x74,
+	0x7e, 0x2e, 0x44, 0x55, 0x4c, 0x2f, 0x95, 0x50, 0x46, 0xc4,
+	0x78, 0xa1, 0xa2, 0x2c, 0xa2, 0x6f, 0xaa, 0x85, 0x7c, 0xa9,
+	0xea, 0x8f, 0xc0, 0x8b, 0x40, 0x10, 0xab, 0x34, 0x76, 0xd3,
+	0xff, 0x9d, 0xf0, 0x56, 0x02, 0x1f, 0xe4, 0xeb, 0x4a, 0x8c,
+	0x91, 0x44, 0x93, 0xad, 0x21, 0xce, 0x81, 0x03, 0xb4, 0x24,
+	0x8b, 0x3a, 0xde, 0x88, 0xd8, 0x01, 0x18, 0xfa, 0x32, 0xe9,
+	0x69, 0x2c, 0xff, 0xd4, 0x49, 0x7d, 0x4d, 0x66, 0x60, 0x2c,
+	0x38, 0x9a, 0x3c, 0xa9, 0x6f, 0x17, 0x14, 0x7f, 0x17, 0x6f,
+	0x0e, 0x74, 0xac, 0x6a, 0x88, 0x13, 0x0a, 0x86, 0x0f, 0x53,
+	0x39, 0x54, 0x09, 0xf5, 0x9e, 0x06, 0x1c, 0xf8, 0xb8, 0x69,
+	0x09, 0xff, 0x7c, 0xc6, 0x75, 0xfb, 0x7f, 0xd2, 0x25, 0x84,
+	0x3f, 0x36, 0xf7, 0x78, 0x02, 0xda, 0x5f, 0xb4, 0x32, 0xe0,
+	0xa2, 0xec, 0x8b, 0x9c, 0x21, 0xcc, 0x5d, 0x37, 0x4c, 0x9d,
+	0x4e, 0x1b, 0xc4, 0x49, 0xe5, 0x43, 0x31, 0x8c, 0x42, 0xfe,
+	0x55, 0xc1, 0xb2, 0x7d, 0x89, 0xc6, 0x1c, 0x7d, 0x82, 0x08,
+	0x16, 0x7c, 0xa0, 0x5a, 0x6a, 0xfa, 0xb5, 0x9f, 0x04, 0x8e,
+	0xa3, 0x03, 0xd6, 0x34, 0x0a, 0xdd, 0x47, 0x7a, 0xde, 0x24,
+	0x96, 0xc9, 0x9b, 0xa0, 0x3f, 0x00, 0x08, 0xdd, 0x49, 0x6e,
+	0xee, 0x55, 0x75, 0xd9, 0x36, 0xc0, 0x16, 0x95, 0xb7, 0x0d,
+	0xce, 0x1e, 0xa6, 0x66, 0x0f, 0x87, 0x27, 0x36, 0x2b, 0x2e,
+	0xb2, 0xda, 0xc3, 0x27, 0x04, 0x73, 0x76, 0xa1, 0xa6, 0x97,
+	0x73, 0x95, 0x72, 0x7d, 0xd5, 0x6d, 0xa0, 0x39, 0xe3, 0xa5,
+	0x1e, 0xdc, 0x86, 0xbc, 0x64, 0xa7, 0xf7, 0x21, 0x5b, 0x5d,
+	0x82, 0xe7, 0xcb, 0x1b, 0x38, 0x11, 0x42, 0xf3, 0x7a, 0x05,
+	0x91, 0xef, 0xc7, 0x48, 0xb7, 0x6a, 0x44, 0xdc, 0x34, 0xd3,
+	0x49, 0xe5, 0xc8, 0xae, 0xa6, 0x74, 0x24, 0x25, 0x9b, 0x20,
+	0x1d, 0xf7, 0x3f, 0x80, 0xac, 0xec, 0xf6, 0xea, 0x58, 0x60,
+	0x51, 0x32, 0xf2, 0xd1, 0x9a, 0xa4, 0xd6, 0xd8, 0x64, 0xfe,
+	0xad, 0xc4, 0x03, 0xa1, 0x0f, 0xf3, 0x55, 0x71, 0xbd, 0x95,
+	0x66, 0x14, 0x29, 0xa1, 0xac, 0xbd, 0x03, 0x66, 0xf3, 0x73,
+	0x12, 0x8f, 0x02, 0x62, 0x86, 0x84, 0x7c, 0xfe, 0x4d, 0x15,
+	0x3d, 0x7e, 0x6e, 0x30, 0x47, 0xcd, 0x9c, 0x23, 0x40, 0x97,
+	0xce, 0x33, 0xcb, 0x1a, 0xc0, 0xe0, 0x5e, 0x40, 0x2e, 0xf3,
+	0x16, 0x53, 0xd1, 0x0f, 0xab, 0x56, 0xaa, 0x76, 0x9b, 0x8f,
+	0x91, 0xa7, 0xbc, 0x15, 0xb6, 0xdf, 0x0b, 0x15, 0xa5, 0x98,
+	0x5f, 0x22, 0xe3, 0x7d, 0x26, 0x12, 0xef, 0x42, 0xd4, 0x0a,
+	0xfb, 0x0c, 0x1e, 0x60, 0x8f, 0x1b, 0xa9, 0x47, 0x98, 0x61,
+	0xa1, 0x16, 0x61, 0xb1, 0x67, 0xbd, 0x50, 0x33, 0xb8, 0x89,
+	0xd7, 0xcd, 0xcb, 0xef, 0x01, 0x8f, 0xbb, 0xd0, 0xdb, 0x92,
+	0xa2, 0x33, 0x34, 0x4f, 0xd7, 0xd4, 0xde, 0xa8, 0x3d, 0x74,
+	0x6b, 0xa2, 0x56, 0x9c, 0x42, 0x01, 0xf5, 0x0f, 0xc8, 0xc6,
+	0x7e, 0x6e, 0x81, 0x46, 0xa9, 0xde, 0x32, 0xc4, 0x65, 0x11,
+	0xfb, 0x40, 0x30, 0xd1, 0x3b, 0xba, 0x9a, 0xb8, 0xa6, 0x3f,
+	0x55, 0x53, 0xca, 0x48, 0x73, 0x99, 0xf4, 0x1a, 0x7e, 0x4d,
+	0x47, 0x79, 0x39, 0xf6, 0xeb, 0x2f, 0x03, 0x95, 0xc9, 0xad,
+	0xf1, 0xd5, 0x6f, 0x41, 0x74, 0x05, 0xa1, 0x00, 0x44, 0x49,
+	0x57, 0x44, 0xf6, 0x85, 0x5c, 0x53, 0x98, 0x10, 0x12, 0xe3,
+	0xfb, 0x0c, 0x22, 0xc8, 0x9d, 0x15, 0xd1, 0x82, 0xf8, 0x84,
+	0x0f, 0xc0, 0x64, 0x91, 0xf8, 0x88, 0xb8, 0x22, 0x55, 0xd7,
+	0xf9, 0x59, 0x06, 0x5d, 0xa5, 0x5c, 0xca, 0xe2, 0x22, 0x17,
+	0x74, 0x9d, 0x14, 0x9d, 0x1c, 0x03, 0x89, 0x78, 0xc5, 0x44,
+	0x10, 0x65, 0x4b, 0xe0, 0xfb, 0xca, 0x20, 0x4e, 0xc6, 0x4a,
+	0x20, 0xc8, 0xef, 0x3f
+};
+static struct deflate_test text = {
+	.format = DEFLATE_RAW,
+	.compressed = text_compressed,
+	.compressed_len = sizeof ( text_compressed ),
+	.expected_len = TEXT_LEN,
+};
+
+/* Pseudo-random text fragment list */
+static struct deflate_test_fragments text_fragments[] = {
+	{ { 1, 2, 3, 500, -1UL } },
+	{ { 7, 100, 7, 100, 7, 100, 7, -1UL } },
+	{ { 600, 1, 1, 1, 1, 1, 1, -1UL } },
+};
+
 /**
  * Report DEFLATE test result
  *
@@ -207,18 +365,64 @@ static void deflate_okx ( struct deflate *deflate,
 #define deflate_ok( deflate, test, frags ) \
 	deflate_okx ( deflate, test, frags, __FILE__, __LINE__ )
 
+/**
+ * Report DEFLATE speed test result
+ *
+ * @v deflate		Decompressor
+ * @v test		Deflate test
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void deflate_speed_okx ( struct deflate *deflate,
+				struct deflate_test *test,
+				const char *file, unsigned int line ) {
+	uint8_t data[ test->expected_len ];
+	struct deflate_chunk in;
+	struct deflate_chunk out;
+	struct profiler profiler;
+	unsigned int i;
+
+	/* Profile decompression */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
+		deflate_init ( deflate, test->format );
+		deflate_chunk_init ( &in, virt_to_user ( test->compressed ),
+				     0, test->compressed_len );
+		deflate_chunk_init ( &out, virt_to_user ( data ), 0,
+				     sizeof ( data ) );
+		profile_start ( &profiler );
+		okx ( deflate_inflate ( deflate, &in, &out ) == 0, file, line );
+		profile_stop ( &profiler );
+		okx ( deflate_finished ( deflate ), file, line );
+		okx ( out.offset == test->expected_len, file, line );
+	}
+	DBG ( "DEFLATE inflated %zd bytes to %zd bytes in %ld +/- %ld "
+	      "ticks\n", test->compressed_len, test->expected_len,
+	      profile_mean ( &profiler ), profile_stddev ( &profiler ) );
+}
+#define deflate_speed_ok( deflate, test ) \
+	deflate_speed_okx ( deflate, test, __FILE__, __LINE__ )
+
 /**
  * Perform DEFLATE self-test
  *
  */
 static void deflate_test_exec ( void ) {
 	struct deflate *deflate;
+	uint8_t *text_expected;
 	unsigned int i;
 
 	/* Allocate shared structure */
 	deflate = malloc ( sizeof ( *deflate ) );
 	ok ( deflate != NULL );
 
+	/* Generate pseudo-random text */
+	text_expected = malloc ( TEXT_LEN );
+	ok ( text_expected != NULL );
+	if ( text_expected )
+		text_generate ( text_expected, TEXT_LEN );
+	text.expected = text_expected;
+
 	/* Perform self-tests */
 	if ( deflate ) {
 
@@ -239,7 +443,18 @@ static void deflate_test_exec ( void ) {
 		}
 	}
 
-	/* Free shared structure */
+	/* Test pseudo-random text */
+	if ( deflate && text_expected ) {
+		deflate_ok ( deflate, &text, NULL );
+		for ( i = 0 ; i < ( sizeof ( text_fragments ) /
+				    sizeof ( text_fragments[0] ) ) ; i++ ) {
+			deflate_ok ( deflate, &text, &text_fragments[i] );
+		}
+		deflate_speed_ok ( deflate, &text );
+	}
+
+	/* Free shared structures */
+	free ( text_expected );
 	free ( deflate );
 }
 
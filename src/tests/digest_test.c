@@ -34,6 +34,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdlib.h>
 #include <string.h>
+#include <assert.h>
 #include <ipxe/crypto.h>
 #include <ipxe/profile.h>
 #include "digest_test.h"
@@ -123,22 +124,25 @@ void digest_okx ( struct digest_test *test, const char *file,
 }
 
 /**
- * Calculate digest algorithm cost
+ * Profile digest algorithm
  *
  * @v digest		Digest algorithm
- * @ret cost		Cost (in cycles per byte)
+ * @v len		Length of data
+ * @ret cycles		Mean cost (in cycles per operation)
  */
-unsigned long digest_cost ( struct digest_algorithm *digest ) {
-	static uint8_t random[8192]; /* Too large for stack */
+unsigned long digest_cycles ( struct digest_algorithm *digest, size_t len ) {
+	static uint8_t random[DIGEST_COST_MAX_LEN]; /* Too large for stack */
 	uint8_t ctx[digest->ctxsize];
 	uint8_t out[digest->digestsize];
 	struct profiler profiler;
-	unsigned long cost;
 	unsigned int i;
 
+	/* Sanity check */
+	assert ( len <= sizeof ( random ) );
+
 	/* Fill buffer with pseudo-random data */
 	srand ( 0x1234568 );
-	for ( i = 0 ; i < sizeof ( random ) ; i++ )
+	for ( i = 0 ; i < len ; i++ )
 		random[i] = rand();
 
 	/* Profile digest calculation */
@@ -146,14 +150,30 @@ unsigned long digest_cost ( struct digest_algorithm *digest ) {
 	for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
 		profile_start ( &profiler );
 		digest_init ( digest, ctx );
-		digest_update ( digest, ctx, random, sizeof ( random ) );
+		digest_update ( digest, ctx, random, len );
 		digest_final ( digest, ctx, out );
 		profile_stop ( &profiler );
 	}
 
+	return profile_mean ( &profiler );
+}
+
+/**
+ * Calculate digest algorithm cost
+ *
+ * @v digest		Digest algorithm
+ * @ret cost		Cost (in cycles per byte)
+ */
+unsigned long digest_cost ( struct digest_algorithm *digest ) {
+	unsigned long cycles;
+	unsigned long cost;
+
+	/* Profile digest calculation */
+	cycles = digest_cycles ( digest, DIGEST_COST_MAX_LEN );
+
 	/* Round to nearest whole number of cycles per byte */
-	cost = ( ( profile_mean ( &profiler ) + ( sizeof ( random ) / 2 ) ) /
-		 sizeof ( random ) );
+	cost = ( ( cycles + ( DIGEST_COST_MAX_LEN / 2 ) ) /
+		 DIGEST_COST_MAX_LEN );
 
 	return cost;
 }
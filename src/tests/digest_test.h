@@ -7,6 +7,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/crypto.h>
 #include <ipxe/test.h>
 
+/** Maximum length of data for digest profiling */
+#define DIGEST_COST_MAX_LEN 8192
+
 /** A digest test */
 struct digest_test {
 	/** Digest algorithm */
@@ -110,6 +113,8 @@ struct digest_test {
 
 extern void digest_okx ( struct digest_test *test, const char *file,
 			 unsigned int line );
+extern unsigned long digest_cycles ( struct digest_algorithm *digest,
+				     size_t len );
 extern unsigned long digest_cost ( struct digest_algorithm *digest );
 
 #endif /* _DIGEST_TEST_H */
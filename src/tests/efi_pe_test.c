@@ -0,0 +1,134 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER );
+
+/** @file
+ *
+ * EFI PE image header tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <ipxe/image.h>
+#include <ipxe/efi/efi_pe.h>
+#include <ipxe/test.h>
+
+/** A minimal PE image */
+struct efi_pe_test_image {
+	/** DOS header */
+	EFI_IMAGE_DOS_HEADER dos;
+	/** PE header */
+	EFI_IMAGE_OPTIONAL_HEADER_UNION pe;
+} __attribute__ (( packed ));
+
+/** Test image data */
+static struct efi_pe_test_image efi_pe_test_data;
+
+/** Test image */
+static struct image efi_pe_test_image = {
+	.refcnt = REF_INIT ( ref_no_free ),
+	.name = "test.efi",
+	.data = ( userptr_t ) &efi_pe_test_data,
+	.len = sizeof ( efi_pe_test_data ),
+};
+
+/**
+ * Construct test image
+ *
+ * @v machine		PE machine type
+ * @v magic		Optional header magic
+ * @v subsystem		Subsystem
+ */
+static void efi_pe_test_build ( unsigned int machine, unsigned int magic,
+				unsigned int subsystem ) {
+	struct efi_pe_test_image *data = &efi_pe_test_data;
+
+	memset ( data, 0, sizeof ( *data ) );
+	data->dos.e_magic = EFI_IMAGE_DOS_SIGNATURE;
+	data->dos.e_lfanew = offsetof ( typeof ( *data ), pe );
+	data->pe.Pe32.Signature = EFI_IMAGE_NT_SIGNATURE;
+	data->pe.Pe32.FileHeader.Machine = machine;
+	data->pe.Pe32.OptionalHeader.Magic = magic;
+	if ( magic == EFI_IMAGE_NT_OPTIONAL_HDR64_MAGIC ) {
+		data->pe.Pe32Plus.OptionalHeader.Subsystem = subsystem;
+	} else {
+		data->pe.Pe32.OptionalHeader.Subsystem = subsystem;
+	}
+}
+
+/**
+ * Perform EFI PE image header self-tests
+ *
+ */
+static void efi_pe_test_exec ( void ) {
+	struct image *image = &efi_pe_test_image;
+
+	/* PE32+ application for the required machine type */
+	efi_pe_test_build ( IMAGE_FILE_MACHINE_X64,
+			    EFI_IMAGE_NT_OPTIONAL_HDR64_MAGIC,
+			    EFI_IMAGE_SUBSYSTEM_EFI_APPLICATION );
+	ok ( efi_pe_check ( image, IMAGE_FILE_MACHINE_X64 ) == 0 );
+
+	/* PE32 driver for the required machine type */
+	efi_pe_test_build ( IMAGE_FILE_MACHINE_I386,
+			    EFI_IMAGE_NT_OPTIONAL_HDR32_MAGIC,
+			    EFI_IMAGE_SUBSYSTEM_EFI_BOOT_SERVICE_DRIVER );
+	ok ( efi_pe_check ( image, IMAGE_FILE_MACHINE_I386 ) == 0 );
+
+	/* Machine type mismatch */
+	efi_pe_test_build ( IMAGE_FILE_MACHINE_ARM64,
+			    EFI_IMAGE_NT_OPTIONAL_HDR64_MAGIC,
+			    EFI_IMAGE_SUBSYSTEM_EFI_APPLICATION );
+	ok ( efi_pe_check ( image, IMAGE_FILE_MACHINE_X64 ) != 0 );
+	ok ( efi_pe_check ( image, IMAGE_FILE_MACHINE_ARM64 ) == 0 );
+	efi_pe_test_build ( IMAGE_FILE_MACHINE_I386,
+			    EFI_IMAGE_NT_OPTIONAL_HDR32_MAGIC,
+			    EFI_IMAGE_SUBSYSTEM_EFI_APPLICATION );
+	ok ( efi_pe_check ( image, IMAGE_FILE_MACHINE_X64 ) != 0 );
+
+	/* Non-EFI subsystem */
+	efi_pe_test_build ( IMAGE_FILE_MACHINE_X64,
+			    EFI_IMAGE_NT_OPTIONAL_HDR64_MAGIC,
+			    EFI_IMAGE_SUBSYSTEM_SAL_RUNTIME_DRIVER );
+	ok ( efi_pe_check ( image, IMAGE_FILE_MACHINE_X64 ) != 0 );
+
+	/* Invalid PE signature */
+	efi_pe_test_build ( IMAGE_FILE_MACHINE_X64,
+			    EFI_IMAGE_NT_OPTIONAL_HDR64_MAGIC,
+			    EFI_IMAGE_SUBSYSTEM_EFI_APPLICATION );
+	efi_pe_test_data.pe.Pe32.Signature = 0;
+	ok ( efi_pe_check ( image, IMAGE_FILE_MACHINE_X64 ) != 0 );
+
+	/* Truncated image */
+	efi_pe_test_build ( IMAGE_FILE_MACHINE_X64,
+			    EFI_IMAGE_NT_OPTIONAL_HDR64_MAGIC,
+			    EFI_IMAGE_SUBSYSTEM_EFI_APPLICATION );
+	image->len = ( sizeof ( efi_pe_test_data ) - 1 );
+	ok ( efi_pe_check ( image, IMAGE_FILE_MACHINE_X64 ) != 0 );
+	image->len = sizeof ( efi_pe_test_data );
+}
+
+/** EFI PE image header self-test */
+struct self_test efi_pe_test __self_test = {
+	.name = "efi_pe",
+	.exec = efi_pe_test_exec,
+};
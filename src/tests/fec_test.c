@@ -0,0 +1,245 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+/** @file
+ *
+ * Reed-Solomon forward error correction self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ipxe/fec.h>
+#include <ipxe/test.h>
+
+/** A repair symbol encoding test */
+struct fec_encode_test {
+	/** Number of source symbols */
+	unsigned int k;
+	/** Source symbols (concatenated) */
+	const void *source;
+	/** Symbol length */
+	size_t len;
+	/** Repair symbol index */
+	unsigned int index;
+	/** Expected repair symbol */
+	const void *expected;
+};
+
+/** A source block recovery test */
+struct fec_decode_test {
+	/** Number of source symbols */
+	unsigned int k;
+	/** Symbol length */
+	size_t len;
+	/** Missing source symbol indices */
+	const uint8_t *missing;
+	/** Repair symbol indices */
+	const uint8_t *index;
+	/** Number of missing source symbols (and repair symbols) */
+	unsigned int count;
+};
+
+/** Define inline data */
+#define DATA(...) { __VA_ARGS__ }
+
+/** Define inline missing source symbol indices */
+#define MISSING(...) { __VA_ARGS__ }
+
+/** Define inline repair symbol indices */
+#define INDEX(...) { __VA_ARGS__ }
+
+/** Define a repair symbol encoding test */
+#define FEC_ENCODE_TEST( name, K, LEN, SOURCE, INDEX, EXPECTED )	\
+	static const uint8_t name ## _source[ (K) * (LEN) ] = SOURCE;	\
+	static const uint8_t name ## _expected[LEN] = EXPECTED;	\
+	static struct fec_encode_test name = {				\
+		.k = K,							\
+		.source = name ## _source,				\
+		.len = LEN,						\
+		.index = INDEX,						\
+		.expected = name ## _expected,				\
+	}
+
+/** Define a source block recovery test */
+#define FEC_DECODE_TEST( name, K, LEN, MISSING, INDEX )		\
+	static const uint8_t name ## _missing[] = MISSING;		\
+	static const uint8_t name ## _index[] = INDEX;			\
+	static struct fec_decode_test name = {				\
+		.k = K,							\
+		.len = LEN,						\
+		.missing = name ## _missing,				\
+		.index = name ## _index,				\
+		.count = sizeof ( name ## _missing ),			\
+	}
+
+/** Three-symbol source block */
+#define SOURCE3 DATA ( 'i', 'P', 'X', 'E', 'F', 'E', 'C', '!',		\
+		       't', 'e', 's', 't' )
+
+/** First repair symbol */
+FEC_ENCODE_TEST ( encode_first, 3, 4, SOURCE3, 3,
+		  DATA ( 0x70, 0xf9, 0x1f, 0x22 ) );
+
+/** Second repair symbol */
+FEC_ENCODE_TEST ( encode_second, 3, 4, SOURCE3, 4,
+		  DATA ( 0x0c, 0x38, 0x3d, 0xbe ) );
+
+/** Last possible repair symbol */
+FEC_ENCODE_TEST ( encode_last, 3, 4, SOURCE3, 255,
+		  DATA ( 0xf9, 0x34, 0xe5, 0xad ) );
+
+/** Single missing symbol */
+FEC_DECODE_TEST ( decode_single, 8, 64, MISSING ( 5 ), INDEX ( 8 ) );
+
+/** Several missing symbols, with non-consecutive repair symbols */
+FEC_DECODE_TEST ( decode_several, 10, 37, MISSING ( 0, 3, 9 ),
+		  INDEX ( 12, 10, 200 ) );
+
+/** All source symbols missing */
+FEC_DECODE_TEST ( decode_all, 4, 16, MISSING ( 0, 1, 2, 3 ),
+		  INDEX ( 4, 5, 6, 7 ) );
+
+/** Single-symbol source block */
+FEC_DECODE_TEST ( decode_tiny, 1, 100, MISSING ( 0 ), INDEX ( 42 ) );
+
+/** Large source block */
+FEC_DECODE_TEST ( decode_large, 200, 1024,
+		  MISSING ( 1, 17, 33, 64, 65, 66, 100, 150, 198, 199 ),
+		  INDEX ( 200, 201, 202, 203, 210, 220, 230, 240, 250, 255 ) );
+
+/**
+ * Report repair symbol encoding test result
+ *
+ * @v test		Repair symbol encoding test
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void fec_encode_okx ( struct fec_encode_test *test, const char *file,
+			     unsigned int line ) {
+	const void *source[test->k];
+	uint8_t repair[test->len];
+	unsigned int i;
+
+	/* Construct repair symbol */
+	for ( i = 0 ; i < test->k ; i++ )
+		source[i] = ( test->source + ( i * test->len ) );
+	fec_encode ( test->k, source, test->index, repair, test->len );
+
+	/* Verify repair symbol */
+	okx ( memcmp ( repair, test->expected, test->len ) == 0, file, line );
+}
+#define fec_encode_ok( test ) fec_encode_okx ( test, __FILE__, __LINE__ )
+
+/**
+ * Report source block recovery test result
+ *
+ * @v test		Source block recovery test
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void fec_decode_okx ( struct fec_decode_test *test, const char *file,
+			     unsigned int line ) {
+	size_t block_len = ( test->k * test->len );
+	void *source[test->k];
+	void *repair[test->count];
+	uint8_t *expected;
+	uint8_t *block;
+	uint8_t *repairs;
+	uint32_t seed;
+	unsigned int i;
+
+	/* Allocate buffers */
+	expected = malloc ( block_len );
+	block = malloc ( block_len );
+	repairs = malloc ( test->count * test->len );
+	okx ( expected != NULL, file, line );
+	okx ( block != NULL, file, line );
+	okx ( repairs != NULL, file, line );
+	if ( ! ( expected && block && repairs ) )
+		goto err_alloc;
+
+	/* Construct pseudo-random source block */
+	seed = ( ( test->k << 16 ) ^ test->len );
+	for ( i = 0 ; i < block_len ; i++ ) {
+		seed = ( ( seed * 1103515245 ) + 12345 );
+		expected[i] = ( seed >> 16 );
+	}
+	memcpy ( block, expected, block_len );
+	for ( i = 0 ; i < test->k ; i++ )
+		source[i] = ( block + ( i * test->len ) );
+
+	/* Construct repair symbols */
+	for ( i = 0 ; i < test->count ; i++ ) {
+		repair[i] = ( repairs + ( i * test->len ) );
+		fec_encode ( test->k, ( ( const void ** ) source ),
+			     test->index[i], repair[i], test->len );
+	}
+
+	/* Erase missing source symbols */
+	for ( i = 0 ; i < test->count ; i++ )
+		memset ( source[ test->missing[i] ], 0xeb, test->len );
+	okx ( memcmp ( block, expected, block_len ) != 0, file, line );
+
+	/* Recover missing source symbols */
+	okx ( fec_decode ( test->k, source, test->missing, repair,
+			   test->index, test->count, test->len ) == 0,
+	      file, line );
+
+	/* Verify source block */
+	okx ( memcmp ( block, expected, block_len ) == 0, file, line );
+
+ err_alloc:
+	free ( repairs );
+	free ( block );
+	free ( expected );
+}
+#define fec_decode_ok( test ) fec_decode_okx ( test, __FILE__, __LINE__ )
+
+/**
+ * Perform forward error correction self-tests
+ *
+ */
+static void fec_test_exec ( void ) {
+
+	/* Encoding tests */
+	fec_encode_ok ( &encode_first );
+	fec_encode_ok ( &encode_second );
+	fec_encode_ok ( &encode_last );
+
+	/* Decoding tests */
+	fec_decode_ok ( &decode_single );
+	fec_decode_ok ( &decode_several );
+	fec_decode_ok ( &decode_all );
+	fec_decode_ok ( &decode_tiny );
+	fec_decode_ok ( &decode_large );
+}
+
+/** Forward error correction self-test */
+struct self_test fec_test __self_test = {
+	.name = "fec",
+	.exec = fec_test_exec,
+};
@@ -0,0 +1,304 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+/** @file
+ *
+ * Fragment reassembly tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/ipstat.h>
+#include <ipxe/fragment.h>
+#include <ipxe/test.h>
+
+/** Length of test packet data */
+#define FRAGMENT_TEST_LEN 4000
+
+/** Headroom reserved in each test fragment */
+#define FRAGMENT_TEST_HEADROOM 64
+
+/** A test fragment header */
+struct fragment_test_header {
+	/** Packet identifier */
+	uint32_t ident;
+	/** Fragment offset */
+	uint32_t offset;
+	/** More fragments flag */
+	uint32_t more;
+	/** Padding */
+	uint8_t pad[4];
+} __attribute__ (( packed ));
+
+/** A fragment reassembly test fragment */
+struct fragment_test_fragment {
+	/** Offset */
+	size_t offset;
+	/** Length */
+	size_t len;
+	/** More fragments flag */
+	int more;
+};
+
+/** Test statistics */
+static struct ip_statistics fragment_test_stats;
+
+/**
+ * Check if test fragment matches fragment reassembly buffer
+ *
+ * @v fragment		Fragment reassembly buffer
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+ * @ret is_fragment	Fragment matches this reassembly buffer
+ */
+static int fragment_test_is_fragment ( struct fragment *fragment,
+				       struct io_buffer *iobuf,
+				       size_t hdrlen __unused ) {
+	struct fragment_test_header *frag_hdr = fragment->iobuf->data;
+	struct fragment_test_header *hdr = iobuf->data;
+
+	return ( hdr->ident == frag_hdr->ident );
+}
+
+/**
+ * Get test fragment offset
+ *
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+ * @ret offset		Offset
+ */
+static size_t fragment_test_offset ( struct io_buffer *iobuf,
+				     size_t hdrlen __unused ) {
+	struct fragment_test_header *hdr = iobuf->data;
+
+	return hdr->offset;
+}
+
+/**
+ * Check if more test fragments exist
+ *
+ * @v iobuf		I/O buffer
+ * @v hdrlen		Length of non-fragmentable potion of I/O buffer
+ * @ret more_frags	More fragments exist
+ */
+static int fragment_test_more ( struct io_buffer *iobuf,
+				size_t hdrlen __unused ) {
+	struct fragment_test_header *hdr = iobuf->data;
+
+	return hdr->more;
+}
+
+/** Test fragment reassembler */
+static struct fragment_reassembler fragment_test_reassembler = {
+	.is_fragment = fragment_test_is_fragment,
+	.fragment_offset = fragment_test_offset,
+	.more_fragments = fragment_test_more,
+	.stats = &fragment_test_stats,
+};
+
+/**
+ * Get expected packet data byte
+ *
+ * @v ident		Packet identifier
+ * @v offset		Offset
+ * @ret byte		Data byte
+ */
+static uint8_t fragment_test_byte ( uint32_t ident, size_t offset ) {
+
+	return ( ident + ( offset * 7 ) + ( offset >> 8 ) );
+}
+
+/**
+ * Pass test fragment to reassembler
+ *
+ * @v ident		Packet identifier
+ * @v frag		Test fragment
+ * @ret iobuf		Reassembled packet, or NULL
+ */
+static struct io_buffer *
+fragment_test_rx ( uint32_t ident, struct fragment_test_fragment *frag ) {
+	struct fragment_test_header *hdr;
+	struct io_buffer *iobuf;
+	size_t hdrlen = sizeof ( *hdr );
+	uint8_t *data;
+	unsigned int i;
+
+	/* Construct fragment */
+	iobuf = alloc_iob ( FRAGMENT_TEST_HEADROOM + hdrlen + frag->len );
+	assert ( iobuf != NULL );
+	iob_reserve ( iobuf, FRAGMENT_TEST_HEADROOM );
+	hdr = iob_put ( iobuf, sizeof ( *hdr ) );
+	memset ( hdr, 0, sizeof ( *hdr ) );
+	hdr->ident = ident;
+	hdr->offset = frag->offset;
+	hdr->more = frag->more;
+	data = iob_put ( iobuf, frag->len );
+	for ( i = 0 ; i < frag->len ; i++ )
+		data[i] = fragment_test_byte ( ident, ( frag->offset + i ) );
+
+	/* Reassemble */
+	iobuf = fragment_reassemble ( &fragment_test_reassembler, iobuf,
+				      &hdrlen );
+	if ( iobuf )
+		assert ( hdrlen == sizeof ( *hdr ) );
+	return iobuf;
+}
+
+/**
+ * Check reassembled packet
+ *
+ * @v ident		Packet identifier
+ * @v iobuf		Reassembled packet
+ * @v len		Expected length of packet data
+ * @ret ok		Packet is correct
+ */
+static int fragment_test_check ( uint32_t ident, struct io_buffer *iobuf,
+				 size_t len ) {
+	struct fragment_test_header *hdr = iobuf->data;
+	uint8_t *data = ( iobuf->data + sizeof ( *hdr ) );
+	unsigned int i;
+
+	if ( iob_headroom ( iobuf ) < FRAGMENT_TEST_HEADROOM )
+		return 0;
+	if ( iob_len ( iobuf ) != ( sizeof ( *hdr ) + len ) )
+		return 0;
+	if ( ( hdr->ident != ident ) || ( hdr->offset != 0 ) )
+		return 0;
+	for ( i = 0 ; i < len ; i++ ) {
+		if ( data[i] != fragment_test_byte ( ident, i ) )
+			return 0;
+	}
+	return 1;
+}
+
+/**
+ * Report fragment reassembly test result
+ *
+ * @v ident		Packet identifier
+ * @v frags		Test fragments (in order of transmission)
+ * @v count		Number of test fragments
+ * @v len		Expected length of packet data
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void fragment_okx ( uint32_t ident, struct fragment_test_fragment *frags,
+			   unsigned int count, size_t len, const char *file,
+			   unsigned int line ) {
+	struct io_buffer *iobuf = NULL;
+	unsigned int i;
+
+	/* Only the final fragment should complete reassembly */
+	for ( i = 0 ; i < count ; i++ ) {
+		okx ( iobuf == NULL, file, line );
+		iobuf = fragment_test_rx ( ident, &frags[i] );
+	}
+	okx ( iobuf != NULL, file, line );
+	if ( iobuf ) {
+		okx ( fragment_test_check ( ident, iobuf, len ), file, line );
+		free_iob ( iobuf );
+	}
+}
+#define fragment_ok( ident, frags, len ) \
+	fragment_okx ( ident, frags, ( sizeof ( frags ) /		\
+				       sizeof ( frags[0] ) ), len,	\
+		       __FILE__, __LINE__ )
+
+/** In-order fragments */
+static struct fragment_test_fragment in_order[] = {
+	{ 0, 1480, 1 }, { 1480, 1480, 1 }, { 2960, 1040, 0 },
+};
+
+/** Reversed fragments */
+static struct fragment_test_fragment reversed[] = {
+	{ 2960, 1040, 0 }, { 1480, 1480, 1 }, { 0, 1480, 1 },
+};
+
+/** Shuffled fragments */
+static struct fragment_test_fragment shuffled[] = {
+	{ 1000, 1000, 1 }, { 3000, 1000, 0 }, { 0, 1000, 1 },
+	{ 2000, 1000, 1 },
+};
+
+/** Fragments including duplicates and overlaps */
+static struct fragment_test_fragment overlapping[] = {
+	{ 1480, 1480, 1 }, { 1480, 1480, 1 }, { 1000, 1000, 1 },
+	{ 2960, 1040, 0 }, { 2000, 2000, 0 }, { 0, 1480, 1 },
+};
+
+/** Fragments including an inconsistent final fragment */
+static struct fragment_test_fragment inconsistent[] = {
+	{ 2000, 2000, 0 }, { 0, 1000, 0 }, { 4000, 8, 1 }, { 1000, 1000, 1 },
+	{ 0, 1000, 1 },
+};
+
+/**
+ * Perform fragment reassembly self-tests
+ *
+ */
+static void fragment_test_exec ( void ) {
+	struct fragment_test_fragment first = { 0, 1000, 1 };
+	struct fragment_test_fragment last = { 1000, 1000, 0 };
+	struct fragment_test_fragment huge = { 0, 1000, 1 };
+	struct io_buffer *iobuf;
+
+	/* Reassembly in various orders */
+	fragment_ok ( 0x1001, in_order, FRAGMENT_TEST_LEN );
+	fragment_ok ( 0x1002, reversed, FRAGMENT_TEST_LEN );
+	fragment_ok ( 0x1003, shuffled, FRAGMENT_TEST_LEN );
+	fragment_ok ( 0x1004, overlapping, FRAGMENT_TEST_LEN );
+	fragment_ok ( 0x1005, inconsistent, FRAGMENT_TEST_LEN );
+
+	/* Interleaved reassembly of two packets */
+	ok ( fragment_test_rx ( 0x2001, &last ) == NULL );
+	ok ( fragment_test_rx ( 0x2002, &first ) == NULL );
+	iobuf = fragment_test_rx ( 0x2001, &first );
+	ok ( iobuf != NULL );
+	ok ( fragment_test_check ( 0x2001, iobuf, 2000 ) );
+	free_iob ( iobuf );
+	iobuf = fragment_test_rx ( 0x2002, &last );
+	ok ( iobuf != NULL );
+	ok ( fragment_test_check ( 0x2002, iobuf, 2000 ) );
+	free_iob ( iobuf );
+
+	/* Memory limit discards least recently used reassembly */
+	ok ( fragment_test_rx ( 0x3001, &first ) == NULL );
+	while ( huge.offset < ( 2 * FRAGMENT_MAX_BUFFERED ) ) {
+		ok ( fragment_test_rx ( 0x3002, &huge ) == NULL );
+		huge.offset += huge.len;
+	}
+	ok ( fragment_test_rx ( 0x3001, &last ) == NULL );
+	iobuf = fragment_test_rx ( 0x3001, &first );
+	ok ( iobuf != NULL );
+	ok ( fragment_test_check ( 0x3001, iobuf, 2000 ) );
+	free_iob ( iobuf );
+}
+
+/** Fragment reassembly self-test */
+struct self_test fragment_test __self_test = {
+	.name = "fragment",
+	.exec = fragment_test_exec,
+};
@@ -0,0 +1,185 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * gzip image tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <ipxe/image.h>
+#include <ipxe/gzip.h>
+#include <ipxe/test.h>
+
+/** A gzip image test */
+struct gzip_test {
+	/** Compressed image */
+	struct image *image;
+	/** Expected extracted image name */
+	const char *name;
+	/** Expected extracted data */
+	const void *expected;
+	/** Length of expected extracted data */
+	size_t expected_len;
+};
+
+/** Define inline data */
+#define DATA(...) { __VA_ARGS__ }
+
+/** Define a gzip test */
+#define GZIP( _name, _compressed, _expected )				\
+	static const uint8_t _name ## __compressed[] = _compressed;	\
+	static const char _name ## __expected[] = _expected;		\
+	static struct image _name ## __image = {			\
+		.refcnt = REF_INIT ( ref_no_free ),			\
+		.name = #_name ".gz",					\
+		.data = ( userptr_t ) ( _name ## __compressed ),	\
+		.len = sizeof ( _name ## __compressed ),		\
+	};								\
+	static struct gzip_test _name = {				\
+		.image = & _name ## __image,				\
+		.name = #_name,						\
+		.expected = _name ## __expected,			\
+		.expected_len = ( sizeof ( _name ## __expected ) - 1 ),	\
+	};
+
+/** Test sentence */
+#define FOX "The quick brown fox jumps over the lazy dog. "
+
+/** Twelve copies of test sentence */
+#define FOX12 FOX FOX FOX FOX FOX FOX FOX FOX FOX FOX FOX FOX
+
+/** Empty file */
+GZIP ( empty,
+       DATA ( 0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03,
+	      0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 ),
+       "" );
+
+/** Short file with original file name */
+GZIP ( hello,
+       DATA ( 0x1f, 0x8b, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03,
+	      0x68, 0x65, 0x6c, 0x6c, 0x6f, 0x2e, 0x74, 0x78, 0x74, 0x00,
+	      0xf3, 0x48, 0xcd, 0xc9, 0xc9, 0x57, 0x28, 0xcf, 0x2f, 0xca,
+	      0x49, 0xe1, 0x02, 0x00, 0xd5, 0xe0, 0x39, 0xb7, 0x0c, 0x00,
+	      0x00, 0x00 ),
+       "Hello world\n" );
+
+/** File with extra field, name, comment, and header CRC */
+GZIP ( fox,
+       DATA ( 0x1f, 0x8b, 0x08, 0x1e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03,
+	      0x06, 0x00, 0x41, 0x42, 0x02, 0x00, 0x78, 0x79, 0x66, 0x6f,
+	      0x78, 0x00, 0x51, 0x75, 0x69, 0x63, 0x6b, 0x20, 0x62, 0x72,
+	      0x6f, 0x77, 0x6e, 0x20, 0x66, 0x6f, 0x78, 0x00, 0x6c, 0xd0,
+	      0x0b, 0xc9, 0x48, 0x55, 0x28, 0x2c, 0xcd, 0x4c, 0xce, 0x56,
+	      0x48, 0x2a, 0xca, 0x2f, 0xcf, 0x53, 0x48, 0xcb, 0xaf, 0x50,
+	      0xc8, 0x2a, 0xcd, 0x2d, 0x28, 0x56, 0xc8, 0x2f, 0x4b, 0x2d,
+	      0x52, 0x28, 0x01, 0x4a, 0xe7, 0x24, 0x56, 0x55, 0x2a, 0xa4,
+	      0xe4, 0xa7, 0xeb, 0x29, 0x84, 0x8c, 0x2a, 0x1e, 0x49, 0x8a,
+	      0x01, 0xdc, 0xdf, 0xaa, 0x72, 0x1c, 0x02, 0x00, 0x00 ),
+       FOX12 );
+
+/** File with corrupted CRC */
+GZIP ( bad_crc,
+       DATA ( 0x1f, 0x8b, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03,
+	      0x68, 0x65, 0x6c, 0x6c, 0x6f, 0x2e, 0x74, 0x78, 0x74, 0x00,
+	      0xf3, 0x48, 0xcd, 0xc9, 0xc9, 0x57, 0x28, 0xcf, 0x2f, 0xca,
+	      0x49, 0xe1, 0x02, 0x00, 0xd4, 0xe0, 0x39, 0xb7, 0x0c, 0x00,
+	      0x00, 0x00 ),
+       "Hello world\n" );
+
+/**
+ * Report gzip test result
+ *
+ * @v test		gzip test
+ * @v valid		Image is expected to be valid
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void gzip_okx ( struct gzip_test *test, int valid, const char *file,
+		       unsigned int line ) {
+	struct image *image = test->image;
+	struct image *extracted;
+	int rc;
+
+	/* Correct image data pointer */
+	image->data = virt_to_user ( ( void * ) image->data );
+
+	/* Check that image is detected as gzip */
+	okx ( register_image ( image ) == 0, file, line );
+	okx ( image->type == &gzip_image_type, file, line );
+
+	/* Extract archive image */
+	rc = image_extract ( image, NULL, &extracted );
+	if ( valid ) {
+		okx ( rc == 0, file, line );
+		if ( rc == 0 ) {
+
+			/* Verify extracted image name and content */
+			okx ( strcmp ( extracted->name, test->name ) == 0,
+			      file, line );
+			okx ( extracted->len == test->expected_len, file, line );
+			okx ( memcmp_user ( extracted->data, 0,
+					    virt_to_user ( test->expected ), 0,
+					    test->expected_len ) == 0,
+			      file, line );
+
+			/* Unregister extracted image */
+			unregister_image ( extracted );
+		}
+	} else {
+		okx ( rc != 0, file, line );
+	}
+
+	/* Unregister image */
+	unregister_image ( image );
+}
+/**
+ * Report gzip test result
+ *
+ * @v test		gzip test
+ * @v valid		Image is expected to be valid
+ */
+#define gzip_ok( test, valid ) gzip_okx ( test, valid, __FILE__, __LINE__ )
+
+/**
+ * Perform gzip self-test
+ *
+ */
+static void gzip_test_exec ( void ) {
+
+	gzip_ok ( &empty, 1 );
+	gzip_ok ( &hello, 1 );
+	gzip_ok ( &fox, 1 );
+	gzip_ok ( &bad_crc, 0 );
+}
+
+/** gzip self-test */
+struct self_test gzip_test __self_test = {
+	.name = "gzip",
+	.exec = gzip_test_exec,
+};
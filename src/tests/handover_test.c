@@ -0,0 +1,162 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+/** @file
+ *
+ * State handover self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ipxe/handover.h>
+#include <ipxe/test.h>
+
+/** Test record type */
+#define HANDOVER_TEST 0x7fff
+
+/** Test state */
+static const uint8_t handover_test_state[] = {
+	0x69, 0x50, 0x58, 0x45, 0x20, 0x68, 0x61, 0x6e, 0x64, 0x6f, 0x76
+};
+
+/** Restored test state */
+static uint8_t handover_test_restored[ sizeof ( handover_test_state ) ];
+
+/** Number of times test state has been restored */
+static unsigned int handover_test_count;
+
+/**
+ * Save test state
+ *
+ * @v data		Buffer to fill with state, or NULL
+ * @v len		Length of buffer
+ * @ret len		Length of state, or zero if no state exists
+ */
+static size_t handover_test_save ( void *data, size_t len ) {
+
+	if ( len >= sizeof ( handover_test_state ) ) {
+		memcpy ( data, handover_test_state,
+			 sizeof ( handover_test_state ) );
+	}
+	return sizeof ( handover_test_state );
+}
+
+/**
+ * Restore test state
+ *
+ * @v data		State
+ * @v len		Length of state
+ * @ret rc		Return status code
+ */
+static int handover_test_restore ( const void *data, size_t len ) {
+
+	okx ( len == sizeof ( handover_test_restored ), __FILE__, __LINE__ );
+	if ( len > sizeof ( handover_test_restored ) )
+		len = sizeof ( handover_test_restored );
+	memcpy ( handover_test_restored, data, len );
+	handover_test_count++;
+	return 0;
+}
+
+/** Test state handover provider */
+struct handover_provider handover_test_provider __handover_provider = {
+	.name = "test",
+	.type = HANDOVER_TEST,
+	.save = handover_test_save,
+	.restore = handover_test_restore,
+};
+
+/**
+ * Perform state handover self-test
+ *
+ */
+static void handover_test_exec ( void ) {
+	struct handover_header *hdr;
+	struct handover_record *record;
+	void *data;
+	size_t len;
+
+	/* Save state */
+	ok ( handover_save ( &data, &len ) == 0 );
+	ok ( data != NULL );
+	ok ( len >= ( sizeof ( *hdr ) + sizeof ( *record ) +
+		      sizeof ( handover_test_state ) ) );
+	ok ( ( len % HANDOVER_ALIGN ) == 0 );
+	hdr = data;
+	ok ( hdr->magic == HANDOVER_MAGIC );
+	ok ( hdr->version == HANDOVER_VERSION );
+	ok ( hdr->len == len );
+
+	/* Restore state */
+	memset ( handover_test_restored, 0, sizeof ( handover_test_restored ) );
+	handover_test_count = 0;
+	ok ( handover_restore ( data, len ) == 0 );
+	ok ( handover_test_count == 1 );
+	ok ( memcmp ( handover_test_restored, handover_test_state,
+		      sizeof ( handover_test_state ) ) == 0 );
+
+	/* Reject truncated block */
+	handover_test_count = 0;
+	ok ( handover_restore ( data, ( len - 1 ) ) != 0 );
+	ok ( handover_restore ( data, ( sizeof ( *hdr ) - 1 ) ) != 0 );
+	ok ( handover_test_count == 0 );
+
+	/* Reject invalid signature and version */
+	hdr->magic = ( HANDOVER_MAGIC ^ 0xffffffffUL );
+	ok ( handover_restore ( data, len ) != 0 );
+	hdr->magic = HANDOVER_MAGIC;
+	hdr->version = ( HANDOVER_VERSION + 1 );
+	ok ( handover_restore ( data, len ) != 0 );
+	hdr->version = HANDOVER_VERSION;
+	ok ( handover_test_count == 0 );
+
+	/* Ignore unknown record types */
+	record = ( data + sizeof ( *hdr ) );
+	while ( record->type != HANDOVER_TEST ) {
+		record = ( ( ( void * ) record ) +
+			   ( ( sizeof ( *record ) + record->len +
+			       HANDOVER_ALIGN - 1 ) &
+			     ~( HANDOVER_ALIGN - 1 ) ) );
+	}
+	record->type = ( HANDOVER_TEST + 1 );
+	ok ( handover_restore ( data, len ) == 0 );
+	ok ( handover_test_count == 0 );
+
+	/* Reject overlength record */
+	record->type = HANDOVER_TEST;
+	record->len = len;
+	ok ( handover_restore ( data, len ) != 0 );
+	ok ( handover_test_count == 0 );
+
+	free ( data );
+}
+
+/** State handover self-test */
+struct self_test handover_test __self_test = {
+	.name = "handover",
+	.exec = handover_test_exec,
+};
@@ -0,0 +1,422 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * HPACK header compression tests
+ *
+ * Test vectors are taken from RFC 7541 appendix C.
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <ipxe/hpack.h>
+#include <ipxe/test.h>
+
+/** An HPACK test header field */
+struct hpack_test_header {
+	/** Name */
+	const char *name;
+	/** Value */
+	const char *value;
+};
+
+/** An HPACK decoding test */
+struct hpack_test {
+	/** Header block */
+	const void *data;
+	/** Length of header block */
+	size_t len;
+	/** Expected header fields */
+	const struct hpack_test_header *headers;
+	/** Number of expected header fields */
+	unsigned int count;
+	/** Expected number of dynamic table entries */
+	unsigned int entries;
+	/** Expected dynamic table size */
+	size_t size;
+};
+
+/** An HPACK decoding test in progress */
+struct hpack_test_check {
+	/** Test */
+	struct hpack_test *test;
+	/** Number of header fields decoded so far */
+	unsigned int index;
+	/** Test code file */
+	const char *file;
+	/** Test code line */
+	unsigned int line;
+};
+
+/** Define inline data */
+#define DATA(...) { __VA_ARGS__ }
+
+/** Define inline header fields */
+#define HEADERS(...) { __VA_ARGS__ }
+
+/** Define an inline header field */
+#define HEADER( NAME, VALUE ) { .name = NAME, .value = VALUE }
+
+/** Define an HPACK decoding test */
+#define HPACK( name, DATA, HEADERS, ENTRIES, SIZE )			\
+	static const uint8_t name ## _data[] = DATA;			\
+	static const struct hpack_test_header name ## _headers[] =	\
+		HEADERS;						\
+	static struct hpack_test name = {				\
+		.data = name ## _data,					\
+		.len = sizeof ( name ## _data ),			\
+		.headers = name ## _headers,				\
+		.count = ( sizeof ( name ## _headers ) /		\
+			   sizeof ( name ## _headers[0] ) ),		\
+		.entries = ENTRIES,					\
+		.size = SIZE,						\
+	}
+
+/** Request without Huffman coding (RFC 7541 C.3.1) */
+HPACK ( plain_req_a,
+	DATA ( 0x82, 0x86, 0x84, 0x41, 0x0f, 0x77, 0x77, 0x77, 0x2e, 0x65,
+		0x78, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x2e, 0x63, 0x6f, 0x6d ),
+	HEADERS ( HEADER ( ":method", "GET" ),
+		   HEADER ( ":scheme", "http" ),
+		   HEADER ( ":path", "/" ),
+		   HEADER ( ":authority", "www.example.com" ) ),
+	1, 57 );
+
+/** Request without Huffman coding (RFC 7541 C.3.2) */
+HPACK ( plain_req_b,
+	DATA ( 0x82, 0x86, 0x84, 0xbe, 0x58, 0x08, 0x6e, 0x6f, 0x2d, 0x63,
+		0x61, 0x63, 0x68, 0x65 ),
+	HEADERS ( HEADER ( ":method", "GET" ),
+		   HEADER ( ":scheme", "http" ),
+		   HEADER ( ":path", "/" ),
+		   HEADER ( ":authority", "www.example.com" ),
+		   HEADER ( "cache-control", "no-cache" ) ),
+	2, 110 );
+
+/** Request without Huffman coding (RFC 7541 C.3.3) */
+HPACK ( plain_req_c,
+	DATA ( 0x82, 0x87, 0x85, 0xbf, 0x40, 0x0a, 0x63, 0x75, 0x73, 0x74,
+		0x6f, 0x6d, 0x2d, 0x6b, 0x65, 0x79, 0x0c, 0x63, 0x75, 0x73,
+		0x74, 0x6f, 0x6d, 0x2d, 0x76, 0x61, 0x6c, 0x75, 0x65 ),
+	HEADERS ( HEADER ( ":method", "GET" ),
+		   HEADER ( ":scheme", "https" ),
+		   HEADER ( ":path", "/index.html" ),
+		   HEADER ( ":authority", "www.example.com" ),
+		   HEADER ( "custom-key", "custom-value" ) ),
+	3, 164 );
+
+/** Request with Huffman coding (RFC 7541 C.4.1) */
+HPACK ( huff_req_a,
+	DATA ( 0x82, 0x86, 0x84, 0x41, 0x8c, 0xf1, 0xe3, 0xc2, 0xe5, 0xf2,
+		0x3a, 0x6b, 0xa0, 0xab, 0x90, 0xf4, 0xff ),
+	HEADERS ( HEADER ( ":method", "GET" ),
+		   HEADER ( ":scheme", "http" ),
+		   HEADER ( ":path", "/" ),
+		   HEADER ( ":authority", "www.example.com" ) ),
+	1, 57 );
+
+/** Request with Huffman coding (RFC 7541 C.4.2) */
+HPACK ( huff_req_b,
+	DATA ( 0x82, 0x86, 0x84, 0xbe, 0x58, 0x86, 0xa8, 0xeb, 0x10, 0x64,
+		0x9c, 0xbf ),
+	HEADERS ( HEADER ( ":method", "GET" ),
+		   HEADER ( ":scheme", "http" ),
+		   HEADER ( ":path", "/" ),
+		   HEADER ( ":authority", "www.example.com" ),
+		   HEADER ( "cache-control", "no-cache" ) ),
+	2, 110 );
+
+/** Request with Huffman coding (RFC 7541 C.4.3) */
+HPACK ( huff_req_c,
+	DATA ( 0x82, 0x87, 0x85, 0xbf, 0x40, 0x88, 0x25, 0xa8, 0x49, 0xe9,
+		0x5b, 0xa9, 0x7d, 0x7f, 0x89, 0x25, 0xa8, 0x49, 0xe9, 0x5b,
+		0xb8, 0xe8, 0xb4, 0xbf ),
+	HEADERS ( HEADER ( ":method", "GET" ),
+		   HEADER ( ":scheme", "https" ),
+		   HEADER ( ":path", "/index.html" ),
+		   HEADER ( ":authority", "www.example.com" ),
+		   HEADER ( "custom-key", "custom-value" ) ),
+	3, 164 );
+
+/** Response with eviction (RFC 7541 C.6.1) */
+HPACK ( evict_resp_a,
+	DATA ( 0x48, 0x82, 0x64, 0x02, 0x58, 0x85, 0xae, 0xc3, 0x77, 0x1a,
+		0x4b, 0x61, 0x96, 0xd0, 0x7a, 0xbe, 0x94, 0x10, 0x54, 0xd4,
+		0x44, 0xa8, 0x20, 0x05, 0x95, 0x04, 0x0b, 0x81, 0x66, 0xe0,
+		0x82, 0xa6, 0x2d, 0x1b, 0xff, 0x6e, 0x91, 0x9d, 0x29, 0xad,
+		0x17, 0x18, 0x63, 0xc7, 0x8f, 0x0b, 0x97, 0xc8, 0xe9, 0xae,
+		0x82, 0xae, 0x43, 0xd3 ),
+	HEADERS ( HEADER ( ":status", "302" ),
+		   HEADER ( "cache-control", "private" ),
+		   HEADER ( "date", "Mon, 21 Oct 2013 20:13:21 GMT" ),
+		   HEADER ( "location", "https://www.example.com" ) ),
+	4, 222 );
+
+/** Response with eviction (RFC 7541 C.6.2) */
+HPACK ( evict_resp_b,
+	DATA ( 0x48, 0x83, 0x64, 0x0e, 0xff, 0xc1, 0xc0, 0xbf ),
+	HEADERS ( HEADER ( ":status", "307" ),
+		   HEADER ( "cache-control", "private" ),
+		   HEADER ( "date", "Mon, 21 Oct 2013 20:13:21 GMT" ),
+		   HEADER ( "location", "https://www.example.com" ) ),
+	4, 222 );
+
+/** Response with eviction (RFC 7541 C.6.3) */
+HPACK ( evict_resp_c,
+	DATA ( 0x88, 0xc1, 0x61, 0x96, 0xd0, 0x7a, 0xbe, 0x94, 0x10, 0x54,
+		0xd4, 0x44, 0xa8, 0x20, 0x05, 0x95, 0x04, 0x0b, 0x81, 0x66,
+		0xe0, 0x84, 0xa6, 0x2d, 0x1b, 0xff, 0xc0, 0x5a, 0x83, 0x9b,
+		0xd9, 0xab, 0x77, 0xad, 0x94, 0xe7, 0x82, 0x1d, 0xd7, 0xf2,
+		0xe6, 0xc7, 0xb3, 0x35, 0xdf, 0xdf, 0xcd, 0x5b, 0x39, 0x60,
+		0xd5, 0xaf, 0x27, 0x08, 0x7f, 0x36, 0x72, 0xc1, 0xab, 0x27,
+		0x0f, 0xb5, 0x29, 0x1f, 0x95, 0x87, 0x31, 0x60, 0x65, 0xc0,
+		0x03, 0xed, 0x4e, 0xe5, 0xb1, 0x06, 0x3d, 0x50, 0x07 ),
+	HEADERS ( HEADER ( ":status", "200" ),
+		   HEADER ( "cache-control", "private" ),
+		   HEADER ( "date", "Mon, 21 Oct 2013 20:13:22 GMT" ),
+		   HEADER ( "location", "https://www.example.com" ),
+		   HEADER ( "content-encoding", "gzip" ),
+		   HEADER ( "set-cookie", "foo=ASDJKHQKBZXOQWEOPIUAXQWEOIU; max-age=3600; version=1" ) ),
+	3, 215 );
+/** Indexed header field with index zero */
+static const uint8_t bad_zero[] = { 0x80 };
+
+/** Indexed header field beyond end of (empty) dynamic table */
+static const uint8_t bad_index[] = { 0xbe };
+
+/** Huffman-coded name containing the end-of-string symbol */
+static const uint8_t bad_eos[] =
+	{ 0x00, 0x84, 0xff, 0xff, 0xff, 0xff, 0x01, 0x61 };
+
+/** Huffman-coded name with more than seven bits of padding */
+static const uint8_t bad_padding[] = { 0x00, 0x82, 0x07, 0xff, 0x01, 0x61 };
+
+/** Truncated string literal */
+static const uint8_t bad_truncated[] = { 0x00, 0x05, 0x61, 0x62 };
+
+/** Dynamic table size update exceeding advertised limit */
+static const uint8_t bad_size[] = { 0x3f, 0xe2, 0x1f };
+
+/**
+ * Check decoded header field
+ *
+ * @v opaque		Test in progress
+ * @v name		Header name
+ * @v value		Header value
+ * @ret rc		Return status code
+ */
+static int hpack_test_check_header ( void *opaque, const char *name,
+			       const char *value ) {
+	struct hpack_test_check *check = opaque;
+	struct hpack_test *test = check->test;
+	const struct hpack_test_header *header;
+
+	okx ( check->index < test->count, check->file, check->line );
+	if ( check->index < test->count ) {
+		header = &test->headers[check->index];
+		okx ( strcmp ( name, header->name ) == 0,
+		      check->file, check->line );
+		okx ( strcmp ( value, header->value ) == 0,
+		      check->file, check->line );
+	}
+	check->index++;
+	return 0;
+}
+
+/**
+ * Ignore decoded header field
+ *
+ * @v opaque		Opaque pointer
+ * @v name		Header name
+ * @v value		Header value
+ * @ret rc		Return status code
+ */
+static int hpack_test_ignore ( void *opaque __unused,
+			       const char *name __unused,
+			       const char *value __unused ) {
+	return 0;
+}
+
+/**
+ * Report an HPACK decoding test result
+ *
+ * @v table		Dynamic table
+ * @v test		HPACK test
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void hpack_decode_okx ( struct hpack_table *table,
+			       struct hpack_test *test, const char *file,
+			       unsigned int line ) {
+	struct hpack_test_check check = {
+		.test = test,
+		.file = file,
+		.line = line,
+	};
+
+	okx ( hpack_decode ( table, test->data, test->len, hpack_test_check_header,
+			     &check ) == 0, file, line );
+	okx ( check.index == test->count, file, line );
+	okx ( table->count == test->entries, file, line );
+	okx ( table->size == test->size, file, line );
+}
+#define hpack_decode_ok( table, test ) \
+	hpack_decode_okx ( table, test, __FILE__, __LINE__ )
+
+/**
+ * Report an HPACK decoding failure test result
+ *
+ * @v data		Header block
+ * @v len		Length of header block
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void hpack_decode_fail_okx ( const void *data, size_t len,
+				    const char *file, unsigned int line ) {
+	struct hpack_table table;
+
+	hpack_init ( &table, HPACK_TABLE_SIZE );
+	okx ( hpack_decode ( &table, data, len, hpack_test_ignore,
+			     NULL ) != 0, file, line );
+	hpack_fini ( &table );
+}
+#define hpack_decode_fail_ok( data ) \
+	hpack_decode_fail_okx ( data, sizeof ( data ), __FILE__, __LINE__ )
+
+/**
+ * Report an HPACK encoding test result
+ *
+ * @v index		Static table index, or zero
+ * @v name		Name
+ * @v value		Value, or NULL
+ * @v expected		Expected encoding
+ * @v expected_len	Length of expected encoding
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void hpack_encode_okx ( unsigned int index, const char *name,
+			       const char *value, const void *expected,
+			       size_t expected_len, const char *file,
+			       unsigned int line ) {
+	size_t len = hpack_encode ( NULL, index, name, value );
+	uint8_t buf[len];
+
+	okx ( len == expected_len, file, line );
+	okx ( hpack_encode ( buf, index, name, value ) == len, file, line );
+	okx ( memcmp ( buf, expected, len ) == 0, file, line );
+}
+#define hpack_encode_ok( index, name, value, expected )			\
+	hpack_encode_okx ( index, name, value, expected,		\
+			   sizeof ( expected ), __FILE__, __LINE__ )
+
+/** Encoded ":method: GET" */
+static const uint8_t enc_method[] = { 0x82 };
+
+/** Encoded ":path: /sample/path" (RFC 7541 C.2.2) */
+static const uint8_t enc_path[] = {
+	0x04, 0x0c, 0x2f, 0x73, 0x61, 0x6d, 0x70, 0x6c, 0x65, 0x2f, 0x70,
+	0x61, 0x74, 0x68
+};
+
+/** Encoded "custom-key: custom-header" (RFC 7541 C.2.1, unindexed) */
+static const uint8_t enc_custom[] = {
+	0x00, 0x0a, 0x63, 0x75, 0x73, 0x74, 0x6f, 0x6d, 0x2d, 0x6b, 0x65,
+	0x79, 0x0d, 0x63, 0x75, 0x73, 0x74, 0x6f, 0x6d, 0x2d, 0x68, 0x65,
+	0x61, 0x64, 0x65, 0x72
+};
+
+/**
+ * Perform HPACK self-tests
+ *
+ */
+static void hpack_test_exec ( void ) {
+	struct hpack_table table;
+	char value[200];
+	uint8_t buf[ sizeof ( value ) + 4 ];
+	struct hpack_test_header long_header = {
+		.name = ":path",
+		.value = value,
+	};
+	struct hpack_test long_test = {
+		.data = buf,
+		.headers = &long_header,
+		.count = 1,
+	};
+
+	/* Requests without Huffman coding */
+	hpack_init ( &table, HPACK_TABLE_SIZE );
+	hpack_decode_ok ( &table, &plain_req_a );
+	hpack_decode_ok ( &table, &plain_req_b );
+	hpack_decode_ok ( &table, &plain_req_c );
+	hpack_fini ( &table );
+
+	/* Requests with Huffman coding */
+	hpack_init ( &table, HPACK_TABLE_SIZE );
+	hpack_decode_ok ( &table, &huff_req_a );
+	hpack_decode_ok ( &table, &huff_req_b );
+	hpack_decode_ok ( &table, &huff_req_c );
+	hpack_fini ( &table );
+
+	/* Responses with eviction */
+	hpack_init ( &table, 256 );
+	hpack_decode_ok ( &table, &evict_resp_a );
+	hpack_decode_ok ( &table, &evict_resp_b );
+	hpack_decode_ok ( &table, &evict_resp_c );
+	hpack_fini ( &table );
+	ok ( table.count == 0 );
+	ok ( table.size == 0 );
+
+	/* Malformed header blocks */
+	hpack_decode_fail_ok ( bad_zero );
+	hpack_decode_fail_ok ( bad_index );
+	hpack_decode_fail_ok ( bad_eos );
+	hpack_decode_fail_ok ( bad_padding );
+	hpack_decode_fail_ok ( bad_truncated );
+	hpack_decode_fail_ok ( bad_size );
+
+	/* Encoding */
+	hpack_encode_ok ( HPACK_METHOD_GET, NULL, NULL, enc_method );
+	hpack_encode_ok ( HPACK_PATH, ":path", "/sample/path", enc_path );
+	hpack_encode_ok ( 0, "Custom-Key", "custom-header", enc_custom );
+
+	/* Round trip with multi-byte integer length */
+	memset ( value, 'x', ( sizeof ( value ) - 1 ) );
+	value[ sizeof ( value ) - 1 ] = '\0';
+	long_test.len = hpack_encode ( NULL, HPACK_PATH, ":path", value );
+	ok ( long_test.len <= sizeof ( buf ) );
+	hpack_encode ( buf, HPACK_PATH, ":path", value );
+	hpack_init ( &table, HPACK_TABLE_SIZE );
+	hpack_decode_ok ( &table, &long_test );
+	hpack_fini ( &table );
+}
+
+/** HPACK self-test */
+struct self_test hpack_test __self_test = {
+	.name = "hpack",
+	.exec = hpack_test_exec,
+};
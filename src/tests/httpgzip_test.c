@@ -0,0 +1,339 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * HTTP gzip and deflate content encoding tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <ipxe/interface.h>
+#include <ipxe/xfer.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/http.h>
+#include <ipxe/test.h>
+
+/** An HTTP content encoding test */
+struct http_gzip_test {
+	/** Content encoding name */
+	const char *encoding;
+	/** Encoded data */
+	const void *data;
+	/** Length of encoded data */
+	size_t len;
+	/** Expected decoded data, or NULL for all zeroes */
+	const void *expected;
+	/** Length of expected decoded data */
+	size_t expected_len;
+};
+
+/** Define inline data */
+#define DATA(...) { __VA_ARGS__ }
+
+/** Define an HTTP content encoding test */
+#define HTTP_GZIP_TEST( _name, _encoding, _data, _expected )		\
+	static const uint8_t _name ## __data[] = _data;			\
+	static const char _name ## __expected[] = _expected;		\
+	static struct http_gzip_test _name = {				\
+		.encoding = _encoding,					\
+		.data = _name ## __data,				\
+		.len = sizeof ( _name ## __data ),			\
+		.expected = _name ## __expected,			\
+		.expected_len = ( sizeof ( _name ## __expected ) - 1 ),	\
+	}
+
+/** Define an HTTP content encoding test with all-zero decoded data */
+#define HTTP_GZIP_ZERO_TEST( _name, _encoding, _data, _expected_len )	\
+	static const uint8_t _name ## __data[] = _data;			\
+	static struct http_gzip_test _name = {				\
+		.encoding = _encoding,					\
+		.data = _name ## __data,				\
+		.len = sizeof ( _name ## __data ),			\
+		.expected_len = _expected_len,				\
+	}
+
+/** Single member with original file name and header CRC */
+HTTP_GZIP_TEST ( name_hcrc, "gzip",
+	DATA ( 0x1f, 0x8b, 0x08, 0x0a, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03,
+	       0x68, 0x65, 0x6c, 0x6c, 0x6f, 0x2e, 0x74, 0x78, 0x74, 0x00,
+	       0x90, 0x99, 0xf3, 0x48, 0xcd, 0xc9, 0xc9, 0x57, 0x28, 0xcf,
+	       0x2f, 0xca, 0x49, 0xe1, 0x02, 0x00, 0xd5, 0xe0, 0x39, 0xb7,
+	       0x0c, 0x00, 0x00, 0x00 ),
+	"Hello world\n" );
+
+/** Two concatenated members */
+HTTP_GZIP_TEST ( multi, "gzip",
+	DATA ( 0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03,
+	       0xf3, 0x48, 0xcd, 0xc9, 0xc9, 0x57, 0x00, 0x00, 0xc0, 0xfc,
+	       0x2d, 0xea, 0x06, 0x00, 0x00, 0x00, 0x1f, 0x8b, 0x08, 0x08,
+	       0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x78, 0x00, 0x2b, 0xcf,
+	       0x2f, 0xca, 0x49, 0xe1, 0x02, 0x00, 0xa8, 0x61, 0x38, 0xdd,
+	       0x06, 0x00, 0x00, 0x00 ),
+	"Hello world\n" );
+
+/** Single member followed by trailing garbage */
+HTTP_GZIP_TEST ( garbage, "gzip",
+	DATA ( 0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03,
+	       0xf3, 0x48, 0xcd, 0xc9, 0xc9, 0x57, 0x28, 0xcf, 0x2f, 0xca,
+	       0x49, 0xe1, 0x02, 0x00, 0xd5, 0xe0, 0x39, 0xb7, 0x0c, 0x00,
+	       0x00, 0x00, 0x00, 0x00, 0x00, 0x00 ),
+	"Hello world\n" );
+
+/** Single member decoding to more than the history window */
+HTTP_GZIP_ZERO_TEST ( zeros, "gzip",
+	DATA ( 0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03,
+	       0xed, 0xc1, 0x31, 0x01, 0x00, 0x00, 0x00, 0xc2, 0xa0, 0xf5,
+	       0x4f, 0x6d, 0x0d, 0x0f, 0xa0, 0x00, 0x00, 0x00, 0x00, 0x00,
+	       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	       0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	       0x00, 0x80, 0x57, 0x03, 0x7d, 0x95, 0x11, 0xd4, 0xa0, 0x86,
+	       0x01, 0x00 ),
+	100000 );
+
+/** zlib-wrapped deflate content */
+HTTP_GZIP_TEST ( deflate, "deflate",
+	DATA ( 0x78, 0x9c, 0xf3, 0x48, 0xcd, 0xc9, 0xc9, 0x57, 0x28, 0xcf,
+	       0x2f, 0xca, 0x49, 0xe1, 0x02, 0x00, 0x1c, 0xf2, 0x04, 0x47 ),
+	"Hello world\n" );
+
+/** Member with corrupted CRC */
+HTTP_GZIP_TEST ( bad_crc, "gzip",
+	DATA ( 0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03,
+	       0xf3, 0x48, 0xcd, 0xc9, 0xc9, 0x57, 0x28, 0xcf, 0x2f, 0xca,
+	       0x49, 0xe1, 0x02, 0x00, 0xd4, 0xe0, 0x39, 0xb7, 0x0c, 0x00,
+	       0x00, 0x00 ),
+	"Hello world\n" );
+
+/** Content truncated within second member */
+HTTP_GZIP_TEST ( truncated, "gzip",
+	DATA ( 0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03,
+	       0xf3, 0x48, 0xcd, 0xc9, 0xc9, 0x57, 0x00, 0x00, 0xc0, 0xfc,
+	       0x2d, 0xea, 0x06, 0x00, 0x00, 0x00, 0x1f, 0x8b, 0x08, 0x08,
+	       0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0x78, 0x00, 0x2b, 0xcf,
+	       0x2f, 0xca, 0x49, 0xe1 ),
+	"Hello world\n" );
+
+/** Test HTTP transaction */
+static struct http_transaction http_gzip_test_http;
+
+/** Test currently in progress */
+static struct http_gzip_test *http_gzip_test_current;
+
+/** Length of decoded data received */
+static size_t http_gzip_test_offset;
+
+/** Decoded data mismatch has been detected */
+static int http_gzip_test_mismatch;
+
+/** Decoded data interface has been closed */
+static int http_gzip_test_closed;
+
+/** Decoded data interface close status */
+static int http_gzip_test_rc;
+
+/**
+ * Receive decoded data
+ *
+ * @v http		HTTP transaction
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int http_gzip_test_deliver ( struct http_transaction *http __unused,
+				    struct io_buffer *iobuf,
+				    struct xfer_metadata *meta __unused ) {
+	struct http_gzip_test *test = http_gzip_test_current;
+	const uint8_t *data = iobuf->data;
+	size_t len = iob_len ( iobuf );
+	size_t i;
+
+	/* Compare against expected data */
+	if ( ( http_gzip_test_offset + len ) > test->expected_len ) {
+		http_gzip_test_mismatch = 1;
+	} else if ( test->expected ) {
+		if ( memcmp ( ( test->expected + http_gzip_test_offset ),
+			      data, len ) != 0 )
+			http_gzip_test_mismatch = 1;
+	} else {
+		for ( i = 0 ; i < len ; i++ ) {
+			if ( data[i] )
+				http_gzip_test_mismatch = 1;
+		}
+	}
+	http_gzip_test_offset += len;
+
+	free_iob ( iobuf );
+	return 0;
+}
+
+/**
+ * Close decoded data interface
+ *
+ * @v http		HTTP transaction
+ * @v rc		Reason for close
+ */
+static void http_gzip_test_close ( struct http_transaction *http, int rc ) {
+
+	http_gzip_test_closed = 1;
+	http_gzip_test_rc = rc;
+	intf_restart ( &http->content, rc );
+}
+
+/** Decoded data interface operations */
+static struct interface_operation http_gzip_test_content_operations[] = {
+	INTF_OP ( xfer_deliver, struct http_transaction *,
+		  http_gzip_test_deliver ),
+	INTF_OP ( intf_close, struct http_transaction *, http_gzip_test_close ),
+};
+
+/** Decoded data interface descriptor */
+static struct interface_descriptor http_gzip_test_content_desc =
+	INTF_DESC ( struct http_transaction, content,
+		    http_gzip_test_content_operations );
+
+/**
+ * Find HTTP content encoding
+ *
+ * @v name		Content encoding name
+ * @ret encoding	Content encoding, or NULL if not found
+ */
+static struct http_content_encoding * http_gzip_test_encoding ( const char
+								 *name ) {
+	struct http_content_encoding *encoding;
+
+	for_each_table_entry ( encoding, HTTP_CONTENT_ENCODINGS ) {
+		if ( strcmp ( encoding->name, name ) == 0 )
+			return encoding;
+	}
+	return NULL;
+}
+
+/**
+ * Report HTTP content encoding test result
+ *
+ * @v test		HTTP content encoding test
+ * @v chunk		Maximum length of each delivered chunk of encoded data
+ * @v valid		Content is expected to be valid
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void http_gzip_okx ( struct http_gzip_test *test, size_t chunk,
+			    int valid, const char *file, unsigned int line ) {
+	struct http_transaction *http = &http_gzip_test_http;
+	struct http_content_encoding *encoding;
+	size_t offset;
+	size_t frag;
+	int rc;
+
+	/* Find content encoding */
+	encoding = http_gzip_test_encoding ( test->encoding );
+	okx ( encoding != NULL, file, line );
+	if ( ! encoding )
+		return;
+
+	/* Initialise test */
+	memset ( http, 0, sizeof ( *http ) );
+	intf_init ( &http->content, &http_gzip_test_content_desc, NULL );
+	intf_init ( &http->transfer, &null_intf_desc, NULL );
+	http_gzip_test_current = test;
+	http_gzip_test_offset = 0;
+	http_gzip_test_mismatch = 0;
+	http_gzip_test_closed = 0;
+	http_gzip_test_rc = 0;
+
+	/* Attach decoder */
+	okx ( encoding->init ( http ) == 0, file, line );
+
+	/* Deliver encoded data */
+	for ( offset = 0 ; offset < test->len ; offset += frag ) {
+		frag = ( test->len - offset );
+		if ( frag > chunk )
+			frag = chunk;
+		rc = xfer_deliver_raw ( &http->transfer, ( test->data + offset ),
+					frag );
+		if ( rc != 0 )
+			break;
+	}
+
+	/* Close encoded data interface */
+	intf_shutdown ( &http->transfer, 0 );
+	okx ( http_gzip_test_closed, file, line );
+
+	/* Check result */
+	if ( valid ) {
+		okx ( offset == test->len, file, line );
+		okx ( http_gzip_test_rc == 0, file, line );
+		okx ( http_gzip_test_offset == test->expected_len, file, line );
+		okx ( ! http_gzip_test_mismatch, file, line );
+	} else {
+		okx ( http_gzip_test_rc != 0, file, line );
+	}
+	intf_restart ( &http->content, 0 );
+}
+#define http_gzip_ok( test, chunk )					\
+	http_gzip_okx ( test, chunk, 1, __FILE__, __LINE__ )
+#define http_gzip_invalid_ok( test, chunk )				\
+	http_gzip_okx ( test, chunk, 0, __FILE__, __LINE__ )
+
+/**
+ * Perform HTTP content encoding self-tests
+ *
+ */
+static void http_gzip_test_exec ( void ) {
+	static const size_t chunks[] = { 1, 7, 4096 };
+	size_t chunk;
+	unsigned int i;
+
+	for ( i = 0 ; i < ( sizeof ( chunks ) / sizeof ( chunks[0] ) ) ; i++ ) {
+		chunk = chunks[i];
+		http_gzip_ok ( &name_hcrc, chunk );
+		http_gzip_ok ( &multi, chunk );
+		http_gzip_ok ( &garbage, chunk );
+		http_gzip_ok ( &zeros, chunk );
+		http_gzip_ok ( &deflate, chunk );
+		http_gzip_invalid_ok ( &bad_crc, chunk );
+		http_gzip_invalid_ok ( &truncated, chunk );
+	}
+}
+
+/** HTTP content encoding self-test */
+struct self_test http_gzip_test __self_test = {
+	.name = "httpgzip",
+	.exec = http_gzip_test_exec,
+};
+
+/* Drag in gzip and deflate content encodings */
+REQUIRING_SYMBOL ( http_gzip_test );
+REQUIRE_OBJECT ( httpgzip );
@@ -34,6 +34,7 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdint.h>
 #include <string.h>
+#include <strings.h>
 #include <assert.h>
 #include <ipxe/iobuf.h>
 #include <ipxe/io.h>
@@ -99,6 +100,38 @@ static inline void alloc_iob_fail_okx ( size_t len, size_t align, size_t offset,
 #define alloc_iob_fail_ok( len, align, offset ) \
 	alloc_iob_fail_okx ( len, align, offset, __FILE__, __LINE__ )
 
+/**
+ * Report receive I/O buffer recycling test result
+ *
+ * @v len		Required length of buffer
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static inline void alloc_rx_iob_okx ( size_t len, const char *file,
+				      unsigned int line ) {
+	struct io_buffer *iobuf;
+	struct io_buffer *recycled;
+
+	/* Allocate and free I/O buffer */
+	iobuf = alloc_rx_iob ( len );
+	okx ( iobuf != NULL, file, line );
+	okx ( iob_tailroom ( iobuf ) >= len, file, line );
+	memset ( iob_put ( iobuf, len ), 0x55, len );
+	iob_pull ( iobuf, 2 );
+	free_iob ( iobuf );
+
+	/* Check that I/O buffer is recycled and reset */
+	recycled = alloc_rx_iob ( len );
+	okx ( recycled == iobuf, file, line );
+	okx ( iob_len ( recycled ) == 0, file, line );
+	okx ( iob_tailroom ( recycled ) >= len, file, line );
+	okx ( ( virt_to_phys ( recycled->data ) &
+		( ( 1UL << fls ( len - 1 ) ) - 1 ) ) == 0, file, line );
+	free_iob ( recycled );
+}
+#define alloc_rx_iob_ok( len ) \
+	alloc_rx_iob_okx ( len, __FILE__, __LINE__ )
+
 /**
  * Perform I/O buffer self-tests
  *
@@ -122,6 +155,10 @@ static void iobuf_test_exec ( void ) {
 	alloc_iob_ok ( 2048, 2048, 0 );
 	alloc_iob_ok ( 2048, 2048, -10 );
 
+	/* Check receive buffer recycling */
+	alloc_rx_iob_ok ( 1536 );
+	alloc_rx_iob_ok ( 2048 );
+
 	/* Excessively large or excessively aligned allocations should fail */
 	alloc_iob_fail_ok ( -1UL, 0, 0 );
 	alloc_iob_fail_ok ( -1UL, 1024, 0 );
@@ -277,6 +277,7 @@ static void ipv6_route_okx ( struct ipv6_test_table *table, const char *dest,
 	INIT_LIST_HEAD ( &saved );
 	list_splice_init ( &ipv6_miniroutes, &saved );
 	list_splice_init ( &table->list, &ipv6_miniroutes );
+	ipv6_route_flush();
 
 	/* Parse addresses */
 	okx ( inet6_aton ( dest, &in_dest ) == 0, file, line );
@@ -317,6 +318,7 @@ static void ipv6_route_okx ( struct ipv6_test_table *table, const char *dest,
 	/* Restore original routing table */
 	list_splice_init ( &ipv6_miniroutes, &table->list );
 	list_splice ( &saved, &ipv6_miniroutes );
+	ipv6_route_flush();
 }
 #define ipv6_route_ok( table, dest, src, next )				\
 	ipv6_route_okx ( table, dest, src, next, __FILE__, __LINE__ )
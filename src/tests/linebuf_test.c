@@ -129,6 +129,21 @@ LINEBUF_TEST ( embedded_nuls,
 	       ( "This\r\ntest\r\nincludes\r\n\r\nsome\0binary\0data\r\n" ),
 	       LINES ( "This", "test", "includes", "", linebuf_failure ) );
 
+/** Complete header block followed by body */
+LINEBUF_TEST ( block,
+	       ( "HTTP/1.1 206 Partial Content\r\n"
+		 "Content-Range: bytes 0-3/8\n"
+		 "\r\n"
+		 "body" ),
+	       LINES ( "HTTP/1.1 206 Partial Content",
+		       "Content-Range: bytes 0-3/8",
+		       "" ) );
+
+/** Header block with embedded NULs */
+LINEBUF_TEST ( block_nuls,
+	       ( "Bad\0header\r\n\r\n" ),
+	       LINES ( linebuf_failure ) );
+
 /**
  * Report line buffer initialisation test result
  *
@@ -269,6 +284,46 @@ static void linebuf_empty_okx ( struct line_buffer *linebuf,
 #define linebuf_empty_ok( linebuf ) \
 	linebuf_empty_okx ( linebuf, __FILE__, __LINE__ )
 
+/**
+ * Report line buffer block test result
+ *
+ * @v test		Line buffer test
+ * @v consumed		Expected consumed length, or negative for failure
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void linebuf_block_okx ( struct linebuf_test *test, int consumed,
+				const char *file, unsigned int line ) {
+	struct line_buffer linebuf;
+	const char *actual;
+	int len;
+
+	linebuf_init_okx ( &linebuf, file, line );
+
+	/* Buffer block */
+	len = line_buffer_block ( &linebuf, test->data, test->len );
+	if ( consumed < 0 ) {
+		okx ( len < 0, file, line );
+	} else {
+		okx ( len == consumed, file, line );
+	}
+
+	/* Check buffered lines */
+	actual = buffered_line ( &linebuf );
+	if ( len > 0 ) {
+		okx ( linebuf.consumed == ( ( size_t ) len ), file, line );
+		okx ( actual != NULL, file, line );
+		okx ( actual[0] == '\0', file, line );
+		linebuf_accumulated_okx ( test, &linebuf, file, line );
+	} else {
+		okx ( actual == NULL, file, line );
+	}
+
+	linebuf_empty_okx ( &linebuf, file, line );
+}
+#define linebuf_block_ok( test, consumed ) \
+	linebuf_block_okx ( test, consumed, __FILE__, __LINE__ )
+
 /**
  * Report line buffer combined test result
  *
@@ -311,6 +366,12 @@ static void linebuf_test_exec ( void ) {
 
 	/* Embedded NULs */
 	linebuf_ok ( &embedded_nuls );
+
+	/* Block tests */
+	linebuf_block_ok ( &simple, simple.len );
+	linebuf_block_ok ( &block, ( block.len - 4 /* "body" */ ) );
+	linebuf_block_ok ( &split_1, 0 );
+	linebuf_block_ok ( &block_nuls, -1 );
 }
 
 /** Line buffer self-test */
@@ -164,13 +164,122 @@ static void memcpy_test_speed ( unsigned int dest_offset,
 	      profile_stddev ( &profiler ) );
 }
 
+/**
+ * Test memmove() between overlapping regions
+ *
+ * @v len		Length of data to move
+ * @v shift		Offset of destination relative to source
+ */
+static void memmove_test_overlap ( size_t len, int shift ) {
+	size_t total = ( len + ( ( shift < 0 ) ? -shift : shift ) );
+	uint8_t *buf;
+	uint8_t *expected;
+	uint8_t *dest;
+	uint8_t *src;
+	unsigned int i;
+
+	/* Allocate blocks */
+	buf = malloc ( total );
+	assert ( buf != NULL );
+	expected = malloc ( total );
+	assert ( expected != NULL );
+
+	/* Generate random data and calculate expected result */
+	for ( i = 0 ; i < total ; i++ )
+		buf[i] = random();
+	src = ( buf + ( ( shift < 0 ) ? -shift : 0 ) );
+	dest = ( src + shift );
+	memcpy ( expected, buf, total );
+	for ( i = 0 ; i < len ; i++ )
+		expected[ ( dest - buf ) + i ] = src[i];
+
+	/* Check result */
+	memmove ( dest, src, len );
+	ok ( memcmp ( buf, expected, total ) == 0 );
+
+	/* Free blocks */
+	free ( expected );
+	free ( buf );
+}
+
+/**
+ * Test memset()
+ *
+ * @v len		Length of region to fill
+ * @v offset		Offset of region within buffer
+ * @v fill		Fill pattern
+ */
+static void memset_test_fill ( size_t len, unsigned int offset, int fill ) {
+	size_t total = ( offset + len + 1 );
+	uint8_t *buf;
+	uint8_t expected;
+	unsigned int i;
+
+	/* Allocate block */
+	buf = malloc ( total );
+	assert ( buf != NULL );
+	for ( i = 0 ; i < total ; i++ )
+		buf[i] = ~fill;
+
+	/* Check result, including guard bytes */
+	memset ( ( buf + offset ), fill, len );
+	for ( i = 0 ; i < total ; i++ ) {
+		expected = ( ( ( i < offset ) || ( i >= ( offset + len ) ) ) ?
+			     ~fill : fill );
+		if ( buf[i] != expected )
+			break;
+	}
+	ok ( i == total );
+
+	/* Free block */
+	free ( buf );
+}
+
+/**
+ * Test memmove() speed
+ *
+ * @v len		Length of data to move
+ */
+static void memmove_test_speed ( size_t len ) {
+	struct profiler profiler;
+	uint8_t *buf;
+	unsigned int i;
+
+	/* Allocate block */
+	buf = malloc ( len + 1 );
+	assert ( buf != NULL );
+
+	/* Profile an overlapping backwards memmove() */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		memmove ( ( buf + 1 ), buf, len );
+		profile_stop ( &profiler );
+	}
+
+	/* Free block */
+	free ( buf );
+
+	DBG ( "MEMMOVE moved %zd bytes backwards in %ld +/- %ld ticks\n",
+	      len, profile_mean ( &profiler ), profile_stddev ( &profiler ) );
+}
+
 /**
  * Perform memcpy() self-tests
  *
  */
 static void memcpy_test_exec ( void ) {
+	static const size_t lens[] = {
+		0, 1, 7, 8, 9, 15, 16, 17, 31, 32, 33, 255, 256, 257, 4099
+	};
+	static const int shifts[] = {
+		-64, -17, -16, -15, -9, -8, -7, -1, 1, 7, 8, 9, 15, 16, 17, 64
+	};
 	unsigned int dest_offset;
 	unsigned int src_offset;
+	unsigned int i;
+	unsigned int j;
+	size_t len;
 
 	/* Constant-length tests */
 	MEMCPY_TEST_CONSTANT ( );
@@ -264,6 +373,28 @@ static void memcpy_test_exec ( void ) {
 			memcpy_test_speed ( dest_offset, src_offset, 4096 );
 		}
 	}
+
+	/* Size sweep */
+	for ( len = 16 ; len <= ( 64 * 1024 ) ; len <<= 2 ) {
+		memcpy_test_speed ( 0, 0, len );
+		memmove_test_speed ( len );
+	}
+
+	/* memset() tests */
+	for ( i = 0 ; i < ( sizeof ( lens ) / sizeof ( lens[0] ) ) ; i++ ) {
+		for ( dest_offset = 0 ; dest_offset < 8 ; dest_offset++ ) {
+			memset_test_fill ( lens[i], dest_offset, 0x00 );
+			memset_test_fill ( lens[i], dest_offset, 0x5a );
+		}
+	}
+
+	/* Overlapping memmove() tests */
+	for ( i = 0 ; i < ( sizeof ( lens ) / sizeof ( lens[0] ) ) ; i++ ) {
+		for ( j = 0 ; j < ( sizeof ( shifts ) /
+				    sizeof ( shifts[0] ) ) ; j++ ) {
+			memmove_test_overlap ( lens[i], shifts[j] );
+		}
+	}
 }
 
 /** memcpy() self-test */
@@ -0,0 +1,619 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Network stack benchmarks
+ *
+ * These tests drive bulk TCP and HTTP transfers through the real
+ * network stack, using an in-memory Ethernet device attached to a
+ * minimal scripted TCP peer.  The peer's own processing time is
+ * excluded from the measurements, so that the reported costs (in
+ * processor cycles per byte and per packet) reflect only the stack
+ * under test.
+ *
+ * Each transfer is reported as a single "bench" line in the same
+ * format as the cryptographic algorithm benchmarks, with additional
+ * fields giving the number of packets received, the number of heap
+ * allocations made, and the elapsed time in milliseconds.
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <byteswap.h>
+#include <ipxe/list.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/malloc.h>
+#include <ipxe/device.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/if_ether.h>
+#include <ipxe/ethernet.h>
+#include <ipxe/neighbour.h>
+#include <ipxe/settings.h>
+#include <ipxe/in.h>
+#include <ipxe/ip.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/tcp.h>
+#include <ipxe/socket.h>
+#include <ipxe/interface.h>
+#include <ipxe/xfer.h>
+#include <ipxe/open.h>
+#include <ipxe/process.h>
+#include <ipxe/timer.h>
+#include <ipxe/profile.h>
+#include <ipxe/test.h>
+
+/** Length of data to transfer in each benchmark
+ *
+ * Increase this for more stable results.
+ */
+#define NETBENCH_LEN ( 4 * 1024 * 1024 )
+
+/** Maximum segment size advertised by peer */
+#define NETBENCH_MSS 1460
+
+/** Receive window advertised by peer */
+#define NETBENCH_WIN 0xffff
+
+/** Peer initial sequence number */
+#define NETBENCH_ISN 0x12345678UL
+
+/** Peer TCP port */
+#define NETBENCH_PORT 80
+
+/** Maximum time to allow for each benchmark */
+#define NETBENCH_TIMEOUT ( 30 * TICKS_PER_SEC )
+
+/** Local IPv4 address */
+#define NETBENCH_LOCAL_IP 0xc0a80001UL
+
+/** Peer IPv4 address */
+#define NETBENCH_PEER_IP 0xc0a80002UL
+
+/** Peer MAC address */
+static const uint8_t netbench_peer_mac[ETH_ALEN] =
+	{ 0x02, 0x00, 0x00, 0x00, 0x00, 0x02 };
+
+/** Local MAC address */
+static const uint8_t netbench_local_mac[ETH_ALEN] =
+	{ 0x02, 0x00, 0x00, 0x00, 0x00, 0x01 };
+
+/** A scripted TCP peer */
+struct netbench_peer {
+	/** Packets awaiting delivery to the stack under test */
+	struct list_head rx;
+	/** Prefix data (e.g. HTTP response headers) */
+	const char *prefix;
+	/** Length of prefix data */
+	size_t prefix_len;
+	/** Total length of data stream (including prefix) */
+	size_t len;
+	/** Wait for request before sending data */
+	int request;
+
+	/** Remote port (in network byte order) */
+	uint16_t port;
+	/** Next sequence number to send */
+	uint32_t snd_nxt;
+	/** Oldest unacknowledged sequence number */
+	uint32_t snd_una;
+	/** Send window */
+	size_t snd_win;
+	/** Next expected sequence number */
+	uint32_t rcv_nxt;
+	/** Data transmission may begin */
+	int ready;
+	/** FIN has been sent */
+	int fin;
+	/** Number of packets sent */
+	unsigned int packets;
+};
+
+/** A benchmark client */
+struct netbench_client {
+	/** Data transfer interface */
+	struct interface xfer;
+	/** Length of data received */
+	size_t len;
+	/** Transfer is complete */
+	int done;
+	/** Completion status */
+	int rc;
+};
+
+/** Benchmark peer */
+static struct netbench_peer netbench_peer;
+
+/** Benchmark device */
+static struct device netbench_dev = {
+	.name = "netbench",
+	.driver_name = "netbench",
+	.siblings = LIST_HEAD_INIT ( netbench_dev.siblings ),
+	.children = LIST_HEAD_INIT ( netbench_dev.children ),
+};
+
+/** Peer processing profiler (excluded from all measurements) */
+static struct profiler netbench_peer_profiler __profiler =
+	{ .name = "netbench.peer" };
+
+/** Transfer profiler */
+static struct profiler netbench_xfer_profiler __profiler =
+	{ .name = "netbench.xfer" };
+
+/**
+ * Transmit segment from peer
+ *
+ * @v peer		Scripted TCP peer
+ * @v netdev		Network device
+ * @v flags		TCP flags
+ * @v len		Length of data
+ */
+static void netbench_peer_tx ( struct netbench_peer *peer,
+			       struct net_device *netdev,
+			       unsigned int flags, size_t len ) {
+	struct ipv4_pseudo_header pshdr;
+	struct tcp_mss_option *mssopt;
+	struct io_buffer *iobuf;
+	struct ethhdr *ethhdr;
+	struct iphdr *iphdr;
+	struct tcp_header *tcphdr;
+	size_t offset;
+	size_t prefix_len;
+	size_t hlen;
+	uint16_t csum;
+
+	/* Allocate I/O buffer */
+	hlen = ( sizeof ( *tcphdr ) +
+		 ( ( flags & TCP_SYN ) ? sizeof ( *mssopt ) : 0 ) );
+	iobuf = alloc_iob ( sizeof ( *ethhdr ) + sizeof ( *iphdr ) +
+			    hlen + len );
+	assert ( iobuf != NULL );
+	iob_reserve ( iobuf, ( sizeof ( *ethhdr ) + sizeof ( *iphdr ) ) );
+
+	/* Construct TCP header and payload.  Any data beyond the
+	 * prefix is left uninitialised, since its content is
+	 * irrelevant to the benchmark.
+	 */
+	tcphdr = iob_put ( iobuf, hlen );
+	memset ( tcphdr, 0, hlen );
+	tcphdr->src = htons ( NETBENCH_PORT );
+	tcphdr->dest = peer->port;
+	tcphdr->seq = htonl ( peer->snd_nxt );
+	tcphdr->ack = htonl ( peer->rcv_nxt );
+	tcphdr->hlen = ( ( hlen / 4 ) << 4 );
+	tcphdr->flags = flags;
+	tcphdr->win = htons ( NETBENCH_WIN );
+	if ( flags & TCP_SYN ) {
+		mssopt = ( ( void * ) ( tcphdr + 1 ) );
+		mssopt->kind = TCP_OPTION_MSS;
+		mssopt->length = sizeof ( *mssopt );
+		mssopt->mss = htons ( NETBENCH_MSS );
+	}
+	offset = ( peer->snd_nxt - NETBENCH_ISN - 1 );
+	iob_put ( iobuf, len );
+	if ( offset < peer->prefix_len ) {
+		prefix_len = ( peer->prefix_len - offset );
+		if ( prefix_len > len )
+			prefix_len = len;
+		memcpy ( ( ( ( void * ) tcphdr ) + hlen ),
+			 ( peer->prefix + offset ), prefix_len );
+	}
+
+	/* Construct IPv4 header */
+	iphdr = iob_push ( iobuf, sizeof ( *iphdr ) );
+	memset ( iphdr, 0, sizeof ( *iphdr ) );
+	iphdr->verhdrlen = ( IP_VER | ( sizeof ( *iphdr ) / 4 ) );
+	iphdr->len = htons ( sizeof ( *iphdr ) + hlen + len );
+	iphdr->ttl = 64;
+	iphdr->protocol = IP_TCP;
+	iphdr->src.s_addr = htonl ( NETBENCH_PEER_IP );
+	iphdr->dest.s_addr = htonl ( NETBENCH_LOCAL_IP );
+	iphdr->chksum = tcpip_chksum ( iphdr, sizeof ( *iphdr ) );
+
+	/* Calculate TCP checksum */
+	memset ( &pshdr, 0, sizeof ( pshdr ) );
+	pshdr.src = iphdr->src;
+	pshdr.dest = iphdr->dest;
+	pshdr.protocol = IP_TCP;
+	pshdr.len = htons ( hlen + len );
+	csum = tcpip_chksum ( &pshdr, sizeof ( pshdr ) );
+	tcphdr->csum = tcpip_continue_chksum ( csum, tcphdr, ( hlen + len ) );
+
+	/* Construct Ethernet header */
+	ethhdr = iob_push ( iobuf, sizeof ( *ethhdr ) );
+	memcpy ( ethhdr->h_dest, netdev->ll_addr, ETH_ALEN );
+	memcpy ( ethhdr->h_source, netbench_peer_mac, ETH_ALEN );
+	ethhdr->h_protocol = htons ( ETH_P_IP );
+
+	/* Update state and queue for delivery */
+	peer->snd_nxt += ( len + ( ( flags & ( TCP_SYN | TCP_FIN ) ) ? 1 : 0 ));
+	peer->packets++;
+	list_add_tail ( &iobuf->list, &peer->rx );
+}
+
+/**
+ * Send as much data from peer as the window allows
+ *
+ * @v peer		Scripted TCP peer
+ * @v netdev		Network device
+ * @ret sent		Any segments were sent
+ */
+static int netbench_peer_send ( struct netbench_peer *peer,
+				struct net_device *netdev ) {
+	size_t offset;
+	size_t in_flight;
+	size_t len;
+	int sent = 0;
+
+	/* Do nothing until data transmission may begin */
+	if ( ! peer->ready )
+		return 0;
+
+	/* Send data segments */
+	while ( 1 ) {
+		offset = ( peer->snd_nxt - NETBENCH_ISN - 1 );
+		in_flight = ( peer->snd_nxt - peer->snd_una );
+		if ( ( offset >= peer->len ) || ( in_flight >= peer->snd_win ) )
+			break;
+		len = ( peer->len - offset );
+		if ( len > NETBENCH_MSS )
+			len = NETBENCH_MSS;
+		if ( len > ( peer->snd_win - in_flight ) )
+			len = ( peer->snd_win - in_flight );
+		netbench_peer_tx ( peer, netdev, ( TCP_ACK | TCP_PSH ), len );
+		sent = 1;
+	}
+
+	/* Send FIN once all data has been sent */
+	if ( ( offset >= peer->len ) && ( ! peer->fin ) ) {
+		netbench_peer_tx ( peer, netdev, ( TCP_ACK | TCP_FIN ), 0 );
+		peer->fin = 1;
+		sent = 1;
+	}
+
+	return sent;
+}
+
+/**
+ * Receive packet at peer
+ *
+ * @v peer		Scripted TCP peer
+ * @v netdev		Network device
+ * @v iobuf		I/O buffer
+ */
+static void netbench_peer_rx ( struct netbench_peer *peer,
+			       struct net_device *netdev,
+			       struct io_buffer *iobuf ) {
+	struct ethhdr *ethhdr = iobuf->data;
+	struct iphdr *iphdr = ( ( void * ) ( ethhdr + 1 ) );
+	struct tcp_header *tcphdr;
+	size_t iphdr_len;
+	size_t tcphdr_len;
+	size_t len;
+	uint32_t seq;
+	uint32_t ack;
+	unsigned int flags;
+	int need_ack = 0;
+
+	/* Ignore anything other than IPv4 TCP */
+	if ( ( ethhdr->h_protocol != htons ( ETH_P_IP ) ) ||
+	     ( iphdr->protocol != IP_TCP ) )
+		return;
+	iphdr_len = ( ( iphdr->verhdrlen & IP_MASK_HLEN ) * 4 );
+	tcphdr = ( ( ( void * ) iphdr ) + iphdr_len );
+	tcphdr_len = ( ( ( tcphdr->hlen & TCP_MASK_HLEN ) / 16 ) * 4 );
+	len = ( ntohs ( iphdr->len ) - iphdr_len - tcphdr_len );
+	seq = ntohl ( tcphdr->seq );
+	ack = ntohl ( tcphdr->ack );
+	flags = tcphdr->flags;
+
+	/* Ignore resets */
+	if ( flags & TCP_RST )
+		return;
+
+	/* Respond to SYN */
+	if ( flags & TCP_SYN ) {
+		peer->port = tcphdr->src;
+		peer->rcv_nxt = ( seq + 1 );
+		peer->snd_nxt = peer->snd_una = NETBENCH_ISN;
+		netbench_peer_tx ( peer, netdev, ( TCP_SYN | TCP_ACK ), 0 );
+		return;
+	}
+
+	/* Process acknowledgement and window (which is never scaled,
+	 * since the peer does not send a window scale option).
+	 */
+	if ( ( flags & TCP_ACK ) &&
+	     ( tcp_cmp ( ack, peer->snd_una ) >= 0 ) &&
+	     ( tcp_cmp ( ack, peer->snd_nxt ) <= 0 ) ) {
+		peer->snd_una = ack;
+		peer->snd_win = ntohs ( tcphdr->win );
+		if ( ! peer->request )
+			peer->ready = 1;
+	}
+
+	/* Consume any in-order data and FIN */
+	if ( ( len || ( flags & TCP_FIN ) ) && ( seq == peer->rcv_nxt ) ) {
+		peer->rcv_nxt += ( len + ( ( flags & TCP_FIN ) ? 1 : 0 ) );
+		if ( len )
+			peer->ready = 1;
+		need_ack = 1;
+	}
+
+	/* Send data, or a bare ACK if required */
+	if ( ( ! netbench_peer_send ( peer, netdev ) ) && need_ack )
+		netbench_peer_tx ( peer, netdev, TCP_ACK, 0 );
+}
+
+/**
+ * Open network device
+ *
+ * @v netdev		Network device
+ * @ret rc		Return status code
+ */
+static int netbench_open ( struct net_device *netdev __unused ) {
+	return 0;
+}
+
+/**
+ * Close network device
+ *
+ * @v netdev		Network device
+ */
+static void netbench_close ( struct net_device *netdev __unused ) {
+	struct io_buffer *iobuf;
+	struct io_buffer *tmp;
+
+	/* Discard any undelivered packets */
+	list_for_each_entry_safe ( iobuf, tmp, &netbench_peer.rx, list ) {
+		list_del ( &iobuf->list );
+		free_iob ( iobuf );
+	}
+}
+
+/**
+ * Transmit packet
+ *
+ * @v netdev		Network device
+ * @v iobuf		I/O buffer
+ * @ret rc		Return status code
+ */
+static int netbench_transmit ( struct net_device *netdev,
+			       struct io_buffer *iobuf ) {
+
+	/* Hand packet to peer, excluding the time taken */
+	profile_start ( &netbench_peer_profiler );
+	netbench_peer_rx ( &netbench_peer, netdev, iobuf );
+	profile_stop ( &netbench_peer_profiler );
+	profile_exclude ( &netbench_peer_profiler );
+
+	/* Complete transmission */
+	netdev_tx_complete ( netdev, iobuf );
+	return 0;
+}
+
+/**
+ * Poll for completed and received packets
+ *
+ * @v netdev		Network device
+ */
+static void netbench_poll ( struct net_device *netdev ) {
+	struct io_buffer *iobuf;
+	struct io_buffer *tmp;
+
+	/* Deliver all packets sent by peer */
+	list_for_each_entry_safe ( iobuf, tmp, &netbench_peer.rx, list ) {
+		list_del ( &iobuf->list );
+		netdev_rx ( netdev, iobuf );
+	}
+}
+
+/** Benchmark network device operations */
+static struct net_device_operations netbench_operations = {
+	.open		= netbench_open,
+	.close		= netbench_close,
+	.transmit	= netbench_transmit,
+	.poll		= netbench_poll,
+};
+
+/**
+ * Receive data at benchmark client
+ *
+ * @v client		Benchmark client
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int netbench_client_deliver ( struct netbench_client *client,
+				     struct io_buffer *iobuf,
+				     struct xfer_metadata *meta __unused ) {
+
+	client->len += iob_len ( iobuf );
+	free_iob ( iobuf );
+	return 0;
+}
+
+/**
+ * Close benchmark client
+ *
+ * @v client		Benchmark client
+ * @v rc		Reason for close
+ */
+static void netbench_client_close ( struct netbench_client *client,
+				    int rc ) {
+
+	client->rc = rc;
+	client->done = 1;
+	intf_shutdown ( &client->xfer, rc );
+}
+
+/** Benchmark client interface operations */
+static struct interface_operation netbench_client_ops[] = {
+	INTF_OP ( xfer_deliver, struct netbench_client *,
+		  netbench_client_deliver ),
+	INTF_OP ( intf_close, struct netbench_client *,
+		  netbench_client_close ),
+};
+
+/** Benchmark client interface descriptor */
+static struct interface_descriptor netbench_client_desc =
+	INTF_DESC ( struct netbench_client, xfer, netbench_client_ops );
+
+/**
+ * Run a transfer benchmark
+ *
+ * @v name		Benchmark name
+ * @v uri		URI to open, or NULL to open a raw TCP socket
+ * @v prefix		Prefix data to be sent by peer
+ * @v len		Length of data to be received by client
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void netbench_okx ( const char *name, const char *uri,
+			   const char *prefix, size_t len,
+			   const char *file, unsigned int line ) {
+	struct netbench_peer *peer = &netbench_peer;
+	struct netbench_client client;
+	struct sockaddr_in sin;
+	struct in_addr local = { .s_addr = htonl ( NETBENCH_LOCAL_IP ) };
+	struct in_addr peer_ip = { .s_addr = htonl ( NETBENCH_PEER_IP ) };
+	struct net_device *netdev;
+	unsigned long allocs;
+	unsigned long started;
+	unsigned long elapsed;
+	unsigned long cycles;
+	unsigned long cpb;
+	unsigned int packets;
+	int rc;
+
+	/* Initialise peer */
+	memset ( peer, 0, sizeof ( *peer ) );
+	INIT_LIST_HEAD ( &peer->rx );
+	peer->prefix = prefix;
+	peer->prefix_len = strlen ( prefix );
+	peer->len = ( peer->prefix_len + len );
+	peer->request = ( uri != NULL );
+
+	/* Create network device */
+	netdev = alloc_etherdev ( 0 );
+	okx ( netdev != NULL, file, line );
+	if ( ! netdev )
+		return;
+	netdev_init ( netdev, &netbench_operations );
+	netdev->dev = &netbench_dev;
+	memcpy ( netdev->hw_addr, netbench_local_mac, ETH_ALEN );
+	okx ( ( rc = register_netdev ( netdev ) ) == 0, file, line );
+	if ( rc != 0 )
+		goto err_register;
+	okx ( netdev_open ( netdev ) == 0, file, line );
+	netdev_link_up ( netdev );
+	okx ( store_setting ( netdev_settings ( netdev ), &ip_setting,
+			      &local, sizeof ( local ) ) == 0, file, line );
+	okx ( neighbour_define ( netdev, &ipv4_protocol, &peer_ip,
+				 netbench_peer_mac ) == 0, file, line );
+
+	/* Open client connection */
+	memset ( &client, 0, sizeof ( client ) );
+	intf_init ( &client.xfer, &netbench_client_desc, NULL );
+	allocs = memblock_allocs;
+	packets = netdev->rx_stats.good;
+	profile_start ( &netbench_xfer_profiler );
+	started = currticks();
+	if ( uri ) {
+		rc = xfer_open_uri_string ( &client.xfer, uri );
+	} else {
+		memset ( &sin, 0, sizeof ( sin ) );
+		sin.sin_family = AF_INET;
+		sin.sin_addr = peer_ip;
+		sin.sin_port = htons ( NETBENCH_PORT );
+		rc = xfer_open_socket ( &client.xfer, SOCK_STREAM,
+					( struct sockaddr * ) &sin, NULL );
+	}
+	okx ( rc == 0, file, line );
+
+	/* Run transfer to completion */
+	while ( ( rc == 0 ) && ( ! client.done ) &&
+		( ( currticks() - started ) < NETBENCH_TIMEOUT ) ) {
+		step();
+	}
+	elapsed = ( currticks() - started );
+	profile_stop ( &netbench_xfer_profiler );
+	intf_shutdown ( &client.xfer, 0 );
+	allocs = ( memblock_allocs - allocs );
+	packets = ( netdev->rx_stats.good - packets );
+	okx ( client.done, file, line );
+	okx ( client.rc == 0, file, line );
+	okx ( client.len == len, file, line );
+
+	/* Report results */
+	cycles = profile_elapsed ( &netbench_xfer_profiler );
+	cpb = ( client.len ?
+		( ( ( cycles * 100ULL ) + ( client.len / 2 ) ) / client.len ) :
+		0 );
+	printf ( "bench name=%s len=%zd cycles=%ld cpb=%ld.%02ld packets=%d "
+		 "allocs=%ld ms=%ld\n", name, client.len, cycles,
+		 ( cpb / 100 ), ( cpb % 100 ), packets, allocs,
+		 ( ( elapsed * 1000 ) / TICKS_PER_SEC ) );
+
+	/* Destroy network device */
+	netdev_close ( netdev );
+	unregister_netdev ( netdev );
+ err_register:
+	netdev_nullify ( netdev );
+	netdev_put ( netdev );
+}
+#define netbench_ok( name, uri, prefix, len )				\
+	netbench_okx ( name, uri, prefix, len, __FILE__, __LINE__ )
+
+/**
+ * Perform network stack benchmarks
+ *
+ */
+static void net_bench_exec ( void ) {
+	char prefix[80];
+
+	/* Raw TCP transfer */
+	netbench_ok ( "tcp", NULL, "", NETBENCH_LEN );
+
+	/* HTTP transfer */
+	snprintf ( prefix, sizeof ( prefix ), "HTTP/1.1 200 OK\r\n"
+		   "Connection: close\r\nContent-Length: %d\r\n\r\n",
+		   NETBENCH_LEN );
+	netbench_ok ( "http", "http://192.168.0.2/bench", prefix,
+		      NETBENCH_LEN );
+}
+
+/** Network stack benchmarks */
+struct self_test net_bench __self_test = {
+	.name = "net_bench",
+	.exec = net_bench_exec,
+};
+
+/* Drag in HTTP protocol */
+REQUIRING_SYMBOL ( net_bench );
+REQUIRE_OBJECT ( http );
@@ -0,0 +1,122 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+/** @file
+ *
+ * Peer Content Caching and Retrieval: Discovery Protocol [MS-PCCRD] tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdlib.h>
+#include <string.h>
+#include <ipxe/pccrd.h>
+#include <ipxe/test.h>
+
+/** Message UUID used for tests */
+#define PCCRD_TEST_UUID "12345678-1234-5678-9abc-def012345678"
+
+/** Non-PeerDist probe (as used to locate e.g. printers) */
+static const char pccrd_test_printer[] =
+	"<soap:Envelope><soap:Header>"
+	"<wsa:MessageID>urn:uuid:" PCCRD_TEST_UUID "</wsa:MessageID>"
+	"</soap:Header><soap:Body><wsd:Probe>"
+	"<wsd:Types>wsdp:Device wprt:PrintDeviceType</wsd:Types>"
+	"</wsd:Probe></soap:Body></soap:Envelope>";
+
+/**
+ * Check that a NUL-separated string list matches expected values
+ *
+ * @v list		String list (terminated with a zero-length string)
+ * @v expected		Expected string list
+ * @v len		Length of expected string list (including terminator)
+ * @ret matches		List matches
+ */
+static int pccrd_list_matches ( const char *list, const char *expected,
+				size_t len ) {
+
+	return ( memcmp ( list, expected, len ) == 0 );
+}
+
+/**
+ * Perform PeerDist discovery self-test
+ *
+ */
+static void pccrd_test_exec ( void ) {
+	static const char ids[] = "0123ABCD\0";
+	static const char message[] = "urn:uuid:" PCCRD_TEST_UUID;
+	static const char matched[] = "0123ABCD\0";
+	static const char locations[] = "192.168.0.1:80\0";
+	struct peerdist_discovery_probe probe;
+	struct peerdist_discovery_reply reply;
+	char *request;
+	char *response;
+	char *printer;
+
+	/* Parse a discovery request as a probe.  The <wsd:Scopes>
+	 * opening tag includes a MatchBy attribute.
+	 */
+	request = peerdist_discovery_request ( PCCRD_TEST_UUID, "0123ABCD" );
+	ok ( request != NULL );
+	if ( request ) {
+		ok ( peerdist_discovery_probe ( request, strlen ( request ),
+						&probe ) == 0 );
+		ok ( strcmp ( probe.message, message ) == 0 );
+		ok ( pccrd_list_matches ( probe.ids, ids, sizeof ( ids ) ) );
+		free ( request );
+	}
+
+	/* Parse a discovery response as a reply.  Segments with a
+	 * zero block count must be eliminated.
+	 */
+	response = peerdist_discovery_response ( PCCRD_TEST_UUID, message,
+						 "0123ABCD 4567EF01",
+						 "0000001000000000",
+						 "192.168.0.1:80" );
+	ok ( response != NULL );
+	if ( response ) {
+		ok ( peerdist_discovery_reply ( response, strlen ( response ),
+						&reply ) == 0 );
+		ok ( pccrd_list_matches ( reply.ids, matched,
+					  sizeof ( matched ) ) );
+		ok ( pccrd_list_matches ( reply.locations, locations,
+					  sizeof ( locations ) ) );
+		free ( response );
+	}
+
+	/* Reject probes for anything other than PeerDist content */
+	printer = strdup ( pccrd_test_printer );
+	ok ( printer != NULL );
+	if ( printer ) {
+		ok ( peerdist_discovery_probe ( printer, strlen ( printer ),
+						&probe ) != 0 );
+		free ( printer );
+	}
+}
+
+/** PeerDist discovery self-test */
+struct self_test pccrd_test __self_test = {
+	.name = "pccrd",
+	.exec = pccrd_test_exec,
+};
@@ -0,0 +1,236 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Process scheduler self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <byteswap.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/device.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/if_ether.h>
+#include <ipxe/ethernet.h>
+#include <ipxe/process.h>
+#include <ipxe/test.h>
+
+/** Number of turns of the competing process to measure */
+#define PROCESS_TEST_TURNS 100
+
+/** Test is in progress */
+static int process_test_active;
+
+/** Test network device is receiving a download */
+static int process_test_downloading;
+
+/** Test network device received a packet on the previous poll */
+static int process_test_delivered;
+
+/** Number of test network device polls */
+static unsigned int process_test_polls;
+
+/** Number of packets received by test network device */
+static unsigned int process_test_packets;
+
+/** Number of competing process steps */
+static unsigned int process_test_steps;
+
+/** Test network device parent */
+static struct device process_test_dev = {
+	.name = "proctest",
+	.driver_name = "proctest",
+	.siblings = LIST_HEAD_INIT ( process_test_dev.siblings ),
+	.children = LIST_HEAD_INIT ( process_test_dev.children ),
+};
+
+/**
+ * Open network device
+ *
+ * @v netdev		Network device
+ * @ret rc		Return status code
+ */
+static int process_test_open ( struct net_device *netdev __unused ) {
+	return 0;
+}
+
+/**
+ * Close network device
+ *
+ * @v netdev		Network device
+ */
+static void process_test_close ( struct net_device *netdev __unused ) {
+	/* Nothing to do */
+}
+
+/**
+ * Transmit packet
+ *
+ * @v netdev		Network device
+ * @v iobuf		I/O buffer
+ * @ret rc		Return status code
+ */
+static int process_test_transmit ( struct net_device *netdev,
+				   struct io_buffer *iobuf ) {
+
+	netdev_tx_complete ( netdev, iobuf );
+	return 0;
+}
+
+/**
+ * Poll for completed and received packets
+ *
+ * @v netdev		Network device
+ */
+static void process_test_poll ( struct net_device *netdev ) {
+	struct ethhdr *ethhdr;
+	struct io_buffer *iobuf;
+
+	/* Count polls */
+	process_test_polls++;
+
+	/* Receive a packet (of an unsupported protocol) on every
+	 * other poll while a download is in progress.  The network
+	 * stack keeps polling until a poll returns no packets, and so
+	 * this delivers exactly one packet per network process step.
+	 */
+	if ( ! process_test_downloading )
+		return;
+	if ( process_test_delivered ) {
+		process_test_delivered = 0;
+		return;
+	}
+	iobuf = alloc_iob ( ETH_ZLEN );
+	if ( ! iobuf )
+		return;
+	ethhdr = iob_put ( iobuf, ETH_ZLEN );
+	memset ( ethhdr, 0, ETH_ZLEN );
+	memcpy ( ethhdr->h_dest, netdev->ll_addr, ETH_ALEN );
+	ethhdr->h_protocol = htons ( 0x88b5 );
+	netdev_rx ( netdev, iobuf );
+	process_test_delivered = 1;
+	process_test_packets++;
+}
+
+/** Test network device operations */
+static struct net_device_operations process_test_operations = {
+	.open		= process_test_open,
+	.close		= process_test_close,
+	.transmit	= process_test_transmit,
+	.poll		= process_test_poll,
+};
+
+/**
+ * Single-step competing process
+ *
+ * @v process		Process
+ */
+static void process_test_step ( struct process *process __unused ) {
+
+	if ( process_test_active )
+		process_test_steps++;
+}
+
+/** Competing permanent process */
+PERMANENT_PROCESS ( process_test_process, process_test_step );
+
+/**
+ * Run scheduler for a fixed number of competing process steps
+ *
+ * @v downloading	Test network device is receiving a download
+ */
+static void process_test_run ( int downloading ) {
+	unsigned int guard;
+
+	/* Run scheduler for a fixed number of competing steps */
+	process_test_downloading = downloading;
+	process_test_delivered = 0;
+	process_test_polls = 0;
+	process_test_packets = 0;
+	process_test_steps = 0;
+	process_test_active = 1;
+	for ( guard = 0 ; ( ( process_test_steps < PROCESS_TEST_TURNS ) &&
+			    ( guard < ( 1000 * PROCESS_TEST_TURNS ) ) ) ;
+	      guard++ ) {
+		step();
+	}
+	process_test_active = 0;
+	process_test_downloading = 0;
+	ok ( process_test_steps == PROCESS_TEST_TURNS );
+}
+
+/**
+ * Perform process scheduler self-tests
+ *
+ */
+static void process_test_exec ( void ) {
+	struct net_device *netdev;
+	int rc;
+
+	/* Create network device */
+	netdev = alloc_etherdev ( 0 );
+	ok ( netdev != NULL );
+	if ( ! netdev )
+		return;
+	netdev_init ( netdev, &process_test_operations );
+	netdev->dev = &process_test_dev;
+	netdev->hw_addr[0] = 0x02;
+	ok ( ( rc = register_netdev ( netdev ) ) == 0 );
+	if ( rc != 0 )
+		goto err_register;
+	ok ( netdev_open ( netdev ) == 0 );
+	netdev_link_up ( netdev );
+
+	/* Allow any traffic generated by opening the device to settle */
+	process_test_run ( 0 );
+
+	/* Network process should get a single step per turn while idle */
+	process_test_run ( 0 );
+	ok ( process_test_polls <= ( PROCESS_TEST_TURNS + 1 ) );
+
+	/* Network process should get its full weight during a download,
+	 * even though only permanent processes are runnable.
+	 */
+	process_test_run ( 1 );
+	ok ( process_test_packets >=
+	     ( NET_PROCESS_WEIGHT * ( PROCESS_TEST_TURNS - 1 ) ) );
+
+	/* Destroy network device */
+	netdev_close ( netdev );
+	unregister_netdev ( netdev );
+ err_register:
+	netdev_nullify ( netdev );
+	netdev_put ( netdev );
+}
+
+/** Process scheduler self-test */
+struct self_test process_test __self_test = {
+	.name = "process",
+	.exec = process_test_exec,
+};
@@ -101,8 +101,11 @@ PROFILE_TEST ( large, 93533894UL, 25538UL,
 static void profile_okx ( struct profile_test *test, const char *file,
 			  unsigned int line ) {
 	struct profiler profiler;
+	unsigned int hist[PROFILE_HIST_BUCKETS];
 	unsigned long mean;
 	unsigned long stddev;
+	unsigned long sample;
+	unsigned int bucket;
 	unsigned int i;
 
 	/* Initialise profiler */
@@ -118,6 +121,17 @@ static void profile_okx ( struct profile_test *test, const char *file,
 	DBGC ( test, "PROFILE calculated mean %ld stddev %ld\n", mean, stddev );
 	okx ( mean == test->mean, file, line );
 	okx ( stddev == test->stddev, file, line );
+
+	/* Check resulting histogram */
+	memset ( hist, 0, sizeof ( hist ) );
+	for ( i = 0 ; i < test->count ; i++ ) {
+		sample = test->samples[i];
+		for ( bucket = 0 ; sample ; bucket++ )
+			sample >>= 1;
+		hist[bucket]++;
+	}
+	okx ( memcmp ( profiler.hist, hist, sizeof ( hist ) ) == 0,
+	      file, line );
 }
 #define profile_ok( test ) profile_okx ( test, __FILE__, __LINE__ )
 
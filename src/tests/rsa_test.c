@@ -205,6 +205,55 @@ struct rsa_signature_test {
 				sizeof ( bad_signature ) );		\
 	} while ( 0 )
 
+/**
+ * Report RSA-PSS signature test result
+ *
+ * @v test		RSA signature test
+ *
+ * RSA-PSS signatures include a random salt, and so cannot be
+ * compared against a fixed expected value.  We instead verify the
+ * expected signature and check that a freshly generated signature
+ * can be verified.
+ */
+#define rsa_pss_signature_ok( test ) do {				\
+	uint8_t bad_signature[ (test)->signature_len ];			\
+	uint8_t ctx[ rsa_pss_algorithm.ctxsize ];			\
+	uint8_t digestctx[ (test)->digest->ctxsize ];			\
+	uint8_t digestout[ (test)->digest->digestsize ];		\
+	uint8_t signature[ (test)->signature_len ];			\
+									\
+	pubkey_verify_ok ( &rsa_pss_algorithm, (test)->public,		\
+			   (test)->public_len, (test)->digest,		\
+			   (test)->plaintext, (test)->plaintext_len,	\
+			   (test)->signature, (test)->signature_len );	\
+	memset ( bad_signature, 0, sizeof ( bad_signature ) );		\
+	pubkey_verify_fail_ok ( &rsa_pss_algorithm, (test)->public,	\
+				(test)->public_len, (test)->digest,	\
+				(test)->plaintext,			\
+				(test)->plaintext_len, bad_signature,	\
+				sizeof ( bad_signature ) );		\
+	pubkey_verify_fail_ok ( &rsa_algorithm, (test)->public,		\
+				(test)->public_len, (test)->digest,	\
+				(test)->plaintext,			\
+				(test)->plaintext_len,			\
+				(test)->signature,			\
+				(test)->signature_len );		\
+	digest_init ( (test)->digest, digestctx );			\
+	digest_update ( (test)->digest, digestctx, (test)->plaintext,	\
+			(test)->plaintext_len );			\
+	digest_final ( (test)->digest, digestctx, digestout );		\
+	ok ( pubkey_init ( &rsa_pss_algorithm, ctx, (test)->private,	\
+			   (test)->private_len ) == 0 );		\
+	ok ( pubkey_sign ( &rsa_pss_algorithm, ctx, (test)->digest,	\
+			   digestout, signature ) ==			\
+	     ( ( int ) sizeof ( signature ) ) );			\
+	pubkey_final ( &rsa_pss_algorithm, ctx );			\
+	pubkey_verify_ok ( &rsa_pss_algorithm, (test)->public,		\
+			   (test)->public_len, (test)->digest,		\
+			   (test)->plaintext, (test)->plaintext_len,	\
+			   signature, sizeof ( signature ) );		\
+	} while ( 0 )
+
 /** "Hello world" encryption and decryption test */
 RSA_ENCRYPT_DECRYPT_TEST ( hw_test,
 	PRIVATE ( 0x30, 0x82, 0x01, 0x3b, 0x02, 0x01, 0x00, 0x02, 0x41, 0x00,
@@ -332,6 +381,84 @@ RSA_SIGNATURE_TEST ( md5_test,
 		    0x56, 0xec, 0x2f, 0x8e, 0xa7, 0xae, 0xd9, 0x80, 0xb3, 0xaa,
 		    0xac, 0x45, 0x00, 0xa8 ) );
 
+/** Random message MD5 signature test using Chinese Remainder Theorem
+ *
+ * This uses the same key as the MD5 signature test, with the private
+ * exponent corrupted.  The expected signature can therefore be
+ * produced only via the CRT components.
+ */
+RSA_SIGNATURE_TEST ( crt_test,
+	PRIVATE ( 0x30, 0x82, 0x01, 0x3b, 0x02, 0x01, 0x00, 0x02, 0x41, 0x00,
+		  0xf9, 0x3f, 0x78, 0x44, 0xe2, 0x0e, 0x25, 0xf1, 0x0e, 0x94,
+		  0xcd, 0xca, 0x6f, 0x9e, 0xea, 0x6d, 0xdf, 0xcd, 0xa0, 0x7c,
+		  0xe2, 0x21, 0xeb, 0xde, 0xa6, 0x01, 0x4b, 0xb0, 0x76, 0x4b,
+		  0xd8, 0x8b, 0x19, 0x83, 0xb4, 0xbe, 0x45, 0xde, 0x3d, 0x46,
+		  0x61, 0x0f, 0x11, 0xe2, 0x2c, 0xf5, 0xb0, 0x63, 0xa0, 0x84,
+		  0xc0, 0xaf, 0x4e, 0xbe, 0x6a, 0xd3, 0x84, 0x3f, 0xec, 0x42,
+		  0x17, 0xe9, 0x25, 0xe1, 0x02, 0x03, 0x01, 0x00, 0x01, 0x02,
+		  0x40, 0x63, 0x7d, 0x93, 0x1f, 0xdd, 0x17, 0xec, 0x24, 0x42,
+		  0x37, 0xc8, 0xce, 0x0a, 0xa7, 0x88, 0x49, 0x5c, 0x9b, 0x9b,
+		  0xa4, 0x5d, 0x93, 0x3b, 0xea, 0x62, 0x3c, 0xb6, 0xd5, 0x07,
+		  0x19, 0xd7, 0x79, 0xf0, 0x3b, 0xab, 0xa3, 0xa5, 0x43, 0x35,
+		  0x8d, 0x58, 0x40, 0xa0, 0x95, 0xc5, 0x63, 0x28, 0x28, 0xda,
+		  0x13, 0x28, 0xdf, 0xc9, 0x05, 0xdc, 0x69, 0x46, 0xff, 0x2a,
+		  0xfb, 0xe4, 0xd1, 0x23, 0xa5, 0x02, 0x21, 0x00, 0xfc, 0xef,
+		  0x3b, 0x9d, 0x9d, 0x69, 0xf3, 0x66, 0x0a, 0x2b, 0x52, 0xd6,
+		  0x61, 0x14, 0x90, 0x6e, 0x7d, 0x3c, 0x08, 0x4b, 0x98, 0x44,
+		  0x00, 0xf2, 0xa4, 0x16, 0x2d, 0xd1, 0xf9, 0xa0, 0x1e, 0x37,
+		  0x02, 0x21, 0x00, 0xfc, 0x44, 0xcc, 0x7c, 0xc0, 0x26, 0x9a,
+		  0x0a, 0x6e, 0xda, 0x17, 0x05, 0x7d, 0x66, 0x8d, 0x29, 0x1a,
+		  0x44, 0xbf, 0x33, 0x76, 0xae, 0x8d, 0xe8, 0xb5, 0xed, 0xb8,
+		  0x6f, 0xdc, 0xfe, 0x10, 0xa7, 0x02, 0x20, 0x76, 0x48, 0x8a,
+		  0x60, 0x93, 0x14, 0xd1, 0x36, 0x8e, 0xda, 0xe3, 0xca, 0x4d,
+		  0x6c, 0x08, 0x7f, 0x23, 0x21, 0xc7, 0xdf, 0x52, 0x3d, 0xbb,
+		  0x13, 0xbd, 0x98, 0x81, 0xa5, 0x08, 0x4f, 0xd0, 0xd1, 0x02,
+		  0x21, 0x00, 0xd9, 0xa3, 0x11, 0x37, 0xdf, 0x1e, 0x6e, 0x6e,
+		  0xe9, 0xcb, 0xc5, 0x68, 0xbb, 0x13, 0x2a, 0x5d, 0x77, 0x88,
+		  0x2f, 0xdc, 0x5a, 0x5b, 0xa5, 0x9a, 0x4a, 0xba, 0x58, 0x10,
+		  0x49, 0xfb, 0xf6, 0xa9, 0x02, 0x21, 0x00, 0x89, 0xe8, 0x47,
+		  0x5b, 0x20, 0x04, 0x3b, 0x0f, 0xb9, 0xe0, 0x1d, 0xab, 0xcf,
+		  0xe8, 0x72, 0xfd, 0x7d, 0x17, 0x85, 0xc8, 0xd8, 0xbd, 0x1a,
+		  0x92, 0xe0, 0xbc, 0x7a, 0xc7, 0x31, 0xbe, 0xef, 0xf4 ),
+	PUBLIC ( 0x30, 0x5c, 0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48, 0x86,
+		 0xf7, 0x0d, 0x01, 0x01, 0x01, 0x05, 0x00, 0x03, 0x4b, 0x00,
+		 0x30, 0x48, 0x02, 0x41, 0x00, 0xf9, 0x3f, 0x78, 0x44, 0xe2,
+		 0x0e, 0x25, 0xf1, 0x0e, 0x94, 0xcd, 0xca, 0x6f, 0x9e, 0xea,
+		 0x6d, 0xdf, 0xcd, 0xa0, 0x7c, 0xe2, 0x21, 0xeb, 0xde, 0xa6,
+		 0x01, 0x4b, 0xb0, 0x76, 0x4b, 0xd8, 0x8b, 0x19, 0x83, 0xb4,
+		 0xbe, 0x45, 0xde, 0x3d, 0x46, 0x61, 0x0f, 0x11, 0xe2, 0x2c,
+		 0xf5, 0xb0, 0x63, 0xa0, 0x84, 0xc0, 0xaf, 0x4e, 0xbe, 0x6a,
+		 0xd3, 0x84, 0x3f, 0xec, 0x42, 0x17, 0xe9, 0x25, 0xe1, 0x02,
+		 0x03, 0x01, 0x00, 0x01 ),
+	PLAINTEXT ( 0x9d, 0x5b, 0x46, 0x42, 0x27, 0xc0, 0xf1, 0x4b, 0xe5, 0x9e,
+		    0xd3, 0x10, 0xa1, 0xeb, 0x16, 0xc3, 0xc6, 0x8f, 0x1a, 0x18,
+		    0x86, 0xc3, 0x92, 0x15, 0x2d, 0x65, 0xa0, 0x40, 0xe1, 0x3e,
+		    0x29, 0x79, 0x7c, 0xd4, 0x08, 0xef, 0x53, 0xeb, 0x08, 0x07,
+		    0x39, 0x21, 0xb3, 0x40, 0xff, 0x4b, 0xc7, 0x76, 0xb9, 0x12,
+		    0x32, 0x41, 0xcc, 0x5a, 0x86, 0x5c, 0x2e, 0x0b, 0x05, 0xd8,
+		    0x56, 0xd4, 0xdf, 0x6f, 0x2c, 0xf0, 0xbf, 0x4b, 0x6f, 0x68,
+		    0xde, 0x39, 0x4a, 0x3e, 0xae, 0x44, 0xb9, 0xc6, 0x24, 0xb3,
+		    0x83, 0x2e, 0x9f, 0xf5, 0x6d, 0x61, 0xc3, 0x8e, 0xe8, 0x8f,
+		    0xa6, 0x87, 0x58, 0x3f, 0x36, 0x13, 0xf4, 0x7e, 0xf0, 0x20,
+		    0x47, 0x87, 0x3f, 0x21, 0x6e, 0x51, 0x3c, 0xf1, 0xef, 0xca,
+		    0x9f, 0x77, 0x9c, 0x91, 0x4f, 0xd4, 0x56, 0xc0, 0x39, 0x11,
+		    0xab, 0x15, 0x2c, 0x5e, 0xad, 0x40, 0x09, 0xe6, 0xde, 0xe5,
+		    0x77, 0x60, 0x19, 0xd4, 0x0d, 0x77, 0x76, 0x24, 0x8b, 0xe6,
+		    0xdd, 0xa5, 0x8d, 0x4a, 0x55, 0x3a, 0xdf, 0xf8, 0x29, 0xfb,
+		    0x47, 0x8a, 0xfe, 0x98, 0x34, 0xf6, 0x30, 0x7f, 0x09, 0x03,
+		    0x26, 0x05, 0xd5, 0x46, 0x18, 0x96, 0xca, 0x96, 0x5b, 0x66,
+		    0xf2, 0x8d, 0xfc, 0xfc, 0x37, 0xf7, 0xc7, 0x6d, 0x6c, 0xd8,
+		    0x24, 0x0c, 0x6a, 0xec, 0x82, 0x5c, 0x72, 0xf1, 0xfc, 0x05,
+		    0xed, 0x8e, 0xe8, 0xd9, 0x8b, 0x8b, 0x67, 0x02, 0x95 ),
+	&md5_algorithm,
+	SIGNATURE ( 0xdb, 0x56, 0x3d, 0xea, 0xae, 0x81, 0x4b, 0x3b, 0x2e, 0x8e,
+		    0xb8, 0xee, 0x13, 0x61, 0xc6, 0xe7, 0xd7, 0x50, 0xcd, 0x0d,
+		    0x34, 0x3a, 0xfe, 0x9a, 0x8d, 0xf8, 0xfb, 0xd6, 0x7e, 0xbd,
+		    0xdd, 0xb3, 0xf9, 0xfb, 0xe0, 0xf8, 0xe7, 0x71, 0x03, 0xe6,
+		    0x55, 0xd5, 0xf4, 0x02, 0x3c, 0xb5, 0xbc, 0x95, 0x2b, 0x66,
+		    0x56, 0xec, 0x2f, 0x8e, 0xa7, 0xae, 0xd9, 0x80, 0xb3, 0xaa,
+		    0xac, 0x45, 0x00, 0xa8 ) );
+
 /** Random message SHA-1 signature test */
 RSA_SIGNATURE_TEST ( sha1_test,
 	PRIVATE ( 0x30, 0x82, 0x01, 0x3b, 0x02, 0x01, 0x00, 0x02, 0x41, 0x00,
@@ -478,6 +605,104 @@ RSA_SIGNATURE_TEST ( sha256_test,
 		    0x7d, 0x38, 0x37, 0xc4, 0xea, 0xdd, 0x3a, 0x6f, 0xa8, 0x65,
 		    0x60, 0x73, 0x77, 0x3c ) );
 
+/** SHA-256 RSA-PSS signature test */
+RSA_SIGNATURE_TEST ( pss_sha256_test,
+	PRIVATE ( 0x30, 0x82, 0x02, 0x5d, 0x02, 0x01, 0x00, 0x02, 0x81, 0x81,
+		  0x00, 0xbe, 0xd4, 0xdb, 0xa1, 0x12, 0x73, 0xfe, 0x7f, 0x01,
+		  0x53, 0xdb, 0xa9, 0x91, 0xca, 0xb5, 0x05, 0x06, 0xc6, 0x92,
+		  0x1b, 0x1c, 0xfd, 0x45, 0x23, 0x57, 0xc7, 0x99, 0xf5, 0x32,
+		  0x8e, 0x55, 0x0a, 0x30, 0x6e, 0x18, 0x5c, 0x89, 0x61, 0xef,
+		  0xab, 0x03, 0x98, 0x7e, 0x0b, 0xbb, 0x17, 0x38, 0x75, 0x5f,
+		  0x05, 0x3c, 0x1a, 0xc6, 0xe7, 0xeb, 0xf1, 0x93, 0x33, 0x98,
+		  0xde, 0x36, 0x93, 0x19, 0xbb, 0x32, 0x19, 0x90, 0x98, 0xfd,
+		  0x25, 0x74, 0xb5, 0xda, 0x21, 0xc2, 0xcf, 0x4b, 0x2e, 0x8a,
+		  0x45, 0x66, 0xbf, 0xff, 0xe7, 0xbc, 0x90, 0xd6, 0xfa, 0x5a,
+		  0x61, 0xc2, 0x6d, 0x0e, 0xd3, 0xaa, 0x65, 0xee, 0xf7, 0x7f,
+		  0x20, 0x0e, 0xcf, 0xca, 0x68, 0x47, 0x5a, 0x00, 0x6f, 0x0c,
+		  0xac, 0xf5, 0x03, 0x70, 0x6b, 0xe8, 0x74, 0x81, 0xd0, 0x08,
+		  0xb8, 0x73, 0xc6, 0x39, 0xcf, 0x07, 0x1b, 0x70, 0xab, 0x02,
+		  0x03, 0x01, 0x00, 0x01, 0x02, 0x81, 0x81, 0x00, 0x88, 0xab,
+		  0x39, 0x80, 0x6a, 0x0e, 0xd8, 0xbd, 0x6c, 0xdd, 0xf9, 0xfb,
+		  0xbf, 0x86, 0x45, 0x8e, 0x8c, 0x03, 0xba, 0xaf, 0xe0, 0x5b,
+		  0x23, 0x20, 0xe4, 0xc4, 0xf6, 0xe6, 0x3c, 0x86, 0xe3, 0x30,
+		  0xa0, 0xee, 0xb8, 0x53, 0xcd, 0xb0, 0x6e, 0x4d, 0x34, 0x0e,
+		  0x0a, 0x77, 0xac, 0x4e, 0x3d, 0x09, 0x12, 0x3c, 0x55, 0x87,
+		  0x77, 0xdc, 0xb1, 0x86, 0x19, 0xbe, 0x62, 0x45, 0x03, 0x20,
+		  0xe6, 0xd3, 0x82, 0xeb, 0xe3, 0x7c, 0x05, 0xaa, 0x3d, 0x59,
+		  0x6d, 0x06, 0x39, 0x77, 0xf2, 0x4a, 0x07, 0x14, 0x1c, 0x7b,
+		  0xf2, 0xe0, 0x35, 0xae, 0x24, 0x5d, 0x57, 0x12, 0x58, 0x89,
+		  0x85, 0x08, 0x2d, 0x17, 0x81, 0x45, 0x71, 0x71, 0x0f, 0xba,
+		  0xd2, 0x54, 0x7b, 0x4c, 0xef, 0xd2, 0xc1, 0x2a, 0x5e, 0x6a,
+		  0x25, 0xb6, 0xda, 0xd9, 0x06, 0x27, 0x06, 0x22, 0xe8, 0x11,
+		  0x5a, 0x46, 0xb2, 0x0a, 0x49, 0x81, 0x02, 0x41, 0x00, 0xfc,
+		  0x92, 0x46, 0xac, 0xff, 0x98, 0xd1, 0xb0, 0xe8, 0x3f, 0xad,
+		  0xcb, 0x9e, 0x4c, 0x90, 0xde, 0x9e, 0x35, 0x85, 0x51, 0x1b,
+		  0xdf, 0xab, 0x40, 0x5b, 0x0c, 0xb4, 0xa9, 0x1d, 0x41, 0x3f,
+		  0x96, 0x04, 0x53, 0xb9, 0x54, 0x3b, 0x1a, 0xe0, 0xd4, 0xb7,
+		  0x6b, 0x82, 0x7f, 0xd6, 0x96, 0x3c, 0x52, 0xbf, 0xc3, 0x58,
+		  0x53, 0x3f, 0x25, 0x86, 0xc6, 0x3c, 0x44, 0x91, 0x77, 0x60,
+		  0xd3, 0xcd, 0x89, 0x02, 0x41, 0x00, 0xc1, 0x6c, 0x06, 0xb9,
+		  0xe4, 0x78, 0x27, 0xf3, 0xa7, 0x23, 0xe3, 0xe4, 0x80, 0x0f,
+		  0x58, 0x93, 0xc0, 0x1e, 0x88, 0x39, 0x1e, 0x04, 0x80, 0x18,
+		  0x72, 0x2d, 0xa7, 0x8d, 0xc3, 0x7c, 0x3d, 0x58, 0xef, 0x96,
+		  0x46, 0x64, 0xb6, 0xb6, 0x6d, 0xa8, 0xf4, 0xac, 0xac, 0xcc,
+		  0x84, 0x57, 0x0a, 0x42, 0xcc, 0x24, 0x6f, 0xc1, 0x15, 0xfc,
+		  0x14, 0x5e, 0xf6, 0x56, 0x7d, 0xab, 0x0d, 0xd1, 0x53, 0x93,
+		  0x02, 0x41, 0x00, 0xec, 0x59, 0xb5, 0xe9, 0x8e, 0x05, 0xe3,
+		  0xb4, 0x38, 0xa1, 0xde, 0x70, 0xfc, 0xe1, 0x89, 0x6f, 0xc9,
+		  0x7d, 0x2c, 0x14, 0x8a, 0x90, 0xf4, 0x20, 0x75, 0x13, 0x9e,
+		  0xbb, 0xe2, 0xb4, 0x7c, 0x5c, 0x56, 0x10, 0x43, 0x0d, 0x9f,
+		  0x81, 0xb7, 0x83, 0x57, 0x61, 0x33, 0xed, 0x8d, 0x51, 0x69,
+		  0x81, 0xc6, 0x11, 0x77, 0x45, 0xef, 0x81, 0x9e, 0x6d, 0x43,
+		  0x58, 0xa7, 0x07, 0x9f, 0x84, 0x94, 0x81, 0x02, 0x40, 0x12,
+		  0x23, 0x91, 0x55, 0xe9, 0x89, 0x23, 0x26, 0x04, 0x6c, 0xa7,
+		  0x38, 0x8c, 0x91, 0xe3, 0xda, 0xa7, 0x4f, 0xb5, 0xb2, 0xb5,
+		  0x8f, 0xf2, 0x7b, 0x58, 0x69, 0xd3, 0xa6, 0xc5, 0xc8, 0x66,
+		  0xf0, 0x6a, 0x37, 0x8b, 0x8e, 0x72, 0x5c, 0x15, 0x58, 0x9c,
+		  0xe9, 0x7c, 0xa3, 0x09, 0x5e, 0x28, 0x46, 0x2f, 0x62, 0xd3,
+		  0x60, 0x26, 0x31, 0xa7, 0xaf, 0x68, 0x26, 0xa0, 0x4e, 0x64,
+		  0x53, 0x57, 0x25, 0x02, 0x40, 0x62, 0x46, 0x65, 0xa1, 0xc2,
+		  0x50, 0xf7, 0xf6, 0x95, 0xfb, 0xf2, 0xdd, 0x6e, 0x43, 0xab,
+		  0x19, 0xc9, 0x45, 0xec, 0xe6, 0x43, 0xe3, 0xf7, 0x40, 0x8b,
+		  0x5a, 0x6a, 0x7f, 0x58, 0x37, 0x40, 0x90, 0xfd, 0xd5, 0xfa,
+		  0x76, 0x85, 0x1f, 0xc1, 0x87, 0x03, 0x2d, 0xe2, 0x36, 0x72,
+		  0x6c, 0x92, 0x5e, 0x2c, 0x77, 0xb4, 0x15, 0x3c, 0x68, 0x28,
+		  0x33, 0x32, 0x83, 0xea, 0xea, 0xfd, 0x3c, 0x5c, 0x16 ),
+	PUBLIC ( 0x30, 0x81, 0x9f, 0x30, 0x0d, 0x06, 0x09, 0x2a, 0x86, 0x48,
+		 0x86, 0xf7, 0x0d, 0x01, 0x01, 0x01, 0x05, 0x00, 0x03, 0x81,
+		 0x8d, 0x00, 0x30, 0x81, 0x89, 0x02, 0x81, 0x81, 0x00, 0xbe,
+		 0xd4, 0xdb, 0xa1, 0x12, 0x73, 0xfe, 0x7f, 0x01, 0x53, 0xdb,
+		 0xa9, 0x91, 0xca, 0xb5, 0x05, 0x06, 0xc6, 0x92, 0x1b, 0x1c,
+		 0xfd, 0x45, 0x23, 0x57, 0xc7, 0x99, 0xf5, 0x32, 0x8e, 0x55,
+		 0x0a, 0x30, 0x6e, 0x18, 0x5c, 0x89, 0x61, 0xef, 0xab, 0x03,
+		 0x98, 0x7e, 0x0b, 0xbb, 0x17, 0x38, 0x75, 0x5f, 0x05, 0x3c,
+		 0x1a, 0xc6, 0xe7, 0xeb, 0xf1, 0x93, 0x33, 0x98, 0xde, 0x36,
+		 0x93, 0x19, 0xbb, 0x32, 0x19, 0x90, 0x98, 0xfd, 0x25, 0x74,
+		 0xb5, 0xda, 0x21, 0xc2, 0xcf, 0x4b, 0x2e, 0x8a, 0x45, 0x66,
+		 0xbf, 0xff, 0xe7, 0xbc, 0x90, 0xd6, 0xfa, 0x5a, 0x61, 0xc2,
+		 0x6d, 0x0e, 0xd3, 0xaa, 0x65, 0xee, 0xf7, 0x7f, 0x20, 0x0e,
+		 0xcf, 0xca, 0x68, 0x47, 0x5a, 0x00, 0x6f, 0x0c, 0xac, 0xf5,
+		 0x03, 0x70, 0x6b, 0xe8, 0x74, 0x81, 0xd0, 0x08, 0xb8, 0x73,
+		 0xc6, 0x39, 0xcf, 0x07, 0x1b, 0x70, 0xab, 0x02, 0x03, 0x01,
+		 0x00, 0x01 ),
+	PLAINTEXT ( 0x52, 0x53, 0x41, 0x2d, 0x50, 0x53, 0x53, 0x20, 0x73, 0x69,
+		    0x67, 0x6e, 0x61, 0x74, 0x75, 0x72, 0x65, 0x20, 0x74, 0x65,
+		    0x73, 0x74, 0x20, 0x6d, 0x65, 0x73, 0x73, 0x61, 0x67, 0x65 ),
+	&sha256_algorithm,
+	SIGNATURE ( 0x74, 0x4d, 0x11, 0x31, 0x12, 0x42, 0x41, 0x45, 0xcd, 0x71,
+		    0xa9, 0xcb, 0x74, 0xfe, 0xd8, 0x71, 0x49, 0x0b, 0xe3, 0x92,
+		    0xc7, 0x3e, 0x57, 0x66, 0x33, 0xb2, 0x8a, 0x08, 0x74, 0xa8,
+		    0x5d, 0x84, 0xf3, 0x35, 0x3e, 0x3d, 0x6b, 0x08, 0x9d, 0x17,
+		    0xd8, 0x36, 0x75, 0x67, 0xaa, 0x8c, 0x19, 0xca, 0x4e, 0x81,
+		    0x69, 0xb4, 0x5e, 0xf9, 0x34, 0x4a, 0xca, 0xbd, 0x83, 0xc3,
+		    0x68, 0xf9, 0x9c, 0xb0, 0x6d, 0xec, 0x46, 0x55, 0x70, 0x89,
+		    0x0d, 0x41, 0x39, 0x0f, 0xea, 0x9b, 0xa6, 0xc0, 0x57, 0xb7,
+		    0x6b, 0x38, 0xae, 0xe1, 0xd1, 0x65, 0x37, 0x98, 0x66, 0x70,
+		    0xac, 0x17, 0x0f, 0x42, 0x28, 0xeb, 0x59, 0x31, 0x3f, 0xce,
+		    0x05, 0x5c, 0x53, 0xfe, 0x30, 0x45, 0xb1, 0x79, 0x27, 0xe1,
+		    0xdc, 0xc4, 0x94, 0x93, 0x8c, 0x27, 0xc4, 0x6b, 0xa8, 0x3e,
+		    0x0d, 0xb6, 0x8a, 0x2a, 0x08, 0x83, 0x50, 0x41 ) );
+
 /**
  * Perform RSA self-tests
  *
@@ -486,8 +711,10 @@ static void rsa_test_exec ( void ) {
 
 	rsa_encrypt_decrypt_ok ( &hw_test );
 	rsa_signature_ok ( &md5_test );
+	rsa_signature_ok ( &crt_test );
 	rsa_signature_ok ( &sha1_test );
 	rsa_signature_ok ( &sha256_test );
+	rsa_pss_signature_ok ( &pss_sha256_test );
 }
 
 /** RSA self-test */
@@ -261,6 +261,10 @@ static struct setting test_busdevfn_setting = {
  *
  */
 static void settings_test_exec ( void ) {
+	char tag_name[] = "12";
+	char unknown_name[] = "no-such-setting";
+	struct settings *settings;
+	struct setting setting;
 
 	/* Register test settings block */
 	ok ( register_settings ( &test_settings, NULL, "test" ) == 0 );
@@ -426,6 +430,17 @@ static void settings_test_exec ( void ) {
 	fetchf_ok ( &test_settings, &test_busdevfn_setting,
 		    RAW ( 0x00, 0x02, 0x0a, 0x21 ), "0002:0a:04.1" );
 
+	/* Predefined setting lookup */
+	ok ( find_setting ( "hostname" ) == &hostname_setting );
+	ok ( find_setting ( "filename" ) == &filename_setting );
+	ok ( find_setting ( "no-such-setting" ) == NULL );
+	ok ( parse_setting_name ( tag_name, find_child_settings, &settings,
+				  &setting ) == 0 );
+	ok ( setting.name == hostname_setting.name );
+	ok ( parse_setting_name ( unknown_name, find_child_settings, &settings,
+				  &setting ) == 0 );
+	ok ( strcmp ( setting.name, "no-such-setting" ) == 0 );
+
 	/* Clear and unregister test settings block */
 	clear_settings ( &test_settings );
 	unregister_settings ( &test_settings );
@@ -0,0 +1,364 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * TCP receive segment coalescing self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <byteswap.h>
+#include <ipxe/list.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/if_ether.h>
+#include <ipxe/ethernet.h>
+#include <ipxe/in.h>
+#include <ipxe/ip.h>
+#include <ipxe/ipv6.h>
+#include <ipxe/tcpip.h>
+#include <ipxe/tcp.h>
+#include <ipxe/test.h>
+
+/** A received TCP segment */
+struct tcpgro_segment {
+	/** Source port */
+	uint16_t port;
+	/** Sequence number */
+	uint32_t seq;
+	/** TCP flags */
+	uint8_t flags;
+	/** Length of data payload */
+	uint16_t len;
+	/** Checksum is to be corrupted */
+	int corrupt;
+};
+
+/** A TCP receive segment coalescing test */
+struct tcpgro_test {
+	/** Network-layer protocol */
+	uint16_t net_proto;
+	/** Received segments */
+	const struct tcpgro_segment *segs;
+	/** Number of received segments */
+	unsigned int count;
+	/** Expected number of packets after coalescing */
+	unsigned int expected;
+};
+
+/** Define a received segment */
+#define SEGMENT( PORT, SEQ, FLAGS, LEN, CORRUPT ) {			\
+		.port = PORT,						\
+		.seq = SEQ,						\
+		.flags = FLAGS,						\
+		.len = LEN,						\
+		.corrupt = CORRUPT,					\
+	}
+
+/** Define a TCP receive segment coalescing test */
+#define TCPGRO_TEST( name, NET_PROTO, EXPECTED, ... )			\
+	static const struct tcpgro_segment name ## _segs[] =		\
+		{ __VA_ARGS__ };					\
+	static struct tcpgro_test name = {				\
+		.net_proto = NET_PROTO,					\
+		.segs = name ## _segs,					\
+		.count = ( sizeof ( name ## _segs ) /			\
+			   sizeof ( name ## _segs[0] ) ),		\
+		.expected = EXPECTED,					\
+	}
+
+/** Data-only segment */
+#define ACK TCP_ACK
+
+/** Pushed data segment */
+#define PSH ( TCP_ACK | TCP_PSH )
+
+/** Three consecutive IPv4 segments */
+TCPGRO_TEST ( ipv4_consecutive, ETH_P_IP, 1,
+	      SEGMENT ( 80, 1000, ACK, 100, 0 ),
+	      SEGMENT ( 80, 1100, ACK, 200, 0 ),
+	      SEGMENT ( 80, 1300, PSH, 300, 0 ) );
+
+/** IPv4 segments with a missing segment */
+TCPGRO_TEST ( ipv4_gap, ETH_P_IP, 2,
+	      SEGMENT ( 80, 1000, ACK, 100, 0 ),
+	      SEGMENT ( 80, 1200, ACK, 100, 0 ) );
+
+/** IPv4 segments from different connections */
+TCPGRO_TEST ( ipv4_different, ETH_P_IP, 3,
+	      SEGMENT ( 80, 1000, ACK, 100, 0 ),
+	      SEGMENT ( 81, 1100, ACK, 100, 0 ),
+	      SEGMENT ( 80, 1100, ACK, 100, 0 ) );
+
+/** IPv4 segments with a corrupted checksum */
+TCPGRO_TEST ( ipv4_corrupt, ETH_P_IP, 2,
+	      SEGMENT ( 80, 1000, ACK, 100, 0 ),
+	      SEGMENT ( 80, 1100, ACK, 100, 1 ) );
+
+/** IPv4 segments following a pushed segment */
+TCPGRO_TEST ( ipv4_pushed, ETH_P_IP, 2,
+	      SEGMENT ( 80, 1000, PSH, 100, 0 ),
+	      SEGMENT ( 80, 1100, ACK, 100, 0 ),
+	      SEGMENT ( 80, 1200, ACK, 100, 0 ) );
+
+/** IPv4 segments including a zero-length acknowledgement */
+TCPGRO_TEST ( ipv4_ack_only, ETH_P_IP, 3,
+	      SEGMENT ( 80, 1000, ACK, 100, 0 ),
+	      SEGMENT ( 80, 1100, ACK, 0, 0 ),
+	      SEGMENT ( 80, 1100, ACK, 100, 0 ) );
+
+/** IPv4 segments exceeding the maximum coalesced length */
+TCPGRO_TEST ( ipv4_long, ETH_P_IP, 2,
+	      SEGMENT ( 80, 0, ACK, 8192, 0 ),
+	      SEGMENT ( 80, 8192, ACK, 8192, 0 ),
+	      SEGMENT ( 80, 16384, ACK, 8192, 0 ),
+	      SEGMENT ( 80, 24576, ACK, 8192, 0 ),
+	      SEGMENT ( 80, 32768, ACK, 8192, 0 ) );
+
+/** Two consecutive IPv6 segments */
+TCPGRO_TEST ( ipv6_consecutive, ETH_P_IPV6, 1,
+	      SEGMENT ( 80, 0xfffffff0, ACK, 1200, 0 ),
+	      SEGMENT ( 80, 0x000004a0, ACK, 1200, 0 ) );
+
+/** Source IPv4 address */
+#define TCPGRO_IPV4_SRC 0x0a000001UL
+
+/** Destination IPv4 address */
+#define TCPGRO_IPV4_DEST 0x0a000002UL
+
+/** Source and destination IPv6 addresses */
+static const struct in6_addr tcpgro_ipv6_addrs[2] = {
+	{ .s6_addr = { 0xfe, 0x80, [15] = 0x01 } },
+	{ .s6_addr = { 0xfe, 0x80, [15] = 0x02 } },
+};
+
+/**
+ * Construct received segment
+ *
+ * @v net_proto		Network-layer protocol
+ * @v seg		Received segment
+ * @ret iobuf		I/O buffer
+ */
+static struct io_buffer * tcpgro_build ( uint16_t net_proto,
+					 const struct tcpgro_segment *seg ) {
+	struct ipv4_pseudo_header pshdr4;
+	struct ipv6_pseudo_header pshdr6;
+	struct io_buffer *iobuf;
+	struct ethhdr *ethhdr;
+	struct iphdr *iphdr;
+	struct ipv6_header *ip6hdr;
+	struct tcp_header *tcphdr;
+	uint8_t *payload;
+	size_t tcp_len = ( sizeof ( *tcphdr ) + seg->len );
+	size_t net_len = ( ( net_proto == ETH_P_IP ) ?
+			   sizeof ( *iphdr ) : sizeof ( *ip6hdr ) );
+	size_t len = ( sizeof ( *ethhdr ) + net_len + tcp_len );
+	uint16_t csum;
+	unsigned int i;
+
+	/* Allocate I/O buffer */
+	iobuf = alloc_iob ( len );
+	assert ( iobuf != NULL );
+	memset ( iob_put ( iobuf, len ), 0, len );
+
+	/* Construct headers */
+	ethhdr = iobuf->data;
+	ethhdr->h_protocol = htons ( net_proto );
+	tcphdr = ( ( ( void * ) ( ethhdr + 1 ) ) + net_len );
+	tcphdr->src = htons ( seg->port );
+	tcphdr->dest = htons ( 49152 );
+	tcphdr->seq = htonl ( seg->seq );
+	tcphdr->ack = htonl ( 0x12345678UL );
+	tcphdr->hlen = ( ( sizeof ( *tcphdr ) / 4 ) << 4 );
+	tcphdr->flags = seg->flags;
+	tcphdr->win = htons ( 0x1000 );
+	payload = ( ( void * ) ( tcphdr + 1 ) );
+	for ( i = 0 ; i < seg->len ; i++ )
+		payload[i] = ( ( seg->seq + i ) & 0xff );
+	csum = tcpip_chksum ( tcphdr, tcp_len );
+	if ( net_proto == ETH_P_IP ) {
+		iphdr = ( ( void * ) ( ethhdr + 1 ) );
+		iphdr->verhdrlen = ( IP_VER | ( sizeof ( *iphdr ) / 4 ) );
+		iphdr->len = htons ( sizeof ( *iphdr ) + tcp_len );
+		iphdr->ttl = 64;
+		iphdr->protocol = IP_TCP;
+		iphdr->src.s_addr = htonl ( TCPGRO_IPV4_SRC );
+		iphdr->dest.s_addr = htonl ( TCPGRO_IPV4_DEST );
+		iphdr->chksum = tcpip_chksum ( iphdr, sizeof ( *iphdr ) );
+		memset ( &pshdr4, 0, sizeof ( pshdr4 ) );
+		pshdr4.src = iphdr->src;
+		pshdr4.dest = iphdr->dest;
+		pshdr4.protocol = IP_TCP;
+		pshdr4.len = htons ( tcp_len );
+		csum = tcpip_continue_chksum ( csum, &pshdr4,
+					       sizeof ( pshdr4 ) );
+	} else {
+		ip6hdr = ( ( void * ) ( ethhdr + 1 ) );
+		ip6hdr->ver_tc_label = htonl ( IPV6_VER );
+		ip6hdr->len = htons ( tcp_len );
+		ip6hdr->next_header = IP_TCP;
+		ip6hdr->hop_limit = 64;
+		memcpy ( &ip6hdr->src, &tcpgro_ipv6_addrs[0],
+			 sizeof ( ip6hdr->src ) );
+		memcpy ( &ip6hdr->dest, &tcpgro_ipv6_addrs[1],
+			 sizeof ( ip6hdr->dest ) );
+		memset ( &pshdr6, 0, sizeof ( pshdr6 ) );
+		memcpy ( &pshdr6.src, &ip6hdr->src, sizeof ( pshdr6.src ) );
+		memcpy ( &pshdr6.dest, &ip6hdr->dest, sizeof ( pshdr6.dest ) );
+		pshdr6.len = htonl ( tcp_len );
+		pshdr6.next_header = IP_TCP;
+		csum = tcpip_continue_chksum ( csum, &pshdr6,
+					       sizeof ( pshdr6 ) );
+	}
+	tcphdr->csum = ( seg->corrupt ? ( csum ^ 0x1234 ) : csum );
+
+	return iobuf;
+}
+
+/**
+ * Check coalesced segment
+ *
+ * @v iobuf		I/O buffer
+ * @v net_proto		Network-layer protocol
+ * @v file		Test code file
+ * @v line		Test code line
+ * @ret len		Length of data payload
+ */
+static size_t tcpgro_check ( struct io_buffer *iobuf, uint16_t net_proto,
+			     const char *file, unsigned int line ) {
+	struct ethhdr *ethhdr = iobuf->data;
+	struct iphdr *iphdr;
+	struct ipv6_header *ip6hdr;
+	struct tcp_header *tcphdr;
+	uint8_t *payload;
+	uint32_t seq;
+	size_t len;
+	size_t i;
+
+	/* Check network-layer header */
+	okx ( ethhdr->h_protocol == htons ( net_proto ), file, line );
+	if ( net_proto == ETH_P_IP ) {
+		iphdr = ( ( void * ) ( ethhdr + 1 ) );
+		okx ( tcpip_chksum ( iphdr, sizeof ( *iphdr ) ) == 0,
+		      file, line );
+		okx ( ( sizeof ( *ethhdr ) + ntohs ( iphdr->len ) ) ==
+		      iob_len ( iobuf ), file, line );
+		tcphdr = ( ( void * ) ( iphdr + 1 ) );
+	} else {
+		ip6hdr = ( ( void * ) ( ethhdr + 1 ) );
+		okx ( ( sizeof ( *ethhdr ) + sizeof ( *ip6hdr ) +
+			ntohs ( ip6hdr->len ) ) == iob_len ( iobuf ),
+		      file, line );
+		tcphdr = ( ( void * ) ( ip6hdr + 1 ) );
+	}
+
+	/* Check data payload */
+	payload = ( ( void * ) ( tcphdr + 1 ) );
+	len = ( iobuf->tail - ( ( void * ) payload ) );
+	seq = ntohl ( tcphdr->seq );
+	for ( i = 0 ; i < len ; i++ ) {
+		if ( payload[i] != ( ( seq + i ) & 0xff ) )
+			break;
+	}
+	okx ( i == len, file, line );
+
+	return len;
+}
+
+/**
+ * Report TCP receive segment coalescing test result
+ *
+ * @v test		TCP receive segment coalescing test
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void tcpgro_okx ( struct tcpgro_test *test, const char *file,
+			 unsigned int line ) {
+	struct net_device *netdev;
+	struct io_buffer *iobuf;
+	struct io_buffer *tmp;
+	unsigned int count = 0;
+	size_t expected_len = 0;
+	size_t len = 0;
+	unsigned int i;
+
+	/* Construct network device with populated receive queue */
+	netdev = alloc_etherdev ( 0 );
+	okx ( netdev != NULL, file, line );
+	if ( ! netdev )
+		return;
+	for ( i = 0 ; i < test->count ; i++ ) {
+		iobuf = tcpgro_build ( test->net_proto, &test->segs[i] );
+		list_add_tail ( &iobuf->list, &netdev->rx_queue );
+		expected_len += test->segs[i].len;
+	}
+
+	/* Coalesce segments */
+	tcp_gro ( netdev );
+
+	/* Check coalesced segments */
+	list_for_each_entry_safe ( iobuf, tmp, &netdev->rx_queue, list ) {
+		len += tcpgro_check ( iobuf, test->net_proto, file, line );
+		list_del ( &iobuf->list );
+		free_iob ( iobuf );
+		count++;
+	}
+	okx ( count == test->expected, file, line );
+	okx ( len == expected_len, file, line );
+
+	netdev_nullify ( netdev );
+	netdev_put ( netdev );
+}
+#define tcpgro_ok( test ) tcpgro_okx ( test, __FILE__, __LINE__ )
+
+/**
+ * Perform TCP receive segment coalescing self-tests
+ *
+ */
+static void tcpgro_test_exec ( void ) {
+
+	tcpgro_ok ( &ipv4_consecutive );
+	tcpgro_ok ( &ipv4_gap );
+	tcpgro_ok ( &ipv4_different );
+	tcpgro_ok ( &ipv4_corrupt );
+	tcpgro_ok ( &ipv4_pushed );
+	tcpgro_ok ( &ipv4_ack_only );
+	tcpgro_ok ( &ipv4_long );
+	tcpgro_ok ( &ipv6_consecutive );
+}
+
+/** TCP receive segment coalescing self-test */
+struct self_test tcpgro_test __self_test = {
+	.name = "tcpgro",
+	.exec = tcpgro_test_exec,
+};
+
+/* Drag in TCP receive segment coalescing */
+REQUIRING_SYMBOL ( tcpgro_test );
+REQUIRE_OBJECT ( tcpgro );
@@ -123,6 +123,27 @@ TCPIP_RANDOM_TEST ( random_aligned_truncated, 0x12345678UL, 4095, 0 );
 /** Random data (unaligned start and finish) */
 TCPIP_RANDOM_TEST ( partial, 0xcafebabe, 121, 5 );
 
+/** Random data (short packet, aligned) */
+TCPIP_RANDOM_TEST ( short_aligned, 0xdeadbeef, 64, 0 );
+
+/** Random data (short packet, unaligned) */
+TCPIP_RANDOM_TEST ( short_unaligned, 0xdeadbeef, 64, 3 );
+
+/** Random data (accelerator threshold, unaligned) */
+TCPIP_RANDOM_TEST ( threshold_unaligned, 0x8badf00d, 128, 1 );
+
+/** Random data (full-sized TCP segment, aligned) */
+TCPIP_RANDOM_TEST ( segment_aligned, 0xfeedface, 1460, 0 );
+
+/** Random data (full-sized TCP segment, unaligned +2) */
+TCPIP_RANDOM_TEST ( segment_unaligned_2, 0xfeedface, 1460, 2 );
+
+/** Random data (full-sized TCP segment, unaligned +6) */
+TCPIP_RANDOM_TEST ( segment_unaligned_6, 0xfeedface, 1460, 6 );
+
+/** Random data (odd-length TCP segment, unaligned +7) */
+TCPIP_RANDOM_TEST ( segment_odd, 0xfeedface, 1459, 7 );
+
 /**
  * Calculate TCP/IP checksum
  *
@@ -195,6 +216,7 @@ static void tcpip_okx ( struct tcpip_test *test, const char *file,
 static void tcpip_random_okx ( struct tcpip_random_test *test,
 			       const char *file, unsigned int line ) {
 	uint8_t *data = ( tcpip_data + test->offset );
+	struct tcpip_chksum_accelerator *accel;
 	struct profiler profiler;
 	uint16_t expected;
 	uint16_t generic_sum;
@@ -230,6 +252,37 @@ static void tcpip_random_okx ( struct tcpip_random_test *test,
 	DBG ( "TCPIP checksummed %zd bytes (+%zd) in %ld +/- %ld ticks\n",
 	      test->len, test->offset, profile_mean ( &profiler ),
 	      profile_stddev ( &profiler ) );
+
+	/* Verify and profile each supported accelerated implementation */
+	for_each_table_entry ( accel, TCPIP_CHKSUM_ACCELERATORS ) {
+		if ( ! accel->supported() )
+			continue;
+		sum = accel->chksum ( TCPIP_EMPTY_CSUM, data, test->len );
+		okx ( sum == expected, file, line );
+		memset ( &profiler, 0, sizeof ( profiler ) );
+		for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
+			profile_start ( &profiler );
+			sum = accel->chksum ( TCPIP_EMPTY_CSUM, data,
+					      test->len );
+			profile_stop ( &profiler );
+		}
+		DBG ( "TCPIP %s checksummed %zd bytes (+%zd) in %ld +/- %ld "
+		      "ticks\n", accel->name, test->len, test->offset,
+		      profile_mean ( &profiler ),
+		      profile_stddev ( &profiler ) );
+	}
+
+	/* Profile generic calculation */
+	memset ( &profiler, 0, sizeof ( profiler ) );
+	for ( i = 0 ; i < PROFILE_COUNT ; i++ ) {
+		profile_start ( &profiler );
+		sum = generic_tcpip_continue_chksum ( TCPIP_EMPTY_CSUM, data,
+						      test->len );
+		profile_stop ( &profiler );
+	}
+	DBG ( "TCPIP generic checksummed %zd bytes (+%zd) in %ld +/- %ld "
+	      "ticks\n", test->len, test->offset, profile_mean ( &profiler ),
+	      profile_stddev ( &profiler ) );
 }
 #define tcpip_random_ok( test ) tcpip_random_okx ( test, __FILE__, __LINE__ )
 
@@ -251,6 +304,13 @@ static void tcpip_test_exec ( void ) {
 	tcpip_random_ok ( &random_unaligned_2 );
 	tcpip_random_ok ( &random_aligned_truncated );
 	tcpip_random_ok ( &partial );
+	tcpip_random_ok ( &short_aligned );
+	tcpip_random_ok ( &short_unaligned );
+	tcpip_random_ok ( &threshold_unaligned );
+	tcpip_random_ok ( &segment_aligned );
+	tcpip_random_ok ( &segment_unaligned_2 );
+	tcpip_random_ok ( &segment_unaligned_6 );
+	tcpip_random_ok ( &segment_odd );
 }
 
 /** TCP/IP self-test */
@@ -37,20 +37,24 @@ REQUIRE_OBJECT ( string_test );
 REQUIRE_OBJECT ( math_test );
 REQUIRE_OBJECT ( vsprintf_test );
 REQUIRE_OBJECT ( list_test );
+REQUIRE_OBJECT ( process_test );
 REQUIRE_OBJECT ( byteswap_test );
 REQUIRE_OBJECT ( base64_test );
 REQUIRE_OBJECT ( base16_test );
 REQUIRE_OBJECT ( settings_test );
 REQUIRE_OBJECT ( time_test );
 REQUIRE_OBJECT ( tcpip_test );
+REQUIRE_OBJECT ( tcpgro_test );
 REQUIRE_OBJECT ( ipv4_test );
 REQUIRE_OBJECT ( ipv6_test );
 REQUIRE_OBJECT ( crc32_test );
+REQUIRE_OBJECT ( crc32c_test );
 REQUIRE_OBJECT ( md5_test );
 REQUIRE_OBJECT ( sha1_test );
 REQUIRE_OBJECT ( sha256_test );
 REQUIRE_OBJECT ( sha512_test );
 REQUIRE_OBJECT ( aes_test );
+REQUIRE_OBJECT ( gcm_test );
 REQUIRE_OBJECT ( hmac_drbg_test );
 REQUIRE_OBJECT ( hash_df_test );
 REQUIRE_OBJECT ( bigint_test );
@@ -61,13 +65,26 @@ REQUIRE_OBJECT ( cms_test );
 REQUIRE_OBJECT ( pnm_test );
 REQUIRE_OBJECT ( deflate_test );
 REQUIRE_OBJECT ( png_test );
+REQUIRE_OBJECT ( zlib_test );
+REQUIRE_OBJECT ( efi_pe_test );
+REQUIRE_OBJECT ( gzip_test );
+REQUIRE_OBJECT ( httpgzip_test );
+REQUIRE_OBJECT ( fec_test );
 REQUIRE_OBJECT ( dns_test );
 REQUIRE_OBJECT ( uri_test );
 REQUIRE_OBJECT ( profile_test );
 REQUIRE_OBJECT ( setjmp_test );
 REQUIRE_OBJECT ( pccrc_test );
+REQUIRE_OBJECT ( pccrd_test );
 REQUIRE_OBJECT ( linebuf_test );
 REQUIRE_OBJECT ( iobuf_test );
 REQUIRE_OBJECT ( bitops_test );
 REQUIRE_OBJECT ( der_test );
 REQUIRE_OBJECT ( pem_test );
+REQUIRE_OBJECT ( hpack_test );
+REQUIRE_OBJECT ( fragment_test );
+REQUIRE_OBJECT ( x25519_test );
+REQUIRE_OBJECT ( hkdf_test );
+REQUIRE_OBJECT ( pbkdf2_test );
+REQUIRE_OBJECT ( handover_test );
+REQUIRE_OBJECT ( timeline_test );
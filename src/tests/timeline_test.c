@@ -0,0 +1,147 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+/** @file
+ *
+ * Boot timeline self-tests
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <ipxe/timeline.h>
+#include <ipxe/test.h>
+
+/**
+ * Report timeline event test result
+ *
+ * @v index		Event index
+ * @v phase		Expected phase
+ * @v event		Expected event
+ * @v detail		Expected detail
+ * @v rc		Expected status code
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void timeline_event_okx ( unsigned int index, const char *phase,
+				 const char *event, const char *detail,
+				 int rc, const char *file, unsigned int line ) {
+	const struct timeline_event *entry;
+	char expected[ 64 + TIMELINE_DETAIL_LEN ];
+	char buf[ 64 + TIMELINE_DETAIL_LEN ];
+	int len;
+
+	/* Check recorded event */
+	entry = timeline_get ( index );
+	okx ( entry != NULL, file, line );
+	if ( ! entry )
+		return;
+	okx ( strcmp ( entry->phase, phase ) == 0, file, line );
+	okx ( strcmp ( entry->event, event ) == 0, file, line );
+	okx ( strcmp ( entry->detail, detail ) == 0, file, line );
+	okx ( entry->rc == rc, file, line );
+
+	/* Check formatted event (ignoring the timestamp) */
+	snprintf ( expected, sizeof ( expected ),
+		   " phase=%s event=%s detail=%s rc=%08x", phase, event,
+		   ( detail[0] ? detail : "-" ), -rc );
+	len = timeline_format ( index, NULL, 0 );
+	okx ( len > 0, file, line );
+	okx ( len < ( int ) sizeof ( buf ), file, line );
+	okx ( timeline_format ( index, buf, sizeof ( buf ) ) == len,
+	      file, line );
+	okx ( strncmp ( buf, "t=", 2 ) == 0, file, line );
+	okx ( strcmp ( ( buf + len - strlen ( expected ) ), expected ) == 0,
+	      file, line );
+}
+#define timeline_event_ok( index, phase, event, detail, rc )		\
+	timeline_event_okx ( index, phase, event, detail, rc,		\
+			     __FILE__, __LINE__ )
+
+/**
+ * Perform boot timeline self-tests
+ *
+ */
+static void timeline_test_exec ( void ) {
+	static const char *labels[] = { "0", "1", "2", "3", "4", "5", "6",
+					"7", "8", "9" };
+	char long_detail[ TIMELINE_DETAIL_LEN + 8 ];
+	char truncated[ TIMELINE_DETAIL_LEN ];
+	unsigned int count;
+	unsigned int last;
+	unsigned int i;
+
+	/* Record a single event */
+	count = timeline_count();
+	timeline_record ( "test", "simple", "net0", 0 );
+	if ( count < TIMELINE_MAX_EVENTS )
+		count++;
+	ok ( timeline_count() == count );
+	timeline_event_ok ( ( count - 1 ), "test", "simple", "net0", 0 );
+
+	/* Record an event with an error and no detail */
+	timeline_record ( "test", "fail", NULL, -ENOENT );
+	if ( count < TIMELINE_MAX_EVENTS )
+		count++;
+	ok ( timeline_count() == count );
+	timeline_event_ok ( ( count - 1 ), "test", "fail", "", -ENOENT );
+
+	/* Record an event with an overlength detail */
+	memset ( long_detail, 'x', ( sizeof ( long_detail ) - 1 ) );
+	long_detail[ sizeof ( long_detail ) - 1 ] = '\0';
+	memset ( truncated, 'x', ( sizeof ( truncated ) - 1 ) );
+	truncated[ sizeof ( truncated ) - 1 ] = '\0';
+	timeline_record ( "test", "long", long_detail, 0 );
+	if ( count < TIMELINE_MAX_EVENTS )
+		count++;
+	ok ( timeline_count() == count );
+	timeline_event_ok ( ( count - 1 ), "test", "long", truncated, 0 );
+
+	/* Overflow the ring buffer */
+	for ( i = 0 ; i < ( TIMELINE_MAX_EVENTS + 3 ) ; i++ ) {
+		timeline_record ( "test", "wrap",
+				  labels[ i % ( sizeof ( labels ) /
+						sizeof ( labels[0] ) ) ], 0 );
+	}
+	ok ( timeline_count() == TIMELINE_MAX_EVENTS );
+	last = ( TIMELINE_MAX_EVENTS - 1 );
+	timeline_event_ok ( 0, "test", "wrap", "3", 0 );
+	timeline_event_ok ( last, "test", "wrap",
+			    labels[ ( TIMELINE_MAX_EVENTS + 2 ) %
+				    ( sizeof ( labels ) /
+				      sizeof ( labels[0] ) ) ], 0 );
+
+	/* Check nonexistent events */
+	ok ( timeline_get ( TIMELINE_MAX_EVENTS ) == NULL );
+	ok ( timeline_format ( TIMELINE_MAX_EVENTS, NULL, 0 ) < 0 );
+}
+
+/** Boot timeline self-test */
+struct self_test timeline_test __self_test = {
+	.name = "timeline",
+	.exec = timeline_test_exec,
+};
@@ -0,0 +1,270 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+/** @file
+ *
+ * X25519 key exchange tests
+ *
+ * Test vectors are taken from RFC 7748.
+ *
+ */
+
+/* Forcibly enable assertions */
+#undef NDEBUG
+
+#include <stdint.h>
+#include <string.h>
+#include <ipxe/x25519.h>
+#include <ipxe/test.h>
+
+/** Define inline base point */
+#define BASE(...) { __VA_ARGS__ }
+
+/** Define inline scalar multiple */
+#define SCALAR(...) { __VA_ARGS__ }
+
+/** Define inline expected result */
+#define EXPECTED(...) { __VA_ARGS__ }
+
+/** An X25519 multiplication test */
+struct x25519_multiply_test {
+	/** Base point (or NULL to use generator) */
+	const struct x25519_value *base;
+	/** Scalar multiple */
+	struct x25519_value scalar;
+	/** Expected result */
+	struct x25519_value expected;
+};
+
+/**
+ * Define an X25519 multiplication test
+ *
+ * @v name		Test name
+ * @v BASE		Base point
+ * @v SCALAR		Scalar multiple
+ * @v EXPECTED		Expected result
+ * @ret test		X25519 multiplication test
+ */
+#define X25519_MULTIPLY_TEST( name, BASE, SCALAR, EXPECTED )		\
+	static const struct x25519_value name ## _base = {		\
+		.raw = BASE,						\
+	};								\
+	static struct x25519_multiply_test name = {			\
+		.base = &name ## _base,					\
+		.scalar = { .raw = SCALAR },				\
+		.expected = { .raw = EXPECTED },			\
+	}
+
+/**
+ * Define an X25519 multiplication test using the generator
+ *
+ * @v name		Test name
+ * @v SCALAR		Scalar multiple
+ * @v EXPECTED		Expected result
+ * @ret test		X25519 multiplication test
+ */
+#define X25519_GENERATOR_TEST( name, SCALAR, EXPECTED )			\
+	static struct x25519_multiply_test name = {			\
+		.base = NULL,						\
+		.scalar = { .raw = SCALAR },				\
+		.expected = { .raw = EXPECTED },			\
+	}
+
+/** RFC 7748 section 5.2 test vector 1 */
+X25519_MULTIPLY_TEST ( rfc7748_1,
+	BASE ( 0xe6, 0xdb, 0x68, 0x67, 0x58, 0x30, 0x30, 0xdb,
+	       0x35, 0x94, 0xc1, 0xa4, 0x24, 0xb1, 0x5f, 0x7c,
+	       0x72, 0x66, 0x24, 0xec, 0x26, 0xb3, 0x35, 0x3b,
+	       0x10, 0xa9, 0x03, 0xa6, 0xd0, 0xab, 0x1c, 0x4c ),
+	SCALAR ( 0xa5, 0x46, 0xe3, 0x6b, 0xf0, 0x52, 0x7c, 0x9d,
+		 0x3b, 0x16, 0x15, 0x4b, 0x82, 0x46, 0x5e, 0xdd,
+		 0x62, 0x14, 0x4c, 0x0a, 0xc1, 0xfc, 0x5a, 0x18,
+		 0x50, 0x6a, 0x22, 0x44, 0xba, 0x44, 0x9a, 0xc4 ),
+	EXPECTED ( 0xc3, 0xda, 0x55, 0x37, 0x9d, 0xe9, 0xc6, 0x90,
+		   0x8e, 0x94, 0xea, 0x4d, 0xf2, 0x8d, 0x08, 0x4f,
+		   0x32, 0xec, 0xcf, 0x03, 0x49, 0x1c, 0x71, 0xf7,
+		   0x54, 0xb4, 0x07, 0x55, 0x77, 0xa2, 0x85, 0x52 ) );
+
+/** RFC 7748 section 5.2 test vector 2 */
+X25519_MULTIPLY_TEST ( rfc7748_2,
+	BASE ( 0xe5, 0x21, 0x0f, 0x12, 0x78, 0x68, 0x11, 0xd3,
+	       0xf4, 0xb7, 0x95, 0x9d, 0x05, 0x38, 0xae, 0x2c,
+	       0x31, 0xdb, 0xe7, 0x10, 0x6f, 0xc0, 0x3c, 0x3e,
+	       0xfc, 0x4c, 0xd5, 0x49, 0xc7, 0x15, 0xa4, 0x93 ),
+	SCALAR ( 0x4b, 0x66, 0xe9, 0xd4, 0xd1, 0xb4, 0x67, 0x3c,
+		 0x5a, 0xd2, 0x26, 0x91, 0x95, 0x7d, 0x6a, 0xf5,
+		 0xc1, 0x1b, 0x64, 0x21, 0xe0, 0xea, 0x01, 0xd4,
+		 0x2c, 0xa4, 0x16, 0x9e, 0x79, 0x18, 0xba, 0x0d ),
+	EXPECTED ( 0x95, 0xcb, 0xde, 0x94, 0x76, 0xe8, 0x90, 0x7d,
+		   0x7a, 0xad, 0xe4, 0x5c, 0xb4, 0xb8, 0x73, 0xf8,
+		   0x8b, 0x59, 0x5a, 0x68, 0x79, 0x9f, 0xa1, 0x52,
+		   0xe6, 0xf8, 0xf7, 0x64, 0x7a, 0xac, 0x79, 0x57 ) );
+
+/** RFC 7748 section 6.1 Alice's public key */
+X25519_GENERATOR_TEST ( alice_public,
+	SCALAR ( 0x77, 0x07, 0x6d, 0x0a, 0x73, 0x18, 0xa5, 0x7d,
+		 0x3c, 0x16, 0xc1, 0x72, 0x51, 0xb2, 0x66, 0x45,
+		 0xdf, 0x4c, 0x2f, 0x87, 0xeb, 0xc0, 0x99, 0x2a,
+		 0xb1, 0x77, 0xfb, 0xa5, 0x1d, 0xb9, 0x2c, 0x2a ),
+	EXPECTED ( 0x85, 0x20, 0xf0, 0x09, 0x89, 0x30, 0xa7, 0x54,
+		   0x74, 0x8b, 0x7d, 0xdc, 0xb4, 0x3e, 0xf7, 0x5a,
+		   0x0d, 0xbf, 0x3a, 0x0d, 0x26, 0x38, 0x1a, 0xf4,
+		   0xeb, 0xa4, 0xa9, 0x8e, 0xaa, 0x9b, 0x4e, 0x6a ) );
+
+/** RFC 7748 section 6.1 Bob's public key */
+X25519_GENERATOR_TEST ( bob_public,
+	SCALAR ( 0x5d, 0xab, 0x08, 0x7e, 0x62, 0x4a, 0x8a, 0x4b,
+		 0x79, 0xe1, 0x7f, 0x8b, 0x83, 0x80, 0x0e, 0xe6,
+		 0x6f, 0x3b, 0xb1, 0x29, 0x26, 0x18, 0xb6, 0xfd,
+		 0x1c, 0x2f, 0x8b, 0x27, 0xff, 0x88, 0xe0, 0xeb ),
+	EXPECTED ( 0xde, 0x9e, 0xdb, 0x7d, 0x7b, 0x7d, 0xc1, 0xb4,
+		   0xd3, 0x5b, 0x61, 0xc2, 0xec, 0xe4, 0x35, 0x37,
+		   0x3f, 0x83, 0x43, 0xc8, 0x5b, 0x78, 0x67, 0x4d,
+		   0xad, 0xfc, 0x7e, 0x14, 0x6f, 0x88, 0x2b, 0x4f ) );
+
+/** RFC 7748 section 6.1 shared secret (Alice) */
+X25519_MULTIPLY_TEST ( alice_shared,
+	BASE ( 0xde, 0x9e, 0xdb, 0x7d, 0x7b, 0x7d, 0xc1, 0xb4,
+	       0xd3, 0x5b, 0x61, 0xc2, 0xec, 0xe4, 0x35, 0x37,
+	       0x3f, 0x83, 0x43, 0xc8, 0x5b, 0x78, 0x67, 0x4d,
+	       0xad, 0xfc, 0x7e, 0x14, 0x6f, 0x88, 0x2b, 0x4f ),
+	SCALAR ( 0x77, 0x07, 0x6d, 0x0a, 0x73, 0x18, 0xa5, 0x7d,
+		 0x3c, 0x16, 0xc1, 0x72, 0x51, 0xb2, 0x66, 0x45,
+		 0xdf, 0x4c, 0x2f, 0x87, 0xeb, 0xc0, 0x99, 0x2a,
+		 0xb1, 0x77, 0xfb, 0xa5, 0x1d, 0xb9, 0x2c, 0x2a ),
+	EXPECTED ( 0x4a, 0x5d, 0x9d, 0x5b, 0xa4, 0xce, 0x2d, 0xe1,
+		   0x72, 0x8e, 0x3b, 0xf4, 0x80, 0x35, 0x0f, 0x25,
+		   0xe0, 0x7e, 0x21, 0xc9, 0x47, 0xd1, 0x9e, 0x33,
+		   0x76, 0xf0, 0x9b, 0x3c, 0x1e, 0x16, 0x17, 0x42 ) );
+
+/** RFC 7748 section 6.1 shared secret (Bob) */
+X25519_MULTIPLY_TEST ( bob_shared,
+	BASE ( 0x85, 0x20, 0xf0, 0x09, 0x89, 0x30, 0xa7, 0x54,
+	       0x74, 0x8b, 0x7d, 0xdc, 0xb4, 0x3e, 0xf7, 0x5a,
+	       0x0d, 0xbf, 0x3a, 0x0d, 0x26, 0x38, 0x1a, 0xf4,
+	       0xeb, 0xa4, 0xa9, 0x8e, 0xaa, 0x9b, 0x4e, 0x6a ),
+	SCALAR ( 0x5d, 0xab, 0x08, 0x7e, 0x62, 0x4a, 0x8a, 0x4b,
+		 0x79, 0xe1, 0x7f, 0x8b, 0x83, 0x80, 0x0e, 0xe6,
+		 0x6f, 0x3b, 0xb1, 0x29, 0x26, 0x18, 0xb6, 0xfd,
+		 0x1c, 0x2f, 0x8b, 0x27, 0xff, 0x88, 0xe0, 0xeb ),
+	EXPECTED ( 0x4a, 0x5d, 0x9d, 0x5b, 0xa4, 0xce, 0x2d, 0xe1,
+		   0x72, 0x8e, 0x3b, 0xf4, 0x80, 0x35, 0x0f, 0x25,
+		   0xe0, 0x7e, 0x21, 0xc9, 0x47, 0xd1, 0x9e, 0x33,
+		   0x76, 0xf0, 0x9b, 0x3c, 0x1e, 0x16, 0x17, 0x42 ) );
+
+/**
+ * Report an X25519 multiplication test result
+ *
+ * @v test		X25519 multiplication test
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void x25519_multiply_okx ( struct x25519_multiply_test *test,
+				  const char *file, unsigned int line ) {
+	struct x25519_value result;
+
+	okx ( elliptic_multiply ( &x25519_curve, test->base, &test->scalar,
+				  &result ) == 0, file, line );
+	okx ( memcmp ( &result, &test->expected, sizeof ( result ) ) == 0,
+	      file, line );
+}
+#define x25519_multiply_ok( test ) \
+	x25519_multiply_okx ( test, __FILE__, __LINE__ )
+
+/**
+ * Report an X25519 iterated multiplication test result
+ *
+ * @v count		Number of iterations
+ * @v expected		Expected result
+ * @v file		Test code file
+ * @v line		Test code line
+ *
+ * This is the iterated test described in RFC 7748 section 5.2, in
+ * which both the scalar and the base point start as the generator.
+ */
+static void x25519_iterate_okx ( unsigned int count,
+				 const struct x25519_value *expected,
+				 const char *file, unsigned int line ) {
+	struct x25519_value scalar = { .raw = { 9 } };
+	struct x25519_value base = { .raw = { 9 } };
+	struct x25519_value result;
+	unsigned int i;
+	int rc = 0;
+
+	for ( i = 0 ; i < count ; i++ ) {
+		rc |= x25519_key ( &base, &scalar, &result );
+		memcpy ( &base, &scalar, sizeof ( base ) );
+		memcpy ( &scalar, &result, sizeof ( scalar ) );
+	}
+	okx ( rc == 0, file, line );
+	okx ( memcmp ( &scalar, expected, sizeof ( scalar ) ) == 0,
+	      file, line );
+}
+#define x25519_iterate_ok( count, expected ) \
+	x25519_iterate_okx ( count, expected, __FILE__, __LINE__ )
+
+/** Result after one iteration */
+static const struct x25519_value x25519_iterate_1 = {
+	.raw = { 0x42, 0x2c, 0x8e, 0x7a, 0x62, 0x27, 0xd7, 0xbc,
+		   0xa1, 0x35, 0x0b, 0x3e, 0x2b, 0xb7, 0x27, 0x9f,
+		   0x78, 0x97, 0xb8, 0x7b, 0xb6, 0x85, 0x4b, 0x78,
+		   0x3c, 0x60, 0xe8, 0x03, 0x11, 0xae, 0x30, 0x79 },
+};
+
+/** Result after 1000 iterations */
+static const struct x25519_value x25519_iterate_1000 = {
+	.raw = { 0x68, 0x4c, 0xf5, 0x9b, 0xa8, 0x33, 0x09, 0x55,
+		   0x28, 0x00, 0xef, 0x56, 0x6f, 0x2f, 0x4d, 0x3c,
+		   0x1c, 0x38, 0x87, 0xc4, 0x93, 0x60, 0xe3, 0x87,
+		   0x5f, 0x2e, 0xb9, 0x4d, 0x99, 0x53, 0x2c, 0x51 },
+};
+
+/**
+ * Perform X25519 self-tests
+ *
+ */
+static void x25519_test_exec ( void ) {
+	static const struct x25519_value zero;
+	struct x25519_value scalar = { .raw = { 9 } };
+	struct x25519_value result;
+
+	/* Multiplication tests */
+	x25519_multiply_ok ( &rfc7748_1 );
+	x25519_multiply_ok ( &rfc7748_2 );
+	x25519_multiply_ok ( &alice_public );
+	x25519_multiply_ok ( &bob_public );
+	x25519_multiply_ok ( &alice_shared );
+	x25519_multiply_ok ( &bob_shared );
+
+	/* Iterated tests */
+	x25519_iterate_ok ( 1, &x25519_iterate_1 );
+	x25519_iterate_ok ( 1000, &x25519_iterate_1000 );
+
+	/* Small-order base point must be rejected */
+	ok ( x25519_key ( &zero, &scalar, &result ) != 0 );
+}
+
+/** X25519 self-test */
+struct self_test x25519_test __self_test = {
+	.name = "x25519",
+	.exec = x25519_test_exec,
+};
@@ -972,6 +972,32 @@ static void x509_validate_chain_fail_okx ( struct x509_test_chain *chn,
 	x509_validate_chain_fail_okx ( chn, time, store, root,		\
 				       __FILE__, __LINE__ )
 
+/**
+ * Report cached certificate chain revalidation test result
+ *
+ * @v chn		Test certificate chain
+ * @v time		Test certificate validation time
+ * @v store		Test certificate store
+ * @v root		Test root certificate list
+ * @v expected		Expected validation result
+ * @v file		Test code file
+ * @v line		Test code line
+ */
+static void x509_revalidate_chain_okx ( struct x509_test_chain *chn,
+					time_t time, struct x509_chain *store,
+					struct x509_root *root, int expected,
+					const char *file, unsigned int line ) {
+
+	okx ( ( x509_validate_chain ( chn->chain, time, store,
+				      root ) == 0 ) == expected, file, line );
+}
+#define x509_revalidate_chain_ok( chn, time, store, root )		\
+	x509_revalidate_chain_okx ( chn, time, store, root, 1,		\
+				    __FILE__, __LINE__ )
+#define x509_revalidate_chain_fail_ok( chn, time, store, root )	\
+	x509_revalidate_chain_okx ( chn, time, store, root, 0,		\
+				    __FILE__, __LINE__ )
+
 /**
  * Perform X.509 self-tests
  *
@@ -1081,6 +1107,16 @@ static void x509_test_exec ( void ) {
 	x509_validate_chain_fail_ok ( &useless_chain, test_ca_expired,
 				      &empty_store, &test_root );
 
+	/* Check that cached validation results expire */
+	x509_validate_chain_ok ( &server_chain, test_time,
+				 &empty_store, &test_root );
+	x509_revalidate_chain_ok ( &server_chain, test_time,
+				   &empty_store, &test_root );
+	x509_revalidate_chain_fail_ok ( &server_chain, test_expired,
+					&empty_store, &test_root );
+	x509_revalidate_chain_ok ( &server_chain, test_time,
+				   &empty_store, &test_root );
+
 	/* Sanity check */
 	assert ( list_empty ( &empty_store.links ) );
 
@@ -68,6 +68,13 @@ static int ( * is_autoboot_device ) ( struct net_device *netdev );
 #define EINFO_ENOENT_BOOT \
 	__einfo_uniqify ( EINFO_ENOENT, 0x01, "Nothing to boot" )
 
+/** Configure all candidate network devices concurrently */
+#ifdef AUTOBOOT_PARALLEL
+#define AUTOBOOT_PARALLEL_ENABLED 1
+#else
+#define AUTOBOOT_PARALLEL_ENABLED 0
+#endif
+
 #define NORMAL	"\033[0m"
 #define BOLD	"\033[1m"
 #define CYAN	"\033[36m"
@@ -109,7 +116,8 @@ const struct setting skip_san_boot_setting __setting ( SETTING_SANBOOT_EXTRA,
  * Boot from filename and root-path URIs
  *
  * @v filename		Filename
- * @v root_path		Root path
+ * @v root_paths	Root path(s)
+ * @v root_path_count	Number of root paths
  * @v drive		SAN drive (if applicable)
  * @v flags		Boot action flags
  * @ret rc		Return status code
@@ -120,14 +128,14 @@ const struct setting skip_san_boot_setting __setting ( SETTING_SANBOOT_EXTRA,
  * provide backwards compatibility for the "keep-san" and
  * "skip-san-boot" options.
  */
-int uriboot ( struct uri *filename, struct uri *root_path, int drive,
-	      unsigned int flags ) {
+int uriboot ( struct uri *filename, struct uri **root_paths,
+	      unsigned int root_path_count, int drive, unsigned int flags ) {
 	struct image *image;
 	int rc;
 
 	/* Hook SAN device, if applicable */
-	if ( root_path ) {
-		drive = san_hook ( root_path, drive );
+	if ( root_path_count ) {
+		drive = san_hook ( root_paths, root_path_count, drive );
 		if ( drive < 0 ) {
 			rc = drive;
 			printf ( "Could not open SAN device: %s\n",
@@ -151,7 +159,7 @@ int uriboot ( struct uri *filename, struct uri *root_path, int drive,
 
 	/* Attempt filename boot if applicable */
 	if ( filename ) {
-		if ( ( rc = imgdownload ( filename, 0, &image ) ) != 0 )
+		if ( ( rc = imgdownload ( filename, 0, NULL, &image ) ) != 0 )
 			goto err_download;
 		imgstat ( image );
 		image->flags |= IMAGE_AUTO_UNREGISTER;
@@ -340,27 +348,17 @@ static int have_pxe_menu ( void ) {
 }
 
 /**
- * Boot from a network device
+ * Boot from a configured network device
  *
  * @v netdev		Network device
  * @ret rc		Return status code
  */
-int netboot ( struct net_device *netdev ) {
+static int netboot_configured ( struct net_device *netdev ) {
 	struct uri *filename;
 	struct uri *root_path;
 	int rc;
 
-	/* Close all other network devices */
-	close_all_netdevs();
-
-	/* Open device and display device status */
-	if ( ( rc = ifopen ( netdev ) ) != 0 )
-		goto err_ifopen;
-	ifstat ( netdev );
-
-	/* Configure device */
-	if ( ( rc = ifconf ( netdev, NULL ) ) != 0 )
-		goto err_dhcp;
+	/* Display routing table */
 	route();
 
 	/* Try PXE menu boot, if applicable */
@@ -396,7 +394,8 @@ int netboot ( struct net_device *netdev ) {
 	}
 
 	/* Boot using next server, filename and root path */
-	if ( ( rc = uriboot ( filename, root_path, san_default_drive(),
+	if ( ( rc = uriboot ( filename, &root_path, ( root_path ? 1 : 0 ),
+			      san_default_drive(),
 			      ( root_path ? 0 : URIBOOT_NO_SAN ) ) ) != 0 )
 		goto err_uriboot;
 
@@ -405,11 +404,88 @@ int netboot ( struct net_device *netdev ) {
 	uri_put ( root_path );
 	uri_put ( filename );
  err_pxe_menu_boot:
- err_dhcp:
- err_ifopen:
 	return rc;
 }
 
+/**
+ * Boot from a network device
+ *
+ * @v netdev		Network device
+ * @ret rc		Return status code
+ */
+int netboot ( struct net_device *netdev ) {
+	int rc;
+
+	/* Close all other network devices */
+	close_all_netdevs();
+
+	/* Open device and display device status */
+	if ( ( rc = ifopen ( netdev ) ) != 0 )
+		return rc;
+	ifstat ( netdev );
+
+	/* Configure device */
+	if ( ( rc = ifconf ( netdev, NULL ) ) != 0 )
+		return rc;
+
+	return netboot_configured ( netdev );
+}
+
+/**
+ * Check if a configured network device has something to boot
+ *
+ * @v netdev		Network device
+ * @ret is_usable	Network device has something to boot
+ */
+static int is_netboot_usable ( struct net_device *netdev ) {
+	struct settings *settings = netdev_settings ( netdev );
+
+	return ( setting_exists ( settings, &filename_setting ) ||
+		 setting_exists ( settings, &root_path_setting ) );
+}
+
+/**
+ * Boot from the first of several network devices to be configured
+ *
+ * @ret rc		Return status code
+ *
+ * All candidate network devices are opened and configured
+ * concurrently, and the first to obtain something bootable is used.
+ */
+static int netboot_parallel ( void ) {
+	struct net_device *netdev;
+	struct net_device *usable;
+	int rc;
+
+	/* Close all network devices */
+	close_all_netdevs();
+
+	/* Open all candidate devices and display device status */
+	for_each_netdev ( netdev ) {
+		if ( is_autoboot_device && ( ! is_autoboot_device ( netdev ) ) )
+			continue;
+		if ( ifopen ( netdev ) == 0 )
+			ifstat ( netdev );
+	}
+
+	/* Configure devices until one has something to boot */
+	usable = ifconf_parallel ( is_netboot_usable );
+	if ( ! usable ) {
+		rc = -ENOENT_BOOT;
+		printf ( "Nothing to boot: %s\n", strerror ( rc ) );
+		return rc;
+	}
+	printf ( "Booting from %s\n", usable->name );
+
+	/* Close all other network devices */
+	for_each_netdev ( netdev ) {
+		if ( netdev != usable )
+			ifclose ( netdev );
+	}
+
+	return netboot_configured ( usable );
+}
+
 /**
  * Test if network device matches the autoboot device bus type and location
  *
@@ -479,6 +555,15 @@ static int autoboot ( void ) {
 	struct net_device *netdev;
 	int rc = -ENODEV;
 
+	/* Try booting from all network devices concurrently, if
+	 * applicable.
+	 */
+	if ( AUTOBOOT_PARALLEL_ENABLED ) {
+		rc = netboot_parallel();
+		printf ( "No more network devices\n" );
+		return rc;
+	}
+
 	/* Try booting from each network device.  If we have a
 	 * specified autoboot device location, then use only devices
 	 * matching that location.
@@ -0,0 +1,88 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <ipxe/uri.h>
+#include <ipxe/monojob.h>
+#include <ipxe/diskwrite.h>
+#include <usr/diskwrite.h>
+
+/** @file
+ *
+ * Local disk writing
+ *
+ */
+
+/**
+ * Download a file directly to a local disk
+ *
+ * @v disk		Disk name
+ * @v uri		URI to download
+ * @v timeout		Download timeout
+ * @ret rc		Return status code
+ */
+int diskwrite ( const char *disk, struct uri *uri, unsigned long timeout ) {
+	const char *password;
+	char *uri_string_redacted;
+	int rc;
+
+	/* Construct redacted URI */
+	password = uri->password;
+	if ( password )
+		uri->password = "***";
+	uri_string_redacted = format_uri_alloc ( uri );
+	uri->password = password;
+	if ( ! uri_string_redacted ) {
+		rc = -ENOMEM;
+		goto err_uri_string;
+	}
+
+	/* Resolve URI */
+	uri = resolve_uri ( cwuri, uri );
+	if ( ! uri ) {
+		rc = -ENOMEM;
+		goto err_resolve_uri;
+	}
+
+	/* Create disk writer */
+	if ( ( rc = create_disk_writer ( &monojob, disk, uri ) ) != 0 ) {
+		printf ( "Could not start writing to %s: %s\n",
+			 disk, strerror ( rc ) );
+		goto err_create;
+	}
+
+	/* Wait for write to complete */
+	if ( ( rc = monojob_wait ( uri_string_redacted, timeout ) ) != 0 )
+		goto err_monojob_wait;
+
+ err_monojob_wait:
+ err_create:
+	uri_put ( uri );
+ err_resolve_uri:
+	free ( uri_string_redacted );
+ err_uri_string:
+	return rc;
+}
@@ -0,0 +1,311 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <ipxe/refcnt.h>
+#include <ipxe/interface.h>
+#include <ipxe/xfer.h>
+#include <ipxe/iobuf.h>
+#include <ipxe/open.h>
+#include <ipxe/job.h>
+#include <ipxe/monojob.h>
+#include <ipxe/uri.h>
+#include <ipxe/timer.h>
+#include <ipxe/profile.h>
+#include <ipxe/timeline.h>
+#include <usr/httpbench.h>
+
+/** @file
+ *
+ * Download benchmarking
+ *
+ * Data is downloaded into a sink which discards it, so that the
+ * measured throughput is not limited by the cost of storing the
+ * downloaded image.  Connection setup phases are identified from the
+ * boot timeline.
+ */
+
+/** A download benchmark sink */
+struct httpbench_sink {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** Job control interface */
+	struct interface job;
+	/** Data transfer interface */
+	struct interface xfer;
+
+	/** Number of bytes received */
+	size_t len;
+	/** Time of first received data (in ticks) */
+	unsigned long first;
+	/** Timestamp of first received data (in profiling ticks) */
+	unsigned long first_cycles;
+	/** Time of completion (in ticks) */
+	unsigned long done;
+	/** Timestamp of completion (in profiling ticks) */
+	unsigned long done_cycles;
+	/** Any data has been received */
+	int started;
+};
+
+/**
+ * Close download benchmark sink
+ *
+ * @v sink		Download benchmark sink
+ * @v rc		Reason for close
+ */
+static void httpbench_close ( struct httpbench_sink *sink, int rc ) {
+
+	/* Record completion time */
+	sink->done = currticks();
+	sink->done_cycles = profile_timestamp();
+
+	/* Shut down interfaces */
+	intf_shutdown ( &sink->xfer, rc );
+	intf_shutdown ( &sink->job, rc );
+}
+
+/**
+ * Discard received data
+ *
+ * @v sink		Download benchmark sink
+ * @v iobuf		I/O buffer
+ * @v meta		Data transfer metadata
+ * @ret rc		Return status code
+ */
+static int httpbench_deliver ( struct httpbench_sink *sink,
+			       struct io_buffer *iobuf,
+			       struct xfer_metadata *meta __unused ) {
+	size_t len = iob_len ( iobuf );
+
+	/* Record time of first received data */
+	if ( len && ! sink->started ) {
+		sink->first = currticks();
+		sink->first_cycles = profile_timestamp();
+		sink->started = 1;
+	}
+
+	/* Discard data */
+	sink->len += len;
+	free_iob ( iobuf );
+
+	return 0;
+}
+
+/**
+ * Report progress of download benchmark
+ *
+ * @v sink		Download benchmark sink
+ * @v progress		Progress report to fill in
+ * @ret ongoing_rc	Ongoing job status code (if known)
+ */
+static int httpbench_progress ( struct httpbench_sink *sink,
+				struct job_progress *progress ) {
+
+	progress->completed = sink->len;
+	return 0;
+}
+
+/** Download benchmark sink data transfer interface operations */
+static struct interface_operation httpbench_xfer_op[] = {
+	INTF_OP ( xfer_deliver, struct httpbench_sink *, httpbench_deliver ),
+	INTF_OP ( intf_close, struct httpbench_sink *, httpbench_close ),
+};
+
+/** Download benchmark sink data transfer interface descriptor */
+static struct interface_descriptor httpbench_xfer_desc =
+	INTF_DESC ( struct httpbench_sink, xfer, httpbench_xfer_op );
+
+/** Download benchmark sink job control interface operations */
+static struct interface_operation httpbench_job_op[] = {
+	INTF_OP ( job_progress, struct httpbench_sink *, httpbench_progress ),
+	INTF_OP ( intf_close, struct httpbench_sink *, httpbench_close ),
+};
+
+/** Download benchmark sink job control interface descriptor */
+static struct interface_descriptor httpbench_job_desc =
+	INTF_DESC ( struct httpbench_sink, job, httpbench_job_op );
+
+/**
+ * Find timeline event
+ *
+ * @v start		Earliest permitted time (in ticks)
+ * @v phase		Phase
+ * @v event		Event within phase
+ * @v ticks		Time of event to fill in
+ * @ret found		Event was found
+ */
+static int httpbench_event ( unsigned long start, const char *phase,
+			     const char *event, unsigned long *ticks ) {
+	const struct timeline_event *entry;
+	unsigned int i;
+
+	for ( i = 0 ; ( entry = timeline_get ( i ) ) != NULL ; i++ ) {
+		if ( ( ( long ) ( entry->ticks - start ) ) < 0 )
+			continue;
+		if ( ( strcmp ( entry->phase, phase ) != 0 ) ||
+		     ( strcmp ( entry->event, event ) != 0 ) )
+			continue;
+		*ticks = entry->ticks;
+		return 1;
+	}
+	return 0;
+}
+
+/**
+ * Convert ticks to milliseconds
+ *
+ * @v ticks		Elapsed time (in ticks)
+ * @ret ms		Elapsed time (in milliseconds)
+ */
+static unsigned long httpbench_ms ( unsigned long ticks ) {
+
+	return ( ( ticks * 1000ULL ) / TICKS_PER_SEC );
+}
+
+/**
+ * Report duration of a connection setup phase
+ *
+ * @v name		Phase name
+ * @v start		Earliest permitted time (in ticks)
+ * @v phase		Timeline phase
+ * @v begin		Timeline event marking start of phase
+ * @v end		Timeline event marking end of phase
+ */
+static void httpbench_phase ( const char *name, unsigned long start,
+			      const char *phase, const char *begin,
+			      const char *end ) {
+	unsigned long begun;
+	unsigned long ended;
+
+	printf ( "  %-14s", name );
+	if ( httpbench_event ( start, phase, begin, &begun ) &&
+	     httpbench_event ( start, phase, end, &ended ) ) {
+		printf ( "%ld ms\n", httpbench_ms ( ended - begun ) );
+	} else {
+		printf ( "-\n" );
+	}
+}
+
+/**
+ * Benchmark download of a URI
+ *
+ * @v uri		URI
+ * @v timeout		Download timeout
+ * @ret rc		Return status code
+ */
+int httpbench ( struct uri *uri, unsigned long timeout ) {
+	struct httpbench_sink *sink;
+	const char *password;
+	char *uri_string_redacted;
+	unsigned long start;
+	unsigned long started;
+	unsigned long elapsed;
+	unsigned long cycles;
+	int rc;
+
+	/* Construct redacted URI */
+	password = uri->password;
+	if ( password )
+		uri->password = "***";
+	uri_string_redacted = format_uri_alloc ( uri );
+	uri->password = password;
+	if ( ! uri_string_redacted ) {
+		rc = -ENOMEM;
+		goto err_uri_string;
+	}
+
+	/* Resolve URI */
+	uri = resolve_uri ( cwuri, uri );
+	if ( ! uri ) {
+		rc = -ENOMEM;
+		goto err_resolve_uri;
+	}
+
+	/* Allocate and initialise sink */
+	sink = zalloc ( sizeof ( *sink ) );
+	if ( ! sink ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	ref_init ( &sink->refcnt, NULL );
+	intf_init ( &sink->job, &httpbench_job_desc, &sink->refcnt );
+	intf_init ( &sink->xfer, &httpbench_xfer_desc, &sink->refcnt );
+
+	/* Start download */
+	start = currticks();
+	started = profile_timestamp();
+	if ( ( rc = xfer_open_uri ( &sink->xfer, uri ) ) != 0 ) {
+		printf ( "Could not start download: %s\n", strerror ( rc ) );
+		httpbench_close ( sink, rc );
+		goto err_open;
+	}
+	intf_plug_plug ( &sink->job, &monojob );
+
+	/* Wait for download to complete */
+	if ( ( rc = monojob_wait ( uri_string_redacted, timeout ) ) != 0 )
+		goto err_monojob_wait;
+
+	/* Report connection setup phases */
+	httpbench_phase ( "TCP connect:", start, "tcp", "syn", "established" );
+	httpbench_phase ( "TLS handshake:", start, "tls", "hello",
+			  "established" );
+
+	/* Report time to first byte */
+	printf ( "  %-14s", "First byte:" );
+	if ( sink->started ) {
+		printf ( "%ld ms\n", httpbench_ms ( sink->first - start ) );
+	} else {
+		printf ( "-\n" );
+	}
+
+	/* Report steady-state throughput and cost */
+	elapsed = ( sink->done - ( sink->started ? sink->first : start ) );
+	cycles = ( sink->done_cycles -
+		   ( sink->started ? sink->first_cycles : started ) );
+	printf ( "  %-14s%zd bytes in %ld ms", "Transfer:", sink->len,
+		 httpbench_ms ( elapsed ) );
+	if ( elapsed ) {
+		printf ( " (%lld kB/s)", ( ( ( unsigned long long ) sink->len *
+					     TICKS_PER_SEC ) /
+					   ( elapsed * 1024ULL ) ) );
+	}
+	if ( sink->len ) {
+		printf ( ", %ld cycles/byte",
+			 ( ( unsigned long ) ( cycles / sink->len ) ) );
+	}
+	printf ( "\n" );
+
+ err_monojob_wait:
+ err_open:
+	ref_put ( &sink->refcnt );
+ err_alloc:
+	uri_put ( uri );
+ err_resolve_uri:
+	free ( uri_string_redacted );
+ err_uri_string:
+	return rc;
+}
@@ -121,6 +121,10 @@ void ifstat ( struct net_device *netdev ) {
 		printf ( "  [Link status: %s]\n",
 			 strerror ( netdev->link_rc ) );
 	}
+	if ( netdev->rx_stats.overflow ) {
+		printf ( "  [RX ring overflows: %d]\n",
+			 netdev->rx_stats.overflow );
+	}
 	ifstat_errors ( &netdev->tx_stats, "TXE" );
 	ifstat_errors ( &netdev->rx_stats, "RXE" );
 }
@@ -133,6 +137,13 @@ struct ifpoller {
 	struct net_device *netdev;
 	/** Network device configurator (if applicable) */
 	struct net_device_configurator *configurator;
+	/**
+	 * Check if configured network device is usable (if applicable)
+	 *
+	 * @v netdev		Network device
+	 * @ret is_usable	Network device is usable
+	 */
+	int ( * usable ) ( struct net_device *netdev );
 	/**
 	 * Check progress
 	 *
@@ -170,12 +181,14 @@ static struct interface_descriptor ifpoller_job_desc =
  *
  * @v netdev		Network device
  * @v configurator	Network device configurator (if applicable)
+ * @v usable		Method to check usability (if applicable)
  * @v timeout		Timeout period, in ticks
  * @v progress		Method to check progress
  * @ret rc		Return status code
  */
 static int ifpoller_wait ( struct net_device *netdev,
 			   struct net_device_configurator *configurator,
+			   int ( * usable ) ( struct net_device *netdev ),
 			   unsigned long timeout,
 			   int ( * progress ) ( struct ifpoller *ifpoller ) ) {
 	static struct ifpoller ifpoller = {
@@ -184,6 +197,7 @@ static int ifpoller_wait ( struct net_device *netdev,
 
 	ifpoller.netdev = netdev;
 	ifpoller.configurator = configurator;
+	ifpoller.usable = usable;
 	ifpoller.progress = progress;
 	intf_plug_plug ( &monojob, &ifpoller.job );
 	return monojob_wait ( "", timeout );
@@ -227,7 +241,8 @@ int iflinkwait ( struct net_device *netdev, unsigned long timeout ) {
 
 	/* Wait for link-up */
 	printf ( "Waiting for link-up on %s", netdev->name );
-	return ifpoller_wait ( netdev, NULL, timeout, iflinkwait_progress );
+	return ifpoller_wait ( netdev, NULL, NULL, timeout,
+			       iflinkwait_progress );
 }
 
 /**
@@ -296,5 +311,93 @@ int ifconf ( struct net_device *netdev,
 		 ( configurator ? configurator->name : "" ),
 		 ( configurator ? "] " : "" ),
 		 netdev->name, netdev->ll_protocol->ntoa ( netdev->ll_addr ) );
-	return ifpoller_wait ( netdev, configurator, 0, ifconf_progress );
+	return ifpoller_wait ( netdev, configurator, NULL, 0, ifconf_progress );
+}
+
+/**
+ * Find first open network device with a usable configuration
+ *
+ * @v usable		Method to check usability, or NULL
+ * @ret netdev		Network device, or NULL if none found
+ */
+static struct net_device *
+ifconf_first_usable ( int ( * usable ) ( struct net_device *netdev ) ) {
+	struct net_device *netdev;
+
+	for_each_netdev ( netdev ) {
+		if ( netdev_is_open ( netdev ) &&
+		     netdev_configuration_ok ( netdev ) &&
+		     ( ( ! usable ) || usable ( netdev ) ) )
+			return netdev;
+	}
+	return NULL;
+}
+
+/**
+ * Check parallel configuration progress
+ *
+ * @v ifpoller		Network device poller
+ * @ret ongoing_rc	Ongoing job status code (if known)
+ */
+static int ifconf_parallel_progress ( struct ifpoller *ifpoller ) {
+	struct net_device *netdev;
+	int in_progress = 0;
+
+	/* Terminate successfully as soon as any device is usable */
+	if ( ifconf_first_usable ( ifpoller->usable ) ) {
+		intf_close ( &ifpoller->job, 0 );
+		return 0;
+	}
+
+	/* Check for any configurations still in progress */
+	for_each_netdev ( netdev ) {
+		if ( netdev_is_open ( netdev ) &&
+		     netdev_configuration_in_progress ( netdev ) )
+			in_progress = 1;
+	}
+
+	/* Fail once all configurations have completed */
+	if ( ! in_progress )
+		intf_close ( &ifpoller->job, -EADDRNOTAVAIL_CONFIG );
+
+	return 0;
+}
+
+/**
+ * Perform concurrent configuration of all open network devices
+ *
+ * @v usable		Method to check usability, or NULL
+ * @ret netdev		First usable network device, or NULL on failure
+ *
+ * All configurators are started on every open network device, and
+ * the first device to obtain a successful (and usable) configuration
+ * is returned.  Configuration continues on any other devices.
+ */
+struct net_device * ifconf_parallel ( int ( * usable )
+				      ( struct net_device *netdev ) ) {
+	struct net_device *netdev;
+	unsigned int count = 0;
+	int rc;
+
+	/* Start configuration on all open devices */
+	for_each_netdev ( netdev ) {
+		if ( ! netdev_is_open ( netdev ) )
+			continue;
+		if ( ( rc = netdev_configure_all ( netdev ) ) != 0 ) {
+			printf ( "Could not configure %s: %s\n",
+				 netdev->name, strerror ( rc ) );
+			continue;
+		}
+		count++;
+	}
+	if ( ! count )
+		return NULL;
+
+	/* Wait for first usable configuration */
+	printf ( "Configuring %d network devices", count );
+	if ( ( rc = ifpoller_wait ( NULL, NULL, usable, 0,
+				    ifconf_parallel_progress ) ) != 0 )
+		return NULL;
+
+	return ifconf_first_usable ( usable );
 }
@@ -26,12 +26,19 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <ctype.h>
 #include <errno.h>
 #include <ipxe/image.h>
+#include <ipxe/uaccess.h>
 #include <ipxe/downloader.h>
 #include <ipxe/monojob.h>
 #include <ipxe/open.h>
 #include <ipxe/uri.h>
+#include <ipxe/refcnt.h>
+#include <ipxe/list.h>
+#include <ipxe/interface.h>
+#include <ipxe/init.h>
 #include <usr/imgmgmt.h>
 
 /** @file
@@ -40,16 +47,306 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
+/** An image being downloaded in the background */
+struct image_prefetch {
+	/** Reference count */
+	struct refcnt refcnt;
+	/** List of prefetched images */
+	struct list_head list;
+	/** Job control interface */
+	struct interface job;
+	/** Image */
+	struct image *image;
+	/** Resolved URI string */
+	char *uri;
+	/** Download status */
+	int rc;
+	/** Image is to be registered by imgwait() */
+	int wait;
+};
+
+/** List of prefetched images */
+static LIST_HEAD ( image_prefetches );
+
+/**
+ * Free prefetched image
+ *
+ * @v refcnt		Reference count
+ */
+static void imgprefetch_free ( struct refcnt *refcnt ) {
+	struct image_prefetch *prefetch =
+		container_of ( refcnt, struct image_prefetch, refcnt );
+
+	image_put ( prefetch->image );
+	free ( prefetch->uri );
+	free ( prefetch );
+}
+
+/**
+ * Handle completion of background download
+ *
+ * @v prefetch		Prefetched image
+ * @v rc		Reason for completion
+ */
+static void imgprefetch_close ( struct image_prefetch *prefetch, int rc ) {
+
+	DBGC ( prefetch, "IMGPREFETCH %s complete: %s\n",
+	       prefetch->image->name, strerror ( rc ) );
+
+	/* Shut down interface and record status */
+	intf_restart ( &prefetch->job, rc );
+	prefetch->rc = rc;
+}
+
+/** Prefetched image job control interface operations */
+static struct interface_operation imgprefetch_job_op[] = {
+	INTF_OP ( intf_close, struct image_prefetch *, imgprefetch_close ),
+};
+
+/** Prefetched image job control interface descriptor */
+static struct interface_descriptor imgprefetch_job_desc =
+	INTF_DESC ( struct image_prefetch, job, imgprefetch_job_op );
+
+/**
+ * Find prefetched image
+ *
+ * @v uri		Resolved URI string
+ * @ret prefetch	Prefetched image, or NULL
+ */
+static struct image_prefetch * imgprefetch_find ( const char *uri ) {
+	struct image_prefetch *prefetch;
+
+	list_for_each_entry ( prefetch, &image_prefetches, list ) {
+		if ( strcmp ( prefetch->uri, uri ) == 0 )
+			return prefetch;
+	}
+	return NULL;
+}
+
+/**
+ * Find image being downloaded in the background for imgwait()
+ *
+ * @v name		Image name, or NULL to find any such image
+ * @ret prefetch	Prefetched image, or NULL
+ */
+static struct image_prefetch * imgprefetch_find_wait ( const char *name ) {
+	struct image_prefetch *prefetch;
+
+	list_for_each_entry ( prefetch, &image_prefetches, list ) {
+		if ( ! prefetch->wait )
+			continue;
+		if ( ( ! name ) || ( strcmp ( prefetch->image->name,
+					      name ) == 0 ) )
+			return prefetch;
+	}
+	return NULL;
+}
+
+/**
+ * Start downloading an image in the background
+ *
+ * @v uri		URI
+ * @v wait		Image is to be registered by imgwait()
+ * @v image		Image to fill in
+ * @ret rc		Return status code
+ */
+static int imgprefetch_start ( struct uri *uri, int wait,
+			       struct image **image ) {
+	struct image_prefetch *prefetch;
+	struct image_prefetch *existing;
+	int rc;
+
+	/* Allocate and initialise structure */
+	prefetch = zalloc ( sizeof ( *prefetch ) );
+	if ( ! prefetch ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	ref_init ( &prefetch->refcnt, imgprefetch_free );
+	intf_init ( &prefetch->job, &imgprefetch_job_desc,
+		    &prefetch->refcnt );
+	prefetch->rc = -EINPROGRESS;
+
+	/* Resolve URI */
+	uri = resolve_uri ( cwuri, uri );
+	if ( ! uri ) {
+		rc = -ENOMEM;
+		goto err_resolve_uri;
+	}
+	prefetch->uri = format_uri_alloc ( uri );
+	if ( ! prefetch->uri ) {
+		rc = -ENOMEM;
+		goto err_uri_string;
+	}
+
+	/* Use existing background download, if any */
+	existing = imgprefetch_find ( prefetch->uri );
+	if ( existing ) {
+		existing->wait |= wait;
+		*image = existing->image;
+		rc = 0;
+		goto err_duplicate;
+	}
+
+	/* Allocate image */
+	prefetch->image = alloc_image ( uri );
+	if ( ! prefetch->image ) {
+		rc = -ENOMEM;
+		goto err_alloc_image;
+	}
+
+	/* Create downloader */
+	if ( ( rc = create_downloader ( &prefetch->job, prefetch->image,
+					NULL ) ) != 0 ) {
+		printf ( "Could not start prefetch: %s\n", strerror ( rc ) );
+		goto err_create_downloader;
+	}
+
+	/* Add to list of prefetched images (transferring reference) */
+	list_add_tail ( &prefetch->list, &image_prefetches );
+	prefetch->wait = wait;
+	*image = prefetch->image;
+	DBGC ( prefetch, "IMGPREFETCH %s started\n", prefetch->image->name );
+	uri_put ( uri );
+	return 0;
+
+ err_create_downloader:
+ err_alloc_image:
+ err_duplicate:
+ err_uri_string:
+	uri_put ( uri );
+ err_resolve_uri:
+	intf_shutdown ( &prefetch->job, rc );
+	ref_put ( &prefetch->refcnt );
+ err_alloc:
+	return rc;
+}
+
+/**
+ * Start downloading an image in the background
+ *
+ * @v uri		URI
+ * @ret rc		Return status code
+ *
+ * The image is not registered.  A subsequent imgdownload() of the
+ * same URI will claim the image, waiting for the download to
+ * complete if necessary.
+ */
+int imgprefetch ( struct uri *uri ) {
+	struct image *image;
+
+	return imgprefetch_start ( uri, 0, &image );
+}
+
+/**
+ * Take prefetched image
+ *
+ * @v prefetch		Prefetched image
+ * @v image		Image to fill in
+ * @ret rc		Return status code
+ *
+ * Returns 0 if the prefetch has already completed, -EINPROGRESS if
+ * the prefetch is still in progress (and has been transferred to the
+ * foreground job), or the failure status of the prefetch.  In all
+ * cases, the prefetched image is removed from the list of prefetched
+ * images and a reference to the image is returned.
+ */
+static int imgprefetch_take ( struct image_prefetch *prefetch,
+			      struct image **image ) {
+	struct interface *dest;
+	int rc;
+
+	/* Remove from list of prefetched images */
+	list_del ( &prefetch->list );
+
+	/* Transfer download in progress to the foreground job */
+	rc = prefetch->rc;
+	if ( rc == -EINPROGRESS ) {
+		dest = prefetch->job.dest;
+		intf_plug_plug ( &monojob, dest );
+		intf_unplug ( &prefetch->job );
+	}
+
+	/* Claim image */
+	DBGC ( prefetch, "IMGPREFETCH %s claimed (%s)\n",
+	       prefetch->image->name, strerror ( rc ) );
+	*image = image_get ( prefetch->image );
+
+	/* Drop list's reference */
+	ref_put ( &prefetch->refcnt );
+
+	return rc;
+}
+
+/**
+ * Claim prefetched image
+ *
+ * @v uri		Resolved URI
+ * @v image		Image to fill in
+ * @ret rc		Return status code
+ *
+ * Returns 0 if the prefetch has already completed, -EINPROGRESS if
+ * the prefetch is still in progress (and has been transferred to the
+ * foreground job), or -ENOENT if no usable prefetched image exists.
+ */
+static int imgprefetch_claim ( struct uri *uri, struct image **image ) {
+	struct image_prefetch *prefetch;
+	char *uri_string;
+	int rc;
+
+	/* Find prefetched image, if any */
+	if ( list_empty ( &image_prefetches ) )
+		return -ENOENT;
+	uri_string = format_uri_alloc ( uri );
+	if ( ! uri_string )
+		return -ENOENT;
+	prefetch = imgprefetch_find ( uri_string );
+	free ( uri_string );
+	if ( ! prefetch )
+		return -ENOENT;
+
+	/* Take image, ignoring any failed prefetch */
+	rc = imgprefetch_take ( prefetch, image );
+	if ( ( rc != 0 ) && ( rc != -EINPROGRESS ) ) {
+		image_put ( *image );
+		return -ENOENT;
+	}
+
+	return rc;
+}
+
+/**
+ * Abandon all background downloads
+ *
+ * @v booting		System is shutting down for OS boot
+ */
+static void imgprefetch_shutdown ( int booting __unused ) {
+	struct image_prefetch *prefetch;
+	struct image_prefetch *tmp;
+
+	list_for_each_entry_safe ( prefetch, tmp, &image_prefetches, list ) {
+		intf_shutdown ( &prefetch->job, -ECANCELED );
+		list_del ( &prefetch->list );
+		ref_put ( &prefetch->refcnt );
+	}
+}
+
+/** Prefetched image shutdown function */
+struct startup_fn imgprefetch_startup_fn __startup_fn ( STARTUP_LATE ) = {
+	.shutdown = imgprefetch_shutdown,
+};
+
 /**
  * Download a new image
  *
  * @v uri		URI
  * @v timeout		Download timeout
+ * @v digest		Digest algorithm to calculate, or NULL for default
  * @v image		Image to fill in
  * @ret rc		Return status code
  */
 int imgdownload ( struct uri *uri, unsigned long timeout,
-		  struct image **image ) {
+		  struct digest_algorithm *digest, struct image **image ) {
 	const char *password;
 	char *uri_string_redacted;
 	int rc;
@@ -72,22 +369,35 @@ int imgdownload ( struct uri *uri, unsigned long timeout,
 		goto err_resolve_uri;
 	}
 
-	/* Allocate image */
-	*image = alloc_image ( uri );
-	if ( ! *image ) {
-		rc = -ENOMEM;
-		goto err_alloc_image;
-	}
+	/* Use prefetched image, if available */
+	rc = ( digest ? -ENOENT : imgprefetch_claim ( uri, image ) );
+	if ( rc == -ENOENT ) {
 
-	/* Create downloader */
-	if ( ( rc = create_downloader ( &monojob, *image ) ) != 0 ) {
-		printf ( "Could not start download: %s\n", strerror ( rc ) );
-		goto err_create_downloader;
+		/* Allocate image */
+		*image = alloc_image ( uri );
+		if ( ! *image ) {
+			rc = -ENOMEM;
+			goto err_alloc_image;
+		}
+
+		/* Create downloader */
+		if ( ( rc = create_downloader ( &monojob, *image,
+						digest ) ) != 0 ) {
+			printf ( "Could not start download: %s\n",
+				 strerror ( rc ) );
+			goto err_create_downloader;
+		}
+		rc = -EINPROGRESS;
 	}
 
-	/* Wait for download to complete */
-	if ( ( rc = monojob_wait ( uri_string_redacted, timeout ) ) != 0 )
-		goto err_monojob_wait;
+	/* Wait for download to complete, if applicable */
+	if ( rc == -EINPROGRESS ) {
+		rc = monojob_wait ( uri_string_redacted, timeout );
+		if ( rc != 0 )
+			goto err_monojob_wait;
+	} else {
+		printf ( "%s... ok\n", uri_string_redacted );
+	}
 
 	/* Register image */
 	if ( ( rc = register_image ( *image ) ) != 0 ) {
@@ -123,7 +433,7 @@ int imgdownload_string ( const char *uri_string, unsigned long timeout,
 	if ( ! ( uri = parse_uri ( uri_string ) ) )
 		return -ENOMEM;
 
-	rc = imgdownload ( uri, timeout, image );
+	rc = imgdownload ( uri, timeout, NULL, image );
 
 	uri_put ( uri );
 	return rc;
@@ -149,6 +459,193 @@ int imgacquire ( const char *name_uri, unsigned long timeout,
 	return imgdownload_string ( name_uri, timeout, image );
 }
 
+/**
+ * Start downloading a new image in the background
+ *
+ * @v uri_string	URI string
+ * @v image		Image to fill in
+ * @ret rc		Return status code
+ *
+ * The image is not registered until imgwait() is called.  The
+ * returned image pointer does not carry a reference, and remains
+ * valid only until the next call to imgwait().
+ */
+int imgdownload_background ( const char *uri_string, struct image **image ) {
+	struct uri *uri;
+	int rc;
+
+	if ( ! ( uri = parse_uri ( uri_string ) ) )
+		return -ENOMEM;
+
+	if ( ( rc = imgprefetch_start ( uri, 1, image ) ) != 0 ) {
+		printf ( "Could not start download: %s\n", strerror ( rc ) );
+		goto err_start;
+	}
+
+ err_start:
+	uri_put ( uri );
+	return rc;
+}
+
+/**
+ * Wait for background downloads to complete
+ *
+ * @v name		Image name, or NULL to wait for all images
+ * @v timeout		Download timeout
+ * @ret rc		Return status code
+ *
+ * Each completed image is registered.
+ */
+int imgwait ( const char *name, unsigned long timeout ) {
+	struct image_prefetch *prefetch;
+	struct image *image;
+	int rc;
+
+	/* Succeed if a named image has already been registered */
+	if ( name && ( ! imgprefetch_find_wait ( name ) ) ) {
+		if ( find_image ( name ) )
+			return 0;
+		printf ( "No such image: %s\n", name );
+		return -ENOENT;
+	}
+
+	/* Wait for each matching image in turn */
+	while ( ( prefetch = imgprefetch_find_wait ( name ) ) != NULL ) {
+
+		/* Take image, waiting for download to complete if needed */
+		rc = imgprefetch_take ( prefetch, &image );
+		if ( rc == -EINPROGRESS ) {
+			rc = monojob_wait ( image->name, timeout );
+			if ( rc != 0 )
+				goto err_wait;
+		} else if ( rc == 0 ) {
+			printf ( "%s... ok\n", image->name );
+		} else {
+			printf ( "Could not download %s: %s\n",
+				 image->name, strerror ( rc ) );
+			goto err_download;
+		}
+
+		/* Register image */
+		if ( ( rc = register_image ( image ) ) != 0 ) {
+			printf ( "Could not register image: %s\n",
+				 strerror ( rc ) );
+			goto err_register;
+		}
+		image_put ( image );
+	}
+
+	return 0;
+
+ err_register:
+ err_download:
+ err_wait:
+	image_put ( image );
+	return rc;
+}
+
+/**
+ * Download all images listed in a manifest
+ *
+ * @v manifest		Manifest image
+ * @v timeout		Download timeout
+ * @ret rc		Return status code
+ *
+ * Each non-empty line of the manifest (other than comment lines
+ * starting with '#') takes the form "<uri> [<arguments>...]".
+ * Relative URIs are resolved against the manifest's own URI.  All
+ * listed images are downloaded concurrently, and are registered in
+ * the order in which they are listed.
+ */
+int imgbatch ( struct image *manifest, unsigned long timeout ) {
+	struct image *image;
+	struct uri *relative;
+	struct uri *uri;
+	char *text;
+	char *line;
+	char *next;
+	char *args;
+	char *end;
+	int rc;
+
+	/* Copy manifest to a NUL-terminated string */
+	text = malloc ( manifest->len + 1 /* NUL */ );
+	if ( ! text ) {
+		rc = -ENOMEM;
+		goto err_alloc;
+	}
+	copy_from_user ( text, manifest->data, 0, manifest->len );
+	text[manifest->len] = '\0';
+
+	/* Start downloading each listed image */
+	for ( line = text ; line ; line = next ) {
+
+		/* Split off line and strip surrounding whitespace */
+		next = strchr ( line, '\n' );
+		if ( next )
+			*(next++) = '\0';
+		while ( isspace ( *line ) )
+			line++;
+		end = ( line + strlen ( line ) );
+		while ( ( end > line ) && isspace ( end[-1] ) )
+			*(--end) = '\0';
+
+		/* Skip blank lines and comments */
+		if ( ( line[0] == '\0' ) || ( line[0] == '#' ) )
+			continue;
+
+		/* Split off arguments, if any */
+		for ( args = line ; *args && ! isspace ( *args ) ; args++ ) {}
+		if ( *args ) {
+			*(args++) = '\0';
+			while ( isspace ( *args ) )
+				args++;
+		}
+
+		/* Parse URI, relative to the manifest if applicable */
+		relative = parse_uri ( line );
+		if ( ! relative ) {
+			rc = -ENOMEM;
+			goto err_parse_uri;
+		}
+		uri = resolve_uri ( manifest->uri, relative );
+		uri_put ( relative );
+		if ( ! uri ) {
+			rc = -ENOMEM;
+			goto err_parse_uri;
+		}
+
+		/* Start download */
+		rc = imgprefetch_start ( uri, 1, &image );
+		uri_put ( uri );
+		if ( rc != 0 ) {
+			printf ( "Could not start download: %s\n",
+				 strerror ( rc ) );
+			goto err_start;
+		}
+
+		/* Set command line, if applicable */
+		if ( *args && ( ( rc = image_set_cmdline ( image,
+							  args ) ) != 0 ) ) {
+			printf ( "Could not set arguments: %s\n",
+				 strerror ( rc ) );
+			goto err_set_cmdline;
+		}
+	}
+
+	/* Wait for all downloads to complete */
+	if ( ( rc = imgwait ( NULL, timeout ) ) != 0 )
+		goto err_wait;
+
+ err_wait:
+ err_set_cmdline:
+ err_start:
+ err_parse_uri:
+	free ( text );
+ err_alloc:
+	return rc;
+}
+
 /**
  * Display status of an image
  *
@@ -40,6 +40,45 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
+/**
+ * Identify digest algorithm used by downloaded signature
+ *
+ * @v signature		Image containing signature
+ * @ret digest		Digest algorithm, or NULL if not identifiable
+ *
+ * Identifying the digest algorithm before downloading the signed
+ * image allows the digest to be calculated as the image data
+ * arrives, so that verification requires no further pass over the
+ * image data.  Any failure here is deliberately ignored, since it
+ * will be reported by the subsequent call to imgverify().
+ */
+struct digest_algorithm * imgverify_digest ( struct image *signature ) {
+	struct digest_algorithm *digest = NULL;
+	struct asn1_cursor *data;
+	struct cms_signature *sig;
+	struct cms_signer_info *info;
+
+	/* Get raw signature data */
+	if ( image_asn1 ( signature, 0, &data ) < 0 )
+		goto err_asn1;
+
+	/* Parse signature */
+	if ( cms_signature ( data->data, data->len, &sig ) != 0 )
+		goto err_parse;
+
+	/* Use digest algorithm of first signer */
+	list_for_each_entry ( info, &sig->info, list ) {
+		digest = info->digest;
+		break;
+	}
+
+	cms_put ( sig );
+ err_parse:
+	free ( data );
+ err_asn1:
+	return digest;
+}
+
 /**
  * Verify image using downloaded signature
  *
@@ -77,7 +116,8 @@ int imgverify ( struct image *image, struct image *signature,
 
 	/* Complete all certificate chains */
 	list_for_each_entry ( info, &sig->info, list ) {
-		if ( ( rc = create_validator ( &monojob, info->chain ) ) != 0 )
+		if ( ( rc = create_validator ( &monojob, info->chain,
+						 NULL, 0 ) ) != 0 )
 			goto err_create_validator;
 		if ( ( rc = monojob_wait ( NULL, 0 ) ) != 0 )
 			goto err_validator_wait;
@@ -85,8 +125,9 @@ int imgverify ( struct image *image, struct image *signature,
 
 	/* Use signature to verify image */
 	now = time ( NULL );
-	if ( ( rc = cms_verify ( sig, image->data, image->len,
-				 name, now, NULL, NULL ) ) != 0 )
+	if ( ( rc = cms_verify_digested ( sig, image->data, image->len,
+					  image->digest, image->digest_value,
+					  name, now, NULL, NULL ) ) != 0 )
 		goto err_verify;
 
 	/* Drop reference to signature */
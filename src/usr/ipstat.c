@@ -25,6 +25,9 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 
 #include <stdio.h>
 #include <ipxe/ipstat.h>
+#include <ipxe/dropstat.h>
+#include <ipxe/netdevice.h>
+#include <ipxe/timer.h>
 #include <usr/ipstat.h>
 
 /** @file
@@ -33,6 +36,25 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
+/**
+ * Print packet drop statistics
+ *
+ */
+static void ipstat_drops ( void ) {
+	struct drop_counter *counter;
+	int first = 1;
+
+	for_each_table_entry ( counter, DROP_COUNTERS ) {
+		if ( ! counter->count )
+			continue;
+		printf ( "%s%s:%ld", ( first ? "Drops:\n  " : " " ),
+			 counter->name, counter->count );
+		first = 0;
+	}
+	if ( ! first )
+		printf ( "\n" );
+}
+
 /**
  * Print IP statistics
  *
@@ -63,4 +85,74 @@ void ipstat ( void ) {
 			 stats->out_mcast_pkts, stats->out_bcast_pkts,
 			 stats->out_octets );
 	}
+	ipstat_drops();
+}
+
+/**
+ * Calculate rate
+ *
+ * @v count		Count
+ * @v elapsed		Elapsed time (in ticks)
+ * @ret rate		Rate (per second)
+ */
+static unsigned long ipstat_rate ( unsigned long long count,
+				   unsigned long elapsed ) {
+
+	if ( ! elapsed )
+		return 0;
+	return ( ( count * TICKS_PER_SEC ) / elapsed );
+}
+
+/**
+ * Print IP statistics in machine-readable form
+ *
+ * Each IP version, packet drop counter and network device is printed
+ * as a single line of space-separated "key=value" pairs.  Network
+ * device rates are averaged over the time since the device was
+ * opened.
+ */
+void ipstat_raw ( void ) {
+	struct ip_statistics_family *family;
+	struct ip_statistics *stats;
+	struct drop_counter *counter;
+	struct net_device *netdev;
+	unsigned long elapsed;
+
+	for_each_table_entry ( family, IP_STATISTICS_FAMILIES ) {
+		stats = family->stats;
+		printf ( "ip version=%d in_receives=%ld in_octets=%ld "
+			 "in_hdr_errors=%ld in_addr_errors=%ld "
+			 "in_unknown_protos=%ld in_truncated_pkts=%ld "
+			 "reasm_fails=%ld in_delivers=%ld out_requests=%ld "
+			 "out_no_routes=%ld out_transmits=%ld "
+			 "out_octets=%ld\n", family->version,
+			 stats->in_receives, stats->in_octets,
+			 stats->in_hdr_errors, stats->in_addr_errors,
+			 stats->in_unknown_protos, stats->in_truncated_pkts,
+			 stats->reasm_fails, stats->in_delivers,
+			 stats->out_requests, stats->out_no_routes,
+			 stats->out_transmits, stats->out_octets );
+	}
+	for_each_table_entry ( counter, DROP_COUNTERS ) {
+		printf ( "drop name=%s count=%ld\n",
+			 counter->name, counter->count );
+	}
+	for_each_netdev ( netdev ) {
+		elapsed = ( netdev_is_open ( netdev ) ?
+			    ( currticks() - netdev->opened ) : 0 );
+		printf ( "netdev name=%s ticks=%ld rx_packets=%d rx_errors=%d "
+			 "rx_bytes=%ld rx_overflows=%d rx_pps=%ld rx_bps=%ld "
+			 "tx_packets=%d tx_errors=%d tx_bytes=%ld tx_pps=%ld "
+			 "tx_bps=%ld\n", netdev->name, elapsed,
+			 netdev->rx_stats.good, netdev->rx_stats.bad,
+			 netdev->rx_stats.bytes, netdev->rx_stats.overflow,
+			 ipstat_rate ( netdev->rx_stats.good, elapsed ),
+			 ipstat_rate ( ( netdev->rx_stats.bytes * 8ULL ),
+				       elapsed ),
+			 netdev->tx_stats.good, netdev->tx_stats.bad,
+			 netdev->tx_stats.bytes,
+			 ipstat_rate ( netdev->tx_stats.good, elapsed ),
+			 ipstat_rate ( ( netdev->tx_stats.bytes * 8ULL ),
+				       elapsed ) );
+	}
 }
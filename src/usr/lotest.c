@@ -34,6 +34,8 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <ipxe/if_ether.h>
 #include <ipxe/keys.h>
 #include <ipxe/console.h>
+#include <ipxe/timer.h>
+#include <ipxe/profile.h>
 #include <usr/ifmgmt.h>
 #include <usr/lotest.h>
 
@@ -283,3 +285,165 @@ int loopback_test ( struct net_device *sender, struct net_device *receiver,
 
 	return 0;
 }
+
+/**
+ * Benchmark a single frame size
+ *
+ * @v sender		Sending network device
+ * @v receiver		Receiving network device
+ * @v ll_dest		Link-layer destination address
+ * @v len		Packet size (excluding link-layer headers)
+ * @v count		Number of packets to transmit
+ * @v window		Maximum number of packets in flight
+ * @ret rc		Return status code
+ */
+static int loopback_bench_len ( struct net_device *sender,
+				struct net_device *receiver,
+				const void *ll_dest, size_t len,
+				unsigned int count, unsigned int window ) {
+	struct net_device_stats tx_stats = sender->tx_stats;
+	struct net_device_stats rx_stats = receiver->rx_stats;
+	struct io_buffer *iobuf;
+	unsigned long start;
+	unsigned long last;
+	unsigned long elapsed;
+	unsigned long started;
+	unsigned long cycles;
+	unsigned int sent = 0;
+	unsigned int received = 0;
+	unsigned int lost = 0;
+	unsigned int bad = 0;
+	unsigned long bytes = 0;
+	int rc;
+
+	/* Transmit and receive packets */
+	start = last = currticks();
+	started = profile_timestamp();
+	while ( ( received + lost + bad ) < count ) {
+
+		/* Check for cancellation */
+		if ( iskey() && ( getchar() == CTRL_C ) )
+			return -ECANCELED;
+
+		/* Transmit packets until window is full */
+		while ( ( sent < count ) &&
+			( ( sent - received - lost - bad ) < window ) ) {
+			iobuf = alloc_iob ( MAX_LL_HEADER_LEN + len );
+			if ( ! iobuf )
+				return -ENOMEM;
+			iob_reserve ( iobuf, MAX_LL_HEADER_LEN );
+			memset ( iob_put ( iobuf, len ), 0, len );
+			*( ( uint32_t * ) iobuf->data ) = htonl ( sent );
+			if ( ( rc = net_tx ( iob_disown ( iobuf ), sender,
+					     &lotest_protocol, ll_dest,
+					     sender->ll_addr ) ) != 0 ) {
+				return rc;
+			}
+			sent++;
+		}
+
+		/* Poll network devices */
+		net_poll();
+
+		/* Consume received packets */
+		while ( ( iobuf = lotest_dequeue() ) != NULL ) {
+			if ( iob_len ( iobuf ) == len ) {
+				received++;
+				bytes += len;
+			} else {
+				bad++;
+			}
+			free_iob ( iobuf );
+			last = currticks();
+		}
+
+		/* Treat all packets in flight as lost if nothing has
+		 * been received for a while.
+		 */
+		if ( ( currticks() - last ) >= TICKS_PER_SEC ) {
+			lost += ( sent - received - lost - bad );
+			last = currticks();
+		}
+	}
+	cycles = ( profile_timestamp() - started );
+	elapsed = ( currticks() - start );
+	if ( ! elapsed )
+		elapsed = 1;
+
+	/* Report results */
+	printf ( "%5zd bytes: %d/%d received, %ld frames/s, %ld kbit/s, "
+		 "%ld cycles/frame, %d lost, %d bad, %d TX errors, "
+		 "%d RX overflows\n", len, received, count,
+		 ( ( received * TICKS_PER_SEC ) / elapsed ),
+		 ( ( ( bytes * 8 / 1000 ) * TICKS_PER_SEC ) / elapsed ),
+		 ( received ? ( cycles / received ) : 0 ), lost, bad,
+		 ( sender->tx_stats.bad - tx_stats.bad ),
+		 ( receiver->rx_stats.overflow - rx_stats.overflow ) );
+
+	return 0;
+}
+
+/**
+ * Benchmark packet throughput between two network devices
+ *
+ * @v sender		Sending network device
+ * @v receiver		Receiving network device
+ * @v mtu		Maximum packet size (excluding link-layer headers)
+ * @v count		Number of packets to transmit per packet size
+ * @v window		Maximum number of packets in flight
+ * @ret rc		Return status code
+ *
+ * Packet sizes are doubled from a minimum of 64 bytes up to the
+ * specified MTU.  Packet contents are not verified, in order to
+ * measure only the cost of the network device and driver.
+ */
+int loopback_bench ( struct net_device *sender, struct net_device *receiver,
+		     size_t mtu, unsigned int count, unsigned int window ) {
+	const void *ll_dest;
+	size_t len;
+	int rc;
+
+	/* Open network devices */
+	if ( ( rc = ifopen ( sender ) ) != 0 )
+		return rc;
+	if ( ( rc = ifopen ( receiver ) ) != 0 )
+		return rc;
+
+	/* Wait for link-up */
+	if ( ( rc = iflinkwait ( sender, 0 ) ) != 0 )
+		return rc;
+	if ( ( rc = iflinkwait ( receiver, 0 ) ) != 0 )
+		return rc;
+
+	/* Sanity check */
+	if ( mtu < sizeof ( uint32_t ) )
+		mtu = sizeof ( uint32_t );
+	if ( ! window )
+		window = 1;
+
+	/* Determine destination address */
+	ll_dest = receiver->ll_addr;
+
+	/* Start benchmark */
+	printf ( "Benchmarking %d packets from %s to %s with up to %d in "
+		 "flight\n", count, sender->name, receiver->name, window );
+	lotest_flush();
+	lotest_receiver = receiver;
+
+	/* Benchmark each packet size */
+	for ( len = LOTEST_BENCH_MIN_LEN ; ; len *= 2 ) {
+		if ( len > mtu )
+			len = mtu;
+		if ( ( rc = loopback_bench_len ( sender, receiver, ll_dest,
+						 len, count, window ) ) != 0 )
+			break;
+		if ( len == mtu )
+			break;
+	}
+
+	/* Stop benchmark */
+	lotest_receiver = NULL;
+	lotest_flush();
+
+	return rc;
+}
@@ -0,0 +1,98 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+#include <stdio.h>
+#include <stdarg.h>
+#include <syslog.h>
+#include <ipxe/malloc.h>
+#include <usr/memstat.h>
+
+/** @file
+ *
+ * Heap statistics
+ *
+ */
+
+/**
+ * Print heap statistics line
+ *
+ * @v log		Write to system log instead of console
+ * @v fmt		Format string
+ * @v ...		Arguments
+ */
+static void __attribute__ (( format ( printf, 2, 3 ) ))
+memstat_printf ( int log, const char *fmt, ... ) {
+	va_list args;
+
+	va_start ( args, fmt );
+	if ( log ) {
+		log_vprintf ( fmt, args );
+	} else {
+		vprintf ( fmt, args );
+	}
+	va_end ( args );
+}
+
+/**
+ * Print heap statistics
+ *
+ * @v log		Write to system log instead of console
+ *
+ * Each line is printed as a space-separated list of "key=value"
+ * pairs.  The "heap" line shows overall usage (including the
+ * high-water mark, for sizing the heap), the "free" lines show the
+ * distribution of free blocks across size classes (as a measure of
+ * fragmentation), and the "site" lines show per-call-site allocation
+ * statistics (if allocation profiling is enabled).
+ */
+void memstat ( int log ) {
+	struct memblock_stats stats;
+	struct malloc_site *site;
+	const char *prefix = ( log ? "memstat " : "" );
+	unsigned int i;
+
+	/* Show overall usage */
+	memblock_stats ( &stats );
+	memstat_printf ( log, "%sheap size=%zd used=%zd max=%zd free=%zd "
+			 "largest=%zd allocs=%ld\n", prefix, heapmem,
+			 ( heapmem - freemem ), maxusedmem, freemem,
+			 stats.largest, memblock_allocs );
+
+	/* Show free block size classes */
+	for ( i = 0 ; i < MEMBLOCK_BINS ; i++ ) {
+		if ( ! stats.count[i] )
+			continue;
+		memstat_printf ( log, "%sfree min=%#lx count=%d size=%zd\n",
+				 prefix, ( 1UL << i ), stats.count[i],
+				 stats.size[i] );
+	}
+
+	/* Show allocation call sites */
+	for ( i = 0 ; ( site = malloc_site ( i ) ) ; i++ ) {
+		if ( ! site->caller )
+			continue;
+		memstat_printf ( log, "%ssite caller=%p count=%ld total=%ld "
+				 "used=%zd max=%zd\n", prefix, site->caller,
+				 site->count, site->total, site->used,
+				 site->max );
+	}
+}
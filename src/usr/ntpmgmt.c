@@ -39,14 +39,15 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 /**
  * Get time and date via NTP
  *
- * @v hostname		Hostname
+ * @v hostnames		Hostnames
+ * @v count		Number of hostnames
  * @ret rc		Return status code
  */
-int ntp ( const char *hostname ) {
+int ntp ( char **hostnames, unsigned int count ) {
 	int rc;
 
-	/* Start NTP client */
-	if ( ( rc = start_ntp ( &monojob, hostname ) ) != 0 )
+	/* Start NTP synchronisation */
+	if ( ( rc = start_ntp_sync ( &monojob, hostnames, count ) ) != 0 )
 		return rc;
 
 	/* Wait for NTP to complete */
@@ -55,3 +56,19 @@ int ntp ( const char *hostname ) {
 
 	return 0;
 }
+
+/**
+ * Start getting time and date via NTP in the background
+ *
+ * @v hostnames		Hostnames
+ * @v count		Number of hostnames
+ * @ret rc		Return status code
+ *
+ * The time and date will be set by whichever server responds first.
+ * Any certificate validation that fails while synchronisation is
+ * still in progress will be retried once the clock has been set.
+ */
+int ntp_background ( char **hostnames, unsigned int count ) {
+
+	return start_ntp_sync ( NULL, hostnames, count );
+}
@@ -26,9 +26,11 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 #include <ipxe/pinger.h>
 #include <ipxe/monojob.h>
 #include <ipxe/timer.h>
+#include <ipxe/profile.h>
 #include <usr/pingmgmt.h>
 
 /** @file
@@ -37,51 +39,317 @@ FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
  *
  */
 
+/** Maximum number of round-trip times retained for percentiles */
+#define PING_MAX_SAMPLES 512
+
+/** Timestamp calibration delay (in microseconds) */
+#define PING_CALIBRATE_USECS 10000
+
+/** Maximum width of a histogram bar */
+#define PING_HIST_WIDTH 50
+
+/** Ping statistics */
+struct ping_statistics {
+	/** Payload length */
+	size_t len;
+	/** Number of requests sent */
+	unsigned int sent;
+	/** Number of valid responses received */
+	unsigned int received;
+	/** Most recent sequence number */
+	uint16_t sequence;
+	/** Minimum round-trip time (in microseconds) */
+	unsigned long min;
+	/** Maximum round-trip time (in microseconds) */
+	unsigned long max;
+	/** Round-trip time profiler (in microseconds) */
+	struct profiler profiler;
+	/** Retained round-trip times (in microseconds) */
+	unsigned long samples[PING_MAX_SAMPLES];
+};
+
+/** Statistics for the current payload length */
+static struct ping_statistics ping_stats;
+
+/** Profiling timestamp units per microsecond (or zero if unknown) */
+static unsigned long ping_scale;
+
+/** Flags for the current ping */
+static unsigned int ping_flags;
+
 /**
- * Display ping result
+ * Calibrate profiling timestamps
+ *
+ * Profiling timestamps (e.g. the TSC on x86) have a much finer
+ * resolution than the system timer tick, but an unknown frequency.
+ * Calibrate them once against the timer's microsecond delay.
+ */
+static void ping_calibrate ( void ) {
+	unsigned long started;
+
+	/* Do nothing if already calibrated */
+	if ( ping_scale )
+		return;
+
+	/* Measure timestamp units elapsed over a fixed delay */
+	started = profile_timestamp();
+	udelay ( PING_CALIBRATE_USECS );
+	ping_scale = ( ( profile_timestamp() - started ) /
+		       PING_CALIBRATE_USECS );
+}
+
+/**
+ * Record ping result
  *
  * @v src		Source socket address, or NULL
  * @v sequence		Sequence number
  * @v len		Payload length
+ * @v elapsed		Round-trip time (in profiling timestamp units)
  * @v rc		Status code
  */
 static void ping_callback ( struct sockaddr *peer, unsigned int sequence,
-			    size_t len, int rc ) {
+			    size_t len, unsigned long elapsed, int rc ) {
+	struct ping_statistics *stats = &ping_stats;
+	unsigned long usecs = ( ping_scale ? ( elapsed / ping_scale ) : 0 );
 
-	/* Display ping response */
+	/* Count each request once, ignoring delayed responses */
+	if ( ( stats->sent == 0 ) ||
+	     ( ( ( int16_t ) ( sequence - stats->sequence ) ) > 0 ) ) {
+		stats->sequence = sequence;
+		stats->sent++;
+	}
+
+	/* Record round-trip time */
+	if ( rc == 0 ) {
+		if ( ( stats->received == 0 ) || ( usecs < stats->min ) )
+			stats->min = usecs;
+		if ( usecs > stats->max )
+			stats->max = usecs;
+		if ( stats->received < PING_MAX_SAMPLES )
+			stats->samples[stats->received] = usecs;
+		stats->received++;
+		profile_update ( &stats->profiler, usecs );
+	}
+
+	/* Display ping response, if applicable */
+	if ( ping_flags & ( PING_QUIET | PING_FLOOD | PING_RAW ) )
+		return;
 	printf ( "%zd bytes from %s: seq=%d",
 		 len, ( peer ? sock_ntoa ( peer ) : "<none>" ), sequence );
-	if ( rc != 0 )
+	if ( rc == 0 ) {
+		printf ( " time=%ld.%03ldms",
+			 ( usecs / 1000 ), ( usecs % 1000 ) );
+	} else {
 		printf ( ": %s", strerror ( rc ) );
+	}
 	printf ( "\n" );
 }
 
 /**
- * Ping a host
+ * Calculate round-trip time percentile
+ *
+ * @v stats		Ping statistics
+ * @v percent		Percentile
+ * @ret usecs		Round-trip time (in microseconds)
+ *
+ * The retained samples must already have been sorted.
+ */
+static unsigned long ping_percentile ( struct ping_statistics *stats,
+				       unsigned int percent ) {
+	unsigned int count;
+
+	/* Use only retained samples */
+	count = stats->received;
+	if ( count > PING_MAX_SAMPLES )
+		count = PING_MAX_SAMPLES;
+	if ( ! count )
+		return 0;
+
+	return stats->samples[ ( ( count - 1 ) * percent ) / 100 ];
+}
+
+/**
+ * Sort retained round-trip times
+ *
+ * @v stats		Ping statistics
+ */
+static void ping_sort ( struct ping_statistics *stats ) {
+	unsigned long usecs;
+	unsigned int count;
+	unsigned int i;
+	unsigned int j;
+
+	/* Use only retained samples */
+	count = stats->received;
+	if ( count > PING_MAX_SAMPLES )
+		count = PING_MAX_SAMPLES;
+
+	/* Insertion sort: the sample count is small */
+	for ( i = 1 ; i < count ; i++ ) {
+		usecs = stats->samples[i];
+		for ( j = i ; j && ( stats->samples[ j - 1 ] > usecs ) ; j-- )
+			stats->samples[j] = stats->samples[ j - 1 ];
+		stats->samples[j] = usecs;
+	}
+}
+
+/**
+ * Display round-trip time histogram
+ *
+ * @v stats		Ping statistics
+ */
+static void ping_histogram ( struct ping_statistics *stats ) {
+	unsigned int *hist = stats->profiler.hist;
+	unsigned int first = PROFILE_HIST_BUCKETS;
+	unsigned int last = 0;
+	unsigned int peak = 0;
+	unsigned int width;
+	unsigned int i;
+
+	/* Find range of non-empty buckets */
+	for ( i = 0 ; i < PROFILE_HIST_BUCKETS ; i++ ) {
+		if ( ! hist[i] )
+			continue;
+		if ( first > i )
+			first = i;
+		last = i;
+		if ( peak < hist[i] )
+			peak = hist[i];
+	}
+
+	/* Display each bucket within range */
+	for ( i = first ; i <= last ; i++ ) {
+		printf ( "%8ld-%-8ldus %6d ",
+			 ( i ? ( 1UL << ( i - 1 ) ) : 0 ), ( 1UL << i ),
+			 hist[i] );
+		width = ( ( hist[i] * PING_HIST_WIDTH + peak - 1 ) / peak );
+		while ( width-- )
+			putchar ( '#' );
+		putchar ( '\n' );
+	}
+}
+
+/**
+ * Display ping statistics
+ *
+ * @v hostname		Hostname
+ * @v stats		Ping statistics
+ */
+static void ping_report ( const char *hostname,
+			  struct ping_statistics *stats ) {
+	unsigned int loss;
+	unsigned int i;
+
+	/* Calculate loss percentage */
+	loss = ( stats->sent ? ( ( ( stats->sent - stats->received ) * 100 )
+				 / stats->sent ) : 0 );
+
+	/* Calculate percentiles */
+	ping_sort ( stats );
+
+	/* Display statistics */
+	if ( ping_flags & PING_RAW ) {
+		printf ( "ping host=%s size=%zd sent=%d received=%d loss=%d "
+			 "min=%ld mean=%ld p50=%ld p99=%ld max=%ld stddev=%ld "
+			 "hist=", hostname, stats->len, stats->sent,
+			 stats->received, loss, stats->min,
+			 profile_mean ( &stats->profiler ),
+			 ping_percentile ( stats, 50 ),
+			 ping_percentile ( stats, 99 ), stats->max,
+			 profile_stddev ( &stats->profiler ) );
+		for ( i = 0 ; i < PROFILE_HIST_BUCKETS ; i++ ) {
+			printf ( "%s%d", ( i ? "," : "" ),
+				 stats->profiler.hist[i] );
+		}
+		printf ( "\n" );
+	} else {
+		printf ( "%s (%zd bytes): %d sent, %d received, %d%% loss\n",
+			 hostname, stats->len, stats->sent, stats->received,
+			 loss );
+		if ( ! stats->received )
+			return;
+		printf ( "min/avg/p50/p99/max = %ld/%ld/%ld/%ld/%ld us\n",
+			 stats->min, profile_mean ( &stats->profiler ),
+			 ping_percentile ( stats, 50 ),
+			 ping_percentile ( stats, 99 ), stats->max );
+		if ( ping_flags & PING_FLOOD )
+			ping_histogram ( stats );
+	}
+}
+
+/**
+ * Ping a host with a single payload length
  *
  * @v hostname		Hostname
  * @v timeout		Timeout between pings, in ticks
  * @v len		Payload length
  * @v count		Number of packets to send (or zero for no limit)
- * @v quiet		Inhibit output
  * @ret rc		Return status code
  */
-int ping ( const char *hostname, unsigned long timeout, size_t len,
-	   unsigned int count, int quiet ) {
+static int ping_len ( const char *hostname, unsigned long timeout,
+		      size_t len, unsigned int count ) {
+	int quiet = ( ping_flags & PING_QUIET );
 	int rc;
 
+	/* Reset statistics */
+	memset ( &ping_stats, 0, sizeof ( ping_stats ) );
+	ping_stats.len = len;
+
 	/* Create pinger */
 	if ( ( rc = create_pinger ( &monojob, hostname, timeout, len, count,
-				    ( quiet ? NULL : ping_callback ) ) ) != 0 ){
+				    ( ping_flags & PING_FLOOD ),
+				    ping_callback ) ) != 0 ) {
 		printf ( "Could not start ping: %s\n", strerror ( rc ) );
 		return rc;
 	}
 
 	/* Wait for ping to complete */
-	if ( ( rc = monojob_wait ( NULL, 0 ) ) != 0 ) {
-		if ( ! quiet )
-			printf ( "Finished: %s\n", strerror ( rc ) );
-		return rc;
+	rc = monojob_wait ( NULL, 0 );
+
+	/* Display statistics */
+	if ( ! quiet )
+		ping_report ( hostname, &ping_stats );
+	if ( ( rc != 0 ) && ! quiet )
+		printf ( "Finished: %s\n", strerror ( rc ) );
+
+	return rc;
+}
+
+/**
+ * Ping a host
+ *
+ * @v hostname		Hostname
+ * @v timeout		Timeout between pings, in ticks
+ * @v len		Payload length
+ * @v max_len		Maximum payload length
+ * @v step		Payload length increment
+ * @v count		Number of packets to send (or zero for no limit)
+ * @v flags		Ping flags
+ * @ret rc		Return status code
+ *
+ * If the maximum payload length exceeds the initial payload length,
+ * then @c count packets will be sent at each payload length in turn,
+ * stopping at the first length for which no response is received.
+ * This may be used to probe the path MTU.
+ */
+int ping ( const char *hostname, unsigned long timeout, size_t len,
+	   size_t max_len, size_t step, unsigned int count,
+	   unsigned int flags ) {
+	int rc;
+
+	/* Calibrate round-trip timing */
+	ping_flags = flags;
+	ping_calibrate();
+
+	/* Ping at each payload length in turn */
+	while ( 1 ) {
+		if ( ( rc = ping_len ( hostname, timeout, len, count ) ) != 0 )
+			return rc;
+		if ( ( len >= max_len ) || ( ! step ) )
+			break;
+		len += step;
+		if ( len > max_len )
+			len = max_len;
 	}
 
 	return 0;
@@ -46,3 +46,27 @@ void profstat ( void ) {
 			 profile_stddev ( profiler ), profiler->count );
 	}
 }
+
+/**
+ * Print profiling statistics in machine-readable form
+ *
+ * Each profiler is printed as a single line of space-separated
+ * "key=value" pairs.  The "hist" value is a comma-separated list of
+ * sample counts for each log2 latency histogram bucket.
+ */
+void profstat_raw ( void ) {
+	struct profiler *profiler;
+	unsigned int i;
+
+	for_each_table_entry ( profiler, PROFILERS ) {
+		printf ( "profiler name=%s count=%d mean=%ld stddev=%ld hist=",
+			 profiler->name, profiler->count,
+			 profile_mean ( profiler ),
+			 profile_stddev ( profiler ) );
+		for ( i = 0 ; i < PROFILE_HIST_BUCKETS ; i++ ) {
+			printf ( "%s%d", ( i ? "," : "" ),
+				 profiler->hist[i] );
+		}
+		printf ( "\n" );
+	}
+}
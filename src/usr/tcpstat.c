@@ -0,0 +1,123 @@
+/*
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License as
+ * published by the Free Software Foundation; either version 2 of the
+ * License, or any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+ * 02110-1301, USA.
+ *
+ * You can also choose to distribute this program under the terms of
+ * the Unmodified Binary Distribution Licence (as given in the file
+ * COPYING.UBDL), provided that you have satisfied its requirements.
+ */
+
+FILE_LICENCE ( GPL2_OR_LATER_OR_UBDL );
+#include <stdio.h>
+#include <byteswap.h>
+#include <ipxe/socket.h>
+#include <ipxe/tcp.h>
+#include <usr/tcpstat.h>
+
+/** @file
+ *
+ * TCP statistics
+ *
+ */
+
+/**
+ * Print TCP connection statistics
+ *
+ * @v stats		Statistics
+ */
+static void tcpstat_stats ( struct tcp_statistics *stats ) {
+
+	printf ( "  TxSegs:%ld TxBytes:%ld Retransmits:%ld Timeouts:%ld "
+		 "Recoveries:%ld TxSacks:%ld\n", stats->tx_segments,
+		 stats->tx_bytes, stats->retransmits, stats->timeouts,
+		 stats->recoveries, stats->tx_sacks );
+	printf ( "  RxSegs:%ld RxBytes:%ld RxOutOfOrder:%ld RxQueueMax:%zd "
+		 "RxSacks:%ld ZeroWindows:%ld\n", stats->rx_segments,
+		 stats->rx_bytes, stats->rx_ooo, stats->rx_queued_max,
+		 stats->rx_sacks, stats->zero_windows );
+}
+
+/**
+ * Print TCP connection statistics in machine-readable form
+ *
+ * @v stats		Statistics
+ */
+static void tcpstat_stats_raw ( struct tcp_statistics *stats ) {
+
+	printf ( "tx_segments=%ld tx_bytes=%ld retransmits=%ld timeouts=%ld "
+		 "recoveries=%ld tx_sacks=%ld rx_segments=%ld rx_bytes=%ld "
+		 "rx_ooo=%ld rx_queued_max=%zd rx_sacks=%ld "
+		 "zero_windows=%ld\n", stats->tx_segments, stats->tx_bytes,
+		 stats->retransmits, stats->timeouts, stats->recoveries,
+		 stats->tx_sacks, stats->rx_segments, stats->rx_bytes,
+		 stats->rx_ooo, stats->rx_queued_max, stats->rx_sacks,
+		 stats->zero_windows );
+}
+
+/**
+ * Print TCP statistics
+ *
+ */
+void tcpstat ( void ) {
+	struct tcp_statistics closed;
+	struct tcp_info info;
+	unsigned int i;
+
+	for ( i = 0 ; tcp_info ( i, &info ) == 0 ; i++ ) {
+		printf ( "TCP %s:%d local port %d %s:\n",
+			 sock_ntoa ( ( struct sockaddr * ) &info.peer ),
+			 ntohs ( info.peer.st_port ), info.local_port,
+			 info.state );
+		printf ( "  MSS:%zd SndWnd:%d RcvWnd:%d Cwnd:%d Ssthresh:%d "
+			 "SRTT:%ld RTTVAR:%ld\n", info.snd_mss, info.snd_win,
+			 info.rcv_win, info.cwnd, info.ssthresh, info.srtt,
+			 info.rttvar );
+		printf ( "  InFlight:%d TxQueued:%zd RxQueued:%zd\n",
+			 info.snd_sent, info.tx_queued, info.rx_queued );
+		tcpstat_stats ( &info.stats );
+	}
+	tcp_closed_stats ( &closed );
+	printf ( "TCP closed connections:\n" );
+	tcpstat_stats ( &closed );
+}
+
+/**
+ * Print TCP statistics in machine-readable form
+ *
+ * Each connection (and the accumulated statistics for all closed
+ * connections) is printed as a single line of space-separated
+ * "key=value" pairs.  Round-trip times are in timer ticks.
+ */
+void tcpstat_raw ( void ) {
+	struct tcp_statistics closed;
+	struct tcp_info info;
+	unsigned int i;
+
+	for ( i = 0 ; tcp_info ( i, &info ) == 0 ; i++ ) {
+		printf ( "tcp peer=%s port=%d local=%d state=%s mss=%zd "
+			 "snd_win=%d rcv_win=%d cwnd=%d ssthresh=%d srtt=%ld "
+			 "rttvar=%ld in_flight=%d tx_queued=%zd "
+			 "rx_queued=%zd ",
+			 sock_ntoa ( ( struct sockaddr * ) &info.peer ),
+			 ntohs ( info.peer.st_port ), info.local_port,
+			 info.state, info.snd_mss, info.snd_win, info.rcv_win,
+			 info.cwnd, info.ssthresh, info.srtt, info.rttvar,
+			 info.snd_sent, info.tx_queued, info.rx_queued );
+		tcpstat_stats_raw ( &info.stats );
+	}
+	tcp_closed_stats ( &closed );
+	printf ( "tcp closed " );
+	tcpstat_stats_raw ( &closed );
+}